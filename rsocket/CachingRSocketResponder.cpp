@@ -0,0 +1,322 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/CachingRSocketResponder.h"
+
+#include <folly/hash/Hash.h>
+#include <folly/io/IOBuf.h>
+
+#include <algorithm>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "yarpl/single/SingleSubscriptions.h"
+#include "yarpl/single/Singles.h"
+
+namespace rsocket {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+size_t lengthOf(const std::unique_ptr<folly::IOBuf>& buf) {
+  return buf ? buf->computeChainDataLength() : 0;
+}
+
+size_t lengthOf(const Payload& payload) {
+  return lengthOf(payload.metadata) + lengthOf(payload.data);
+}
+
+/// Null buffers are equal to empty ones.
+bool sameContents(
+    const std::unique_ptr<folly::IOBuf>& a,
+    const std::unique_ptr<folly::IOBuf>& b) {
+  auto const length = lengthOf(a);
+  if (length != lengthOf(b)) {
+    return false;
+  }
+  return length == 0 || folly::IOBufEqualTo()(*a, *b);
+}
+
+bool sameRequest(const Payload& a, const Payload& b) {
+  return sameContents(a.metadata, b.metadata) && sameContents(a.data, b.data);
+}
+
+uint64_t hashOf(const Payload& request) {
+  folly::IOBufHash hash;
+  return folly::hash::hash_128_to_64(
+      hash(request.metadata), hash(request.data));
+}
+
+/// Copy of a buffer that doesn't share its memory.  Incoming requests are
+/// usually slices of a much larger read buffer, which a clone would keep
+/// alive for as long as the cache entry.
+std::unique_ptr<folly::IOBuf> ownedCopy(
+    const std::unique_ptr<folly::IOBuf>& buf) {
+  if (!buf) {
+    return nullptr;
+  }
+  auto copy = folly::IOBuf::create(buf->computeChainDataLength());
+  for (auto range : *buf) {
+    std::memcpy(copy->writableTail(), range.data(), range.size());
+    copy->append(range.size());
+  }
+  return copy;
+}
+
+std::shared_ptr<yarpl::single::Single<Payload>> respondWith(Payload response) {
+  return yarpl::single::Singles::create<Payload>(
+      [response = std::move(response)](
+          std::shared_ptr<yarpl::single::SingleObserver<Payload>>
+              observer) mutable {
+        observer->onSubscribe(yarpl::single::SingleSubscriptions::empty());
+        observer->onSuccess(std::move(response));
+      });
+}
+
+} // namespace
+
+class CachingRSocketResponder::Cache {
+ public:
+  explicit Cache(const Options& options)
+      : shards_(std::max<size_t>(options.shards, 1)),
+        shardBytes_{options.maxBytes / shards_.size()},
+        ttl_{options.ttl} {}
+
+  folly::Optional<Payload> find(const Payload& request, uint64_t hash) {
+    auto& shard = shardFor(hash);
+    auto const now = Clock::now();
+
+    std::lock_guard<std::mutex> lock{shard.mutex};
+    auto range = shard.index.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      auto entry = it->second;
+      if (!sameRequest(entry->request, request)) {
+        continue;
+      }
+      if (entry->expiry <= now) {
+        shard.erase(it);
+        return folly::none;
+      }
+      shard.lru.splice(shard.lru.begin(), shard.lru, entry);
+      return entry->response.clone();
+    }
+    return folly::none;
+  }
+
+  void insert(Payload request, uint64_t hash, const Payload& response) {
+    auto const bytes = lengthOf(request) + lengthOf(response) + sizeof(Entry);
+    if (bytes > shardBytes_) {
+      return;
+    }
+    auto const expiry = ttl_.count() > 0 ? Clock::now() + ttl_
+                                         : Clock::time_point::max();
+
+    auto& shard = shardFor(hash);
+    std::lock_guard<std::mutex> lock{shard.mutex};
+    auto range = shard.index.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (sameRequest(it->second->request, request)) {
+        shard.erase(it);
+        break;
+      }
+    }
+
+    shard.lru.push_front(
+        Entry{hash, std::move(request), response.clone(), bytes, expiry});
+    shard.index.emplace(hash, shard.lru.begin());
+    shard.bytes += bytes;
+
+    while (shard.bytes > shardBytes_) {
+      auto oldest = std::prev(shard.lru.end());
+      auto range = shard.index.equal_range(oldest->hash);
+      auto it = std::find_if(range.first, range.second, [&](auto& indexed) {
+        return indexed.second == oldest;
+      });
+      DCHECK(it != range.second);
+      shard.erase(it);
+    }
+  }
+
+  size_t size() const {
+    size_t bytes = 0;
+    for (auto& shard : shards_) {
+      std::lock_guard<std::mutex> lock{shard.mutex};
+      bytes += shard.bytes;
+    }
+    return bytes;
+  }
+
+ private:
+  struct Entry {
+    uint64_t hash;
+    Payload request;
+    Payload response;
+    size_t bytes;
+    Clock::time_point expiry;
+  };
+
+  using Entries = std::list<Entry>;
+
+  struct Shard {
+    using Index = std::unordered_multimap<uint64_t, Entries::iterator>;
+
+    void erase(Index::iterator it) {
+      bytes -= it->second->bytes;
+      lru.erase(it->second);
+      index.erase(it);
+    }
+
+    mutable std::mutex mutex;
+
+    /// Most recently used first.
+    Entries lru;
+    Index index;
+    size_t bytes{0};
+  };
+
+  Shard& shardFor(uint64_t hash) {
+    return shards_[(hash >> 32) % shards_.size()];
+  }
+
+  std::vector<Shard> shards_;
+  const size_t shardBytes_;
+  const std::chrono::milliseconds ttl_;
+};
+
+namespace {
+
+/// Caches the response of a missed request on its way to the requester.
+class CacheFillingObserver : public yarpl::single::SingleObserver<Payload> {
+ public:
+  using Fill = folly::Function<void(const Payload& response)>;
+
+  CacheFillingObserver(
+      std::shared_ptr<yarpl::single::SingleObserver<Payload>> inner,
+      Fill fill)
+      : inner_{std::move(inner)}, fill_{std::move(fill)} {}
+
+  void onSubscribe(std::shared_ptr<yarpl::single::SingleSubscription>
+                       subscription) override {
+    inner_->onSubscribe(std::move(subscription));
+  }
+
+  void onSuccess(Payload response) override {
+    fill_(response);
+    inner_->onSuccess(std::move(response));
+  }
+
+  void onError(folly::exception_wrapper ew) override {
+    inner_->onError(std::move(ew));
+  }
+
+ private:
+  const std::shared_ptr<yarpl::single::SingleObserver<Payload>> inner_;
+  Fill fill_;
+};
+
+} // namespace
+
+CachingRSocketResponder::CachingRSocketResponder(
+    std::shared_ptr<RSocketResponder> inner,
+    Options options,
+    std::shared_ptr<RSocketStats> stats)
+    : inner_{std::move(inner)},
+      cacheable_{std::move(options.cacheable)},
+      cache_{std::make_shared<Cache>(options)},
+      stats_{std::move(stats)} {
+  CHECK(inner_);
+}
+
+CachingRSocketResponder::~CachingRSocketResponder() = default;
+
+folly::Optional<Payload> CachingRSocketResponder::lookup(
+    const Payload& request) {
+  if (cacheable_ && !cacheable_(request)) {
+    return folly::none;
+  }
+  auto response = cache_->find(request, hashOf(request));
+  if (response) {
+    stats_->responseCacheHit();
+  }
+  return response;
+}
+
+size_t CachingRSocketResponder::size() const {
+  return cache_->size();
+}
+
+std::shared_ptr<yarpl::single::Single<Payload>>
+CachingRSocketResponder::handleRequestResponse(
+    Payload request,
+    StreamId streamId) {
+  if (cacheable_ && !cacheable_(request)) {
+    return inner_->handleRequestResponse(std::move(request), streamId);
+  }
+
+  auto const hash = hashOf(request);
+  if (auto response = cache_->find(request, hash)) {
+    stats_->responseCacheHit();
+    return respondWith(std::move(*response));
+  }
+  stats_->responseCacheMiss();
+
+  Payload key{ownedCopy(request.data), ownedCopy(request.metadata)};
+  auto single = inner_->handleRequestResponse(std::move(request), streamId);
+  return yarpl::single::Singles::create<Payload>(
+      [single = std::move(single),
+       cache = cache_,
+       key = std::move(key),
+       hash](std::shared_ptr<yarpl::single::SingleObserver<Payload>>
+                 observer) mutable {
+        single->subscribe(std::make_shared<CacheFillingObserver>(
+            std::move(observer),
+            [cache = std::move(cache), key = std::move(key), hash](
+                const Payload& response) mutable {
+              cache->insert(std::move(key), hash, response);
+            }));
+      });
+}
+
+std::shared_ptr<yarpl::flowable::Flowable<Payload>>
+CachingRSocketResponder::handleRequestStream(
+    Payload request,
+    StreamId streamId) {
+  return inner_->handleRequestStream(std::move(request), streamId);
+}
+
+std::shared_ptr<yarpl::flowable::Flowable<Payload>>
+CachingRSocketResponder::handleRequestChannel(
+    Payload request,
+    std::shared_ptr<yarpl::flowable::Flowable<Payload>> requestStream,
+    StreamId streamId) {
+  return inner_->handleRequestChannel(
+      std::move(request), std::move(requestStream), streamId);
+}
+
+void CachingRSocketResponder::handleFireAndForget(
+    Payload request,
+    StreamId streamId) {
+  inner_->handleFireAndForget(std::move(request), streamId);
+}
+
+void CachingRSocketResponder::handleMetadataPush(
+    std::unique_ptr<folly::IOBuf> metadata) {
+  inner_->handleMetadataPush(std::move(metadata));
+}
+
+} // namespace rsocket
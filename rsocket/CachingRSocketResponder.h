@@ -0,0 +1,102 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Optional.h>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+
+#include "rsocket/RSocketResponder.h"
+#include "rsocket/RSocketStats.h"
+
+namespace rsocket {
+
+/**
+ * A decorated RSocketResponder that caches the responses of request-response
+ * calls.
+ *
+ * Requests are identified by their metadata (which carries the route) and
+ * data.  Lookups hash both without copying them, and compare them in full with
+ * the cached request on a hit.  A hit is answered with a clone of the cached
+ * Payload, which shares its buffers, right on the thread of the call.
+ * RSocketServer also checks the cache before handing a request to the
+ * executor of setResponderExecutor(), so that hits never leave the I/O thread.
+ *
+ * The cache is split into shards with a lock each, and every shard evicts its
+ * least recently used entries to stay within its share of `maxBytes`.  Only
+ * successful responses are cached.  Streams, channels and fire-and-forget
+ * requests go to the inner responder as they are.
+ *
+ * An instance can be shared by connections on different threads.
+ */
+class CachingRSocketResponder : public RSocketResponder {
+ public:
+  struct Options {
+    /// Upper bound on the bytes held by the cached requests and responses.
+    size_t maxBytes{64 * 1024 * 1024};
+
+    /// Number of independently locked parts of the cache.
+    size_t shards{16};
+
+    /// How long a response stays valid.  Zero keeps it until it is evicted.
+    std::chrono::milliseconds ttl{std::chrono::seconds{10}};
+
+    /// Whether the response to a request may be cached.  All of them are by
+    /// default.  Called concurrently from the threads of the connections.
+    std::function<bool(const Payload& request)> cacheable;
+  };
+
+  /// `stats` counts the hits and misses, see RSocketStats::responseCacheHit().
+  CachingRSocketResponder(
+      std::shared_ptr<RSocketResponder> inner,
+      Options options,
+      std::shared_ptr<RSocketStats> stats = RSocketStats::noop());
+  ~CachingRSocketResponder() override;
+
+  /// Returns a clone of the cached response to `request`, if there is one.
+  folly::Optional<Payload> lookup(const Payload& request);
+
+  /// Bytes held by the cache right now.
+  size_t size() const;
+
+  std::shared_ptr<yarpl::single::Single<Payload>> handleRequestResponse(
+      Payload request,
+      StreamId streamId) override;
+
+  std::shared_ptr<yarpl::flowable::Flowable<Payload>> handleRequestStream(
+      Payload request,
+      StreamId streamId) override;
+
+  std::shared_ptr<yarpl::flowable::Flowable<Payload>> handleRequestChannel(
+      Payload request,
+      std::shared_ptr<yarpl::flowable::Flowable<Payload>> requestStream,
+      StreamId streamId) override;
+
+  void handleFireAndForget(Payload request, StreamId streamId) override;
+
+  void handleMetadataPush(std::unique_ptr<folly::IOBuf> metadata) override;
+
+ private:
+  class Cache;
+
+  const std::shared_ptr<RSocketResponder> inner_;
+  const std::function<bool(const Payload&)> cacheable_;
+  const std::shared_ptr<Cache> cache_;
+  const std::shared_ptr<RSocketStats> stats_;
+};
+
+} // namespace rsocket
@@ -0,0 +1,328 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/CoalescingRSocketResponder.h"
+
+#include <folly/Conv.h>
+#include <folly/ExceptionWrapper.h>
+#include <folly/Try.h>
+
+#include <algorithm>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "yarpl/single/SingleSubscriptions.h"
+#include "yarpl/single/Singles.h"
+
+namespace rsocket {
+
+/// The requests in flight, by key.
+struct CoalescingRSocketResponder::Flights {
+  explicit Flights(std::shared_ptr<RSocketStats> s) : stats{std::move(s)} {}
+
+  /// Forgets `flight` once it completed or got cancelled, so that the next
+  /// request with its key starts another one.
+  void erase(const std::string& key, const Flight* flight) {
+    auto locked = byKey.wlock();
+    auto it = locked->find(key);
+    if (it != locked->end() && it->second.get() == flight) {
+      locked->erase(it);
+    }
+  }
+
+  folly::Synchronized<std::unordered_map<std::string, std::shared_ptr<Flight>>>
+      byKey;
+  const std::shared_ptr<RSocketStats> stats;
+};
+
+/// Subscription of one of the requests waiting for a flight.  It can be
+/// cancelled before it is attached to the flight.
+class CoalescingRSocketResponder::Waiter
+    : public yarpl::single::SingleSubscription {
+ public:
+  void cancel() override;
+
+  /// Returns false if the waiter got cancelled already.
+  bool attach(std::shared_ptr<Flight> flight) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (cancelled_) {
+      return false;
+    }
+    flight_ = std::move(flight);
+    return true;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::shared_ptr<Flight> flight_;
+  bool cancelled_{false};
+};
+
+/// One request to the inner responder, and the requests waiting for its
+/// result.
+class CoalescingRSocketResponder::Flight
+    : public yarpl::single::SingleObserver<Payload>,
+      public std::enable_shared_from_this<Flight> {
+ public:
+  using Observer = std::shared_ptr<yarpl::single::SingleObserver<Payload>>;
+
+  Flight(std::weak_ptr<Flights> flights, std::string key)
+      : flights_{std::move(flights)}, key_{std::move(key)} {}
+
+  /// Makes `observer` wait for the result, delivering it right away if the
+  /// flight completed in the meantime.  Returns false if the flight got
+  /// cancelled, and the request has to start another one.
+  bool join(const std::shared_ptr<Waiter>& waiter, Observer observer) {
+    std::unique_lock<std::mutex> lock{mutex_};
+    if (cancelled_) {
+      return false;
+    }
+    if (completed_) {
+      lock.unlock();
+      deliver(*observer);
+      return true;
+    }
+    waiters_.emplace_back(waiter.get(), std::move(observer));
+    lock.unlock();
+
+    if (!waiter->attach(shared_from_this())) {
+      leave(waiter.get());
+    }
+    return true;
+  }
+
+  /// Removes a cancelled waiter, and cancels the inner request if it was the
+  /// last one.
+  void leave(const Waiter* waiter) {
+    std::unique_lock<std::mutex> lock{mutex_};
+    auto it = std::find_if(
+        waiters_.begin(), waiters_.end(), [&](const auto& entry) {
+          return entry.first == waiter;
+        });
+    if (it == waiters_.end()) {
+      return;
+    }
+    waiters_.erase(it);
+    if (!waiters_.empty()) {
+      return;
+    }
+
+    cancelled_ = true;
+    auto subscription = std::move(subscription_);
+    lock.unlock();
+
+    if (auto flights = flights_.lock()) {
+      flights->erase(key_, this);
+    }
+    if (subscription) {
+      subscription->cancel();
+    }
+  }
+
+  size_t waiting() const {
+    std::lock_guard<std::mutex> lock{mutex_};
+    return waiters_.size();
+  }
+
+  // SingleObserver, for the inner request.
+
+  void onSubscribe(std::shared_ptr<yarpl::single::SingleSubscription>
+                       subscription) override {
+    std::unique_lock<std::mutex> lock{mutex_};
+    if (cancelled_) {
+      lock.unlock();
+      subscription->cancel();
+      return;
+    }
+    subscription_ = std::move(subscription);
+  }
+
+  void onSuccess(Payload response) override {
+    complete(folly::Try<Payload>(std::move(response)));
+  }
+
+  void onError(folly::exception_wrapper ew) override {
+    complete(folly::Try<Payload>(std::move(ew)));
+  }
+
+ private:
+  void complete(folly::Try<Payload> result) {
+    // Stop new requests from joining before handing out the result.
+    if (auto flights = flights_.lock()) {
+      flights->erase(key_, this);
+    }
+
+    std::vector<std::pair<const Waiter*, Observer>> waiters;
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      result_ = std::move(result);
+      completed_ = true;
+      subscription_.reset();
+      waiters = std::move(waiters_);
+      waiters_.clear();
+    }
+
+    for (auto& waiter : waiters) {
+      deliver(*waiter.second);
+    }
+  }
+
+  /// Hands a clone of the result to `observer`.  The result doesn't change
+  /// once completed_ is set.
+  void deliver(yarpl::single::SingleObserver<Payload>& observer) const {
+    if (result_.hasException()) {
+      observer.onError(result_.exception());
+    } else {
+      observer.onSuccess(result_.value().clone());
+    }
+  }
+
+  const std::weak_ptr<Flights> flights_;
+  const std::string key_;
+
+  mutable std::mutex mutex_;
+  std::vector<std::pair<const Waiter*, Observer>> waiters_;
+  std::shared_ptr<yarpl::single::SingleSubscription> subscription_;
+  folly::Try<Payload> result_;
+  bool completed_{false};
+  bool cancelled_{false};
+};
+
+void CoalescingRSocketResponder::Waiter::cancel() {
+  std::shared_ptr<Flight> flight;
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    cancelled_ = true;
+    flight = std::move(flight_);
+  }
+  if (flight) {
+    flight->leave(this);
+  }
+}
+
+CoalescingRSocketResponder::CoalescingRSocketResponder(
+    std::shared_ptr<RSocketResponder> inner,
+    KeyFunction keyFunction,
+    std::shared_ptr<RSocketStats> stats)
+    : inner_{std::move(inner)},
+      keyFunction_{std::move(keyFunction)},
+      flights_{std::make_shared<Flights>(std::move(stats))} {
+  CHECK(inner_);
+  CHECK(keyFunction_);
+}
+
+folly::Optional<std::string> CoalescingRSocketResponder::keyByMetadataAndData(
+    const Payload& request) {
+  // Prefixed with the length of the metadata, so that moving bytes between
+  // metadata and data makes another key.
+  auto const metadataLength =
+      request.metadata ? request.metadata->computeChainDataLength() : 0;
+  auto const dataLength =
+      request.data ? request.data->computeChainDataLength() : 0;
+  auto key = folly::to<std::string>(metadataLength, ':');
+  key.reserve(key.size() + metadataLength + dataLength);
+  auto const append = [&](folly::StringPiece range) {
+    key.append(range.data(), range.size());
+  };
+  request.forEachMetadataRange(append);
+  request.forEachDataRange(append);
+  return key;
+}
+
+std::shared_ptr<yarpl::single::Single<Payload>>
+CoalescingRSocketResponder::handleRequestResponse(
+    Payload request,
+    StreamId streamId) {
+  auto key = keyFunction_(request);
+  if (!key) {
+    return inner_->handleRequestResponse(std::move(request), streamId);
+  }
+
+  return yarpl::single::Singles::create<Payload>(
+      [inner = inner_,
+       flights = flights_,
+       key = std::move(*key),
+       request = std::move(request),
+       streamId](std::shared_ptr<yarpl::single::SingleObserver<Payload>>
+                     observer) mutable {
+        auto waiter = std::make_shared<Waiter>();
+        observer->onSubscribe(waiter);
+
+        while (true) {
+          std::shared_ptr<Flight> flight;
+          bool started = false;
+          {
+            auto locked = flights->byKey.wlock();
+            auto& entry = (*locked)[key];
+            if (!entry) {
+              entry = std::make_shared<Flight>(flights, key);
+              started = true;
+            }
+            flight = entry;
+          }
+
+          if (!flight->join(waiter, observer)) {
+            // Everybody else gave up on that one, start another.
+            flights->erase(key, flight.get());
+            continue;
+          }
+          if (started) {
+            inner->handleRequestResponse(std::move(request), streamId)
+                ->subscribe(std::move(flight));
+          } else {
+            flights->stats->requestCoalesced();
+          }
+          return;
+        }
+      });
+}
+
+std::shared_ptr<yarpl::flowable::Flowable<Payload>>
+CoalescingRSocketResponder::handleRequestStream(
+    Payload request,
+    StreamId streamId) {
+  return inner_->handleRequestStream(std::move(request), streamId);
+}
+
+std::shared_ptr<yarpl::flowable::Flowable<Payload>>
+CoalescingRSocketResponder::handleRequestChannel(
+    Payload request,
+    std::shared_ptr<yarpl::flowable::Flowable<Payload>> requestStream,
+    StreamId streamId) {
+  return inner_->handleRequestChannel(
+      std::move(request), std::move(requestStream), streamId);
+}
+
+void CoalescingRSocketResponder::handleFireAndForget(
+    Payload request,
+    StreamId streamId) {
+  inner_->handleFireAndForget(std::move(request), streamId);
+}
+
+void CoalescingRSocketResponder::handleMetadataPush(
+    std::unique_ptr<folly::IOBuf> metadata) {
+  inner_->handleMetadataPush(std::move(metadata));
+}
+
+size_t CoalescingRSocketResponder::inFlight() const {
+  size_t waiting = 0;
+  auto locked = flights_->byKey.rlock();
+  for (auto& entry : *locked) {
+    waiting += entry.second->waiting();
+  }
+  return waiting;
+}
+
+} // namespace rsocket
@@ -0,0 +1,97 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/Synchronized.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "rsocket/RSocketResponder.h"
+#include "rsocket/RSocketStats.h"
+
+namespace rsocket {
+
+/**
+ * A decorated RSocketResponder that coalesces identical request-response
+ * calls which are in flight at the same time.
+ *
+ * The first request with a given key is passed on to the inner responder.
+ * Requests that arrive with the same key before it completes wait for its
+ * result instead, and every one of them receives a clone of the response
+ * Payload, which shares the response buffers rather than copying them.  A
+ * waiting request that gets cancelled leaves the others waiting, and the
+ * inner request is cancelled once nobody waits for it anymore.
+ *
+ * An instance can be shared by connections on different threads.  Results are
+ * delivered on the thread the inner responder completes on, which
+ * RSocketServer moves back to the EventBase of each connection unless it was
+ * given setSingleThreadedResponder().
+ *
+ * Streams, channels and fire-and-forget requests go to the inner responder as
+ * they are.
+ */
+class CoalescingRSocketResponder : public RSocketResponder {
+ public:
+  /// Returns the key identifying a request, or folly::none to never coalesce
+  /// it.  Called concurrently from the threads of the connections.
+  using KeyFunction =
+      std::function<folly::Optional<std::string>(const Payload& request)>;
+
+  /// `stats` counts the requests that were coalesced, see
+  /// RSocketStats::requestCoalesced().
+  CoalescingRSocketResponder(
+      std::shared_ptr<RSocketResponder> inner,
+      KeyFunction keyFunction = keyByMetadataAndData,
+      std::shared_ptr<RSocketStats> stats = RSocketStats::noop());
+
+  /// Requests are identical when both their metadata and data are.
+  static folly::Optional<std::string> keyByMetadataAndData(const Payload&);
+
+  std::shared_ptr<yarpl::single::Single<Payload>> handleRequestResponse(
+      Payload request,
+      StreamId streamId) override;
+
+  std::shared_ptr<yarpl::flowable::Flowable<Payload>> handleRequestStream(
+      Payload request,
+      StreamId streamId) override;
+
+  std::shared_ptr<yarpl::flowable::Flowable<Payload>> handleRequestChannel(
+      Payload request,
+      std::shared_ptr<yarpl::flowable::Flowable<Payload>> requestStream,
+      StreamId streamId) override;
+
+  void handleFireAndForget(Payload request, StreamId streamId) override;
+
+  void handleMetadataPush(std::unique_ptr<folly::IOBuf> metadata) override;
+
+  /// Number of requests waiting for an inner request right now, including the
+  /// ones that started it.
+  size_t inFlight() const;
+
+ private:
+  class Flight;
+  struct Flights;
+  class Waiter;
+
+  const std::shared_ptr<RSocketResponder> inner_;
+  const KeyFunction keyFunction_;
+  const std::shared_ptr<Flights> flights_;
+};
+
+} // namespace rsocket
@@ -17,6 +17,9 @@
 #include "yarpl/flowable/CancelingSubscriber.h"
 
 #include <folly/Conv.h>
+#include <folly/futures/Future.h>
+
+#include <algorithm>
 
 using namespace yarpl::flowable;
 
@@ -43,4 +46,40 @@ ColdResumeHandler::handleRequesterResumeStream(
     size_t /* consumerAllowance */) {
   return std::make_shared<CancelingSubscriber<Payload>>();
 }
+
+std::vector<std::shared_ptr<Subscriber<Payload>>>
+ColdResumeHandler::handleRequesterResumeStreams(
+    std::vector<RequesterResumeStream> streams) {
+  std::vector<std::shared_ptr<Subscriber<Payload>>> subscribers(
+      streams.size());
+  auto const resumeChunk = [&](size_t begin, size_t end) {
+    for (auto i = begin; i < end; ++i) {
+      subscribers[i] = handleRequesterResumeStream(
+          std::move(streams[i].streamToken), streams[i].consumerAllowance);
+    }
+  };
+
+  auto const chunkSize = std::max<size_t>(resumeChunkSize(), 1);
+  auto const executor = resumeExecutor();
+  if (!executor || streams.size() <= chunkSize) {
+    resumeChunk(0, streams.size());
+    return subscribers;
+  }
+
+  std::vector<folly::Future<folly::Unit>> chunks;
+  chunks.reserve((streams.size() + chunkSize - 1) / chunkSize);
+  for (size_t begin = 0; begin < streams.size(); begin += chunkSize) {
+    auto const end = std::min(begin + chunkSize, streams.size());
+    chunks.push_back(
+        folly::via(executor, [&resumeChunk, begin, end] {
+          resumeChunk(begin, end);
+        }));
+  }
+
+  // Wait for every chunk, even if one failed, as they all refer to `streams`.
+  for (auto& chunk : folly::collectAll(std::move(chunks)).get()) {
+    chunk.throwIfFailed();
+  }
+  return subscribers;
+}
 } // namespace rsocket
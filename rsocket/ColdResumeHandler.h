@@ -14,6 +14,11 @@
 
 #pragma once
 
+#include <folly/Executor.h>
+
+#include <string>
+#include <vector>
+
 #include "yarpl/Flowable.h"
 
 #include "rsocket/Payload.h"
@@ -51,6 +56,36 @@ class ColdResumeHandler {
   handleRequesterResumeStream(
       std::string streamToken,
       size_t consumerAllowance);
+
+  // A REQUEST_STREAM for which the application acted as a requester before
+  // cold-start.
+  struct RequesterResumeStream {
+    StreamId streamId;
+    std::string streamToken;
+    size_t consumerAllowance;
+  };
+
+  // This method will be called once per cold resumption with all the
+  // REQUEST_STREAMs for which the application acted as a requester, and
+  // returns their Subscribers in the same order.  It runs on the EventBase of
+  // the connection, which waits for it to return since frames of the streams
+  // may follow right behind RESUME_OK.  The default action calls
+  // handleRequesterResumeStream() for every stream, in chunks of
+  // resumeChunkSize() streams run in parallel on resumeExecutor() if there is
+  // one.
+  virtual std::vector<
+      std::shared_ptr<yarpl::flowable::Subscriber<rsocket::Payload>>>
+  handleRequesterResumeStreams(std::vector<RequesterResumeStream> streams);
+
+  // Executor to re-establish streams on in parallel.  When there is one,
+  // handleRequesterResumeStream() must be thread-safe.
+  virtual folly::Executor* resumeExecutor() {
+    return nullptr;
+  }
+
+  virtual size_t resumeChunkSize() const {
+    return 64;
+  }
 };
 
 } // namespace rsocket
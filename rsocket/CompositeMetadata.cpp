@@ -0,0 +1,314 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/CompositeMetadata.h"
+
+#include <stdexcept>
+
+namespace rsocket {
+
+namespace {
+
+struct KnownMimeType {
+  uint8_t id;
+  folly::StringPiece name;
+};
+
+constexpr KnownMimeType kWellKnownMimeTypes[] = {
+    {0x00, "application/avro"},
+    {0x01, "application/cbor"},
+    {0x02, "application/graphql"},
+    {0x03, "application/gzip"},
+    {0x04, "application/javascript"},
+    {0x05, "application/json"},
+    {0x06, "application/octet-stream"},
+    {0x07, "application/pdf"},
+    {0x08, "application/vnd.apache.thrift.binary"},
+    {0x09, "application/vnd.google.protobuf"},
+    {0x0A, "application/xml"},
+    {0x0B, "application/zip"},
+    {0x0C, "audio/aac"},
+    {0x0D, "audio/mp3"},
+    {0x0E, "audio/mp4"},
+    {0x0F, "audio/mpeg3"},
+    {0x10, "audio/mpeg"},
+    {0x11, "audio/ogg"},
+    {0x12, "audio/opus"},
+    {0x13, "audio/vorbis"},
+    {0x14, "image/bmp"},
+    {0x15, "image/gif"},
+    {0x16, "image/heic-sequence"},
+    {0x17, "image/heic"},
+    {0x18, "image/heif-sequence"},
+    {0x19, "image/heif"},
+    {0x1A, "image/jpeg"},
+    {0x1B, "image/png"},
+    {0x1C, "image/tiff"},
+    {0x1D, "multipart/mixed"},
+    {0x1E, "text/css"},
+    {0x1F, "text/csv"},
+    {0x20, "text/html"},
+    {0x21, "text/plain"},
+    {0x22, "text/xml"},
+    {0x23, "video/H264"},
+    {0x24, "video/H265"},
+    {0x25, "video/VP8"},
+    {0x26, "application/x-hessian"},
+    {0x27, "application/x-java-object"},
+    {0x28, "application/cloudevents+json"},
+    {0x7A, "message/x.rsocket.mime-type.v0"},
+    {0x7B, "message/x.rsocket.accept-mime-types.v0"},
+    {0x7C, "message/x.rsocket.authentication.v0"},
+    {0x7D, "message/x.rsocket.tracing-zipkin.v0"},
+    {0x7E, "message/x.rsocket.routing.v0"},
+    {0x7F, "message/x.rsocket.composite-metadata.v0"},
+};
+
+constexpr size_t kMaxMimeTypeLength = 128;
+constexpr size_t kMaxContentLength = (1 << 24) - 1;
+constexpr size_t kMaxTagLength = 255;
+
+/// Reads `length` bytes, which the cursor must have.  They are returned in
+/// place if they are in one buffer, and copied into `scratch` otherwise.
+folly::StringPiece
+readView(folly::io::Cursor& cursor, size_t length, char* scratch) {
+  auto const bytes = cursor.peekBytes();
+  if (bytes.size() >= length) {
+    cursor.skip(length);
+    return folly::StringPiece(
+        reinterpret_cast<const char*>(bytes.data()), length);
+  }
+  cursor.pull(scratch, length);
+  return folly::StringPiece(scratch, length);
+}
+
+void writeContentLength(folly::io::QueueAppender& appender, size_t length) {
+  appender.write<uint8_t>(static_cast<uint8_t>(length >> 16));
+  appender.write<uint8_t>(static_cast<uint8_t>(length >> 8));
+  appender.write<uint8_t>(static_cast<uint8_t>(length));
+}
+
+size_t contentLengthOf(const std::unique_ptr<folly::IOBuf>& content) {
+  auto const length = content ? content->computeChainDataLength() : 0;
+  if (length > kMaxContentLength) {
+    throw std::invalid_argument("Composite metadata entry is too long");
+  }
+  return length;
+}
+
+} // namespace
+
+folly::StringPiece wellKnownMimeType(uint8_t id) {
+  static const auto names = [] {
+    std::array<folly::StringPiece, 128> names;
+    for (auto const& mimeType : kWellKnownMimeTypes) {
+      names[mimeType.id] = mimeType.name;
+    }
+    return names;
+  }();
+  return id < names.size() ? names[id] : folly::StringPiece();
+}
+
+folly::Optional<uint8_t> wellKnownMimeTypeId(folly::StringPiece mimeType) {
+  for (auto const& known : kWellKnownMimeTypes) {
+    if (known.name == mimeType) {
+      return known.id;
+    }
+  }
+  return folly::none;
+}
+
+folly::Optional<folly::ByteRange>
+CompositeMetadataReader::Entry::contiguousContent() const {
+  auto cursor = content;
+  auto const bytes = cursor.peekBytes();
+  if (bytes.size() < contentLength) {
+    return folly::none;
+  }
+  return bytes.subpiece(0, contentLength);
+}
+
+std::unique_ptr<folly::IOBuf> CompositeMetadataReader::Entry::cloneContent()
+    const {
+  if (contentLength == 0) {
+    return folly::IOBuf::create(0);
+  }
+  auto cursor = content;
+  std::unique_ptr<folly::IOBuf> buf;
+  cursor.clone(buf, contentLength);
+  return buf;
+}
+
+CompositeMetadataReader::CompositeMetadataReader(const folly::IOBuf& metadata)
+    : cursor_(&metadata),
+      remaining_(metadata.computeChainDataLength()),
+      entry_(metadata) {}
+
+bool CompositeMetadataReader::next() {
+  if (remaining_ == 0 || malformed_) {
+    return false;
+  }
+
+  auto const mime = cursor_.read<uint8_t>();
+  --remaining_;
+  if (mime & 0x80) {
+    auto const id = static_cast<uint8_t>(mime & 0x7F);
+    entry_.mimeTypeId = static_cast<WellKnownMimeType>(id);
+    entry_.mimeType = wellKnownMimeType(id);
+  } else {
+    size_t const length = mime + 1;
+    if (remaining_ < length) {
+      malformed_ = true;
+      return false;
+    }
+    entry_.mimeTypeId = folly::none;
+    entry_.mimeType = readView(cursor_, length, mimeTypeScratch_.data());
+    remaining_ -= length;
+  }
+
+  if (remaining_ < 3) {
+    malformed_ = true;
+    return false;
+  }
+  size_t length = cursor_.read<uint8_t>() << 16;
+  length |= cursor_.read<uint8_t>() << 8;
+  length |= cursor_.read<uint8_t>();
+  remaining_ -= 3;
+  if (remaining_ < length) {
+    malformed_ = true;
+    return false;
+  }
+
+  entry_.content = cursor_;
+  entry_.contentLength = length;
+  cursor_.skip(length);
+  remaining_ -= length;
+  return true;
+}
+
+const CompositeMetadataReader::Entry* CompositeMetadataReader::find(
+    WellKnownMimeType mimeTypeId) {
+  // The well-known types can also be given by name.
+  auto const name = wellKnownMimeType(mimeTypeId);
+  while (next()) {
+    if (entry_.mimeTypeId ? *entry_.mimeTypeId == mimeTypeId
+                          : entry_.mimeType == name) {
+      return &entry_;
+    }
+  }
+  return nullptr;
+}
+
+const CompositeMetadataReader::Entry* CompositeMetadataReader::find(
+    folly::StringPiece mimeType) {
+  while (next()) {
+    if (entry_.mimeType == mimeType) {
+      return &entry_;
+    }
+  }
+  return nullptr;
+}
+
+RoutingMetadataReader::RoutingMetadataReader(const folly::IOBuf& metadata)
+    : cursor_(&metadata), remaining_(metadata.computeChainDataLength()) {}
+
+RoutingMetadataReader::RoutingMetadataReader(
+    const CompositeMetadataReader::Entry& entry)
+    : cursor_(entry.content), remaining_(entry.contentLength) {}
+
+bool RoutingMetadataReader::next() {
+  if (remaining_ == 0 || malformed_) {
+    return false;
+  }
+  size_t const length = cursor_.read<uint8_t>();
+  --remaining_;
+  if (length == 0 || remaining_ < length) {
+    malformed_ = true;
+    return false;
+  }
+  tag_ = readView(cursor_, length, tagScratch_.data());
+  remaining_ -= length;
+  return true;
+}
+
+CompositeMetadataBuilder& CompositeMetadataBuilder::add(
+    folly::StringPiece mimeType,
+    std::unique_ptr<folly::IOBuf> content) {
+  if (auto const id = wellKnownMimeTypeId(mimeType)) {
+    return add(static_cast<WellKnownMimeType>(*id), std::move(content));
+  }
+  if (mimeType.empty() || mimeType.size() > kMaxMimeTypeLength) {
+    throw std::invalid_argument(
+        "Composite metadata MIME type must be 1 to 128 bytes long");
+  }
+  auto const length = contentLengthOf(content);
+  {
+    folly::io::QueueAppender appender(&queue_, 64);
+    appender.write<uint8_t>(static_cast<uint8_t>(mimeType.size() - 1));
+    appender.push(
+        reinterpret_cast<const uint8_t*>(mimeType.data()), mimeType.size());
+    writeContentLength(appender, length);
+  }
+  if (length > 0) {
+    queue_.append(std::move(content));
+  }
+  return *this;
+}
+
+CompositeMetadataBuilder& CompositeMetadataBuilder::add(
+    WellKnownMimeType mimeTypeId,
+    std::unique_ptr<folly::IOBuf> content) {
+  auto const length = contentLengthOf(content);
+  {
+    folly::io::QueueAppender appender(&queue_, 64);
+    appender.write<uint8_t>(0x80 | static_cast<uint8_t>(mimeTypeId));
+    writeContentLength(appender, length);
+  }
+  if (length > 0) {
+    queue_.append(std::move(content));
+  }
+  return *this;
+}
+
+CompositeMetadataBuilder& CompositeMetadataBuilder::addRouting(
+    std::initializer_list<folly::StringPiece> tags) {
+  size_t length = 0;
+  for (auto tag : tags) {
+    if (tag.empty() || tag.size() > kMaxTagLength) {
+      throw std::invalid_argument(
+          "Routing metadata tags must be 1 to 255 bytes long");
+    }
+    length += 1 + tag.size();
+  }
+  if (length > kMaxContentLength) {
+    throw std::invalid_argument("Composite metadata entry is too long");
+  }
+
+  folly::io::QueueAppender appender(&queue_, 4 + length);
+  appender.write<uint8_t>(
+      0x80 | static_cast<uint8_t>(WellKnownMimeType::Routing));
+  writeContentLength(appender, length);
+  for (auto tag : tags) {
+    appender.write<uint8_t>(static_cast<uint8_t>(tag.size()));
+    appender.push(reinterpret_cast<const uint8_t*>(tag.data()), tag.size());
+  }
+  return *this;
+}
+
+std::unique_ptr<folly::IOBuf> CompositeMetadataBuilder::build() {
+  auto metadata = queue_.move();
+  return metadata ? std::move(metadata) : folly::IOBuf::create(0);
+}
+
+} // namespace rsocket
@@ -0,0 +1,188 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/Range.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBuf.h>
+#include <folly/io/IOBufQueue.h>
+
+#include <array>
+#include <initializer_list>
+#include <memory>
+
+namespace rsocket {
+
+/// Ids of the MIME types of the RSocket well-known MIME types extension that
+/// are used by the metadata extensions.  See wellKnownMimeType() for the rest.
+enum class WellKnownMimeType : uint8_t {
+  ApplicationJson = 0x05,
+  ApplicationOctetStream = 0x06,
+  ApplicationProtobuf = 0x09,
+  TextPlain = 0x21,
+  MimeType = 0x7A,
+  AcceptMimeTypes = 0x7B,
+  Authentication = 0x7C,
+  TracingZipkin = 0x7D,
+  Routing = 0x7E,
+  CompositeMetadata = 0x7F,
+};
+
+/// Returns the name of a well-known MIME type, or an empty string if the id
+/// isn't assigned.
+folly::StringPiece wellKnownMimeType(uint8_t id);
+
+inline folly::StringPiece wellKnownMimeType(WellKnownMimeType id) {
+  return wellKnownMimeType(static_cast<uint8_t>(id));
+}
+
+/// Returns the id of a well-known MIME type, or folly::none if `mimeType`
+/// isn't one.
+folly::Optional<uint8_t> wellKnownMimeTypeId(folly::StringPiece mimeType);
+
+/**
+ * Reads the entries of composite metadata
+ * (message/x.rsocket.composite-metadata.v0) in place.
+ *
+ * The metadata can be an IOBuf chain, entries are read across its buffers
+ * without coalescing it.  A MIME type name that straddles two buffers is
+ * copied into the reader, nothing else is copied or allocated, so the views
+ * of an entry are valid until the next call to next(), and only as long as
+ * the metadata is.
+ *
+ *   CompositeMetadataReader reader{*payload.metadata};
+ *   while (reader.next()) {
+ *     if (reader.entry().mimeTypeId == WellKnownMimeType::TracingZipkin) {
+ *       ...
+ *     }
+ *   }
+ */
+class CompositeMetadataReader {
+ public:
+  struct Entry {
+    explicit Entry(const folly::IOBuf& metadata) : content(&metadata) {}
+
+    /// Id of the MIME type of the entry, if it is encoded by its id.
+    folly::Optional<WellKnownMimeType> mimeTypeId;
+
+    /// Name of the MIME type of the entry.  Empty for a well-known id that
+    /// isn't assigned yet.
+    folly::StringPiece mimeType;
+
+    /// Cursor at the start of the content of the entry, which is
+    /// `contentLength` bytes long.
+    folly::io::Cursor content;
+    size_t contentLength{0};
+
+    /// Returns the content, if it is contiguous in one buffer.
+    folly::Optional<folly::ByteRange> contiguousContent() const;
+
+    /// Returns the content as a (possibly chained) IOBuf sharing the buffers
+    /// of the metadata.
+    std::unique_ptr<folly::IOBuf> cloneContent() const;
+  };
+
+  explicit CompositeMetadataReader(const folly::IOBuf& metadata);
+
+  /// Advances to the next entry.  Returns false after the last entry, or if
+  /// the metadata is malformed, see malformed().
+  bool next();
+
+  /// The current entry.  Only valid after next() has returned true.
+  const Entry& entry() const {
+    return entry_;
+  }
+
+  /// Whether reading stopped at a truncated entry.
+  bool malformed() const {
+    return malformed_;
+  }
+
+  /// Returns the first entry with the given MIME type, which is valid as long
+  /// as the reader and the metadata are.  Starts from the current entry.
+  const Entry* find(WellKnownMimeType mimeTypeId);
+  const Entry* find(folly::StringPiece mimeType);
+
+ private:
+  folly::io::Cursor cursor_;
+  size_t remaining_;
+  Entry entry_;
+  bool malformed_{false};
+  std::array<char, 128> mimeTypeScratch_;
+};
+
+/**
+ * Reads the tags of routing metadata (message/x.rsocket.routing.v0) in place,
+ * either from a whole metadata buffer or from an entry of composite metadata.
+ *
+ * A tag that straddles two buffers of a chain is copied into the reader, so a
+ * tag is valid until the next call to next().
+ */
+class RoutingMetadataReader {
+ public:
+  explicit RoutingMetadataReader(const folly::IOBuf& metadata);
+  explicit RoutingMetadataReader(const CompositeMetadataReader::Entry& entry);
+
+  /// Advances to the next tag.  Returns false after the last tag, or if the
+  /// metadata is malformed, see malformed().
+  bool next();
+
+  folly::StringPiece tag() const {
+    return tag_;
+  }
+
+  bool malformed() const {
+    return malformed_;
+  }
+
+ private:
+  folly::io::Cursor cursor_;
+  size_t remaining_;
+  folly::StringPiece tag_;
+  bool malformed_{false};
+  std::array<char, 255> tagScratch_;
+};
+
+/**
+ * Builds composite metadata.  Well-known MIME types are encoded by their id,
+ * and the content of an entry is chained in without being copied.
+ *
+ * Throws std::invalid_argument for MIME type names that are empty or longer
+ * than 128 bytes, and for content of 16MB or more.
+ */
+class CompositeMetadataBuilder {
+ public:
+  CompositeMetadataBuilder& add(
+      folly::StringPiece mimeType,
+      std::unique_ptr<folly::IOBuf> content);
+  CompositeMetadataBuilder& add(
+      WellKnownMimeType mimeTypeId,
+      std::unique_ptr<folly::IOBuf> content);
+
+  /// Adds a routing entry with the given tags, the first of which is the
+  /// route.  Throws std::invalid_argument for empty tags or tags longer than
+  /// 255 bytes.
+  CompositeMetadataBuilder& addRouting(
+      std::initializer_list<folly::StringPiece> tags);
+
+  /// Returns the metadata, and resets the builder.
+  std::unique_ptr<folly::IOBuf> build();
+
+ private:
+  folly::IOBufQueue queue_{folly::IOBufQueue::cacheChainLength()};
+};
+
+} // namespace rsocket
@@ -14,12 +14,19 @@
 
 #pragma once
 
+#include <chrono>
+#include <functional>
 #include <memory>
+#include <vector>
 
 #include <folly/io/IOBuf.h>
 
 #include "yarpl/flowable/Subscriber.h"
 
+namespace folly {
+class EventBase;
+}
+
 namespace rsocket {
 
 /// Represents a connection of the underlying protocol, on top of which the
@@ -41,6 +48,20 @@ class DuplexConnection {
  public:
   using Subscriber = yarpl::flowable::Subscriber<std::unique_ptr<folly::IOBuf>>;
 
+  /// What the underlying protocol knows about the path to the peer.  Zero
+  /// stands for unknown.
+  struct TransportInfo {
+    /// Size of the send buffer of the socket.
+    size_t sendBufferSize{0};
+
+    /// Bytes the transport may have in flight, e.g. the TCP congestion
+    /// window.
+    size_t congestionWindow{0};
+
+    /// Smoothed round-trip time.
+    std::chrono::microseconds rtt{0};
+  };
+
   virtual ~DuplexConnection() = default;
 
   /// Sets a Subscriber that will consume received frames (a reader).
@@ -54,6 +75,74 @@ class DuplexConnection {
   /// Does nothing if the underlying connection is closed.
   virtual void send(std::unique_ptr<folly::IOBuf>) = 0;
 
+  /// Write several serialized frames to the connection, in order.
+  ///
+  /// Connections that can hand all of them to the underlying protocol in a
+  /// single write should override this.  By default, sends them one by one.
+  virtual void sendBatch(std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+    for (auto& frame : frames) {
+      send(std::move(frame));
+    }
+  }
+
+  /// Bytes read from the underlying protocol that the connection holds on to
+  /// because they don't form a complete frame yet.
+  virtual size_t bufferedInputBytes() const {
+    return 0;
+  }
+
+  /// Bytes handed to send() that the underlying protocol hasn't written out
+  /// yet, e.g. because the socket's send buffer is full.
+  virtual size_t bufferedOutputBytes() const {
+    return 0;
+  }
+
+  /// Sets a callback run every time the underlying protocol is done writing
+  /// out some of the bytes counted by bufferedOutputBytes(), so that a caller
+  /// which stopped sending can check whether to start again.  Runs on the
+  /// thread of the connection.  Connections that don't buffer output never
+  /// run it.
+  virtual void setOutputWrittenCallback(std::function<void()>) {}
+
+  /// Reads the conditions of the underlying protocol.  May take system
+  /// calls, so not meant for every frame.
+  virtual TransportInfo transportInfo() const {
+    return TransportInfo();
+  }
+
+  /// Whether the connection can move to another EventBase right now, see
+  /// detachEventBase().  Must be called on the current EventBase.
+  virtual bool isDetachable() const {
+    return false;
+  }
+
+  /// Stops using the current EventBase, without closing the connection.  No
+  /// method may be called until attachEventBase(), except from the new
+  /// EventBase.  Must be called on the current EventBase, and only if
+  /// isDetachable().
+  virtual void detachEventBase() {}
+
+  /// Resumes the connection on `eventBase` after detachEventBase().  Must be
+  /// called on `eventBase`.
+  virtual void attachEventBase(folly::EventBase&) {}
+
+  /// Whether the connection can end frames with checksums, see
+  /// FrameChecksums.  Safe to call from any thread.
+  virtual bool supportsFrameChecksums() const {
+    return false;
+  }
+
+  /// Adds a checksum trailer to every later frame sent, and checks and
+  /// strips the trailer of every later frame received.  Must be called
+  /// before the peer sends a frame with a trailer, and only if
+  /// supportsFrameChecksums().
+  virtual void enableFrameChecksums() {}
+
+  /// Hints at the typical length of the frames the peer sends, see
+  /// CapacityHints::payloadSize.  Connections that size their read buffers
+  /// may start from it, within their own bounds.
+  virtual void setReadBufferSizeHint(size_t) {}
+
   /// Whether the duplex connection respects frame boundaries.
   virtual bool isFramed() const {
     return false;
@@ -0,0 +1,302 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/FanoutStream.h"
+
+#include <folly/ExceptionWrapper.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "yarpl/utils/credits.h"
+
+namespace rsocket {
+
+using yarpl::flowable::Subscriber;
+
+/// The ring buffer and the cursors of the streams reading it, all guarded by
+/// `mutex`.
+class FanoutStream::State : public std::enable_shared_from_this<State> {
+ public:
+  State(size_t capacity, Overflow o) : ring(capacity), overflow{o} {
+    CHECK_GT(capacity, 0);
+  }
+
+  void subscribe(std::shared_ptr<Subscriber<Payload>> subscriber);
+
+  /// Called by the source, one item at a time.
+  void publish(Payload payload);
+
+  void terminate(folly::exception_wrapper ew);
+
+  /// Forgets a cursor that got cancelled or terminated.
+  void remove(const Cursor* cursor) {
+    auto it = std::find_if(
+        cursors.begin(), cursors.end(), [&](const auto& entry) {
+          return entry.get() == cursor;
+        });
+    if (it != cursors.end()) {
+      std::swap(*it, cursors.back());
+      cursors.pop_back();
+    }
+  }
+
+  mutable std::mutex mutex;
+  std::vector<Payload> ring;
+  /// Sequence number of the next item, whose slot is `head % ring.size()`.
+  uint64_t head{0};
+  const Overflow overflow;
+  bool terminated{false};
+  folly::exception_wrapper error;
+  std::vector<std::shared_ptr<Cursor>> cursors;
+
+ private:
+  /// Copy of `cursors` to drain once an item is in, kept around because
+  /// publish() is called for every item.
+  std::vector<std::shared_ptr<Cursor>> draining_;
+};
+
+/// The subscription of one stream, and its position in the ring.
+///
+/// Whoever finds the cursor not draining drains it: the source publishing,
+/// or the stream requesting more.  The others only leave a note to drain it
+/// once more, so that the subscriber is signalled by one thread at a time.
+class FanoutStream::Cursor : public yarpl::flowable::Subscription,
+                             public std::enable_shared_from_this<Cursor> {
+ public:
+  Cursor(
+      std::shared_ptr<State> state,
+      std::shared_ptr<Subscriber<Payload>> subscriber,
+      uint64_t next)
+      : state_{std::move(state)},
+        subscriber_{std::move(subscriber)},
+        next_{next} {}
+
+  /// Signals onSubscribe(), and then drains whatever came in meanwhile.
+  void start() {
+    subscriber_->onSubscribe(shared_from_this());
+    std::unique_lock<std::mutex> lock{state_->mutex};
+    drainLocked(lock);
+  }
+
+  void request(int64_t n) override {
+    std::unique_lock<std::mutex> lock{state_->mutex};
+    credits_ = yarpl::credits::add(credits_, n);
+    drainOrDefer(lock);
+  }
+
+  void cancel() override {
+    cancelled_ = true;
+    std::lock_guard<std::mutex> lock{state_->mutex};
+    state_->remove(this);
+  }
+
+  void drain() {
+    std::unique_lock<std::mutex> lock{state_->mutex};
+    drainOrDefer(lock);
+  }
+
+ private:
+  void drainOrDefer(std::unique_lock<std::mutex>& lock) {
+    if (draining_) {
+      redrain_ = true;
+      return;
+    }
+    draining_ = true;
+    drainLocked(lock);
+  }
+
+  void drainLocked(std::unique_lock<std::mutex>& lock) {
+    do {
+      redrain_ = false;
+      if (cancelled_) {
+        break;
+      }
+
+      collect();
+      auto const terminal = state_->terminated && next_ >= state_->head;
+      folly::exception_wrapper error;
+      if (terminal) {
+        error = state_->error;
+        state_->remove(this);
+      }
+      lock.unlock();
+
+      for (auto& payload : batch_) {
+        if (cancelled_) {
+          break;
+        }
+        subscriber_->onNext(std::move(payload));
+      }
+      batch_.clear();
+
+      if (terminal) {
+        // The cursor stays draining for good, nobody signals it anymore.
+        auto subscriber = std::move(subscriber_);
+        if (!cancelled_.exchange(true)) {
+          if (error) {
+            subscriber->onError(std::move(error));
+          } else {
+            subscriber->onComplete();
+          }
+        }
+        return;
+      }
+      lock.lock();
+    } while (redrain_);
+    draining_ = false;
+  }
+
+  /// Takes the items the credits allow, and applies the overflow policy to
+  /// the ones they don't.
+  void collect() {
+    auto const head = state_->head;
+    auto const capacity = state_->ring.size();
+    if (head - next_ > capacity) {
+      next_ = head - capacity;
+    }
+    while (credits_ > 0 && next_ < head) {
+      batch_.push_back(state_->ring[next_ % capacity].clone());
+      ++next_;
+      yarpl::credits::consume(credits_, 1);
+    }
+    if (credits_ == 0 && next_ < head) {
+      next_ = state_->overflow == Overflow::Drop ? head : head - 1;
+    }
+  }
+
+  const std::shared_ptr<State> state_;
+  std::atomic<bool> cancelled_{false};
+
+  // Guarded by the mutex of the state.
+  uint64_t next_;
+  int64_t credits_{0};
+  /// start() holds the cursor until onSubscribe() returned.
+  bool draining_{true};
+  bool redrain_{false};
+
+  // Only touched while draining.
+  std::shared_ptr<Subscriber<Payload>> subscriber_;
+  std::vector<Payload> batch_;
+};
+
+class FanoutStream::Stream : public yarpl::flowable::Flowable<Payload> {
+ public:
+  explicit Stream(std::shared_ptr<State> state) : state_{std::move(state)} {}
+
+  void subscribe(std::shared_ptr<Subscriber<Payload>> subscriber) override {
+    state_->subscribe(std::move(subscriber));
+  }
+
+ private:
+  const std::shared_ptr<State> state_;
+};
+
+class FanoutStream::SourceObserver
+    : public yarpl::observable::Observer<Payload> {
+ public:
+  explicit SourceObserver(std::shared_ptr<State> state)
+      : state_{std::move(state)} {}
+
+  void onNext(Payload payload) override {
+    state_->publish(std::move(payload));
+  }
+
+  void onComplete() override {
+    Observer::onComplete();
+    state_->terminate(folly::exception_wrapper());
+  }
+
+  void onError(folly::exception_wrapper ew) override {
+    Observer::onError(ew);
+    state_->terminate(std::move(ew));
+  }
+
+ private:
+  const std::shared_ptr<State> state_;
+};
+
+void FanoutStream::State::subscribe(
+    std::shared_ptr<Subscriber<Payload>> subscriber) {
+  std::shared_ptr<Cursor> cursor;
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    cursor = std::make_shared<Cursor>(
+        shared_from_this(), std::move(subscriber), head);
+    if (!terminated) {
+      cursors.push_back(cursor);
+    }
+  }
+  cursor->start();
+}
+
+void FanoutStream::State::publish(Payload payload) {
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    if (terminated) {
+      return;
+    }
+    ring[head % ring.size()] = std::move(payload);
+    ++head;
+    draining_ = cursors;
+  }
+  for (auto& cursor : draining_) {
+    cursor->drain();
+  }
+  draining_.clear();
+}
+
+void FanoutStream::State::terminate(folly::exception_wrapper ew) {
+  std::vector<std::shared_ptr<Cursor>> toDrain;
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    if (terminated) {
+      return;
+    }
+    terminated = true;
+    error = std::move(ew);
+    toDrain = cursors;
+  }
+  for (auto& cursor : toDrain) {
+    cursor->drain();
+  }
+}
+
+FanoutStream::FanoutStream(
+    std::shared_ptr<yarpl::observable::Observable<Payload>> source,
+    size_t capacity,
+    Overflow overflow)
+    : state_{std::make_shared<State>(capacity, overflow)} {
+  subscription_ = source->subscribe(std::make_shared<SourceObserver>(state_));
+}
+
+FanoutStream::~FanoutStream() {
+  if (subscription_) {
+    subscription_->cancel();
+  }
+  state_->terminate(folly::exception_wrapper());
+}
+
+std::shared_ptr<yarpl::flowable::Flowable<Payload>> FanoutStream::stream() {
+  return std::make_shared<Stream>(state_);
+}
+
+size_t FanoutStream::streams() const {
+  std::lock_guard<std::mutex> lock{state_->mutex};
+  return state_->cursors.size();
+}
+
+} // namespace rsocket
@@ -0,0 +1,80 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+
+#include "rsocket/Payload.h"
+#include "yarpl/Flowable.h"
+#include "yarpl/Observable.h"
+
+namespace rsocket {
+
+/**
+ * Serves a hot Observable of payloads, e.g. market data, to any number of
+ * streams.
+ *
+ * The fanout subscribes to the source once, and keeps its last `capacity`
+ * items in a ring buffer shared by all the streams.  Each stream only has a
+ * cursor into the ring, and receives clones of the payloads, which share
+ * their buffers.  A stream starts with the items the source emits after it
+ * subscribed.
+ *
+ * A stream that runs out of REQUEST_N credits doesn't hold the others back:
+ * with Overflow::Drop it misses the items emitted until it requests more,
+ * with Overflow::Conflate it gets the latest of them once it does.  A stream
+ * that has credits but falls more than `capacity` items behind misses the
+ * ones that were overwritten.
+ *
+ * The streams complete or fail when the source does, and complete when the
+ * fanout is destroyed.  An instance can be shared by connections on
+ * different threads.  Items are delivered on the thread the source emits
+ * them on, or on the thread requesting more of them.
+ */
+class FanoutStream {
+ public:
+  enum class Overflow {
+    Drop,
+    Conflate,
+  };
+
+  explicit FanoutStream(
+      std::shared_ptr<yarpl::observable::Observable<Payload>> source,
+      size_t capacity = 1024,
+      Overflow overflow = Overflow::Drop);
+  ~FanoutStream();
+
+  FanoutStream(const FanoutStream&) = delete;
+  FanoutStream& operator=(const FanoutStream&) = delete;
+
+  /// Returns a Flowable for one more stream, e.g. the result of
+  /// RSocketResponder::handleRequestStream().  Every subscriber to it is a
+  /// stream of its own.
+  std::shared_ptr<yarpl::flowable::Flowable<Payload>> stream();
+
+  /// Number of streams subscribed right now.
+  size_t streams() const;
+
+ private:
+  class Cursor;
+  class Stream;
+  class State;
+  class SourceObserver;
+
+  const std::shared_ptr<State> state_;
+  std::shared_ptr<yarpl::observable::Subscription> subscription_;
+};
+
+} // namespace rsocket
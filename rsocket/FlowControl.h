@@ -0,0 +1,95 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+#include "rsocket/internal/Common.h"
+
+namespace rsocket {
+
+/// Flow control state of one stream, to tell what a stalled stream is
+/// waiting for.  See RSocketStateMachine::flowControl().
+struct StreamFlowControl {
+  StreamId streamId{0};
+
+  /// Time since the stream was opened.
+  std::chrono::microseconds age{0};
+
+  /// Whether the stream receives a stream of payloads from the peer, and so
+  /// has the consumer figures below.
+  bool consumer{false};
+
+  /// Payloads the local subscriber asked for that haven't arrived yet.  When
+  /// zero, the stream waits for the subscriber to request more.
+  size_t consumerAllowance{0};
+
+  /// Part of consumerAllowance not yet sent to the peer in REQUEST_N frames.
+  size_t consumerPendingAllowance{0};
+
+  /// Bytes the peer may still send, with byte-based flow control.
+  size_t consumerByteCredit{0};
+
+  /// Whether the stream sends a stream of payloads to the peer, and so has
+  /// the publisher figures below.
+  bool publisher{false};
+
+  /// Payloads the peer asked for that haven't been sent yet.  When zero, the
+  /// stream waits for the peer to request more.
+  size_t publisherAllowance{0};
+
+  /// Part of publisherAllowance not yet passed on to the local producer,
+  /// because it hasn't subscribed yet, the connection's output is paused or
+  /// the byte credit is used up.
+  size_t publisherHeldBack{0};
+
+  /// Bytes the stream may still send, with byte-based flow control.  When
+  /// zero, the stream waits for the peer to grant more.
+  size_t publisherByteCredit{0};
+
+  /// Frames of the stream queued in the output scheduler, if there is one.
+  size_t queuedBytes{0};
+
+  /// Fragments of a payload of the stream that is being reassembled.
+  size_t reassemblyBytes{0};
+};
+
+/// Flow control state of a connection and its streams.
+struct ConnectionFlowControl {
+  /// Frames held back by the connection, either because it can't send them
+  /// (e.g. while resuming) or by the output scheduler.
+  size_t pendingOutputBytes{0};
+
+  /// Whether the connection holds back output because too many frames are
+  /// pending, which pauses the producers of its streams.
+  bool outputPaused{false};
+
+  /// Bytes handed to the transport that it hasn't written out yet.  Only
+  /// known when the transport runs on the thread of the connection.
+  size_t transportOutputBytes{0};
+
+  /// Whether the transport buffers so many bytes that the producers of the
+  /// streams are paused, see TransportOutputOptions.
+  bool transportOutputPaused{false};
+
+  /// Sent frames kept by the ResumeManager to replay on resumption.
+  size_t resumeBufferBytes{0};
+
+  std::vector<StreamFlowControl> streams;
+};
+
+} // namespace rsocket
@@ -0,0 +1,153 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/FrameCapture.h"
+
+#include <folly/String.h>
+#include <folly/io/Cursor.h>
+
+#include <algorithm>
+#include <ostream>
+
+#include "rsocket/framing/FrameSerializer.h"
+
+namespace rsocket {
+
+namespace {
+
+template <typename FrameT>
+bool printAs(
+    std::ostream& os,
+    const FrameSerializer& serializer,
+    std::unique_ptr<folly::IOBuf> buf) {
+  FrameT frame;
+  if (!serializer.deserializeFrom(frame, std::move(buf))) {
+    return false;
+  }
+  os << frame;
+  return true;
+}
+
+/// Prints a complete frame the way the frame logs do.  Returns false if the
+/// frame cannot be decoded.
+bool printFrame(
+    std::ostream& os,
+    const FrameSerializer& serializer,
+    std::unique_ptr<folly::IOBuf> buf) {
+  switch (serializer.peekFrameType(*buf)) {
+    case FrameType::REQUEST_STREAM:
+      return printAs<Frame_REQUEST_STREAM>(os, serializer, std::move(buf));
+    case FrameType::REQUEST_CHANNEL:
+      return printAs<Frame_REQUEST_CHANNEL>(os, serializer, std::move(buf));
+    case FrameType::REQUEST_RESPONSE:
+      return printAs<Frame_REQUEST_RESPONSE>(os, serializer, std::move(buf));
+    case FrameType::REQUEST_FNF:
+      return printAs<Frame_REQUEST_FNF>(os, serializer, std::move(buf));
+    case FrameType::REQUEST_N:
+      return printAs<Frame_REQUEST_N>(os, serializer, std::move(buf));
+    case FrameType::METADATA_PUSH:
+      return printAs<Frame_METADATA_PUSH>(os, serializer, std::move(buf));
+    case FrameType::CANCEL:
+      return printAs<Frame_CANCEL>(os, serializer, std::move(buf));
+    case FrameType::PAYLOAD:
+      return printAs<Frame_PAYLOAD>(os, serializer, std::move(buf));
+    case FrameType::ERROR:
+      return printAs<Frame_ERROR>(os, serializer, std::move(buf));
+    case FrameType::KEEPALIVE:
+      return printAs<Frame_KEEPALIVE>(os, serializer, std::move(buf));
+    case FrameType::SETUP:
+      return printAs<Frame_SETUP>(os, serializer, std::move(buf));
+    case FrameType::LEASE:
+      return printAs<Frame_LEASE>(os, serializer, std::move(buf));
+    case FrameType::RESUME:
+      return printAs<Frame_RESUME>(os, serializer, std::move(buf));
+    case FrameType::RESUME_OK:
+      return printAs<Frame_RESUME_OK>(os, serializer, std::move(buf));
+    case FrameType::EXT:
+      return printAs<Frame_EXT>(os, serializer, std::move(buf));
+    case FrameType::RESERVED:
+    default:
+      return false;
+  }
+}
+
+} // namespace
+
+FrameCapture::FrameCapture(Options options)
+    : options_{std::move(options)},
+      ring_(std::max<size_t>(options_.maxFrames, 1)) {
+  for (auto& record : ring_) {
+    record.bytes.reserve(options_.maxBytesPerFrame);
+  }
+}
+
+void FrameCapture::record(Direction direction, const folly::IOBuf& frame) {
+  const auto time = std::chrono::system_clock::now();
+  const auto length = frame.computeChainDataLength();
+
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto& record = ring_[recorded_++ % ring_.size()];
+  record.time = time;
+  record.direction = direction;
+  record.length = static_cast<uint32_t>(length);
+
+  // Stays within the capacity reserved up front.
+  record.bytes.resize(std::min(length, options_.maxBytesPerFrame));
+  folly::io::Cursor cursor{&frame};
+  cursor.pull(&record.bytes[0], record.bytes.size());
+}
+
+std::vector<FrameCapture::Record> FrameCapture::snapshot() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  const auto size = std::min<uint64_t>(recorded_, ring_.size());
+  std::vector<Record> records;
+  records.reserve(size);
+  for (auto i = recorded_ - size; i < recorded_; ++i) {
+    records.push_back(ring_[i % ring_.size()]);
+  }
+  return records;
+}
+
+uint64_t FrameCapture::recorded() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return recorded_;
+}
+
+void FrameCapture::print(
+    std::ostream& os,
+    const std::vector<Record>& records) {
+  const auto& serializer =
+      *FrameSerializer::shared(ProtocolVersion::Latest, false);
+  for (const auto& record : records) {
+    os << record.direction << ' ';
+    const auto buf =
+        folly::IOBuf::wrapBuffer(record.bytes.data(), record.bytes.size());
+    if (record.truncated() || !printFrame(os, serializer, buf->clone())) {
+      if (const auto decoded = serializer.decodeFrameHeader(*buf)) {
+        os << decoded->header << ' ';
+      }
+      os << "<" << record.length << " bytes> " << folly::hexlify(record.bytes);
+      if (record.truncated()) {
+        os << "...";
+      }
+    }
+    os << '\n';
+  }
+}
+
+std::ostream& operator<<(std::ostream& os, FrameCapture::Direction direction) {
+  return os << (direction == FrameCapture::Direction::IN ? "IN " : "OUT");
+}
+
+} // namespace rsocket
@@ -0,0 +1,95 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/io/IOBuf.h>
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace rsocket {
+
+/**
+ * Captures the frames of a connection into a bounded ring, to be formatted
+ * offline.
+ *
+ * Formatting a frame for a log line costs far more than reading or writing
+ * it, so instead a capture only copies the first bytes of each frame into a
+ * slot of the ring, which is allocated up front.  Connections without a
+ * capture only pay for a null check per frame.  print() decodes the frames
+ * of a snapshot into the same text the frame logs use.
+ *
+ * A capture is meant to be set on a sample of the connections, see
+ * RSocketConnectionParams::frameCapture.  record() is called on the thread of
+ * the connection, snapshot() may be called from any thread.
+ */
+class FrameCapture {
+ public:
+  struct Options {
+    /// Frames kept in the ring.  The oldest frames are overwritten first.
+    size_t maxFrames{1024};
+
+    /// Bytes kept of each frame.  Frames longer than this are printed with
+    /// their header only.
+    size_t maxBytesPerFrame{256};
+  };
+
+  enum class Direction : uint8_t { IN, OUT };
+
+  struct Record {
+    std::chrono::system_clock::time_point time;
+    Direction direction{Direction::IN};
+
+    /// Length of the whole frame, which may be longer than `bytes`.
+    uint32_t length{0};
+    std::string bytes;
+
+    bool truncated() const {
+      return bytes.size() < length;
+    }
+  };
+
+  explicit FrameCapture(Options options = Options());
+
+  /// Copies the first bytes of a frame, without its frame length field, into
+  /// the ring.  Does not allocate.
+  void record(Direction direction, const folly::IOBuf& frame);
+
+  /// Returns the frames in the ring, oldest first.
+  std::vector<Record> snapshot() const;
+
+  /// Frames recorded so far, including the ones overwritten since.
+  uint64_t recorded() const;
+
+  /// Writes one line per frame, e.g. "IN  Frame_CANCEL(...)".  Frames that
+  /// were truncated or cannot be decoded are printed as their header and a
+  /// hex dump of their bytes.
+  static void print(std::ostream& os, const std::vector<Record>& records);
+
+ private:
+  const Options options_;
+
+  mutable std::mutex mutex_;
+  std::vector<Record> ring_;
+  uint64_t recorded_{0};
+};
+
+std::ostream& operator<<(std::ostream&, FrameCapture::Direction);
+
+} // namespace rsocket
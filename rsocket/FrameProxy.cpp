@@ -0,0 +1,524 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/FrameProxy.h"
+
+#include <glog/logging.h>
+
+#include <limits>
+
+#include "rsocket/framing/FrameProcessor.h"
+#include "rsocket/framing/FrameSerializer.h"
+#include "rsocket/framing/FrameTransportImpl.h"
+#include "rsocket/framing/FramedDuplexConnection.h"
+
+namespace rsocket {
+
+namespace {
+
+constexpr StreamId kMaxStreamId = std::numeric_limits<int32_t>::max();
+
+bool isLastFragment(FrameFlags flags) {
+  return !(flags & FrameFlags::FOLLOWS);
+}
+
+bool completes(FrameFlags flags) {
+  return !!(flags & FrameFlags::COMPLETE) && isLastFragment(flags);
+}
+
+folly::Optional<StreamType> requestStreamType(FrameType type) {
+  switch (type) {
+    case FrameType::REQUEST_RESPONSE:
+      return StreamType::REQUEST_RESPONSE;
+    case FrameType::REQUEST_STREAM:
+      return StreamType::STREAM;
+    case FrameType::REQUEST_CHANNEL:
+      return StreamType::CHANNEL;
+    case FrameType::REQUEST_FNF:
+      return StreamType::FNF;
+    default:
+      return folly::none;
+  }
+}
+
+} // namespace
+
+constexpr uint64_t FrameProxy::kBackendId;
+
+/// Hands the frames and the termination of one connection to the proxy.
+class FrameProxy::Leg : public FrameProcessor {
+ public:
+  Leg(std::weak_ptr<FrameProxy> proxy, uint64_t legId)
+      : proxy_(std::move(proxy)), legId_(legId) {}
+
+  void processFrame(std::unique_ptr<folly::IOBuf> frame) override {
+    if (auto proxy = proxy_.lock()) {
+      proxy->onFrame(legId_, std::move(frame));
+    }
+  }
+
+  void onTerminal(folly::exception_wrapper ex) override {
+    VLOG(3) << "Proxy connection " << legId_ << " terminated: " << ex.what();
+    if (auto proxy = proxy_.lock()) {
+      proxy->onTerminal(legId_);
+    }
+  }
+
+ private:
+  const std::weak_ptr<FrameProxy> proxy_;
+  const uint64_t legId_;
+};
+
+std::shared_ptr<FrameProxy> FrameProxy::create(
+    std::unique_ptr<DuplexConnection> backend,
+    SetupParameters setup) {
+  auto const version = setup.protocolVersion == ProtocolVersion::Unknown
+      ? ProtocolVersion::Latest
+      : setup.protocolVersion;
+  auto proxy = std::shared_ptr<FrameProxy>(new FrameProxy(version, setup));
+  proxy->start(std::move(backend), std::move(setup));
+  return proxy;
+}
+
+FrameProxy::FrameProxy(ProtocolVersion version, SetupParameters& setup)
+    : version_(version),
+      metadataMimeType_(setup.metadataMimeType),
+      dataMimeType_(setup.dataMimeType),
+      serializer_(FrameSerializer::shared(version, true)) {
+  CHECK(serializer_) << "Unsupported protocol version " << version;
+}
+
+FrameProxy::~FrameProxy() {
+  closeAll("Proxy is gone");
+}
+
+void FrameProxy::start(
+    std::unique_ptr<DuplexConnection> backend,
+    SetupParameters setup) {
+  backend_ = std::make_shared<FrameTransportImpl>(framed(std::move(backend)));
+
+  Frame_SETUP frame(
+      FrameFlags::EMPTY_,
+      version_.major,
+      version_.minor,
+      Frame_SETUP::kMaxKeepaliveTime,
+      Frame_SETUP::kMaxLifetime,
+      setup.token,
+      std::move(setup.metadataMimeType),
+      std::move(setup.dataMimeType),
+      std::move(setup.payload));
+  VLOG(3) << "Proxy out: " << frame;
+  backend_->outputFrameOrDrop(serializer_->serializeOut(std::move(frame)));
+
+  backend_->setFrameProcessor(
+      std::make_shared<Leg>(shared_from_this(), kBackendId));
+}
+
+std::unique_ptr<DuplexConnection> FrameProxy::framed(
+    std::unique_ptr<DuplexConnection> connection) {
+  if (connection->isFramed()) {
+    return connection;
+  }
+  return std::make_unique<FramedDuplexConnection>(
+      std::move(connection), version_);
+}
+
+void FrameProxy::addEdge(std::unique_ptr<DuplexConnection> connection) {
+  if (closed_) {
+    return;
+  }
+
+  auto const edgeId = nextEdgeId_++;
+  auto edge = std::make_unique<Edge>();
+  edge->transport =
+      std::make_shared<FrameTransportImpl>(framed(std::move(connection)));
+  auto transport = edge->transport;
+  edges_.emplace(edgeId, std::move(edge));
+
+  // May deliver frames in-line.
+  transport->setFrameProcessor(
+      std::make_shared<Leg>(shared_from_this(), edgeId));
+}
+
+void FrameProxy::close() {
+  closeAll("Proxy is closing");
+}
+
+void FrameProxy::onFrame(
+    uint64_t legId,
+    std::unique_ptr<folly::IOBuf> frame) {
+  if (legId == kBackendId) {
+    onBackendFrame(std::move(frame));
+  } else {
+    onEdgeFrame(legId, std::move(frame));
+  }
+}
+
+void FrameProxy::onTerminal(uint64_t legId) {
+  if (legId == kBackendId) {
+    closeAll("Backend connection closed");
+  } else {
+    closeEdge(legId, folly::none);
+  }
+}
+
+void FrameProxy::onEdgeFrame(
+    uint64_t edgeId,
+    std::unique_ptr<folly::IOBuf> frame) {
+  auto it = edges_.find(edgeId);
+  if (it == edges_.end()) {
+    return;
+  }
+  auto& edge = *it->second;
+
+  auto const decoded = serializer_->decodeFrameHeader(*frame);
+  if (!decoded) {
+    closeEdge(edgeId, Frame_ERROR::connectionError("Invalid frame header"));
+    return;
+  }
+  auto const& header = decoded->header;
+
+  if (!edge.setUp) {
+    onEdgeSetup(edgeId, edge, header, std::move(frame));
+    return;
+  }
+  if (header.streamId == 0) {
+    onEdgeConnectionFrame(edgeId, edge, header, std::move(frame));
+    return;
+  }
+
+  switch (header.type) {
+    case FrameType::REQUEST_RESPONSE:
+    case FrameType::REQUEST_STREAM:
+    case FrameType::REQUEST_CHANNEL:
+    case FrameType::REQUEST_FNF:
+      openStream(edgeId, edge, header, std::move(frame));
+      return;
+    case FrameType::PAYLOAD:
+    case FrameType::REQUEST_N:
+    case FrameType::CANCEL:
+    case FrameType::ERROR:
+      forwardToBackend(edge, header, std::move(frame));
+      return;
+    default:
+      VLOG(2) << "Proxy dropping " << header.type << " frame of edge stream "
+              << header.streamId;
+      return;
+  }
+}
+
+void FrameProxy::onEdgeSetup(
+    uint64_t edgeId,
+    Edge& edge,
+    const FrameHeader& header,
+    std::unique_ptr<folly::IOBuf> frame) {
+  if (header.type == FrameType::RESUME) {
+    closeEdge(
+        edgeId,
+        Frame_ERROR::rejectedResume("The proxy doesn't resume connections"));
+    return;
+  }
+
+  Frame_SETUP setup;
+  if (header.type != FrameType::SETUP ||
+      !serializer_->deserializeFrom(setup, std::move(frame))) {
+    closeEdge(edgeId, Frame_ERROR::invalidSetup("Expected a SETUP frame"));
+    return;
+  }
+  VLOG(3) << "Proxy in: " << setup;
+
+  if (ProtocolVersion(setup.versionMajor_, setup.versionMinor_) != version_ ||
+      setup.metadataMimeType_ != metadataMimeType_ ||
+      setup.dataMimeType_ != dataMimeType_) {
+    closeEdge(
+        edgeId,
+        Frame_ERROR::unsupportedSetup(
+            "Protocol version or MIME types don't match the backend's"));
+    return;
+  }
+  if (!!(setup.header_.flags &
+         (FrameFlags::RESUME_ENABLE | FrameFlags::LEASE))) {
+    closeEdge(
+        edgeId,
+        Frame_ERROR::unsupportedSetup(
+            "The proxy doesn't support resumption or leases"));
+    return;
+  }
+  edge.setUp = true;
+}
+
+void FrameProxy::onEdgeConnectionFrame(
+    uint64_t edgeId,
+    Edge& edge,
+    const FrameHeader& header,
+    std::unique_ptr<folly::IOBuf> frame) {
+  switch (header.type) {
+    case FrameType::KEEPALIVE:
+      if (!!(header.flags & FrameFlags::KEEPALIVE_RESPOND)) {
+        answerKeepalive(*edge.transport, std::move(frame));
+      }
+      return;
+    case FrameType::METADATA_PUSH:
+      backend_->outputFrameOrDrop(std::move(frame));
+      return;
+    case FrameType::ERROR:
+      closeEdge(edgeId, folly::none);
+      return;
+    default:
+      VLOG(2) << "Proxy dropping " << header.type << " frame of edge "
+              << edgeId;
+      return;
+  }
+}
+
+void FrameProxy::openStream(
+    uint64_t edgeId,
+    Edge& edge,
+    const FrameHeader& header,
+    std::unique_ptr<folly::IOBuf> frame) {
+  auto const type = *requestStreamType(header.type);
+
+  if (edge.streams.contains(header.streamId)) {
+    closeEdge(edgeId, Frame_ERROR::connectionError("Stream id reused"));
+    return;
+  }
+  if (nextStreamId_ > kMaxStreamId) {
+    if (type != StreamType::FNF) {
+      edge.transport->outputFrameOrDrop(serializer_->serializeOut(
+          Frame_ERROR::rejected(header.streamId, "Out of stream ids")));
+    }
+    return;
+  }
+
+  auto const backendStreamId = nextStreamId_;
+  nextStreamId_ += 2;
+
+  if (type != StreamType::FNF) {
+    Route route;
+    route.edgeId = edgeId;
+    route.edgeStreamId = header.streamId;
+    route.type = type;
+    // Only a channel has payloads going up, after the request.
+    route.upDone = type != StreamType::CHANNEL || completes(header.flags);
+    routes_.emplace(backendStreamId, route);
+    edge.streams.emplace(header.streamId, backendStreamId);
+  }
+
+  backend_->outputFrameOrDrop(
+      serializer_->rewriteStreamId(std::move(frame), backendStreamId));
+}
+
+void FrameProxy::forwardToBackend(
+    Edge& edge,
+    const FrameHeader& header,
+    std::unique_ptr<folly::IOBuf> frame) {
+  auto const backendStreamId = edge.streams.find(header.streamId);
+  if (!backendStreamId) {
+    VLOG(3) << "Proxy dropping " << header.type << " frame of unknown stream "
+            << header.streamId;
+    return;
+  }
+  auto const streamId = *backendStreamId;
+  auto route = routes_.find(streamId);
+  DCHECK(route);
+
+  switch (header.type) {
+    case FrameType::PAYLOAD:
+      route->upDone = route->upDone || completes(header.flags);
+      break;
+    case FrameType::CANCEL:
+      route->downDone = true;
+      break;
+    case FrameType::ERROR:
+      route->upDone = true;
+      route->downDone = true;
+      break;
+    default:
+      break;
+  }
+
+  backend_->outputFrameOrDrop(
+      serializer_->rewriteStreamId(std::move(frame), streamId));
+  finishIfDone(streamId, *route);
+}
+
+void FrameProxy::onBackendFrame(std::unique_ptr<folly::IOBuf> frame) {
+  auto const decoded = serializer_->decodeFrameHeader(*frame);
+  if (!decoded) {
+    backend_->outputFrameOrDrop(serializer_->serializeOut(
+        Frame_ERROR::connectionError("Invalid frame header")));
+    closeAll("Backend sent an invalid frame");
+    return;
+  }
+  auto const& header = decoded->header;
+
+  if (header.streamId == 0) {
+    onBackendConnectionFrame(header, std::move(frame));
+    return;
+  }
+
+  switch (header.type) {
+    case FrameType::REQUEST_RESPONSE:
+    case FrameType::REQUEST_STREAM:
+    case FrameType::REQUEST_CHANNEL:
+      backend_->outputFrameOrDrop(serializer_->serializeOut(
+          Frame_ERROR::rejected(
+              header.streamId, "The proxy doesn't accept requests")));
+      return;
+    case FrameType::PAYLOAD:
+    case FrameType::REQUEST_N:
+    case FrameType::CANCEL:
+    case FrameType::ERROR:
+      forwardToEdge(header, std::move(frame));
+      return;
+    default:
+      VLOG(2) << "Proxy dropping " << header.type
+              << " frame of backend stream " << header.streamId;
+      return;
+  }
+}
+
+void FrameProxy::onBackendConnectionFrame(
+    const FrameHeader& header,
+    std::unique_ptr<folly::IOBuf> frame) {
+  switch (header.type) {
+    case FrameType::KEEPALIVE:
+      if (!!(header.flags & FrameFlags::KEEPALIVE_RESPOND)) {
+        answerKeepalive(*backend_, std::move(frame));
+      }
+      return;
+    case FrameType::ERROR:
+      closeAll("Backend connection failed");
+      return;
+    default:
+      VLOG(2) << "Proxy dropping " << header.type << " frame of backend";
+      return;
+  }
+}
+
+void FrameProxy::forwardToEdge(
+    const FrameHeader& header,
+    std::unique_ptr<folly::IOBuf> frame) {
+  auto route = routes_.find(header.streamId);
+  if (!route) {
+    VLOG(3) << "Proxy dropping " << header.type << " frame of unknown stream "
+            << header.streamId;
+    return;
+  }
+
+  switch (header.type) {
+    case FrameType::PAYLOAD:
+      // The first complete payload is the whole response.
+      route->downDone = route->downDone ||
+          (route->type == StreamType::REQUEST_RESPONSE
+               ? isLastFragment(header.flags)
+               : completes(header.flags));
+      break;
+    case FrameType::CANCEL:
+      route->upDone = true;
+      break;
+    case FrameType::ERROR:
+      route->upDone = true;
+      route->downDone = true;
+      break;
+    default:
+      break;
+  }
+
+  auto it = edges_.find(route->edgeId);
+  DCHECK(it != edges_.end());
+  it->second->transport->outputFrameOrDrop(
+      serializer_->rewriteStreamId(std::move(frame), route->edgeStreamId));
+  finishIfDone(header.streamId, *route);
+}
+
+void FrameProxy::answerKeepalive(
+    FrameTransportImpl& transport,
+    std::unique_ptr<folly::IOBuf> frame) {
+  Frame_KEEPALIVE keepalive;
+  if (!serializer_->deserializeFrom(keepalive, std::move(frame))) {
+    return;
+  }
+  // The proxy doesn't resume, so it has no position to report.
+  transport.outputFrameOrDrop(serializer_->serializeOut(
+      Frame_KEEPALIVE(FrameFlags::EMPTY_, 0, std::move(keepalive.data_))));
+}
+
+void FrameProxy::finishIfDone(StreamId backendStreamId, const Route& route) {
+  if (!route.upDone || !route.downDone) {
+    return;
+  }
+  auto it = edges_.find(route.edgeId);
+  if (it != edges_.end()) {
+    it->second->streams.erase(route.edgeStreamId);
+  }
+  routes_.erase(backendStreamId);
+}
+
+void FrameProxy::closeEdge(
+    uint64_t edgeId,
+    folly::Optional<Frame_ERROR> error) {
+  auto it = edges_.find(edgeId);
+  if (it == edges_.end()) {
+    return;
+  }
+  auto edge = std::move(it->second);
+  edges_.erase(it);
+
+  // Terminate what the backend still has going on the streams of the edge.
+  edge->streams.forEach([&](StreamId, StreamId backendStreamId) {
+    auto route = routes_.find(backendStreamId);
+    if (!route) {
+      return;
+    }
+    if (!route->upDone) {
+      backend_->outputFrameOrDrop(serializer_->serializeOut(
+          Frame_ERROR::canceled(backendStreamId, "Edge connection closed")));
+    } else if (!route->downDone) {
+      backend_->outputFrameOrDrop(
+          serializer_->serializeOut(Frame_CANCEL(backendStreamId)));
+    }
+    routes_.erase(backendStreamId);
+  });
+
+  if (error) {
+    VLOG(3) << "Proxy out: " << *error;
+    edge->transport->outputFrameOrDrop(
+        serializer_->serializeOut(std::move(*error)));
+  }
+  edge->transport->close();
+}
+
+void FrameProxy::closeAll(folly::StringPiece reason) {
+  if (closed_) {
+    return;
+  }
+  closed_ = true;
+
+  routes_.extractAll();
+  if (auto backend = std::move(backend_)) {
+    backend->close();
+  }
+
+  auto edges = std::move(edges_);
+  edges_.clear();
+  for (auto& entry : edges) {
+    auto& transport = *entry.second->transport;
+    transport.outputFrameOrDrop(
+        serializer_->serializeOut(Frame_ERROR::connectionError(reason)));
+    transport.close();
+  }
+}
+
+} // namespace rsocket
@@ -0,0 +1,177 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Optional.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "rsocket/DuplexConnection.h"
+#include "rsocket/RSocketParameters.h"
+#include "rsocket/framing/Frame.h"
+#include "rsocket/internal/Common.h"
+#include "rsocket/internal/StreamTable.h"
+
+namespace rsocket {
+
+class FrameSerializer;
+class FrameTransportImpl;
+
+/**
+ * Forwards the streams of connections accepted from edge clients to a single
+ * backend connection, frame by frame.
+ *
+ * The proxy connects to the backend as a client, and maps every stream an
+ * edge opens to a stream id of its own on the backend connection.  Frames of
+ * a stream are forwarded with only the stream id in their header rewritten,
+ * so the proxy neither decodes payloads nor runs a Flowable per stream.
+ * REQUEST_N frames are forwarded as they are, so flow control runs end to
+ * end between the edge client and the backend.
+ *
+ * Edges must set up their connection with the protocol version and MIME types
+ * the proxy was created with, and without resumption or leases, which the
+ * proxy doesn't support.  The SETUP frames of the edges are not forwarded.
+ * The proxy answers keepalives itself, forwards METADATA_PUSH frames of the
+ * edges to the backend, and rejects requests from the backend.
+ *
+ * Not thread-safe: the connections must all live on the same EventBase, and
+ * the proxy must only be used from it.
+ */
+class FrameProxy : public std::enable_shared_from_this<FrameProxy> {
+ public:
+  /// Sends a SETUP frame on the backend connection, with the MIME types,
+  /// payload and protocol version of `setup`.  Resumption, leases, payload
+  /// compression and byte credit are not negotiated by the proxy, a backend
+  /// which needs them is given the MIME types the edges use.
+  static std::shared_ptr<FrameProxy> create(
+      std::unique_ptr<DuplexConnection> backend,
+      SetupParameters setup);
+
+  ~FrameProxy();
+
+  /// Starts forwarding the streams of a connection accepted from an edge.
+  /// Does nothing but drop the connection once the proxy is closed.
+  void addEdge(std::unique_ptr<DuplexConnection>);
+
+  /// Closes the backend connection and every edge connection, with a
+  /// connection error to the edges.  Also happens when the backend connection
+  /// closes.
+  void close();
+
+  bool isClosed() const {
+    return closed_;
+  }
+
+  size_t numEdges() const {
+    return edges_.size();
+  }
+
+  /// Number of streams being forwarded.
+  size_t numStreams() const {
+    return routes_.size();
+  }
+
+ private:
+  class Leg;
+
+  /// Where the frames of a backend stream are forwarded to, and which
+  /// directions of the stream are done.  The stream is forgotten once both
+  /// are, "up" being the edge to backend direction.
+  struct Route {
+    uint64_t edgeId{0};
+    StreamId edgeStreamId{0};
+    StreamType type{StreamType::REQUEST_RESPONSE};
+    bool upDone{false};
+    bool downDone{false};
+  };
+
+  struct Edge {
+    std::shared_ptr<FrameTransportImpl> transport;
+    bool setUp{false};
+
+    /// Backend stream ids, by edge stream id.
+    StreamTable<StreamId> streams;
+  };
+
+  /// Identifies the backend connection to a Leg, edge ids start at one.
+  static constexpr uint64_t kBackendId = 0;
+
+  FrameProxy(ProtocolVersion, SetupParameters&);
+
+  void start(std::unique_ptr<DuplexConnection> backend, SetupParameters);
+
+  std::unique_ptr<DuplexConnection> framed(std::unique_ptr<DuplexConnection>);
+
+  void onFrame(uint64_t legId, std::unique_ptr<folly::IOBuf>);
+  void onTerminal(uint64_t legId);
+
+  void onEdgeFrame(uint64_t edgeId, std::unique_ptr<folly::IOBuf>);
+  void onEdgeSetup(
+      uint64_t edgeId,
+      Edge&,
+      const FrameHeader&,
+      std::unique_ptr<folly::IOBuf>);
+  void onEdgeConnectionFrame(
+      uint64_t edgeId,
+      Edge&,
+      const FrameHeader&,
+      std::unique_ptr<folly::IOBuf>);
+  void openStream(
+      uint64_t edgeId,
+      Edge&,
+      const FrameHeader&,
+      std::unique_ptr<folly::IOBuf>);
+  void forwardToBackend(
+      Edge&,
+      const FrameHeader&,
+      std::unique_ptr<folly::IOBuf>);
+
+  void onBackendFrame(std::unique_ptr<folly::IOBuf>);
+  void onBackendConnectionFrame(
+      const FrameHeader&,
+      std::unique_ptr<folly::IOBuf>);
+  void forwardToEdge(const FrameHeader&, std::unique_ptr<folly::IOBuf>);
+
+  /// Answers a KEEPALIVE frame that asks for a response.
+  void answerKeepalive(FrameTransportImpl&, std::unique_ptr<folly::IOBuf>);
+
+  /// Forgets a stream once both of its directions are done.
+  void finishIfDone(StreamId backendStreamId, const Route&);
+
+  /// Closes an edge connection, terminating its streams on the backend, and
+  /// sends `error` to the edge first if there is one.
+  void closeEdge(uint64_t edgeId, folly::Optional<Frame_ERROR> error);
+
+  void closeAll(folly::StringPiece reason);
+
+  const ProtocolVersion version_;
+  const std::string metadataMimeType_;
+  const std::string dataMimeType_;
+  const FrameSerializer* const serializer_;
+
+  std::shared_ptr<FrameTransportImpl> backend_;
+  std::unordered_map<uint64_t, std::unique_ptr<Edge>> edges_;
+  uint64_t nextEdgeId_{kBackendId + 1};
+
+  /// Streams of the backend connection, by backend stream id.
+  StreamTable<Route> routes_;
+  StreamId nextStreamId_{1};
+
+  bool closed_{false};
+};
+
+} // namespace rsocket
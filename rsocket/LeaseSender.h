@@ -0,0 +1,55 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Optional.h>
+
+#include <chrono>
+#include <cstdint>
+
+namespace rsocket {
+
+/// Permission for a peer to send up to `numberOfRequests` requests during the
+/// next `ttl`.
+struct Lease {
+  std::chrono::milliseconds ttl;
+  uint32_t numberOfRequests;
+};
+
+/// Server-side admission control policy, see RSocketServer::setLeaseSender().
+///
+/// Clients that ask for leases in their SETUP frame may only send requests
+/// allowed by a lease the server granted them.  Requests beyond that are
+/// rejected by the server, so a loaded server can shed load by granting small
+/// leases, or none at all.
+///
+/// A single instance is shared by all connections of a server, and is called
+/// from their EventBase threads concurrently.
+class LeaseSender {
+ public:
+  virtual ~LeaseSender() = default;
+
+  /// Returns the next lease to grant to a connection.  Called when the
+  /// connection is set up or resumed, and again whenever its current lease
+  /// expires or is used up.  Returning folly::none grants nothing, and the
+  /// connection asks again after retryInterval().
+  virtual folly::Optional<Lease> nextLease() = 0;
+
+  virtual std::chrono::milliseconds retryInterval() const {
+    return std::chrono::milliseconds{100};
+  }
+};
+
+} // namespace rsocket
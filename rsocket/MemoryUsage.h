@@ -0,0 +1,55 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+
+namespace rsocket {
+
+/// Bytes held by one or more connections, broken down by what holds them.
+/// Each figure is kept up to date as the connection runs, so reading them is
+/// cheap.
+struct MemoryUsage {
+  /// Stream state machines, including the blocks pooled for reuse.
+  size_t streams{0};
+
+  /// Fragments of incoming payloads that are still being reassembled.
+  size_t reassembly{0};
+
+  /// Frames waiting to be written, held back either because the connection
+  /// can't send them or by the output scheduler.
+  size_t pendingOutput{0};
+
+  /// Sent frames kept by the ResumeManager to replay on resumption.
+  size_t resumeBuffer{0};
+
+  /// Bytes read from the transport that don't form a complete frame yet.
+  size_t inputBuffer{0};
+
+  size_t total() const {
+    return streams + reassembly + pendingOutput + resumeBuffer + inputBuffer;
+  }
+
+  MemoryUsage& operator+=(const MemoryUsage& other) {
+    streams += other.streams;
+    reassembly += other.reassembly;
+    pendingOutput += other.pendingOutput;
+    resumeBuffer += other.resumeBuffer;
+    inputBuffer += other.inputBuffer;
+    return *this;
+  }
+};
+
+} // namespace rsocket
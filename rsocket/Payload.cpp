@@ -17,7 +17,9 @@
 #include <folly/String.h>
 #include <folly/io/Cursor.h>
 
+#include "rsocket/internal/BufferCompaction.h"
 #include "rsocket/internal/Common.h"
+#include "rsocket/internal/PayloadBufferPool.h"
 
 namespace rsocket {
 
@@ -31,17 +33,74 @@ std::string cloneIOBufToString(std::unique_ptr<folly::IOBuf> const& buf) {
   return buf ? buf->cloneAsValue().moveToFbString().toStdString() : "";
 }
 
+/// Like BufferCompaction::compact(), but into a buffer from createBuffer().
+void compactBuffer(std::unique_ptr<folly::IOBuf>& buf) {
+  if (!buf || !BufferCompaction().needed(*buf)) {
+    return;
+  }
+  auto const length = buf->computeChainDataLength();
+  auto compacted = Payload::createBuffer(length);
+  folly::io::Cursor(buf.get()).pull(compacted->writableData(), length);
+  compacted->append(length);
+  buf = std::move(compacted);
+}
+
+folly::Optional<folly::StringPiece> viewOf(const folly::IOBuf* buf) {
+  if (!buf) {
+    return folly::StringPiece();
+  }
+  if (!buf->isChained()) {
+    return folly::StringPiece(buf->data(), buf->length());
+  }
+
+  // Empty buffers in the chain don't break contiguity.
+  folly::Optional<folly::StringPiece> view;
+  for (auto range : *buf) {
+    if (range.empty()) {
+      continue;
+    }
+    if (view) {
+      return folly::none;
+    }
+    view = folly::StringPiece(range);
+  }
+  if (!view) {
+    return folly::StringPiece();
+  }
+  return view;
+}
+
+folly::StringPiece coalescedViewOf(folly::IOBuf* buf) {
+  return buf ? folly::StringPiece(buf->coalesce()) : folly::StringPiece();
+}
+
 } // namespace
 
+constexpr size_t Payload::kHeaderHeadroom;
+constexpr size_t Payload::kSmallPayloadSize;
+
 Payload::Payload(
     std::unique_ptr<folly::IOBuf> d,
     std::unique_ptr<folly::IOBuf> m)
     : data{std::move(d)}, metadata{std::move(m)} {}
 
-Payload::Payload(folly::StringPiece d, folly::StringPiece m)
-    : data{folly::IOBuf::copyBuffer(d.data(), d.size())} {
-  if (!m.empty()) {
-    metadata = folly::IOBuf::copyBuffer(m.data(), m.size());
+Payload::Payload(folly::StringPiece d, folly::StringPiece m) {
+  if (d.size() + m.size() > kSmallPayloadSize) {
+    data = folly::IOBuf::copyBuffer(d.data(), d.size());
+    if (!m.empty()) {
+      metadata = folly::IOBuf::copyBuffer(m.data(), m.size());
+    }
+    return;
+  }
+
+  // Leave room for the frame header in front of the first buffer, and for the
+  // data behind the metadata.
+  if (m.empty()) {
+    data = copyBuffer(d);
+  } else {
+    data = folly::IOBuf::copyBuffer(d.data(), d.size());
+    metadata = folly::IOBuf::copyBuffer(
+        m.data(), m.size(), kHeaderHeadroom, /* minTailroom */ d.size());
   }
 }
 
@@ -74,6 +133,22 @@ std::string Payload::cloneMetadataToString() const {
   return cloneIOBufToString(metadata);
 }
 
+folly::Optional<folly::StringPiece> Payload::dataView() const {
+  return viewOf(data.get());
+}
+
+folly::Optional<folly::StringPiece> Payload::metadataView() const {
+  return viewOf(metadata.get());
+}
+
+folly::StringPiece Payload::coalescedDataView() {
+  return coalescedViewOf(data.get());
+}
+
+folly::StringPiece Payload::coalescedMetadataView() {
+  return coalescedViewOf(metadata.get());
+}
+
 void Payload::clear() {
   data.reset();
   metadata.reset();
@@ -90,6 +165,26 @@ Payload Payload::clone() const {
   return out;
 }
 
+void Payload::compact() {
+  compactBuffer(data);
+  compactBuffer(metadata);
+}
+
+std::unique_ptr<folly::IOBuf> Payload::createBuffer(size_t capacity) {
+  auto buf = folly::IOBuf::createCombined(kHeaderHeadroom + capacity);
+  buf->advance(kHeaderHeadroom);
+  return buf;
+}
+
+std::unique_ptr<folly::IOBuf> Payload::copyBuffer(folly::StringPiece bytes) {
+  return folly::IOBuf::copyBuffer(
+      bytes.data(), bytes.size(), kHeaderHeadroom, /* minTailroom */ 0);
+}
+
+std::unique_ptr<folly::IOBuf> Payload::allocate(size_t capacity) {
+  return PayloadBufferPool::allocate(kHeaderHeadroom, capacity);
+}
+
 ErrorWithPayload::ErrorWithPayload(Payload&& payload)
     : payload(std::move(payload)) {}
 
@@ -14,6 +14,8 @@
 
 #pragma once
 
+#include <folly/Optional.h>
+#include <folly/Range.h>
 #include <folly/io/IOBuf.h>
 #include <memory>
 #include <string>
@@ -23,6 +25,16 @@ namespace rsocket {
 /// The type of a read-only view on a binary buffer.
 /// MUST manage the lifetime of the underlying buffer.
 struct Payload {
+  /// Headroom reserved by createBuffer(), enough for the frame serializer to
+  /// write any data-carrying frame header (including the frame length field)
+  /// in place, in front of the payload bytes.
+  static constexpr size_t kHeaderHeadroom = 16;
+
+  /// Payloads of at most this many bytes of data and metadata are laid out so
+  /// that their frame is serialized into a single buffer, with the data copied
+  /// in behind the metadata.
+  static constexpr size_t kSmallPayloadSize = 64;
+
   Payload() = default;
 
   explicit Payload(
@@ -43,12 +55,65 @@ struct Payload {
   std::string moveMetadataToString();
   std::string cloneMetadataToString() const;
 
+  /// Views on the data and metadata, without copying them.  Empty if there is
+  /// no buffer, folly::none if the bytes span several buffers of a chain.
+  folly::Optional<folly::StringPiece> dataView() const;
+  folly::Optional<folly::StringPiece> metadataView() const;
+
+  /// Like dataView() and metadataView(), but coalesce a chain into a single
+  /// buffer first, which copies it only the first time.
+  folly::StringPiece coalescedDataView();
+  folly::StringPiece coalescedMetadataView();
+
+  /// Call `fn(folly::StringPiece)` for each non-empty buffer of the data or
+  /// metadata chain, in order.
+  template <typename Fn>
+  void forEachDataRange(Fn&& fn) const {
+    forEachRange(data.get(), fn);
+  }
+  template <typename Fn>
+  void forEachMetadataRange(Fn&& fn) const {
+    forEachRange(metadata.get(), fn);
+  }
+
   void clear();
 
   Payload clone() const;
 
+  /// Copies data and metadata that are chains of many small buffers, or
+  /// slices of much larger buffers, into buffers of their own, see
+  /// BufferCompaction.  For payloads kept for a long time, e.g. by
+  /// Flowable::replay(), which calls it.
+  void compact();
+
+  /// Allocates a buffer for payload data or metadata with kHeaderHeadroom
+  /// bytes of headroom.  Frames carrying such buffers are serialized without
+  /// any additional allocation.
+  static std::unique_ptr<folly::IOBuf> createBuffer(size_t capacity);
+
+  /// Copies the given bytes into a buffer created by createBuffer().
+  static std::unique_ptr<folly::IOBuf> copyBuffer(folly::StringPiece);
+
+  /// Like createBuffer(), but takes the buffer from a per-thread pool, to
+  /// which it returns once the transport is done writing it out.  See
+  /// PayloadBufferPool for the sizes that are pooled.
+  static std::unique_ptr<folly::IOBuf> allocate(size_t capacity);
+
   std::unique_ptr<folly::IOBuf> data;
   std::unique_ptr<folly::IOBuf> metadata;
+
+ private:
+  template <typename Fn>
+  static void forEachRange(const folly::IOBuf* buf, Fn& fn) {
+    if (!buf) {
+      return;
+    }
+    for (auto range : *buf) {
+      if (!range.empty()) {
+        fn(folly::StringPiece(range));
+      }
+    }
+  }
 };
 
 struct ErrorWithPayload : public std::exception {
@@ -73,6 +73,32 @@ folly::Future<std::unique_ptr<RSocketClient>> RSocket::createConnectedClient(
           });
 }
 
+std::unique_ptr<RSocketClient> RSocket::createConnectingClient(
+    std::shared_ptr<ConnectionFactory> connectionFactory,
+    folly::EventBase& stateMachineEvb,
+    SetupParameters setupParameters,
+    std::shared_ptr<RSocketResponder> responder,
+    std::chrono::milliseconds keepaliveInterval,
+    std::shared_ptr<RSocketStats> stats,
+    std::shared_ptr<RSocketConnectionEvents> connectionEvents,
+    std::shared_ptr<ResumeManager> resumeManager,
+    std::shared_ptr<ColdResumeHandler> coldResumeHandler) {
+  CHECK(connectionFactory);
+  auto client = std::unique_ptr<RSocketClient>(new RSocketClient(
+      std::move(connectionFactory),
+      setupParameters.protocolVersion,
+      setupParameters.token,
+      std::move(responder),
+      keepaliveInterval,
+      std::move(stats),
+      std::move(connectionEvents),
+      std::move(resumeManager),
+      std::move(coldResumeHandler),
+      &stateMachineEvb));
+  client->connectInBackground(std::move(setupParameters));
+  return client;
+}
+
 folly::Future<std::unique_ptr<RSocketClient>> RSocket::createResumedClient(
     std::shared_ptr<ConnectionFactory> connectionFactory,
     ResumeIdentificationToken token,
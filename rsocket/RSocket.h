@@ -40,6 +40,30 @@ class RSocket {
           std::shared_ptr<ColdResumeHandler>(),
       folly::EventBase* stateMachineEvb = nullptr);
 
+  // Like createConnectedClient(), but returns the RSocketClient right away,
+  // with a requester that can be used before the connection is made.  The
+  // frames of the requests made in the meantime are written in the same
+  // write as the SETUP frame, so the first requests don't wait for a round
+  // trip to connect first.  If the connection fails the client is closed,
+  // failing those requests with the error.
+  //
+  // The state machine runs on `stateMachineEvb`, since the EventBase of the
+  // transport isn't known until the connection is made.  Throws
+  // std::invalid_argument for unsupported setup parameters.
+  static std::unique_ptr<RSocketClient> createConnectingClient(
+      std::shared_ptr<ConnectionFactory>,
+      folly::EventBase& stateMachineEvb,
+      SetupParameters setupParameters = SetupParameters(),
+      std::shared_ptr<RSocketResponder> responder =
+          std::make_shared<RSocketResponder>(),
+      std::chrono::milliseconds keepaliveInterval = kDefaultKeepaliveInterval,
+      std::shared_ptr<RSocketStats> stats = RSocketStats::noop(),
+      std::shared_ptr<RSocketConnectionEvents> connectionEvents =
+          std::shared_ptr<RSocketConnectionEvents>(),
+      std::shared_ptr<ResumeManager> resumeManager = ResumeManager::makeEmpty(),
+      std::shared_ptr<ColdResumeHandler> coldResumeHandler =
+          std::shared_ptr<ColdResumeHandler>());
+
   // Creates a RSocketClient which cold-resumes from the provided state
   // keepaliveInterval of 0 will result in no keepAlives
   static folly::Future<std::unique_ptr<RSocketClient>> createResumedClient(
@@ -13,6 +13,10 @@
 // limitations under the License.
 
 #include "rsocket/RSocketClient.h"
+
+#include <utility>
+
+#include "rsocket/RSocket.h"
 #include "rsocket/RSocketRequester.h"
 #include "rsocket/RSocketResponder.h"
 #include "rsocket/RSocketStats.h"
@@ -24,6 +28,90 @@
 
 namespace rsocket {
 
+namespace {
+
+std::shared_ptr<FrameTransport> makeFrameTransport(
+    std::unique_ptr<DuplexConnection> connection,
+    ProtocolVersion protocolVersion) {
+  std::unique_ptr<DuplexConnection> framed;
+  if (connection->isFramed()) {
+    framed = std::move(connection);
+  } else {
+    framed = std::make_unique<FramedDuplexConnection>(
+        std::move(connection), protocolVersion);
+  }
+  return std::make_shared<FrameTransportImpl>(std::move(framed));
+}
+
+/// Connects a state machine set up by prepareClient(), closing it if the
+/// connection doesn't support the setup parameters.
+void connectPreparedClient(
+    RSocketStateMachine& stateMachine,
+    std::shared_ptr<FrameTransport> transport) {
+  try {
+    stateMachine.connectClient(std::move(transport));
+  } catch (const std::exception& ex) {
+    stateMachine.close(
+        folly::exception_wrapper{std::current_exception(), ex},
+        StreamCompletionSignal::CONNECTION_ERROR);
+  }
+}
+
+} // namespace
+
+/// Passes the events of the state machine on to the application, and has
+/// the client reconnect once the connection is lost.  Only used on the
+/// EventBase of the state machine.
+class RSocketClient::ConnectionEvents : public RSocketConnectionEvents {
+ public:
+  explicit ConnectionEvents(std::shared_ptr<RSocketConnectionEvents> events)
+      : events_(std::move(events)) {}
+
+  void onConnected() override {
+    if (events_) {
+      events_->onConnected();
+    }
+  }
+
+  void onDisconnected(const folly::exception_wrapper& ex) override {
+    if (events_) {
+      events_->onDisconnected(ex);
+    }
+    if (reconnectManager && !disconnecting) {
+      reconnectManager->onDisconnected();
+    }
+  }
+
+  void onClosed(const folly::exception_wrapper& ex) override {
+    if (reconnectManager) {
+      reconnectManager->onClosed();
+    }
+    if (events_) {
+      events_->onClosed(ex);
+    }
+  }
+
+  void onStreamsPaused() override {
+    if (events_) {
+      events_->onStreamsPaused();
+    }
+  }
+
+  void onStreamsResumed() override {
+    if (events_) {
+      events_->onStreamsResumed();
+    }
+  }
+
+  std::shared_ptr<ReconnectManager> reconnectManager;
+
+  /// Set while the application disconnects the client.
+  bool disconnecting{false};
+
+ private:
+  const std::shared_ptr<RSocketConnectionEvents> events_;
+};
+
 RSocketClient::RSocketClient(
     std::shared_ptr<ConnectionFactory> connectionFactory,
     ProtocolVersion protocolVersion,
@@ -52,6 +140,10 @@ RSocketClient::RSocketClient(
 RSocketClient::~RSocketClient() {
   VLOG(3) << "~RSocketClient ..";
 
+  if (reconnectManager_) {
+    reconnectManager_->stop();
+  }
+
   evb_->runImmediatelyOrRunInEventBaseThreadAndWait([sm = stateMachine_] {
     auto exn = folly::make_exception_wrapper<std::runtime_error>(
         "RSocketClient is closing");
@@ -122,37 +214,128 @@ folly::Future<folly::Unit> RSocketClient::resumeFromConnection(
   auto transport =
       std::make_shared<FrameTransportImpl>(std::move(framedConnection));
 
-  std::shared_ptr<FrameTransport> ft;
-  if (evb_ != &connection.eventBase) {
-    // If the StateMachine EventBase is different from the transport
-    // EventBase, then use ScheduledFrameTransport and
-    // ScheduledFrameProcessor to ensure the RSocketStateMachine and
-    // Transport live on the desired EventBases
-    ft = std::make_shared<ScheduledFrameTransport>(
-        std::move(transport),
-        &connection.eventBase, /* Transport EventBase */
-        evb_); /* StateMachine EventBase */
-  } else {
-    ft = std::move(transport);
-  }
-
   evb_->runInEventBaseThread([this,
-                              frameTransport = std::move(ft),
+                              transport = std::move(transport),
+                              transportEvb = &connection.eventBase,
                               callback = std::move(resumeCallback)]() mutable {
     if (!stateMachine_) {
       createState();
     }
 
+    if (evb_ == transportEvb) {
+      stateMachine_->resumeClient(
+          token_, std::move(transport), std::move(callback), protocolVersion_);
+      return;
+    }
+
+    if (migrateOnResume_ && stateMachine_->canMoveEventBase()) {
+      migrateAndResume(
+          *transportEvb, std::move(transport), std::move(callback));
+      return;
+    }
+
+    // If the StateMachine EventBase is different from the transport
+    // EventBase, then use ScheduledFrameTransport and
+    // ScheduledFrameProcessor to ensure the RSocketStateMachine and
+    // Transport live on the desired EventBases
+    auto scheduledFT = std::make_shared<ScheduledFrameTransport>(
+        std::move(transport),
+        transportEvb, /* Transport EventBase */
+        evb_); /* StateMachine EventBase */
     stateMachine_->resumeClient(
-        token_,
-        std::move(frameTransport),
-        std::move(callback),
-        protocolVersion_);
+        token_, std::move(scheduledFT), std::move(callback), protocolVersion_);
   });
 
   return future;
 }
 
+void RSocketClient::migrateAndResume(
+    folly::EventBase& transportEvb,
+    std::shared_ptr<FrameTransport> transport,
+    std::unique_ptr<ClientResumeStatusCallback> callback) {
+  VLOG(2) << "Moving the state machine to the transport's EventBase";
+
+  // Loop callbacks that the state machine scheduled on this EventBase run
+  // before this one, so that nothing touches it here once it has moved.
+  evb_->runInLoop([this,
+                   transportEvb = &transportEvb,
+                   transport = std::move(transport),
+                   callback = std::move(callback)]() mutable {
+    stateMachine_->moveToEventBase(*transportEvb);
+    requester_->setEventBase(*transportEvb);
+    evb_ = transportEvb;
+
+    evb_->runInEventBaseThread([this,
+                                transport = std::move(transport),
+                                callback = std::move(callback)]() mutable {
+      stateMachine_->resumeClient(
+          token_, std::move(transport), std::move(callback), protocolVersion_);
+    });
+  });
+}
+
+void RSocketClient::setAutoReconnect(ReconnectOptions options) {
+  CHECK(connectionFactory_)
+      << "The client was likely created without ConnectionFactory. Can't "
+      << "reconnect";
+  CHECK(clientEvents_) << "The client has no state machine yet";
+
+  auto manager = std::make_shared<ReconnectManager>(
+      *evb_,
+      options,
+      [factory = connectionFactory_, version = protocolVersion_] {
+        return factory->connect(version, ResumeStatus::RESUMING);
+      },
+      [this](ReconnectManager::Connection connection) {
+        return resumeFromConnection(std::move(connection));
+      },
+      stats_);
+  if (auto previous = std::exchange(reconnectManager_, manager)) {
+    previous->stop();
+  }
+  evb_->runImmediatelyOrRunInEventBaseThreadAndWait(
+      [events = clientEvents_, manager = std::move(manager)]() mutable {
+        events->reconnectManager = std::move(manager);
+      });
+}
+
+folly::Future<folly::Unit> RSocketClient::connectBulk(
+    std::shared_ptr<ConnectionFactory> connectionFactory,
+    SetupParameters setupParameters) {
+  CHECK(requester_) << "The client has no state machine yet";
+
+  return RSocket::createConnectedClient(
+             std::move(connectionFactory),
+             std::move(setupParameters),
+             std::make_shared<RSocketResponder>(),
+             keepaliveInterval_,
+             stats_)
+      .thenValue([this](std::unique_ptr<RSocketClient> client) {
+        VLOG(2) << "Bulk connection established";
+        requester_->setBulkRequester(client->getRequester());
+        bulkClient_ = std::move(client);
+      });
+}
+
+void RSocketClient::setMemoryPressure(
+    std::shared_ptr<const MemoryPressureController> controller) {
+  evb_->runInEventBaseThread(
+      [sm = stateMachine_, controller = std::move(controller)]() mutable {
+        sm->setMemoryPressure(std::move(controller));
+      });
+}
+
+folly::SemiFuture<ConnectionFlowControl> RSocketClient::flowControl() const {
+  if (!stateMachine_) {
+    return folly::makeSemiFuture<ConnectionFlowControl>(
+        std::runtime_error{"RSocketClient must always have a state machine"});
+  }
+  return folly::via(
+             folly::getKeepAliveToken(evb_),
+             [sm = stateMachine_] { return sm->flowControl(); })
+      .semi();
+}
+
 folly::Future<folly::Unit> RSocketClient::disconnect(
     folly::exception_wrapper ew) {
   if (!stateMachine_) {
@@ -160,8 +343,13 @@ folly::Future<folly::Unit> RSocketClient::disconnect(
         std::runtime_error{"RSocketClient must always have a state machine"});
   }
 
-  auto work = [sm = stateMachine_, e = std::move(ew)]() mutable {
+  auto work = [sm = stateMachine_,
+               events = clientEvents_,
+               e = std::move(ew)]() mutable {
+    // Asked for by the application, so not to be undone by reconnecting.
+    events->disconnecting = true;
     sm->disconnect(std::move(e));
+    events->disconnecting = false;
   };
 
   if (evb_->isInEventBaseThread()) {
@@ -185,14 +373,8 @@ void RSocketClient::fromConnection(
   }
   createState();
 
-  std::unique_ptr<DuplexConnection> framed;
-  if (connection->isFramed()) {
-    framed = std::move(connection);
-  } else {
-    framed = std::make_unique<FramedDuplexConnection>(
-        std::move(connection), params.protocolVersion);
-  }
-  auto transport = std::make_shared<FrameTransportImpl>(std::move(framed));
+  auto transport =
+      makeFrameTransport(std::move(connection), params.protocolVersion);
 
   if (evb_ == &transportEvb) {
     stateMachine_->connectClient(std::move(transport), std::move(params));
@@ -211,6 +393,49 @@ void RSocketClient::fromConnection(
   });
 }
 
+void RSocketClient::connectInBackground(SetupParameters params) {
+  CHECK(connectionFactory_);
+  CHECK(evb_);
+  createState();
+
+  auto const version = params.protocolVersion;
+  // Nothing else uses the state machine yet, so it can be set up here.
+  // Throws for unsupported setup parameters.
+  stateMachine_->prepareClient(std::move(params));
+
+  auto sm = stateMachine_;
+  auto evb = evb_;
+  connectionFactory_->connect(version, ResumeStatus::NEW_SESSION)
+      .thenValue([sm, evb, version](
+                     ConnectionFactory::ConnectedDuplexConnection connection) {
+        // The transport is made on its own EventBase, as in
+        // RSocket::createConnectedClient().
+        auto transportEvb = &connection.eventBase;
+        return folly::via(
+            transportEvb,
+            [sm, evb, version, connection = std::move(connection)]() mutable {
+              auto transport = makeFrameTransport(
+                  std::move(connection.connection), version);
+              if (evb == &connection.eventBase) {
+                connectPreparedClient(*sm, std::move(transport));
+                return;
+              }
+              auto scheduledFT = std::make_shared<ScheduledFrameTransport>(
+                  std::move(transport), &connection.eventBase, evb);
+              evb->runInEventBaseThread(
+                  [sm, scheduledFT = std::move(scheduledFT)]() mutable {
+                    connectPreparedClient(*sm, std::move(scheduledFT));
+                  });
+            });
+      })
+      .thenError([sm, evb](folly::exception_wrapper ex) {
+        VLOG(2) << "Background connection failed: " << ex.what();
+        evb->runInEventBaseThread([sm, ex = std::move(ex)]() mutable {
+          sm->close(std::move(ex), StreamCompletionSignal::CONNECTION_ERROR);
+        });
+      });
+}
+
 void RSocketClient::createState() {
   // Creation of state is permitted only once for each RSocketClient.
   // When evb is removed from RSocketStateMachine, the state can be
@@ -227,12 +452,14 @@ void RSocketClient::createState() {
         std::make_unique<KeepaliveTimer>(keepaliveInterval_, *evb_);
   }
 
+  clientEvents_ =
+      std::make_shared<ConnectionEvents>(std::move(connectionEvents_));
   stateMachine_ = std::make_shared<RSocketStateMachine>(
       std::move(responder_),
       std::move(keepaliveTimer),
       RSocketMode::CLIENT,
-      std::move(stats_),
-      std::move(connectionEvents_),
+      stats_,
+      clientEvents_,
       std::move(resumeManager_),
       std::move(coldResumeHandler_));
 
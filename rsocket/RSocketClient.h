@@ -19,12 +19,15 @@
 #include "rsocket/ColdResumeHandler.h"
 #include "rsocket/ConnectionFactory.h"
 #include "rsocket/DuplexConnection.h"
+#include "rsocket/FlowControl.h"
 #include "rsocket/RSocketConnectionEvents.h"
 #include "rsocket/RSocketParameters.h"
 #include "rsocket/RSocketRequester.h"
 #include "rsocket/RSocketResponder.h"
 #include "rsocket/RSocketStats.h"
 #include "rsocket/ResumeManager.h"
+#include "rsocket/internal/MemoryPressureController.h"
+#include "rsocket/internal/ReconnectManager.h"
 
 namespace rsocket {
 
@@ -68,7 +71,53 @@ class RSocketClient {
   // Disconnect the underlying transport.
   folly::Future<folly::Unit> disconnect(folly::exception_wrapper = {});
 
+  // Flow control state of the connection and its streams, read on the
+  // EventBase of the state machine.  Helps telling whether a stalled stream
+  // waits for credits from either side, the transport or resumption.
+  folly::SemiFuture<ConnectionFlowControl> flowControl() const;
+
+  // Move the state machine onto the EventBase of the transport when resuming
+  // on a transport that lives on another one, instead of hopping between the
+  // two for every frame.  Only possible while the client has no streams and
+  // doesn't honor leases; otherwise resumption keeps the hop.
+  void setMigrateOnResume(bool migrate) {
+    migrateOnResume_ = migrate;
+  }
+
+  // Reconnect and resume as soon as the connection is lost, instead of
+  // waiting for resume() to be called.  Connections are attempted in rounds,
+  // spaced out by a jittered exponential backoff, and the client resumes on
+  // the first one made.  A disconnect() is not followed by reconnection.
+  //
+  // Requires the client to have a ConnectionFactory and a resumable
+  // connection.
+  void setAutoReconnect(ReconnectOptions options);
+
+  // Degrade the connection while the controller reports memory pressure:
+  // streams keep less credit outstanding with the server, the resume buffer
+  // is capped, and requests of the server are rejected once pressure is
+  // critical.  See MemoryPressureController.
+  void setMemoryPressure(
+      std::shared_ptr<const MemoryPressureController> controller);
+
+  // Opens a second connection to the server for the streams of requesters
+  // made with RSocketRequester::withBulkTraffic(), so that bulk transfers
+  // don't fill the socket buffers in front of the latency-sensitive requests
+  // of this connection.  Give `connectionFactory` a DSCP mark and socket
+  // buffer sizes of its own, see TcpDuplexConnection::Options, and point it
+  // at a server acceptor that does the same.  The state machine of the bulk
+  // connection runs on the EventBase of its transport.
+  //
+  // The bulk connection is a session of its own: it isn't resumed or
+  // disconnected along with this one, only closed when the client is
+  // destroyed.  The client must outlive the returned future.
+  folly::Future<folly::Unit> connectBulk(
+      std::shared_ptr<ConnectionFactory> connectionFactory,
+      SetupParameters setupParameters = SetupParameters());
+
  private:
+  class ConnectionEvents;
+
   // Private constructor.  RSocket class should be used to create instances
   // of RSocketClient.
   RSocketClient(
@@ -89,9 +138,22 @@ class RSocketClient {
       folly::EventBase& transportEvb,
       SetupParameters setupParameters);
 
+  // Creates the state machine, then connects it using the ConnectionFactory
+  // without waiting for the connection.  Requests made in the meantime are
+  // written along with the SETUP frame.  A failed connection closes the
+  // client.
+  void connectInBackground(SetupParameters setupParameters);
+
   // Creates RSocketStateMachine and RSocketRequester
   void createState();
 
+  // Moves the state machine and requester onto `transportEvb`, then resumes
+  // there.  Runs on the current EventBase of the state machine.
+  void migrateAndResume(
+      folly::EventBase& transportEvb,
+      std::shared_ptr<FrameTransport> transport,
+      std::unique_ptr<ClientResumeStatusCallback> callback);
+
   const std::shared_ptr<ConnectionFactory> connectionFactory_;
   std::shared_ptr<RSocketResponder> responder_;
   const std::chrono::milliseconds keepaliveInterval_;
@@ -102,6 +164,11 @@ class RSocketClient {
 
   std::shared_ptr<RSocketStateMachine> stateMachine_;
   std::shared_ptr<RSocketRequester> requester_;
+  // Stand in for the connection events of the application, with the state
+  // machine, so that the client learns about disconnects.
+  std::shared_ptr<ConnectionEvents> clientEvents_;
+  std::shared_ptr<ReconnectManager> reconnectManager_;
+  std::unique_ptr<RSocketClient> bulkClient_;
 
   const ProtocolVersion protocolVersion_;
   const ResumeIdentificationToken token_;
@@ -116,5 +183,7 @@ class RSocketClient {
   // EventBase, but the transport ends up being in different EventBase after
   // resumption, and vice versa.
   folly::EventBase* evb_{nullptr};
+
+  bool migrateOnResume_{false};
 };
 } // namespace rsocket
@@ -0,0 +1,297 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/RSocketCoroResponder.h"
+
+#if FOLLY_HAS_COROUTINES
+
+#include <folly/CancellationToken.h>
+#include <folly/ScopeGuard.h>
+#include <folly/Try.h>
+#include <folly/executors/GlobalExecutor.h>
+#include <folly/experimental/coro/Baton.h>
+#include <folly/experimental/coro/WithCancellation.h>
+#include <folly/io/async/EventBaseManager.h>
+
+#include "rsocket/internal/CoroStreamSubscriber.h"
+#include "yarpl/flowable/AsyncGeneratorShim.h"
+#include "yarpl/utils/credits.h"
+
+namespace rsocket {
+
+using namespace yarpl::flowable;
+using namespace yarpl::single;
+
+namespace {
+
+/// The EventBase of the connection when called by its state machines.
+folly::EventBase& currentEventBase() {
+  auto const evb = folly::EventBaseManager::get()->getExistingEventBase();
+  return evb ? *evb : *folly::getEventBase();
+}
+
+/// Subscription of a response stream pulled from a generator.  It is called
+/// on the EventBase the generator is pulled on, so needs no synchronization.
+class GeneratorSubscription : public Subscription {
+ public:
+  void request(int64_t n) override {
+    credits_ = yarpl::credits::add(credits_, n);
+    baton_.post();
+  }
+
+  void cancel() override {
+    cancelSource_.requestCancellation();
+    baton_.post();
+  }
+
+  folly::CancellationToken token() const {
+    return cancelSource_.getToken();
+  }
+
+  /// Waits for the requester to grant a credit, and takes it.  Returns false
+  /// if the stream is cancelled instead.
+  folly::coro::Task<bool> takeCredit() {
+    while (credits_ == 0 && !cancelSource_.isCancellationRequested()) {
+      baton_.reset();
+      co_await baton_;
+    }
+    if (cancelSource_.isCancellationRequested()) {
+      co_return false;
+    }
+    yarpl::credits::consume(credits_, 1);
+    co_return true;
+  }
+
+ private:
+  int64_t credits_{0};
+  folly::coro::Baton baton_;
+  folly::CancellationSource cancelSource_;
+};
+
+class TaskSubscription : public SingleSubscription {
+ public:
+  void cancel() override {
+    cancelSource_.requestCancellation();
+  }
+
+  folly::CancellationToken token() const {
+    return cancelSource_.getToken();
+  }
+
+ private:
+  folly::CancellationSource cancelSource_;
+};
+
+folly::coro::Task<void> pushResponse(
+    folly::coro::Task<Payload> task,
+    folly::CancellationToken token,
+    std::shared_ptr<SingleObserver<Payload>> response) {
+  auto result = co_await folly::coro::co_awaitTry(
+      folly::coro::co_withCancellation(token, std::move(task)));
+  if (token.isCancellationRequested()) {
+    co_return;
+  }
+  if (result.hasException()) {
+    response->onError(std::move(result).exception());
+  } else {
+    response->onSuccess(std::move(result).value());
+  }
+}
+
+/// Pulls an element from the generator for every credit, and nothing ahead
+/// of them, until the generator ends or the requester cancels.
+folly::coro::Task<void> pushStream(
+    folly::coro::AsyncGenerator<Payload&&> generator,
+    std::shared_ptr<GeneratorSubscription> subscription,
+    std::shared_ptr<Subscriber<Payload>> response) {
+  auto const token = subscription->token();
+  while (co_await subscription->takeCredit()) {
+    folly::Try<Payload> value;
+    try {
+      auto item =
+          co_await folly::coro::co_withCancellation(token, generator.next());
+      if (item) {
+        value.emplace(std::move(*item));
+      }
+    } catch (const std::exception& ex) {
+      value.emplaceException(std::current_exception(), ex);
+    } catch (...) {
+      value.emplaceException(std::current_exception());
+    }
+
+    if (token.isCancellationRequested()) {
+      co_return;
+    }
+    if (value.hasValue()) {
+      response->onNext(std::move(value).value());
+    } else if (value.hasException()) {
+      response->onError(std::move(value).exception());
+      co_return;
+    } else {
+      response->onComplete();
+      co_return;
+    }
+  }
+}
+
+folly::coro::AsyncGenerator<Payload&&> pullRequests(
+    std::shared_ptr<CoroStreamSubscriber> subscriber) {
+  SCOPE_EXIT {
+    subscriber->cancel();
+  };
+  auto token = co_await folly::coro::co_current_cancellation_token;
+  folly::CancellationCallback onCancel(
+      token, [subscriber] { subscriber->cancel(); });
+
+  while (auto item = co_await subscriber->next()) {
+    co_yield std::move(*item);
+  }
+}
+
+/// Cancels the requests of a channel once its responses end, even if the
+/// handler never pulled the requests.
+folly::coro::AsyncGenerator<Payload&&> cancelRequestsAtEnd(
+    folly::coro::AsyncGenerator<Payload&&> responses,
+    std::shared_ptr<CoroStreamSubscriber> requests) {
+  SCOPE_EXIT {
+    requests->cancel();
+  };
+  while (auto item = co_await responses.next()) {
+    co_yield std::move(*item);
+  }
+}
+
+void startResponse(
+    folly::coro::Task<Payload> task,
+    std::shared_ptr<SingleObserver<Payload>> response) {
+  auto subscription = std::make_shared<TaskSubscription>();
+  response->onSubscribe(subscription);
+  pushResponse(std::move(task), subscription->token(), std::move(response))
+      .scheduleOn(&currentEventBase())
+      .start();
+}
+
+} // namespace
+
+folly::coro::Task<Payload> RSocketCoroResponder::handleRequestResponseCo(
+    Payload,
+    StreamId) {
+  co_yield folly::coro::co_error(
+      std::logic_error("handleRequestResponse not implemented"));
+}
+
+folly::coro::AsyncGenerator<Payload&&>
+RSocketCoroResponder::handleRequestStreamCo(Payload, StreamId) {
+  co_yield folly::coro::co_error(
+      std::logic_error("handleRequestStream not implemented"));
+}
+
+folly::coro::AsyncGenerator<Payload&&>
+RSocketCoroResponder::handleRequestChannelCo(
+    Payload,
+    folly::coro::AsyncGenerator<Payload&&>,
+    StreamId) {
+  co_yield folly::coro::co_error(
+      std::logic_error("handleRequestChannel not implemented"));
+}
+
+std::shared_ptr<Single<Payload>> RSocketCoroResponder::handleRequestResponse(
+    Payload request,
+    StreamId streamId) {
+  return Singles::create<Payload>(
+      [task = handleRequestResponseCo(std::move(request), streamId)](
+          std::shared_ptr<SingleObserver<Payload>> observer) mutable {
+        startResponse(std::move(task), std::move(observer));
+      });
+}
+
+std::shared_ptr<Flowable<Payload>> RSocketCoroResponder::handleRequestStream(
+    Payload request,
+    StreamId streamId) {
+  return yarpl::toFlowable(
+      handleRequestStreamCo(std::move(request), streamId),
+      &currentEventBase());
+}
+
+std::shared_ptr<Flowable<Payload>> RSocketCoroResponder::handleRequestChannel(
+    Payload request,
+    std::shared_ptr<Flowable<Payload>> requestStream,
+    StreamId streamId) {
+  auto requests = std::make_shared<CoroStreamSubscriber>(channelBatch_);
+  requestStream->subscribe(requests);
+  auto responses = handleRequestChannelCo(
+      std::move(request), pullRequests(requests), streamId);
+  return yarpl::toFlowable(
+      cancelRequestsAtEnd(std::move(responses), std::move(requests)),
+      &currentEventBase());
+}
+
+std::shared_ptr<Subscriber<Payload>>
+RSocketCoroResponderAdapter::handleRequestChannel(
+    Payload request,
+    StreamId streamId,
+    std::shared_ptr<Subscriber<Payload>> response) noexcept {
+  auto requests =
+      std::make_shared<CoroStreamSubscriber>(inner_->channelBatch());
+  auto responses = inner_->handleRequestChannelCo(
+      std::move(request), pullRequests(requests), streamId);
+
+  auto subscription = std::make_shared<GeneratorSubscription>();
+  response->onSubscribe(subscription);
+  pushStream(
+      cancelRequestsAtEnd(std::move(responses), requests),
+      std::move(subscription),
+      std::move(response))
+      .scheduleOn(&currentEventBase())
+      .start();
+  return requests;
+}
+
+void RSocketCoroResponderAdapter::handleRequestStream(
+    Payload request,
+    StreamId streamId,
+    std::shared_ptr<Subscriber<Payload>> response) noexcept {
+  auto subscription = std::make_shared<GeneratorSubscription>();
+  response->onSubscribe(subscription);
+  pushStream(
+      inner_->handleRequestStreamCo(std::move(request), streamId),
+      std::move(subscription),
+      std::move(response))
+      .scheduleOn(&currentEventBase())
+      .start();
+}
+
+void RSocketCoroResponderAdapter::handleRequestResponse(
+    Payload request,
+    StreamId streamId,
+    std::shared_ptr<SingleObserver<Payload>> response) noexcept {
+  startResponse(
+      inner_->handleRequestResponseCo(std::move(request), streamId),
+      std::move(response));
+}
+
+void RSocketCoroResponderAdapter::handleFireAndForget(
+    Payload request,
+    StreamId streamId) {
+  inner_->handleFireAndForget(std::move(request), streamId);
+}
+
+void RSocketCoroResponderAdapter::handleMetadataPush(
+    std::unique_ptr<folly::IOBuf> buf) {
+  inner_->handleMetadataPush(std::move(buf));
+}
+
+} // namespace rsocket
+
+#endif // FOLLY_HAS_COROUTINES
@@ -0,0 +1,135 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Portability.h>
+
+#if FOLLY_HAS_COROUTINES
+
+#include <folly/experimental/coro/AsyncGenerator.h>
+#include <folly/experimental/coro/Task.h>
+
+#include "rsocket/RSocketResponder.h"
+
+namespace rsocket {
+
+/**
+ * Responder APIs for handlers written as coroutines.
+ *
+ * A request-response handler returns a Task with the response, and stream and
+ * channel handlers return an AsyncGenerator of the responses.  The generator
+ * is pulled on the EventBase of the connection, one element per credit the
+ * requester has granted with REQUEST_N, and a CANCEL from the requester
+ * cancels the pending co_await.
+ *
+ * Handed directly to a client or server, the coroutines are driven by the
+ * stream state machines with no Flowable in between.  When the responder is
+ * wrapped by another one (e.g. when the server runs responders on an
+ * executor), the RSocketResponder methods adapt the coroutines to Flowables
+ * and Singles instead.
+ */
+class RSocketCoroResponder : public RSocketResponder {
+ public:
+  /// `channelBatch` is the number of channel requests buffered ahead of the
+  /// handler pulling them.
+  explicit RSocketCoroResponder(size_t channelBatch = 64)
+      : channelBatch_(channelBatch) {}
+
+  /**
+   * Called when a new `requestResponse` occurs from an RSocketRequester.
+   *
+   * Returns a Task with the response.
+   */
+  virtual folly::coro::Task<Payload> handleRequestResponseCo(
+      Payload request,
+      StreamId streamId);
+
+  /**
+   * Called when a new `requestStream` occurs from an RSocketRequester.
+   *
+   * Returns a generator of the response stream.
+   */
+  virtual folly::coro::AsyncGenerator<Payload&&> handleRequestStreamCo(
+      Payload request,
+      StreamId streamId);
+
+  /**
+   * Called when a new `requestChannel` occurs from an RSocketRequester.
+   *
+   * Returns a generator of the response stream.  Ending the response stream
+   * cancels the requests.
+   */
+  virtual folly::coro::AsyncGenerator<Payload&&> handleRequestChannelCo(
+      Payload request,
+      folly::coro::AsyncGenerator<Payload&&> requests,
+      StreamId streamId);
+
+  std::shared_ptr<yarpl::single::Single<Payload>> handleRequestResponse(
+      Payload request,
+      StreamId streamId) final;
+
+  std::shared_ptr<yarpl::flowable::Flowable<Payload>> handleRequestStream(
+      Payload request,
+      StreamId streamId) final;
+
+  std::shared_ptr<yarpl::flowable::Flowable<Payload>> handleRequestChannel(
+      Payload request,
+      std::shared_ptr<yarpl::flowable::Flowable<Payload>> requestStream,
+      StreamId streamId) final;
+
+  size_t channelBatch() const {
+    return channelBatch_;
+  }
+
+ private:
+  const size_t channelBatch_;
+};
+
+/// Drives the coroutines of an RSocketCoroResponder from the stream state
+/// machines.  Must be called on the EventBase of the connection.
+class RSocketCoroResponderAdapter : public RSocketResponderCore {
+ public:
+  explicit RSocketCoroResponderAdapter(
+      std::shared_ptr<RSocketCoroResponder> inner)
+      : inner_(std::move(inner)) {}
+
+  std::shared_ptr<yarpl::flowable::Subscriber<Payload>> handleRequestChannel(
+      Payload request,
+      StreamId streamId,
+      std::shared_ptr<yarpl::flowable::Subscriber<Payload>>
+          response) noexcept override;
+
+  void handleRequestStream(
+      Payload request,
+      StreamId streamId,
+      std::shared_ptr<yarpl::flowable::Subscriber<Payload>>
+          response) noexcept override;
+
+  void handleRequestResponse(
+      Payload request,
+      StreamId streamId,
+      std::shared_ptr<yarpl::single::SingleObserver<Payload>>
+          response) noexcept override;
+
+  void handleFireAndForget(Payload request, StreamId streamId) override;
+  void handleMetadataPush(std::unique_ptr<folly::IOBuf> buf) override;
+
+ private:
+  const std::shared_ptr<RSocketCoroResponder> inner_;
+};
+
+} // namespace rsocket
+
+#endif // FOLLY_HAS_COROUTINES
@@ -33,4 +33,10 @@ class ResumptionException : public RSocketException {
 class ConnectionException : public RSocketException {
   using RSocketException::RSocketException;
 };
+
+// Fails new requests while the connection holds back too many unsent frames,
+// e.g. during resumption.  The application may retry the request later.
+class OutputBackpressureException : public RSocketException {
+  using RSocketException::RSocketException;
+};
 } // namespace rsocket
@@ -0,0 +1,1085 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/RSocketLoadBalancedClient.h"
+
+#include <folly/Optional.h>
+#include <folly/Random.h>
+#include <folly/executors/InlineExecutor.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <unordered_set>
+
+#include "rsocket/RSocketException.h"
+#include "yarpl/utils/credits.h"
+
+namespace rsocket {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/// A connection of the pool.
+class Member {
+ public:
+  Member(
+      std::string server,
+      std::unique_ptr<RSocketClient> client,
+      double initialLatencyMicros)
+      : server_(std::move(server)),
+        client_(std::move(client)),
+        latencyMicros_(initialLatencyMicros) {}
+
+  const std::string& server() const {
+    return server_;
+  }
+
+  RSocketClient& client() const {
+    return *client_;
+  }
+
+  /// Smoothed latency weighted by the number of outstanding requests.
+  double cost() const {
+    return latencyMicros_.load(std::memory_order_relaxed) *
+        (outstanding_.load(std::memory_order_relaxed) + 1);
+  }
+
+  void addOutstanding() {
+    outstanding_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void removeOutstanding() {
+    outstanding_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  void recordLatency(Clock::duration latency, double smoothing) {
+    auto const sample =
+        std::chrono::duration<double, std::micro>(latency).count();
+    auto current = latencyMicros_.load(std::memory_order_relaxed);
+    while (!latencyMicros_.compare_exchange_weak(
+        current,
+        current + (sample - current) * smoothing,
+        std::memory_order_relaxed)) {
+    }
+  }
+
+ private:
+  const std::string server_;
+  const std::unique_ptr<RSocketClient> client_;
+  std::atomic<uint32_t> outstanding_{0};
+  std::atomic<double> latencyMicros_;
+};
+
+/// The latencies of the latest responses of the pool, from which the delay
+/// before hedging a request is derived.
+class LatencyWindow {
+ public:
+  static constexpr size_t kSize = 1024;
+  /// The percentile is recomputed after every this many responses.
+  static constexpr size_t kRefreshInterval = 64;
+
+  explicit LatencyWindow(double percentile) : percentile_(percentile) {}
+
+  void add(Clock::duration latency) {
+    auto const micros =
+        std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+    auto const n = count_.fetch_add(1, std::memory_order_relaxed);
+    samples_[n % kSize].store(
+        static_cast<uint64_t>(std::max<int64_t>(micros, 0)),
+        std::memory_order_relaxed);
+    if ((n + 1) % kRefreshInterval == 0) {
+      refresh(std::min<size_t>(n + 1, kSize));
+    }
+  }
+
+  /// The percentile of the latencies, or zero until enough responses were
+  /// seen.
+  std::chrono::microseconds percentile() const {
+    return std::chrono::microseconds(
+        percentileMicros_.load(std::memory_order_relaxed));
+  }
+
+ private:
+  void refresh(size_t n) {
+    std::vector<uint64_t> samples(n);
+    for (size_t i = 0; i < n; ++i) {
+      samples[i] = samples_[i].load(std::memory_order_relaxed);
+    }
+    auto const rank = std::min(
+        n - 1, static_cast<size_t>(static_cast<double>(n) * percentile_));
+    std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+    percentileMicros_.store(samples[rank], std::memory_order_relaxed);
+  }
+
+  const double percentile_;
+  std::array<std::atomic<uint64_t>, kSize> samples_{};
+  std::atomic<size_t> count_{0};
+  std::atomic<uint64_t> percentileMicros_{0};
+};
+
+/// Counts a request as outstanding on its member until it terminates, and
+/// feeds the latency of its first response to the member and to the window
+/// of the pool, if it hedges.
+class Tracker {
+ public:
+  Tracker(
+      std::shared_ptr<Member> member,
+      double smoothing,
+      std::shared_ptr<LatencyWindow> window)
+      : member_(std::move(member)),
+        smoothing_(smoothing),
+        window_(std::move(window)),
+        start_(Clock::now()) {
+    member_->addOutstanding();
+  }
+
+  ~Tracker() {
+    onTerminal();
+  }
+
+  void onResponse() {
+    if (!responded_.exchange(true, std::memory_order_relaxed)) {
+      auto const latency = Clock::now() - start_;
+      member_->recordLatency(latency, smoothing_);
+      if (window_) {
+        window_->add(latency);
+      }
+    }
+  }
+
+  void onTerminal() {
+    if (!terminated_.exchange(true, std::memory_order_relaxed)) {
+      member_->removeOutstanding();
+    }
+  }
+
+ private:
+  const std::shared_ptr<Member> member_;
+  const double smoothing_;
+  const std::shared_ptr<LatencyWindow> window_;
+  const Clock::time_point start_;
+  std::atomic<bool> responded_{false};
+  std::atomic<bool> terminated_{false};
+};
+
+class TrackingSingleSubscription : public yarpl::single::SingleSubscription {
+ public:
+  TrackingSingleSubscription(
+      std::shared_ptr<yarpl::single::SingleSubscription> inner,
+      std::shared_ptr<Tracker> tracker)
+      : inner_(std::move(inner)), tracker_(std::move(tracker)) {}
+
+  void cancel() override {
+    tracker_->onTerminal();
+    inner_->cancel();
+  }
+
+ private:
+  const std::shared_ptr<yarpl::single::SingleSubscription> inner_;
+  const std::shared_ptr<Tracker> tracker_;
+};
+
+class TrackingSingleObserver : public yarpl::single::SingleObserver<Payload> {
+ public:
+  TrackingSingleObserver(
+      std::shared_ptr<yarpl::single::SingleObserver<Payload>> inner,
+      std::shared_ptr<Tracker> tracker)
+      : inner_(std::move(inner)), tracker_(std::move(tracker)) {}
+
+  void onSubscribe(std::shared_ptr<yarpl::single::SingleSubscription>
+                       subscription) override {
+    inner_->onSubscribe(std::make_shared<TrackingSingleSubscription>(
+        std::move(subscription), tracker_));
+  }
+
+  void onSuccess(Payload value) override {
+    tracker_->onResponse();
+    tracker_->onTerminal();
+    inner_->onSuccess(std::move(value));
+  }
+
+  void onError(folly::exception_wrapper ex) override {
+    tracker_->onTerminal();
+    inner_->onError(std::move(ex));
+  }
+
+ private:
+  const std::shared_ptr<yarpl::single::SingleObserver<Payload>> inner_;
+  const std::shared_ptr<Tracker> tracker_;
+};
+
+class TrackingSubscription : public yarpl::flowable::Subscription {
+ public:
+  TrackingSubscription(
+      std::shared_ptr<yarpl::flowable::Subscription> inner,
+      std::shared_ptr<Tracker> tracker)
+      : inner_(std::move(inner)), tracker_(std::move(tracker)) {}
+
+  void request(int64_t n) override {
+    inner_->request(n);
+  }
+
+  void cancel() override {
+    tracker_->onTerminal();
+    inner_->cancel();
+  }
+
+ private:
+  const std::shared_ptr<yarpl::flowable::Subscription> inner_;
+  const std::shared_ptr<Tracker> tracker_;
+};
+
+class TrackingSubscriber : public yarpl::flowable::Subscriber<Payload> {
+ public:
+  TrackingSubscriber(
+      std::shared_ptr<yarpl::flowable::Subscriber<Payload>> inner,
+      std::shared_ptr<Tracker> tracker)
+      : inner_(std::move(inner)), tracker_(std::move(tracker)) {}
+
+  void onSubscribe(
+      std::shared_ptr<yarpl::flowable::Subscription> subscription) override {
+    inner_->onSubscribe(std::make_shared<TrackingSubscription>(
+        std::move(subscription), tracker_));
+  }
+
+  void onNext(Payload value) override {
+    tracker_->onResponse();
+    inner_->onNext(std::move(value));
+  }
+
+  void onComplete() override {
+    tracker_->onTerminal();
+    inner_->onComplete();
+  }
+
+  void onError(folly::exception_wrapper ex) override {
+    tracker_->onTerminal();
+    inner_->onError(std::move(ex));
+  }
+
+ private:
+  const std::shared_ptr<yarpl::flowable::Subscriber<Payload>> inner_;
+  const std::shared_ptr<Tracker> tracker_;
+};
+
+folly::exception_wrapper noServerError() {
+  return folly::make_exception_wrapper<ConnectionException>(
+      "No connection to send the request to");
+}
+
+/// A requestResponse() sent on up to two connections, the second one after a
+/// delay.  The first attempt to succeed wins, and the other one is cancelled.
+/// An attempt failing while the other one is in flight is ignored.
+class HedgedSingle : public yarpl::single::SingleSubscription {
+ public:
+  HedgedSingle(
+      std::shared_ptr<yarpl::single::SingleObserver<Payload>> observer,
+      std::shared_ptr<RSocketStats> stats)
+      : observer_(std::move(observer)), stats_(std::move(stats)) {}
+
+  /// Returns false if the request is already done, and the attempt must not
+  /// be sent.
+  bool startAttempt() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (done_) {
+      return false;
+    }
+    ++inFlight_;
+    return true;
+  }
+
+  void onAttemptSubscribe(
+      size_t attempt,
+      std::shared_ptr<yarpl::single::SingleSubscription> subscription) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!done_) {
+        subscriptions_[attempt] = std::move(subscription);
+        return;
+      }
+    }
+    subscription->cancel();
+  }
+
+  void onAttemptSuccess(size_t attempt, Payload value) {
+    std::shared_ptr<yarpl::single::SingleObserver<Payload>> observer;
+    std::shared_ptr<yarpl::single::SingleSubscription> loser;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (done_) {
+        return;
+      }
+      done_ = true;
+      observer = std::move(observer_);
+      loser = std::move(subscriptions_[1 - attempt]);
+      subscriptions_ = {};
+    }
+    if (loser) {
+      loser->cancel();
+    }
+    if (attempt == 1) {
+      stats_->hedgeWon();
+    }
+    observer->onSuccess(std::move(value));
+  }
+
+  void onAttemptError(size_t attempt, folly::exception_wrapper ex) {
+    std::shared_ptr<yarpl::single::SingleObserver<Payload>> observer;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (done_) {
+        return;
+      }
+      subscriptions_[attempt] = nullptr;
+      if (--inFlight_ > 0) {
+        return;
+      }
+      done_ = true;
+      observer = std::move(observer_);
+    }
+    observer->onError(std::move(ex));
+  }
+
+  void cancel() override {
+    decltype(subscriptions_) subscriptions;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      done_ = true;
+      observer_ = nullptr;
+      subscriptions = std::move(subscriptions_);
+    }
+    for (auto& subscription : subscriptions) {
+      if (subscription) {
+        subscription->cancel();
+      }
+    }
+  }
+
+ private:
+  std::mutex mutex_;
+  std::shared_ptr<yarpl::single::SingleObserver<Payload>> observer_;
+  std::array<std::shared_ptr<yarpl::single::SingleSubscription>, 2>
+      subscriptions_;
+  size_t inFlight_{0};
+  bool done_{false};
+  const std::shared_ptr<RSocketStats> stats_;
+};
+
+class HedgeAttemptObserver : public yarpl::single::SingleObserver<Payload> {
+ public:
+  HedgeAttemptObserver(std::shared_ptr<HedgedSingle> hedged, size_t attempt)
+      : hedged_(std::move(hedged)), attempt_(attempt) {}
+
+  void onSubscribe(std::shared_ptr<yarpl::single::SingleSubscription>
+                       subscription) override {
+    hedged_->onAttemptSubscribe(attempt_, std::move(subscription));
+  }
+
+  void onSuccess(Payload value) override {
+    hedged_->onAttemptSuccess(attempt_, std::move(value));
+  }
+
+  void onError(folly::exception_wrapper ex) override {
+    hedged_->onAttemptError(attempt_, std::move(ex));
+  }
+
+ private:
+  const std::shared_ptr<HedgedSingle> hedged_;
+  const size_t attempt_;
+};
+
+/// A requestStream() sent on up to two connections, the second one after a
+/// delay.  The attempt whose first element or completion comes first wins,
+/// and the other one is cancelled.  Until then, the elements requested from
+/// the stream are requested from both attempts.
+class HedgedStream : public yarpl::flowable::Subscription {
+ public:
+  HedgedStream(
+      std::shared_ptr<yarpl::flowable::Subscriber<Payload>> subscriber,
+      std::shared_ptr<RSocketStats> stats)
+      : subscriber_(std::move(subscriber)), stats_(std::move(stats)) {}
+
+  /// Returns false if the stream is already done or decided, and the attempt
+  /// must not be sent.
+  bool startAttempt() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (done_ || winner_ >= 0) {
+      return false;
+    }
+    ++inFlight_;
+    return true;
+  }
+
+  void onAttemptSubscribe(
+      size_t attempt,
+      std::shared_ptr<yarpl::flowable::Subscription> subscription) {
+    int64_t requested;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!done_ && (winner_ < 0 || winner_ == static_cast<int>(attempt))) {
+        subscriptions_[attempt] = subscription;
+        requested = requested_;
+      } else {
+        requested = -1;
+      }
+    }
+    if (requested < 0) {
+      subscription->cancel();
+    } else if (requested > 0) {
+      subscription->request(requested);
+    }
+  }
+
+  void onAttemptNext(size_t attempt, Payload value) {
+    std::shared_ptr<yarpl::flowable::Subscriber<Payload>> subscriber;
+    std::shared_ptr<yarpl::flowable::Subscription> loser;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (done_ || !decide(attempt, loser)) {
+        return;
+      }
+      subscriber = subscriber_;
+    }
+    if (loser) {
+      loser->cancel();
+    }
+    subscriber->onNext(std::move(value));
+  }
+
+  void onAttemptComplete(size_t attempt) {
+    std::shared_ptr<yarpl::flowable::Subscriber<Payload>> subscriber;
+    std::shared_ptr<yarpl::flowable::Subscription> loser;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (done_ || !decide(attempt, loser)) {
+        return;
+      }
+      done_ = true;
+      subscriber = std::move(subscriber_);
+      subscriptions_ = {};
+    }
+    if (loser) {
+      loser->cancel();
+    }
+    subscriber->onComplete();
+  }
+
+  void onAttemptError(size_t attempt, folly::exception_wrapper ex) {
+    std::shared_ptr<yarpl::flowable::Subscriber<Payload>> subscriber;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (done_ ||
+          (winner_ >= 0 && winner_ != static_cast<int>(attempt))) {
+        return;
+      }
+      subscriptions_[attempt] = nullptr;
+      if (winner_ < 0 && --inFlight_ > 0) {
+        return;
+      }
+      done_ = true;
+      subscriber = std::move(subscriber_);
+      subscriptions_ = {};
+    }
+    subscriber->onError(std::move(ex));
+  }
+
+  void request(int64_t n) override {
+    decltype(subscriptions_) subscriptions;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (done_) {
+        return;
+      }
+      requested_ = yarpl::credits::add(requested_, n);
+      subscriptions = subscriptions_;
+    }
+    for (auto& subscription : subscriptions) {
+      if (subscription) {
+        subscription->request(n);
+      }
+    }
+  }
+
+  void cancel() override {
+    decltype(subscriptions_) subscriptions;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      done_ = true;
+      subscriber_ = nullptr;
+      subscriptions = std::move(subscriptions_);
+    }
+    for (auto& subscription : subscriptions) {
+      if (subscription) {
+        subscription->cancel();
+      }
+    }
+  }
+
+ private:
+  /// Makes `attempt` the winner if there is none yet.  Returns false if the
+  /// other attempt won.  Must hold mutex_.
+  bool decide(
+      size_t attempt,
+      std::shared_ptr<yarpl::flowable::Subscription>& loser) {
+    if (winner_ >= 0) {
+      return winner_ == static_cast<int>(attempt);
+    }
+    winner_ = static_cast<int>(attempt);
+    loser = std::move(subscriptions_[1 - attempt]);
+    if (attempt == 1) {
+      stats_->hedgeWon();
+    }
+    return true;
+  }
+
+  std::mutex mutex_;
+  std::shared_ptr<yarpl::flowable::Subscriber<Payload>> subscriber_;
+  std::array<std::shared_ptr<yarpl::flowable::Subscription>, 2>
+      subscriptions_;
+  int64_t requested_{0};
+  size_t inFlight_{0};
+  int winner_{-1};
+  bool done_{false};
+  const std::shared_ptr<RSocketStats> stats_;
+};
+
+class HedgeAttemptSubscriber : public yarpl::flowable::Subscriber<Payload> {
+ public:
+  HedgeAttemptSubscriber(std::shared_ptr<HedgedStream> hedged, size_t attempt)
+      : hedged_(std::move(hedged)), attempt_(attempt) {}
+
+  void onSubscribe(
+      std::shared_ptr<yarpl::flowable::Subscription> subscription) override {
+    hedged_->onAttemptSubscribe(attempt_, std::move(subscription));
+  }
+
+  void onNext(Payload value) override {
+    hedged_->onAttemptNext(attempt_, std::move(value));
+  }
+
+  void onComplete() override {
+    hedged_->onAttemptComplete(attempt_);
+  }
+
+  void onError(folly::exception_wrapper ex) override {
+    hedged_->onAttemptError(attempt_, std::move(ex));
+  }
+
+ private:
+  const std::shared_ptr<HedgedStream> hedged_;
+  const size_t attempt_;
+};
+
+} // namespace
+
+class RSocketLoadBalancedClient::Pool
+    : public std::enable_shared_from_this<Pool> {
+ public:
+  using Members = std::vector<std::shared_ptr<Member>>;
+
+  Pool(ClientFactory factory, Options options)
+      : factory_(std::move(factory)),
+        options_(std::move(options)),
+        window_(
+            options_.hedgePercentile > 0
+                ? std::make_shared<LatencyWindow>(options_.hedgePercentile)
+                : nullptr) {}
+
+  bool hedges() const {
+    return window_ != nullptr;
+  }
+
+  RSocketStats& stats() const {
+    return *options_.stats;
+  }
+
+  const std::shared_ptr<RSocketStats>& sharedStats() const {
+    return options_.stats;
+  }
+
+  /// Delay after which a request is hedged, or zero if it must not be.
+  std::chrono::microseconds hedgeDelay() const {
+    auto const delay = window_->percentile();
+    if (delay.count() == 0) {
+      return delay;
+    }
+    return std::max(delay, options_.minHedgeDelay);
+  }
+
+  /// Starts tracking a request sent to the member.
+  std::shared_ptr<Tracker> track(std::shared_ptr<Member> member) const {
+    return std::make_shared<Tracker>(
+        std::move(member), options_.latencySmoothing, window_);
+  }
+
+  /// Picks the cheaper of two random members, other than `exclude`.  Returns
+  /// nullptr if there is no such member.
+  std::shared_ptr<Member> pick(const Member* exclude = nullptr) const {
+    auto const members = snapshot();
+    auto n = members->size();
+    auto excluded = n;
+    if (exclude) {
+      for (size_t i = 0; i < members->size(); ++i) {
+        if ((*members)[i].get() == exclude) {
+          excluded = i;
+          --n;
+          break;
+        }
+      }
+    }
+    // Maps an index among the candidates to one among the members.
+    auto const at = [&](size_t i) -> const std::shared_ptr<Member>& {
+      return (*members)[i >= excluded ? i + 1 : i];
+    };
+
+    if (n == 0) {
+      return nullptr;
+    }
+    if (n == 1) {
+      return at(0);
+    }
+    auto const first = folly::Random::rand32(n);
+    auto second = folly::Random::rand32(n - 1);
+    if (second >= first) {
+      ++second;
+    }
+    auto& a = at(first);
+    auto& b = at(second);
+    return a->cost() <= b->cost() ? a : b;
+  }
+
+  std::shared_ptr<const Members> snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return members_;
+  }
+
+  void setServers(std::vector<std::string> servers) {
+    std::vector<std::string> added;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      std::unordered_set<std::string> wanted(servers.begin(), servers.end());
+      for (auto& server : wanted) {
+        if (!servers_.count(server)) {
+          added.push_back(server);
+        }
+      }
+
+      auto members = std::make_shared<Members>();
+      for (auto& member : *members_) {
+        if (wanted.count(member->server())) {
+          members->push_back(member);
+        }
+      }
+      members_ = std::move(members);
+      servers_ = std::move(wanted);
+    }
+
+    for (auto& server : added) {
+      connect(std::move(server));
+    }
+  }
+
+ private:
+  void connect(std::string server) {
+    VLOG(2) << "Connecting to " << server;
+    factory_(server)
+        .via(&folly::InlineExecutor::instance())
+        .thenTry([weakPool = std::weak_ptr<Pool>(shared_from_this()),
+                  server](folly::Try<std::unique_ptr<RSocketClient>>&& client) {
+          if (auto pool = weakPool.lock()) {
+            pool->onConnected(server, std::move(client));
+          }
+        });
+  }
+
+  void onConnected(
+      const std::string& server,
+      folly::Try<std::unique_ptr<RSocketClient>>&& client) {
+    std::shared_ptr<Member> member;
+    if (client.hasValue() && client.value()) {
+      auto const initialLatency =
+          std::chrono::duration<double, std::micro>(options_.initialLatency);
+      member = std::make_shared<Member>(
+          server, std::move(client.value()), initialLatency.count());
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!servers_.count(server)) {
+      VLOG(2) << server << " was removed while connecting to it";
+      return;
+    }
+    if (!member) {
+      LOG(WARNING) << "Failed to connect to " << server << ", dropping it: "
+                   << (client.hasException() ? client.exception().what()
+                                             : "no client");
+      servers_.erase(server);
+      return;
+    }
+    auto members = std::make_shared<Members>(*members_);
+    members->push_back(std::move(member));
+    members_ = std::move(members);
+  }
+
+  const ClientFactory factory_;
+  const Options options_;
+  /// Recent latencies of the pool, if it hedges requests.
+  const std::shared_ptr<LatencyWindow> window_;
+
+  mutable std::mutex mutex_;
+  /// Servers of the list, connected or not.
+  std::unordered_set<std::string> servers_;
+  /// Connected members, replaced as a whole whenever they change, so that
+  /// requests can pick from a snapshot.
+  std::shared_ptr<const Members> members_{std::make_shared<const Members>()};
+};
+
+/// Picks a member of the pool for every request.
+class RSocketLoadBalancedClient::Requester : public RSocketRequester {
+ public:
+  using Derive = std::function<std::shared_ptr<RSocketRequester>(
+      const std::shared_ptr<RSocketRequester>&)>;
+
+  Requester(std::shared_ptr<Pool> pool, Derive derive)
+      : RSocketRequester(nullptr, std::shared_ptr<SwappableEventBase>()),
+        pool_(std::move(pool)),
+        derive_(std::move(derive)) {}
+
+  using RSocketRequester::requestChannel;
+
+  std::shared_ptr<yarpl::flowable::Flowable<Payload>> requestStream(
+      Payload request) override {
+    return yarpl::flowable::internal::flowableFromSubscriber<Payload>(
+        [pool = pool_, derive = derive_, request = std::move(request)](
+            std::shared_ptr<yarpl::flowable::Subscriber<Payload>>
+                subscriber) mutable {
+          auto member = pool->pick();
+          if (!member) {
+            yarpl::flowable::Flowable<Payload>::error(noServerError())
+                ->subscribe(std::move(subscriber));
+            return;
+          }
+          if (pool->hedges()) {
+            hedgeStream(
+                std::move(pool),
+                std::move(derive),
+                std::move(member),
+                std::move(request),
+                std::move(subscriber));
+            return;
+          }
+          auto tracker = pool->track(member);
+          requesterOf(derive, *member)
+              ->requestStream(std::move(request))
+              ->subscribe(std::make_shared<TrackingSubscriber>(
+                  std::move(subscriber), std::move(tracker)));
+        });
+  }
+
+  std::shared_ptr<yarpl::single::Single<Payload>> requestResponse(
+      Payload request) override {
+    return yarpl::single::Singles::create<Payload>(
+        [pool = pool_, derive = derive_, request = std::move(request)](
+            std::shared_ptr<yarpl::single::SingleObserver<Payload>>
+                observer) mutable {
+          auto member = pool->pick();
+          if (!member) {
+            yarpl::single::Singles::error<Payload>(noServerError())
+                ->subscribe(std::move(observer));
+            return;
+          }
+          if (pool->hedges()) {
+            hedgeResponse(
+                std::move(pool),
+                std::move(derive),
+                std::move(member),
+                std::move(request),
+                std::move(observer));
+            return;
+          }
+          auto tracker = pool->track(member);
+          requesterOf(derive, *member)
+              ->requestResponse(std::move(request))
+              ->subscribe(std::make_shared<TrackingSingleObserver>(
+                  std::move(observer), std::move(tracker)));
+        });
+  }
+
+  folly::SemiFuture<Payload> requestResponseFuture(Payload request) override {
+    auto member = pool_->pick();
+    if (!member) {
+      return folly::makeSemiFuture<Payload>(noServerError());
+    }
+    auto tracker = pool_->track(member);
+    return requesterOf(derive_, *member)
+        ->requestResponseFuture(std::move(request))
+        .via(&folly::InlineExecutor::instance())
+        .thenTry([tracker = std::move(tracker)](folly::Try<Payload>&& t) {
+          if (t.hasValue()) {
+            tracker->onResponse();
+          }
+          tracker->onTerminal();
+          return std::move(t);
+        })
+        .semi();
+  }
+
+  std::shared_ptr<yarpl::single::Single<void>> fireAndForget(
+      Payload request) override {
+    if (auto member = pool_->pick()) {
+      return requesterOf(derive_, *member)->fireAndForget(std::move(request));
+    }
+    return yarpl::single::Singles::error<void>(noServerError());
+  }
+
+  void fireAndForgetBatch(std::vector<Payload> requests) override {
+    if (auto member = pool_->pick()) {
+      requesterOf(derive_, *member)->fireAndForgetBatch(std::move(requests));
+    } else {
+      VLOG(1) << "Dropping " << requests.size()
+              << " fire-and-forget requests, no connection to send them to";
+    }
+  }
+
+  /// Pushes the metadata on every connection.
+  void metadataPush(std::unique_ptr<folly::IOBuf> metadata) override {
+    for (auto& member : *pool_->snapshot()) {
+      requesterOf(derive_, *member)->metadataPush(metadata->clone());
+    }
+  }
+
+  /// Closes every connection of the pool.
+  void closeSocket() override {
+    for (auto& member : *pool_->snapshot()) {
+      member->client().getRequester()->closeSocket();
+    }
+  }
+
+  std::shared_ptr<RSocketRequester> withOutputWeight(uint32_t weight) override {
+    return derived([weight](const std::shared_ptr<RSocketRequester>& r) {
+      return r->withOutputWeight(weight);
+    });
+  }
+
+  std::shared_ptr<RSocketRequester> withoutResumption() override {
+    return derived([](const std::shared_ptr<RSocketRequester>& r) {
+      return r->withoutResumption();
+    });
+  }
+
+  std::shared_ptr<RSocketRequester> withDeadline(
+      RequestDeadline::Clock::time_point deadline) override {
+    return derived([deadline](const std::shared_ptr<RSocketRequester>& r) {
+      return r->withDeadline(deadline);
+    });
+  }
+
+  std::shared_ptr<RSocketRequester> withBulkTraffic() override {
+    return derived([](const std::shared_ptr<RSocketRequester>& r) {
+      return r->withBulkTraffic();
+    });
+  }
+
+ protected:
+  std::shared_ptr<yarpl::flowable::Flowable<Payload>> requestChannel(
+      Payload request,
+      bool hasInitialRequest,
+      std::shared_ptr<yarpl::flowable::Flowable<Payload>> requests) override {
+    return yarpl::flowable::internal::flowableFromSubscriber<Payload>(
+        [pool = pool_,
+         derive = derive_,
+         request = std::move(request),
+         hasInitialRequest,
+         requests = std::move(requests)](
+            std::shared_ptr<yarpl::flowable::Subscriber<Payload>>
+                subscriber) mutable {
+          auto member = pool->pick();
+          if (!member) {
+            yarpl::flowable::Flowable<Payload>::error(noServerError())
+                ->subscribe(std::move(subscriber));
+            return;
+          }
+          auto tracker = pool->track(member);
+          auto requester = requesterOf(derive, *member);
+          auto responses = hasInitialRequest
+              ? requester->requestChannel(
+                    std::move(request), std::move(requests))
+              : requester->requestChannel(std::move(requests));
+          responses->subscribe(std::make_shared<TrackingSubscriber>(
+              std::move(subscriber), std::move(tracker)));
+        });
+  }
+
+ private:
+  static void hedgeResponse(
+      std::shared_ptr<Pool> pool,
+      Derive derive,
+      std::shared_ptr<Member> primary,
+      Payload request,
+      std::shared_ptr<yarpl::single::SingleObserver<Payload>> observer) {
+    auto hedged = std::make_shared<HedgedSingle>(observer, pool->sharedStats());
+    observer->onSubscribe(hedged);
+    pool->stats().hedgeableRequest();
+
+    // Hedging starts once the pool has seen enough responses to know its
+    // latencies.
+    auto const delay = pool->hedgeDelay();
+    folly::Optional<Payload> backup;
+    if (delay.count() > 0) {
+      backup = request.clone();
+    }
+    sendResponseAttempt(*pool, derive, primary, std::move(request), hedged, 0);
+    if (!backup) {
+      return;
+    }
+    folly::futures::sleep(delay)
+        .via(&folly::InlineExecutor::instance())
+        .thenValue([pool = std::move(pool),
+                    derive = std::move(derive),
+                    primary = std::move(primary),
+                    hedged = std::move(hedged),
+                    backup = std::move(*backup)](folly::Unit) mutable {
+          if (auto member = pool->pick(primary.get())) {
+            sendResponseAttempt(
+                *pool, derive, member, std::move(backup), hedged, 1);
+          }
+        });
+  }
+
+  static void sendResponseAttempt(
+      const Pool& pool,
+      const Derive& derive,
+      const std::shared_ptr<Member>& member,
+      Payload request,
+      const std::shared_ptr<HedgedSingle>& hedged,
+      size_t attempt) {
+    if (!hedged->startAttempt()) {
+      return;
+    }
+    if (attempt > 0) {
+      pool.stats().hedgeSent();
+    }
+    requesterOf(derive, *member)
+        ->requestResponse(std::move(request))
+        ->subscribe(std::make_shared<TrackingSingleObserver>(
+            std::make_shared<HedgeAttemptObserver>(hedged, attempt),
+            pool.track(member)));
+  }
+
+  static void hedgeStream(
+      std::shared_ptr<Pool> pool,
+      Derive derive,
+      std::shared_ptr<Member> primary,
+      Payload request,
+      std::shared_ptr<yarpl::flowable::Subscriber<Payload>> subscriber) {
+    auto hedged =
+        std::make_shared<HedgedStream>(subscriber, pool->sharedStats());
+    subscriber->onSubscribe(hedged);
+    pool->stats().hedgeableRequest();
+
+    auto const delay = pool->hedgeDelay();
+    folly::Optional<Payload> backup;
+    if (delay.count() > 0) {
+      backup = request.clone();
+    }
+    sendStreamAttempt(*pool, derive, primary, std::move(request), hedged, 0);
+    if (!backup) {
+      return;
+    }
+    folly::futures::sleep(delay)
+        .via(&folly::InlineExecutor::instance())
+        .thenValue([pool = std::move(pool),
+                    derive = std::move(derive),
+                    primary = std::move(primary),
+                    hedged = std::move(hedged),
+                    backup = std::move(*backup)](folly::Unit) mutable {
+          if (auto member = pool->pick(primary.get())) {
+            sendStreamAttempt(
+                *pool, derive, member, std::move(backup), hedged, 1);
+          }
+        });
+  }
+
+  static void sendStreamAttempt(
+      const Pool& pool,
+      const Derive& derive,
+      const std::shared_ptr<Member>& member,
+      Payload request,
+      const std::shared_ptr<HedgedStream>& hedged,
+      size_t attempt) {
+    if (!hedged->startAttempt()) {
+      return;
+    }
+    if (attempt > 0) {
+      pool.stats().hedgeSent();
+    }
+    requesterOf(derive, *member)
+        ->requestStream(std::move(request))
+        ->subscribe(std::make_shared<TrackingSubscriber>(
+            std::make_shared<HedgeAttemptSubscriber>(hedged, attempt),
+            pool.track(member)));
+  }
+
+  static std::shared_ptr<RSocketRequester> requesterOf(
+      const Derive& derive,
+      const Member& member) {
+    auto& requester = member.client().getRequester();
+    return derive ? derive(requester) : requester;
+  }
+
+  std::shared_ptr<RSocketRequester> derived(Derive derive) const {
+    if (derive_) {
+      derive = [outer = std::move(derive), inner = derive_](
+                   const std::shared_ptr<RSocketRequester>& r) {
+        return outer(inner(r));
+      };
+    }
+    return std::make_shared<Requester>(pool_, std::move(derive));
+  }
+
+  const std::shared_ptr<Pool> pool_;
+  /// Applied to the requester of the picked member, e.g. to give the
+  /// request an output weight.
+  const Derive derive_;
+};
+
+RSocketLoadBalancedClient::RSocketLoadBalancedClient(ClientFactory factory)
+    : RSocketLoadBalancedClient(std::move(factory), Options()) {}
+
+RSocketLoadBalancedClient::RSocketLoadBalancedClient(
+    ClientFactory factory,
+    Options options)
+    : pool_(std::make_shared<Pool>(std::move(factory), std::move(options))),
+      requester_(std::make_shared<Requester>(pool_, nullptr)) {}
+
+RSocketLoadBalancedClient::~RSocketLoadBalancedClient() {
+  VLOG(3) << "~RSocketLoadBalancedClient ..";
+}
+
+const std::shared_ptr<RSocketRequester>&
+RSocketLoadBalancedClient::getRequester() const {
+  return requester_;
+}
+
+void RSocketLoadBalancedClient::setServers(std::vector<std::string> servers) {
+  pool_->setServers(std::move(servers));
+}
+
+size_t RSocketLoadBalancedClient::getNumConnections() const {
+  return pool_->snapshot()->size();
+}
+
+} // namespace rsocket
@@ -0,0 +1,116 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/futures/Future.h>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rsocket/RSocketClient.h"
+#include "rsocket/RSocketRequester.h"
+#include "rsocket/RSocketStats.h"
+
+namespace rsocket {
+
+/**
+ * API for spreading requests over connections to many servers.
+ *
+ * Keeps an RSocketClient connected to each server of a list that can change
+ * at any time, and sends each request to one of them, picked with the
+ * power-of-two-choices: of two random connections, the one with the lower
+ * cost, i.e. the smoothed latency of its server weighted by the number of
+ * its outstanding requests.
+ *
+ * The requests are sent through getRequester(), which picks a connection at
+ * the time the request would be sent on a single connection, e.g. on
+ * subscribe for requestResponse().
+ *
+ * Optionally, requestResponse() and requestStream() are hedged: when the
+ * connection picked hasn't responded within a percentile of the latencies of
+ * the pool, a backup of the request is sent on another connection.  The
+ * first to respond wins, and the other request is cancelled.  For a stream,
+ * the race ends at its first element.
+ */
+class RSocketLoadBalancedClient {
+ public:
+  /// Connects to a server of the list.
+  using ClientFactory =
+      std::function<folly::Future<std::unique_ptr<RSocketClient>>(
+          const std::string& server)>;
+
+  struct Options {
+    /// Weight of the latest response in the smoothed latency of a server,
+    /// between 0 and 1.
+    double latencySmoothing{0.2};
+
+    /// Latency assumed for a server until it responds to a first request.
+    std::chrono::microseconds initialLatency{std::chrono::milliseconds(1)};
+
+    /// Percentile of the recent latencies of the pool after which a request
+    /// is hedged, between 0 and 1, e.g. 0.95.  0 disables hedging.
+    double hedgePercentile{0};
+
+    /// Lower bound of the delay before a request is hedged.
+    std::chrono::microseconds minHedgeDelay{std::chrono::milliseconds(1)};
+
+    /// Told about the requests that are hedged, and the hedges that win.
+    std::shared_ptr<RSocketStats> stats{RSocketStats::noop()};
+  };
+
+  explicit RSocketLoadBalancedClient(ClientFactory factory);
+  RSocketLoadBalancedClient(ClientFactory factory, Options options);
+  ~RSocketLoadBalancedClient();
+
+  RSocketLoadBalancedClient(const RSocketLoadBalancedClient&) = delete;
+  RSocketLoadBalancedClient(RSocketLoadBalancedClient&&) = delete;
+  RSocketLoadBalancedClient& operator=(const RSocketLoadBalancedClient&) =
+      delete;
+  RSocketLoadBalancedClient& operator=(RSocketLoadBalancedClient&&) = delete;
+
+  /**
+   * Returns the requester sending requests over the pool.  Requests fail
+   * with a ConnectionException while no connection is up.
+   */
+  const std::shared_ptr<RSocketRequester>& getRequester() const;
+
+  /**
+   * Replaces the list of servers.  Connects to the servers that are new to
+   * the list, and stops sending requests to the connections of the servers
+   * that are no longer in it.  Those are closed once their outstanding
+   * requests are done.
+   *
+   * A server whose connection fails is dropped from the list, until the
+   * next call to setServers() with it.
+   */
+  void setServers(std::vector<std::string> servers);
+
+  /**
+   * Number of connections requests are sent to.
+   */
+  size_t getNumConnections() const;
+
+ private:
+  class Pool;
+  class Requester;
+
+  const std::shared_ptr<Pool> pool_;
+  const std::shared_ptr<RSocketRequester> requester_;
+};
+
+} // namespace rsocket
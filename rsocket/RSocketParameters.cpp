@@ -24,6 +24,10 @@ std::ostream& operator<<(
             << " dataMimeType: " << setupPayload.dataMimeType
             << " payload: " << setupPayload.payload
             << " token: " << setupPayload.token
-            << " resumable: " << setupPayload.resumable;
+            << " resumable: " << setupPayload.resumable
+            << " honorLease: " << setupPayload.honorLease
+            << " byteCredit: " << setupPayload.byteCredit
+            << " frameChecksum: " << setupPayload.frameChecksum
+            << " capacityHints: " << setupPayload.capacityHints;
 }
 } // namespace rsocket
@@ -21,6 +21,7 @@
 
 #include "rsocket/Payload.h"
 #include "rsocket/framing/Frame.h"
+#include "rsocket/internal/CapacityHints.h"
 
 namespace rsocket {
 
@@ -56,6 +57,32 @@ class SetupParameters : public RSocketParameters {
   std::string dataMimeType;
   Payload payload;
   ResumeIdentificationToken token;
+
+  /// Name of the codec payload data is compressed with ("zstd" or "lz4"), or
+  /// empty for no compression.  See PayloadCompressor.
+  std::string payloadCompression;
+
+  /// Byte credit each stream starts with in each direction, for byte-based
+  /// flow control on top of REQUEST_N, or zero to only count payloads.  See
+  /// ByteCredit.
+  size_t byteCredit{0};
+
+  /// Name of the checksum ending every frame ("crc32c"), or empty for none.
+  /// See FrameChecksums.
+  std::string frameChecksum;
+
+  /// Sizes the server should preallocate the connection for.  See
+  /// CapacityHints.
+  CapacityHints capacityHints;
+
+  /// Whether the client honors leases granted by the server.  The client then
+  /// only sends requests allowed by a lease.  See LeaseSender.
+  bool honorLease{false};
+
+  /// Client only, not sent to the server.  Number of requests held back until
+  /// the server grants a lease, when honoring leases.  Requests beyond that,
+  /// and channels, fail immediately when there is no lease.
+  size_t maxRequestsAwaitingLease{0};
 };
 
 std::ostream& operator<<(std::ostream&, const SetupParameters&);
@@ -15,11 +15,19 @@
 #include "rsocket/RSocketRequester.h"
 
 #include <folly/ExceptionWrapper.h>
+#include <folly/ScopeGuard.h>
+#if FOLLY_HAS_COROUTINES
+#include <folly/experimental/coro/CurrentExecutor.h>
+#endif
 
+#include "rsocket/internal/CoroStreamSubscriber.h"
 #include "rsocket/internal/ScheduledSingleObserver.h"
 #include "rsocket/internal/ScheduledSubscriber.h"
 #include "yarpl/Flowable.h"
 #include "yarpl/single/SingleSubscriptions.h"
+#if FOLLY_HAS_COROUTINES
+#include "yarpl/flowable/AsyncGeneratorShim.h"
+#endif
 
 using namespace folly;
 
@@ -28,30 +36,128 @@ namespace rsocket {
 namespace {
 
 template <class Fn>
-void runOnCorrectThread(folly::EventBase& evb, Fn fn) {
-  if (evb.isInEventBaseThread()) {
-    fn();
+void runOnCorrectThread(SwappableEventBase& evb, Fn fn) {
+  if (auto const current = evb.getEventBaseIfInThread()) {
+    fn(*current);
   } else {
     evb.runInEventBaseThread(std::move(fn));
   }
 }
 
+#if FOLLY_HAS_COROUTINES
+folly::coro::AsyncGenerator<Payload&&> pullStream(
+    std::shared_ptr<yarpl::flowable::Flowable<Payload>> flowable,
+    size_t batch) {
+  auto subscriber = std::make_shared<CoroStreamSubscriber>(batch);
+  SCOPE_EXIT {
+    subscriber->cancel();
+  };
+  auto token = co_await folly::coro::co_current_cancellation_token;
+  folly::CancellationCallback onCancel(
+      token, [subscriber] { subscriber->cancel(); });
+
+  flowable->subscribe(subscriber);
+  while (auto item = co_await subscriber->next()) {
+    co_yield std::move(*item);
+  }
+  if (token.isCancellationRequested()) {
+    co_yield folly::coro::co_error(folly::OperationCancelled{});
+  }
+}
+#endif
+
 } // namespace
 
 RSocketRequester::RSocketRequester(
     std::shared_ptr<RSocketStateMachine> srs,
     EventBase& eventBase)
-    : stateMachine_{std::move(srs)}, eventBase_{&eventBase} {}
+    : RSocketRequester(
+          std::move(srs),
+          std::make_shared<SwappableEventBase>(eventBase)) {
+  bulk_ = std::make_shared<
+      folly::Synchronized<std::shared_ptr<RSocketRequester>>>();
+}
+
+RSocketRequester::RSocketRequester(
+    std::shared_ptr<RSocketStateMachine> srs,
+    std::shared_ptr<SwappableEventBase> eventBase)
+    : stateMachine_{std::move(srs)}, eventBase_{std::move(eventBase)} {}
 
 RSocketRequester::~RSocketRequester() {
   VLOG(1) << "Destroying RSocketRequester";
 }
 
 void RSocketRequester::closeSocket() {
-  eventBase_->runInEventBaseThread([stateMachine = std::move(stateMachine_)] {
-    VLOG(2) << "Closing RSocketStateMachine on EventBase";
-    stateMachine->close({}, StreamCompletionSignal::SOCKET_CLOSED);
-  });
+  eventBase_->runInEventBaseThread(
+      [stateMachine = std::move(stateMachine_)](folly::EventBase&) {
+        VLOG(2) << "Closing RSocketStateMachine on EventBase";
+        stateMachine->close({}, StreamCompletionSignal::SOCKET_CLOSED);
+      });
+}
+
+void RSocketRequester::setEventBase(folly::EventBase& eventBase) {
+  eventBase_->setEventBase(eventBase);
+}
+
+bool RSocketRequester::trySetEventBase(
+    folly::EventBase& eventBase,
+    folly::Function<void(folly::EventBase&)> first) {
+  return eventBase_->trySetEventBase(eventBase, std::move(first));
+}
+
+std::shared_ptr<RSocketRequester> RSocketRequester::derive() const {
+  CHECK(stateMachine_);
+  auto requester = std::shared_ptr<RSocketRequester>(
+      new RSocketRequester(stateMachine_, eventBase_));
+  requester->outputWeight_ = outputWeight_;
+  requester->resumable_ = resumable_;
+  requester->deadline_ = deadline_;
+  requester->requestBatching_ = requestBatching_;
+  requester->bulk_ = bulk_;
+  return requester;
+}
+
+std::shared_ptr<RSocketRequester> RSocketRequester::withOutputWeight(
+    uint32_t weight) {
+  auto requester = derive();
+  requester->outputWeight_ = weight;
+  return requester;
+}
+
+std::shared_ptr<RSocketRequester> RSocketRequester::withoutResumption() {
+  auto requester = derive();
+  requester->resumable_ = false;
+  return requester;
+}
+
+std::shared_ptr<RSocketRequester> RSocketRequester::withDeadline(
+    RequestDeadline::Clock::time_point deadline) {
+  auto requester = derive();
+  requester->deadline_ = deadline;
+  return requester;
+}
+
+std::shared_ptr<RSocketRequester> RSocketRequester::withRequestBatching(
+    RequestBatchingOptions options) {
+  auto requester = derive();
+  requester->requestBatching_ = options;
+  return requester;
+}
+
+std::shared_ptr<RSocketRequester> RSocketRequester::withBulkTraffic() {
+  auto requester = derive();
+  if (auto bulk = bulk_ ? bulk_->copy() : nullptr) {
+    requester->stateMachine_ = bulk->stateMachine_;
+    requester->eventBase_ = bulk->eventBase_;
+    requester->bulk_ = bulk->bulk_;
+  }
+  return requester;
+}
+
+void RSocketRequester::setBulkRequester(
+    std::shared_ptr<RSocketRequester> bulk) {
+  CHECK(bulk_) << "The requester can't have a bulk connection";
+  *bulk_->wlock() = std::move(bulk);
 }
 
 std::shared_ptr<yarpl::flowable::Flowable<rsocket::Payload>>
@@ -82,19 +188,30 @@ RSocketRequester::requestChannel(
        req = std::move(request),
        hasInitialRequest,
        requestStream = std::move(requestStreamFlowable),
-       srs = stateMachine_](
+       srs = stateMachine_,
+       weight = outputWeight_,
+       resumable = resumable_,
+       deadline = deadline_](
           std::shared_ptr<yarpl::flowable::Subscriber<Payload>> subscriber) {
-        auto lambda = [eb,
-                       r = req.clone(),
+        auto lambda = [r = req.clone(),
                        hasInitialRequest,
                        requestStream,
                        srs,
-                       subs = std::move(subscriber)]() mutable {
+                       weight,
+                       resumable,
+                       deadline,
+                       subs = std::move(subscriber)](
+                          folly::EventBase& evb) mutable {
           auto scheduled =
               std::make_shared<ScheduledSubscriptionSubscriber<Payload>>(
-                  std::move(subs), *eb);
+                  std::move(subs), evb);
           auto responseSink = srs->requestChannel(
-              std::move(r), hasInitialRequest, std::move(scheduled));
+              std::move(r),
+              hasInitialRequest,
+              std::move(scheduled),
+              weight,
+              resumable,
+              deadline);
           // responseSink is wrapped with thread scheduling
           // so all emissions happen on the right thread.
 
@@ -104,7 +221,7 @@ RSocketRequester::requestChannel(
           if (responseSink) {
             auto scheduledResponse =
                 std::make_shared<ScheduledSubscriber<Payload>>(
-                    std::move(responseSink), *eb);
+                    std::move(responseSink), evb);
             requestStream->subscribe(std::move(scheduledResponse));
           }
         };
@@ -117,15 +234,26 @@ RSocketRequester::requestStream(Payload request) {
   CHECK(stateMachine_);
 
   return yarpl::flowable::internal::flowableFromSubscriber<Payload>(
-      [eb = eventBase_, req = std::move(request), srs = stateMachine_](
+      [eb = eventBase_,
+       req = std::move(request),
+       srs = stateMachine_,
+       weight = outputWeight_,
+       resumable = resumable_,
+       deadline = deadline_](
           std::shared_ptr<yarpl::flowable::Subscriber<Payload>> subscriber) {
-        auto lambda =
-            [eb, r = req.clone(), srs, subs = std::move(subscriber)]() mutable {
-              auto scheduled =
-                  std::make_shared<ScheduledSubscriptionSubscriber<Payload>>(
-                      std::move(subs), *eb);
-              srs->requestStream(std::move(r), std::move(scheduled));
-            };
+        auto lambda = [r = req.clone(),
+                       srs,
+                       weight,
+                       resumable,
+                       deadline,
+                       subs = std::move(subscriber)](
+                          folly::EventBase& evb) mutable {
+          auto scheduled =
+              std::make_shared<ScheduledSubscriptionSubscriber<Payload>>(
+                  std::move(subs), evb);
+          srs->requestStream(
+              std::move(r), std::move(scheduled), weight, resumable, deadline);
+        };
         runOnCorrectThread(*eb, std::move(lambda));
       });
 }
@@ -135,45 +263,131 @@ RSocketRequester::requestResponse(Payload request) {
   CHECK(stateMachine_);
 
   return yarpl::single::Single<Payload>::create(
-      [eb = eventBase_, req = std::move(request), srs = stateMachine_](
+      [eb = eventBase_,
+       req = std::move(request),
+       srs = stateMachine_,
+       weight = outputWeight_,
+       resumable = resumable_,
+       deadline = deadline_,
+       batching = requestBatching_](
           std::shared_ptr<yarpl::single::SingleObserver<Payload>> observer) {
-        auto lambda = [eb,
-                       r = req.clone(),
+        auto lambda = [r = req.clone(),
                        srs,
-                       obs = std::move(observer)]() mutable {
+                       weight,
+                       resumable,
+                       deadline,
+                       batching,
+                       obs = std::move(observer)](
+                          folly::EventBase& evb) mutable {
           auto scheduled =
               std::make_shared<ScheduledSubscriptionSingleObserver<Payload>>(
-                  std::move(obs), *eb);
-          srs->requestResponse(std::move(r), std::move(scheduled));
+                  std::move(obs), evb);
+          srs->requestResponse(
+              std::move(r),
+              std::move(scheduled),
+              weight,
+              resumable,
+              deadline,
+              batching);
         };
         runOnCorrectThread(*eb, std::move(lambda));
       });
 }
 
+folly::SemiFuture<Payload> RSocketRequester::requestResponseFuture(
+    Payload request) {
+  CHECK(stateMachine_);
+
+  folly::Promise<Payload> promise;
+  auto future = promise.getSemiFuture();
+  runOnCorrectThread(
+      *eventBase_,
+      [r = std::move(request),
+       p = std::move(promise),
+       srs = stateMachine_,
+       weight = outputWeight_,
+       resumable = resumable_,
+       deadline = deadline_,
+       batching = requestBatching_](folly::EventBase&) mutable {
+        srs->requestResponse(
+            std::move(r), std::move(p), weight, resumable, deadline, batching);
+      });
+  return future;
+}
+
+#if FOLLY_HAS_COROUTINES
+folly::coro::Task<Payload> RSocketRequester::requestResponseCo(
+    Payload request) {
+  co_return co_await requestResponseFuture(std::move(request));
+}
+
+folly::coro::AsyncGenerator<Payload&&> RSocketRequester::requestStreamCo(
+    Payload request,
+    size_t batch) {
+  return pullStream(requestStream(std::move(request)), batch);
+}
+
+folly::coro::AsyncGenerator<Payload&&> RSocketRequester::requestChannelCo(
+    folly::coro::AsyncGenerator<Payload&&> requests,
+    size_t batch) {
+  return pullStream(
+      requestChannel(yarpl::toFlowable(std::move(requests))), batch);
+}
+
+folly::coro::AsyncGenerator<Payload&&> RSocketRequester::requestChannelCo(
+    Payload request,
+    folly::coro::AsyncGenerator<Payload&&> requests,
+    size_t batch) {
+  return pullStream(
+      requestChannel(
+          std::move(request), yarpl::toFlowable(std::move(requests))),
+      batch);
+}
+#endif
+
 std::shared_ptr<yarpl::single::Single<void>> RSocketRequester::fireAndForget(
     rsocket::Payload request) {
   CHECK(stateMachine_);
 
   return yarpl::single::Single<void>::create(
-      [eb = eventBase_, req = std::move(request), srs = stateMachine_](
+      [eb = eventBase_,
+       req = std::move(request),
+       srs = stateMachine_,
+       deadline = deadline_](
           std::shared_ptr<yarpl::single::SingleObserverBase<void>> subscriber) {
-        auto lambda =
-            [r = req.clone(), srs, subs = std::move(subscriber)]() mutable {
-              // TODO: Pass in SingleSubscriber for underlying layers to call
-              // onSuccess/onError once put on network.
-              srs->fireAndForget(std::move(r));
-              subs->onSubscribe(yarpl::single::SingleSubscriptions::empty());
-              subs->onSuccess();
-            };
+        auto lambda = [r = req.clone(),
+                       srs,
+                       deadline,
+                       subs = std::move(subscriber)](
+                          folly::EventBase&) mutable {
+          // TODO: Pass in SingleSubscriber for underlying layers to call
+          // onSuccess/onError once put on network.
+          srs->fireAndForget(std::move(r), deadline);
+          subs->onSubscribe(yarpl::single::SingleSubscriptions::empty());
+          subs->onSuccess();
+        };
         runOnCorrectThread(*eb, std::move(lambda));
       });
 }
 
+void RSocketRequester::fireAndForgetBatch(std::vector<Payload> requests) {
+  CHECK(stateMachine_);
+
+  runOnCorrectThread(
+      *eventBase_,
+      [srs = stateMachine_,
+       reqs = std::move(requests)](folly::EventBase&) mutable {
+        srs->fireAndForgetBatch(std::move(reqs));
+      });
+}
+
 void RSocketRequester::metadataPush(std::unique_ptr<folly::IOBuf> metadata) {
   CHECK(stateMachine_);
 
   runOnCorrectThread(
-      *eventBase_, [srs = stateMachine_, meta = std::move(metadata)]() mutable {
+      *eventBase_,
+      [srs = stateMachine_,
+       meta = std::move(metadata)](folly::EventBase&) mutable {
         srs->metadataPush(std::move(meta));
       });
 }
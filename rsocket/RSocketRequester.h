@@ -14,12 +14,21 @@
 
 #pragma once
 
+#include <folly/Portability.h>
+#include <folly/Synchronized.h>
+#include <folly/futures/Future.h>
 #include <folly/io/async/EventBase.h>
+#if FOLLY_HAS_COROUTINES
+#include <folly/experimental/coro/AsyncGenerator.h>
+#include <folly/experimental/coro/Task.h>
+#endif
 
 #include "yarpl/Flowable.h"
 #include "yarpl/Single.h"
 
 #include "rsocket/Payload.h"
+#include "rsocket/RequestDeadline.h"
+#include "rsocket/internal/SwappableEventBase.h"
 #include "rsocket/statemachine/RSocketStateMachine.h"
 
 namespace rsocket {
@@ -96,6 +105,55 @@ class RSocketRequester {
   virtual std::shared_ptr<yarpl::single::Single<rsocket::Payload>>
   requestResponse(rsocket::Payload request);
 
+  /**
+   * Send a single request and get a future of the single response.
+   *
+   * Cheaper than requestResponse(), as it doesn't allocate an observer and
+   * subscription for every request.  The request can't be cancelled:
+   * dropping the future discards the response.
+   *
+   * The future is completed on the EventBase of the connection.
+   */
+  virtual folly::SemiFuture<rsocket::Payload> requestResponseFuture(
+      rsocket::Payload request);
+
+#if FOLLY_HAS_COROUTINES
+  /// Credits the coroutine streams grant at a time by default.
+  static constexpr size_t kDefaultCoroBatch = 64;
+
+  /**
+   * Coroutine version of requestResponseFuture().  Cancelling the coroutine
+   * doesn't cancel the request.
+   */
+  folly::coro::Task<rsocket::Payload> requestResponseCo(
+      rsocket::Payload request);
+
+  /**
+   * Coroutine version of requestStream().
+   *
+   * Elements are requested from the responder `batch` at a time, with a
+   * REQUEST_N every `batch / 2` elements pulled, and buffered until pulled.
+   * Destroying the generator, or cancelling the coroutine pulling from it,
+   * cancels the stream.  The requester must outlive the generator.
+   */
+  folly::coro::AsyncGenerator<rsocket::Payload&&> requestStreamCo(
+      rsocket::Payload request,
+      size_t batch = kDefaultCoroBatch);
+
+  /**
+   * Coroutine version of requestChannel().  The requests are pulled from
+   * their generator on the global IO executor, as the responder asks for
+   * them.  Responses are pulled as in requestStreamCo().
+   */
+  folly::coro::AsyncGenerator<rsocket::Payload&&> requestChannelCo(
+      folly::coro::AsyncGenerator<rsocket::Payload&&> requests,
+      size_t batch = kDefaultCoroBatch);
+  folly::coro::AsyncGenerator<rsocket::Payload&&> requestChannelCo(
+      rsocket::Payload request,
+      folly::coro::AsyncGenerator<rsocket::Payload&&> requests,
+      size_t batch = kDefaultCoroBatch);
+#endif
+
   /**
    * Send a single Payload with no response.
    *
@@ -111,6 +169,16 @@ class RSocketRequester {
   virtual std::shared_ptr<yarpl::single::Single<void>> fireAndForget(
       rsocket::Payload request);
 
+  /**
+   * Send a batch of Payloads with no response.
+   *
+   * Unlike fireAndForget(), the payloads are sent eagerly, and whether they
+   * reached the network isn't reported.  The whole batch moves to the
+   * EventBase of the connection in one hop, and is written to the transport
+   * in a single write.
+   */
+  virtual void fireAndForgetBatch(std::vector<rsocket::Payload> requests);
+
   /**
    * Send metadata without response.
    */
@@ -118,6 +186,86 @@ class RSocketRequester {
 
   virtual void closeSocket();
 
+  /**
+   * Returns a requester on the same connection, whose requests have their
+   * frames scheduled with the given weight relative to other streams.
+   *
+   * Only has an effect if the connection has an output scheduler, see
+   * RSocketStateMachine::setOutputSchedulerOptions().  Zero picks the
+   * default weight.
+   */
+  virtual std::shared_ptr<RSocketRequester> withOutputWeight(uint32_t weight);
+
+  /**
+   * Returns a requester on the same connection, whose streams are not resumed.
+   *
+   * On a resumable connection, the frames of these streams skip the resume
+   * buffer, and the streams are terminated with an error as soon as the
+   * connection is lost.  Meant for high-volume streams that can tolerate
+   * loss.  The peer must be running this library as well.
+   */
+  virtual std::shared_ptr<RSocketRequester> withoutResumption();
+
+  /**
+   * Returns a requester on the same connection, whose requests fail once
+   * `deadline` passes.
+   *
+   * The deadline goes along with each request, and the responder cancels the
+   * request when it passes, or drops it if it passed already.  Handlers can
+   * pass the deadline of the request they serve on to the requests they make
+   * themselves, see RequestDeadline::current().  Fire-and-forget batches are
+   * sent without a deadline.
+   */
+  virtual std::shared_ptr<RSocketRequester> withDeadline(
+      RequestDeadline::Clock::time_point deadline);
+
+  /**
+   * Returns a requester on the same connection, whose request-response calls
+   * made in a burst share a single write to the transport rather than taking
+   * one each.
+   *
+   * A request is held back for at most `options.maxDelay`, and the batch is
+   * written as soon as it holds `options.maxBytes`.  Any other frame written
+   * on the connection writes out the batch ahead of it.  Has no effect on a
+   * connection with an output scheduler.
+   */
+  virtual std::shared_ptr<RSocketRequester> withRequestBatching(
+      RequestBatchingOptions options = RequestBatchingOptions());
+
+  /**
+   * Returns a requester whose requests are made on the bulk connection of
+   * this one, with the same options, see setBulkRequester().  Meant for
+   * streams moving a lot of data, so that their frames don't fill the socket
+   * buffers in front of latency-sensitive requests.  Stays on the same
+   * connection if there is no bulk connection (yet).
+   */
+  virtual std::shared_ptr<RSocketRequester> withBulkTraffic();
+
+  /**
+   * Makes withBulkTraffic() send requests through `bulk`, on this requester
+   * and all those derived from it, before and after.  Usually done by
+   * RSocketClient::connectBulk().
+   */
+  void setBulkRequester(std::shared_ptr<RSocketRequester> bulk);
+
+  /**
+   * Moves the requester, and those derived from it, onto the EventBase that
+   * its state machine moved to.  Calls made before the current EventBase has
+   * run everything queued on it still run after those, in order.
+   */
+  void setEventBase(folly::EventBase& eventBase);
+
+  /**
+   * Moves the requester, and those derived from it, onto `eventBase` at once
+   * if no call is waiting to run on the current EventBase, and runs `first`
+   * on `eventBase` ahead of the calls made from then on.  Returns false,
+   * leaving the requester where it is, otherwise.  Must be called on the
+   * current EventBase.
+   */
+  bool trySetEventBase(
+      folly::EventBase& eventBase,
+      folly::Function<void(folly::EventBase&)> first);
+
  protected:
   virtual std::shared_ptr<yarpl::flowable::Flowable<rsocket::Payload>>
   requestChannel(
@@ -125,7 +273,23 @@ class RSocketRequester {
       bool hasInitialRequest,
       std::shared_ptr<yarpl::flowable::Flowable<rsocket::Payload>> requests);
 
+  RSocketRequester(
+      std::shared_ptr<rsocket::RSocketStateMachine> srs,
+      std::shared_ptr<SwappableEventBase> eventBase);
+
+  /// A requester on the same connection, with the same options.
+  std::shared_ptr<RSocketRequester> derive() const;
+
   std::shared_ptr<rsocket::RSocketStateMachine> stateMachine_;
-  folly::EventBase* eventBase_;
+  /// Shared with the requesters derived from this one.
+  std::shared_ptr<SwappableEventBase> eventBase_;
+  uint32_t outputWeight_{0};
+  bool resumable_{true};
+  folly::Optional<RequestDeadline::Clock::time_point> deadline_;
+  folly::Optional<RequestBatchingOptions> requestBatching_;
+  /// The requester of the bulk connection, shared with the requesters
+  /// derived from this one.
+  std::shared_ptr<folly::Synchronized<std::shared_ptr<RSocketRequester>>>
+      bulk_;
 };
 } // namespace rsocket
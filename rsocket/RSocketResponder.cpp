@@ -16,6 +16,7 @@
 
 #include <folly/io/async/EventBase.h>
 #include <yarpl/flowable/CancelingSubscriber.h>
+#include <yarpl/single/SingleSubscriptions.h>
 
 namespace rsocket {
 
@@ -183,6 +184,20 @@ void RSocketResponderAdapter::handleRequestResponse(
     StreamId streamId,
     std::shared_ptr<SingleObserver<Payload>> responseObserver) noexcept {
   auto single = inner_->handleRequestResponse(std::move(request), streamId);
+
+  // A result that is ready up front, e.g. from Singles::just(), is handed to
+  // the responder right away, without going through the Single.
+  if (single.use_count() == 1) {
+    if (auto result = single->takeReadyResult()) {
+      responseObserver->onSubscribe(SingleSubscriptions::ready());
+      if (result->hasValue()) {
+        responseObserver->onSuccess(std::move(result->value()));
+      } else {
+        responseObserver->onError(std::move(result->exception()));
+      }
+      return;
+    }
+  }
   single->subscribe(std::move(responseObserver));
 }
 
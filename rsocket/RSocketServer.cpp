@@ -15,6 +15,9 @@
 #include "rsocket/RSocketServer.h"
 #include <folly/io/async/EventBaseManager.h>
 
+#include <algorithm>
+#include <cmath>
+
 #include <rsocket/internal/ScheduledRSocketResponder.h>
 #include "rsocket/RSocketErrors.h"
 #include "rsocket/RSocketStats.h"
@@ -42,29 +45,66 @@ RSocketServer::~RSocketServer() {
 }
 
 void RSocketServer::shutdownAndWait() {
-  if (isShutdown_) {
+  if (!stopAccepting()) {
     return;
   }
 
-  // Will stop forwarding connections from duplexConnectionAcceptor_ to
-  // setupResumeAcceptors_
-  isShutdown_ = true;
+  // Close off all outstanding connections.
+  connectionSet_->shutdownAndWait();
+}
+
+void RSocketServer::drainAndWait(DrainOptions options) {
+  if (!stopAccepting()) {
+    return;
+  }
+
+  std::function<void(ResumeIdentificationToken, ResumeHandoffState)> handOff;
+  if (auto handoff = resumeStateHandoff_) {
+    handOff = [handoff](
+                  ResumeIdentificationToken token, ResumeHandoffState state) {
+      handoff->push(std::move(token), std::move(state));
+    };
+  }
+  connectionSet_->drainAndWait(
+      options.timeout,
+      std::move(options.onProgress),
+      options.progressInterval,
+      std::move(handOff));
+}
+
+bool RSocketServer::stopAccepting() {
+  if (isShutdown_.exchange(true)) {
+    return false;
+  }
+
+  if (rebalancer_.joinable()) {
+    stopRebalancing_.post();
+    rebalancer_.join();
+  }
+  // Setting isShutdown_ stops forwarding connections from
+  // duplexConnectionAcceptor_ to setupResumeAcceptors_.
 
   // Stop accepting new connections.
   if (duplexConnectionAcceptor_) {
     duplexConnectionAcceptor_->stop();
   }
 
-  std::vector<folly::Future<folly::Unit>> closingFutures;
+  folly::Baton<> closed;
+  std::atomic<size_t> closing{1};
+  auto onClosed = [&] {
+    if (--closing == 0) {
+      closed.post();
+    }
+  };
   for (auto& acceptor : setupResumeAcceptors_.accessAllThreads()) {
     // This call will queue up the cleanup on the eventBase.
-    closingFutures.push_back(acceptor.close());
+    ++closing;
+    acceptor.close(onClosed);
   }
+  onClosed();
 
-  folly::collectAll(closingFutures).get();
-
-  // Close off all outstanding connections.
-  connectionSet_->shutdownAndWait();
+  closed.wait();
+  return true;
 }
 
 void RSocketServer::start(
@@ -97,9 +137,221 @@ void RSocketServer::setSingleThreadedResponder() {
   useScheduledResponder_ = false;
 }
 
+void RSocketServer::setResponderExecutor(
+    folly::Executor::KeepAlive<> executor) {
+  responderExecutor_ = std::move(executor);
+}
+
+void RSocketServer::setMigrateOnResume() {
+  migrateOnResume_ = true;
+}
+
+folly::SemiFuture<size_t> RSocketServer::rebalance(
+    const RebalanceOptions& options) {
+  struct Load {
+    folly::EventBase* eventBase;
+    std::shared_ptr<AdmissionController> admissionController;
+    size_t connections;
+  };
+
+  std::vector<Load> loads;
+  {
+    const auto eventBases = eventBases_.lock();
+    for (auto& kv : *eventBases) {
+      loads.push_back({kv.first, kv.second, 0});
+    }
+  }
+  if (isShutdown_ || loads.size() < 2) {
+    return folly::makeSemiFuture<size_t>(0);
+  }
+
+  size_t total = 0;
+  const auto counts = connectionSet_->countByEventBase();
+  for (auto& load : loads) {
+    auto const it = counts.find(load.eventBase);
+    load.connections = it != counts.end() ? it->second : 0;
+    total += load.connections;
+  }
+  std::sort(loads.begin(), loads.end(), [](const Load& a, const Load& b) {
+    return a.connections < b.connections;
+  });
+
+  auto const average = static_cast<double>(total) / loads.size();
+  auto const overloaded = average * (1 + options.imbalanceThreshold);
+  auto const ceiling = static_cast<size_t>(std::ceil(average));
+  auto const floor = static_cast<size_t>(average);
+
+  // Pair the most loaded EventBases with the least loaded ones.
+  std::vector<folly::SemiFuture<size_t>> moves;
+  auto budget = options.maxMovesPerRound;
+  size_t low = 0;
+  size_t high = loads.size() - 1;
+  while (budget > 0 && low < high && loads[high].connections > overloaded) {
+    auto& from = loads[high];
+    auto& to = loads[low];
+    if (to.connections >= floor) {
+      break;
+    }
+    auto const surplus = from.connections - ceiling;
+    auto const deficit = floor - to.connections;
+    auto const count = std::min({budget, surplus, deficit});
+
+    if (count > 0) {
+      VLOG(2) << "Moving " << count << " connections from "
+              << from.eventBase->getName() << " to "
+              << to.eventBase->getName();
+      moves.push_back(moveConnections(
+          connectionSet_,
+          *from.eventBase,
+          *to.eventBase,
+          to.admissionController,
+          count));
+    }
+    from.connections -= count;
+    to.connections += count;
+    budget -= count;
+    if (count == surplus) {
+      --high;
+    }
+    if (count == deficit) {
+      ++low;
+    }
+  }
+
+  if (moves.empty()) {
+    return folly::makeSemiFuture<size_t>(0);
+  }
+  return folly::collectAll(std::move(moves))
+      .deferValue([](std::vector<folly::Try<size_t>> results) {
+        size_t moved = 0;
+        for (auto& result : results) {
+          if (result.hasValue()) {
+            moved += result.value();
+          }
+        }
+        return moved;
+      });
+}
+
+void RSocketServer::startRebalancing(RebalanceOptions options) {
+  CHECK(!rebalancer_.joinable()) << "startRebalancing() already called";
+  if (isShutdown_) {
+    return;
+  }
+  rebalancer_ = std::thread([this, options = std::move(options)] {
+    while (!stopRebalancing_.try_wait_for(options.interval)) {
+      auto const moved = rebalance(options).get();
+      VLOG_IF(1, moved > 0) << "Rebalanced " << moved << " connections";
+    }
+  });
+}
+
+folly::SemiFuture<size_t> RSocketServer::moveConnections(
+    std::shared_ptr<ConnectionSet> connectionSet,
+    folly::EventBase& from,
+    folly::EventBase& to,
+    std::shared_ptr<AdmissionController> admissionController,
+    size_t count) {
+  auto states = connectionSet->serverStatesOn(&from);
+  folly::Promise<size_t> promise;
+  auto future = promise.getSemiFuture();
+
+  from.runInEventBaseThread([connectionSet = std::move(connectionSet),
+                             states = std::move(states),
+                             admissionController =
+                                 std::move(admissionController),
+                             promise = std::move(promise),
+                             &from,
+                             &to,
+                             count]() mutable {
+    // As on resumption, loop callbacks that the state machines scheduled on
+    // this EventBase run before this one.
+    from.runInLoop([connectionSet = std::move(connectionSet),
+                    states = std::move(states),
+                    admissionController = std::move(admissionController),
+                    promise = std::move(promise),
+                    &from,
+                    &to,
+                    count]() mutable {
+      size_t moved = 0;
+      for (auto& state : states) {
+        if (moved == count) {
+          break;
+        }
+        const auto& machine = state->rSocketStateMachine_;
+        // Moved by an earlier round, or busy.
+        if (state->eventBase() != &from ||
+            !machine->canMoveConnectedToEventBase()) {
+          continue;
+        }
+        auto const attached = [machine, admissionController] {
+          if (admissionController) {
+            machine->setAdmissionController(admissionController);
+          }
+        };
+        if (state->moveConnectedToEventBase(to, attached)) {
+          connectionSet->setEventBase(*machine, &to);
+          ++moved;
+        }
+      }
+      promise.setValue(moved);
+    });
+  });
+  return future;
+}
+
+void RSocketServer::setLeaseSender(std::shared_ptr<LeaseSender> leaseSender) {
+  leaseSender_ = std::move(leaseSender);
+}
+
+void RSocketServer::setAdmissionControl(AdmissionController::Options options) {
+  admissionOptions_ = options;
+}
+
+void RSocketServer::setMemoryPressure(
+    std::shared_ptr<const MemoryPressureController> controller) {
+  memoryPressure_ = std::move(controller);
+}
+
+void RSocketServer::setEventBaseMonitoring(
+    EventBaseMonitor::Options options) {
+  monitoringOptions_ = options;
+}
+
+void RSocketServer::setTenantQuotas(std::shared_ptr<TenantQuotas> quotas) {
+  tenantQuotas_ = std::move(quotas);
+}
+
+void RSocketServer::setStreamAccounting(
+    std::shared_ptr<StreamAccounting> accounting) {
+  streamAccounting_ = std::move(accounting);
+}
+
+void RSocketServer::setFramedReaderOptions(FramedReader::Options options) {
+  framedReaderOptions_ = std::move(options);
+}
+
+void RSocketServer::setCapacityHintLimits(CapacityHints limits) {
+  capacityHintLimits_ = limits;
+}
+
+void RSocketServer::setResumeManagerFactory(ResumeManagerFactory factory) {
+  resumeManagerFactory_ = std::move(factory);
+}
+
+void RSocketServer::setResumeBufferBudget(
+    std::shared_ptr<ResumeBufferBudget> budget,
+    size_t capacityPerConnection) {
+  resumeManagerFactory_ = [budget = std::move(budget), capacityPerConnection](
+                              std::shared_ptr<RSocketStats> stats) {
+    return std::make_shared<WarmResumeManager>(
+        std::move(stats), capacityPerConnection, budget);
+  };
+}
+
 void RSocketServer::acceptConnection(
     std::unique_ptr<DuplexConnection> connection,
-    folly::EventBase&,
+    folly::EventBase& eventBase,
     std::shared_ptr<RSocketServiceHandler> serviceHandler) {
   stats_->serverConnectionAccepted();
   if (isShutdown_) {
@@ -112,18 +364,51 @@ void RSocketServer::acceptConnection(
     framedConnection = std::move(connection);
   } else {
     framedConnection = std::make_unique<FramedDuplexConnection>(
-        std::move(connection), ProtocolVersion::Unknown);
+        std::move(connection),
+        ProtocolVersion::Unknown,
+        framedReaderOptions_);
   }
 
   auto* acceptor = setupResumeAcceptors_.get();
 
+  std::shared_ptr<AdmissionController> admissionController;
+  if (admissionOptions_) {
+    auto& controller = *admissionControllers_;
+    if (!controller) {
+      controller = AdmissionController::create(eventBase, *admissionOptions_);
+    }
+    admissionController = controller;
+  }
+
+  if (monitoringOptions_) {
+    auto& monitor = *eventBaseMonitors_;
+    if (!monitor) {
+      monitor =
+          EventBaseMonitor::create(eventBase, *monitoringOptions_, stats_);
+    }
+  }
+
+  auto& eventBaseKnown = *eventBaseKnown_;
+  if (!eventBaseKnown) {
+    eventBaseKnown = true;
+    eventBases_.lock()->emplace(&eventBase, admissionController);
+  }
+
   VLOG(2) << "Going to accept duplex connection";
 
   acceptor->accept(
       std::move(framedConnection),
       [serviceHandler,
        weakConSet = std::weak_ptr<ConnectionSet>(connectionSet_),
-       scheduledResponder = useScheduledResponder_](
+       scheduledResponder = useScheduledResponder_,
+       responderExecutor = responderExecutor_.copy(),
+       leaseSender = leaseSender_,
+       tenantQuotas = tenantQuotas_,
+       streamAccounting = streamAccounting_,
+       admissionController = std::move(admissionController),
+       memoryPressure = memoryPressure_,
+       resumeManagerFactory = resumeManagerFactory_,
+       capacityHintLimits = capacityHintLimits_](
           std::unique_ptr<DuplexConnection> conn,
           SetupParameters params) mutable {
         if (auto connectionSet = weakConSet.lock()) {
@@ -131,6 +416,14 @@ void RSocketServer::acceptConnection(
               serviceHandler,
               std::move(connectionSet),
               scheduledResponder,
+              responderExecutor.copy(),
+              leaseSender,
+              admissionController,
+              memoryPressure,
+              tenantQuotas,
+              streamAccounting,
+              resumeManagerFactory,
+              capacityHintLimits,
               std::move(conn),
               std::move(params));
         }
@@ -147,6 +440,14 @@ void RSocketServer::onRSocketSetup(
     std::shared_ptr<RSocketServiceHandler> serviceHandler,
     std::shared_ptr<ConnectionSet> connectionSet,
     bool scheduledResponder,
+    folly::Executor::KeepAlive<> responderExecutor,
+    std::shared_ptr<LeaseSender> leaseSender,
+    std::shared_ptr<AdmissionController> admissionController,
+    std::shared_ptr<const MemoryPressureController> memoryPressure,
+    const std::shared_ptr<TenantQuotas>& tenantQuotas,
+    std::shared_ptr<StreamAccounting> streamAccounting,
+    const ResumeManagerFactory& resumeManagerFactory,
+    const CapacityHints& capacityHintLimits,
     std::unique_ptr<DuplexConnection> connection,
     SetupParameters setupParams) {
   const auto eventBase = folly::EventBaseManager::get()->getExistingEventBase();
@@ -157,7 +458,7 @@ void RSocketServer::onRSocketSetup(
     VLOG(3) << "Terminating SETUP attempt from client. "
             << result.error().what();
     connection->send(
-        FrameSerializer::createFrameSerializer(setupParams.protocolVersion)
+        FrameSerializer::shared(setupParams.protocolVersion, false)
             ->serializeOut(Frame_ERROR::rejectedSetup(result.error().what())));
     return;
   }
@@ -165,54 +466,142 @@ void RSocketServer::onRSocketSetup(
   if (!connectionParams.responder) {
     LOG(ERROR) << "Received invalid Responder. Dropping connection";
     connection->send(
-        FrameSerializer::createFrameSerializer(setupParams.protocolVersion)
+        FrameSerializer::shared(setupParams.protocolVersion, false)
             ->serializeOut(Frame_ERROR::rejectedSetup(
                 "Received invalid Responder from server")));
     return;
   }
-  const auto rs = std::make_shared<RSocketStateMachine>(
-      scheduledResponder
-          ? std::make_shared<ScheduledRSocketResponder>(
-                std::move(connectionParams.responder), *eventBase)
-          : std::move(connectionParams.responder),
-      nullptr,
-      RSocketMode::SERVER,
-      connectionParams.stats,
-      std::move(connectionParams.connectionEvents),
-      setupParams.resumable
-          ? std::make_shared<WarmResumeManager>(connectionParams.stats)
-          : ResumeManager::makeEmpty(),
-      nullptr /* coldResumeHandler */);
 
-  if (!connectionSet->insert(rs, eventBase)) {
+  std::shared_ptr<TenantQuotas::Bucket> tenant;
+  if (tenantQuotas) {
+    tenant = tenantQuotas->bucketFor(setupParams);
+    if (!tenant->tryOpenConnection()) {
+      VLOG(3) << "Rejecting SETUP, tenant " << tenant->tenant()
+              << " has too many connections";
+      connectionParams.stats->tenantQuotaExceeded();
+      connection->send(
+          FrameSerializer::shared(setupParams.protocolVersion, false)
+              ->serializeOut(Frame_ERROR::rejectedSetup(
+                  "Tenant has too many connections")));
+      return;
+    }
+  }
+
+  auto const hints = setupParams.capacityHints.boundedBy(capacityHintLimits);
+  auto const resumeCapacity = hints.resumeWindow > 0
+      ? hints.resumeWindow
+      : size_t{WarmResumeManager::DEFAULT_CAPACITY};
+
+  std::shared_ptr<ResumeManager> resumeManager;
+  if (!setupParams.resumable) {
+    resumeManager = ResumeManager::makeEmpty();
+  } else if (tenant && tenant->resumeBufferBudget()) {
+    resumeManager = std::make_shared<WarmResumeManager>(
+        connectionParams.stats, resumeCapacity, tenant->resumeBufferBudget());
+  } else if (resumeManagerFactory) {
+    resumeManager = resumeManagerFactory(connectionParams.stats);
+  } else {
+    resumeManager = std::make_shared<WarmResumeManager>(
+        connectionParams.stats, resumeCapacity);
+  }
+
+  const auto rs = createSession(
+      *serviceHandler,
+      *connectionSet,
+      *eventBase,
+      scheduledResponder,
+      std::move(responderExecutor),
+      std::move(connectionParams),
+      std::move(resumeManager),
+      setupParams);
+  if (!rs) {
+    if (tenant) {
+      tenant->closeConnection();
+    }
     VLOG(1) << "Server is closed, so ignore the connection";
     connection->send(
-        FrameSerializer::createFrameSerializer(setupParams.protocolVersion)
+        FrameSerializer::shared(setupParams.protocolVersion, false)
             ->serializeOut(Frame_ERROR::rejectedSetup(
                 "Server ignores the connection attempt")));
     return;
   }
-  rs->registerCloseCallback(connectionSet.get());
-
-  auto requester = std::make_shared<RSocketRequester>(rs, *eventBase);
-  auto serverState = std::shared_ptr<RSocketServerState>(
-      new RSocketServerState(*eventBase, rs, std::move(requester)));
-  serviceHandler->onNewRSocketState(std::move(serverState), setupParams.token);
+  rs->setLeaseSender(std::move(leaseSender));
+  rs->setAdmissionController(std::move(admissionController));
+  rs->setMemoryPressure(std::move(memoryPressure));
+  rs->setTenant(std::move(tenant));
+  rs->setStreamAccounting(std::move(streamAccounting));
+  if (hints.streams > 0) {
+    rs->reserveClientStreams(hints.streams);
+  }
+  if (hints.payloadSize > 0) {
+    connection->setReadBufferSizeHint(hints.payloadSize);
+  }
   rs->connectServer(
       std::make_shared<FrameTransportImpl>(std::move(connection)),
       std::move(setupParams));
 }
 
+std::shared_ptr<RSocketStateMachine> RSocketServer::createSession(
+    RSocketServiceHandler& serviceHandler,
+    ConnectionSet& connectionSet,
+    folly::EventBase& eventBase,
+    bool scheduledResponder,
+    folly::Executor::KeepAlive<> responderExecutor,
+    RSocketConnectionParams connectionParams,
+    std::shared_ptr<ResumeManager> resumeManager,
+    const SetupParameters& setupParams) {
+  std::shared_ptr<ScheduledRSocketResponder> scheduled;
+  if (scheduledResponder || responderExecutor) {
+    scheduled = std::make_shared<ScheduledRSocketResponder>(
+        std::move(connectionParams.responder),
+        eventBase,
+        std::move(responderExecutor));
+  }
+
+  const auto rs = std::make_shared<RSocketStateMachine>(
+      scheduled ? scheduled : std::move(connectionParams.responder),
+      nullptr,
+      RSocketMode::SERVER,
+      connectionParams.stats,
+      std::move(connectionParams.connectionEvents),
+      std::move(resumeManager),
+      nullptr /* coldResumeHandler */);
+  rs->setFrameCapture(std::move(connectionParams.frameCapture));
+
+  auto requester = std::make_shared<RSocketRequester>(rs, eventBase);
+  auto serverState = std::shared_ptr<RSocketServerState>(new RSocketServerState(
+      eventBase, rs, std::move(requester), std::move(scheduled)));
+  if (!connectionSet.insert(rs, &eventBase, serverState)) {
+    return nullptr;
+  }
+  rs->registerCloseCallback(&connectionSet);
+
+  if (setupParams.resumable && serviceHandler.useServerResumeIndex()) {
+    connectionSet.indexResumable(setupParams.token, serverState);
+  }
+  serviceHandler.onNewRSocketState(std::move(serverState), setupParams.token);
+  return rs;
+}
+
 void RSocketServer::onRSocketResume(
     std::shared_ptr<RSocketServiceHandler> serviceHandler,
     std::unique_ptr<DuplexConnection> connection,
     ResumeParameters resumeParams) {
-  auto result = serviceHandler->onResume(resumeParams.token);
+  auto result = serviceHandler->useServerResumeIndex()
+      ? lookUpResumable(resumeParams.token)
+      : serviceHandler->onResume(resumeParams.token);
+  if (result.hasError() && resumeStateHandoff_) {
+    fetchHandedOff(
+        std::move(serviceHandler),
+        std::move(connection),
+        std::move(resumeParams));
+    return;
+  }
   if (result.hasError()) {
     stats_->resumeFailedNoState();
     VLOG(3) << "Terminating RESUME attempt from client.  No ServerState found";
     connection->send(
-        FrameSerializer::createFrameSerializer(resumeParams.protocolVersion)
+        FrameSerializer::shared(resumeParams.protocolVersion, false)
             ->serializeOut(Frame_ERROR::rejectedSetup(result.error().what())));
     return;
   }
@@ -220,30 +609,212 @@ void RSocketServer::onRSocketResume(
   CHECK(serverState);
   const auto eventBase = folly::EventBaseManager::get()->getExistingEventBase();
   VLOG(2) << "Resuming client on " << eventBase->getName();
-  if (!serverState->eventBase_.isInEventBaseThread()) {
-    // If the resumed connection is on a different EventBase, then use
-    // ScheduledFrameTransport and ScheduledFrameProcessor to ensure the
-    // RSocketStateMachine continues to live on the same EventBase and the
-    // IO happens in the new EventBase
-    auto scheduledFT = std::make_shared<ScheduledFrameTransport>(
-        std::make_shared<FrameTransportImpl>(std::move(connection)),
-        eventBase, /* Transport EventBase */
-        &serverState->eventBase_); /* StateMachine EventBase */
-    serverState->eventBase_.runInEventBaseThread(
-        [serverState,
-         scheduledFT = std::move(scheduledFT),
-         resumeParams = std::move(resumeParams)]() mutable {
-          serverState->rSocketStateMachine_->resumeServer(
-              std::move(scheduledFT), resumeParams);
-        });
-  } else {
+  const auto stateMachineEvb = serverState->eventBase();
+  if (stateMachineEvb->isInEventBaseThread()) {
     // If the resumed connection is on the same EventBase, then the
     // RSocketStateMachine and Transport can continue living in the same
     // EventBase without any thread hopping between them.
     serverState->rSocketStateMachine_->resumeServer(
         std::make_shared<FrameTransportImpl>(std::move(connection)),
         resumeParams);
+    return;
   }
+
+  auto transport = std::make_shared<FrameTransportImpl>(std::move(connection));
+  stateMachineEvb->runInEventBaseThread(
+      [serverState,
+       stateMachineEvb,
+       eventBase,
+       transport = std::move(transport),
+       resumeParams = std::move(resumeParams),
+       migrate = migrateOnResume_,
+       connectionSet = connectionSet_]() mutable {
+        const auto& stateMachine = serverState->rSocketStateMachine_;
+        if (migrate && stateMachine->canMoveEventBase()) {
+          VLOG(2) << "Moving the state machine to the transport's EventBase";
+          // Loop callbacks that the state machine scheduled on this EventBase
+          // run before this one, so that nothing touches it here once it has
+          // moved.
+          stateMachineEvb->runInLoop([serverState,
+                                      eventBase,
+                                      transport = std::move(transport),
+                                      resumeParams = std::move(resumeParams),
+                                      connectionSet]() mutable {
+            serverState->moveToEventBase(*eventBase);
+            connectionSet->setEventBase(
+                *serverState->rSocketStateMachine_, eventBase);
+            eventBase->runInEventBaseThread(
+                [serverState,
+                 transport = std::move(transport),
+                 resumeParams = std::move(resumeParams)]() mutable {
+                  serverState->rSocketStateMachine_->resumeServer(
+                      std::move(transport), resumeParams);
+                });
+          });
+          return;
+        }
+
+        // If the resumed connection is on a different EventBase, then use
+        // ScheduledFrameTransport and ScheduledFrameProcessor to ensure the
+        // RSocketStateMachine continues to live on the same EventBase and the
+        // IO happens in the new EventBase
+        auto scheduledFT = std::make_shared<ScheduledFrameTransport>(
+            std::move(transport),
+            eventBase, /* Transport EventBase */
+            stateMachineEvb); /* StateMachine EventBase */
+        stateMachine->resumeServer(std::move(scheduledFT), resumeParams);
+      });
+}
+
+void RSocketServer::fetchHandedOff(
+    std::shared_ptr<RSocketServiceHandler> serviceHandler,
+    std::unique_ptr<DuplexConnection> connection,
+    ResumeParameters resumeParams) {
+  const auto eventBase = folly::EventBaseManager::get()->getExistingEventBase();
+  std::shared_ptr<AdmissionController> admissionController;
+  {
+    auto eventBases = eventBases_.lock();
+    auto const it = eventBases->find(eventBase);
+    if (it != eventBases->end()) {
+      admissionController = it->second;
+    }
+  }
+
+  using HandedOff = folly::Optional<ResumeHandoffState>;
+  VLOG(2) << "Fetching the state of session " << resumeParams.token;
+  resumeStateHandoff_->fetch(resumeParams.token)
+      .via(folly::getKeepAliveToken(eventBase))
+      .thenTry([serviceHandler = std::move(serviceHandler),
+                weakConSet = std::weak_ptr<ConnectionSet>(connectionSet_),
+                stats = stats_,
+                eventBase,
+                scheduledResponder = useScheduledResponder_,
+                responderExecutor = responderExecutor_.copy(),
+                admissionController = std::move(admissionController),
+                resumeManagerFactory = resumeManagerFactory_,
+                connection = std::move(connection),
+                resumeParams = std::move(resumeParams)](
+                   folly::Try<HandedOff> state) mutable {
+        auto connectionSet = weakConSet.lock();
+        if (!connectionSet) {
+          return;
+        }
+        if (state.hasException() || !state.value()) {
+          stats->resumeFailedNoState();
+          if (state.hasException()) {
+            LOG(ERROR) << "Failed fetching the state of session "
+                       << resumeParams.token << ": " << state.exception();
+          }
+          VLOG(3) << "Terminating RESUME attempt from client.  No handed off "
+                  << "ServerState found";
+          connection->send(
+              FrameSerializer::shared(resumeParams.protocolVersion, false)
+                  ->serializeOut(
+                      Frame_ERROR::rejectedResume("No ServerState")));
+          return;
+        }
+        takeOver(
+            *serviceHandler,
+            *connectionSet,
+            *eventBase,
+            scheduledResponder,
+            std::move(responderExecutor),
+            std::move(admissionController),
+            resumeManagerFactory,
+            std::move(connection),
+            std::move(resumeParams),
+            std::move(*state.value()));
+      });
+}
+
+void RSocketServer::takeOver(
+    RSocketServiceHandler& serviceHandler,
+    ConnectionSet& connectionSet,
+    folly::EventBase& eventBase,
+    bool scheduledResponder,
+    folly::Executor::KeepAlive<> responderExecutor,
+    std::shared_ptr<AdmissionController> admissionController,
+    const ResumeManagerFactory& resumeManagerFactory,
+    std::unique_ptr<DuplexConnection> connection,
+    ResumeParameters resumeParams,
+    ResumeHandoffState state) {
+  SetupParameters setupParams(
+      state.metadataMimeType,
+      state.dataMimeType,
+      Payload(),
+      true /* resumable */,
+      resumeParams.token,
+      state.protocolVersion);
+  setupParams.payloadCompression = state.payloadCompression;
+  setupParams.byteCredit = state.byteCredit;
+
+  const auto reject = [&](folly::StringPiece msg) {
+    VLOG(3) << "Terminating RESUME attempt from client.  " << msg;
+    connection->send(
+        FrameSerializer::shared(resumeParams.protocolVersion, false)
+            ->serializeOut(Frame_ERROR::rejectedResume(msg)));
+  };
+
+  auto result = serviceHandler.onNewSetup(setupParams);
+  if (result.hasError()) {
+    reject(result.error().what());
+    return;
+  }
+  auto connectionParams = std::move(result.value());
+  if (!connectionParams.responder) {
+    reject("Received invalid Responder from server");
+    return;
+  }
+
+  // The frames can only be restored into a WarmResumeManager.
+  auto resumeManager = resumeManagerFactory
+      ? std::dynamic_pointer_cast<WarmResumeManager>(
+            resumeManagerFactory(connectionParams.stats))
+      : nullptr;
+  if (!resumeManager) {
+    resumeManager = std::make_shared<WarmResumeManager>(connectionParams.stats);
+  }
+  resumeManager->restore(
+      state.firstSentPosition, state.impliedPosition, state.frames);
+
+  const auto rs = createSession(
+      serviceHandler,
+      connectionSet,
+      eventBase,
+      scheduledResponder,
+      std::move(responderExecutor),
+      std::move(connectionParams),
+      std::move(resumeManager),
+      setupParams);
+  if (!rs) {
+    reject("Server ignores the connection attempt");
+    return;
+  }
+  VLOG(2) << "Taking over session " << resumeParams.token << " with "
+          << state.openStreams.size() << " lost streams";
+  rs->setAdmissionController(std::move(admissionController));
+  rs->takeOver(state);
+  rs->resumeServer(
+      std::make_shared<FrameTransportImpl>(std::move(connection)),
+      resumeParams);
+}
+
+folly::SemiFuture<folly::Optional<ResumeHandoffState>> RSocketServer::handOff(
+    const ResumeIdentificationToken& token) {
+  return connectionSet_->handOff(token);
+}
+
+void RSocketServer::setResumeStateHandoff(
+    std::shared_ptr<ResumeStateHandoff> handoff) {
+  resumeStateHandoff_ = std::move(handoff);
+}
+
+folly::Expected<std::shared_ptr<RSocketServerState>, RSocketException>
+RSocketServer::lookUpResumable(const ResumeIdentificationToken& token) {
+  if (auto state = connectionSet_->findResumable(token)) {
+    return state;
+  }
+  return folly::makeUnexpected(RSocketException("No ServerState"));
 }
 
 void RSocketServer::startAndPark(
@@ -265,4 +836,38 @@ size_t RSocketServer::getNumConnections() {
   return connectionSet_ ? connectionSet_->size() : 0;
 }
 
+folly::SemiFuture<MemoryUsage> RSocketServer::memoryUsage() const {
+  return connectionSet_ ? connectionSet_->memoryUsage()
+                        : folly::makeSemiFuture(MemoryUsage());
+}
+
+folly::SemiFuture<std::vector<ConnectionFlowControl>>
+RSocketServer::flowControl() const {
+  return connectionSet_
+      ? connectionSet_->flowControl()
+      : folly::makeSemiFuture(std::vector<ConnectionFlowControl>());
+}
+
+size_t RSocketServer::broadcastMetadataPush(
+    std::unique_ptr<folly::IOBuf> metadata) {
+  return connectionSet_
+      ? connectionSet_->broadcastMetadataPush(std::move(metadata))
+      : 0;
+}
+
+size_t RSocketServer::broadcastFireAndForget(Payload request) {
+  return connectionSet_
+      ? connectionSet_->broadcastFireAndForget(std::move(request))
+      : 0;
+}
+
+size_t RSocketServer::broadcastRequestStream(
+    Payload request,
+    std::function<std::shared_ptr<yarpl::flowable::Subscriber<Payload>>()>
+        makeSubscriber) {
+  return connectionSet_ ? connectionSet_->broadcastRequestStream(
+                              std::move(request), std::move(makeSubscriber))
+                        : 0;
+}
+
 } // namespace rsocket
@@ -14,18 +14,34 @@
 
 #pragma once
 
+#include <chrono>
+#include <functional>
 #include <mutex>
+#include <thread>
+#include <unordered_map>
 
+#include <folly/Executor.h>
 #include <folly/Synchronized.h>
 #include <folly/ThreadLocal.h>
 #include <folly/synchronization/Baton.h>
 
 #include "rsocket/ConnectionAcceptor.h"
+#include "rsocket/LeaseSender.h"
 #include "rsocket/RSocketParameters.h"
 #include "rsocket/RSocketResponder.h"
 #include "rsocket/RSocketServiceHandler.h"
+#include "rsocket/ResumeManager.h"
+#include "rsocket/ResumeStateHandoff.h"
+#include "rsocket/StreamAccounting.h"
+#include "rsocket/TenantQuotas.h"
+#include "rsocket/framing/FramedReader.h"
+#include "rsocket/internal/AdmissionController.h"
+#include "rsocket/internal/MemoryPressureController.h"
 #include "rsocket/internal/ConnectionSet.h"
+#include "rsocket/internal/EventBaseMonitor.h"
+#include "rsocket/internal/ResumeBufferBudget.h"
 #include "rsocket/internal/SetupResumeAcceptor.h"
+#include "rsocket/internal/WarmResumeManager.h"
 
 namespace rsocket {
 
@@ -38,6 +54,9 @@ namespace rsocket {
  */
 class RSocketServer {
  public:
+  using ResumeManagerFactory = std::function<std::shared_ptr<ResumeManager>(
+      std::shared_ptr<RSocketStats>)>;
+
   explicit RSocketServer(
       std::unique_ptr<ConnectionAcceptor>,
       std::shared_ptr<RSocketStats> stats = RSocketStats::noop());
@@ -89,8 +108,33 @@ class RSocketServer {
       folly::EventBase& eventBase,
       std::shared_ptr<RSocketServiceHandler> serviceHandler);
 
+  /**
+   * Stop accepting connections, close all of them and wait for them to have
+   * closed.  Called by the destructor.
+   */
   void shutdownAndWait();
 
+  struct DrainOptions {
+    /// Time the streams of a connection are given to end before the
+    /// connection is closed anyway.
+    std::chrono::milliseconds timeout{std::chrono::seconds{30}};
+
+    /// Called with the number of connections still open every
+    /// progressInterval while draining, and with zero at the end.
+    std::function<void(size_t)> onProgress;
+    std::chrono::milliseconds progressInterval{std::chrono::seconds{1}};
+  };
+
+  /**
+   * Shut down gracefully: stop accepting connections, and close each one once
+   * its streams have ended, or after `options.timeout` at the latest.  The
+   * clients get a connection ERROR, so that they reconnect elsewhere, and
+   * their new requests are rejected in the meantime.  The connections drain
+   * in parallel, on their own EventBases.  Blocks until all of them have
+   * closed.
+   */
+  void drainAndWait(DrainOptions options);
+
   /**
    * Gets the port the ConnectionAcceptor is listening on.  Returns folly::none
    * if this server is not listening on a port.
@@ -103,22 +147,281 @@ class RSocketServer {
    */
   void setSingleThreadedResponder();
 
+  /**
+   * Run the responder of every connection on the given Executor, e.g. a
+   * CPUThreadPoolExecutor shared by the whole server, instead of on the
+   * EventBase of the connection.  The state machine of a connection stays on
+   * its EventBase.  The calls of each stream still reach the responder one
+   * at a time and in order, but different streams of one connection run in
+   * parallel.  Overrides setSingleThreadedResponder().  Must be called before
+   * start() or acceptConnection().
+   */
+  void setResponderExecutor(folly::Executor::KeepAlive<> executor);
+
+  /**
+   * Move the state machine of a connection resumed on another EventBase onto
+   * the EventBase of the new transport, instead of hopping between the two
+   * for every frame.  Only possible for connections that have no streams and
+   * don't use leases; the others keep the hop.
+   */
+  void setMigrateOnResume();
+
+  struct RebalanceOptions {
+    /// Time between two rounds of startRebalancing().
+    std::chrono::milliseconds interval{std::chrono::seconds{10}};
+
+    /// An EventBase is overloaded once it has more connections than the
+    /// average over all the EventBases by this fraction.
+    double imbalanceThreshold{0.2};
+
+    /// Most connections moved per round.
+    size_t maxMovesPerRound{64};
+  };
+
+  /**
+   * Move connections from the overloaded EventBases, those with the most
+   * connections, onto those with the fewest, bringing them towards the
+   * average.  The EventBases are the ones that accepted a connection so far.
+   * A connection moves along with its transport, and only while it has no
+   * streams (see RSocketStateMachine::canMoveConnectedToEventBase()), so
+   * that no stream is interrupted: busy connections are left for a later
+   * round.  Only connections whose transport can be detached from its
+   * EventBase move, e.g. TCP ones.  Returns the number of connections moved.
+   */
+  folly::SemiFuture<size_t> rebalance(const RebalanceOptions& options);
+
+  /**
+   * Call rebalance() every `options.interval`, from a thread of its own,
+   * until the server shuts down.  Does nothing once it has shut down.  Can
+   * only be called once.
+   */
+  void startRebalancing(RebalanceOptions options);
+
+  /**
+   * Grant leases from the given sender to clients that ask to honor leases,
+   * and reject their requests beyond those leases.  Clients asking for leases
+   * are rejected when no sender is set.  Must be called before start() or
+   * acceptConnection().
+   */
+  void setLeaseSender(std::shared_ptr<LeaseSender> leaseSender);
+
+  /**
+   * Reject new requests with REJECTED, before they reach the responder, while
+   * the EventBase of their connection is overloaded.  Each EventBase measures
+   * its own queueing delay, see AdmissionController.  Must be called before
+   * start() or acceptConnection().
+   */
+  void setAdmissionControl(AdmissionController::Options options);
+
+  /**
+   * Degrade the connections of the server while the controller reports
+   * memory pressure: their streams keep less credit outstanding with the
+   * peer, their resume buffers are capped and, once pressure is critical,
+   * their new requests are rejected with REJECTED.  Limits are restored as
+   * pressure clears.  See MemoryPressureController, and
+   * TcpConnectionAcceptor::Options::memoryPressure to also pause accepting.
+   * Must be called before start() or acceptConnection().
+   */
+  void setMemoryPressure(
+      std::shared_ptr<const MemoryPressureController> controller);
+
+  /**
+   * Report the loop lag, NotificationQueue depth and time spent per activity
+   * of every EventBase thread serving connections to the RSocketStats of the
+   * server, see EventBaseMonitor.  Must be called before start() or
+   * acceptConnection().
+   */
+  void setEventBaseMonitoring(EventBaseMonitor::Options options);
+
+  /**
+   * Enforce per-tenant quotas on the connections of the server, see
+   * TenantQuotas.  Connections past the connection quota of their tenant are
+   * rejected at setup, and the connections of tenants with a resume buffer
+   * quota share a ResumeBufferBudget, in place of the resume managers of
+   * setResumeManagerFactory().  Must be called before start() or
+   * acceptConnection().
+   */
+  void setTenantQuotas(std::shared_ptr<TenantQuotas> quotas);
+
+  /**
+   * Account for the bytes and handler time of the streams of every
+   * connection of the server, see StreamAccounting.  Must be called before
+   * start() or acceptConnection().
+   */
+  void setStreamAccounting(std::shared_ptr<StreamAccounting> accounting);
+
+  /**
+   * Frame the input of connections that aren't framed by their transport
+   * (e.g. TCP) with the given options, e.g. to copy small frames out of large
+   * read buffers.  Must be called before start() or acceptConnection().
+   */
+  void setFramedReaderOptions(FramedReader::Options options);
+
+  /**
+   * Bound the capacity hints of the SETUP frames of clients (see
+   * CapacityHints) by these limits, each hint by the field of the same name.
+   * The bounded hints size the stream table and read buffer of a connection,
+   * and the capacity of the WarmResumeManager of a resumable connection that
+   * the server creates itself, i.e. without setResumeManagerFactory().  Zero
+   * limits ignore the hint.  Must be called before start() or
+   * acceptConnection().
+   */
+  void setCapacityHintLimits(CapacityHints limits);
+
+  /**
+   * Create the ResumeManager of each resumable connection with the given
+   * factory, e.g. to keep sent frames in a RingResumeManager.  By default,
+   * connections get a WarmResumeManager.  The factory is called concurrently
+   * from the threads accepting connections.  Must be called before start() or
+   * acceptConnection().
+   */
+  void setResumeManagerFactory(ResumeManagerFactory factory);
+
+  /**
+   * Give each resumable connection a WarmResumeManager of the given capacity
+   * that draws from the shared budget, so that connections can buffer a lot
+   * of frames while the server as a whole stays within the budget.  Replaces
+   * the factory set with setResumeManagerFactory().  Must be called before
+   * start() or acceptConnection().
+   */
+  void setResumeBufferBudget(
+      std::shared_ptr<ResumeBufferBudget> budget,
+      size_t capacityPerConnection = WarmResumeManager::DEFAULT_CAPACITY);
+
+  /**
+   * Let resumable sessions move between server instances, e.g. when clients
+   * reconnect to another instance behind a load balancer during a deploy.  A
+   * client resuming a session the server doesn't have resumes the state
+   * fetched from `handoff`, and drainAndWait() pushes the state of the
+   * sessions in the server's resume index to `handoff` and disconnects their
+   * clients without an ERROR, instead of closing the sessions.  A session
+   * taken over gets its responder from RSocketServiceHandler::onNewSetup(),
+   * called with the SETUP parameters of the session but not its payload.
+   * See ResumeHandoffState for what survives the move.  Must be called before
+   * start() or acceptConnection().
+   */
+  void setResumeStateHandoff(std::shared_ptr<ResumeStateHandoff> handoff);
+
+  /**
+   * Hand the session with the given resume token over to another server:
+   * close it here, and return its state for the other server's
+   * ResumeStateHandoff::fetch().  Returns folly::none if the session isn't in
+   * the server's resume index (see RSocketServiceHandler) or can't be handed
+   * over (see RSocketStateMachine::exportResumeState()).
+   */
+  folly::SemiFuture<folly::Optional<ResumeHandoffState>> handOff(
+      const ResumeIdentificationToken& token);
+
   /**
    * Number of active connections to this server.
    */
   size_t getNumConnections();
 
+  /**
+   * Memory held by all the connections to this server, see
+   * RSocketStateMachine::memoryUsage().
+   */
+  folly::SemiFuture<MemoryUsage> memoryUsage() const;
+
+  /**
+   * Flow control state of every connection to this server, see
+   * RSocketStateMachine::flowControl().  Each connection is read on its own
+   * EventBase.
+   */
+  folly::SemiFuture<std::vector<ConnectionFlowControl>> flowControl() const;
+
+  /**
+   * Send a METADATA_PUSH frame with the given metadata to every connection,
+   * e.g. to push a configuration or routing update.  The frame is serialized
+   * once and shared by all the connections.  Returns the number of
+   * connections it was sent to.  Doesn't wait for the frames to be written.
+   */
+  size_t broadcastMetadataPush(std::unique_ptr<folly::IOBuf> metadata);
+
+  /**
+   * Send a fire-and-forget request to every connection, e.g. to push a
+   * notification to the clients.  The frame is serialized once, and only its
+   * stream id is written for each connection.  Returns the number of
+   * connections it was sent to.  Doesn't wait for the frames to be written.
+   */
+  size_t broadcastFireAndForget(Payload request);
+
+  /**
+   * Request a stream from every connection.  `makeSubscriber` is called on
+   * the EventBase of each connection, concurrently, for the subscriber of
+   * its stream.  The streams share the buffers of `request`.  Returns the
+   * number of connections the stream was requested from.
+   */
+  size_t broadcastRequestStream(
+      Payload request,
+      std::function<std::shared_ptr<yarpl::flowable::Subscriber<Payload>>()>
+          makeSubscriber);
+
  private:
   static void onRSocketSetup(
       std::shared_ptr<RSocketServiceHandler> serviceHandler,
       std::shared_ptr<ConnectionSet> connectionSet,
       bool scheduledResponder,
+      folly::Executor::KeepAlive<> responderExecutor,
+      std::shared_ptr<LeaseSender> leaseSender,
+      std::shared_ptr<AdmissionController> admissionController,
+      std::shared_ptr<const MemoryPressureController> memoryPressure,
+      const std::shared_ptr<TenantQuotas>& tenantQuotas,
+      std::shared_ptr<StreamAccounting> streamAccounting,
+      const ResumeManagerFactory& resumeManagerFactory,
+      const CapacityHints& capacityHintLimits,
       std::unique_ptr<DuplexConnection> connection,
       rsocket::SetupParameters setupPayload);
   void onRSocketResume(
       std::shared_ptr<RSocketServiceHandler> serviceHandler,
       std::unique_ptr<DuplexConnection> connection,
       rsocket::ResumeParameters setupPayload);
+  folly::Expected<std::shared_ptr<RSocketServerState>, RSocketException>
+  lookUpResumable(const ResumeIdentificationToken&);
+
+  /// Creates the state machine of a new session, and adds it to the
+  /// connection set.  Returns nullptr if the set is closed.
+  static std::shared_ptr<RSocketStateMachine> createSession(
+      RSocketServiceHandler& serviceHandler,
+      ConnectionSet& connectionSet,
+      folly::EventBase& eventBase,
+      bool scheduledResponder,
+      folly::Executor::KeepAlive<> responderExecutor,
+      RSocketConnectionParams connectionParams,
+      std::shared_ptr<ResumeManager> resumeManager,
+      const SetupParameters& setupParams);
+
+  /// Resumes a session this server doesn't have from the state fetched from
+  /// the ResumeStateHandoff, see setResumeStateHandoff().
+  void fetchHandedOff(
+      std::shared_ptr<RSocketServiceHandler> serviceHandler,
+      std::unique_ptr<DuplexConnection> connection,
+      rsocket::ResumeParameters resumeParams);
+  static void takeOver(
+      RSocketServiceHandler& serviceHandler,
+      ConnectionSet& connectionSet,
+      folly::EventBase& eventBase,
+      bool scheduledResponder,
+      folly::Executor::KeepAlive<> responderExecutor,
+      std::shared_ptr<AdmissionController> admissionController,
+      const ResumeManagerFactory& resumeManagerFactory,
+      std::unique_ptr<DuplexConnection> connection,
+      rsocket::ResumeParameters resumeParams,
+      ResumeHandoffState state);
+
+  /// Moves up to `count` connections from one EventBase to another, see
+  /// rebalance().  The connections get the AdmissionController of their new
+  /// EventBase, if any.
+  static folly::SemiFuture<size_t> moveConnections(
+      std::shared_ptr<ConnectionSet> connectionSet,
+      folly::EventBase& from,
+      folly::EventBase& to,
+      std::shared_ptr<AdmissionController> admissionController,
+      size_t count);
+
+  /// Stops the acceptor and closes the connections still in SETUP/RESUME.
+  /// Returns false if the server was shut down already.
+  bool stopAccepting();
 
   const std::unique_ptr<ConnectionAcceptor> duplexConnectionAcceptor_;
   bool started{false};
@@ -139,5 +442,57 @@ class RSocketServer {
    * be scheduled to another event base.
    */
   bool useScheduledResponder_{true};
+
+  /// See setMigrateOnResume().
+  bool migrateOnResume_{false};
+
+  /// See setResponderExecutor().
+  folly::Executor::KeepAlive<> responderExecutor_;
+
+  std::shared_ptr<LeaseSender> leaseSender_;
+  std::shared_ptr<TenantQuotas> tenantQuotas_;
+  std::shared_ptr<StreamAccounting> streamAccounting_;
+  ResumeManagerFactory resumeManagerFactory_;
+
+  /// See setCapacityHintLimits().
+  CapacityHints capacityHintLimits_{4096, 64 * 1024, 16 * 1024 * 1024};
+
+  /// See setResumeStateHandoff().
+  std::shared_ptr<ResumeStateHandoff> resumeStateHandoff_;
+
+  /// See setAdmissionControl(), with one controller per EventBase thread.
+  folly::Optional<AdmissionController::Options> admissionOptions_;
+
+  /// See setMemoryPressure().
+  std::shared_ptr<const MemoryPressureController> memoryPressure_;
+
+  /// See setFramedReaderOptions().
+  FramedReader::Options framedReaderOptions_;
+  class AdmissionControllerTag {};
+  folly::ThreadLocal<
+      std::shared_ptr<AdmissionController>,
+      AdmissionControllerTag>
+      admissionControllers_;
+
+  /// See setEventBaseMonitoring(), with one monitor per EventBase thread.
+  folly::Optional<EventBaseMonitor::Options> monitoringOptions_;
+  class EventBaseMonitorTag {};
+  folly::ThreadLocal<std::shared_ptr<EventBaseMonitor>, EventBaseMonitorTag>
+      eventBaseMonitors_;
+
+  /// EventBases that accepted connections, with their AdmissionController.
+  folly::Synchronized<
+      std::unordered_map<
+          folly::EventBase*,
+          std::shared_ptr<AdmissionController>>,
+      std::mutex>
+      eventBases_;
+  /// Whether the EventBase of the thread is in eventBases_ already.
+  class EventBaseKnownTag {};
+  folly::ThreadLocal<bool, EventBaseKnownTag> eventBaseKnown_;
+
+  /// See startRebalancing().
+  std::thread rebalancer_;
+  folly::Baton<> stopRebalancing_;
 };
 } // namespace rsocket
@@ -14,7 +14,12 @@
 
 #pragma once
 
+#include <atomic>
+
+#include <folly/Function.h>
+
 #include "rsocket/RSocketRequester.h"
+#include "rsocket/internal/ScheduledRSocketResponder.h"
 
 namespace folly {
 class EventBase;
@@ -25,7 +30,7 @@ namespace rsocket {
 class RSocketServerState {
  public:
   void close() {
-    eventBase_.runInEventBaseThread([sm = rSocketStateMachine_] {
+    eventBase()->runInEventBaseThread([sm = rSocketStateMachine_] {
       sm->close({}, StreamCompletionSignal::SOCKET_CLOSED);
     });
   }
@@ -35,22 +40,72 @@ class RSocketServerState {
   }
 
   folly::EventBase* eventBase() {
-    return &eventBase_;
+    return eventBase_.load(std::memory_order_acquire);
   }
 
+  friend class ConnectionSet;
   friend class RSocketServer;
 
  private:
   RSocketServerState(
       folly::EventBase& eventBase,
       std::shared_ptr<RSocketStateMachine> stateMachine,
-      std::shared_ptr<RSocketRequester> rSocketRequester)
-      : eventBase_(eventBase),
+      std::shared_ptr<RSocketRequester> rSocketRequester,
+      std::shared_ptr<ScheduledRSocketResponder> scheduledResponder = nullptr)
+      : eventBase_(&eventBase),
         rSocketStateMachine_(stateMachine),
-        rSocketRequester_(rSocketRequester) {}
+        rSocketRequester_(rSocketRequester),
+        scheduledResponder_(std::move(scheduledResponder)) {}
+
+  // Moves the connection onto another EventBase, see
+  // RSocketStateMachine::moveToEventBase().  Must be called on the current
+  // one.
+  void moveToEventBase(folly::EventBase& eventBase) {
+    rSocketStateMachine_->moveToEventBase(eventBase);
+    rSocketRequester_->setEventBase(eventBase);
+    if (scheduledResponder_) {
+      scheduledResponder_->setEventBase(eventBase);
+    }
+    eventBase_.store(&eventBase, std::memory_order_release);
+  }
+
+  // Moves a connected connection, transport included, onto another
+  // EventBase, see RSocketStateMachine::moveConnectedToEventBase().
+  // `onAttached` runs on `eventBase` once the transport is attached to it,
+  // before any call made to the requester from then on.  Returns false,
+  // leaving the connection where it is, if calls to the requester are still
+  // waiting to run on the current EventBase.  Must be called on the current
+  // one.
+  bool moveConnectedToEventBase(
+      folly::EventBase& eventBase,
+      folly::Function<void()> onAttached) {
+    auto& current = *this->eventBase();
+    const auto& machine = rSocketStateMachine_;
+    machine->moveConnectedToEventBase(eventBase);
+    auto const moved = rSocketRequester_->trySetEventBase(
+        eventBase,
+        [machine, onAttached = std::move(onAttached)](
+            folly::EventBase& evb) mutable {
+          machine->attachToEventBase(evb);
+          onAttached();
+        });
+    if (!moved) {
+      machine->attachToEventBase(current);
+      return false;
+    }
+    if (scheduledResponder_) {
+      scheduledResponder_->setEventBase(eventBase);
+    }
+    eventBase_.store(&eventBase, std::memory_order_release);
+    return true;
+  }
 
-  folly::EventBase& eventBase_;
+  // Changes when the connection moves on resumption or rebalancing.
+  std::atomic<folly::EventBase*> eventBase_;
   const std::shared_ptr<RSocketStateMachine> rSocketStateMachine_;
   const std::shared_ptr<RSocketRequester> rSocketRequester_;
+  // The responder of the connection, if its calls are scheduled on the
+  // EventBase of the connection.
+  const std::shared_ptr<ScheduledRSocketResponder> scheduledResponder_;
 };
 } // namespace rsocket
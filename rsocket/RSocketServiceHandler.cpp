@@ -32,11 +32,17 @@ bool RSocketServiceHandler::canResume(
   return true;
 }
 
+bool RSocketServiceHandler::useServerResumeIndex() const {
+  return false;
+}
+
 std::shared_ptr<RSocketServiceHandler> RSocketServiceHandler::create(
-    OnNewSetupFn onNewSetupFn) {
+    OnNewSetupFn onNewSetupFn,
+    bool resumable) {
   class ServiceHandler : public RSocketServiceHandler {
    public:
-    explicit ServiceHandler(OnNewSetupFn fn) : onNewSetupFn_(std::move(fn)) {}
+    ServiceHandler(OnNewSetupFn fn, bool resumable)
+        : onNewSetupFn_(std::move(fn)), resumable_(resumable) {}
     folly::Expected<RSocketConnectionParams, RSocketException> onNewSetup(
         const SetupParameters& setupParameters) override {
       try {
@@ -47,9 +53,14 @@ std::shared_ptr<RSocketServiceHandler> RSocketServiceHandler::create(
       }
     }
 
+    bool useServerResumeIndex() const override {
+      return resumable_;
+    }
+
    private:
     OnNewSetupFn onNewSetupFn_;
+    const bool resumable_;
   };
-  return std::make_shared<ServiceHandler>(std::move(onNewSetupFn));
+  return std::make_shared<ServiceHandler>(std::move(onNewSetupFn), resumable);
 }
 } // namespace rsocket
@@ -16,6 +16,7 @@
 
 #include <folly/Expected.h>
 
+#include "rsocket/FrameCapture.h"
 #include "rsocket/RSocketConnectionEvents.h"
 #include "rsocket/RSocketException.h"
 #include "rsocket/RSocketParameters.h"
@@ -44,6 +45,10 @@ struct RSocketConnectionParams {
   std::shared_ptr<RSocketResponder> responder;
   std::shared_ptr<RSocketStats> stats;
   std::shared_ptr<RSocketConnectionEvents> connectionEvents;
+
+  // If set, the frames of the connection are recorded into this capture, e.g.
+  // for a sample of the connections.  See FrameCapture.
+  std::shared_ptr<FrameCapture> frameCapture;
 };
 
 // This class has to be implemented by the application.  The methods can be
@@ -103,8 +108,16 @@ class RSocketServiceHandler {
       const std::vector<StreamId>& /* dirtyStreamIds */,
       ResumeIdentificationToken) const;
 
-  // Convenience constructor to create a simple RSocketServiceHandler.
+  // If this returns true, the server resumes connections by looking up the
+  // resume token in its own index of resumable connections, and onResume() is
+  // not called.  The application then doesn't need to keep the
+  // RSocketServerState objects around itself.
+  virtual bool useServerResumeIndex() const;
+
+  // Convenience constructor to create a simple RSocketServiceHandler.  If
+  // resumable is true, it resumes connections through the server's index.
   static std::shared_ptr<RSocketServiceHandler> create(
-      OnNewSetupFn onNewSetupFn);
+      OnNewSetupFn onNewSetupFn,
+      bool resumable = false);
 };
 } // namespace rsocket
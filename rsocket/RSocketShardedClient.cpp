@@ -0,0 +1,209 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/RSocketShardedClient.h"
+
+#include <folly/executors/InlineExecutor.h>
+#include <folly/io/async/EventBaseManager.h>
+#include <glog/logging.h>
+
+#include <atomic>
+#include <unordered_map>
+
+namespace rsocket {
+
+/// Which shard serves the requests made on each worker.
+struct RSocketShardedClient::Routes {
+  std::unordered_map<folly::EventBase*, size_t> shards;
+
+  /// Round-robin counter for requests made off the workers.
+  mutable std::atomic<size_t> next{0};
+
+  size_t shardOfCallingThread(size_t numShards) const {
+    auto const eventBase =
+        folly::EventBaseManager::get()->getExistingEventBase();
+    if (eventBase) {
+      auto it = shards.find(eventBase);
+      if (it != shards.end()) {
+        return it->second;
+      }
+    }
+    return next.fetch_add(1, std::memory_order_relaxed) % numShards;
+  }
+};
+
+/// Forwards every request to the requester of the shard of the calling
+/// thread, which runs it in-line.
+class RSocketShardedClient::Requester : public RSocketRequester {
+ public:
+  Requester(
+      std::shared_ptr<const Routes> routes,
+      std::vector<std::shared_ptr<RSocketRequester>> shards)
+      : RSocketRequester(nullptr, std::shared_ptr<SwappableEventBase>()),
+        routes_(std::move(routes)),
+        shards_(std::move(shards)) {}
+
+  using RSocketRequester::requestChannel;
+
+  std::shared_ptr<yarpl::flowable::Flowable<Payload>> requestStream(
+      Payload request) override {
+    return local().requestStream(std::move(request));
+  }
+
+  std::shared_ptr<yarpl::single::Single<Payload>> requestResponse(
+      Payload request) override {
+    return local().requestResponse(std::move(request));
+  }
+
+  folly::SemiFuture<Payload> requestResponseFuture(Payload request) override {
+    return local().requestResponseFuture(std::move(request));
+  }
+
+  std::shared_ptr<yarpl::single::Single<void>> fireAndForget(
+      Payload request) override {
+    return local().fireAndForget(std::move(request));
+  }
+
+  void fireAndForgetBatch(std::vector<Payload> requests) override {
+    local().fireAndForgetBatch(std::move(requests));
+  }
+
+  /// Pushes the metadata on every connection.
+  void metadataPush(std::unique_ptr<folly::IOBuf> metadata) override {
+    for (auto& shard : shards_) {
+      shard->metadataPush(metadata->clone());
+    }
+  }
+
+  /// Closes every connection.
+  void closeSocket() override {
+    for (auto& shard : shards_) {
+      shard->closeSocket();
+    }
+  }
+
+  std::shared_ptr<RSocketRequester> withOutputWeight(uint32_t weight) override {
+    return derived([weight](RSocketRequester& r) {
+      return r.withOutputWeight(weight);
+    });
+  }
+
+  std::shared_ptr<RSocketRequester> withoutResumption() override {
+    return derived([](RSocketRequester& r) { return r.withoutResumption(); });
+  }
+
+  std::shared_ptr<RSocketRequester> withDeadline(
+      RequestDeadline::Clock::time_point deadline) override {
+    return derived(
+        [deadline](RSocketRequester& r) { return r.withDeadline(deadline); });
+  }
+
+  std::shared_ptr<RSocketRequester> withBulkTraffic() override {
+    return derived([](RSocketRequester& r) { return r.withBulkTraffic(); });
+  }
+
+ protected:
+  std::shared_ptr<yarpl::flowable::Flowable<Payload>> requestChannel(
+      Payload request,
+      bool hasInitialRequest,
+      std::shared_ptr<yarpl::flowable::Flowable<Payload>> requests) override {
+    auto& shard = local();
+    return hasInitialRequest
+        ? shard.requestChannel(std::move(request), std::move(requests))
+        : shard.requestChannel(std::move(requests));
+  }
+
+ private:
+  RSocketRequester& local() const {
+    return *shards_[routes_->shardOfCallingThread(shards_.size())];
+  }
+
+  template <typename F>
+  std::shared_ptr<RSocketRequester> derived(F&& derive) const {
+    std::vector<std::shared_ptr<RSocketRequester>> shards;
+    shards.reserve(shards_.size());
+    for (auto& shard : shards_) {
+      shards.push_back(derive(*shard));
+    }
+    return std::make_shared<Requester>(routes_, std::move(shards));
+  }
+
+  const std::shared_ptr<const Routes> routes_;
+  /// Indexed by shard.
+  const std::vector<std::shared_ptr<RSocketRequester>> shards_;
+};
+
+folly::Future<std::unique_ptr<RSocketShardedClient>>
+RSocketShardedClient::connect(
+    std::vector<folly::EventBase*> eventBases,
+    ClientFactory factory) {
+  CHECK(!eventBases.empty());
+  std::vector<folly::Future<std::unique_ptr<RSocketClient>>> clients;
+  clients.reserve(eventBases.size());
+  for (auto eventBase : eventBases) {
+    CHECK(eventBase);
+    clients.push_back(factory(*eventBase));
+  }
+
+  return folly::collect(std::move(clients))
+      .via(&folly::InlineExecutor::instance())
+      .thenValue([eventBases = std::move(eventBases)](
+                     std::vector<std::unique_ptr<RSocketClient>> clients) {
+        return std::unique_ptr<RSocketShardedClient>(
+            new RSocketShardedClient(eventBases, std::move(clients)));
+      });
+}
+
+RSocketShardedClient::RSocketShardedClient(
+    std::vector<folly::EventBase*> eventBases,
+    std::vector<std::unique_ptr<RSocketClient>> clients)
+    : clients_(std::move(clients)),
+      requester_([&] {
+        auto routes = std::make_shared<Routes>();
+        std::vector<std::shared_ptr<RSocketRequester>> shards;
+        shards.reserve(clients_.size());
+        for (size_t i = 0; i < clients_.size(); ++i) {
+          routes->shards.emplace(eventBases[i], i);
+          shards.push_back(clients_[i]->getRequester());
+        }
+        return std::make_shared<Requester>(
+            std::move(routes), std::move(shards));
+      }()) {}
+
+RSocketShardedClient::~RSocketShardedClient() {
+  VLOG(3) << "~RSocketShardedClient ..";
+}
+
+const std::shared_ptr<RSocketRequester>& RSocketShardedClient::getRequester()
+    const {
+  return requester_;
+}
+
+RSocketClient& RSocketShardedClient::getClient(size_t shard) const {
+  return *clients_.at(shard);
+}
+
+folly::Future<folly::Unit> RSocketShardedClient::disconnect(
+    folly::exception_wrapper ew) {
+  std::vector<folly::Future<folly::Unit>> disconnects;
+  disconnects.reserve(clients_.size());
+  for (auto& client : clients_) {
+    disconnects.push_back(client->disconnect(ew));
+  }
+  return folly::collectAll(std::move(disconnects))
+      .via(&folly::InlineExecutor::instance())
+      .thenValue([](std::vector<folly::Try<folly::Unit>>) {});
+}
+
+} // namespace rsocket
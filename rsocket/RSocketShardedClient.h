@@ -0,0 +1,100 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/futures/Future.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "rsocket/RSocketClient.h"
+#include "rsocket/RSocketRequester.h"
+
+namespace folly {
+class EventBase;
+}
+
+namespace rsocket {
+
+/**
+ * API for spreading the requests of a multi-core client over one connection
+ * per worker thread.
+ *
+ * Keeps an RSocketClient per worker EventBase, whose state machine runs on
+ * that EventBase.  getRequester() sends every request over the connection of
+ * the EventBase of the calling thread, so that requests made on a worker
+ * never hop threads.  Requests made on other threads are spread round-robin
+ * over the connections.
+ *
+ * Streams stay on the connection they were opened on.  A lost connection is
+ * not replaced, its requests fail until it resumes.
+ */
+class RSocketShardedClient {
+ public:
+  /// Connects the client of one worker.  The state machine of the client
+  /// must run on `eventBase`, e.g. pass it as stateMachineEvb and connect
+  /// with a transport on it.
+  using ClientFactory =
+      std::function<folly::Future<std::unique_ptr<RSocketClient>>(
+          folly::EventBase& eventBase)>;
+
+  /// Connects a client for every worker EventBase.  Fails if any of them
+  /// fails to connect.
+  static folly::Future<std::unique_ptr<RSocketShardedClient>> connect(
+      std::vector<folly::EventBase*> eventBases,
+      ClientFactory factory);
+
+  ~RSocketShardedClient();
+
+  RSocketShardedClient(const RSocketShardedClient&) = delete;
+  RSocketShardedClient(RSocketShardedClient&&) = delete;
+  RSocketShardedClient& operator=(const RSocketShardedClient&) = delete;
+  RSocketShardedClient& operator=(RSocketShardedClient&&) = delete;
+
+  /**
+   * Returns the requester sending each request over the connection of the
+   * calling thread.
+   */
+  const std::shared_ptr<RSocketRequester>& getRequester() const;
+
+  /**
+   * Returns the client of a worker, in the order of the EventBases given to
+   * connect().
+   */
+  RSocketClient& getClient(size_t shard) const;
+
+  size_t getNumShards() const {
+    return clients_.size();
+  }
+
+  /**
+   * Disconnects every client.
+   */
+  folly::Future<folly::Unit> disconnect(folly::exception_wrapper = {});
+
+ private:
+  class Requester;
+  struct Routes;
+
+  RSocketShardedClient(
+      std::vector<folly::EventBase*> eventBases,
+      std::vector<std::unique_ptr<RSocketClient>> clients);
+
+  const std::vector<std::unique_ptr<RSocketClient>> clients_;
+  const std::shared_ptr<RSocketRequester> requester_;
+};
+
+} // namespace rsocket
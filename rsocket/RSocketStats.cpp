@@ -40,6 +40,9 @@ class NoopStats : public RSocketStats {
 
   void bytesWritten(size_t) override {}
   void bytesRead(size_t) override {}
+  void bytesWrittenZeroCopy(size_t) override {}
+  void bytesWrittenCopied(size_t) override {}
+  void kernelTls(DuplexConnection*, bool, bool) override {}
   void frameWritten(FrameType) override {}
   void frameRead(FrameType) override {}
   void serverResume(folly::Optional<int64_t>, int64_t, int64_t, ResumeOutcome)
@@ -51,6 +54,7 @@ class NoopStats : public RSocketStats {
 
   void keepaliveSent() override {}
   void keepaliveReceived() override {}
+  void keepaliveSuppressed() override {}
 
   static std::shared_ptr<NoopStats> instance() {
     static const auto singleton = std::make_shared<NoopStats>();
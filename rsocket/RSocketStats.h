@@ -15,6 +15,7 @@
 #pragma once
 
 #include <folly/Optional.h>
+#include <chrono>
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -22,6 +23,10 @@
 #include "rsocket/framing/FrameType.h"
 #include "rsocket/internal/Common.h"
 
+namespace folly {
+class EventBase;
+}
+
 namespace rsocket {
 
 class DuplexConnection;
@@ -30,6 +35,14 @@ class RSocketStats {
  public:
   enum class ResumeOutcome { SUCCESS, FAILURE };
 
+  /// What the thread of an EventBase spends its time on, see
+  /// eventBaseActivity().
+  enum class EventBaseActivity { READ, FRAME_DISPATCH, RESPONDER, WRITE };
+
+  /// How far connections are degraded to save memory, see
+  /// memoryPressureChanged().
+  enum class MemoryPressure { NONE, ELEVATED, HIGH, CRITICAL };
+
   virtual ~RSocketStats() = default;
 
   static std::shared_ptr<RSocketStats> noop();
@@ -54,17 +67,123 @@ class RSocketStats {
       ResumeOutcome /* outcome */) {}
   virtual void bytesWritten(size_t /* bytes */) {}
   virtual void bytesRead(size_t /* bytes */) {}
+  /// Split of the bytes written on a connection which sends large writes with
+  /// MSG_ZEROCOPY, between those the kernel sent in place and those it copied.
+  virtual void bytesWrittenZeroCopy(size_t /* bytes */) {}
+  virtual void bytesWrittenCopied(size_t /* bytes */) {}
+  /// Whether the kernel took over the encryption (`send`) and decryption
+  /// (`receive`) of a TLS connection that asked for kTLS.
+  virtual void kernelTls(
+      DuplexConnection* /* connection */,
+      bool /* send */,
+      bool /* receive */) {}
   virtual void frameWritten(FrameType /* frameType */) {}
   virtual void frameRead(FrameType /* frameType */) {}
   virtual void resumeBufferChanged(
       int /* framesCountDelta */,
       int /* dataSizeDelta */) {}
+  /// Frames dropped from a resume buffer to keep a ResumeBufferBudget shared
+  /// with other connections within its limit.
+  virtual void resumeBufferEvictedForBudget(
+      int /* framesCount */,
+      int /* dataSize */) {}
   virtual void streamBufferChanged(
       int64_t /* framesCountDelta */,
       int64_t /* dataSizeDelta */) {}
+  /// Lifecycle of a stream opened by either end of a connection.  The first
+  /// payload is the first one going to the requester (the response, for a
+  /// request-response), `latency` after the stream was opened.  A stream is
+  /// closed `duration` after it was opened, with `bytes` of payloads sent and
+  /// received, including the request.
+  virtual void streamOpened(StreamType /* streamType */) {}
+  virtual void streamFirstPayload(
+      StreamType /* streamType */,
+      std::chrono::microseconds /* latency */) {}
+  virtual void streamClosed(
+      StreamType /* streamType */,
+      std::chrono::microseconds /* duration */,
+      size_t /* bytes */) {}
   virtual void resumeFailedNoState() {}
+  /// A cold resumption re-established `streams` requested streams, which took
+  /// the ColdResumeHandler `duration`.
+  virtual void coldResumeStreamsRestored(
+      size_t /* streams */,
+      std::chrono::microseconds /* duration */) {}
   virtual void keepaliveSent() {}
   virtual void keepaliveReceived() {}
+  /// A keepalive wasn't sent as frames received within its period showed
+  /// that the peer is alive.
+  virtual void keepaliveSuppressed() {}
+  virtual void payloadCompressed(
+      size_t /* rawBytes */,
+      size_t /* compressedBytes */) {}
+  virtual void payloadDecompressed(
+      size_t /* compressedBytes */,
+      size_t /* rawBytes */) {}
+  /// A stream state machine was created, with memory recycled from a closed
+  /// one if `fromPool` is set.
+  virtual void streamStateMachineAllocated(bool /* fromPool */) {}
+  virtual void leaseSent(uint32_t /* numberOfRequests */) {}
+  virtual void leaseReceived(uint32_t /* numberOfRequests */) {}
+  /// A request was failed or rejected because there was no lease for it.
+  virtual void requestWithoutLease() {}
+  /// A request was queued or rejected because too many streams were active.
+  virtual void streamLimitReached() {}
+  /// A request was rejected because its EventBase was overloaded, see
+  /// RSocketServer::setAdmissionControl().
+  virtual void requestRejectedOverloaded() {}
+  /// The memory pressure of the process changed level, at `bytes` of memory
+  /// used, see MemoryPressureController.
+  virtual void memoryPressureChanged(
+      MemoryPressure /* level */,
+      size_t /* bytes */) {}
+  /// A request was rejected because memory was critically tight.
+  virtual void requestRejectedMemoryPressure() {}
+  /// A request was cancelled, or dropped before reaching the responder,
+  /// because its deadline passed, see RequestDeadline.
+  virtual void requestDeadlineExpired() {}
+  /// Frames of streams past their deadline were dropped rather than sent,
+  /// see OutputScheduler::Options::earliestDeadlineFirst.
+  virtual void expiredFramesDropped(size_t /* frames */) {}
+  /// A connection or request was rejected because its tenant was over one
+  /// of its quotas, see TenantQuotas.
+  virtual void tenantQuotaExceeded() {}
+  /// A request-response joined an identical one already in flight, see
+  /// CoalescingRSocketResponder.
+  virtual void requestCoalesced() {}
+  /// A request-response was answered from, or missed, the cache of a
+  /// CachingRSocketResponder.
+  virtual void responseCacheHit() {}
+  virtual void responseCacheMiss() {}
+  /// A request matched none of the routes of a RoutingRSocketResponder.
+  virtual void requestUnrouted() {}
+  /// A request that may be hedged by an RSocketLoadBalancedClient was sent,
+  /// a backup of it was sent on another connection (`hedgeSent`), and the
+  /// backup responded first (`hedgeWon`).
+  virtual void hedgeableRequest() {}
+  virtual void hedgeSent() {}
+  virtual void hedgeWon() {}
+  /// Instrumentation of the EventBase threads of a server, reported from
+  /// the thread every interval, see RSocketServer::setEventBaseMonitoring().
+  /// `lag` is how late a timer of the loop fired, `queueDepth` the number of
+  /// callbacks waiting in its NotificationQueue.  `time` is the time the
+  /// thread spent on an activity over the interval.
+  virtual void eventBaseLoopLag(
+      folly::EventBase* /* eventBase */,
+      std::chrono::microseconds /* lag */,
+      size_t /* queueDepth */) {}
+  virtual void eventBaseActivity(
+      folly::EventBase* /* eventBase */,
+      EventBaseActivity /* activity */,
+      std::chrono::microseconds /* time */) {}
+  /// A client lost its connection and made an attempt to connect again, it
+  /// resumed after being disconnected for `downtime` and `rounds` rounds of
+  /// attempts, or it gave up, see RSocketClient::setAutoReconnect().
+  virtual void reconnectAttempted() {}
+  virtual void reconnected(
+      std::chrono::microseconds /* downtime */,
+      size_t /* rounds */) {}
+  virtual void reconnectAbandoned() {}
   virtual void unknownFrameReceived() {
   } // TODO(lehecka): add to all implementations
 };
@@ -0,0 +1,78 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/RequestDeadline.h"
+
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBuf.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace rsocket {
+
+namespace {
+
+thread_local folly::Optional<RequestDeadline::Clock::time_point>
+    currentDeadline;
+
+} // namespace
+
+constexpr uint32_t RequestDeadline::kExtendedType;
+
+folly::Optional<RequestDeadline::Clock::time_point>
+RequestDeadline::current() {
+  return currentDeadline;
+}
+
+bool RequestDeadline::expired() {
+  return currentDeadline && *currentDeadline <= Clock::now();
+}
+
+RequestDeadline::Scope::Scope(folly::Optional<Clock::time_point> deadline)
+    : previous_(std::move(currentDeadline)) {
+  currentDeadline = std::move(deadline);
+}
+
+RequestDeadline::Scope::~Scope() {
+  currentDeadline = std::move(previous_);
+}
+
+Frame_EXT RequestDeadline::frame(
+    StreamId streamId,
+    Clock::time_point deadline) {
+  auto const left = std::chrono::duration_cast<std::chrono::milliseconds>(
+      deadline - Clock::now());
+  auto const millis = std::min<int64_t>(
+      std::max<int64_t>(left.count(), 0),
+      std::numeric_limits<uint32_t>::max());
+
+  auto data = folly::IOBuf::create(sizeof(uint32_t));
+  folly::io::Appender appender(data.get(), 0);
+  appender.writeBE<uint32_t>(static_cast<uint32_t>(millis));
+  return Frame_EXT{
+      streamId, FrameFlags::IGNORE_, kExtendedType, std::move(data)};
+}
+
+folly::Optional<std::chrono::milliseconds> RequestDeadline::parse(
+    const Frame_EXT& frame) {
+  if (frame.extendedType_ != kExtendedType || !frame.data_ ||
+      frame.data_->computeChainDataLength() != sizeof(uint32_t)) {
+    return folly::none;
+  }
+  folly::io::Cursor cur(frame.data_.get());
+  return std::chrono::milliseconds{cur.readBE<uint32_t>()};
+}
+
+} // namespace rsocket
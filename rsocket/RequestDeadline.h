@@ -0,0 +1,77 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Optional.h>
+
+#include <chrono>
+#include <cstdint>
+
+#include "rsocket/framing/Frame.h"
+
+namespace rsocket {
+
+/// The deadline a requester attached to a request, see
+/// RSocketRequester::withDeadline().
+///
+/// The requester sends an EXT frame of kExtendedType carrying the time left
+/// until the deadline, as a 32-bit count of milliseconds, right before the
+/// frame that opens the stream.  The frame has the IGNORE flag, so peers that
+/// don't know about deadlines just skip it.  Sending the time left rather
+/// than the deadline itself keeps the clocks of the peers out of it, at the
+/// cost of the time the frame spends in flight.
+///
+/// Once the deadline passes the requester fails the request and cancels it,
+/// and the responder cancels the stream as if it received a CANCEL frame.  A
+/// request whose deadline passed before it reaches the responder is dropped
+/// without calling the RSocketResponder.  The frame isn't resumable, so a
+/// request replayed after a resumption is only bounded by the requester.
+class RequestDeadline {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr uint32_t kExtendedType = 0x00000002;
+
+  /// The deadline of the request the calling thread is handling, if it has
+  /// one.  Set for the duration of the calls to RSocketResponder that
+  /// start a request, including those run on a responder executor.
+  static folly::Optional<Clock::time_point> current();
+
+  /// Whether the request the calling thread is handling is past its
+  /// deadline.
+  static bool expired();
+
+  /// Sets the deadline current() returns for as long as it lives.
+  class Scope {
+   public:
+    explicit Scope(folly::Optional<Clock::time_point> deadline);
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    folly::Optional<Clock::time_point> previous_;
+  };
+
+  /// The frame attaching `deadline` to the request opening a stream.
+  static Frame_EXT frame(StreamId streamId, Clock::time_point deadline);
+
+  /// The time left until the deadline carried by an EXT frame of
+  /// kExtendedType, or folly::none if it is malformed.
+  static folly::Optional<std::chrono::milliseconds> parse(const Frame_EXT&);
+};
+
+} // namespace rsocket
@@ -53,6 +53,19 @@ struct StreamResumeInfo {
 
 using StreamResumeInfos = std::unordered_map<StreamId, StreamResumeInfo>;
 
+/// Bounds how fast a connection replays the frames of its ResumeManager once
+/// it resumes, so that a large replay doesn't hold up its EventBase.
+struct ResumeReplayOptions {
+  /// Bytes replayed per EventBase loop iteration.  The replay yields to the
+  /// other connections of the EventBase in between.  Zero replays all the
+  /// frames at once.
+  size_t maxBytesPerLoop{64 * 1024};
+
+  /// The replay waits while the transport buffers this many bytes of output,
+  /// see DuplexConnection::bufferedOutputBytes().  Zero disables the bound.
+  size_t maxBufferedOutputBytes{1024 * 1024};
+};
+
 // Applications desiring to have cold-resumption should implement a
 // ResumeManager interface.  By default, an in-memory implementation of this
 // interface (WarmResumeManager) will be used by RSocket.
@@ -105,6 +118,20 @@ class ResumeManager {
       ResumePosition position,
       FrameTransport& transport) const = 0;
 
+  // Sends the frames starting from "position" like sendFramesFromPosition(),
+  // but stops once about "maxBytes" have been sent, at a frame boundary and
+  // after at least one frame.  Returns the position to continue from, which
+  // is lastSentPosition() once all the frames have been sent.  Lets the
+  // state machine spread a large replay over several EventBase loop
+  // iterations.  By default, sends all the frames at once.
+  virtual ResumePosition sendFramesFromPositionUpTo(
+      ResumePosition position,
+      FrameTransport& transport,
+      size_t /* maxBytes */) const {
+    sendFramesFromPosition(position, transport);
+    return lastSentPosition();
+  }
+
   // This should return the first (oldest) available position in the send
   // buffer.
   virtual ResumePosition firstSentPosition() const = 0;
@@ -133,6 +160,19 @@ class ResumeManager {
   // Returns the largest used StreamId so far.
   virtual StreamId getLargestUsedStreamId() const = 0;
 
+  // Called when the connection gets a transport, on setup or on resumption.
+  virtual void onConnected() {}
+
+  // Called when the transport of a connection goes away, e.g. while it waits
+  // to be resumed.
+  virtual void onDisconnected() {}
+
+  // Bytes of sent frames held in memory for resumption.  Implementations
+  // storing them elsewhere can leave this at zero.
+  virtual size_t bufferedBytes() const {
+    return 0;
+  }
+
   // Utility method to check frames which should be tracked for resumption.
   virtual bool shouldTrackFrame(const FrameType frameType) const {
     switch (frameType) {
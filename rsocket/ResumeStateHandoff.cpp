@@ -0,0 +1,128 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/ResumeStateHandoff.h"
+
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBufQueue.h>
+
+#include <stdexcept>
+
+namespace rsocket {
+
+namespace {
+
+constexpr uint8_t kFormatVersion = 1;
+
+void writeString(folly::io::QueueAppender& appender, const std::string& str) {
+  appender.writeBE<uint32_t>(static_cast<uint32_t>(str.size()));
+  appender.push(reinterpret_cast<const uint8_t*>(str.data()), str.size());
+}
+
+std::string readString(folly::io::Cursor& cursor) {
+  auto const size = cursor.readBE<uint32_t>();
+  return cursor.readFixedString(size);
+}
+
+} // namespace
+
+std::unique_ptr<folly::IOBuf> ResumeHandoffState::serialize() const {
+  folly::IOBufQueue queue(folly::IOBufQueue::cacheChainLength());
+  folly::io::QueueAppender appender(&queue, 256);
+
+  appender.writeBE<uint8_t>(kFormatVersion);
+  appender.writeBE<uint16_t>(protocolVersion.major);
+  appender.writeBE<uint16_t>(protocolVersion.minor);
+  writeString(appender, metadataMimeType);
+  writeString(appender, dataMimeType);
+  writeString(appender, payloadCompression);
+  appender.writeBE<uint64_t>(byteCredit);
+  appender.writeBE<int64_t>(impliedPosition);
+  appender.writeBE<int64_t>(firstSentPosition);
+  appender.writeBE<uint32_t>(nextStreamId);
+
+  appender.writeBE<uint32_t>(static_cast<uint32_t>(openStreams.size()));
+  for (auto streamId : openStreams) {
+    appender.writeBE<uint32_t>(streamId);
+  }
+
+  appender.writeBE<uint32_t>(static_cast<uint32_t>(frames.size()));
+  for (const auto& frame : frames) {
+    appender.writeBE<uint32_t>(
+        static_cast<uint32_t>(frame->computeChainDataLength()));
+    // The frames are shared, not copied.
+    appender.insert(frame->clone());
+  }
+  return queue.move();
+}
+
+ResumeHandoffState ResumeHandoffState::deserialize(const folly::IOBuf& buf) {
+  ResumeHandoffState state;
+  folly::io::Cursor cursor(&buf);
+  try {
+    if (cursor.readBE<uint8_t>() != kFormatVersion) {
+      throw std::runtime_error("Unknown resume handoff state format");
+    }
+    state.protocolVersion.major = cursor.readBE<uint16_t>();
+    state.protocolVersion.minor = cursor.readBE<uint16_t>();
+    state.metadataMimeType = readString(cursor);
+    state.dataMimeType = readString(cursor);
+    state.payloadCompression = readString(cursor);
+    state.byteCredit = cursor.readBE<uint64_t>();
+    state.impliedPosition = cursor.readBE<int64_t>();
+    state.firstSentPosition = cursor.readBE<int64_t>();
+    state.nextStreamId = cursor.readBE<uint32_t>();
+
+    auto streams = cursor.readBE<uint32_t>();
+    while (streams-- > 0) {
+      state.openStreams.push_back(cursor.readBE<uint32_t>());
+    }
+
+    auto frames = cursor.readBE<uint32_t>();
+    while (frames-- > 0) {
+      auto const size = cursor.readBE<uint32_t>();
+      std::unique_ptr<folly::IOBuf> frame;
+      cursor.clone(frame, size);
+      state.frames.push_back(std::move(frame));
+    }
+  } catch (const std::out_of_range&) {
+    throw std::runtime_error("Truncated resume handoff state");
+  }
+  if (!cursor.isAtEnd()) {
+    throw std::runtime_error("Trailing bytes after resume handoff state");
+  }
+  return state;
+}
+
+void ResumeStateHandoff::push(ResumeIdentificationToken, ResumeHandoffState) {}
+
+folly::SemiFuture<folly::Optional<ResumeHandoffState>>
+InMemoryResumeStateHandoff::fetch(ResumeIdentificationToken token) {
+  auto states = states_.lock();
+  auto it = states->find(token);
+  if (it == states->end()) {
+    return folly::makeSemiFuture(folly::Optional<ResumeHandoffState>());
+  }
+  auto state = std::move(it->second);
+  states->erase(it);
+  return folly::makeSemiFuture(folly::make_optional(std::move(state)));
+}
+
+void InMemoryResumeStateHandoff::push(
+    ResumeIdentificationToken token,
+    ResumeHandoffState state) {
+  (*states_.lock())[std::move(token)] = std::move(state);
+}
+
+} // namespace rsocket
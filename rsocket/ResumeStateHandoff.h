@@ -0,0 +1,106 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/Synchronized.h>
+#include <folly/futures/Future.h>
+#include <folly/io/IOBuf.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "rsocket/framing/Frame.h"
+#include "rsocket/framing/ResumeIdentificationToken.h"
+
+namespace rsocket {
+
+/// State of a resumable session on a server, as another server instance needs
+/// it to take the session over when the client resumes there, e.g. after
+/// being moved by a load balancer during a deploy.
+///
+/// The streams of the session can't move along with it, as they are served by
+/// the responder of the original server: the new server ends the ones that
+/// were still open once the client has resumed.  Everything else carries on:
+/// the frames buffered for resumption are replayed from the new server.
+struct ResumeHandoffState {
+  /// From the SETUP the session started with.
+  ProtocolVersion protocolVersion;
+  std::string metadataMimeType;
+  std::string dataMimeType;
+  std::string payloadCompression;
+  size_t byteCredit{0};
+
+  ResumePosition impliedPosition{0};
+  /// The frames buffered for resumption, in order, the first one being at
+  /// firstSentPosition.
+  ResumePosition firstSentPosition{0};
+  std::vector<std::unique_ptr<folly::IOBuf>> frames;
+
+  /// Next id for a stream opened by the server.
+  StreamId nextStreamId{0};
+  std::vector<StreamId> openStreams;
+
+  /// Binary form of the state, to be sent between servers.
+  std::unique_ptr<folly::IOBuf> serialize() const;
+
+  /// Throws std::runtime_error if `buf` isn't a serialized state.
+  static ResumeHandoffState deserialize(const folly::IOBuf& buf);
+};
+
+/// Moves the state of resumable sessions between server instances, see
+/// RSocketServer::setResumeStateHandoff().  Applications implement it on top
+/// of whatever the instances share, e.g. RPCs between peers calling
+/// RSocketServer::handOff(), or a remote cache.
+///
+/// Calls can be made from any thread, and must not block.
+class ResumeStateHandoff {
+ public:
+  virtual ~ResumeStateHandoff() = default;
+
+  /// Called when a client resumes a session the server doesn't have.  Fetches
+  /// the state of the session, e.g. from the peer it's on, or from wherever a
+  /// peer pushed it.  Returns folly::none if there is no such session.
+  virtual folly::SemiFuture<folly::Optional<ResumeHandoffState>> fetch(
+      ResumeIdentificationToken token) = 0;
+
+  /// Called when the server drains (see RSocketServer::drainAndWait()) with
+  /// the state of every resumable session, before the client is
+  /// disconnected, so that it can resume on another instance.
+  virtual void push(ResumeIdentificationToken token, ResumeHandoffState state);
+};
+
+/// ResumeStateHandoff for servers in the same process, which hands the
+/// sessions pushed by one over to the others (for prototyping and testing
+/// purposes).
+class InMemoryResumeStateHandoff : public ResumeStateHandoff {
+ public:
+  folly::SemiFuture<folly::Optional<ResumeHandoffState>> fetch(
+      ResumeIdentificationToken token) override;
+
+  void push(ResumeIdentificationToken token, ResumeHandoffState state)
+      override;
+
+ private:
+  folly::Synchronized<
+      std::map<ResumeIdentificationToken, ResumeHandoffState>,
+      std::mutex>
+      states_;
+};
+
+} // namespace rsocket
@@ -0,0 +1,42 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/ResumeStore.h"
+
+namespace rsocket {
+
+void InMemoryResumeStore::commit(Writes writes) {
+  auto entries = entries_.lock();
+  for (auto& write : writes) {
+    if (write.second) {
+      (*entries)[write.first] = std::move(*write.second);
+    } else {
+      entries->erase(write.first);
+    }
+  }
+}
+
+std::map<std::string, std::string> InMemoryResumeStore::load(
+    folly::StringPiece prefix) {
+  std::map<std::string, std::string> result;
+  auto entries = entries_.lock();
+  for (auto it = entries->lower_bound(prefix.str());
+       it != entries->end() && folly::StringPiece(it->first).startsWith(prefix);
+       ++it) {
+    result.insert(*it);
+  }
+  return result;
+}
+
+} // namespace rsocket
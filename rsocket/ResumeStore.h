@@ -0,0 +1,61 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/Range.h>
+#include <folly/Synchronized.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace rsocket {
+
+/// Key-value backend for PersistentResumeManager.  Applications implement it
+/// on top of whatever storage they have, e.g. a local database or a remote
+/// cache.
+///
+/// Calls can be made from any thread, and can block: commit() is only ever
+/// called from the writer executor given to the manager, never from an
+/// EventBase.
+class ResumeStore {
+ public:
+  /// A batch of writes.  A value of folly::none erases the key.
+  using Writes = std::map<std::string, folly::Optional<std::string>>;
+
+  virtual ~ResumeStore() = default;
+
+  /// Applies a batch of writes.  Batches are committed one at a time, in the
+  /// order they are made.  Failures should be reported by throwing.
+  virtual void commit(Writes writes) = 0;
+
+  /// Returns every entry whose key starts with `prefix`.
+  virtual std::map<std::string, std::string> load(folly::StringPiece prefix) = 0;
+};
+
+/// ResumeStore that keeps everything in memory (for prototyping and testing
+/// purposes).
+class InMemoryResumeStore : public ResumeStore {
+ public:
+  void commit(Writes writes) override;
+
+  std::map<std::string, std::string> load(folly::StringPiece prefix) override;
+
+ private:
+  folly::Synchronized<std::map<std::string, std::string>, std::mutex> entries_;
+};
+
+} // namespace rsocket
@@ -0,0 +1,321 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/RoutingRSocketResponder.h"
+
+#include <folly/Bits.h>
+#include <folly/hash/SpookyHashV2.h>
+
+#include <algorithm>
+#include <numeric>
+
+#include "rsocket/CompositeMetadata.h"
+#include "yarpl/flowable/Flowable.h"
+#include "yarpl/single/Singles.h"
+
+namespace rsocket {
+
+using namespace yarpl::flowable;
+using namespace yarpl::single;
+
+namespace {
+
+/// Seeds tried for a bucket before the table is made bigger.
+constexpr uint32_t kMaxSeed = 1 << 16;
+
+uint64_t hashOf(folly::StringPiece name, uint32_t seed) {
+  return folly::hash::SpookyHashV2::Hash64(name.data(), name.size(), seed);
+}
+
+/// Calls `fn(route)` if the metadata has a route.  The route may be copied
+/// out of the metadata if it straddles two buffers, so it is only valid
+/// during the call.  Raw routes are only read from the first buffer.
+template <typename Fn>
+void withRoute(
+    const folly::IOBuf& metadata,
+    RoutingRSocketResponder::MetadataFormat format,
+    Fn&& fn) {
+  using MetadataFormat = RoutingRSocketResponder::MetadataFormat;
+  switch (format) {
+    case MetadataFormat::Composite: {
+      CompositeMetadataReader entries{metadata};
+      if (auto entry = entries.find(WellKnownMimeType::Routing)) {
+        RoutingMetadataReader tags{*entry};
+        if (tags.next()) {
+          fn(tags.tag());
+        }
+      }
+      return;
+    }
+    case MetadataFormat::Routing: {
+      RoutingMetadataReader tags{metadata};
+      if (tags.next()) {
+        fn(tags.tag());
+      }
+      return;
+    }
+    case MetadataFormat::Raw:
+      if (metadata.length() > 0) {
+        fn(folly::StringPiece(
+            reinterpret_cast<const char*>(metadata.data()),
+            metadata.length()));
+      }
+      return;
+  }
+}
+
+std::runtime_error noRoute() {
+  return std::runtime_error("No route for request");
+}
+
+} // namespace
+
+RoutingRSocketResponder::Routes::Route& RoutingRSocketResponder::Routes::route(
+    std::string name) {
+  auto it = std::find_if(
+      routes_.begin(), routes_.end(), [&](const Route& route) {
+        return route.name == name;
+      });
+  if (it != routes_.end()) {
+    return *it;
+  }
+  routes_.emplace_back();
+  routes_.back().name = std::move(name);
+  return routes_.back();
+}
+
+RoutingRSocketResponder::Routes&
+RoutingRSocketResponder::Routes::requestResponse(
+    std::string route,
+    RequestResponseHandler handler) {
+  this->route(std::move(route)).requestResponse = std::move(handler);
+  return *this;
+}
+
+RoutingRSocketResponder::Routes& RoutingRSocketResponder::Routes::requestStream(
+    std::string route,
+    RequestStreamHandler handler) {
+  this->route(std::move(route)).requestStream = std::move(handler);
+  return *this;
+}
+
+RoutingRSocketResponder::Routes&
+RoutingRSocketResponder::Routes::requestChannel(
+    std::string route,
+    RequestChannelHandler handler) {
+  this->route(std::move(route)).requestChannel = std::move(handler);
+  return *this;
+}
+
+RoutingRSocketResponder::Routes& RoutingRSocketResponder::Routes::fireAndForget(
+    std::string route,
+    FireAndForgetHandler handler) {
+  this->route(std::move(route)).fireAndForget = std::move(handler);
+  return *this;
+}
+
+RoutingRSocketResponder::RoutingRSocketResponder(
+    Routes routes,
+    MetadataFormat format,
+    std::shared_ptr<RSocketResponder> fallback,
+    std::shared_ptr<RSocketStats> stats)
+    : routes_(std::move(routes.routes_)),
+      format_(format),
+      fallback_(std::move(fallback)),
+      stats_(std::move(stats)),
+      requests_(new std::atomic<uint64_t>[routes_.size()]()) {
+  build();
+}
+
+/// Builds the table with hash and displace: the routes are split into
+/// buckets by their hash, and starting from the biggest bucket, every bucket
+/// gets the first seed that hashes all of its routes to free slots.
+void RoutingRSocketResponder::build() {
+  auto const count = routes_.size();
+  if (count == 0) {
+    return;
+  }
+
+  auto const buckets = folly::nextPowTwo(count);
+  std::vector<std::vector<uint32_t>> members(buckets);
+  for (uint32_t i = 0; i < count; ++i) {
+    members[hashOf(routes_[i].name, 0) & (buckets - 1)].push_back(i);
+  }
+  std::vector<size_t> order(buckets);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return members[a].size() > members[b].size();
+  });
+
+  std::vector<uint64_t> placed;
+  for (auto slots = folly::nextPowTwo(2 * count);; slots *= 2) {
+    seeds_.assign(buckets, 0);
+    slots_.assign(slots, 0);
+
+    auto const placeBucket = [&](size_t bucket) {
+      for (uint32_t seed = 1; seed < kMaxSeed; ++seed) {
+        placed.clear();
+        for (auto index : members[bucket]) {
+          auto const slot = hashOf(routes_[index].name, seed) & (slots - 1);
+          if (slots_[slot] != 0) {
+            break;
+          }
+          slots_[slot] = index + 1;
+          placed.push_back(slot);
+        }
+        if (placed.size() == members[bucket].size()) {
+          seeds_[bucket] = seed;
+          return true;
+        }
+        for (auto slot : placed) {
+          slots_[slot] = 0;
+        }
+      }
+      return false;
+    };
+
+    bool built = true;
+    for (auto bucket : order) {
+      if (members[bucket].empty()) {
+        break;
+      }
+      if (!placeBucket(bucket)) {
+        built = false;
+        break;
+      }
+    }
+    if (built) {
+      return;
+    }
+  }
+}
+
+const RoutingRSocketResponder::Route* RoutingRSocketResponder::lookup(
+    folly::StringPiece name) const {
+  if (slots_.empty()) {
+    return nullptr;
+  }
+  auto const seed = seeds_[hashOf(name, 0) & (seeds_.size() - 1)];
+  auto const index = slots_[hashOf(name, seed) & (slots_.size() - 1)];
+  if (index == 0 || routes_[index - 1].name != name) {
+    return nullptr;
+  }
+  return &routes_[index - 1];
+}
+
+folly::Optional<folly::StringPiece> RoutingRSocketResponder::parseRoute(
+    const folly::IOBuf& metadata,
+    MetadataFormat format) {
+  // Reading a single buffer, the route is always a view into it.
+  folly::IOBuf const head{
+      folly::IOBuf::WRAP_BUFFER, metadata.data(), metadata.length()};
+  folly::Optional<folly::StringPiece> route;
+  withRoute(head, format, [&](folly::StringPiece name) { route = name; });
+  return route;
+}
+
+template <typename Handler>
+const Handler* RoutingRSocketResponder::find(
+    Payload& request,
+    Handler Route::*handler) {
+  const Route* route = nullptr;
+  if (request.metadata) {
+    // Routes in (composite) routing metadata are read across the buffers
+    // of a chain, raw routes need the whole metadata in one buffer.
+    if (format_ == MetadataFormat::Raw && request.metadata->isChained()) {
+      request.metadata->coalesce();
+    }
+    withRoute(*request.metadata, format_, [&](folly::StringPiece name) {
+      route = lookup(name);
+    });
+  }
+  if (route && route->*handler) {
+    requests_[route - routes_.data()].fetch_add(1, std::memory_order_relaxed);
+    return &(route->*handler);
+  }
+  unrouted_.fetch_add(1, std::memory_order_relaxed);
+  stats_->requestUnrouted();
+  return nullptr;
+}
+
+void RoutingRSocketResponder::forEachRoute(
+    const std::function<void(folly::StringPiece, uint64_t)>& fn) const {
+  for (size_t i = 0; i < routes_.size(); ++i) {
+    fn(routes_[i].name, requests_[i].load(std::memory_order_relaxed));
+  }
+}
+
+uint64_t RoutingRSocketResponder::unrouted() const {
+  return unrouted_.load(std::memory_order_relaxed);
+}
+
+std::shared_ptr<Single<Payload>> RoutingRSocketResponder::handleRequestResponse(
+    Payload request,
+    StreamId streamId) {
+  if (auto handler = find(request, &Route::requestResponse)) {
+    return (*handler)(std::move(request), streamId);
+  }
+  if (fallback_) {
+    return fallback_->handleRequestResponse(std::move(request), streamId);
+  }
+  return Singles::error<Payload>(noRoute());
+}
+
+std::shared_ptr<Flowable<Payload>> RoutingRSocketResponder::handleRequestStream(
+    Payload request,
+    StreamId streamId) {
+  if (auto handler = find(request, &Route::requestStream)) {
+    return (*handler)(std::move(request), streamId);
+  }
+  if (fallback_) {
+    return fallback_->handleRequestStream(std::move(request), streamId);
+  }
+  return Flowable<Payload>::error(noRoute());
+}
+
+std::shared_ptr<Flowable<Payload>>
+RoutingRSocketResponder::handleRequestChannel(
+    Payload request,
+    std::shared_ptr<Flowable<Payload>> requestStream,
+    StreamId streamId) {
+  if (auto handler = find(request, &Route::requestChannel)) {
+    return (*handler)(std::move(request), std::move(requestStream), streamId);
+  }
+  if (fallback_) {
+    return fallback_->handleRequestChannel(
+        std::move(request), std::move(requestStream), streamId);
+  }
+  return Flowable<Payload>::error(noRoute());
+}
+
+void RoutingRSocketResponder::handleFireAndForget(
+    Payload request,
+    StreamId streamId) {
+  if (auto handler = find(request, &Route::fireAndForget)) {
+    (*handler)(std::move(request), streamId);
+  } else if (fallback_) {
+    fallback_->handleFireAndForget(std::move(request), streamId);
+  } else {
+    VLOG(3) << "Dropping fire-and-forget request without a route";
+  }
+}
+
+void RoutingRSocketResponder::handleMetadataPush(
+    std::unique_ptr<folly::IOBuf> metadata) {
+  if (fallback_) {
+    fallback_->handleMetadataPush(std::move(metadata));
+  }
+}
+
+} // namespace rsocket
@@ -0,0 +1,165 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/Range.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rsocket/RSocketResponder.h"
+#include "rsocket/RSocketStats.h"
+
+namespace rsocket {
+
+/**
+ * An RSocketResponder that dispatches requests to handlers by the route in
+ * their metadata.
+ *
+ * The route is read in place from the metadata, in one of the formats of
+ * MetadataFormat, and looked up in a perfect hash table built from the routes
+ * when the responder is constructed.  A lookup costs two hashes of the route
+ * and one comparison, and allocates nothing.
+ *
+ * Requests whose route has no handler for their interaction type go to the
+ * `fallback` responder, which fails them by default.  The responder counts
+ * the requests of every route, see forEachRoute().
+ *
+ * An instance can be shared by connections on different threads.
+ */
+class RoutingRSocketResponder : public RSocketResponder {
+ public:
+  /// Where the route is found in the metadata of a request.
+  enum class MetadataFormat {
+    /// Composite metadata (message/x.rsocket.composite-metadata.v0) with a
+    /// routing entry in it.
+    Composite,
+    /// Routing metadata (message/x.rsocket.routing.v0), whose first tag is
+    /// the route.
+    Routing,
+    /// The whole metadata is the route.
+    Raw,
+  };
+
+  using RequestResponseHandler =
+      std::function<std::shared_ptr<yarpl::single::Single<Payload>>(
+          Payload request,
+          StreamId streamId)>;
+  using RequestStreamHandler =
+      std::function<std::shared_ptr<yarpl::flowable::Flowable<Payload>>(
+          Payload request,
+          StreamId streamId)>;
+  using RequestChannelHandler =
+      std::function<std::shared_ptr<yarpl::flowable::Flowable<Payload>>(
+          Payload request,
+          std::shared_ptr<yarpl::flowable::Flowable<Payload>> requestStream,
+          StreamId streamId)>;
+  using FireAndForgetHandler =
+      std::function<void(Payload request, StreamId streamId)>;
+
+  /// The handlers of every route.  A route can have a handler for each of the
+  /// interaction types, and registering one twice replaces it.
+  class Routes {
+   public:
+    Routes& requestResponse(std::string route, RequestResponseHandler);
+    Routes& requestStream(std::string route, RequestStreamHandler);
+    Routes& requestChannel(std::string route, RequestChannelHandler);
+    Routes& fireAndForget(std::string route, FireAndForgetHandler);
+
+   private:
+    friend class RoutingRSocketResponder;
+
+    struct Route {
+      std::string name;
+      RequestResponseHandler requestResponse;
+      RequestStreamHandler requestStream;
+      RequestChannelHandler requestChannel;
+      FireAndForgetHandler fireAndForget;
+    };
+
+    Route& route(std::string name);
+
+    std::vector<Route> routes_;
+  };
+
+  RoutingRSocketResponder(
+      Routes routes,
+      MetadataFormat format = MetadataFormat::Composite,
+      std::shared_ptr<RSocketResponder> fallback = nullptr,
+      std::shared_ptr<RSocketStats> stats = RSocketStats::noop());
+
+  /// Returns the route in `metadata`, which points into the buffer, or
+  /// folly::none if there is none.  Only the first buffer of a chain is read.
+  static folly::Optional<folly::StringPiece> parseRoute(
+      const folly::IOBuf& metadata,
+      MetadataFormat format);
+
+  /// Calls `fn(route, requests)` with the number of requests dispatched to
+  /// each route so far.
+  void forEachRoute(
+      const std::function<void(folly::StringPiece, uint64_t)>& fn) const;
+
+  /// Number of requests that matched no route so far.
+  uint64_t unrouted() const;
+
+  std::shared_ptr<yarpl::single::Single<Payload>> handleRequestResponse(
+      Payload request,
+      StreamId streamId) override;
+
+  std::shared_ptr<yarpl::flowable::Flowable<Payload>> handleRequestStream(
+      Payload request,
+      StreamId streamId) override;
+
+  std::shared_ptr<yarpl::flowable::Flowable<Payload>> handleRequestChannel(
+      Payload request,
+      std::shared_ptr<yarpl::flowable::Flowable<Payload>> requestStream,
+      StreamId streamId) override;
+
+  void handleFireAndForget(Payload request, StreamId streamId) override;
+
+  void handleMetadataPush(std::unique_ptr<folly::IOBuf> metadata) override;
+
+ private:
+  using Route = Routes::Route;
+
+  /// Returns the handler of the route of a request, or nullptr if there is
+  /// none.  Counts the request for its route, or as unrouted.
+  template <typename Handler>
+  const Handler* find(Payload& request, Handler Route::*handler);
+
+  const Route* lookup(folly::StringPiece name) const;
+
+  void build();
+
+  const std::vector<Route> routes_;
+  const MetadataFormat format_;
+  const std::shared_ptr<RSocketResponder> fallback_;
+  const std::shared_ptr<RSocketStats> stats_;
+
+  /// The perfect hash table.  A route hashes with seed 0 to one of the
+  /// `seeds_`, and with that seed to its slot, which holds its index in
+  /// `routes_` plus one.
+  std::vector<uint32_t> seeds_;
+  std::vector<uint32_t> slots_;
+
+  const std::unique_ptr<std::atomic<uint64_t>[]> requests_;
+  std::atomic<uint64_t> unrouted_{0};
+};
+
+} // namespace rsocket
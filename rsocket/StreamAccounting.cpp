@@ -0,0 +1,80 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/StreamAccounting.h"
+
+namespace rsocket {
+
+namespace {
+
+void addAll(
+    StreamAccounting::Snapshot& to,
+    const StreamAccounting::Snapshot& from) {
+  for (const auto& entry : from) {
+    to[entry.first] += entry.second;
+  }
+}
+
+} // namespace
+
+StreamAccounting::Usage& StreamAccounting::Usage::operator+=(
+    const Usage& other) {
+  streams += other.streams;
+  bytesIn += other.bytesIn;
+  bytesOut += other.bytesOut;
+  handlerTime += other.handlerTime;
+  return *this;
+}
+
+StreamAccounting::KeyFn StreamAccounting::byRoute(
+    RoutingRSocketResponder::MetadataFormat format) {
+  return [format](StreamType, const Payload& request) {
+    if (request.metadata) {
+      if (auto route =
+              RoutingRSocketResponder::parseRoute(*request.metadata, format)) {
+        return route->str();
+      }
+    }
+    return std::string();
+  };
+}
+
+StreamAccounting::StreamAccounting(KeyFn keyFn)
+    : keyFn_(std::move(keyFn)), local_([this] { return new Local(this); }) {}
+
+StreamAccounting::Local::~Local() {
+  std::lock_guard<std::mutex> lock(parent->retiredMutex_);
+  addAll(parent->retired_, usage);
+}
+
+void StreamAccounting::add(const std::string& key, const Usage& usage) {
+  auto& local = *local_;
+  std::lock_guard<std::mutex> lock(local.mutex);
+  local.usage[key] += usage;
+}
+
+StreamAccounting::Snapshot StreamAccounting::snapshot() const {
+  Snapshot snapshot;
+  {
+    std::lock_guard<std::mutex> lock(retiredMutex_);
+    snapshot = retired_;
+  }
+  for (const auto& local : local_.accessAllThreads()) {
+    std::lock_guard<std::mutex> lock(local.mutex);
+    addAll(snapshot, local.usage);
+  }
+  return snapshot;
+}
+
+} // namespace rsocket
@@ -0,0 +1,109 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/ThreadLocal.h>
+#include <folly/container/F14Map.h>
+#include <folly/lang/Align.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+#include "rsocket/Payload.h"
+#include "rsocket/RoutingRSocketResponder.h"
+#include "rsocket/internal/Common.h"
+
+namespace rsocket {
+
+/**
+ * Accounts for the bytes and the handler time of streams, per key of the
+ * request that opened them, e.g. per route.
+ *
+ * A stream counts the bytes of the payloads it sends and receives, and the
+ * time its thread spends in the responder handler of its request and in
+ * delivering payloads to its subscriber.  The stream counts on its own, and
+ * only adds its usage to its key once it closes, into a table of the thread
+ * closing it.  snapshot() sums the tables of all threads, so streams that are
+ * still open are not in a snapshot yet.
+ *
+ * An instance can be shared by connections on different threads, see
+ * RSocketServer::setStreamAccounting().
+ */
+class StreamAccounting {
+ public:
+  /// Returns the key that the stream opened by a request is accounted under.
+  using KeyFn =
+      std::function<std::string(StreamType type, const Payload& request)>;
+
+  struct Usage {
+    uint64_t streams{0};
+    uint64_t bytesIn{0};
+    uint64_t bytesOut{0};
+
+    /// Time spent in handlers on the thread of the stream.  This is the
+    /// wall time of the callbacks, which is their CPU time unless they block.
+    std::chrono::nanoseconds handlerTime{0};
+
+    Usage& operator+=(const Usage& other);
+  };
+
+  using Snapshot = folly::F14FastMap<std::string, Usage>;
+
+  /// Accounts streams by the route in the metadata of their request, see
+  /// RoutingRSocketResponder::parseRoute().  Requests without a route are
+  /// accounted under the empty key.
+  static KeyFn byRoute(
+      RoutingRSocketResponder::MetadataFormat format =
+          RoutingRSocketResponder::MetadataFormat::Composite);
+
+  explicit StreamAccounting(KeyFn keyFn = byRoute());
+
+  std::string keyOf(StreamType type, const Payload& request) const {
+    return keyFn_(type, request);
+  }
+
+  /// Adds usage to a key, in the table of the calling thread.
+  void add(const std::string& key, const Usage& usage);
+
+  /// Returns the usage of every key so far.
+  Snapshot snapshot() const;
+
+ private:
+  struct Tag {};
+
+  /// The table of one thread.  The mutex is only contended by snapshot().
+  struct alignas(folly::hardware_destructive_interference_size) Local {
+    explicit Local(StreamAccounting* parent) : parent(parent) {}
+    ~Local();
+
+    StreamAccounting* const parent;
+    mutable std::mutex mutex;
+    Snapshot usage;
+  };
+
+  const KeyFn keyFn_;
+
+  /// Usage of the threads that exited.  Declared ahead of `local_` so that
+  /// it outlives the Local instances folding into it.
+  mutable std::mutex retiredMutex_;
+  Snapshot retired_;
+
+  folly::ThreadLocal<Local, Tag> local_;
+};
+
+} // namespace rsocket
@@ -0,0 +1,128 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/TenantQuotas.h"
+
+#include <algorithm>
+
+namespace rsocket {
+
+namespace {
+
+int64_t nanosOf(TenantQuotas::Clock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             time.time_since_epoch())
+      .count();
+}
+
+} // namespace
+
+TenantQuotas::Bucket::Bucket(std::string tenant, const Quota& quota)
+    : tenant_(std::move(tenant)),
+      quota_(quota),
+      resumeBufferBudget_(
+          quota.maxResumeBufferBytes > 0
+              ? std::make_shared<ResumeBufferBudget>(
+                    quota.maxResumeBufferBytes)
+              : nullptr),
+      nanosPerByte_(
+          quota.maxBytesPerSecond > 0 ? 1e9 / quota.maxBytesPerSecond : 0),
+      burstNanos_(static_cast<int64_t>(
+          (quota.burstBytes > 0 ? quota.burstBytes : quota.maxBytesPerSecond) *
+          nanosPerByte_)) {}
+
+bool TenantQuotas::Bucket::tryAdd(std::atomic<size_t>& counter, size_t limit) {
+  if (limit == 0) {
+    counter.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+  auto current = counter.load(std::memory_order_relaxed);
+  do {
+    if (current >= limit) {
+      return false;
+    }
+  } while (!counter.compare_exchange_weak(
+      current, current + 1, std::memory_order_relaxed));
+  return true;
+}
+
+bool TenantQuotas::Bucket::tryOpenConnection() {
+  return tryAdd(connections_, quota_.maxConnections);
+}
+
+void TenantQuotas::Bucket::closeConnection() {
+  connections_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool TenantQuotas::Bucket::tryOpenStream() {
+  return tryAdd(activeStreams_, quota_.maxActiveStreams);
+}
+
+void TenantQuotas::Bucket::openStream() {
+  activeStreams_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void TenantQuotas::Bucket::closeStreams(size_t streams) {
+  activeStreams_.fetch_sub(streams, std::memory_order_relaxed);
+}
+
+void TenantQuotas::Bucket::bytesRead(size_t bytes, Clock::time_point now) {
+  if (nanosPerByte_ == 0) {
+    return;
+  }
+  auto const cost = static_cast<int64_t>(bytes * nanosPerByte_);
+  auto const nowNanos = nanosOf(now);
+  auto busyUntil = busyUntil_.load(std::memory_order_relaxed);
+  while (!busyUntil_.compare_exchange_weak(
+      busyUntil,
+      std::max(busyUntil, nowNanos) + cost,
+      std::memory_order_relaxed)) {
+  }
+}
+
+bool TenantQuotas::Bucket::withinByteRate(Clock::time_point now) const {
+  return nanosPerByte_ == 0 ||
+      busyUntil_.load(std::memory_order_relaxed) - nanosOf(now) <=
+      burstNanos_;
+}
+
+TenantQuotas::TenantQuotas(TenantFn tenantOf, Quota defaultQuota)
+    : tenantOf_(std::move(tenantOf)), defaultQuota_(defaultQuota) {}
+
+void TenantQuotas::setQuota(const std::string& tenant, const Quota& quota) {
+  auto tenants = tenants_.lock();
+  tenants->quotas[tenant] = quota;
+  // The connections to come get a bucket with the new quota.
+  tenants->buckets.erase(tenant);
+}
+
+std::shared_ptr<TenantQuotas::Bucket> TenantQuotas::bucketFor(
+    const SetupParameters& setupParams) {
+  return bucket(tenantOf_(setupParams));
+}
+
+std::shared_ptr<TenantQuotas::Bucket> TenantQuotas::bucket(
+    const std::string& tenant) {
+  auto tenants = tenants_.lock();
+  auto& bucket = tenants->buckets[tenant];
+  if (!bucket) {
+    auto const quota = tenants->quotas.find(tenant);
+    bucket = std::make_shared<Bucket>(
+        tenant,
+        quota != tenants->quotas.end() ? quota->second : defaultQuota_);
+  }
+  return bucket;
+}
+
+} // namespace rsocket
@@ -0,0 +1,156 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Synchronized.h>
+#include <folly/container/F14Map.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "rsocket/RSocketParameters.h"
+#include "rsocket/internal/ResumeBufferBudget.h"
+
+namespace rsocket {
+
+/**
+ * Limits on the resources the connections of each tenant of a server may
+ * use, see RSocketServer::setTenantQuotas().
+ *
+ * The tenant of a connection is named by a function of its SETUP frame,
+ * e.g. reading it from the metadata.  The connection is given the Bucket of
+ * its tenant when it is set up, and keeps it for as long as it lives, so the
+ * map of tenants is only looked up once per connection.
+ *
+ * Thread-safe, a single instance is shared by all the connections of a
+ * server.
+ */
+class TenantQuotas {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using TenantFn = std::function<std::string(const SetupParameters&)>;
+
+  /// Zero means no limit.
+  struct Quota {
+    /// Most connections of the tenant open at once.  SETUP frames past it
+    /// are rejected.
+    size_t maxConnections{0};
+
+    /// Most streams the peers of the tenant have active at once, over all
+    /// its connections.  Requests past it are rejected.  Fire-and-forget
+    /// requests count while they are received, but are never rejected.
+    size_t maxActiveStreams{0};
+
+    /// Rate at which the peers of the tenant may send bytes, over all its
+    /// connections, and the bytes they may send above it in a burst (the
+    /// rate's worth of a second by default).  New requests are rejected
+    /// while the tenant is over, all the other frames are still received.
+    double maxBytesPerSecond{0};
+    double burstBytes{0};
+
+    /// Most bytes buffered for the resumption of the connections of the
+    /// tenant, see ResumeBufferBudget.
+    size_t maxResumeBufferBytes{0};
+  };
+
+  /// The usage of a tenant, against its quota.
+  class Bucket {
+   public:
+    Bucket(std::string tenant, const Quota& quota);
+
+    const std::string& tenant() const {
+      return tenant_;
+    }
+
+    const Quota& quota() const {
+      return quota_;
+    }
+
+    /// Counts a connection, if the tenant may open one more.
+    bool tryOpenConnection();
+    void closeConnection();
+
+    /// Counts a stream, if the tenant may open one more.
+    bool tryOpenStream();
+    /// Counts a stream, regardless of the limit.
+    void openStream();
+    void closeStreams(size_t streams);
+
+    /// Charges bytes received from a peer of the tenant.
+    void bytesRead(size_t bytes, Clock::time_point now = Clock::now());
+
+    /// Whether the tenant is within its byte rate.
+    bool withinByteRate(Clock::time_point now = Clock::now()) const;
+
+    /// The budget the resume buffers of the connections of the tenant share,
+    /// null unless the tenant has a resume buffer quota.
+    const std::shared_ptr<ResumeBufferBudget>& resumeBufferBudget() const {
+      return resumeBufferBudget_;
+    }
+
+    size_t connections() const {
+      return connections_.load(std::memory_order_relaxed);
+    }
+
+    size_t activeStreams() const {
+      return activeStreams_.load(std::memory_order_relaxed);
+    }
+
+   private:
+    static bool tryAdd(std::atomic<size_t>& counter, size_t limit);
+
+    const std::string tenant_;
+    const Quota quota_;
+    const std::shared_ptr<ResumeBufferBudget> resumeBufferBudget_;
+
+    /// The byte rate is enforced as a virtual scheduling (GCRA) bucket: the
+    /// time, in nanoseconds of the clock, at which the tenant would be back
+    /// to having sent nothing, if it stopped now.  It is over its rate while
+    /// that is more than the burst ahead of the clock.
+    const double nanosPerByte_;
+    const int64_t burstNanos_;
+    std::atomic<int64_t> busyUntil_{0};
+
+    std::atomic<size_t> connections_{0};
+    std::atomic<size_t> activeStreams_{0};
+  };
+
+  /// Tenants without a quota of their own get `defaultQuota`.
+  TenantQuotas(TenantFn tenantOf, Quota defaultQuota = Quota());
+
+  /// Sets the quota of a tenant.  The connections it has open already keep
+  /// counting against the previous quota, in a bucket of their own.
+  void setQuota(const std::string& tenant, const Quota& quota);
+
+  /// Returns the bucket of the tenant of a connection.
+  std::shared_ptr<Bucket> bucketFor(const SetupParameters& setupParams);
+  std::shared_ptr<Bucket> bucket(const std::string& tenant);
+
+ private:
+  struct Tenants {
+    folly::F14FastMap<std::string, Quota> quotas;
+    folly::F14FastMap<std::string, std::shared_ptr<Bucket>> buckets;
+  };
+
+  const TenantFn tenantOf_;
+  const Quota defaultQuota_;
+  folly::Synchronized<Tenants, std::mutex> tenants_;
+};
+
+} // namespace rsocket
@@ -0,0 +1,537 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/ThreadLocalRSocketStats.h"
+
+namespace rsocket {
+
+folly::StringPiece ThreadLocalRSocketStats::toString(Counter counter) {
+  switch (counter) {
+    case Counter::SOCKETS_CREATED:
+      return "SOCKETS_CREATED";
+    case Counter::SOCKETS_CONNECTED:
+      return "SOCKETS_CONNECTED";
+    case Counter::SOCKETS_DISCONNECTED:
+      return "SOCKETS_DISCONNECTED";
+    case Counter::SOCKETS_CLOSED:
+      return "SOCKETS_CLOSED";
+    case Counter::SERVER_CONNECTIONS_ACCEPTED:
+      return "SERVER_CONNECTIONS_ACCEPTED";
+    case Counter::DUPLEX_CONNECTIONS_CREATED:
+      return "DUPLEX_CONNECTIONS_CREATED";
+    case Counter::DUPLEX_CONNECTIONS_CLOSED:
+      return "DUPLEX_CONNECTIONS_CLOSED";
+    case Counter::RESUMES_SUCCEEDED:
+      return "RESUMES_SUCCEEDED";
+    case Counter::RESUMES_FAILED:
+      return "RESUMES_FAILED";
+    case Counter::RESUMES_FAILED_NO_STATE:
+      return "RESUMES_FAILED_NO_STATE";
+    case Counter::RESUME_BYTES_REPLAYED:
+      return "RESUME_BYTES_REPLAYED";
+    case Counter::COLD_RESUMES:
+      return "COLD_RESUMES";
+    case Counter::COLD_RESUME_STREAMS_RESTORED:
+      return "COLD_RESUME_STREAMS_RESTORED";
+    case Counter::COLD_RESUME_MICROS:
+      return "COLD_RESUME_MICROS";
+    case Counter::BYTES_WRITTEN:
+      return "BYTES_WRITTEN";
+    case Counter::BYTES_READ:
+      return "BYTES_READ";
+    case Counter::BYTES_WRITTEN_ZERO_COPY:
+      return "BYTES_WRITTEN_ZERO_COPY";
+    case Counter::BYTES_WRITTEN_COPIED:
+      return "BYTES_WRITTEN_COPIED";
+    case Counter::KERNEL_TLS_SEND:
+      return "KERNEL_TLS_SEND";
+    case Counter::KERNEL_TLS_RECEIVE:
+      return "KERNEL_TLS_RECEIVE";
+    case Counter::FRAMES_WRITTEN:
+      return "FRAMES_WRITTEN";
+    case Counter::FRAMES_READ:
+      return "FRAMES_READ";
+    case Counter::UNKNOWN_FRAMES_READ:
+      return "UNKNOWN_FRAMES_READ";
+    case Counter::RESUME_FRAMES_EVICTED:
+      return "RESUME_FRAMES_EVICTED";
+    case Counter::RESUME_BYTES_EVICTED:
+      return "RESUME_BYTES_EVICTED";
+    case Counter::STREAM_FRAMES_BUFFERED:
+      return "STREAM_FRAMES_BUFFERED";
+    case Counter::STREAM_BYTES_BUFFERED:
+      return "STREAM_BYTES_BUFFERED";
+    case Counter::STREAMS_OPENED:
+      return "STREAMS_OPENED";
+    case Counter::STREAMS_CLOSED:
+      return "STREAMS_CLOSED";
+    case Counter::STREAM_BYTES:
+      return "STREAM_BYTES";
+    case Counter::STREAM_STATE_MACHINES_ALLOCATED:
+      return "STREAM_STATE_MACHINES_ALLOCATED";
+    case Counter::STREAM_STATE_MACHINES_POOLED:
+      return "STREAM_STATE_MACHINES_POOLED";
+    case Counter::KEEPALIVES_SENT:
+      return "KEEPALIVES_SENT";
+    case Counter::KEEPALIVES_RECEIVED:
+      return "KEEPALIVES_RECEIVED";
+    case Counter::KEEPALIVES_SUPPRESSED:
+      return "KEEPALIVES_SUPPRESSED";
+    case Counter::PAYLOADS_COMPRESSED:
+      return "PAYLOADS_COMPRESSED";
+    case Counter::PAYLOAD_BYTES_COMPRESSED:
+      return "PAYLOAD_BYTES_COMPRESSED";
+    case Counter::PAYLOAD_BYTES_AFTER_COMPRESSION:
+      return "PAYLOAD_BYTES_AFTER_COMPRESSION";
+    case Counter::PAYLOADS_DECOMPRESSED:
+      return "PAYLOADS_DECOMPRESSED";
+    case Counter::LEASES_SENT:
+      return "LEASES_SENT";
+    case Counter::LEASES_RECEIVED:
+      return "LEASES_RECEIVED";
+    case Counter::REQUESTS_WITHOUT_LEASE:
+      return "REQUESTS_WITHOUT_LEASE";
+    case Counter::STREAM_LIMIT_REACHED:
+      return "STREAM_LIMIT_REACHED";
+    case Counter::REQUESTS_REJECTED_OVERLOADED:
+      return "REQUESTS_REJECTED_OVERLOADED";
+    case Counter::REQUESTS_REJECTED_MEMORY_PRESSURE:
+      return "REQUESTS_REJECTED_MEMORY_PRESSURE";
+    case Counter::MEMORY_PRESSURE_CHANGES:
+      return "MEMORY_PRESSURE_CHANGES";
+    case Counter::REQUEST_DEADLINES_EXPIRED:
+      return "REQUEST_DEADLINES_EXPIRED";
+    case Counter::EXPIRED_FRAMES_DROPPED:
+      return "EXPIRED_FRAMES_DROPPED";
+    case Counter::TENANT_QUOTAS_EXCEEDED:
+      return "TENANT_QUOTAS_EXCEEDED";
+    case Counter::REQUESTS_COALESCED:
+      return "REQUESTS_COALESCED";
+    case Counter::RESPONSE_CACHE_HITS:
+      return "RESPONSE_CACHE_HITS";
+    case Counter::RESPONSE_CACHE_MISSES:
+      return "RESPONSE_CACHE_MISSES";
+    case Counter::REQUESTS_UNROUTED:
+      return "REQUESTS_UNROUTED";
+    case Counter::HEDGEABLE_REQUESTS:
+      return "HEDGEABLE_REQUESTS";
+    case Counter::HEDGES_SENT:
+      return "HEDGES_SENT";
+    case Counter::HEDGES_WON:
+      return "HEDGES_WON";
+    case Counter::EVENT_BASE_LAG_SAMPLES:
+      return "EVENT_BASE_LAG_SAMPLES";
+    case Counter::EVENT_BASE_LAG_MICROS:
+      return "EVENT_BASE_LAG_MICROS";
+    case Counter::EVENT_BASE_READ_MICROS:
+      return "EVENT_BASE_READ_MICROS";
+    case Counter::EVENT_BASE_FRAME_DISPATCH_MICROS:
+      return "EVENT_BASE_FRAME_DISPATCH_MICROS";
+    case Counter::EVENT_BASE_RESPONDER_MICROS:
+      return "EVENT_BASE_RESPONDER_MICROS";
+    case Counter::EVENT_BASE_WRITE_MICROS:
+      return "EVENT_BASE_WRITE_MICROS";
+    case Counter::RECONNECT_ATTEMPTS:
+      return "RECONNECT_ATTEMPTS";
+    case Counter::RECONNECTS:
+      return "RECONNECTS";
+    case Counter::RECONNECT_ROUNDS:
+      return "RECONNECT_ROUNDS";
+    case Counter::RECONNECT_DOWNTIME_MICROS:
+      return "RECONNECT_DOWNTIME_MICROS";
+    case Counter::RECONNECTS_ABANDONED:
+      return "RECONNECTS_ABANDONED";
+  }
+  return "UNKNOWN";
+}
+
+ThreadLocalRSocketStats::ThreadLocalRSocketStats()
+    : local_([this] { return new Local(this); }) {}
+
+ThreadLocalRSocketStats::Local::~Local() {
+  Snapshot snapshot;
+  addTo(snapshot);
+
+  std::lock_guard<std::mutex> lock(parent->retiredMutex_);
+  auto& retired = parent->retired_;
+  for (size_t i = 0; i < kCounters; ++i) {
+    retired.counters[i] += snapshot.counters[i];
+  }
+  for (size_t i = 0; i < kFrameTypes; ++i) {
+    retired.framesWrittenByType[i] += snapshot.framesWrittenByType[i];
+    retired.framesReadByType[i] += snapshot.framesReadByType[i];
+  }
+  retired.resumeBufferFrames += snapshot.resumeBufferFrames;
+  retired.resumeBufferBytes += snapshot.resumeBufferBytes;
+  retired.streamBufferFrames += snapshot.streamBufferFrames;
+  retired.streamBufferBytes += snapshot.streamBufferBytes;
+  // The queue of the thread is gone, so its depth isn't retired.
+}
+
+void ThreadLocalRSocketStats::Local::addTo(Snapshot& snapshot) const {
+  for (size_t i = 0; i < kCounters; ++i) {
+    snapshot.counters[i] += counters[i].load(std::memory_order_relaxed);
+  }
+  for (size_t i = 0; i < kFrameTypes; ++i) {
+    snapshot.framesWrittenByType[i] +=
+        framesWritten[i].load(std::memory_order_relaxed);
+    snapshot.framesReadByType[i] +=
+        framesRead[i].load(std::memory_order_relaxed);
+  }
+  snapshot.resumeBufferFrames +=
+      resumeBufferFrames.load(std::memory_order_relaxed);
+  snapshot.resumeBufferBytes +=
+      resumeBufferBytes.load(std::memory_order_relaxed);
+  snapshot.streamBufferFrames +=
+      streamBufferFrames.load(std::memory_order_relaxed);
+  snapshot.streamBufferBytes +=
+      streamBufferBytes.load(std::memory_order_relaxed);
+  snapshot.eventBaseQueueDepth +=
+      eventBaseQueueDepth.load(std::memory_order_relaxed);
+}
+
+ThreadLocalRSocketStats::Snapshot ThreadLocalRSocketStats::snapshot() const {
+  Snapshot snapshot;
+  {
+    std::lock_guard<std::mutex> lock(retiredMutex_);
+    snapshot = retired_;
+  }
+  for (const auto& local : local_.accessAllThreads()) {
+    local.addTo(snapshot);
+  }
+  for (size_t i = 0; i < kStreamTypes; ++i) {
+    snapshot.firstPayloadLatencies[i] = firstPayloadLatencies_[i].snapshot();
+    snapshot.streamDurations[i] = streamDurations_[i].snapshot();
+  }
+  snapshot.memoryPressure = memoryPressure_.load(std::memory_order_relaxed);
+  snapshot.memoryPressureBytes =
+      memoryPressureBytes_.load(std::memory_order_relaxed);
+  return snapshot;
+}
+
+void ThreadLocalRSocketStats::socketCreated() {
+  add(Counter::SOCKETS_CREATED);
+}
+
+void ThreadLocalRSocketStats::socketConnected() {
+  add(Counter::SOCKETS_CONNECTED);
+}
+
+void ThreadLocalRSocketStats::socketDisconnected() {
+  add(Counter::SOCKETS_DISCONNECTED);
+}
+
+void ThreadLocalRSocketStats::socketClosed(StreamCompletionSignal) {
+  add(Counter::SOCKETS_CLOSED);
+}
+
+void ThreadLocalRSocketStats::serverConnectionAccepted() {
+  add(Counter::SERVER_CONNECTIONS_ACCEPTED);
+}
+
+void ThreadLocalRSocketStats::duplexConnectionCreated(
+    const std::string&,
+    DuplexConnection*) {
+  add(Counter::DUPLEX_CONNECTIONS_CREATED);
+}
+
+void ThreadLocalRSocketStats::duplexConnectionClosed(
+    const std::string&,
+    DuplexConnection*) {
+  add(Counter::DUPLEX_CONNECTIONS_CLOSED);
+}
+
+void ThreadLocalRSocketStats::serverResume(
+    folly::Optional<int64_t>,
+    int64_t,
+    int64_t serverDelta,
+    ResumeOutcome outcome) {
+  if (outcome != ResumeOutcome::SUCCESS) {
+    add(Counter::RESUMES_FAILED);
+    return;
+  }
+  add(Counter::RESUMES_SUCCEEDED);
+  // The frames the server sent that the client hadn't received, which are
+  // sent again.
+  if (serverDelta > 0) {
+    add(Counter::RESUME_BYTES_REPLAYED, static_cast<uint64_t>(serverDelta));
+  }
+}
+
+void ThreadLocalRSocketStats::bytesWritten(size_t bytes) {
+  add(Counter::BYTES_WRITTEN, bytes);
+}
+
+void ThreadLocalRSocketStats::bytesRead(size_t bytes) {
+  add(Counter::BYTES_READ, bytes);
+}
+
+void ThreadLocalRSocketStats::bytesWrittenZeroCopy(size_t bytes) {
+  add(Counter::BYTES_WRITTEN_ZERO_COPY, bytes);
+}
+
+void ThreadLocalRSocketStats::bytesWrittenCopied(size_t bytes) {
+  add(Counter::BYTES_WRITTEN_COPIED, bytes);
+}
+
+void ThreadLocalRSocketStats::kernelTls(
+    DuplexConnection*,
+    bool send,
+    bool receive) {
+  if (send) {
+    add(Counter::KERNEL_TLS_SEND);
+  }
+  if (receive) {
+    add(Counter::KERNEL_TLS_RECEIVE);
+  }
+}
+
+void ThreadLocalRSocketStats::frameWritten(FrameType type) {
+  auto& local = *local_;
+  local.add(Counter::FRAMES_WRITTEN);
+  Local::bump(local.framesWritten[indexOf(type)], uint64_t(1));
+}
+
+void ThreadLocalRSocketStats::frameRead(FrameType type) {
+  auto& local = *local_;
+  local.add(Counter::FRAMES_READ);
+  Local::bump(local.framesRead[indexOf(type)], uint64_t(1));
+}
+
+void ThreadLocalRSocketStats::resumeBufferChanged(
+    int framesCountDelta,
+    int dataSizeDelta) {
+  auto& local = *local_;
+  Local::bump(local.resumeBufferFrames, int64_t(framesCountDelta));
+  Local::bump(local.resumeBufferBytes, int64_t(dataSizeDelta));
+}
+
+void ThreadLocalRSocketStats::resumeBufferEvictedForBudget(
+    int framesCount,
+    int dataSize) {
+  auto& local = *local_;
+  local.add(Counter::RESUME_FRAMES_EVICTED, framesCount);
+  local.add(Counter::RESUME_BYTES_EVICTED, dataSize);
+}
+
+void ThreadLocalRSocketStats::streamBufferChanged(
+    int64_t framesCountDelta,
+    int64_t dataSizeDelta) {
+  auto& local = *local_;
+  Local::bump(local.streamBufferFrames, framesCountDelta);
+  Local::bump(local.streamBufferBytes, dataSizeDelta);
+  if (framesCountDelta > 0) {
+    local.add(
+        Counter::STREAM_FRAMES_BUFFERED,
+        static_cast<uint64_t>(framesCountDelta));
+  }
+  if (dataSizeDelta > 0) {
+    local.add(
+        Counter::STREAM_BYTES_BUFFERED, static_cast<uint64_t>(dataSizeDelta));
+  }
+}
+
+void ThreadLocalRSocketStats::streamOpened(StreamType) {
+  add(Counter::STREAMS_OPENED);
+}
+
+void ThreadLocalRSocketStats::streamFirstPayload(
+    StreamType type,
+    std::chrono::microseconds latency) {
+  firstPayloadLatencies_[static_cast<size_t>(type)].record(latency.count());
+}
+
+void ThreadLocalRSocketStats::streamClosed(
+    StreamType type,
+    std::chrono::microseconds duration,
+    size_t bytes) {
+  auto& local = *local_;
+  local.add(Counter::STREAMS_CLOSED);
+  local.add(Counter::STREAM_BYTES, bytes);
+  streamDurations_[static_cast<size_t>(type)].record(duration.count());
+}
+
+void ThreadLocalRSocketStats::resumeFailedNoState() {
+  add(Counter::RESUMES_FAILED_NO_STATE);
+}
+
+void ThreadLocalRSocketStats::coldResumeStreamsRestored(
+    size_t streams,
+    std::chrono::microseconds duration) {
+  auto& local = *local_;
+  local.add(Counter::COLD_RESUMES);
+  local.add(Counter::COLD_RESUME_STREAMS_RESTORED, streams);
+  local.add(
+      Counter::COLD_RESUME_MICROS, static_cast<uint64_t>(duration.count()));
+}
+
+void ThreadLocalRSocketStats::keepaliveSent() {
+  add(Counter::KEEPALIVES_SENT);
+}
+
+void ThreadLocalRSocketStats::keepaliveReceived() {
+  add(Counter::KEEPALIVES_RECEIVED);
+}
+
+void ThreadLocalRSocketStats::keepaliveSuppressed() {
+  add(Counter::KEEPALIVES_SUPPRESSED);
+}
+
+void ThreadLocalRSocketStats::payloadCompressed(
+    size_t rawBytes,
+    size_t compressedBytes) {
+  auto& local = *local_;
+  local.add(Counter::PAYLOADS_COMPRESSED);
+  local.add(Counter::PAYLOAD_BYTES_COMPRESSED, rawBytes);
+  local.add(Counter::PAYLOAD_BYTES_AFTER_COMPRESSION, compressedBytes);
+}
+
+void ThreadLocalRSocketStats::payloadDecompressed(size_t, size_t) {
+  add(Counter::PAYLOADS_DECOMPRESSED);
+}
+
+void ThreadLocalRSocketStats::streamStateMachineAllocated(bool fromPool) {
+  add(fromPool ? Counter::STREAM_STATE_MACHINES_POOLED
+               : Counter::STREAM_STATE_MACHINES_ALLOCATED);
+}
+
+void ThreadLocalRSocketStats::leaseSent(uint32_t) {
+  add(Counter::LEASES_SENT);
+}
+
+void ThreadLocalRSocketStats::leaseReceived(uint32_t) {
+  add(Counter::LEASES_RECEIVED);
+}
+
+void ThreadLocalRSocketStats::requestWithoutLease() {
+  add(Counter::REQUESTS_WITHOUT_LEASE);
+}
+
+void ThreadLocalRSocketStats::streamLimitReached() {
+  add(Counter::STREAM_LIMIT_REACHED);
+}
+
+void ThreadLocalRSocketStats::requestRejectedOverloaded() {
+  add(Counter::REQUESTS_REJECTED_OVERLOADED);
+}
+
+void ThreadLocalRSocketStats::memoryPressureChanged(
+    MemoryPressure level,
+    size_t bytes) {
+  add(Counter::MEMORY_PRESSURE_CHANGES);
+  memoryPressure_.store(level, std::memory_order_relaxed);
+  memoryPressureBytes_.store(bytes, std::memory_order_relaxed);
+}
+
+void ThreadLocalRSocketStats::requestRejectedMemoryPressure() {
+  add(Counter::REQUESTS_REJECTED_MEMORY_PRESSURE);
+}
+
+void ThreadLocalRSocketStats::requestDeadlineExpired() {
+  add(Counter::REQUEST_DEADLINES_EXPIRED);
+}
+
+void ThreadLocalRSocketStats::expiredFramesDropped(size_t frames) {
+  add(Counter::EXPIRED_FRAMES_DROPPED, frames);
+}
+
+void ThreadLocalRSocketStats::tenantQuotaExceeded() {
+  add(Counter::TENANT_QUOTAS_EXCEEDED);
+}
+
+void ThreadLocalRSocketStats::requestCoalesced() {
+  add(Counter::REQUESTS_COALESCED);
+}
+
+void ThreadLocalRSocketStats::responseCacheHit() {
+  add(Counter::RESPONSE_CACHE_HITS);
+}
+
+void ThreadLocalRSocketStats::responseCacheMiss() {
+  add(Counter::RESPONSE_CACHE_MISSES);
+}
+
+void ThreadLocalRSocketStats::requestUnrouted() {
+  add(Counter::REQUESTS_UNROUTED);
+}
+
+void ThreadLocalRSocketStats::hedgeableRequest() {
+  add(Counter::HEDGEABLE_REQUESTS);
+}
+
+void ThreadLocalRSocketStats::hedgeSent() {
+  add(Counter::HEDGES_SENT);
+}
+
+void ThreadLocalRSocketStats::hedgeWon() {
+  add(Counter::HEDGES_WON);
+}
+
+void ThreadLocalRSocketStats::eventBaseLoopLag(
+    folly::EventBase*,
+    std::chrono::microseconds lag,
+    size_t queueDepth) {
+  auto& local = *local_;
+  local.add(Counter::EVENT_BASE_LAG_SAMPLES);
+  local.add(Counter::EVENT_BASE_LAG_MICROS, static_cast<uint64_t>(lag.count()));
+  local.eventBaseQueueDepth.store(
+      static_cast<int64_t>(queueDepth), std::memory_order_relaxed);
+}
+
+void ThreadLocalRSocketStats::eventBaseActivity(
+    folly::EventBase*,
+    EventBaseActivity activity,
+    std::chrono::microseconds time) {
+  auto counter = Counter::EVENT_BASE_READ_MICROS;
+  switch (activity) {
+    case EventBaseActivity::READ:
+      counter = Counter::EVENT_BASE_READ_MICROS;
+      break;
+    case EventBaseActivity::FRAME_DISPATCH:
+      counter = Counter::EVENT_BASE_FRAME_DISPATCH_MICROS;
+      break;
+    case EventBaseActivity::RESPONDER:
+      counter = Counter::EVENT_BASE_RESPONDER_MICROS;
+      break;
+    case EventBaseActivity::WRITE:
+      counter = Counter::EVENT_BASE_WRITE_MICROS;
+      break;
+  }
+  add(counter, static_cast<uint64_t>(time.count()));
+}
+
+void ThreadLocalRSocketStats::reconnectAttempted() {
+  add(Counter::RECONNECT_ATTEMPTS);
+}
+
+void ThreadLocalRSocketStats::reconnected(
+    std::chrono::microseconds downtime,
+    size_t rounds) {
+  auto& local = *local_;
+  local.add(Counter::RECONNECTS);
+  local.add(Counter::RECONNECT_ROUNDS, rounds);
+  local.add(
+      Counter::RECONNECT_DOWNTIME_MICROS,
+      static_cast<uint64_t>(downtime.count()));
+}
+
+void ThreadLocalRSocketStats::reconnectAbandoned() {
+  add(Counter::RECONNECTS_ABANDONED);
+}
+
+void ThreadLocalRSocketStats::unknownFrameReceived() {
+  add(Counter::UNKNOWN_FRAMES_READ);
+}
+
+} // namespace rsocket
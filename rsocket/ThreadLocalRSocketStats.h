@@ -0,0 +1,307 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Range.h>
+#include <folly/ThreadLocal.h>
+#include <folly/lang/Align.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#include "rsocket/RSocketStats.h"
+#include "rsocket/internal/ThreadLocalHistogram.h"
+
+namespace rsocket {
+
+/**
+ * An RSocketStats that counts every event, with counters that are cheap to
+ * update from many threads at once.
+ *
+ * Every thread counts into a cache-line-aligned block of its own with relaxed
+ * stores, so that events on different threads neither contend on an atomic
+ * read-modify-write nor share cache lines.  snapshot() sums the blocks of all
+ * threads when asked.  Streams are timed into a ThreadLocalHistogram per
+ * stream type.
+ *
+ * One instance is meant to be shared by all the connections of a client or
+ * server.
+ */
+class ThreadLocalRSocketStats : public RSocketStats {
+ public:
+  enum class Counter : size_t {
+    SOCKETS_CREATED,
+    SOCKETS_CONNECTED,
+    SOCKETS_DISCONNECTED,
+    SOCKETS_CLOSED,
+    SERVER_CONNECTIONS_ACCEPTED,
+    DUPLEX_CONNECTIONS_CREATED,
+    DUPLEX_CONNECTIONS_CLOSED,
+    RESUMES_SUCCEEDED,
+    RESUMES_FAILED,
+    RESUMES_FAILED_NO_STATE,
+    RESUME_BYTES_REPLAYED,
+    COLD_RESUMES,
+    COLD_RESUME_STREAMS_RESTORED,
+    COLD_RESUME_MICROS,
+    BYTES_WRITTEN,
+    BYTES_READ,
+    BYTES_WRITTEN_ZERO_COPY,
+    BYTES_WRITTEN_COPIED,
+    KERNEL_TLS_SEND,
+    KERNEL_TLS_RECEIVE,
+    FRAMES_WRITTEN,
+    FRAMES_READ,
+    UNKNOWN_FRAMES_READ,
+    RESUME_FRAMES_EVICTED,
+    RESUME_BYTES_EVICTED,
+    STREAM_FRAMES_BUFFERED,
+    STREAM_BYTES_BUFFERED,
+    STREAMS_OPENED,
+    STREAMS_CLOSED,
+    STREAM_BYTES,
+    STREAM_STATE_MACHINES_ALLOCATED,
+    STREAM_STATE_MACHINES_POOLED,
+    KEEPALIVES_SENT,
+    KEEPALIVES_RECEIVED,
+    KEEPALIVES_SUPPRESSED,
+    PAYLOADS_COMPRESSED,
+    PAYLOAD_BYTES_COMPRESSED,
+    PAYLOAD_BYTES_AFTER_COMPRESSION,
+    PAYLOADS_DECOMPRESSED,
+    LEASES_SENT,
+    LEASES_RECEIVED,
+    REQUESTS_WITHOUT_LEASE,
+    STREAM_LIMIT_REACHED,
+    REQUESTS_REJECTED_OVERLOADED,
+    REQUESTS_REJECTED_MEMORY_PRESSURE,
+    MEMORY_PRESSURE_CHANGES,
+    REQUEST_DEADLINES_EXPIRED,
+    EXPIRED_FRAMES_DROPPED,
+    TENANT_QUOTAS_EXCEEDED,
+    REQUESTS_COALESCED,
+    RESPONSE_CACHE_HITS,
+    RESPONSE_CACHE_MISSES,
+    REQUESTS_UNROUTED,
+    HEDGEABLE_REQUESTS,
+    HEDGES_SENT,
+    HEDGES_WON,
+    EVENT_BASE_LAG_SAMPLES,
+    EVENT_BASE_LAG_MICROS,
+    EVENT_BASE_READ_MICROS,
+    EVENT_BASE_FRAME_DISPATCH_MICROS,
+    EVENT_BASE_RESPONDER_MICROS,
+    EVENT_BASE_WRITE_MICROS,
+    RECONNECT_ATTEMPTS,
+    RECONNECTS,
+    RECONNECT_ROUNDS,
+    RECONNECT_DOWNTIME_MICROS,
+    RECONNECTS_ABANDONED,
+  };
+
+  static constexpr size_t kCounters =
+      static_cast<size_t>(Counter::RECONNECTS_ABANDONED) + 1;
+  static constexpr size_t kFrameTypes = 64;
+  static constexpr size_t kStreamTypes = 4;
+
+  static folly::StringPiece toString(Counter);
+
+  struct Snapshot {
+    uint64_t operator[](Counter counter) const {
+      return counters[static_cast<size_t>(counter)];
+    }
+
+    uint64_t framesWritten(FrameType type) const {
+      return framesWrittenByType[indexOf(type)];
+    }
+
+    uint64_t framesRead(FrameType type) const {
+      return framesReadByType[indexOf(type)];
+    }
+
+    /// Microseconds from opening a stream to its first payload, see
+    /// RSocketStats::streamFirstPayload().
+    const ThreadLocalHistogram::Snapshot& firstPayloadLatency(
+        StreamType type) const {
+      return firstPayloadLatencies[static_cast<size_t>(type)];
+    }
+
+    /// Microseconds from opening a stream to closing it.
+    const ThreadLocalHistogram::Snapshot& streamDuration(
+        StreamType type) const {
+      return streamDurations[static_cast<size_t>(type)];
+    }
+
+    std::array<uint64_t, kCounters> counters{};
+    std::array<uint64_t, kFrameTypes> framesWrittenByType{};
+    std::array<uint64_t, kFrameTypes> framesReadByType{};
+
+    /// Frames and bytes held in resume and stream buffers right now.
+    int64_t resumeBufferFrames{0};
+    int64_t resumeBufferBytes{0};
+    int64_t streamBufferFrames{0};
+    int64_t streamBufferBytes{0};
+
+    /// Callbacks waiting in the NotificationQueues of the monitored
+    /// EventBase threads, as of their last report.
+    int64_t eventBaseQueueDepth{0};
+
+    /// Memory pressure level of the process, and the memory it used, as of
+    /// the last change of level.
+    MemoryPressure memoryPressure{MemoryPressure::NONE};
+    uint64_t memoryPressureBytes{0};
+
+    std::array<ThreadLocalHistogram::Snapshot, kStreamTypes>
+        firstPayloadLatencies;
+    std::array<ThreadLocalHistogram::Snapshot, kStreamTypes> streamDurations;
+  };
+
+  ThreadLocalRSocketStats();
+
+  /// Sums the events counted by all threads so far.
+  Snapshot snapshot() const;
+
+  void socketCreated() override;
+  void socketConnected() override;
+  void socketDisconnected() override;
+  void socketClosed(StreamCompletionSignal) override;
+  void serverConnectionAccepted() override;
+  void duplexConnectionCreated(const std::string&, DuplexConnection*) override;
+  void duplexConnectionClosed(const std::string&, DuplexConnection*) override;
+  void serverResume(
+      folly::Optional<int64_t> clientAvailable,
+      int64_t serverAvailable,
+      int64_t serverDelta,
+      ResumeOutcome outcome) override;
+  void bytesWritten(size_t bytes) override;
+  void bytesRead(size_t bytes) override;
+  void bytesWrittenZeroCopy(size_t bytes) override;
+  void bytesWrittenCopied(size_t bytes) override;
+  void kernelTls(DuplexConnection*, bool send, bool receive) override;
+  void frameWritten(FrameType) override;
+  void frameRead(FrameType) override;
+  void resumeBufferChanged(int framesCountDelta, int dataSizeDelta) override;
+  void resumeBufferEvictedForBudget(int framesCount, int dataSize) override;
+  void streamBufferChanged(int64_t framesCountDelta, int64_t dataSizeDelta)
+      override;
+  void streamOpened(StreamType) override;
+  void streamFirstPayload(StreamType, std::chrono::microseconds latency)
+      override;
+  void streamClosed(
+      StreamType,
+      std::chrono::microseconds duration,
+      size_t bytes) override;
+  void resumeFailedNoState() override;
+  void coldResumeStreamsRestored(
+      size_t streams,
+      std::chrono::microseconds duration) override;
+  void keepaliveSent() override;
+  void keepaliveReceived() override;
+  void keepaliveSuppressed() override;
+  void payloadCompressed(size_t rawBytes, size_t compressedBytes) override;
+  void payloadDecompressed(size_t compressedBytes, size_t rawBytes) override;
+  void streamStateMachineAllocated(bool fromPool) override;
+  void leaseSent(uint32_t numberOfRequests) override;
+  void leaseReceived(uint32_t numberOfRequests) override;
+  void requestWithoutLease() override;
+  void streamLimitReached() override;
+  void requestRejectedOverloaded() override;
+  void memoryPressureChanged(MemoryPressure level, size_t bytes) override;
+  void requestRejectedMemoryPressure() override;
+  void requestDeadlineExpired() override;
+  void expiredFramesDropped(size_t frames) override;
+  void tenantQuotaExceeded() override;
+  void requestCoalesced() override;
+  void responseCacheHit() override;
+  void responseCacheMiss() override;
+  void requestUnrouted() override;
+  void hedgeableRequest() override;
+  void hedgeSent() override;
+  void hedgeWon() override;
+  void eventBaseLoopLag(
+      folly::EventBase*,
+      std::chrono::microseconds lag,
+      size_t queueDepth) override;
+  void eventBaseActivity(
+      folly::EventBase*,
+      EventBaseActivity activity,
+      std::chrono::microseconds time) override;
+  void reconnectAttempted() override;
+  void reconnected(std::chrono::microseconds downtime, size_t rounds)
+      override;
+  void reconnectAbandoned() override;
+  void unknownFrameReceived() override;
+
+ private:
+  struct Tag {};
+
+  static size_t indexOf(FrameType type) {
+    return static_cast<size_t>(type) % kFrameTypes;
+  }
+
+  /// The counters of one thread.  Written by that thread only, read by any.
+  struct alignas(folly::hardware_destructive_interference_size) Local {
+    explicit Local(ThreadLocalRSocketStats* parent) : parent(parent) {}
+    ~Local();
+
+    template <typename T>
+    static void bump(std::atomic<T>& counter, T by) {
+      counter.store(
+          counter.load(std::memory_order_relaxed) + by,
+          std::memory_order_relaxed);
+    }
+
+    void add(Counter counter, uint64_t by = 1) {
+      bump(counters[static_cast<size_t>(counter)], by);
+    }
+
+    void addTo(Snapshot& snapshot) const;
+
+    ThreadLocalRSocketStats* const parent;
+    std::array<std::atomic<uint64_t>, kCounters> counters{};
+    std::array<std::atomic<uint64_t>, kFrameTypes> framesWritten{};
+    std::array<std::atomic<uint64_t>, kFrameTypes> framesRead{};
+    std::atomic<int64_t> resumeBufferFrames{0};
+    std::atomic<int64_t> resumeBufferBytes{0};
+    std::atomic<int64_t> streamBufferFrames{0};
+    std::atomic<int64_t> streamBufferBytes{0};
+
+    /// Set, rather than added to, by the EventBase thread owning this.  Not
+    /// kept once the thread exits.
+    std::atomic<int64_t> eventBaseQueueDepth{0};
+  };
+
+  void add(Counter counter, uint64_t by = 1) {
+    local_->add(counter, by);
+  }
+
+  /// Counts of the threads that exited.  Declared ahead of `local_` so that
+  /// it outlives the Local instances folding into it.
+  mutable std::mutex retiredMutex_;
+  Snapshot retired_;
+
+  folly::ThreadLocal<Local, Tag> local_;
+
+  std::array<ThreadLocalHistogram, kStreamTypes> firstPayloadLatencies_;
+  std::array<ThreadLocalHistogram, kStreamTypes> streamDurations_;
+
+  /// Process-wide, so not kept per thread.
+  std::atomic<MemoryPressure> memoryPressure_{MemoryPressure::NONE};
+  std::atomic<uint64_t> memoryPressureBytes_{0};
+};
+
+} // namespace rsocket
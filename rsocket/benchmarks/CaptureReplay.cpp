@@ -0,0 +1,300 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/benchmarks/Latch.h"
+#include "rsocket/benchmarks/Throughput.h"
+
+#include <folly/Benchmark.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <folly/portability/GFlags.h>
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+#include "rsocket/RSocket.h"
+#include "rsocket/framing/FrameSerializer.h"
+#include "rsocket/transports/capture/CaptureFile.h"
+
+using namespace rsocket;
+
+DEFINE_string(
+    capture,
+    "",
+    "capture file to replay, see CaptureDuplexConnection; replays a "
+    "synthetic session if empty");
+DEFINE_int32(synthetic_requests, 10000, "requests of the synthetic session");
+DEFINE_int32(
+    synthetic_gap_us,
+    20,
+    "microseconds between the frames of the synthetic session");
+
+/// Replays the frames a server read on a captured connection into a server,
+/// over a connection that drops whatever the server sends back.  At original
+/// speed every frame is delivered at its offset from the start of the
+/// capture, to the millisecond, which reproduces the load of the captured
+/// connection.  At max speed the frames are delivered back to back.
+
+namespace {
+
+constexpr std::chrono::minutes kTimeout{5};
+
+class ReplayConnection : public DuplexConnection {
+ public:
+  ReplayConnection(
+      const CapturedSession& session,
+      folly::EventBase& eventBase,
+      bool originalSpeed,
+      Latch& done)
+      : state_{std::make_shared<State>(session, eventBase, originalSpeed)} {
+    state_->done = &done;
+  }
+
+  ~ReplayConnection() override {
+    if (auto input = std::move(state_->input)) {
+      input->onComplete();
+    }
+  }
+
+  void setInput(std::shared_ptr<Subscriber> input) override {
+    auto& state = *state_;
+    state.input = input;
+    input->onSubscribe(
+        std::make_shared<Subscription>(state_, ++state.generation));
+    if (state.scheduled) {
+      // Delivering already, or waiting for the next frame to be due.
+      return;
+    }
+    if (!state.started) {
+      state.started = true;
+      state.start = std::chrono::steady_clock::now();
+    }
+    state.scheduled = true;
+    state.eventBase.runInLoop(
+        [weak = std::weak_ptr<State>(state_)] { State::deliver(weak); });
+  }
+
+  void send(std::unique_ptr<folly::IOBuf> frame) override {
+    framesSent.fetch_add(1, std::memory_order_relaxed);
+    bytesSent.fetch_add(
+        frame->computeChainDataLength(), std::memory_order_relaxed);
+  }
+
+  bool isFramed() const override {
+    return true;
+  }
+
+  static std::atomic<size_t> framesSent;
+  static std::atomic<size_t> bytesSent;
+
+ private:
+  struct State {
+    State(
+        const CapturedSession& session,
+        folly::EventBase& evb,
+        bool original)
+        : eventBase{evb}, originalSpeed{original} {
+      for (const auto& frame : session.frames) {
+        if (frame.direction == FrameCapture::Direction::IN) {
+          frames.push_back(&frame);
+        }
+      }
+    }
+
+    /// Delivers the frames that are due, until the input goes away.
+    static void deliver(const std::weak_ptr<State>& weak) {
+      const auto self = weak.lock();
+      if (!self) {
+        return;
+      }
+      auto& state = *self;
+      while (state.next < state.frames.size()) {
+        if (!state.input) {
+          // Waits for setInput().
+          state.scheduled = false;
+          return;
+        }
+        const auto& frame = *state.frames[state.next];
+        if (state.originalSpeed) {
+          const auto due = state.start + frame.offset;
+          const auto now = std::chrono::steady_clock::now();
+          if (due > now) {
+            // Rounded up, as timers only have millisecond precision.
+            const auto delay =
+                std::chrono::duration_cast<std::chrono::milliseconds>(
+                    due - now + std::chrono::milliseconds{1} -
+                    std::chrono::nanoseconds{1});
+            state.eventBase.runAfterDelay(
+                [weak] { deliver(weak); },
+                static_cast<uint32_t>(delay.count()));
+            return;
+          }
+        }
+        ++state.next;
+        const auto input = state.input;
+        input->onNext(frame.frame->clone());
+      }
+      state.scheduled = false;
+      if (auto done = std::exchange(state.done, nullptr)) {
+        done->post();
+      }
+    }
+
+    folly::EventBase& eventBase;
+    const bool originalSpeed;
+    std::vector<const CapturedFrame*> frames;
+    size_t next{0};
+
+    std::shared_ptr<Subscriber> input;
+    uint64_t generation{0};
+    bool started{false};
+    bool scheduled{false};
+    std::chrono::steady_clock::time_point start;
+    Latch* done{nullptr};
+  };
+
+  /// Cancelling stops the deliveries to the input it was handed to.
+  class Subscription : public yarpl::flowable::Subscription {
+   public:
+    Subscription(std::weak_ptr<State> state, uint64_t generation)
+        : state_{std::move(state)}, generation_{generation} {}
+
+    void request(int64_t) override {}
+
+    void cancel() override {
+      if (auto state = state_.lock()) {
+        if (state->generation == generation_) {
+          state->input.reset();
+        }
+      }
+    }
+
+   private:
+    const std::weak_ptr<State> state_;
+    const uint64_t generation_;
+  };
+
+  const std::shared_ptr<State> state_;
+};
+
+std::atomic<size_t> ReplayConnection::framesSent{0};
+std::atomic<size_t> ReplayConnection::bytesSent{0};
+
+std::unique_ptr<folly::IOBuf> makeSetup(const FrameSerializer& serializer) {
+  const auto version = ProtocolVersion::Latest;
+
+  Frame_SETUP frame;
+  frame.header_ = FrameHeader{FrameType::SETUP, FrameFlags::EMPTY_, 0};
+  frame.versionMajor_ = version.major;
+  frame.versionMinor_ = version.minor;
+  frame.keepaliveTime_ = Frame_SETUP::kMaxKeepaliveTime;
+  frame.maxLifetime_ = Frame_SETUP::kMaxLifetime;
+  frame.token_ = ResumeIdentificationToken::generateNew();
+  frame.metadataMimeType_ = "application/octet-stream";
+  frame.dataMimeType_ = "application/octet-stream";
+  return serializer.serializeOut(std::move(frame));
+}
+
+/// A session of request/responses, with a stream every tenth request that
+/// asks for a few responses and then cancels.
+CapturedSession makeSyntheticSession() {
+  const auto& serializer =
+      *FrameSerializer::shared(ProtocolVersion::Latest, false);
+  const std::chrono::microseconds gap{FLAGS_synthetic_gap_us};
+
+  CapturedSession session;
+  session.start = std::chrono::system_clock::now();
+  std::chrono::nanoseconds offset{0};
+  auto add = [&](std::unique_ptr<folly::IOBuf> frame) {
+    CapturedFrame captured;
+    captured.offset = offset;
+    captured.frame = std::move(frame);
+    session.frames.push_back(std::move(captured));
+    offset += gap;
+  };
+
+  add(makeSetup(serializer));
+  StreamId streamId = 1;
+  for (int i = 0; i < FLAGS_synthetic_requests; ++i, streamId += 2) {
+    if (i % 10 == 9) {
+      add(serializer.serializeOut(
+          Frame_REQUEST_STREAM(streamId, FrameFlags::EMPTY_, 4, Payload("s"))));
+      add(serializer.serializeOut(Frame_CANCEL(streamId)));
+    } else {
+      add(serializer.serializeOut(Frame_REQUEST_RESPONSE(
+          streamId, FrameFlags::EMPTY_, Payload("request"))));
+    }
+  }
+  return session;
+}
+
+const CapturedSession& session() {
+  static const auto session = FLAGS_capture.empty()
+      ? makeSyntheticSession()
+      : CaptureFile::read(FLAGS_capture);
+  return session;
+}
+
+void replay(size_t n, bool originalSpeed) {
+  std::unique_ptr<folly::ScopedEventBaseThread> worker;
+  std::unique_ptr<RSocketServer> server;
+  std::shared_ptr<RSocketServiceHandler> serviceHandler;
+  BENCHMARK_SUSPEND {
+    session();
+    worker = std::make_unique<folly::ScopedEventBaseThread>("replay");
+    server = std::make_unique<RSocketServer>(nullptr);
+    auto responder = std::make_shared<FixedResponder>("response");
+    serviceHandler = RSocketServiceHandler::create(
+        [responder](const SetupParameters&) { return responder; });
+  }
+
+  auto& evb = *worker->getEventBase();
+  for (size_t i = 0; i < n; ++i) {
+    Latch done{1};
+    evb.runInEventBaseThread([&] {
+      server->acceptConnection(
+          std::make_unique<ReplayConnection>(
+              session(), evb, originalSpeed, done),
+          evb,
+          serviceHandler);
+    });
+    if (!done.timed_wait(kTimeout)) {
+      LOG(ERROR) << "Timed out!";
+    }
+  }
+
+  BENCHMARK_SUSPEND {
+    server.reset();
+    worker.reset();
+    const auto& frames = session().frames;
+    const auto read = std::count_if(
+        frames.begin(), frames.end(), [](const CapturedFrame& frame) {
+          return frame.direction == FrameCapture::Direction::IN;
+        });
+    LOG(INFO) << "  Replayed " << read << " frames " << n
+              << " times, the server sent "
+              << ReplayConnection::framesSent.exchange(0) << " frames of "
+              << ReplayConnection::bytesSent.exchange(0) << " bytes";
+  }
+}
+
+} // namespace
+
+BENCHMARK(Replay_MaxSpeed, n) {
+  replay(n, false);
+}
+
+BENCHMARK(Replay_OriginalSpeed, n) {
+  replay(n, true);
+}
@@ -0,0 +1,80 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/benchmarks/InProcessFixture.h"
+#include "rsocket/benchmarks/Latch.h"
+#include "rsocket/benchmarks/Throughput.h"
+
+#include <folly/Benchmark.h>
+#include <folly/portability/GFlags.h>
+
+#include "rsocket/RSocket.h"
+#include "yarpl/Flowable.h"
+
+using namespace rsocket;
+
+DEFINE_int32(items, 1000000, "number of items in each direction");
+DEFINE_int32(payload_size, 32, "size of the payloads, in bytes");
+DEFINE_int32(
+    request_batch,
+    64,
+    "number of items both ends of the channel ask for at a time");
+
+BENCHMARK(ChannelThroughput, n) {
+  (void)n;
+
+  // Both directions of the channel terminate.
+  Latch latch{2};
+
+  std::unique_ptr<InProcessFixture> fixture;
+  std::shared_ptr<yarpl::flowable::Flowable<Payload>> requests;
+  folly::Optional<uint64_t> allocationsBefore;
+
+  BENCHMARK_SUSPEND {
+    auto const message = std::string(FLAGS_payload_size, 'a');
+    fixture = std::make_unique<InProcessFixture>(
+        std::make_shared<ChannelResponder>(
+            latch, message, FLAGS_items, FLAGS_request_batch));
+
+    requests = yarpl::flowable::Flowable<Payload>::fromGenerator(
+                   [msg = folly::IOBuf::copyBuffer(message)] {
+                     return Payload(msg->clone());
+                   })
+                   ->take(FLAGS_items);
+
+    LOG(INFO) << "  Running with " << FLAGS_items << " items of "
+              << FLAGS_payload_size << " bytes each way, asked for "
+              << FLAGS_request_batch << " at a time";
+    allocationsBefore = allocationCount();
+  }
+
+  fixture->clients.front()->getRequester()
+      ->requestChannel(Payload("InMemoryChannel"), requests)
+      ->subscribe(
+          std::make_shared<BatchingSubscriber>(latch, FLAGS_request_batch));
+
+  constexpr std::chrono::minutes timeout{5};
+  if (!latch.timed_wait(timeout)) {
+    LOG(ERROR) << "Timed out!";
+  }
+
+  BENCHMARK_SUSPEND {
+    auto const allocationsAfter = allocationCount();
+    if (allocationsBefore && allocationsAfter && FLAGS_items > 0) {
+      LOG(INFO) << "  Allocations per item: "
+                << static_cast<double>(*allocationsAfter - *allocationsBefore) /
+              (2 * FLAGS_items);
+    }
+  }
+}
@@ -0,0 +1,93 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/benchmarks/Fixture.h"
+#include "rsocket/benchmarks/Latch.h"
+#include "rsocket/benchmarks/Throughput.h"
+
+#include <folly/Benchmark.h>
+#include <folly/portability/GFlags.h>
+
+#include "rsocket/RSocket.h"
+#include "yarpl/Flowable.h"
+
+using namespace rsocket;
+
+DEFINE_int32(server_threads, 8, "number of server threads to run");
+DEFINE_int32(
+    override_client_threads,
+    0,
+    "control the number of client threads (defaults to the number of clients)");
+DEFINE_int32(clients, 10, "number of clients to run");
+DEFINE_int32(channels, 1, "number of channels, per client");
+DEFINE_int32(items, 1000000, "number of items in each direction of a channel");
+DEFINE_int32(payload_size, 32, "size of the payloads, in bytes");
+DEFINE_int32(
+    request_batch,
+    64,
+    "number of items both ends of a channel ask for at a time");
+
+BENCHMARK(ChannelThroughput, n) {
+  (void)n;
+
+  // Both directions of every channel terminate.
+  Latch latch{static_cast<size_t>(2 * FLAGS_channels * FLAGS_clients)};
+
+  std::unique_ptr<Fixture> fixture;
+  Fixture::Options opts;
+  std::shared_ptr<yarpl::flowable::Flowable<Payload>> requests;
+
+  BENCHMARK_SUSPEND {
+    auto const message = std::string(FLAGS_payload_size, 'a');
+    auto responder = std::make_shared<ChannelResponder>(
+        latch, message, FLAGS_items, FLAGS_request_batch);
+
+    opts.serverThreads = FLAGS_server_threads;
+    opts.clients = FLAGS_clients;
+    if (FLAGS_override_client_threads > 0) {
+      opts.clientThreads = FLAGS_override_client_threads;
+    }
+
+    fixture = std::make_unique<Fixture>(opts, std::move(responder));
+
+    requests = yarpl::flowable::Flowable<Payload>::fromGenerator(
+                   [msg = folly::IOBuf::copyBuffer(message)] {
+                     return Payload(msg->clone());
+                   })
+                   ->take(FLAGS_items);
+
+    LOG(INFO) << "Running:";
+    LOG(INFO) << "  Server with " << opts.serverThreads << " threads.";
+    LOG(INFO) << "  " << opts.clients << " clients across "
+              << fixture->workers.size() << " threads.";
+    LOG(INFO) << "  Running " << FLAGS_channels << " channels per client, of "
+              << FLAGS_items << " items of " << FLAGS_payload_size
+              << " bytes each way, asked for " << FLAGS_request_batch
+              << " at a time.";
+  }
+
+  for (int i = 0; i < FLAGS_channels; ++i) {
+    for (auto& client : fixture->clients) {
+      client->getRequester()
+          ->requestChannel(Payload("TcpChannel"), requests)
+          ->subscribe(std::make_shared<BatchingSubscriber>(
+              latch, FLAGS_request_batch));
+    }
+  }
+
+  constexpr std::chrono::minutes timeout{5};
+  if (!latch.timed_wait(timeout)) {
+    LOG(ERROR) << "Timed out!";
+  }
+}
@@ -0,0 +1,339 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/benchmarks/Fixture.h"
+#include "rsocket/benchmarks/LatencyHistogram.h"
+#include "rsocket/benchmarks/Throughput.h"
+
+#include <folly/Benchmark.h>
+#include <folly/memory/Malloc.h>
+#include <folly/memory/MallctlHelper.h>
+#include <folly/portability/GFlags.h>
+#include <folly/synchronization/Baton.h>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "rsocket/RSocket.h"
+#include "rsocket/internal/WarmResumeManager.h"
+#include "rsocket/statemachine/RSocketStateMachine.h"
+#include "rsocket/transports/tcp/TcpConnectionFactory.h"
+
+using namespace rsocket;
+
+DEFINE_int32(server_threads, 8, "number of server threads to run");
+DEFINE_int32(client_threads, 16, "number of threads holding connections");
+DEFINE_int32(connections, 100000, "number of connections to hold open");
+DEFINE_int32(keepalive_ms, 5000, "keepalive interval of the connections");
+DEFINE_bool(resumable, true, "whether the connections are resumable");
+DEFINE_double(
+    active_fraction,
+    0.01,
+    "fraction of the connections sending requests while measuring");
+DEFINE_int32(measure_seconds, 10, "length of the idle and active phases");
+DEFINE_int32(
+    samples,
+    1000,
+    "number of connections opened and closed on top of the held ones");
+
+/// Holds a large number of mostly idle connections open, and reports:
+///
+/// - the resident memory and heap allocated per connection, client and
+///   server side combined as both run in this process, and the size of the
+///   state machine each side holds per connection,
+/// - the CPU time spent per connection on keepalives alone, and with a
+///   fraction of the connections sending requests,
+/// - the latency of opening (up to the first response) and closing one more
+///   connection, which goes through the server's ConnectionSet, and of
+///   memoryUsage() walking the set, at that scale.
+///
+/// Every connection takes up two file descriptors, the limit on open files
+/// has to be raised accordingly (e.g. `ulimit -n 250000`).
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+size_t residentBytes() {
+  std::ifstream statm{"/proc/self/statm"};
+  size_t pages = 0;
+  size_t resident = 0;
+  statm >> pages >> resident;
+  return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+/// Bytes allocated by the process, or none if that can't be determined.
+folly::Optional<size_t> allocatedBytes() {
+  if (!folly::usingJEMalloc()) {
+    return folly::none;
+  }
+  try {
+    uint64_t epoch = 1;
+    folly::mallctlWrite("epoch", epoch);
+
+    size_t allocated = 0;
+    folly::mallctlRead("stats.allocated", &allocated);
+    return allocated;
+  } catch (const std::exception& exn) {
+    LOG(WARNING) << "Cannot read allocation stats: " << exn.what();
+    return folly::none;
+  }
+}
+
+std::chrono::microseconds cpuTime() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  auto const micros = [](const timeval& tv) {
+    return std::chrono::seconds{tv.tv_sec} +
+        std::chrono::microseconds{tv.tv_usec};
+  };
+  return micros(usage.ru_utime) + micros(usage.ru_stime);
+}
+
+void checkFileLimit() {
+  rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 &&
+      limit.rlim_cur < 2 * static_cast<rlim_t>(FLAGS_connections) + 1000) {
+    LOG(WARNING) << "The limit of " << limit.rlim_cur
+                 << " open files is too low for " << FLAGS_connections
+                 << " connections";
+  }
+}
+
+/// Opens a connection from `evb` and waits for the response to a first
+/// request, so that the server has set it up.
+std::shared_ptr<RSocketClient> connect(
+    folly::EventBase& evb,
+    const folly::SocketAddress& address) {
+  SetupParameters params;
+  params.resumable = FLAGS_resumable;
+  auto client =
+      RSocket::createConnectedClient(
+          std::make_unique<TcpConnectionFactory>(evb, address),
+          std::move(params),
+          std::make_shared<RSocketResponder>(),
+          std::chrono::milliseconds{FLAGS_keepalive_ms},
+          RSocketStats::noop(),
+          nullptr /* connectionEvents */,
+          FLAGS_resumable
+              ? std::make_shared<WarmResumeManager>(RSocketStats::noop())
+              : ResumeManager::makeEmpty())
+          .get();
+
+  folly::Baton<> done;
+  client->getRequester()
+      ->requestResponse(Payload("ConnectionScaleTcp"))
+      ->subscribe(
+          [&](Payload) { done.post(); },
+          [&](folly::exception_wrapper ew) {
+            LOG(ERROR) << "First request failed: " << ew.what();
+            done.post();
+          });
+  done.wait();
+  return client;
+}
+
+/// Clients have to be destroyed on their EventBase.
+void disconnect(folly::EventBase& evb, std::shared_ptr<RSocketClient> client) {
+  evb.runInEventBaseThreadAndWait([c = std::move(client)] {});
+}
+
+/// Splits `total` over the client workers of `fixture`, running
+/// `fn(evb, count, workerIndex)` for each of them from its own thread.
+template <typename F>
+void forEachWorker(Fixture& fixture, size_t total, F&& fn) {
+  auto const workers = fixture.workers.size();
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < workers; ++i) {
+    auto const count = total / workers + (i < total % workers ? 1 : 0);
+    auto& evb = *fixture.workers[i]->getEventBase();
+    threads.emplace_back([&fn, &evb, count, i] { fn(evb, count, i); });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+/// Sends one request-response after the other on a connection until
+/// stopped.  Runs on the EventBase of the connection.
+class ActiveConnection {
+ public:
+  ActiveConnection(RSocketRequester& requester, std::atomic<bool>& stop)
+      : requester_{requester}, stop_{stop} {}
+
+  void next() {
+    if (stop_.load(std::memory_order_relaxed)) {
+      done_.post();
+      return;
+    }
+    requester_.requestResponse(Payload("ConnectionScaleTcp"))
+        ->subscribe(
+            [this](Payload) {
+              ++completed_;
+              next();
+            },
+            [this](folly::exception_wrapper) { done_.post(); });
+  }
+
+  size_t wait() {
+    done_.wait();
+    return completed_;
+  }
+
+ private:
+  RSocketRequester& requester_;
+  std::atomic<bool>& stop_;
+  size_t completed_{0};
+  folly::Baton<> done_;
+};
+
+void logCpu(
+    const char* phase,
+    std::chrono::microseconds cpu,
+    size_t connections) {
+  auto const seconds = static_cast<double>(FLAGS_measure_seconds);
+  LOG(INFO) << "  " << phase << ": " << cpu.count() / seconds / 1000
+            << "ms of CPU per second, "
+            << static_cast<double>(cpu.count()) / seconds / connections
+            << "us per connection per second";
+}
+
+void logLatency(const char* operation, const LatencyHistogram& histogram) {
+  auto const us = [](std::chrono::nanoseconds latency) {
+    return std::chrono::duration<double, std::micro>(latency).count();
+  };
+  LOG(INFO) << "  " << operation << " latency p50 "
+            << us(histogram.percentile(0.5)) << "us, p99 "
+            << us(histogram.percentile(0.99)) << "us, max "
+            << us(histogram.max()) << "us";
+}
+
+} // namespace
+
+BENCHMARK(ConnectionScale, n) {
+  (void)n;
+
+  folly::BenchmarkSuspender suspender;
+  checkFileLimit();
+
+  Fixture::Options opts;
+  opts.serverThreads = FLAGS_server_threads;
+  opts.clients = 0;
+  opts.clientThreads = static_cast<size_t>(FLAGS_client_threads);
+  opts.resumable = FLAGS_resumable;
+  Fixture fixture{opts, std::make_shared<FixedResponder>("ConnectionScale")};
+  folly::SocketAddress const address{
+      "127.0.0.1", *fixture.server->listeningPort()};
+
+  LOG(INFO) << "Opening " << FLAGS_connections << " connections (keepalive "
+            << FLAGS_keepalive_ms << "ms, "
+            << (FLAGS_resumable ? "resumable" : "not resumable") << ")";
+
+  std::vector<std::vector<std::shared_ptr<RSocketClient>>> clients(
+      fixture.workers.size());
+  auto const residentBefore = residentBytes();
+  auto const allocatedBefore = allocatedBytes();
+  forEachWorker(
+      fixture,
+      FLAGS_connections,
+      [&](folly::EventBase& evb, size_t count, size_t i) {
+        for (size_t j = 0; j < count; ++j) {
+          clients[i].push_back(connect(evb, address));
+        }
+      });
+  auto const residentAfter = residentBytes();
+  auto const allocatedAfter = allocatedBytes();
+
+  auto const connections = fixture.server->getNumConnections();
+  auto const usage = fixture.server->memoryUsage().get();
+  if (connections > 0) {
+    LOG(INFO) << "  Resident bytes per connection: "
+              << (residentAfter - std::min(residentAfter, residentBefore)) /
+            connections;
+    if (allocatedBefore && allocatedAfter &&
+        *allocatedAfter > *allocatedBefore) {
+      LOG(INFO) << "  Allocated bytes per connection: "
+                << (*allocatedAfter - *allocatedBefore) / connections;
+    }
+    LOG(INFO) << "  Tracked server bytes per connection: "
+              << usage.total() / connections;
+  }
+  LOG(INFO) << "  sizeof(RSocketStateMachine): "
+            << sizeof(RSocketStateMachine);
+
+  // Only keepalives are sent while the connections sit idle.
+  auto cpuStart = cpuTime();
+  std::this_thread::sleep_for(std::chrono::seconds{FLAGS_measure_seconds});
+  logCpu("Idle", cpuTime() - cpuStart, connections);
+
+  std::atomic<bool> stop{false};
+  std::vector<std::unique_ptr<ActiveConnection>> active;
+  cpuStart = cpuTime();
+  for (size_t i = 0; i < clients.size(); ++i) {
+    auto const fraction = std::max(0.0, std::min(FLAGS_active_fraction, 1.0));
+    auto const count = static_cast<size_t>(clients[i].size() * fraction);
+    auto& evb = *fixture.workers[i]->getEventBase();
+    for (size_t j = 0; j < count; ++j) {
+      active.push_back(std::make_unique<ActiveConnection>(
+          *clients[i][j]->getRequester(), stop));
+      evb.runInEventBaseThread([a = active.back().get()] { a->next(); });
+    }
+  }
+  std::this_thread::sleep_for(std::chrono::seconds{FLAGS_measure_seconds});
+  stop = true;
+  size_t requests = 0;
+  for (auto& connection : active) {
+    requests += connection->wait();
+  }
+  logCpu("Active", cpuTime() - cpuStart, connections);
+  LOG(INFO) << "  " << active.size() << " active connections sent "
+            << requests / FLAGS_measure_seconds << " requests/sec";
+
+  // Open and close connections on top of the held ones.
+  LatencyHistogram opens;
+  LatencyHistogram closes;
+  auto& evb = *fixture.workers.front()->getEventBase();
+  for (int i = 0; i < FLAGS_samples; ++i) {
+    auto start = Clock::now();
+    auto client = connect(evb, address);
+    opens.record(Clock::now() - start);
+
+    start = Clock::now();
+    disconnect(evb, std::move(client));
+    closes.record(Clock::now() - start);
+  }
+  logLatency("Open", opens);
+  logLatency("Close", closes);
+
+  LatencyHistogram walks;
+  for (int i = 0; i < 10; ++i) {
+    auto const start = Clock::now();
+    fixture.server->memoryUsage().get();
+    walks.record(Clock::now() - start);
+  }
+  logLatency("memoryUsage()", walks);
+
+  for (size_t i = 0; i < clients.size(); ++i) {
+    auto& workerEvb = *fixture.workers[i]->getEventBase();
+    workerEvb.runInEventBaseThreadAndWait(
+        [c = std::move(clients[i])] {});
+  }
+}
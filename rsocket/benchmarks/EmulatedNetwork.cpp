@@ -0,0 +1,291 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/benchmarks/EmulatedNetwork.h"
+
+#include <folly/Function.h>
+#include <folly/Optional.h>
+#include <folly/io/async/AsyncTimeout.h>
+
+#include <algorithm>
+#include <deque>
+#include <random>
+
+namespace rsocket {
+
+using Clock = std::chrono::steady_clock;
+
+/// One direction of the path.  Holds the buffers back until they are due,
+/// then hands them to the sink.
+class EmulatedDuplexConnection::DelayLine : public folly::AsyncTimeout {
+ public:
+  using Sink =
+      folly::Function<void(std::vector<std::unique_ptr<folly::IOBuf>>)>;
+
+  DelayLine(
+      folly::EventBase& eventBase,
+      const Options& options,
+      uint64_t seed,
+      Sink sink)
+      : folly::AsyncTimeout{&eventBase},
+        options_{options},
+        random_{seed},
+        sink_{std::move(sink)} {}
+
+  bool empty() const {
+    return queue_.empty();
+  }
+
+  void push(std::unique_ptr<folly::IOBuf> buf) {
+    auto const now = Clock::now();
+    auto const arrival = arrivalOf(now, buf->computeChainDataLength());
+    if (queue_.empty() && arrival <= now) {
+      std::vector<std::unique_ptr<folly::IOBuf>> due;
+      due.push_back(std::move(buf));
+      // Last, the sink may destroy this line.
+      sink_(std::move(due));
+      return;
+    }
+    queue_.push_back(Entry{arrival, std::move(buf)});
+    if (queue_.size() == 1) {
+      schedule(now);
+    }
+  }
+
+  /// Hands every buffer still held back to the sink right away.
+  void flush() {
+    cancelTimeout();
+    deliver(Clock::time_point::max());
+  }
+
+  void timeoutExpired() noexcept override {
+    deliver(Clock::now());
+  }
+
+ private:
+  struct Entry {
+    Clock::time_point arrival;
+    std::unique_ptr<folly::IOBuf> buf;
+  };
+
+  Clock::time_point arrivalOf(Clock::time_point now, size_t bytes) {
+    // The buffer leaves once the ones ahead of it are through, and takes as
+    // long as the bandwidth says to go through.
+    departure_ = std::max(departure_, now);
+    if (options_.bandwidth > 0) {
+      departure_ += std::chrono::nanoseconds{
+          static_cast<std::chrono::nanoseconds::rep>(
+              bytes * 1000000000.0 / options_.bandwidth)};
+    }
+
+    auto arrival = departure_ + options_.delay;
+    if (options_.jitter.count() > 0) {
+      std::uniform_int_distribution<std::chrono::microseconds::rep> jitter{
+          0, options_.jitter.count()};
+      arrival += std::chrono::microseconds{jitter(random_)};
+    }
+    if (options_.lossRate > 0 &&
+        std::bernoulli_distribution{options_.lossRate}(random_)) {
+      arrival += options_.retransmitTimeout;
+    }
+
+    // In order, the way a byte stream delivers them.
+    lastArrival_ = std::max(lastArrival_, arrival);
+    return lastArrival_;
+  }
+
+  void schedule(Clock::time_point now) {
+    auto const wait = std::chrono::duration_cast<std::chrono::microseconds>(
+        queue_.front().arrival - now);
+    scheduleTimeoutHighRes(
+        std::max(wait, std::chrono::microseconds{0}));
+  }
+
+  void deliver(Clock::time_point now) {
+    std::vector<std::unique_ptr<folly::IOBuf>> due;
+    while (!queue_.empty() && queue_.front().arrival <= now) {
+      due.push_back(std::move(queue_.front().buf));
+      queue_.pop_front();
+    }
+    if (!queue_.empty()) {
+      schedule(Clock::now());
+    }
+    if (!due.empty()) {
+      // Last, the sink may destroy this line.
+      sink_(std::move(due));
+    }
+  }
+
+  const Options& options_;
+  std::mt19937_64 random_;
+  Sink sink_;
+  std::deque<Entry> queue_;
+  Clock::time_point departure_;
+  Clock::time_point lastArrival_;
+};
+
+/// Holds the buffers read by the connection back on their way to its input.
+/// Terminal signals wait for the buffers ahead of them.
+class EmulatedDuplexConnection::Input
+    : public DuplexConnection::Subscriber,
+      public std::enable_shared_from_this<Input> {
+ public:
+  Input(
+      folly::EventBase& eventBase,
+      const Options& options,
+      std::shared_ptr<DuplexConnection::Subscriber> inner)
+      : options_{options},
+        inner_{std::move(inner)},
+        line_{eventBase,
+              options_,
+              options_.seed + 1,
+              [this](std::vector<std::unique_ptr<folly::IOBuf>> bufs) {
+                deliver(std::move(bufs));
+              }} {}
+
+  void onSubscribe(
+      std::shared_ptr<yarpl::flowable::Subscription> subscription) override {
+    inner_->onSubscribe(std::move(subscription));
+  }
+
+  void onNext(std::unique_ptr<folly::IOBuf> buf) override {
+    if (line_.empty()) {
+      // The line may call back into the timer after the connection let go
+      // of this input.
+      self_ = shared_from_this();
+    }
+    line_.push(std::move(buf));
+  }
+
+  void onComplete() override {
+    terminate(folly::exception_wrapper());
+  }
+
+  void onError(folly::exception_wrapper ew) override {
+    terminate(std::move(ew));
+  }
+
+ private:
+  void deliver(std::vector<std::unique_ptr<folly::IOBuf>> bufs) {
+    // The inner subscriber may let go of this input.
+    auto const self = shared_from_this();
+    inner_->onNextBatch(folly::range(bufs));
+    if (line_.empty()) {
+      self_.reset();
+      if (terminal_) {
+        finish();
+      }
+    }
+  }
+
+  void terminate(folly::exception_wrapper ew) {
+    terminal_ = std::move(ew);
+    if (line_.empty()) {
+      finish();
+    }
+  }
+
+  void finish() {
+    auto ew = std::move(*terminal_);
+    terminal_.reset();
+    if (ew) {
+      inner_->onError(std::move(ew));
+    } else {
+      inner_->onComplete();
+    }
+  }
+
+  const Options options_;
+  const std::shared_ptr<DuplexConnection::Subscriber> inner_;
+  std::shared_ptr<Input> self_;
+  folly::Optional<folly::exception_wrapper> terminal_;
+  DelayLine line_;
+};
+
+EmulatedDuplexConnection::EmulatedDuplexConnection(
+    std::unique_ptr<DuplexConnection> connection,
+    folly::EventBase& eventBase,
+    Options options)
+    : connection_{std::move(connection)},
+      eventBase_{eventBase},
+      options_{std::move(options)},
+      output_{std::make_unique<DelayLine>(
+          eventBase,
+          options_,
+          options_.seed,
+          [this](std::vector<std::unique_ptr<folly::IOBuf>> bufs) {
+            connection_->sendBatch(std::move(bufs));
+          })} {
+  DCHECK(connection_);
+}
+
+EmulatedDuplexConnection::~EmulatedDuplexConnection() {
+  output_->flush();
+}
+
+void EmulatedDuplexConnection::setInput(
+    std::shared_ptr<DuplexConnection::Subscriber> input) {
+  connection_->setInput(
+      input ? std::make_shared<Input>(eventBase_, options_, std::move(input))
+            : nullptr);
+}
+
+void EmulatedDuplexConnection::send(std::unique_ptr<folly::IOBuf> buf) {
+  output_->push(std::move(buf));
+}
+
+void EmulatedDuplexConnection::sendBatch(
+    std::vector<std::unique_ptr<folly::IOBuf>> bufs) {
+  for (auto& buf : bufs) {
+    output_->push(std::move(buf));
+  }
+}
+
+DuplexConnection::TransportInfo EmulatedDuplexConnection::transportInfo()
+    const {
+  auto info = connection_->transportInfo();
+  info.rtt += 2 * options_.delay + options_.jitter;
+  if (options_.bandwidth > 0) {
+    // The bandwidth-delay product, what a sender converges to.
+    info.congestionWindow = static_cast<size_t>(
+        options_.bandwidth *
+        std::chrono::duration<double>(info.rtt).count());
+  }
+  return info;
+}
+
+folly::Future<ConnectionFactory::ConnectedDuplexConnection>
+EmulatedConnectionFactory::connect(
+    ProtocolVersion version,
+    ResumeStatus resume) {
+  auto options = options_;
+  // Two seeds per connection, one for each direction.
+  options.seed += 2 * connections_++;
+  return factory_->connect(version, resume)
+      .thenValue([options](ConnectedDuplexConnection connected) {
+        auto eventBase = &connected.eventBase;
+        return folly::via(
+            eventBase,
+            [connection = std::move(connected.connection),
+             eventBase,
+             options]() mutable {
+              return ConnectedDuplexConnection{
+                  std::make_unique<EmulatedDuplexConnection>(
+                      std::move(connection), *eventBase, options),
+                  *eventBase};
+            });
+      });
+}
+
+} // namespace rsocket
@@ -0,0 +1,133 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/io/async/EventBase.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#include "rsocket/ConnectionFactory.h"
+#include "rsocket/DuplexConnection.h"
+
+namespace rsocket {
+
+/// Decorates a connection to emulate a WAN path between it and its peer.
+/// Every buffer sent or read is held back for the one-way delay plus a random
+/// jitter, and the buffers of each direction go through no faster than the
+/// bandwidth allows.  Buffers keep their order, as they would over TCP.
+///
+/// Losses are emulated the way a reliable transport lives through them: a
+/// lost buffer arrives a retransmission timeout late, and holds back the
+/// ones behind it.
+///
+/// Both directions are emulated on the connection it decorates, so wrapping
+/// the client side of a loopback connection emulates the whole path.  Must
+/// be created and used on the EventBase of the connection.
+class EmulatedDuplexConnection : public DuplexConnection {
+ public:
+  struct Options {
+    /// Propagation delay of each direction.
+    std::chrono::microseconds delay{0};
+
+    /// Upper bound of the random delay added to every buffer.
+    std::chrono::microseconds jitter{0};
+
+    /// Bytes per second in each direction, unlimited if zero.
+    size_t bandwidth{0};
+
+    /// Probability of a buffer being lost, and so retransmitted.
+    double lossRate{0};
+    std::chrono::microseconds retransmitTimeout{std::chrono::milliseconds{200}};
+
+    /// Seed of the jitter and of the losses, so that runs can be reproduced.
+    uint64_t seed{0};
+  };
+
+  EmulatedDuplexConnection(
+      std::unique_ptr<DuplexConnection> connection,
+      folly::EventBase& eventBase,
+      Options options);
+
+  /// Sends the buffers still held back right away.
+  ~EmulatedDuplexConnection() override;
+
+  void setInput(std::shared_ptr<DuplexConnection::Subscriber>) override;
+
+  void send(std::unique_ptr<folly::IOBuf>) override;
+
+  void sendBatch(std::vector<std::unique_ptr<folly::IOBuf>> frames) override;
+
+  size_t bufferedInputBytes() const override {
+    return connection_->bufferedInputBytes();
+  }
+
+  /// Buffers held back count as in flight, not as buffered.
+  size_t bufferedOutputBytes() const override {
+    return connection_->bufferedOutputBytes();
+  }
+
+  void setOutputWrittenCallback(std::function<void()> callback) override {
+    connection_->setOutputWrittenCallback(std::move(callback));
+  }
+
+  /// The conditions of the emulated path, rather than of loopback.
+  TransportInfo transportInfo() const override;
+
+  bool supportsFrameChecksums() const override {
+    return connection_->supportsFrameChecksums();
+  }
+
+  void enableFrameChecksums() override {
+    connection_->enableFrameChecksums();
+  }
+
+  bool isFramed() const override {
+    return connection_->isFramed();
+  }
+
+ private:
+  class DelayLine;
+  class Input;
+
+  const std::unique_ptr<DuplexConnection> connection_;
+  folly::EventBase& eventBase_;
+  const Options options_;
+  std::unique_ptr<DelayLine> output_;
+};
+
+/// Wraps every connection made by another factory in an
+/// EmulatedDuplexConnection.  Each connection gets a seed of its own, derived
+/// from the one in the options.
+class EmulatedConnectionFactory : public ConnectionFactory {
+ public:
+  EmulatedConnectionFactory(
+      std::shared_ptr<ConnectionFactory> factory,
+      EmulatedDuplexConnection::Options options)
+      : factory_{std::move(factory)}, options_{std::move(options)} {}
+
+  folly::Future<ConnectedDuplexConnection> connect(
+      ProtocolVersion,
+      ResumeStatus) override;
+
+ private:
+  const std::shared_ptr<ConnectionFactory> factory_;
+  const EmulatedDuplexConnection::Options options_;
+  std::atomic<uint64_t> connections_{0};
+};
+
+} // namespace rsocket
@@ -0,0 +1,204 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/benchmarks/EmulatedNetwork.h"
+#include "rsocket/benchmarks/Fixture.h"
+#include "rsocket/benchmarks/LatencyHistogram.h"
+#include "rsocket/benchmarks/Throughput.h"
+
+#include <folly/Benchmark.h>
+#include <folly/portability/GFlags.h>
+#include <folly/synchronization/Baton.h>
+
+#include <chrono>
+
+#include "rsocket/RSocket.h"
+#include "yarpl/Flowable.h"
+#include "yarpl/Single.h"
+
+using namespace rsocket;
+
+DEFINE_int32(server_threads, 2, "number of server threads to run");
+DEFINE_int32(clients, 4, "number of clients to run");
+DEFINE_int32(items, 100000, "number of items in each stream");
+DEFINE_int32(payload_size, 32, "size of the payloads, in bytes");
+DEFINE_int32(round_trips, 200, "number of request-responses to time");
+DEFINE_int32(delay_ms, 20, "one-way delay of the emulated path");
+DEFINE_int32(jitter_ms, 2, "upper bound of the jitter added to each buffer");
+DEFINE_int32(
+    bandwidth_mbps,
+    100,
+    "bandwidth of each direction of the emulated path, unlimited if 0");
+DEFINE_double(loss, 0, "probability of a buffer being retransmitted");
+DEFINE_int32(retransmit_ms, 200, "delay of a retransmitted buffer");
+DEFINE_int64(seed, 1, "seed of the jitter and of the losses");
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/// Streams back `count` copies of a message, and answers requests with it.
+class CountedResponder : public RSocketResponder {
+ public:
+  CountedResponder(const std::string& message, size_t count)
+      : message_{folly::IOBuf::copyBuffer(message)}, count_{count} {}
+
+  std::shared_ptr<yarpl::flowable::Flowable<Payload>> handleRequestStream(
+      Payload,
+      StreamId) override {
+    return yarpl::flowable::Flowable<Payload>::fromGenerator(
+               [msg = message_->clone()] { return Payload(msg->clone()); })
+        ->take(count_);
+  }
+
+  std::shared_ptr<yarpl::single::Single<Payload>> handleRequestResponse(
+      Payload,
+      StreamId) override {
+    return yarpl::single::Singles::fromGenerator<Payload>(
+        [msg = message_->clone()] { return Payload(msg->clone()); });
+  }
+
+ private:
+  const std::unique_ptr<folly::IOBuf> message_;
+  const size_t count_;
+};
+
+EmulatedDuplexConnection::Options networkFromFlags() {
+  EmulatedDuplexConnection::Options network;
+  network.delay = std::chrono::milliseconds{FLAGS_delay_ms};
+  network.jitter = std::chrono::milliseconds{FLAGS_jitter_ms};
+  network.bandwidth = static_cast<size_t>(FLAGS_bandwidth_mbps) * 1000000 / 8;
+  network.lossRate = FLAGS_loss;
+  network.retransmitTimeout = std::chrono::milliseconds{FLAGS_retransmit_ms};
+  network.seed = static_cast<uint64_t>(FLAGS_seed);
+  return network;
+}
+
+std::unique_ptr<Fixture> makeFixture(size_t clients) {
+  Fixture::Options opts;
+  opts.serverThreads = FLAGS_server_threads;
+  opts.clients = clients;
+  opts.network = networkFromFlags();
+
+  LOG(INFO) << "Running:";
+  LOG(INFO) << "  Server with " << opts.serverThreads << " threads.";
+  LOG(INFO) << "  " << opts.clients << " clients, over a path of "
+            << FLAGS_delay_ms << "ms (+" << FLAGS_jitter_ms
+            << "ms jitter) each way, " << FLAGS_bandwidth_mbps
+            << "Mbps, with " << FLAGS_loss * 100 << "% loss.";
+
+  return std::make_unique<Fixture>(
+      opts,
+      std::make_shared<CountedResponder>(
+          std::string(FLAGS_payload_size, 'a'), FLAGS_items));
+}
+
+/// Sends one request-response at a time, each as soon as the response to the
+/// previous one arrives, and times every round trip.
+class RoundTrips {
+ public:
+  RoundTrips(RSocketRequester& requester, size_t count)
+      : requester_(requester), remaining_(count) {}
+
+  void next() {
+    if (remaining_-- == 0) {
+      done_.post();
+      return;
+    }
+    start_ = Clock::now();
+    requester_.requestResponse(Payload("EmulatedNetworkTcp"))
+        ->subscribe(
+            [this](Payload) {
+              histogram_.record(Clock::now() - start_);
+              next();
+            },
+            [this](folly::exception_wrapper ew) {
+              LOG(ERROR) << "Request failed: " << ew.what();
+              done_.post();
+            });
+  }
+
+  const LatencyHistogram& wait() {
+    done_.wait();
+    return histogram_;
+  }
+
+ private:
+  RSocketRequester& requester_;
+  size_t remaining_;
+  Clock::time_point start_;
+  LatencyHistogram histogram_;
+  folly::Baton<> done_;
+};
+
+} // namespace
+
+/// Throughput of streams asking for `batch` items at a time, so that the
+/// REQUEST_N round trips show.
+void streamThroughput(size_t n, size_t batch) {
+  (void)n;
+
+  Latch latch{static_cast<size_t>(FLAGS_clients)};
+  std::unique_ptr<Fixture> fixture;
+
+  BENCHMARK_SUSPEND {
+    fixture = makeFixture(FLAGS_clients);
+    LOG(INFO) << "  Running a stream of " << FLAGS_items << " items of "
+              << FLAGS_payload_size << " bytes per client, asked for "
+              << batch << " at a time.";
+  }
+
+  for (auto& client : fixture->clients) {
+    client->getRequester()
+        ->requestStream(Payload("EmulatedNetworkTcp"))
+        ->subscribe(std::make_shared<BatchingSubscriber>(latch, batch));
+  }
+
+  constexpr std::chrono::minutes timeout{5};
+  if (!latch.timed_wait(timeout)) {
+    LOG(ERROR) << "Timed out!";
+  }
+
+  BENCHMARK_SUSPEND {
+    fixture.reset();
+  }
+}
+
+BENCHMARK_NAMED_PARAM(streamThroughput, batch16, 16)
+BENCHMARK_NAMED_PARAM(streamThroughput, batch256, 256)
+BENCHMARK_NAMED_PARAM(streamThroughput, batch4096, 4096)
+
+BENCHMARK(RequestResponseLatency, n) {
+  (void)n;
+
+  std::unique_ptr<Fixture> fixture;
+  BENCHMARK_SUSPEND {
+    fixture = makeFixture(1);
+  }
+
+  RoundTrips trips(
+      *fixture->clients.front()->getRequester(), FLAGS_round_trips);
+  trips.next();
+  auto const& histogram = trips.wait();
+
+  BENCHMARK_SUSPEND {
+    auto const us = [](std::chrono::nanoseconds latency) {
+      return std::chrono::duration<double, std::micro>(latency).count();
+    };
+    LOG(INFO) << "Round trips: p50 " << us(histogram.percentile(0.5))
+              << "us, p99 " << us(histogram.percentile(0.99)) << "us, max "
+              << us(histogram.max()) << "us";
+    fixture.reset();
+  }
+}
@@ -18,6 +18,9 @@
 #include <folly/Benchmark.h>
 #include <folly/portability/GFlags.h>
 
+#include <algorithm>
+#include <vector>
+
 #include "rsocket/RSocket.h"
 
 using namespace rsocket;
@@ -29,6 +32,7 @@ DEFINE_int32(
     "control the number of client threads (defaults to the number of clients)");
 DEFINE_int32(clients, 10, "number of clients to run");
 DEFINE_int32(items, 1000000, "number of items to fire-and-forget, in total");
+DEFINE_int32(batch_size, 64, "number of items per fireAndForgetBatch() call");
 
 namespace {
 
@@ -43,6 +47,33 @@ class Responder : public RSocketResponder {
  private:
   Latch& latch_;
 };
+
+std::unique_ptr<Fixture> makeFixture(Fixture::Options& opts, Latch& latch) {
+  auto responder = std::make_shared<Responder>(latch);
+
+  opts.serverThreads = FLAGS_server_threads;
+  opts.clients = FLAGS_clients;
+  if (FLAGS_override_client_threads > 0) {
+    opts.clientThreads = FLAGS_override_client_threads;
+  }
+
+  auto fixture = std::make_unique<Fixture>(opts, std::move(responder));
+
+  LOG(INFO) << "Running:";
+  LOG(INFO) << "  Server with " << opts.serverThreads << " threads.";
+  LOG(INFO) << "  " << opts.clients << " clients across "
+            << fixture->workers.size() << " threads.";
+  LOG(INFO) << "  Running " << FLAGS_items << " requests in total.";
+  return fixture;
+}
+
+void waitFor(Latch& latch) {
+  constexpr std::chrono::minutes timeout{5};
+  if (!latch.timed_wait(timeout)) {
+    LOG(ERROR) << "Timed out!";
+  }
+}
+
 } // namespace
 
 BENCHMARK(FireForgetThroughput, n) {
@@ -54,21 +85,7 @@ BENCHMARK(FireForgetThroughput, n) {
   Fixture::Options opts;
 
   BENCHMARK_SUSPEND {
-    auto responder = std::make_shared<Responder>(latch);
-
-    opts.serverThreads = FLAGS_server_threads;
-    opts.clients = FLAGS_clients;
-    if (FLAGS_override_client_threads > 0) {
-      opts.clientThreads = FLAGS_override_client_threads;
-    }
-
-    fixture = std::make_unique<Fixture>(opts, std::move(responder));
-
-    LOG(INFO) << "Running:";
-    LOG(INFO) << "  Server with " << opts.serverThreads << " threads.";
-    LOG(INFO) << "  " << opts.clients << " clients across "
-              << fixture->workers.size() << " threads.";
-    LOG(INFO) << "  Running " << FLAGS_items << " requests in total.";
+    fixture = makeFixture(opts, latch);
   }
 
   for (int i = 0; i < FLAGS_items; ++i) {
@@ -80,8 +97,34 @@ BENCHMARK(FireForgetThroughput, n) {
     }
   }
 
-  constexpr std::chrono::minutes timeout{5};
-  if (!latch.timed_wait(timeout)) {
-    LOG(ERROR) << "Timed out!";
+  waitFor(latch);
+}
+
+BENCHMARK_RELATIVE(FireForgetBatchThroughput, n) {
+  (void)n;
+
+  Latch latch{static_cast<size_t>(FLAGS_items)};
+
+  std::unique_ptr<Fixture> fixture;
+  Fixture::Options opts;
+
+  BENCHMARK_SUSPEND {
+    fixture = makeFixture(opts, latch);
   }
+
+  auto const batchSize = std::max(FLAGS_batch_size, 1);
+  for (int i = 0; i < FLAGS_items; i += batchSize) {
+    auto const count = std::min(batchSize, FLAGS_items - i);
+    for (auto& client : fixture->clients) {
+      std::vector<Payload> batch;
+      batch.reserve(count);
+      for (int j = 0; j < count; ++j) {
+        batch.emplace_back("TcpFireAndForget");
+      }
+      client->getRequester()->fireAndForgetBatch(std::move(batch));
+    }
+  }
+
+  waitFor(latch);
 }
+
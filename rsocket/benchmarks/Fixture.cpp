@@ -15,6 +15,8 @@
 #include "rsocket/benchmarks/Fixture.h"
 
 #include "rsocket/RSocket.h"
+#include "rsocket/internal/ThreadAffinity.h"
+#include "rsocket/internal/WarmResumeManager.h"
 #include "rsocket/transports/tcp/TcpConnectionAcceptor.h"
 #include "rsocket/transports/tcp/TcpConnectionFactory.h"
 
@@ -24,10 +26,38 @@ namespace {
 
 std::shared_ptr<RSocketClient> makeClient(
     folly::EventBase* eventBase,
-    folly::SocketAddress address) {
-  auto factory =
-      std::make_unique<TcpConnectionFactory>(*eventBase, std::move(address));
-  return RSocket::createConnectedClient(std::move(factory)).get();
+    folly::SocketAddress address,
+    const Fixture::Options& options) {
+  auto const tls = options.serverSslContext && options.clientSslContext;
+  TcpDuplexConnection::Options connectionOptions;
+  connectionOptions.kernelTls = tls && options.kernelTls;
+  auto const stats =
+      options.clientStats ? options.clientStats : RSocketStats::noop();
+  std::shared_ptr<ConnectionFactory> factory =
+      std::make_shared<TcpConnectionFactory>(
+          *eventBase,
+          std::move(address),
+          tls ? options.clientSslContext : nullptr,
+          std::move(connectionOptions),
+          stats);
+  if (options.network) {
+    factory = std::make_shared<EmulatedConnectionFactory>(
+        std::move(factory), *options.network);
+  }
+  auto const resumable = options.resumable;
+  SetupParameters params;
+  params.resumable = resumable;
+  return RSocket::createConnectedClient(
+             std::move(factory),
+             std::move(params),
+             std::make_shared<RSocketResponder>(),
+             kDefaultKeepaliveInterval,
+             stats,
+             nullptr /* connectionEvents */,
+             resumable
+                 ? std::make_shared<WarmResumeManager>(RSocketStats::noop())
+                 : ResumeManager::makeEmpty())
+      .get();
 }
 } // namespace
 
@@ -38,16 +68,29 @@ Fixture::Fixture(
   TcpConnectionAcceptor::Options opts;
   opts.address = folly::SocketAddress{"0.0.0.0", 0};
   opts.threads = options.serverThreads;
+  opts.cpuSets = options.serverCpuSets;
+  if (options.clientSslContext) {
+    opts.sslContext = options.serverSslContext;
+  }
 
   auto acceptor = std::make_unique<TcpConnectionAcceptor>(std::move(opts));
   server = std::make_unique<RSocketServer>(std::move(acceptor));
-  server->start([responder](const SetupParameters&) { return responder; });
+  if (options.resumeManagerFactory) {
+    server->setResumeManagerFactory(options.resumeManagerFactory);
+  }
+  server->start(RSocketServiceHandler::create(
+      [responder](const SetupParameters&) { return responder; },
+      options.resumable));
 
   auto const numWorkers =
       options.clientThreads ? *options.clientThreads : options.clients;
   for (size_t i = 0; i < numWorkers; ++i) {
     workers.push_back(std::make_unique<folly::ScopedEventBaseThread>(
         "rsocket-client-thread"));
+    if (i < options.clientCpuSets.size()) {
+      pinEventBaseThread(
+          *workers.back()->getEventBase(), options.clientCpuSets[i]);
+    }
   }
 
   const folly::SocketAddress actual{"127.0.0.1", *server->listeningPort()};
@@ -55,7 +98,8 @@ Fixture::Fixture(
   for (size_t i = 0; i < options.clients; ++i) {
     auto worker = std::move(workers.front());
     workers.pop_front();
-    clients.push_back(makeClient(worker->getEventBase(), actual));
+    clients.push_back(
+        makeClient(worker->getEventBase(), actual, options));
     workers.push_back(std::move(worker));
   }
 }
@@ -16,8 +16,10 @@
 
 #include "rsocket/RSocketClient.h"
 #include "rsocket/RSocketServer.h"
+#include "rsocket/benchmarks/EmulatedNetwork.h"
 
 #include <folly/Optional.h>
+#include <folly/io/async/SSLContext.h>
 #include <folly/io/async/ScopedEventBaseThread.h>
 
 #include <deque>
@@ -40,6 +42,37 @@ struct Fixture {
     /// Number of worker threads driving the clients.  A default value means to
     /// use one thread per client.
     folly::Optional<size_t> clientThreads;
+
+    /// Whether the clients ask for resumable connections, so that both sides
+    /// buffer the frames they send.  The server then resumes them through its
+    /// resume index.
+    bool resumable{false};
+
+    /// Creates the server's resume managers, if set.
+    RSocketServer::ResumeManagerFactory resumeManagerFactory;
+
+    /// Sets of CPUs to pin the server and client worker threads to, the i-th
+    /// thread to the i-th set.  Threads past the end of the lists aren't
+    /// pinned.  See cpuSetsAcrossNumaNodes() to spread them over the NUMA
+    /// nodes.
+    std::vector<std::vector<int>> serverCpuSets;
+    std::vector<std::vector<int>> clientCpuSets;
+
+    /// TLS contexts of the server and of the clients, see Tls.h.  The
+    /// connections are plaintext unless both are set.
+    std::shared_ptr<folly::SSLContext> serverSslContext;
+    std::shared_ptr<folly::SSLContext> clientSslContext;
+
+    /// Whether the clients ask for kTLS, see
+    /// TcpDuplexConnection::Options::kernelTls.
+    bool kernelTls{false};
+
+    /// Stats of the client connections, none if null.
+    std::shared_ptr<RSocketStats> clientStats;
+
+    /// Emulated WAN conditions between every client and the server, if set.
+    /// See EmulatedDuplexConnection.
+    folly::Optional<EmulatedDuplexConnection::Options> network;
   };
 
   Fixture(Options, std::shared_ptr<RSocketResponder>);
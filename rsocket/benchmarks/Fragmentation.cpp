@@ -0,0 +1,266 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <folly/Benchmark.h>
+#include <folly/Optional.h>
+#include <folly/memory/Malloc.h>
+#include <folly/memory/MallctlHelper.h>
+#include <folly/portability/GFlags.h>
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <tuple>
+
+#include "rsocket/RSocketStats.h"
+#include "rsocket/framing/FrameSerializer_v1_0.h"
+#include "rsocket/statemachine/StreamFragmentAccumulator.h"
+#include "rsocket/statemachine/StreamsWriter.h"
+
+using namespace rsocket;
+
+DEFINE_bool(
+    contiguous,
+    false,
+    "reassemble fragments into contiguous buffers rather than chaining them");
+
+/// Fragmentation and reassembly of large payloads, without a transport.
+///
+/// Payloads go through StreamsWriterImpl::writeFragmented(), the frames are
+/// serialized and parsed back, and a StreamFragmentAccumulator reassembles
+/// them as the receiving stream would.  Besides the time per payload, the
+/// first run of each configuration logs the bytes that were copied rather
+/// than shared with the original payload, and the peak heap growth (when
+/// running with jemalloc).
+
+namespace {
+
+constexpr StreamId kStreamId = 1;
+constexpr size_t KB = 1024;
+constexpr size_t MB = 1024 * KB;
+
+/// Bytes in use on the heap by this thread, or none if that can't be
+/// determined.
+folly::Optional<int64_t> threadHeapBytes() {
+  if (!folly::usingJEMalloc()) {
+    return folly::none;
+  }
+  try {
+    uint64_t allocated = 0;
+    uint64_t deallocated = 0;
+    folly::mallctlRead("thread.allocated", &allocated);
+    folly::mallctlRead("thread.deallocated", &deallocated);
+    return static_cast<int64_t>(allocated) - static_cast<int64_t>(deallocated);
+  } catch (const std::exception&) {
+    return folly::none;
+  }
+}
+
+/// Bytes of `chain` that don't point into the buffer of `original`.
+size_t copiedBytes(const folly::IOBuf& chain, const folly::IOBuf& original) {
+  size_t copied = 0;
+  for (const auto range : chain) {
+    if (range.begin() < original.data() || range.end() > original.tail()) {
+      copied += range.size();
+    }
+  }
+  return copied;
+}
+
+/// Writes payloads as the frames of a stream and parses them straight back,
+/// reassembling them like the other end of the connection would.
+class LoopbackWriter : public StreamsWriterImpl {
+ public:
+  LoopbackWriter(size_t mtu, const StreamFragmentAccumulator::Options& options)
+      : mtu_{mtu}, fragments_{options} {}
+
+  /// Sends `payload` as a request-response or as an item of a stream, and
+  /// returns it reassembled.
+  Payload roundTrip(StreamType type, Payload payload) {
+    if (type == StreamType::REQUEST_RESPONSE) {
+      writeNewStream(kStreamId, type, 0, std::move(payload));
+    } else {
+      writePayload(
+          Frame_PAYLOAD(kStreamId, FrameFlags::NEXT, std::move(payload)));
+    }
+    return std::move(received_);
+  }
+
+  /// Accounts the frames of payloads sharing the buffer of `original`.
+  void track(const folly::IOBuf* original, folly::Optional<int64_t> heapBase) {
+    original_ = original;
+    heapBase_ = heapBase;
+  }
+
+  size_t frames{0};
+  size_t copiedIntoFrames{0};
+  int64_t peakHeapGrowth{0};
+
+  void onStreamClosed(StreamId) override {}
+
+  std::shared_ptr<yarpl::flowable::Subscriber<Payload>> onNewStreamReady(
+      StreamId,
+      StreamType,
+      Payload,
+      std::shared_ptr<yarpl::flowable::Subscriber<Payload>>) override {
+    return nullptr;
+  }
+
+  void onNewStreamReady(
+      StreamId,
+      StreamType,
+      Payload,
+      std::shared_ptr<yarpl::single::SingleObserver<Payload>>) override {}
+
+ protected:
+  void outputFrame(std::unique_ptr<folly::IOBuf> frame) override {
+    ++frames;
+    if (original_) {
+      copiedIntoFrames += copiedBytes(*frame, *original_);
+    }
+
+    Payload payload;
+    bool follows = false;
+    if (serializer_.peekFrameType(*frame) == FrameType::REQUEST_RESPONSE) {
+      Frame_REQUEST_RESPONSE request;
+      CHECK(serializer_.deserializeFrom(request, std::move(frame)));
+      payload = std::move(request.payload_);
+      follows = request.header_.flagsFollows();
+    } else {
+      Frame_PAYLOAD response;
+      CHECK(serializer_.deserializeFrom(response, std::move(frame)));
+      payload = std::move(response.payload_);
+      follows = response.header_.flagsFollows();
+    }
+
+    fragments_.addPayloadIgnoreFlags(std::move(payload));
+    if (!follows) {
+      received_ = fragments_.consumePayloadIgnoreFlags();
+    }
+
+    if (heapBase_) {
+      if (auto const heap = threadHeapBytes()) {
+        peakHeapGrowth = std::max(peakHeapGrowth, *heap - *heapBase_);
+      }
+    }
+  }
+
+  const FrameSerializer& serializer() override {
+    return serializer_;
+  }
+
+  RSocketStats& stats() override {
+    return *stats_;
+  }
+
+  bool shouldQueue() override {
+    return false;
+  }
+
+  size_t maxFragmentSize() const override {
+    return mtu_ ? mtu_ : StreamsWriterImpl::maxFragmentSize();
+  }
+
+ private:
+  const size_t mtu_;
+  StreamFragmentAccumulator fragments_;
+  FrameSerializerV1_0 serializer_;
+  std::shared_ptr<RSocketStats> stats_ = RSocketStats::noop();
+  Payload received_;
+
+  const folly::IOBuf* original_{nullptr};
+  folly::Optional<int64_t> heapBase_;
+};
+
+/// Logs the copies and memory use of one payload, the first time a
+/// configuration runs.
+void reportOnce(StreamType type, size_t payloadSize, size_t mtu) {
+  static std::set<std::tuple<StreamType, size_t, size_t>> reported;
+  if (!reported.emplace(type, payloadSize, mtu).second) {
+    return;
+  }
+
+  StreamFragmentAccumulator::Options options;
+  options.contiguous = FLAGS_contiguous;
+  LoopbackWriter writer{mtu, options};
+
+  auto const original = folly::IOBuf::create(payloadSize);
+  original->append(payloadSize);
+  writer.track(original.get(), threadHeapBytes());
+
+  auto received = writer.roundTrip(type, Payload(original->clone()));
+  CHECK_EQ(payloadSize, received.data->computeChainDataLength());
+
+  auto const mtuName = mtu ? std::to_string(mtu / KB) + "KB" : "default";
+  LOG(INFO) << toString(type) << " of " << payloadSize / KB << "KB, MTU "
+            << mtuName << ": " << writer.frames << " frames, "
+            << writer.copiedIntoFrames << " bytes copied into frames, "
+            << copiedBytes(*received.data, *original)
+            << " bytes copied by reassembly, peak heap growth "
+            << (threadHeapBytes() ? std::to_string(writer.peakHeapGrowth)
+                                  : std::string("unknown"))
+            << " bytes";
+}
+
+void roundTrips(size_t n, StreamType type, size_t payloadSize, size_t mtu) {
+  folly::BenchmarkSuspender suspender;
+  reportOnce(type, payloadSize, mtu);
+
+  StreamFragmentAccumulator::Options options;
+  options.contiguous = FLAGS_contiguous;
+  LoopbackWriter writer{mtu, options};
+
+  auto const original = folly::IOBuf::create(payloadSize);
+  original->append(payloadSize);
+  suspender.dismiss();
+
+  for (size_t i = 0; i < n; ++i) {
+    folly::doNotOptimizeAway(
+        writer.roundTrip(type, Payload(original->clone())));
+  }
+}
+
+void requestResponse(size_t n, size_t payloadSize, size_t mtu) {
+  roundTrips(n, StreamType::REQUEST_RESPONSE, payloadSize, mtu);
+}
+
+void stream(size_t n, size_t payloadSize, size_t mtu) {
+  roundTrips(n, StreamType::STREAM, payloadSize, mtu);
+}
+
+} // namespace
+
+BENCHMARK_NAMED_PARAM(requestResponse, 1KB_mtu16KB, 1 * KB, 16 * KB)
+BENCHMARK_NAMED_PARAM(requestResponse, 64KB_mtu16KB, 64 * KB, 16 * KB)
+BENCHMARK_NAMED_PARAM(requestResponse, 1MB_mtu16KB, 1 * MB, 16 * KB)
+BENCHMARK_NAMED_PARAM(requestResponse, 16MB_mtu16KB, 16 * MB, 16 * KB)
+BENCHMARK_NAMED_PARAM(requestResponse, 64MB_mtu16KB, 64 * MB, 16 * KB)
+BENCHMARK_NAMED_PARAM(requestResponse, 1MB_mtu1MB, 1 * MB, 1 * MB)
+BENCHMARK_NAMED_PARAM(requestResponse, 16MB_mtu1MB, 16 * MB, 1 * MB)
+BENCHMARK_NAMED_PARAM(requestResponse, 64MB_mtu1MB, 64 * MB, 1 * MB)
+BENCHMARK_NAMED_PARAM(requestResponse, 16MB_mtuDefault, 16 * MB, 0)
+BENCHMARK_NAMED_PARAM(requestResponse, 64MB_mtuDefault, 64 * MB, 0)
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK_NAMED_PARAM(stream, 1KB_mtu16KB, 1 * KB, 16 * KB)
+BENCHMARK_NAMED_PARAM(stream, 64KB_mtu16KB, 64 * KB, 16 * KB)
+BENCHMARK_NAMED_PARAM(stream, 1MB_mtu16KB, 1 * MB, 16 * KB)
+BENCHMARK_NAMED_PARAM(stream, 16MB_mtu16KB, 16 * MB, 16 * KB)
+BENCHMARK_NAMED_PARAM(stream, 64MB_mtu16KB, 64 * MB, 16 * KB)
+BENCHMARK_NAMED_PARAM(stream, 1MB_mtu1MB, 1 * MB, 1 * MB)
+BENCHMARK_NAMED_PARAM(stream, 16MB_mtu1MB, 16 * MB, 1 * MB)
+BENCHMARK_NAMED_PARAM(stream, 64MB_mtu1MB, 64 * MB, 1 * MB)
+BENCHMARK_NAMED_PARAM(stream, 16MB_mtuDefault, 16 * MB, 0)
+BENCHMARK_NAMED_PARAM(stream, 64MB_mtuDefault, 64 * MB, 0)
@@ -0,0 +1,136 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <folly/Benchmark.h>
+
+#include <stdexcept>
+
+#include "rsocket/framing/FrameSerializer_v1_0.h"
+
+using namespace rsocket;
+
+constexpr size_t kMessageLen = 32;
+
+namespace {
+
+std::unique_ptr<FrameSerializer> makeSerializer() {
+  return FrameSerializer::createFrameSerializer(ProtocolVersion::Latest);
+}
+
+Payload makePayload() {
+  return Payload(std::string(kMessageLen, 'a'), std::string(kMessageLen, 'b'));
+}
+
+Frame_PAYLOAD makePayloadFrame(StreamId streamId) {
+  return Frame_PAYLOAD(streamId, FrameFlags::NEXT, makePayload());
+}
+
+/// The check every frame constructor used to run on the frames we send,
+/// kept to measure the encode path against.
+FOLLY_NOINLINE void checkFlags(const Payload& payload, FrameFlags flags) {
+  if (bool(payload.metadata) != bool(flags & FrameFlags::METADATA)) {
+    throw std::invalid_argument{
+        "Value of METADATA flag doesn't match payload metadata"};
+  }
+}
+
+} // namespace
+
+BENCHMARK(SerializePayload_Virtual, n) {
+  auto serializer = makeSerializer();
+  for (size_t i = 0; i < n; ++i) {
+    folly::BenchmarkSuspender suspender;
+    auto frame = makePayloadFrame(static_cast<StreamId>(i | 1));
+    suspender.dismiss();
+
+    folly::doNotOptimizeAway(serializer->serializeOut(std::move(frame)));
+  }
+}
+
+BENCHMARK_RELATIVE(SerializePayload_Devirtualized, n) {
+  auto serializer = makeSerializer();
+  for (size_t i = 0; i < n; ++i) {
+    folly::BenchmarkSuspender suspender;
+    auto frame = makePayloadFrame(static_cast<StreamId>(i | 1));
+    suspender.dismiss();
+
+    folly::doNotOptimizeAway(
+        visitFrameSerializer(*serializer, [&](const auto& s) {
+          return s.serializeOut(std::move(frame));
+        }));
+  }
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(PeekFrameHeader_Virtual, n) {
+  folly::BenchmarkSuspender suspender;
+  auto serializer = makeSerializer();
+  auto buf = serializer->serializeOut(makePayloadFrame(1));
+  suspender.dismiss();
+
+  for (size_t i = 0; i < n; ++i) {
+    folly::doNotOptimizeAway(serializer->peekFrameType(*buf));
+    folly::doNotOptimizeAway(serializer->peekStreamId(*buf, false));
+  }
+}
+
+BENCHMARK_RELATIVE(PeekFrameHeader_Devirtualized, n) {
+  folly::BenchmarkSuspender suspender;
+  auto serializer = makeSerializer();
+  auto buf = serializer->serializeOut(makePayloadFrame(1));
+  suspender.dismiss();
+
+  for (size_t i = 0; i < n; ++i) {
+    visitFrameSerializer(*serializer, [&](const auto& s) {
+      folly::doNotOptimizeAway(s.peekFrameType(*buf));
+      folly::doNotOptimizeAway(s.peekStreamId(*buf, false));
+    });
+  }
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(BuildAndSerializePayload_Checked, n) {
+  auto serializer = makeSerializer();
+  for (size_t i = 0; i < n; ++i) {
+    folly::BenchmarkSuspender suspender;
+    auto payload = makePayload();
+    suspender.dismiss();
+
+    Frame_PAYLOAD frame(
+        static_cast<StreamId>(i | 1), FrameFlags::NEXT, std::move(payload));
+    checkFlags(frame.payload_, frame.header_.flags);
+    folly::doNotOptimizeAway(
+        visitFrameSerializer(*serializer, [&](const auto& s) {
+          return s.serializeOut(std::move(frame));
+        }));
+  }
+}
+
+BENCHMARK_RELATIVE(BuildAndSerializePayload_Trusted, n) {
+  auto serializer = makeSerializer();
+  for (size_t i = 0; i < n; ++i) {
+    folly::BenchmarkSuspender suspender;
+    auto payload = makePayload();
+    suspender.dismiss();
+
+    Frame_PAYLOAD frame(
+        static_cast<StreamId>(i | 1), FrameFlags::NEXT, std::move(payload));
+    folly::doNotOptimizeAway(
+        visitFrameSerializer(*serializer, [&](const auto& s) {
+          return s.serializeOut(std::move(frame));
+        }));
+  }
+}
@@ -0,0 +1,89 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <folly/memory/Malloc.h>
+#include <folly/memory/MallctlHelper.h>
+
+#include <vector>
+
+#include "rsocket/RSocket.h"
+#include "rsocket/transports/inprocess/InProcessConnectionAcceptor.h"
+#include "rsocket/transports/inprocess/InProcessConnectionFactory.h"
+
+namespace rsocket {
+
+/// Number of allocations made by the process so far, or none if that can't be
+/// determined.  IOBuf allocates with malloc() rather than operator new, so
+/// this asks jemalloc instead of counting in a global operator new.
+inline folly::Optional<uint64_t> allocationCount() {
+  if (!folly::usingJEMalloc()) {
+    return folly::none;
+  }
+  try {
+    uint64_t epoch = 1;
+    folly::mallctlWrite("epoch", epoch);
+
+    uint64_t small = 0;
+    uint64_t large = 0;
+    folly::mallctlRead("stats.arenas.4096.small.nmalloc", &small);
+    folly::mallctlRead("stats.arenas.4096.large.nmalloc", &large);
+    return small + large;
+  } catch (const std::exception& exn) {
+    LOG(WARNING) << "Cannot read allocation stats: " << exn.what();
+    return folly::none;
+  }
+}
+
+/// A server and clients connected to it through an in-process transport, so
+/// that the benchmark measures the overhead of the state machines alone.
+///
+/// The server runs on one thread, and the clients share another.
+struct InProcessFixture {
+  explicit InProcessFixture(
+      std::shared_ptr<RSocketResponder> responder,
+      size_t numClients = 1) {
+    auto acceptor = std::make_unique<InProcessConnectionAcceptor>(
+        *serverWorker.getEventBase());
+    // Owned by the server from here on.
+    auto const& endpoint = *acceptor;
+
+    server = std::make_unique<RSocketServer>(std::move(acceptor));
+    server->start([responder](const SetupParameters&) { return responder; });
+
+    for (size_t i = 0; i < numClients; ++i) {
+      auto factory = std::make_unique<InProcessConnectionFactory>(
+          *clientWorker.getEventBase(), endpoint);
+      clients.push_back(
+          RSocket::createConnectedClient(std::move(factory)).get());
+    }
+  }
+
+  ~InProcessFixture() {
+    // Close the connections on their own thread, before the server goes.
+    clientWorker.getEventBase()->runInEventBaseThreadAndWait(
+        [c = std::move(clients)] {});
+    server.reset();
+  }
+
+  folly::ScopedEventBaseThread serverWorker;
+  folly::ScopedEventBaseThread clientWorker;
+  std::unique_ptr<RSocketServer> server;
+  std::vector<std::shared_ptr<RSocketClient>> clients;
+};
+
+} // namespace rsocket
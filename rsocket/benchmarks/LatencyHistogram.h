@@ -0,0 +1,108 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Bits.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace rsocket {
+
+/// HDR-style histogram of latencies, in nanoseconds.
+///
+/// Values below kSubBuckets have a bucket each, then every power of two is
+/// split into kSubBuckets / 2 linear steps, so a value is placed within 1/64
+/// of itself at any magnitude.  Not thread-safe: keep one per thread and
+/// merge() them once the run is over.
+class LatencyHistogram {
+ public:
+  static constexpr size_t kSubBucketBits = 7;
+  static constexpr size_t kSubBuckets = size_t(1) << kSubBucketBits;
+  static constexpr size_t kHalf = kSubBuckets / 2;
+  static constexpr size_t kBuckets = (64 - kSubBucketBits + 2) * kHalf;
+
+  LatencyHistogram() : counts_(kBuckets) {}
+
+  void record(std::chrono::nanoseconds latency) {
+    auto const value = static_cast<uint64_t>(
+        std::max<std::chrono::nanoseconds::rep>(latency.count(), 0));
+    ++counts_[bucketOf(value)];
+    ++count_;
+    max_ = std::max(max_, value);
+  }
+
+  void merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < kBuckets; ++i) {
+      counts_[i] += other.counts_[i];
+    }
+    count_ += other.count_;
+    max_ = std::max(max_, other.max_);
+  }
+
+  uint64_t count() const {
+    return count_;
+  }
+
+  /// A latency that `fraction` of the recorded ones are at most, rounded up
+  /// to the bound of its bucket.  Zero if nothing was recorded.
+  std::chrono::nanoseconds percentile(double fraction) const {
+    if (count_ == 0) {
+      return std::chrono::nanoseconds{0};
+    }
+    auto const rank = std::max<uint64_t>(
+        1, static_cast<uint64_t>(std::ceil(fraction * count_)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; ++i) {
+      seen += counts_[i];
+      if (seen >= rank) {
+        return std::chrono::nanoseconds{std::min(upperBoundOf(i), max_)};
+      }
+    }
+    return max();
+  }
+
+  std::chrono::nanoseconds max() const {
+    return std::chrono::nanoseconds{max_};
+  }
+
+  static size_t bucketOf(uint64_t value) {
+    if (value < kSubBuckets) {
+      return value;
+    }
+    // Shift that leaves kSubBucketBits significant bits, at least 1.
+    size_t const shift = folly::findLastSet(value) - kSubBucketBits;
+    return shift * kHalf + (value >> shift);
+  }
+
+  static uint64_t upperBoundOf(size_t bucket) {
+    if (bucket < kSubBuckets) {
+      return bucket;
+    }
+    size_t const shift = (bucket - kSubBuckets) / kHalf + 1;
+    uint64_t const step = (bucket - kSubBuckets) % kHalf + kHalf;
+    return (step << shift) + ((uint64_t(1) << shift) - 1);
+  }
+
+ private:
+  std::vector<uint64_t> counts_;
+  uint64_t count_{0};
+  uint64_t max_{0};
+};
+
+} // namespace rsocket
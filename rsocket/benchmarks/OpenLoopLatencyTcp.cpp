@@ -0,0 +1,307 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/benchmarks/Fixture.h"
+#include "rsocket/benchmarks/LatencyHistogram.h"
+#include "rsocket/benchmarks/Latch.h"
+#include "rsocket/benchmarks/Throughput.h"
+
+#include <folly/Benchmark.h>
+#include <folly/io/Cursor.h>
+#include <folly/portability/GFlags.h>
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "rsocket/RSocket.h"
+#include "yarpl/Single.h"
+
+using namespace rsocket;
+
+constexpr size_t kMessageLen = 32;
+
+DEFINE_int32(server_threads, 8, "number of server threads to run");
+DEFINE_int32(
+    override_client_threads,
+    0,
+    "control the number of client threads (defaults to the number of clients)");
+DEFINE_int32(clients, 10, "number of clients to run");
+DEFINE_int32(items, 100000, "number of requests to send, in total");
+DEFINE_int32(rate, 20000, "requests per second to send, across all clients");
+DEFINE_int32(stream_items, 10, "number of items each stream asks for");
+
+/// Open-loop latency benchmarks.
+///
+/// Requests are sent on a fixed schedule, whether or not earlier ones have
+/// completed, and each latency is measured from the time its request was due
+/// to be sent rather than the time it actually was.  A stall then shows up in
+/// the latency of every request held up behind it, instead of also holding
+/// back the requests that would have measured it (coordinated omission).
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/// One histogram per client, each only touched on the thread of its client.
+using Histograms = std::vector<LatencyHistogram>;
+
+std::unique_ptr<Fixture> makeFixture(
+    Fixture::Options& opts,
+    std::shared_ptr<RSocketResponder> responder) {
+  opts.serverThreads = FLAGS_server_threads;
+  opts.clients = FLAGS_clients;
+  if (FLAGS_override_client_threads > 0) {
+    opts.clientThreads = FLAGS_override_client_threads;
+  }
+
+  auto fixture = std::make_unique<Fixture>(opts, std::move(responder));
+
+  LOG(INFO) << "Running:";
+  LOG(INFO) << "  Server with " << opts.serverThreads << " threads.";
+  LOG(INFO) << "  " << opts.clients << " clients across "
+            << fixture->workers.size() << " threads.";
+  LOG(INFO) << "  Sending " << FLAGS_items << " requests in total, at "
+            << FLAGS_rate << " requests/s.";
+  return fixture;
+}
+
+/// Calls `send(i, due)` for every request on the calling thread, at the time
+/// `due` each of them is scheduled for.  Requests that fall behind schedule
+/// are sent right away, still with their original due time.
+template <typename Send>
+void sendOnSchedule(Send&& send) {
+  auto const interval = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(1.0 / FLAGS_rate));
+  auto const start = Clock::now();
+  for (int i = 0; i < FLAGS_items; ++i) {
+    auto const due = start + i * interval;
+    std::this_thread::sleep_until(due);
+    send(i, due);
+  }
+}
+
+void waitFor(Latch& latch) {
+  constexpr std::chrono::minutes timeout{5};
+  if (!latch.timed_wait(timeout)) {
+    LOG(ERROR) << "Timed out!";
+  }
+}
+
+void report(const char* model, const LatencyHistogram& histogram) {
+  auto const us = [](std::chrono::nanoseconds latency) {
+    return std::chrono::duration<double, std::micro>(latency).count();
+  };
+  LOG(INFO) << model << " latency over " << histogram.count()
+            << " requests: p50 " << us(histogram.percentile(0.5))
+            << "us, p99 " << us(histogram.percentile(0.99)) << "us, p99.9 "
+            << us(histogram.percentile(0.999)) << "us, max "
+            << us(histogram.max()) << "us";
+}
+
+void report(const char* model, const Histograms& histograms) {
+  LatencyHistogram total;
+  for (const auto& histogram : histograms) {
+    total.merge(histogram);
+  }
+  report(model, total);
+}
+
+class Observer : public yarpl::single::SingleObserverBase<Payload> {
+ public:
+  Observer(Latch& latch, LatencyHistogram& histogram, Clock::time_point due)
+      : latch_{latch}, histogram_{histogram}, due_{due} {}
+
+  void onSuccess(Payload) override {
+    histogram_.record(Clock::now() - due_);
+    latch_.post();
+    yarpl::single::SingleObserverBase<Payload>::onSuccess({});
+  }
+
+  void onError(folly::exception_wrapper) override {
+    latch_.post();
+    yarpl::single::SingleObserverBase<Payload>::onError({});
+  }
+
+ private:
+  Latch& latch_;
+  LatencyHistogram& histogram_;
+  Clock::time_point const due_;
+};
+
+/// Records the time until the last item of a bounded stream arrives.
+class StreamSubscriber : public yarpl::flowable::BaseSubscriber<Payload> {
+ public:
+  StreamSubscriber(
+      Latch& latch,
+      LatencyHistogram& histogram,
+      Clock::time_point due)
+      : latch_{latch}, histogram_{histogram}, due_{due} {}
+
+  void onSubscribeImpl() override {
+    this->request(FLAGS_stream_items);
+  }
+
+  void onNextImpl(Payload) override {}
+
+  void onCompleteImpl() override {
+    histogram_.record(Clock::now() - due_);
+    latch_.post();
+  }
+
+  void onErrorImpl(folly::exception_wrapper) override {
+    latch_.post();
+  }
+
+ private:
+  Latch& latch_;
+  LatencyHistogram& histogram_;
+  Clock::time_point const due_;
+};
+
+/// Records the time until a fire-and-forget reaches the server.  The due time
+/// travels in the payload, which works as both ends share the steady clock of
+/// this process.
+class FireForgetResponder : public RSocketResponder {
+ public:
+  explicit FireForgetResponder(Latch& latch) : latch_{latch} {}
+
+  void handleFireAndForget(Payload request, StreamId) override {
+    auto const now = Clock::now();
+    folly::io::Cursor cursor{request.data.get()};
+    auto const due =
+        Clock::time_point{Clock::duration{cursor.readBE<int64_t>()}};
+    {
+      // Held for a handful of instructions per request, which is noise next
+      // to the round trip through the sockets.
+      std::lock_guard<std::mutex> lock{mutex_};
+      histogram_.record(now - due);
+    }
+    latch_.post();
+  }
+
+  LatencyHistogram histogram() {
+    std::lock_guard<std::mutex> lock{mutex_};
+    return histogram_;
+  }
+
+ private:
+  Latch& latch_;
+  std::mutex mutex_;
+  LatencyHistogram histogram_;
+};
+
+Payload makeFireForget(Clock::time_point due) {
+  auto data = folly::IOBuf::create(sizeof(int64_t));
+  folly::io::Appender appender{data.get(), 0};
+  appender.writeBE<int64_t>(due.time_since_epoch().count());
+  return Payload(std::move(data));
+}
+
+} // namespace
+
+BENCHMARK(RequestResponseOpenLoopLatency, n) {
+  (void)n;
+
+  Latch latch{static_cast<size_t>(FLAGS_items)};
+
+  std::unique_ptr<Fixture> fixture;
+  Fixture::Options opts;
+  Histograms histograms;
+
+  BENCHMARK_SUSPEND {
+    fixture = makeFixture(
+        opts, std::make_shared<FixedResponder>(std::string(kMessageLen, 'a')));
+    histograms.resize(opts.clients);
+  }
+
+  sendOnSchedule([&](int i, Clock::time_point due) {
+    auto const index = i % opts.clients;
+    fixture->clients[index]
+        ->getRequester()
+        ->requestResponse(Payload("OpenLoopLatencyTcp"))
+        ->subscribe(
+            std::make_shared<Observer>(latch, histograms[index], due));
+  });
+
+  waitFor(latch);
+
+  BENCHMARK_SUSPEND {
+    fixture.reset();
+    report("RequestResponse", histograms);
+  }
+}
+
+BENCHMARK(StreamOpenLoopLatency, n) {
+  (void)n;
+
+  Latch latch{static_cast<size_t>(FLAGS_items)};
+
+  std::unique_ptr<Fixture> fixture;
+  Fixture::Options opts;
+  Histograms histograms;
+
+  BENCHMARK_SUSPEND {
+    fixture = makeFixture(
+        opts, std::make_shared<FixedResponder>(std::string(kMessageLen, 'a')));
+    histograms.resize(opts.clients);
+  }
+
+  sendOnSchedule([&](int i, Clock::time_point due) {
+    auto const index = i % opts.clients;
+    fixture->clients[index]
+        ->getRequester()
+        ->requestStream(Payload("OpenLoopLatencyTcp"))
+        ->take(FLAGS_stream_items)
+        ->subscribe(std::make_shared<StreamSubscriber>(
+            latch, histograms[index], due));
+  });
+
+  waitFor(latch);
+
+  BENCHMARK_SUSPEND {
+    fixture.reset();
+    report("Stream", histograms);
+  }
+}
+
+BENCHMARK(FireForgetOpenLoopLatency, n) {
+  (void)n;
+
+  Latch latch{static_cast<size_t>(FLAGS_items)};
+  auto responder = std::make_shared<FireForgetResponder>(latch);
+
+  std::unique_ptr<Fixture> fixture;
+  Fixture::Options opts;
+
+  BENCHMARK_SUSPEND {
+    fixture = makeFixture(opts, responder);
+  }
+
+  sendOnSchedule([&](int i, Clock::time_point due) {
+    fixture->clients[i % opts.clients]
+        ->getRequester()
+        ->fireAndForget(makeFireForget(due))
+        ->subscribe(
+            std::make_shared<yarpl::single::SingleObserverBase<void>>());
+  });
+
+  waitFor(latch);
+
+  BENCHMARK_SUSPEND {
+    fixture.reset();
+    report("FireForget", responder->histogram());
+  }
+}
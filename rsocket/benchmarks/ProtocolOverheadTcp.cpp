@@ -0,0 +1,442 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/benchmarks/Fixture.h"
+#include "rsocket/benchmarks/Latch.h"
+#include "rsocket/benchmarks/Throughput.h"
+
+#include <folly/Benchmark.h>
+#include <folly/Conv.h>
+#include <folly/String.h>
+#include <folly/io/async/AsyncServerSocket.h>
+#include <folly/io/async/AsyncSocket.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <folly/portability/GFlags.h>
+#include <folly/synchronization/Baton.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rsocket/RSocket.h"
+
+using namespace rsocket;
+
+DEFINE_string(
+    message_sizes,
+    "32,1024,16384",
+    "comma-separated payload sizes, in bytes");
+DEFINE_int32(messages, 200000, "number of stream items per payload size");
+DEFINE_int32(round_trips, 20000, "number of round trips per payload size");
+
+/// Runs the same workloads over a bare folly::AsyncSocket and over RSocket,
+/// back to back and with identical payloads, and reports what the protocol
+/// layer costs per message, in time and in bytes on the wire:
+///
+/// - stream: the server sends --messages payloads, after a one-byte request
+///   on the raw socket and a REQUEST_STREAM asking for all of them with
+///   RSocket,
+/// - round trip: the client sends a payload and waits for the server to send
+///   it back, --round_trips times in a row, as request-responses with
+///   RSocket.
+///
+/// Both sides run a server thread and a client thread in this process, so
+/// the difference is the framing, the state machines and the streams, not
+/// the event loop or the kernel.  The raw socket writes every message as it
+/// comes, while RSocket coalesces the frames written in a loop.
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+enum class Workload { Stream, RoundTrip };
+
+/// Stream items the raw server writes before waiting for the writes to
+/// complete.
+constexpr size_t kRawBatch = 1024;
+
+/// Counts the bytes RSocket clients read and write.
+class ByteCounter : public RSocketStats {
+ public:
+  void bytesWritten(size_t bytes) override {
+    bytes_.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  void bytesRead(size_t bytes) override {
+    bytes_.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  /// Bytes read and written since the previous call.
+  size_t take() {
+    return bytes_.exchange(0, std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<size_t> bytes_{0};
+};
+
+/// Server end of a raw connection.  Echoes back whatever it reads for round
+/// trips, and for a stream answers the request with `count` payloads, in
+/// batches so that the socket doesn't queue them all up.
+class RawServerConnection : public folly::AsyncReader::ReadCallback,
+                            public folly::AsyncWriter::WriteCallback {
+ public:
+  RawServerConnection(
+      folly::AsyncSocket::UniquePtr socket,
+      Workload workload,
+      const folly::IOBuf& payload,
+      size_t count)
+      : socket_{std::move(socket)},
+        workload_{workload},
+        payload_{payload.clone()},
+        remaining_{count} {
+    socket_->setReadCB(this);
+  }
+
+  void getReadBuffer(void** buffer, size_t* length) noexcept override {
+    *buffer = buffer_.data();
+    *length = buffer_.size();
+  }
+
+  void readDataAvailable(size_t length) noexcept override {
+    if (workload_ == Workload::RoundTrip) {
+      socket_->writeChain(
+          nullptr, folly::IOBuf::copyBuffer(buffer_.data(), length));
+    } else {
+      writeBatch();
+    }
+  }
+
+  void readEOF() noexcept override {
+    socket_->setReadCB(nullptr);
+  }
+
+  void readErr(const folly::AsyncSocketException& ex) noexcept override {
+    VLOG(2) << "Raw server read failed: " << ex.what();
+    socket_->setReadCB(nullptr);
+  }
+
+  void writeSuccess() noexcept override {
+    writeBatch();
+  }
+
+  void writeErr(size_t, const folly::AsyncSocketException& ex) noexcept
+      override {
+    VLOG(2) << "Raw server write failed: " << ex.what();
+  }
+
+ private:
+  void writeBatch() {
+    auto const batch = std::min(remaining_, kRawBatch);
+    remaining_ -= batch;
+    for (size_t i = 0; i < batch; ++i) {
+      // The last write of the batch asks for the next one.
+      socket_->writeChain(i + 1 == batch ? this : nullptr, payload_->clone());
+    }
+  }
+
+  folly::AsyncSocket::UniquePtr socket_;
+  const Workload workload_;
+  const std::unique_ptr<folly::IOBuf> payload_;
+  size_t remaining_;
+  std::vector<char> buffer_ = std::vector<char>(64 * 1024);
+};
+
+class RawServer : public folly::AsyncServerSocket::AcceptCallback {
+ public:
+  RawServer(Workload workload, const folly::IOBuf& payload, size_t count)
+      : workload_{workload}, payload_{payload.clone()}, count_{count} {
+    auto const evb = thread_.getEventBase();
+    evb->runInEventBaseThreadAndWait([&] {
+      socket_.reset(new folly::AsyncServerSocket(evb));
+      socket_->bind(folly::SocketAddress("127.0.0.1", 0));
+      socket_->addAcceptCallback(this, evb);
+      socket_->listen(16);
+      socket_->startAccepting();
+    });
+  }
+
+  ~RawServer() override {
+    thread_.getEventBase()->runInEventBaseThreadAndWait([&] {
+      socket_.reset();
+      connections_.clear();
+    });
+  }
+
+  folly::SocketAddress address() const {
+    return socket_->getAddress();
+  }
+
+  void connectionAccepted(
+      folly::NetworkSocket fd,
+      const folly::SocketAddress&) noexcept override {
+    connections_.push_back(std::make_unique<RawServerConnection>(
+        folly::AsyncSocket::UniquePtr(
+            new folly::AsyncSocket(thread_.getEventBase(), fd)),
+        workload_,
+        *payload_,
+        count_));
+  }
+
+  void acceptError(const std::exception& ex) noexcept override {
+    LOG(ERROR) << "Raw server accept failed: " << ex.what();
+  }
+
+ private:
+  const Workload workload_;
+  const std::unique_ptr<folly::IOBuf> payload_;
+  const size_t count_;
+
+  folly::ScopedEventBaseThread thread_{"raw-server"};
+  folly::AsyncServerSocket::UniquePtr socket_;
+  std::vector<std::unique_ptr<RawServerConnection>> connections_;
+};
+
+/// Client end of a raw connection, living on its own thread.
+class RawClient : public folly::AsyncSocket::ConnectCallback,
+                  public folly::AsyncReader::ReadCallback {
+ public:
+  RawClient(const folly::SocketAddress& address, const folly::IOBuf& payload)
+      : payload_{payload.clone()},
+        size_{payload.computeChainDataLength()} {
+    auto& evb = *thread_.getEventBase();
+    evb.runInEventBaseThread([this, &evb, address] {
+      socket_.reset(new folly::AsyncSocket(&evb));
+      socket_->connect(this, address);
+    });
+    connected_.wait();
+  }
+
+  ~RawClient() override {
+    thread_.getEventBase()->runInEventBaseThreadAndWait(
+        [&] { socket_.reset(); });
+  }
+
+  /// Runs the workload for `count` messages.  Returns how long it took, and
+  /// sets `bytes` to the bytes read and written.
+  Clock::duration run(Workload workload, size_t count, size_t& bytes) {
+    workload_ = workload;
+    count_ = count;
+    auto const start = Clock::now();
+    thread_.getEventBase()->runInEventBaseThread([this] {
+      socket_->setReadCB(this);
+      if (workload_ == Workload::RoundTrip) {
+        sendPayload();
+      } else {
+        bytes_ += 1;
+        socket_->writeChain(nullptr, folly::IOBuf::copyBuffer("s", 1));
+      }
+    });
+    done_.wait();
+    bytes = bytes_;
+    return Clock::now() - start;
+  }
+
+  void connectSuccess() noexcept override {
+    connected_.post();
+  }
+
+  void connectErr(const folly::AsyncSocketException& ex) noexcept override {
+    LOG(FATAL) << "Raw client failed to connect: " << ex.what();
+  }
+
+  void getReadBuffer(void** buffer, size_t* length) noexcept override {
+    *buffer = buffer_.data();
+    *length = buffer_.size();
+  }
+
+  void readDataAvailable(size_t length) noexcept override {
+    received_ += length;
+    bytes_ += length;
+    if (workload_ == Workload::Stream) {
+      if (received_ >= count_ * size_) {
+        finish();
+      }
+    } else if (received_ >= sent_ * size_) {
+      if (sent_ == count_) {
+        finish();
+      } else {
+        sendPayload();
+      }
+    }
+  }
+
+  void readEOF() noexcept override {
+    LOG(ERROR) << "Raw server closed the connection";
+    finish();
+  }
+
+  void readErr(const folly::AsyncSocketException& ex) noexcept override {
+    LOG(ERROR) << "Raw client read failed: " << ex.what();
+    finish();
+  }
+
+ private:
+  void sendPayload() {
+    ++sent_;
+    bytes_ += size_;
+    socket_->writeChain(nullptr, payload_->clone());
+  }
+
+  void finish() {
+    socket_->setReadCB(nullptr);
+    done_.post();
+  }
+
+  const std::unique_ptr<folly::IOBuf> payload_;
+  const size_t size_;
+
+  Workload workload_{Workload::Stream};
+  size_t count_{0};
+  size_t sent_{0};
+  size_t received_{0};
+  size_t bytes_{0};
+
+  folly::Baton<> connected_;
+  folly::Baton<> done_;
+  std::vector<char> buffer_ = std::vector<char>(64 * 1024);
+  folly::AsyncSocket::UniquePtr socket_;
+  folly::ScopedEventBaseThread thread_{"raw-client"};
+};
+
+struct Result {
+  Clock::duration elapsed{};
+  size_t bytes{0};
+};
+
+Result runRaw(Workload workload, const std::string& message, size_t count) {
+  auto const payload = folly::IOBuf::copyBuffer(message);
+  RawServer server{workload, *payload, count};
+  RawClient client{server.address(), *payload};
+
+  Result result;
+  result.elapsed = client.run(workload, count, result.bytes);
+  return result;
+}
+
+/// Sends request-responses one after the other, the next one from the
+/// callback of the previous one.
+class RoundTrips {
+ public:
+  RoundTrips(
+      std::shared_ptr<RSocketRequester> requester,
+      const std::string& message,
+      size_t count,
+      folly::Baton<>& done)
+      : requester_{std::move(requester)},
+        message_{message},
+        remaining_{count},
+        done_{done} {}
+
+  void next() {
+    if (remaining_-- == 0) {
+      done_.post();
+      return;
+    }
+    requester_->requestResponse(Payload(message_))
+        ->subscribe(
+            [this](Payload) { next(); },
+            [this](folly::exception_wrapper ew) {
+              LOG(ERROR) << "Round trip failed: " << ew.what();
+              done_.post();
+            });
+  }
+
+ private:
+  const std::shared_ptr<RSocketRequester> requester_;
+  const std::string message_;
+  size_t remaining_;
+  folly::Baton<>& done_;
+};
+
+Result runRSocket(
+    Workload workload,
+    const std::string& message,
+    size_t count) {
+  auto stats = std::make_shared<ByteCounter>();
+  Fixture::Options opts;
+  opts.serverThreads = 1;
+  opts.clients = 1;
+  opts.clientStats = stats;
+  Fixture fixture{opts, std::make_shared<FixedResponder>(message)};
+  auto requester = fixture.clients.front()->getRequester();
+
+  // Leaves out the SETUP frame.
+  stats->take();
+
+  Result result;
+  auto const start = Clock::now();
+  if (workload == Workload::Stream) {
+    Latch latch{1};
+    requester->requestStream(Payload("s"))
+        ->subscribe(std::make_shared<BoundedSubscriber>(latch, count));
+    latch.wait();
+  } else {
+    folly::Baton<> done;
+    RoundTrips roundTrips{requester, message, count, done};
+    roundTrips.next();
+    done.wait();
+  }
+  result.elapsed = Clock::now() - start;
+  result.bytes = stats->take();
+  return result;
+}
+
+void report(Workload workload, const std::string& message, size_t count) {
+  auto const raw = runRaw(workload, message, count);
+  auto const rsocket = runRSocket(workload, message, count);
+
+  auto const perMessage = [count](Clock::duration elapsed) {
+    return std::chrono::duration<double, std::nano>(elapsed).count() / count;
+  };
+  auto const rawNanos = perMessage(raw.elapsed);
+  auto const rsocketNanos = perMessage(rsocket.elapsed);
+  auto const extraBytes =
+      (static_cast<double>(rsocket.bytes) - static_cast<double>(raw.bytes)) /
+      count;
+
+  LOG(INFO) << "  " << message.size() << "B "
+            << (workload == Workload::Stream ? "stream" : "round trip")
+            << ": raw " << rawNanos << " ns, RSocket " << rsocketNanos
+            << " ns, overhead " << (rsocketNanos - rawNanos) << " ns and "
+            << extraBytes << " bytes per message";
+}
+
+std::vector<size_t> messageSizes() {
+  std::vector<folly::StringPiece> pieces;
+  folly::split(',', FLAGS_message_sizes, pieces, true);
+  std::vector<size_t> sizes;
+  for (auto piece : pieces) {
+    sizes.push_back(folly::to<size_t>(folly::trimWhitespace(piece)));
+  }
+  return sizes;
+}
+
+} // namespace
+
+BENCHMARK(ProtocolOverhead, n) {
+  (void)n;
+
+  folly::BenchmarkSuspender suspender;
+  for (auto const size : messageSizes()) {
+    std::string const message(size, 'a');
+    LOG(INFO) << size << " byte payloads:";
+    report(Workload::Stream, message, static_cast<size_t>(FLAGS_messages));
+    report(
+        Workload::RoundTrip, message, static_cast<size_t>(FLAGS_round_trips));
+  }
+}
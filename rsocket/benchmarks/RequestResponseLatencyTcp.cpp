@@ -0,0 +1,176 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/benchmarks/Throughput.h"
+
+#include <folly/Benchmark.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <folly/portability/GFlags.h>
+#include <folly/synchronization/Baton.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "rsocket/RSocket.h"
+#include "rsocket/internal/BusyPollEventBaseThread.h"
+#include "rsocket/internal/ThreadAffinity.h"
+#include "rsocket/transports/tcp/TcpConnectionAcceptor.h"
+#include "rsocket/transports/tcp/TcpConnectionFactory.h"
+
+using namespace rsocket;
+
+constexpr size_t kMessageLen = 32;
+
+DEFINE_int32(items, 100000, "number of round trips to time, in each mode");
+DEFINE_int32(
+    busy_poll_micros,
+    50,
+    "SO_BUSY_POLL budget of the sockets when busy polling");
+DEFINE_int32(server_cpu, -1, "CPU to pin the server thread to, if any");
+DEFINE_int32(client_cpu, -1, "CPU to pin the client thread to, if any");
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::vector<int> cpuFlag(int cpu) {
+  return cpu >= 0 ? std::vector<int>{cpu} : std::vector<int>{};
+}
+
+/// Sends one request-response at a time, each as soon as the response to the
+/// previous one arrives, and times every round trip.  Runs on the thread of
+/// the client.
+class RoundTrips {
+ public:
+  RoundTrips(RSocketRequester& requester, size_t count)
+      : requester_(requester), remaining_(count) {
+    latencies_.reserve(count);
+  }
+
+  void next() {
+    if (remaining_-- == 0) {
+      done_.post();
+      return;
+    }
+    start_ = Clock::now();
+    requester_.requestResponse(Payload("RequestResponseLatencyTcp"))
+        ->subscribe(
+            [this](Payload) {
+              latencies_.push_back(Clock::now() - start_);
+              next();
+            },
+            [this](folly::exception_wrapper ew) {
+              LOG(ERROR) << "Request failed: " << ew.what();
+              done_.post();
+            });
+  }
+
+  std::vector<Clock::duration> wait() {
+    done_.wait();
+    return std::move(latencies_);
+  }
+
+ private:
+  RSocketRequester& requester_;
+  size_t remaining_;
+  Clock::time_point start_;
+  std::vector<Clock::duration> latencies_;
+  folly::Baton<> done_;
+};
+
+void report(const char* mode, std::vector<Clock::duration> latencies) {
+  if (latencies.empty()) {
+    return;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  auto const at = [&](double quantile) {
+    auto const index = static_cast<size_t>(quantile * (latencies.size() - 1));
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               latencies[index])
+        .count();
+  };
+  LOG(INFO) << mode << " round trips: p50 " << at(0.5) << "us, p99 "
+            << at(0.99) << "us, p99.9 " << at(0.999) << "us, max "
+            << at(1.0) << "us";
+}
+
+void run(bool busyPoll) {
+  folly::BenchmarkSuspender suspender;
+
+  TcpDuplexConnection::Options connectionOptions;
+  if (busyPoll) {
+    connectionOptions.busyPollMicros = FLAGS_busy_poll_micros;
+  }
+
+  TcpConnectionAcceptor::Options opts;
+  opts.address = folly::SocketAddress{"0.0.0.0", 0};
+  opts.threads = 1;
+  opts.busyPoll = busyPoll;
+  opts.connection = connectionOptions;
+  opts.cpuSets.push_back(cpuFlag(FLAGS_server_cpu));
+
+  auto server = std::make_unique<RSocketServer>(
+      std::make_unique<TcpConnectionAcceptor>(std::move(opts)));
+  auto responder =
+      std::make_shared<FixedResponder>(std::string(kMessageLen, 'a'));
+  server->start(RSocketServiceHandler::create(
+      [responder](const SetupParameters&) { return responder; }));
+
+  std::unique_ptr<folly::ScopedEventBaseThread> thread;
+  std::unique_ptr<BusyPollEventBaseThread> busyPollThread;
+  folly::EventBase* evb;
+  if (busyPoll) {
+    busyPollThread = std::make_unique<BusyPollEventBaseThread>(
+        "rsocket-client-thread", cpuFlag(FLAGS_client_cpu));
+    evb = busyPollThread->getEventBase();
+  } else {
+    thread = std::make_unique<folly::ScopedEventBaseThread>(
+        "rsocket-client-thread");
+    evb = thread->getEventBase();
+    pinEventBaseThread(*evb, cpuFlag(FLAGS_client_cpu));
+  }
+
+  auto client =
+      RSocket::createConnectedClient(
+          std::make_unique<TcpConnectionFactory>(
+              *evb,
+              folly::SocketAddress{"127.0.0.1", *server->listeningPort()},
+              nullptr,
+              connectionOptions))
+          .get();
+
+  suspender.dismiss();
+  RoundTrips trips(*client->getRequester(), FLAGS_items);
+  evb->runInEventBaseThread([&] { trips.next(); });
+  auto latencies = trips.wait();
+  suspender.rehire();
+
+  report(busyPoll ? "Busy polling" : "Blocking", std::move(latencies));
+
+  evb->runInEventBaseThreadAndWait([c = std::move(client)] {});
+  server.reset();
+}
+
+} // namespace
+
+BENCHMARK(RequestResponseLatency, n) {
+  (void)n;
+  run(false);
+}
+
+BENCHMARK_RELATIVE(RequestResponseLatencyBusyPoll, n) {
+  (void)n;
+  run(true);
+}
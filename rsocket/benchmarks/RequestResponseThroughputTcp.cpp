@@ -15,8 +15,10 @@
 #include "rsocket/benchmarks/Fixture.h"
 #include "rsocket/benchmarks/Latch.h"
 #include "rsocket/benchmarks/Throughput.h"
+#include "rsocket/benchmarks/Tls.h"
 
 #include <folly/Benchmark.h>
+#include <folly/executors/InlineExecutor.h>
 #include <folly/init/Init.h>
 #include <folly/portability/GFlags.h>
 
@@ -37,6 +39,7 @@ DEFINE_int32(
     items,
     1000000,
     "number of request-response requests to send, in total");
+DEFINE_bool(ktls, false, "whether the TLS clients ask for kTLS");
 
 namespace {
 
@@ -63,33 +66,48 @@ class Observer : public yarpl::single::SingleObserverBase<Payload> {
  private:
   Latch& latch_;
 };
-} // namespace
 
-BENCHMARK(RequestResponseThroughput, n) {
-  (void)n;
+std::unique_ptr<Fixture> makeFixture(Fixture::Options& opts, bool tls) {
+  auto responder =
+      std::make_shared<FixedResponder>(std::string(kMessageLen, 'a'));
+
+  opts.serverThreads = FLAGS_server_threads;
+  opts.clients = FLAGS_clients;
+  if (FLAGS_override_client_threads > 0) {
+    opts.clientThreads = FLAGS_override_client_threads;
+  }
+  if (tls) {
+    opts.serverSslContext = makeServerTlsContext();
+    opts.clientSslContext = makeClientTlsContext();
+    opts.kernelTls = FLAGS_ktls;
+  }
+
+  auto fixture = std::make_unique<Fixture>(opts, std::move(responder));
+
+  LOG(INFO) << "Running:";
+  LOG(INFO) << "  Server with " << opts.serverThreads << " threads"
+            << (tls ? ", over TLS." : ".");
+  LOG(INFO) << "  " << opts.clients << " clients across "
+            << fixture->workers.size() << " threads.";
+  LOG(INFO) << "  Running " << FLAGS_items << " requests in total";
+  return fixture;
+}
+
+void waitFor(Latch& latch) {
+  constexpr std::chrono::minutes timeout{5};
+  if (!latch.timed_wait(timeout)) {
+    LOG(ERROR) << "Timed out!";
+  }
+}
 
+void requestResponseThroughput(bool tls) {
   Latch latch{static_cast<size_t>(FLAGS_items)};
 
   std::unique_ptr<Fixture> fixture;
   Fixture::Options opts;
 
   BENCHMARK_SUSPEND {
-    auto responder =
-        std::make_shared<FixedResponder>(std::string(kMessageLen, 'a'));
-
-    opts.serverThreads = FLAGS_server_threads;
-    opts.clients = FLAGS_clients;
-    if (FLAGS_override_client_threads > 0) {
-      opts.clientThreads = FLAGS_override_client_threads;
-    }
-
-    fixture = std::make_unique<Fixture>(opts, std::move(responder));
-
-    LOG(INFO) << "Running:";
-    LOG(INFO) << "  Server with " << opts.serverThreads << " threads.";
-    LOG(INFO) << "  " << opts.clients << " clients across "
-              << fixture->workers.size() << " threads.";
-    LOG(INFO) << "  Running " << FLAGS_items << " requests in total";
+    fixture = makeFixture(opts, tls);
   }
 
   for (int i = 0; i < FLAGS_items; ++i) {
@@ -99,8 +117,43 @@ BENCHMARK(RequestResponseThroughput, n) {
         ->subscribe(std::make_shared<Observer>(latch));
   }
 
-  constexpr std::chrono::minutes timeout{5};
-  if (!latch.timed_wait(timeout)) {
-    LOG(ERROR) << "Timed out!";
+  waitFor(latch);
+}
+
+void requestResponseFutureThroughput() {
+  Latch latch{static_cast<size_t>(FLAGS_items)};
+
+  std::unique_ptr<Fixture> fixture;
+  Fixture::Options opts;
+
+  BENCHMARK_SUSPEND {
+    fixture = makeFixture(opts, false);
   }
+
+  for (int i = 0; i < FLAGS_items; ++i) {
+    auto& client = fixture->clients[i % opts.clients];
+    client->getRequester()
+        ->requestResponseFuture(Payload("RequestResponseTcp"))
+        .via(&folly::InlineExecutor::instance())
+        .thenTry([&latch](folly::Try<Payload>&&) { latch.post(); });
+  }
+
+  waitFor(latch);
+}
+
+} // namespace
+
+BENCHMARK(RequestResponseThroughput, n) {
+  (void)n;
+  requestResponseThroughput(false);
+}
+
+BENCHMARK_RELATIVE(RequestResponseFutureThroughput, n) {
+  (void)n;
+  requestResponseFutureThroughput();
+}
+
+BENCHMARK_RELATIVE(RequestResponseTlsThroughput, n) {
+  (void)n;
+  requestResponseThroughput(true);
 }
@@ -0,0 +1,135 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/benchmarks/InProcessFixture.h"
+#include "rsocket/benchmarks/Latch.h"
+#include "rsocket/benchmarks/Throughput.h"
+
+#include <folly/Benchmark.h>
+#include <folly/executors/InlineExecutor.h>
+#include <folly/portability/GFlags.h>
+
+#include <functional>
+
+#include "rsocket/RSocket.h"
+
+using namespace rsocket;
+
+DEFINE_int32(pipelined, 1000, "requests in flight at once when pipelining");
+
+/// Cost of handing requests to RSocketRequester from the EventBase of the
+/// connection, where they run inline, compared to handing them from another
+/// thread, where they hop onto the EventBase.
+///
+/// Requests from another thread that come in a burst are batched into a
+/// single hop.  The responses always complete on the EventBase.
+
+namespace {
+
+constexpr std::chrono::minutes kTimeout{5};
+
+/// Sends `count` requests one after the other, each once the previous one
+/// got its response.
+void roundTrips(RSocketRequester& requester, size_t count, Latch& latch) {
+  if (count == 0) {
+    latch.post();
+    return;
+  }
+  requester.requestResponseFuture(Payload("RequesterDispatch"))
+      .via(&folly::InlineExecutor::instance())
+      .thenValue([&requester, count, &latch](Payload) {
+        roundTrips(requester, count - 1, latch);
+      });
+}
+
+void roundTrip(size_t n, bool inThread) {
+  std::unique_ptr<InProcessFixture> fixture;
+  BENCHMARK_SUSPEND {
+    fixture = std::make_unique<InProcessFixture>(
+        std::make_shared<FixedResponder>("response"));
+  }
+  auto& requester = *fixture->clients.front()->getRequester();
+
+  if (inThread) {
+    Latch latch{1};
+    fixture->clientWorker.getEventBase()->runInEventBaseThread(
+        [&] { roundTrips(requester, n, latch); });
+    if (!latch.timed_wait(kTimeout)) {
+      LOG(ERROR) << "Timed out!";
+    }
+  } else {
+    for (size_t i = 0; i < n; ++i) {
+      requester.requestResponseFuture(Payload("RequesterDispatch"))
+          .get(kTimeout);
+    }
+  }
+
+  BENCHMARK_SUSPEND {
+    fixture.reset();
+  }
+}
+
+/// Sends --pipelined requests at once, `n` times over.
+void pipelined(size_t n, bool inThread) {
+  std::unique_ptr<InProcessFixture> fixture;
+  BENCHMARK_SUSPEND {
+    fixture = std::make_unique<InProcessFixture>(
+        std::make_shared<FixedResponder>("response"));
+  }
+  auto& requester = *fixture->clients.front()->getRequester();
+  auto const perRound = static_cast<size_t>(FLAGS_pipelined);
+
+  for (size_t round = 0; round < n; ++round) {
+    Latch latch{perRound};
+    auto send = [&] {
+      for (size_t i = 0; i < perRound; ++i) {
+        requester.requestResponseFuture(Payload("RequesterDispatch"))
+            .via(&folly::InlineExecutor::instance())
+            .thenValue([&latch](Payload) { latch.post(); });
+      }
+    };
+    if (inThread) {
+      fixture->clientWorker.getEventBase()->runInEventBaseThread(send);
+    } else {
+      send();
+    }
+    if (!latch.timed_wait(kTimeout)) {
+      LOG(ERROR) << "Timed out!";
+    }
+  }
+
+  BENCHMARK_SUSPEND {
+    fixture.reset();
+  }
+}
+
+} // namespace
+
+BENCHMARK(RoundTrip_OtherThread, n) {
+  roundTrip(n, false);
+}
+
+BENCHMARK_RELATIVE(RoundTrip_InThread, n) {
+  roundTrip(n, true);
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(Pipelined_OtherThread, n) {
+  pipelined(n, false);
+}
+
+BENCHMARK_RELATIVE(Pipelined_InThread, n) {
+  pipelined(n, true);
+}
@@ -0,0 +1,239 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/benchmarks/Fixture.h"
+#include "rsocket/benchmarks/Latch.h"
+#include "rsocket/benchmarks/Throughput.h"
+
+#include <folly/Benchmark.h>
+#include <folly/portability/GFlags.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "rsocket/RSocket.h"
+#include "yarpl/Single.h"
+
+using namespace rsocket;
+
+DEFINE_int32(
+    max_threads,
+    0,
+    "largest number of server threads to run, and as many client threads "
+    "(defaults to half the cores)");
+DEFINE_int32(clients_per_thread, 4, "number of clients per client thread");
+DEFINE_int32(
+    items_per_thread,
+    200000,
+    "number of requests or stream items, per server thread");
+DEFINE_int32(request_batch, 64, "number of items streams ask for at a time");
+
+/// Runs every interaction model with 1, 2, 4, ... up to --max_threads server
+/// threads, with as many client threads and a fixed load per thread, and
+/// reports:
+///
+/// - the throughput, and the throughput per server thread,
+/// - the scaling efficiency, the throughput per thread relative to the run
+///   with a single thread.
+///
+/// An efficiency that drops as threads are added points at state shared by
+/// the threads, e.g. the ConnectionSet or stats counters.  The clients run in
+/// the same process, so --max_threads should leave them half the cores.
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kMessageLen = 32;
+
+enum class Model { FireAndForget, RequestResponse, Stream, Channel };
+
+const char* nameOf(Model model) {
+  switch (model) {
+    case Model::FireAndForget:
+      return "fire-and-forget";
+    case Model::RequestResponse:
+      return "request-response";
+    case Model::Stream:
+      return "stream";
+    case Model::Channel:
+      return "channel";
+  }
+  return "unknown";
+}
+
+/// Counts the fire-and-forget requests it receives.
+class CountingResponder : public FixedResponder {
+ public:
+  explicit CountingResponder(Latch& latch)
+      : FixedResponder{std::string(kMessageLen, 'a')}, latch_{latch} {}
+
+  void handleFireAndForget(Payload, StreamId) override {
+    latch_.post();
+  }
+
+ private:
+  Latch& latch_;
+};
+
+class ResponseObserver : public yarpl::single::SingleObserverBase<Payload> {
+ public:
+  explicit ResponseObserver(Latch& latch) : latch_{latch} {}
+
+  void onSuccess(Payload) override {
+    latch_.post();
+    yarpl::single::SingleObserverBase<Payload>::onSuccess({});
+  }
+
+  void onError(folly::exception_wrapper) override {
+    latch_.post();
+    yarpl::single::SingleObserverBase<Payload>::onError({});
+  }
+
+ private:
+  Latch& latch_;
+};
+
+/// Items per second of one run of `model` with `threads` server and client
+/// threads.
+double runOnce(Model model, size_t threads) {
+  auto const items = static_cast<size_t>(FLAGS_items_per_thread) * threads;
+  auto const clients =
+      std::max<size_t>(FLAGS_clients_per_thread, 1) * threads;
+  auto const perClient = std::max<size_t>(items / clients, 1);
+  auto const batch = static_cast<size_t>(std::max(FLAGS_request_batch, 1));
+
+  size_t expected = items;
+  if (model == Model::Stream) {
+    expected = clients;
+  } else if (model == Model::Channel) {
+    // Both directions of every channel terminate.
+    expected = 2 * clients;
+  }
+  Latch latch{expected};
+
+  std::shared_ptr<RSocketResponder> responder;
+  if (model == Model::Channel) {
+    responder = std::make_shared<ChannelResponder>(
+        latch, std::string(kMessageLen, 'a'), perClient, batch);
+  } else {
+    responder = std::make_shared<CountingResponder>(latch);
+  }
+
+  Fixture::Options opts;
+  opts.serverThreads = threads;
+  opts.clients = clients;
+  opts.clientThreads = threads;
+  Fixture fixture{opts, std::move(responder)};
+
+  auto const requests = yarpl::flowable::Flowable<Payload>::fromGenerator(
+                            [msg = folly::IOBuf::copyBuffer(
+                                 std::string(kMessageLen, 'a'))] {
+                              return Payload(msg->clone());
+                            })
+                            ->take(perClient);
+
+  auto const start = Clock::now();
+  switch (model) {
+    case Model::FireAndForget:
+      for (size_t i = 0; i < items; ++i) {
+        fixture.clients[i % clients]
+            ->getRequester()
+            ->fireAndForget(Payload("ServerScaling"))
+            ->subscribe(
+                std::make_shared<yarpl::single::SingleObserverBase<void>>());
+      }
+      break;
+    case Model::RequestResponse:
+      for (size_t i = 0; i < items; ++i) {
+        fixture.clients[i % clients]
+            ->getRequester()
+            ->requestResponse(Payload("ServerScaling"))
+            ->subscribe(std::make_shared<ResponseObserver>(latch));
+      }
+      break;
+    case Model::Stream:
+      for (auto& client : fixture.clients) {
+        client->getRequester()
+            ->requestStream(Payload("ServerScaling"))
+            ->subscribe(std::make_shared<BoundedSubscriber>(latch, perClient));
+      }
+      break;
+    case Model::Channel:
+      for (auto& client : fixture.clients) {
+        client->getRequester()
+            ->requestChannel(Payload("ServerScaling"), requests)
+            ->subscribe(std::make_shared<BatchingSubscriber>(latch, batch));
+      }
+      break;
+  }
+
+  constexpr std::chrono::minutes timeout{5};
+  if (!latch.timed_wait(timeout)) {
+    LOG(ERROR) << "Timed out!";
+    return 0;
+  }
+  auto const seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+  auto delivered = items;
+  if (model == Model::Stream) {
+    delivered = perClient * clients;
+  } else if (model == Model::Channel) {
+    delivered = 2 * perClient * clients;
+  }
+  return delivered / seconds;
+}
+
+std::vector<size_t> threadCounts() {
+  auto max = static_cast<size_t>(std::max(FLAGS_max_threads, 0));
+  if (max == 0) {
+    max = std::max<size_t>(std::thread::hardware_concurrency() / 2, 1);
+  }
+  std::vector<size_t> counts;
+  for (size_t threads = 1; threads < max; threads *= 2) {
+    counts.push_back(threads);
+  }
+  counts.push_back(max);
+  return counts;
+}
+
+} // namespace
+
+BENCHMARK(ServerScaling, n) {
+  (void)n;
+
+  folly::BenchmarkSuspender suspender;
+  auto const counts = threadCounts();
+
+  for (auto model : {Model::FireAndForget,
+                     Model::RequestResponse,
+                     Model::Stream,
+                     Model::Channel}) {
+    LOG(INFO) << nameOf(model) << ":";
+    double single = 0;
+    for (auto threads : counts) {
+      auto const throughput = runOnce(model, threads);
+      auto const perThread = throughput / threads;
+      if (threads == 1) {
+        single = perThread;
+      }
+      LOG(INFO) << "  " << threads << " threads: " << throughput
+                << " items/sec, " << perThread << " per thread, "
+                << (single > 0 ? 100 * perThread / single : 0)
+                << "% efficiency";
+    }
+  }
+}
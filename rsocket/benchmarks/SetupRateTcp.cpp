@@ -0,0 +1,229 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/benchmarks/Fixture.h"
+#include "rsocket/benchmarks/Throughput.h"
+
+#include <folly/Benchmark.h>
+#include <folly/memory/Malloc.h>
+#include <folly/memory/MallctlHelper.h>
+#include <folly/portability/GFlags.h>
+#include <folly/synchronization/Baton.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "rsocket/RSocket.h"
+#include "rsocket/transports/tcp/TcpConnectionFactory.h"
+
+using namespace rsocket;
+
+DEFINE_int32(server_threads, 8, "number of server threads to run");
+DEFINE_int32(client_threads, 16, "number of threads opening connections");
+DEFINE_int32(setups, 20000, "number of connections to open and close");
+DEFINE_int32(held, 1000, "number of connections held open to measure memory");
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/// Bytes allocated by the process, or none if that can't be determined.
+folly::Optional<size_t> allocatedBytes() {
+  if (!folly::usingJEMalloc()) {
+    return folly::none;
+  }
+  try {
+    uint64_t epoch = 1;
+    folly::mallctlWrite("epoch", epoch);
+
+    size_t allocated = 0;
+    folly::mallctlRead("stats.allocated", &allocated);
+    return allocated;
+  } catch (const std::exception& exn) {
+    LOG(WARNING) << "Cannot read allocation stats: " << exn.what();
+    return folly::none;
+  }
+}
+
+Fixture::Options fixtureOptions() {
+  Fixture::Options opts;
+  opts.serverThreads = FLAGS_server_threads;
+  opts.clients = 0;
+  opts.clientThreads = static_cast<size_t>(FLAGS_client_threads);
+  return opts;
+}
+
+std::unique_ptr<Fixture> makeFixture() {
+  return std::make_unique<Fixture>(
+      fixtureOptions(), std::make_shared<FixedResponder>("SetupRateTcp"));
+}
+
+folly::SocketAddress serverAddress(Fixture& fixture) {
+  return folly::SocketAddress{"127.0.0.1", *fixture.server->listeningPort()};
+}
+
+/// Opens a connection from `evb` and waits until the server has processed its
+/// SETUP frame.  RSocket doesn't acknowledge SETUP, so this waits for the
+/// response to a first request instead.
+std::shared_ptr<RSocketClient> connect(
+    folly::EventBase& evb,
+    const folly::SocketAddress& address) {
+  auto client = RSocket::createConnectedClient(
+                    std::make_unique<TcpConnectionFactory>(evb, address))
+                    .get();
+
+  folly::Baton<> done;
+  client->getRequester()
+      ->requestResponse(Payload("SetupRateTcp"))
+      ->subscribe(
+          [&](Payload) { done.post(); },
+          [&](folly::exception_wrapper ew) {
+            LOG(ERROR) << "First request failed: " << ew.what();
+            done.post();
+          });
+  done.wait();
+  return client;
+}
+
+/// Clients have to be destroyed on their EventBase.
+void disconnect(folly::EventBase& evb, std::shared_ptr<RSocketClient> client) {
+  evb.runInEventBaseThreadAndWait([c = std::move(client)] {});
+}
+
+/// Splits `total` over the client workers of `fixture`, running
+/// `fn(evb, count, workerIndex)` for each of them from its own thread.
+template <typename F>
+void forEachWorker(Fixture& fixture, size_t total, F&& fn) {
+  auto const workers = fixture.workers.size();
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < workers; ++i) {
+    auto const count = total / workers + (i < total % workers ? 1 : 0);
+    auto& evb = *fixture.workers[i]->getEventBase();
+    threads.emplace_back([&fn, &evb, count, i] { fn(evb, count, i); });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+void logLatencies(std::vector<Clock::duration> latencies) {
+  if (latencies.empty()) {
+    return;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  auto const at = [&](double quantile) {
+    auto const index = static_cast<size_t>(quantile * (latencies.size() - 1));
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               latencies[index])
+        .count();
+  };
+  LOG(INFO) << "  Setup latency p50 " << at(0.5) << "us, p99 " << at(0.99)
+            << "us, max " << at(1.0) << "us";
+}
+
+} // namespace
+
+/// Opens and closes FLAGS_setups connections as fast as the client threads
+/// can, each one after the previous one from the same thread is closed.
+BENCHMARK(SetupRate, n) {
+  (void)n;
+
+  std::unique_ptr<Fixture> fixture;
+  folly::SocketAddress address;
+  std::vector<std::vector<Clock::duration>> latencies;
+
+  BENCHMARK_SUSPEND {
+    fixture = makeFixture();
+    address = serverAddress(*fixture);
+    latencies.resize(fixture->workers.size());
+  }
+
+  auto const start = Clock::now();
+  forEachWorker(
+      *fixture,
+      FLAGS_setups,
+      [&](folly::EventBase& evb, size_t count, size_t i) {
+        latencies[i].reserve(count);
+        for (size_t j = 0; j < count; ++j) {
+          auto const setupStart = Clock::now();
+          auto client = connect(evb, address);
+          latencies[i].push_back(Clock::now() - setupStart);
+          disconnect(evb, std::move(client));
+        }
+      });
+  auto const elapsed = Clock::now() - start;
+
+  BENCHMARK_SUSPEND {
+    std::vector<Clock::duration> all;
+    for (auto& threadLatencies : latencies) {
+      all.insert(all.end(), threadLatencies.begin(), threadLatencies.end());
+    }
+    auto const seconds = std::chrono::duration<double>(elapsed).count();
+    LOG(INFO) << "  " << all.size() << " setups, "
+              << static_cast<size_t>(all.size() / seconds) << " setups/sec";
+    logLatencies(std::move(all));
+    fixture.reset();
+  }
+}
+
+/// Holds FLAGS_held connections open at once and reports the memory they take
+/// up, on both the client and the server side.
+BENCHMARK(SetupMemory, n) {
+  (void)n;
+
+  std::unique_ptr<Fixture> fixture;
+  folly::SocketAddress address;
+  std::vector<std::vector<std::shared_ptr<RSocketClient>>> clients;
+  folly::Optional<size_t> allocatedBefore;
+
+  BENCHMARK_SUSPEND {
+    fixture = makeFixture();
+    address = serverAddress(*fixture);
+    clients.resize(fixture->workers.size());
+    allocatedBefore = allocatedBytes();
+  }
+
+  forEachWorker(
+      *fixture, FLAGS_held, [&](folly::EventBase& evb, size_t count, size_t i) {
+        for (size_t j = 0; j < count; ++j) {
+          clients[i].push_back(connect(evb, address));
+        }
+      });
+
+  BENCHMARK_SUSPEND {
+    auto const allocatedAfter = allocatedBytes();
+    auto const connections = fixture->server->getNumConnections();
+    auto const usage = fixture->server->memoryUsage().get();
+    if (connections > 0) {
+      if (allocatedBefore && allocatedAfter &&
+          *allocatedAfter > *allocatedBefore) {
+        LOG(INFO) << "  Allocated bytes per connection: "
+                  << (*allocatedAfter - *allocatedBefore) / connections;
+      }
+      LOG(INFO) << "  Tracked server bytes per connection: "
+                << usage.total() / connections;
+    }
+
+    for (size_t i = 0; i < clients.size(); ++i) {
+      auto& evb = *fixture->workers[i]->getEventBase();
+      for (auto& client : clients[i]) {
+        disconnect(evb, std::move(client));
+      }
+    }
+    fixture.reset();
+  }
+}
@@ -0,0 +1,115 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <folly/Benchmark.h>
+#include <folly/io/async/EventBase.h>
+
+#include <memory>
+#include <vector>
+
+#include "rsocket/framing/FrameSerializer.h"
+#include "rsocket/internal/SetupResumeAcceptor.h"
+
+using namespace rsocket;
+
+namespace {
+
+/// Connection that delivers `firstFrame`, if any, as soon as it gets an input.
+/// Keeps its input alive like a real transport does.
+class FakeConnection : public DuplexConnection {
+ public:
+  explicit FakeConnection(std::unique_ptr<folly::IOBuf> firstFrame)
+      : firstFrame_{std::move(firstFrame)} {}
+
+  ~FakeConnection() override {
+    if (auto input = std::move(input_)) {
+      input->onComplete();
+    }
+  }
+
+  void setInput(std::shared_ptr<Subscriber> input) override {
+    input_ = std::move(input);
+    input_->onSubscribe(yarpl::flowable::Subscription::create());
+    if (firstFrame_) {
+      input_->onNext(std::move(firstFrame_));
+    }
+  }
+
+  void send(std::unique_ptr<folly::IOBuf>) override {}
+
+ private:
+  std::unique_ptr<folly::IOBuf> firstFrame_;
+  std::shared_ptr<Subscriber> input_;
+};
+
+std::unique_ptr<folly::IOBuf> makeSetup() {
+  auto const version = ProtocolVersion::Latest;
+
+  Frame_SETUP frame;
+  frame.header_ = FrameHeader{FrameType::SETUP, FrameFlags::EMPTY_, 0};
+  frame.versionMajor_ = version.major;
+  frame.versionMinor_ = version.minor;
+  frame.keepaliveTime_ = Frame_SETUP::kMaxKeepaliveTime;
+  frame.maxLifetime_ = Frame_SETUP::kMaxLifetime;
+  frame.token_ = ResumeIdentificationToken::generateNew();
+  frame.metadataMimeType_ = "application/octet-stream";
+  frame.dataMimeType_ = "application/octet-stream";
+  return FrameSerializer::createFrameSerializer(version)->serializeOut(
+      std::move(frame));
+}
+
+} // namespace
+
+/// A connection that sends its SETUP frame right away, handed to the setup
+/// callback.
+BENCHMARK(AcceptSetup, n) {
+  folly::BenchmarkSuspender suspender;
+  folly::EventBase evb;
+  SetupResumeAcceptor acceptor{&evb};
+  auto const setup = makeSetup();
+
+  // The setup callback runs from within FakeConnection::setInput(), so the
+  // connections must outlive the loop.
+  std::vector<std::unique_ptr<DuplexConnection>> connections;
+  connections.reserve(n);
+  suspender.dismiss();
+
+  for (size_t i = 0; i < n; ++i) {
+    acceptor.accept(
+        std::make_unique<FakeConnection>(setup->clone()),
+        [&](std::unique_ptr<DuplexConnection> connection,
+            SetupParameters) noexcept {
+          connections.push_back(std::move(connection));
+        },
+        [](std::unique_ptr<DuplexConnection>, ResumeParameters) noexcept {});
+  }
+
+  suspender.rehire();
+  connections.clear();
+}
+
+/// Connections that never send a frame, closed when the server shuts down.
+BENCHMARK(AcceptAndClose, n) {
+  folly::EventBase evb;
+  SetupResumeAcceptor acceptor{&evb};
+
+  for (size_t i = 0; i < n; ++i) {
+    acceptor.accept(
+        std::make_unique<FakeConnection>(nullptr),
+        [](std::unique_ptr<DuplexConnection>, SetupParameters) noexcept {},
+        [](std::unique_ptr<DuplexConnection>, ResumeParameters) noexcept {});
+  }
+
+  acceptor.close();
+}
@@ -0,0 +1,101 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <folly/Benchmark.h>
+#include <gflags/gflags.h>
+
+#include <memory>
+#include <unordered_map>
+
+#include "rsocket/internal/StreamTable.h"
+
+using namespace rsocket;
+
+DEFINE_int32(streams, 10000, "number of concurrent streams");
+
+namespace {
+
+using Value = std::shared_ptr<int>;
+
+/// Ids of the concurrent streams, as allocated by a client.
+StreamId streamIdAt(size_t i) {
+  return static_cast<StreamId>(2 * i + 1);
+}
+
+template <typename Table>
+void insertStreams(Table& table, size_t count) {
+  auto value = std::make_shared<int>(0);
+  for (size_t i = 0; i < count; ++i) {
+    table.emplace(streamIdAt(i), value);
+  }
+}
+
+bool contains(std::unordered_map<StreamId, Value>& table, StreamId id) {
+  return table.find(id) != table.end();
+}
+
+bool contains(StreamTable<Value>& table, StreamId id) {
+  return table.find(id) != nullptr;
+}
+
+/// Looks up every concurrent stream, as frames for them come in.
+template <typename Table>
+void lookup(size_t n) {
+  folly::BenchmarkSuspender suspender;
+  auto const count = static_cast<size_t>(FLAGS_streams);
+  Table table;
+  insertStreams(table, count);
+  suspender.dismiss();
+
+  for (size_t i = 0; i < n; ++i) {
+    folly::doNotOptimizeAway(contains(table, streamIdAt(i % count)));
+  }
+}
+
+/// Opens a new stream and closes the oldest one, keeping the number of
+/// concurrent streams constant.
+template <typename Table>
+void churn(size_t n) {
+  folly::BenchmarkSuspender suspender;
+  auto const count = static_cast<size_t>(FLAGS_streams);
+  Table table;
+  insertStreams(table, count);
+  auto value = std::make_shared<int>(0);
+  suspender.dismiss();
+
+  for (size_t i = 0; i < n; ++i) {
+    table.erase(streamIdAt(i));
+    table.emplace(streamIdAt(i + count), value);
+  }
+}
+
+} // namespace
+
+BENCHMARK(Lookup_UnorderedMap, n) {
+  lookup<std::unordered_map<StreamId, Value>>(n);
+}
+
+BENCHMARK_RELATIVE(Lookup_StreamTable, n) {
+  lookup<StreamTable<Value>>(n);
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(Churn_UnorderedMap, n) {
+  churn<std::unordered_map<StreamId, Value>>(n);
+}
+
+BENCHMARK_RELATIVE(Churn_StreamTable, n) {
+  churn<StreamTable<Value>>(n);
+}
@@ -12,14 +12,15 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+
+#include "rsocket/benchmarks/InProcessFixture.h"
+#include "rsocket/benchmarks/Latch.h"
 #include "rsocket/benchmarks/Throughput.h"
 
 #include <folly/Benchmark.h>
-#include <folly/Synchronized.h>
-#include <folly/init/Init.h>
-#include <folly/io/async/ScopedEventBaseThread.h>
 #include <folly/portability/GFlags.h>
-#include <folly/synchronization/Baton.h>
+
+#include <algorithm>
 
 #include "rsocket/RSocket.h"
 #include "yarpl/Flowable.h"
@@ -28,160 +29,72 @@ using namespace rsocket;
 
 constexpr size_t kMessageLen = 32;
 
-DEFINE_int32(items, 1000000, "number of items in stream");
+DEFINE_int32(items, 1000000, "number of items to stream, in total");
+
+/// Stream throughput over the in-process transport, so that what is measured
+/// is the cost of the state machines and the serializer rather than TCP.
+///
+/// Each configuration spreads --items over `streams` streams on each of
+/// `connections` connections, with the subscribers asking for `credits`
+/// items at a time (or for the whole stream at once when zero).
 
 namespace {
 
-/// State shared across the client and server DirectDuplexConnections.
-struct State {
-  /// Whether one of the two connections has been destroyed.
-  folly::Synchronized<bool> destroyed;
-};
+void streams(size_t n, size_t connections, size_t streams, size_t credits) {
+  (void)n;
 
-/// DuplexConnection that talks to another DuplexConnection via memory.
-class DirectDuplexConnection : public DuplexConnection {
- public:
-  DirectDuplexConnection(std::shared_ptr<State> state, folly::EventBase& evb)
-      : state_{std::move(state)}, evb_{evb} {}
+  auto const total = connections * streams;
+  auto const perStream =
+      std::max<size_t>(static_cast<size_t>(FLAGS_items) / total, 1);
+  auto const batch = credits ? credits : perStream;
 
-  ~DirectDuplexConnection() override {
-    *state_->destroyed.wlock() = true;
-  }
+  Latch latch{total};
 
-  // Tie two DirectDuplexConnections together so they can talk to each other.
-  void tie(DirectDuplexConnection* other) {
-    other_ = other;
-    other_->other_ = this;
-  }
+  std::unique_ptr<InProcessFixture> fixture;
+  folly::Optional<uint64_t> allocationsBefore;
 
-  void setInput(std::shared_ptr<DuplexConnection::Subscriber> input) override {
-    input_ = std::move(input);
+  BENCHMARK_SUSPEND {
+    LOG(INFO) << "  Running " << connections << " connections of " << streams
+              << " streams of " << perStream << " items, asked for " << batch
+              << " at a time";
+
+    fixture = std::make_unique<InProcessFixture>(
+        std::make_shared<FixedResponder>(std::string(kMessageLen, 'a')),
+        connections);
+    allocationsBefore = allocationCount();
   }
 
-  void send(std::unique_ptr<folly::IOBuf> buf) override {
-    auto destroyed = state_->destroyed.rlock();
-    if (*destroyed || !other_) {
-      return;
+  for (size_t i = 0; i < streams; ++i) {
+    for (auto& client : fixture->clients) {
+      client->getRequester()
+          ->requestStream(Payload("InMemoryStream"))
+          ->take(perStream)
+          ->subscribe(std::make_shared<BatchingSubscriber>(latch, batch));
     }
-
-    other_->evb_.runInEventBaseThread(
-        [state = state_, other = other_, b = std::move(buf)]() mutable {
-          auto destroyed = state->destroyed.rlock();
-          if (*destroyed) {
-            return;
-          }
-
-          other->input_->onNext(std::move(b));
-        });
   }
 
- private:
-  std::shared_ptr<State> state_;
-  folly::EventBase& evb_;
-
-  DirectDuplexConnection* other_{nullptr};
-
-  std::shared_ptr<DuplexConnection::Subscriber> input_;
-};
-
-class Acceptor : public ConnectionAcceptor {
- public:
-  explicit Acceptor(std::shared_ptr<State> state) : state_{std::move(state)} {}
-
-  void setClientConnection(DirectDuplexConnection* connection) {
-    client_ = connection;
-  }
-
-  void start(OnDuplexConnectionAccept onAccept) override {
-    worker_.getEventBase()->runInEventBaseThread(
-        [this, onAccept = std::move(onAccept)]() mutable {
-          auto server = std::make_unique<DirectDuplexConnection>(
-              std::move(state_), *worker_.getEventBase());
-          server->tie(client_);
-          onAccept(std::move(server), *worker_.getEventBase());
-        });
-  }
-
-  void stop() override {}
-
-  folly::Optional<uint16_t> listeningPort() const override {
-    return folly::none;
-  }
-
- private:
-  std::shared_ptr<State> state_;
-
-  DirectDuplexConnection* client_{nullptr};
-
-  folly::ScopedEventBaseThread worker_;
-};
-
-class Factory : public ConnectionFactory {
- public:
-  Factory() {
-    auto state = std::make_shared<State>();
-
-    connection_ = std::make_unique<DirectDuplexConnection>(
-        state, *worker_.getEventBase());
-
-    auto acceptor = std::make_unique<Acceptor>(state);
-    acceptor_ = acceptor.get();
-
-    acceptor_->setClientConnection(connection_.get());
-
-    auto responder =
-        std::make_shared<FixedResponder>(std::string(kMessageLen, 'a'));
-
-    server_ = std::make_unique<RSocketServer>(std::move(acceptor));
-    server_->start([responder](const SetupParameters&) { return responder; });
-  }
-
-  folly::Future<ConnectedDuplexConnection> connect(
-      ProtocolVersion,
-      ResumeStatus /* unused */) override {
-    return folly::via(worker_.getEventBase(), [this] {
-      return ConnectedDuplexConnection{std::move(connection_),
-                                       *worker_.getEventBase()};
-    });
+  constexpr std::chrono::minutes timeout{5};
+  if (!latch.timed_wait(timeout)) {
+    LOG(ERROR) << "Timed out!";
   }
 
- private:
-  std::unique_ptr<DirectDuplexConnection> connection_;
-
-  std::unique_ptr<rsocket::RSocketServer> server_;
-  Acceptor* acceptor_{nullptr};
-
-  folly::ScopedEventBaseThread worker_;
-};
-
-std::shared_ptr<RSocketClient> makeClient() {
-  auto factory = std::make_unique<Factory>();
-  return RSocket::createConnectedClient(std::move(factory)).get();
-}
-} // namespace
-
-BENCHMARK(StreamThroughput, n) {
-  (void)n;
-
-  std::shared_ptr<RSocketClient> client;
-  std::shared_ptr<BoundedSubscriber> subscriber;
-
-  folly::ScopedEventBaseThread worker;
-
-  Latch latch{1};
-
   BENCHMARK_SUSPEND {
-    LOG(INFO) << "  Running with " << FLAGS_items << " items";
-
-    client = makeClient();
+    auto const allocationsAfter = allocationCount();
+    if (allocationsBefore && allocationsAfter) {
+      LOG(INFO) << "  Allocations per item: "
+                << static_cast<double>(*allocationsAfter - *allocationsBefore) /
+              (total * perStream);
+    }
+    fixture.reset();
   }
+}
 
-  client->getRequester()
-      ->requestStream(Payload("InMemoryStream"))
-      ->subscribe(std::make_shared<BoundedSubscriber>(latch, FLAGS_items));
+} // namespace
 
-  constexpr std::chrono::minutes timeout{5};
-  if (!latch.timed_wait(timeout)) {
-    LOG(ERROR) << "Timed out!";
-  }
-}
+BENCHMARK_NAMED_PARAM(streams, 1conn_1stream, 1, 1, 0)
+BENCHMARK_NAMED_PARAM(streams, 1conn_1stream_credits64, 1, 1, 64)
+BENCHMARK_NAMED_PARAM(streams, 1conn_1stream_credits1, 1, 1, 1)
+BENCHMARK_NAMED_PARAM(streams, 1conn_100streams_credits64, 1, 100, 64)
+BENCHMARK_NAMED_PARAM(streams, 1conn_1000streams_credits64, 1, 1000, 64)
+BENCHMARK_NAMED_PARAM(streams, 10conns_10streams_credits64, 10, 10, 64)
+BENCHMARK_NAMED_PARAM(streams, 100conns_1stream_credits64, 100, 1, 64)
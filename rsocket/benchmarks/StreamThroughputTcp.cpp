@@ -14,6 +14,7 @@
 
 #include "rsocket/benchmarks/Fixture.h"
 #include "rsocket/benchmarks/Throughput.h"
+#include "rsocket/benchmarks/Tls.h"
 
 #include <folly/Benchmark.h>
 #include <folly/portability/GFlags.h>
@@ -33,10 +34,12 @@ DEFINE_int32(
 DEFINE_int32(clients, 10, "number of clients to run");
 DEFINE_int32(items, 1000000, "number of items in stream, per client");
 DEFINE_int32(streams, 1, "number of streams, per client");
+DEFINE_bool(resumable, false, "whether the connections are resumable");
+DEFINE_bool(ktls, false, "whether the TLS clients ask for kTLS");
 
-BENCHMARK(StreamThroughput, n) {
-  (void)n;
+namespace {
 
+void streamThroughput(bool tls) {
   Latch latch{static_cast<size_t>(FLAGS_streams)};
 
   std::unique_ptr<Fixture> fixture;
@@ -48,14 +51,21 @@ BENCHMARK(StreamThroughput, n) {
 
     opts.serverThreads = FLAGS_server_threads;
     opts.clients = FLAGS_clients;
+    opts.resumable = FLAGS_resumable;
     if (FLAGS_override_client_threads > 0) {
       opts.clientThreads = FLAGS_override_client_threads;
     }
+    if (tls) {
+      opts.serverSslContext = makeServerTlsContext();
+      opts.clientSslContext = makeClientTlsContext();
+      opts.kernelTls = FLAGS_ktls;
+    }
 
     fixture = std::make_unique<Fixture>(opts, std::move(responder));
 
     LOG(INFO) << "Running:";
-    LOG(INFO) << "  Server with " << opts.serverThreads << " threads.";
+    LOG(INFO) << "  Server with " << opts.serverThreads << " threads"
+              << (tls ? ", over TLS." : ".");
     LOG(INFO) << "  " << opts.clients << " clients across "
               << fixture->workers.size() << " threads.";
     LOG(INFO) << "  Running " << FLAGS_streams << " streams of " << FLAGS_items
@@ -75,3 +85,15 @@ BENCHMARK(StreamThroughput, n) {
     LOG(ERROR) << "Timed out!";
   }
 }
+
+} // namespace
+
+BENCHMARK(StreamThroughput, n) {
+  (void)n;
+  streamThroughput(false);
+}
+
+BENCHMARK_RELATIVE(StreamThroughputTls, n) {
+  (void)n;
+  streamThroughput(true);
+}
@@ -14,6 +14,8 @@
 
 #pragma once
 
+#include <algorithm>
+
 #include "rsocket/RSocketResponder.h"
 #include "rsocket/benchmarks/Latch.h"
 
@@ -84,4 +86,67 @@ class BoundedSubscriber : public yarpl::flowable::BaseSubscriber<Payload> {
   size_t requested_{0};
   std::atomic<size_t> received_{0};
 };
+
+/// Subscriber that asks for `batch` items at a time, and for the next batch
+/// once all of the previous one arrived.  Signals a latch when it terminates.
+class BatchingSubscriber : public yarpl::flowable::BaseSubscriber<Payload> {
+ public:
+  BatchingSubscriber(Latch& latch, size_t batch)
+      : latch_{latch}, batch_{std::max<size_t>(batch, 1)} {}
+
+  void onSubscribeImpl() override {
+    this->request(batch_);
+  }
+
+  void onNextImpl(Payload) override {
+    if (++received_ == batch_) {
+      received_ = 0;
+      this->request(batch_);
+    }
+  }
+
+  void onCompleteImpl() override {
+    latch_.post();
+  }
+
+  void onErrorImpl(folly::exception_wrapper) override {
+    latch_.post();
+  }
+
+ private:
+  Latch& latch_;
+  const size_t batch_;
+  size_t received_{0};
+};
+
+/// Responder for channels that consumes the requests of a channel with a
+/// BatchingSubscriber, and sends back `count` copies of a message.
+class ChannelResponder : public RSocketResponder {
+ public:
+  ChannelResponder(
+      Latch& latch,
+      const std::string& message,
+      size_t count,
+      size_t batch)
+      : latch_{latch},
+        message_{folly::IOBuf::copyBuffer(message)},
+        count_{count},
+        batch_{batch} {}
+
+  std::shared_ptr<yarpl::flowable::Flowable<Payload>> handleRequestChannel(
+      Payload,
+      std::shared_ptr<yarpl::flowable::Flowable<Payload>> requests,
+      StreamId) override {
+    requests->subscribe(std::make_shared<BatchingSubscriber>(latch_, batch_));
+    return yarpl::flowable::Flowable<Payload>::fromGenerator(
+               [msg = message_->clone()] { return Payload(msg->clone()); })
+        ->take(count_);
+  }
+
+ private:
+  Latch& latch_;
+  std::unique_ptr<folly::IOBuf> message_;
+  const size_t count_;
+  const size_t batch_;
+};
 } // namespace rsocket
@@ -0,0 +1,85 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/benchmarks/Tls.h"
+
+#include <folly/portability/OpenSSL.h>
+#include <folly/ssl/OpenSSLPtrTypes.h>
+
+#include <stdexcept>
+
+namespace rsocket {
+
+namespace {
+
+void useSelfSignedCertificate(folly::SSLContext& context) {
+  folly::ssl::EvpPkeyCtxUniquePtr keyContext(
+      EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr));
+  EVP_PKEY* generated = nullptr;
+  if (!keyContext || EVP_PKEY_keygen_init(keyContext.get()) <= 0 ||
+      EVP_PKEY_CTX_set_ec_paramgen_curve_nid(
+          keyContext.get(), NID_X9_62_prime256v1) <= 0 ||
+      EVP_PKEY_keygen(keyContext.get(), &generated) <= 0) {
+    throw std::runtime_error("Cannot generate a TLS key");
+  }
+  folly::ssl::EvpPkeyUniquePtr key(generated);
+
+  folly::ssl::X509UniquePtr cert(X509_new());
+  X509_set_version(cert.get(), 2);
+  ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert.get()), 0);
+  X509_gmtime_adj(X509_getm_notAfter(cert.get()), 24 * 60 * 60);
+
+  auto const name = X509_get_subject_name(cert.get());
+  X509_NAME_add_entry_by_txt(
+      name,
+      "CN",
+      MBSTRING_ASC,
+      reinterpret_cast<const unsigned char*>("localhost"),
+      -1,
+      -1,
+      0);
+  X509_set_issuer_name(cert.get(), name);
+  X509_set_pubkey(cert.get(), key.get());
+
+  if (X509_sign(cert.get(), key.get(), EVP_sha256()) == 0 ||
+      SSL_CTX_use_certificate(context.getSSLCtx(), cert.get()) != 1 ||
+      SSL_CTX_use_PrivateKey(context.getSSLCtx(), key.get()) != 1) {
+    throw std::runtime_error("Cannot set up a self-signed TLS certificate");
+  }
+}
+
+} // namespace
+
+std::shared_ptr<folly::SSLContext> makeServerTlsContext(
+    const std::string& certPath,
+    const std::string& keyPath) {
+  auto context = std::make_shared<folly::SSLContext>();
+  if (certPath.empty() || keyPath.empty()) {
+    useSelfSignedCertificate(*context);
+  } else {
+    context->loadCertificate(certPath.c_str());
+    context->loadPrivateKey(keyPath.c_str());
+  }
+  return context;
+}
+
+std::shared_ptr<folly::SSLContext> makeClientTlsContext() {
+  auto context = std::make_shared<folly::SSLContext>();
+  context->setVerificationOption(
+      folly::SSLContext::SSLVerifyPeerEnum::NO_VERIFY);
+  return context;
+}
+
+} // namespace rsocket
@@ -0,0 +1,35 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/io/async/SSLContext.h>
+
+#include <memory>
+#include <string>
+
+namespace rsocket {
+
+/// Context for a benchmark server, with the certificate and private key read
+/// from the given PEM files.  Without them, uses a self-signed P-256
+/// certificate generated on the spot.
+std::shared_ptr<folly::SSLContext> makeServerTlsContext(
+    const std::string& certPath = "",
+    const std::string& keyPath = "");
+
+/// Context for benchmark clients.  Doesn't verify the server certificate, as
+/// the clients only ever talk to their own server.
+std::shared_ptr<folly::SSLContext> makeClientTlsContext();
+
+} // namespace rsocket
@@ -0,0 +1,222 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/benchmarks/Fixture.h"
+#include "rsocket/benchmarks/Throughput.h"
+#include "rsocket/benchmarks/Tls.h"
+
+#include <folly/Benchmark.h>
+#include <folly/portability/GFlags.h>
+#include <folly/portability/OpenSSL.h>
+#include <folly/synchronization/Baton.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "rsocket/RSocket.h"
+#include "rsocket/transports/tcp/TcpConnectionFactory.h"
+
+using namespace rsocket;
+
+DEFINE_int32(server_threads, 8, "number of server threads to run");
+DEFINE_int32(client_threads, 16, "number of threads opening connections");
+DEFINE_int32(handshakes, 20000, "number of TLS connections to open and close");
+DEFINE_string(
+    resumption,
+    "none",
+    "how sessions are resumed: none, cache (session ids looked up in the "
+    "server's cache) or ticket (session tickets)");
+DEFINE_bool(tls12, false, "cap the handshakes at TLS 1.2");
+DEFINE_string(
+    tls_cert,
+    "",
+    "PEM certificate of the server, self-signed if unset");
+DEFINE_string(tls_key, "", "PEM private key of the server");
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/// Sets up the server and client contexts for FLAGS_resumption.  Returns
+/// whether the clients resume sessions.
+bool configureResumption(folly::SSLContext& server, folly::SSLContext& client) {
+  auto const serverCtx = server.getSSLCtx();
+  server.setSessionCacheContext("TlsHandshakeTcp");
+
+  if (FLAGS_resumption == "none") {
+    SSL_CTX_set_session_cache_mode(serverCtx, SSL_SESS_CACHE_OFF);
+    SSL_CTX_set_options(serverCtx, SSL_OP_NO_TICKET);
+  } else if (FLAGS_resumption == "cache") {
+    SSL_CTX_set_options(serverCtx, SSL_OP_NO_TICKET);
+  } else if (FLAGS_resumption == "ticket") {
+    SSL_CTX_set_session_cache_mode(serverCtx, SSL_SESS_CACHE_OFF);
+  } else {
+    throw std::invalid_argument("Unknown --resumption " + FLAGS_resumption);
+  }
+
+  auto const resume = FLAGS_resumption != "none";
+  // TlsSessionCache only resumes TLS 1.2 sessions.
+  if (FLAGS_tls12 || resume) {
+    SSL_CTX_set_max_proto_version(client.getSSLCtx(), TLS1_2_VERSION);
+  }
+  return resume;
+}
+
+/// Opens a TLS connection from `evb` and waits until the server has processed
+/// its SETUP frame, by waiting for the response to a first request.
+std::shared_ptr<RSocketClient> connect(
+    folly::EventBase& evb,
+    const folly::SocketAddress& address,
+    const std::shared_ptr<folly::SSLContext>& sslContext,
+    const std::shared_ptr<TlsSessionCache>& tlsSessions) {
+  TcpConnectionFactory::Options options;
+  options.tlsSessions = tlsSessions;
+  auto client = RSocket::createConnectedClient(
+                    std::make_unique<TcpConnectionFactory>(
+                        evb,
+                        std::vector<folly::SocketAddress>{address},
+                        sslContext,
+                        TcpDuplexConnection::Options(),
+                        RSocketStats::noop(),
+                        std::move(options)))
+                    .get();
+
+  folly::Baton<> done;
+  client->getRequester()
+      ->requestResponse(Payload("TlsHandshakeTcp"))
+      ->subscribe(
+          [&](Payload) { done.post(); },
+          [&](folly::exception_wrapper ew) {
+            LOG(ERROR) << "First request failed: " << ew.what();
+            done.post();
+          });
+  done.wait();
+  return client;
+}
+
+/// Clients have to be destroyed on their EventBase.
+void disconnect(folly::EventBase& evb, std::shared_ptr<RSocketClient> client) {
+  evb.runInEventBaseThreadAndWait([c = std::move(client)] {});
+}
+
+void logLatencies(std::vector<Clock::duration> latencies) {
+  if (latencies.empty()) {
+    return;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  auto const at = [&](double quantile) {
+    auto const index = static_cast<size_t>(quantile * (latencies.size() - 1));
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               latencies[index])
+        .count();
+  };
+  LOG(INFO) << "  Handshake latency p50 " << at(0.5) << "us, p99 " << at(0.99)
+            << "us, max " << at(1.0) << "us";
+}
+
+} // namespace
+
+/// Opens and closes FLAGS_handshakes TLS connections as fast as the client
+/// threads can, each one after the previous one from the same thread is
+/// closed.  Every client thread keeps the session of its own connections,
+/// as a client process would.
+BENCHMARK(TlsHandshakeRate, n) {
+  (void)n;
+
+  std::unique_ptr<Fixture> fixture;
+  folly::SocketAddress address;
+  std::shared_ptr<folly::SSLContext> clientContext;
+  std::vector<std::shared_ptr<TlsSessionCache>> sessions;
+  std::vector<std::vector<Clock::duration>> latencies;
+
+  BENCHMARK_SUSPEND {
+    Fixture::Options opts;
+    opts.serverThreads = FLAGS_server_threads;
+    opts.clients = 0;
+    opts.clientThreads = static_cast<size_t>(FLAGS_client_threads);
+    opts.serverSslContext = makeServerTlsContext(FLAGS_tls_cert, FLAGS_tls_key);
+    opts.clientSslContext = makeClientTlsContext();
+    auto const resume =
+        configureResumption(*opts.serverSslContext, *opts.clientSslContext);
+    clientContext = opts.clientSslContext;
+
+    fixture = std::make_unique<Fixture>(
+        std::move(opts), std::make_shared<FixedResponder>("TlsHandshakeTcp"));
+    address =
+        folly::SocketAddress{"127.0.0.1", *fixture->server->listeningPort()};
+    for (size_t i = 0; i < fixture->workers.size(); ++i) {
+      sessions.push_back(
+          resume ? std::make_shared<TlsSessionCache>() : nullptr);
+    }
+    latencies.resize(fixture->workers.size());
+
+    LOG(INFO) << "Running:";
+    LOG(INFO) << "  Server with " << FLAGS_server_threads << " threads.";
+    LOG(INFO) << "  " << FLAGS_handshakes << " handshakes from "
+              << fixture->workers.size() << " threads, resumption "
+              << FLAGS_resumption << ".";
+  }
+
+  auto const workers = fixture->workers.size();
+  auto const total = static_cast<size_t>(FLAGS_handshakes);
+  auto const start = Clock::now();
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < workers; ++i) {
+    auto const count = total / workers + (i < total % workers ? 1 : 0);
+    threads.emplace_back([&, count, i] {
+      auto& evb = *fixture->workers[i]->getEventBase();
+      latencies[i].reserve(count);
+      for (size_t j = 0; j < count; ++j) {
+        auto const handshakeStart = Clock::now();
+        auto client = connect(evb, address, clientContext, sessions[i]);
+        latencies[i].push_back(Clock::now() - handshakeStart);
+        disconnect(evb, std::move(client));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  auto const elapsed = Clock::now() - start;
+
+  BENCHMARK_SUSPEND {
+    std::vector<Clock::duration> all;
+    for (auto& threadLatencies : latencies) {
+      all.insert(all.end(), threadLatencies.begin(), threadLatencies.end());
+    }
+    auto const seconds = std::chrono::duration<double>(elapsed).count();
+    LOG(INFO) << "  " << all.size() << " handshakes, "
+              << static_cast<size_t>(all.size() / seconds)
+              << " handshakes/sec";
+    logLatencies(std::move(all));
+
+    size_t resumed = 0;
+    size_t full = 0;
+    for (auto& cache : sessions) {
+      if (cache) {
+        resumed += cache->resumed();
+        full += cache->full();
+      }
+    }
+    if (resumed + full > 0) {
+      LOG(INFO) << "  " << resumed << " resumed and " << full
+                << " full handshakes";
+    }
+    fixture.reset();
+  }
+}
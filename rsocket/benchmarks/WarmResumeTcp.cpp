@@ -0,0 +1,208 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/benchmarks/Fixture.h"
+#include "rsocket/benchmarks/Throughput.h"
+
+#include <folly/Benchmark.h>
+#include <folly/futures/Future.h>
+#include <folly/portability/GFlags.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "rsocket/RSocket.h"
+#include "rsocket/internal/WarmResumeManager.h"
+
+using namespace rsocket;
+
+constexpr size_t kMessageLen = 32;
+
+DEFINE_int32(server_threads, 8, "number of server threads to run");
+DEFINE_int32(clients, 10, "number of clients to run");
+DEFINE_int32(items, 1000000, "number of items in stream, per client");
+DEFINE_int32(
+    disconnect_interval_ms,
+    100,
+    "time between forced disconnects of every client");
+DEFINE_int32(scale_clients, 2000, "number of clients resumed at once");
+DEFINE_int32(scale_client_threads, 16, "worker threads for the scale clients");
+
+namespace {
+
+std::atomic<size_t> replayedBytes{0};
+
+/// Server side resume manager that counts the bytes it replays.
+class CountingResumeManager : public WarmResumeManager {
+ public:
+  using WarmResumeManager::WarmResumeManager;
+
+  ResumePosition sendFramesFromPositionUpTo(
+      ResumePosition position,
+      FrameTransport& transport,
+      size_t maxBytes) const override {
+    auto const next = WarmResumeManager::sendFramesFromPositionUpTo(
+        position, transport, maxBytes);
+    replayedBytes += static_cast<size_t>(next - position);
+    return next;
+  }
+};
+
+Fixture::Options fixtureOptions() {
+  Fixture::Options opts;
+  opts.serverThreads = FLAGS_server_threads;
+  opts.clients = FLAGS_clients;
+  opts.resumable = true;
+  opts.resumeManagerFactory = [](std::shared_ptr<RSocketStats> stats) {
+    return std::make_shared<CountingResumeManager>(std::move(stats));
+  };
+  return opts;
+}
+
+/// Disconnects and resumes a client, returning how long it took.
+std::chrono::microseconds bounce(RSocketClient& client) {
+  const auto start = std::chrono::steady_clock::now();
+  client.disconnect(std::runtime_error("Benchmark triggered disconnect"))
+      .thenValue([&](auto&&) { return client.resume(); })
+      .get();
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start);
+}
+
+void logLatencies(std::vector<std::chrono::microseconds> latencies) {
+  if (latencies.empty()) {
+    LOG(INFO) << "  No resumptions.";
+    return;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  const auto at = [&](double quantile) {
+    return latencies[static_cast<size_t>(quantile * (latencies.size() - 1))]
+        .count();
+  };
+  LOG(INFO) << "  " << latencies.size() << " resumptions, reconnect latency"
+            << " p50 " << at(0.5) << "us, p99 " << at(0.99) << "us, max "
+            << latencies.back().count() << "us.";
+  LOG(INFO) << "  " << replayedBytes.load() << " bytes replayed.";
+}
+
+/// Streams FLAGS_items items to every client, optionally bouncing all the
+/// clients every FLAGS_disconnect_interval_ms.
+void runStreams(bool disconnect) {
+  Latch latch{static_cast<size_t>(FLAGS_clients)};
+  std::unique_ptr<Fixture> fixture;
+  std::vector<std::chrono::microseconds> latencies;
+
+  BENCHMARK_SUSPEND {
+    replayedBytes = 0;
+    fixture = std::make_unique<Fixture>(
+        fixtureOptions(),
+        std::make_shared<FixedResponder>(std::string(kMessageLen, 'a')));
+  }
+
+  for (auto& client : fixture->clients) {
+    client->getRequester()
+        ->requestStream(Payload("TcpStream"))
+        ->subscribe(std::make_shared<BoundedSubscriber>(latch, FLAGS_items));
+  }
+
+  constexpr std::chrono::minutes timeout{5};
+  const std::chrono::milliseconds interval{FLAGS_disconnect_interval_ms};
+  if (disconnect) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!latch.timed_wait(interval)) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        LOG(ERROR) << "Timed out!";
+        break;
+      }
+      for (auto& client : fixture->clients) {
+        latencies.push_back(bounce(*client));
+      }
+    }
+  } else if (!latch.timed_wait(timeout)) {
+    LOG(ERROR) << "Timed out!";
+  }
+
+  BENCHMARK_SUSPEND {
+    if (disconnect) {
+      logLatencies(std::move(latencies));
+    }
+    fixture.reset();
+  }
+}
+
+} // namespace
+
+BENCHMARK(StreamWithoutDisconnects, n) {
+  (void)n;
+  runStreams(false);
+}
+
+// The relative throughput is the throughput kept across the disconnects.
+BENCHMARK_RELATIVE(StreamWithDisconnects, n) {
+  (void)n;
+  runStreams(true);
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(ResumeManyClients, n) {
+  (void)n;
+
+  std::unique_ptr<Fixture> fixture;
+  std::vector<std::chrono::microseconds> latencies;
+
+  BENCHMARK_SUSPEND {
+    replayedBytes = 0;
+    auto opts = fixtureOptions();
+    opts.clients = FLAGS_scale_clients;
+    opts.clientThreads = FLAGS_scale_client_threads;
+    fixture = std::make_unique<Fixture>(
+        std::move(opts),
+        std::make_shared<FixedResponder>(std::string(kMessageLen, 'a')));
+
+    std::vector<folly::Future<folly::Unit>> disconnects;
+    for (auto& client : fixture->clients) {
+      disconnects.push_back(client->disconnect(
+          std::runtime_error("Benchmark triggered disconnect")));
+    }
+    folly::collectAll(std::move(disconnects)).get();
+    latencies.resize(fixture->clients.size());
+  }
+
+  // Every client resumes at once, as after a network partition heals.
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<folly::Future<folly::Unit>> resumes;
+  for (size_t i = 0; i < fixture->clients.size(); ++i) {
+    resumes.push_back(fixture->clients[i]->resume().thenValue(
+        [&latencies, i, start](folly::Unit) {
+          latencies[i] =
+              std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::steady_clock::now() - start);
+        }));
+  }
+  auto results = folly::collectAll(std::move(resumes)).get();
+
+  BENCHMARK_SUSPEND {
+    const auto failed = std::count_if(
+        results.begin(), results.end(), [](const folly::Try<folly::Unit>& t) {
+          return t.hasException();
+        });
+    if (failed > 0) {
+      LOG(ERROR) << failed << " clients failed to resume";
+    }
+    logLatencies(std::move(latencies));
+    fixture.reset();
+  }
+}
@@ -35,14 +35,15 @@ class HelloChannelRequestResponder : public rsocket::RSocketResponder {
       rsocket::Payload initialPayload,
       std::shared_ptr<Flowable<rsocket::Payload>> request,
       rsocket::StreamId) override {
-    std::cout << "Initial request " << initialPayload.cloneDataToString()
+    std::cout << "Initial request " << initialPayload.coalescedDataView()
               << std::endl;
 
     // say "Hello" to each name on the input stream
     return request->map([](Payload p) {
-      std::cout << "Request Stream: " << p.cloneDataToString() << std::endl;
+      auto const name = p.coalescedDataView();
+      std::cout << "Request Stream: " << name << std::endl;
       std::stringstream ss;
-      ss << "Hello " << p.moveDataToString() << "!";
+      ss << "Hello " << name << "!";
       std::string s = ss.str();
       return Payload(s);
     });
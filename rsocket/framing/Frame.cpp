@@ -20,24 +20,12 @@
 #include <sstream>
 
 #include "rsocket/RSocketParameters.h"
+#include "rsocket/internal/ByteCredit.h"
+#include "rsocket/internal/FrameChecksums.h"
+#include "rsocket/internal/PayloadCompressor.h"
 
 namespace rsocket {
 
-namespace detail {
-
-FrameFlags getFlags(const Payload& p) {
-  return p.metadata ? FrameFlags::METADATA : FrameFlags::EMPTY_;
-}
-
-void checkFlags(const Payload& p, FrameFlags flags) {
-  if (bool(p.metadata) != bool(flags & FrameFlags::METADATA)) {
-    throw std::invalid_argument{
-        "Value of METADATA flag doesn't match payload metadata"};
-  }
-}
-
-} // namespace detail
-
 constexpr uint32_t Frame_LEASE::kMaxTtl;
 constexpr uint32_t Frame_LEASE::kMaxNumRequests;
 constexpr uint32_t Frame_SETUP::kMaxKeepaliveTime;
@@ -161,14 +149,24 @@ std::ostream& operator<<(std::ostream& os, const Frame_SETUP& frame) {
 void Frame_SETUP::moveToSetupPayload(SetupParameters& setupPayload) {
   setupPayload.metadataMimeType = std::move(metadataMimeType_);
   setupPayload.dataMimeType = std::move(dataMimeType_);
+  setupPayload.payloadCompression =
+      PayloadCompressor::removeFromMimeType(setupPayload.dataMimeType);
+  setupPayload.byteCredit =
+      ByteCredit::removeFromMimeType(setupPayload.metadataMimeType);
+  setupPayload.frameChecksum =
+      FrameChecksums::removeFromMimeType(setupPayload.metadataMimeType);
+  setupPayload.capacityHints =
+      CapacityHints::removeFromMimeType(setupPayload.metadataMimeType);
   setupPayload.payload = std::move(payload_);
   setupPayload.token = std::move(token_);
   setupPayload.resumable = !!(header_.flags & FrameFlags::RESUME_ENABLE);
+  setupPayload.honorLease = !!(header_.flags & FrameFlags::LEASE);
   setupPayload.protocolVersion = ProtocolVersion(versionMajor_, versionMinor_);
 }
 
 std::ostream& operator<<(std::ostream& os, const Frame_LEASE& frame) {
-  return os << frame.header_ << ", ("
+  return os << frame.header_ << ", TTL: " << frame.ttl_
+            << "ms, Requests: " << frame.numberOfRequests_ << ", ("
             << (frame.metadata_ ? frame.metadata_->computeChainDataLength() : 0)
             << ")";
 }
@@ -184,6 +182,12 @@ std::ostream& operator<<(std::ostream& os, const Frame_RESUME_OK& frame) {
   return os << frame.header_ << ", (@" << frame.position_ << ")";
 }
 
+std::ostream& operator<<(std::ostream& os, const Frame_EXT& frame) {
+  return os << frame.header_ << ", extendedType=" << frame.extendedType_
+            << ", "
+            << (frame.data_ ? frame.data_->computeChainDataLength() : 0);
+}
+
 std::ostream& operator<<(std::ostream& os, const Frame_REQUEST_CHANNEL& frame) {
   return os << frame.header_ << ", initialRequestN=" << frame.requestN_ << ", "
             << frame.payload_;
@@ -42,9 +42,23 @@ namespace rsocket {
 
 namespace detail {
 
-FrameFlags getFlags(const Payload&);
-
-void checkFlags(const Payload&, FrameFlags);
+inline FrameFlags getFlags(const Payload& p) {
+  return p.metadata ? FrameFlags::METADATA : FrameFlags::EMPTY_;
+}
+
+/// Flags of a frame built to be sent: those of `flags` within `allowed`,
+/// with METADATA set from the payload instead of validated against it.  The
+/// frames decoded from a peer get their flags from deserializeFrom(), which
+/// does its own validation of the input.  Asking for METADATA without
+/// metadata is a bug, only caught in debug builds.
+inline FrameFlags payloadFrameFlags(
+    const Payload& payload,
+    FrameFlags flags,
+    FrameFlags allowed = ~FrameFlags::EMPTY_) {
+  DCHECK(!(flags & FrameFlags::METADATA) || payload.metadata)
+      << "METADATA flag set on a payload without metadata";
+  return (flags & allowed & ~FrameFlags::METADATA) | getFlags(payload);
+}
 
 } // namespace detail
 
@@ -90,10 +104,9 @@ class Frame_REQUEST_Base {
       FrameFlags flags,
       uint32_t requestN,
       Payload payload)
-      : header_(frameType, flags | detail::getFlags(payload), streamId),
+      : header_(frameType, detail::payloadFrameFlags(payload, flags), streamId),
         requestN_(requestN),
         payload_(std::move(payload)) {
-    detail::checkFlags(payload_, header_.flags);
     // TODO: DCHECK(requestN_ > 0);
     DCHECK(requestN_ <= Frame_REQUEST_N::kMaxRequestN);
   }
@@ -177,11 +190,9 @@ class Frame_REQUEST_RESPONSE {
   Frame_REQUEST_RESPONSE(StreamId streamId, FrameFlags flags, Payload payload)
       : header_(
             FrameType::REQUEST_RESPONSE,
-            (flags & AllowedFlags) | detail::getFlags(payload),
+            detail::payloadFrameFlags(payload, flags, AllowedFlags),
             streamId),
-        payload_(std::move(payload)) {
-    detail::checkFlags(payload_, header_.flags);
-  }
+        payload_(std::move(payload)) {}
 
   FrameHeader header_;
   Payload payload_;
@@ -197,11 +208,9 @@ class Frame_REQUEST_FNF {
   Frame_REQUEST_FNF(StreamId streamId, FrameFlags flags, Payload payload)
       : header_(
             FrameType::REQUEST_FNF,
-            (flags & AllowedFlags) | detail::getFlags(payload),
+            detail::payloadFrameFlags(payload, flags, AllowedFlags),
             streamId),
-        payload_(std::move(payload)) {
-    detail::checkFlags(payload_, header_.flags);
-  }
+        payload_(std::move(payload)) {}
 
   FrameHeader header_;
   Payload payload_;
@@ -214,7 +223,7 @@ class Frame_METADATA_PUSH {
   explicit Frame_METADATA_PUSH(std::unique_ptr<folly::IOBuf> metadata)
       : header_(FrameType::METADATA_PUSH, FrameFlags::METADATA, 0),
         metadata_(std::move(metadata)) {
-    CHECK(metadata_);
+    DCHECK(metadata_);
   }
 
   FrameHeader header_;
@@ -241,11 +250,9 @@ class Frame_PAYLOAD {
   Frame_PAYLOAD(StreamId streamId, FrameFlags flags, Payload payload)
       : header_(
             FrameType::PAYLOAD,
-            (flags & AllowedFlags) | detail::getFlags(payload),
+            detail::payloadFrameFlags(payload, flags, AllowedFlags),
             streamId),
-        payload_(std::move(payload)) {
-    detail::checkFlags(payload_, header_.flags);
-  }
+        payload_(std::move(payload)) {}
 
   static Frame_PAYLOAD complete(StreamId streamId);
 
@@ -334,7 +341,7 @@ class Frame_SETUP {
       Payload payload)
       : header_(
             FrameType::SETUP,
-            (flags & AllowedFlags) | detail::getFlags(payload),
+            detail::payloadFrameFlags(payload, flags, AllowedFlags),
             0),
         versionMajor_(versionMajor),
         versionMinor_(versionMinor),
@@ -344,7 +351,6 @@ class Frame_SETUP {
         metadataMimeType_(metadataMimeType),
         dataMimeType_(dataMimeType),
         payload_(std::move(payload)) {
-    detail::checkFlags(payload_, header_.flags);
     DCHECK(keepaliveTime_ > 0);
     DCHECK(maxLifetime_ > 0);
     DCHECK(keepaliveTime_ <= kMaxKeepaliveTime);
@@ -436,4 +442,24 @@ class Frame_RESUME_OK {
 };
 std::ostream& operator<<(std::ostream&, const Frame_RESUME_OK&);
 
+/// A frame of a protocol extension.  Peers that don't know its extended type
+/// ignore it if it has the IGNORE flag, and close the connection otherwise.
+class Frame_EXT {
+ public:
+  Frame_EXT() = default;
+  Frame_EXT(
+      StreamId streamId,
+      FrameFlags flags,
+      uint32_t extendedType,
+      std::unique_ptr<folly::IOBuf> data)
+      : header_(FrameType::EXT, flags & FrameFlags::IGNORE_, streamId),
+        extendedType_(extendedType),
+        data_(std::move(data)) {}
+
+  FrameHeader header_;
+  uint32_t extendedType_{};
+  std::unique_ptr<folly::IOBuf> data_;
+};
+std::ostream& operator<<(std::ostream&, const Frame_EXT&);
+
 } // namespace rsocket
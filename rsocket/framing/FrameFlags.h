@@ -40,6 +40,12 @@ enum class FrameFlags : uint16_t {
 
   // PAYLOAD.
   NEXT = 0x20,
+
+  // REQUEST_RESPONSE, REQUEST_STREAM, REQUEST_CHANNEL, REQUEST_N, CANCEL,
+  // PAYLOAD, ERROR.  An extension of this library, not part of the protocol:
+  // marks the frames of a stream that is dropped instead of resumed, which
+  // neither peer counts towards its resume position.
+  UNTRACKED = 0x01,
 };
 
 constexpr uint16_t raw(FrameFlags flags) {
@@ -42,6 +42,10 @@ class FrameHeader {
     return !!(flags & FrameFlags::FOLLOWS);
   }
 
+  bool flagsUntracked() const {
+    return !!(flags & FrameFlags::UNTRACKED);
+  }
+
   FrameType type{FrameType::RESERVED};
   FrameFlags flags{FrameFlags::EMPTY_};
   StreamId streamId{0};
@@ -17,6 +17,17 @@
 
 namespace rsocket {
 
+namespace {
+
+const FrameSerializer* makeSharedV1_0(bool preallocateFrameSizeField) {
+  // Leaked, connections may still be torn down during static destruction.
+  auto const serializer = new FrameSerializerV1_0();
+  serializer->preallocateFrameSizeField() = preallocateFrameSizeField;
+  return serializer;
+}
+
+} // namespace
+
 std::unique_ptr<FrameSerializer> FrameSerializer::createFrameSerializer(
     const ProtocolVersion& protocolVersion) {
   if (protocolVersion == FrameSerializerV1_0::Version) {
@@ -35,13 +46,39 @@ std::unique_ptr<FrameSerializer> FrameSerializer::createAutodetectedSerializer(
   return createFrameSerializer(detectedVersion);
 }
 
+const FrameSerializer* FrameSerializer::shared(
+    const ProtocolVersion& protocolVersion,
+    bool preallocateFrameSizeField) {
+  if (protocolVersion == FrameSerializerV1_0::Version) {
+    static const auto framed = makeSharedV1_0(true);
+    static const auto unframed = makeSharedV1_0(false);
+    return preallocateFrameSizeField ? framed : unframed;
+  }
+
+  DCHECK(protocolVersion == ProtocolVersion::Unknown);
+  LOG_IF(ERROR, protocolVersion != ProtocolVersion::Unknown)
+      << "unknown protocol version " << protocolVersion;
+  return nullptr;
+}
+
+const FrameSerializer* FrameSerializer::sharedAutodetected(
+    const folly::IOBuf& firstFrame,
+    bool preallocateFrameSizeField) {
+  return shared(
+      FrameSerializerV1_0::detectProtocolVersion(firstFrame),
+      preallocateFrameSizeField);
+}
+
 bool& FrameSerializer::preallocateFrameSizeField() {
   return preallocateFrameSizeField_;
 }
 
+size_t FrameSerializer::frameLengthPrependSize() const {
+  return preallocateFrameSizeField_ ? frameLengthFieldSize() : 0;
+}
+
 folly::IOBufQueue FrameSerializer::createBufferQueue(size_t bufferSize) const {
-  const auto prependSize =
-      preallocateFrameSizeField_ ? frameLengthFieldSize() : 0;
+  const auto prependSize = frameLengthPrependSize();
   auto buf = folly::IOBuf::createCombined(bufferSize + prependSize);
   buf->advance(prependSize);
   folly::IOBufQueue queue(folly::IOBufQueue::cacheChainLength());
@@ -22,6 +22,21 @@
 
 namespace rsocket {
 
+/// Headroom to leave in front of a serialized frame so that a framed
+/// connection can write the frame length field of any protocol version in
+/// place, rather than chaining a buffer of its own in front of the frame.
+constexpr size_t kFrameLengthFieldHeadroom = sizeof(uint32_t);
+
+/// A frame header decoded ahead of the rest of the frame, so that it can be
+/// inspected and then handed back to deserializeFrom() without being parsed a
+/// second time.
+struct DecodedFrameHeader {
+  FrameHeader header;
+
+  /// Offset of the first byte after the header, from the start of the frame.
+  size_t bodyOffset{0};
+};
+
 // interface separating serialization/deserialization of ReactiveSocket frames
 class FrameSerializer {
  public:
@@ -35,6 +50,18 @@ class FrameSerializer {
   static std::unique_ptr<FrameSerializer> createAutodetectedSerializer(
       const folly::IOBuf& firstFrame);
 
+  /// Serializers hold no state other than preallocateFrameSizeField(), so a
+  /// connection doesn't need one of its own.  Returns the serializer of the
+  /// protocol version with the given setting, shared by every connection and
+  /// never destroyed, or nullptr for an unknown version.
+  static const FrameSerializer* shared(
+      const ProtocolVersion& protocolVersion,
+      bool preallocateFrameSizeField);
+
+  static const FrameSerializer* sharedAutodetected(
+      const folly::IOBuf& firstFrame,
+      bool preallocateFrameSizeField);
+
   static folly::Optional<StreamId> peekStreamId(
       const ProtocolVersion& protocolVersion,
       const folly::IOBuf& frame,
@@ -45,6 +72,18 @@ class FrameSerializer {
       const folly::IOBuf& in,
       bool skipFrameLengthBytes) const = 0;
 
+  /// Decodes the type, flags and stream id of a frame in a single pass.
+  /// Returns folly::none if the header is truncated or malformed.
+  virtual folly::Optional<DecodedFrameHeader> decodeFrameHeader(
+      const folly::IOBuf& in) const = 0;
+
+  /// Replaces the stream id in the header of a serialized frame, leaving the
+  /// rest of the frame untouched.  The frame must hold at least a header, see
+  /// decodeFrameHeader().
+  virtual std::unique_ptr<folly::IOBuf> rewriteStreamId(
+      std::unique_ptr<folly::IOBuf> frame,
+      StreamId streamId) const = 0;
+
   virtual std::unique_ptr<folly::IOBuf> serializeOut(
       Frame_REQUEST_STREAM&&) const = 0;
   virtual std::unique_ptr<folly::IOBuf> serializeOut(
@@ -67,6 +106,7 @@ class FrameSerializer {
   virtual std::unique_ptr<folly::IOBuf> serializeOut(Frame_RESUME&&) const = 0;
   virtual std::unique_ptr<folly::IOBuf> serializeOut(
       Frame_RESUME_OK&&) const = 0;
+  virtual std::unique_ptr<folly::IOBuf> serializeOut(Frame_EXT&&) const = 0;
 
   virtual bool deserializeFrom(
       Frame_REQUEST_STREAM&,
@@ -101,13 +141,66 @@ class FrameSerializer {
       const = 0;
   virtual bool deserializeFrom(Frame_RESUME_OK&, std::unique_ptr<folly::IOBuf>)
       const = 0;
+  virtual bool deserializeFrom(Frame_EXT&, std::unique_ptr<folly::IOBuf>)
+      const = 0;
+
+  // Overloads for the frames of stream traffic that take a header already
+  // decoded by decodeFrameHeader(), and only parse the frame body.
+  virtual bool deserializeFrom(
+      Frame_REQUEST_STREAM&,
+      std::unique_ptr<folly::IOBuf>,
+      const DecodedFrameHeader&) const = 0;
+  virtual bool deserializeFrom(
+      Frame_REQUEST_CHANNEL&,
+      std::unique_ptr<folly::IOBuf>,
+      const DecodedFrameHeader&) const = 0;
+  virtual bool deserializeFrom(
+      Frame_REQUEST_RESPONSE&,
+      std::unique_ptr<folly::IOBuf>,
+      const DecodedFrameHeader&) const = 0;
+  virtual bool deserializeFrom(
+      Frame_REQUEST_FNF&,
+      std::unique_ptr<folly::IOBuf>,
+      const DecodedFrameHeader&) const = 0;
+  virtual bool deserializeFrom(
+      Frame_REQUEST_N&,
+      std::unique_ptr<folly::IOBuf>,
+      const DecodedFrameHeader&) const = 0;
+  virtual bool deserializeFrom(
+      Frame_CANCEL&,
+      std::unique_ptr<folly::IOBuf>,
+      const DecodedFrameHeader&) const = 0;
+  virtual bool deserializeFrom(
+      Frame_PAYLOAD&,
+      std::unique_ptr<folly::IOBuf>,
+      const DecodedFrameHeader&) const = 0;
+  virtual bool deserializeFrom(
+      Frame_ERROR&,
+      std::unique_ptr<folly::IOBuf>,
+      const DecodedFrameHeader&) const = 0;
 
   virtual size_t frameLengthFieldSize() const = 0;
+
+  /// Whether to leave room for the frame length field in front of every
+  /// serialized frame.  Must be set for framed connections, so that framing a
+  /// frame doesn't allocate.
   bool& preallocateFrameSizeField();
 
+  /// Whether this is an instance of the final FrameSerializerV1_0 class.  See
+  /// visitFrameSerializer().
+  bool isV1_0() const {
+    return isV1_0_;
+  }
+
  protected:
   folly::IOBufQueue createBufferQueue(size_t bufferSize) const;
 
+  /// Number of bytes to leave in front of a serialized frame for the frame
+  /// length field.
+  size_t frameLengthPrependSize() const;
+
+  bool isV1_0_{false};
+
  private:
   bool preallocateFrameSizeField_{false};
 };
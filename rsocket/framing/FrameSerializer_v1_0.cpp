@@ -14,13 +14,17 @@
 
 #include "rsocket/framing/FrameSerializer_v1_0.h"
 
+#include <folly/hash/Checksum.h>
 #include <folly/io/Cursor.h>
 
+#include <algorithm>
+
 namespace rsocket {
 
 constexpr const ProtocolVersion FrameSerializerV1_0::Version;
 constexpr const size_t FrameSerializerV1_0::kFrameHeaderSize;
 constexpr const size_t FrameSerializerV1_0::kMinBytesNeededForAutodetection;
+constexpr const size_t FrameSerializerV1_0::kChecksumSize;
 
 namespace {
 constexpr const uint32_t kMedatadaLengthSize = 3u; // bytes
@@ -31,17 +35,8 @@ ProtocolVersion FrameSerializerV1_0::protocolVersion() const {
   return Version;
 }
 
-static FrameType deserializeFrameType(uint16_t frameType) {
-  if (frameType > static_cast<uint8_t>(FrameType::RESUME_OK) &&
-      frameType != static_cast<uint8_t>(FrameType::EXT)) {
-    return FrameType::RESERVED;
-  }
-  return static_cast<FrameType>(frameType);
-}
-
-static void serializeHeaderInto(
-    folly::io::QueueAppender& appender,
-    const FrameHeader& header) {
+template <typename Writer>
+static void serializeHeaderInto(Writer& appender, const FrameHeader& header) {
   appender.writeBE<int32_t>(static_cast<int32_t>(header.streamId));
 
   auto type = static_cast<uint8_t>(header.type); // 6 bit
@@ -62,24 +57,33 @@ static void deserializeHeaderFrom(folly::io::Cursor& cur, FrameHeader& header) {
       static_cast<FrameFlags>(((type & 0x3) << 8) | cur.readBE<uint8_t>());
 }
 
-static void serializeMetadataInto(
-    folly::io::QueueAppender& appender,
-    std::unique_ptr<folly::IOBuf> metadata) {
-  if (metadata == nullptr) {
-    return;
-  }
-
+static uint32_t metadataLengthOf(const folly::IOBuf& metadata) {
   // metadata length field not included in the medatadata length
   uint32_t metadataLength =
-      static_cast<uint32_t>(metadata->computeChainDataLength());
+      static_cast<uint32_t>(metadata.computeChainDataLength());
   CHECK_LT(metadataLength, kMaxMetadataLength)
       << "Metadata is too big to serialize";
+  return metadataLength;
+}
 
+template <typename Writer>
+static void serializeMetadataLengthInto(
+    Writer& appender,
+    uint32_t metadataLength) {
   appender.write(static_cast<uint8_t>(metadataLength >> 16)); // first byte
   appender.write(
       static_cast<uint8_t>((metadataLength >> 8) & 0xFF)); // second byte
   appender.write(static_cast<uint8_t>(metadataLength & 0xFF)); // third byte
+}
+
+static void serializeMetadataInto(
+    folly::io::QueueAppender& appender,
+    std::unique_ptr<folly::IOBuf> metadata) {
+  if (metadata == nullptr) {
+    return;
+  }
 
+  serializeMetadataLengthInto(appender, metadataLengthOf(*metadata));
   appender.insert(std::move(metadata));
 }
 
@@ -103,12 +107,22 @@ std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::deserializeMetadataFrom(
   return metadata;
 }
 
+/// Reads the rest of the frame `in`, which `cur` is reading from.  The data
+/// runs to the end of the frame, so when the frame is a single buffer it is
+/// trimmed and handed out as is, instead of being cloned.  `cur` must not be
+/// used afterwards.
 static std::unique_ptr<folly::IOBuf> deserializeDataFrom(
-    folly::io::Cursor& cur) {
+    folly::io::Cursor& cur,
+    std::unique_ptr<folly::IOBuf>& in) {
   std::unique_ptr<folly::IOBuf> data;
   auto totalLength = cur.totalLength();
 
   if (totalLength > 0) {
+    if (in && !in->isChained()) {
+      in->trimStart(cur.getCurrentPosition());
+      DCHECK_EQ(totalLength, in->length());
+      return std::move(in);
+    }
     cur.clone(data, totalLength);
   }
   return data;
@@ -116,12 +130,30 @@ static std::unique_ptr<folly::IOBuf> deserializeDataFrom(
 
 static Payload deserializePayloadFrom(
     folly::io::Cursor& cur,
+    std::unique_ptr<folly::IOBuf>& in,
     FrameFlags flags) {
   auto metadata = FrameSerializerV1_0::deserializeMetadataFrom(cur, flags);
-  auto data = deserializeDataFrom(cur);
+  auto data = deserializeDataFrom(cur, in);
   return Payload(std::move(data), std::move(metadata));
 }
 
+/// Reads a resume token, copying it straight out of the frame when it is in
+/// one buffer.
+static void deserializeTokenFrom(
+    folly::io::Cursor& cur,
+    ResumeIdentificationToken& token) {
+  auto const size = cur.readBE<uint16_t>();
+  auto const bytes = cur.peekBytes();
+  if (bytes.size() >= size) {
+    token.set(bytes.subpiece(0, size));
+    cur.skip(size);
+    return;
+  }
+  std::vector<uint8_t> data(size);
+  cur.pull(data.data(), data.size());
+  token.set(std::move(data));
+}
+
 static void serializePayloadInto(
     folly::io::QueueAppender& appender,
     Payload&& payload) {
@@ -135,8 +167,65 @@ static uint32_t payloadFramingSize(const Payload& payload) {
   return (payload.metadata != nullptr ? kMedatadaLengthSize : 0);
 }
 
+/// Appends the data after the metadata of a frame.  Small data is copied into
+/// the tailroom of the metadata buffer when it fits, so that the frame goes
+/// out as a single buffer.
+static void appendDataTo(
+    folly::IOBuf& frame,
+    std::unique_ptr<folly::IOBuf> data) {
+  auto const length = data->computeChainDataLength();
+  if (length > Payload::kSmallPayloadSize || frame.isChained() ||
+      frame.tailroom() < length) {
+    frame.prependChain(std::move(data));
+    return;
+  }
+  folly::io::Cursor(data.get()).pull(frame.writableTail(), length);
+  frame.append(length);
+}
+
+std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeIntoHeadroom(
+    const FrameHeader& header,
+    folly::Optional<uint32_t> requestN,
+    Payload& payload) const {
+  // The header goes in front of the metadata if there is any, otherwise in
+  // front of the data.
+  auto& target = payload.metadata ? payload.metadata : payload.data;
+  const size_t headerSize = kFrameHeaderSize +
+      (requestN ? sizeof(uint32_t) : 0) + payloadFramingSize(payload);
+
+  if (!target || target->isSharedOne() ||
+      target->headroom() < headerSize + frameLengthPrependSize()) {
+    return nullptr;
+  }
+
+  const bool hasMetadata = payload.metadata != nullptr;
+  const auto metadataLength = hasMetadata ? metadataLengthOf(*target) : 0;
+
+  auto frame = std::move(target);
+  frame->prepend(headerSize);
+
+  folly::io::RWPrivateCursor cur(frame.get());
+  serializeHeaderInto(cur, header);
+  if (requestN) {
+    cur.writeBE<int32_t>(static_cast<int32_t>(*requestN));
+  }
+
+  if (hasMetadata) {
+    serializeMetadataLengthInto(cur, metadataLength);
+    if (payload.data) {
+      appendDataTo(*frame, std::move(payload.data));
+    }
+  }
+  return frame;
+}
+
 std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeOutInternal(
     Frame_REQUEST_Base&& frame) const {
+  if (auto buf = serializeIntoHeadroom(
+          frame.header_, frame.requestN_, frame.payload_)) {
+    return buf;
+  }
+
   auto queue = createBufferQueue(
       FrameSerializerV1_0::kFrameHeaderSize + sizeof(uint32_t) +
       payloadFramingSize(frame.payload_));
@@ -149,20 +238,88 @@ std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeOutInternal(
   return queue.move();
 }
 
+static void deserializeBodyFrom(
+    folly::io::Cursor& cur,
+    std::unique_ptr<folly::IOBuf>& in,
+    Frame_REQUEST_Base& frame) {
+  auto requestN = cur.readBE<int32_t>();
+  // TODO(lehecka): requestN <= 0
+  if (requestN < 0) {
+    throw std::runtime_error("invalid request N");
+  }
+  frame.requestN_ = static_cast<uint32_t>(requestN);
+  frame.payload_ = deserializePayloadFrom(cur, in, frame.header_.flags);
+}
+
+static void deserializeBodyFrom(
+    folly::io::Cursor& cur,
+    std::unique_ptr<folly::IOBuf>& in,
+    Frame_REQUEST_RESPONSE& frame) {
+  frame.payload_ = deserializePayloadFrom(cur, in, frame.header_.flags);
+}
+
+static void deserializeBodyFrom(
+    folly::io::Cursor& cur,
+    std::unique_ptr<folly::IOBuf>& in,
+    Frame_REQUEST_FNF& frame) {
+  frame.payload_ = deserializePayloadFrom(cur, in, frame.header_.flags);
+}
+
+static void deserializeBodyFrom(
+    folly::io::Cursor& cur,
+    std::unique_ptr<folly::IOBuf>&,
+    Frame_REQUEST_N& frame) {
+  auto requestN = cur.readBE<int32_t>();
+  if (requestN <= 0) {
+    throw std::runtime_error("invalid request n");
+  }
+  frame.requestN_ = static_cast<uint32_t>(requestN);
+}
+
+static void deserializeBodyFrom(
+    folly::io::Cursor&,
+    std::unique_ptr<folly::IOBuf>&,
+    Frame_CANCEL&) {}
+
+static void deserializeBodyFrom(
+    folly::io::Cursor& cur,
+    std::unique_ptr<folly::IOBuf>& in,
+    Frame_PAYLOAD& frame) {
+  frame.payload_ = deserializePayloadFrom(cur, in, frame.header_.flags);
+}
+
+static void deserializeBodyFrom(
+    folly::io::Cursor& cur,
+    std::unique_ptr<folly::IOBuf>& in,
+    Frame_ERROR& frame) {
+  frame.errorCode_ = static_cast<ErrorCode>(cur.readBE<uint32_t>());
+  frame.payload_ = deserializePayloadFrom(cur, in, frame.header_.flags);
+}
+
+template <typename TFrame>
 static bool deserializeFromInternal(
-    Frame_REQUEST_Base& frame,
+    TFrame& frame,
     std::unique_ptr<folly::IOBuf> in) {
   folly::io::Cursor cur(in.get());
   try {
     deserializeHeaderFrom(cur, frame.header_);
+    deserializeBodyFrom(cur, in, frame);
+  } catch (...) {
+    return false;
+  }
+  return true;
+}
 
-    auto requestN = cur.readBE<int32_t>();
-    // TODO(lehecka): requestN <= 0
-    if (requestN < 0) {
-      throw std::runtime_error("invalid request N");
-    }
-    frame.requestN_ = static_cast<uint32_t>(requestN);
-    frame.payload_ = deserializePayloadFrom(cur, frame.header_.flags);
+template <typename TFrame>
+static bool deserializeFromInternal(
+    TFrame& frame,
+    std::unique_ptr<folly::IOBuf> in,
+    const DecodedFrameHeader& decoded) {
+  folly::io::Cursor cur(in.get());
+  try {
+    cur.skip(decoded.bodyOffset);
+    frame.header_ = decoded.header;
+    deserializeBodyFrom(cur, in, frame);
   } catch (...) {
     return false;
   }
@@ -177,7 +334,86 @@ static size_t getResumeIdTokenFramingLength(
       : 0;
 }
 
-FrameType FrameSerializerV1_0::peekFrameType(const folly::IOBuf& in) const {
+bool FrameSerializerV1_0::carriesChecksum(const folly::IOBuf& frame) {
+  uint8_t type;
+  if (FOLLY_LIKELY(frame.length() > sizeof(int32_t))) {
+    type = frame.data()[sizeof(int32_t)];
+  } else {
+    folly::io::Cursor cur(&frame);
+    if (!cur.canAdvance(sizeof(int32_t) + 1)) {
+      // Too short for a header, removeChecksum() rejects it.
+      return true;
+    }
+    cur.skip(sizeof(int32_t));
+    type = cur.read<uint8_t>();
+  }
+  switch (deserializeFrameType(type >> 2)) {
+    case FrameType::SETUP:
+    case FrameType::RESUME:
+    case FrameType::RESUME_OK:
+      return false;
+    default:
+      return true;
+  }
+}
+
+uint32_t FrameSerializerV1_0::checksum(
+    const folly::IOBuf& frame,
+    size_t length) {
+  // folly::crc32c() uses the SSE4.2 or ARMv8 CRC instructions when the CPU
+  // has them, and takes the running value of the previous buffers.
+  uint32_t crc = ~0U;
+  for (auto range : frame) {
+    if (length == 0) {
+      break;
+    }
+    auto const size = std::min(range.size(), length);
+    crc = folly::crc32c(range.data(), size, crc);
+    length -= size;
+  }
+  DCHECK_EQ(length, 0);
+  return crc;
+}
+
+void FrameSerializerV1_0::appendChecksum(folly::IOBuf& frame) {
+  auto const crc = checksum(frame, frame.computeChainDataLength());
+  auto const last = frame.prev();
+  if (last->tailroom() < kChecksumSize || last->isSharedOne()) {
+    frame.prependChain(folly::IOBuf::create(kChecksumSize));
+  }
+  folly::io::Appender appender(&frame, 0);
+  appender.writeBE<uint32_t>(crc);
+}
+
+bool FrameSerializerV1_0::removeChecksum(folly::IOBuf& frame) {
+  auto const length = frame.computeChainDataLength();
+  if (length < kFrameHeaderSize + kChecksumSize) {
+    return false;
+  }
+  auto const bodyLength = length - kChecksumSize;
+  folly::io::Cursor cur(&frame);
+  cur.skip(bodyLength);
+  if (cur.readBE<uint32_t>() != checksum(frame, bodyLength)) {
+    return false;
+  }
+
+  // Trim the trailer off the end of the chain, dropping the buffers it
+  // empties.
+  size_t remaining = kChecksumSize;
+  while (remaining > 0) {
+    auto const last = frame.prev();
+    auto const trimmed = std::min(last->length(), remaining);
+    last->trimEnd(trimmed);
+    remaining -= trimmed;
+    if (last->length() == 0 && last != &frame) {
+      last->unlink();
+    }
+  }
+  return true;
+}
+
+FrameType FrameSerializerV1_0::peekFrameTypeSlow(
+    const folly::IOBuf& in) const {
   folly::io::Cursor cur(&in);
   try {
     cur.skip(sizeof(int32_t)); // streamId
@@ -188,7 +424,7 @@ FrameType FrameSerializerV1_0::peekFrameType(const folly::IOBuf& in) const {
   }
 }
 
-folly::Optional<StreamId> FrameSerializerV1_0::peekStreamId(
+folly::Optional<StreamId> FrameSerializerV1_0::peekStreamIdSlow(
     const folly::IOBuf& in,
     bool skipFrameLengthBytes) const {
   folly::io::Cursor cur(&in);
@@ -206,6 +442,47 @@ folly::Optional<StreamId> FrameSerializerV1_0::peekStreamId(
   }
 }
 
+folly::Optional<DecodedFrameHeader> FrameSerializerV1_0::decodeFrameHeaderSlow(
+    const folly::IOBuf& in) const {
+  folly::io::Cursor cur(&in);
+  try {
+    DecodedFrameHeader decoded;
+    deserializeHeaderFrom(cur, decoded.header);
+    decoded.bodyOffset = kFrameHeaderSize;
+    return decoded;
+  } catch (...) {
+    return folly::none;
+  }
+}
+
+std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::rewriteStreamId(
+    std::unique_ptr<folly::IOBuf> frame,
+    StreamId streamId) const {
+  DCHECK_LE(
+      streamId, static_cast<StreamId>(std::numeric_limits<int32_t>::max()));
+
+  if (frame->length() < sizeof(uint32_t)) {
+    frame->gather(sizeof(uint32_t));
+  }
+  if (frame->isSharedOne()) {
+    // Others can see the buffer, so put the stream id in a buffer of its own
+    // in front of the rest of the frame instead.
+    auto rest = std::move(frame);
+    rest->trimStart(sizeof(uint32_t));
+    frame = folly::IOBuf::create(frameLengthPrependSize() + sizeof(uint32_t));
+    frame->advance(frameLengthPrependSize());
+    frame->append(sizeof(uint32_t));
+    frame->prependChain(std::move(rest));
+  }
+
+  auto const data = frame->writableData();
+  data[0] = static_cast<uint8_t>(streamId >> 24);
+  data[1] = static_cast<uint8_t>(streamId >> 16);
+  data[2] = static_cast<uint8_t>(streamId >> 8);
+  data[3] = static_cast<uint8_t>(streamId);
+  return frame;
+}
+
 std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeOut(
     Frame_REQUEST_STREAM&& frame) const {
   return serializeOutInternal(std::move(frame));
@@ -218,6 +495,11 @@ std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeOut(
 
 std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeOut(
     Frame_REQUEST_RESPONSE&& frame) const {
+  if (auto buf =
+          serializeIntoHeadroom(frame.header_, folly::none, frame.payload_)) {
+    return buf;
+  }
+
   auto queue =
       createBufferQueue(kFrameHeaderSize + payloadFramingSize(frame.payload_));
   folly::io::QueueAppender appender(&queue, /* do not grow */ 0);
@@ -228,6 +510,11 @@ std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeOut(
 
 std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeOut(
     Frame_REQUEST_FNF&& frame) const {
+  if (auto buf =
+          serializeIntoHeadroom(frame.header_, folly::none, frame.payload_)) {
+    return buf;
+  }
+
   auto queue =
       createBufferQueue(kFrameHeaderSize + payloadFramingSize(frame.payload_));
   folly::io::QueueAppender appender(&queue, /* do not grow */ 0);
@@ -266,6 +553,11 @@ std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeOut(
 
 std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeOut(
     Frame_PAYLOAD&& frame) const {
+  if (auto buf =
+          serializeIntoHeadroom(frame.header_, folly::none, frame.payload_)) {
+    return buf;
+  }
+
   auto queue =
       createBufferQueue(kFrameHeaderSize + payloadFramingSize(frame.payload_));
   folly::io::QueueAppender appender(&queue, /* do not grow */ 0);
@@ -385,6 +677,18 @@ std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeOut(
   return queue.move();
 }
 
+std::unique_ptr<folly::IOBuf> FrameSerializerV1_0::serializeOut(
+    Frame_EXT&& frame) const {
+  auto queue = createBufferQueue(kFrameHeaderSize + sizeof(uint32_t));
+  folly::io::QueueAppender appender(&queue, /* do not grow */ 0);
+  serializeHeaderInto(appender, frame.header_);
+  appender.writeBE<uint32_t>(frame.extendedType_);
+  if (frame.data_) {
+    appender.insert(std::move(frame.data_));
+  }
+  return queue.move();
+}
+
 bool FrameSerializerV1_0::deserializeFrom(
     Frame_REQUEST_STREAM& frame,
     std::unique_ptr<folly::IOBuf> in) const {
@@ -400,44 +704,19 @@ bool FrameSerializerV1_0::deserializeFrom(
 bool FrameSerializerV1_0::deserializeFrom(
     Frame_REQUEST_RESPONSE& frame,
     std::unique_ptr<folly::IOBuf> in) const {
-  folly::io::Cursor cur(in.get());
-  try {
-    deserializeHeaderFrom(cur, frame.header_);
-    frame.payload_ = deserializePayloadFrom(cur, frame.header_.flags);
-  } catch (...) {
-    return false;
-  }
-  return true;
+  return deserializeFromInternal(frame, std::move(in));
 }
 
 bool FrameSerializerV1_0::deserializeFrom(
     Frame_REQUEST_FNF& frame,
     std::unique_ptr<folly::IOBuf> in) const {
-  folly::io::Cursor cur(in.get());
-  try {
-    deserializeHeaderFrom(cur, frame.header_);
-    frame.payload_ = deserializePayloadFrom(cur, frame.header_.flags);
-  } catch (...) {
-    return false;
-  }
-  return true;
+  return deserializeFromInternal(frame, std::move(in));
 }
 
 bool FrameSerializerV1_0::deserializeFrom(
     Frame_REQUEST_N& frame,
     std::unique_ptr<folly::IOBuf> in) const {
-  folly::io::Cursor cur(in.get());
-  try {
-    deserializeHeaderFrom(cur, frame.header_);
-    auto requestN = cur.readBE<int32_t>();
-    if (requestN <= 0) {
-      throw std::runtime_error("invalid request n");
-    }
-    frame.requestN_ = static_cast<uint32_t>(requestN);
-  } catch (...) {
-    return false;
-  }
-  return true;
+  return deserializeFromInternal(frame, std::move(in));
 }
 
 bool FrameSerializerV1_0::deserializeFrom(
@@ -448,7 +727,7 @@ bool FrameSerializerV1_0::deserializeFrom(
     deserializeHeaderFrom(cur, frame.header_);
     // metadata takes the rest of the frame, just like data in other frames
     // that's why we use deserializeDataFrom
-    frame.metadata_ = deserializeDataFrom(cur);
+    frame.metadata_ = deserializeDataFrom(cur, in);
   } catch (...) {
     return false;
   }
@@ -458,40 +737,75 @@ bool FrameSerializerV1_0::deserializeFrom(
 bool FrameSerializerV1_0::deserializeFrom(
     Frame_CANCEL& frame,
     std::unique_ptr<folly::IOBuf> in) const {
-  folly::io::Cursor cur(in.get());
-  try {
-    deserializeHeaderFrom(cur, frame.header_);
-  } catch (...) {
-    return false;
-  }
-  return true;
+  return deserializeFromInternal(frame, std::move(in));
 }
 
 bool FrameSerializerV1_0::deserializeFrom(
     Frame_PAYLOAD& frame,
     std::unique_ptr<folly::IOBuf> in) const {
-  folly::io::Cursor cur(in.get());
-  try {
-    deserializeHeaderFrom(cur, frame.header_);
-    frame.payload_ = deserializePayloadFrom(cur, frame.header_.flags);
-  } catch (...) {
-    return false;
-  }
-  return true;
+  return deserializeFromInternal(frame, std::move(in));
 }
 
 bool FrameSerializerV1_0::deserializeFrom(
     Frame_ERROR& frame,
     std::unique_ptr<folly::IOBuf> in) const {
-  folly::io::Cursor cur(in.get());
-  try {
-    deserializeHeaderFrom(cur, frame.header_);
-    frame.errorCode_ = static_cast<ErrorCode>(cur.readBE<uint32_t>());
-    frame.payload_ = deserializePayloadFrom(cur, frame.header_.flags);
-  } catch (...) {
-    return false;
-  }
-  return true;
+  return deserializeFromInternal(frame, std::move(in));
+}
+
+bool FrameSerializerV1_0::deserializeFrom(
+    Frame_REQUEST_STREAM& frame,
+    std::unique_ptr<folly::IOBuf> in,
+    const DecodedFrameHeader& header) const {
+  return deserializeFromInternal(frame, std::move(in), header);
+}
+
+bool FrameSerializerV1_0::deserializeFrom(
+    Frame_REQUEST_CHANNEL& frame,
+    std::unique_ptr<folly::IOBuf> in,
+    const DecodedFrameHeader& header) const {
+  return deserializeFromInternal(frame, std::move(in), header);
+}
+
+bool FrameSerializerV1_0::deserializeFrom(
+    Frame_REQUEST_RESPONSE& frame,
+    std::unique_ptr<folly::IOBuf> in,
+    const DecodedFrameHeader& header) const {
+  return deserializeFromInternal(frame, std::move(in), header);
+}
+
+bool FrameSerializerV1_0::deserializeFrom(
+    Frame_REQUEST_FNF& frame,
+    std::unique_ptr<folly::IOBuf> in,
+    const DecodedFrameHeader& header) const {
+  return deserializeFromInternal(frame, std::move(in), header);
+}
+
+bool FrameSerializerV1_0::deserializeFrom(
+    Frame_REQUEST_N& frame,
+    std::unique_ptr<folly::IOBuf> in,
+    const DecodedFrameHeader& header) const {
+  return deserializeFromInternal(frame, std::move(in), header);
+}
+
+bool FrameSerializerV1_0::deserializeFrom(
+    Frame_CANCEL& frame,
+    std::unique_ptr<folly::IOBuf> in,
+    const DecodedFrameHeader& header) const {
+  return deserializeFromInternal(frame, std::move(in), header);
+}
+
+bool FrameSerializerV1_0::deserializeFrom(
+    Frame_PAYLOAD& frame,
+    std::unique_ptr<folly::IOBuf> in,
+    const DecodedFrameHeader& header) const {
+  return deserializeFromInternal(frame, std::move(in), header);
+}
+
+bool FrameSerializerV1_0::deserializeFrom(
+    Frame_ERROR& frame,
+    std::unique_ptr<folly::IOBuf> in,
+    const DecodedFrameHeader& header) const {
+  return deserializeFromInternal(frame, std::move(in), header);
 }
 
 bool FrameSerializerV1_0::deserializeFrom(
@@ -505,7 +819,7 @@ bool FrameSerializerV1_0::deserializeFrom(
       throw std::runtime_error("invalid value for position");
     }
     frame.position_ = static_cast<ResumePosition>(position);
-    frame.data_ = deserializeDataFrom(cur);
+    frame.data_ = deserializeDataFrom(cur, in);
   } catch (...) {
     return false;
   }
@@ -535,10 +849,7 @@ bool FrameSerializerV1_0::deserializeFrom(
     frame.maxLifetime_ = static_cast<uint32_t>(maxLifetime);
 
     if (!!(frame.header_.flags & FrameFlags::RESUME_ENABLE)) {
-      auto resumeTokenSize = cur.readBE<uint16_t>();
-      std::vector<uint8_t> data(resumeTokenSize);
-      cur.pull(data.data(), data.size());
-      frame.token_.set(std::move(data));
+      deserializeTokenFrom(cur, frame.token_);
     } else {
       frame.token_ = ResumeIdentificationToken();
     }
@@ -548,7 +859,7 @@ bool FrameSerializerV1_0::deserializeFrom(
 
     auto dmtLen = cur.readBE<uint8_t>();
     frame.dataMimeType_ = cur.readFixedString(dmtLen);
-    frame.payload_ = deserializePayloadFrom(cur, frame.header_.flags);
+    frame.payload_ = deserializePayloadFrom(cur, in, frame.header_.flags);
   } catch (...) {
     return false;
   }
@@ -573,7 +884,7 @@ bool FrameSerializerV1_0::deserializeFrom(
       throw std::runtime_error("invalid numberOfRequests value");
     }
     frame.numberOfRequests_ = static_cast<uint32_t>(numberOfRequests);
-    frame.metadata_ = deserializeDataFrom(cur);
+    frame.metadata_ = deserializeDataFrom(cur, in);
   } catch (...) {
     return false;
   }
@@ -589,10 +900,7 @@ bool FrameSerializerV1_0::deserializeFrom(
     frame.versionMajor_ = cur.readBE<uint16_t>();
     frame.versionMinor_ = cur.readBE<uint16_t>();
 
-    auto resumeTokenSize = cur.readBE<uint16_t>();
-    std::vector<uint8_t> data(resumeTokenSize);
-    cur.pull(data.data(), data.size());
-    frame.token_.set(std::move(data));
+    deserializeTokenFrom(cur, frame.token_);
 
     auto lastReceivedServerPosition = cur.readBE<int64_t>();
     if (lastReceivedServerPosition < 0) {
@@ -630,6 +938,20 @@ bool FrameSerializerV1_0::deserializeFrom(
   return true;
 }
 
+bool FrameSerializerV1_0::deserializeFrom(
+    Frame_EXT& frame,
+    std::unique_ptr<folly::IOBuf> in) const {
+  folly::io::Cursor cur(in.get());
+  try {
+    deserializeHeaderFrom(cur, frame.header_);
+    frame.extendedType_ = cur.readBE<uint32_t>();
+    frame.data_ = deserializeDataFrom(cur, in);
+  } catch (...) {
+    return false;
+  }
+  return true;
+}
+
 ProtocolVersion FrameSerializerV1_0::detectProtocolVersion(
     const folly::IOBuf& firstFrame,
     size_t skipBytes) {
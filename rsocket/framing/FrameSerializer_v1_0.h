@@ -14,26 +14,93 @@
 
 #pragma once
 
+#include <limits>
+
+#include <folly/Likely.h>
+
 #include "rsocket/framing/FrameSerializer.h"
 
 namespace rsocket {
 
-class FrameSerializerV1_0 : public FrameSerializer {
+class FrameSerializerV1_0 final : public FrameSerializer {
  public:
   constexpr static const ProtocolVersion Version = ProtocolVersion(1, 0);
   constexpr static const size_t kFrameHeaderSize = 6; // bytes
   constexpr static const size_t kMinBytesNeededForAutodetection = 10; // bytes
 
+  FrameSerializerV1_0() {
+    isV1_0_ = true;
+  }
+
   ProtocolVersion protocolVersion() const override;
 
   static ProtocolVersion detectProtocolVersion(
       const folly::IOBuf& firstFrame,
       size_t skipBytes = 0);
 
-  FrameType peekFrameType(const folly::IOBuf& in) const override;
+  // The peek methods are defined inline so that they compile down to a couple
+  // of loads when the header is in the first buffer and the call is
+  // devirtualized.
+
+  FrameType peekFrameType(const folly::IOBuf& in) const override {
+    if (FOLLY_LIKELY(in.length() >= kFrameHeaderSize)) {
+      // |Frame Type |I|M| is the fifth byte, after the stream id.
+      return deserializeFrameType(in.data()[sizeof(int32_t)] >> 2);
+    }
+    return peekFrameTypeSlow(in);
+  }
+
   folly::Optional<StreamId> peekStreamId(
       const folly::IOBuf& in,
-      bool skipFrameLengthBytes) const override;
+      bool skipFrameLengthBytes) const override {
+    const size_t offset = skipFrameLengthBytes ? 3 : 0;
+    if (FOLLY_LIKELY(in.length() >= offset + sizeof(int32_t))) {
+      const auto data = in.data() + offset;
+      const uint32_t streamId = (static_cast<uint32_t>(data[0]) << 24) |
+          (static_cast<uint32_t>(data[1]) << 16) |
+          (static_cast<uint32_t>(data[2]) << 8) |
+          static_cast<uint32_t>(data[3]);
+      if (streamId >
+          static_cast<uint32_t>(std::numeric_limits<int32_t>::max())) {
+        return folly::none;
+      }
+      return folly::make_optional(static_cast<StreamId>(streamId));
+    }
+    return peekStreamIdSlow(in, skipFrameLengthBytes);
+  }
+
+  folly::Optional<DecodedFrameHeader> decodeFrameHeader(
+      const folly::IOBuf& in) const override {
+    if (FOLLY_LIKELY(in.length() >= kFrameHeaderSize)) {
+      const auto data = in.data();
+      if (data[0] & 0x80) {
+        return folly::none; // negative stream id
+      }
+      DecodedFrameHeader decoded;
+      decoded.header.streamId = (static_cast<StreamId>(data[0]) << 24) |
+          (static_cast<StreamId>(data[1]) << 16) |
+          (static_cast<StreamId>(data[2]) << 8) |
+          static_cast<StreamId>(data[3]);
+      decoded.header.type = deserializeFrameType(data[4] >> 2);
+      decoded.header.flags =
+          static_cast<FrameFlags>(((data[4] & 0x3) << 8) | data[5]);
+      decoded.bodyOffset = kFrameHeaderSize;
+      return decoded;
+    }
+    return decodeFrameHeaderSlow(in);
+  }
+
+  std::unique_ptr<folly::IOBuf> rewriteStreamId(
+      std::unique_ptr<folly::IOBuf> frame,
+      StreamId streamId) const override;
+
+  static FrameType deserializeFrameType(uint16_t frameType) {
+    if (frameType > static_cast<uint8_t>(FrameType::RESUME_OK) &&
+        frameType != static_cast<uint8_t>(FrameType::EXT)) {
+      return FrameType::RESERVED;
+    }
+    return static_cast<FrameType>(frameType);
+  }
 
   std::unique_ptr<folly::IOBuf> serializeOut(
       Frame_REQUEST_STREAM&&) const override;
@@ -54,6 +121,7 @@ class FrameSerializerV1_0 : public FrameSerializer {
   std::unique_ptr<folly::IOBuf> serializeOut(Frame_LEASE&&) const override;
   std::unique_ptr<folly::IOBuf> serializeOut(Frame_RESUME&&) const override;
   std::unique_ptr<folly::IOBuf> serializeOut(Frame_RESUME_OK&&) const override;
+  std::unique_ptr<folly::IOBuf> serializeOut(Frame_EXT&&) const override;
 
   bool deserializeFrom(Frame_REQUEST_STREAM&, std::unique_ptr<folly::IOBuf>)
       const override;
@@ -83,15 +151,104 @@ class FrameSerializerV1_0 : public FrameSerializer {
       const override;
   bool deserializeFrom(Frame_RESUME_OK&, std::unique_ptr<folly::IOBuf>)
       const override;
+  bool deserializeFrom(Frame_EXT&, std::unique_ptr<folly::IOBuf>)
+      const override;
+
+  bool deserializeFrom(
+      Frame_REQUEST_STREAM&,
+      std::unique_ptr<folly::IOBuf>,
+      const DecodedFrameHeader&) const override;
+  bool deserializeFrom(
+      Frame_REQUEST_CHANNEL&,
+      std::unique_ptr<folly::IOBuf>,
+      const DecodedFrameHeader&) const override;
+  bool deserializeFrom(
+      Frame_REQUEST_RESPONSE&,
+      std::unique_ptr<folly::IOBuf>,
+      const DecodedFrameHeader&) const override;
+  bool deserializeFrom(
+      Frame_REQUEST_FNF&,
+      std::unique_ptr<folly::IOBuf>,
+      const DecodedFrameHeader&) const override;
+  bool deserializeFrom(
+      Frame_REQUEST_N&,
+      std::unique_ptr<folly::IOBuf>,
+      const DecodedFrameHeader&) const override;
+  bool deserializeFrom(
+      Frame_CANCEL&,
+      std::unique_ptr<folly::IOBuf>,
+      const DecodedFrameHeader&) const override;
+  bool deserializeFrom(
+      Frame_PAYLOAD&,
+      std::unique_ptr<folly::IOBuf>,
+      const DecodedFrameHeader&) const override;
+  bool deserializeFrom(
+      Frame_ERROR&,
+      std::unique_ptr<folly::IOBuf>,
+      const DecodedFrameHeader&) const override;
+
+  /// Size of the CRC32C trailer that ends every frame of a connection which
+  /// negotiated frame checksums, see FrameChecksums.  The trailer counts in
+  /// the frame length.
+  static constexpr size_t kChecksumSize = sizeof(uint32_t);
+
+  /// Whether a frame gets the checksum trailer on such a connection.  SETUP,
+  /// RESUME and RESUME_OK never do, as they are exchanged before both ends
+  /// know about checksums.
+  static bool carriesChecksum(const folly::IOBuf& frame);
+
+  /// CRC32C of the first `length` bytes of a frame, computed buffer by buffer
+  /// over its chain.
+  static uint32_t checksum(const folly::IOBuf& frame, size_t length);
+
+  /// Appends the checksum trailer to a frame.  Writes it in the tailroom of
+  /// the last buffer when that buffer isn't shared, so that most frames
+  /// don't grow their chain.
+  static void appendChecksum(folly::IOBuf& frame);
+
+  /// Checks the checksum trailer of a frame and trims it off.  Returns false,
+  /// leaving the frame as it was, if the frame is too short to have one or
+  /// the checksum doesn't match.
+  static bool removeChecksum(folly::IOBuf& frame);
 
   static std::unique_ptr<folly::IOBuf> deserializeMetadataFrom(
       folly::io::Cursor& cur,
       FrameFlags flags);
 
  private:
+  FrameType peekFrameTypeSlow(const folly::IOBuf& in) const;
+  folly::Optional<StreamId> peekStreamIdSlow(
+      const folly::IOBuf& in,
+      bool skipFrameLengthBytes) const;
+  folly::Optional<DecodedFrameHeader> decodeFrameHeaderSlow(
+      const folly::IOBuf& in) const;
+
   std::unique_ptr<folly::IOBuf> serializeOutInternal(
       Frame_REQUEST_Base&& frame) const;
 
+  /// Writes the frame header directly into the headroom of the payload's
+  /// first buffer, producing the frame without allocating a header buffer.
+  /// Returns nullptr and leaves the payload untouched if the buffer is shared
+  /// or lacks the headroom.
+  std::unique_ptr<folly::IOBuf> serializeIntoHeadroom(
+      const FrameHeader& header,
+      folly::Optional<uint32_t> requestN,
+      Payload& payload) const;
+
   size_t frameLengthFieldSize() const override;
 };
+
+/// Invokes `fn` with the serializer cast to its concrete type when it is a
+/// FrameSerializerV1_0, and with the FrameSerializer interface otherwise.
+/// FrameSerializerV1_0 is final, so calls `fn` makes on it are direct calls
+/// the compiler is free to inline.  `fn` is expected to be a generic lambda.
+template <typename Serializer, typename Fn>
+auto visitFrameSerializer(Serializer& serializer, Fn&& fn)
+    -> decltype(fn(serializer)) {
+  if (FOLLY_LIKELY(serializer.isV1_0())) {
+    return fn(static_cast<const FrameSerializerV1_0&>(serializer));
+  }
+  return fn(serializer);
+}
+
 } // namespace rsocket
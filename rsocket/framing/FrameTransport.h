@@ -16,6 +16,8 @@
 
 #include <folly/io/IOBuf.h>
 
+#include <vector>
+
 #include "rsocket/DuplexConnection.h"
 #include "rsocket/framing/FrameProcessor.h"
 
@@ -27,6 +29,12 @@ class FrameTransport {
   virtual ~FrameTransport() = default;
   virtual void setFrameProcessor(std::shared_ptr<FrameProcessor>) = 0;
   virtual void outputFrameOrDrop(std::unique_ptr<folly::IOBuf>) = 0;
+  virtual void outputFramesOrDrop(
+      std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+    for (auto& frame : frames) {
+      outputFrameOrDrop(std::move(frame));
+    }
+  }
   virtual void close() = 0;
 
   // Just for observation purposes!
@@ -34,5 +42,43 @@ class FrameTransport {
   virtual DuplexConnection* getConnection() = 0;
 
   virtual bool isConnectionFramed() const = 0;
+
+  /// See DuplexConnection::bufferedInputBytes().  Zero when the connection
+  /// runs on another thread and can't be inspected.
+  virtual size_t bufferedInputBytes() const {
+    return 0;
+  }
+
+  /// See DuplexConnection::bufferedOutputBytes(), with the same caveat.
+  virtual size_t bufferedOutputBytes() const {
+    return 0;
+  }
+
+  /// See DuplexConnection::setOutputWrittenCallback().  Ignored when the
+  /// connection runs on another thread.
+  virtual void setOutputWrittenCallback(std::function<void()>) {}
+
+  /// See DuplexConnection::transportInfo().  Unknown when the connection
+  /// runs on another thread.
+  virtual DuplexConnection::TransportInfo transportInfo() const {
+    return DuplexConnection::TransportInfo();
+  }
+
+  /// See DuplexConnection::supportsFrameChecksums() and
+  /// enableFrameChecksums().
+  virtual bool supportsFrameChecksums() const {
+    return false;
+  }
+  virtual void enableFrameChecksums() {}
+
+  /// See DuplexConnection::isDetachable().  False when the connection runs
+  /// on another thread.
+  virtual bool isDetachable() const {
+    return false;
+  }
+
+  /// See DuplexConnection::detachEventBase() and attachEventBase().
+  virtual void detachEventBase() {}
+  virtual void attachEventBase(folly::EventBase&) {}
 };
 } // namespace rsocket
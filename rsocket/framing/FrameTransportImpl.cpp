@@ -16,11 +16,16 @@
 
 #include <folly/ExceptionWrapper.h>
 #include <folly/io/IOBuf.h>
+#include <folly/tracing/StaticTracepoint.h>
 #include <glog/logging.h>
 
 #include "rsocket/DuplexConnection.h"
 #include "rsocket/framing/FrameProcessor.h"
 
+// Set while a tracer is attached to the probe, so that the length of the
+// frames read is only computed then.
+FOLLY_SDT_DEFINE_SEMAPHORE(rsocket, frame_read)
+
 namespace rsocket {
 
 using namespace yarpl::flowable;
@@ -68,6 +73,8 @@ void FrameTransportImpl::close() {
   if (!connection_) {
     return;
   }
+  outputWritten_ = nullptr;
+  flushOutputBatch();
   connection_.reset();
 
   if (auto subscription = std::move(connectionInputSub_)) {
@@ -88,10 +95,29 @@ void FrameTransportImpl::onSubscribe(
 }
 
 void FrameTransportImpl::onNext(std::unique_ptr<folly::IOBuf> frame) {
+  if (FOLLY_SDT_IS_ENABLED(rsocket, frame_read)) {
+    FOLLY_SDT_WITH_SEMAPHORE(
+        rsocket, frame_read, this, frame->computeChainDataLength());
+  }
   // Copy in case frame processing calls through to close().
-  if (auto const processor = frameProcessor_) {
+  auto const processor = frameProcessor_;
+  if (!processor) {
+    return;
+  }
+
+  // Frames may be processed within another processing pass if processing
+  // feeds input to the connection, only the outermost pass flushes.
+  if (processing_) {
     processor->processFrame(std::move(frame));
+    return;
   }
+
+  // Processing may drop the last reference to this instance.
+  auto const self = shared_from_this();
+  processing_ = true;
+  processor->processFrame(std::move(frame));
+  processing_ = false;
+  flushOutputBatch();
 }
 
 void FrameTransportImpl::terminateProcessor(folly::exception_wrapper ex) {
@@ -123,8 +149,62 @@ void FrameTransportImpl::onError(folly::exception_wrapper ex) {
 
 void FrameTransportImpl::outputFrameOrDrop(
     std::unique_ptr<folly::IOBuf> frame) {
+  auto const length = frame->computeChainDataLength();
+  FOLLY_SDT(rsocket, frame_write, this, length);
+  if (!connection_) {
+    return;
+  }
+  if (processing_) {
+    outputBatchBytes_ += length;
+    outputBatch_.push_back(std::move(frame));
+    return;
+  }
+  connection_->send(std::move(frame));
+}
+
+void FrameTransportImpl::outputFramesOrDrop(
+    std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+  FOLLY_SDT(rsocket, frames_write, this, frames.size());
+  if (!connection_) {
+    return;
+  }
+  if (processing_) {
+    for (auto& frame : frames) {
+      outputBatchBytes_ += frame->computeChainDataLength();
+      outputBatch_.push_back(std::move(frame));
+    }
+    return;
+  }
+  connection_->sendBatch(std::move(frames));
+}
+
+void FrameTransportImpl::flushOutputBatch() {
+  if (outputBatch_.empty()) {
+    return;
+  }
+  auto frames = std::move(outputBatch_);
+  outputBatch_.clear();
+  outputBatchBytes_ = 0;
+  if (!connection_) {
+    return;
+  }
+  if (frames.size() == 1) {
+    connection_->send(std::move(frames.front()));
+  } else {
+    connection_->sendBatch(std::move(frames));
+  }
+  if (outputWritten_) {
+    // Copy in case the callback closes this instance.
+    auto const outputWritten = outputWritten_;
+    outputWritten();
+  }
+}
+
+void FrameTransportImpl::setOutputWrittenCallback(
+    std::function<void()> callback) {
+  outputWritten_ = callback;
   if (connection_) {
-    connection_->send(std::move(frame));
+    connection_->setOutputWrittenCallback(std::move(callback));
   }
 }
 
@@ -38,9 +38,18 @@ class FrameTransportImpl
 
   /// Writes the frame directly to output. If the connection was closed it will
   /// drop the frame.
+  ///
+  /// Frames written while a received frame is being processed are held back,
+  /// and handed to DuplexConnection::sendBatch() together once processing is
+  /// done.
   void outputFrameOrDrop(std::unique_ptr<folly::IOBuf>) override;
 
-  /// Cancel the input and close the underlying connection.
+  /// Writes the frames to output in a single batch, see
+  /// DuplexConnection::sendBatch().
+  void outputFramesOrDrop(std::vector<std::unique_ptr<folly::IOBuf>>) override;
+
+  /// Sends the frames held back, then cancels the input and closes the
+  /// underlying connection.
   void close() override;
 
   bool isClosed() const {
@@ -53,6 +62,53 @@ class FrameTransportImpl
 
   bool isConnectionFramed() const override;
 
+  size_t bufferedInputBytes() const override {
+    return connection_ ? connection_->bufferedInputBytes() : 0;
+  }
+
+  /// Includes the frames held back until the end of the current processing
+  /// pass.
+  size_t bufferedOutputBytes() const override {
+    return outputBatchBytes_ +
+        (connection_ ? connection_->bufferedOutputBytes() : 0);
+  }
+
+  /// Also runs the callback once the frames held back during a processing
+  /// pass are handed to the connection.
+  void setOutputWrittenCallback(std::function<void()> callback) override;
+
+  DuplexConnection::TransportInfo transportInfo() const override {
+    return connection_ ? connection_->transportInfo()
+                       : DuplexConnection::TransportInfo();
+  }
+
+  bool supportsFrameChecksums() const override {
+    return connection_ && connection_->supportsFrameChecksums();
+  }
+
+  void enableFrameChecksums() override {
+    if (connection_) {
+      connection_->enableFrameChecksums();
+    }
+  }
+
+  /// Not while frames are held back during a processing pass.
+  bool isDetachable() const override {
+    return !processing_ && outputBatch_.empty() && connection_ &&
+        connection_->isDetachable();
+  }
+
+  void detachEventBase() override {
+    DCHECK(isDetachable());
+    connection_->detachEventBase();
+  }
+
+  void attachEventBase(folly::EventBase& eventBase) override {
+    if (connection_) {
+      connection_->attachEventBase(eventBase);
+    }
+  }
+
   // Subscriber.
 
   void onSubscribe(std::shared_ptr<yarpl::flowable::Subscription>) override;
@@ -67,11 +123,24 @@ class FrameTransportImpl
   /// processor is set, overwriting any previously queued exception.
   void terminateProcessor(folly::exception_wrapper);
 
+  /// Sends the frames held back during a processing pass.
+  void flushOutputBatch();
+
   std::shared_ptr<FrameProcessor> frameProcessor_;
   std::shared_ptr<DuplexConnection> connection_;
 
   std::shared_ptr<DuplexConnection::Subscriber> connectionOutput_;
   std::shared_ptr<yarpl::flowable::Subscription> connectionInputSub_;
+
+  /// Whether a received frame is being processed, which holds back output
+  /// until it is done.
+  bool processing_{false};
+
+  /// Frames written during the current processing pass, and their bytes.
+  std::vector<std::unique_ptr<folly::IOBuf>> outputBatch_;
+  size_t outputBatchBytes_{0};
+
+  std::function<void()> outputWritten_;
 };
 
 } // namespace rsocket
@@ -14,6 +14,7 @@
 
 #include "rsocket/framing/FramedDuplexConnection.h"
 #include <folly/io/Cursor.h>
+#include <folly/io/IOBufQueue.h>
 #include "rsocket/framing/FrameSerializer_v1_0.h"
 #include "rsocket/framing/FramedReader.h"
 
@@ -23,6 +24,11 @@ namespace {
 
 constexpr auto kMaxFrameLength = 0xFFFFFF; // 24bit max value
 
+/// Frames of a batch up to this many bytes are copied into shared output
+/// blocks of kOutputBlockSize bytes, longer ones are chained as they are.
+constexpr size_t kCoalescedFrameLength = 512;
+constexpr size_t kOutputBlockSize = 16 * 1024;
+
 template <typename TWriter>
 void writeFrameLength(
     TWriter& cur,
@@ -63,6 +69,8 @@ std::unique_ptr<folly::IOBuf> prependSize(
       << "payloadLength: " << payloadLength
       << " kMaxFrameLength: " << kMaxFrameLength;
 
+  // Serializers and resume managers leave headroom for the field, so this
+  // only allocates for frames made elsewhere.
   if (payload->headroom() >= frameSizeFieldLength) {
     // move the data pointer back and write value to the payload
     payload->prepend(frameSizeFieldLength);
@@ -90,22 +98,87 @@ FramedDuplexConnection::~FramedDuplexConnection() {}
 FramedDuplexConnection::FramedDuplexConnection(
     std::unique_ptr<DuplexConnection> connection,
     ProtocolVersion protocolVersion)
+    : FramedDuplexConnection(
+          std::move(connection),
+          protocolVersion,
+          FramedReader::Options()) {}
+
+FramedDuplexConnection::FramedDuplexConnection(
+    std::unique_ptr<DuplexConnection> connection,
+    ProtocolVersion protocolVersion,
+    FramedReader::Options readerOptions)
     : inner_(std::move(connection)),
-      protocolVersion_(std::make_shared<ProtocolVersion>(protocolVersion)) {}
+      protocolVersion_(std::make_shared<ProtocolVersion>(protocolVersion)),
+      readerOptions_(std::move(readerOptions)) {}
 
 void FramedDuplexConnection::send(std::unique_ptr<folly::IOBuf> buf) {
   if (!inner_) {
     return;
   }
 
+  if (frameChecksums_ && FrameSerializerV1_0::carriesChecksum(*buf)) {
+    FrameSerializerV1_0::appendChecksum(*buf);
+  }
   auto sized = prependSize(*protocolVersion_, std::move(buf));
   inner_->send(std::move(sized));
 }
 
+void FramedDuplexConnection::sendBatch(
+    std::vector<std::unique_ptr<folly::IOBuf>> bufs) {
+  if (!inner_ || bufs.empty()) {
+    return;
+  }
+
+  const auto frameSizeFieldLength = getFrameSizeFieldLength(*protocolVersion_);
+  folly::IOBufQueue output;
+  folly::io::QueueAppender appender(&output, kOutputBlockSize);
+  for (auto& buf : bufs) {
+    CHECK(buf);
+    const auto length = buf->computeChainDataLength();
+    const bool checksum =
+        frameChecksums_ && FrameSerializerV1_0::carriesChecksum(*buf);
+    if (length > kCoalescedFrameLength) {
+      if (checksum) {
+        FrameSerializerV1_0::appendChecksum(*buf);
+      }
+      appender.insert(prependSize(*protocolVersion_, std::move(buf)));
+      continue;
+    }
+    // A burst of small frames ends up in a handful of buffers, rather than
+    // one (or two, with the length field) per frame.
+    writeFrameLength(
+        appender,
+        checksum ? length + FrameSerializerV1_0::kChecksumSize : length,
+        frameSizeFieldLength);
+    for (auto range : *buf) {
+      appender.push(range.data(), range.size());
+    }
+    if (checksum) {
+      appender.writeBE<uint32_t>(FrameSerializerV1_0::checksum(*buf, length));
+    }
+  }
+  inner_->send(output.move());
+}
+
+void FramedDuplexConnection::enableFrameChecksums() {
+  frameChecksums_ = true;
+  if (inputReader_) {
+    inputReader_->enableFrameChecksums();
+  }
+}
+
+size_t FramedDuplexConnection::bufferedInputBytes() const {
+  return inputReader_ ? inputReader_->bufferedBytes() : 0;
+}
+
 void FramedDuplexConnection::setInput(
     std::shared_ptr<DuplexConnection::Subscriber> framesSink) {
   if (!inputReader_) {
-    inputReader_ = std::make_shared<FramedReader>(protocolVersion_);
+    inputReader_ =
+        std::make_shared<FramedReader>(protocolVersion_, readerOptions_);
+    if (frameChecksums_) {
+      inputReader_->enableFrameChecksums();
+    }
     inner_->setInput(inputReader_);
   }
   inputReader_->setInput(std::move(framesSink));
@@ -15,29 +15,74 @@
 #pragma once
 
 #include "rsocket/DuplexConnection.h"
+#include "rsocket/framing/FramedReader.h"
 #include "rsocket/internal/Common.h"
 
 namespace rsocket {
 
-class FramedReader;
-struct ProtocolVersion;
-
 class FramedDuplexConnection : public virtual DuplexConnection {
  public:
   FramedDuplexConnection(
       std::unique_ptr<DuplexConnection> connection,
       ProtocolVersion protocolVersion);
+  FramedDuplexConnection(
+      std::unique_ptr<DuplexConnection> connection,
+      ProtocolVersion protocolVersion,
+      FramedReader::Options readerOptions);
 
   ~FramedDuplexConnection();
 
   void send(std::unique_ptr<folly::IOBuf>) override;
 
+  /// Prepends every frame with its length and sends them to the inner
+  /// connection as a single chain.  Small frames are copied next to each
+  /// other into shared blocks, larger ones are chained without copying.
+  void sendBatch(std::vector<std::unique_ptr<folly::IOBuf>>) override;
+
   void setInput(std::shared_ptr<DuplexConnection::Subscriber>) override;
 
   bool isFramed() const override {
     return true;
   }
 
+  size_t bufferedInputBytes() const override;
+
+  size_t bufferedOutputBytes() const override {
+    return inner_->bufferedOutputBytes();
+  }
+
+  void setOutputWrittenCallback(std::function<void()> callback) override {
+    inner_->setOutputWrittenCallback(std::move(callback));
+  }
+
+  TransportInfo transportInfo() const override {
+    return inner_->transportInfo();
+  }
+
+  void setReadBufferSizeHint(size_t bytes) override {
+    inner_->setReadBufferSizeHint(bytes);
+  }
+
+  /// Frame checksums are computed and checked here, rather than by the
+  /// serializer, so that frames buffered for resumption don't carry them.
+  bool supportsFrameChecksums() const override {
+    return true;
+  }
+
+  void enableFrameChecksums() override;
+
+  bool isDetachable() const override {
+    return inner_->isDetachable();
+  }
+
+  void detachEventBase() override {
+    inner_->detachEventBase();
+  }
+
+  void attachEventBase(folly::EventBase& eventBase) override {
+    inner_->attachEventBase(eventBase);
+  }
+
   DuplexConnection* getConnection() {
     return inner_.get();
   }
@@ -46,5 +91,7 @@ class FramedDuplexConnection : public virtual DuplexConnection {
   const std::unique_ptr<DuplexConnection> inner_;
   std::shared_ptr<FramedReader> inputReader_;
   const std::shared_ptr<ProtocolVersion> protocolVersion_;
+  const FramedReader::Options readerOptions_;
+  bool frameChecksums_{false};
 };
 } // namespace rsocket
@@ -18,6 +18,7 @@
 
 #include "rsocket/framing/FrameSerializer_v1_0.h"
 #include "rsocket/internal/Common.h"
+#include "rsocket/internal/FrameTracer.h"
 
 namespace rsocket {
 
@@ -56,6 +57,15 @@ size_t frameSizeWithoutLengthField(ProtocolVersion version, size_t frameSize) {
       ? frameSize - frameSizeFieldLength(version)
       : frameSize;
 }
+
+/// Copies a frame into a buffer of its own.
+std::unique_ptr<folly::IOBuf> copyFrame(const folly::IOBuf& frame) {
+  auto const length = frame.computeChainDataLength();
+  auto copy = folly::IOBuf::create(length);
+  folly::io::Cursor(&frame).pull(copy->writableData(), length);
+  copy->append(length);
+  return copy;
+}
 } // namespace
 
 size_t FramedReader::readFrameLength() const {
@@ -74,6 +84,74 @@ size_t FramedReader::readFrameLength() const {
   return frameLength;
 }
 
+bool FramedReader::deliverContiguousFrames() {
+  auto const head = payloadQueue_.front();
+  if (!head) {
+    return false;
+  }
+
+  auto const fieldLength = frameSizeFieldLength(*version_);
+  auto const minimalLength = minimalFrameLength(*version_);
+
+  // Keep the head buffer alive independently of the queue, the subscriber
+  // may tear this reader down while frames are being delivered.
+  auto const block = head->cloneOne();
+  const uint8_t* const data = block->data();
+  size_t const length = block->length();
+
+  size_t offset = 0;
+  bool delivered = false;
+
+  while (allowance_.canConsume(1) && inner_ &&
+         offset + fieldLength <= length) {
+    // Reading of arbitrary-sized big-endian integer.
+    size_t frameLength = 0;
+    for (size_t i = 0; i < fieldLength; ++i) {
+      frameLength = (frameLength << 8) | data[offset + i];
+    }
+
+    if (frameLength < minimalLength) {
+      error("Invalid frame - Frame size smaller than minimum");
+      break;
+    }
+
+    auto const totalLength = frameSizeWithLengthField(*version_, frameLength);
+    if (offset + totalLength > length) {
+      // The frame continues in the next buffer, leave it to parseFrames().
+      break;
+    }
+
+    auto const payloadSize =
+        frameSizeWithoutLengthField(*version_, frameLength);
+    std::unique_ptr<folly::IOBuf> nextFrame;
+    if (payloadSize < options_.copyThreshold) {
+      nextFrame =
+          folly::IOBuf::copyBuffer(data + offset + fieldLength, payloadSize);
+    } else {
+      nextFrame = block->cloneOne();
+      nextFrame->trimStart(offset + fieldLength);
+      nextFrame->trimEnd(length - offset - fieldLength - payloadSize);
+    }
+
+    if (!verifyChecksum(*nextFrame)) {
+      break;
+    }
+
+    offset += totalLength;
+    payloadQueue_.trimStart(totalLength);
+    delivered = true;
+
+    CHECK(allowance_.tryConsume(1));
+
+    VLOG(4) << "parsed frame length=" << nextFrame->length() << '\n'
+            << hexDump(nextFrame->clone()->moveToFbString());
+    traceFrame(*nextFrame);
+    inner_->onNext(std::move(nextFrame));
+  }
+
+  return delivered;
+}
+
 void FramedReader::onSubscribe(std::shared_ptr<Subscription> subscription) {
   subscription_ = std::move(subscription);
   subscription_->request(std::numeric_limits<int64_t>::max());
@@ -82,10 +160,41 @@ void FramedReader::onSubscribe(std::shared_ptr<Subscription> subscription) {
 void FramedReader::onNext(std::unique_ptr<folly::IOBuf> payload) {
   VLOG(4) << "incoming bytes length=" << payload->length() << '\n'
           << hexDump(payload->clone()->moveToFbString());
+  if (FrameTracer::enabled()) {
+    lastReadNanos_ = FrameTracer::now();
+  }
   payloadQueue_.append(std::move(payload));
   parseFrames();
 }
 
+bool FramedReader::verifyChecksum(folly::IOBuf& frame) {
+  if (FOLLY_LIKELY(!frameChecksums_) ||
+      !FrameSerializerV1_0::carriesChecksum(frame) ||
+      FrameSerializerV1_0::removeChecksum(frame)) {
+    return true;
+  }
+  error("Invalid frame - checksum mismatch");
+  return false;
+}
+
+void FramedReader::traceFrame(const folly::IOBuf& frame) const {
+  if (!FrameTracer::enabled() || *version_ != FrameSerializerV1_0::Version) {
+    return;
+  }
+  auto const decoded = FrameSerializerV1_0().decodeFrameHeader(frame);
+  if (!decoded || !FrameTracer::sampled(decoded->header.streamId)) {
+    return;
+  }
+  auto const& header = decoded->header;
+  FrameTracer::record(
+      FrameTracer::Point::SOCKET_READ,
+      header.streamId,
+      header.type,
+      lastReadNanos_);
+  FrameTracer::record(
+      FrameTracer::Point::PARSED, header.streamId, header.type);
+}
+
 void FramedReader::parseFrames() {
   if (dispatchingFrames_) {
     return;
@@ -102,6 +211,16 @@ void FramedReader::parseFrames() {
       break;
     }
 
+    // Fast path: every frame that sits entirely within the head buffer is
+    // sliced off of it in one pass.  Only frames that straddle buffers go
+    // through the queue below.
+    if (deliverContiguousFrames()) {
+      continue;
+    }
+    if (!inner_) {
+      break;
+    }
+
     auto const frameSizeFieldLen = frameSizeFieldLength(*version_);
     if (payloadQueue_.chainLength() < frameSizeFieldLen) {
       // We don't even have the next frame size value.
@@ -127,11 +246,18 @@ void FramedReader::parseFrames() {
     DCHECK_GT(payloadSize, 0)
         << "folly::IOBufQueue::split(0) returns a nullptr, can't have that";
     auto nextFrame = payloadQueue_.split(payloadSize);
+    if (payloadSize < options_.copyThreshold) {
+      nextFrame = copyFrame(*nextFrame);
+    }
+    if (!verifyChecksum(*nextFrame)) {
+      break;
+    }
 
     CHECK(allowance_.tryConsume(1));
 
     VLOG(4) << "parsed frame length=" << nextFrame->length() << '\n'
             << hexDump(nextFrame->clone()->moveToFbString());
+    traceFrame(*nextFrame);
     inner_->onNext(std::move(nextFrame));
   }
 
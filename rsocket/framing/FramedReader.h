@@ -27,8 +27,18 @@ class FramedReader : public DuplexConnection::Subscriber,
                      public yarpl::flowable::Subscription,
                      public std::enable_shared_from_this<FramedReader> {
  public:
+  struct Options {
+    /// Frames shorter than this many bytes are copied out of the buffers they
+    /// were read into, so that holding on to a small frame doesn't pin a large
+    /// read buffer.  Longer frames are handed out as slices of the read
+    /// buffers, without copying.  Zero slices every frame.
+    size_t copyThreshold{0};
+  };
+
   explicit FramedReader(std::shared_ptr<ProtocolVersion> version)
       : version_{std::move(version)} {}
+  FramedReader(std::shared_ptr<ProtocolVersion> version, Options options)
+      : version_{std::move(version)}, options_{std::move(options)} {}
 
   /// Set the inner subscriber which will be getting full frame payloads.
   void setInput(std::shared_ptr<DuplexConnection::Subscriber>);
@@ -48,20 +58,49 @@ class FramedReader : public DuplexConnection::Subscriber,
   void request(int64_t) override;
   void cancel() override;
 
+  /// Checks and strips the checksum trailer of every later frame that has
+  /// one, see FrameChecksums.  A frame that doesn't match errors the reader.
+  void enableFrameChecksums() {
+    frameChecksums_ = true;
+  }
+
+  /// Bytes received that don't form a complete frame yet.
+  size_t bufferedBytes() const {
+    return payloadQueue_.chainLength();
+  }
+
  private:
   void parseFrames();
   bool ensureOrAutodetectProtocolVersion();
 
   size_t readFrameLength() const;
 
+  /// Deliver all complete frames contained in the first buffer of the queue,
+  /// without copying or splitting the queue.  Returns whether any frame was
+  /// delivered.
+  bool deliverContiguousFrames();
+
+  /// Strips the checksum trailer of a frame, when checksums are enabled.
+  /// Returns false, having errored the reader, if it doesn't match.
+  bool verifyChecksum(folly::IOBuf& frame);
+
+  /// Records the frame with FrameTracer, if its stream is sampled.
+  void traceFrame(const folly::IOBuf&) const;
+
   std::shared_ptr<yarpl::flowable::Subscription> subscription_;
   std::shared_ptr<DuplexConnection::Subscriber> inner_;
 
   Allowance allowance_;
   bool dispatchingFrames_{false};
+  bool frameChecksums_{false};
+
+  /// When the last bytes were received, only kept while FrameTracer is
+  /// enabled.
+  uint64_t lastReadNanos_{0};
 
   folly::IOBufQueue payloadQueue_{folly::IOBufQueue::cacheChainLength()};
   const std::shared_ptr<ProtocolVersion> version_;
+  const Options options_;
 };
 
 } // namespace rsocket
@@ -14,19 +14,24 @@
 
 #include "rsocket/framing/ResumeIdentificationToken.h"
 
+#include <algorithm>
 #include <limits>
 #include <ostream>
 #include <sstream>
 #include <stdexcept>
 
 #include <folly/Random.h>
+#include <folly/hash/Hash.h>
+#include <folly/hash/SpookyHashV2.h>
 #include <glog/logging.h>
 
 namespace rsocket {
 
 constexpr const char* kHexChars = "0123456789abcdef";
 
-ResumeIdentificationToken::ResumeIdentificationToken() {}
+ResumeIdentificationToken::ResumeIdentificationToken() {
+  rehash();
+}
 
 ResumeIdentificationToken::ResumeIdentificationToken(const std::string& token) {
   const auto getNibble = [&token](size_t i) {
@@ -44,27 +49,66 @@ ResumeIdentificationToken::ResumeIdentificationToken(const std::string& token) {
       (token.size() % 2) != 0) {
     throw std::invalid_argument("ResumeToken not in right format: " + token);
   }
+  std::vector<uint8_t> bits;
+  bits.reserve((token.size() - 2) / 2);
   size_t i = 2;
   while (i < token.size()) {
     const uint8_t firstNibble = getNibble(i++);
     const uint8_t secondNibble = getNibble(i++);
-    bits_.push_back((firstNibble << 4) | secondNibble);
+    bits.push_back((firstNibble << 4) | secondNibble);
   }
+  set(std::move(bits));
 }
 
 ResumeIdentificationToken ResumeIdentificationToken::generateNew() {
-  constexpr size_t kSize = 16;
-  std::vector<uint8_t> data;
-  data.reserve(kSize);
-  for (size_t i = 0; i < kSize; i++) {
-    data.push_back(static_cast<uint8_t>(folly::Random::rand32()));
-  }
-  return ResumeIdentificationToken(std::move(data));
+  ResumeIdentificationToken token;
+  token.inline_ = {{folly::Random::rand64(), folly::Random::rand64()}};
+  token.size_ = kInlineSize;
+  token.rehash();
+  return token;
 }
 
 void ResumeIdentificationToken::set(std::vector<uint8_t> newBits) {
+  if (newBits.size() <= kInlineSize) {
+    set(folly::ByteRange(newBits.data(), newBits.size()));
+    return;
+  }
+  CHECK(newBits.size() <= std::numeric_limits<uint16_t>::max());
+  inline_ = {};
+  overflow_ = std::move(newBits);
+  size_ = static_cast<uint16_t>(overflow_.size());
+  rehash();
+}
+
+void ResumeIdentificationToken::set(folly::ByteRange newBits) {
   CHECK(newBits.size() <= std::numeric_limits<uint16_t>::max());
-  bits_ = std::move(newBits);
+  inline_ = {};
+  if (newBits.size() <= kInlineSize) {
+    std::memcpy(&inline_, newBits.data(), newBits.size());
+    overflow_.clear();
+  } else {
+    overflow_.assign(newBits.begin(), newBits.end());
+  }
+  size_ = static_cast<uint16_t>(newBits.size());
+  rehash();
+}
+
+void ResumeIdentificationToken::rehash() {
+  if (size_ <= kInlineSize) {
+    hash_ = static_cast<size_t>(
+        folly::hash::hash_128_to_64(inline_[0] ^ size_, inline_[1]));
+  } else {
+    hash_ = static_cast<size_t>(
+        folly::hash::SpookyHashV2::Hash64(overflow_.data(), size_, 0));
+  }
+}
+
+bool ResumeIdentificationToken::operator<(
+    const ResumeIdentificationToken& right) const {
+  auto const left = data();
+  auto const other = right.data();
+  return std::lexicographical_compare(
+      left.begin(), left.end(), other.begin(), other.end());
 }
 
 std::string ResumeIdentificationToken::str() const {
@@ -14,15 +14,27 @@
 
 #pragma once
 
+#include <folly/Range.h>
+
+#include <array>
 #include <cstdint>
+#include <cstring>
+#include <functional>
 #include <iosfwd>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 namespace rsocket {
 
+/// A resume token.  Tokens of up to kInlineSize bytes, which includes those
+/// from generateNew(), are stored inline, and compare as two 64 bit words.
+/// The hash of a token is computed when it is set, so hashing one with
+/// std::hash (e.g. as the key of a folly::F14FastMap) is free.
 class ResumeIdentificationToken {
  public:
+  static constexpr size_t kInlineSize = 16;
+
   /// Creates an empty token.
   ResumeIdentificationToken();
 
@@ -33,33 +45,67 @@ class ResumeIdentificationToken {
 
   static ResumeIdentificationToken generateNew();
 
-  const std::vector<uint8_t>& data() const {
-    return bits_;
+  folly::ByteRange data() const {
+    return folly::ByteRange(bytes(), size_);
   }
 
   void set(std::vector<uint8_t> newBits);
+  void set(folly::ByteRange newBits);
+
+  size_t hash() const {
+    return hash_;
+  }
 
   bool operator==(const ResumeIdentificationToken& right) const {
-    return data() == right.data();
+    if (size_ != right.size_ || hash_ != right.hash_) {
+      return false;
+    }
+    if (size_ <= kInlineSize) {
+      return inline_[0] == right.inline_[0] && inline_[1] == right.inline_[1];
+    }
+    return std::memcmp(bytes(), right.bytes(), size_) == 0;
   }
 
   bool operator!=(const ResumeIdentificationToken& right) const {
-    return data() != right.data();
+    return !(*this == right);
   }
 
-  bool operator<(const ResumeIdentificationToken& right) const {
-    return data() < right.data();
-  }
+  bool operator<(const ResumeIdentificationToken& right) const;
 
   std::string str() const;
 
  private:
-  explicit ResumeIdentificationToken(std::vector<uint8_t> bits)
-      : bits_(std::move(bits)) {}
+  const uint8_t* bytes() const {
+    return size_ <= kInlineSize ? reinterpret_cast<const uint8_t*>(&inline_)
+                                : overflow_.data();
+  }
+
+  void rehash();
+
+  /// The bytes of a token of up to kInlineSize bytes, padded with zeroes.
+  std::array<uint64_t, 2> inline_{};
 
-  std::vector<uint8_t> bits_;
+  /// The bytes of a longer token.
+  std::vector<uint8_t> overflow_;
+
+  size_t hash_{0};
+  uint16_t size_{0};
 };
 
 std::ostream& operator<<(std::ostream&, const ResumeIdentificationToken&);
 
 } // namespace rsocket
+
+namespace std {
+
+template <>
+struct hash<rsocket::ResumeIdentificationToken> {
+  /// The precomputed hash is well mixed, F14 maps can use it as is.
+  using folly_is_avalanching = std::true_type;
+
+  size_t operator()(const rsocket::ResumeIdentificationToken& token) const {
+    return token.hash();
+  }
+};
+
+} // namespace std
@@ -19,7 +19,9 @@ namespace rsocket {
 ScheduledFrameProcessor::ScheduledFrameProcessor(
     std::shared_ptr<FrameProcessor> processor,
     folly::EventBase* evb)
-    : evb_{evb}, processor_{std::move(processor)} {}
+    : evb_{evb},
+      processor_{std::move(processor)},
+      input_{std::make_shared<ScheduledFrameQueue>()} {}
 
 ScheduledFrameProcessor::~ScheduledFrameProcessor() = default;
 
@@ -27,10 +29,14 @@ void ScheduledFrameProcessor::processFrame(
     std::unique_ptr<folly::IOBuf> ioBuf) {
   CHECK(processor_) << "Calling processFrame() after onTerminal()";
 
-  evb_->runInEventBaseThread(
-      [processor = processor_, buf = std::move(ioBuf)]() mutable {
-        processor->processFrame(std::move(buf));
-      });
+  if (!input_->push(std::move(ioBuf))) {
+    return;
+  }
+  evb_->runInEventBaseThread([processor = processor_, input = input_] {
+    for (auto& frame : input->drain()) {
+      processor->processFrame(std::move(frame));
+    }
+  });
 }
 
 void ScheduledFrameProcessor::onTerminal(folly::exception_wrapper ew) {
@@ -17,6 +17,7 @@
 #include <folly/io/async/EventBase.h>
 
 #include "rsocket/framing/FrameProcessor.h"
+#include "rsocket/framing/ScheduledFrameQueue.h"
 
 namespace rsocket {
 
@@ -28,6 +29,8 @@ namespace rsocket {
 // original RSocketStateMachine was constructed for the client.  Here the
 // transport uses this class to schedule events of the RSocketStateMachine
 // (FrameProcessor) in the original EventBase.
+//
+// Frames are handed to the processor in batches, see ScheduledFrameQueue.
 class ScheduledFrameProcessor : public FrameProcessor {
  public:
   ScheduledFrameProcessor(std::shared_ptr<FrameProcessor>, folly::EventBase*);
@@ -39,6 +42,8 @@ class ScheduledFrameProcessor : public FrameProcessor {
  private:
   folly::EventBase* const evb_;
   std::shared_ptr<FrameProcessor> processor_;
+  // Frames on their way to processor_.
+  const std::shared_ptr<ScheduledFrameQueue> input_;
 };
 
 } // namespace rsocket
@@ -0,0 +1,74 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/concurrency/UnboundedQueue.h>
+#include <folly/io/IOBuf.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace rsocket {
+
+/// Frames handed over from one thread to the EventBase of another, in
+/// batches.
+///
+/// Producers push frames onto a lock-free queue.  Only the push that finds
+/// no drain pending asks its caller to schedule one, so a burst of frames
+/// costs a single callback on the consumer's EventBase, which drains every
+/// frame queued by the time it runs.  Callbacks the producer schedules on
+/// the same EventBase after a push still run after the frames of that push.
+class ScheduledFrameQueue {
+ public:
+  /// Queues a frame.  Returns true if the caller must schedule a drain().
+  bool push(std::unique_ptr<folly::IOBuf> frame) {
+    queue_.enqueue(std::move(frame));
+    return !drainScheduled_.exchange(true, std::memory_order_acq_rel);
+  }
+
+  /// Queues several frames, in order.  Returns true if the caller must
+  /// schedule a drain().
+  bool push(std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+    for (auto& frame : frames) {
+      queue_.enqueue(std::move(frame));
+    }
+    return !drainScheduled_.exchange(true, std::memory_order_acq_rel);
+  }
+
+  /// Takes every frame queued so far.  Called by the single consumer, from
+  /// the drain its producers scheduled.  May return nothing if an earlier
+  /// drain already took the frames.
+  std::vector<std::unique_ptr<folly::IOBuf>> drain() {
+    // Frames pushed from now on schedule another drain, which then finds
+    // nothing left if this one took them.  Acquires the frames of the pushes
+    // that didn't schedule one.
+    drainScheduled_.exchange(false, std::memory_order_acq_rel);
+
+    std::vector<std::unique_ptr<folly::IOBuf>> frames;
+    std::unique_ptr<folly::IOBuf> frame;
+    while (queue_.try_dequeue(frame)) {
+      frames.push_back(std::move(frame));
+    }
+    return frames;
+  }
+
+ private:
+  folly::UMPSCQueue<std::unique_ptr<folly::IOBuf>, false /* MayBlock */>
+      queue_;
+  std::atomic<bool> drainScheduled_{false};
+};
+
+} // namespace rsocket
@@ -37,9 +37,27 @@ void ScheduledFrameTransport::outputFrameOrDrop(
     std::unique_ptr<folly::IOBuf> ioBuf) {
   CHECK(frameTransport_) << "Inner transport already closed";
 
+  if (output_->push(std::move(ioBuf))) {
+    scheduleOutput();
+  }
+}
+
+void ScheduledFrameTransport::outputFramesOrDrop(
+    std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+  CHECK(frameTransport_) << "Inner transport already closed";
+
+  if (output_->push(std::move(frames))) {
+    scheduleOutput();
+  }
+}
+
+void ScheduledFrameTransport::scheduleOutput() {
   transportEvb_->runInEventBaseThread(
-      [transport = frameTransport_, buf = std::move(ioBuf)]() mutable {
-        transport->outputFrameOrDrop(std::move(buf));
+      [transport = frameTransport_, output = output_]() mutable {
+        auto frames = output->drain();
+        if (!frames.empty()) {
+          transport->outputFramesOrDrop(std::move(frames));
+        }
       });
 }
 
@@ -55,4 +73,16 @@ bool ScheduledFrameTransport::isConnectionFramed() const {
   return frameTransport_->isConnectionFramed();
 }
 
+bool ScheduledFrameTransport::supportsFrameChecksums() const {
+  CHECK(frameTransport_) << "Inner transport already closed";
+  return frameTransport_->supportsFrameChecksums();
+}
+
+void ScheduledFrameTransport::enableFrameChecksums() {
+  CHECK(frameTransport_) << "Inner transport already closed";
+
+  transportEvb_->runInEventBaseThread(
+      [transport = frameTransport_]() { transport->enableFrameChecksums(); });
+}
+
 } // namespace rsocket
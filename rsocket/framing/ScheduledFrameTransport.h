@@ -17,6 +17,7 @@
 #include <folly/io/async/EventBase.h>
 
 #include "rsocket/framing/FrameTransport.h"
+#include "rsocket/framing/ScheduledFrameQueue.h"
 
 namespace rsocket {
 
@@ -28,6 +29,8 @@ namespace rsocket {
 // original RSocketStateMachine was constructed for the client.  Here the
 // RSocketStateMachine uses this class to schedule events of the Transport in
 // the new EventBase.
+//
+// Frames are handed to the transport in batches, see ScheduledFrameQueue.
 class ScheduledFrameTransport : public FrameTransport {
  public:
   ScheduledFrameTransport(
@@ -36,15 +39,22 @@ class ScheduledFrameTransport : public FrameTransport {
       folly::EventBase* stateMachineEvb)
       : transportEvb_(transportEvb),
         stateMachineEvb_(stateMachineEvb),
-        frameTransport_(std::move(frameTransport)) {}
+        frameTransport_(std::move(frameTransport)),
+        output_(std::make_shared<ScheduledFrameQueue>()) {}
 
   ~ScheduledFrameTransport();
 
   void setFrameProcessor(std::shared_ptr<FrameProcessor>) override;
   void outputFrameOrDrop(std::unique_ptr<folly::IOBuf>) override;
+  void outputFramesOrDrop(std::vector<std::unique_ptr<folly::IOBuf>>) override;
   void close() override;
   bool isConnectionFramed() const override;
 
+  /// Enabling is scheduled on the transport's EventBase, so it must come
+  /// before the first frame is output and before setFrameProcessor().
+  bool supportsFrameChecksums() const override;
+  void enableFrameChecksums() override;
+
  private:
   DuplexConnection* getConnection() override {
     DLOG(FATAL)
@@ -54,10 +64,15 @@ class ScheduledFrameTransport : public FrameTransport {
     return nullptr;
   }
 
+  /// Schedules a drain of output_ on the transport's EventBase.
+  void scheduleOutput();
+
  private:
   folly::EventBase* const transportEvb_;
   folly::EventBase* const stateMachineEvb_;
   std::shared_ptr<FrameTransport> frameTransport_;
+  /// Frames on their way to frameTransport_.
+  const std::shared_ptr<ScheduledFrameQueue> output_;
 };
 
 } // namespace rsocket
@@ -0,0 +1,68 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/AdmissionController.h"
+
+#include <folly/io/async/EventBase.h>
+
+#include <algorithm>
+
+namespace rsocket {
+
+std::shared_ptr<AdmissionController> AdmissionController::create(
+    folly::EventBase& eventBase,
+    Options options) {
+  auto controller = std::make_shared<AdmissionController>(options);
+  eventBase.runInEventBaseThread(
+      [weakController = std::weak_ptr<AdmissionController>(controller),
+       &eventBase] {
+        if (auto self = weakController.lock()) {
+          self->scheduleSample(eventBase);
+        }
+      });
+  return controller;
+}
+
+void AdmissionController::sample(
+    Clock::duration delay,
+    Clock::time_point now) {
+  if (delay <= options_.target) {
+    aboveTargetSince_.clear();
+    overloaded_.store(false, std::memory_order_relaxed);
+    return;
+  }
+
+  if (!aboveTargetSince_) {
+    aboveTargetSince_ = now;
+  } else if (now - *aboveTargetSince_ >= options_.interval) {
+    overloaded_.store(true, std::memory_order_relaxed);
+  }
+}
+
+void AdmissionController::scheduleSample(folly::EventBase& eventBase) {
+  auto const due = Clock::now() + options_.sampleInterval;
+  eventBase.runAfterDelay(
+      [weakThis = std::weak_ptr<AdmissionController>(shared_from_this()),
+       &eventBase,
+       due] {
+        if (auto self = weakThis.lock()) {
+          auto const now = Clock::now();
+          self->sample(std::max(now - due, Clock::duration::zero()), now);
+          self->scheduleSample(eventBase);
+        }
+      },
+      static_cast<uint32_t>(options_.sampleInterval.count()));
+}
+
+} // namespace rsocket
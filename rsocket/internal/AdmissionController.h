@@ -0,0 +1,91 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Optional.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+namespace folly {
+class EventBase;
+}
+
+namespace rsocket {
+
+/// Server-side admission control based on the queueing delay of an EventBase,
+/// see RSocketServer::setAdmissionControl().
+///
+/// Frames are read and handed to the responder on the EventBase of their
+/// connection, so they wait behind whatever the loop is busy with.  The
+/// controller samples that wait by how late a recurring timer of the loop
+/// fires.  Like CoDel, it only counts the EventBase as overloaded once the
+/// delay stayed above `target` for a whole `interval`, so that short bursts
+/// are absorbed by the queue, and lets requests in again as soon as a sample is
+/// back under the target.
+///
+/// Samples are taken on the EventBase thread, admit() can be called from any
+/// thread.
+class AdmissionController
+    : public std::enable_shared_from_this<AdmissionController> {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Options {
+    /// Queueing delay that is acceptable to keep up indefinitely.
+    std::chrono::milliseconds target{5};
+
+    /// How long the delay must stay above `target` before requests are
+    /// rejected.
+    std::chrono::milliseconds interval{100};
+
+    /// Time between two samples of the delay.
+    std::chrono::milliseconds sampleInterval{10};
+  };
+
+  /// A controller that samples the queueing delay of `eventBase` until it is
+  /// destroyed.
+  static std::shared_ptr<AdmissionController> create(
+      folly::EventBase& eventBase,
+      Options options);
+
+  /// A controller fed by sample() only.
+  explicit AdmissionController(Options options) : options_{options} {}
+
+  /// Whether new requests should be accepted.
+  bool admit() const {
+    return !overloaded_.load(std::memory_order_relaxed);
+  }
+
+  /// Records the queueing delay measured at `now`.
+  void sample(Clock::duration delay, Clock::time_point now = Clock::now());
+
+  const Options& options() const {
+    return options_;
+  }
+
+ private:
+  void scheduleSample(folly::EventBase& eventBase);
+
+  const Options options_;
+
+  /// When the delay went above the target, if it still is.
+  folly::Optional<Clock::time_point> aboveTargetSince_;
+
+  std::atomic<bool> overloaded_{false};
+};
+
+} // namespace rsocket
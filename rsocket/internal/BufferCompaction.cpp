@@ -0,0 +1,59 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/BufferCompaction.h"
+
+#include <folly/io/Cursor.h>
+
+namespace rsocket {
+
+bool BufferCompaction::needed(const folly::IOBuf& chain) const {
+  size_t buffers = 0;
+  size_t length = 0;
+  size_t pinned = 0;
+  for (auto buf = &chain;;) {
+    ++buffers;
+    length += buf->length();
+    // The capacity of the whole buffer, even for a slice of it.
+    pinned += buf->capacity();
+    buf = buf->next();
+    if (buf == &chain) {
+      break;
+    }
+  }
+  if (length == 0 || length > maxLength) {
+    return false;
+  }
+  return buffers > maxBuffers ||
+      (pinned >= minPinnedBytes && pinned > maxOverhead * length);
+}
+
+bool BufferCompaction::compact(folly::IOBuf& chain) const {
+  if (!needed(chain)) {
+    return false;
+  }
+  auto const length = chain.computeChainDataLength();
+  folly::IOBuf compacted(folly::IOBuf::CREATE, length);
+  folly::io::Cursor(&chain).pull(compacted.writableData(), length);
+  compacted.append(length);
+  // Frees the rest of the old chain along with its head.
+  chain = std::move(compacted);
+  return true;
+}
+
+bool BufferCompaction::compact(std::unique_ptr<folly::IOBuf>& chain) const {
+  return chain && compact(*chain);
+}
+
+} // namespace rsocket
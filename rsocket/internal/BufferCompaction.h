@@ -0,0 +1,54 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/io/IOBuf.h>
+
+#include <memory>
+
+namespace rsocket {
+
+/// Frames and payloads kept for a long time, e.g. buffered for resumption or
+/// replayed to late subscribers, are often slices of the much larger buffers
+/// they were read into, or long chains of small slices.  Kept as they are,
+/// they pin every one of those buffers.  Compacting copies such a chain into
+/// a single buffer of its own length, so that the buffers it pinned can be
+/// freed.  The thresholds keep the copies to the chains that need them.
+struct BufferCompaction {
+  /// Chains of more buffers than this are compacted.
+  size_t maxBuffers{8};
+
+  /// Chains are compacted when the buffers they pin are more than this many
+  /// times as large as the bytes they hold...
+  size_t maxOverhead{4};
+
+  /// ...and at least this large, so that a small frame in a buffer of a few
+  /// dozen bytes is left alone.
+  size_t minPinnedBytes{4 * 1024};
+
+  /// Chains holding more bytes than this are never compacted, they fill most
+  /// of what they pin and are expensive to copy.
+  size_t maxLength{64 * 1024};
+
+  /// Whether the chain is worth compacting.
+  bool needed(const folly::IOBuf& chain) const;
+
+  /// Copies the chain into a buffer of its own if needed().  Returns whether
+  /// it did.
+  bool compact(folly::IOBuf& chain) const;
+  bool compact(std::unique_ptr<folly::IOBuf>& chain) const;
+};
+
+} // namespace rsocket
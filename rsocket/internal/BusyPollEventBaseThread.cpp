@@ -0,0 +1,63 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/BusyPollEventBaseThread.h"
+
+#include <folly/String.h>
+#include <folly/io/async/EventBaseManager.h>
+#include <folly/portability/Event.h>
+#include <folly/system/ThreadName.h>
+#include <glog/logging.h>
+
+#include "rsocket/internal/ThreadAffinity.h"
+
+namespace rsocket {
+
+BusyPollEventBaseThread::BusyPollEventBaseThread(
+    folly::StringPiece name,
+    std::vector<int> cpus)
+    : eventBase_(std::make_unique<folly::EventBase>()),
+      thread_(
+          &BusyPollEventBaseThread::run,
+          this,
+          name.str(),
+          std::move(cpus)) {}
+
+BusyPollEventBaseThread::~BusyPollEventBaseThread() {
+  stopping_.store(true, std::memory_order_relaxed);
+  thread_.join();
+}
+
+void BusyPollEventBaseThread::run(std::string name, std::vector<int> cpus) {
+  folly::setThreadName(name);
+  if (!pinCurrentThreadToCpus(cpus)) {
+    LOG(WARNING) << "Cannot pin " << name << " to CPUs "
+                 << folly::join(',', cpus);
+  }
+
+  auto const manager = folly::EventBaseManager::get();
+  manager->setEventBase(eventBase_.get(), false);
+
+  while (!stopping_.load(std::memory_order_relaxed)) {
+    eventBase_->loopOnce(EVLOOP_NONBLOCK);
+  }
+
+  // Whatever was queued until the stop still runs, and the EventBase goes
+  // away on its own thread.
+  eventBase_->loopOnce(EVLOOP_NONBLOCK);
+  manager->clearEventBase();
+  eventBase_.reset();
+}
+
+} // namespace rsocket
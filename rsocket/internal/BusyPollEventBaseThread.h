@@ -0,0 +1,63 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Range.h>
+#include <folly/io/async/EventBase.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rsocket {
+
+/// A thread driving an EventBase like folly::ScopedEventBaseThread, which
+/// spins on non-blocking loop iterations instead of sleeping in epoll_wait().
+///
+/// Events are picked up as soon as they happen, without the wakeup latency
+/// of a sleeping thread, at the cost of keeping a CPU fully busy.  Pairs with
+/// SO_BUSY_POLL on the sockets of the EventBase (see
+/// TcpDuplexConnection::Options::busyPollMicros), which polls the device
+/// queue from the read path.  Best pinned to a CPU of its own.
+class BusyPollEventBaseThread {
+ public:
+  /// The thread is pinned to `cpus` unless it's empty, see
+  /// pinCurrentThreadToCpus().
+  explicit BusyPollEventBaseThread(
+      folly::StringPiece name,
+      std::vector<int> cpus = {});
+
+  /// Stops the loop and joins the thread.  Callbacks queued until then still
+  /// run.
+  ~BusyPollEventBaseThread();
+
+  BusyPollEventBaseThread(const BusyPollEventBaseThread&) = delete;
+  BusyPollEventBaseThread& operator=(const BusyPollEventBaseThread&) = delete;
+
+  folly::EventBase* getEventBase() const {
+    return eventBase_.get();
+  }
+
+ private:
+  void run(std::string name, std::vector<int> cpus);
+
+  std::unique_ptr<folly::EventBase> eventBase_;
+  std::atomic<bool> stopping_{false};
+  std::thread thread_;
+};
+
+} // namespace rsocket
@@ -0,0 +1,77 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/ByteCredit.h"
+
+#include <folly/Conv.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBuf.h>
+
+#include <algorithm>
+
+#include "rsocket/internal/Common.h"
+
+namespace rsocket {
+
+namespace {
+
+constexpr folly::StringPiece kMimeParameter{"rsocket-byte-credit="};
+
+} // namespace
+
+constexpr uint32_t ByteCredit::kExtendedType;
+constexpr uint32_t ByteCredit::kMaxGrant;
+
+std::string ByteCredit::addToMimeType(
+    folly::StringPiece mimeType,
+    size_t credit) {
+  return folly::to<std::string>(mimeType, ";", kMimeParameter, credit);
+}
+
+size_t ByteCredit::removeFromMimeType(std::string& mimeType) {
+  auto const value = removeMimeTypeParameter(mimeType, kMimeParameter);
+  auto const credit = folly::tryTo<uint32_t>(value);
+  if (!credit.hasValue()) {
+    return 0;
+  }
+  return std::min(credit.value(), kMaxGrant);
+}
+
+Frame_EXT ByteCredit::grantFrame(StreamId streamId, uint32_t bytes) {
+  auto data = folly::IOBuf::create(sizeof(uint32_t));
+  folly::io::Appender appender(data.get(), 0);
+  appender.writeBE<uint32_t>(bytes);
+  return Frame_EXT{
+      streamId, FrameFlags::IGNORE_, kExtendedType, std::move(data)};
+}
+
+folly::Optional<uint32_t> ByteCredit::parseGrant(const Frame_EXT& frame) {
+  if (frame.extendedType_ != kExtendedType || !frame.data_ ||
+      frame.data_->computeChainDataLength() != sizeof(uint32_t)) {
+    return folly::none;
+  }
+  folly::io::Cursor cur(frame.data_.get());
+  auto const bytes = cur.readBE<uint32_t>();
+  if (bytes == 0 || bytes > kMaxGrant) {
+    return folly::none;
+  }
+  return bytes;
+}
+
+size_t ByteCredit::lengthOf(const Payload& payload) {
+  return (payload.data ? payload.data->computeChainDataLength() : 0) +
+      (payload.metadata ? payload.metadata->computeChainDataLength() : 0);
+}
+
+} // namespace rsocket
@@ -0,0 +1,66 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/Range.h>
+
+#include <cstdint>
+#include <limits>
+#include <string>
+
+#include "rsocket/Payload.h"
+#include "rsocket/framing/Frame.h"
+
+namespace rsocket {
+
+/// Byte-based flow control, on top of the payload counts of REQUEST_N.
+///
+/// The client asks for it by adding a `rsocket-byte-credit` parameter to the
+/// metadata MIME type of its SETUP frame, e.g. "text/plain;
+/// rsocket-byte-credit=1048576".  Every stream then starts with that many
+/// bytes of credit in each direction.  A consumer grants more with EXT frames
+/// of kExtendedType carrying a 32-bit byte count once its subscriber has
+/// taken half of it, and a publisher stops asking its producer for payloads
+/// while it has no byte credit left.  The last payload may overshoot the
+/// credit, so that a payload larger than the credit doesn't stall the stream.
+///
+/// Payload lengths are data and metadata combined, before compression and
+/// fragmentation.  Grants are not resumable frames, so they are lost if the
+/// connection drops while they are in flight.
+class ByteCredit {
+ public:
+  static constexpr uint32_t kExtendedType = 0x00000001;
+  static constexpr uint32_t kMaxGrant = std::numeric_limits<int32_t>::max();
+
+  /// Append the byte credit parameter to a metadata MIME type.
+  static std::string addToMimeType(folly::StringPiece mimeType, size_t credit);
+
+  /// Strip the byte credit parameter from a metadata MIME type, returning the
+  /// initial credit of each stream, or zero if there was none.
+  static size_t removeFromMimeType(std::string& mimeType);
+
+  /// The frame granting `bytes` more credit on a stream.
+  static Frame_EXT grantFrame(StreamId streamId, uint32_t bytes);
+
+  /// Bytes granted by an EXT frame of kExtendedType, or folly::none if it is
+  /// malformed.
+  static folly::Optional<uint32_t> parseGrant(const Frame_EXT&);
+
+  /// What a payload costs in byte credit.
+  static size_t lengthOf(const Payload&);
+};
+
+} // namespace rsocket
@@ -0,0 +1,81 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/CapacityHints.h"
+
+#include <folly/Conv.h>
+
+#include <algorithm>
+#include <ostream>
+
+#include "rsocket/internal/Common.h"
+
+namespace rsocket {
+
+namespace {
+
+constexpr folly::StringPiece kStreamsParameter{"rsocket-expected-streams="};
+constexpr folly::StringPiece kPayloadSizeParameter{"rsocket-payload-size="};
+constexpr folly::StringPiece kResumeWindowParameter{"rsocket-resume-window="};
+
+void appendParameter(
+    std::string& mimeType,
+    folly::StringPiece parameter,
+    size_t value) {
+  if (value > 0) {
+    folly::toAppend(";", parameter, value, &mimeType);
+  }
+}
+
+size_t removeParameter(std::string& mimeType, folly::StringPiece parameter) {
+  auto const value = removeMimeTypeParameter(mimeType, parameter);
+  auto const parsed = folly::tryTo<size_t>(value);
+  return parsed.hasValue() ? parsed.value() : 0;
+}
+
+} // namespace
+
+CapacityHints CapacityHints::boundedBy(const CapacityHints& limits) const {
+  CapacityHints bounded;
+  bounded.streams = std::min(streams, limits.streams);
+  bounded.payloadSize = std::min(payloadSize, limits.payloadSize);
+  bounded.resumeWindow = std::min(resumeWindow, limits.resumeWindow);
+  return bounded;
+}
+
+std::string CapacityHints::addToMimeType(
+    folly::StringPiece mimeType,
+    const CapacityHints& hints) {
+  auto result = mimeType.str();
+  appendParameter(result, kStreamsParameter, hints.streams);
+  appendParameter(result, kPayloadSizeParameter, hints.payloadSize);
+  appendParameter(result, kResumeWindowParameter, hints.resumeWindow);
+  return result;
+}
+
+CapacityHints CapacityHints::removeFromMimeType(std::string& mimeType) {
+  CapacityHints hints;
+  hints.streams = removeParameter(mimeType, kStreamsParameter);
+  hints.payloadSize = removeParameter(mimeType, kPayloadSizeParameter);
+  hints.resumeWindow = removeParameter(mimeType, kResumeWindowParameter);
+  return hints;
+}
+
+std::ostream& operator<<(std::ostream& os, const CapacityHints& hints) {
+  return os << "streams=" << hints.streams
+            << " payloadSize=" << hints.payloadSize
+            << " resumeWindow=" << hints.resumeWindow;
+}
+
+} // namespace rsocket
@@ -0,0 +1,69 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Range.h>
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+
+namespace rsocket {
+
+/// What a client expects of its connection, so that the server can size it
+/// up front instead of growing it from the defaults, e.g. for a client that
+/// opens thousands of streams at once or moves large payloads.
+///
+/// The client sends the hints that are set as parameters of the metadata
+/// MIME type of its SETUP frame, e.g. "text/plain;
+/// rsocket-expected-streams=10000; rsocket-payload-size=65536".  They are
+/// only hints: the server bounds them by its own limits (see
+/// RSocketServer::setCapacityHintLimits()), and the connection still grows
+/// past them when it needs to.
+struct CapacityHints {
+  /// Streams opened by the client expected to be open at once.  Sizes the
+  /// stream table of the connection.
+  size_t streams{0};
+
+  /// Typical length of the frames the client sends.  Sizes the read buffer
+  /// of the server's connection.
+  size_t payloadSize{0};
+
+  /// Bytes of sent frames the server should keep for the client to resume
+  /// from.  Sizes the WarmResumeManager of a resumable connection.
+  size_t resumeWindow{0};
+
+  /// Whether no hint is set.
+  bool empty() const {
+    return streams == 0 && payloadSize == 0 && resumeWindow == 0;
+  }
+
+  /// The hints, each capped by the same field of `limits`.
+  CapacityHints boundedBy(const CapacityHints& limits) const;
+
+  /// Append the parameters of the hints that are set to a metadata MIME
+  /// type.
+  static std::string addToMimeType(
+      folly::StringPiece mimeType,
+      const CapacityHints& hints);
+
+  /// Strip the parameters of the hints from a metadata MIME type, returning
+  /// the hints.  Malformed ones are left unset.
+  static CapacityHints removeFromMimeType(std::string& mimeType);
+};
+
+std::ostream& operator<<(std::ostream&, const CapacityHints&);
+
+} // namespace rsocket
@@ -137,4 +137,29 @@ outer:
 std::string hexDump(folly::StringPiece s) {
   return folly::hexDump(s.data(), std::min<size_t>(0xFF, s.size()));
 }
+
+std::string removeMimeTypeParameter(
+    std::string& mimeType,
+    folly::StringPiece prefix) {
+  auto const pos = mimeType.find(prefix.str());
+  if (pos == std::string::npos) {
+    return std::string();
+  }
+
+  auto const valueBegin = pos + prefix.size();
+  auto valueEnd = mimeType.find(';', valueBegin);
+  if (valueEnd == std::string::npos) {
+    valueEnd = mimeType.size();
+  }
+  auto value = mimeType.substr(valueBegin, valueEnd - valueBegin);
+
+  // Remove the parameter together with the separator in front of it.
+  auto begin = pos;
+  while (begin > 0 &&
+         (mimeType[begin - 1] == ' ' || mimeType[begin - 1] == ';')) {
+    --begin;
+  }
+  mimeType.erase(begin, valueEnd - begin);
+  return folly::trimWhitespace(value).str();
+}
 } // namespace rsocket
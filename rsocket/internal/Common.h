@@ -47,6 +47,12 @@ constexpr int64_t kMaxRequestN = std::numeric_limits<int32_t>::max();
 std::string humanify(std::unique_ptr<folly::IOBuf> const&);
 std::string hexDump(folly::StringPiece s);
 
+/// Removes a parameter from a MIME type, returning its value, or an empty
+/// string if there was none.  `prefix` is the parameter name followed by '='.
+std::string removeMimeTypeParameter(
+    std::string& mimeType,
+    folly::StringPiece prefix);
+
 /// Indicates the reason why the stream stateMachine received a terminal signal
 /// from the connection.
 enum class StreamCompletionSignal {
@@ -66,7 +72,7 @@ enum class RSocketMode : uint8_t { SERVER, CLIENT };
 
 std::ostream& operator<<(std::ostream&, RSocketMode);
 
-enum class StreamType {
+enum class StreamType : uint8_t {
   REQUEST_RESPONSE,
   STREAM,
   CHANNEL,
@@ -0,0 +1,219 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/CompressingResumeManager.h"
+
+#include <folly/futures/Future.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/EventBaseManager.h>
+
+#include <algorithm>
+
+#include "rsocket/framing/FrameSerializer.h"
+
+namespace rsocket {
+
+CompressingResumeManager::CompressingResumeManager(
+    std::shared_ptr<RSocketStats> stats,
+    folly::Executor::KeepAlive<> compressor,
+    Options options,
+    size_t capacity)
+    : WarmResumeManager(
+          stats ? std::move(stats) : RSocketStats::noop(),
+          capacity),
+      compressor_(std::move(compressor)),
+      options_(std::move(options)) {}
+
+CompressingResumeManager::~CompressingResumeManager() {
+  if (compressed_) {
+    // The frames would otherwise be dropped by WarmResumeManager, which
+    // no longer sees them.
+    stats_->resumeBufferChanged(
+        -static_cast<int>(compressed_->frames.size()),
+        -static_cast<int>(compressed_->size));
+  }
+}
+
+void CompressingResumeManager::trackSentFrame(
+    const folly::IOBuf& serializedFrame,
+    FrameType frameType,
+    StreamId streamId,
+    size_t consumerAllowance) {
+  if (!shouldTrackFrame(frameType)) {
+    return;
+  }
+  expand();
+  ++generation_;
+  WarmResumeManager::trackSentFrame(
+      serializedFrame, frameType, streamId, consumerAllowance);
+}
+
+void CompressingResumeManager::resetUpToPosition(ResumePosition position) {
+  if (position <= firstSentPosition_) {
+    return;
+  }
+  expand();
+  ++generation_;
+  WarmResumeManager::resetUpToPosition(position);
+}
+
+bool CompressingResumeManager::isPositionAvailable(
+    ResumePosition position) const {
+  if (!compressed_) {
+    return WarmResumeManager::isPositionAvailable(position);
+  }
+  return position == lastSentPosition_ ||
+      std::binary_search(
+             compressed_->frames.begin(), compressed_->frames.end(), position);
+}
+
+void CompressingResumeManager::sendFramesFromPosition(
+    ResumePosition position,
+    FrameTransport& transport) const {
+  const_cast<CompressingResumeManager*>(this)->expand();
+  WarmResumeManager::sendFramesFromPosition(position, transport);
+}
+
+ResumePosition CompressingResumeManager::sendFramesFromPositionUpTo(
+    ResumePosition position,
+    FrameTransport& transport,
+    size_t maxBytes) const {
+  const_cast<CompressingResumeManager*>(this)->expand();
+  return WarmResumeManager::sendFramesFromPositionUpTo(
+      position, transport, maxBytes);
+}
+
+void CompressingResumeManager::onConnected() {
+  disconnected_ = false;
+  ++generation_;
+}
+
+void CompressingResumeManager::onDisconnected() {
+  disconnected_ = true;
+  ++generation_;
+  if (frames_.empty()) {
+    return;
+  }
+
+  auto const evb = folly::EventBaseManager::get()->getExistingEventBase();
+  if (!evb) {
+    return;
+  }
+  auto self = std::static_pointer_cast<CompressingResumeManager>(
+      shared_from_this());
+  evb->runAfterDelay(
+      [weak = std::weak_ptr<CompressingResumeManager>(self),
+       generation = generation_] {
+        auto manager = weak.lock();
+        if (manager && manager->generation_ == generation) {
+          manager->compress();
+        }
+      },
+      static_cast<uint32_t>(options_.idleDelay.count()));
+}
+
+size_t CompressingResumeManager::bufferedBytes() const {
+  return compressed_ ? compressed_->data->computeChainDataLength() : size_;
+}
+
+void CompressingResumeManager::compress() {
+  DCHECK(disconnected_);
+  if (frames_.empty() || compressed_) {
+    return;
+  }
+
+  // The clones share the buffers of the frames, which never change, so they
+  // can be read on the compressor.
+  auto compressed = std::make_unique<Compressed>();
+  compressed->size = size_;
+  compressed->frames.reserve(frames_.size());
+  std::unique_ptr<folly::IOBuf> chain;
+  for (const auto& frame : frames_) {
+    compressed->frames.push_back(frame.first);
+    if (chain) {
+      chain->prependChain(frame.second.clone());
+    } else {
+      chain = frame.second.clone();
+    }
+  }
+
+  auto const evb = folly::EventBaseManager::get()->getExistingEventBase();
+  DCHECK(evb);
+  auto self = std::static_pointer_cast<CompressingResumeManager>(
+      shared_from_this());
+  folly::via(
+      compressor_,
+      [codec = options_.codec,
+       chain = std::move(chain),
+       compressed = std::move(compressed)]() mutable {
+        compressed->data = folly::io::getCodec(codec)->compress(chain.get());
+        return std::move(compressed);
+      })
+      .via(folly::getKeepAliveToken(evb))
+      .thenTry([weak = std::weak_ptr<CompressingResumeManager>(self),
+                generation = generation_](
+                   folly::Try<std::unique_ptr<Compressed>> result) {
+        auto manager = weak.lock();
+        if (!manager) {
+          return;
+        }
+        if (result.hasException()) {
+          LOG(WARNING) << "Failed compressing resume buffer: "
+                       << result.exception().what();
+          return;
+        }
+        if (manager->generation_ == generation) {
+          manager->install(std::move(result.value()));
+        }
+      });
+}
+
+void CompressingResumeManager::install(std::unique_ptr<Compressed> compressed) {
+  DCHECK(!compressed_);
+  DCHECK(!frames_.empty() && frames_.front().first == compressed->frames[0]);
+  VLOG(4) << "Compressed resume buffer from " << compressed->size << " to "
+          << compressed->data->computeChainDataLength() << " bytes";
+  frames_.clear();
+  compressed_ = std::move(compressed);
+}
+
+void CompressingResumeManager::expand() {
+  if (!compressed_) {
+    return;
+  }
+  auto compressed = std::move(compressed_);
+  auto data = folly::io::getCodec(options_.codec)
+                  ->uncompress(compressed->data.get(), compressed->size);
+
+  folly::io::Cursor cursor(data.get());
+  for (size_t i = 0; i < compressed->frames.size(); ++i) {
+    auto const next = i + 1 < compressed->frames.size()
+        ? compressed->frames[i + 1]
+        : lastSentPosition_;
+    // Each frame gets a buffer of its own.  Slices of the uncompressed data
+    // would see the end of the previous frame as headroom, which framing the
+    // frame for the transport overwrites.
+    auto const length = static_cast<size_t>(next - compressed->frames[i]);
+    folly::IOBuf frame(
+        folly::IOBuf::CREATE, kFrameLengthFieldHeadroom + length);
+    frame.advance(kFrameLengthFieldHeadroom);
+    cursor.pull(frame.writableData(), length);
+    frame.append(length);
+    frames_.emplace_back(compressed->frames[i], std::move(frame));
+  }
+  DCHECK(cursor.isAtEnd());
+}
+
+} // namespace rsocket
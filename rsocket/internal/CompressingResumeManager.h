@@ -0,0 +1,107 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Executor.h>
+#include <folly/compression/Compression.h>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "rsocket/internal/WarmResumeManager.h"
+
+namespace rsocket {
+
+/// WarmResumeManager that compresses its buffered frames once the connection
+/// has been disconnected for `idleDelay`, so that connections waiting for a
+/// RESUME hold less memory.
+///
+/// Compression runs on the `compressor` executor.  The frames are only
+/// decompressed when they are needed again, usually by
+/// sendFramesFromPosition() when the connection resumes.  Must be owned by a
+/// shared_ptr, and used on the EventBase of its connection.
+class CompressingResumeManager : public WarmResumeManager {
+ public:
+  struct Options {
+    folly::io::CodecType codec{folly::io::CodecType::ZSTD};
+    std::chrono::milliseconds idleDelay{std::chrono::seconds(10)};
+  };
+
+  CompressingResumeManager(
+      std::shared_ptr<RSocketStats> stats,
+      folly::Executor::KeepAlive<> compressor,
+      Options options,
+      size_t capacity = DEFAULT_CAPACITY);
+  ~CompressingResumeManager();
+
+  void trackSentFrame(
+      const folly::IOBuf& serializedFrame,
+      FrameType frameType,
+      StreamId streamId,
+      size_t consumerAllowance) override;
+
+  void resetUpToPosition(ResumePosition position) override;
+
+  bool isPositionAvailable(ResumePosition position) const override;
+
+  void sendFramesFromPosition(
+      ResumePosition position,
+      FrameTransport& transport) const override;
+
+  ResumePosition sendFramesFromPositionUpTo(
+      ResumePosition position,
+      FrameTransport& transport,
+      size_t maxBytes) const override;
+
+  void onConnected() override;
+  void onDisconnected() override;
+
+  /// While compressed, the size of the compressed frames.
+  size_t bufferedBytes() const override;
+
+  bool isCompressed() const {
+    return compressed_ != nullptr;
+  }
+
+ private:
+  struct Compressed {
+    std::unique_ptr<folly::IOBuf> data;
+    /// Start positions of the frames, oldest first.
+    std::vector<ResumePosition> frames;
+    /// Total size of the frames before compression.
+    size_t size{0};
+  };
+
+  void compress();
+  void install(std::unique_ptr<Compressed>);
+
+  /// Puts the frames back in the buffer.  The frames themselves don't change,
+  /// so const methods can call it too.
+  void expand();
+
+  const folly::Executor::KeepAlive<> compressor_;
+  const Options options_;
+
+  bool disconnected_{false};
+
+  /// Bumped whenever the buffered frames change or the connection comes back,
+  /// which makes a compression in flight stale.
+  uint64_t generation_{0};
+
+  std::unique_ptr<Compressed> compressed_;
+};
+
+} // namespace rsocket
@@ -14,8 +14,11 @@
 
 #include "rsocket/internal/ConnectionSet.h"
 
+#include "rsocket/framing/Frame.h"
+#include "rsocket/framing/FrameSerializer.h"
 #include "rsocket/statemachine/RSocketStateMachine.h"
 
+#include <folly/hash/Hash.h>
 #include <folly/io/async/EventBase.h>
 
 namespace rsocket {
@@ -30,79 +33,476 @@ ConnectionSet::~ConnectionSet() {
 
 void ConnectionSet::shutdownAndWait() {
   VLOG(1) << "Started ConnectionSet::shutdownAndWait";
-  shutDown_ = true;
 
   SCOPE_EXIT {
     VLOG(1) << "Finished ConnectionSet::shutdownAndWait";
   };
 
-  StateMachineMap map;
+  auto map = takeAll();
+  if (map.empty()) {
+    VLOG(2) << "No connections to close, early exit";
+    return;
+  }
 
-  // Move all the connections out of the synchronized map so we don't block
-  // while closing the state machines.
-  {
-    const auto locked = machines_.lock();
-    if (locked->empty()) {
-      VLOG(2) << "No connections to close, early exit";
-      return;
+  VLOG(2) << "Need to close " << map.size() << " connections";
+  runOnEventBases(std::move(map), [](folly::EventBase&, auto& machines) {
+    for (auto& machine : machines) {
+      machine->close({}, StreamCompletionSignal::SOCKET_CLOSED);
+    }
+  });
+
+  VLOG(2) << "Waiting for connections to close";
+  waitForCloses(nullptr, {});
+  VLOG(2) << "Connections have closed";
+}
+
+void ConnectionSet::drainAndWait(
+    std::chrono::milliseconds timeout,
+    std::function<void(size_t)> onProgress,
+    std::chrono::milliseconds progressInterval,
+    std::function<void(ResumeIdentificationToken, ResumeHandoffState)>
+        handOff) {
+  VLOG(1) << "Started ConnectionSet::drainAndWait";
+
+  SCOPE_EXIT {
+    VLOG(1) << "Finished ConnectionSet::drainAndWait";
+  };
+
+  auto map = takeAll();
+  if (map.empty()) {
+    VLOG(2) << "No connections to drain, early exit";
+    return;
+  }
+
+  VLOG(2) << "Need to drain " << map.size() << " connections";
+  using Tokens =
+      std::unordered_map<RSocketStateMachine*, ResumeIdentificationToken>;
+  auto tokens = std::make_shared<Tokens>();
+  if (handOff) {
+    for (const auto& kv : map) {
+      if (kv.second.token) {
+        tokens->emplace(kv.first.get(), *kv.second.token);
+      }
     }
+  }
+
+  runOnEventBases(
+      std::move(map),
+      [timeout, tokens, handOff](folly::EventBase&, auto& machines) {
+        for (auto& machine : machines) {
+          folly::Function<void(ResumeHandoffState)> onHandOff;
+          auto const it = tokens->find(machine.get());
+          if (it != tokens->end()) {
+            onHandOff = [handOff, token = it->second](
+                            ResumeHandoffState state) mutable {
+              handOff(std::move(token), std::move(state));
+            };
+          }
+          machine->drain(
+              Frame_ERROR::connectionError("Server is shutting down"),
+              timeout,
+              std::move(onHandOff));
+        }
+      });
 
-    targetRemoves_ = removes_ + locked->size();
-    map.swap(*locked);
+  VLOG(2) << "Waiting for connections to drain";
+  waitForCloses(onProgress, progressInterval);
+  VLOG(2) << "Connections have drained";
+}
+
+size_t ConnectionSet::broadcastMetadataPush(
+    std::unique_ptr<folly::IOBuf> metadata) {
+  auto map = copyAll();
+  auto const count = map.size();
+  if (count == 0) {
+    return 0;
   }
 
-  VLOG(2) << "Need to close " << map.size() << " connections";
+  // A serializer of its own doesn't leave headroom for the frame length, so
+  // the framing of each connection chains the length in front of the shared
+  // buffer rather than writing into it.
+  auto const version = ProtocolVersion::Latest;
+  auto const serializer = FrameSerializer::shared(version, false);
+  std::shared_ptr<const folly::IOBuf> frame =
+      serializer->serializeOut(Frame_METADATA_PUSH(std::move(metadata)));
+
+  VLOG(2) << "Broadcasting METADATA_PUSH to " << count << " connections";
+  runOnEventBases(
+      std::move(map), [frame, version](folly::EventBase&, auto& machines) {
+        for (auto& machine : machines) {
+          machine->metadataPushSerialized(frame->clone(), version);
+        }
+      });
+  return count;
+}
+
+size_t ConnectionSet::broadcastFireAndForget(Payload request) {
+  auto map = copyAll();
+  auto const count = map.size();
+  if (count == 0) {
+    return 0;
+  }
+
+  // Each connection writes its own stream id over this one.
+  auto const version = ProtocolVersion::Latest;
+  auto const serializer = FrameSerializer::shared(version, false);
+  std::shared_ptr<const folly::IOBuf> frame = serializer->serializeOut(
+      Frame_REQUEST_FNF(1, FrameFlags::EMPTY_, std::move(request)));
+
+  VLOG(2) << "Broadcasting REQUEST_FNF to " << count << " connections";
+  runOnEventBases(
+      std::move(map), [frame, version](folly::EventBase&, auto& machines) {
+        for (auto& machine : machines) {
+          machine->fireAndForgetSerialized(frame->clone(), version);
+        }
+      });
+  return count;
+}
+
+size_t ConnectionSet::broadcastRequestStream(
+    Payload request,
+    std::function<std::shared_ptr<yarpl::flowable::Subscriber<Payload>>()>
+        makeSubscriber) {
+  auto map = copyAll();
+  auto const count = map.size();
+  if (count == 0) {
+    return 0;
+  }
+
+  // The initial REQUEST_N of every stream is its subscriber's, so only the
+  // payload can be shared.
+  auto shared = std::make_shared<const Payload>(std::move(request));
+  VLOG(2) << "Requesting a stream from " << count << " connections";
+  runOnEventBases(
+      std::move(map),
+      [shared, makeSubscriber = std::move(makeSubscriber)](
+          folly::EventBase&, auto& machines) {
+        for (auto& machine : machines) {
+          machine->requestStream(shared->clone(), makeSubscriber());
+        }
+      });
+  return count;
+}
+
+ConnectionSet::StateMachineMap ConnectionSet::copyAll() const {
+  StateMachineMap map;
+  map.reserve(size());
+  for (auto& shard : machineShards_) {
+    const auto locked = shard.machines.lock();
+    map.insert(locked->begin(), locked->end());
+  }
+  return map;
+}
+
+ConnectionSet::StateMachineMap ConnectionSet::takeAll() {
+  StateMachineMap map;
 
+  // Move all the connections out of the synchronized maps so we don't block
+  // while closing the state machines.  A shard that has been emptied rejects
+  // inserts, as shutDown_ is checked under its lock.
+  closing_ = 1;
+  shutDown_ = true;
+  for (auto& shard : machineShards_) {
+    const auto locked = shard.machines.lock();
+    closing_ += locked->size();
+    size_ -= locked->size();
+    for (auto& kv : *locked) {
+      map.emplace(std::move(kv));
+    }
+    locked->clear();
+  }
+
+  // remove() can't find the tokens of these connections anymore.
+  for (auto& shard : shards_) {
+    shard.index.lock()->clear();
+  }
+  return map;
+}
+
+void ConnectionSet::runOnEventBases(
+    StateMachineMap map,
+    std::function<void(
+        folly::EventBase&,
+        std::vector<std::shared_ptr<RSocketStateMachine>>&)> fn) {
+  // One hop per EventBase rather than per connection.
+  std::unordered_map<folly::EventBase*, StateMachineMap> byEventBase;
   for (auto& kv : map) {
-    auto rsocket = std::move(kv.first);
-    auto evb = kv.second;
+    byEventBase[eventBaseOf(kv.second)].insert(kv);
+  }
+  map.clear();
 
-    const auto close = [rs = std::move(rsocket)] {
-      rs->close({}, StreamCompletionSignal::SOCKET_CLOSED);
+  for (auto& kv : byEventBase) {
+    auto evb = kv.first;
+    auto run = [evb, fn](StateMachineMap entries) {
+      // Connections that moved to another EventBase since, e.g. rebalanced
+      // by the server, are followed there.
+      StateMachineMap moved;
+      std::vector<std::shared_ptr<RSocketStateMachine>> machines;
+      for (auto& entry : entries) {
+        if (eventBaseOf(entry.second) == evb) {
+          machines.push_back(entry.first);
+        } else {
+          moved.insert(entry);
+        }
+      }
+      if (!machines.empty()) {
+        fn(*evb, machines);
+      }
+      if (!moved.empty()) {
+        runOnEventBases(std::move(moved), fn);
+      }
     };
 
-    // We could be closing on the same thread as the state machine.  In that
-    // case, close the state machine inline, otherwise we hang.
+    // We could be running on the same thread as the state machines, e.g.
+    // closing them.  In that case, run inline, otherwise we hang.
     if (evb->isInEventBaseThread()) {
-      VLOG(3) << "Closing connection inline";
-      close();
+      VLOG(3) << "Running on " << kv.second.size() << " connections inline";
+      run(std::move(kv.second));
     } else {
-      VLOG(3) << "Closing connection asynchronously";
-      evb->runInEventBaseThread(close);
+      VLOG(3) << "Running on " << kv.second.size() << " connections "
+              << "asynchronously";
+      evb->runInEventBaseThread(
+          [run = std::move(run), entries = std::move(kv.second)]() mutable {
+            run(std::move(entries));
+          });
     }
   }
+}
 
-  VLOG(2) << "Waiting for connections to close";
-  shutdownDone_.wait();
-  VLOG(2) << "Connections have closed";
+folly::EventBase* ConnectionSet::eventBaseOf(const Entry& entry) {
+  return entry.state ? entry.state->eventBase() : entry.evb;
+}
+
+void ConnectionSet::waitForCloses(
+    const std::function<void(size_t)>& onProgress,
+    std::chrono::milliseconds progressInterval) {
+  // Some of the connections may have closed already.
+  onShutdownClose();
+
+  if (!onProgress) {
+    shutdownDone_.wait();
+    return;
+  }
+  while (!shutdownDone_.try_wait_for(progressInterval)) {
+    onProgress(closing_.load(std::memory_order_relaxed));
+  }
+  onProgress(0);
+}
+
+void ConnectionSet::onShutdownClose() {
+  if (closing_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    shutdownDone_.post();
+  }
 }
 
 bool ConnectionSet::insert(
     std::shared_ptr<RSocketStateMachine> machine,
-    folly::EventBase* evb) {
+    folly::EventBase* evb,
+    std::shared_ptr<RSocketServerState> state) {
   VLOG(4) << "insert(" << machine.get() << ", " << evb << ")";
 
+  Entry entry;
+  entry.evb = evb;
+  entry.state = std::move(state);
+  const auto locked = shardFor(machine.get()).machines.lock();
   if (shutDown_) {
     return false;
   }
-  machines_.lock()->emplace(std::move(machine), evb);
+  locked->emplace(std::move(machine), std::move(entry));
+  ++size_;
   return true;
 }
 
 void ConnectionSet::remove(RSocketStateMachine& machine) {
   VLOG(4) << "remove(" << &machine << ")";
 
-  const auto locked = machines_.lock();
-  auto const result = locked->erase(machine.shared_from_this());
-  DCHECK_LE(result, 1);
+  {
+    const auto locked = shardFor(&machine).machines.lock();
+    auto const it = locked->find(machine.shared_from_this());
+    if (it != locked->end()) {
+      if (it->second.token) {
+        auto index = shardFor(*it->second.token).index.lock();
+        auto const found = index->find(*it->second.token);
+        // The token may have been reused by a newer connection.
+        if (found != index->end() &&
+            found->second->rSocketStateMachine_.get() == &machine) {
+          index->erase(found);
+        }
+      }
+      locked->erase(it);
+      --size_;
+      return;
+    }
+  }
+
+  // Not in the set, so shutdownAndWait() took it out.
+  if (shutDown_) {
+    onShutdownClose();
+  }
+}
 
-  if (++removes_ == targetRemoves_) {
-    shutdownDone_.post();
+void ConnectionSet::setEventBase(
+    RSocketStateMachine& machine,
+    folly::EventBase* evb) {
+  VLOG(4) << "setEventBase(" << &machine << ", " << evb << ")";
+
+  const auto locked = shardFor(&machine).machines.lock();
+  auto const it = locked->find(machine.shared_from_this());
+  if (it != locked->end()) {
+    it->second.evb = evb;
+  }
+}
+
+std::unordered_map<folly::EventBase*, size_t>
+ConnectionSet::countByEventBase() const {
+  std::unordered_map<folly::EventBase*, size_t> counts;
+  for (auto& shard : machineShards_) {
+    const auto locked = shard.machines.lock();
+    for (auto& kv : *locked) {
+      ++counts[kv.second.evb];
+    }
+  }
+  return counts;
+}
+
+std::vector<std::shared_ptr<RSocketServerState>> ConnectionSet::serverStatesOn(
+    folly::EventBase* evb) const {
+  std::vector<std::shared_ptr<RSocketServerState>> states;
+  for (auto& shard : machineShards_) {
+    const auto locked = shard.machines.lock();
+    for (auto& kv : *locked) {
+      if (kv.second.state && kv.second.evb == evb) {
+        states.push_back(kv.second.state);
+      }
+    }
   }
+  return states;
 }
 
 size_t ConnectionSet::size() const {
-  return machines_.lock()->size();
+  return size_.load(std::memory_order_relaxed);
+}
+
+void ConnectionSet::indexResumable(
+    const ResumeIdentificationToken& token,
+    std::shared_ptr<RSocketServerState> state) {
+  const auto locked =
+      shardFor(state->rSocketStateMachine_.get()).machines.lock();
+  auto const it = locked->find(state->rSocketStateMachine_);
+  if (it == locked->end()) {
+    // Already closed, or the set is shutting down.
+    return;
+  }
+  it->second.token = token;
+  (*shardFor(token).index.lock())[token] = std::move(state);
+}
+
+std::shared_ptr<RSocketServerState> ConnectionSet::findResumable(
+    const ResumeIdentificationToken& token) const {
+  const auto index = shardFor(token).index.lock();
+  auto const it = index->find(token);
+  return it != index->end() ? it->second : nullptr;
+}
+
+namespace {
+/// Runs `fn` on the EventBase of a connection, following the connection if
+/// it moves to another EventBase before `fn` gets to run.
+template <typename F>
+auto viaEventBaseOf(
+    folly::EventBase* evb,
+    std::shared_ptr<RSocketServerState> state,
+    F fn) -> folly::SemiFuture<decltype(fn())> {
+  using T = decltype(fn());
+  return folly::via(
+             folly::getKeepAliveToken(evb),
+             [evb, state = std::move(state), fn = std::move(fn)]() mutable
+             -> folly::SemiFuture<T> {
+               auto const current = state ? state->eventBase() : evb;
+               if (current != evb) {
+                 return viaEventBaseOf(
+                     current, std::move(state), std::move(fn));
+               }
+               return folly::makeSemiFuture(fn());
+             })
+      .semi();
+}
+} // namespace
+
+ConnectionSet::MachineShard& ConnectionSet::shardFor(
+    const RSocketStateMachine* machine) const {
+  auto const hash =
+      folly::hash::twang_mix64(reinterpret_cast<uintptr_t>(machine));
+  return machineShards_[hash % kMachineShards];
+}
+
+ConnectionSet::Shard& ConnectionSet::shardFor(
+    const ResumeIdentificationToken& token) const {
+  // The low bits pick the bucket inside the shard, so use the high ones.
+  return shards_[(token.hash() >> 32) % kResumeIndexShards];
+}
+
+folly::SemiFuture<MemoryUsage> ConnectionSet::memoryUsage() const {
+  std::vector<folly::SemiFuture<MemoryUsage>> usages;
+  usages.reserve(size());
+  for (auto& shard : machineShards_) {
+    const auto locked = shard.machines.lock();
+    for (auto& kv : *locked) {
+      usages.push_back(viaEventBaseOf(
+          kv.second.evb, kv.second.state, [machine = kv.first] {
+            return machine->memoryUsage();
+          }));
+    }
+  }
+
+  return folly::collectAll(std::move(usages))
+      .deferValue([](std::vector<folly::Try<MemoryUsage>> results) {
+        MemoryUsage total;
+        for (auto& result : results) {
+          if (result.hasValue()) {
+            total += result.value();
+          }
+        }
+        return total;
+      });
+}
+
+folly::SemiFuture<folly::Optional<ResumeHandoffState>> ConnectionSet::handOff(
+    const ResumeIdentificationToken& token) {
+  auto state = findResumable(token);
+  if (!state) {
+    return folly::makeSemiFuture(folly::Optional<ResumeHandoffState>());
+  }
+  auto const evb = state->eventBase();
+  return viaEventBaseOf(evb, state, [machine = state->rSocketStateMachine_] {
+    return machine->handOff();
+  });
+}
+
+folly::SemiFuture<std::vector<ConnectionFlowControl>>
+ConnectionSet::flowControl() const {
+  std::vector<folly::SemiFuture<ConnectionFlowControl>> snapshots;
+  snapshots.reserve(size());
+  for (auto& shard : machineShards_) {
+    const auto locked = shard.machines.lock();
+    for (auto& kv : *locked) {
+      snapshots.push_back(viaEventBaseOf(
+          kv.second.evb, kv.second.state, [machine = kv.first] {
+            return machine->flowControl();
+          }));
+    }
+  }
+
+  return folly::collectAll(std::move(snapshots))
+      .deferValue([](std::vector<folly::Try<ConnectionFlowControl>> results) {
+        std::vector<ConnectionFlowControl> connections;
+        connections.reserve(results.size());
+        for (auto& result : results) {
+          if (result.hasValue()) {
+            connections.push_back(std::move(result.value()));
+          }
+        }
+        return connections;
+      });
 }
 
 } // namespace rsocket
@@ -14,13 +14,24 @@
 
 #pragma once
 
+#include <folly/Optional.h>
 #include <folly/Synchronized.h>
+#include <folly/container/F14Map.h>
+#include <folly/futures/Future.h>
+#include <folly/lang/Align.h>
 #include <folly/synchronization/Baton.h>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
+#include <vector>
 
+#include "rsocket/RSocketServerState.h"
+#include "rsocket/framing/ResumeIdentificationToken.h"
 #include "rsocket/statemachine/RSocketStateMachine.h"
 
 namespace folly {
@@ -34,26 +45,169 @@ namespace rsocket {
 ///
 /// Also tracks which EventBase is controlling each state machine so that they
 /// can be closed on the correct thread.
+///
+/// The state machines are split into shards by address, with a lock each, so
+/// that a storm of connections and reconnections on many threads doesn't
+/// contend on a single lock.
+///
+/// Resumable connections can also be indexed by their resume token.  The index
+/// is sharded the same way, by token.
 class ConnectionSet : public RSocketStateMachine::CloseCallback {
  public:
+  static constexpr size_t kMachineShards = 64;
+  static constexpr size_t kResumeIndexShards = 64;
+
   ConnectionSet();
   virtual ~ConnectionSet();
 
-  bool insert(std::shared_ptr<RSocketStateMachine>, folly::EventBase*);
+  /// Adds a state machine, along with the state of its connection on the
+  /// server.  That state's EventBase is then the one of the state machine,
+  /// so that calls follow it when it moves.
+  bool insert(
+      std::shared_ptr<RSocketStateMachine>,
+      folly::EventBase*,
+      std::shared_ptr<RSocketServerState> state = nullptr);
   void remove(RSocketStateMachine&) override;
 
+  /// Records that a state machine in the set moved to another EventBase.
+  void setEventBase(RSocketStateMachine&, folly::EventBase*);
+
+  /// Number of state machines on each EventBase.
+  std::unordered_map<folly::EventBase*, size_t> countByEventBase() const;
+
+  /// States of the connections on the given EventBase, of those inserted
+  /// with one.
+  std::vector<std::shared_ptr<RSocketServerState>> serverStatesOn(
+      folly::EventBase*) const;
+
+  /// Number of state machines in the set.  Doesn't lock.
   size_t size() const;
 
+  /// Indexes the state of a connection already in the set by its resume
+  /// token.  It is removed from the index when the connection closes.
+  void indexResumable(
+      const ResumeIdentificationToken&,
+      std::shared_ptr<RSocketServerState>);
+
+  /// Returns the state of the connection with the given resume token, or
+  /// nullptr if there is none.
+  std::shared_ptr<RSocketServerState> findResumable(
+      const ResumeIdentificationToken&) const;
+
+  /// Sums up the memory used by all the connections.  Each connection is
+  /// read on its own EventBase.
+  folly::SemiFuture<MemoryUsage> memoryUsage() const;
+
+  /// Flow control state of every connection, each read on its own EventBase.
+  /// Connections that close meanwhile are left out.
+  folly::SemiFuture<std::vector<ConnectionFlowControl>> flowControl() const;
+
+  /// Sends a METADATA_PUSH frame to every connection.  The frame is
+  /// serialized once and its buffer shared by all the connections, which are
+  /// handed it in one batch per EventBase.  Returns the number of connections
+  /// it was dispatched to.
+  size_t broadcastMetadataPush(std::unique_ptr<folly::IOBuf> metadata);
+
+  /// Sends a REQUEST_FNF frame to every connection, serialized once like
+  /// broadcastMetadataPush().  Only the stream id is written for each
+  /// connection.  Returns the number of connections it was dispatched to.
+  size_t broadcastFireAndForget(Payload request);
+
+  /// Requests a stream from every connection.  `makeSubscriber` is called on
+  /// the EventBase of each connection, concurrently, for the subscriber of
+  /// its stream.  The connections share the buffers of `request`.  Returns
+  /// the number of connections it was dispatched to.
+  size_t broadcastRequestStream(
+      Payload request,
+      std::function<std::shared_ptr<yarpl::flowable::Subscriber<Payload>>()>
+          makeSubscriber);
+
+  /// Closes every connection and waits for them to have closed.
   void shutdownAndWait();
 
+  /// Drains every connection, see RSocketStateMachine::drain(), and waits
+  /// for them to have closed.  The connections are drained in parallel, on
+  /// their own EventBases.  While waiting, calls `onProgress` with the number
+  /// of connections still open every `progressInterval`.  With `handOff`,
+  /// the connections in the resume index are handed over rather than closed
+  /// with an ERROR frame, and `handOff` is called with their state.
+  void drainAndWait(
+      std::chrono::milliseconds timeout,
+      std::function<void(size_t)> onProgress = nullptr,
+      std::chrono::milliseconds progressInterval = std::chrono::seconds{1},
+      std::function<void(ResumeIdentificationToken, ResumeHandoffState)>
+          handOff = nullptr);
+
+  /// Hands over the connection with the given resume token, see
+  /// RSocketStateMachine::handOff(), on its EventBase.  Returns folly::none
+  /// if there is no such connection, or if it can't be handed over.
+  folly::SemiFuture<folly::Optional<ResumeHandoffState>> handOff(
+      const ResumeIdentificationToken&);
+
  private:
-  using StateMachineMap = std::
-      unordered_map<std::shared_ptr<RSocketStateMachine>, folly::EventBase*>;
+  struct Entry {
+    folly::EventBase* evb{nullptr};
+    std::shared_ptr<RSocketServerState> state;
+    /// Set once the connection is in the resume index.
+    folly::Optional<ResumeIdentificationToken> token;
+  };
+
+  /// The EventBase of the state machine of an entry.  Read from its state
+  /// when there is one, which could have moved since the entry was copied.
+  static folly::EventBase* eventBaseOf(const Entry&);
+
+  using StateMachineMap =
+      std::unordered_map<std::shared_ptr<RSocketStateMachine>, Entry>;
+
+  using ResumeIndex = folly::F14FastMap<
+      ResumeIdentificationToken,
+      std::shared_ptr<RSocketServerState>>;
+
+  struct alignas(folly::hardware_destructive_interference_size) MachineShard {
+    folly::Synchronized<StateMachineMap, std::mutex> machines;
+  };
+
+  struct alignas(folly::hardware_destructive_interference_size) Shard {
+    folly::Synchronized<ResumeIndex, std::mutex> index;
+  };
+
+  MachineShard& shardFor(const RSocketStateMachine*) const;
+  Shard& shardFor(const ResumeIdentificationToken&) const;
+
+  /// Takes all the state machines out of the set and stops it from taking
+  /// new ones.
+  StateMachineMap takeAll();
+
+  /// Copies the state machines of the set, leaving them in it.
+  StateMachineMap copyAll() const;
+
+  /// Runs `fn` once on every EventBase of the state machines, with the state
+  /// machines of that EventBase.  Follows the state machines that move to
+  /// another EventBase before `fn` gets to run.
+  static void runOnEventBases(
+      StateMachineMap,
+      std::function<void(
+          folly::EventBase&,
+          std::vector<std::shared_ptr<RSocketStateMachine>>&)> fn);
+
+  /// Waits for the state machines taken by takeAll() to have closed.
+  void waitForCloses(
+      const std::function<void(size_t)>& onProgress,
+      std::chrono::milliseconds progressInterval);
+
+  /// Called for every state machine that takeAll() took out of the set, once
+  /// it has closed.
+  void onShutdownClose();
+
+  // Lock order: a machine shard before a resume index shard.
+  mutable std::array<MachineShard, kMachineShards> machineShards_;
+  mutable std::array<Shard, kResumeIndexShards> shards_;
+  std::atomic<size_t> size_{0};
 
-  folly::Synchronized<StateMachineMap, std::mutex> machines_;
   folly::Baton<> shutdownDone_;
-  size_t removes_{0};
-  size_t targetRemoves_{0};
+  /// State machines taken out by takeAll() that haven't closed yet, plus one
+  /// until waitForCloses().
+  std::atomic<size_t> closing_{0};
   std::atomic<bool> shutDown_{false};
 };
 
@@ -0,0 +1,164 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Portability.h>
+
+#if FOLLY_HAS_COROUTINES
+
+#include <folly/Optional.h>
+#include <folly/experimental/coro/Baton.h>
+#include <folly/experimental/coro/Task.h>
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+
+#include "rsocket/Payload.h"
+#include "yarpl/flowable/Subscriber.h"
+
+namespace rsocket {
+
+/// Subscriber that buffers the elements of a stream for a coroutine to pull
+/// them with next().
+///
+/// Credits are granted in batches: `batch` elements up front, and another
+/// round whenever the coroutine has consumed half a batch, so the peer
+/// gets a REQUEST_N every batch / 2 elements rather than for every element.
+/// The buffer holds at most `batch` elements.
+class CoroStreamSubscriber : public yarpl::flowable::Subscriber<Payload> {
+ public:
+  explicit CoroStreamSubscriber(size_t batch)
+      : batch_(std::max<size_t>(batch, 1)) {}
+
+  /// The next element, or none at the end of the stream.  Throws the error
+  /// of the stream.  Must not be called concurrently.
+  folly::coro::Task<folly::Optional<Payload>> next() {
+    while (true) {
+      std::shared_ptr<yarpl::flowable::Subscription> subscription;
+      int64_t credits = 0;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!items_.empty()) {
+          auto item = std::move(items_.front());
+          items_.pop_front();
+          if (++consumed_ >= (batch_ + 1) / 2) {
+            credits = static_cast<int64_t>(consumed_);
+            consumed_ = 0;
+            subscription = subscription_;
+          }
+          lock.unlock();
+          if (subscription) {
+            subscription->request(credits);
+          }
+          co_return std::move(item);
+        }
+        if (completed_) {
+          co_return folly::none;
+        }
+        if (error_) {
+          error_.throw_exception();
+        }
+        baton_.reset();
+      }
+      co_await baton_;
+    }
+  }
+
+  /// Cancels the stream.  Pending and later calls to next() end it.
+  void cancel() {
+    std::shared_ptr<yarpl::flowable::Subscription> subscription;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (cancelled_) {
+        return;
+      }
+      cancelled_ = true;
+      completed_ = true;
+      items_.clear();
+      subscription = std::move(subscription_);
+    }
+    if (subscription) {
+      subscription->cancel();
+    }
+    baton_.post();
+  }
+
+  void onSubscribe(
+      std::shared_ptr<yarpl::flowable::Subscription> subscription) override {
+    bool cancelled;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      cancelled = cancelled_;
+      if (!cancelled) {
+        subscription_ = subscription;
+      }
+    }
+    if (cancelled) {
+      subscription->cancel();
+    } else {
+      subscription->request(static_cast<int64_t>(batch_));
+    }
+  }
+
+  void onNext(Payload value) override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (cancelled_) {
+        return;
+      }
+      items_.push_back(std::move(value));
+    }
+    baton_.post();
+  }
+
+  void onComplete() override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      completed_ = true;
+      subscription_ = nullptr;
+    }
+    baton_.post();
+  }
+
+  void onError(folly::exception_wrapper ex) override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (cancelled_) {
+        return;
+      }
+      error_ = std::move(ex);
+      subscription_ = nullptr;
+    }
+    baton_.post();
+  }
+
+ private:
+  const size_t batch_;
+
+  std::mutex mutex_;
+  std::shared_ptr<yarpl::flowable::Subscription> subscription_;
+  std::deque<Payload> items_;
+  /// Elements consumed since credits were last granted.
+  size_t consumed_{0};
+  bool completed_{false};
+  bool cancelled_{false};
+  folly::exception_wrapper error_;
+  folly::coro::Baton baton_{false};
+};
+
+} // namespace rsocket
+
+#endif // FOLLY_HAS_COROUTINES
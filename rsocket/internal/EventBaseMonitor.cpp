@@ -0,0 +1,135 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/EventBaseMonitor.h"
+
+#include <folly/io/async/EventBase.h>
+
+#include <algorithm>
+#include <array>
+
+namespace rsocket {
+
+namespace {
+
+constexpr size_t kActivities =
+    static_cast<size_t>(RSocketStats::EventBaseActivity::WRITE) + 1;
+
+/// The activity the thread is on, and the time it spent on each one since
+/// the last report.
+struct ThreadActivities {
+  bool monitored{false};
+  bool inScope{false};
+  RSocketStats::EventBaseActivity current{};
+  EventBaseMonitor::Clock::time_point since;
+  std::array<EventBaseMonitor::Clock::duration, kActivities> time{};
+
+  void account(EventBaseMonitor::Clock::time_point now) {
+    time[static_cast<size_t>(current)] += now - since;
+    since = now;
+  }
+};
+
+thread_local ThreadActivities threadActivities;
+
+} // namespace
+
+std::shared_ptr<EventBaseMonitor> EventBaseMonitor::create(
+    folly::EventBase& eventBase,
+    Options options,
+    std::shared_ptr<RSocketStats> stats) {
+  auto monitor = std::make_shared<EventBaseMonitor>(options, std::move(stats));
+  eventBase.runInEventBaseThread(
+      [weakMonitor = std::weak_ptr<EventBaseMonitor>(monitor), &eventBase] {
+        if (auto self = weakMonitor.lock()) {
+          threadActivities = ThreadActivities();
+          threadActivities.monitored = true;
+          self->scheduleReport(eventBase);
+        }
+      });
+  return monitor;
+}
+
+EventBaseMonitor::ActivityScope::ActivityScope(Activity activity) {
+  auto& activities = threadActivities;
+  if (!activities.monitored) {
+    return;
+  }
+  auto const now = Clock::now();
+  active_ = true;
+  nested_ = activities.inScope;
+  if (nested_) {
+    previous_ = activities.current;
+    activities.account(now);
+  } else {
+    activities.since = now;
+  }
+  activities.current = activity;
+  activities.inScope = true;
+}
+
+EventBaseMonitor::ActivityScope::~ActivityScope() {
+  auto& activities = threadActivities;
+  if (!active_ || !activities.monitored) {
+    return;
+  }
+  activities.account(Clock::now());
+  activities.inScope = nested_;
+  if (nested_) {
+    activities.current = previous_;
+  }
+}
+
+void EventBaseMonitor::report(
+    folly::EventBase& eventBase,
+    Clock::duration lag) {
+  auto& activities = threadActivities;
+  if (activities.inScope) {
+    activities.account(Clock::now());
+  }
+
+  stats_->eventBaseLoopLag(
+      &eventBase,
+      std::chrono::duration_cast<std::chrono::microseconds>(lag),
+      eventBase.getNotificationQueueSize());
+  for (size_t i = 0; i < kActivities; ++i) {
+    stats_->eventBaseActivity(
+        &eventBase,
+        static_cast<Activity>(i),
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            activities.time[i]));
+    activities.time[i] = Clock::duration::zero();
+  }
+}
+
+void EventBaseMonitor::scheduleReport(folly::EventBase& eventBase) {
+  auto const due = Clock::now() + options_.interval;
+  eventBase.runAfterDelay(
+      [weakThis = std::weak_ptr<EventBaseMonitor>(shared_from_this()),
+       &eventBase,
+       due] {
+        auto self = weakThis.lock();
+        if (!self) {
+          // Stop timing activities nobody reports on anymore.
+          threadActivities = ThreadActivities();
+          return;
+        }
+        auto const now = Clock::now();
+        self->report(eventBase, std::max(now - due, Clock::duration::zero()));
+        self->scheduleReport(eventBase);
+      },
+      static_cast<uint32_t>(options_.interval.count()));
+}
+
+} // namespace rsocket
@@ -0,0 +1,91 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+
+#include "rsocket/RSocketStats.h"
+
+namespace folly {
+class EventBase;
+}
+
+namespace rsocket {
+
+/// Instrumentation of an EventBase thread, see
+/// RSocketServer::setEventBaseMonitoring().
+///
+/// Every `interval` the monitor reports to RSocketStats how late its timer
+/// fired, the depth of the NotificationQueue of the EventBase, and the time
+/// the thread spent on each RSocketStats::EventBaseActivity since the last
+/// report.
+///
+/// Time is attributed to an activity by the ActivityScopes living on the
+/// thread.  Scopes nest, and the time spent in a nested scope only counts for
+/// its own activity, e.g. the frames a read dispatches don't count as read
+/// time.  Scopes cost a clock read on either end on monitored threads, and
+/// nothing else elsewhere.
+class EventBaseMonitor : public std::enable_shared_from_this<EventBaseMonitor> {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using Activity = RSocketStats::EventBaseActivity;
+
+  struct Options {
+    /// Time between two reports.
+    std::chrono::milliseconds interval{1000};
+  };
+
+  /// A monitor that reports on `eventBase` until it is destroyed.
+  static std::shared_ptr<EventBaseMonitor> create(
+      folly::EventBase& eventBase,
+      Options options,
+      std::shared_ptr<RSocketStats> stats);
+
+  EventBaseMonitor(Options options, std::shared_ptr<RSocketStats> stats)
+      : options_{options}, stats_{std::move(stats)} {}
+
+  /// Attributes the time the calling thread spends while it lives to
+  /// `activity`, if the thread is monitored.
+  class ActivityScope {
+   public:
+    explicit ActivityScope(Activity activity);
+    ~ActivityScope();
+
+    ActivityScope(const ActivityScope&) = delete;
+    ActivityScope& operator=(const ActivityScope&) = delete;
+
+   private:
+    bool active_{false};
+    bool nested_{false};
+    Activity previous_{};
+  };
+
+  /// Reports the state of the calling thread, which must be the one of
+  /// `eventBase`, with the given loop lag.
+  void report(folly::EventBase& eventBase, Clock::duration lag);
+
+  const Options& options() const {
+    return options_;
+  }
+
+ private:
+  void scheduleReport(folly::EventBase& eventBase);
+
+  const Options options_;
+  const std::shared_ptr<RSocketStats> stats_;
+};
+
+} // namespace rsocket
@@ -0,0 +1,77 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Executor.h>
+
+#include "yarpl/single/SingleObserver.h"
+#include "yarpl/single/SingleSubscription.h"
+
+namespace rsocket {
+
+// A wrapper over SingleSubscription that runs cancel() on an Executor.
+class ExecutorSingleSubscription : public yarpl::single::SingleSubscription {
+ public:
+  ExecutorSingleSubscription(
+      std::shared_ptr<yarpl::single::SingleSubscription> inner,
+      folly::Executor::KeepAlive<> executor)
+      : inner_(std::move(inner)), executor_(std::move(executor)) {}
+
+  void cancel() override {
+    executor_->add([inner = std::move(inner_)] { inner->cancel(); });
+  }
+
+ private:
+  std::shared_ptr<yarpl::single::SingleSubscription> inner_;
+  const folly::Executor::KeepAlive<> executor_;
+};
+
+//
+// This class is to wrap a SingleObserver of the library that is handed to the
+// application code running on an Executor.  The SingleSubscription passed to
+// onSubscribe is wrapped in an ExecutorSingleSubscription, so that the
+// library's call to cancel runs on the Executor.
+//
+template <typename T>
+class ExecutorSubscriptionSingleObserver
+    : public yarpl::single::SingleObserver<T> {
+ public:
+  ExecutorSubscriptionSingleObserver(
+      std::shared_ptr<yarpl::single::SingleObserver<T>> observer,
+      folly::Executor::KeepAlive<> executor)
+      : inner_(std::move(observer)), executor_(std::move(executor)) {}
+
+  void onSubscribe(std::shared_ptr<yarpl::single::SingleSubscription>
+                       subscription) override {
+    inner_->onSubscribe(std::make_shared<ExecutorSingleSubscription>(
+        std::move(subscription), executor_));
+  }
+
+  // No further calls to the subscription after this method is invoked.
+  void onSuccess(T value) override {
+    inner_->onSuccess(std::move(value));
+  }
+
+  // No further calls to the subscription after this method is invoked.
+  void onError(folly::exception_wrapper ex) override {
+    inner_->onError(std::move(ex));
+  }
+
+ private:
+  const std::shared_ptr<yarpl::single::SingleObserver<T>> inner_;
+  const folly::Executor::KeepAlive<> executor_;
+};
+
+} // namespace rsocket
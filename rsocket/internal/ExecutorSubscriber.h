@@ -0,0 +1,128 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Executor.h>
+
+#include "yarpl/flowable/Subscriber.h"
+#include "yarpl/flowable/Subscription.h"
+
+namespace rsocket {
+
+// A wrapper over Subscription that runs all of the subscription's methods on
+// an Executor.  Used with a SerialExecutor to keep the calls of a stream in
+// order.
+class ExecutorSubscription : public yarpl::flowable::Subscription {
+ public:
+  ExecutorSubscription(
+      std::shared_ptr<yarpl::flowable::Subscription> inner,
+      folly::Executor::KeepAlive<> executor)
+      : inner_(std::move(inner)), executor_(std::move(executor)) {}
+
+  void request(int64_t n) override {
+    executor_->add([inner = inner_, n] { inner->request(n); });
+  }
+
+  void cancel() override {
+    executor_->add([inner = std::move(inner_)] { inner->cancel(); });
+  }
+
+ private:
+  std::shared_ptr<yarpl::flowable::Subscription> inner_;
+  const folly::Executor::KeepAlive<> executor_;
+};
+
+//
+// A decorator of the Subscriber object which runs the method calls on the
+// provided Executor.
+// This class should be used to wrap a Subscriber provided from the
+// application code, whose methods the library calls on its EventBase.
+//
+template <typename T>
+class ExecutorSubscriber : public yarpl::flowable::Subscriber<T> {
+ public:
+  ExecutorSubscriber(
+      std::shared_ptr<yarpl::flowable::Subscriber<T>> inner,
+      folly::Executor::KeepAlive<> executor)
+      : inner_(std::move(inner)), executor_(std::move(executor)) {}
+
+  void onSubscribe(
+      std::shared_ptr<yarpl::flowable::Subscription> subscription) override {
+    executor_->add([inner = inner_, subscription = std::move(subscription)] {
+      inner->onSubscribe(std::move(subscription));
+    });
+  }
+
+  void onComplete() override {
+    executor_->add([inner = inner_] { inner->onComplete(); });
+  }
+
+  void onError(folly::exception_wrapper ex) override {
+    executor_->add([inner = inner_, ex = std::move(ex)]() mutable {
+      inner->onError(std::move(ex));
+    });
+  }
+
+  void onNext(T value) override {
+    executor_->add([inner = inner_, value = std::move(value)]() mutable {
+      inner->onNext(std::move(value));
+    });
+  }
+
+ private:
+  const std::shared_ptr<yarpl::flowable::Subscriber<T>> inner_;
+  const folly::Executor::KeepAlive<> executor_;
+};
+
+//
+// This class is to wrap a Subscriber of the library that is handed to the
+// application code running on an Executor.  The Subscription the library
+// passes to onSubscribe is wrapped in an ExecutorSubscription, so that the
+// library's calls to request and cancel run on the Executor.
+//
+template <typename T>
+class ExecutorSubscriptionSubscriber : public yarpl::flowable::Subscriber<T> {
+ public:
+  ExecutorSubscriptionSubscriber(
+      std::shared_ptr<yarpl::flowable::Subscriber<T>> inner,
+      folly::Executor::KeepAlive<> executor)
+      : inner_(std::move(inner)), executor_(std::move(executor)) {}
+
+  void onSubscribe(
+      std::shared_ptr<yarpl::flowable::Subscription> sub) override {
+    inner_->onSubscribe(
+        std::make_shared<ExecutorSubscription>(std::move(sub), executor_));
+  }
+
+  void onNext(T value) override {
+    inner_->onNext(std::move(value));
+  }
+
+  void onComplete() override {
+    auto inner = std::move(inner_);
+    inner->onComplete();
+  }
+
+  void onError(folly::exception_wrapper ew) override {
+    auto inner = std::move(inner_);
+    inner->onError(std::move(ew));
+  }
+
+ private:
+  std::shared_ptr<yarpl::flowable::Subscriber<T>> inner_;
+  const folly::Executor::KeepAlive<> executor_;
+};
+
+} // namespace rsocket
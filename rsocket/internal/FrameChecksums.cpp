@@ -0,0 +1,41 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/FrameChecksums.h"
+
+#include <folly/Conv.h>
+
+#include "rsocket/internal/Common.h"
+
+namespace rsocket {
+
+namespace {
+
+constexpr folly::StringPiece kMimeParameter{"rsocket-frame-checksum="};
+
+} // namespace
+
+constexpr folly::StringPiece FrameChecksums::kCrc32c;
+
+std::string FrameChecksums::addToMimeType(
+    folly::StringPiece mimeType,
+    folly::StringPiece checksum) {
+  return folly::to<std::string>(mimeType, ";", kMimeParameter, checksum);
+}
+
+std::string FrameChecksums::removeFromMimeType(std::string& mimeType) {
+  return removeMimeTypeParameter(mimeType, kMimeParameter);
+}
+
+} // namespace rsocket
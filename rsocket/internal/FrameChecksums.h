@@ -0,0 +1,55 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Range.h>
+
+#include <string>
+
+namespace rsocket {
+
+/// Per-frame integrity checks, on top of whatever the transport does.
+///
+/// The client asks for them by adding a `rsocket-frame-checksum=crc32c`
+/// parameter to the metadata MIME type of its SETUP frame.  Every later frame
+/// sent by either end, other than RESUME and RESUME_OK, then ends with the
+/// CRC32C of the rest of the frame, which the receiving end checks before
+/// handing the frame on.  A frame that doesn't match closes the connection.
+///
+/// The trailers are added and checked by the framed connection (see
+/// FramedDuplexConnection::enableFrameChecksums()), so frames buffered for
+/// resumption and the positions they count don't include them.  A session
+/// with frame checksums can't be cold resumed or handed over to another
+/// server, since neither records them.
+class FrameChecksums {
+ public:
+  /// The only checksum there is.
+  static constexpr folly::StringPiece kCrc32c{"crc32c"};
+
+  static bool isSupported(folly::StringPiece checksum) {
+    return checksum == kCrc32c;
+  }
+
+  /// Append the frame checksum parameter to a metadata MIME type.
+  static std::string addToMimeType(
+      folly::StringPiece mimeType,
+      folly::StringPiece checksum);
+
+  /// Strip the frame checksum parameter from a metadata MIME type, returning
+  /// the name of the checksum, or an empty string if there was none.
+  static std::string removeFromMimeType(std::string& mimeType);
+};
+
+} // namespace rsocket
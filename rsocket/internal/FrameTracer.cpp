@@ -0,0 +1,193 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/FrameTracer.h"
+
+#include <folly/ThreadLocal.h>
+
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <mutex>
+#include <ostream>
+
+namespace rsocket {
+
+std::atomic<uint32_t> FrameTracer::sampleEvery_{0};
+
+namespace {
+
+uint64_t pack(StreamId streamId, FrameType type, FrameTracer::Point point) {
+  return static_cast<uint64_t>(streamId) |
+      static_cast<uint64_t>(type) << 32 | static_cast<uint64_t>(point) << 40;
+}
+
+FrameTracer::Event unpack(uint64_t nanos, uint64_t packed) {
+  return FrameTracer::Event{
+      nanos,
+      static_cast<StreamId>(packed),
+      static_cast<FrameType>((packed >> 32) & 0xff),
+      static_cast<FrameTracer::Point>((packed >> 40) & 0xff)};
+}
+
+class Rings;
+
+/// The events of one thread.  Written by that thread only, read by any.
+class Ring {
+ public:
+  explicit Ring(Rings& rings) : rings_(rings) {}
+  ~Ring();
+
+  void record(uint64_t nanos, uint64_t packed) {
+    auto const head = head_.load(std::memory_order_relaxed);
+    auto& slot = slots_[head % FrameTracer::kRingSize];
+    slot.nanos.store(nanos, std::memory_order_relaxed);
+    slot.packed.store(packed, std::memory_order_relaxed);
+    head_.store(head + 1, std::memory_order_release);
+  }
+
+  /// Appends the events of the ring, dropping the ones the owner thread
+  /// overwrote while they were being read.
+  void appendTo(std::vector<FrameTracer::Event>& events) const {
+    auto const head = head_.load(std::memory_order_acquire);
+    auto const begin =
+        head > FrameTracer::kRingSize ? head - FrameTracer::kRingSize : 0;
+    std::vector<FrameTracer::Event> read;
+    read.reserve(head - begin);
+    for (auto i = begin; i < head; ++i) {
+      auto& slot = slots_[i % FrameTracer::kRingSize];
+      read.push_back(unpack(
+          slot.nanos.load(std::memory_order_relaxed),
+          slot.packed.load(std::memory_order_relaxed)));
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    auto const after = head_.load(std::memory_order_relaxed);
+    auto const valid =
+        after > FrameTracer::kRingSize ? after - FrameTracer::kRingSize : 0;
+    auto const skip = std::min<uint64_t>(
+        valid > begin ? valid - begin : 0, read.size());
+    events.insert(events.end(), read.begin() + skip, read.end());
+  }
+
+ private:
+  struct Slot {
+    std::atomic<uint64_t> nanos{0};
+    std::atomic<uint64_t> packed{0};
+  };
+
+  Rings& rings_;
+  std::array<Slot, FrameTracer::kRingSize> slots_;
+  std::atomic<uint64_t> head_{0};
+};
+
+/// The rings of all the threads, plus the last events of the threads that
+/// exited.
+class Rings {
+ public:
+  Rings() : local_([this] { return new Ring(*this); }) {}
+
+  Ring& local() {
+    return *local_;
+  }
+
+  void retire(std::vector<FrameTracer::Event> events) {
+    std::lock_guard<std::mutex> lock(retiredMutex_);
+    retired_.insert(retired_.end(), events.begin(), events.end());
+    while (retired_.size() > FrameTracer::kRingSize) {
+      retired_.pop_front();
+    }
+  }
+
+  std::vector<FrameTracer::Event> dump() {
+    std::vector<FrameTracer::Event> events;
+    {
+      std::lock_guard<std::mutex> lock(retiredMutex_);
+      events.assign(retired_.begin(), retired_.end());
+    }
+    for (const auto& ring : local_.accessAllThreads()) {
+      ring.appendTo(events);
+    }
+    return events;
+  }
+
+ private:
+  struct Tag {};
+
+  std::mutex retiredMutex_;
+  std::deque<FrameTracer::Event> retired_;
+
+  folly::ThreadLocal<Ring, Tag> local_;
+};
+
+Ring::~Ring() {
+  std::vector<FrameTracer::Event> events;
+  appendTo(events);
+  rings_.retire(std::move(events));
+}
+
+/// Never destroyed, threads may record while the process exits.
+Rings& rings() {
+  static auto const instance = new Rings();
+  return *instance;
+}
+
+} // namespace
+
+void FrameTracer::record(
+    Point point,
+    StreamId streamId,
+    FrameType type,
+    uint64_t nanos) {
+  rings().local().record(nanos, pack(streamId, type, point));
+}
+
+std::vector<FrameTracer::Event> FrameTracer::dump() {
+  auto events = rings().dump();
+  std::stable_sort(
+      events.begin(), events.end(), [](const Event& a, const Event& b) {
+        return a.nanos < b.nanos;
+      });
+  return events;
+}
+
+void FrameTracer::print(
+    std::ostream& os,
+    const std::vector<Event>& events) {
+  auto const start = events.empty() ? 0 : events.front().nanos;
+  for (const auto& event : events) {
+    os << "+" << event.nanos - start << "ns stream "
+       << event.streamId << " " << event.type << " " << event.point << "\n";
+  }
+}
+
+std::ostream& operator<<(std::ostream& os, FrameTracer::Point point) {
+  switch (point) {
+    case FrameTracer::Point::SOCKET_READ:
+      return os << "SOCKET_READ";
+    case FrameTracer::Point::PARSED:
+      return os << "PARSED";
+    case FrameTracer::Point::DISPATCHED:
+      return os << "DISPATCHED";
+    case FrameTracer::Point::DELIVERED:
+      return os << "DELIVERED";
+    case FrameTracer::Point::SERIALIZED:
+      return os << "SERIALIZED";
+    case FrameTracer::Point::WRITTEN:
+      return os << "WRITTEN";
+  }
+  return os << "Point[" << static_cast<int>(point) << "]";
+}
+
+} // namespace rsocket
@@ -0,0 +1,108 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Likely.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+#include "rsocket/framing/FrameType.h"
+#include "rsocket/internal/Common.h"
+
+namespace rsocket {
+
+/// Timestamps of the frames of a sample of streams as they go through the
+/// library, to find out where the latency of a request comes from.
+///
+/// Tracing is off until setSampleRate() is called, and then traces 1 in N
+/// streams, picked by stream id.  Every thread records into a ring of its own
+/// with relaxed stores, so recording doesn't contend.  A ring keeps the last
+/// kRingSize events of its thread, dump() collects the rings of all threads.
+///
+/// When tracing is off, every hook costs a relaxed load and a branch.
+class FrameTracer {
+ public:
+  static constexpr size_t kRingSize = 4096;
+
+  /// Where a frame was seen, in the order an inbound request goes through
+  /// them, followed by the frames written in response.
+  enum class Point : uint8_t {
+    /// The bytes of the frame were read from the connection.  Frames read
+    /// together share the time of the read.
+    SOCKET_READ,
+    /// The frame was cut out of the byte stream by FramedReader.
+    PARSED,
+    /// RSocketStateMachine decoded the header and is handing the frame over.
+    DISPATCHED,
+    /// The stream or responder the frame was handed to returned.
+    DELIVERED,
+    /// A frame of the stream was serialized.
+    SERIALIZED,
+    /// The serialized frame was handed to the transport to be written.
+    WRITTEN,
+  };
+
+  struct Event {
+    /// Nanoseconds on the steady clock.
+    uint64_t nanos;
+    StreamId streamId;
+    FrameType type;
+    Point point;
+  };
+
+  /// Traces 1 in `every` streams, or none if `every` is zero.
+  static void setSampleRate(uint32_t every) {
+    sampleEvery_.store(every, std::memory_order_relaxed);
+  }
+
+  static bool enabled() {
+    return FOLLY_UNLIKELY(sampleEvery_.load(std::memory_order_relaxed) != 0);
+  }
+
+  /// Whether the frames of this stream are traced.  Frames of the
+  /// connection, on stream 0, never are.
+  static bool sampled(StreamId streamId) {
+    auto const every = sampleEvery_.load(std::memory_order_relaxed);
+    return FOLLY_UNLIKELY(every != 0) && streamId != 0 &&
+        (streamId >> 1) % every == 0;
+  }
+
+  static uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  /// Records an event for a sampled stream, see sampled().
+  static void record(Point, StreamId, FrameType, uint64_t nanos = now());
+
+  /// The events still in the rings of all threads, including threads that
+  /// exited, ordered by time.
+  static std::vector<Event> dump();
+
+  /// Writes the events one per line, with the time relative to the first.
+  static void print(std::ostream&, const std::vector<Event>&);
+
+ private:
+  static std::atomic<uint32_t> sampleEvery_;
+};
+
+std::ostream& operator<<(std::ostream&, FrameTracer::Point);
+
+} // namespace rsocket
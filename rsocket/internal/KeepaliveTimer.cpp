@@ -14,14 +14,14 @@
 
 #include "rsocket/internal/KeepaliveTimer.h"
 
+#include <utility>
+
 namespace rsocket {
 
 KeepaliveTimer::KeepaliveTimer(
     std::chrono::milliseconds period,
     folly::EventBase& eventBase)
-    : eventBase_(eventBase),
-      generation_(std::make_shared<uint32_t>(0)),
-      period_(period) {}
+    : eventBase_(&eventBase), period_(period) {}
 
 KeepaliveTimer::~KeepaliveTimer() {
   stop();
@@ -32,22 +32,25 @@ std::chrono::milliseconds KeepaliveTimer::keepaliveTime() const {
 }
 
 void KeepaliveTimer::schedule() {
-  const auto scheduledGeneration = *generation_;
-  const auto generation = generation_;
-  eventBase_.runAfterDelay(
-      [this,
-       wpConnection = std::weak_ptr<FrameSink>(connection_),
-       generation,
-       scheduledGeneration]() {
-        auto spConnection = wpConnection.lock();
-        if (!spConnection) {
-          return;
-        }
-        if (*generation == scheduledGeneration) {
-          sendKeepalive(*spConnection);
-        }
-      },
-      static_cast<uint32_t>(keepaliveTime().count()));
+  KeepaliveWheel::get(*eventBase_).schedule(*this, keepaliveTime());
+}
+
+void KeepaliveTimer::expired() {
+  // Keep the connection around, sending a keepalive may stop the timer.
+  auto const connection = connection_;
+  if (!connection) {
+    return;
+  }
+  if (std::exchange(frameReceived_, false)) {
+    // The peer is alive, whether or not it answered the last keepalive.
+    pending_ = false;
+    if (!connection->needsKeepaliveFrames()) {
+      connection->keepaliveSuppressed();
+      schedule();
+      return;
+    }
+  }
+  sendKeepalive(*connection);
 }
 
 void KeepaliveTimer::sendKeepalive(FrameSink& sink) {
@@ -67,15 +70,18 @@ void KeepaliveTimer::sendKeepalive(FrameSink& sink) {
 
 // must be called from the same thread as start
 void KeepaliveTimer::stop() {
-  *generation_ += 1;
+  if (is_linked()) {
+    KeepaliveWheel::get(*eventBase_).cancel(*this);
+  }
   pending_ = false;
+  frameReceived_ = false;
   connection_.reset();
 }
 
 // must be called from the same thread as stop
 void KeepaliveTimer::start(const std::shared_ptr<FrameSink>& connection) {
   connection_ = connection;
-  *generation_ += 1;
+  frameReceived_ = false;
   DCHECK(!pending_);
 
   schedule();
@@ -84,4 +90,10 @@ void KeepaliveTimer::start(const std::shared_ptr<FrameSink>& connection) {
 void KeepaliveTimer::keepaliveReceived() {
   pending_ = false;
 }
+
+void KeepaliveTimer::setEventBase(folly::EventBase& eventBase) {
+  DCHECK(!connection_) << "KeepaliveTimer moved while running";
+  DCHECK(!is_linked());
+  eventBase_ = &eventBase;
+}
 } // namespace rsocket
@@ -16,15 +16,23 @@
 
 #include <folly/io/async/EventBase.h>
 
+#include "rsocket/internal/KeepaliveWheel.h"
 #include "rsocket/statemachine/RSocketStateMachine.h"
 
 namespace rsocket {
 
-class KeepaliveTimer {
+/// Sends a KEEPALIVE frame every period, and closes the connection if the
+/// previous one wasn't answered by then.  Scheduled on the KeepaliveWheel of
+/// its EventBase, shared by every connection on it.
+///
+/// Any frame from the peer proves it is alive, which settles the previous
+/// keepalive.  If one arrived during the period, the keepalive is also
+/// skipped when the FrameSink allows it, see needsKeepaliveFrames().
+class KeepaliveTimer : private KeepaliveWheel::Entry {
  public:
   KeepaliveTimer(std::chrono::milliseconds period, folly::EventBase& eventBase);
 
-  ~KeepaliveTimer();
+  ~KeepaliveTimer() override;
 
   std::chrono::milliseconds keepaliveTime() const;
 
@@ -38,11 +46,21 @@ class KeepaliveTimer {
 
   void keepaliveReceived();
 
+  /// Called for every frame received on the connection.
+  void frameReceived() {
+    frameReceived_ = true;
+  }
+
+  /// Moves the timer onto another EventBase.  Only while it is stopped.
+  void setEventBase(folly::EventBase& eventBase);
+
  private:
+  void expired() override;
+
   std::shared_ptr<FrameSink> connection_;
-  folly::EventBase& eventBase_;
-  const std::shared_ptr<uint32_t> generation_;
+  folly::EventBase* eventBase_;
   const std::chrono::milliseconds period_;
-  std::atomic<bool> pending_{false};
+  bool pending_{false};
+  bool frameReceived_{false};
 };
 } // namespace rsocket
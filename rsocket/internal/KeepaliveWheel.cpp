@@ -0,0 +1,117 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/KeepaliveWheel.h"
+
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/EventBaseLocal.h>
+
+#include <algorithm>
+#include <memory>
+
+namespace rsocket {
+
+constexpr std::chrono::milliseconds KeepaliveWheel::kTick;
+constexpr size_t KeepaliveWheel::kSlots;
+
+namespace {
+
+folly::EventBaseLocal<std::unique_ptr<KeepaliveWheel>>& wheels() {
+  static auto* wheels =
+      new folly::EventBaseLocal<std::unique_ptr<KeepaliveWheel>>;
+  return *wheels;
+}
+
+} // namespace
+
+KeepaliveWheel& KeepaliveWheel::get(folly::EventBase& evb) {
+  DCHECK(evb.isInEventBaseThread());
+  if (auto wheel = wheels().get(evb)) {
+    return **wheel;
+  }
+  return *wheels().emplace(evb, std::make_unique<KeepaliveWheel>(evb));
+}
+
+KeepaliveWheel::KeepaliveWheel(folly::EventBase& evb)
+    : folly::AsyncTimeout(&evb), start_(std::chrono::steady_clock::now()) {}
+
+void KeepaliveWheel::schedule(Entry& entry, std::chrono::milliseconds delay) {
+  if (entry.is_linked()) {
+    entry.unlink();
+  } else {
+    ++size_;
+  }
+
+  if (!isScheduled() && !walking_) {
+    // Nothing was ticking, skip the slots that went by meanwhile.
+    lastTick_ = currentTick();
+    scheduleNextTick();
+  }
+
+  auto const ticks = std::max<int64_t>(
+      (delay.count() + kTick.count() - 1) / kTick.count(), 1);
+  entry.dueTick_ = currentTick() + static_cast<uint64_t>(ticks);
+  slots_[entry.dueTick_ % kSlots].push_back(entry);
+}
+
+void KeepaliveWheel::cancel(Entry& entry) {
+  if (entry.is_linked()) {
+    entry.unlink();
+    --size_;
+  }
+}
+
+void KeepaliveWheel::timeoutExpired() noexcept {
+  auto const now = currentTick();
+  // Running more than a revolution late, every slot is walked once.
+  auto const last = std::min(now, lastTick_ + kSlots);
+
+  walking_ = true;
+  while (lastTick_ < last) {
+    ++lastTick_;
+    Slot due;
+    due.swap(slots_[lastTick_ % kSlots]);
+    while (!due.empty()) {
+      auto& entry = due.front();
+      due.pop_front();
+      if (entry.dueTick_ > now) {
+        // Due in a later round.
+        slots_[entry.dueTick_ % kSlots].push_back(entry);
+        continue;
+      }
+      --size_;
+      entry.expired();
+    }
+  }
+  lastTick_ = now;
+  walking_ = false;
+
+  if (size_ > 0) {
+    scheduleNextTick();
+  }
+}
+
+uint64_t KeepaliveWheel::currentTick() const {
+  return static_cast<uint64_t>(
+      (std::chrono::steady_clock::now() - start_) / kTick);
+}
+
+void KeepaliveWheel::scheduleNextTick() {
+  auto const next = start_ + (lastTick_ + 1) * kTick;
+  auto const delay = std::chrono::duration_cast<std::chrono::milliseconds>(
+      next - std::chrono::steady_clock::now());
+  scheduleTimeout(std::max(delay, std::chrono::milliseconds{1}));
+}
+
+} // namespace rsocket
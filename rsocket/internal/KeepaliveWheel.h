@@ -0,0 +1,98 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/io/async/AsyncTimeout.h>
+
+#include <boost/intrusive/list.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace folly {
+class EventBase;
+}
+
+namespace rsocket {
+
+/// Keepalive timers of all the connections on one EventBase, driven by a
+/// single timeout.
+///
+/// Entries are hashed into kSlots slots by the tick they are due at, an entry
+/// due more than a revolution ahead waits in its slot for its round.  Every
+/// tick the wheel walks the slot that came due and fires its entries in one
+/// pass, so a tick costs the number of entries due rather than the number of
+/// connections.  The timeout is only scheduled while the wheel has entries.
+///
+/// Not thread-safe, used on the thread of its EventBase only.
+class KeepaliveWheel : private folly::AsyncTimeout {
+ public:
+  static constexpr std::chrono::milliseconds kTick{10};
+  static constexpr size_t kSlots = 1024;
+
+  /// Something to fire at a later tick.  Must be cancelled, or have fired,
+  /// before it is destroyed.
+  class Entry
+      : public boost::intrusive::list_base_hook<
+            boost::intrusive::link_mode<boost::intrusive::auto_unlink>> {
+   public:
+    virtual ~Entry() = default;
+
+    /// Called once the entry is due.  It is out of the wheel by then, and may
+    /// be scheduled again from here.
+    virtual void expired() = 0;
+
+   private:
+    friend class KeepaliveWheel;
+    uint64_t dueTick_{0};
+  };
+
+  /// The wheel of an EventBase, created on first use.  Must be called on the
+  /// thread of the EventBase.
+  static KeepaliveWheel& get(folly::EventBase&);
+
+  explicit KeepaliveWheel(folly::EventBase&);
+
+  /// Fires `entry` after `delay`, rounded up to a whole tick.  Moves it if it
+  /// was scheduled already.
+  void schedule(Entry&, std::chrono::milliseconds delay);
+
+  /// Takes `entry` out of the wheel, if it is in it.
+  void cancel(Entry&);
+
+  /// Number of entries waiting to fire.
+  size_t size() const {
+    return size_;
+  }
+
+ private:
+  using Slot = boost::intrusive::
+      list<Entry, boost::intrusive::constant_time_size<false>>;
+
+  void timeoutExpired() noexcept override;
+
+  uint64_t currentTick() const;
+  void scheduleNextTick();
+
+  const std::chrono::steady_clock::time_point start_;
+  std::array<Slot, kSlots> slots_;
+  /// Last tick whose slot was walked.
+  uint64_t lastTick_{0};
+  size_t size_{0};
+  bool walking_{false};
+};
+
+} // namespace rsocket
@@ -0,0 +1,64 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace rsocket {
+
+/// Requests left in the current lease of a connection, and when the lease
+/// expires.  Kept by both the side granting the lease and the side honoring
+/// it.
+class LeaseBudget {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /// Replaces the current lease.
+  void grant(
+      std::chrono::milliseconds ttl,
+      uint32_t numberOfRequests,
+      Clock::time_point now = Clock::now()) {
+    expiry_ = now + ttl;
+    remaining_ = numberOfRequests;
+  }
+
+  void clear() {
+    remaining_ = 0;
+  }
+
+  bool available(Clock::time_point now = Clock::now()) const {
+    return remaining_ > 0 && now < expiry_;
+  }
+
+  /// Uses up one request of the lease, if it allows one more.
+  bool tryConsume(Clock::time_point now = Clock::now()) {
+    if (!available(now)) {
+      return false;
+    }
+    --remaining_;
+    return true;
+  }
+
+  uint32_t remaining() const {
+    return remaining_;
+  }
+
+ private:
+  Clock::time_point expiry_;
+  uint32_t remaining_{0};
+};
+
+} // namespace rsocket
@@ -0,0 +1,146 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/MemoryPressureController.h"
+
+#include <folly/io/async/EventBase.h>
+#include <glog/logging.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+
+#include "rsocket/internal/Common.h"
+
+namespace rsocket {
+
+namespace {
+
+const char* toString(MemoryPressureController::Level level) {
+  switch (level) {
+    case MemoryPressureController::Level::NONE:
+      return "NONE";
+    case MemoryPressureController::Level::ELEVATED:
+      return "ELEVATED";
+    case MemoryPressureController::Level::HIGH:
+      return "HIGH";
+    case MemoryPressureController::Level::CRITICAL:
+      return "CRITICAL";
+  }
+  return "UNKNOWN";
+}
+
+} // namespace
+
+size_t MemoryPressureController::residentSetBytes() {
+  // The second field of statm is the resident set, in pages.
+  std::ifstream statm("/proc/self/statm");
+  size_t pages = 0;
+  size_t resident = 0;
+  if (!(statm >> pages >> resident)) {
+    return 0;
+  }
+  auto const pageSize = ::sysconf(_SC_PAGESIZE);
+  return pageSize > 0 ? resident * static_cast<size_t>(pageSize) : 0;
+}
+
+std::shared_ptr<MemoryPressureController> MemoryPressureController::create(
+    folly::EventBase& eventBase,
+    Options options,
+    std::shared_ptr<RSocketStats> stats,
+    UsageFunction usage) {
+  auto controller =
+      std::make_shared<MemoryPressureController>(options, std::move(stats));
+  eventBase.runInEventBaseThread(
+      [weakController = std::weak_ptr<MemoryPressureController>(controller),
+       &eventBase,
+       usage = std::move(usage)]() mutable {
+        if (auto self = weakController.lock()) {
+          self->sample(usage());
+          self->scheduleSample(eventBase, std::move(usage));
+        }
+      });
+  return controller;
+}
+
+size_t MemoryPressureController::maxRequestN() const {
+  switch (level()) {
+    case Level::NONE:
+      return kMaxRequestN;
+    case Level::ELEVATED:
+      return std::max<size_t>(options_.elevatedRequestN, 1);
+    case Level::HIGH:
+    case Level::CRITICAL:
+      return std::max<size_t>(options_.highRequestN, 1);
+  }
+  return kMaxRequestN;
+}
+
+size_t MemoryPressureController::maxResumeBufferBytes() const {
+  if (level() < Level::HIGH) {
+    return std::numeric_limits<size_t>::max();
+  }
+  return options_.highResumeBufferBytes;
+}
+
+void MemoryPressureController::sample(size_t bytes) {
+  auto const current = level();
+  auto next = levelAt(bytes);
+  if (next < current) {
+    // Only step down to the level usage would be at with the margin added.
+    auto const margin = static_cast<size_t>(
+        static_cast<double>(bytes) * (1 + options_.hysteresis));
+    next = std::max(next, std::min(current, levelAt(margin)));
+  }
+  if (next == current) {
+    return;
+  }
+
+  VLOG(1) << "Memory pressure went from " << toString(current) << " to "
+          << toString(next) << " at " << bytes << " bytes";
+  level_.store(next, std::memory_order_relaxed);
+  stats_->memoryPressureChanged(next, bytes);
+}
+
+MemoryPressureController::Level MemoryPressureController::levelAt(
+    size_t bytes) const {
+  if (options_.criticalBytes > 0 && bytes >= options_.criticalBytes) {
+    return Level::CRITICAL;
+  }
+  if (options_.highBytes > 0 && bytes >= options_.highBytes) {
+    return Level::HIGH;
+  }
+  if (options_.elevatedBytes > 0 && bytes >= options_.elevatedBytes) {
+    return Level::ELEVATED;
+  }
+  return Level::NONE;
+}
+
+void MemoryPressureController::scheduleSample(
+    folly::EventBase& eventBase,
+    UsageFunction usage) {
+  eventBase.runAfterDelay(
+      [weakThis = std::weak_ptr<MemoryPressureController>(shared_from_this()),
+       &eventBase,
+       usage = std::move(usage)]() mutable {
+        if (auto self = weakThis.lock()) {
+          self->sample(usage());
+          self->scheduleSample(eventBase, std::move(usage));
+        }
+      },
+      static_cast<uint32_t>(options_.sampleInterval.count()));
+}
+
+} // namespace rsocket
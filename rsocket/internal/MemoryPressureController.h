@@ -0,0 +1,131 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+
+#include "rsocket/RSocketStats.h"
+
+namespace folly {
+class EventBase;
+}
+
+namespace rsocket {
+
+/// Process-wide degradation of connections as memory gets tight, see
+/// RSocketServer::setMemoryPressure().
+///
+/// The controller samples the memory used by the process, its resident set
+/// unless told otherwise, and maps it to a level.  Each level degrades
+/// connections a step further: ELEVATED shrinks the credit consumers keep
+/// outstanding with their peers, HIGH shrinks it further, caps resume buffers
+/// and pauses accepting connections, and CRITICAL also rejects new streams.
+/// A level is only left once usage is `hysteresis` below its threshold, so
+/// that usage hovering around a threshold doesn't flap between levels.
+///
+/// Samples are taken on the EventBase given to create(), the limits can be
+/// read from any thread.
+class MemoryPressureController
+    : public std::enable_shared_from_this<MemoryPressureController> {
+ public:
+  using Level = RSocketStats::MemoryPressure;
+
+  /// Returns the bytes of memory the process uses.
+  using UsageFunction = std::function<size_t()>;
+
+  struct Options {
+    /// Bytes of memory used from which each level applies.  Zero disables a
+    /// level.
+    size_t elevatedBytes{0};
+    size_t highBytes{0};
+    size_t criticalBytes{0};
+
+    /// Fraction of its threshold that usage must drop below it before a
+    /// level is left.
+    double hysteresis{0.05};
+
+    /// Time between two samples of the memory used.
+    std::chrono::milliseconds sampleInterval{100};
+
+    /// Most credit a consumer keeps outstanding with its peer, per stream,
+    /// at ELEVATED and from HIGH on.
+    size_t elevatedRequestN{64};
+    size_t highRequestN{8};
+
+    /// Most bytes a resume buffer keeps from HIGH on.
+    size_t highResumeBufferBytes{64 * 1024};
+  };
+
+  /// Resident set size of the process, or zero if it can't be read.
+  static size_t residentSetBytes();
+
+  /// A controller that samples `usage` on `eventBase` until it is destroyed,
+  /// and reports changes of level to `stats`.
+  static std::shared_ptr<MemoryPressureController> create(
+      folly::EventBase& eventBase,
+      Options options,
+      std::shared_ptr<RSocketStats> stats = RSocketStats::noop(),
+      UsageFunction usage = residentSetBytes);
+
+  /// A controller fed by sample() only.
+  explicit MemoryPressureController(
+      Options options,
+      std::shared_ptr<RSocketStats> stats = RSocketStats::noop())
+      : options_{options}, stats_{std::move(stats)} {}
+
+  Level level() const {
+    return level_.load(std::memory_order_relaxed);
+  }
+
+  /// Most credit a consumer should keep outstanding with its peer, per
+  /// stream.  kMaxRequestN when there is no pressure.
+  size_t maxRequestN() const;
+
+  /// Most bytes a resume buffer should keep.  Unbounded below HIGH.
+  size_t maxResumeBufferBytes() const;
+
+  /// Whether new connections should be accepted.
+  bool acceptConnections() const {
+    return level() < Level::HIGH;
+  }
+
+  /// Whether new streams should be admitted.
+  bool admitStreams() const {
+    return level() < Level::CRITICAL;
+  }
+
+  /// Records that the process uses `bytes` of memory.
+  void sample(size_t bytes);
+
+  const Options& options() const {
+    return options_;
+  }
+
+ private:
+  /// The level of `bytes`, without hysteresis.
+  Level levelAt(size_t bytes) const;
+
+  void scheduleSample(folly::EventBase& eventBase, UsageFunction usage);
+
+  const Options options_;
+  const std::shared_ptr<RSocketStats> stats_;
+
+  std::atomic<Level> level_{Level::NONE};
+};
+
+} // namespace rsocket
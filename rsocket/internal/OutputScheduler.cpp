@@ -0,0 +1,191 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/OutputScheduler.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+
+namespace rsocket {
+
+OutputScheduler::OutputScheduler(const Options& options) : options_(options) {
+  CHECK_GT(options_.quantum, 0u);
+}
+
+void OutputScheduler::setWeight(StreamId streamId, uint32_t weight) {
+  if (weight == 0) {
+    weights_.erase(streamId);
+  } else {
+    weights_[streamId] = weight;
+  }
+}
+
+void OutputScheduler::eraseWeight(StreamId streamId) {
+  weights_.erase(streamId);
+  if (!deadlines_.empty()) {
+    deadlines_.erase(streamId);
+  }
+}
+
+void OutputScheduler::setDeadline(
+    StreamId streamId,
+    Clock::time_point deadline) {
+  if (options_.earliestDeadlineFirst) {
+    deadlines_[streamId] = deadline;
+  }
+}
+
+size_t OutputScheduler::dropExpired(StreamId streamId) {
+  if (deadlines_.empty()) {
+    return 0;
+  }
+  deadlines_.erase(streamId);
+  auto it = queues_.find(streamId);
+  if (it == queues_.end() || !it->second.byDeadline) {
+    return 0;
+  }
+  auto const dropped = dropQueue(it);
+  expiredFramesDropped_ += dropped;
+  return dropped;
+}
+
+size_t OutputScheduler::dropQueue(Queues::iterator it) {
+  auto& queue = it->second;
+  DCHECK(queue.byDeadline);
+  auto const dropped = queue.frames.size();
+  for (const auto& frame : queue.frames) {
+    bytes_ -= frame.length;
+  }
+  size_ -= dropped;
+  byDeadline_.erase({queue.deadline, it->first});
+  queues_.erase(it);
+  return dropped;
+}
+
+uint32_t OutputScheduler::weightOf(StreamId streamId) const {
+  auto it = weights_.find(streamId);
+  return it != weights_.end() ? it->second
+                              : std::max<uint32_t>(options_.defaultWeight, 1);
+}
+
+size_t OutputScheduler::bytesOf(StreamId streamId) const {
+  auto it = queues_.find(streamId);
+  if (it == queues_.end()) {
+    return 0;
+  }
+  size_t bytes = 0;
+  for (const auto& frame : it->second.frames) {
+    bytes += frame.length;
+  }
+  return bytes;
+}
+
+void OutputScheduler::push(
+    StreamId streamId,
+    std::unique_ptr<folly::IOBuf> frame) {
+  auto const length = frame->computeChainDataLength();
+
+  auto& queue = queues_[streamId];
+  if (queue.frames.empty()) {
+    auto const deadline =
+        deadlines_.empty() ? deadlines_.end() : deadlines_.find(streamId);
+    if (deadline != deadlines_.end()) {
+      queue.byDeadline = true;
+      queue.deadline = deadline->second;
+      byDeadline_.emplace(queue.deadline, streamId);
+    } else {
+      queue.weight = weightOf(streamId);
+      active_.push_back(streamId);
+    }
+  }
+  queue.frames.push_back(Frame{std::move(frame), length});
+
+  ++size_;
+  bytes_ += length;
+}
+
+std::unique_ptr<folly::IOBuf> OutputScheduler::popEarliestDeadline() {
+  auto const now = Clock::now();
+  while (!byDeadline_.empty()) {
+    auto const earliest = byDeadline_.begin();
+    auto it = queues_.find(earliest->second);
+    DCHECK(it != queues_.end());
+    if (earliest->first <= now) {
+      // The peer would only throw the frames away.
+      expiredFramesDropped_ += dropQueue(it);
+      continue;
+    }
+
+    auto& queue = it->second;
+    auto& next = queue.frames.front();
+    auto frame = std::move(next.buf);
+    bytes_ -= next.length;
+    --size_;
+    queue.frames.pop_front();
+    if (queue.frames.empty()) {
+      byDeadline_.erase(earliest);
+      queues_.erase(it);
+    }
+    return frame;
+  }
+  return nullptr;
+}
+
+std::unique_ptr<folly::IOBuf> OutputScheduler::pop() {
+  if (!byDeadline_.empty()) {
+    if (auto frame = popEarliestDeadline()) {
+      return frame;
+    }
+  }
+
+  // Every pass over the active streams adds credit, so this terminates.
+  while (!active_.empty()) {
+    auto const streamId = active_.front();
+    auto it = queues_.find(streamId);
+    DCHECK(it != queues_.end());
+    auto& queue = it->second;
+    DCHECK(!queue.frames.empty());
+
+    if (!queue.credited) {
+      queue.deficit += options_.quantum * queue.weight;
+      queue.credited = true;
+    }
+
+    auto& next = queue.frames.front();
+    if (queue.deficit < next.length) {
+      // Out of credit for this turn, let the next stream go.
+      queue.credited = false;
+      active_.pop_front();
+      active_.push_back(streamId);
+      continue;
+    }
+
+    queue.deficit -= next.length;
+    auto frame = std::move(next.buf);
+    bytes_ -= next.length;
+    --size_;
+    queue.frames.pop_front();
+
+    if (queue.frames.empty()) {
+      // An idle stream doesn't keep its credit.
+      queues_.erase(it);
+      active_.pop_front();
+    }
+    return frame;
+  }
+  return nullptr;
+}
+
+} // namespace rsocket
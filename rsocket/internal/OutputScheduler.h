@@ -0,0 +1,168 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/io/IOBuf.h>
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <utility>
+
+#include "rsocket/internal/Common.h"
+
+namespace rsocket {
+
+/// Holds the outgoing frames of a connection in one queue per stream, and
+/// hands them out in deficit weighted round-robin order.
+///
+/// Every turn a stream gets `quantum * weight` bytes of credit, and sends its
+/// frames in order for as long as the credit covers them.  A stream sending
+/// large fragments therefore can't hold back the small frames of other
+/// streams for more than a turn.
+///
+/// Optionally, the streams that have a deadline go first, earliest deadline
+/// first, and the frames of those past their deadline are dropped rather
+/// than sent.
+class OutputScheduler {
+ public:
+  /// The clock of RequestDeadline.
+  using Clock = std::chrono::steady_clock;
+
+  struct Options {
+    /// Bytes of credit a stream of weight one gets per turn.  Must not be
+    /// zero.
+    size_t quantum{16 * 1024};
+
+    /// The most bytes written in one EventBase loop iteration.  The rest is
+    /// left for the next iteration, so that frames submitted in the meantime
+    /// compete with it.
+    size_t maxBytesPerLoop{256 * 1024};
+
+    /// Weight of streams that weren't given one.
+    uint32_t defaultWeight{1};
+
+    /// Weight of request-response streams that weren't given one, on both
+    /// the requesting and the responding side.
+    uint32_t requestResponseWeight{4};
+
+    /// Send the frames of streams with a deadline ahead of the others, in
+    /// deadline order, and drop those of streams past their deadline, see
+    /// setDeadline().  Only matters while frames wait in the scheduler,
+    /// i.e. when more than maxBytesPerLoop are written at once.
+    bool earliestDeadlineFirst{false};
+  };
+
+  explicit OutputScheduler(const Options& options);
+
+  const Options& options() const {
+    return options_;
+  }
+
+  /// Sets the weight of the frames of a stream queued from now on.  Zero
+  /// restores the default weight.
+  void setWeight(StreamId streamId, uint32_t weight);
+
+  /// Forgets the weight and deadline of a closed stream.  Its queued frames
+  /// are still sent.
+  void eraseWeight(StreamId streamId);
+
+  /// Sets the deadline of the frames of a stream queued from now on.  Has no
+  /// effect unless Options::earliestDeadlineFirst is set.
+  void setDeadline(StreamId streamId, Clock::time_point deadline);
+
+  /// Drops the queued frames of a stream that is past its deadline, and
+  /// forgets the deadline, so that the frames the stream queues next, e.g. a
+  /// CANCEL, are sent.  Returns the number of frames dropped.
+  size_t dropExpired(StreamId streamId);
+
+  /// Number of frames dropped as their stream was past its deadline since
+  /// the last call.
+  size_t takeExpiredFramesDropped() {
+    return std::exchange(expiredFramesDropped_, 0);
+  }
+
+  void push(StreamId streamId, std::unique_ptr<folly::IOBuf> frame);
+
+  /// Returns the next frame to send, or nullptr if there is none.
+  std::unique_ptr<folly::IOBuf> pop();
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  /// Number of queued frames.
+  size_t size() const {
+    return size_;
+  }
+
+  /// Number of queued bytes.
+  size_t bytes() const {
+    return bytes_;
+  }
+
+  /// Number of queued bytes of one stream.  Walks its queue.
+  size_t bytesOf(StreamId streamId) const;
+
+ private:
+  struct Frame {
+    std::unique_ptr<folly::IOBuf> buf;
+    size_t length;
+  };
+
+  struct Queue {
+    std::deque<Frame> frames;
+    uint32_t weight{1};
+    size_t deficit{0};
+
+    /// Whether the queue got its credit for the current turn.
+    bool credited{false};
+
+    /// Whether the queue is in byDeadline_ rather than active_, and the
+    /// deadline it is there with.
+    bool byDeadline{false};
+    Clock::time_point deadline;
+  };
+
+  using Queues = std::unordered_map<StreamId, Queue>;
+
+  uint32_t weightOf(StreamId streamId) const;
+
+  /// Pops the next frame of the stream in byDeadline_ with the earliest
+  /// deadline, dropping the streams past theirs on the way.
+  std::unique_ptr<folly::IOBuf> popEarliestDeadline();
+
+  /// Drops the frames of a queue in byDeadline_, and the queue.
+  size_t dropQueue(Queues::iterator it);
+
+  const Options options_;
+
+  std::unordered_map<StreamId, uint32_t> weights_;
+  std::unordered_map<StreamId, Clock::time_point> deadlines_;
+
+  /// Queues of the streams with frames to send, and their turn order.
+  Queues queues_;
+  std::deque<StreamId> active_;
+  std::set<std::pair<Clock::time_point, StreamId>> byDeadline_;
+
+  size_t expiredFramesDropped_{0};
+
+  size_t size_{0};
+  size_t bytes_{0};
+};
+
+} // namespace rsocket
@@ -0,0 +1,142 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/PayloadBufferPool.h"
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace rsocket {
+
+namespace {
+
+using Pool = PayloadBufferPool;
+
+static_assert(
+    Pool::kMinClassSize << (Pool::kNumClasses - 1) == Pool::kMaxClassSize,
+    "Size classes must span kMinClassSize to kMaxClassSize");
+
+struct Node {
+  Node* next;
+};
+
+/// Trivially destructible, so that buffers freed while other thread_locals
+/// are destroyed still find it.  The Reaper frees the cached buffers at
+/// thread exit, and makes later buffers bypass the lists.
+struct FreeLists {
+  std::array<Node*, Pool::kNumClasses> heads;
+  std::array<uint32_t, Pool::kNumClasses> counts;
+  bool dead;
+};
+
+FreeLists& freeLists() {
+  static thread_local FreeLists lists{{}, {}, false};
+  return lists;
+}
+
+struct Reaper {
+  ~Reaper() {
+    auto& lists = freeLists();
+    for (size_t i = 0; i < Pool::kNumClasses; ++i) {
+      while (auto node = lists.heads[i]) {
+        lists.heads[i] = node->next;
+        std::free(node);
+      }
+      lists.counts[i] = 0;
+    }
+    lists.dead = true;
+  }
+};
+
+/// Registers the thread's Reaper the first time it caches a buffer.
+void reaper() {
+  static thread_local Reaper reaper;
+  (void)reaper;
+}
+
+size_t classSize(size_t index) {
+  return Pool::kMinClassSize << index;
+}
+
+void release(void* buf, void* userData) {
+  auto const index = reinterpret_cast<uintptr_t>(userData);
+  auto& lists = freeLists();
+  auto const maxCount = Pool::kMaxCachedBytesPerClass / classSize(index);
+  if (lists.dead || lists.counts[index] >= maxCount) {
+    std::free(buf);
+    return;
+  }
+  reaper();
+  auto node = static_cast<Node*>(buf);
+  node->next = lists.heads[index];
+  lists.heads[index] = node;
+  ++lists.counts[index];
+}
+
+} // namespace
+
+constexpr size_t PayloadBufferPool::kMinClassSize;
+constexpr size_t PayloadBufferPool::kMaxClassSize;
+constexpr size_t PayloadBufferPool::kNumClasses;
+constexpr size_t PayloadBufferPool::kMaxCachedBytesPerClass;
+
+std::unique_ptr<folly::IOBuf> PayloadBufferPool::allocate(
+    size_t headroom,
+    size_t capacity) {
+  auto const size = headroom + capacity;
+  if (size < kMinClassSize || size > kMaxClassSize) {
+    auto buf = folly::IOBuf::createCombined(size);
+    buf->advance(headroom);
+    return buf;
+  }
+
+  size_t index = 0;
+  while (classSize(index) < size) {
+    ++index;
+  }
+
+  auto& lists = freeLists();
+  void* block = lists.heads[index];
+  if (block) {
+    lists.heads[index] = lists.heads[index]->next;
+    --lists.counts[index];
+  } else {
+    block = std::malloc(classSize(index));
+    if (!block) {
+      throw std::bad_alloc();
+    }
+  }
+
+  auto buf = folly::IOBuf::takeOwnership(
+      block,
+      classSize(index),
+      0,
+      release,
+      reinterpret_cast<void*>(static_cast<uintptr_t>(index)));
+  buf->advance(headroom);
+  return buf;
+}
+
+size_t PayloadBufferPool::cachedBuffers() {
+  auto const& lists = freeLists();
+  size_t count = 0;
+  for (auto const n : lists.counts) {
+    count += n;
+  }
+  return count;
+}
+
+} // namespace rsocket
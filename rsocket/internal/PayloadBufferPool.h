@@ -0,0 +1,54 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/io/IOBuf.h>
+
+#include <cstddef>
+#include <memory>
+
+namespace rsocket {
+
+/// Per-thread cache of the buffers handed out by Payload::allocate(), one
+/// free list per size class.
+///
+/// A buffer goes back to the list of the thread that frees it, typically the
+/// thread of the transport once it wrote the buffer out, which may differ
+/// from the thread that allocated it.  Size classes are powers of two from
+/// kMinClassSize to kMaxClassSize bytes.  Buffers outside that range aren't
+/// pooled: smaller ones cost a single allocation with
+/// IOBuf::createCombined(), which a pooled buffer needs more than one
+/// allocation to beat, and larger ones are rare enough to not be cached.
+class PayloadBufferPool {
+ public:
+  static constexpr size_t kMinClassSize = 1024;
+  static constexpr size_t kMaxClassSize = 64 * 1024;
+  static constexpr size_t kNumClasses = 7;
+
+  /// Each thread caches at most this many bytes of buffers per size class,
+  /// freeing the buffers returned beyond it.
+  static constexpr size_t kMaxCachedBytesPerClass = 1024 * 1024;
+
+  /// Returns an empty buffer with `headroom` bytes of headroom and at least
+  /// `capacity` bytes of tailroom.
+  static std::unique_ptr<folly::IOBuf> allocate(
+      size_t headroom,
+      size_t capacity);
+
+  /// Number of buffers the calling thread caches.
+  static size_t cachedBuffers();
+};
+
+} // namespace rsocket
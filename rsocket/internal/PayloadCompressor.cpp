@@ -0,0 +1,152 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "rsocket/internal/PayloadCompressor.h"
+
+#include <folly/Conv.h>
+#include <folly/String.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBufQueue.h>
+
+#include "rsocket/RSocketStats.h"
+#include "rsocket/internal/Common.h"
+
+namespace rsocket {
+
+namespace {
+
+constexpr folly::StringPiece kMimeParameter{"rsocket-compression="};
+
+enum class Marker : uint8_t {
+  RAW = 0x00,
+  COMPRESSED = 0x01,
+};
+
+std::unique_ptr<folly::IOBuf> withMarker(
+    Marker marker,
+    std::unique_ptr<folly::IOBuf> data) {
+  if (!data->isSharedOne() && data->headroom() >= 1) {
+    data->prepend(1);
+    data->writableData()[0] = static_cast<uint8_t>(marker);
+    return data;
+  }
+  auto head = folly::IOBuf::create(1);
+  head->writableData()[0] = static_cast<uint8_t>(marker);
+  head->append(1);
+  head->prependChain(std::move(data));
+  return head;
+}
+
+} // namespace
+
+constexpr size_t PayloadCompressor::kDefaultThreshold;
+
+std::unique_ptr<PayloadCompressor> PayloadCompressor::create(
+    folly::StringPiece codecName,
+    std::shared_ptr<RSocketStats> stats,
+    size_t threshold) {
+  folly::io::CodecType type;
+  if (codecName == "zstd") {
+    type = folly::io::CodecType::ZSTD;
+  } else if (codecName == "lz4") {
+    type = folly::io::CodecType::LZ4_FRAME;
+  } else {
+    return nullptr;
+  }
+  if (!folly::io::hasCodec(type)) {
+    return nullptr;
+  }
+  return std::make_unique<PayloadCompressor>(
+      codecName.str(),
+      folly::io::getCodec(type),
+      std::move(stats),
+      threshold);
+}
+
+std::string PayloadCompressor::addToMimeType(
+    folly::StringPiece mimeType,
+    folly::StringPiece codecName) {
+  return folly::to<std::string>(mimeType, ";", kMimeParameter, codecName);
+}
+
+std::string PayloadCompressor::removeFromMimeType(std::string& mimeType) {
+  return removeMimeTypeParameter(mimeType, kMimeParameter);
+}
+
+PayloadCompressor::PayloadCompressor(
+    std::string codecName,
+    std::unique_ptr<folly::io::Codec> codec,
+    std::shared_ptr<RSocketStats> stats,
+    size_t threshold)
+    : codecName_{std::move(codecName)},
+      codec_{std::move(codec)},
+      stats_{std::move(stats)},
+      threshold_{threshold} {}
+
+void PayloadCompressor::compress(Payload& payload) const {
+  if (!payload.data) {
+    return;
+  }
+
+  auto const length = payload.data->computeChainDataLength();
+  if (length >= threshold_) {
+    auto compressed = codec_->compress(payload.data.get());
+    auto const compressedLength = compressed->computeChainDataLength();
+    if (compressedLength < length) {
+      stats_->payloadCompressed(length, compressedLength);
+      payload.data = withMarker(Marker::COMPRESSED, std::move(compressed));
+      return;
+    }
+  }
+  payload.data = withMarker(Marker::RAW, std::move(payload.data));
+}
+
+bool PayloadCompressor::decompress(Payload& payload) const {
+  if (!payload.data) {
+    return true;
+  }
+
+  folly::IOBufQueue queue{folly::IOBufQueue::cacheChainLength()};
+  queue.append(std::move(payload.data));
+  if (queue.chainLength() < 1) {
+    return false;
+  }
+
+  auto const marker =
+      static_cast<Marker>(folly::io::Cursor(queue.front()).read<uint8_t>());
+  queue.trimStart(1);
+  auto data = queue.move();
+  if (!data) {
+    data = folly::IOBuf::create(0);
+  }
+
+  switch (marker) {
+    case Marker::RAW:
+      payload.data = std::move(data);
+      return true;
+    case Marker::COMPRESSED:
+      try {
+        auto const compressedLength = data->computeChainDataLength();
+        payload.data = codec_->uncompress(data.get());
+        stats_->payloadDecompressed(
+            compressedLength, payload.data->computeChainDataLength());
+        return true;
+      } catch (const std::exception& exn) {
+        VLOG(3) << "Failed to decompress payload: " << exn.what();
+        return false;
+      }
+  }
+  return false;
+}
+
+} // namespace rsocket
@@ -0,0 +1,80 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <folly/Range.h>
+#include <folly/compression/Compression.h>
+
+#include "rsocket/Payload.h"
+
+namespace rsocket {
+
+class RSocketStats;
+
+/// Transparent compression of payload data.
+///
+/// The client asks for it by adding a `rsocket-compression` parameter to the
+/// data MIME type of its SETUP frame, e.g. "application/json;
+/// rsocket-compression=zstd".  Once negotiated, every payload sent on a
+/// stream carries a one byte marker in front of its data saying whether the
+/// rest of the data is compressed.  Only data at least `threshold` bytes
+/// long is compressed, metadata is never touched.
+class PayloadCompressor {
+ public:
+  static constexpr size_t kDefaultThreshold = 1024;
+
+  /// Create a compressor for the named codec ("zstd" or "lz4").  Returns
+  /// nullptr if the codec is unknown or not compiled into folly.
+  static std::unique_ptr<PayloadCompressor> create(
+      folly::StringPiece codecName,
+      std::shared_ptr<RSocketStats> stats,
+      size_t threshold = kDefaultThreshold);
+
+  /// Append the compression parameter for `codecName` to a data MIME type.
+  static std::string addToMimeType(
+      folly::StringPiece mimeType,
+      folly::StringPiece codecName);
+
+  /// Strip the compression parameter from a data MIME type, returning the
+  /// codec name, or an empty string if there was none.
+  static std::string removeFromMimeType(std::string& mimeType);
+
+  PayloadCompressor(
+      std::string codecName,
+      std::unique_ptr<folly::io::Codec> codec,
+      std::shared_ptr<RSocketStats> stats,
+      size_t threshold);
+
+  const std::string& codecName() const {
+    return codecName_;
+  }
+
+  /// Compress the data of a payload about to be sent, if it is big enough.
+  void compress(Payload& payload) const;
+
+  /// Undo compress() on a received payload.  Returns false if the data is
+  /// malformed.
+  bool decompress(Payload& payload) const;
+
+ private:
+  const std::string codecName_;
+  const std::unique_ptr<folly::io::Codec> codec_;
+  const std::shared_ptr<RSocketStats> stats_;
+  const size_t threshold_;
+};
+
+} // namespace rsocket
@@ -0,0 +1,390 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/PersistentResumeManager.h"
+
+#include <folly/Conv.h>
+#include <folly/Format.h>
+#include <folly/Synchronized.h>
+#include <folly/io/IOBuf.h>
+#include <folly/io/async/EventBaseManager.h>
+#include <folly/json.h>
+
+#include <mutex>
+
+namespace rsocket {
+
+namespace {
+
+constexpr folly::StringPiece FIRST_SENT_POSITION = "FirstSentPosition";
+constexpr folly::StringPiece LAST_SENT_POSITION = "LastSentPosition";
+constexpr folly::StringPiece IMPLIED_POSITION = "ImpliedPosition";
+constexpr folly::StringPiece LARGEST_USED_STREAMID = "LargestUsedStreamId";
+constexpr folly::StringPiece STREAM_TYPE = "StreamType";
+constexpr folly::StringPiece REQUESTER = "Requester";
+constexpr folly::StringPiece STREAM_TOKEN = "StreamToken";
+constexpr folly::StringPiece PROD_ALLOWANCE = "ProducerAllowance";
+constexpr folly::StringPiece CONS_ALLOWANCE = "ConsumerAllowance";
+
+constexpr folly::StringPiece kStateKey = "state";
+constexpr folly::StringPiece kStreamKey = "stream/";
+constexpr folly::StringPiece kFrameKey = "frame/";
+
+} // namespace
+
+/// Commits batches on the writer executor, one at a time and in order.  Owned
+/// jointly by the manager and the batches in flight.
+class PersistentResumeManager::Writer
+    : public std::enable_shared_from_this<Writer> {
+ public:
+  Writer(std::shared_ptr<ResumeStore> store, folly::Executor::KeepAlive<> ex)
+      : store_(std::move(store)), executor_(std::move(ex)) {}
+
+  ResumeStore& store() {
+    return *store_;
+  }
+
+  void enqueue(ResumeStore::Writes writes) {
+    {
+      auto queue = queue_.lock();
+      queue->batches.push_back(std::move(writes));
+      if (queue->draining) {
+        return;
+      }
+      queue->draining = true;
+    }
+    executor_->add([self = shared_from_this()] { self->drain(); });
+  }
+
+ private:
+  struct Queue {
+    std::deque<ResumeStore::Writes> batches;
+    bool draining{false};
+  };
+
+  void drain() {
+    while (true) {
+      ResumeStore::Writes writes;
+      {
+        auto queue = queue_.lock();
+        if (queue->batches.empty()) {
+          queue->draining = false;
+          return;
+        }
+        writes = std::move(queue->batches.front());
+        queue->batches.pop_front();
+      }
+      try {
+        store_->commit(std::move(writes));
+      } catch (const std::exception& ex) {
+        LOG(ERROR) << "Failed writing resumption state: " << ex.what();
+      }
+    }
+  }
+
+  const std::shared_ptr<ResumeStore> store_;
+  const folly::Executor::KeepAlive<> executor_;
+  folly::Synchronized<Queue, std::mutex> queue_;
+};
+
+PersistentResumeManager::PersistentResumeManager(
+    std::shared_ptr<RSocketStats> stats,
+    std::shared_ptr<ResumeStore> store,
+    std::string keyPrefix,
+    folly::Executor::KeepAlive<> writer,
+    size_t capacity,
+    size_t flushBytes)
+    : WarmResumeManager(
+          stats ? std::move(stats) : RSocketStats::noop(),
+          capacity),
+      keyPrefix_(std::move(keyPrefix)),
+      flushBytes_(flushBytes),
+      writer_(std::make_shared<Writer>(std::move(store), std::move(writer))) {
+  try {
+    load();
+  } catch (const std::exception& ex) {
+    throw std::runtime_error(folly::sformat(
+        "Failed loading resumption state {}. {}", keyPrefix_, ex.what()));
+  }
+}
+
+PersistentResumeManager::~PersistentResumeManager() {
+  flush();
+}
+
+void PersistentResumeManager::load() {
+  const auto entries = writer_->store().load(keyPrefix_);
+  if (entries.empty()) {
+    return;
+  }
+
+  const auto stateIt = entries.find(stateKey());
+  if (stateIt == entries.end()) {
+    throw std::runtime_error("State key missing");
+  }
+  const auto state = folly::parseJson(stateIt->second);
+  if (state.count(FIRST_SENT_POSITION) != 1 ||
+      state.count(LAST_SENT_POSITION) != 1 ||
+      state.count(IMPLIED_POSITION) != 1 ||
+      state.count(LARGEST_USED_STREAMID) != 1) {
+    throw std::runtime_error("State keys missing");
+  }
+  firstSentPosition_ = state[FIRST_SENT_POSITION].getInt();
+  lastSentPosition_ = state[LAST_SENT_POSITION].getInt();
+  impliedPosition_ = state[IMPLIED_POSITION].getInt();
+  largestUsedStreamId_ = state[LARGEST_USED_STREAMID].getInt();
+
+  std::deque<std::pair<ResumePosition, folly::StringPiece>> frames;
+  for (const auto& entry : entries) {
+    folly::StringPiece key(entry.first);
+    key.advance(keyPrefix_.size());
+
+    if (key.removePrefix(kStreamKey)) {
+      const auto info = folly::parseJson(entry.second);
+      if (info.count(STREAM_TYPE) != 1 || info.count(REQUESTER) != 1 ||
+          info.count(STREAM_TOKEN) != 1 || info.count(PROD_ALLOWANCE) != 1 ||
+          info.count(CONS_ALLOWANCE) != 1) {
+        throw std::runtime_error("StreamResumeInfo keys missing");
+      }
+      StreamResumeInfo streamResumeInfo(
+          static_cast<StreamType>(info[STREAM_TYPE].getInt()),
+          static_cast<RequestOriginator>(info[REQUESTER].getInt()),
+          info[STREAM_TOKEN].getString());
+      streamResumeInfo.producerAllowance = info[PROD_ALLOWANCE].getInt();
+      streamResumeInfo.consumerAllowance = info[CONS_ALLOWANCE].getInt();
+      streamResumeInfos_.emplace(
+          folly::to<StreamId>(key), std::move(streamResumeInfo));
+    } else if (key.removePrefix(kFrameKey)) {
+      // Frame keys are zero padded, so they come in position order.
+      frames.emplace_back(
+          folly::to<ResumePosition>(key), folly::StringPiece(entry.second));
+    }
+  }
+
+  // Only the frames leading up to the last sent position without a gap can be
+  // replayed.  A gap is left by writes that were lost, e.g. in a crash.
+  auto position = lastSentPosition_;
+  auto begin = frames.end();
+  while (begin != frames.begin()) {
+    auto prev = std::prev(begin);
+    if (prev->first < firstSentPosition_ ||
+        prev->first + static_cast<ResumePosition>(prev->second.size()) !=
+            position) {
+      break;
+    }
+    position = prev->first;
+    begin = prev;
+  }
+
+  for (auto it = frames.begin(); it != begin; ++it) {
+    erase(frameKey(it->first));
+  }
+  for (auto it = begin; it != frames.end(); ++it) {
+    frames_.emplace_back(
+        it->first,
+        folly::IOBuf(
+            folly::IOBuf::COPY_BUFFER, it->second.data(), it->second.size()));
+    persistedFrames_.push_back(it->first);
+    size_ += it->second.size();
+  }
+  if (!frames_.empty()) {
+    stats_->resumeBufferChanged(
+        static_cast<int>(frames_.size()), static_cast<int>(size_));
+  }
+  firstSentPosition_ = position;
+
+  while (size_ > capacity()) {
+    evictFrame();
+  }
+  syncFrames();
+}
+
+void PersistentResumeManager::trackReceivedFrame(
+    size_t frameLength,
+    FrameType frameType,
+    StreamId streamId,
+    size_t consumerAllowance) {
+  if (!shouldTrackFrame(frameType)) {
+    return;
+  }
+  // A missing stream has most likely been closed by this very frame.
+  auto it = streamResumeInfos_.find(streamId);
+  if (it != streamResumeInfos_.end()) {
+    it->second.consumerAllowance = consumerAllowance;
+    markStreamDirty(streamId);
+  }
+  WarmResumeManager::trackReceivedFrame(
+      frameLength, frameType, streamId, consumerAllowance);
+  markStateDirty();
+}
+
+void PersistentResumeManager::trackSentFrame(
+    const folly::IOBuf& serializedFrame,
+    FrameType frameType,
+    StreamId streamId,
+    size_t consumerAllowance) {
+  if (!shouldTrackFrame(frameType)) {
+    return;
+  }
+  auto it = streamResumeInfos_.find(streamId);
+  if (it != streamResumeInfos_.end()) {
+    it->second.consumerAllowance = consumerAllowance;
+    markStreamDirty(streamId);
+  }
+
+  const auto position = lastSentPosition_;
+  WarmResumeManager::trackSentFrame(
+      serializedFrame, frameType, streamId, consumerAllowance);
+
+  if (!frames_.empty() && frames_.back().first == position) {
+    std::string value;
+    value.reserve(lastSentPosition_ - position);
+    for (auto range : serializedFrame) {
+      value.append(reinterpret_cast<const char*>(range.data()), range.size());
+    }
+    put(frameKey(position), std::move(value));
+    persistedFrames_.push_back(position);
+  }
+  syncFrames();
+}
+
+void PersistentResumeManager::resetUpToPosition(ResumePosition position) {
+  WarmResumeManager::resetUpToPosition(position);
+  syncFrames();
+}
+
+void PersistentResumeManager::onStreamOpen(
+    StreamId streamId,
+    RequestOriginator requester,
+    std::string streamToken,
+    StreamType streamType) {
+  CHECK(streamType != StreamType::FNF);
+  CHECK(streamResumeInfos_.find(streamId) == streamResumeInfos_.end());
+  if (requester == RequestOriginator::LOCAL &&
+      streamId > largestUsedStreamId_) {
+    largestUsedStreamId_ = streamId;
+    markStateDirty();
+  }
+  streamResumeInfos_.emplace(
+      streamId,
+      StreamResumeInfo(streamType, requester, std::move(streamToken)));
+  markStreamDirty(streamId);
+}
+
+void PersistentResumeManager::onStreamClosed(StreamId streamId) {
+  if (streamResumeInfos_.erase(streamId) > 0) {
+    dirtyStreams_.erase(streamId);
+    erase(streamKey(streamId));
+  }
+}
+
+void PersistentResumeManager::flush() {
+  flushCallback_.cancelLoopCallback();
+  for (auto streamId : dirtyStreams_) {
+    pending_[streamKey(streamId)] =
+        serializeStream(streamResumeInfos_.at(streamId));
+  }
+  dirtyStreams_.clear();
+  if (stateDirty_) {
+    pending_[stateKey()] = serializeState();
+    stateDirty_ = false;
+  }
+  if (pending_.empty()) {
+    return;
+  }
+  ResumeStore::Writes writes;
+  writes.swap(pending_);
+  pendingBytes_ = 0;
+  writer_->enqueue(std::move(writes));
+}
+
+void PersistentResumeManager::put(std::string key, std::string value) {
+  pendingBytes_ += key.size() + value.size();
+  pending_[std::move(key)] = std::move(value);
+  scheduleFlush();
+}
+
+void PersistentResumeManager::erase(std::string key) {
+  pendingBytes_ += key.size();
+  pending_[std::move(key)] = folly::none;
+  scheduleFlush();
+}
+
+void PersistentResumeManager::markStateDirty() {
+  stateDirty_ = true;
+  scheduleFlush();
+}
+
+void PersistentResumeManager::markStreamDirty(StreamId streamId) {
+  dirtyStreams_.insert(streamId);
+  scheduleFlush();
+}
+
+std::string PersistentResumeManager::serializeState() const {
+  folly::dynamic state = folly::dynamic::object();
+  state[FIRST_SENT_POSITION] = firstSentPosition_;
+  state[LAST_SENT_POSITION] = lastSentPosition_;
+  state[IMPLIED_POSITION] = impliedPosition_;
+  state[LARGEST_USED_STREAMID] = largestUsedStreamId_;
+  return folly::toJson(state);
+}
+
+std::string PersistentResumeManager::serializeStream(
+    const StreamResumeInfo& info) {
+  folly::dynamic val = folly::dynamic::object();
+  val[STREAM_TYPE] = folly::to<int>(info.streamType);
+  val[STREAM_TOKEN] = info.streamToken;
+  val[REQUESTER] = folly::to<int>(info.requester);
+  val[CONS_ALLOWANCE] = info.consumerAllowance;
+  val[PROD_ALLOWANCE] = info.producerAllowance;
+  return folly::toJson(val);
+}
+
+void PersistentResumeManager::syncFrames() {
+  while (!persistedFrames_.empty() &&
+         persistedFrames_.front() < firstSentPosition_) {
+    erase(frameKey(persistedFrames_.front()));
+    persistedFrames_.pop_front();
+  }
+  markStateDirty();
+}
+
+void PersistentResumeManager::scheduleFlush() {
+  if (pendingBytes_ >= flushBytes_) {
+    flush();
+    return;
+  }
+  if (flushCallback_.isLoopCallbackScheduled()) {
+    return;
+  }
+  if (auto evb = folly::EventBaseManager::get()->getExistingEventBase()) {
+    evb->runInLoop(&flushCallback_);
+  } else {
+    flush();
+  }
+}
+
+std::string PersistentResumeManager::stateKey() const {
+  return folly::to<std::string>(keyPrefix_, kStateKey);
+}
+
+std::string PersistentResumeManager::streamKey(StreamId streamId) const {
+  return folly::to<std::string>(keyPrefix_, kStreamKey, streamId);
+}
+
+std::string PersistentResumeManager::frameKey(ResumePosition position) const {
+  return folly::sformat("{}{}{:020d}", keyPrefix_, kFrameKey, position);
+}
+
+} // namespace rsocket
@@ -0,0 +1,150 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Executor.h>
+#include <folly/io/async/EventBase.h>
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_set>
+
+#include "rsocket/ResumeStore.h"
+#include "rsocket/internal/WarmResumeManager.h"
+
+namespace rsocket {
+
+/// ResumeManager for cold resumption that mirrors its state into a
+/// ResumeStore: the resume positions, the StreamResumeInfos with their stream
+/// tokens, and the buffered frames.
+///
+/// The state is still served from memory.  Changes are gathered into a batch
+/// until the end of the current EventBase loop iteration (or until the batch
+/// reaches `flushBytes`), and the batch is then committed by the writer
+/// executor, so the store is never called from the I/O thread.
+///
+/// Every key is prefixed with `keyPrefix`, which should be unique to the
+/// session, e.g. derived from its ResumeIdentificationToken.
+class PersistentResumeManager : public WarmResumeManager {
+ public:
+  constexpr static size_t kDefaultFlushBytes = 64 * 1024;
+
+  /// Restores the state already in `store` under `keyPrefix`, if any.
+  /// Throws if that state cannot be parsed.
+  PersistentResumeManager(
+      std::shared_ptr<RSocketStats> stats,
+      std::shared_ptr<ResumeStore> store,
+      std::string keyPrefix,
+      folly::Executor::KeepAlive<> writer,
+      size_t capacity = DEFAULT_CAPACITY,
+      size_t flushBytes = kDefaultFlushBytes);
+
+  /// Hands the pending writes to the writer.  Writes already handed over are
+  /// still committed after the manager is gone.
+  ~PersistentResumeManager();
+
+  void trackReceivedFrame(
+      size_t frameLength,
+      FrameType frameType,
+      StreamId streamId,
+      size_t consumerAllowance) override;
+
+  void trackSentFrame(
+      const folly::IOBuf& serializedFrame,
+      FrameType frameType,
+      StreamId streamId,
+      size_t consumerAllowance) override;
+
+  void resetUpToPosition(ResumePosition position) override;
+
+  void onStreamOpen(
+      StreamId,
+      RequestOriginator,
+      std::string streamToken,
+      StreamType) override;
+
+  void onStreamClosed(StreamId streamId) override;
+
+  const StreamResumeInfos& getStreamResumeInfos() const override {
+    return streamResumeInfos_;
+  }
+
+  StreamId getLargestUsedStreamId() const override {
+    return largestUsedStreamId_;
+  }
+
+  /// Hands the pending writes to the writer now, instead of at the end of the
+  /// loop iteration.
+  void flush();
+
+ private:
+  class Writer;
+
+  class FlushCallback : public folly::EventBase::LoopCallback {
+   public:
+    explicit FlushCallback(PersistentResumeManager& manager)
+        : manager_(manager) {}
+
+    void runLoopCallback() noexcept override {
+      manager_.flush();
+    }
+
+   private:
+    PersistentResumeManager& manager_;
+  };
+
+  void load();
+
+  void put(std::string key, std::string value);
+  void erase(std::string key);
+
+  /// The positions and the stream infos change with every frame, so they are
+  /// only serialized once per batch.
+  void markStateDirty();
+  void markStreamDirty(StreamId);
+  std::string serializeState() const;
+  static std::string serializeStream(const StreamResumeInfo&);
+
+  /// Erases the frames that are no longer buffered, and records the new
+  /// positions.
+  void syncFrames();
+
+  void scheduleFlush();
+
+  std::string stateKey() const;
+  std::string streamKey(StreamId) const;
+  std::string frameKey(ResumePosition) const;
+
+  const std::string keyPrefix_;
+  const size_t flushBytes_;
+  const std::shared_ptr<Writer> writer_;
+
+  StreamResumeInfos streamResumeInfos_;
+
+  // Largest used StreamId so far.
+  StreamId largestUsedStreamId_{0};
+
+  /// Positions of the frames that are in the store, oldest first.
+  std::deque<ResumePosition> persistedFrames_;
+
+  ResumeStore::Writes pending_;
+  size_t pendingBytes_{0};
+  bool stateDirty_{false};
+  std::unordered_set<StreamId> dirtyStreams_;
+  FlushCallback flushCallback_{*this};
+};
+
+} // namespace rsocket
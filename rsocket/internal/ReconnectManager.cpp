@@ -0,0 +1,202 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/ReconnectManager.h"
+
+#include <folly/Random.h>
+#include <folly/io/async/EventBase.h>
+
+#include <algorithm>
+#include <atomic>
+
+namespace rsocket {
+
+/// The attempts of a round, the first to connect wins.
+struct ReconnectManager::Round {
+  explicit Round(size_t attempts) : pending(attempts) {}
+
+  std::atomic<size_t> pending;
+  std::atomic<bool> connected{false};
+};
+
+ReconnectManager::ReconnectManager(
+    folly::EventBase& eventBase,
+    ReconnectOptions options,
+    ConnectFn connect,
+    ResumeFn resume,
+    std::shared_ptr<RSocketStats> stats)
+    : eventBase_(eventBase),
+      options_(options),
+      connect_(std::move(connect)),
+      resume_(std::move(resume)),
+      stats_(stats ? std::move(stats) : RSocketStats::noop()) {
+  CHECK_GT(options_.parallelAttempts, 0u);
+}
+
+template <typename Fn>
+void ReconnectManager::runOnEventBase(Fn&& fn) {
+  eventBase_.runInEventBaseThread(
+      [weakThis = std::weak_ptr<ReconnectManager>(shared_from_this()),
+       fn = std::forward<Fn>(fn)]() mutable {
+        auto const self = weakThis.lock();
+        if (self && !self->stopped_) {
+          fn(*self);
+        }
+      });
+}
+
+void ReconnectManager::onDisconnected() {
+  runOnEventBase([](ReconnectManager& self) {
+    if (self.reconnecting_) {
+      return;
+    }
+    VLOG(2) << "Connection lost, reconnecting";
+    self.reconnecting_ = true;
+    self.rounds_ = 0;
+    self.disconnectedAt_ = Clock::now();
+    self.scheduleRound();
+  });
+}
+
+void ReconnectManager::onClosed() {
+  runOnEventBase([](ReconnectManager& self) {
+    self.stopped_ = true;
+    self.reconnecting_ = false;
+  });
+}
+
+void ReconnectManager::stop() {
+  eventBase_.runImmediatelyOrRunInEventBaseThreadAndWait([this] {
+    stopped_ = true;
+    reconnecting_ = false;
+  });
+}
+
+std::chrono::milliseconds ReconnectManager::backoff(
+    const ReconnectOptions& options,
+    size_t round) {
+  if (round == 0) {
+    return std::chrono::milliseconds(0);
+  }
+  auto const maxBackoff = static_cast<double>(options.maxBackoff.count());
+  auto delay = static_cast<double>(options.initialBackoff.count());
+  for (size_t i = 1; i < round && delay < maxBackoff; ++i) {
+    delay *= options.backoffMultiplier;
+  }
+  return std::chrono::milliseconds(
+      static_cast<int64_t>(std::min(delay, maxBackoff)));
+}
+
+void ReconnectManager::scheduleRound() {
+  auto delay = backoff(options_, rounds_);
+  if (delay.count() > 0 && options_.jitter > 0) {
+    auto const jitter =
+        std::min(options_.jitter, 1.0) * folly::Random::randDouble01();
+    delay = std::chrono::milliseconds(static_cast<int64_t>(
+        static_cast<double>(delay.count()) * (1 - jitter)));
+  }
+
+  if (delay.count() == 0) {
+    startRound();
+    return;
+  }
+  eventBase_.runAfterDelay(
+      [weakThis = std::weak_ptr<ReconnectManager>(shared_from_this())] {
+        auto const self = weakThis.lock();
+        if (self && !self->stopped_) {
+          self->startRound();
+        }
+      },
+      static_cast<uint32_t>(delay.count()));
+}
+
+void ReconnectManager::startRound() {
+  if (options_.maxRounds > 0 && rounds_ >= options_.maxRounds) {
+    LOG(WARNING) << "Giving up reconnecting after " << rounds_ << " rounds";
+    reconnecting_ = false;
+    stats_->reconnectAbandoned();
+    return;
+  }
+  ++rounds_;
+
+  auto round = std::make_shared<Round>(options_.parallelAttempts);
+  for (size_t i = 0; i < options_.parallelAttempts; ++i) {
+    stats_->reconnectAttempted();
+    folly::makeFutureWith(connect_).thenTry(
+        [weakThis = std::weak_ptr<ReconnectManager>(shared_from_this()),
+         round](folly::Try<Connection>&& connection) {
+          auto const last = --round->pending == 0;
+          auto const self = weakThis.lock();
+          if (connection.hasValue()) {
+            if (self && !round->connected.exchange(true)) {
+              self->runOnEventBase(
+                  [connection = std::move(*connection)](
+                      ReconnectManager& manager) mutable {
+                    manager.onConnected(std::move(connection));
+                  });
+              return;
+            }
+            // Lost the race, drop it on its own EventBase.
+            connection->eventBase.runInEventBaseThread(
+                [dropped = std::move(connection->connection)] {});
+            return;
+          }
+          if (self && last && !round->connected) {
+            self->runOnEventBase(
+                [ex = std::move(connection.exception())](
+                    ReconnectManager& manager) { manager.onRoundFailed(ex); });
+          }
+        });
+  }
+}
+
+void ReconnectManager::onConnected(Connection connection) {
+  VLOG(2) << "Reconnected, resuming";
+  folly::makeFutureWith([&] { return resume_(std::move(connection)); })
+      .thenTry(
+          [weakThis = std::weak_ptr<ReconnectManager>(shared_from_this())](
+              folly::Try<folly::Unit>&& result) {
+            auto const self = weakThis.lock();
+            if (!self) {
+              return;
+            }
+            if (result.hasException()) {
+              self->runOnEventBase(
+                  [ex = std::move(result.exception())](
+                      ReconnectManager& manager) {
+                    manager.onRoundFailed(ex);
+                  });
+              return;
+            }
+            self->runOnEventBase(
+                [](ReconnectManager& manager) { manager.onReconnected(); });
+          });
+}
+
+void ReconnectManager::onRoundFailed(const folly::exception_wrapper& ex) {
+  VLOG(2) << "Round " << rounds_ << " of reconnection attempts failed: "
+          << ex.what();
+  scheduleRound();
+}
+
+void ReconnectManager::onReconnected() {
+  auto const downtime = std::chrono::duration_cast<std::chrono::microseconds>(
+      Clock::now() - disconnectedAt_);
+  VLOG(2) << "Resumed after " << downtime.count() << "us and " << rounds_
+          << " rounds";
+  reconnecting_ = false;
+  stats_->reconnected(downtime, rounds_);
+}
+
+} // namespace rsocket
@@ -0,0 +1,116 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/futures/Future.h>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+
+#include "rsocket/ConnectionFactory.h"
+#include "rsocket/RSocketStats.h"
+
+namespace folly {
+class EventBase;
+}
+
+namespace rsocket {
+
+/// How a client reconnects once its connection is lost, see
+/// RSocketClient::setAutoReconnect().
+struct ReconnectOptions {
+  /// The first round of attempts is made at once, the next ones after a
+  /// delay that starts at `initialBackoff` and grows by `backoffMultiplier`
+  /// every round, up to `maxBackoff`.
+  std::chrono::milliseconds initialBackoff{10};
+  std::chrono::milliseconds maxBackoff{5000};
+  double backoffMultiplier{2};
+
+  /// Fraction of each delay that is drawn at random, so that clients that
+  /// lost their connections together don't all come back at once.
+  double jitter{0.5};
+
+  /// Connections attempted at once in each round.  The first one to connect
+  /// is resumed on, the others are dropped.
+  size_t parallelAttempts{1};
+
+  /// Rounds made before giving up, zero to never give up.
+  size_t maxRounds{0};
+};
+
+/// Reconnects a client once its connection is lost, with rounds of
+/// connection attempts spaced out by a jittered exponential backoff, and
+/// resumes on the first connection made.
+///
+/// Runs on a single EventBase.  Its methods can be called from any thread.
+class ReconnectManager : public std::enable_shared_from_this<ReconnectManager> {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using Connection = ConnectionFactory::ConnectedDuplexConnection;
+  using ConnectFn = std::function<folly::Future<Connection>()>;
+  using ResumeFn = std::function<folly::Future<folly::Unit>(Connection)>;
+
+  ReconnectManager(
+      folly::EventBase& eventBase,
+      ReconnectOptions options,
+      ConnectFn connect,
+      ResumeFn resume,
+      std::shared_ptr<RSocketStats> stats);
+
+  /// Starts reconnecting, unless it is already.
+  void onDisconnected();
+
+  /// Stops reconnecting, as the connection is closed.  Doesn't wait for the
+  /// EventBase, unlike stop().
+  void onClosed();
+
+  /// Stops reconnecting for good.  Neither `connect` nor `resume` are called
+  /// once this returns.
+  void stop();
+
+  /// The delay before a round of attempts, with no jitter applied.  Zero for
+  /// the first round.
+  static std::chrono::milliseconds backoff(
+      const ReconnectOptions& options,
+      size_t round);
+
+ private:
+  struct Round;
+
+  void scheduleRound();
+  void startRound();
+  void onConnected(Connection connection);
+  void onRoundFailed(const folly::exception_wrapper& ex);
+  void onReconnected();
+
+  /// Runs `fn` on the EventBase, unless the manager is gone or stopped.
+  template <typename Fn>
+  void runOnEventBase(Fn&& fn);
+
+  folly::EventBase& eventBase_;
+  const ReconnectOptions options_;
+  const ConnectFn connect_;
+  const ResumeFn resume_;
+  const std::shared_ptr<RSocketStats> stats_;
+
+  bool stopped_{false};
+  bool reconnecting_{false};
+  /// Rounds made since the connection was lost.
+  size_t rounds_{0};
+  Clock::time_point disconnectedAt_;
+};
+
+} // namespace rsocket
@@ -0,0 +1,89 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/RequestNWindow.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace rsocket {
+
+namespace {
+using Seconds = std::chrono::duration<double>;
+} // namespace
+
+RequestNWindow::RequestNWindow(const Options& options)
+    : options_(options),
+      window_(std::max(
+          options.minWindow,
+          std::min(options.initialWindow, options.maxWindow))) {}
+
+void RequestNWindow::onRequestSent(size_t n, Clock::time_point now) {
+  if (n == 0) {
+    return;
+  }
+  requests_.push_back(Request{sent_ + 1, now});
+  sent_ += n;
+}
+
+void RequestNWindow::onPayload(Clock::time_point now) {
+  ++received_;
+  if (!requests_.empty() && requests_.front().first <= received_) {
+    sampleRtt(now - requests_.front().sentAt, now);
+    requests_.pop_front();
+  }
+  sampleRate(now);
+}
+
+void RequestNWindow::sampleRtt(Clock::duration sample, Clock::time_point now) {
+  if (!minRtt_ || sample <= *minRtt_ ||
+      now - minRttAt_ > options_.rttExpiry) {
+    minRtt_ = sample;
+    minRttAt_ = now;
+  }
+}
+
+void RequestNWindow::sampleRate(Clock::time_point now) {
+  if (!intervalStart_) {
+    intervalStart_ = now;
+    intervalPayloads_ = 0;
+    return;
+  }
+  ++intervalPayloads_;
+
+  auto const elapsed = now - *intervalStart_;
+  if (!minRtt_ || elapsed < *minRtt_ || elapsed <= Clock::duration::zero()) {
+    return;
+  }
+
+  // Follow increases right away so the window ramps up quickly, but smooth
+  // decreases, which are often just a pause of the consumer.
+  auto const sample =
+      intervalPayloads_ / std::chrono::duration_cast<Seconds>(elapsed).count();
+  rate_ = std::max(sample, 0.75 * rate_ + 0.25 * sample);
+
+  intervalStart_ = now;
+  intervalPayloads_ = 0;
+  resize();
+}
+
+void RequestNWindow::resize() {
+  auto const rtt = std::chrono::duration_cast<Seconds>(*minRtt_).count();
+  auto const window = std::ceil(options_.gain * rate_ * rtt);
+  window_ = static_cast<size_t>(std::max(
+      static_cast<double>(options_.minWindow),
+      std::min(window, static_cast<double>(options_.maxWindow))));
+}
+
+} // namespace rsocket
@@ -0,0 +1,107 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Optional.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+namespace rsocket {
+
+/// Sizes the allowance a consumer keeps outstanding at its peer to the
+/// bandwidth-delay product of the stream: the rate payloads are consumed at,
+/// times the round-trip time of a REQUEST_N.
+///
+/// A round-trip sample is the time from sending some allowance to receiving
+/// the first payload it allowed.  Samples also include any time the peer spent
+/// on earlier allowance or waiting for its producer, so the smallest recent
+/// sample is used.  The rate is measured over intervals of at least one round
+/// trip.  While the window is what limits the rate, a gain above one makes
+/// every interval grow it a bit more, until the producer or the consumer
+/// becomes the bottleneck.
+class RequestNWindow {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Options {
+    /// Window used until the first round trip and rate are measured.
+    size_t initialWindow{64};
+    size_t minWindow{8};
+    size_t maxWindow{4096};
+
+    /// Multiple of the bandwidth-delay product to keep outstanding.
+    double gain{2.0};
+
+    /// How long the smallest round-trip sample is trusted before a larger one
+    /// replaces it, so that the window follows a path that got slower.
+    std::chrono::milliseconds rttExpiry{10000};
+  };
+
+  explicit RequestNWindow(const Options& options);
+
+  /// Allowance to keep outstanding at the peer.
+  size_t size() const {
+    return window_;
+  }
+
+  /// Smallest recent round-trip sample, if there is one.
+  folly::Optional<Clock::duration> rtt() const {
+    return minRtt_;
+  }
+
+  /// Payloads per second, or zero until it is measured.
+  double rate() const {
+    return rate_;
+  }
+
+  /// `n` more allowance was sent to the peer.
+  void onRequestSent(size_t n, Clock::time_point now = Clock::now());
+
+  /// A payload arrived, using up one unit of allowance.
+  void onPayload(Clock::time_point now = Clock::now());
+
+ private:
+  struct Request {
+    /// Sequence number of the first unit of allowance of the request.
+    uint64_t first;
+    Clock::time_point sentAt;
+  };
+
+  void sampleRtt(Clock::duration sample, Clock::time_point now);
+  void sampleRate(Clock::time_point now);
+  void resize();
+
+  const Options options_;
+  size_t window_;
+
+  /// Units of allowance sent and used up since the stream started.
+  uint64_t sent_{0};
+  uint64_t received_{0};
+
+  /// Requests whose first unit of allowance hasn't been used yet.
+  std::deque<Request> requests_;
+
+  folly::Optional<Clock::duration> minRtt_;
+  Clock::time_point minRttAt_;
+
+  folly::Optional<Clock::time_point> intervalStart_;
+  uint64_t intervalPayloads_{0};
+  double rate_{0};
+};
+
+} // namespace rsocket
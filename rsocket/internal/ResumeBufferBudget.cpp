@@ -0,0 +1,134 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/ResumeBufferBudget.h"
+
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/EventBaseManager.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "rsocket/internal/WarmResumeManager.h"
+
+namespace rsocket {
+
+template <typename F>
+void ResumeBufferBudget::updateAccount(State& state, const void* key, F&& fn) {
+  auto it = state.accounts.find(key);
+  if (it == state.accounts.end()) {
+    return;
+  }
+  state.victims.erase(victimKey(key, it->second));
+  fn(it->second);
+  state.victims.insert(victimKey(key, it->second));
+}
+
+void ResumeBufferBudget::charge(WarmResumeManager& manager, size_t bytes) {
+  const void* const self = &manager;
+  bool trimSelf = false;
+  std::vector<std::pair<std::weak_ptr<WarmResumeManager>, folly::EventBase*>>
+      victims;
+
+  {
+    auto state = state_.lock();
+    if (state->accounts.find(self) == state->accounts.end()) {
+      Account account;
+      account.manager = manager.shared_from_this();
+      account.evb = folly::EventBaseManager::get()->getExistingEventBase();
+      state->victims.insert(victimKey(self, account));
+      state->accounts.emplace(self, std::move(account));
+    }
+
+    updateAccount(*state, self, [&](Account& account) {
+      account.bytes += bytes;
+      account.lastCharged = ++state->charges;
+      // Also covers managers whose EventBase couldn't be told to trim.
+      trimSelf = account.trimRequested > 0;
+    });
+
+    auto const used = used_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    while (used > limit_ + state->trimRequested && !state->victims.empty()) {
+      auto const victim = *state->victims.begin();
+      auto const trimmable = std::get<0>(victim);
+      if (trimmable == 0) {
+        break;
+      }
+      auto const key = std::get<2>(victim);
+      auto const amount =
+          std::min(trimmable, used - limit_ - state->trimRequested);
+
+      bool alreadyTrimming = false;
+      updateAccount(*state, key, [&](Account& account) {
+        alreadyTrimming = account.trimRequested > 0;
+        account.trimRequested += amount;
+      });
+      state->trimRequested += amount;
+
+      if (key == self) {
+        trimSelf = true;
+      } else if (!alreadyTrimming) {
+        auto& account = state->accounts.at(key);
+        victims.emplace_back(account.manager, account.evb);
+      }
+    }
+  }
+
+  for (auto& victim : victims) {
+    if (victim.second) {
+      victim.second->runInEventBaseThread([manager = std::move(victim.first)] {
+        if (auto locked = manager.lock()) {
+          locked->trimForBudget();
+        }
+      });
+    }
+  }
+
+  if (trimSelf) {
+    manager.trimForBudget();
+  }
+}
+
+void ResumeBufferBudget::release(WarmResumeManager& manager, size_t bytes) {
+  auto state = state_.lock();
+  updateAccount(*state, &manager, [&](Account& account) {
+    DCHECK_LE(bytes, account.bytes);
+    account.bytes -= bytes;
+    auto const trimmed = std::min(bytes, account.trimRequested);
+    account.trimRequested -= trimmed;
+    state->trimRequested -= trimmed;
+    used_.fetch_sub(bytes, std::memory_order_relaxed);
+  });
+}
+
+size_t ResumeBufferBudget::trimRequested(
+    const WarmResumeManager& manager) const {
+  auto state = state_.lock();
+  auto it = state->accounts.find(&manager);
+  return it != state->accounts.end() ? it->second.trimRequested : 0;
+}
+
+void ResumeBufferBudget::close(WarmResumeManager& manager) {
+  auto state = state_.lock();
+  auto it = state->accounts.find(&manager);
+  if (it == state->accounts.end()) {
+    return;
+  }
+  state->victims.erase(victimKey(&manager, it->second));
+  state->trimRequested -= it->second.trimRequested;
+  used_.fetch_sub(it->second.bytes, std::memory_order_relaxed);
+  state->accounts.erase(it);
+}
+
+} // namespace rsocket
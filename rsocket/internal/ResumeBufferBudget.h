@@ -0,0 +1,122 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Synchronized.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+
+namespace folly {
+class EventBase;
+}
+
+namespace rsocket {
+
+class WarmResumeManager;
+
+/// Bounds the bytes that all the WarmResumeManagers sharing it buffer for
+/// resumption, on top of the capacity of each of them.  Typically one budget
+/// is shared by all the connections of a server, see
+/// RSocketServer::setResumeBufferBudget().
+///
+/// Managers charge the budget for every frame they buffer.  Once the total is
+/// over the limit, the largest buffers are asked to drop their oldest frames,
+/// the least recently used first among buffers of the same size.  A manager
+/// drops frames on the EventBase it runs on, so the total can go over the
+/// limit for the duration of an EventBase loop.
+///
+/// Thread-safe.
+class ResumeBufferBudget {
+ public:
+  explicit ResumeBufferBudget(size_t limit) : limit_(limit) {}
+
+  ResumeBufferBudget(const ResumeBufferBudget&) = delete;
+  ResumeBufferBudget& operator=(const ResumeBufferBudget&) = delete;
+
+  size_t limit() const {
+    return limit_;
+  }
+
+  /// Bytes currently buffered by all the managers.
+  size_t used() const {
+    return used_.load(std::memory_order_relaxed);
+  }
+
+  /// Called by the manager, on its EventBase, when it buffers a frame.  The
+  /// manager must be owned by a shared_ptr.
+  void charge(WarmResumeManager& manager, size_t bytes);
+
+  /// Called by the manager when it drops buffered frames, for whatever
+  /// reason.  Counts towards the bytes it was asked to drop.
+  void release(WarmResumeManager& manager, size_t bytes);
+
+  /// Bytes the manager still has to drop to bring the budget back in line.
+  size_t trimRequested(const WarmResumeManager& manager) const;
+
+  /// Called by the manager when it is destroyed.
+  void close(WarmResumeManager& manager);
+
+ private:
+  struct Account {
+    std::weak_ptr<WarmResumeManager> manager;
+    folly::EventBase* evb{nullptr};
+    size_t bytes{0};
+    size_t trimRequested{0};
+
+    /// Value of State::charges when the account was last charged.
+    uint64_t lastCharged{0};
+  };
+
+  /// Orders the accounts that can still be trimmed: most bytes left to trim
+  /// first, then least recently charged.
+  using VictimKey = std::tuple<size_t, uint64_t, const void*>;
+  struct VictimOrder {
+    bool operator()(const VictimKey& a, const VictimKey& b) const {
+      if (std::get<0>(a) != std::get<0>(b)) {
+        return std::get<0>(a) > std::get<0>(b);
+      }
+      return std::tie(std::get<1>(a), std::get<2>(a)) <
+          std::tie(std::get<1>(b), std::get<2>(b));
+    }
+  };
+
+  struct State {
+    std::unordered_map<const void*, Account> accounts;
+    std::set<VictimKey, VictimOrder> victims;
+    size_t trimRequested{0};
+    uint64_t charges{0};
+  };
+
+  static VictimKey victimKey(const void* key, const Account& account) {
+    return VictimKey(
+        account.bytes - account.trimRequested, account.lastCharged, key);
+  }
+
+  /// Applies `fn` to an account, keeping it at the right place in victims.
+  template <typename F>
+  static void updateAccount(State& state, const void* key, F&& fn);
+
+  const size_t limit_;
+  std::atomic<size_t> used_{0};
+  folly::Synchronized<State, std::mutex> state_;
+};
+
+} // namespace rsocket
@@ -0,0 +1,176 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/RingResumeManager.h"
+
+#include <folly/io/IOBuf.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "rsocket/framing/FrameSerializer.h"
+#include "rsocket/framing/FrameTransport.h"
+
+namespace rsocket {
+
+RingResumeManager::RingResumeManager(
+    std::shared_ptr<RSocketStats> stats,
+    size_t capacity)
+    : stats_(stats ? std::move(stats) : RSocketStats::noop()),
+      capacity_(capacity) {}
+
+RingResumeManager::~RingResumeManager() {
+  clearFrames(lastSentPosition_);
+}
+
+void RingResumeManager::trackReceivedFrame(
+    size_t frameLength,
+    FrameType frameType,
+    StreamId streamId,
+    size_t consumerAllowance) {
+  if (shouldTrackFrame(frameType)) {
+    VLOG(6) << "Track received frame " << frameType << " StreamId: " << streamId
+            << " Allowance: " << consumerAllowance;
+    impliedPosition_ += frameLength;
+  }
+}
+
+void RingResumeManager::trackSentFrame(
+    const folly::IOBuf& serializedFrame,
+    FrameType frameType,
+    StreamId,
+    size_t consumerAllowance) {
+  if (!shouldTrackFrame(frameType)) {
+    return;
+  }
+
+  const auto frameDataLength = serializedFrame.computeChainDataLength();
+  VLOG(6) << "Track sent frame " << frameType
+          << " Allowance: " << consumerAllowance;
+
+  // A frame that doesn't fit empties the buffer, and isn't kept.
+  if (frameDataLength == 0 || frameDataLength > capacity_) {
+    clearFrames(lastSentPosition_);
+    lastSentPosition_ += frameDataLength;
+    firstSentPosition_ = lastSentPosition_;
+    return;
+  }
+
+  while (bufferedBytes() + frameDataLength > capacity_) {
+    clearFrames(frames_.size() > 1 ? frames_[1] : lastSentPosition_);
+  }
+
+  if (!ring_) {
+    ring_.reset(new uint8_t[capacity_]);
+  }
+  copyIn(serializedFrame, lastSentPosition_);
+  frames_.push_back(lastSentPosition_);
+  lastSentPosition_ += frameDataLength;
+  stats_->resumeBufferChanged(1, static_cast<int>(frameDataLength));
+}
+
+void RingResumeManager::resetUpToPosition(ResumePosition position) {
+  if (position <= firstSentPosition_) {
+    return;
+  }
+  clearFrames(std::min(position, lastSentPosition_));
+}
+
+bool RingResumeManager::isPositionAvailable(ResumePosition position) const {
+  return position == lastSentPosition_ ||
+      std::binary_search(frames_.begin(), frames_.end(), position);
+}
+
+void RingResumeManager::sendFramesFromPosition(
+    ResumePosition position,
+    FrameTransport& frameTransport) const {
+  sendFramesFromPositionUpTo(
+      position, frameTransport, std::numeric_limits<size_t>::max());
+}
+
+ResumePosition RingResumeManager::sendFramesFromPositionUpTo(
+    ResumePosition position,
+    FrameTransport& frameTransport,
+    size_t maxBytes) const {
+  DCHECK(isPositionAvailable(position));
+
+  if (position == lastSentPosition_) {
+    // idle resumption
+    return position;
+  }
+
+  auto it = std::lower_bound(frames_.begin(), frames_.end(), position);
+  DCHECK(it != frames_.end() && *it == position);
+
+  size_t sent = 0;
+  do {
+    const auto next = std::next(it);
+    const auto end = next != frames_.end() ? *next : lastSentPosition_;
+    const auto length = static_cast<size_t>(end - *it);
+    frameTransport.outputFrameOrDrop(copyOut(*it, length));
+    sent += length;
+    it = next;
+  } while (it != frames_.end() && sent < maxBytes);
+
+  return it != frames_.end() ? *it : lastSentPosition_;
+}
+
+void RingResumeManager::clearFrames(ResumePosition position) {
+  DCHECK_LE(position, lastSentPosition_);
+  if (position <= firstSentPosition_) {
+    return;
+  }
+
+  // A position inside a frame drops that frame as well.
+  const auto end = std::lower_bound(frames_.begin(), frames_.end(), position);
+  const auto first = end != frames_.end() ? *end : lastSentPosition_;
+  stats_->resumeBufferChanged(
+      -static_cast<int>(std::distance(frames_.begin(), end)),
+      -static_cast<int>(first - firstSentPosition_));
+
+  frames_.erase(frames_.begin(), end);
+  firstSentPosition_ = first;
+}
+
+void RingResumeManager::copyIn(
+    const folly::IOBuf& frame,
+    ResumePosition position) {
+  auto offset = static_cast<size_t>(position % capacity_);
+  for (auto range : frame) {
+    while (!range.empty()) {
+      const auto n = std::min(range.size(), capacity_ - offset);
+      std::memcpy(ring_.get() + offset, range.data(), n);
+      range.advance(n);
+      offset = (offset + n) % capacity_;
+    }
+  }
+}
+
+std::unique_ptr<folly::IOBuf> RingResumeManager::copyOut(
+    ResumePosition position,
+    size_t length) const {
+  // Copied rather than wrapped, since the transport may hold on to the frame
+  // after the ring is overwritten.
+  auto buf = folly::IOBuf::create(kFrameLengthFieldHeadroom + length);
+  buf->advance(kFrameLengthFieldHeadroom);
+  auto offset = static_cast<size_t>(position % capacity_);
+  const auto first = std::min(length, capacity_ - offset);
+  std::memcpy(buf->writableTail(), ring_.get() + offset, first);
+  std::memcpy(buf->writableTail() + first, ring_.get(), length - first);
+  buf->append(length);
+  return buf;
+}
+
+} // namespace rsocket
@@ -0,0 +1,122 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/lang/Assume.h>
+
+#include <deque>
+#include <memory>
+
+#include "rsocket/RSocketStats.h"
+#include "rsocket/ResumeManager.h"
+
+namespace rsocket {
+
+/// Warm resumption store that copies sent frames into a single ring buffer
+/// of `capacity` bytes, instead of keeping a clone of every frame.
+///
+/// Resume positions are byte counts of the tracked frames, so a frame at
+/// position P sits at offset P % capacity in the ring.  The only index kept
+/// is the start position of each buffered frame, which is searched with a
+/// binary search.  The ring is allocated when the first frame is tracked.
+class RingResumeManager : public ResumeManager {
+ public:
+  static constexpr size_t kDefaultCapacity = 1024 * 1024; // 1MB
+
+  explicit RingResumeManager(
+      std::shared_ptr<RSocketStats> stats,
+      size_t capacity = kDefaultCapacity);
+  ~RingResumeManager();
+
+  void trackReceivedFrame(
+      size_t frameLength,
+      FrameType frameType,
+      StreamId streamId,
+      size_t consumerAllowance) override;
+
+  void trackSentFrame(
+      const folly::IOBuf& serializedFrame,
+      FrameType frameType,
+      StreamId streamId,
+      size_t consumerAllowance) override;
+
+  void resetUpToPosition(ResumePosition position) override;
+
+  bool isPositionAvailable(ResumePosition position) const override;
+
+  void sendFramesFromPosition(
+      ResumePosition position,
+      FrameTransport& transport) const override;
+
+  ResumePosition sendFramesFromPositionUpTo(
+      ResumePosition position,
+      FrameTransport& transport,
+      size_t maxBytes) const override;
+
+  ResumePosition firstSentPosition() const override {
+    return firstSentPosition_;
+  }
+
+  ResumePosition lastSentPosition() const override {
+    return lastSentPosition_;
+  }
+
+  ResumePosition impliedPosition() const override {
+    return impliedPosition_;
+  }
+
+  // No action to perform for warm resumption
+  void onStreamOpen(StreamId, RequestOriginator, std::string, StreamType)
+      override {}
+
+  // No action to perform for warm resumption
+  void onStreamClosed(StreamId) override {}
+
+  const StreamResumeInfos& getStreamResumeInfos() const override {
+    LOG(FATAL) << "Not Implemented for Warm Resumption";
+    folly::assume_unreachable();
+  }
+
+  StreamId getLargestUsedStreamId() const override {
+    LOG(FATAL) << "Not Implemented for Warm Resumption";
+    folly::assume_unreachable();
+  }
+
+  size_t bufferedBytes() const override {
+    return static_cast<size_t>(lastSentPosition_ - firstSentPosition_);
+  }
+
+ private:
+  /// Drops the frames that start before `position`.
+  void clearFrames(ResumePosition position);
+
+  void copyIn(const folly::IOBuf& frame, ResumePosition position);
+  std::unique_ptr<folly::IOBuf> copyOut(
+      ResumePosition position,
+      size_t length) const;
+
+  const std::shared_ptr<RSocketStats> stats_;
+  const size_t capacity_;
+  std::unique_ptr<uint8_t[]> ring_;
+
+  /// Start position of each buffered frame, oldest first.
+  std::deque<ResumePosition> frames_;
+
+  ResumePosition firstSentPosition_{0};
+  ResumePosition lastSentPosition_{0};
+  ResumePosition impliedPosition_{0};
+};
+
+} // namespace rsocket
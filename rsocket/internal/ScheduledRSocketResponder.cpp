@@ -14,26 +14,52 @@
 
 #include "rsocket/internal/ScheduledRSocketResponder.h"
 
+#include <folly/executors/SerialExecutor.h>
 #include <folly/io/async/EventBase.h>
 
+#include "rsocket/CachingRSocketResponder.h"
+#include "rsocket/internal/ExecutorSingleObserver.h"
+#include "rsocket/internal/ExecutorSubscriber.h"
 #include "rsocket/internal/ScheduledSingleObserver.h"
 #include "rsocket/internal/ScheduledSubscriber.h"
+#include "rsocket/internal/StreamErrors.h"
+#include "yarpl/single/SingleSubscriptions.h"
 
 namespace rsocket {
 
 ScheduledRSocketResponder::ScheduledRSocketResponder(
     std::shared_ptr<RSocketResponder> inner,
-    folly::EventBase& eventBase)
-    : inner_(std::move(inner)), eventBase_(eventBase) {}
+    folly::EventBase& eventBase,
+    folly::Executor::KeepAlive<> executor)
+    : inner_(std::move(inner)),
+      cache_(std::dynamic_pointer_cast<CachingRSocketResponder>(inner_)),
+      eventBase_(&eventBase),
+      executor_(std::move(executor)) {}
 
 std::shared_ptr<yarpl::single::Single<Payload>>
 ScheduledRSocketResponder::handleRequestResponse(
     Payload request,
     StreamId streamId) {
+  if (executor_) {
+    if (cache_) {
+      if (auto response = cache_->lookup(request)) {
+        return yarpl::single::Singles::create<Payload>(
+            [response = std::move(*response)](
+                std::shared_ptr<yarpl::single::SingleObserver<Payload>>
+                    observer) mutable {
+              observer->onSubscribe(
+                  yarpl::single::SingleSubscriptions::empty());
+              observer->onSuccess(std::move(response));
+            });
+      }
+    }
+    return offloadRequestResponse(
+        std::move(request), streamId, RequestDeadline::current());
+  }
   auto innerFlowable =
       inner_->handleRequestResponse(std::move(request), streamId);
   return yarpl::single::Singles::create<Payload>(
-      [innerFlowable = std::move(innerFlowable), eventBase = &eventBase_](
+      [innerFlowable = std::move(innerFlowable), eventBase = eventBase_](
           std::shared_ptr<yarpl::single::SingleObserver<Payload>> observer) {
         innerFlowable->subscribe(
             std::make_shared<ScheduledSingleObserver<Payload>>(
@@ -45,10 +71,14 @@ std::shared_ptr<yarpl::flowable::Flowable<Payload>>
 ScheduledRSocketResponder::handleRequestStream(
     Payload request,
     StreamId streamId) {
+  if (executor_) {
+    return offloadRequestStream(
+        std::move(request), streamId, RequestDeadline::current());
+  }
   auto innerFlowable =
       inner_->handleRequestStream(std::move(request), streamId);
   return yarpl::flowable::internal::flowableFromSubscriber<Payload>(
-      [innerFlowable = std::move(innerFlowable), eventBase = &eventBase_](
+      [innerFlowable = std::move(innerFlowable), eventBase = eventBase_](
           std::shared_ptr<yarpl::flowable::Subscriber<Payload>> subscriber) {
         innerFlowable->subscribe(std::make_shared<ScheduledSubscriber<Payload>>(
             std::move(subscriber), *eventBase));
@@ -60,9 +90,16 @@ ScheduledRSocketResponder::handleRequestChannel(
     Payload request,
     std::shared_ptr<yarpl::flowable::Flowable<Payload>> requestStream,
     StreamId streamId) {
+  if (executor_) {
+    return offloadRequestChannel(
+        std::move(request),
+        std::move(requestStream),
+        streamId,
+        RequestDeadline::current());
+  }
   auto requestStreamFlowable =
       yarpl::flowable::internal::flowableFromSubscriber<Payload>(
-          [requestStream = std::move(requestStream), eventBase = &eventBase_](
+          [requestStream = std::move(requestStream), eventBase = eventBase_](
               std::shared_ptr<yarpl::flowable::Subscriber<Payload>>
                   subscriber) {
             requestStream->subscribe(
@@ -72,7 +109,7 @@ ScheduledRSocketResponder::handleRequestChannel(
   auto innerFlowable = inner_->handleRequestChannel(
       std::move(request), std::move(requestStreamFlowable), streamId);
   return yarpl::flowable::internal::flowableFromSubscriber<Payload>(
-      [innerFlowable = std::move(innerFlowable), eventBase = &eventBase_](
+      [innerFlowable = std::move(innerFlowable), eventBase = eventBase_](
           std::shared_ptr<yarpl::flowable::Subscriber<Payload>> subscriber) {
         innerFlowable->subscribe(std::make_shared<ScheduledSubscriber<Payload>>(
             std::move(subscriber), *eventBase));
@@ -82,7 +119,159 @@ ScheduledRSocketResponder::handleRequestChannel(
 void ScheduledRSocketResponder::handleFireAndForget(
     Payload request,
     StreamId streamId) {
+  if (executor_) {
+    executor_->add([inner = inner_,
+                    request = std::move(request),
+                    streamId,
+                    deadline = RequestDeadline::current()]() mutable {
+      if (expired(deadline)) {
+        return;
+      }
+      RequestDeadline::Scope scope(deadline);
+      inner->handleFireAndForget(std::move(request), streamId);
+    });
+    return;
+  }
   inner_->handleFireAndForget(std::move(request), streamId);
 }
 
+bool ScheduledRSocketResponder::expired(const Deadline& deadline) {
+  if (!deadline || *deadline > RequestDeadline::Clock::now()) {
+    return false;
+  }
+  VLOG(3) << "Dropping a request queued past its deadline";
+  return true;
+}
+
+std::shared_ptr<yarpl::single::Single<Payload>>
+ScheduledRSocketResponder::offloadRequestResponse(
+    Payload request,
+    StreamId streamId,
+    Deadline deadline) {
+  return yarpl::single::Singles::create<Payload>(
+      [inner = inner_,
+       executor = executor_.copy(),
+       eventBase = eventBase_,
+       request = std::move(request),
+       streamId,
+       deadline](std::shared_ptr<yarpl::single::SingleObserver<Payload>>
+                     observer) mutable {
+        auto serial = folly::SerialExecutor::create(std::move(executor));
+        auto scheduled = std::make_shared<ScheduledSingleObserver<Payload>>(
+            std::make_shared<ExecutorSubscriptionSingleObserver<Payload>>(
+                std::move(observer), serial.copy()),
+            *eventBase);
+        serial->add([inner = std::move(inner),
+                     request = std::move(request),
+                     streamId,
+                     deadline,
+                     scheduled = std::move(scheduled)]() mutable {
+          if (expired(deadline)) {
+            scheduled->onSubscribe(yarpl::single::SingleSubscriptions::empty());
+            scheduled->onError(StreamErrors::deadlineExpired());
+            return;
+          }
+          RequestDeadline::Scope scope(deadline);
+          inner->handleRequestResponse(std::move(request), streamId)
+              ->subscribe(std::move(scheduled));
+        });
+      });
+}
+
+std::shared_ptr<yarpl::flowable::Flowable<Payload>>
+ScheduledRSocketResponder::offloadRequestStream(
+    Payload request,
+    StreamId streamId,
+    Deadline deadline) {
+  return yarpl::flowable::internal::flowableFromSubscriber<Payload>(
+      [inner = inner_,
+       executor = executor_.copy(),
+       eventBase = eventBase_,
+       request = std::move(request),
+       streamId,
+       deadline](std::shared_ptr<yarpl::flowable::Subscriber<Payload>>
+                     subscriber) mutable {
+        auto serial = folly::SerialExecutor::create(std::move(executor));
+        auto scheduled = std::make_shared<ScheduledSubscriber<Payload>>(
+            std::make_shared<ExecutorSubscriptionSubscriber<Payload>>(
+                std::move(subscriber), serial.copy()),
+            *eventBase);
+        serial->add([inner = std::move(inner),
+                     request = std::move(request),
+                     streamId,
+                     deadline,
+                     scheduled = std::move(scheduled)]() mutable {
+          if (expired(deadline)) {
+            scheduled->onSubscribe(yarpl::flowable::Subscription::create());
+            scheduled->onError(StreamErrors::deadlineExpired());
+            return;
+          }
+          RequestDeadline::Scope scope(deadline);
+          inner->handleRequestStream(std::move(request), streamId)
+              ->subscribe(std::move(scheduled));
+        });
+      });
+}
+
+std::shared_ptr<yarpl::flowable::Flowable<Payload>>
+ScheduledRSocketResponder::offloadRequestChannel(
+    Payload request,
+    std::shared_ptr<yarpl::flowable::Flowable<Payload>> requestStream,
+    StreamId streamId,
+    Deadline deadline) {
+  return yarpl::flowable::internal::flowableFromSubscriber<Payload>(
+      [inner = inner_,
+       executor = executor_.copy(),
+       eventBase = eventBase_,
+       request = std::move(request),
+       requestStream = std::move(requestStream),
+       streamId,
+       deadline](std::shared_ptr<yarpl::flowable::Subscriber<Payload>>
+                     subscriber) mutable {
+        auto serial = folly::SerialExecutor::create(std::move(executor));
+
+        // The application subscribes to the request stream from the
+        // Executor, but the stream lives on the EventBase, and so must its
+        // subscriber.
+        auto requestStreamFlowable =
+            yarpl::flowable::internal::flowableFromSubscriber<Payload>(
+                [requestStream = std::move(requestStream),
+                 eventBase,
+                 serial = serial.copy()](
+                    std::shared_ptr<yarpl::flowable::Subscriber<Payload>>
+                        subscriber) {
+                  auto scheduled = std::make_shared<
+                      ScheduledSubscriptionSubscriber<Payload>>(
+                      std::make_shared<ExecutorSubscriber<Payload>>(
+                          std::move(subscriber), serial.copy()),
+                      *eventBase);
+                  eventBase->runInEventBaseThread(
+                      [requestStream, scheduled = std::move(scheduled)] {
+                        requestStream->subscribe(std::move(scheduled));
+                      });
+                });
+
+        auto scheduled = std::make_shared<ScheduledSubscriber<Payload>>(
+            std::make_shared<ExecutorSubscriptionSubscriber<Payload>>(
+                std::move(subscriber), serial.copy()),
+            *eventBase);
+        serial->add([inner = std::move(inner),
+                     request = std::move(request),
+                     requestStreamFlowable = std::move(requestStreamFlowable),
+                     streamId,
+                     deadline,
+                     scheduled = std::move(scheduled)]() mutable {
+          if (expired(deadline)) {
+            scheduled->onSubscribe(yarpl::flowable::Subscription::create());
+            scheduled->onError(StreamErrors::deadlineExpired());
+            return;
+          }
+          RequestDeadline::Scope scope(deadline);
+          auto innerFlowable = inner->handleRequestChannel(
+              std::move(request), std::move(requestStreamFlowable), streamId);
+          innerFlowable->subscribe(std::move(scheduled));
+        });
+      });
+}
+
 } // namespace rsocket
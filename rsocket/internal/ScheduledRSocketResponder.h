@@ -14,7 +14,10 @@
 
 #pragma once
 
+#include <folly/Executor.h>
+
 #include "rsocket/RSocketResponder.h"
+#include "rsocket/RequestDeadline.h"
 
 namespace folly {
 class EventBase;
@@ -22,15 +25,27 @@ class EventBase;
 
 namespace rsocket {
 
+class CachingRSocketResponder;
+
 //
 // A decorated RSocketResponder object which schedules the calls from
 // application code to RSocket on the provided EventBase
 //
+// When given an Executor, it also runs the calls from RSocket to the
+// application code on that Executor instead of the EventBase, each stream
+// through its own SerialExecutor so that the calls of a stream stay in order.
+// The calls carry the RequestDeadline::current() of the request over to the
+// Executor, and requests whose deadline passed while they were queued are
+// dropped there without calling the application.
+// Request-responses that a CachingRSocketResponder has a response for are
+// answered without leaving the EventBase.
+//
 class ScheduledRSocketResponder : public RSocketResponder {
  public:
   ScheduledRSocketResponder(
       std::shared_ptr<RSocketResponder> inner,
-      folly::EventBase& eventBase);
+      folly::EventBase& eventBase,
+      folly::Executor::KeepAlive<> executor = {});
 
   std::shared_ptr<yarpl::single::Single<Payload>> handleRequestResponse(
       Payload request,
@@ -47,9 +62,39 @@ class ScheduledRSocketResponder : public RSocketResponder {
 
   void handleFireAndForget(Payload request, StreamId streamId) override;
 
+  // Schedules the calls of the streams created from now on on another
+  // EventBase.  Must be called on the thread of the state machine, while it
+  // has no streams.
+  void setEventBase(folly::EventBase& eventBase) {
+    eventBase_ = &eventBase;
+  }
+
  private:
+  using Deadline = folly::Optional<RequestDeadline::Clock::time_point>;
+
+  /// Whether a request queued on the Executor is past its deadline.
+  static bool expired(const Deadline& deadline);
+
+  std::shared_ptr<yarpl::single::Single<Payload>> offloadRequestResponse(
+      Payload request,
+      StreamId streamId,
+      Deadline deadline);
+
+  std::shared_ptr<yarpl::flowable::Flowable<Payload>> offloadRequestStream(
+      Payload request,
+      StreamId streamId,
+      Deadline deadline);
+
+  std::shared_ptr<yarpl::flowable::Flowable<Payload>> offloadRequestChannel(
+      Payload request,
+      std::shared_ptr<yarpl::flowable::Flowable<Payload>> requestStream,
+      StreamId streamId,
+      Deadline deadline);
+
   const std::shared_ptr<RSocketResponder> inner_;
-  folly::EventBase& eventBase_;
+  const std::shared_ptr<CachingRSocketResponder> cache_;
+  folly::EventBase* eventBase_;
+  const folly::Executor::KeepAlive<> executor_;
 };
 
 } // namespace rsocket
@@ -15,18 +15,24 @@
 #include "rsocket/internal/SetupResumeAcceptor.h"
 
 #include <folly/ExceptionWrapper.h>
+#include <folly/synchronization/Baton.h>
 #include <folly/io/async/EventBase.h>
 
 #include "rsocket/framing/Frame.h"
 #include "rsocket/framing/FrameProcessor.h"
 #include "rsocket/framing/FrameSerializer.h"
+#include "rsocket/framing/FrameSerializer_v1_0.h"
 
 namespace rsocket {
 
 /// Subscriber that owns a connection, sets itself as that connection's input,
 /// and reads out a single frame before cancelling.
+///
+/// Holds a reference to itself while linked into the acceptor's list, which is
+/// dropped when the subscriber terminates.
 class SetupResumeAcceptor::OneFrameSubscriber final
-    : public yarpl::flowable::BaseSubscriber<std::unique_ptr<folly::IOBuf>> {
+    : public yarpl::flowable::BaseSubscriber<std::unique_ptr<folly::IOBuf>>,
+      public SetupResumeAcceptor::PendingConnection {
  public:
   OneFrameSubscriber(
       SetupResumeAcceptor& acceptor,
@@ -45,14 +51,18 @@ class SetupResumeAcceptor::OneFrameSubscriber final
 
   void setInput() {
     DCHECK(acceptor_.inOwnerThread());
-    connection_->setInput(ref_from_this(this));
+    self_ = ref_from_this(this);
+    acceptor_.connections_.push_back(*this);
+    connection_->setInput(self_);
   }
 
   /// Shut down the DuplexConnection, breaking the cycle between it and this
   /// subscriber.  Expects the DuplexConnection's destructor to call
   /// onComplete/onError on its input subscriber (this).
-  void close() {
+  void close() override {
     auto self = ref_from_this(this);
+    unlink();
+    self_.reset();
     connection_.reset();
   }
 
@@ -79,11 +89,13 @@ class SetupResumeAcceptor::OneFrameSubscriber final
 
   void onTerminateImpl() override {
     DCHECK(acceptor_.inOwnerThread());
-    acceptor_.remove(ref_from_this(this));
+    unlink();
+    self_.reset();
   }
 
  private:
   SetupResumeAcceptor& acceptor_;
+  std::shared_ptr<OneFrameSubscriber> self_;
   std::unique_ptr<DuplexConnection> connection_;
   SetupResumeAcceptor::OnSetup onSetup_;
   SetupResumeAcceptor::OnResume onResume_;
@@ -95,7 +107,18 @@ SetupResumeAcceptor::SetupResumeAcceptor(folly::EventBase* eventBase)
 }
 
 SetupResumeAcceptor::~SetupResumeAcceptor() {
-  close().get();
+  folly::Baton<> closed;
+  close([&] { closed.post(); });
+  closed.wait();
+}
+
+const FrameSerializer* SetupResumeAcceptor::serializerFor(
+    const folly::IOBuf& firstFrame) {
+  const auto version = FrameSerializerV1_0::detectProtocolVersion(firstFrame);
+  if (version == ProtocolVersion::Unknown) {
+    return nullptr;
+  }
+  return FrameSerializer::shared(version, false);
 }
 
 void SetupResumeAcceptor::processFrame(
@@ -110,7 +133,7 @@ void SetupResumeAcceptor::processFrame(
     return;
   }
 
-  const auto serializer = FrameSerializer::createAutodetectedSerializer(*buf);
+  const auto serializer = serializerFor(*buf);
   if (!serializer) {
     VLOG(2) << "Unable to detect protocol version";
     return;
@@ -189,25 +212,26 @@ void SetupResumeAcceptor::accept(
     return;
   }
 
-  const auto subscriber = std::make_shared<OneFrameSubscriber>(
-      *this, std::move(connection), std::move(onSetup), std::move(onResume));
-  connections_.insert(subscriber);
-  subscriber->setInput();
-}
-
-void SetupResumeAcceptor::remove(
-    const std::shared_ptr<SetupResumeAcceptor::OneFrameSubscriber>&
-        subscriber) {
-  DCHECK(inOwnerThread());
-  connections_.erase(subscriber);
+  std::make_shared<OneFrameSubscriber>(
+      *this, std::move(connection), std::move(onSetup), std::move(onResume))
+      ->setInput();
 }
 
-folly::Future<folly::Unit> SetupResumeAcceptor::close() {
+void SetupResumeAcceptor::close(folly::Function<void()> onClosed) {
   if (inOwnerThread()) {
     closeAll();
-    return folly::makeFuture();
+    if (onClosed) {
+      onClosed();
+    }
+    return;
   }
-  return folly::via(eventBase_, [this] { closeAll(); });
+  eventBase_->runInEventBaseThread(
+      [this, onClosed = std::move(onClosed)]() mutable {
+        closeAll();
+        if (onClosed) {
+          onClosed();
+        }
+      });
 }
 
 void SetupResumeAcceptor::closeAll() {
@@ -215,9 +239,9 @@ void SetupResumeAcceptor::closeAll() {
 
   closed_ = true;
 
-  auto connections = std::move(connections_);
-  for (auto& connection : connections) {
-    connection->close();
+  // Closing a connection unlinks it, so always close the first one.
+  while (!connections_.empty()) {
+    connections_.front().close();
   }
 }
 
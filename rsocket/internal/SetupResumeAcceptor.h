@@ -15,10 +15,9 @@
 #pragma once
 
 #include <memory>
-#include <unordered_set>
 
+#include <boost/intrusive/list.hpp>
 #include <folly/Function.h>
-#include <folly/futures/Future.h>
 
 #include "rsocket/DuplexConnection.h"
 #include "rsocket/RSocketParameters.h"
@@ -33,11 +32,17 @@ class exception_wrapper;
 
 namespace rsocket {
 
+class FrameSerializer;
+
 /// Acceptor of DuplexConnections that lets us decide whether the connection is
 /// trying to setup a new connection or resume an existing one.
 ///
 /// An instance of this class must be tied to a specific thread, as the
 /// SetupResumeAcceptor::accept() entry point is not thread-safe.
+///
+/// Accepting a connection costs a single allocation: the subscriber that reads
+/// the first frame links itself into an intrusive list of pending connections
+/// and keeps itself alive until that frame arrives or the connection ends.
 class SetupResumeAcceptor final {
  public:
   using OnSetup = folly::Function<
@@ -53,21 +58,39 @@ class SetupResumeAcceptor final {
   void accept(std::unique_ptr<DuplexConnection>, OnSetup, OnResume);
 
   /// Close all open connections, and prevent new ones from being accepted.  Can
-  /// be called from any thread, and also after the EventBase has been
-  /// destroyed, provided we know the ID of the owner thread.
-  folly::Future<folly::Unit> close();
+  /// be called from any thread.  The connections are closed inline when called
+  /// from the owner thread, otherwise on its EventBase; `onClosed` runs once
+  /// they are.
+  void close(folly::Function<void()> onClosed = nullptr);
 
  private:
   class OneFrameSubscriber;
 
+  /// A connection waiting for its first frame.
+  class PendingConnection : public boost::intrusive::list_base_hook<
+                                boost::intrusive::link_mode<
+                                    boost::intrusive::auto_unlink>> {
+   public:
+    virtual ~PendingConnection() = default;
+
+    /// Shut down the connection without processing any frame from it.
+    virtual void close() = 0;
+  };
+
+  using PendingConnections = boost::intrusive::
+      list<PendingConnection, boost::intrusive::constant_time_size<false>>;
+
   void processFrame(
       std::unique_ptr<DuplexConnection>,
       std::unique_ptr<folly::IOBuf>,
       OnSetup,
       OnResume);
 
-  /// Remove a OneFrameSubscriber from the set.
-  void remove(const std::shared_ptr<OneFrameSubscriber>&);
+  /// Returns a serializer for the protocol version of the first frame of a
+  /// connection, or nullptr if the version can't be detected.  Serializers are
+  /// stateless, so this is the one shared by every connection using the same
+  /// version, see FrameSerializer::shared().
+  const FrameSerializer* serializerFor(const folly::IOBuf& firstFrame);
 
   /// Close all open connections.
   void closeAll();
@@ -80,7 +103,7 @@ class SetupResumeAcceptor final {
   /// work within the owner thread.
   bool inOwnerThread() const;
 
-  std::unordered_set<std::shared_ptr<OneFrameSubscriber>> connections_;
+  PendingConnections connections_;
 
   bool closed_{false};
 
@@ -0,0 +1,288 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/SpillingResumeManager.h"
+
+#include <folly/Format.h>
+#include <folly/String.h>
+#include <folly/io/IOBuf.h>
+#include <folly/portability/Fcntl.h>
+#include <folly/portability/SysMman.h>
+#include <folly/portability/Unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include "rsocket/framing/FrameSerializer.h"
+#include "rsocket/framing/FrameTransport.h"
+
+namespace rsocket {
+
+namespace {
+
+std::atomic<uint64_t> segmentCounter{0};
+
+struct FrameStartLess {
+  template <typename Frame>
+  bool operator()(const Frame& frame, ResumePosition position) const {
+    return frame.first < position;
+  }
+};
+
+} // namespace
+
+SpillingResumeManager::SpillingResumeManager(
+    std::shared_ptr<RSocketStats> stats,
+    Options options)
+    : stats_(stats ? std::move(stats) : RSocketStats::noop()),
+      options_(std::move(options)) {
+  DCHECK_GT(options_.segmentSize, 0);
+  DCHECK_GT(options_.maxSegments, 0);
+}
+
+SpillingResumeManager::~SpillingResumeManager() {
+  clearFrames(lastSentPosition_);
+}
+
+void SpillingResumeManager::trackReceivedFrame(
+    size_t frameLength,
+    FrameType frameType,
+    StreamId streamId,
+    size_t consumerAllowance) {
+  if (shouldTrackFrame(frameType)) {
+    VLOG(6) << "Track received frame " << frameType << " StreamId: " << streamId
+            << " Allowance: " << consumerAllowance;
+    impliedPosition_ += frameLength;
+  }
+}
+
+void SpillingResumeManager::trackSentFrame(
+    const folly::IOBuf& serializedFrame,
+    FrameType frameType,
+    StreamId,
+    size_t consumerAllowance) {
+  if (!shouldTrackFrame(frameType)) {
+    return;
+  }
+
+  const auto frameDataLength = serializedFrame.computeChainDataLength();
+  VLOG(6) << "Track sent frame " << frameType
+          << " Allowance: " << consumerAllowance;
+
+  // A frame that can't fit in a segment empties the buffer, and isn't kept.
+  if (frameDataLength == 0 || frameDataLength > options_.segmentSize) {
+    clearFrames(lastSentPosition_);
+    lastSentPosition_ += frameDataLength;
+    firstSentPosition_ = lastSentPosition_;
+    return;
+  }
+
+  memoryFrames_.emplace_back(lastSentPosition_, serializedFrame.clone());
+  options_.compaction.compact(memoryFrames_.back().second);
+  memorySize_ += frameDataLength;
+  lastSentPosition_ += frameDataLength;
+  stats_->resumeBufferChanged(1, static_cast<int>(frameDataLength));
+
+  while (memorySize_ > options_.memoryCapacity && !memoryFrames_.empty()) {
+    spillOldestFrame();
+  }
+}
+
+void SpillingResumeManager::resetUpToPosition(ResumePosition position) {
+  if (position <= firstSentPosition_) {
+    return;
+  }
+  clearFrames(std::min(position, lastSentPosition_));
+}
+
+bool SpillingResumeManager::isPositionAvailable(ResumePosition position) const {
+  if (position == lastSentPosition_ ||
+      std::binary_search(
+          spilledFrames_.begin(), spilledFrames_.end(), position)) {
+    return true;
+  }
+  auto it = std::lower_bound(
+      memoryFrames_.begin(), memoryFrames_.end(), position, FrameStartLess());
+  return it != memoryFrames_.end() && it->first == position;
+}
+
+void SpillingResumeManager::sendFramesFromPosition(
+    ResumePosition position,
+    FrameTransport& frameTransport) const {
+  DCHECK(isPositionAvailable(position));
+
+  if (position == lastSentPosition_) {
+    // idle resumption
+    return;
+  }
+
+  // Spilled frames are read back in position order, so the reads sweep each
+  // segment from front to back.
+  auto segment = segments_.begin();
+  for (auto it = std::lower_bound(
+           spilledFrames_.begin(), spilledFrames_.end(), position);
+       it != spilledFrames_.end();
+       ++it) {
+    while (segment->end <= *it) {
+      ++segment;
+    }
+    const auto next = std::next(it);
+    const auto end = next != spilledFrames_.end() ? *next : segment->end;
+    frameTransport.outputFrameOrDrop(folly::IOBuf::copyBuffer(
+        segment->data + (*it - segment->start),
+        end - *it,
+        kFrameLengthFieldHeadroom));
+  }
+
+  for (auto it = std::lower_bound(
+           memoryFrames_.begin(),
+           memoryFrames_.end(),
+           position,
+           FrameStartLess());
+       it != memoryFrames_.end();
+       ++it) {
+    frameTransport.outputFrameOrDrop(it->second->clone());
+  }
+}
+
+size_t SpillingResumeManager::spilledBytes() const {
+  if (spilledFrames_.empty()) {
+    return 0;
+  }
+  return static_cast<size_t>(segments_.back().end - spilledFrames_.front());
+}
+
+void SpillingResumeManager::spillOldestFrame() {
+  auto& frame = memoryFrames_.front();
+  const auto frameDataLength = frame.second->computeChainDataLength();
+
+  if (segments_.empty() ||
+      segments_.back().end - segments_.back().start + frameDataLength >
+          options_.segmentSize) {
+    if (segments_.size() >= options_.maxSegments) {
+      clearFrames(segments_.front().end);
+    }
+    if (!openSegment(frame.first)) {
+      // Dropped as if it were evicted.  Frames are only ever dropped from the
+      // front, so anything spilled before it has to go as well.
+      clearFrames(
+          memoryFrames_.size() > 1 ? memoryFrames_[1].first
+                                   : lastSentPosition_);
+      return;
+    }
+  }
+
+  auto& segment = segments_.back();
+  DCHECK_EQ(segment.end, frame.first);
+  auto dest = segment.data + (segment.end - segment.start);
+  for (auto range : *frame.second) {
+    std::memcpy(dest, range.data(), range.size());
+    dest += range.size();
+  }
+  segment.end += frameDataLength;
+
+  spilledFrames_.push_back(frame.first);
+  memorySize_ -= frameDataLength;
+  memoryFrames_.pop_front();
+}
+
+bool SpillingResumeManager::openSegment(ResumePosition start) {
+  const auto path = folly::sformat(
+      "{}/rsocket-resume-{}-{}",
+      options_.directory,
+      getpid(),
+      segmentCounter.fetch_add(1, std::memory_order_relaxed));
+
+  const auto fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0) {
+    LOG(ERROR) << "Cannot create resume segment " << path << ": "
+               << folly::errnoStr(errno);
+    return false;
+  }
+  // The mapping keeps the file alive, nothing else needs its name.
+  unlink(path.c_str());
+
+  if (ftruncate(fd, static_cast<off_t>(options_.segmentSize)) != 0) {
+    LOG(ERROR) << "Cannot size resume segment " << path << ": "
+               << folly::errnoStr(errno);
+    close(fd);
+    return false;
+  }
+
+  auto data = mmap(
+      nullptr,
+      options_.segmentSize,
+      PROT_READ | PROT_WRITE,
+      MAP_SHARED,
+      fd,
+      0);
+  const auto mmapErrno = errno;
+  close(fd);
+  if (data == MAP_FAILED) {
+    LOG(ERROR) << "Cannot map resume segment " << path << ": "
+               << folly::errnoStr(mmapErrno);
+    return false;
+  }
+  madvise(data, options_.segmentSize, MADV_SEQUENTIAL);
+
+  Segment segment;
+  segment.start = start;
+  segment.end = start;
+  segment.data = static_cast<uint8_t*>(data);
+  segments_.push_back(segment);
+  return true;
+}
+
+void SpillingResumeManager::unmapSegment(Segment& segment) {
+  munmap(segment.data, options_.segmentSize);
+  segment.data = nullptr;
+}
+
+void SpillingResumeManager::clearFrames(ResumePosition position) {
+  DCHECK_LE(position, lastSentPosition_);
+  if (position <= firstSentPosition_) {
+    return;
+  }
+
+  // A position inside a frame drops that frame as well.
+  const auto spilledEnd =
+      std::lower_bound(spilledFrames_.begin(), spilledFrames_.end(), position);
+  auto dropped = std::distance(spilledFrames_.begin(), spilledEnd);
+  spilledFrames_.erase(spilledFrames_.begin(), spilledEnd);
+
+  if (spilledFrames_.empty()) {
+    while (!memoryFrames_.empty() && memoryFrames_.front().first < position) {
+      memorySize_ -= memoryFrames_.front().second->computeChainDataLength();
+      memoryFrames_.pop_front();
+      ++dropped;
+    }
+  }
+
+  const auto first = !spilledFrames_.empty()
+      ? spilledFrames_.front()
+      : !memoryFrames_.empty() ? memoryFrames_.front().first
+                               : lastSentPosition_;
+  while (!segments_.empty() && segments_.front().end <= first) {
+    unmapSegment(segments_.front());
+    segments_.pop_front();
+  }
+
+  stats_->resumeBufferChanged(
+      -static_cast<int>(dropped),
+      -static_cast<int>(first - firstSentPosition_));
+  firstSentPosition_ = first;
+}
+
+} // namespace rsocket
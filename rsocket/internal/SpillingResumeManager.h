@@ -0,0 +1,152 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/lang/Assume.h>
+
+#include <deque>
+#include <memory>
+#include <string>
+
+#include "rsocket/RSocketStats.h"
+#include "rsocket/ResumeManager.h"
+#include "rsocket/internal/BufferCompaction.h"
+
+namespace rsocket {
+
+/// Warm resumption store for connections that may stay disconnected for a
+/// long time.  The most recent frames are kept in memory.  Older ones are
+/// spilled to memory-mapped segment files, so that the operating system can
+/// page them out, and read back in order when the connection resumes.
+///
+/// Segment files are unlinked as soon as they are created, so nothing is left
+/// on disk once the manager goes away, however it goes away.
+class SpillingResumeManager : public ResumeManager {
+ public:
+  struct Options {
+    /// Directory the segment files are created in.
+    std::string directory{"/tmp"};
+
+    /// Bytes of the most recent frames kept in memory.
+    size_t memoryCapacity{256 * 1024};
+
+    /// Size of each segment file.  Larger frames aren't buffered at all.
+    size_t segmentSize{4 * 1024 * 1024};
+
+    /// Most segment files kept.  The oldest segment is dropped to make room
+    /// for a new one.
+    size_t maxSegments{16};
+
+    /// Thresholds past which frames kept in memory are copied into buffers
+    /// of their own, rather than pinning the buffers they were read into.
+    BufferCompaction compaction;
+  };
+
+  SpillingResumeManager(std::shared_ptr<RSocketStats> stats, Options options);
+  ~SpillingResumeManager();
+
+  void trackReceivedFrame(
+      size_t frameLength,
+      FrameType frameType,
+      StreamId streamId,
+      size_t consumerAllowance) override;
+
+  void trackSentFrame(
+      const folly::IOBuf& serializedFrame,
+      FrameType frameType,
+      StreamId streamId,
+      size_t consumerAllowance) override;
+
+  void resetUpToPosition(ResumePosition position) override;
+
+  bool isPositionAvailable(ResumePosition position) const override;
+
+  void sendFramesFromPosition(
+      ResumePosition position,
+      FrameTransport& transport) const override;
+
+  ResumePosition firstSentPosition() const override {
+    return firstSentPosition_;
+  }
+
+  ResumePosition lastSentPosition() const override {
+    return lastSentPosition_;
+  }
+
+  ResumePosition impliedPosition() const override {
+    return impliedPosition_;
+  }
+
+  // No action to perform for warm resumption
+  void onStreamOpen(StreamId, RequestOriginator, std::string, StreamType)
+      override {}
+
+  // No action to perform for warm resumption
+  void onStreamClosed(StreamId) override {}
+
+  const StreamResumeInfos& getStreamResumeInfos() const override {
+    LOG(FATAL) << "Not Implemented for Warm Resumption";
+    folly::assume_unreachable();
+  }
+
+  StreamId getLargestUsedStreamId() const override {
+    LOG(FATAL) << "Not Implemented for Warm Resumption";
+    folly::assume_unreachable();
+  }
+
+  /// Only counts the frames held in memory.
+  size_t bufferedBytes() const override {
+    return memorySize_;
+  }
+
+  /// Bytes of the frames spilled to segment files.
+  size_t spilledBytes() const;
+
+ private:
+  struct Segment {
+    /// Position of the first frame written to the segment.
+    ResumePosition start{0};
+    /// Position right after the last frame written to the segment.
+    ResumePosition end{0};
+    uint8_t* data{nullptr};
+  };
+
+  /// Moves the oldest frame held in memory to the last segment.
+  void spillOldestFrame();
+  bool openSegment(ResumePosition start);
+  void unmapSegment(Segment&);
+
+  /// Drops the frames that start before `position`.
+  void clearFrames(ResumePosition position);
+
+  const std::shared_ptr<RSocketStats> stats_;
+  const Options options_;
+
+  /// Most recent frames, oldest first.
+  std::deque<std::pair<ResumePosition, std::unique_ptr<folly::IOBuf>>>
+      memoryFrames_;
+  size_t memorySize_{0};
+
+  /// Start positions of the spilled frames, oldest first.  All of them are
+  /// older than the frames in memory.
+  std::deque<ResumePosition> spilledFrames_;
+  std::deque<Segment> segments_;
+
+  ResumePosition firstSentPosition_{0};
+  ResumePosition lastSentPosition_{0};
+  ResumePosition impliedPosition_{0};
+};
+
+} // namespace rsocket
@@ -0,0 +1,47 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/StackTraceUtils.h"
+
+#include <folly/Likely.h>
+
+#include <atomic>
+
+namespace rsocket {
+
+namespace {
+
+std::atomic<uint32_t> sampling{0};
+
+thread_local uint32_t calls{0};
+
+} // namespace
+
+void setStackTraceSampling(uint32_t oneIn) {
+  sampling.store(oneIn, std::memory_order_relaxed);
+}
+
+bool shouldSampleStackTrace() {
+  auto const oneIn = sampling.load(std::memory_order_relaxed);
+  if (FOLLY_LIKELY(oneIn == 0)) {
+    return false;
+  }
+  if (++calls < oneIn) {
+    return false;
+  }
+  calls = 0;
+  return true;
+}
+
+} // namespace rsocket
@@ -14,10 +14,16 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
 
 namespace rsocket {
 
+/// Captures the stack of the calling thread.  Empty unless the build provides
+/// an implementation, see REACTIVE_SOCKET_EXTERNAL_STACK_TRACE_UTILS.
+///
+/// Capturing a stack is slow.  Diagnostics that can run once per frame or per
+/// stream error must go through sampledStackTrace() instead.
 std::string getStackTrace();
 
 #ifndef REACTIVE_SOCKET_EXTERNAL_STACK_TRACE_UTILS
@@ -26,4 +32,18 @@ inline std::string getStackTrace() {
 }
 #endif
 
+/// Makes sampledStackTrace() capture the stack on 1 in `oneIn` calls of each
+/// thread.  Zero, the default, turns stack capture off.
+void setStackTraceSampling(uint32_t oneIn);
+
+/// Whether the next sampledStackTrace() call of this thread would capture the
+/// stack.  Counts as a call.
+bool shouldSampleStackTrace();
+
+/// getStackTrace() for the calls picked by setStackTraceSampling(), and an
+/// empty string for the others.
+inline std::string sampledStackTrace() {
+  return shouldSampleStackTrace() ? getStackTrace() : std::string();
+}
+
 } // namespace rsocket
@@ -0,0 +1,98 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/StreamErrors.h"
+
+#include <folly/Range.h>
+#include <folly/io/IOBuf.h>
+
+#include <stdexcept>
+
+#include "rsocket/RSocketException.h"
+
+namespace rsocket {
+
+namespace {
+
+bool isEmpty(const std::unique_ptr<folly::IOBuf>& buf) {
+  return !buf || buf->computeChainDataLength() == 0;
+}
+
+/// Whether the data of `payload` is `message`, without copying it unless it
+/// spans several buffers.
+bool dataEquals(const Payload& payload, folly::StringPiece message) {
+  if (auto const view = payload.dataView()) {
+    return *view == message;
+  }
+  return payload.cloneDataToString() == message;
+}
+
+} // namespace
+
+folly::exception_wrapper StreamErrors::disconnected() {
+  static auto const error = folly::make_exception_wrapper<std::runtime_error>(
+      "RSocket connection is disconnected or closed");
+  return error;
+}
+
+folly::exception_wrapper StreamErrors::outputPaused() {
+  static auto const error =
+      folly::make_exception_wrapper<OutputBackpressureException>(
+          "Too many frames are waiting to be sent");
+  return error;
+}
+
+folly::exception_wrapper StreamErrors::tooManyStreams() {
+  static auto const error = folly::make_exception_wrapper<std::runtime_error>(
+      "Too many active streams");
+  return error;
+}
+
+folly::exception_wrapper StreamErrors::noLease() {
+  static auto const error =
+      folly::make_exception_wrapper<std::runtime_error>("No lease available");
+  return error;
+}
+
+folly::exception_wrapper StreamErrors::deadlineExpired() {
+  static auto const error = folly::make_exception_wrapper<std::runtime_error>(
+      "Request deadline expired");
+  return error;
+}
+
+folly::exception_wrapper StreamErrors::emptyApplicationError() {
+  static auto const error =
+      folly::make_exception_wrapper<ErrorWithPayload>(Payload());
+  return error;
+}
+
+folly::exception_wrapper StreamErrorCache::error(
+    ErrorCode errorCode,
+    Payload payload) {
+  if (errorCode == ErrorCode::APPLICATION_ERROR) {
+    if (isEmpty(payload.data) && isEmpty(payload.metadata)) {
+      return StreamErrors::emptyApplicationError();
+    }
+    return folly::make_exception_wrapper<ErrorWithPayload>(std::move(payload));
+  }
+
+  if (!lastError_ || !dataEquals(payload, lastMessage_)) {
+    lastMessage_ = payload.moveDataToString();
+    lastError_ =
+        folly::make_exception_wrapper<std::runtime_error>(lastMessage_);
+  }
+  return lastError_;
+}
+
+} // namespace rsocket
@@ -0,0 +1,61 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/ExceptionWrapper.h>
+
+#include <string>
+
+#include "rsocket/Payload.h"
+#include "rsocket/framing/ErrorCode.h"
+
+namespace rsocket {
+
+/// The errors that fail streams in bulk, e.g. every request made while the
+/// connection is down.  Each one is made once, and copied from then on,
+/// which neither allocates nor throws.
+///
+/// Copies of an exception_wrapper may share the exception, which must not be
+/// modified.  The ErrorWithPayload of emptyApplicationError() has an empty
+/// payload, so moving it out leaves the error as it was.
+class StreamErrors {
+ public:
+  static folly::exception_wrapper disconnected();
+  static folly::exception_wrapper outputPaused();
+  static folly::exception_wrapper tooManyStreams();
+  static folly::exception_wrapper noLease();
+  static folly::exception_wrapper deadlineExpired();
+
+  /// An APPLICATION_ERROR without a payload.
+  static folly::exception_wrapper emptyApplicationError();
+};
+
+/// Turns the ERROR frames of streams into exception_wrappers for their
+/// subscribers.  APPLICATION_ERRORs become ErrorWithPayload, and the other
+/// errors a std::runtime_error with the message of the frame.
+///
+/// During error storms the peer sends the same error over and over, e.g.
+/// REJECTED while its backend is down.  The error for the last message is
+/// kept, and handed out again for as long as the message repeats.
+class StreamErrorCache {
+ public:
+  folly::exception_wrapper error(ErrorCode errorCode, Payload payload);
+
+ private:
+  std::string lastMessage_;
+  folly::exception_wrapper lastError_;
+};
+
+} // namespace rsocket
@@ -0,0 +1,293 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Bits.h>
+#include <folly/Likely.h>
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "rsocket/internal/Common.h"
+
+namespace rsocket {
+
+/// Registry of the live streams of a connection, keyed by stream id.
+///
+/// Each side of a connection allocates stream ids monotonically with a fixed
+/// parity, so the live ids of one parity sit in a narrow window.  The table
+/// keeps one direct-mapped lane of slots per parity, indexed by the low bits
+/// of `streamId >> 1`.  Each slot remembers the full id it holds, which acts
+/// as the generation check when a slot is reused by a later stream.
+///
+/// When a new stream maps to a slot that is taken, the lane doubles in size
+/// if it is at least half full and below its maximum capacity.  Otherwise
+/// the stream goes to an overflow hash map, so that a few streams that happen
+/// to collide (a long-lived stream among the requests that keep opening after
+/// it, or a peer picking sparse ids) cost a map entry each instead of a large
+/// lane.  A lane that becomes sparse again halves, down to the capacity
+/// reserved for it.
+template <typename T>
+class StreamTable {
+ public:
+  static constexpr size_t kInitialLaneCapacity = 16;
+  static constexpr size_t kMaxLaneCapacity = 1 << 12;
+
+  /// `maxLaneCapacity` is rounded up to a power of two, of at least
+  /// kInitialLaneCapacity.
+  explicit StreamTable(size_t maxLaneCapacity = kMaxLaneCapacity)
+      : maxLaneCapacity_{
+            folly::nextPowTwo(std::max(maxLaneCapacity, kInitialLaneCapacity))},
+        laneFloors_{{kInitialLaneCapacity, kInitialLaneCapacity}} {}
+
+  size_t size() const {
+    return size_;
+  }
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  /// Number of streams whose id has the same parity as `streamId`, i.e. that
+  /// were opened by the same side of the connection.
+  size_t sizeWithParityOf(StreamId streamId) const {
+    return paritySizes_[streamId & 1];
+  }
+
+  /// Number of slots in the lane of the streams with the parity of
+  /// `streamId`.  Only to be used for observation purposes.
+  size_t laneCapacity(StreamId streamId) const {
+    return lanes_[streamId & 1].size();
+  }
+
+  /// Returns the value of the stream, or nullptr if it is not in the table.
+  T* find(StreamId streamId) {
+    auto& slot = slotFor(streamId);
+    if (FOLLY_LIKELY(slot.streamId == streamId && streamId != 0)) {
+      return &slot.value;
+    }
+    return findOverflow(streamId);
+  }
+
+  const T* find(StreamId streamId) const {
+    return const_cast<StreamTable*>(this)->find(streamId);
+  }
+
+  bool contains(StreamId streamId) const {
+    return find(streamId) != nullptr;
+  }
+
+  /// Throws std::out_of_range if the stream is not in the table.
+  const T& at(StreamId streamId) const {
+    if (auto value = find(streamId)) {
+      return *value;
+    }
+    throw std::out_of_range("Stream is not in the table");
+  }
+
+  /// Adds a stream.  Returns false, leaving the table unchanged, if a stream
+  /// with the same id is already in it.
+  bool emplace(StreamId streamId, T value) {
+    if (streamId == 0 || contains(streamId)) {
+      return false;
+    }
+
+    auto const parity = streamId & 1;
+    auto& lane = lanes_[parity];
+    if (lane.empty()) {
+      lane.resize(laneFloors_[parity]);
+    }
+
+    while (slotFor(streamId).streamId != 0) {
+      if (lane.size() >= maxLaneCapacity_ ||
+          laneSizes_[parity] * 2 < lane.size()) {
+        overflow_.emplace(streamId, std::move(value));
+        ++size_;
+        ++paritySizes_[parity];
+        return true;
+      }
+      resize(parity, lane.size() * 2);
+    }
+
+    auto& slot = slotFor(streamId);
+    slot.streamId = streamId;
+    slot.value = std::move(value);
+    ++size_;
+    ++paritySizes_[parity];
+    ++laneSizes_[parity];
+    return true;
+  }
+
+  /// Preallocates the lane of the streams with the parity of `streamId` for
+  /// this many streams at once, up to the maximum lane capacity.  The lane
+  /// doesn't shrink below that from then on.
+  void reserve(StreamId streamId, size_t streams) {
+    auto const parity = streamId & 1;
+    auto& lane = lanes_[parity];
+    auto const capacity = std::min(
+        folly::nextPowTwo(std::max(streams, kInitialLaneCapacity)),
+        maxLaneCapacity_);
+    laneFloors_[parity] = std::max(laneFloors_[parity], capacity);
+    if (lane.empty()) {
+      lane.resize(capacity);
+    } else if (lane.size() < capacity) {
+      resize(parity, capacity);
+    }
+  }
+
+  /// Removes a stream.  Returns false if it was not in the table.
+  bool erase(StreamId streamId) {
+    auto& slot = slotFor(streamId);
+    if (slot.streamId == streamId && streamId != 0) {
+      auto const parity = streamId & 1;
+      slot = Slot();
+      --size_;
+      --paritySizes_[parity];
+      --laneSizes_[parity];
+      auto const capacity = lanes_[parity].size();
+      if (capacity > laneFloors_[parity] &&
+          laneSizes_[parity] * 8 < capacity) {
+        resize(parity, capacity / 2);
+      }
+      return true;
+    }
+    if (!overflow_.empty() && overflow_.erase(streamId) > 0) {
+      --size_;
+      --paritySizes_[streamId & 1];
+      return true;
+    }
+    return false;
+  }
+
+  /// Calls `fn(streamId, value)` for every stream.  `fn` must not add or
+  /// remove streams.
+  template <typename F>
+  void forEach(F&& fn) {
+    for (auto& lane : lanes_) {
+      for (auto& slot : lane) {
+        if (slot.streamId != 0) {
+          fn(slot.streamId, slot.value);
+        }
+      }
+    }
+    for (auto& entry : overflow_) {
+      fn(entry.first, entry.second);
+    }
+  }
+
+  template <typename F>
+  void forEach(F&& fn) const {
+    const_cast<StreamTable*>(this)->forEach(
+        [&](StreamId streamId, const T& value) { fn(streamId, value); });
+  }
+
+  /// Empties the table, returning the values that were in it.
+  std::vector<T> extractAll() {
+    std::vector<T> values;
+    values.reserve(size_);
+    for (auto& lane : lanes_) {
+      for (auto& slot : lane) {
+        if (slot.streamId != 0) {
+          values.push_back(std::move(slot.value));
+          slot = Slot();
+        }
+      }
+    }
+    for (auto& entry : overflow_) {
+      values.push_back(std::move(entry.second));
+    }
+    overflow_.clear();
+    size_ = 0;
+    paritySizes_ = {};
+    laneSizes_ = {};
+    return values;
+  }
+
+ private:
+  struct Slot {
+    StreamId streamId{0};
+    T value{};
+  };
+
+  using Lane = std::vector<Slot>;
+
+  static size_t indexOf(const Lane& lane, StreamId streamId) {
+    return (streamId >> 1) & (lane.size() - 1);
+  }
+
+  Slot& slotFor(StreamId streamId) {
+    auto& lane = lanes_[streamId & 1];
+    if (FOLLY_UNLIKELY(lane.empty())) {
+      return emptySlot_;
+    }
+    return lane[indexOf(lane, streamId)];
+  }
+
+  T* findOverflow(StreamId streamId) {
+    if (FOLLY_LIKELY(overflow_.empty())) {
+      return nullptr;
+    }
+    auto it = overflow_.find(streamId);
+    return it != overflow_.end() ? &it->second : nullptr;
+  }
+
+  /// Rehashes a lane into `capacity` slots.  Growing splits every slot in
+  /// two, so it cannot collide.  Shrinking merges slots in pairs, and moves
+  /// one stream of each pair that is fully taken to the overflow map.
+  /// Streams already in the overflow map stay there until they are erased.
+  void resize(size_t parity, size_t capacity) {
+    auto& lane = lanes_[parity];
+    Lane resized(capacity);
+    for (auto& slot : lane) {
+      if (slot.streamId == 0) {
+        continue;
+      }
+      auto& target = resized[indexOf(resized, slot.streamId)];
+      if (target.streamId == 0) {
+        target = std::move(slot);
+      } else {
+        overflow_.emplace(slot.streamId, std::move(slot.value));
+        --laneSizes_[parity];
+      }
+    }
+    lane = std::move(resized);
+  }
+
+  size_t maxLaneCapacity_;
+  std::array<Lane, 2> lanes_;
+  std::unordered_map<StreamId, T> overflow_;
+  size_t size_{0};
+  std::array<size_t, 2> paritySizes_{};
+
+  /// Streams held in each lane, as opposed to the overflow map.
+  std::array<size_t, 2> laneSizes_{};
+
+  /// Capacity each lane starts with and doesn't shrink below, see reserve().
+  std::array<size_t, 2> laneFloors_;
+
+  /// Stands in for the slots of a lane that isn't allocated yet.  Never
+  /// written to, since emplace() allocates the lane first.
+  Slot emptySlot_;
+};
+
+template <typename T>
+constexpr size_t StreamTable<T>::kInitialLaneCapacity;
+template <typename T>
+constexpr size_t StreamTable<T>::kMaxLaneCapacity;
+
+} // namespace rsocket
@@ -14,65 +14,179 @@
 
 #include "SwappableEventBase.h"
 
+#include <atomic>
+#include <utility>
+
 namespace rsocket {
 
-bool SwappableEventBase::runInEventBaseThread(CbFunc cb) {
-  const std::lock_guard<std::mutex> l(hasSebDtored_->l_);
+// A callback, or a swap marker if it has no callback
+struct SwappableEventBase::Entry {
+  CbFunc cb;
+  Entry* next{nullptr};
+};
 
-  if (this->isSwapping()) {
-    queued_.push_back(std::move(cb));
-    return false;
+struct SwappableEventBase::SharedState {
+  explicit SharedState(folly::EventBase& eb) : eb_(&eb) {}
+
+  ~SharedState() {
+    // Only left over if an EventBase went away with a drain still scheduled
+    auto head = pushed_.load();
+    while (head) {
+      delete std::exchange(head, head->next);
+    }
+    while (taken_) {
+      delete std::exchange(taken_, taken_->next);
+    }
   }
 
-  eb_->runInEventBaseThread(
-      [eb = eb_, cb_ = std::move(cb)]() mutable { return cb_(*eb); });
+  // Adds 'entry' to the queue, returning true if the caller has to schedule
+  // the drain
+  bool push(Entry* entry) {
+    auto head = pushed_.load(std::memory_order_relaxed);
+    do {
+      entry->next = head;
+    } while (!pushed_.compare_exchange_weak(
+        head, entry, std::memory_order_release, std::memory_order_relaxed));
+    return pending_.fetch_add(1, std::memory_order_acq_rel) == 0;
+  }
 
-  return true;
-}
+  // Takes the oldest entry off the queue.  Only called by the drain, which
+  // knows there is one.
+  std::unique_ptr<Entry> take() {
+    if (!taken_) {
+      // 'pushed_' is newest first
+      auto head = pushed_.exchange(nullptr, std::memory_order_acquire);
+      while (head) {
+        auto const next = head->next;
+        head->next = taken_;
+        taken_ = head;
+        head = next;
+      }
+    }
+    DCHECK(taken_);
+    return std::unique_ptr<Entry>(std::exchange(taken_, taken_->next));
+  }
 
-void SwappableEventBase::setEventBase(folly::EventBase& newEb) {
-  const std::lock_guard<std::mutex> l(hasSebDtored_->l_);
+  // Releases an entry that was taken off the queue once it is done with,
+  // returning true if more entries are pending
+  bool release() {
+    return pending_.fetch_sub(1, std::memory_order_acq_rel) > 1;
+  }
+
+  // the EventBase the queue runs on, only changed by whoever holds the right
+  // to drain the queue (a non-zero 'pending_')
+  std::atomic<folly::EventBase*> eb_;
+
+  // the EventBase to swap to, set while a swap is in progress
+  std::atomic<folly::EventBase*> nextEb_{nullptr};
+
+  // entries in the queue, including the one running.  The call raising it
+  // from zero gets the right to drain the queue, and schedules the drain.
+  std::atomic<size_t> pending_{0};
+
+  // entries pushed to the queue, newest first
+  std::atomic<Entry*> pushed_{nullptr};
+
+  // entries the drain took off 'pushed_', oldest first
+  Entry* taken_{nullptr};
+};
+
+SwappableEventBase::SwappableEventBase(folly::EventBase& eb)
+    : state_(std::make_shared<SharedState>(eb)) {}
 
-  auto const alreadySwapping = this->isSwapping();
-  nextEb_ = &newEb;
-  if (alreadySwapping) {
+bool SwappableEventBase::runInEventBaseThread(CbFunc cb) {
+  auto const swapping =
+      state_->nextEb_.load(std::memory_order_acquire) != nullptr;
+  auto entry = std::make_unique<Entry>();
+  entry->cb = std::move(cb);
+  enqueue(state_, std::move(entry));
+  return !swapping;
+}
+
+void SwappableEventBase::enqueue(
+    const std::shared_ptr<SharedState>& state,
+    std::unique_ptr<Entry> entry) {
+  if (!state->push(entry.release())) {
+    // the drain is already scheduled
     return;
   }
+  state->eb_.load(std::memory_order_acquire)
+      ->runInEventBaseThread([state]() mutable { drain(std::move(state)); });
+}
 
-  eb_->runInEventBaseThread([this, hasSebDtored = hasSebDtored_]() {
-    const std::lock_guard<std::mutex> lInner(hasSebDtored->l_);
-    if (hasSebDtored->destroyed_) {
-      // SEB was destroyed, any queued callbacks were appended to the old eb_
-      return;
+void SwappableEventBase::drain(std::shared_ptr<SharedState> state) {
+  auto& eb = *state->eb_.load(std::memory_order_acquire);
+  do {
+    auto const entry = state->take();
+    if (entry->cb) {
+      entry->cb(eb);
+      continue;
     }
 
-    eb_ = nextEb_;
-    nextEb_ = nullptr;
+    // A swap: let the tasks already enqueued on the current EventBase run
+    // first, then move to the last EventBase set, or stay if the SEB was
+    // destroyed in the meantime.
+    eb.runInEventBaseThread([state = std::move(state), &eb]() mutable {
+      auto const next = state->nextEb_.exchange(nullptr);
+      auto const to = next ? next : &eb;
+      state->eb_.store(to, std::memory_order_release);
+      if (!state->release()) {
+        return;
+      }
+      if (to == &eb) {
+        drain(std::move(state));
+      } else {
+        to->runInEventBaseThread(
+            [state = std::move(state)]() mutable { drain(std::move(state)); });
+      }
+    });
+    return;
+  } while (state->release());
+}
 
-    // enqueue tasks that were being buffered while this was waiting
-    // for the previous EB to drain
-    for (auto& cb : queued_) {
-      eb_->runInEventBaseThread(
-          [cb = std::move(cb), eb = eb_]() mutable { return cb(*eb); });
-    }
+void SwappableEventBase::setEventBase(folly::EventBase& newEb) {
+  if (state_->nextEb_.exchange(&newEb) != nullptr) {
+    // swapping already, the swap goes to the last EventBase set
+    return;
+  }
+  enqueue(state_, std::make_unique<Entry>());
+}
+
+bool SwappableEventBase::trySetEventBase(
+    folly::EventBase& newEb,
+    CbFunc first) {
+  auto& state = *state_;
+  DCHECK(state.eb_.load()->isInEventBaseThread());
+
+  // Nothing left to drain on the current EventBase, as taking the right to
+  // drain the queue means no drain is running or scheduled.
+  size_t expected = 0;
+  if (!state.pending_.compare_exchange_strong(
+          expected, 1, std::memory_order_acq_rel)) {
+    return false;
+  }
 
-    queued_.clear();
-  });
+  state.eb_.store(&newEb, std::memory_order_release);
+  newEb.runInEventBaseThread(
+      [state = state_, first = std::move(first), &newEb]() mutable {
+        first(newEb);
+        if (state->release()) {
+          drain(std::move(state));
+        }
+      });
+  return true;
 }
 
-bool SwappableEventBase::isSwapping() const {
-  return nextEb_ != nullptr;
+folly::EventBase* SwappableEventBase::getEventBaseIfInThread() const {
+  if (state_->pending_.load(std::memory_order_acquire) != 0) {
+    return nullptr;
+  }
+  auto const eb = state_->eb_.load(std::memory_order_acquire);
+  return eb->isInEventBaseThread() ? eb : nullptr;
 }
 
 SwappableEventBase::~SwappableEventBase() {
-  const std::lock_guard<std::mutex> l(hasSebDtored_->l_);
-
-  hasSebDtored_->destroyed_ = true;
-  for (auto& cb : queued_) {
-    eb_->runInEventBaseThread(
-        [cb = std::move(cb), eb = eb_]() mutable { return cb(*eb); });
-  }
-  queued_.clear();
+  state_->nextEb_.store(nullptr);
 }
 
 } /* namespace rsocket */
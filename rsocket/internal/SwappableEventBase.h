@@ -16,7 +16,8 @@
 
 #include <folly/Function.h>
 #include <folly/io/async/EventBase.h>
-#include <mutex>
+
+#include <memory>
 
 namespace rsocket {
 
@@ -24,28 +25,29 @@ namespace rsocket {
 // an underlying EventBase to be changed, and to force callbacks to be
 // executed in serial order regardless of which underlying EventBase they are
 // enqueued on.
+//
+// Callbacks go through a lock-free multi-producer queue.  The call that finds
+// the queue empty schedules the task that runs it on the current EventBase,
+// which keeps running callbacks until the queue is empty again.  A swap is a
+// marker in the queue, so it is ordered with the callbacks without any lock.
 class SwappableEventBase final {
-  // std::mutex doesn't like being in a std::pair
-  struct MutexBoolPair {
-    // lock for synchronization on destroyed_, and all members of the parent SEB
-    std::mutex l_;
-    // has the SEB's destructor ran?
-    bool destroyed_{false};
-  };
+  struct Entry;
+  struct SharedState;
 
  public:
   using CbFunc = folly::Function<void(folly::EventBase&)>;
 
-  explicit SwappableEventBase(folly::EventBase& eb)
-      : eb_(&eb),
-        nextEb_(nullptr),
-        hasSebDtored_(std::make_shared<MutexBoolPair>()) {}
+  explicit SwappableEventBase(folly::EventBase& eb);
 
   // Run or enqueue 'cb', in order with all prior calls to runInEventBaseThread
+  // Callbacks enqueued before the EventBase gets to run them are run by a
+  // single task, so that a burst of calls from another thread wakes the
+  // EventBase up once.
   // If setEventBase has been called, and the prior EventBase is still
   // processing tasks, runInEventBaseThread will queue tasks until the old EB's
-  // tasks have all completed. After that, SwappableEventBase will enqueue
-  // buffered tasks on the last EB set via setEventBase.
+  // tasks have all completed, and returns false. After that,
+  // SwappableEventBase will run queued tasks on the last EB set via
+  // setEventBase.
   //
   // Callbacks take a single parameter: the underlying EventBase
   // that the callback is executing on.
@@ -55,27 +57,36 @@ class SwappableEventBase final {
   // drained
   void setEventBase(folly::EventBase& newEb);
 
-  // SwappableEventBase will enqueue tasks on the old eventbase if
-  // there are any pending by the time the SEB is destroyed
+  // Switches to 'newEb' at once if no callback is waiting to run on the
+  // current EventBase and no swap is in progress, and runs 'first' on
+  // 'newEb' ahead of the callbacks enqueued from then on.  Returns false,
+  // dropping 'first', otherwise.  Must be called on the current EventBase.
+  bool trySetEventBase(folly::EventBase& newEb, CbFunc first);
+
+  // Returns the current EventBase if the caller runs on it and no swap is in
+  // progress and no callbacks are waiting to run, in which case a callback may
+  // run inline without breaking the order with the callbacks already
+  // enqueued.  Returns nullptr otherwise.
+  folly::EventBase* getEventBaseIfInThread() const;
+
+  // Cancels a swap in progress: callbacks still queued by the time the SEB is
+  // destroyed run on the old EventBase
   ~SwappableEventBase();
 
  private:
-  folly::EventBase* eb_;
-  folly::EventBase* nextEb_; // also indicate if we're in the middle of a swap
-
-  // is the SwappableEventBase waiting for the current EventBase to finish
-  // draining?
-  bool isSwapping() const;
-
-  // shared data between the SwappableEventBase and anyone else holding
-  // a reference to the SEB (eg, swapping lambda in setEventBase) to avoid
-  // accessing a dangling pointer in the case where the SEB has already
-  // had its destructor run
-  mutable std::shared_ptr<MutexBoolPair> hasSebDtored_;
-
-  // tasks enqueued with runInEventBaseThread while the SEB is waiting for
-  // the old EventBase* eb_ to drain
-  std::vector<CbFunc> queued_;
+  // Appends 'entry' to the queue, scheduling the task that runs the queue if
+  // it was empty
+  static void enqueue(
+      const std::shared_ptr<SharedState>& state,
+      std::unique_ptr<Entry> entry);
+
+  // Runs the queue on the current EventBase until it is empty or reaches a
+  // swap.  Only one drain runs at a time.
+  static void drain(std::shared_ptr<SharedState> state);
+
+  // shared between the SwappableEventBase and the tasks running its
+  // callbacks, which may outlive it
+  const std::shared_ptr<SharedState> state_;
 };
 
 } // namespace rsocket
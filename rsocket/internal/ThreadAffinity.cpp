@@ -0,0 +1,164 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/ThreadAffinity.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <folly/Conv.h>
+#include <folly/FileUtil.h>
+#include <folly/String.h>
+#include <glog/logging.h>
+
+namespace rsocket {
+
+namespace {
+
+/// Parses a CPU list of the kernel, such as "0-3,8,10-11".
+std::vector<int> parseCpuList(folly::StringPiece list) {
+  std::vector<folly::StringPiece> ranges;
+  folly::split(',', folly::trimWhitespace(list), ranges, true);
+
+  std::vector<int> cpus;
+  for (auto range : ranges) {
+    folly::StringPiece first, last;
+    if (!folly::split('-', range, first, last)) {
+      first = last = range;
+    }
+    auto const from = folly::tryTo<int>(first);
+    auto const to = folly::tryTo<int>(last);
+    if (!from || !to) {
+      return {};
+    }
+    for (auto cpu = *from; cpu <= *to; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+#if defined(__linux__) && defined(SYS_mbind)
+/// MPOL_LOCAL of <numaif.h>, which isn't always installed.
+constexpr int kMpolLocal = 4;
+
+void unmapBuffer(void* data, void* size) {
+  ::munmap(data, reinterpret_cast<size_t>(size));
+}
+#endif
+
+} // namespace
+
+bool pinCurrentThreadToCpu(int cpu) {
+  return pinCurrentThreadToCpus({cpu});
+}
+
+bool pinCurrentThreadToCpus(const std::vector<int>& cpus) {
+  if (cpus.empty()) {
+    return true;
+  }
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  bool any = false;
+  for (auto cpu : cpus) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &set);
+      any = true;
+    }
+  }
+  return any &&
+      ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+#else
+  return false;
+#endif
+}
+
+void pinEventBaseThread(folly::EventBase& evb, const std::vector<int>& cpus) {
+  if (cpus.empty()) {
+    return;
+  }
+  evb.runInEventBaseThreadAndWait([&] {
+    if (!pinCurrentThreadToCpus(cpus)) {
+      LOG(WARNING) << "Cannot pin " << evb.getName() << " to CPUs "
+                   << folly::join(',', cpus);
+    }
+  });
+}
+
+std::vector<std::vector<int>> numaNodeCpus() {
+  std::vector<std::vector<int>> nodes;
+#ifdef __linux__
+  std::string list;
+  while (folly::readFile(
+      folly::to<std::string>(
+          "/sys/devices/system/node/node", nodes.size(), "/cpulist")
+          .c_str(),
+      list)) {
+    nodes.push_back(parseCpuList(list));
+  }
+#endif
+  return nodes;
+}
+
+std::vector<std::vector<int>> cpuSetsAcrossNumaNodes(size_t threads) {
+  std::vector<std::vector<int>> nodes;
+  for (auto& cpus : numaNodeCpus()) {
+    // Nodes with memory only have no CPUs.
+    if (!cpus.empty()) {
+      nodes.push_back(std::move(cpus));
+    }
+  }
+  if (nodes.empty()) {
+    return {};
+  }
+
+  std::vector<std::vector<int>> sets;
+  sets.reserve(threads);
+  for (size_t i = 0; i < threads; ++i) {
+    sets.push_back(nodes[i % nodes.size()]);
+  }
+  return sets;
+}
+
+std::unique_ptr<folly::IOBuf> createNumaLocalBuffer(size_t capacity) {
+#if defined(__linux__) && defined(SYS_mbind)
+  auto const page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+  auto const size = (capacity + page - 1) / page * page;
+  auto const data = ::mmap(
+      nullptr,
+      size,
+      PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS,
+      -1,
+      0);
+  if (data != MAP_FAILED) {
+    // Nothing is allocated until the first write, which then takes memory
+    // from the node of the writer.  Failing leaves the process default.
+    ::syscall(SYS_mbind, data, size, kMpolLocal, nullptr, 0, 0);
+    auto buffer = folly::IOBuf::takeOwnership(
+        data, size, unmapBuffer, reinterpret_cast<void*>(size));
+    buffer->trimEnd(buffer->length());
+    return buffer;
+  }
+#endif
+  return folly::IOBuf::create(capacity);
+}
+
+} // namespace rsocket
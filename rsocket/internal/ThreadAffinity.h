@@ -0,0 +1,55 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/io/IOBuf.h>
+#include <folly/io/async/EventBase.h>
+
+#include <memory>
+#include <vector>
+
+namespace rsocket {
+
+/// Pins the calling thread to `cpu`.  Returns false, leaving the thread as it
+/// is, if the platform doesn't support it or the CPU is not available.
+bool pinCurrentThreadToCpu(int cpu);
+
+/// Pins the calling thread to a set of CPUs, which it may then move between.
+/// Returns false, leaving the thread as it is, if the platform doesn't
+/// support it or none of the CPUs is available.  An empty set is a no-op.
+bool pinCurrentThreadToCpus(const std::vector<int>& cpus);
+
+/// Pins the thread running `evb` to a set of CPUs, waiting until it is done.
+/// Logs a warning if it fails.
+void pinEventBaseThread(folly::EventBase& evb, const std::vector<int>& cpus);
+
+/// CPUs of every NUMA node of the machine, indexed by node.  Empty if the
+/// platform doesn't tell.
+std::vector<std::vector<int>> numaNodeCpus();
+
+/// Spreads `threads` threads over the NUMA nodes of the machine, the i-th
+/// thread on all the CPUs of node `i % nodes`, so that every node holds the
+/// same share of them.  Empty, i.e. no pinning, when there are no NUMA nodes
+/// to go by.
+std::vector<std::vector<int>> cpuSetsAcrossNumaNodes(size_t threads);
+
+/// An empty buffer of at least `capacity` bytes, whose memory comes from the
+/// NUMA node of the thread that first writes to it, even when the process
+/// default is to interleave memory across the nodes.  Costs an mmap() and
+/// munmap(), so it suits buffers that are large and long-lived.  Falls back
+/// on a regular IOBuf where the platform doesn't support it.
+std::unique_ptr<folly::IOBuf> createNumaLocalBuffer(size_t capacity);
+
+} // namespace rsocket
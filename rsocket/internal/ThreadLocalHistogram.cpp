@@ -0,0 +1,103 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/ThreadLocalHistogram.h"
+
+#include <folly/Bits.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace rsocket {
+
+uint64_t ThreadLocalHistogram::Snapshot::percentile(double fraction) const {
+  if (count == 0) {
+    return 0;
+  }
+  auto const rank = std::max<uint64_t>(
+      1, static_cast<uint64_t>(std::ceil(fraction * count)));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBuckets; ++i) {
+    seen += buckets[i];
+    if (seen >= rank) {
+      return std::min(upperBoundOf(i), max);
+    }
+  }
+  return max;
+}
+
+ThreadLocalHistogram::Snapshot& ThreadLocalHistogram::Snapshot::operator+=(
+    const Snapshot& other) {
+  count += other.count;
+  sum += other.sum;
+  max = std::max(max, other.max);
+  for (size_t i = 0; i < kBuckets; ++i) {
+    buckets[i] += other.buckets[i];
+  }
+  return *this;
+}
+
+ThreadLocalHistogram::ThreadLocalHistogram()
+    : local_([this] { return new Local(this); }) {}
+
+ThreadLocalHistogram::Local::~Local() {
+  Snapshot snapshot;
+  addTo(snapshot);
+  std::lock_guard<std::mutex> lock(parent_->retiredMutex_);
+  parent_->retired_ += snapshot;
+}
+
+void ThreadLocalHistogram::Local::addTo(Snapshot& snapshot) const {
+  snapshot.count += count_.load(std::memory_order_relaxed);
+  snapshot.sum += sum_.load(std::memory_order_relaxed);
+  snapshot.max = std::max(snapshot.max, max_.load(std::memory_order_relaxed));
+  for (size_t i = 0; i < kBuckets; ++i) {
+    snapshot.buckets[i] += buckets_[i].load(std::memory_order_relaxed);
+  }
+}
+
+ThreadLocalHistogram::Snapshot ThreadLocalHistogram::snapshot() const {
+  Snapshot snapshot;
+  {
+    std::lock_guard<std::mutex> lock(retiredMutex_);
+    snapshot = retired_;
+  }
+  for (const auto& local : local_.accessAllThreads()) {
+    local.addTo(snapshot);
+  }
+  return snapshot;
+}
+
+size_t ThreadLocalHistogram::bucketOf(uint64_t value) {
+  if (value < 4) {
+    return value;
+  }
+  // Index of the highest bit, at least 2.
+  size_t const exponent = folly::findLastSet(value) - 1;
+  size_t const step = (value >> (exponent - 2)) & 3;
+  return 4 * (exponent - 1) + step;
+}
+
+uint64_t ThreadLocalHistogram::upperBoundOf(size_t bucket) {
+  if (bucket < 4) {
+    return bucket;
+  }
+  size_t const exponent = bucket / 4 + 1;
+  uint64_t const step = bucket % 4;
+  uint64_t const lower = (4 + step) << (exponent - 2);
+  uint64_t const width = uint64_t(1) << (exponent - 2);
+  return lower + (width - 1);
+}
+
+} // namespace rsocket
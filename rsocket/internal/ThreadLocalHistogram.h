@@ -0,0 +1,114 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/ThreadLocal.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+namespace rsocket {
+
+/// A histogram of non-negative values, e.g. latencies in microseconds, that
+/// many threads record into without contending with each other.
+///
+/// Every thread records into buckets of its own, with plain relaxed stores
+/// rather than atomic read-modify-writes, and snapshot() sums the buckets of
+/// all threads when asked.  The counts of threads that exit are folded into
+/// the histogram, so they are not lost.
+///
+/// Buckets are logarithmic with four linear steps per power of two, so a
+/// value is placed within 25% of itself.
+class ThreadLocalHistogram {
+ public:
+  /// Values below 4 have a bucket each, then every power of two has four.
+  static constexpr size_t kBuckets = 4 * 63;
+
+  struct Snapshot {
+    uint64_t count{0};
+    uint64_t sum{0};
+    uint64_t max{0};
+    std::array<uint64_t, kBuckets> buckets{};
+
+    /// A value that `fraction` of the recorded values are at most, rounded up
+    /// to the bound of its bucket.  Zero if nothing was recorded.
+    uint64_t percentile(double fraction) const;
+
+    double mean() const {
+      return count == 0 ? 0 : static_cast<double>(sum) / count;
+    }
+
+    Snapshot& operator+=(const Snapshot&);
+  };
+
+  ThreadLocalHistogram();
+
+  void record(uint64_t value) {
+    local_->record(value);
+  }
+
+  /// Sums the values recorded by all threads so far.
+  Snapshot snapshot() const;
+
+  /// The bucket a value is counted in, and the largest value counted in a
+  /// bucket.
+  static size_t bucketOf(uint64_t value);
+  static uint64_t upperBoundOf(size_t bucket);
+
+ private:
+  struct Tag {};
+
+  /// The buckets of one thread.  Written by that thread only, read by any.
+  class Local {
+   public:
+    explicit Local(ThreadLocalHistogram* parent) : parent_(parent) {}
+    ~Local();
+
+    void record(uint64_t value) {
+      bump(buckets_[bucketOf(value)], 1);
+      bump(count_, 1);
+      bump(sum_, value);
+      if (value > max_.load(std::memory_order_relaxed)) {
+        max_.store(value, std::memory_order_relaxed);
+      }
+    }
+
+    void addTo(Snapshot& snapshot) const;
+
+   private:
+    static void bump(std::atomic<uint64_t>& counter, uint64_t by) {
+      counter.store(
+          counter.load(std::memory_order_relaxed) + by,
+          std::memory_order_relaxed);
+    }
+
+    ThreadLocalHistogram* const parent_;
+    std::array<std::atomic<uint64_t>, kBuckets> buckets_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+  };
+
+  /// Counts of the threads that exited.  Declared ahead of `local_` so that
+  /// it outlives the Local instances folding into it.
+  mutable std::mutex retiredMutex_;
+  Snapshot retired_;
+
+  folly::ThreadLocal<Local, Tag> local_;
+};
+
+} // namespace rsocket
@@ -15,11 +15,15 @@
 #include "rsocket/internal/WarmResumeManager.h"
 
 #include <algorithm>
+#include <limits>
 
 namespace rsocket {
 
 WarmResumeManager::~WarmResumeManager() {
   clearFrames(lastSentPosition_);
+  if (budget_) {
+    budget_->close(*this);
+  }
 }
 
 void WarmResumeManager::trackReceivedFrame(
@@ -40,24 +44,31 @@ void WarmResumeManager::trackSentFrame(
     StreamId,
     size_t consumerAllowance) {
   if (shouldTrackFrame(frameType)) {
-    // TODO(tmont): this could be expensive, find a better way to get length
-    const auto frameDataLength = serializedFrame.computeChainDataLength();
-
     VLOG(6) << "Track sent frame " << frameType
             << " Allowance: " << consumerAllowance;
-    // If the frame is too huge, we don't cache it.
-    // We empty the entire cache instead.
-    if (frameDataLength > capacity_) {
-      resetUpToPosition(lastSentPosition_);
-      lastSentPosition_ += frameDataLength;
-      firstSentPosition_ += frameDataLength;
-      DCHECK(firstSentPosition_ == lastSentPosition_);
-      DCHECK(size_ == 0);
-      return;
-    }
+    appendFrame(serializedFrame);
+  }
+}
+
+void WarmResumeManager::appendFrame(const folly::IOBuf& serializedFrame) {
+  // TODO(tmont): this could be expensive, find a better way to get length
+  const auto frameDataLength = serializedFrame.computeChainDataLength();
 
-    addFrame(serializedFrame, frameDataLength);
+  // If the frame is too huge, we don't cache it.
+  // We empty the entire cache instead.
+  if (frameDataLength > capacity()) {
+    resetUpToPosition(lastSentPosition_);
     lastSentPosition_ += frameDataLength;
+    firstSentPosition_ += frameDataLength;
+    DCHECK(firstSentPosition_ == lastSentPosition_);
+    DCHECK(size_ == 0);
+    return;
+  }
+
+  addFrame(serializedFrame, frameDataLength);
+  lastSentPosition_ += frameDataLength;
+  if (budget_) {
+    budget_->charge(*this, frameDataLength);
   }
 }
 
@@ -77,28 +88,58 @@ void WarmResumeManager::resetUpToPosition(ResumePosition position) {
 }
 
 bool WarmResumeManager::isPositionAvailable(ResumePosition position) const {
-  return (lastSentPosition_ == position) ||
-      std::binary_search(
-             frames_.begin(),
-             frames_.end(),
-             std::make_pair(position, std::unique_ptr<folly::IOBuf>()),
-             [](decltype(frames_.back()) pairA,
-                decltype(frames_.back()) pairB) {
-               return pairA.first < pairB.first;
-             });
+  if (lastSentPosition_ == position) {
+    return true;
+  }
+  const auto found = std::lower_bound(
+      frames_.begin(),
+      frames_.end(),
+      position,
+      [](decltype(frames_.back()) pair, ResumePosition pos) {
+        return pair.first < pos;
+      });
+  return found != frames_.end() && found->first == position;
 }
 
 void WarmResumeManager::addFrame(
     const folly::IOBuf& frame,
     size_t frameDataLength) {
   size_ += frameDataLength;
-  while (size_ > capacity_) {
+  auto const capacity = this->capacity();
+  while (size_ > capacity) {
     evictFrame();
   }
-  frames_.emplace_back(lastSentPosition_, frame.clone());
+  frames_.emplace_back(lastSentPosition_, frame.cloneAsValue());
+  compaction_.compact(frames_.back().second);
   stats_->resumeBufferChanged(1, static_cast<int>(frameDataLength));
 }
 
+void WarmResumeManager::restore(
+    ResumePosition firstSentPosition,
+    ResumePosition impliedPosition,
+    const std::vector<std::unique_ptr<folly::IOBuf>>& frames) {
+  CHECK(frames_.empty() && lastSentPosition_ == 0 && impliedPosition_ == 0);
+  firstSentPosition_ = lastSentPosition_ = firstSentPosition;
+  impliedPosition_ = impliedPosition;
+  for (const auto& frame : frames) {
+    appendFrame(*frame);
+  }
+}
+
+void WarmResumeManager::trimForBudget() {
+  int frames = 0;
+  size_t bytes = 0;
+  while (!frames_.empty() && budget_->trimRequested(*this) > 0) {
+    auto const before = size_;
+    evictFrame();
+    ++frames;
+    bytes += before - size_;
+  }
+  if (frames > 0) {
+    stats_->resumeBufferEvictedForBudget(frames, static_cast<int>(bytes));
+  }
+}
+
 void WarmResumeManager::evictFrame() {
   DCHECK(!frames_.empty());
 
@@ -128,17 +169,29 @@ void WarmResumeManager::clearFrames(ResumePosition position) {
       -static_cast<int>(pos - firstSentPosition_));
 
   frames_.erase(frames_.begin(), end);
-  size_ -= static_cast<decltype(size_)>(pos - firstSentPosition_);
+  const auto cleared = static_cast<decltype(size_)>(pos - firstSentPosition_);
+  size_ -= cleared;
+  if (budget_) {
+    budget_->release(*this, cleared);
+  }
 }
 
 void WarmResumeManager::sendFramesFromPosition(
     ResumePosition position,
     FrameTransport& frameTransport) const {
+  sendFramesFromPositionUpTo(
+      position, frameTransport, std::numeric_limits<size_t>::max());
+}
+
+ResumePosition WarmResumeManager::sendFramesFromPositionUpTo(
+    ResumePosition position,
+    FrameTransport& frameTransport,
+    size_t maxBytes) const {
   DCHECK(isPositionAvailable(position));
 
   if (position == lastSentPosition_) {
     // idle resumption
-    return;
+    return position;
   }
 
   auto found = std::lower_bound(
@@ -152,10 +205,16 @@ void WarmResumeManager::sendFramesFromPosition(
   DCHECK(found != frames_.end());
   DCHECK(found->first == position);
 
-  while (found != frames_.end()) {
-    frameTransport.outputFrameOrDrop(found->second->clone());
-    found++;
-  }
+  size_t sent = 0;
+  do {
+    const auto next = std::next(found);
+    const auto end = next != frames_.end() ? next->first : lastSentPosition_;
+    frameTransport.outputFrameOrDrop(found->second.clone());
+    sent += static_cast<size_t>(end - found->first);
+    found = next;
+  } while (found != frames_.end() && sent < maxBytes);
+
+  return found != frames_.end() ? found->first : lastSentPosition_;
 }
 
 std::shared_ptr<ResumeManager> ResumeManager::makeEmpty() {
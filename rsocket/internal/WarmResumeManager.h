@@ -14,28 +14,40 @@
 
 #pragma once
 
+#include <algorithm>
 #include <deque>
+#include <vector>
 
+#include <folly/io/IOBuf.h>
 #include <folly/lang/Assume.h>
 
 #include "rsocket/RSocketStats.h"
 #include "rsocket/ResumeManager.h"
-
-namespace folly {
-class IOBuf;
-}
+#include "rsocket/internal/BufferCompaction.h"
+#include "rsocket/internal/MemoryPressureController.h"
+#include "rsocket/internal/ResumeBufferBudget.h"
 
 namespace rsocket {
 
 class RSocketStateMachine;
 class FrameTransport;
 
-class WarmResumeManager : public ResumeManager {
+class WarmResumeManager
+    : public ResumeManager,
+      public std::enable_shared_from_this<WarmResumeManager> {
  public:
+  constexpr static size_t DEFAULT_CAPACITY = 1024 * 1024; // 1MB
+
+  /// With a budget, the frames buffered also count towards it, and may be
+  /// dropped to keep it within its limit.  The manager must then be owned by
+  /// a shared_ptr.
   explicit WarmResumeManager(
       std::shared_ptr<RSocketStats> stats,
-      size_t capacity = DEFAULT_CAPACITY)
-      : stats_(std::move(stats)), capacity_(capacity) {}
+      size_t capacity = DEFAULT_CAPACITY,
+      std::shared_ptr<ResumeBufferBudget> budget = nullptr)
+      : stats_(std::move(stats)),
+        capacity_(capacity),
+        budget_(std::move(budget)) {}
   ~WarmResumeManager();
 
   void trackReceivedFrame(
@@ -58,6 +70,11 @@ class WarmResumeManager : public ResumeManager {
       ResumePosition position,
       FrameTransport& transport) const override;
 
+  ResumePosition sendFramesFromPositionUpTo(
+      ResumePosition position,
+      FrameTransport& transport,
+      size_t maxBytes) const override;
+
   ResumePosition firstSentPosition() const override {
     return firstSentPosition_;
   }
@@ -91,10 +108,48 @@ class WarmResumeManager : public ResumeManager {
     return size_;
   }
 
+  size_t bufferedBytes() const override {
+    return size_;
+  }
+
+  /// Restores the positions and the frames of a session that was on another
+  /// server, see ResumeHandoffState.  The manager must be empty.
+  void restore(
+      ResumePosition firstSentPosition,
+      ResumePosition impliedPosition,
+      const std::vector<std::unique_ptr<folly::IOBuf>>& frames);
+
+  /// Thresholds past which the frames buffered are copied into buffers of
+  /// their own, rather than pinning the buffers they were read into.
+  void setBufferCompaction(BufferCompaction compaction) {
+    compaction_ = compaction;
+  }
+
+  /// Caps the frames buffered at MemoryPressureController::
+  /// maxResumeBufferBytes(), when below the capacity.  The cap applies as
+  /// frames are buffered.
+  void setMemoryPressure(
+      std::shared_ptr<const MemoryPressureController> controller) {
+    memoryPressure_ = std::move(controller);
+  }
+
+  /// Drops the oldest frames until the budget no longer asks for it.  Called
+  /// by the budget, on the EventBase of the connection.
+  void trimForBudget();
+
  protected:
+  /// Buffers a frame sent at lastSentPosition_.
+  void appendFrame(const folly::IOBuf&);
   void addFrame(const folly::IOBuf&, size_t);
   void evictFrame();
 
+  /// The capacity, lowered under memory pressure.
+  size_t capacity() const {
+    return memoryPressure_
+        ? std::min(capacity_, memoryPressure_->maxResumeBufferBytes())
+        : capacity_;
+  }
+
   // Called before clearing cached frames to update stats.
   void clearFrames(ResumePosition position);
 
@@ -107,10 +162,18 @@ class WarmResumeManager : public ResumeManager {
   // Inferred position of the rcvd frames
   ResumePosition impliedPosition_{0};
 
-  std::deque<std::pair<ResumePosition, std::unique_ptr<folly::IOBuf>>> frames_;
+  // Frames are kept as IOBuf values sharing the buffers of the frames that
+  // were written, so tracking a frame doesn't allocate the head of its chain.
+  // They are only materialized into new chains on replay.  Frames past the
+  // compaction thresholds are copied instead.
+  std::deque<std::pair<ResumePosition, folly::IOBuf>> frames_;
+  BufferCompaction compaction_;
 
-  constexpr static size_t DEFAULT_CAPACITY = 1024 * 1024; // 1MB
   const size_t capacity_;
   size_t size_{0};
+
+  const std::shared_ptr<ResumeBufferBudget> budget_;
+
+  std::shared_ptr<const MemoryPressureController> memoryPressure_;
 };
 } // namespace rsocket
@@ -28,12 +28,16 @@ void ChannelRequester::onSubscribe(
 
 void ChannelRequester::onNext(Payload request) {
   if (!requested_) {
+    // The initial payload goes with REQUEST_CHANNEL and costs no byte credit.
     initStream(std::move(request));
+    payloadPublished(0);
     return;
   }
 
   if (!publisherClosed()) {
+    auto const cost = byteCost(request);
     writePayload(std::move(request));
+    payloadPublished(cost);
   }
 }
 
@@ -108,6 +112,10 @@ void ChannelRequester::handleRequestN(uint32_t n) {
   PublisherBase::processRequestN(n);
 }
 
+void ChannelRequester::handleByteCredit(uint32_t bytes) {
+  PublisherBase::processByteCredit(bytes);
+}
+
 void ChannelRequester::handleError(folly::exception_wrapper ew) {
   CHECK(requested_);
   errorConsumer(std::move(ew));
@@ -120,6 +128,16 @@ void ChannelRequester::handleCancel() {
   tryCompleteChannel();
 }
 
+void ChannelRequester::handleOutputPaused(bool paused) {
+  setPublisherPaused(paused);
+}
+
+void ChannelRequester::describeFlowControl(
+    StreamFlowControl& flowControl) const {
+  ConsumerBase::describeFlowControl(flowControl);
+  describePublisher(flowControl, payloadsSent());
+}
+
 void ChannelRequester::endStream(StreamCompletionSignal signal) {
   terminatePublisher();
   ConsumerBase::endStream(signal);
@@ -128,7 +146,7 @@ void ChannelRequester::endStream(StreamCompletionSignal signal) {
 void ChannelRequester::initStream(Payload&& request) {
   requested_ = true;
 
-  const size_t initialN = initialResponseAllowance_.consumeUpTo(kMaxRequestN);
+  const size_t initialN = initialResponseAllowance_.consumeUpTo(maxRequestN());
   const size_t remainingN = initialResponseAllowance_.consumeAll();
 
   // Send as much as possible with the initial request.
@@ -31,13 +31,13 @@ class ChannelRequester : public ConsumerBase,
       std::shared_ptr<StreamsWriter> writer,
       StreamId streamId)
       : ConsumerBase(std::move(writer), streamId),
-        PublisherBase(0 /*initialRequestN*/),
+        PublisherBase(0 /*initialRequestN*/, initialByteCredit()),
         request_(std::move(request)),
         hasInitialRequest_(true) {}
 
   ChannelRequester(std::shared_ptr<StreamsWriter> writer, StreamId streamId)
       : ConsumerBase(std::move(writer), streamId),
-        PublisherBase(1 /*initialRequestN*/) {}
+        PublisherBase(1 /*initialRequestN*/, initialByteCredit()) {}
 
   void onSubscribe(std::shared_ptr<yarpl::flowable::Subscription>) override;
   void onNext(Payload) override;
@@ -53,8 +53,11 @@ class ChannelRequester : public ConsumerBase,
       bool flagsNext,
       bool flagsFollows) override;
   void handleRequestN(uint32_t) override;
+  void handleByteCredit(uint32_t) override;
   void handleError(folly::exception_wrapper) override;
   void handleCancel() override;
+  void handleOutputPaused(bool) override;
+  void describeFlowControl(StreamFlowControl&) const override;
 
   void endStream(StreamCompletionSignal) override;
 
@@ -23,7 +23,9 @@ void ChannelResponder::onSubscribe(
 
 void ChannelResponder::onNext(Payload response) {
   if (!publisherClosed()) {
+    auto const cost = byteCost(response);
     writePayload(std::move(response));
+    payloadPublished(cost);
   }
 }
 
@@ -70,11 +72,17 @@ void ChannelResponder::handlePayload(
     return;
   }
 
+  auto consumed = payloadFragments_.consumePayloadAndFlags();
+  if (!consumed) {
+    handleMalformedPayload();
+    return;
+  }
+
   bool finalFlagsComplete, finalFlagsNext;
   Payload finalPayload;
 
   std::tie(finalPayload, finalFlagsNext, finalFlagsComplete) =
-      payloadFragments_.consumePayloadAndFlags();
+      std::move(consumed.value());
 
   if (newStream_) {
     newStream_ = false;
@@ -97,6 +105,10 @@ void ChannelResponder::handleRequestN(uint32_t n) {
   processRequestN(n);
 }
 
+void ChannelResponder::handleByteCredit(uint32_t bytes) {
+  processByteCredit(bytes);
+}
+
 void ChannelResponder::handleError(folly::exception_wrapper ew) {
   errorConsumer(std::move(ew));
   terminatePublisher();
@@ -107,6 +119,16 @@ void ChannelResponder::handleCancel() {
   tryCompleteChannel();
 }
 
+void ChannelResponder::handleOutputPaused(bool paused) {
+  setPublisherPaused(paused);
+}
+
+void ChannelResponder::describeFlowControl(
+    StreamFlowControl& flowControl) const {
+  ConsumerBase::describeFlowControl(flowControl);
+  describePublisher(flowControl, payloadsSent());
+}
+
 void ChannelResponder::endStream(StreamCompletionSignal signal) {
   terminatePublisher();
   ConsumerBase::endStream(signal);
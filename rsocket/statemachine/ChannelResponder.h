@@ -30,7 +30,7 @@ class ChannelResponder : public ConsumerBase,
       StreamId streamId,
       uint32_t initialRequestN)
       : ConsumerBase(std::move(writer), streamId),
-        PublisherBase(initialRequestN) {}
+        PublisherBase(initialRequestN, initialByteCredit()) {}
 
   void onSubscribe(std::shared_ptr<yarpl::flowable::Subscription>) override;
   void onNext(Payload) override;
@@ -47,8 +47,11 @@ class ChannelResponder : public ConsumerBase,
       bool flagsFollows) override;
 
   void handleRequestN(uint32_t) override;
+  void handleByteCredit(uint32_t) override;
   void handleError(folly::exception_wrapper) override;
   void handleCancel() override;
+  void handleOutputPaused(bool) override;
+  void describeFlowControl(StreamFlowControl&) const override;
 
   void endStream(StreamCompletionSignal) override;
 
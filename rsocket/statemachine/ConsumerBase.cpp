@@ -16,10 +16,27 @@
 
 #include <algorithm>
 
+#include <folly/io/async/EventBaseManager.h>
 #include <glog/logging.h>
 
+#include "rsocket/internal/ByteCredit.h"
+
 namespace rsocket {
 
+ConsumerBase::ConsumerBase(
+    std::shared_ptr<StreamsWriter> writer,
+    StreamId streamId)
+    : StreamStateMachineBase(std::move(writer), streamId),
+      byteCredit_(initialByteCredit()),
+      byteWindow_(initialByteCredit()) {
+  if (writer_) {
+    requestNOptions_ = writer_->requestNOptions();
+  }
+  if (requestNOptions_.adaptiveWindow) {
+    window_.emplace(*requestNOptions_.adaptiveWindow);
+  }
+}
+
 void ConsumerBase::subscribe(
     std::shared_ptr<yarpl::flowable::Subscriber<Payload>> subscriber) {
   if (state_ == State::CLOSED) {
@@ -40,11 +57,24 @@ void ConsumerBase::cancelConsumer() {
 }
 
 void ConsumerBase::addImplicitAllowance(size_t n) {
+  if (unbounded_) {
+    return;
+  }
+  if (n >= static_cast<size_t>(kMaxRequestN)) {
+    setUnbounded();
+    return;
+  }
   allowance_.add(n);
   activeRequests_.add(n);
+  if (window_) {
+    window_->onRequestSent(n);
+  }
 }
 
 void ConsumerBase::generateRequest(size_t n) {
+  if (unbounded_) {
+    return;
+  }
   allowance_.add(n);
   pendingAllowance_.add(n);
   sendRequests();
@@ -69,25 +99,51 @@ size_t ConsumerBase::getConsumerAllowance() const {
   return allowance_.get();
 }
 
+void ConsumerBase::describeFlowControl(StreamFlowControl& flowControl) const {
+  StreamStateMachineBase::describeFlowControl(flowControl);
+  flowControl.consumer = true;
+  flowControl.consumerAllowance = allowance_.get();
+  flowControl.consumerPendingAllowance = pendingAllowance_.get();
+  flowControl.consumerByteCredit = byteCredit_.get();
+}
+
 void ConsumerBase::processPayload(Payload&& payload, bool onNext) {
   if (!payload && !onNext) {
     return;
   }
 
   // Frames carrying application-level payloads are taken into account when
-  // figuring out flow control allowance.
-  if (!allowance_.tryConsume(1) || !activeRequests_.tryConsume(1)) {
-    handleFlowControlError();
-    return;
+  // figuring out flow control allowance, unless the demand is unbounded.
+  if (!unbounded_) {
+    if (!allowance_.tryConsume(1) || !activeRequests_.tryConsume(1)) {
+      handleFlowControlError();
+      return;
+    }
+    if (window_) {
+      window_->onPayload();
+    }
   }
 
-  sendRequests();
+  if (byteWindow_ > 0) {
+    byteCredit_.consumeUpTo(ByteCredit::lengthOf(payload));
+  }
+
+  payloadReceived(payload);
+  if (!unbounded_) {
+    sendRequests();
+  }
   if (consumingSubscriber_) {
+    HandlerTimer timer{*this};
     consumingSubscriber_->onNext(std::move(payload));
   } else {
     LOG(ERROR) << "Consuming subscriber is missing, might be a race on "
                << "cancel/onNext";
   }
+
+  // The subscriber is done with the payload, its bytes can be granted back.
+  if (byteWindow_ > 0 && !consumerClosed()) {
+    grantByteCredit();
+  }
 }
 
 bool ConsumerBase::processFragmentedPayload(
@@ -102,11 +158,17 @@ bool ConsumerBase::processFragmentedPayload(
     return false;
   }
 
+  auto consumed = payloadFragments_.consumePayloadAndFlags();
+  if (!consumed) {
+    handleMalformedPayload();
+    return false;
+  }
+
   bool finalFlagsComplete, finalFlagsNext;
   Payload finalPayload;
 
   std::tie(finalPayload, finalFlagsNext, finalFlagsComplete) =
-      payloadFragments_.consumePayloadAndFlags();
+      std::move(consumed.value());
   processPayload(std::move(finalPayload), finalFlagsNext);
   return finalFlagsComplete;
 }
@@ -128,15 +190,102 @@ void ConsumerBase::errorConsumer(folly::exception_wrapper ew) {
 }
 
 void ConsumerBase::sendRequests() {
+  if (!requestNOptions_.deferToLoopEnd) {
+    flushRequests();
+    return;
+  }
+
+  if (requestsScheduled_ || pendingAllowance_.get() == 0) {
+    return;
+  }
+
+  auto const eventBase = folly::EventBaseManager::get()->getExistingEventBase();
+  if (!eventBase) {
+    flushRequests();
+    return;
+  }
+
+  requestsScheduled_ = true;
+  eventBase->runInLoop(
+      [weakThis = std::weak_ptr<ConsumerBase>(shared_from_this())] {
+        if (auto self = weakThis.lock()) {
+          self->requestsScheduled_ = false;
+          if (!self->consumerClosed()) {
+            self->flushRequests();
+          }
+        }
+      });
+}
+
+size_t ConsumerBase::maxRequestN() const {
+  auto const limit = std::min<size_t>(requestNLimit(), kMaxRequestN);
+  if (window_) {
+    return std::min<size_t>(window_->size(), limit);
+  }
+  return limit;
+}
+
+void ConsumerBase::flushRequests() {
+  if (unbounded_) {
+    return;
+  }
+  auto const outstanding = activeRequests_.get();
   auto toSync = std::min<size_t>(pendingAllowance_.get(), kMaxRequestN);
-  auto actives = activeRequests_.get();
-  if (actives <= toSync) {
-    toSync = pendingAllowance_.consumeUpTo(toSync);
-    if (toSync > 0) {
-      writeRequestN(static_cast<uint32_t>(toSync));
-      activeRequests_.add(toSync);
-    }
+  if (window_) {
+    auto const window = window_->size();
+    toSync = outstanding < window ? std::min(toSync, window - outstanding) : 0;
+  }
+  // The rest of the allowance stays pending until payloads free up credit.
+  auto const limit = requestNLimit();
+  if (limit < static_cast<size_t>(kMaxRequestN)) {
+    toSync = outstanding < limit ? std::min(toSync, limit - outstanding) : 0;
+  }
+  if (toSync == 0 || !shouldFlushRequests(toSync, outstanding)) {
+    return;
+  }
+  toSync = pendingAllowance_.consumeUpTo(toSync);
+  writeRequestN(static_cast<uint32_t>(toSync));
+  if (toSync >= static_cast<size_t>(kMaxRequestN)) {
+    setUnbounded();
+    return;
+  }
+  activeRequests_.add(toSync);
+  if (window_) {
+    window_->onRequestSent(toSync);
+  }
+}
+
+bool ConsumerBase::shouldFlushRequests(size_t pending, size_t outstanding)
+    const {
+  if (window_) {
+    return outstanding <= window_->size() / 2;
+  }
+  if (requestNOptions_.highWatermark > 0 &&
+      pending >= requestNOptions_.highWatermark) {
+    return true;
   }
+  if (requestNOptions_.lowWatermark) {
+    return outstanding <= *requestNOptions_.lowWatermark;
+  }
+  return outstanding <= pending;
+}
+
+void ConsumerBase::grantByteCredit() {
+  if (byteCredit_.get() > byteWindow_ / 2) {
+    return;
+  }
+  auto const bytes = std::min<size_t>(
+      byteWindow_ - byteCredit_.get(), ByteCredit::kMaxGrant);
+  byteCredit_.add(bytes);
+  writeByteCredit(static_cast<uint32_t>(bytes));
+}
+
+void ConsumerBase::setUnbounded() {
+  VLOG(5) << "ConsumerBase::setUnbounded()";
+  unbounded_ = true;
+  allowance_.add(Allowance::max());
+  pendingAllowance_.consumeAll();
+  activeRequests_.add(Allowance::max());
 }
 
 void ConsumerBase::handleFlowControlError() {
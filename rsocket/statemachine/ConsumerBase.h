@@ -16,6 +16,7 @@
 
 #include "rsocket/Payload.h"
 #include "rsocket/internal/Allowance.h"
+#include "rsocket/internal/RequestNWindow.h"
 #include "rsocket/statemachine/StreamStateMachineBase.h"
 #include "yarpl/flowable/Subscriber.h"
 #include "yarpl/flowable/Subscription.h"
@@ -27,7 +28,7 @@ class ConsumerBase : public StreamStateMachineBase,
                      public yarpl::flowable::Subscription,
                      public std::enable_shared_from_this<ConsumerBase> {
  public:
-  using StreamStateMachineBase::StreamStateMachineBase;
+  ConsumerBase(std::shared_ptr<StreamsWriter> writer, StreamId streamId);
 
   void subscribe(std::shared_ptr<yarpl::flowable::Subscriber<Payload>>);
 
@@ -44,6 +45,7 @@ class ConsumerBase : public StreamStateMachineBase,
   }
 
   size_t getConsumerAllowance() const override;
+  void describeFlowControl(StreamFlowControl&) const override;
   void endStream(StreamCompletionSignal) override;
 
  protected:
@@ -53,6 +55,10 @@ class ConsumerBase : public StreamStateMachineBase,
   bool
   processFragmentedPayload(Payload&&, bool next, bool complete, bool follows);
 
+  /// Largest allowance that may be sent to the peer at once, e.g. with the
+  /// initial request.
+  size_t maxRequestN() const;
+
   void cancelConsumer();
   void completeConsumer();
   void errorConsumer(folly::exception_wrapper);
@@ -63,10 +69,22 @@ class ConsumerBase : public StreamStateMachineBase,
     CLOSED,
   };
 
+  /// Sends the pending allowance now, or schedules it, as decided by
+  /// requestNOptions_.
   void sendRequests();
+  void flushRequests();
+  bool shouldFlushRequests(size_t pending, size_t outstanding) const;
 
   void handleFlowControlError();
 
+  /// Called once kMaxRequestN was requested from the peer, which the peer
+  /// takes as unbounded demand.  From then on payloads are not counted
+  /// against the allowance and no more REQUEST_N frames are sent.
+  void setUnbounded();
+
+  /// Grants the peer more byte credit once it has used up half of it.
+  void grantByteCredit();
+
   /// A Subscriber that will consume payloads.  This is responsible for
   /// delivering a terminal signal to the Subscriber once the stream ends.
   std::shared_ptr<yarpl::flowable::Subscriber<Payload>> consumingSubscriber_;
@@ -81,7 +99,24 @@ class ConsumerBase : public StreamStateMachineBase,
   /// calls.
   Allowance activeRequests_;
 
+  RequestNOptions requestNOptions_;
+
+  /// Set if requestNOptions_ asks for an adaptive window.
+  folly::Optional<RequestNWindow> window_;
+
+  /// With byte-based flow control, the bytes the peer may still send, and
+  /// the most it may send before hearing back from the consumer.  See
+  /// ByteCredit.
+  Allowance byteCredit_;
+  const size_t byteWindow_;
+
   State state_{State::RESPONDING};
+
+  /// Whether flushRequests() is scheduled for the end of the loop iteration.
+  bool requestsScheduled_{false};
+
+  /// Whether the demand of the subscriber is unbounded, see setUnbounded().
+  bool unbounded_{false};
 };
 
 } // namespace rsocket
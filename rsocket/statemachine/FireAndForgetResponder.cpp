@@ -30,7 +30,12 @@ void FireAndForgetResponder::handlePayload(
     return;
   }
 
-  Payload finalPayload = payloadFragments_.consumePayloadIgnoreFlags();
+  auto consumed = payloadFragments_.consumePayloadIgnoreFlags();
+  if (!consumed) {
+    handleMalformedPayload();
+    return;
+  }
+  Payload finalPayload = std::move(consumed.value());
   onNewStreamReady(
       StreamType::FNF,
       std::move(finalPayload),
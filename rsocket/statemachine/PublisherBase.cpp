@@ -14,12 +14,25 @@
 
 #include "rsocket/statemachine/PublisherBase.h"
 
+#include <folly/tracing/StaticTracepoint.h>
 #include <glog/logging.h>
 
+#include <algorithm>
+
+#include "rsocket/internal/ByteCredit.h"
+#include "rsocket/internal/Common.h"
+#include "yarpl/utils/credits.h"
+
 namespace rsocket {
 
-PublisherBase::PublisherBase(uint32_t initialRequestN)
-    : initialRequestN_(initialRequestN) {}
+PublisherBase::PublisherBase(
+    uint32_t initialRequestN,
+    size_t initialByteCredit)
+    : pendingRequestN_(initialRequestN),
+      requested_(initialRequestN),
+      byteCredit_(initialByteCredit),
+      unbounded_(initialRequestN >= kMaxRequestN),
+      byteCreditEnabled_(initialByteCredit > 0) {}
 
 void PublisherBase::publisherSubscribe(
     std::shared_ptr<yarpl::flowable::Subscription> subscription) {
@@ -29,9 +42,7 @@ void PublisherBase::publisherSubscribe(
   }
   DCHECK(!producingSubscription_);
   producingSubscription_ = std::move(subscription);
-  if (initialRequestN_) {
-    producingSubscription_->request(initialRequestN_.consumeAll());
-  }
+  requestFromProducer();
 }
 
 void PublisherBase::publisherComplete() {
@@ -44,17 +55,92 @@ bool PublisherBase::publisherClosed() const {
 }
 
 void PublisherBase::processRequestN(uint32_t requestN) {
+  FOLLY_SDT(rsocket, request_n_receive, this, requestN);
   if (requestN == 0 || state_ == State::CLOSED) {
     return;
   }
+  // Without byte credit, an unbounded stream has nothing left to keep track
+  // of.
+  if (unbounded_ && !byteCreditEnabled_) {
+    return;
+  }
+  requested_ += requestN;
+  if (requestN >= kMaxRequestN) {
+    unbounded_ = true;
+  }
 
   // We might not have the subscription set yet as there can be REQUEST_N frames
   // scheduled on the executor before onSubscribe method.
-  if (producingSubscription_) {
-    producingSubscription_->request(requestN);
+  pendingRequestN_.add(requestN);
+  requestFromProducer();
+}
+
+void PublisherBase::processByteCredit(uint32_t bytes) {
+  if (!byteCreditEnabled_ || state_ == State::CLOSED) {
+    return;
+  }
+  byteCredit_.add(bytes);
+  requestFromProducer();
+}
+
+void PublisherBase::setPublisherPaused(bool paused) {
+  paused_ = paused;
+  requestFromProducer();
+}
+
+size_t PublisherBase::byteCost(const Payload& payload) const {
+  return byteCreditEnabled_ ? ByteCredit::lengthOf(payload) : 0;
+}
+
+void PublisherBase::payloadPublished(size_t byteCost) {
+  if (!byteCreditEnabled_ || state_ == State::CLOSED) {
+    return;
+  }
+  byteCredit_.consumeUpTo(byteCost);
+  averageByteCost_ = averageByteCost_ == 0
+      ? byteCost
+      : (3 * averageByteCost_ + byteCost) / 4;
+  if (requestedFromProducer_ > 0 && --requestedFromProducer_ == 0) {
+    requestFromProducer();
+  }
+}
+
+void PublisherBase::requestFromProducer() {
+  if (!producingSubscription_ || paused_ || !pendingRequestN_) {
+    return;
+  }
+  if (!byteCreditEnabled_) {
+    auto const n = pendingRequestN_.consumeAll();
+    producingSubscription_->request(
+        unbounded_ ? yarpl::credits::kNoFlowControl : n);
+    return;
+  }
+
+  // Only ask for the next payloads once the producer emitted the ones asked
+  // for before, so that they can't run much past the byte credit.
+  if (!byteCredit_ || requestedFromProducer_ > 0) {
+    return;
+  }
+  size_t n = 1;
+  if (averageByteCost_ > 0) {
+    n = std::max<size_t>(1, byteCredit_.get() / averageByteCost_);
+  }
+  n = pendingRequestN_.consumeUpTo(n);
+  requestedFromProducer_ = n;
+  producingSubscription_->request(n);
+}
+
+void PublisherBase::describePublisher(
+    StreamFlowControl& flowControl,
+    uint64_t sent) const {
+  flowControl.publisher = true;
+  if (unbounded_) {
+    flowControl.publisherAllowance = Allowance::max();
   } else {
-    initialRequestN_.add(requestN);
+    flowControl.publisherAllowance = requested_ > sent ? requested_ - sent : 0;
   }
+  flowControl.publisherHeldBack = pendingRequestN_.get();
+  flowControl.publisherByteCredit = byteCredit_.get();
 }
 
 void PublisherBase::terminatePublisher() {
@@ -14,6 +14,8 @@
 
 #pragma once
 
+#include "rsocket/FlowControl.h"
+#include "rsocket/Payload.h"
 #include "rsocket/internal/Allowance.h"
 #include "yarpl/flowable/Subscription.h"
 
@@ -22,25 +24,68 @@ namespace rsocket {
 /// A class that represents a flow-control-aware producer of data.
 class PublisherBase {
  public:
-  explicit PublisherBase(uint32_t initialRequestN);
+  /// A non-zero `initialByteCredit` turns on byte-based flow control, see
+  /// ByteCredit.
+  explicit PublisherBase(
+      uint32_t initialRequestN,
+      size_t initialByteCredit = 0);
 
   void publisherSubscribe(std::shared_ptr<yarpl::flowable::Subscription>);
 
   void processRequestN(uint32_t);
+  void processByteCredit(uint32_t bytes);
   void publisherComplete();
 
   bool publisherClosed() const;
   void terminatePublisher();
 
+  /// While paused, demand from the peer is held back rather than passed on to
+  /// the producer.  It is passed on all at once upon resuming.
+  void setPublisherPaused(bool paused);
+
+  /// What sending a payload costs in byte credit, zero unless byte-based
+  /// flow control is on.  Meant to be taken before the payload is sent and
+  /// passed to payloadPublished() after.
+  size_t byteCost(const Payload&) const;
+
+  /// To be called after sending each payload the producer emitted.
+  void payloadPublished(size_t byteCost);
+
+  /// Fills in the publisher part of the flow control state of the stream,
+  /// given how many payloads it sent.
+  void describePublisher(StreamFlowControl&, uint64_t sent) const;
+
  private:
   enum class State : uint8_t {
     RESPONDING,
     CLOSED,
   };
 
+  /// Passes as much of pendingRequestN_ on to the producer as is allowed.
+  void requestFromProducer();
+
   std::shared_ptr<yarpl::flowable::Subscription> producingSubscription_;
-  Allowance initialRequestN_;
+  /// Demand from the peer that wasn't passed on to the producer yet.
+  Allowance pendingRequestN_;
+  /// Total of the credits the peer gave the stream.
+  uint64_t requested_{0};
+
+  /// Byte credit the peer gave the stream and that wasn't used up yet.
+  Allowance byteCredit_;
+  /// Payloads asked from the producer that it hasn't emitted yet, only kept
+  /// track of with byte-based flow control.
+  size_t requestedFromProducer_{0};
+  /// Moving average of the byte cost of payloads, to guess how many payloads
+  /// the byte credit left is worth.
+  size_t averageByteCost_{0};
+
   State state_{State::RESPONDING};
+  bool paused_{false};
+  /// Set once the peer requested kMaxRequestN, which by the protocol means
+  /// unbounded demand.  The producer is then asked for
+  /// credits::kNoFlowControl, and further REQUEST_N frames are ignored.
+  bool unbounded_{false};
+  const bool byteCreditEnabled_;
 };
 
 } // namespace rsocket
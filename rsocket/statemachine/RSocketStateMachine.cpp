@@ -17,24 +17,39 @@
 #include <folly/ExceptionWrapper.h>
 #include <folly/Format.h>
 #include <folly/Optional.h>
+#include <folly/ScopeGuard.h>
 #include <folly/String.h>
 #include <folly/io/async/EventBaseManager.h>
 #include <folly/lang/Assume.h>
+#include <folly/tracing/StaticTracepoint.h>
+
+#include <chrono>
+#include <limits>
+#include <utility>
 
 #include "rsocket/DuplexConnection.h"
+#include "rsocket/RSocketCoroResponder.h"
 #include "rsocket/RSocketConnectionEvents.h"
+#include "rsocket/RSocketException.h"
 #include "rsocket/RSocketParameters.h"
 #include "rsocket/RSocketResponder.h"
 #include "rsocket/RSocketStats.h"
 #include "rsocket/framing/Frame.h"
 #include "rsocket/framing/FrameSerializer.h"
 #include "rsocket/framing/FrameTransportImpl.h"
+#include "rsocket/internal/ByteCredit.h"
 #include "rsocket/internal/ClientResumeStatusCallback.h"
+#include "rsocket/internal/EventBaseMonitor.h"
+#include "rsocket/internal/FrameChecksums.h"
+#include "rsocket/internal/FrameTracer.h"
+#include "rsocket/internal/PayloadCompressor.h"
 #include "rsocket/internal/ScheduledSubscriber.h"
+#include "rsocket/internal/StreamErrors.h"
 #include "rsocket/internal/WarmResumeManager.h"
 #include "rsocket/statemachine/ChannelRequester.h"
 #include "rsocket/statemachine/ChannelResponder.h"
 #include "rsocket/statemachine/FireAndForgetResponder.h"
+#include "rsocket/statemachine/RequestResponseFutureRequester.h"
 #include "rsocket/statemachine/RequestResponseRequester.h"
 #include "rsocket/statemachine/RequestResponseResponder.h"
 #include "rsocket/statemachine/StreamRequester.h"
@@ -50,17 +65,56 @@ namespace {
 
 void disconnectError(
     std::shared_ptr<yarpl::flowable::Subscriber<Payload>> subscriber) {
-  std::runtime_error exn{"RSocket connection is disconnected or closed"};
   subscriber->onSubscribe(yarpl::flowable::Subscription::create());
-  subscriber->onError(std::move(exn));
+  subscriber->onError(StreamErrors::disconnected());
 }
 
 void disconnectError(
     std::shared_ptr<yarpl::single::SingleObserver<Payload>> observer) {
-  auto exn = folly::make_exception_wrapper<std::runtime_error>(
-      "RSocket connection is disconnected or closed");
   observer->onSubscribe(yarpl::single::SingleSubscriptions::empty());
-  observer->onError(std::move(exn));
+  observer->onError(StreamErrors::disconnected());
+}
+
+void disconnectError(folly::Promise<Payload> promise) {
+  promise.setException(StreamErrors::disconnected());
+}
+
+/// Collects the frames a ResumeManager replays, see exportResumeState().
+class FrameCollector : public FrameTransport {
+ public:
+  explicit FrameCollector(std::vector<std::unique_ptr<folly::IOBuf>>& frames)
+      : frames_(frames) {}
+
+  void setFrameProcessor(std::shared_ptr<FrameProcessor>) override {}
+
+  void outputFrameOrDrop(std::unique_ptr<folly::IOBuf> frame) override {
+    frames_.push_back(std::move(frame));
+  }
+
+  void close() override {}
+
+  DuplexConnection* getConnection() override {
+    return nullptr;
+  }
+
+  bool isConnectionFramed() const override {
+    return false;
+  }
+
+ private:
+  std::vector<std::unique_ptr<folly::IOBuf>>& frames_;
+};
+
+/// Coroutine responders are driven directly, the others through their
+/// Flowables and Singles.
+std::shared_ptr<RSocketResponderCore> toResponderCore(
+    std::shared_ptr<RSocketResponder> responder) {
+#if FOLLY_HAS_COROUTINES
+  if (auto coro = std::dynamic_pointer_cast<RSocketCoroResponder>(responder)) {
+    return std::make_shared<RSocketCoroResponderAdapter>(std::move(coro));
+  }
+#endif
+  return std::make_shared<RSocketResponderAdapter>(std::move(responder));
 }
 
 } // namespace
@@ -74,8 +128,7 @@ RSocketStateMachine::RSocketStateMachine(
     std::shared_ptr<ResumeManager> resumeManager,
     std::shared_ptr<ColdResumeHandler> coldResumeHandler)
     : RSocketStateMachine(
-          std::make_shared<RSocketResponderAdapter>(
-              std::move(requestResponder)),
+          toResponderCore(std::move(requestResponder)),
           std::move(keepaliveTimer),
           mode,
           std::move(stats),
@@ -133,18 +186,76 @@ void RSocketStateMachine::setResumable(bool resumable) {
   isResumable_ = resumable;
 }
 
+void RSocketStateMachine::setMemoryPressure(
+    std::shared_ptr<const MemoryPressureController> controller) {
+  auto const warm =
+      std::dynamic_pointer_cast<WarmResumeManager>(resumeManager_);
+  if (warm) {
+    warm->setMemoryPressure(controller);
+  }
+  memoryPressure_ = std::move(controller);
+}
+
 void RSocketStateMachine::connectServer(
     std::shared_ptr<FrameTransport> frameTransport,
     const SetupParameters& setupParams) {
   setResumable(setupParams.resumable);
+  if (setupParams.resumable) {
+    auto& session = sessionState();
+    session.metadataMimeType = setupParams.metadataMimeType;
+    session.dataMimeType = setupParams.dataMimeType;
+    session.payloadCompression = setupParams.payloadCompression;
+  }
   setProtocolVersionOrThrow(setupParams.protocolVersion, frameTransport);
+
+  if (!setupParams.payloadCompression.empty()) {
+    payloadCompressor_ =
+        PayloadCompressor::create(setupParams.payloadCompression, stats_);
+  }
+  byteCredit_ = setupParams.byteCredit;
+
+  frameChecksums_ = FrameChecksums::isSupported(setupParams.frameChecksum) &&
+      frameTransport->supportsFrameChecksums();
+  if (frameChecksums_) {
+    // Ahead of connect(), the frames after SETUP may already be waiting.
+    frameTransport->enableFrameChecksums();
+  }
+
   connect(std::move(frameTransport));
+
+  if (!setupParams.payloadCompression.empty() && !payloadCompressor_) {
+    auto const msg = folly::sformat(
+        "Unsupported payload compression {}", setupParams.payloadCompression);
+    closeWithError(Frame_ERROR::unsupportedSetup(msg));
+    return;
+  }
+
+  if (!setupParams.frameChecksum.empty() && !frameChecksums_) {
+    auto const msg = folly::sformat(
+        "Unsupported frame checksum {}", setupParams.frameChecksum);
+    closeWithError(Frame_ERROR::unsupportedSetup(msg));
+    return;
+  }
+
+  if (setupParams.honorLease) {
+    if (!leaseSender_) {
+      closeWithError(Frame_ERROR::unsupportedSetup("Leases are not supported"));
+      return;
+    }
+    leaseEnabled_ = true;
+  }
+
   sendPendingFrames();
+
+  if (leaseEnabled_) {
+    sendLease();
+  }
 }
 
 bool RSocketStateMachine::resumeServer(
     std::shared_ptr<FrameTransport> frameTransport,
     const ResumeParameters& resumeParams) {
+  FOLLY_SDT(rsocket, server_resume_start, this, resumeParams.serverPosition);
   const folly::Optional<int64_t> clientAvailable =
       (resumeParams.clientPosition == kUnspecifiedResumePosition)
       ? folly::none
@@ -162,11 +273,37 @@ bool RSocketStateMachine::resumeServer(
   closeFrameTransport(
       std::runtime_error{"Connection being resumed, dropping old connection"});
   setProtocolVersionOrThrow(resumeParams.protocolVersion, frameTransport);
+
+  if (frameChecksums_ && frameTransport) {
+    if (!frameTransport->supportsFrameChecksums()) {
+      connect(std::move(frameTransport));
+      closeWithError(Frame_ERROR::connectionError(
+          "Frame checksums are not supported by the resumed connection"));
+      return false;
+    }
+    frameTransport->enableFrameChecksums();
+  }
   connect(std::move(frameTransport));
 
   const auto result = resumeFromPositionOrClose(
       resumeParams.serverPosition, resumeParams.clientPosition);
 
+  if (result && leaseEnabled_) {
+    sendLease();
+  }
+  if (result && sessionState_ && !sessionState_->handedOffStreams.empty()) {
+    // Queued behind the replayed frames.
+    for (auto streamId : sessionState_->handedOffStreams) {
+      if ((streamId & 1) == (nextStreamId_ & 1)) {
+        writeCancel(Frame_CANCEL(streamId));
+      } else {
+        writeError(Frame_ERROR::canceled(
+            streamId, "Stream was lost when the session moved servers"));
+      }
+    }
+    sessionState_->handedOffStreams.clear();
+  }
+
   stats_->serverResume(
       clientAvailable,
       serverAvailable,
@@ -174,21 +311,64 @@ bool RSocketStateMachine::resumeServer(
       result ? RSocketStats::ResumeOutcome::SUCCESS
              : RSocketStats::ResumeOutcome::FAILURE);
 
+  FOLLY_SDT(rsocket, server_resume_finish, this, result);
   return result;
 }
 
 void RSocketStateMachine::connectClient(
     std::shared_ptr<FrameTransport> transport,
     SetupParameters params) {
+  prepareClient(std::move(params));
+  connectClient(std::move(transport));
+}
+
+void RSocketStateMachine::prepareClient(SetupParameters params) {
+  CHECK(!setupFrame_) << "The client has already been set up";
+
   auto const version = params.protocolVersion == ProtocolVersion::Unknown
       ? ProtocolVersion::Latest
       : params.protocolVersion;
 
-  setProtocolVersionOrThrow(version, transport);
+  setProtocolVersionOrThrow(version, nullptr);
   setResumable(params.resumable);
+  leaseEnabled_ = params.honorLease;
+  maxRequestsAwaitingLease_ = params.maxRequestsAwaitingLease;
+
+  if (!params.payloadCompression.empty()) {
+    payloadCompressor_ =
+        PayloadCompressor::create(params.payloadCompression, stats_);
+    if (!payloadCompressor_) {
+      throw std::invalid_argument(folly::sformat(
+          "Unsupported payload compression {}", params.payloadCompression));
+    }
+    params.dataMimeType = PayloadCompressor::addToMimeType(
+        params.dataMimeType, params.payloadCompression);
+  }
+  if (params.byteCredit > 0) {
+    byteCredit_ = std::min<size_t>(params.byteCredit, ByteCredit::kMaxGrant);
+    params.metadataMimeType =
+        ByteCredit::addToMimeType(params.metadataMimeType, byteCredit_);
+  }
+  if (!params.frameChecksum.empty()) {
+    if (!FrameChecksums::isSupported(params.frameChecksum)) {
+      throw std::invalid_argument(folly::sformat(
+          "Unsupported frame checksum {}", params.frameChecksum));
+    }
+    frameChecksums_ = true;
+    params.metadataMimeType = FrameChecksums::addToMimeType(
+        params.metadataMimeType, params.frameChecksum);
+  }
+  if (!params.capacityHints.empty()) {
+    if (params.capacityHints.streams > 0) {
+      reserveClientStreams(params.capacityHints.streams);
+    }
+    params.metadataMimeType = CapacityHints::addToMimeType(
+        params.metadataMimeType, params.capacityHints);
+  }
 
   Frame_SETUP frame(
       (params.resumable ? FrameFlags::RESUME_ENABLE : FrameFlags::EMPTY_) |
+          (params.honorLease ? FrameFlags::LEASE : FrameFlags::EMPTY_) |
           (params.payload.metadata ? FrameFlags::METADATA : FrameFlags::EMPTY_),
       version.major,
       version.minor,
@@ -203,11 +383,42 @@ void RSocketStateMachine::connectClient(
   // should retry without resumability
 
   VLOG(3) << "Out: " << frame;
+  setupFrame_ = serializeOut(std::move(frame));
+}
+
+void RSocketStateMachine::connectClient(
+    std::shared_ptr<FrameTransport> transport) {
+  CHECK(setupFrame_) << "The client hasn't been set up";
+
+  if (isClosed()) {
+    // Closed while waiting for its connection.
+    transport->close();
+    return;
+  }
+
+  if (frameChecksums_) {
+    if (!transport->supportsFrameChecksums()) {
+      throw std::invalid_argument(
+          "Frame checksums are not supported by the connection");
+    }
+    // SETUP goes out without a checksum, the server's first frame comes
+    // with one.
+    transport->enableFrameChecksums();
+  }
 
   connect(std::move(transport));
-  // making sure we send setup frame first
-  outputFrame(frameSerializer_->serializeOut(std::move(frame)));
-  // then the rest of the cached frames will be sent
+
+  // The SETUP frame goes first, the frames of the requests made before the
+  // connection share its write rather than following it a write at a time.
+  std::vector<std::unique_ptr<folly::IOBuf>> frames;
+  frames.push_back(std::move(setupFrame_));
+  if (auto pending = consumePendingOutputFrames()) {
+    for (auto& frame : *pending) {
+      frames.push_back(std::move(frame));
+    }
+  }
+  outputFrames(std::move(frames));
+  // Starts the keepalives, and lets the streams write again.
   sendPendingFrames();
 }
 
@@ -216,6 +427,8 @@ void RSocketStateMachine::resumeClient(
     std::shared_ptr<FrameTransport> transport,
     std::unique_ptr<ClientResumeStatusCallback> resumeCallback,
     ProtocolVersion version) {
+  FOLLY_SDT(rsocket, client_resume_start, this);
+
   // Cold-resumption.  Set the serializer.
   if (!frameSerializer_) {
     CHECK(coldResumeHandler_);
@@ -226,6 +439,14 @@ void RSocketStateMachine::resumeClient(
       version == ProtocolVersion::Unknown ? ProtocolVersion::Latest : version,
       transport);
 
+  if (frameChecksums_) {
+    if (!transport->supportsFrameChecksums()) {
+      throw std::invalid_argument(
+          "Frame checksums are not supported by the connection");
+    }
+    transport->enableFrameChecksums();
+  }
+
   Frame_RESUME resumeFrame(
       std::move(token),
       resumeManager_->impliedPosition(),
@@ -238,7 +459,7 @@ void RSocketStateMachine::resumeClient(
 
   setResumable(true);
   reconnect(std::move(transport), std::move(resumeCallback));
-  outputFrame(frameSerializer_->serializeOut(std::move(resumeFrame)));
+  outputFrame(serializeOut(std::move(resumeFrame)));
 }
 
 void RSocketStateMachine::connect(std::shared_ptr<FrameTransport> transport) {
@@ -251,19 +472,35 @@ void RSocketStateMachine::connect(std::shared_ptr<FrameTransport> transport) {
   // setFrameProcessor() returns.  There can be terminating signals processed in
   // that call which will nullify frameTransport_.
   frameTransport_ = transport;
+  resumeManager_->onConnected();
 
   CHECK(frameSerializer_);
-  frameSerializer_->preallocateFrameSizeField() =
-      transport->isConnectionFramed();
+  frameSerializer_ = FrameSerializer::shared(
+      frameSerializer_->protocolVersion(), transport->isConnectionFramed());
 
   if (connectionEvents_) {
     connectionEvents_->onConnected();
   }
 
+  if (transportOutputOptions_.highWatermark > 0 ||
+      resumeReplayOptions_.maxBufferedOutputBytes > 0) {
+    frameTransport_->setOutputWrittenCallback(
+        [weakThis = std::weak_ptr<RSocketStateMachine>(shared_from_this())] {
+          if (auto self = weakThis.lock()) {
+            self->onTransportOutputWritten();
+          }
+        });
+  }
+
   // Keep a reference to stats, as processing frames might close this instance.
   auto const stats = stats_;
   frameTransport_->setFrameProcessor(shared_from_this());
   stats->socketConnected();
+
+  // The previous transport may have left the streams paused.
+  if (frameTransport_) {
+    updateTransportOutputPaused();
+  }
 }
 
 void RSocketStateMachine::sendPendingFrames() {
@@ -288,6 +525,7 @@ void RSocketStateMachine::disconnect(folly::exception_wrapper ex) {
   }
 
   closeFrameTransport(std::move(ex));
+  resumeManager_->onDisconnected();
 
   if (connectionEvents_) {
     connectionEvents_->onStreamsPaused();
@@ -313,7 +551,13 @@ void RSocketStateMachine::close(
         ConnectionException(ex ? ex.get_exception()->what() : "RS closing"));
   }
 
+  ++leaseGeneration_;
   closeStreams(signal);
+  if (auto tenant = std::move(tenant_)) {
+    tenant->closeConnection();
+  }
+  failRequestsAwaitingLease();
+  failRequestsAwaitingStreamSlot();
   closeFrameTransport(ex);
 
   if (auto connectionEvents = std::move(connectionEvents_)) {
@@ -331,11 +575,20 @@ void RSocketStateMachine::closeFrameTransport(folly::exception_wrapper ex) {
     return;
   }
 
+  // Whatever the streams wrote before the connection went away goes out
+  // first.
+  flushScheduledFrames();
+  flushRequestBatch();
+
   // Stop scheduling keepalives since the socket is now disconnected
   if (keepaliveTimer_) {
     keepaliveTimer_->stop();
   }
 
+  // The next transport replays from the position its peer asks for.
+  replayPosition_.reset();
+  replayAwaitingOutput_ = false;
+
   if (auto resumeCallback = std::move(resumeCallback_)) {
     resumeCallback->onResumeError(ConnectionException(
         ex ? ex.get_exception()->what() : "connection closing"));
@@ -348,6 +601,8 @@ void RSocketStateMachine::closeFrameTransport(folly::exception_wrapper ex) {
     frameTransport_->close();
     frameTransport_ = nullptr;
   }
+
+  closeUntrackedStreams();
 }
 
 void RSocketStateMachine::disconnectOrCloseWithError(Frame_ERROR&& errorFrame) {
@@ -391,11 +646,147 @@ void RSocketStateMachine::closeWithError(Frame_ERROR&& error) {
 
   std::runtime_error exn{error.payload_.cloneDataToString()};
   if (frameSerializer_) {
-    outputFrameOrEnqueue(frameSerializer_->serializeOut(std::move(error)));
+    flushScheduledFrames();
+    outputFrameOrEnqueue(serializeOut(std::move(error)));
   }
   close(std::move(exn), signal);
 }
 
+void RSocketStateMachine::drain(
+    Frame_ERROR&& error,
+    std::chrono::milliseconds timeout,
+    folly::Function<void(ResumeHandoffState)> handOff) {
+  if (isClosed() || drain_) {
+    return;
+  }
+  VLOG(2) << mode_ << " Draining " << streams_.size() << " streams";
+  drain_ = std::make_unique<DrainState>();
+  drain_->error = std::move(error);
+  drain_->handOff = std::move(handOff);
+
+  if (leaseEnabled_) {
+    ++leaseGeneration_;
+    grantedLease_.clear();
+  }
+
+  if (streams_.empty()) {
+    closeDrained();
+    return;
+  }
+
+  auto const eventBase = folly::EventBaseManager::get()->getExistingEventBase();
+  if (!eventBase) {
+    LOG(ERROR) << "Cannot time out the drain without an EventBase";
+    return;
+  }
+  eventBase->runAfterDelay(
+      [weakThis = std::weak_ptr<RSocketStateMachine>(shared_from_this())] {
+        if (auto self = weakThis.lock()) {
+          VLOG(2) << self->mode_ << " Drain timed out with "
+                  << self->streams_.size() << " streams open";
+          self->closeDrained();
+        }
+      },
+      static_cast<uint32_t>(std::max<int64_t>(timeout.count(), 1)));
+}
+
+void RSocketStateMachine::closeDrained() {
+  if (isClosed() || !drain_) {
+    return;
+  }
+  if (auto handOff = std::exchange(drain_->handOff, nullptr)) {
+    if (auto state = this->handOff()) {
+      handOff(std::move(*state));
+      return;
+    }
+  }
+  auto error = std::move(drain_->error);
+  closeWithError(std::move(error));
+}
+
+folly::Optional<ResumeHandoffState> RSocketStateMachine::exportResumeState() {
+  if (mode_ != RSocketMode::SERVER || !isResumable_ || isClosed() ||
+      leaseEnabled_ || frameChecksums_ || !frameSerializer_) {
+    return folly::none;
+  }
+  // Scheduled frames are either written and buffered for resumption, or
+  // queued as pending frames.
+  flushScheduledFrames();
+
+  auto const& session = sessionState();
+  ResumeHandoffState state;
+  state.protocolVersion = frameSerializer_->protocolVersion();
+  state.metadataMimeType = session.metadataMimeType;
+  state.dataMimeType = session.dataMimeType;
+  state.payloadCompression = session.payloadCompression;
+  state.byteCredit = byteCredit_;
+  state.impliedPosition = resumeManager_->impliedPosition();
+  state.nextStreamId = nextStreamId_;
+
+  state.firstSentPosition = resumeManager_->firstSentPosition();
+  if (resumeManager_->isPositionAvailable(state.firstSentPosition)) {
+    FrameCollector collector(state.frames);
+    resumeManager_->sendFramesFromPosition(state.firstSentPosition, collector);
+  } else {
+    state.firstSentPosition = resumeManager_->lastSentPosition();
+  }
+  // Frames not written yet follow, as if they had been.
+  if (auto frames = pendingOutputFrames()) {
+    for (const auto& frame : *frames) {
+      auto const type = frameSerializer_->peekFrameType(*frame);
+      if (resumeManager_->shouldTrackFrame(type)) {
+        state.frames.push_back(frame->clone());
+      }
+    }
+  }
+
+  streams_.forEach([&](StreamId streamId, const auto&) {
+    state.openStreams.push_back(streamId);
+  });
+  state.openStreams.insert(
+      state.openStreams.end(),
+      session.handedOffStreams.begin(),
+      session.handedOffStreams.end());
+  return state;
+}
+
+folly::Optional<ResumeHandoffState> RSocketStateMachine::handOff() {
+  auto state = exportResumeState();
+  if (state) {
+    VLOG(2) << mode_ << " Handing over the session with "
+            << state->openStreams.size() << " streams";
+    close(
+        std::runtime_error{"Session handed over to another server"},
+        StreamCompletionSignal::CONNECTION_END);
+  }
+  return state;
+}
+
+void RSocketStateMachine::takeOver(const ResumeHandoffState& state) {
+  DCHECK(mode_ == RSocketMode::SERVER);
+  setResumable(true);
+  auto& session = sessionState();
+  session.metadataMimeType = state.metadataMimeType;
+  session.dataMimeType = state.dataMimeType;
+  session.payloadCompression = state.payloadCompression;
+  if (!state.payloadCompression.empty()) {
+    payloadCompressor_ =
+        PayloadCompressor::create(state.payloadCompression, stats_);
+  }
+  byteCredit_ = state.byteCredit;
+  if (state.nextStreamId != 0) {
+    nextStreamId_ = state.nextStreamId;
+  }
+  session.handedOffStreams = state.openStreams;
+}
+
+RSocketStateMachine::SessionState& RSocketStateMachine::sessionState() {
+  if (!sessionState_) {
+    sessionState_ = std::make_unique<SessionState>();
+  }
+  return *sessionState_;
+}
+
 void RSocketStateMachine::reconnect(
     std::shared_ptr<FrameTransport> newFrameTransport,
     std::unique_ptr<ClientResumeStatusCallback> resumeCallback) {
@@ -414,17 +805,55 @@ void RSocketStateMachine::reconnect(
 
 void RSocketStateMachine::requestStream(
     Payload request,
-    std::shared_ptr<yarpl::flowable::Subscriber<Payload>> responseSink) {
-  if (isDisconnected()) {
+    std::shared_ptr<yarpl::flowable::Subscriber<Payload>> responseSink,
+    uint32_t outputWeight,
+    bool resumable,
+    folly::Optional<RequestDeadline::Clock::time_point> deadline) {
+  if (refusesRequests()) {
     disconnectError(std::move(responseSink));
     return;
   }
 
+  if (pendingOutputPaused()) {
+    responseSink->onSubscribe(yarpl::flowable::Subscription::create());
+    responseSink->onError(StreamErrors::outputPaused());
+    return;
+  }
+
+  if (!hasStreamSlot() || !acquireLease()) {
+    auto retry = [this,
+                  request = std::move(request),
+                  responseSink,
+                  outputWeight,
+                  resumable,
+                  deadline](folly::exception_wrapper ew) mutable {
+      if (ew) {
+        responseSink->onSubscribe(yarpl::flowable::Subscription::create());
+        responseSink->onError(std::move(ew));
+        return;
+      }
+      requestStream(
+          std::move(request),
+          std::move(responseSink),
+          outputWeight,
+          resumable,
+          deadline);
+    };
+    if (!hasStreamSlot()) {
+      awaitStreamSlot(std::move(retry));
+    } else {
+      awaitLease(std::move(retry));
+    }
+    return;
+  }
+
   auto const streamId = getNextStreamId();
-  auto stateMachine = std::make_shared<StreamRequester>(
+  setOutputWeight(streamId, StreamType::STREAM, outputWeight);
+  setStreamUntracked(streamId, resumable);
+  setStreamDeadline(streamId, deadline);
+  auto stateMachine = streamPool().make<StreamRequester>(
       shared_from_this(), streamId, std::move(request));
-  const auto result = streams_.emplace(streamId, stateMachine);
-  DCHECK(result.second);
+  addStream(streamId, stateMachine);
   stateMachine->subscribe(std::move(responseSink));
 }
 
@@ -432,79 +861,421 @@ std::shared_ptr<yarpl::flowable::Subscriber<Payload>>
 RSocketStateMachine::requestChannel(
     Payload request,
     bool hasInitialRequest,
-    std::shared_ptr<yarpl::flowable::Subscriber<Payload>> responseSink) {
-  if (isDisconnected()) {
+    std::shared_ptr<yarpl::flowable::Subscriber<Payload>> responseSink,
+    uint32_t outputWeight,
+    bool resumable,
+    folly::Optional<RequestDeadline::Clock::time_point> deadline) {
+  if (refusesRequests()) {
     disconnectError(std::move(responseSink));
     return nullptr;
   }
 
+  if (pendingOutputPaused()) {
+    responseSink->onSubscribe(yarpl::flowable::Subscription::create());
+    responseSink->onError(StreamErrors::outputPaused());
+    return nullptr;
+  }
+
+  // The caller needs the channel's subscriber right away, so channels can't
+  // wait for a stream to end or for a lease.
+  if (!hasStreamSlot()) {
+    stats_->streamLimitReached();
+    responseSink->onSubscribe(yarpl::flowable::Subscription::create());
+    responseSink->onError(StreamErrors::tooManyStreams());
+    return nullptr;
+  }
+
+  if (!acquireLease()) {
+    stats_->requestWithoutLease();
+    responseSink->onSubscribe(yarpl::flowable::Subscription::create());
+    responseSink->onError(StreamErrors::noLease());
+    return nullptr;
+  }
+
   auto const streamId = getNextStreamId();
+  setOutputWeight(streamId, StreamType::CHANNEL, outputWeight);
+  setStreamUntracked(streamId, resumable);
+  setStreamDeadline(streamId, deadline);
   std::shared_ptr<ChannelRequester> stateMachine;
   if (hasInitialRequest) {
-    stateMachine = std::make_shared<ChannelRequester>(
+    stateMachine = streamPool().make<ChannelRequester>(
         std::move(request), shared_from_this(), streamId);
   } else {
     stateMachine =
-        std::make_shared<ChannelRequester>(shared_from_this(), streamId);
+        streamPool().make<ChannelRequester>(shared_from_this(), streamId);
+  }
+  addStream(streamId, stateMachine);
+  if (transportOutputPaused_) {
+    stateMachine->handleOutputPaused(true);
   }
-  const auto result = streams_.emplace(streamId, stateMachine);
-  DCHECK(result.second);
   stateMachine->subscribe(std::move(responseSink));
   return stateMachine;
 }
 
 void RSocketStateMachine::requestResponse(
     Payload request,
-    std::shared_ptr<yarpl::single::SingleObserver<Payload>> responseSink) {
-  if (isDisconnected()) {
+    std::shared_ptr<yarpl::single::SingleObserver<Payload>> responseSink,
+    uint32_t outputWeight,
+    bool resumable,
+    folly::Optional<RequestDeadline::Clock::time_point> deadline,
+    folly::Optional<RequestBatchingOptions> batching) {
+  if (refusesRequests()) {
     disconnectError(std::move(responseSink));
     return;
   }
 
+  if (pendingOutputPaused()) {
+    responseSink->onSubscribe(yarpl::single::SingleSubscriptions::empty());
+    responseSink->onError(StreamErrors::outputPaused());
+    return;
+  }
+
+  if (!hasStreamSlot() || !acquireLease()) {
+    auto retry = [this,
+                  request = std::move(request),
+                  responseSink,
+                  outputWeight,
+                  resumable,
+                  deadline,
+                  batching](folly::exception_wrapper ew) mutable {
+      if (ew) {
+        responseSink->onSubscribe(yarpl::single::SingleSubscriptions::empty());
+        responseSink->onError(std::move(ew));
+        return;
+      }
+      requestResponse(
+          std::move(request),
+          std::move(responseSink),
+          outputWeight,
+          resumable,
+          deadline,
+          batching);
+    };
+    if (!hasStreamSlot()) {
+      awaitStreamSlot(std::move(retry));
+    } else {
+      awaitLease(std::move(retry));
+    }
+    return;
+  }
+
+  batchingRequest_ = batching.get_pointer();
+  auto const batchingGuard =
+      folly::makeGuard([this] { batchingRequest_ = nullptr; });
+
   auto const streamId = getNextStreamId();
-  auto stateMachine = std::make_shared<RequestResponseRequester>(
+  setOutputWeight(streamId, StreamType::REQUEST_RESPONSE, outputWeight);
+  setStreamUntracked(streamId, resumable);
+  setStreamDeadline(streamId, deadline);
+  auto stateMachine = streamPool().make<RequestResponseRequester>(
       shared_from_this(), streamId, std::move(request));
-  const auto result = streams_.emplace(streamId, stateMachine);
-  DCHECK(result.second);
+  addStream(streamId, stateMachine);
   stateMachine->subscribe(std::move(responseSink));
 }
 
+void RSocketStateMachine::requestResponse(
+    Payload request,
+    folly::Promise<Payload> response,
+    uint32_t outputWeight,
+    bool resumable,
+    folly::Optional<RequestDeadline::Clock::time_point> deadline,
+    folly::Optional<RequestBatchingOptions> batching) {
+  if (refusesRequests()) {
+    disconnectError(std::move(response));
+    return;
+  }
+
+  if (pendingOutputPaused()) {
+    response.setException(StreamErrors::outputPaused());
+    return;
+  }
+
+  if (!hasStreamSlot() || !acquireLease()) {
+    auto retry = [this,
+                  request = std::move(request),
+                  response = std::move(response),
+                  outputWeight,
+                  resumable,
+                  deadline,
+                  batching](folly::exception_wrapper ew) mutable {
+      if (ew) {
+        response.setException(std::move(ew));
+        return;
+      }
+      requestResponse(
+          std::move(request),
+          std::move(response),
+          outputWeight,
+          resumable,
+          deadline,
+          batching);
+    };
+    if (!hasStreamSlot()) {
+      awaitStreamSlot(std::move(retry));
+    } else {
+      awaitLease(std::move(retry));
+    }
+    return;
+  }
+
+  batchingRequest_ = batching.get_pointer();
+  auto const batchingGuard =
+      folly::makeGuard([this] { batchingRequest_ = nullptr; });
+
+  auto const streamId = getNextStreamId();
+  setOutputWeight(streamId, StreamType::REQUEST_RESPONSE, outputWeight);
+  setStreamUntracked(streamId, resumable);
+  setStreamDeadline(streamId, deadline);
+  auto stateMachine = streamPool().make<RequestResponseFutureRequester>(
+      shared_from_this(), streamId, std::move(response));
+  addStream(streamId, stateMachine);
+  stateMachine->start(std::move(request));
+}
+
 void RSocketStateMachine::closeStreams(StreamCompletionSignal signal) {
+  endCancelBatch();
+  if (tenant_) {
+    tenant_->closeStreams(peerStreams());
+  }
   while (!streams_.empty()) {
-    auto it = streams_.begin();
-    auto streamStateMachine = std::move(it->second);
-    streams_.erase(it);
-    streamStateMachine->endStream(signal);
+    for (auto& streamStateMachine : streams_.extractAll()) {
+      streamStateMachine->endStream(signal);
+      retireStream(std::move(streamStateMachine));
+    }
+  }
+  reassemblyBytes_ = 0;
+  untrackedStreams_.clear();
+  streamDeadlines_.clear();
+}
+
+void RSocketStateMachine::setStreamUntracked(
+    StreamId streamId,
+    bool resumable) {
+  if (!resumable && isResumable_) {
+    untrackedStreams_.insert(streamId);
+  }
+}
+
+void RSocketStateMachine::setStreamDeadline(
+    StreamId streamId,
+    folly::Optional<RequestDeadline::Clock::time_point> deadline) {
+  if (deadline) {
+    // The timer is armed once the request is written, see writeNewStream().
+    streamDeadlines_.emplace(streamId, *deadline);
+    setOutputDeadline(streamId, *deadline);
+  }
+}
+
+void RSocketStateMachine::scheduleStreamDeadline(
+    StreamId streamId,
+    RequestDeadline::Clock::time_point deadline) {
+  auto const eventBase = folly::EventBaseManager::get()->getExistingEventBase();
+  if (!eventBase) {
+    LOG(ERROR) << "Cannot enforce request deadlines without an EventBase";
+    return;
+  }
+  auto const delay = std::chrono::duration_cast<std::chrono::milliseconds>(
+      deadline - RequestDeadline::Clock::now());
+  eventBase->runAfterDelay(
+      [weakThis = std::weak_ptr<RSocketStateMachine>(shared_from_this()),
+       streamId] {
+        if (auto self = weakThis.lock()) {
+          self->onStreamDeadline(streamId);
+        }
+      },
+      static_cast<uint32_t>(std::max<int64_t>(delay.count(), 1)));
+}
+
+void RSocketStateMachine::onStreamDeadline(StreamId streamId) {
+  // Stream ids aren't reused, so the stream is the one the deadline is for.
+  if (!streamDeadline(streamId)) {
+    return;
+  }
+  auto const stateMachine = getStreamStateMachine(streamId);
+  if (!stateMachine) {
+    return;
+  }
+  VLOG(3) << mode_ << " Deadline passed on stream " << streamId;
+  stats_->requestDeadlineExpired();
+  if (auto scheduler = outputScheduler()) {
+    if (auto const dropped = scheduler->dropExpired(streamId)) {
+      stats_->expiredFramesDropped(dropped);
+    }
+  }
+  if ((streamId & 1) == (nextStreamId_ & 1)) {
+    writeCancel(Frame_CANCEL{streamId});
+    stateMachine->handleError(StreamErrors::deadlineExpired());
+  } else {
+    stateMachine->handleCancel();
+  }
+}
+
+void RSocketStateMachine::closeUntrackedStreams() {
+  if (untrackedStreams_.empty()) {
+    return;
+  }
+  VLOG(3) << "Closing " << untrackedStreams_.size()
+          << " streams that can't be resumed";
+
+  // No new streams open while disconnected, but ending a stream can close
+  // others, so don't walk the set while doing so.
+  const std::vector<StreamId> streamIds(
+      untrackedStreams_.begin(), untrackedStreams_.end());
+  for (auto const streamId : streamIds) {
+    auto const found = streams_.find(streamId);
+    if (!found) {
+      untrackedStreams_.erase(streamId);
+      continue;
+    }
+    auto const stateMachine = *found;
+    stateMachine->endStream(StreamCompletionSignal::CONNECTION_ERROR);
+    onStreamClosed(streamId);
+  }
+}
+
+void RSocketStateMachine::handleStreamPayload(
+    StreamStateMachineBase& stateMachine,
+    Payload payload,
+    bool flagsComplete,
+    bool flagsNext,
+    bool flagsFollows) {
+  auto const before = stateMachine.payloadFragments().size();
+  stateMachine.handlePayload(
+      std::move(payload), flagsComplete, flagsNext, flagsFollows);
+  // If the stream closed meanwhile, onStreamClosed() took off what it held
+  // then, so this still adds up.
+  reassemblyBytes_ += stateMachine.payloadFragments().size();
+  reassemblyBytes_ -= before;
+}
+
+MemoryUsage RSocketStateMachine::memoryUsage() const {
+  MemoryUsage usage;
+  usage.streams = streamPool_ ? streamPool_->bytes() : 0;
+  usage.reassembly = reassemblyBytes_;
+  usage.pendingOutput = pendingOutputBytes();
+  if (auto scheduler = outputScheduler()) {
+    usage.pendingOutput += scheduler->bytes();
+  }
+  usage.resumeBuffer = resumeManager_->bufferedBytes();
+  if (frameTransport_) {
+    usage.inputBuffer = frameTransport_->bufferedInputBytes();
   }
+  return usage;
+}
+
+ConnectionFlowControl RSocketStateMachine::flowControl() const {
+  ConnectionFlowControl flowControl;
+  auto const scheduler = outputScheduler();
+  flowControl.pendingOutputBytes =
+      pendingOutputBytes() + (scheduler ? scheduler->bytes() : 0);
+  flowControl.outputPaused = pendingOutputPaused();
+  flowControl.transportOutputPaused = transportOutputPaused_;
+  if (frameTransport_) {
+    flowControl.transportOutputBytes = frameTransport_->bufferedOutputBytes();
+  }
+  flowControl.resumeBufferBytes = resumeManager_->bufferedBytes();
+
+  flowControl.streams.reserve(streams_.size());
+  streams_.forEach([&](StreamId streamId, const auto& stateMachine) {
+    StreamFlowControl stream;
+    stateMachine->describeFlowControl(stream);
+    if (scheduler) {
+      stream.queuedBytes = scheduler->bytesOf(streamId);
+    }
+    flowControl.streams.push_back(stream);
+  });
+  return flowControl;
 }
 
 void RSocketStateMachine::processFrame(std::unique_ptr<folly::IOBuf> frame) {
+  EventBaseMonitor::ActivityScope activity{
+      EventBaseMonitor::Activity::FRAME_DISPATCH};
   if (isClosed()) {
     VLOG(4) << "StateMachine has been closed.  Discarding incoming frame";
     return;
   }
 
+  if (FOLLY_UNLIKELY(frameCapture_ != nullptr)) {
+    frameCapture_->record(FrameCapture::Direction::IN, *frame);
+  }
+
   if (!ensureOrAutodetectFrameSerializer(*frame)) {
     constexpr auto msg = "Cannot detect protocol version";
     closeWithError(Frame_ERROR::connectionError(msg));
     return;
   }
 
-  const auto frameType = frameSerializer_->peekFrameType(*frame);
-  stats_->frameRead(frameType);
-
-  const auto optStreamId = frameSerializer_->peekStreamId(*frame, false);
-  if (!optStreamId) {
+  // Decode the header once, every handler below reuses it.
+  const auto decoded =
+      visitFrameSerializer(*frameSerializer_, [&](const auto& s) {
+        return s.decodeFrameHeader(*frame);
+      });
+  if (!decoded) {
     constexpr auto msg = "Cannot decode stream ID";
     closeWithError(Frame_ERROR::connectionError(msg));
     return;
   }
 
+  const auto frameType = decoded->header.type;
+  const auto streamId = decoded->header.streamId;
+  if (frameType == FrameType::CANCEL) {
+    beginCancelBatch();
+  } else if (cancelBatch_) {
+    endCancelBatch();
+    if (isClosed()) {
+      return;
+    }
+  }
+  stats_->frameRead(frameType);
+  if (tenant_) {
+    tenant_->bytesRead(frame->computeChainDataLength());
+  }
+  if (keepaliveTimer_ && frameType != FrameType::KEEPALIVE) {
+    keepaliveTimer_->frameReceived();
+  }
+
+  // The peer opened a stream that isn't resumable, flag what we write for it
+  // as well.
+  const bool untracked = decoded->header.flagsUntracked();
+  const bool opensUntrackedStream = untracked &&
+      (frameType == FrameType::REQUEST_STREAM ||
+       frameType == FrameType::REQUEST_CHANNEL ||
+       frameType == FrameType::REQUEST_RESPONSE) &&
+      !streams_.contains(streamId);
+  if (opensUntrackedStream) {
+    untrackedStreams_.insert(streamId);
+  }
+
+  const bool traced = FrameTracer::sampled(streamId);
+  if (traced) {
+    FrameTracer::record(FrameTracer::Point::DISPATCHED, streamId, frameType);
+  }
+
   const auto frameLength = frame->computeChainDataLength();
-  const auto streamId = *optStreamId;
-  handleFrame(streamId, frameType, std::move(frame));
-  resumeManager_->trackReceivedFrame(
-      frameLength, frameType, streamId, getConsumerAllowance(streamId));
+  auto const dispatching = std::exchange(dispatchingFrame_, true);
+  handleFrame(*decoded, std::move(frame));
+  dispatchingFrame_ = dispatching;
+
+  if (traced) {
+    FrameTracer::record(FrameTracer::Point::DELIVERED, streamId, frameType);
+  }
+
+  if (opensUntrackedStream && !streams_.contains(streamId)) {
+    // The request was rejected, or the stream is already over.
+    untrackedStreams_.erase(streamId);
+  }
+  if (!untracked) {
+    resumeManager_->trackReceivedFrame(
+        frameLength, frameType, streamId, getConsumerAllowance(streamId));
+    if (resumeAckThreshold_ > 0 && isResumable_) {
+      acknowledgeReceivedFrames();
+    }
+  }
+
+  if (!dispatchingFrame_ && !cancelBatch_ && !retiredStreams_.empty()) {
+    auto const retired = std::move(retiredStreams_);
+    retiredStreams_.clear();
+  }
 }
 
 void RSocketStateMachine::onTerminal(folly::exception_wrapper ex) {
@@ -541,6 +1312,8 @@ void RSocketStateMachine::onKeepAliveFrame(
 
 void RSocketStateMachine::onMetadataPushFrame(
     std::unique_ptr<folly::IOBuf> metadata) {
+  EventBaseMonitor::ActivityScope activity{
+      EventBaseMonitor::Activity::RESPONDER};
   requestResponder_->handleMetadataPush(std::move(metadata));
 }
 
@@ -561,34 +1334,53 @@ void RSocketStateMachine::onResumeOkFrame(ResumePosition resumePosition) {
 
   if (coldResumeInProgress_) {
     setNextStreamId(resumeManager_->getLargestUsedStreamId());
-    for (const auto& it : resumeManager_->getStreamResumeInfos()) {
-      const auto streamId = it.first;
-      const StreamResumeInfo& streamResumeInfo = it.second;
-      if (streamResumeInfo.requester == RequestOriginator::LOCAL &&
-          streamResumeInfo.streamType == StreamType::STREAM) {
-        auto subscriber = coldResumeHandler_->handleRequesterResumeStream(
-            streamResumeInfo.streamToken, streamResumeInfo.consumerAllowance);
-
-        auto stateMachine = std::make_shared<StreamRequester>(
-            shared_from_this(), streamId, Payload());
-        // Set requested to true (since cold resumption)
-        stateMachine->setRequested(streamResumeInfo.consumerAllowance);
-        const auto result = streams_.emplace(streamId, stateMachine);
-        DCHECK(result.second);
-        stateMachine->subscribe(
-            std::make_shared<ScheduledSubscriptionSubscriber<Payload>>(
-                std::move(subscriber),
-                *folly::EventBaseManager::get()->getEventBase()));
-      }
-    }
+    resumeRequesterStreams();
     coldResumeInProgress_ = false;
   }
 
+  FOLLY_SDT(rsocket, client_resume_finish, this, resumePosition);
   auto resumeCallback = std::move(resumeCallback_);
   resumeCallback->onResumeOk();
   resumeFromPosition(resumePosition);
 }
 
+void RSocketStateMachine::resumeRequesterStreams() {
+  std::vector<ColdResumeHandler::RequesterResumeStream> streams;
+  for (const auto& it : resumeManager_->getStreamResumeInfos()) {
+    const StreamResumeInfo& streamResumeInfo = it.second;
+    if (streamResumeInfo.requester == RequestOriginator::LOCAL &&
+        streamResumeInfo.streamType == StreamType::STREAM) {
+      streams.push_back({it.first,
+                         streamResumeInfo.streamToken,
+                         streamResumeInfo.consumerAllowance});
+    }
+  }
+  if (streams.empty()) {
+    return;
+  }
+
+  auto const start = std::chrono::steady_clock::now();
+  auto subscribers = coldResumeHandler_->handleRequesterResumeStreams(streams);
+  stats_->coldResumeStreamsRestored(
+      streams.size(),
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start));
+  CHECK_EQ(streams.size(), subscribers.size());
+
+  auto& eventBase = *folly::EventBaseManager::get()->getEventBase();
+  for (size_t i = 0; i < streams.size(); ++i) {
+    auto const streamId = streams[i].streamId;
+    auto stateMachine = streamPool().make<StreamRequester>(
+        shared_from_this(), streamId, Payload());
+    // Set requested to true (since cold resumption)
+    stateMachine->setRequested(streams[i].consumerAllowance);
+    addStream(streamId, stateMachine);
+    stateMachine->subscribe(
+        std::make_shared<ScheduledSubscriptionSubscriber<Payload>>(
+            std::move(subscribers[i]), eventBase));
+  }
+}
+
 void RSocketStateMachine::onErrorFrame(
     StreamId streamId,
     ErrorCode errorCode,
@@ -598,16 +1390,9 @@ void RSocketStateMachine::onErrorFrame(
       return;
     }
     // we ignore  messages for streams which don't exist
-    if (auto stateMachine = getStreamStateMachine(streamId)) {
-      if (errorCode != ErrorCode::APPLICATION_ERROR) {
-        // Encapsulate non-user errors with runtime_error, which is more
-        // suitable for LOGging.
-        stateMachine->handleError(
-            std::runtime_error(payload.moveDataToString()));
-      } else {
-        // Don't expose user errors
-        stateMachine->handleError(ErrorWithPayload(std::move(payload)));
-      }
+    if (auto stateMachine = findStream(streamId)) {
+      stateMachine->handleError(
+          streamErrors_.error(errorCode, std::move(payload)));
     }
   } else {
     // TODO: handle INVALID_SETUP, UNSUPPORTED_SETUP, REJECTED_SETUP
@@ -639,8 +1424,254 @@ void RSocketStateMachine::onReservedFrame() {
   onUnexpectedFrame(0);
 }
 
-void RSocketStateMachine::onLeaseFrame() {
-  onUnexpectedFrame(0);
+void RSocketStateMachine::onLeaseFrame(
+    uint32_t ttl,
+    uint32_t numberOfRequests) {
+  if (mode_ != RSocketMode::CLIENT || !leaseEnabled_) {
+    onUnexpectedFrame(0);
+    return;
+  }
+
+  receivedLease_.grant(std::chrono::milliseconds{ttl}, numberOfRequests);
+  stats_->leaseReceived(numberOfRequests);
+
+  while (requestsAwaitingLease_ && !requestsAwaitingLease_->empty() &&
+         receivedLease_.available() && !isClosed()) {
+    auto request = std::move(requestsAwaitingLease_->front());
+    requestsAwaitingLease_->pop_front();
+    request(folly::exception_wrapper());
+  }
+}
+
+void RSocketStateMachine::sendLease() {
+  if (isClosed() || !leaseSender_) {
+    return;
+  }
+
+  auto lease = leaseSender_->nextLease();
+  if (!lease || lease->ttl.count() <= 0 || lease->numberOfRequests == 0) {
+    grantedLease_.clear();
+    scheduleLeaseRenewal(leaseSender_->retryInterval());
+    return;
+  }
+
+  auto const ttl = static_cast<uint32_t>(
+      std::min<int64_t>(lease->ttl.count(), Frame_LEASE::kMaxTtl));
+  auto const numberOfRequests =
+      std::min(lease->numberOfRequests, Frame_LEASE::kMaxNumRequests);
+  grantedLease_.grant(std::chrono::milliseconds{ttl}, numberOfRequests);
+
+  Frame_LEASE frame{ttl, numberOfRequests};
+  VLOG(3) << mode_ << " Out: " << frame;
+  outputFrameOrEnqueue(serializeOut(std::move(frame)));
+  stats_->leaseSent(numberOfRequests);
+
+  scheduleLeaseRenewal(std::chrono::milliseconds{ttl});
+}
+
+void RSocketStateMachine::scheduleLeaseRenewal(
+    std::chrono::milliseconds delay) {
+  auto const generation = ++leaseGeneration_;
+  auto const eventBase = folly::EventBaseManager::get()->getExistingEventBase();
+  if (!eventBase) {
+    LOG(ERROR) << "Cannot renew leases without an EventBase";
+    return;
+  }
+  eventBase->runAfterDelay(
+      [weakThis = std::weak_ptr<RSocketStateMachine>(shared_from_this()),
+       generation] {
+        auto self = weakThis.lock();
+        if (self && self->leaseGeneration_ == generation) {
+          self->sendLease();
+        }
+      },
+      static_cast<uint32_t>(std::max<int64_t>(delay.count(), 1)));
+}
+
+bool RSocketStateMachine::ensureLeaseGranted(
+    StreamId streamId,
+    bool rejectRequest) {
+  if (mode_ != RSocketMode::SERVER || !leaseEnabled_) {
+    return true;
+  }
+
+  if (grantedLease_.tryConsume()) {
+    if (grantedLease_.remaining() == 0) {
+      // Used up, ask for the next lease right away rather than at expiry.
+      sendLease();
+    }
+    return true;
+  }
+
+  stats_->requestWithoutLease();
+  if (rejectRequest) {
+    outputFrameOrEnqueue(serializeOut(
+        Frame_ERROR::rejected(streamId, "Request exceeds the lease")));
+  }
+  return false;
+}
+
+bool RSocketStateMachine::acquireLease() {
+  return mode_ != RSocketMode::CLIENT || !leaseEnabled_ ||
+      receivedLease_.tryConsume();
+}
+
+void RSocketStateMachine::awaitLease(
+    folly::Function<void(folly::exception_wrapper)> request) {
+  auto& queue = requestsAwaitingLease_;
+  if (!queue && maxRequestsAwaitingLease_ > 0) {
+    queue = std::make_unique<RequestQueue>();
+  }
+  if (queue && queue->size() < maxRequestsAwaitingLease_) {
+    queue->push_back(std::move(request));
+    return;
+  }
+  stats_->requestWithoutLease();
+  request(StreamErrors::noLease());
+}
+
+void RSocketStateMachine::failRequestsAwaitingLease() {
+  auto requests = std::move(requestsAwaitingLease_);
+  if (!requests) {
+    return;
+  }
+  for (auto& request : *requests) {
+    request(StreamErrors::disconnected());
+  }
+}
+
+bool RSocketStateMachine::hasStreamSlot() const {
+  return streamLimits_.maxActiveStreams == 0 ||
+      streams_.sizeWithParityOf(nextStreamId_) <
+          streamLimits_.maxActiveStreams;
+}
+
+void RSocketStateMachine::awaitStreamSlot(
+    folly::Function<void(folly::exception_wrapper)> request) {
+  stats_->streamLimitReached();
+  auto& queue = requestsAwaitingStreamSlot_;
+  if (!queue && streamLimits_.maxQueuedRequests > 0) {
+    queue = std::make_unique<RequestQueue>();
+  }
+  if (queue && queue->size() < streamLimits_.maxQueuedRequests) {
+    queue->push_back(std::move(request));
+    return;
+  }
+  request(StreamErrors::tooManyStreams());
+}
+
+void RSocketStateMachine::admitRequestsAwaitingStreamSlot() {
+  while (requestsAwaitingStreamSlot_ &&
+         !requestsAwaitingStreamSlot_->empty() && hasStreamSlot() &&
+         !isClosed()) {
+    auto request = std::move(requestsAwaitingStreamSlot_->front());
+    requestsAwaitingStreamSlot_->pop_front();
+    request(folly::exception_wrapper());
+  }
+}
+
+void RSocketStateMachine::failRequestsAwaitingStreamSlot() {
+  auto requests = std::move(requestsAwaitingStreamSlot_);
+  if (!requests) {
+    return;
+  }
+  for (auto& request : *requests) {
+    request(StreamErrors::disconnected());
+  }
+}
+
+bool RSocketStateMachine::ensureBelowPeerStreamLimit(StreamId streamId) {
+  if (streamLimits_.maxPeerActiveStreams == 0 ||
+      streams_.sizeWithParityOf(streamId) <
+          streamLimits_.maxPeerActiveStreams) {
+    return true;
+  }
+  stats_->streamLimitReached();
+  outputFrameOrEnqueue(serializeOut(
+      Frame_ERROR::rejected(streamId, "Too many active streams")));
+  return false;
+}
+
+bool RSocketStateMachine::ensureNotDraining(
+    StreamId streamId,
+    bool rejectRequest) {
+  if (!drain_) {
+    return true;
+  }
+  if (rejectRequest) {
+    outputFrameOrEnqueue(serializeOut(
+        Frame_ERROR::rejected(streamId, "Connection is draining")));
+  }
+  return false;
+}
+
+bool RSocketStateMachine::ensureAdmitted(
+    StreamId streamId,
+    bool rejectRequest) {
+  if (!admissionController_ || admissionController_->admit()) {
+    return true;
+  }
+  stats_->requestRejectedOverloaded();
+  if (rejectRequest) {
+    outputFrameOrEnqueue(serializeOut(
+        Frame_ERROR::rejected(streamId, "Server is overloaded")));
+  }
+  return false;
+}
+
+bool RSocketStateMachine::ensureMemoryAvailable(
+    StreamId streamId,
+    bool rejectRequest) {
+  if (!memoryPressure_ || memoryPressure_->admitStreams()) {
+    return true;
+  }
+  stats_->requestRejectedMemoryPressure();
+  if (rejectRequest) {
+    outputFrameOrEnqueue(serializeOut(
+        Frame_ERROR::rejected(streamId, "Memory pressure is critical")));
+  }
+  return false;
+}
+
+bool RSocketStateMachine::ensureTenantWithinByteRate(
+    StreamId streamId,
+    bool rejectRequest) {
+  if (!tenant_ || tenant_->withinByteRate()) {
+    return true;
+  }
+  stats_->tenantQuotaExceeded();
+  if (rejectRequest) {
+    outputFrameOrEnqueue(serializeOut(
+        Frame_ERROR::rejected(streamId, "Tenant is over its byte rate")));
+  }
+  return false;
+}
+
+bool RSocketStateMachine::ensureTenantStreamSlot(
+    StreamId streamId,
+    bool rejectRequest) {
+  if (!tenant_) {
+    return true;
+  }
+  if (!rejectRequest) {
+    tenant_->openStream();
+    return true;
+  }
+  if (tenant_->tryOpenStream()) {
+    return true;
+  }
+  // The request passed every other check, forget its deadline.
+  if (!streamDeadlines_.empty()) {
+    streamDeadlines_.erase(streamId);
+  }
+  stats_->tenantQuotaExceeded();
+  outputFrameOrEnqueue(serializeOut(Frame_ERROR::rejected(
+      streamId, "Too many active streams for the tenant")));
+  return false;
+}
+
+size_t RSocketStateMachine::peerStreams() const {
+  return streams_.sizeWithParityOf(nextStreamId_ + 1);
 }
 
 void RSocketStateMachine::onExtFrame() {
@@ -652,160 +1683,313 @@ void RSocketStateMachine::onUnexpectedFrame(StreamId streamId) {
   closeWithError(Frame_ERROR::connectionError(msg));
 }
 
+const std::array<RSocketStateMachine::FrameHandler, 64>
+    RSocketStateMachine::kFrameHandlers = [] {
+      std::array<FrameHandler, 64> handlers;
+      handlers.fill(&RSocketStateMachine::handleUnknownFrame);
+
+      auto set = [&](FrameType type, FrameHandler handler) {
+        handlers[static_cast<uint8_t>(type)] = handler;
+      };
+      set(FrameType::RESERVED, &RSocketStateMachine::handleReservedFrame);
+      set(FrameType::SETUP, &RSocketStateMachine::handleSetupFrame);
+      set(FrameType::LEASE, &RSocketStateMachine::handleLeaseFrame);
+      set(FrameType::KEEPALIVE, &RSocketStateMachine::handleKeepAliveFrame);
+      set(FrameType::REQUEST_RESPONSE,
+          &RSocketStateMachine::handleRequestResponseFrame);
+      set(FrameType::REQUEST_FNF,
+          &RSocketStateMachine::handleFireAndForgetFrame);
+      set(FrameType::REQUEST_STREAM,
+          &RSocketStateMachine::handleRequestStreamFrame);
+      set(FrameType::REQUEST_CHANNEL,
+          &RSocketStateMachine::handleRequestChannelFrame);
+      set(FrameType::REQUEST_N, &RSocketStateMachine::handleRequestNFrame);
+      set(FrameType::CANCEL, &RSocketStateMachine::handleCancelFrame);
+      set(FrameType::PAYLOAD, &RSocketStateMachine::handlePayloadFrame);
+      set(FrameType::ERROR, &RSocketStateMachine::handleErrorFrame);
+      set(FrameType::METADATA_PUSH,
+          &RSocketStateMachine::handleMetadataPushFrame);
+      set(FrameType::RESUME, &RSocketStateMachine::handleResumeFrame);
+      set(FrameType::RESUME_OK, &RSocketStateMachine::handleResumeOkFrame);
+      set(FrameType::EXT, &RSocketStateMachine::handleExtFrame);
+      return handlers;
+    }();
+
 void RSocketStateMachine::handleFrame(
-    StreamId streamId,
-    FrameType frameType,
+    const DecodedFrameHeader& header,
     std::unique_ptr<folly::IOBuf> payload) {
-  switch (frameType) {
-    case FrameType::KEEPALIVE: {
-      Frame_KEEPALIVE frame;
-      if (!deserializeFrameOrError(frame, std::move(payload))) {
-        return;
-      }
-      VLOG(3) << mode_ << " In: " << frame;
-      onKeepAliveFrame(
-          frame.position_,
-          std::move(frame.data_),
-          !!(frame.header_.flags & FrameFlags::KEEPALIVE_RESPOND));
-      return;
-    }
-    case FrameType::METADATA_PUSH: {
-      Frame_METADATA_PUSH frame;
-      if (!deserializeFrameOrError(frame, std::move(payload))) {
-        return;
-      }
-      VLOG(3) << mode_ << " In: " << frame;
-      onMetadataPushFrame(std::move(frame.metadata_));
-      return;
-    }
-    case FrameType::RESUME_OK: {
-      Frame_RESUME_OK frame;
-      if (!deserializeFrameOrError(frame, std::move(payload))) {
-        return;
-      }
-      VLOG(3) << mode_ << " In: " << frame;
-      onResumeOkFrame(frame.position_);
-      return;
-    }
-    case FrameType::ERROR: {
-      Frame_ERROR frame;
-      if (!deserializeFrameOrError(frame, std::move(payload))) {
-        return;
-      }
-      VLOG(3) << mode_ << " In: " << frame;
-      onErrorFrame(streamId, frame.errorCode_, std::move(frame.payload_));
-      return;
-    }
-    case FrameType::SETUP:
-      onSetupFrame();
-      return;
-    case FrameType::RESUME:
-      onResumeFrame();
-      return;
-    case FrameType::RESERVED:
-      onReservedFrame();
-      return;
-    case FrameType::LEASE:
-      onLeaseFrame();
-      return;
-    case FrameType::REQUEST_N: {
-      Frame_REQUEST_N frameRequestN;
-      if (!deserializeFrameOrError(frameRequestN, std::move(payload))) {
-        return;
-      }
-      VLOG(3) << mode_ << " In: " << frameRequestN;
-      onRequestNFrame(streamId, frameRequestN.requestN_);
-      break;
-    }
-    case FrameType::CANCEL: {
-      VLOG(3) << mode_ << " In: " << Frame_CANCEL(streamId);
-      onCancelFrame(streamId);
-      break;
-    }
-    case FrameType::PAYLOAD: {
-      Frame_PAYLOAD framePayload;
-      if (!deserializeFrameOrError(framePayload, std::move(payload))) {
-        return;
-      }
-      VLOG(3) << mode_ << " In: " << framePayload;
-      onPayloadFrame(
-          streamId,
-          std::move(framePayload.payload_),
-          framePayload.header_.flagsFollows(),
-          framePayload.header_.flagsComplete(),
-          framePayload.header_.flagsNext());
-      break;
-    }
-    case FrameType::REQUEST_CHANNEL: {
-      Frame_REQUEST_CHANNEL frame;
-      if (!deserializeFrameOrError(frame, std::move(payload))) {
-        return;
-      }
-      VLOG(3) << mode_ << " In: " << frame;
-      onRequestChannelFrame(
-          streamId,
-          frame.requestN_,
-          std::move(frame.payload_),
-          frame.header_.flagsComplete(),
-          frame.header_.flagsNext(),
-          frame.header_.flagsFollows());
-      break;
-    }
-    case FrameType::REQUEST_STREAM: {
-      Frame_REQUEST_STREAM frame;
-      if (!deserializeFrameOrError(frame, std::move(payload))) {
-        return;
-      }
-      VLOG(3) << mode_ << " In: " << frame;
-      onRequestStreamFrame(
-          streamId,
-          frame.requestN_,
-          std::move(frame.payload_),
-          frame.header_.flagsFollows());
-      break;
-    }
-    case FrameType::REQUEST_RESPONSE: {
-      Frame_REQUEST_RESPONSE frame;
-      if (!deserializeFrameOrError(frame, std::move(payload))) {
-        return;
-      }
-      VLOG(3) << mode_ << " In: " << frame;
-      onRequestResponseFrame(
-          streamId, std::move(frame.payload_), frame.header_.flagsFollows());
-      break;
-    }
-    case FrameType::REQUEST_FNF: {
-      Frame_REQUEST_FNF frame;
-      if (!deserializeFrameOrError(frame, std::move(payload))) {
-        return;
-      }
-      VLOG(3) << mode_ << " In: " << frame;
-      onFireAndForgetFrame(
-          streamId, std::move(frame.payload_), frame.header_.flagsFollows());
-      break;
-    }
-    case FrameType::EXT:
-      onExtFrame();
-      return;
+  const auto index = static_cast<uint8_t>(header.header.type);
+  DCHECK_LT(index, kFrameHandlers.size());
+  (this->*kFrameHandlers[index])(header, std::move(payload));
+}
 
-    default: {
-      stats_->unknownFrameReceived();
-      // per rsocket spec, we will ignore any other unknown frames
-      return;
-    }
+void RSocketStateMachine::handleKeepAliveFrame(
+    const DecodedFrameHeader&,
+    std::unique_ptr<folly::IOBuf> payload) {
+  Frame_KEEPALIVE frame;
+  if (!deserializeFrameOrError(frame, std::move(payload))) {
+    return;
+  }
+  VLOG(3) << mode_ << " In: " << frame;
+  onKeepAliveFrame(
+      frame.position_,
+      std::move(frame.data_),
+      !!(frame.header_.flags & FrameFlags::KEEPALIVE_RESPOND));
+}
+
+void RSocketStateMachine::handleMetadataPushFrame(
+    const DecodedFrameHeader&,
+    std::unique_ptr<folly::IOBuf> payload) {
+  Frame_METADATA_PUSH frame;
+  if (!deserializeFrameOrError(frame, std::move(payload))) {
+    return;
+  }
+  VLOG(3) << mode_ << " In: " << frame;
+  onMetadataPushFrame(std::move(frame.metadata_));
+}
+
+void RSocketStateMachine::handleResumeOkFrame(
+    const DecodedFrameHeader&,
+    std::unique_ptr<folly::IOBuf> payload) {
+  Frame_RESUME_OK frame;
+  if (!deserializeFrameOrError(frame, std::move(payload))) {
+    return;
   }
+  VLOG(3) << mode_ << " In: " << frame;
+  onResumeOkFrame(frame.position_);
+}
+
+void RSocketStateMachine::handleErrorFrame(
+    const DecodedFrameHeader& header,
+    std::unique_ptr<folly::IOBuf> payload) {
+  Frame_ERROR frame;
+  if (!deserializeFrameOrError(frame, std::move(payload), header)) {
+    return;
+  }
+  VLOG(3) << mode_ << " In: " << frame;
+  onErrorFrame(
+      header.header.streamId, frame.errorCode_, std::move(frame.payload_));
+}
+
+void RSocketStateMachine::handleSetupFrame(
+    const DecodedFrameHeader&,
+    std::unique_ptr<folly::IOBuf>) {
+  onSetupFrame();
+}
+
+void RSocketStateMachine::handleResumeFrame(
+    const DecodedFrameHeader&,
+    std::unique_ptr<folly::IOBuf>) {
+  onResumeFrame();
+}
+
+void RSocketStateMachine::handleReservedFrame(
+    const DecodedFrameHeader&,
+    std::unique_ptr<folly::IOBuf>) {
+  onReservedFrame();
+}
+
+void RSocketStateMachine::handleLeaseFrame(
+    const DecodedFrameHeader&,
+    std::unique_ptr<folly::IOBuf> payload) {
+  Frame_LEASE frame;
+  if (!deserializeFrameOrError(frame, std::move(payload))) {
+    return;
+  }
+  VLOG(3) << mode_ << " In: " << frame;
+  onLeaseFrame(frame.ttl_, frame.numberOfRequests_);
+}
+
+void RSocketStateMachine::handleRequestNFrame(
+    const DecodedFrameHeader& header,
+    std::unique_ptr<folly::IOBuf> payload) {
+  Frame_REQUEST_N frame;
+  if (!deserializeFrameOrError(frame, std::move(payload), header)) {
+    return;
+  }
+  VLOG(3) << mode_ << " In: " << frame;
+  onRequestNFrame(header.header.streamId, frame.requestN_);
+}
+
+void RSocketStateMachine::handleCancelFrame(
+    const DecodedFrameHeader& header,
+    std::unique_ptr<folly::IOBuf>) {
+  VLOG(3) << mode_ << " In: " << Frame_CANCEL(header.header.streamId);
+  onCancelFrame(header.header.streamId);
+}
+
+void RSocketStateMachine::handlePayloadFrame(
+    const DecodedFrameHeader& header,
+    std::unique_ptr<folly::IOBuf> payload) {
+  Frame_PAYLOAD frame;
+  if (!deserializeFrameOrError(frame, std::move(payload), header)) {
+    return;
+  }
+  VLOG(3) << mode_ << " In: " << frame;
+  onPayloadFrame(
+      header.header.streamId,
+      std::move(frame.payload_),
+      header.header.flagsFollows(),
+      header.header.flagsComplete(),
+      header.header.flagsNext());
+}
+
+void RSocketStateMachine::handleRequestChannelFrame(
+    const DecodedFrameHeader& header,
+    std::unique_ptr<folly::IOBuf> payload) {
+  Frame_REQUEST_CHANNEL frame;
+  if (!deserializeFrameOrError(frame, std::move(payload), header)) {
+    return;
+  }
+  VLOG(3) << mode_ << " In: " << frame;
+  onRequestChannelFrame(
+      header.header.streamId,
+      frame.requestN_,
+      std::move(frame.payload_),
+      header.header.flagsComplete(),
+      header.header.flagsNext(),
+      header.header.flagsFollows());
+}
+
+void RSocketStateMachine::handleRequestStreamFrame(
+    const DecodedFrameHeader& header,
+    std::unique_ptr<folly::IOBuf> payload) {
+  Frame_REQUEST_STREAM frame;
+  if (!deserializeFrameOrError(frame, std::move(payload), header)) {
+    return;
+  }
+  VLOG(3) << mode_ << " In: " << frame;
+  onRequestStreamFrame(
+      header.header.streamId,
+      frame.requestN_,
+      std::move(frame.payload_),
+      header.header.flagsFollows());
+}
+
+void RSocketStateMachine::handleRequestResponseFrame(
+    const DecodedFrameHeader& header,
+    std::unique_ptr<folly::IOBuf> payload) {
+  Frame_REQUEST_RESPONSE frame;
+  if (!deserializeFrameOrError(frame, std::move(payload), header)) {
+    return;
+  }
+  VLOG(3) << mode_ << " In: " << frame;
+  onRequestResponseFrame(
+      header.header.streamId,
+      std::move(frame.payload_),
+      header.header.flagsFollows());
+}
+
+void RSocketStateMachine::handleFireAndForgetFrame(
+    const DecodedFrameHeader& header,
+    std::unique_ptr<folly::IOBuf> payload) {
+  Frame_REQUEST_FNF frame;
+  if (!deserializeFrameOrError(frame, std::move(payload), header)) {
+    return;
+  }
+  VLOG(3) << mode_ << " In: " << frame;
+  onFireAndForgetFrame(
+      header.header.streamId,
+      std::move(frame.payload_),
+      header.header.flagsFollows());
+}
+
+void RSocketStateMachine::handleExtFrame(
+    const DecodedFrameHeader&,
+    std::unique_ptr<folly::IOBuf> payload) {
+  Frame_EXT frame;
+  if (!deserializeFrameOrError(frame, std::move(payload))) {
+    return;
+  }
+  VLOG(3) << mode_ << " In: " << frame;
+  if (byteCredit_ > 0 && frame.extendedType_ == ByteCredit::kExtendedType) {
+    onByteCreditFrame(frame);
+    return;
+  }
+  if (frame.extendedType_ == RequestDeadline::kExtendedType) {
+    onRequestDeadlineFrame(frame);
+    return;
+  }
+  if (!!(frame.header_.flags & FrameFlags::IGNORE_)) {
+    stats_->unknownFrameReceived();
+    return;
+  }
+  onExtFrame();
+}
+
+void RSocketStateMachine::handleUnknownFrame(
+    const DecodedFrameHeader&,
+    std::unique_ptr<folly::IOBuf>) {
+  stats_->unknownFrameReceived();
+  // per rsocket spec, we will ignore any other unknown frames
 }
 
 std::shared_ptr<StreamStateMachineBase>
 RSocketStateMachine::getStreamStateMachine(StreamId streamId) {
-  const auto&& it = streams_.find(streamId);
-  if (it == streams_.end()) {
+  auto const stateMachine = streams_.find(streamId);
+  if (!stateMachine) {
     return nullptr;
   }
   // we are purposely making a copy of the reference here to avoid problems with
   // lifetime of the stateMachine when a terminating signal is delivered which
   // will cause the stateMachine to be destroyed while in one of its methods
-  return it->second;
+  return *stateMachine;
+}
+
+StreamStateMachineBase* RSocketStateMachine::findStream(StreamId streamId) {
+  DCHECK(dispatchingFrame_);
+  auto const stateMachine = streams_.find(streamId);
+  return stateMachine ? stateMachine->get() : nullptr;
+}
+
+void RSocketStateMachine::retireStream(
+    std::shared_ptr<StreamStateMachineBase> stateMachine) {
+  if (dispatchingFrame_ || cancelBatch_) {
+    retiredStreams_.push_back(std::move(stateMachine));
+  }
+}
+
+void RSocketStateMachine::beginCancelBatch() {
+  if (cancelBatch_) {
+    return;
+  }
+  // Without a loop to end it, every CANCEL is processed on its own.
+  auto const eventBase =
+      folly::EventBaseManager::get()->getExistingEventBase();
+  if (!eventBase) {
+    return;
+  }
+  cancelBatch_ = true;
+  eventBase->runInLoop(
+      [weakThis = std::weak_ptr<RSocketStateMachine>(shared_from_this())] {
+        if (auto self = weakThis.lock()) {
+          self->endCancelBatch();
+        }
+      });
+}
+
+void RSocketStateMachine::endCancelBatch() {
+  if (!cancelBatch_) {
+    return;
+  }
+  cancelBatch_ = false;
+
+  auto const peerStreams = std::exchange(cancelBatchPeerStreams_, 0);
+  if (tenant_ && peerStreams > 0) {
+    tenant_->closeStreams(peerStreams);
+  }
+  if (!dispatchingFrame_) {
+    auto const retired = std::move(retiredStreams_);
+    retiredStreams_.clear();
+  }
+  if (isClosed()) {
+    return;
+  }
+
+  admitRequestsAwaitingStreamSlot();
+  if (drain_ && streams_.empty()) {
+    closeDrained();
+  }
 }
 
 bool RSocketStateMachine::ensureNotInResumption() {
@@ -829,17 +2013,44 @@ void RSocketStateMachine::onRequestNFrame(
     return;
   }
   // we ignore  messages for streams which don't exist
-  if (auto stateMachine = getStreamStateMachine(streamId)) {
+  if (auto stateMachine = findStream(streamId)) {
     stateMachine->handleRequestN(requestN);
   }
 }
 
+void RSocketStateMachine::onByteCreditFrame(const Frame_EXT& frame) {
+  auto const bytes = ByteCredit::parseGrant(frame);
+  if (!bytes || frame.header_.streamId == 0) {
+    closeWithError(Frame_ERROR::connectionError("Invalid byte credit frame"));
+    return;
+  }
+  if (!ensureNotInResumption()) {
+    return;
+  }
+  // Grants may cross the end of the stream.
+  if (auto stateMachine = findStream(frame.header_.streamId)) {
+    stateMachine->handleByteCredit(*bytes);
+  }
+}
+
+void RSocketStateMachine::onRequestDeadlineFrame(const Frame_EXT& frame) {
+  auto const left = RequestDeadline::parse(frame);
+  if (!left || frame.header_.streamId == 0) {
+    // Peers are free to ignore the frame, so a malformed one is harmless.
+    VLOG(3) << mode_ << " Ignoring invalid deadline frame";
+    stats_->unknownFrameReceived();
+    return;
+  }
+  incomingDeadline_ = std::make_pair(
+      frame.header_.streamId, RequestDeadline::Clock::now() + *left);
+}
+
 void RSocketStateMachine::onCancelFrame(StreamId streamId) {
   if (!ensureNotInResumption()) {
     return;
   }
   // we ignore  messages for streams which don't exist
-  if (auto stateMachine = getStreamStateMachine(streamId)) {
+  if (auto stateMachine = findStream(streamId)) {
     stateMachine->handleCancel();
   }
 }
@@ -854,9 +2065,17 @@ void RSocketStateMachine::onPayloadFrame(
     return;
   }
   // we ignore  messages for streams which don't exist
-  if (auto stateMachine = getStreamStateMachine(streamId)) {
-    stateMachine->handlePayload(
-        std::move(payload), flagsComplete, flagsNext, flagsFollows);
+  if (auto stateMachine = findStream(streamId)) {
+    if (!ensureWithinReassemblyLimit(
+            stateMachine->payloadFragments(), payload, flagsFollows)) {
+      return;
+    }
+    handleStreamPayload(
+        *stateMachine,
+        std::move(payload),
+        flagsComplete,
+        flagsNext,
+        flagsFollows);
   }
 }
 
@@ -865,14 +2084,29 @@ void RSocketStateMachine::onRequestStreamFrame(
     uint32_t requestN,
     Payload payload,
     bool flagsFollows) {
-  if (!ensureNotInResumption() || !isNewStreamId(streamId)) {
+  if (!ensureNotInResumption() || !isNewStreamId(streamId) ||
+      !ensureNotDraining(streamId, true) ||
+      !ensureAdmitted(streamId, true) ||
+      !ensureMemoryAvailable(streamId, true) ||
+      !ensureTenantWithinByteRate(streamId, true) ||
+      !ensureBelowPeerStreamLimit(streamId) ||
+      !ensureLeaseGranted(streamId, true) ||
+      !ensureWithinReassemblyLimit(
+          StreamFragmentAccumulator(fragmentReassemblyOptions_),
+          payload,
+          flagsFollows) ||
+      !ensureBeforeDeadline(streamId, StreamType::STREAM) ||
+      !ensureTenantStreamSlot(streamId, true)) {
     return;
   }
-  auto stateMachine =
-      std::make_shared<StreamResponder>(shared_from_this(), streamId, requestN);
-  const auto result = streams_.emplace(streamId, stateMachine);
-  DCHECK(result.second); // ensured by calling isNewStreamId
-  stateMachine->handlePayload(std::move(payload), false, false, flagsFollows);
+  auto stateMachine = streamPool().make<StreamResponder>(
+      shared_from_this(), streamId, requestN);
+  addStream(streamId, stateMachine);
+  if (outputPaused()) {
+    stateMachine->handleOutputPaused(true);
+  }
+  handleStreamPayload(
+      *stateMachine, std::move(payload), false, false, flagsFollows);
 }
 
 void RSocketStateMachine::onRequestChannelFrame(
@@ -882,43 +2116,125 @@ void RSocketStateMachine::onRequestChannelFrame(
     bool flagsComplete,
     bool flagsNext,
     bool flagsFollows) {
-  if (!ensureNotInResumption() || !isNewStreamId(streamId)) {
+  if (!ensureNotInResumption() || !isNewStreamId(streamId) ||
+      !ensureNotDraining(streamId, true) ||
+      !ensureAdmitted(streamId, true) ||
+      !ensureMemoryAvailable(streamId, true) ||
+      !ensureTenantWithinByteRate(streamId, true) ||
+      !ensureBelowPeerStreamLimit(streamId) ||
+      !ensureLeaseGranted(streamId, true) ||
+      !ensureWithinReassemblyLimit(
+          StreamFragmentAccumulator(fragmentReassemblyOptions_),
+          payload,
+          flagsFollows) ||
+      !ensureBeforeDeadline(streamId, StreamType::CHANNEL) ||
+      !ensureTenantStreamSlot(streamId, true)) {
     return;
   }
-  auto stateMachine = std::make_shared<ChannelResponder>(
+  auto stateMachine = streamPool().make<ChannelResponder>(
       shared_from_this(), streamId, requestN);
-  const auto result = streams_.emplace(streamId, stateMachine);
-  DCHECK(result.second); // ensured by calling isNewStreamId
-  stateMachine->handlePayload(
-      std::move(payload), flagsComplete, flagsNext, flagsFollows);
+  addStream(streamId, stateMachine);
+  if (outputPaused()) {
+    stateMachine->handleOutputPaused(true);
+  }
+  handleStreamPayload(
+      *stateMachine,
+      std::move(payload),
+      flagsComplete,
+      flagsNext,
+      flagsFollows);
 }
 
 void RSocketStateMachine::onRequestResponseFrame(
     StreamId streamId,
     Payload payload,
     bool flagsFollows) {
-  if (!ensureNotInResumption() || !isNewStreamId(streamId)) {
+  if (!ensureNotInResumption() || !isNewStreamId(streamId) ||
+      !ensureNotDraining(streamId, true) ||
+      !ensureAdmitted(streamId, true) ||
+      !ensureMemoryAvailable(streamId, true) ||
+      !ensureTenantWithinByteRate(streamId, true) ||
+      !ensureBelowPeerStreamLimit(streamId) ||
+      !ensureLeaseGranted(streamId, true) ||
+      !ensureWithinReassemblyLimit(
+          StreamFragmentAccumulator(fragmentReassemblyOptions_),
+          payload,
+          flagsFollows) ||
+      !ensureBeforeDeadline(streamId, StreamType::REQUEST_RESPONSE) ||
+      !ensureTenantStreamSlot(streamId, true)) {
     return;
   }
+  setOutputWeight(streamId, StreamType::REQUEST_RESPONSE, 0);
   auto stateMachine =
-      std::make_shared<RequestResponseResponder>(shared_from_this(), streamId);
-  const auto result = streams_.emplace(streamId, stateMachine);
-  DCHECK(result.second); // ensured by calling isNewStreamId
-  stateMachine->handlePayload(std::move(payload), false, false, flagsFollows);
+      streamPool().make<RequestResponseResponder>(shared_from_this(), streamId);
+  addStream(streamId, stateMachine);
+  handleStreamPayload(
+      *stateMachine, std::move(payload), false, false, flagsFollows);
 }
 
 void RSocketStateMachine::onFireAndForgetFrame(
     StreamId streamId,
     Payload payload,
     bool flagsFollows) {
-  if (!ensureNotInResumption() || !isNewStreamId(streamId)) {
+  if (!ensureNotInResumption() || !isNewStreamId(streamId) ||
+      !ensureNotDraining(streamId, false) ||
+      !ensureAdmitted(streamId, false) ||
+      !ensureMemoryAvailable(streamId, false) ||
+      !ensureTenantWithinByteRate(streamId, false) ||
+      !ensureLeaseGranted(streamId, false) ||
+      !ensureWithinReassemblyLimit(
+          StreamFragmentAccumulator(fragmentReassemblyOptions_),
+          payload,
+          flagsFollows) ||
+      !ensureBeforeDeadline(streamId, StreamType::FNF) ||
+      !ensureTenantStreamSlot(streamId, false)) {
     return;
   }
   auto stateMachine =
-      std::make_shared<FireAndForgetResponder>(shared_from_this(), streamId);
-  const auto result = streams_.emplace(streamId, stateMachine);
-  DCHECK(result.second); // ensured by calling isNewStreamId
-  stateMachine->handlePayload(std::move(payload), false, false, flagsFollows);
+      streamPool().make<FireAndForgetResponder>(shared_from_this(), streamId);
+  addStream(streamId, stateMachine);
+  handleStreamPayload(
+      *stateMachine, std::move(payload), false, false, flagsFollows);
+}
+
+bool RSocketStateMachine::ensureWithinReassemblyLimit(
+    const StreamFragmentAccumulator& fragments,
+    const Payload& payload,
+    bool flagsFollows) {
+  if (!fragments.exceedsMaxSize(payload, flagsFollows)) {
+    return true;
+  }
+  constexpr auto msg = "Fragmented payload exceeds the reassembly limit";
+  closeWithError(Frame_ERROR::connectionError(msg));
+  return false;
+}
+
+bool RSocketStateMachine::ensureBeforeDeadline(
+    StreamId streamId,
+    StreamType streamType) {
+  if (FOLLY_LIKELY(!incomingDeadline_)) {
+    return true;
+  }
+  auto const incoming = std::move(*incomingDeadline_);
+  incomingDeadline_.reset();
+  if (incoming.first != streamId) {
+    return true;
+  }
+
+  auto const deadline = incoming.second;
+  if (deadline <= RequestDeadline::Clock::now()) {
+    // As if the requester had cancelled the request already.
+    VLOG(3) << mode_ << " Dropping request on stream " << streamId
+            << ", its deadline passed";
+    stats_->requestDeadlineExpired();
+    return false;
+  }
+  streamDeadlines_.emplace(streamId, deadline);
+  setOutputDeadline(streamId, deadline);
+  if (streamType != StreamType::FNF) {
+    scheduleStreamDeadline(streamId, deadline);
+  }
+  return true;
 }
 
 bool RSocketStateMachine::isNewStreamId(StreamId streamId) {
@@ -942,6 +2258,9 @@ RSocketStateMachine::onNewStreamReady(
         streamId, RequestOriginator::REMOTE, streamToken, streamType);
   }
 
+  RequestDeadline::Scope deadline(streamDeadline(streamId));
+  EventBaseMonitor::ActivityScope activity{
+      EventBaseMonitor::Activity::RESPONDER};
   switch (streamType) {
     case StreamType::CHANNEL:
       return requestResponder_->handleRequestChannel(
@@ -980,6 +2299,9 @@ void RSocketStateMachine::onNewStreamReady(
     resumeManager_->onStreamOpen(
         streamId, RequestOriginator::REMOTE, streamToken, streamType);
   }
+  RequestDeadline::Scope deadline(streamDeadline(streamId));
+  EventBaseMonitor::ActivityScope activity{
+      EventBaseMonitor::Activity::RESPONDER};
   requestResponder_->handleRequestResponse(
       std::move(payload), streamId, std::move(response));
 }
@@ -991,13 +2313,44 @@ void RSocketStateMachine::sendKeepalive(std::unique_ptr<folly::IOBuf> data) {
 void RSocketStateMachine::sendKeepalive(
     FrameFlags flags,
     std::unique_ptr<folly::IOBuf> data) {
-  Frame_KEEPALIVE pingFrame(
-      flags, resumeManager_->impliedPosition(), std::move(data));
+  lastAckedPosition_ = resumeManager_->impliedPosition();
+  Frame_KEEPALIVE pingFrame(flags, lastAckedPosition_, std::move(data));
   VLOG(3) << mode_ << " Out: " << pingFrame;
-  outputFrameOrEnqueue(frameSerializer_->serializeOut(std::move(pingFrame)));
+  outputFrameOrEnqueue(serializeOut(std::move(pingFrame)));
   stats_->keepaliveSent();
 }
 
+void RSocketStateMachine::acknowledgeReceivedFrames() {
+  auto const unacked = resumeManager_->impliedPosition() - lastAckedPosition_;
+  if (unacked < static_cast<ResumePosition>(resumeAckThreshold_) ||
+      isClosed() || isDisconnected() || resumeCallback_) {
+    return;
+  }
+  VLOG(5) << "Acknowledging " << unacked << " received bytes";
+  // Only clients may ask for an answer.  The server's answer carries its own
+  // position, which trims the resume buffer of the client in turn.
+  sendKeepalive(
+      mode_ == RSocketMode::CLIENT ? FrameFlags::KEEPALIVE_RESPOND
+                                   : FrameFlags::EMPTY_,
+      folly::IOBuf::create(0));
+}
+
+bool RSocketStateMachine::needsKeepaliveFrames() const {
+  if (!keepaliveSuppression_) {
+    return true;
+  }
+  if (!isResumable_) {
+    return false;
+  }
+  // The keepalive is still due if it carries a position the peer hasn't seen.
+  return resumeManager_->impliedPosition() > lastAckedPosition_;
+}
+
+void RSocketStateMachine::keepaliveSuppressed() {
+  VLOG(5) << mode_ << " Suppressed keepalive";
+  stats_->keepaliveSuppressed();
+}
+
 bool RSocketStateMachine::isPositionAvailable(ResumePosition position) const {
   return resumeManager_->isPositionAvailable(position);
 }
@@ -1017,8 +2370,7 @@ bool RSocketStateMachine::resumeFromPositionOrClose(
       resumeManager_->isPositionAvailable(serverPosition)) {
     Frame_RESUME_OK resumeOkFrame{resumeManager_->impliedPosition()};
     VLOG(3) << "Out: " << resumeOkFrame;
-    frameTransport_->outputFrameOrDrop(
-        frameSerializer_->serializeOut(std::move(resumeOkFrame)));
+    frameTransport_->outputFrameOrDrop(serializeOut(std::move(resumeOkFrame)));
     resumeFromPosition(serverPosition);
     return true;
   }
@@ -1043,48 +2395,437 @@ void RSocketStateMachine::resumeFromPosition(ResumePosition position) {
   if (connectionEvents_) {
     connectionEvents_->onStreamsResumed();
   }
-  resumeManager_->sendFramesFromPosition(position, *frameTransport_);
 
-  auto frames = consumePendingOutputFrames();
-  for (auto& frame : frames) {
-    outputFrameOrEnqueue(std::move(frame));
+  replayPosition_ = position;
+  // A replay still scheduled from an earlier transport picks up from here.
+  if (!replayScheduled_) {
+    replayFrames();
   }
+}
+
+void RSocketStateMachine::replayFrames() {
+  auto const& options = resumeReplayOptions_;
+  while (replayPosition_ && !isDisconnected()) {
+    auto const position = *replayPosition_;
+    if (position == resumeManager_->lastSentPosition()) {
+      replayPosition_.reset();
+      finishReplay();
+      return;
+    }
+
+    // The ResumeManager may have dropped frames to stay within a budget.
+    if (!resumeManager_->isPositionAvailable(position)) {
+      replayPosition_.reset();
+      closeWithError(Frame_ERROR::connectionError(
+          "Frames to replay were dropped from the resume buffer"));
+      return;
+    }
+
+    if (options.maxBufferedOutputBytes > 0 &&
+        frameTransport_->bufferedOutputBytes() >=
+            options.maxBufferedOutputBytes) {
+      VLOG(4) << "Waiting for the transport to write out before replaying";
+      replayAwaitingOutput_ = true;
+      return;
+    }
+
+    auto const maxBytes = options.maxBytesPerLoop > 0
+        ? options.maxBytesPerLoop
+        : std::numeric_limits<size_t>::max();
+    replayPosition_ = resumeManager_->sendFramesFromPositionUpTo(
+        position, *frameTransport_, maxBytes);
+    if (*replayPosition_ != resumeManager_->lastSentPosition() &&
+        scheduleReplay()) {
+      return;
+    }
+  }
+}
+
+bool RSocketStateMachine::scheduleReplay() {
+  auto const eventBase = folly::EventBaseManager::get()->getExistingEventBase();
+  if (!eventBase) {
+    return false;
+  }
+  replayScheduled_ = true;
+  eventBase->runInLoop(
+      [weakThis = std::weak_ptr<RSocketStateMachine>(shared_from_this())] {
+        if (auto self = weakThis.lock()) {
+          self->replayScheduled_ = false;
+          self->replayFrames();
+        }
+      });
+  return true;
+}
+
+void RSocketStateMachine::finishReplay() {
+  if (auto frames = consumePendingOutputFrames()) {
+    for (auto& frame : *frames) {
+      outputFrameOrEnqueue(std::move(frame));
+    }
+  }
+  updatePendingOutputPaused();
 
   if (!isDisconnected() && keepaliveTimer_) {
     keepaliveTimer_->start(shared_from_this());
   }
 }
 
+void RSocketStateMachine::onTransportOutputWritten() {
+  updateTransportOutputPaused();
+  if (replayAwaitingOutput_) {
+    replayAwaitingOutput_ = false;
+    // Not from within the write callback of the transport.
+    if (!scheduleReplay()) {
+      replayFrames();
+    }
+  }
+}
+
+size_t RSocketStateMachine::maxFragmentSize() const {
+  if (!fragmentSizeOptions_) {
+    return StreamsWriterImpl::maxFragmentSize();
+  }
+  auto const now = std::chrono::steady_clock::now();
+  if (now >= fragmentSizeExpiry_) {
+    auto const info = frameTransport_ ? frameTransport_->transportInfo()
+                                      : DuplexConnection::TransportInfo();
+    fragmentSize_ =
+        adaptiveFragmentSize(*fragmentSizeOptions_, info, streams_.size());
+    fragmentSizeExpiry_ = now + fragmentSizeOptions_->refreshInterval;
+    VLOG(5) << "Fragment size " << fragmentSize_ << " for "
+            << streams_.size() << " streams";
+  }
+  return fragmentSize_;
+}
+
 bool RSocketStateMachine::shouldQueue() {
-  // if we are resuming we cant send any frames until we receive RESUME_OK
-  return isDisconnected() || resumeCallback_;
+  // if we are resuming we cant send any frames until we receive RESUME_OK,
+  // nor before the frames to replay have all been sent
+  return isDisconnected() || resumeCallback_ || replayPosition_.hasValue();
 }
 
-void RSocketStateMachine::fireAndForget(Payload request) {
+void RSocketStateMachine::fireAndForget(
+    Payload request,
+    folly::Optional<RequestDeadline::Clock::time_point> deadline) {
+  if (pendingOutputPaused()) {
+    VLOG(3) << "Dropping fire-and-forget request, too many frames are pending";
+    return;
+  }
+
+  if (!acquireLease()) {
+    awaitLease([this, request = std::move(request), deadline](
+                   folly::exception_wrapper ew) mutable {
+      if (ew) {
+        VLOG(3) << "Dropping fire-and-forget request: " << ew.what();
+        return;
+      }
+      fireAndForget(std::move(request), deadline);
+    });
+    return;
+  }
+
   auto const streamId = getNextStreamId();
+  if (deadline) {
+    // Takes the same path as the request, to stay ahead of it.
+    outputFrameOrEnqueue(
+        serializeOut(RequestDeadline::frame(streamId, *deadline)));
+  }
   Frame_REQUEST_FNF frame{streamId, FrameFlags::EMPTY_, std::move(request)};
-  outputFrameOrEnqueue(frameSerializer_->serializeOut(std::move(frame)));
+  outputFrameOrEnqueue(serializeOut(std::move(frame)));
+}
+
+void RSocketStateMachine::fireAndForgetBatch(std::vector<Payload> requests) {
+  if (pendingOutputPaused()) {
+    VLOG(3) << "Dropping " << requests.size()
+            << " fire-and-forget requests, too many frames are pending";
+    return;
+  }
+
+  std::vector<std::unique_ptr<folly::IOBuf>> frames;
+  frames.reserve(requests.size());
+  for (auto& request : requests) {
+    if (!acquireLease()) {
+      // Goes through the regular path, to wait for a lease.
+      fireAndForget(std::move(request));
+      continue;
+    }
+    auto const streamId = getNextStreamId();
+    frames.push_back(serializeOut(
+        Frame_REQUEST_FNF{streamId, FrameFlags::EMPTY_, std::move(request)}));
+  }
+
+  if (frames.empty()) {
+    return;
+  }
+
+  if (shouldQueue()) {
+    for (auto& frame : frames) {
+      enqueuePendingOutputFrame(std::move(frame));
+    }
+    return;
+  }
+  outputFrames(std::move(frames));
 }
 
 void RSocketStateMachine::metadataPush(std::unique_ptr<folly::IOBuf> metadata) {
   Frame_METADATA_PUSH metadataPushFrame{std::move(metadata)};
+  outputFrameOrEnqueue(serializeOut(std::move(metadataPushFrame)));
+}
+
+bool RSocketStateMachine::metadataPushSerialized(
+    std::unique_ptr<folly::IOBuf> frame,
+    ProtocolVersion version) {
+  if (isClosed() || !frameSerializer_ ||
+      frameSerializer_->protocolVersion() != version) {
+    return false;
+  }
+  outputFrameOrEnqueue(std::move(frame));
+  return true;
+}
+
+bool RSocketStateMachine::fireAndForgetSerialized(
+    std::unique_ptr<folly::IOBuf> frame,
+    ProtocolVersion version) {
+  if (isClosed() || !frameSerializer_ ||
+      frameSerializer_->protocolVersion() != version) {
+    return false;
+  }
+  if (pendingOutputPaused()) {
+    VLOG(3) << "Dropping fire-and-forget request, too many frames are pending";
+    return false;
+  }
+
+  if (!acquireLease()) {
+    awaitLease([this, frame = std::move(frame), version](
+                   folly::exception_wrapper ew) mutable {
+      if (ew) {
+        VLOG(3) << "Dropping fire-and-forget request: " << ew.what();
+        return;
+      }
+      fireAndForgetSerialized(std::move(frame), version);
+    });
+    return true;
+  }
+
+  auto const streamId = getNextStreamId();
   outputFrameOrEnqueue(
-      frameSerializer_->serializeOut(std::move(metadataPushFrame)));
+      frameSerializer_->rewriteStreamId(std::move(frame), streamId));
+  return true;
 }
 
 void RSocketStateMachine::outputFrame(std::unique_ptr<folly::IOBuf> frame) {
   DCHECK(!isDisconnected());
+  if (batchingRequest_) {
+    batchRequestFrame(std::move(frame));
+    return;
+  }
+  if (FOLLY_UNLIKELY(!requestBatch_.empty())) {
+    // Shares the write of the batch, behind it.
+    requestBatch_.push_back(std::move(frame));
+    flushRequestBatch();
+    return;
+  }
+  trackOutputFrame(*frame);
+  frameTransport_->outputFrameOrDrop(std::move(frame));
+  if (!transportOutputPaused_) {
+    updateTransportOutputPaused();
+  }
+}
 
-  const auto frameType = frameSerializer_->peekFrameType(*frame);
-  stats_->frameWritten(frameType);
+void RSocketStateMachine::outputFrames(
+    std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+  DCHECK(!isDisconnected());
+  if (!requestBatch_.empty()) {
+    for (auto& frame : frames) {
+      requestBatch_.push_back(std::move(frame));
+    }
+    flushRequestBatch();
+    return;
+  }
+  writeFrames(std::move(frames));
+}
 
-  if (isResumable_) {
-    auto streamIdPtr = frameSerializer_->peekStreamId(*frame, false);
-    CHECK(streamIdPtr) << "Error in serialized frame.";
-    resumeManager_->trackSentFrame(
-        *frame, frameType, *streamIdPtr, getConsumerAllowance(*streamIdPtr));
+void RSocketStateMachine::batchRequestFrame(
+    std::unique_ptr<folly::IOBuf> frame) {
+  auto const& options = *batchingRequest_;
+  requestBatchBytes_ += frame->computeChainDataLength();
+  requestBatch_.push_back(std::move(frame));
+  if (requestBatchBytes_ >= options.maxBytes) {
+    flushRequestBatch();
+    return;
+  }
+
+  // The batch is written by the earliest time one of its requests may wait
+  // until.
+  auto const due = std::chrono::steady_clock::now() + options.maxDelay;
+  if (requestBatch_.size() > 1 && due >= requestBatchDue_) {
+    return;
+  }
+  requestBatchDue_ = due;
+
+  auto const eventBase = folly::EventBaseManager::get()->getExistingEventBase();
+  if (!eventBase) {
+    flushRequestBatch();
+    return;
+  }
+  auto flush = [weakThis = std::weak_ptr<RSocketStateMachine>(
+                    shared_from_this()),
+                generation = requestBatchGeneration_] {
+    auto const self = weakThis.lock();
+    if (self && self->requestBatchGeneration_ == generation) {
+      self->flushRequestBatch();
+    }
+  };
+  if (options.maxDelay.count() == 0) {
+    eventBase->runInLoop(std::move(flush));
+  } else {
+    eventBase->runAfterDelay(
+        std::move(flush), static_cast<uint32_t>(options.maxDelay.count()));
+  }
+}
+
+void RSocketStateMachine::flushRequestBatch() {
+  if (requestBatch_.empty()) {
+    return;
+  }
+  ++requestBatchGeneration_;
+  requestBatchBytes_ = 0;
+  auto frames = std::move(requestBatch_);
+  requestBatch_.clear();
+  writeFrames(std::move(frames));
+}
+
+void RSocketStateMachine::writeFrames(
+    std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+  DCHECK(!isDisconnected());
+  for (auto& frame : frames) {
+    trackOutputFrame(*frame);
+  }
+  frameTransport_->outputFramesOrDrop(std::move(frames));
+  if (!transportOutputPaused_) {
+    updateTransportOutputPaused();
+  }
+}
+
+void RSocketStateMachine::trackOutputFrame(const folly::IOBuf& frame) {
+  if (FOLLY_UNLIKELY(frameCapture_ != nullptr)) {
+    frameCapture_->record(FrameCapture::Direction::OUT, frame);
+  }
+
+  if (FrameTracer::enabled()) {
+    const auto decoded =
+        visitFrameSerializer(*frameSerializer_, [&](const auto& s) {
+          return s.decodeFrameHeader(frame);
+        });
+    if (decoded && FrameTracer::sampled(decoded->header.streamId)) {
+      FrameTracer::record(
+          FrameTracer::Point::WRITTEN,
+          decoded->header.streamId,
+          decoded->header.type);
+    }
+  }
+
+  if (!isResumable_) {
+    stats_->frameWritten(
+        visitFrameSerializer(*frameSerializer_, [&](const auto& s) {
+          return s.peekFrameType(frame);
+        }));
+    return;
+  }
+
+  // The resume manager needs the stream id as well, so decode the header in
+  // one pass instead of peeking at each field.
+  const auto decoded =
+      visitFrameSerializer(*frameSerializer_, [&](const auto& s) {
+        return s.decodeFrameHeader(frame);
+      });
+  CHECK(decoded) << "Error in serialized frame.";
+  const auto& header = decoded->header;
+  stats_->frameWritten(header.type);
+  if (header.flagsUntracked()) {
+    return;
+  }
+  resumeManager_->trackSentFrame(
+      frame,
+      header.type,
+      header.streamId,
+      getConsumerAllowance(header.streamId));
+}
+
+void RSocketStateMachine::scheduleOutput() {
+  auto const eventBase = folly::EventBaseManager::get()->getExistingEventBase();
+  if (!eventBase) {
+    StreamsWriterImpl::scheduleOutput();
+    return;
+  }
+  eventBase->runInLoop(
+      [weakThis = std::weak_ptr<RSocketStateMachine>(shared_from_this())] {
+        if (auto self = weakThis.lock()) {
+          self->drainScheduledFrames();
+        }
+      });
+}
+
+void RSocketStateMachine::onPendingOutputPaused(bool paused) {
+  if (!transportOutputPaused_) {
+    setStreamsOutputPaused(paused);
+  }
+}
+
+void RSocketStateMachine::updateTransportOutputPaused() {
+  auto const& options = transportOutputOptions_;
+  if (options.highWatermark == 0 || !frameTransport_) {
+    return;
+  }
+  auto const buffered = frameTransport_->bufferedOutputBytes();
+  if (!transportOutputPaused_) {
+    if (buffered < options.highWatermark) {
+      return;
+    }
+    VLOG(3) << "Transport buffers " << buffered << " bytes of output";
+  } else if (buffered > options.lowWatermark) {
+    return;
+  }
+  transportOutputPaused_ = !transportOutputPaused_;
+  if (!pendingOutputPaused()) {
+    setStreamsOutputPaused(transportOutputPaused_);
+  }
+}
+
+void RSocketStateMachine::setStreamsOutputPaused(bool paused) {
+  VLOG(2) << (paused ? "Pausing" : "Resuming") << " output of streams";
+
+  // Resuming a stream may close it, so don't walk the table while doing so.
+  std::vector<std::shared_ptr<StreamStateMachineBase>> streams;
+  streams.reserve(streams_.size());
+  streams_.forEach([&](StreamId, const auto& stateMachine) {
+    streams.push_back(stateMachine);
+  });
+  for (auto& stateMachine : streams) {
+    stateMachine->handleOutputPaused(paused);
+  }
+}
+
+void RSocketStateMachine::setOutputWeight(
+    StreamId streamId,
+    StreamType streamType,
+    uint32_t weight) {
+  auto const scheduler = outputScheduler();
+  if (!scheduler) {
+    return;
+  }
+  if (weight == 0 && streamType == StreamType::REQUEST_RESPONSE) {
+    weight = scheduler->options().requestResponseWeight;
+  }
+  scheduler->setWeight(streamId, weight);
+}
+
+void RSocketStateMachine::setOutputDeadline(
+    StreamId streamId,
+    RequestDeadline::Clock::time_point deadline) {
+  if (auto scheduler = outputScheduler()) {
+    scheduler->setDeadline(streamId, deadline);
   }
-  frameTransport_->outputFrameOrDrop(std::move(frame));
 }
 
 uint32_t RSocketStateMachine::getKeepaliveTime() const {
@@ -1101,6 +2842,11 @@ bool RSocketStateMachine::isClosed() const {
   return isClosed_;
 }
 
+bool RSocketStateMachine::refusesRequests() const {
+  // The requests of a client waiting for its first connection are queued.
+  return isDisconnected() && (!setupFrame_ || isClosed());
+}
+
 void RSocketStateMachine::writeNewStream(
     StreamId streamId,
     StreamType streamType,
@@ -1113,13 +2859,70 @@ void RSocketStateMachine::writeNewStream(
         streamId, RequestOriginator::LOCAL, streamToken, streamType);
   }
 
+  auto const deadline = streamDeadline(streamId);
+  if (deadline) {
+    writeExt(RequestDeadline::frame(streamId, *deadline));
+  }
   StreamsWriterImpl::writeNewStream(
       streamId, streamType, initialRequestN, std::move(payload));
+  if (deadline) {
+    scheduleStreamDeadline(streamId, *deadline);
+  }
+}
+
+void RSocketStateMachine::addStream(
+    StreamId streamId,
+    std::shared_ptr<StreamStateMachineBase> stateMachine) {
+  FOLLY_SDT(rsocket, stream_open, this, streamId);
+  const auto inserted = streams_.emplace(streamId, std::move(stateMachine));
+  DCHECK(inserted);
 }
 
 void RSocketStateMachine::onStreamClosed(StreamId streamId) {
-  streams_.erase(streamId);
+  FOLLY_SDT(rsocket, stream_close, this, streamId);
+  if (auto stateMachine = streams_.find(streamId)) {
+    reassemblyBytes_ -= (*stateMachine)->payloadFragments().size();
+    retireStream(std::move(*stateMachine));
+    streams_.erase(streamId);
+    if (tenant_ && (streamId & 1) != (nextStreamId_ & 1)) {
+      if (cancelBatch_) {
+        ++cancelBatchPeerStreams_;
+      } else {
+        tenant_->closeStreams(1);
+      }
+    }
+  }
+  untrackedStreams_.erase(streamId);
+  if (!streamDeadlines_.empty()) {
+    streamDeadlines_.erase(streamId);
+  }
+  if (auto scheduler = outputScheduler()) {
+    scheduler->eraseWeight(streamId);
+  }
   resumeManager_->onStreamClosed(streamId);
+  if (cancelBatch_) {
+    // endCancelBatch() does the rest, once for the whole burst.
+    return;
+  }
+  if ((streamId & 1) == (nextStreamId_ & 1)) {
+    admitRequestsAwaitingStreamSlot();
+  }
+
+  if (drain_ && streams_.empty()) {
+    // Not from within the stream that just ended.
+    auto const eventBase =
+        folly::EventBaseManager::get()->getExistingEventBase();
+    if (!eventBase) {
+      closeDrained();
+      return;
+    }
+    eventBase->runInLoop(
+        [weakThis = std::weak_ptr<RSocketStateMachine>(shared_from_this())] {
+          if (auto self = weakThis.lock()) {
+            self->closeDrained();
+          }
+        });
+  }
 }
 
 bool RSocketStateMachine::ensureOrAutodetectFrameSerializer(
@@ -1135,23 +2938,22 @@ bool RSocketStateMachine::ensureOrAutodetectFrameSerializer(
     return false;
   }
 
-  auto serializer = FrameSerializer::createAutodetectedSerializer(firstFrame);
+  auto const serializer = FrameSerializer::sharedAutodetected(
+      firstFrame, frameTransport_ && frameTransport_->isConnectionFramed());
   if (!serializer) {
     LOG(ERROR) << "unable to detect protocol version";
     return false;
   }
 
   VLOG(2) << "detected protocol version" << serializer->protocolVersion();
-  frameSerializer_ = std::move(serializer);
-  frameSerializer_->preallocateFrameSizeField() =
-      frameTransport_ && frameTransport_->isConnectionFramed();
+  frameSerializer_ = serializer;
 
   return true;
 }
 
 size_t RSocketStateMachine::getConsumerAllowance(StreamId streamId) const {
-  auto const it = streams_.find(streamId);
-  return it != streams_.end() ? it->second->getConsumerAllowance() : 0;
+  auto const stateMachine = streams_.find(streamId);
+  return stateMachine ? (*stateMachine)->getConsumerAllowance() : 0;
 }
 
 void RSocketStateMachine::registerCloseCallback(
@@ -1172,7 +2974,11 @@ void RSocketStateMachine::setProtocolVersionOrThrow(
   // explicitly closed when exceptions are thrown. The right solution is to
   // automatically close duplex connection in the destructor when unique_ptr
   // is released
-  auto transportGuard = folly::makeGuard([&] { transport->close(); });
+  auto transportGuard = folly::makeGuard([&] {
+    if (transport) {
+      transport->close();
+    }
+  });
 
   if (frameSerializer_) {
     if (frameSerializer_->protocolVersion() != version) {
@@ -1180,14 +2986,12 @@ void RSocketStateMachine::setProtocolVersionOrThrow(
       throw std::runtime_error{"Protocol version mismatch"};
     }
   } else {
-    auto frameSerializer = FrameSerializer::createFrameSerializer(version);
+    auto const frameSerializer = FrameSerializer::shared(
+        version, frameTransport_ && frameTransport_->isConnectionFramed());
     if (!frameSerializer) {
       throw std::runtime_error{"Invalid protocol version"};
     }
-
-    frameSerializer_ = std::move(frameSerializer);
-    frameSerializer_->preallocateFrameSizeField() =
-        frameTransport_ && frameTransport_->isConnectionFramed();
+    frameSerializer_ = frameSerializer;
   }
 
   transportGuard.dismiss();
@@ -1202,8 +3006,8 @@ StreamId RSocketStateMachine::getNextStreamId() {
     throw std::runtime_error{"Ran out of stream IDs"};
   }
 
-  CHECK_EQ(0, streams_.count(streamId))
-      << "Next stream ID already exists in the streams map";
+  CHECK(!streams_.contains(streamId))
+      << "Next stream ID already exists in the streams table";
 
   nextStreamId_ += 2;
   return streamId;
@@ -1213,6 +3017,13 @@ void RSocketStateMachine::setNextStreamId(StreamId streamId) {
   nextStreamId_ = streamId + 2;
 }
 
+StreamStateMachinePool& RSocketStateMachine::streamPool() {
+  if (!streamPool_) {
+    streamPool_ = std::make_shared<StreamStateMachinePool>(stats_);
+  }
+  return *streamPool_;
+}
+
 bool RSocketStateMachine::registerNewPeerStreamId(StreamId streamId) {
   DCHECK_NE(0, streamId);
   if (nextStreamId_ % 2 == streamId % 2) {
@@ -1233,4 +3044,34 @@ bool RSocketStateMachine::hasStreams() const {
   return !streams_.empty();
 }
 
+bool RSocketStateMachine::canMoveEventBase() const {
+  return isDisconnected() && !isClosed() && streams_.empty() &&
+      !leaseEnabled_ && !replayScheduled_;
+}
+
+void RSocketStateMachine::moveToEventBase(folly::EventBase& eventBase) {
+  DCHECK(canMoveEventBase());
+  if (keepaliveTimer_) {
+    keepaliveTimer_->setEventBase(eventBase);
+  }
+}
+
+bool RSocketStateMachine::canMoveConnectedToEventBase() const {
+  return !isDisconnected() && !isClosed() && streams_.empty() &&
+      (!requestsAwaitingStreamSlot_ || requestsAwaitingStreamSlot_->empty()) &&
+      !leaseEnabled_ && !keepaliveTimer_ && !drain_ && !replayPosition_ &&
+      !replayScheduled_ && frameTransport_->isDetachable();
+}
+
+void RSocketStateMachine::moveConnectedToEventBase(folly::EventBase&) {
+  DCHECK(canMoveConnectedToEventBase());
+  frameTransport_->detachEventBase();
+}
+
+void RSocketStateMachine::attachToEventBase(folly::EventBase& eventBase) {
+  if (frameTransport_) {
+    frameTransport_->attachEventBase(eventBase);
+  }
+}
+
 } // namespace rsocket
@@ -14,20 +14,47 @@
 
 #pragma once
 
+#include <folly/Function.h>
+#include <folly/Likely.h>
+#include <folly/Optional.h>
+#include <folly/futures/Promise.h>
+
+#include <array>
+#include <chrono>
 #include <deque>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "rsocket/ColdResumeHandler.h"
 #include "rsocket/DuplexConnection.h"
+#include "rsocket/LeaseSender.h"
+#include "rsocket/FlowControl.h"
+#include "rsocket/FrameCapture.h"
+#include "rsocket/MemoryUsage.h"
 #include "rsocket/Payload.h"
 #include "rsocket/RSocketParameters.h"
+#include "rsocket/RequestDeadline.h"
 #include "rsocket/ResumeManager.h"
+#include "rsocket/ResumeStateHandoff.h"
+#include "rsocket/StreamAccounting.h"
+#include "rsocket/TenantQuotas.h"
 #include "rsocket/framing/FrameProcessor.h"
 #include "rsocket/framing/FrameSerializer.h"
+#include "rsocket/framing/FrameSerializer_v1_0.h"
+#include "rsocket/internal/AdmissionController.h"
 #include "rsocket/internal/Common.h"
 #include "rsocket/internal/KeepaliveTimer.h"
+#include "rsocket/internal/LeaseBudget.h"
+#include "rsocket/internal/MemoryPressureController.h"
+#include "rsocket/internal/StreamErrors.h"
+#include "rsocket/internal/StreamTable.h"
 #include "rsocket/statemachine/StreamFragmentAccumulator.h"
 #include "rsocket/statemachine/StreamStateMachineBase.h"
+#include "rsocket/statemachine/StreamStateMachinePool.h"
 #include "rsocket/statemachine/StreamsWriter.h"
 #include "yarpl/flowable/Subscriber.h"
 #include "yarpl/flowable/Subscription.h"
@@ -62,6 +89,30 @@ class FrameSink {
 
   virtual void sendKeepalive(
       std::unique_ptr<folly::IOBuf> data = folly::IOBuf::create(0)) = 0;
+
+  /// Whether KEEPALIVE frames carry something the peer needs besides proof
+  /// of liveness, so that they are sent even while other frames flow.
+  virtual bool needsKeepaliveFrames() const {
+    return true;
+  }
+
+  /// Called when a keepalive was skipped, see needsKeepaliveFrames().
+  virtual void keepaliveSuppressed() {}
+};
+
+/// Limits the streams a connection keeps active at once, counted separately
+/// for each side.  Zero means no limit.  Fire-and-forget requests are never
+/// held back or rejected.
+struct StreamLimits {
+  /// Most streams this side may have open.  Requests past it wait for a
+  /// stream to end, or fail if `maxQueuedRequests` are waiting already.
+  /// Channels never wait, they fail right away.
+  size_t maxActiveStreams{0};
+  size_t maxQueuedRequests{0};
+
+  /// Most streams the peer may have open.  Requests past it are rejected
+  /// without reaching the responder.
+  size_t maxPeerActiveStreams{0};
 };
 
 /// Handles connection-level frames and (de)multiplexes streams.
@@ -106,6 +157,15 @@ class RSocketStateMachine final
   /// Connect as a client.  Sends a SETUP frame.
   void connectClient(std::shared_ptr<FrameTransport>, SetupParameters);
 
+  /// Sets up a client ahead of its connection, so that requests can be made
+  /// before there is one.  Their frames are queued, and written along with
+  /// the SETUP frame once connectClient() is called without parameters.
+  void prepareClient(SetupParameters);
+
+  /// Connect as a client set up by prepareClient().  Sends the SETUP frame
+  /// and the frames of the requests made so far in a single write.
+  void connectClient(std::shared_ptr<FrameTransport>);
+
   /// Resume a connection as a client.  Sends a RESUME frame.
   void resumeClient(
       ResumeIdentificationToken,
@@ -130,28 +190,130 @@ class RSocketStateMachine final
   /// Close the connection and all of its streams.
   void close(folly::exception_wrapper, StreamCompletionSignal);
 
+  /// Stops taking requests from the peer and closes the connection with the
+  /// ERROR frame once the streams still open have ended, or after `timeout`
+  /// at the latest.  Requests of the peer from now on are rejected.  When
+  /// leases are enabled, the peer's lease is left to run out instead of being
+  /// renewed, so that it holds its requests back.
+  ///
+  /// With `handOff`, a session that can be handed over to another server
+  /// (see exportResumeState()) is instead closed without the ERROR frame,
+  /// after calling `handOff` with its state, so that the client resumes it
+  /// elsewhere.
+  void drain(
+      Frame_ERROR&&,
+      std::chrono::milliseconds timeout,
+      folly::Function<void(ResumeHandoffState)> handOff = nullptr);
+
+  /// State of the session for another server to take it over when the
+  /// client resumes there, see ResumeHandoffState.  Returns folly::none if
+  /// the session isn't a resumable server one, or uses leases, which don't
+  /// move between servers.
+  folly::Optional<ResumeHandoffState> exportResumeState();
+
+  /// Exports the state of the session, and closes it without sending
+  /// anything more to the client, which is to resume on another server.
+  /// Returns folly::none, leaving the session open, if it can't be handed
+  /// over.
+  folly::Optional<ResumeHandoffState> handOff();
+
+  /// Takes over a session from another server, before resumeServer().  The
+  /// ResumeManager must hold the frames of the session already.  The streams
+  /// that were open are ended once the client has resumed.
+  void takeOver(const ResumeHandoffState&);
+
+  // The output weight of a request only matters with an output scheduler,
+  // see setOutputSchedulerOptions().  Zero picks the default weight.
+  //
+  // A request that isn't resumable keeps its frames out of the resume buffer
+  // of a resumable connection, and its stream is terminated with an error as
+  // soon as the connection is lost.  The peer must run this library too, see
+  // FrameFlags::UNTRACKED.
+  //
+  // A request with a deadline is failed once the deadline passes, and the
+  // deadline goes along with it to the peer, see RequestDeadline.
+  //
+  // The frames of a batched request response are held back to share a write
+  // with those of the requests that follow, see RequestBatchingOptions.  Has
+  // no effect with an output scheduler, which writes the frames of streams
+  // on its own schedule.
+
   void requestStream(
       Payload request,
-      std::shared_ptr<yarpl::flowable::Subscriber<Payload>> responseSink);
+      std::shared_ptr<yarpl::flowable::Subscriber<Payload>> responseSink,
+      uint32_t outputWeight = 0,
+      bool resumable = true,
+      folly::Optional<RequestDeadline::Clock::time_point> deadline =
+          folly::none);
 
   std::shared_ptr<yarpl::flowable::Subscriber<Payload>> requestChannel(
       Payload request,
       bool hasInitialRequest,
-      std::shared_ptr<yarpl::flowable::Subscriber<Payload>> responseSink);
+      std::shared_ptr<yarpl::flowable::Subscriber<Payload>> responseSink,
+      uint32_t outputWeight = 0,
+      bool resumable = true,
+      folly::Optional<RequestDeadline::Clock::time_point> deadline =
+          folly::none);
 
   void requestResponse(
       Payload payload,
-      std::shared_ptr<yarpl::single::SingleObserver<Payload>> responseSink);
+      std::shared_ptr<yarpl::single::SingleObserver<Payload>> responseSink,
+      uint32_t outputWeight = 0,
+      bool resumable = true,
+      folly::Optional<RequestDeadline::Clock::time_point> deadline =
+          folly::none,
+      folly::Optional<RequestBatchingOptions> batching = folly::none);
+
+  /// Send a REQUEST_RESPONSE frame, completing the promise with the response.
+  void requestResponse(
+      Payload payload,
+      folly::Promise<Payload> response,
+      uint32_t outputWeight = 0,
+      bool resumable = true,
+      folly::Optional<RequestDeadline::Clock::time_point> deadline =
+          folly::none,
+      folly::Optional<RequestBatchingOptions> batching = folly::none);
 
   /// Send a REQUEST_FNF frame.
-  void fireAndForget(Payload);
+  void fireAndForget(
+      Payload,
+      folly::Optional<RequestDeadline::Clock::time_point> deadline =
+          folly::none);
+
+  /// Send a REQUEST_FNF frame for each of the payloads, handing all of them
+  /// to the transport in a single write.
+  void fireAndForgetBatch(std::vector<Payload>);
 
   /// Send a METADATA_PUSH frame.
   void metadataPush(std::unique_ptr<folly::IOBuf>);
 
+  /// Send a METADATA_PUSH frame serialized ahead of time for the given
+  /// protocol version, e.g. once for many connections.  The frame may share
+  /// its buffer with other connections, it isn't written to.  Returns false,
+  /// dropping the frame, if the connection is closed or speaks another
+  /// version.
+  bool metadataPushSerialized(
+      std::unique_ptr<folly::IOBuf> frame,
+      ProtocolVersion version);
+
+  /// Send a REQUEST_FNF frame serialized ahead of time, like
+  /// metadataPushSerialized().  The frame gets the next stream id of this
+  /// connection, written into a buffer of its own in front of the shared one.
+  /// Returns false, dropping the frame, if the connection is closed, speaks
+  /// another version or has too many frames pending.
+  bool fireAndForgetSerialized(
+      std::unique_ptr<folly::IOBuf> frame,
+      ProtocolVersion version);
+
   /// Send a KEEPALIVE frame, with the RESPOND flag set.
   void sendKeepalive(std::unique_ptr<folly::IOBuf>) override;
 
+  /// Always, unless setKeepaliveSuppression() is on.  Resumable connections
+  /// then still need them to acknowledge the frames they received.
+  bool needsKeepaliveFrames() const override;
+
+  void keepaliveSuppressed() override;
+
   class CloseCallback {
    public:
     virtual ~CloseCallback() = default;
@@ -168,6 +330,188 @@ class RSocketStateMachine final
   // Has active requests?
   bool hasStreams() const;
 
+  /// Whether the state machine can move to another EventBase on resumption,
+  /// see moveToEventBase().  Only while disconnected, with no streams, whose
+  /// subscribers are bound to the current EventBase, and without leases,
+  /// whose renewal is scheduled on it.
+  bool canMoveEventBase() const;
+
+  /// Moves the timers of the state machine onto `eventBase`.  The caller
+  /// moves everything else that schedules calls into the state machine
+  /// (requesters, responders) and drives it from `eventBase` from then on.
+  /// Must be called on the current EventBase.
+  void moveToEventBase(folly::EventBase& eventBase);
+
+  /// Whether the state machine can move to another EventBase together with
+  /// its transport, see moveConnectedToEventBase().  Only while connected,
+  /// with no streams, no requests waiting for a stream slot and no leases as
+  /// above, without a keepalive timer or a drain in progress, and with a
+  /// transport that can be detached right now.
+  bool canMoveConnectedToEventBase() const;
+
+  /// Detaches the transport from the current EventBase, see
+  /// DuplexConnection::detachEventBase().  The caller moves everything else
+  /// as for moveToEventBase(), then calls attachToEventBase() on
+  /// `eventBase`.  Must be called on the current EventBase.
+  void moveConnectedToEventBase(folly::EventBase& eventBase);
+
+  /// Resumes the transport on `eventBase` after moveConnectedToEventBase().
+  /// Must be called on `eventBase`.
+  void attachToEventBase(folly::EventBase& eventBase);
+
+  /// Memory held by the connection.  Must be called on its EventBase.
+  MemoryUsage memoryUsage() const;
+
+  /// Flow control state of the connection and of each of its streams.  Must
+  /// be called on its EventBase, see RSocketClient::flowControl() and
+  /// RSocketServer::flowControl() to call it from any thread.
+  ConnectionFlowControl flowControl() const;
+
+  /// Configure how fragmented payloads are reassembled on streams created
+  /// from now on, including the largest fragmented payload the peer may send
+  /// before the connection is closed.
+  void setFragmentReassemblyOptions(
+      const StreamFragmentAccumulator::Options& options) {
+    fragmentReassemblyOptions_ = options;
+  }
+
+  /// Configure when streams created from now on send REQUEST_N frames.
+  void setRequestNOptions(const RequestNOptions& options) {
+    requestNOptions_ = options;
+  }
+
+  RequestNOptions requestNOptions() const override {
+    return requestNOptions_;
+  }
+
+  size_t initialByteCredit() const override {
+    return byteCredit_;
+  }
+
+  /// Bounds the frames held back while the connection can't send them.  Past
+  /// the high watermark, streams hold back demand from the peer and new
+  /// requests fail with OutputBackpressureException.
+  void setPendingOutputOptions(const PendingOutputOptions& options) {
+    StreamsWriterImpl::setPendingOutputOptions(options);
+  }
+
+  /// Bounds the output the transport buffers, e.g. while the socket is slower
+  /// than the producers of the streams.  Past the high watermark, streams
+  /// stop asking their producers for data until the transport is down to the
+  /// low watermark.  Must be called before connecting.
+  void setTransportOutputOptions(const TransportOutputOptions& options) {
+    transportOutputOptions_ = options;
+  }
+
+  /// Spreads the replay of the frames buffered by the ResumeManager over
+  /// several EventBase loop iterations on resumption.  Frames written
+  /// meanwhile are held back until the replay is done.  Must be called
+  /// before connecting.
+  void setResumeReplayOptions(const ResumeReplayOptions& options) {
+    resumeReplayOptions_ = options;
+  }
+
+  /// Must be called before connecting.  Keeps the outgoing frames of each
+  /// stream in a queue of its own and interleaves them by weight, so that a
+  /// stream writing a lot of data can't hold back the others.
+  void setOutputSchedulerOptions(const OutputScheduler::Options& options) {
+    enableOutputScheduler(options);
+  }
+
+  /// Fragments large payloads written from now on to a size picked from the
+  /// conditions of the transport, within the bounds of `options`.  Without
+  /// it, payloads are only fragmented past the largest frame size.
+  void setFragmentSizeOptions(const FragmentSizeOptions& options) {
+    fragmentSizeOptions_ = options;
+    fragmentSizeExpiry_ = {};
+  }
+
+  /// Resumable connections only.  Acknowledges the received frames with a
+  /// KEEPALIVE frame once this many bytes of them went unacknowledged, so
+  /// that the peer trims its resume buffer continuously rather than once per
+  /// keepalive period.  Zero leaves acknowledgements to keepalives.
+  void setResumeAckThreshold(size_t bytes) {
+    resumeAckThreshold_ = bytes;
+  }
+
+  /// Skips keepalives in periods during which frames were received.  Off by
+  /// default: only suits peers that take any frame as proof of liveness, a
+  /// peer that times out on missing KEEPALIVE frames would drop a connection
+  /// that only receives.  Resumable connections still send the keepalive if
+  /// some of the received frames haven't been acknowledged yet, which pairs
+  /// well with setResumeAckThreshold(), acknowledging them as they come.
+  void setKeepaliveSuppression(bool enabled) {
+    keepaliveSuppression_ = enabled;
+  }
+
+  /// Applies to requests made or received from now on.
+  void setStreamLimits(const StreamLimits& limits) {
+    streamLimits_ = limits;
+  }
+
+  /// Server only, must be called before connectServer().  Grants leases from
+  /// the sender if the client asks to honor leases, and rejects its requests
+  /// that exceed them.  Clients asking for leases are rejected when there is
+  /// no sender.
+  void setLeaseSender(std::shared_ptr<LeaseSender> leaseSender) {
+    leaseSender_ = std::move(leaseSender);
+  }
+
+  /// Server only.  Rejects the requests received while the controller reports
+  /// its EventBase as overloaded, before they reach the responder.
+  void setAdmissionController(
+      std::shared_ptr<const AdmissionController> controller) {
+    admissionController_ = std::move(controller);
+  }
+
+  /// Degrades the connection while memory is tight: shrinks the credit its
+  /// streams keep outstanding, caps its resume buffer if it is kept by a
+  /// WarmResumeManager, and rejects the requests of the peer once pressure is
+  /// critical.  See MemoryPressureController.
+  void setMemoryPressure(
+      std::shared_ptr<const MemoryPressureController> controller);
+
+  size_t requestNLimit() const override {
+    return memoryPressure_ ? memoryPressure_->maxRequestN() : kMaxRequestN;
+  }
+
+  /// Server only, must be called before connectServer().  Counts the
+  /// connection, the streams its peer opens and the bytes it sends against
+  /// the quota of its tenant, and rejects the requests past the quota.  The
+  /// connection is counted as closed once this is closed.
+  void setTenant(std::shared_ptr<TenantQuotas::Bucket> tenant) {
+    tenant_ = std::move(tenant);
+  }
+
+  /// Preallocates the stream table for this many streams opened by the
+  /// client at once, see CapacityHints::streams.
+  void reserveClientStreams(size_t streams) {
+    streams_.reserve(1, streams);
+  }
+
+  /// Accounts for the bytes and handler time of the streams opened from now
+  /// on, see StreamAccounting.
+  void setStreamAccounting(std::shared_ptr<StreamAccounting> accounting) {
+    streamAccounting_ = std::move(accounting);
+  }
+
+  StreamAccounting* streamAccounting() override {
+    return streamAccounting_.get();
+  }
+
+  /// Records the frames read and written from now on into a capture, see
+  /// FrameCapture.  Without one, frames are not captured at all.
+  void setFrameCapture(std::shared_ptr<FrameCapture> capture) {
+    frameCapture_ = std::move(capture);
+  }
+
+  StreamFragmentAccumulator::Options fragmentReassemblyOptions()
+      const override {
+    auto options = fragmentReassemblyOptions_;
+    options.compressor = payloadCompressor_;
+    return options;
+  }
+
  private:
   // connection scope signals
   void onKeepAliveFrame(
@@ -176,6 +520,9 @@ class RSocketStateMachine final
       bool keepAliveRespond);
   void onMetadataPushFrame(std::unique_ptr<folly::IOBuf> metadata);
   void onResumeOkFrame(ResumePosition resumePosition);
+  /// Re-establishes the streams requested before a cold-start, with their
+  /// subscribers from the ColdResumeHandler.
+  void resumeRequesterStreams();
   void onErrorFrame(StreamId streamId, ErrorCode errorCode, Payload payload);
 
   // stream scope signals
@@ -207,13 +554,104 @@ class RSocketStateMachine final
   void onSetupFrame();
   void onResumeFrame();
   void onReservedFrame();
-  void onLeaseFrame();
+  void onLeaseFrame(uint32_t ttl, uint32_t numberOfRequests);
   void onExtFrame();
+  void onByteCreditFrame(const Frame_EXT&);
+  void onRequestDeadlineFrame(const Frame_EXT&);
   void onUnexpectedFrame(StreamId streamId);
 
   std::shared_ptr<StreamStateMachineBase> getStreamStateMachine(
       StreamId streamId);
 
+  /// Like getStreamStateMachine(), without taking a reference.  Only for the
+  /// handlers of the frame processFrame() is dispatching, see retireStream().
+  StreamStateMachineBase* findStream(StreamId streamId);
+
+  /// Drops the reference of the connection to a stream that closed.  While a
+  /// frame is dispatched, the handler of the frame may still be running a
+  /// method of the stream, so it is only released once processFrame()
+  /// returns.
+  void retireStream(std::shared_ptr<StreamStateMachineBase>);
+
+  /// A peer dropping many streams at once sends a burst of CANCEL frames.
+  /// While such a burst is processed, the streams it closes are only taken
+  /// out of the stream table, and the rest of what closing a stream does is
+  /// done once for the whole burst: releasing the stream state machines,
+  /// returning the streams to the tenant, admitting the requests waiting for
+  /// a stream slot and checking whether a drain is over.  The burst ends
+  /// with the first frame of another type, or with the current iteration of
+  /// the EventBase loop.
+  void beginCancelBatch();
+  void endCancelBatch();
+
+  /// Drops a new request from the peer if the deadline that came with it has
+  /// passed already.  Otherwise remembers the deadline, and cancels the
+  /// stream when it passes unless the stream is a fire-and-forget.
+  bool ensureBeforeDeadline(StreamId streamId, StreamType streamType);
+
+  /// Closes the connection if accepting the fragment would take the payload
+  /// being reassembled over the configured limit.
+  bool ensureWithinReassemblyLimit(
+      const StreamFragmentAccumulator& fragments,
+      const Payload& payload,
+      bool flagsFollows);
+
+  /// Grants the next lease from leaseSender_ and schedules its renewal.
+  void sendLease();
+  void scheduleLeaseRenewal(std::chrono::milliseconds delay);
+
+  /// Server only.  Uses up one request of the lease granted to the client,
+  /// or rejects the request if there is none.
+  bool ensureLeaseGranted(StreamId streamId, bool rejectRequest);
+
+  /// Client only.  Uses up one request of the lease granted by the server.
+  bool acquireLease();
+
+  using RequestQueue =
+      std::deque<folly::Function<void(folly::exception_wrapper)>>;
+
+  /// Client only.  Holds back a request until a lease is granted, or fails
+  /// it right away if too many are held back already.  The request is called
+  /// with an error if it fails, and without one once it may be sent.
+  void awaitLease(folly::Function<void(folly::exception_wrapper)> request);
+  void failRequestsAwaitingLease();
+
+  /// Whether this side may open another stream under the stream limits.
+  bool hasStreamSlot() const;
+
+  /// Holds back a request until another stream ends, or fails it right away
+  /// if too many are held back already.  Same contract as awaitLease().
+  void awaitStreamSlot(folly::Function<void(folly::exception_wrapper)> request);
+  void admitRequestsAwaitingStreamSlot();
+  void failRequestsAwaitingStreamSlot();
+
+  /// Rejects a request of the peer if it has too many streams open already.
+  bool ensureBelowPeerStreamLimit(StreamId streamId);
+
+  /// Rejects a request of the peer once the connection is draining.
+  bool ensureNotDraining(StreamId streamId, bool rejectRequest);
+
+  /// Rejects a request of the peer while the admission controller reports
+  /// overload.
+  bool ensureAdmitted(StreamId streamId, bool rejectRequest);
+
+  /// Rejects a request of the peer while memory pressure is critical.
+  bool ensureMemoryAvailable(StreamId streamId, bool rejectRequest);
+
+  /// Rejects a request of the peer while its tenant is over its byte rate.
+  bool ensureTenantWithinByteRate(StreamId streamId, bool rejectRequest);
+
+  /// Counts a stream the peer opens against the quota of its tenant, or
+  /// rejects it.  Fire-and-forget requests are counted but never rejected.
+  /// Must be the last check before the stream is added.
+  bool ensureTenantStreamSlot(StreamId streamId, bool rejectRequest);
+
+  /// Number of streams the peer has open, i.e. counted for tenant_.
+  size_t peerStreams() const;
+
+  /// Closes a draining connection with its ERROR frame.
+  void closeDrained();
+
   void connect(std::shared_ptr<FrameTransport>);
 
   /// Terminate underlying connection and connect new connection
@@ -232,6 +670,9 @@ class RSocketStateMachine final
   /// Whether the connection has been closed.
   bool isClosed() const;
 
+  /// Whether new requests fail right away, for want of a connection.
+  bool refusesRequests() const;
+
   uint32_t getKeepaliveTime() const;
 
   void sendPendingFrames() override;
@@ -243,15 +684,50 @@ class RSocketStateMachine final
     return *stats_;
   }
 
-  FrameSerializer& serializer() override {
+  const FrameSerializer& serializer() override {
     return *frameSerializer_;
   }
 
+  const PayloadCompressor* payloadCompressor() const override {
+    return payloadCompressor_.get();
+  }
+
+  /// The adaptive fragment size, if setFragmentSizeOptions() was called.
+  size_t maxFragmentSize() const override;
+
+  FrameFlags streamFrameFlags(StreamId streamId) const override {
+    return !untrackedStreams_.empty() && untrackedStreams_.count(streamId)
+        ? FrameFlags::UNTRACKED
+        : FrameFlags::EMPTY_;
+  }
+
   template <typename TFrame>
   bool deserializeFrameOrError(
       TFrame& frame,
       std::unique_ptr<folly::IOBuf> buf) {
-    if (frameSerializer_->deserializeFrom(frame, std::move(buf))) {
+    const bool ok =
+        visitFrameSerializer(*frameSerializer_, [&](const auto& s) {
+          return s.deserializeFrom(frame, std::move(buf));
+        });
+    if (ok) {
+      return true;
+    }
+    closeWithError(Frame_ERROR::connectionError("Invalid frame"));
+    return false;
+  }
+
+  /// Like deserializeFrameOrError() above, but reuses the header that was
+  /// already decoded in processFrame().
+  template <typename TFrame>
+  bool deserializeFrameOrError(
+      TFrame& frame,
+      std::unique_ptr<folly::IOBuf> buf,
+      const DecodedFrameHeader& header) {
+    const bool ok =
+        visitFrameSerializer(*frameSerializer_, [&](const auto& s) {
+          return s.deserializeFrom(frame, std::move(buf), header);
+        });
+    if (ok) {
       return true;
     }
     closeWithError(Frame_ERROR::connectionError("Invalid frame"));
@@ -262,16 +738,174 @@ class RSocketStateMachine final
   void processFrame(std::unique_ptr<folly::IOBuf>) override;
   void onTerminal(folly::exception_wrapper) override;
 
-  void handleFrame(StreamId, FrameType, std::unique_ptr<folly::IOBuf>);
+  void handleFrame(const DecodedFrameHeader&, std::unique_ptr<folly::IOBuf>);
+
+  // Per frame type handlers, dispatched to through kFrameHandlers.
+  using FrameHandler = void (RSocketStateMachine::*)(
+      const DecodedFrameHeader&,
+      std::unique_ptr<folly::IOBuf>);
+
+  void handleKeepAliveFrame(
+      const DecodedFrameHeader&,
+      std::unique_ptr<folly::IOBuf>);
+  void handleMetadataPushFrame(
+      const DecodedFrameHeader&,
+      std::unique_ptr<folly::IOBuf>);
+  void handleResumeOkFrame(
+      const DecodedFrameHeader&,
+      std::unique_ptr<folly::IOBuf>);
+  void handleErrorFrame(
+      const DecodedFrameHeader&,
+      std::unique_ptr<folly::IOBuf>);
+  void handleSetupFrame(
+      const DecodedFrameHeader&,
+      std::unique_ptr<folly::IOBuf>);
+  void handleResumeFrame(
+      const DecodedFrameHeader&,
+      std::unique_ptr<folly::IOBuf>);
+  void handleReservedFrame(
+      const DecodedFrameHeader&,
+      std::unique_ptr<folly::IOBuf>);
+  void handleLeaseFrame(
+      const DecodedFrameHeader&,
+      std::unique_ptr<folly::IOBuf>);
+  void handleRequestNFrame(
+      const DecodedFrameHeader&,
+      std::unique_ptr<folly::IOBuf>);
+  void handleCancelFrame(
+      const DecodedFrameHeader&,
+      std::unique_ptr<folly::IOBuf>);
+  void handlePayloadFrame(
+      const DecodedFrameHeader&,
+      std::unique_ptr<folly::IOBuf>);
+  void handleRequestChannelFrame(
+      const DecodedFrameHeader&,
+      std::unique_ptr<folly::IOBuf>);
+  void handleRequestStreamFrame(
+      const DecodedFrameHeader&,
+      std::unique_ptr<folly::IOBuf>);
+  void handleRequestResponseFrame(
+      const DecodedFrameHeader&,
+      std::unique_ptr<folly::IOBuf>);
+  void handleFireAndForgetFrame(
+      const DecodedFrameHeader&,
+      std::unique_ptr<folly::IOBuf>);
+  void handleExtFrame(const DecodedFrameHeader&, std::unique_ptr<folly::IOBuf>);
+  void handleUnknownFrame(
+      const DecodedFrameHeader&,
+      std::unique_ptr<folly::IOBuf>);
+
+  /// Frame handlers indexed by the 6-bit frame type.
+  static const std::array<FrameHandler, 64> kFrameHandlers;
 
   void closeStreams(StreamCompletionSignal);
+
+  /// Marks a new local stream as not resumable, if the connection is.
+  void setStreamUntracked(StreamId, bool resumable);
+
+  /// Remembers the deadline of a new local stream, to send it along with the
+  /// request.
+  void setStreamDeadline(
+      StreamId,
+      folly::Optional<RequestDeadline::Clock::time_point> deadline);
+
+  /// The deadline of a stream, if it has one.
+  folly::Optional<RequestDeadline::Clock::time_point> streamDeadline(
+      StreamId streamId) const {
+    if (FOLLY_LIKELY(streamDeadlines_.empty())) {
+      return folly::none;
+    }
+    auto const it = streamDeadlines_.find(streamId);
+    if (it == streamDeadlines_.end()) {
+      return folly::none;
+    }
+    return it->second;
+  }
+
+  /// Ends a stream when its deadline passes: a local one is failed and
+  /// cancelled, a remote one is cancelled as if the peer sent a CANCEL.
+  void scheduleStreamDeadline(
+      StreamId,
+      RequestDeadline::Clock::time_point deadline);
+  void onStreamDeadline(StreamId);
+
+  /// Terminates the streams that can't survive a resumption, without sending
+  /// anything to the peer, which does the same on its side.
+  void closeUntrackedStreams();
+
+  /// Hands a payload frame to a stream, keeping reassemblyBytes_ up to date.
+  void handleStreamPayload(
+      StreamStateMachineBase&,
+      Payload,
+      bool flagsComplete,
+      bool flagsNext,
+      bool flagsFollows);
   void closeFrameTransport(folly::exception_wrapper);
 
   void sendKeepalive(FrameFlags, std::unique_ptr<folly::IOBuf>);
 
+  /// Sends a KEEPALIVE frame with the implied position if the frames received
+  /// since the last one reach the resume ack threshold.
+  void acknowledgeReceivedFrames();
+
   void resumeFromPosition(ResumePosition);
+
+  /// Replays the next frames since replayPosition_, then yields to the
+  /// EventBase, or waits for the transport to write out its output, until
+  /// all of them are sent.  See resumeReplayOptions_.
+  void replayFrames();
+
+  /// Schedules replayFrames() for the next EventBase loop iteration.
+  /// Returns false if there is no EventBase to schedule it on.
+  bool scheduleReplay();
+
+  /// Sends the frames held back during the replay, once it is done.
+  void finishReplay();
+
+  /// Called every time the transport writes out some of its output.
+  void onTransportOutputWritten();
+
   void outputFrame(std::unique_ptr<folly::IOBuf>) override;
 
+  /// Like outputFrame(), for several frames written in a single batch.
+  void outputFrames(std::vector<std::unique_ptr<folly::IOBuf>>);
+
+  /// Holds back a frame of a batched request, see batchingRequest_.
+  void batchRequestFrame(std::unique_ptr<folly::IOBuf>);
+
+  /// Writes the frames of the batched requests, if there are any.
+  void flushRequestBatch();
+
+  /// Writes frames to the transport, after the batched requests.
+  void writeFrames(std::vector<std::unique_ptr<folly::IOBuf>>);
+
+  /// Records a frame that is about to be written to the transport.
+  void trackOutputFrame(const folly::IOBuf&);
+
+  void scheduleOutput() override;
+  void onPendingOutputPaused(bool paused) override;
+
+  /// Whether streams hold back demand from their producers, as either too
+  /// many frames are pending or the transport buffers too many bytes.
+  bool outputPaused() const {
+    return pendingOutputPaused() || transportOutputPaused_;
+  }
+
+  /// Pauses or resumes the streams once the bytes the transport buffers cross
+  /// a watermark of transportOutputOptions_.
+  void updateTransportOutputPaused();
+
+  /// Passes a change of outputPaused() on to the streams.
+  void setStreamsOutputPaused(bool paused);
+
+  /// Sets the weight the output scheduler gives to a new stream, if there is
+  /// an output scheduler.
+  void setOutputWeight(StreamId, StreamType, uint32_t weight);
+
+  /// Passes the deadline of a stream on to the output scheduler, if there is
+  /// one, see OutputScheduler::Options::earliestDeadlineFirst.
+  void setOutputDeadline(StreamId, RequestDeadline::Clock::time_point);
+
   void writeNewStream(
       StreamId streamId,
       StreamType streamType,
@@ -290,6 +924,9 @@ class RSocketStateMachine final
       std::shared_ptr<yarpl::single::SingleObserver<Payload>> response)
       override;
 
+  /// Adds a stream to streams_.  Its id must not be in use, which requesters
+  /// ensure by allocating it and responders by checking isNewStreamId().
+  void addStream(StreamId, std::shared_ptr<StreamStateMachineBase>);
   void onStreamClosed(StreamId) override;
 
   bool ensureOrAutodetectFrameSerializer(const folly::IOBuf& firstFrame);
@@ -305,6 +942,8 @@ class RSocketStateMachine final
   bool registerNewPeerStreamId(StreamId streamId);
   StreamId getNextStreamId();
 
+  StreamStateMachinePool& streamPool();
+
   void setNextStreamId(StreamId streamId);
 
   /// Client/server mode this state machine is operating in.
@@ -313,17 +952,174 @@ class RSocketStateMachine final
   /// Whether the connection was initialized as resumable.
   bool isResumable_{false};
 
+  /// State of a resumable server session.  Most connections never have any,
+  /// so it is only allocated by sessionState() when first needed.
+  struct SessionState {
+    /// Parameters of the SETUP of the connection, for exportResumeState().
+    std::string metadataMimeType;
+    std::string dataMimeType;
+    std::string payloadCompression;
+
+    /// Streams of a session taken over from another server, to end once the
+    /// client has resumed.  See takeOver().
+    std::vector<StreamId> handedOffStreams;
+  };
+
+  SessionState& sessionState();
+
+  std::unique_ptr<SessionState> sessionState_;
+
+  /// See setResumeAckThreshold().
+  size_t resumeAckThreshold_{0};
+
+  /// See setKeepaliveSuppression().
+  bool keepaliveSuppression_{false};
+
+  /// The implied position sent in the last KEEPALIVE frame.
+  ResumePosition lastAckedPosition_{0};
+
   /// Whether the connection has closed.
   bool isClosed_{false};
 
   /// Whether a cold resume is currently in progress.
   bool coldResumeInProgress_{false};
 
+  StreamFragmentAccumulator::Options fragmentReassemblyOptions_;
+  RequestNOptions requestNOptions_;
+
+  /// Set when payload compression was negotiated during SETUP.
+  std::shared_ptr<const PayloadCompressor> payloadCompressor_;
+
+  /// Initial byte credit of each stream, if byte-based flow control was
+  /// negotiated during SETUP.
+  size_t byteCredit_{0};
+
+  /// Set when frame checksums were negotiated during SETUP.  Enabled again on
+  /// the connection of every resumption.
+  bool frameChecksums_{false};
+
+  /// The SETUP frame of a client set up by prepareClient(), until it is
+  /// connected.
+  std::unique_ptr<folly::IOBuf> setupFrame_;
+
+  TransportOutputOptions transportOutputOptions_;
+
+  folly::Optional<FragmentSizeOptions> fragmentSizeOptions_;
+  /// The fragment size last picked, and until when it is used.
+  mutable size_t fragmentSize_{0};
+  mutable std::chrono::steady_clock::time_point fragmentSizeExpiry_;
+
+  /// Whether the transport went past the high watermark of
+  /// transportOutputOptions_, and hasn't dropped to the low one since.
+  bool transportOutputPaused_{false};
+
+  ResumeReplayOptions resumeReplayOptions_;
+  /// Position of the next frame to replay, while replaying.
+  folly::Optional<ResumePosition> replayPosition_;
+  /// Whether replayFrames() is scheduled on the EventBase.
+  bool replayScheduled_{false};
+  /// Whether the replay waits for the transport to write out its output.
+  bool replayAwaitingOutput_{false};
+
+  /// Whether the client agreed to honor leases during SETUP.
+  bool leaseEnabled_{false};
+
+  /// Server only: source of the leases granted to the client, and what is
+  /// left of the last one.
+  std::shared_ptr<LeaseSender> leaseSender_;
+  LeaseBudget grantedLease_;
+
+  /// Invalidates scheduled lease renewals.
+  uint32_t leaseGeneration_{0};
+
+  struct DrainState {
+    /// The frame to close the connection with.
+    Frame_ERROR error;
+    /// To hand the session over instead of sending the frame.
+    folly::Function<void(ResumeHandoffState)> handOff;
+  };
+
+  /// Set by drain().
+  std::unique_ptr<DrainState> drain_;
+
+  std::shared_ptr<const AdmissionController> admissionController_;
+
+  /// See setMemoryPressure().
+  std::shared_ptr<const MemoryPressureController> memoryPressure_;
+
+  /// Quota of the tenant of the connection, see setTenant().
+  std::shared_ptr<TenantQuotas::Bucket> tenant_;
+
+  /// See setStreamAccounting().
+  std::shared_ptr<StreamAccounting> streamAccounting_;
+
+  /// See setFrameCapture().
+  std::shared_ptr<FrameCapture> frameCapture_;
+
+  /// Client only: what is left of the last lease the server granted, and the
+  /// requests waiting for the next one.
+  LeaseBudget receivedLease_;
+  /// Allocated when the first request has to wait, like the queue below.
+  std::unique_ptr<RequestQueue> requestsAwaitingLease_;
+  size_t maxRequestsAwaitingLease_{0};
+
+  StreamLimits streamLimits_;
+  std::unique_ptr<RequestQueue> requestsAwaitingStreamSlot_;
+
   std::shared_ptr<RSocketStats> stats_;
 
-  /// Map of all individual stream state machines.
-  std::unordered_map<StreamId, std::shared_ptr<StreamStateMachineBase>>
-      streams_;
+  /// Table of all individual stream state machines.
+  StreamTable<std::shared_ptr<StreamStateMachineBase>> streams_;
+
+  /// Whether processFrame() is dispatching a frame.
+  bool dispatchingFrame_{false};
+
+  /// Streams that closed while a frame was dispatched, see retireStream().
+  std::vector<std::shared_ptr<StreamStateMachineBase>> retiredStreams_;
+
+  /// Set during a burst of CANCEL frames, see beginCancelBatch().
+  bool cancelBatch_{false};
+
+  /// Streams of the peer closed during the burst, still counted as open by
+  /// tenant_.
+  size_t cancelBatchPeerStreams_{0};
+
+  /// Set while a batched request is being written, every frame written in
+  /// the meantime joins the batch.
+  const RequestBatchingOptions* batchingRequest_{nullptr};
+
+  /// The frames of the batched requests, not written yet.  Any other frame
+  /// written flushes them first, so that frames stay in order.
+  std::vector<std::unique_ptr<folly::IOBuf>> requestBatch_;
+  size_t requestBatchBytes_{0};
+  /// When the batch is due to be written, and the number of batches
+  /// written so far, so that a flush scheduled for an earlier batch doesn't
+  /// write a later one.
+  std::chrono::steady_clock::time_point requestBatchDue_;
+  uint64_t requestBatchGeneration_{0};
+
+  /// Bytes held by the fragment accumulators of the streams in streams_.
+  size_t reassemblyBytes_{0};
+
+  /// Streams in streams_ whose frames skip the resume buffer.
+  std::unordered_set<StreamId> untrackedStreams_;
+
+  /// Turns the ERROR frames of streams into errors for their subscribers.
+  StreamErrorCache streamErrors_;
+
+  /// Deadlines of the streams in streams_ that have one.
+  std::unordered_map<StreamId, RequestDeadline::Clock::time_point>
+      streamDeadlines_;
+
+  /// The deadline the peer sent for the request it is about to open, which
+  /// comes in the frame right before it.
+  folly::Optional<std::pair<StreamId, RequestDeadline::Clock::time_point>>
+      incomingDeadline_;
+
+  /// Recycles the memory of closed stream state machines.  Created along
+  /// with the first stream, see streamPool().
+  std::shared_ptr<StreamStateMachinePool> streamPool_;
+
   StreamId nextStreamId_;
   StreamId lastPeerStreamId_{0};
 
@@ -332,7 +1128,9 @@ class RSocketStateMachine final
 
   const std::shared_ptr<RSocketResponderCore> requestResponder_;
   std::shared_ptr<FrameTransport> frameTransport_;
-  std::unique_ptr<FrameSerializer> frameSerializer_;
+  /// Shared by the connections of the same protocol version and framing,
+  /// see FrameSerializer::shared().
+  const FrameSerializer* frameSerializer_{nullptr};
 
   const std::unique_ptr<KeepaliveTimer> keepaliveTimer_;
 
@@ -0,0 +1,88 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/statemachine/RequestResponseFutureRequester.h"
+
+#include "rsocket/internal/Common.h"
+
+namespace rsocket {
+
+void RequestResponseFutureRequester::start(Payload request) {
+  DCHECK(!requested_);
+  requested_ = true;
+  newStream(StreamType::REQUEST_RESPONSE, 1, std::move(request));
+}
+
+void RequestResponseFutureRequester::endStream(StreamCompletionSignal signal) {
+  if (!requested_) {
+    return;
+  }
+  // Spontaneous ::endStream signal means an error.
+  DCHECK(StreamCompletionSignal::COMPLETE != signal);
+  DCHECK(StreamCompletionSignal::CANCEL != signal);
+  requested_ = false;
+  promise_.setException(StreamInterruptedException(static_cast<int>(signal)));
+}
+
+void RequestResponseFutureRequester::handleError(folly::exception_wrapper ew) {
+  if (!requested_) {
+    return;
+  }
+  requested_ = false;
+  promise_.setException(std::move(ew));
+  removeFromWriter();
+}
+
+void RequestResponseFutureRequester::handlePayload(
+    Payload&& payload,
+    bool /*flagsComplete*/,
+    bool flagsNext,
+    bool flagsFollows) {
+  CHECK(requested_);
+
+  payloadFragments_.addPayload(std::move(payload), flagsNext, false);
+
+  if (flagsFollows) {
+    // there will be more fragments to come
+    return;
+  }
+
+  auto consumed = payloadFragments_.consumePayloadAndFlags();
+  if (!consumed) {
+    handleMalformedPayload();
+    return;
+  }
+
+  bool finalFlagsNext, finalFlagsComplete;
+  Payload finalPayload;
+
+  std::tie(finalPayload, finalFlagsNext, finalFlagsComplete) =
+      std::move(consumed.value());
+  payloadReceived(finalPayload);
+
+  if (finalPayload || finalFlagsNext || finalFlagsComplete) {
+    requested_ = false;
+    promise_.setValue(std::move(finalPayload));
+  } else {
+    writeInvalidError("Payload, NEXT or COMPLETE flag expected");
+    endStream(StreamCompletionSignal::ERROR);
+  }
+  removeFromWriter();
+}
+
+size_t RequestResponseFutureRequester::getConsumerAllowance() const {
+  return requested_ ? 1 : 0;
+}
+
+} // namespace rsocket
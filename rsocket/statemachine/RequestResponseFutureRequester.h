@@ -0,0 +1,60 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/futures/Promise.h>
+
+#include "rsocket/Payload.h"
+#include "rsocket/statemachine/StreamStateMachineBase.h"
+
+namespace rsocket {
+
+/// RequestResponse requester that completes a promise, rather than signalling
+/// a SingleObserver.  Needs no observer, subscription or scheduling wrapper
+/// around them, so a request costs this object and the promise's core.
+///
+/// The request can't be cancelled: dropping the future discards the response
+/// once it arrives.
+class RequestResponseFutureRequester : public StreamStateMachineBase {
+ public:
+  RequestResponseFutureRequester(
+      std::shared_ptr<StreamsWriter> writer,
+      StreamId streamId,
+      folly::Promise<Payload> promise)
+      : StreamStateMachineBase(std::move(writer), streamId),
+        promise_(std::move(promise)) {}
+
+  /// Sends the REQUEST_RESPONSE frame.
+  void start(Payload request);
+
+ private:
+  void handlePayload(
+      Payload&& payload,
+      bool flagsComplete,
+      bool flagsNext,
+      bool flagsFollows) override;
+  void handleError(folly::exception_wrapper ew) override;
+
+  void endStream(StreamCompletionSignal signal) override;
+
+  size_t getConsumerAllowance() const override;
+
+  folly::Promise<Payload> promise_;
+
+  /// Whether the request was sent and the promise is still pending.
+  bool requested_{false};
+};
+
+} // namespace rsocket
@@ -110,16 +110,26 @@ void RequestResponseRequester::handlePayload(
     return;
   }
 
+  auto consumed = payloadFragments_.consumePayloadAndFlags();
+  if (!consumed) {
+    handleMalformedPayload();
+    return;
+  }
+
   bool finalFlagsNext, finalFlagsComplete;
   Payload finalPayload;
 
   std::tie(finalPayload, finalFlagsNext, finalFlagsComplete) =
-      payloadFragments_.consumePayloadAndFlags();
+      std::move(consumed.value());
+  payloadReceived(finalPayload);
 
   state_ = State::CLOSED;
 
   if (finalPayload || finalFlagsNext) {
-    consumingSubscriber_->onSuccess(std::move(finalPayload));
+    {
+      HandlerTimer timer{*this};
+      consumingSubscriber_->onSuccess(std::move(finalPayload));
+    }
     consumingSubscriber_ = nullptr;
   } else if (!finalFlagsComplete) {
     writeInvalidError("Payload, NEXT or COMPLETE flag expected");
@@ -98,7 +98,12 @@ void RequestResponseResponder::handlePayload(
   }
 
   CHECK(state_ == State::NEW);
-  Payload finalPayload = payloadFragments_.consumePayloadIgnoreFlags();
+  auto consumed = payloadFragments_.consumePayloadIgnoreFlags();
+  if (!consumed) {
+    handleMalformedPayload();
+    return;
+  }
+  Payload finalPayload = std::move(consumed.value());
 
   state_ = State::RESPONDING;
   onNewStreamReady(
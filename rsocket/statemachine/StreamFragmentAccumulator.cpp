@@ -14,26 +14,80 @@
 
 #include "rsocket/statemachine/StreamFragmentAccumulator.h"
 
+#include <folly/tracing/StaticTracepoint.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "rsocket/internal/PayloadCompressor.h"
+
 namespace rsocket {
 
 StreamFragmentAccumulator::StreamFragmentAccumulator()
     : flagsComplete(false), flagsNext(false) {}
 
+StreamFragmentAccumulator::StreamFragmentAccumulator(const Options& options)
+    : flagsComplete(false), flagsNext(false), options_(options) {}
+
+void StreamFragmentAccumulator::appendFragment(
+    std::unique_ptr<folly::IOBuf>& dst,
+    std::unique_ptr<folly::IOBuf> src,
+    size_t sizeHint) {
+  if (!dst) {
+    // A lone fragment is the whole payload, don't copy it until we know more
+    // are coming.
+    dst = std::move(src);
+    return;
+  }
+
+  if (!options_.contiguous) {
+    dst->prev()->appendChain(std::move(src));
+    return;
+  }
+
+  auto const srcLength = src->computeChainDataLength();
+  if (dst->isChained() || dst->isSharedOne() ||
+      dst->tailroom() < srcLength) {
+    // Start (or restart) a contiguous buffer big enough for everything seen
+    // so far, the incoming fragment, and whatever the hint expects.  Without
+    // a hint it at least doubles, so that many small fragments aren't copied
+    // over and over.
+    auto const dstLength = dst->computeChainDataLength();
+    auto capacity = std::max({sizeHint, 2 * dstLength, dstLength + srcLength});
+    if (options_.maxSize) {
+      capacity = std::min(capacity, options_.maxSize);
+    }
+    capacity = std::max(capacity, dstLength + srcLength);
+
+    auto buf = folly::IOBuf::create(capacity);
+    for (const auto range : *dst) {
+      std::memcpy(buf->writableTail(), range.data(), range.size());
+      buf->append(range.size());
+    }
+    dst = std::move(buf);
+  }
+
+  for (const auto range : *src) {
+    std::memcpy(dst->writableTail(), range.data(), range.size());
+    dst->append(range.size());
+  }
+}
+
 void StreamFragmentAccumulator::addPayloadIgnoreFlags(Payload p) {
+  if (!anyFragments()) {
+    FOLLY_SDT(rsocket, reassembly_start, this);
+  }
+  size_ += p.metadata ? p.metadata->computeChainDataLength() : 0;
+  size_ += p.data ? p.data->computeChainDataLength() : 0;
+
   if (p.metadata) {
-    if (!fragments.metadata) {
-      fragments.metadata = std::move(p.metadata);
-    } else {
-      fragments.metadata->prev()->appendChain(std::move(p.metadata));
-    }
+    appendFragment(fragments.metadata, std::move(p.metadata), 0);
   }
 
   if (p.data) {
-    if (!fragments.data) {
-      fragments.data = std::move(p.data);
-    } else {
-      fragments.data->prev()->appendChain(std::move(p.data));
-    }
+    auto const sizeHint =
+        options_.sizeHint ? options_.sizeHint : lastDataSize_;
+    appendFragment(fragments.data, std::move(p.data), sizeHint);
   }
 }
 
@@ -46,19 +100,53 @@ void StreamFragmentAccumulator::addPayload(
   addPayloadIgnoreFlags(std::move(p));
 }
 
-Payload StreamFragmentAccumulator::consumePayloadIgnoreFlags() {
+bool StreamFragmentAccumulator::exceedsMaxSize(
+    const Payload& p,
+    bool flagsFollows) const {
+  if (!options_.maxSize || (!flagsFollows && !anyFragments())) {
+    return false;
+  }
+  auto const length = (p.metadata ? p.metadata->computeChainDataLength() : 0) +
+      (p.data ? p.data->computeChainDataLength() : 0);
+  return size_ + length > options_.maxSize;
+}
+
+void StreamFragmentAccumulator::onConsumed() {
+  FOLLY_SDT(rsocket, reassembly_finish, this, size_);
   flagsComplete = false;
   flagsNext = false;
-  return std::move(fragments);
+  size_ = 0;
+  if (fragments.data) {
+    lastDataSize_ = fragments.data->computeChainDataLength();
+  }
 }
 
-std::tuple<Payload, bool, bool>
+folly::Expected<Payload, folly::Unit>
+StreamFragmentAccumulator::takeFragments() {
+  auto payload = std::move(fragments);
+  if (options_.compressor && !options_.compressor->decompress(payload)) {
+    VLOG(3) << "Dropping a malformed compressed payload";
+    return folly::makeUnexpected(folly::unit);
+  }
+  return payload;
+}
+
+folly::Expected<Payload, folly::Unit>
+StreamFragmentAccumulator::consumePayloadIgnoreFlags() {
+  onConsumed();
+  return takeFragments();
+}
+
+folly::Expected<std::tuple<Payload, bool, bool>, folly::Unit>
 StreamFragmentAccumulator::consumePayloadAndFlags() {
-  auto ret = std::make_tuple(
-      std::move(fragments), bool(flagsNext), bool(flagsComplete));
-  flagsComplete = false;
-  flagsNext = false;
-  return ret;
+  auto const next = bool(flagsNext);
+  auto const complete = bool(flagsComplete);
+  onConsumed();
+  auto payload = takeFragments();
+  if (!payload) {
+    return folly::makeUnexpected(payload.error());
+  }
+  return std::make_tuple(std::move(payload.value()), next, complete);
 }
 
 } /* namespace rsocket */
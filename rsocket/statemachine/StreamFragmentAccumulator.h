@@ -14,28 +14,86 @@
 
 #pragma once
 
+#include <memory>
+#include <tuple>
+
+#include <folly/Expected.h>
+#include <folly/Unit.h>
+
 #include "rsocket/Payload.h"
 
 namespace rsocket {
 
+class PayloadCompressor;
+
 class StreamFragmentAccumulator {
  public:
+  struct Options {
+    /// Copy fragments into one contiguous buffer per payload part instead of
+    /// chaining them, so consumers don't need to coalesce the result.
+    bool contiguous{false};
+
+    /// Capacity to reserve for contiguous reassembly of the data.  When zero,
+    /// the size of the previous payload reassembled on this stream is used.
+    size_t sizeHint{0};
+
+    /// Largest fragmented payload (data and metadata combined) accepted, or
+    /// zero for no limit.
+    size_t maxSize{0};
+
+    /// When set, reassembled payloads are decompressed before being handed
+    /// out.
+    std::shared_ptr<const PayloadCompressor> compressor;
+  };
+
   StreamFragmentAccumulator();
+  explicit StreamFragmentAccumulator(const Options&);
+
+  void setOptions(const Options& options) {
+    options_ = options;
+  }
 
   void addPayloadIgnoreFlags(Payload p);
   void addPayload(Payload p, bool next, bool complete);
 
-  Payload consumePayloadIgnoreFlags();
-  std::tuple<Payload, bool, bool> consumePayloadAndFlags();
+  /// Take the reassembled payload.  Fails, dropping the payload, when its
+  /// data doesn't decompress, see Options::compressor.
+  folly::Expected<Payload, folly::Unit> consumePayloadIgnoreFlags();
+  folly::Expected<std::tuple<Payload, bool, bool>, folly::Unit>
+  consumePayloadAndFlags();
 
   bool anyFragments() const {
     return fragments.data || fragments.metadata;
   }
 
+  /// Bytes accumulated so far, data and metadata combined.
+  size_t size() const {
+    return size_;
+  }
+
+  /// Whether accepting `p` would take the payload being reassembled over
+  /// Options::maxSize.  Unfragmented payloads are never rejected.
+  bool exceedsMaxSize(const Payload& p, bool flagsFollows) const;
+
  private:
+  void appendFragment(
+      std::unique_ptr<folly::IOBuf>& dst,
+      std::unique_ptr<folly::IOBuf> src,
+      size_t sizeHint);
+  void onConsumed();
+  folly::Expected<Payload, folly::Unit> takeFragments();
+
   bool flagsComplete : 1;
   bool flagsNext : 1;
   Payload fragments;
+  Options options_;
+
+  /// Bytes accumulated so far, data and metadata combined.
+  size_t size_{0};
+
+  /// Size of the data of the last reassembled payload, used as the size hint
+  /// when none is configured.
+  size_t lastDataSize_{0};
 };
 
 } /* namespace rsocket */
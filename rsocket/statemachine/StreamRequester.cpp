@@ -38,7 +38,7 @@ void StreamRequester::request(int64_t signedN) {
 
   // We must inform ConsumerBase about an implicit allowance we have requested
   // from the remote end.
-  auto const initial = std::min<uint32_t>(n, kMaxRequestN);
+  auto const initial = static_cast<uint32_t>(std::min(n, maxRequestN()));
   addImplicitAllowance(initial);
   newStream(StreamType::STREAM, initial, std::move(initialPayload_));
 
@@ -25,7 +25,20 @@ void StreamResponder::onNext(Payload response) {
   if (publisherClosed()) {
     return;
   }
+  auto const cost = byteCost(response);
   writePayload(std::move(response));
+  payloadPublished(cost);
+}
+
+void StreamResponder::onNextBatch(folly::Range<Payload*> responses) {
+  for (auto& response : responses) {
+    if (publisherClosed()) {
+      return;
+    }
+    auto const cost = byteCost(response);
+    writePayload(std::move(response));
+    payloadPublished(cost);
+  }
 }
 
 void StreamResponder::onComplete() {
@@ -54,6 +67,10 @@ void StreamResponder::handleRequestN(uint32_t n) {
   processRequestN(n);
 }
 
+void StreamResponder::handleByteCredit(uint32_t bytes) {
+  processByteCredit(bytes);
+}
+
 void StreamResponder::handleError(folly::exception_wrapper) {
   handleCancel();
 }
@@ -70,7 +87,12 @@ void StreamResponder::handlePayload(
     return;
   }
 
-  Payload finalPayload = payloadFragments_.consumePayloadIgnoreFlags();
+  auto consumed = payloadFragments_.consumePayloadIgnoreFlags();
+  if (!consumed) {
+    handleMalformedPayload();
+    return;
+  }
+  Payload finalPayload = std::move(consumed.value());
 
   if (newStream_) {
     newStream_ = false;
@@ -90,6 +112,16 @@ void StreamResponder::handleCancel() {
   removeFromWriter();
 }
 
+void StreamResponder::handleOutputPaused(bool paused) {
+  setPublisherPaused(paused);
+}
+
+void StreamResponder::describeFlowControl(
+    StreamFlowControl& flowControl) const {
+  StreamStateMachineBase::describeFlowControl(flowControl);
+  describePublisher(flowControl, payloadsSent());
+}
+
 void StreamResponder::endStream(StreamCompletionSignal signal) {
   if (publisherClosed()) {
     return;
@@ -31,10 +31,11 @@ class StreamResponder : public StreamStateMachineBase,
       StreamId streamId,
       uint32_t initialRequestN)
       : StreamStateMachineBase(std::move(writer), streamId),
-        PublisherBase(initialRequestN) {}
+        PublisherBase(initialRequestN, initialByteCredit()) {}
 
   void onSubscribe(std::shared_ptr<yarpl::flowable::Subscription>) override;
   void onNext(Payload) override;
+  void onNextBatch(folly::Range<Payload*>) override;
   void onComplete() override;
   void onError(folly::exception_wrapper) override;
 
@@ -44,8 +45,11 @@ class StreamResponder : public StreamStateMachineBase,
       bool flagsNext,
       bool flagsFollows) override;
   void handleRequestN(uint32_t) override;
+  void handleByteCredit(uint32_t) override;
   void handleError(folly::exception_wrapper) override;
   void handleCancel() override;
+  void handleOutputPaused(bool) override;
+  void describeFlowControl(StreamFlowControl&) const override;
 
   void endStream(StreamCompletionSignal) override;
 
@@ -14,11 +14,45 @@
 
 #include "rsocket/statemachine/StreamStateMachineBase.h"
 #include <folly/io/IOBuf.h>
+#include <folly/tracing/StaticTracepoint.h>
+#include "rsocket/RSocketStats.h"
+#include "rsocket/StreamAccounting.h"
+#include "rsocket/internal/ByteCredit.h"
 #include "rsocket/statemachine/RSocketStateMachine.h"
 #include "rsocket/statemachine/StreamsWriter.h"
 
+#include <utility>
+
 namespace rsocket {
 
+namespace {
+
+size_t lengthOf(const Payload& payload) {
+  return (payload.data ? payload.data->computeChainDataLength() : 0) +
+      (payload.metadata ? payload.metadata->computeChainDataLength() : 0);
+}
+
+} // namespace
+
+struct StreamStateMachineBase::Accounted {
+  Accounted(StreamAccounting& accounting, std::string key)
+      : accounting(accounting), key(std::move(key)) {}
+
+  StreamAccounting& accounting;
+  const std::string key;
+  StreamAccounting::Usage usage;
+
+  /// Whether the stream was removed from the writer.  Handler time spent
+  /// after that is added to the key right away.
+  bool closed{false};
+};
+
+StreamStateMachineBase::~StreamStateMachineBase() {
+  if (accounted_ && !accounted_->closed) {
+    flushAccounting();
+  }
+}
+
 void StreamStateMachineBase::handleRequestN(uint32_t) {
   VLOG(4) << "Unexpected handleRequestN";
 }
@@ -36,23 +70,41 @@ size_t StreamStateMachineBase::getConsumerAllowance() const {
   return 0;
 }
 
+void StreamStateMachineBase::describeFlowControl(
+    StreamFlowControl& flowControl) const {
+  flowControl.streamId = streamId_;
+  flowControl.age = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - createdAt_);
+  flowControl.reassemblyBytes = payloadFragments_.size();
+}
+
 void StreamStateMachineBase::newStream(
     StreamType streamType,
     uint32_t initialRequestN,
     Payload payload) {
+  streamOpened(streamType, true, payload);
   writer_->writeNewStream(
       streamId_, streamType, initialRequestN, std::move(payload));
 }
 
 void StreamStateMachineBase::writeRequestN(uint32_t n) {
+  FOLLY_SDT(rsocket, request_n_send, this, streamId_, n);
   writer_->writeRequestN(Frame_REQUEST_N{streamId_, n});
 }
 
+void StreamStateMachineBase::writeByteCredit(uint32_t bytes) {
+  writer_->writeExt(ByteCredit::grantFrame(streamId_, bytes));
+}
+
 void StreamStateMachineBase::writeCancel() {
   writer_->writeCancel(Frame_CANCEL{streamId_});
 }
 
 void StreamStateMachineBase::writePayload(Payload&& payload, bool complete) {
+  ++payloadsSent_;
+  if (stats_ || accounted_) {
+    recordPayload(payload, true);
+  }
   auto const flags =
       FrameFlags::NEXT | (complete ? FrameFlags::COMPLETE : FrameFlags::EMPTY_);
   Frame_PAYLOAD frame{streamId_, flags, std::move(payload)};
@@ -76,7 +128,24 @@ void StreamStateMachineBase::writeInvalidError(folly::StringPiece msg) {
   writer_->writeError(Frame_ERROR::invalid(streamId_, msg));
 }
 
+void StreamStateMachineBase::handleMalformedPayload() {
+  constexpr auto msg = "Malformed compressed payload";
+  writeInvalidError(msg);
+  handleError(std::runtime_error(msg));
+}
+
 void StreamStateMachineBase::removeFromWriter() {
+  if (auto stats = std::exchange(stats_, nullptr)) {
+    stats->streamClosed(
+        streamType_,
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - openedAt_),
+        streamBytes_);
+  }
+  if (accounted_ && !accounted_->closed) {
+    accounted_->closed = true;
+    flushAccounting();
+  }
   writer_->onStreamClosed(streamId_);
   // TODO: set writer_ to nullptr
 }
@@ -86,6 +155,8 @@ StreamStateMachineBase::onNewStreamReady(
     StreamType streamType,
     Payload payload,
     std::shared_ptr<yarpl::flowable::Subscriber<Payload>> response) {
+  streamOpened(streamType, false, payload);
+  HandlerTimer timer{*this};
   return writer_->onNewStreamReady(
       streamId_, streamType, std::move(payload), std::move(response));
 }
@@ -94,7 +165,67 @@ void StreamStateMachineBase::onNewStreamReady(
     StreamType streamType,
     Payload payload,
     std::shared_ptr<yarpl::single::SingleObserver<Payload>> response) {
+  streamOpened(streamType, false, payload);
+  HandlerTimer timer{*this};
   writer_->onNewStreamReady(
       streamId_, streamType, std::move(payload), std::move(response));
 }
+
+void StreamStateMachineBase::streamOpened(
+    StreamType streamType,
+    bool requester,
+    const Payload& request) {
+  if (auto accounting = writer_->streamAccounting()) {
+    accounted_ = std::make_unique<Accounted>(
+        *accounting, accounting->keyOf(streamType, request));
+    accounted_->usage.streams = 1;
+    (requester ? accounted_->usage.bytesOut : accounted_->usage.bytesIn) =
+        lengthOf(request);
+  }
+  requester_ = requester;
+
+  stats_ = writer_->streamStats();
+  if (!stats_) {
+    return;
+  }
+  openedAt_ = std::chrono::steady_clock::now();
+  streamBytes_ = lengthOf(request);
+  streamType_ = streamType;
+  firstPayloadSeen_ = false;
+  stats_->streamOpened(streamType);
+}
+
+void StreamStateMachineBase::recordPayload(const Payload& payload, bool sent) {
+  auto const length = lengthOf(payload);
+  if (accounted_) {
+    (sent ? accounted_->usage.bytesOut : accounted_->usage.bytesIn) += length;
+  }
+  if (!stats_) {
+    return;
+  }
+
+  streamBytes_ += length;
+  // The first payload going to the requester.
+  if (!firstPayloadSeen_ && sent != requester_) {
+    firstPayloadSeen_ = true;
+    stats_->streamFirstPayload(
+        streamType_,
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - openedAt_));
+  }
+}
+
+void StreamStateMachineBase::addHandlerTime(
+    std::chrono::steady_clock::duration time) {
+  accounted_->usage.handlerTime +=
+      std::chrono::duration_cast<std::chrono::nanoseconds>(time);
+  if (accounted_->closed) {
+    flushAccounting();
+  }
+}
+
+void StreamStateMachineBase::flushAccounting() {
+  accounted_->accounting.add(accounted_->key, accounted_->usage);
+  accounted_->usage = StreamAccounting::Usage();
+}
 } // namespace rsocket
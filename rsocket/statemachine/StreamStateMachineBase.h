@@ -16,9 +16,14 @@
 
 #include <folly/ExceptionWrapper.h>
 
+#include <chrono>
+#include <memory>
+
+#include "rsocket/FlowControl.h"
 #include "rsocket/framing/FrameHeader.h"
 #include "rsocket/internal/Common.h"
 #include "rsocket/statemachine/StreamFragmentAccumulator.h"
+#include "rsocket/statemachine/StreamsWriter.h"
 #include "yarpl/Flowable.h"
 #include "yarpl/Single.h"
 
@@ -28,7 +33,6 @@ class IOBuf;
 
 namespace rsocket {
 
-class StreamsWriter;
 struct Payload;
 
 /// A common base class of all state machines.
@@ -40,8 +44,12 @@ class StreamStateMachineBase {
   StreamStateMachineBase(
       std::shared_ptr<StreamsWriter> writer,
       StreamId streamId)
-      : writer_(std::move(writer)), streamId_(streamId) {}
-  virtual ~StreamStateMachineBase() = default;
+      : writer_(std::move(writer)), streamId_(streamId) {
+    if (writer_) {
+      payloadFragments_.setOptions(writer_->fragmentReassemblyOptions());
+    }
+  }
+  virtual ~StreamStateMachineBase();
 
   virtual void handlePayload(
       Payload&& payload,
@@ -49,11 +57,26 @@ class StreamStateMachineBase {
       bool flagsNext,
       bool flagsFollows) = 0;
   virtual void handleRequestN(uint32_t n);
+  /// The peer granted more byte credit, see ByteCredit.
+  virtual void handleByteCredit(uint32_t /*bytes*/) {}
   virtual void handleError(folly::exception_wrapper);
   virtual void handleCancel();
 
   virtual size_t getConsumerAllowance() const;
 
+  /// Called when the connection starts or stops holding back output because
+  /// too many frames are pending.  Producers of data should stop asking for
+  /// more while output is paused.
+  virtual void handleOutputPaused(bool /*paused*/) {}
+
+  const StreamFragmentAccumulator& payloadFragments() const {
+    return payloadFragments_;
+  }
+
+  /// Fills in the flow control state of the stream, except for what only
+  /// the connection knows.  See RSocketStateMachine::flowControl().
+  virtual void describeFlowControl(StreamFlowControl&) const;
+
   /// Indicates a terminal signal from the connection.
   ///
   /// This signal corresponds to Subscriber::{onComplete,onError} and
@@ -72,6 +95,7 @@ class StreamStateMachineBase {
   newStream(StreamType streamType, uint32_t initialRequestN, Payload payload);
 
   void writeRequestN(uint32_t);
+  void writeByteCredit(uint32_t bytes);
   void writeCancel();
 
   void writePayload(Payload&& payload, bool complete = false);
@@ -80,8 +104,61 @@ class StreamStateMachineBase {
   void writeApplicationError(Payload&& payload);
   void writeInvalidError(folly::StringPiece);
 
+  /// Fails the stream on a payload that payloadFragments_ couldn't
+  /// decompress: tells the peer with an INVALID error, and closes the stream
+  /// here as if the peer had sent it.
+  void handleMalformedPayload();
+
   void removeFromWriter();
 
+  /// Most credit the stream may have outstanding, see StreamsWriter.
+  size_t requestNLimit() const {
+    return writer_ ? writer_->requestNLimit() : kMaxRequestN;
+  }
+
+  /// Byte credit the stream starts with, see StreamsWriter.
+  size_t initialByteCredit() const {
+    return writer_ ? writer_->initialByteCredit() : 0;
+  }
+
+  /// Number of payloads sent with writePayload().
+  uint64_t payloadsSent() const {
+    return payloadsSent_;
+  }
+
+  /// Counts a payload received on the stream, for RSocketStats and
+  /// StreamAccounting.  Payloads sent with writePayload() are counted already.
+  void payloadReceived(const Payload& payload) {
+    if (stats_ || accounted_) {
+      recordPayload(payload, false);
+    }
+  }
+
+  /// Adds the time until it is destroyed to the handler time of the stream,
+  /// if the writer accounts for streams, see StreamAccounting.
+  class HandlerTimer {
+   public:
+    explicit HandlerTimer(StreamStateMachineBase& stream)
+        : stream_(stream.accounted_ ? &stream : nullptr) {
+      if (stream_) {
+        start_ = std::chrono::steady_clock::now();
+      }
+    }
+
+    ~HandlerTimer() {
+      if (stream_) {
+        stream_->addHandlerTime(std::chrono::steady_clock::now() - start_);
+      }
+    }
+
+    HandlerTimer(const HandlerTimer&) = delete;
+    HandlerTimer& operator=(const HandlerTimer&) = delete;
+
+   private:
+    StreamStateMachineBase* const stream_;
+    std::chrono::steady_clock::time_point start_;
+  };
+
   std::shared_ptr<yarpl::flowable::Subscriber<Payload>> onNewStreamReady(
       StreamType streamType,
       Payload payload,
@@ -99,7 +176,33 @@ class StreamStateMachineBase {
   StreamFragmentAccumulator payloadFragments_;
 
  private:
+  /// Starts reporting the lifecycle of the stream to the stats of the writer,
+  /// if there are any.
+  void streamOpened(StreamType, bool requester, const Payload& request);
+  void recordPayload(const Payload&, bool sent);
+
+  /// Usage of the stream that isn't added to its key yet.
+  struct Accounted;
+
+  void addHandlerTime(std::chrono::steady_clock::duration);
+
+  /// Adds the usage so far to the key of the stream.
+  void flushAccounting();
+
+  const std::chrono::steady_clock::time_point createdAt_{
+      std::chrono::steady_clock::now()};
+  uint64_t payloadsSent_{0};
+
+  RSocketStats* stats_{nullptr};
+  std::unique_ptr<Accounted> accounted_;
+  std::chrono::steady_clock::time_point openedAt_;
+  size_t streamBytes_{0};
+
+  // Kept together so that they share a single word.
   const StreamId streamId_;
+  StreamType streamType_{StreamType::REQUEST_RESPONSE};
+  bool requester_{false};
+  bool firstPayloadSeen_{false};
 };
 
 } // namespace rsocket
@@ -0,0 +1,92 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/statemachine/StreamStateMachinePool.h"
+
+#include <algorithm>
+
+namespace rsocket {
+
+StreamStateMachinePool::StreamStateMachinePool(
+    std::shared_ptr<RSocketStats> stats,
+    size_t maxPooled)
+    : maxPooled_(maxPooled),
+      stats_(stats ? std::move(stats) : RSocketStats::noop()) {}
+
+StreamStateMachinePool::~StreamStateMachinePool() {
+  auto state = state_.lock();
+  for (auto& freeList : state->freeLists) {
+    for (auto block : freeList.blocks) {
+      ::operator delete(block);
+    }
+  }
+}
+
+size_t StreamStateMachinePool::pooled() const {
+  return state_.lock()->pooled;
+}
+
+size_t StreamStateMachinePool::bytes() const {
+  return state_.lock()->bytes;
+}
+
+void* StreamStateMachinePool::allocate(size_t size) {
+  {
+    auto state = state_.lock();
+    for (auto& freeList : state->freeLists) {
+      if (freeList.size == size) {
+        if (!freeList.blocks.empty()) {
+          auto block = freeList.blocks.back();
+          freeList.blocks.pop_back();
+          --state->pooled;
+          state.unlock();
+          stats_->streamStateMachineAllocated(true);
+          return block;
+        }
+        break;
+      }
+    }
+  }
+  stats_->streamStateMachineAllocated(false);
+  auto block = ::operator new(size);
+  state_.lock()->bytes += size;
+  return block;
+}
+
+void StreamStateMachinePool::deallocate(void* block, size_t size) noexcept {
+  {
+    auto state = state_.lock();
+    if (state->pooled < maxPooled_) {
+      try {
+        auto it = std::find_if(
+            state->freeLists.begin(),
+            state->freeLists.end(),
+            [size](const FreeList& list) { return list.size == size; });
+        if (it == state->freeLists.end()) {
+          state->freeLists.push_back(FreeList{size, {}});
+          it = state->freeLists.end() - 1;
+        }
+        it->blocks.push_back(block);
+        ++state->pooled;
+        return;
+      } catch (const std::bad_alloc&) {
+        // Fall through and free the block instead.
+      }
+    }
+    state->bytes -= size;
+  }
+  ::operator delete(block);
+}
+
+} // namespace rsocket
@@ -0,0 +1,121 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Synchronized.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "rsocket/RSocketStats.h"
+
+namespace rsocket {
+
+/// Per-connection pool of the memory backing stream state machines.
+///
+/// State machines are created with std::allocate_shared, so the object and
+/// its control block live in one block.  When the last reference to a state
+/// machine goes away (normally right after its stream is closed) the block is
+/// kept on a free list for the next state machine of the same size, instead
+/// of going back to the allocator.  At most maxPooled blocks are kept.
+///
+/// The objects themselves are never reused, so a stray reference held by an
+/// application can't observe a recycled stream.
+///
+/// State machines might be destroyed on a different thread than they were
+/// created, and might outlive the connection, so the free lists are locked
+/// and each block keeps the pool alive.
+class StreamStateMachinePool
+    : public std::enable_shared_from_this<StreamStateMachinePool> {
+ public:
+  static constexpr size_t kDefaultMaxPooled = 256;
+
+  explicit StreamStateMachinePool(
+      std::shared_ptr<RSocketStats> stats,
+      size_t maxPooled = kDefaultMaxPooled);
+  ~StreamStateMachinePool();
+
+  StreamStateMachinePool(const StreamStateMachinePool&) = delete;
+  StreamStateMachinePool& operator=(const StreamStateMachinePool&) = delete;
+
+  template <typename T, typename... Args>
+  std::shared_ptr<T> make(Args&&... args) {
+    return std::allocate_shared<T>(
+        Allocator<T>(shared_from_this()), std::forward<Args>(args)...);
+  }
+
+  /// Number of free blocks currently held.
+  size_t pooled() const;
+
+  /// Bytes of the blocks backing live state machines, plus the free blocks.
+  size_t bytes() const;
+
+ private:
+  template <typename T>
+  struct Allocator {
+    using value_type = T;
+
+    explicit Allocator(std::shared_ptr<StreamStateMachinePool> p)
+        : pool(std::move(p)) {}
+
+    template <typename U>
+    Allocator(const Allocator<U>& other) : pool(other.pool) {}
+
+    T* allocate(size_t n) {
+      return static_cast<T*>(pool->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* ptr, size_t n) noexcept {
+      pool->deallocate(ptr, n * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const Allocator<U>& other) const {
+      return pool == other.pool;
+    }
+
+    template <typename U>
+    bool operator!=(const Allocator<U>& other) const {
+      return pool != other.pool;
+    }
+
+    std::shared_ptr<StreamStateMachinePool> pool;
+  };
+
+  struct FreeList {
+    size_t size;
+    std::vector<void*> blocks;
+  };
+
+  struct State {
+    /// One free list per block size.  There are only a handful of state
+    /// machine types, so this is searched linearly.
+    std::vector<FreeList> freeLists;
+    size_t pooled{0};
+
+    /// Bytes of all the blocks handed out and not freed, pooled or not.
+    size_t bytes{0};
+  };
+
+  void* allocate(size_t size);
+  void deallocate(void* block, size_t size) noexcept;
+
+  folly::Synchronized<State, std::mutex> state_;
+  const size_t maxPooled_;
+  const std::shared_ptr<RSocketStats> stats_;
+};
+
+} // namespace rsocket
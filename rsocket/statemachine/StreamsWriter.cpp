@@ -14,8 +14,12 @@
 
 #include "rsocket/statemachine/StreamsWriter.h"
 
+#include <algorithm>
+#include <limits>
+
 #include "rsocket/RSocketStats.h"
-#include "rsocket/framing/FrameSerializer.h"
+#include "rsocket/internal/FrameTracer.h"
+#include "rsocket/internal/PayloadCompressor.h"
 
 namespace rsocket {
 
@@ -31,10 +35,12 @@ void StreamsWriterImpl::outputFrameOrEnqueue(
 void StreamsWriterImpl::sendPendingFrames() {
   // We are free to try to send frames again.  Not all frames might be sent if
   // the connection breaks, the rest of them will queue up again.
-  auto frames = consumePendingOutputFrames();
-  for (auto& frame : frames) {
-    outputFrameOrEnqueue(std::move(frame));
+  if (auto frames = consumePendingOutputFrames()) {
+    for (auto& frame : *frames) {
+      outputFrameOrEnqueue(std::move(frame));
+    }
   }
+  updatePendingOutputPaused();
 }
 
 void StreamsWriterImpl::enqueuePendingOutputFrame(
@@ -42,12 +48,24 @@ void StreamsWriterImpl::enqueuePendingOutputFrame(
   auto const length = frame->computeChainDataLength();
   stats().streamBufferChanged(1, static_cast<int64_t>(length));
   pendingSize_ += length;
-  pendingOutputFrames_.push_back(std::move(frame));
+  if (!pendingOutputFrames_) {
+    pendingOutputFrames_ = std::make_unique<PendingOutputFrames>();
+  }
+  pendingOutputFrames_->push_back(std::move(frame));
+
+  // Only pause here.  Resuming waits until an attempt to send the pending
+  // frames is over, as they are consumed and queued again meanwhile.
+  if (!pendingOutputPaused_) {
+    updatePendingOutputPaused();
+  }
 }
 
-std::deque<std::unique_ptr<folly::IOBuf>>
+std::unique_ptr<StreamsWriterImpl::PendingOutputFrames>
 StreamsWriterImpl::consumePendingOutputFrames() {
-  if (auto const numFrames = pendingOutputFrames_.size()) {
+  if (!pendingOutputFrames_) {
+    return nullptr;
+  }
+  if (auto const numFrames = pendingOutputFrames_->size()) {
     stats().streamBufferChanged(
         -static_cast<int64_t>(numFrames), -static_cast<int64_t>(pendingSize_));
     pendingSize_ = 0;
@@ -55,58 +73,178 @@ StreamsWriterImpl::consumePendingOutputFrames() {
   return std::move(pendingOutputFrames_);
 }
 
+void StreamsWriterImpl::updatePendingOutputPaused() {
+  auto const& options = pendingOutputOptions_;
+  if (!pendingOutputPaused_) {
+    if (options.highWatermark > 0 && pendingSize_ >= options.highWatermark) {
+      pendingOutputPaused_ = true;
+      onPendingOutputPaused(true);
+    }
+  } else if (pendingSize_ <= options.lowWatermark) {
+    pendingOutputPaused_ = false;
+    onPendingOutputPaused(false);
+  }
+}
+
+void StreamsWriterImpl::outputStreamFrame(
+    StreamId streamId,
+    std::unique_ptr<folly::IOBuf> frame) {
+  if (FrameTracer::sampled(streamId)) {
+    FrameTracer::record(
+        FrameTracer::Point::SERIALIZED,
+        streamId,
+        serializer().peekFrameType(*frame));
+  }
+
+  if (!outputScheduler_) {
+    outputFrameOrEnqueue(std::move(frame));
+    return;
+  }
+
+  if (shouldQueue()) {
+    // Keeps the frames of each stream in order.
+    requeueScheduledFrames();
+    enqueuePendingOutputFrame(std::move(frame));
+    return;
+  }
+
+  outputScheduler_->push(streamId, std::move(frame));
+  if (!drainScheduled_) {
+    drainScheduled_ = true;
+    scheduleOutput();
+  }
+}
+
+void StreamsWriterImpl::enableOutputScheduler(
+    const OutputScheduler::Options& options) {
+  DCHECK(!outputScheduler_ || outputScheduler_->empty());
+  outputScheduler_ = std::make_unique<OutputScheduler>(options);
+}
+
+void StreamsWriterImpl::scheduleOutput() {
+  drainScheduled_ = false;
+  flushScheduledFrames();
+}
+
+void StreamsWriterImpl::drainScheduledFrames() {
+  drainScheduled_ = false;
+  if (!outputScheduler_) {
+    return;
+  }
+
+  writeScheduledFrames(outputScheduler_->options().maxBytesPerLoop);
+  if (!outputScheduler_->empty() && !drainScheduled_) {
+    drainScheduled_ = true;
+    scheduleOutput();
+  }
+}
+
+void StreamsWriterImpl::flushScheduledFrames() {
+  if (outputScheduler_) {
+    writeScheduledFrames(std::numeric_limits<size_t>::max());
+  }
+}
+
+void StreamsWriterImpl::writeScheduledFrames(size_t maxBytes) {
+  size_t written = 0;
+  while (!outputScheduler_->empty() && written < maxBytes) {
+    if (shouldQueue()) {
+      requeueScheduledFrames();
+      return;
+    }
+    auto frame = outputScheduler_->pop();
+    if (!frame) {
+      // The rest was past its deadline.
+      break;
+    }
+    written += frame->computeChainDataLength();
+    outputFrame(std::move(frame));
+  }
+  reportExpiredFramesDropped();
+}
+
+void StreamsWriterImpl::requeueScheduledFrames() {
+  while (auto frame = outputScheduler_->pop()) {
+    enqueuePendingOutputFrame(std::move(frame));
+  }
+  reportExpiredFramesDropped();
+}
+
+void StreamsWriterImpl::reportExpiredFramesDropped() {
+  if (auto const dropped = outputScheduler_->takeExpiredFramesDropped()) {
+    stats().expiredFramesDropped(dropped);
+  }
+}
+
 void StreamsWriterImpl::writeNewStream(
     StreamId streamId,
     StreamType streamType,
     uint32_t initialRequestN,
     Payload payload) {
-  // for simplicity, require that sent buffers don't consist of chains
   writeFragmented(
       [&](Payload p, FrameFlags flags) {
         switch (streamType) {
           case StreamType::CHANNEL:
-            outputFrameOrEnqueue(
-                serializer().serializeOut(Frame_REQUEST_CHANNEL(
+            outputStreamFrame(
+                streamId,
+                serializeOut(Frame_REQUEST_CHANNEL(
                     streamId, flags, initialRequestN, std::move(p))));
             break;
           case StreamType::STREAM:
-            outputFrameOrEnqueue(serializer().serializeOut(Frame_REQUEST_STREAM(
-                streamId, flags, initialRequestN, std::move(p))));
+            outputStreamFrame(
+                streamId,
+                serializeOut(Frame_REQUEST_STREAM(
+                    streamId, flags, initialRequestN, std::move(p))));
             break;
           case StreamType::REQUEST_RESPONSE:
-            outputFrameOrEnqueue(serializer().serializeOut(
-                Frame_REQUEST_RESPONSE(streamId, flags, std::move(p))));
+            outputStreamFrame(
+                streamId,
+                serializeOut(
+                    Frame_REQUEST_RESPONSE(streamId, flags, std::move(p))));
             break;
           case StreamType::FNF:
-            outputFrameOrEnqueue(serializer().serializeOut(
-                Frame_REQUEST_FNF(streamId, flags, std::move(p))));
+            outputStreamFrame(
+                streamId,
+                serializeOut(
+                    Frame_REQUEST_FNF(streamId, flags, std::move(p))));
             break;
           default:
             CHECK(false) << "invalid stream type " << toString(streamType);
         }
       },
       streamId,
-      FrameFlags::EMPTY_,
+      streamFrameFlags(streamId),
       std::move(payload));
 }
 
 void StreamsWriterImpl::writeRequestN(Frame_REQUEST_N&& frame) {
-  outputFrameOrEnqueue(serializer().serializeOut(std::move(frame)));
+  auto const streamId = frame.header_.streamId;
+  frame.header_.flags |= streamFrameFlags(streamId);
+  outputStreamFrame(streamId, serializeOut(std::move(frame)));
 }
 
 void StreamsWriterImpl::writeCancel(Frame_CANCEL&& frame) {
-  outputFrameOrEnqueue(serializer().serializeOut(std::move(frame)));
+  auto const streamId = frame.header_.streamId;
+  frame.header_.flags |= streamFrameFlags(streamId);
+  outputStreamFrame(streamId, serializeOut(std::move(frame)));
+}
+
+void StreamsWriterImpl::writeExt(Frame_EXT&& frame) {
+  auto const streamId = frame.header_.streamId;
+  frame.header_.flags |= streamFrameFlags(streamId);
+  outputStreamFrame(streamId, serializeOut(std::move(frame)));
 }
 
 void StreamsWriterImpl::writePayload(Frame_PAYLOAD&& f) {
   Frame_PAYLOAD frame = std::move(f);
   auto const streamId = frame.header_.streamId;
-  auto const initialFlags = frame.header_.flags;
+  auto const initialFlags = frame.header_.flags | streamFrameFlags(streamId);
 
   writeFragmented(
       [this, streamId](Payload p, FrameFlags flags) {
-        outputFrameOrEnqueue(serializer().serializeOut(
-            Frame_PAYLOAD(streamId, flags, std::move(p))));
+        outputStreamFrame(
+            streamId,
+            serializeOut(Frame_PAYLOAD(streamId, flags, std::move(p))));
       },
       streamId,
       initialFlags,
@@ -115,9 +253,13 @@ void StreamsWriterImpl::writePayload(Frame_PAYLOAD&& f) {
 
 void StreamsWriterImpl::writeError(Frame_ERROR&& frame) {
   // TODO: implement fragmentation for writeError as well
-  outputFrameOrEnqueue(serializer().serializeOut(std::move(frame)));
+  auto const streamId = frame.header_.streamId;
+  frame.header_.flags |= streamFrameFlags(streamId);
+  outputStreamFrame(streamId, serializeOut(std::move(frame)));
 }
 
+namespace {
+
 // The max amount of user data transmitted per frame - eg the size
 // of the data and metadata combined, plus the size of the frame header.
 // This assumes that the frame header will never be more than 512 bytes in
@@ -126,12 +268,80 @@ void StreamsWriterImpl::writeError(Frame_ERROR&& frame) {
 // be noticeable (0.003% wasted at most)
 constexpr size_t GENEROUS_MAX_FRAME_SIZE = 0xFFFFFF - 512;
 
+/// Detaches up to `len` bytes from the front of `chain` without copying any
+/// data.  Buffers that fit entirely are unlinked from the chain and moved
+/// over, a buffer straddling the boundary is shared between the two halves
+/// with cloneOne() and trimmed on each side.  `chainLength` is kept in sync
+/// with the bytes remaining in `chain`.
+std::unique_ptr<folly::IOBuf> splitChainAtMost(
+    std::unique_ptr<folly::IOBuf>& chain,
+    size_t& chainLength,
+    size_t len) {
+  std::unique_ptr<folly::IOBuf> head;
+  auto append = [&](std::unique_ptr<folly::IOBuf> buf) {
+    if (head) {
+      head->prependChain(std::move(buf));
+    } else {
+      head = std::move(buf);
+    }
+  };
+
+  while (chain && len > 0) {
+    const auto bufLength = chain->length();
+    if (bufLength <= len) {
+      auto rest = chain->pop();
+      len -= bufLength;
+      chainLength -= bufLength;
+      append(std::move(chain));
+      chain = std::move(rest);
+    } else {
+      auto part = chain->cloneOne();
+      part->trimEnd(bufLength - len);
+      chain->trimStart(len);
+      chainLength -= len;
+      len = 0;
+      append(std::move(part));
+    }
+  }
+
+  return head ? std::move(head) : folly::IOBuf::create(0);
+}
+
+} // namespace
+
+size_t adaptiveFragmentSize(
+    const FragmentSizeOptions& options,
+    const DuplexConnection::TransportInfo& info,
+    size_t streams) {
+  DCHECK_LE(options.minFragmentSize, options.maxFragmentSize);
+  auto size = options.maxFragmentSize;
+  if (info.sendBufferSize > 0) {
+    size = std::min(size, info.sendBufferSize / std::max<size_t>(streams, 1));
+  }
+  if (info.congestionWindow > 0 && info.rtt.count() > 0) {
+    // A congestion window goes out once per round trip.
+    auto const sentInDelay = static_cast<double>(info.congestionWindow) *
+        options.maxFragmentDelay.count() / info.rtt.count();
+    if (sentInDelay < size) {
+      size = static_cast<size_t>(sentInDelay);
+    }
+  }
+  return std::max(size, options.minFragmentSize);
+}
+
+size_t StreamsWriterImpl::maxFragmentSize() const {
+  return GENEROUS_MAX_FRAME_SIZE;
+}
+
 // writeFragmented takes a `payload` and splits it up into chunks which
 // are sent as fragmented requests. The first fragmented payload is
 // given to writeInitialFrame, which is expected to write the initial
 // "REQUEST_" or "PAYLOAD" frame of a stream or response. writeFragmented
 // then writes the rest of the frames as payloads.
 //
+// The payload may be an arbitrary IOBuf chain.  Fragments reference the
+// original buffers rather than copies of them.
+//
 // writeInitialFrame
 //  - called with the payload of the first frame to send, and any additional
 //    flags (eg, addFlags with FOLLOWS, if there are more frames to write)
@@ -148,34 +358,41 @@ void StreamsWriterImpl::writeFragmented(
     StreamId const streamId,
     FrameFlags const addFlags,
     Payload payload) {
-  folly::IOBufQueue metaQueue{folly::IOBufQueue::cacheChainLength()};
-  folly::IOBufQueue dataQueue{folly::IOBufQueue::cacheChainLength()};
+  if (auto const compressor = payloadCompressor()) {
+    compressor->compress(payload);
+  }
+
+  auto const fragmentSize = maxFragmentSize();
 
   // have to keep track of "did the full payload even have a metadata", because
   // the rsocket protocol makes a distinction between a zero-length metadata
   // and a null metadata.
   bool const haveNonNullMeta = !!payload.metadata;
-  metaQueue.append(std::move(payload.metadata));
-  dataQueue.append(std::move(payload.data));
+  size_t metaLeft =
+      haveNonNullMeta ? payload.metadata->computeChainDataLength() : 0;
+  size_t dataLeft = payload.data ? payload.data->computeChainDataLength() : 0;
+
+  // Common case: everything fits in one frame, send the payload as is.
+  if (metaLeft + dataLeft <= fragmentSize) {
+    writeInitialFrame(std::move(payload), addFlags);
+    return;
+  }
 
   bool isFirstFrame = true;
 
   while (true) {
     Payload sendme;
 
-    // chew off some metadata (splitAtMost will never return a null pointer,
-    // safe to compute length on it always)
+    // chew off some metadata (splitChainAtMost will never return a null
+    // pointer)
+    size_t metaSent = 0;
     if (haveNonNullMeta) {
-      sendme.metadata = metaQueue.splitAtMost(GENEROUS_MAX_FRAME_SIZE);
-      DCHECK_GE(
-          GENEROUS_MAX_FRAME_SIZE, sendme.metadata->computeChainDataLength());
+      metaSent = std::min(metaLeft, fragmentSize);
+      sendme.metadata = splitChainAtMost(payload.metadata, metaLeft, metaSent);
     }
-    sendme.data = dataQueue.splitAtMost(
-        GENEROUS_MAX_FRAME_SIZE -
-        (haveNonNullMeta ? sendme.metadata->computeChainDataLength() : 0));
+    sendme.data = splitChainAtMost(
+        payload.data, dataLeft, std::min(dataLeft, fragmentSize - metaSent));
 
-    auto const metaLeft = metaQueue.chainLength();
-    auto const dataLeft = dataQueue.chainLength();
     auto const moreFragments = metaLeft || dataLeft;
     auto const flags =
         (moreFragments ? FrameFlags::FOLLOWS : FrameFlags::EMPTY_) | addFlags;
@@ -184,8 +401,9 @@ void StreamsWriterImpl::writeFragmented(
       isFirstFrame = false;
       writeInitialFrame(std::move(sendme), flags);
     } else {
-      outputFrameOrEnqueue(serializer().serializeOut(
-          Frame_PAYLOAD(streamId, flags, std::move(sendme))));
+      outputStreamFrame(
+          streamId,
+          serializeOut(Frame_PAYLOAD(streamId, flags, std::move(sendme))));
     }
 
     if (!moreFragments) {
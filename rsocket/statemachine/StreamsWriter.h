@@ -14,19 +14,123 @@
 
 #pragma once
 
+#include <folly/Optional.h>
+
+#include <chrono>
 #include <deque>
 
 #include <yarpl/Flowable.h>
 #include <yarpl/Single.h>
+#include "rsocket/DuplexConnection.h"
 #include "rsocket/Payload.h"
 #include "rsocket/framing/Frame.h"
+#include "rsocket/framing/FrameSerializer_v1_0.h"
 #include "rsocket/framing/FrameType.h"
 #include "rsocket/internal/Common.h"
+#include "rsocket/internal/OutputScheduler.h"
+#include "rsocket/internal/RequestNWindow.h"
+#include "rsocket/statemachine/StreamFragmentAccumulator.h"
 
 namespace rsocket {
 
+class PayloadCompressor;
 class RSocketStats;
-class FrameSerializer;
+class StreamAccounting;
+
+/// When a consumer replenishes its peer's allowance with REQUEST_N frames.
+///
+/// By default the pending allowance is sent once the peer's outstanding
+/// allowance is no larger than it, i.e. once about half of what was requested
+/// has been delivered.
+struct RequestNOptions {
+  /// Send the pending allowance once the peer's outstanding allowance is at
+  /// most this many, instead of the default rule.  With zero, REQUEST_N is
+  /// only sent once the peer has run out.
+  folly::Optional<size_t> lowWatermark;
+
+  /// Also send the pending allowance as soon as it reaches this many,
+  /// whatever the outstanding allowance.  Zero disables this.
+  size_t highWatermark{0};
+
+  /// Send at the end of the current EventBase loop iteration, so that all
+  /// request() calls made during an iteration result in at most one frame.
+  bool deferToLoopEnd{false};
+
+  /// Keep the peer's outstanding allowance at the bandwidth-delay product of
+  /// the stream instead, see RequestNWindow.  The consumer's requests beyond
+  /// the window are held back until the peer uses up half of it.  Replaces
+  /// lowWatermark and highWatermark, and also bounds the allowance sent with
+  /// the initial request.
+  folly::Optional<RequestNWindow::Options> adaptiveWindow;
+};
+
+/// Bounds on the frames a connection holds back while it can't send them, e.g.
+/// while it is resuming.
+struct PendingOutputOptions {
+  /// Once this many bytes of frames are pending, streams stop asking their
+  /// producers for more data and new requests fail.  Zero disables the bound.
+  size_t highWatermark{0};
+
+  /// Streams go back to asking for data once no more than this many bytes are
+  /// pending.
+  size_t lowWatermark{0};
+};
+
+/// Bounds on the bytes a connection hands to its transport that the transport
+/// hasn't written out yet, see DuplexConnection::bufferedOutputBytes().  Only
+/// apply to transports that run on the thread of the connection.
+struct TransportOutputOptions {
+  /// Once the transport buffers this many bytes, streams stop asking their
+  /// producers for more data.  Unlike PendingOutputOptions, new requests are
+  /// still accepted.  Zero disables the bound.
+  size_t highWatermark{0};
+
+  /// Streams go back to asking for data once the transport buffers no more
+  /// than this many bytes.
+  size_t lowWatermark{0};
+};
+
+/// Lets the frames of requests made in a burst share a single write to the
+/// transport, rather than taking one each, see
+/// RSocketRequester::withRequestBatching().
+struct RequestBatchingOptions {
+  /// Longest a request is held back waiting for others to share its write.
+  /// Zero holds it until the end of the current EventBase loop iteration.
+  std::chrono::milliseconds maxDelay{0};
+
+  /// The batch is written as soon as it holds this many bytes.
+  size_t maxBytes{16 * 1024};
+};
+
+/// Sizes the fragments of large payloads from the conditions of the
+/// transport, rather than sending each payload in as few frames as possible.
+///
+/// A fragment gets an equal share of the socket's send buffer among the
+/// streams of the connection, and no more than the transport sends in
+/// `maxFragmentDelay` at the rate its congestion window and round-trip time
+/// allow.  Large fragments keep the header overhead low on a fast link, small
+/// ones keep a slow link from holding the frames of other streams back behind
+/// a fragment for long.
+struct FragmentSizeOptions {
+  /// Bounds of the fragment size, in payload bytes.  Also the size used when
+  /// the transport doesn't tell its conditions.
+  size_t minFragmentSize{4 * 1024};
+  size_t maxFragmentSize{1024 * 1024};
+
+  /// Longest a fragment should take the transport to send.
+  std::chrono::microseconds maxFragmentDelay{1000};
+
+  /// How long a fragment size is used before the conditions of the transport
+  /// are read again.
+  std::chrono::milliseconds refreshInterval{100};
+};
+
+/// The fragment size for a connection with `streams` open streams, see
+/// FragmentSizeOptions.
+size_t adaptiveFragmentSize(
+    const FragmentSizeOptions& options,
+    const DuplexConnection::TransportInfo& info,
+    size_t streams);
 
 /// The interface for writing stream related frames on the wire.
 class StreamsWriter {
@@ -41,6 +145,7 @@ class StreamsWriter {
 
   virtual void writeRequestN(Frame_REQUEST_N&&) = 0;
   virtual void writeCancel(Frame_CANCEL&&) = 0;
+  virtual void writeExt(Frame_EXT&&) = 0;
 
   virtual void writePayload(Frame_PAYLOAD&&) = 0;
   virtual void writeError(Frame_ERROR&&) = 0;
@@ -58,6 +163,42 @@ class StreamsWriter {
       StreamType streamType,
       Payload payload,
       std::shared_ptr<yarpl::single::SingleObserver<Payload>> response) = 0;
+
+  /// How streams writing to this writer reassemble fragmented payloads.
+  virtual StreamFragmentAccumulator::Options fragmentReassemblyOptions()
+      const {
+    return StreamFragmentAccumulator::Options();
+  }
+
+  /// How streams writing to this writer send REQUEST_N frames.
+  virtual RequestNOptions requestNOptions() const {
+    return RequestNOptions();
+  }
+
+  /// Most credit a stream writing to this writer may have outstanding with
+  /// its peer, across its REQUEST_N frames.  Read every time the stream sends
+  /// credit, so it may change over the life of the stream.
+  virtual size_t requestNLimit() const {
+    return kMaxRequestN;
+  }
+
+  /// Byte credit each stream starts with in each direction, or zero unless
+  /// byte-based flow control was negotiated.  See ByteCredit.
+  virtual size_t initialByteCredit() const {
+    return 0;
+  }
+
+  /// Where streams writing to this writer report their lifecycle, see
+  /// RSocketStats::streamOpened().  Null if they don't.
+  virtual RSocketStats* streamStats() {
+    return nullptr;
+  }
+
+  /// Where streams writing to this writer account for their usage.  Null if
+  /// they don't.
+  virtual StreamAccounting* streamAccounting() {
+    return nullptr;
+  }
 };
 
 class StreamsWriterImpl : public StreamsWriter {
@@ -70,19 +211,49 @@ class StreamsWriterImpl : public StreamsWriter {
 
   void writeRequestN(Frame_REQUEST_N&&) override;
   void writeCancel(Frame_CANCEL&&) override;
+  void writeExt(Frame_EXT&&) override;
 
   void writePayload(Frame_PAYLOAD&&) override;
 
   // TODO: writeFragmentedError
   void writeError(Frame_ERROR&&) override;
 
+  RSocketStats* streamStats() override {
+    return &stats();
+  }
+
  protected:
+  using PendingOutputFrames = std::deque<std::unique_ptr<folly::IOBuf>>;
+
   // note: onStreamClosed() method is also still pure
   virtual void outputFrame(std::unique_ptr<folly::IOBuf>) = 0;
-  virtual FrameSerializer& serializer() = 0;
+  virtual const FrameSerializer& serializer() = 0;
   virtual RSocketStats& stats() = 0;
   virtual bool shouldQueue() = 0;
 
+  /// The most payload bytes (data and metadata combined) sent in a single
+  /// frame before the payload is fragmented.
+  virtual size_t maxFragmentSize() const;
+
+  /// Compressor applied to outgoing payloads, if compression was negotiated.
+  virtual const PayloadCompressor* payloadCompressor() const {
+    return nullptr;
+  }
+
+  /// Flags added to every frame written for the stream.
+  virtual FrameFlags streamFrameFlags(StreamId) const {
+    return FrameFlags::EMPTY_;
+  }
+
+  /// Serialize a frame, bypassing virtual dispatch when the connection's
+  /// serializer is a FrameSerializerV1_0.
+  template <typename TFrame>
+  std::unique_ptr<folly::IOBuf> serializeOut(TFrame&& frame) {
+    return visitFrameSerializer(serializer(), [&](const auto& s) {
+      return s.serializeOut(std::forward<TFrame>(frame));
+    });
+  }
+
   template <typename WriteInitialFrame>
   void writeFragmented(
       WriteInitialFrame,
@@ -94,14 +265,87 @@ class StreamsWriterImpl : public StreamsWriter {
   virtual void sendPendingFrames();
   void outputFrameOrEnqueue(std::unique_ptr<folly::IOBuf>);
   void enqueuePendingOutputFrame(std::unique_ptr<folly::IOBuf> frame);
-  std::deque<std::unique_ptr<folly::IOBuf>> consumePendingOutputFrames();
+  /// Takes all the pending output frames.  Null if there are none.
+  std::unique_ptr<PendingOutputFrames> consumePendingOutputFrames();
+
+  /// The byte size of all pending output frames.
+  size_t pendingOutputBytes() const {
+    return pendingSize_;
+  }
+
+  /// Null if no frame is pending.
+  const PendingOutputFrames* pendingOutputFrames() const {
+    return pendingOutputFrames_.get();
+  }
+
+  void setPendingOutputOptions(const PendingOutputOptions& options) {
+    pendingOutputOptions_ = options;
+  }
+
+  /// Whether pending frames went past the high watermark, and haven't dropped
+  /// to the low watermark since.
+  bool pendingOutputPaused() const {
+    return pendingOutputPaused_;
+  }
+
+  /// Pauses or resumes output once the pending frames cross a watermark.
+  /// Called after an attempt to send the pending frames.
+  void updatePendingOutputPaused();
+
+  /// Called when pendingOutputPaused() changes.
+  virtual void onPendingOutputPaused(bool /*paused*/) {}
+
+  /// Like outputFrameOrEnqueue(), but passes the frame of a stream through
+  /// the output scheduler, if there is one.
+  void outputStreamFrame(StreamId, std::unique_ptr<folly::IOBuf>);
+
+  /// Interleave the frames of different streams by weight, rather than
+  /// writing them in the order they were submitted.  Must be called before
+  /// any frame is written.
+  void enableOutputScheduler(const OutputScheduler::Options&);
+
+  /// Null unless enableOutputScheduler() was called.
+  OutputScheduler* outputScheduler() const {
+    return outputScheduler_.get();
+  }
+
+  /// Arranges for drainScheduledFrames() to be called later, typically at the
+  /// end of the current EventBase loop iteration.  By default writes all the
+  /// scheduled frames right away.
+  virtual void scheduleOutput();
+
+  /// Writes up to OutputScheduler::Options::maxBytesPerLoop bytes of the
+  /// scheduled frames, and schedules the rest for later.
+  void drainScheduledFrames();
+
+  /// Writes all the scheduled frames, e.g. before the connection is closed.
+  void flushScheduledFrames();
 
  private:
-  /// A queue of frames that are slated to be sent out.
-  std::deque<std::unique_ptr<folly::IOBuf>> pendingOutputFrames_;
+  void writeScheduledFrames(size_t maxBytes);
+
+  /// Moves the scheduled frames to the queue of pending frames.
+  void requeueScheduledFrames();
+
+  /// Reports the frames the output scheduler dropped as they were past their
+  /// deadline.
+  void reportExpiredFramesDropped();
+
+  /// A queue of frames that are slated to be sent out.  Most connections
+  /// never queue any, so it is only allocated with the first one.
+  std::unique_ptr<PendingOutputFrames> pendingOutputFrames_;
 
   /// The byte size of all pending output frames.
   size_t pendingSize_{0};
+
+  PendingOutputOptions pendingOutputOptions_;
+  bool pendingOutputPaused_{false};
+
+  std::unique_ptr<OutputScheduler> outputScheduler_;
+
+  /// Whether scheduleOutput() was called and drainScheduledFrames() is yet to
+  /// be.
+  bool drainScheduled_{false};
 };
 
 } // namespace rsocket
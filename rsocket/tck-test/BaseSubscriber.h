@@ -41,7 +41,14 @@ class BaseSubscriber {
   void assertNotCompleted();
   void assertCanceled();
 
+  // Whether to log the signals the subscriber receives.  Must be set before
+  // the subscriber is subscribed.
+  void setVerbose(bool verbose) {
+    verbose_ = verbose;
+  }
+
  protected:
+  bool verbose_{true};
   std::atomic<bool> canceled_{false};
 
   ////////////////////////////////////////////////////////////////////////////
@@ -27,7 +27,7 @@ FlowableSubscriber::FlowableSubscriber(int initialRequestN)
     : initialRequestN_(initialRequestN) {}
 
 void FlowableSubscriber::request(int n) {
-  LOG(INFO) << "... requesting " << n;
+  LOG_IF(INFO, verbose_) << "... requesting " << n;
   while (!subscription_) {
     ;
   }
@@ -35,7 +35,7 @@ void FlowableSubscriber::request(int n) {
 }
 
 void FlowableSubscriber::cancel() {
-  LOG(INFO) << "... canceling ";
+  LOG_IF(INFO, verbose_) << "... canceling ";
   canceled_ = true;
   if (auto subscription = std::move(subscription_)) {
     subscription->cancel();
@@ -52,7 +52,7 @@ void FlowableSubscriber::onSubscribe(
 }
 
 void FlowableSubscriber::onNext(Payload element) noexcept {
-  LOG(INFO) << "... received onNext from Publisher: " << element;
+  LOG_IF(INFO, verbose_) << "... received onNext from Publisher: " << element;
   {
     const std::unique_lock<std::mutex> lock(mutex_);
     const std::string data =
@@ -67,7 +67,7 @@ void FlowableSubscriber::onNext(Payload element) noexcept {
 }
 
 void FlowableSubscriber::onComplete() noexcept {
-  LOG(INFO) << "... received onComplete from Publisher";
+  LOG_IF(INFO, verbose_) << "... received onComplete from Publisher";
   {
     const std::unique_lock<std::mutex> lock(mutex_);
     completed_ = true;
@@ -77,7 +77,7 @@ void FlowableSubscriber::onComplete() noexcept {
 }
 
 void FlowableSubscriber::onError(folly::exception_wrapper ex) noexcept {
-  LOG(INFO) << "... received onError from Publisher";
+  LOG_IF(INFO, verbose_) << "... received onError from Publisher";
   {
     const std::unique_lock<std::mutex> lock(mutex_);
     errors_.push_back(std::move(ex));
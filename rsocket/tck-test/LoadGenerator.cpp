@@ -0,0 +1,187 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/tck-test/LoadGenerator.h"
+
+#include <atomic>
+#include <functional>
+#include <thread>
+
+#include <folly/Format.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+
+#include "rsocket/RSocket.h"
+#include "rsocket/internal/ThreadLocalHistogram.h"
+#include "rsocket/tck-test/TestInterpreter.h"
+#include "rsocket/transports/tcp/TcpConnectionFactory.h"
+
+using namespace folly;
+
+namespace rsocket {
+namespace tck {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+bool sharesConnections(const Test& test) {
+  if (test.resumption()) {
+    return false;
+  }
+  for (const auto& command : test.commands()) {
+    if (command.name() == "disconnect" || command.name() == "resume") {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+struct LoadGenerator::TestStats {
+  // Microseconds from when a run was due to start until it finished.
+  ThreadLocalHistogram latency;
+  std::atomic<uint64_t> failures{0};
+};
+
+LoadGenerator::LoadGenerator(
+    std::vector<const Test*> tests,
+    SocketAddress address,
+    Options options)
+    : address_(std::move(address)), options_(options) {
+  CHECK_GT(options_.threads, 0);
+  CHECK_GT(options_.connectionsPerThread, 0);
+
+  for (auto test : tests) {
+    if (!sharesConnections(*test)) {
+      LOG(WARNING) << "Leaving out test " << test->name()
+                   << ", it disconnects or resumes its clients";
+      continue;
+    }
+    tests_.push_back(test);
+    stats_.push_back(std::make_unique<TestStats>());
+  }
+}
+
+LoadGenerator::~LoadGenerator() = default;
+
+bool LoadGenerator::run() {
+  if (tests_.empty()) {
+    LOG(ERROR) << "No tests to generate load with";
+    return false;
+  }
+
+  LOG(INFO) << "Running " << tests_.size() << " tests on "
+            << options_.threads << " threads with "
+            << options_.connectionsPerThread << " connections each for "
+            << options_.duration.count() << "ms";
+
+  auto const start = Clock::now();
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < options_.threads; ++i) {
+    threads.emplace_back([this, i, start] { runThread(i, start); });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  auto const elapsed =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  bool passed = !connectFailed_;
+  for (size_t i = 0; i < tests_.size(); ++i) {
+    auto const snapshot = stats_[i]->latency.snapshot();
+    auto const failures = stats_[i]->failures.load();
+    passed = passed && failures == 0;
+    LOG(INFO) << sformat(
+        "{}: {} runs, {} failed, {:.1f} runs/s, latency p50 {}us, "
+        "p90 {}us, p99 {}us, max {}us",
+        tests_[i]->name(),
+        snapshot.count,
+        failures,
+        snapshot.count / elapsed,
+        snapshot.percentile(0.5),
+        snapshot.percentile(0.9),
+        snapshot.percentile(0.99),
+        snapshot.max);
+  }
+  return passed;
+}
+
+void LoadGenerator::runThread(size_t thread, Clock::time_point start) {
+  ScopedEventBaseThread worker;
+  std::vector<std::shared_ptr<RSocketClient>> connections;
+  try {
+    for (size_t i = 0; i < options_.connectionsPerThread; ++i) {
+      connections.push_back(RSocket::createConnectedClient(
+                                std::make_unique<TcpConnectionFactory>(
+                                    *worker.getEventBase(), address_))
+                                .get());
+    }
+  } catch (const std::exception& ex) {
+    LOG(ERROR) << "Load thread " << thread
+               << " failed to connect: " << ex.what();
+    connectFailed_ = true;
+    return;
+  }
+
+  // Every thread starts its runs at the same interval, offset from the other
+  // threads so that together they start runs evenly at the target rate.
+  Clock::duration interval{0};
+  if (options_.rate > 0) {
+    interval = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(options_.threads / options_.rate));
+  }
+  auto const threads = static_cast<Clock::rep>(options_.threads);
+  Clock::time_point due =
+      start + interval * static_cast<Clock::rep>(thread) / threads;
+  auto const end = start + options_.duration;
+
+  for (size_t run = 0;; ++run) {
+    if (options_.rate > 0) {
+      if (due >= end) {
+        break;
+      }
+      std::this_thread::sleep_until(due);
+    } else {
+      due = Clock::now();
+      if (due >= end) {
+        break;
+      }
+    }
+
+    auto const index = (thread + run) % tests_.size();
+    TestInterpreter::Options interpreterOptions;
+    interpreterOptions.verbose = false;
+    interpreterOptions.clients = [&](const std::string& clientId) {
+      auto const hash = std::hash<std::string>()(clientId);
+      return connections[(hash + run) % connections.size()];
+    };
+    TestInterpreter interpreter(
+        *tests_[index], address_, std::move(interpreterOptions));
+    bool const passed = interpreter.run();
+
+    auto& stats = *stats_[index];
+    stats.latency.record(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            Clock::now() - due)
+            .count());
+    if (!passed) {
+      ++stats.failures;
+    }
+    due += interval;
+  }
+}
+
+} // namespace tck
+} // namespace rsocket
@@ -0,0 +1,76 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include <folly/SocketAddress.h>
+
+#include "rsocket/tck-test/TestSuite.h"
+
+namespace rsocket {
+namespace tck {
+
+// Runs the tests of a suite as a load scenario: every load thread runs the
+// tests one after the other, round-robin, over connections it keeps open for
+// the whole run, until the duration is up.  Then logs the throughput and the
+// latency of every test.
+//
+// Runs are scheduled open loop at the target rate, and a run's latency is
+// measured from when it was due to start rather than from when it did, so a
+// server that falls behind shows up in the latencies instead of only slowing
+// the load down.
+//
+// Tests that disconnect or resume their clients can't share connections with
+// each other, so they are left out.
+class LoadGenerator {
+ public:
+  struct Options {
+    size_t threads{1};
+    size_t connectionsPerThread{1};
+
+    // Tests started per second, across all threads.  Zero starts every test
+    // as soon as the one before it on the same thread is done.
+    double rate{0};
+
+    std::chrono::milliseconds duration{std::chrono::seconds(10)};
+  };
+
+  LoadGenerator(
+      std::vector<const Test*> tests,
+      folly::SocketAddress address,
+      Options options);
+  ~LoadGenerator();
+
+  // Returns whether every run of every test passed.
+  bool run();
+
+ private:
+  struct TestStats;
+
+  void runThread(size_t thread, std::chrono::steady_clock::time_point start);
+
+  std::vector<const Test*> tests_;
+  std::vector<std::unique_ptr<TestStats>> stats_;
+  folly::SocketAddress address_;
+  Options options_;
+  std::atomic<bool> connectFailed_{false};
+};
+
+} // namespace tck
+} // namespace rsocket
@@ -24,11 +24,12 @@ namespace rsocket {
 namespace tck {
 
 void SingleSubscriber::request(int n) {
-  LOG(INFO) << "... requesting " << n << ". No request() for Single.";
+  LOG_IF(INFO, verbose_) << "... requesting " << n
+                         << ". No request() for Single.";
 }
 
 void SingleSubscriber::cancel() {
-  LOG(INFO) << "... canceling ";
+  LOG_IF(INFO, verbose_) << "... canceling ";
   canceled_ = true;
   if (auto subscription = std::move(subscription_)) {
     subscription->cancel();
@@ -42,7 +43,8 @@ void SingleSubscriber::onSubscribe(
 }
 
 void SingleSubscriber::onSuccess(Payload element) noexcept {
-  LOG(INFO) << "... received onSuccess from Publisher: " << element;
+  LOG_IF(INFO, verbose_) << "... received onSuccess from Publisher: "
+                         << element;
   {
     const std::unique_lock<std::mutex> lock(mutex_);
     const std::string data =
@@ -62,7 +64,7 @@ void SingleSubscriber::onSuccess(Payload element) noexcept {
 }
 
 void SingleSubscriber::onError(folly::exception_wrapper ex) noexcept {
-  LOG(INFO) << "... received onError from Publisher";
+  LOG_IF(INFO, verbose_) << "... received onError from Publisher";
   {
     const std::unique_lock<std::mutex> lock(mutex_);
     errors_.push_back(std::move(ex));
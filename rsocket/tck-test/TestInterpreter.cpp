@@ -31,13 +31,21 @@ namespace rsocket {
 namespace tck {
 
 TestInterpreter::TestInterpreter(const Test& test, SocketAddress address)
-    : address_(address), test_(test) {
+    : TestInterpreter(test, std::move(address), Options()) {}
+
+TestInterpreter::TestInterpreter(
+    const Test& test,
+    SocketAddress address,
+    Options options)
+    : address_(address), test_(test), options_(std::move(options)) {
   DCHECK(!test.empty());
 }
 
 bool TestInterpreter::run() {
-  LOG(INFO) << "Executing test: " << test_.name() << " ("
-            << test_.commands().size() - 1 << " commands)";
+  if (options_.verbose) {
+    LOG(INFO) << "Executing test: " << test_.name() << " ("
+              << test_.commands().size() - 1 << " commands)";
+  }
 
   int i = 0;
   try {
@@ -79,13 +87,15 @@ bool TestInterpreter::run() {
         ex.what());
     return false;
   }
-  LOG(INFO) << "Test " << test_.name() << " succeeded";
+  if (options_.verbose) {
+    LOG(INFO) << "Test " << test_.name() << " succeeded";
+  }
   return true;
 }
 
 void TestInterpreter::handleDisconnect(const DisconnectCommand& command) {
   if (testClient_.find(command.clientId()) != testClient_.end()) {
-    LOG(INFO) << "Disconnecting the client";
+    LOG_IF(INFO, options_.verbose) << "Disconnecting the client";
     testClient_[command.clientId()]->client->disconnect(
         std::runtime_error("disconnect triggered from client"));
   }
@@ -93,7 +103,7 @@ void TestInterpreter::handleDisconnect(const DisconnectCommand& command) {
 
 void TestInterpreter::handleResume(const ResumeCommand& command) {
   if (testClient_.find(command.clientId()) != testClient_.end()) {
-    LOG(INFO) << "Resuming the client";
+    LOG_IF(INFO, options_.verbose) << "Resuming the client";
     testClient_[command.clientId()]->client->resume().get();
   }
 }
@@ -101,17 +111,8 @@ void TestInterpreter::handleResume(const ResumeCommand& command) {
 void TestInterpreter::handleSubscribe(const SubscribeCommand& command) {
   // If client does not exist, create a new client.
   if (testClient_.find(command.clientId()) == testClient_.end()) {
-    SetupParameters setupParameters;
-    if (test_.resumption()) {
-      setupParameters.resumable = true;
-    }
-    auto client = RSocket::createConnectedClient(
-                      std::make_unique<TcpConnectionFactory>(
-                          *worker_.getEventBase(), std::move(address_)),
-                      std::move(setupParameters))
-                      .get();
     testClient_[command.clientId()] =
-        std::make_shared<TestClient>(move(client));
+        std::make_shared<TestClient>(connect(command.clientId()));
   }
 
   CHECK(
@@ -120,6 +121,7 @@ void TestInterpreter::handleSubscribe(const SubscribeCommand& command) {
 
   if (command.isRequestResponseType()) {
     auto testSubscriber = std::make_shared<SingleSubscriber>();
+    testSubscriber->setVerbose(options_.verbose);
     testSubscribers_[command.clientId() + command.id()] = testSubscriber;
     testClient_[command.clientId()]
         ->requester
@@ -128,6 +130,7 @@ void TestInterpreter::handleSubscribe(const SubscribeCommand& command) {
         ->subscribe(std::move(testSubscriber));
   } else if (command.isRequestStreamType()) {
     auto testSubscriber = std::make_shared<FlowableSubscriber>();
+    testSubscriber->setVerbose(options_.verbose);
     testSubscribers_[command.clientId() + command.id()] = testSubscriber;
     testClient_[command.clientId()]
         ->requester
@@ -139,6 +142,26 @@ void TestInterpreter::handleSubscribe(const SubscribeCommand& command) {
   }
 }
 
+std::shared_ptr<RSocketClient> TestInterpreter::connect(
+    const std::string& clientId) {
+  if (options_.clients) {
+    return options_.clients(clientId);
+  }
+
+  if (!worker_) {
+    worker_ = std::make_unique<folly::ScopedEventBaseThread>();
+  }
+  SetupParameters setupParameters;
+  if (test_.resumption()) {
+    setupParameters.resumable = true;
+  }
+  return RSocket::createConnectedClient(
+             std::make_unique<TcpConnectionFactory>(
+                 *worker_->getEventBase(), std::move(address_)),
+             std::move(setupParameters))
+      .get();
+}
+
 void TestInterpreter::handleRequest(const RequestCommand& command) {
   getSubscriber(command.clientId() + command.id())->request(command.n());
 }
@@ -149,14 +172,16 @@ void TestInterpreter::handleCancel(const CancelCommand& command) {
 
 void TestInterpreter::handleAwait(const AwaitCommand& command) {
   if (command.isTerminalType()) {
-    LOG(INFO) << "... await: terminal event";
+    LOG_IF(INFO, options_.verbose) << "... await: terminal event";
     getSubscriber(command.clientId() + command.id())->awaitTerminalEvent();
   } else if (command.isAtLeastType()) {
-    LOG(INFO) << "... await: terminal at least " << command.numElements();
+    LOG_IF(INFO, options_.verbose)
+        << "... await: terminal at least " << command.numElements();
     getSubscriber(command.clientId() + command.id())
         ->awaitAtLeast(command.numElements());
   } else if (command.isNoEventsType()) {
-    LOG(INFO) << "... await: no events for " << command.waitTime() << "ms";
+    LOG_IF(INFO, options_.verbose)
+        << "... await: no events for " << command.waitTime() << "ms";
     getSubscriber(command.clientId() + command.id())
         ->awaitNoEvents(command.waitTime());
   } else {
@@ -166,31 +191,33 @@ void TestInterpreter::handleAwait(const AwaitCommand& command) {
 
 void TestInterpreter::handleAssert(const AssertCommand& command) {
   if (command.isNoErrorAssert()) {
-    LOG(INFO) << "... assert: no error";
+    LOG_IF(INFO, options_.verbose) << "... assert: no error";
     getSubscriber(command.clientId() + command.id())->assertNoErrors();
   } else if (command.isErrorAssert()) {
-    LOG(INFO) << "... assert: error";
+    LOG_IF(INFO, options_.verbose) << "... assert: error";
     getSubscriber(command.clientId() + command.id())->assertError();
   } else if (command.isReceivedAssert()) {
-    LOG(INFO) << "... assert: values";
+    LOG_IF(INFO, options_.verbose) << "... assert: values";
     getSubscriber(command.clientId() + command.id())
         ->assertValues(command.values());
   } else if (command.isReceivedNAssert()) {
-    LOG(INFO) << "... assert: value count " << command.valueCount();
+    LOG_IF(INFO, options_.verbose)
+        << "... assert: value count " << command.valueCount();
     getSubscriber(command.clientId() + command.id())
         ->assertValueCount(command.valueCount());
   } else if (command.isReceivedAtLeastAssert()) {
-    LOG(INFO) << "... assert: received at least " << command.valueCount();
+    LOG_IF(INFO, options_.verbose)
+        << "... assert: received at least " << command.valueCount();
     getSubscriber(command.clientId() + command.id())
         ->assertReceivedAtLeast(command.valueCount());
   } else if (command.isCompletedAssert()) {
-    LOG(INFO) << "... assert: completed";
+    LOG_IF(INFO, options_.verbose) << "... assert: completed";
     getSubscriber(command.clientId() + command.id())->assertCompleted();
   } else if (command.isNotCompletedAssert()) {
-    LOG(INFO) << "... assert: not completed";
+    LOG_IF(INFO, options_.verbose) << "... assert: not completed";
     getSubscriber(command.clientId() + command.id())->assertNotCompleted();
   } else if (command.isCanceledAssert()) {
-    LOG(INFO) << "... assert: canceled";
+    LOG_IF(INFO, options_.verbose) << "... assert: canceled";
     getSubscriber(command.clientId() + command.id())->assertCanceled();
   } else {
     throw std::runtime_error("unsupported assert type");
@@ -14,7 +14,9 @@
 
 #pragma once
 
+#include <functional>
 #include <map>
+#include <memory>
 
 #include <folly/SocketAddress.h>
 #include <folly/io/async/ScopedEventBaseThread.h>
@@ -56,7 +58,21 @@ class TestInterpreter {
   };
 
  public:
+  struct Options {
+    // Returns the connection to run the commands of a client on, instead of
+    // connecting a client of its own for every client of the test.
+    std::function<std::shared_ptr<RSocketClient>(const std::string& clientId)>
+        clients;
+
+    // Logs every command that runs, and the outcome of the test.
+    bool verbose{true};
+  };
+
   TestInterpreter(const Test& test, folly::SocketAddress address);
+  TestInterpreter(
+      const Test& test,
+      folly::SocketAddress address,
+      Options options);
 
   bool run();
 
@@ -70,10 +86,13 @@ class TestInterpreter {
   void handleResume(const ResumeCommand& command);
 
   std::shared_ptr<BaseSubscriber> getSubscriber(const std::string& id);
+  std::shared_ptr<RSocketClient> connect(const std::string& clientId);
 
-  folly::ScopedEventBaseThread worker_;
+  // Only started once the test connects a client of its own.
+  std::unique_ptr<folly::ScopedEventBaseThread> worker_;
   folly::SocketAddress address_;
   const Test& test_;
+  Options options_;
   std::map<std::string, std::string> interactionIdToType_;
   std::map<std::string, std::shared_ptr<BaseSubscriber>> testSubscribers_;
   std::map<std::string, std::shared_ptr<TestClient>> testClient_;
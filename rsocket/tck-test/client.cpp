@@ -20,6 +20,7 @@
 
 #include "rsocket/RSocket.h"
 
+#include "rsocket/tck-test/LoadGenerator.h"
 #include "rsocket/tck-test/TestFileParser.h"
 #include "rsocket/tck-test/TestInterpreter.h"
 
@@ -33,6 +34,18 @@ DEFINE_string(
     "all",
     "Comma separated names of tests to run. By default run all tests");
 DEFINE_int32(timeout, 5, "timeout (in secs) for connecting to the server");
+DEFINE_int32(
+    load_duration,
+    0,
+    "run the tests as a load scenario for this many seconds, rather than "
+    "running each of them once");
+DEFINE_int32(load_threads, 1, "threads to run the load scenario on");
+DEFINE_int32(load_connections, 1, "connections per load thread");
+DEFINE_double(
+    load_rate,
+    0,
+    "tests started per second across all load threads, 0 to start each "
+    "test as soon as the one before it is done");
 
 using namespace rsocket;
 using namespace rsocket::tck;
@@ -60,10 +73,33 @@ int main(int argc, char* argv[]) {
   int ran = 0, passed = 0;
   std::vector<std::string> testsToRun;
   folly::split(",", FLAGS_tests, testsToRun);
-  for (const auto& test : testSuite.tests()) {
-    if (FLAGS_tests == "all" ||
+  auto const selected = [&](const Test& test) {
+    return FLAGS_tests == "all" ||
         std::find(testsToRun.begin(), testsToRun.end(), test.name()) !=
-            testsToRun.end()) {
+        testsToRun.end();
+  };
+
+  if (FLAGS_load_duration > 0) {
+    std::vector<const Test*> tests;
+    for (const auto& test : testSuite.tests()) {
+      if (selected(test)) {
+        tests.push_back(&test);
+      }
+    }
+    LoadGenerator::Options options;
+    options.threads = FLAGS_load_threads;
+    options.connectionsPerThread = FLAGS_load_connections;
+    options.rate = FLAGS_load_rate;
+    options.duration = std::chrono::seconds(FLAGS_load_duration);
+    LoadGenerator generator(std::move(tests), address, options);
+    bool const passing = generator.run();
+    LOG(INFO) << "Load scenario DONE. "
+              << (passing ? "All runs passed." : "Some runs failed.");
+    return !passing;
+  }
+
+  for (const auto& test : testSuite.tests()) {
+    if (selected(test)) {
       TestInterpreter interpreter(test, std::move(address));
       bool passing = interpreter.run();
       ++ran;
@@ -0,0 +1,82 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <gtest/gtest.h>
+
+#include "RSocketTests.h"
+#include "yarpl/Single.h"
+
+using namespace rsocket;
+using namespace rsocket::tests;
+using namespace rsocket::tests::client_server;
+
+namespace {
+
+/// Answers every request with its name, so that the test can tell which
+/// server a request went to.
+class NamedResponder : public RSocketResponder {
+ public:
+  explicit NamedResponder(std::string name) : name_(std::move(name)) {}
+
+  std::shared_ptr<yarpl::single::Single<Payload>> handleRequestResponse(
+      Payload,
+      StreamId) override {
+    return yarpl::single::Single<Payload>::just(Payload(name_));
+  }
+
+ private:
+  const std::string name_;
+};
+
+std::string ask(RSocketRequester& requester) {
+  return requester.requestResponseFuture(Payload("request"))
+      .get(std::chrono::seconds{5})
+      .moveDataToString();
+}
+
+} // namespace
+
+TEST(BulkConnectionTest, BulkTrafficGoesToBulkConnection) {
+  folly::ScopedEventBaseThread worker;
+  auto primary = makeServer(std::make_shared<NamedResponder>("primary"));
+  auto bulk = makeServer(std::make_shared<NamedResponder>("bulk"));
+  auto client = makeClient(worker.getEventBase(), *primary->listeningPort());
+  auto const& requester = client->getRequester();
+
+  // Without a bulk connection, bulk traffic stays on the primary one.
+  EXPECT_EQ("primary", ask(*requester->withBulkTraffic()));
+
+  // Derived before the bulk connection is made, and still routed to it.
+  auto weighted = requester->withOutputWeight(2);
+
+  TcpDuplexConnection::Options options;
+  options.dscp = 8;
+  options.sendBufferSize = 1 << 20;
+  client
+      ->connectBulk(std::make_shared<TcpConnectionFactory>(
+          *worker.getEventBase(),
+          folly::SocketAddress("127.0.0.1", *bulk->listeningPort()),
+          nullptr,
+          options))
+      .get(std::chrono::seconds{5});
+
+  EXPECT_EQ("primary", ask(*requester));
+  EXPECT_EQ("bulk", ask(*requester->withBulkTraffic()));
+  EXPECT_EQ("bulk", ask(*weighted->withBulkTraffic()));
+  EXPECT_EQ("primary", ask(*weighted));
+
+  // Bulk traffic of the bulk connection stays where it is.
+  EXPECT_EQ("bulk", ask(*requester->withBulkTraffic()->withBulkTraffic()));
+}
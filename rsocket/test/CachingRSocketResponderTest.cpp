@@ -0,0 +1,153 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+
+#include "rsocket/CachingRSocketResponder.h"
+#include "yarpl/single/SingleTestObserver.h"
+#include "yarpl/single/Singles.h"
+
+using namespace rsocket;
+using namespace yarpl::single;
+using namespace std::chrono_literals;
+
+namespace {
+
+/// Responds with the request data followed by a call counter.
+class CountingResponder : public RSocketResponder {
+ public:
+  std::shared_ptr<Single<Payload>> handleRequestResponse(
+      Payload request,
+      StreamId) override {
+    auto const call = ++calls;
+    if (fail) {
+      return Singles::error<Payload>(std::runtime_error("failed"));
+    }
+    auto response = request.moveDataToString() + std::to_string(call) +
+        std::string(responsePadding, ' ');
+    return Singles::fromGenerator<Payload>(
+        [response] { return Payload(response); });
+  }
+
+  size_t calls{0};
+  size_t responsePadding{0};
+  bool fail{false};
+};
+
+class CachingRSocketResponderTest : public testing::Test {
+ protected:
+  Payload request(CachingRSocketResponder& responder, Payload payload) {
+    auto observer = SingleTestObserver<Payload>::create();
+    responder.handleRequestResponse(std::move(payload), 1)
+        ->subscribe(observer);
+    observer->assertSuccess();
+    return std::move(observer->getOnSuccessValue());
+  }
+
+  std::string requestData(CachingRSocketResponder& responder, Payload payload) {
+    return request(responder, std::move(payload)).moveDataToString();
+  }
+
+  std::shared_ptr<CountingResponder> inner{
+      std::make_shared<CountingResponder>()};
+};
+
+} // namespace
+
+TEST_F(CachingRSocketResponderTest, CachesResponses) {
+  CachingRSocketResponder responder{inner, {}};
+
+  auto first = request(responder, Payload("a", "route"));
+  auto second = request(responder, Payload("a", "route"));
+  EXPECT_EQ(1, inner->calls);
+  EXPECT_EQ("a1", second.cloneDataToString());
+
+  // The cached response is shared rather than copied.
+  EXPECT_EQ(first.data->data(), second.data->data());
+  EXPECT_GT(responder.size(), 0);
+
+  auto looked = responder.lookup(Payload("a", "route"));
+  ASSERT_TRUE(looked);
+  EXPECT_EQ("a1", looked->cloneDataToString());
+}
+
+TEST_F(CachingRSocketResponderTest, KeysOnMetadataAndData) {
+  CachingRSocketResponder responder{inner, {}};
+
+  EXPECT_EQ("a1", requestData(responder, Payload("a", "route")));
+  EXPECT_EQ("a2", requestData(responder, Payload("a", "other")));
+  EXPECT_EQ("b3", requestData(responder, Payload("b", "route")));
+  EXPECT_EQ("a4", requestData(responder, Payload("a")));
+  EXPECT_EQ("a1", requestData(responder, Payload("a", "route")));
+  EXPECT_EQ(4, inner->calls);
+}
+
+TEST_F(CachingRSocketResponderTest, ResponsesExpire) {
+  CachingRSocketResponder::Options options;
+  options.ttl = 1ms;
+  CachingRSocketResponder responder{inner, options};
+
+  EXPECT_EQ("a1", requestData(responder, Payload("a")));
+  std::this_thread::sleep_for(5ms);
+  EXPECT_FALSE(responder.lookup(Payload("a")));
+  EXPECT_EQ("a2", requestData(responder, Payload("a")));
+}
+
+TEST_F(CachingRSocketResponderTest, EvictsLeastRecentlyUsed) {
+  inner->responsePadding = 1000;
+  CachingRSocketResponder::Options options;
+  options.shards = 1;
+  options.maxBytes = 2600;
+  CachingRSocketResponder responder{inner, options};
+
+  request(responder, Payload("a"));
+  request(responder, Payload("b"));
+  request(responder, Payload("a"));
+  request(responder, Payload("c"));
+  EXPECT_EQ(3, inner->calls);
+
+  EXPECT_TRUE(responder.lookup(Payload("a")));
+  EXPECT_TRUE(responder.lookup(Payload("c")));
+  EXPECT_FALSE(responder.lookup(Payload("b")));
+  EXPECT_LE(responder.size(), options.maxBytes);
+}
+
+TEST_F(CachingRSocketResponderTest, DoesNotCacheErrors) {
+  CachingRSocketResponder responder{inner, {}};
+  inner->fail = true;
+
+  for (int i = 0; i < 2; ++i) {
+    auto observer = SingleTestObserver<Payload>::create();
+    responder.handleRequestResponse(Payload("a"), 1)->subscribe(observer);
+    observer->assertOnErrorMessage("failed");
+  }
+  EXPECT_EQ(2, inner->calls);
+  EXPECT_EQ(0, responder.size());
+}
+
+TEST_F(CachingRSocketResponderTest, SkipsRequestsThatAreNotCacheable) {
+  CachingRSocketResponder::Options options;
+  options.cacheable = [](const Payload& request) {
+    return request.cloneMetadataToString() != "nocache";
+  };
+  CachingRSocketResponder responder{inner, options};
+
+  EXPECT_EQ("a1", requestData(responder, Payload("a", "nocache")));
+  EXPECT_EQ("a2", requestData(responder, Payload("a", "nocache")));
+  EXPECT_EQ("a3", requestData(responder, Payload("a")));
+  EXPECT_EQ("a3", requestData(responder, Payload("a")));
+}
@@ -0,0 +1,167 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <vector>
+
+#include "rsocket/CoalescingRSocketResponder.h"
+#include "yarpl/single/SingleSubscriptions.h"
+#include "yarpl/single/SingleTestObserver.h"
+#include "yarpl/single/Singles.h"
+
+using namespace rsocket;
+using namespace yarpl::single;
+
+namespace {
+
+/// Responder whose request-responses complete when the test says so.
+class PendingResponder : public RSocketResponder {
+ public:
+  std::shared_ptr<Single<Payload>> handleRequestResponse(Payload, StreamId)
+      override {
+    ++calls;
+    return Singles::create<Payload>(
+        [this](std::shared_ptr<SingleObserver<Payload>> observer) {
+          auto cancelled = std::make_shared<std::atomic<bool>>(false);
+          observer->onSubscribe(
+              SingleSubscriptions::create([cancelled] { *cancelled = true; }));
+          requests.push_back({std::move(observer), std::move(cancelled)});
+        });
+  }
+
+  struct Request {
+    std::shared_ptr<SingleObserver<Payload>> observer;
+    std::shared_ptr<std::atomic<bool>> cancelled;
+  };
+
+  size_t calls{0};
+  std::vector<Request> requests;
+};
+
+class CountingStats : public RSocketStats {
+ public:
+  void requestCoalesced() override {
+    ++coalesced;
+  }
+
+  size_t coalesced{0};
+};
+
+class CoalescingRSocketResponderTest : public testing::Test {
+ protected:
+  std::shared_ptr<SingleTestObserver<Payload>> request(
+      Payload payload,
+      StreamId streamId = 1) {
+    auto observer = SingleTestObserver<Payload>::create();
+    responder.handleRequestResponse(std::move(payload), streamId)
+        ->subscribe(observer);
+    return observer;
+  }
+
+  std::shared_ptr<PendingResponder> inner{
+      std::make_shared<PendingResponder>()};
+  std::shared_ptr<CountingStats> stats{std::make_shared<CountingStats>()};
+  CoalescingRSocketResponder responder{
+      inner,
+      CoalescingRSocketResponder::keyByMetadataAndData,
+      stats};
+};
+
+} // namespace
+
+TEST_F(CoalescingRSocketResponderTest, CoalescesIdenticalRequests) {
+  auto first = request(Payload("data", "route"));
+  auto second = request(Payload("data", "route"));
+  auto third = request(Payload("data", "route"));
+  EXPECT_EQ(1, inner->calls);
+  EXPECT_EQ(2, stats->coalesced);
+  EXPECT_EQ(3, responder.inFlight());
+
+  inner->requests[0].observer->onSuccess(Payload("response"));
+  EXPECT_EQ(0, responder.inFlight());
+
+  for (auto& observer : {first, second, third}) {
+    observer->assertSuccess();
+    EXPECT_EQ("response", observer->getOnSuccessValue().cloneDataToString());
+  }
+  // The responses share one buffer.
+  EXPECT_EQ(
+      first->getOnSuccessValue().data->data(),
+      third->getOnSuccessValue().data->data());
+}
+
+TEST_F(CoalescingRSocketResponderTest, DifferentRequestsAreNotCoalesced) {
+  request(Payload("data", "route"));
+  request(Payload("other", "route"));
+  request(Payload("routedata"));
+  EXPECT_EQ(3, inner->calls);
+  EXPECT_EQ(0, stats->coalesced);
+}
+
+TEST_F(CoalescingRSocketResponderTest, CompletedRequestIsNotReused) {
+  request(Payload("data"));
+  inner->requests[0].observer->onSuccess(Payload("response"));
+
+  auto later = request(Payload("data"));
+  EXPECT_EQ(2, inner->calls);
+  later->assertNoTerminalEvent();
+}
+
+TEST_F(CoalescingRSocketResponderTest, ErrorsAreFannedOut) {
+  auto first = request(Payload("data"));
+  auto second = request(Payload("data"));
+  inner->requests[0].observer->onError(std::runtime_error("failed"));
+
+  first->assertOnErrorMessage("failed");
+  second->assertOnErrorMessage("failed");
+}
+
+TEST_F(CoalescingRSocketResponderTest, CancelledWaiterLeavesOthersWaiting) {
+  auto first = request(Payload("data"));
+  auto second = request(Payload("data"));
+
+  first->cancel();
+  EXPECT_FALSE(*inner->requests[0].cancelled);
+  EXPECT_EQ(1, responder.inFlight());
+
+  inner->requests[0].observer->onSuccess(Payload("response"));
+  first->assertNoTerminalEvent();
+  second->assertSuccess();
+}
+
+TEST_F(CoalescingRSocketResponderTest, LastCancelCancelsInnerRequest) {
+  auto first = request(Payload("data"));
+  auto second = request(Payload("data"));
+
+  first->cancel();
+  second->cancel();
+  EXPECT_TRUE(*inner->requests[0].cancelled);
+  EXPECT_EQ(0, responder.inFlight());
+
+  request(Payload("data"));
+  EXPECT_EQ(2, inner->calls);
+}
+
+TEST_F(CoalescingRSocketResponderTest, RequestsWithoutKeyPassThrough) {
+  CoalescingRSocketResponder passThrough{
+      inner, [](const Payload&) { return folly::Optional<std::string>(); }};
+
+  passThrough.handleRequestResponse(Payload("data"), 1)
+      ->subscribe(SingleTestObserver<Payload>::create());
+  passThrough.handleRequestResponse(Payload("data"), 3)
+      ->subscribe(SingleTestObserver<Payload>::create());
+  EXPECT_EQ(2, inner->calls);
+}
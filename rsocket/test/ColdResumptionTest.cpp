@@ -16,6 +16,7 @@
 
 #include <folly/Conv.h>
 #include <folly/Format.h>
+#include <folly/executors/CPUThreadPoolExecutor.h>
 #include <folly/io/async/ScopedEventBaseThread.h>
 #include <folly/portability/GFlags.h>
 
@@ -111,6 +112,51 @@ class HelloResumeHandler : public ColdResumeHandler {
 };
 } // namespace
 
+namespace {
+class ChunkedResumeHandler : public ColdResumeHandler {
+ public:
+  std::shared_ptr<Subscriber<Payload>> handleRequesterResumeStream(
+      std::string streamToken,
+      size_t consumerAllowance) override {
+    EXPECT_EQ(folly::to<size_t>(streamToken), consumerAllowance);
+    ++streamsResumed_;
+    return std::make_shared<HelloSubscriber>(consumerAllowance);
+  }
+
+  folly::Executor* resumeExecutor() override {
+    return &pool_;
+  }
+
+  size_t resumeChunkSize() const override {
+    return 3;
+  }
+
+  std::atomic<size_t> streamsResumed_{0};
+
+ private:
+  folly::CPUThreadPoolExecutor pool_{4};
+};
+} // namespace
+
+TEST(ColdResumptionTest, BatchedHandlerResumesInChunks) {
+  ChunkedResumeHandler handler;
+  std::vector<ColdResumeHandler::RequesterResumeStream> streams;
+  for (size_t i = 0; i < 10; ++i) {
+    streams.push_back(
+        {static_cast<StreamId>(2 * i + 1), folly::to<std::string>(i), i});
+  }
+
+  auto subscribers = handler.handleRequesterResumeStreams(streams);
+  EXPECT_EQ(10, handler.streamsResumed_);
+  ASSERT_EQ(10, subscribers.size());
+  for (size_t i = 0; i < subscribers.size(); ++i) {
+    auto subscriber =
+        std::dynamic_pointer_cast<HelloSubscriber>(subscribers[i]);
+    ASSERT_NE(nullptr, subscriber);
+    EXPECT_EQ(i, subscriber->getLatestValue());
+  }
+}
+
 std::unique_ptr<rsocket::RSocketClient> createResumedClient(
     folly::EventBase* evb,
     uint32_t port,
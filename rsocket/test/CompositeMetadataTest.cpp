@@ -0,0 +1,167 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "rsocket/CompositeMetadata.h"
+
+using namespace rsocket;
+
+namespace {
+
+/// Splits a buffer into a chain of one byte buffers.
+std::unique_ptr<folly::IOBuf> fragment(const folly::IOBuf& buf) {
+  auto bytes = buf.cloneCoalescedAsValue();
+  std::unique_ptr<folly::IOBuf> chain = folly::IOBuf::create(0);
+  for (size_t i = 0; i < bytes.length(); ++i) {
+    chain->prependChain(folly::IOBuf::copyBuffer(bytes.data() + i, 1));
+  }
+  return chain;
+}
+
+std::string contentOf(const CompositeMetadataReader::Entry& entry) {
+  return entry.cloneContent()->moveToFbString().toStdString();
+}
+
+} // namespace
+
+TEST(CompositeMetadataTest, WellKnownMimeTypes) {
+  EXPECT_EQ("application/json", wellKnownMimeType(0x05));
+  EXPECT_EQ(
+      "message/x.rsocket.routing.v0",
+      wellKnownMimeType(WellKnownMimeType::Routing));
+  EXPECT_EQ("", wellKnownMimeType(0x60));
+  EXPECT_EQ("", wellKnownMimeType(0xFF));
+
+  EXPECT_EQ(0x21, wellKnownMimeTypeId("text/plain").value());
+  EXPECT_FALSE(wellKnownMimeTypeId("text/x-unknown"));
+}
+
+TEST(CompositeMetadataTest, RoundTrip) {
+  auto metadata = CompositeMetadataBuilder()
+                      .addRouting({"service.method", "tag"})
+                      .add("text/plain", folly::IOBuf::copyBuffer("hi"))
+                      .add("application/x-custom", folly::IOBuf::create(0))
+                      .build();
+
+  CompositeMetadataReader reader{*metadata};
+  ASSERT_TRUE(reader.next());
+  EXPECT_EQ(WellKnownMimeType::Routing, reader.entry().mimeTypeId.value());
+  RoutingMetadataReader tags{reader.entry()};
+  ASSERT_TRUE(tags.next());
+  EXPECT_EQ("service.method", tags.tag());
+  ASSERT_TRUE(tags.next());
+  EXPECT_EQ("tag", tags.tag());
+  EXPECT_FALSE(tags.next());
+  EXPECT_FALSE(tags.malformed());
+
+  // Well-known types are encoded by their id.
+  ASSERT_TRUE(reader.next());
+  EXPECT_EQ(WellKnownMimeType::TextPlain, reader.entry().mimeTypeId.value());
+  EXPECT_EQ("text/plain", reader.entry().mimeType);
+  EXPECT_EQ("hi", contentOf(reader.entry()));
+
+  ASSERT_TRUE(reader.next());
+  EXPECT_FALSE(reader.entry().mimeTypeId);
+  EXPECT_EQ("application/x-custom", reader.entry().mimeType);
+  EXPECT_EQ(0, reader.entry().contentLength);
+
+  EXPECT_FALSE(reader.next());
+  EXPECT_FALSE(reader.malformed());
+}
+
+TEST(CompositeMetadataTest, ContentIsNotCopied) {
+  auto content = folly::IOBuf::copyBuffer(std::string(100, 'x'));
+  auto const data = content->data();
+  auto metadata = CompositeMetadataBuilder()
+                      .add(WellKnownMimeType::TracingZipkin, std::move(content))
+                      .build();
+
+  CompositeMetadataReader reader{*metadata};
+  auto entry = reader.find(WellKnownMimeType::TracingZipkin);
+  ASSERT_NE(nullptr, entry);
+  auto bytes = entry->contiguousContent();
+  ASSERT_TRUE(bytes);
+  EXPECT_EQ(data, bytes->data());
+  EXPECT_EQ(100, bytes->size());
+}
+
+TEST(CompositeMetadataTest, ReadsAcrossBuffers) {
+  auto metadata =
+      CompositeMetadataBuilder()
+          .add("application/x-custom", folly::IOBuf::copyBuffer("abc"))
+          .addRouting({"route"})
+          .build();
+  auto chain = fragment(*metadata);
+
+  CompositeMetadataReader reader{*chain};
+  ASSERT_TRUE(reader.next());
+  EXPECT_EQ("application/x-custom", reader.entry().mimeType);
+  EXPECT_FALSE(reader.entry().contiguousContent());
+  EXPECT_EQ("abc", contentOf(reader.entry()));
+
+  ASSERT_TRUE(reader.next());
+  RoutingMetadataReader tags{reader.entry()};
+  ASSERT_TRUE(tags.next());
+  EXPECT_EQ("route", tags.tag());
+  EXPECT_FALSE(reader.next());
+}
+
+TEST(CompositeMetadataTest, FindsWellKnownTypeByName) {
+  auto metadata = CompositeMetadataBuilder()
+                      .add("application/x-custom", folly::IOBuf::create(0))
+                      .build();
+  // A well-known type spelled out by name, as peers are allowed to.
+  std::string const name = "message/x.rsocket.routing.v0";
+  metadata->prependChain(folly::IOBuf::copyBuffer(
+      std::string(1, static_cast<char>(name.size() - 1)) + name +
+      std::string("\0\0\2\1r", 5)));
+
+  CompositeMetadataReader reader{*metadata};
+  auto entry = reader.find(WellKnownMimeType::Routing);
+  ASSERT_NE(nullptr, entry);
+  EXPECT_FALSE(entry->mimeTypeId);
+  EXPECT_EQ("\1r", contentOf(*entry));
+}
+
+TEST(CompositeMetadataTest, Malformed) {
+  auto metadata = CompositeMetadataBuilder()
+                      .add("text/plain", folly::IOBuf::copyBuffer("hello"))
+                      .build();
+  metadata->coalesce();
+  metadata->trimEnd(1);
+
+  CompositeMetadataReader reader{*metadata};
+  EXPECT_FALSE(reader.next());
+  EXPECT_TRUE(reader.malformed());
+
+  auto routing = folly::IOBuf::copyBuffer(std::string("\5ab", 3));
+  RoutingMetadataReader tags{*routing};
+  EXPECT_FALSE(tags.next());
+  EXPECT_TRUE(tags.malformed());
+}
+
+TEST(CompositeMetadataTest, BuilderRejectsInvalidEntries) {
+  CompositeMetadataBuilder builder;
+  EXPECT_THROW(builder.add("", nullptr), std::invalid_argument);
+  EXPECT_THROW(
+      builder.add(std::string(129, 'a'), nullptr), std::invalid_argument);
+  EXPECT_THROW(builder.addRouting({""}), std::invalid_argument);
+  EXPECT_THROW(
+      builder.addRouting({std::string(256, 'a')}), std::invalid_argument);
+  EXPECT_EQ(0, builder.build()->computeChainDataLength());
+}
@@ -0,0 +1,160 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <folly/Portability.h>
+
+#if FOLLY_HAS_COROUTINES
+
+#include <folly/Conv.h>
+#include <folly/ScopeGuard.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <folly/synchronization/Baton.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <thread>
+
+#include "RSocketTests.h"
+#include "rsocket/RSocketCoroResponder.h"
+#include "yarpl/Flowable.h"
+#include "yarpl/flowable/TestSubscriber.h"
+#include "yarpl/single/SingleTestObserver.h"
+
+using namespace yarpl;
+using namespace yarpl::flowable;
+using namespace rsocket;
+using namespace rsocket::tests;
+using namespace rsocket::tests::client_server;
+
+namespace {
+
+class HelloCoroHandler : public RSocketCoroResponder {
+ public:
+  folly::coro::Task<Payload> handleRequestResponseCo(
+      Payload request,
+      StreamId) override {
+    co_return Payload("Hello, " + request.moveDataToString() + "!");
+  }
+
+  folly::coro::AsyncGenerator<Payload&&> handleRequestStreamCo(
+      Payload request,
+      StreamId) override {
+    SCOPE_EXIT {
+      streamDone.post();
+    };
+    auto const name = request.moveDataToString();
+    auto const count = name == "forever" ? std::numeric_limits<int>::max() : 10;
+    for (int i = 1; i <= count; ++i) {
+      ++pulled;
+      co_yield Payload(name + " " + folly::to<std::string>(i));
+    }
+  }
+
+  folly::coro::AsyncGenerator<Payload&&> handleRequestChannelCo(
+      Payload request,
+      folly::coro::AsyncGenerator<Payload&&> requests,
+      StreamId) override {
+    auto const prefix = "[" + request.moveDataToString() + "] ";
+    while (auto item = co_await requests.next()) {
+      co_yield Payload(prefix + "Hello " + item->moveDataToString() + "!");
+    }
+  }
+
+  std::atomic<int> pulled{0};
+  folly::Baton<> streamDone;
+};
+
+} // namespace
+
+TEST(CoroResponderTest, RequestResponse) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeServer(std::make_shared<HelloCoroHandler>());
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+
+  auto to = single::SingleTestObserver<std::string>::create();
+  client->getRequester()
+      ->requestResponse(Payload("Jane"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(to);
+  to->awaitTerminalEvent();
+  to->assertOnSuccessValue("Hello, Jane!");
+}
+
+TEST(CoroResponderTest, StreamIsPulledPerCredit) {
+  folly::ScopedEventBaseThread worker;
+  auto handler = std::make_shared<HelloCoroHandler>();
+  auto server = makeServer(handler);
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+
+  auto ts = TestSubscriber<std::string>::create(3);
+  client->getRequester()
+      ->requestStream(Payload("Bob"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(ts);
+  ts->awaitValueCount(3);
+
+  // Nothing is pulled from the generator ahead of the credits.
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(3, handler->pulled);
+
+  ts->request(7);
+  ts->awaitTerminalEvent();
+  ts->assertSuccess();
+  ts->assertValueCount(10);
+  ts->assertValueAt(0, "Bob 1");
+  ts->assertValueAt(9, "Bob 10");
+}
+
+TEST(CoroResponderTest, CancelDestroysGenerator) {
+  folly::ScopedEventBaseThread worker;
+  auto handler = std::make_shared<HelloCoroHandler>();
+  auto server = makeServer(handler);
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+
+  auto ts = TestSubscriber<std::string>::create(1);
+  client->getRequester()
+      ->requestStream(Payload("forever"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(ts);
+  ts->awaitValueCount(1);
+  ts->cancel();
+  handler->streamDone.wait();
+  EXPECT_EQ(1, handler->pulled);
+}
+
+TEST(CoroResponderTest, Channel) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeServer(std::make_shared<HelloCoroHandler>());
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+
+  auto ts = TestSubscriber<std::string>::create();
+  client->getRequester()
+      ->requestChannel(
+          Payload("/hello"),
+          Flowable<>::justN({"Bob", "Jane"})->map([](std::string v) {
+            return Payload(v);
+          }))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(ts);
+
+  ts->awaitTerminalEvent();
+  ts->assertSuccess();
+  ts->assertValueCount(2);
+  ts->assertValueAt(0, "[/hello] Hello Bob!");
+  ts->assertValueAt(1, "[/hello] Hello Jane!");
+}
+
+#endif // FOLLY_HAS_COROUTINES
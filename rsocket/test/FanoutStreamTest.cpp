@@ -0,0 +1,141 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "rsocket/FanoutStream.h"
+#include "yarpl/flowable/TestSubscriber.h"
+
+using namespace rsocket;
+using namespace yarpl::flowable;
+using namespace yarpl::observable;
+
+namespace {
+
+/// Hot source the test emits to.
+struct Source {
+  std::shared_ptr<Observable<Payload>> observable() {
+    return Observable<Payload>::create(
+        [this](std::shared_ptr<Observer<Payload>> o) { observer = o; });
+  }
+
+  void emit(std::initializer_list<const char*> values) {
+    for (auto value : values) {
+      observer->onNext(Payload(value));
+    }
+  }
+
+  std::shared_ptr<Observer<Payload>> observer;
+};
+
+std::vector<std::string> received(TestSubscriber<Payload>& subscriber) {
+  std::vector<std::string> values;
+  for (const auto& payload : subscriber.values()) {
+    values.push_back(payload.cloneDataToString());
+  }
+  return values;
+}
+
+using Values = std::vector<std::string>;
+
+} // namespace
+
+TEST(FanoutStreamTest, ServesEveryStream) {
+  Source source;
+  FanoutStream fanout{source.observable()};
+
+  auto first = TestSubscriber<Payload>::create();
+  fanout.stream()->subscribe(first);
+  source.emit({"a"});
+
+  auto second = TestSubscriber<Payload>::create();
+  fanout.stream()->subscribe(second);
+  EXPECT_EQ(2, fanout.streams());
+  source.emit({"b", "c"});
+
+  EXPECT_EQ((Values{"a", "b", "c"}), received(*first));
+  EXPECT_EQ((Values{"b", "c"}), received(*second));
+
+  second->cancel();
+  EXPECT_EQ(1, fanout.streams());
+  source.observer->onComplete();
+  first->assertSuccess();
+  EXPECT_EQ(0, fanout.streams());
+}
+
+TEST(FanoutStreamTest, DropsWithoutCredits) {
+  Source source;
+  FanoutStream fanout{source.observable(), 16, FanoutStream::Overflow::Drop};
+
+  auto slow = TestSubscriber<Payload>::create(1);
+  auto fast = TestSubscriber<Payload>::create();
+  fanout.stream()->subscribe(slow);
+  fanout.stream()->subscribe(fast);
+
+  source.emit({"a", "b", "c"});
+  slow->request(2);
+  source.emit({"d"});
+
+  EXPECT_EQ((Values{"a", "d"}), received(*slow));
+  EXPECT_EQ((Values{"a", "b", "c", "d"}), received(*fast));
+}
+
+TEST(FanoutStreamTest, ConflatesWithoutCredits) {
+  Source source;
+  FanoutStream fanout{
+      source.observable(), 16, FanoutStream::Overflow::Conflate};
+
+  auto slow = TestSubscriber<Payload>::create(1);
+  fanout.stream()->subscribe(slow);
+
+  source.emit({"a", "b", "c"});
+  EXPECT_EQ((Values{"a"}), received(*slow));
+
+  // Completion waits for the conflated item to be requested.
+  source.observer->onComplete();
+  EXPECT_THROW(slow->assertSuccess(), std::runtime_error);
+  slow->request(5);
+  EXPECT_EQ((Values{"a", "c"}), received(*slow));
+  slow->assertSuccess();
+}
+
+TEST(FanoutStreamTest, SourceErrorFailsStreams) {
+  Source source;
+  FanoutStream fanout{source.observable()};
+
+  auto subscriber = TestSubscriber<Payload>::create();
+  fanout.stream()->subscribe(subscriber);
+  source.observer->onError(std::runtime_error("feed down"));
+  subscriber->assertOnErrorMessage("feed down");
+
+  // Streams opened later fail right away.
+  auto late = TestSubscriber<Payload>::create();
+  fanout.stream()->subscribe(late);
+  late->assertOnErrorMessage("feed down");
+}
+
+TEST(FanoutStreamTest, DestructionCompletesStreams) {
+  Source source;
+  auto subscriber = TestSubscriber<Payload>::create();
+  {
+    FanoutStream fanout{source.observable()};
+    fanout.stream()->subscribe(subscriber);
+  }
+  subscriber->assertSuccess();
+  EXPECT_TRUE(source.observer->isUnsubscribed());
+}
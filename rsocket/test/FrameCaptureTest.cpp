@@ -0,0 +1,90 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+#include "rsocket/FrameCapture.h"
+#include "rsocket/framing/FrameSerializer.h"
+
+using namespace rsocket;
+
+namespace {
+
+const FrameSerializer& serializer() {
+  return *FrameSerializer::shared(ProtocolVersion::Latest, false);
+}
+
+std::string print(const FrameCapture& capture) {
+  std::ostringstream os;
+  FrameCapture::print(os, capture.snapshot());
+  return os.str();
+}
+
+} // namespace
+
+TEST(FrameCaptureTest, PrintsFramesOffline) {
+  FrameCapture capture;
+  capture.record(
+      FrameCapture::Direction::IN,
+      *serializer().serializeOut(Frame_CANCEL(1)));
+  capture.record(
+      FrameCapture::Direction::OUT,
+      *serializer().serializeOut(Frame_REQUEST_N(3, 10)));
+
+  std::ostringstream expected;
+  expected << "IN  " << Frame_CANCEL(1) << "\n"
+           << "OUT " << Frame_REQUEST_N(3, 10) << "\n";
+  EXPECT_EQ(expected.str(), print(capture));
+}
+
+TEST(FrameCaptureTest, RingKeepsNewestFrames) {
+  FrameCapture::Options options;
+  options.maxFrames = 2;
+  FrameCapture capture{options};
+  for (StreamId streamId = 1; streamId <= 5; ++streamId) {
+    capture.record(
+        FrameCapture::Direction::IN,
+        *serializer().serializeOut(Frame_CANCEL(streamId)));
+  }
+  EXPECT_EQ(5, capture.recorded());
+
+  std::ostringstream expected;
+  expected << "IN  " << Frame_CANCEL(4) << "\n"
+           << "IN  " << Frame_CANCEL(5) << "\n";
+  EXPECT_EQ(expected.str(), print(capture));
+}
+
+TEST(FrameCaptureTest, TruncatesLongFrames) {
+  FrameCapture::Options options;
+  options.maxBytesPerFrame = 16;
+  FrameCapture capture{options};
+  const auto frame = serializer().serializeOut(Frame_PAYLOAD(
+      7, FrameFlags::NEXT, Payload(std::string(100, 'x'))));
+  capture.record(FrameCapture::Direction::OUT, *frame);
+
+  const auto records = capture.snapshot();
+  ASSERT_EQ(1, records.size());
+  EXPECT_TRUE(records[0].truncated());
+  EXPECT_EQ(frame->computeChainDataLength(), records[0].length);
+  EXPECT_EQ(16, records[0].bytes.size());
+
+  // Only the header can be decoded.
+  std::ostringstream header;
+  header << FrameHeader(FrameType::PAYLOAD, FrameFlags::NEXT, 7);
+  const auto printed = print(capture);
+  EXPECT_EQ(0, printed.find("OUT " + header.str() + " <"));
+  EXPECT_NE(std::string::npos, printed.find("...\n"));
+}
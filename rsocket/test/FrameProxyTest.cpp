@@ -0,0 +1,221 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include "rsocket/FrameProxy.h"
+#include "rsocket/framing/FrameSerializer.h"
+#include "rsocket/test/test_utils/MockDuplexConnection.h"
+
+using namespace rsocket;
+using namespace testing;
+
+namespace {
+
+/// One end of a connection to the proxy: feeds it frames and collects the
+/// frames it sends.
+class Peer {
+ public:
+  std::unique_ptr<DuplexConnection> connect() {
+    auto connection = std::make_unique<NiceMock<MockDuplexConnection>>();
+    ON_CALL(*connection, isFramed()).WillByDefault(Return(true));
+    ON_CALL(*connection, setInput_(_))
+        .WillByDefault(Invoke(
+            [this](std::shared_ptr<DuplexConnection::Subscriber> input) {
+              input_ = std::move(input);
+              input_->onSubscribe(std::make_shared<
+                                  NiceMock<yarpl::mocks::MockSubscription>>());
+            }));
+    ON_CALL(*connection, send_(_))
+        .WillByDefault(Invoke([this](std::unique_ptr<folly::IOBuf>& frame) {
+          sent.push_back(std::move(frame));
+        }));
+    return std::move(connection);
+  }
+
+  template <typename Frame>
+  void receive(Frame frame) {
+    input_->onNext(serializer->serializeOut(std::move(frame)));
+  }
+
+  void close() {
+    input_->onComplete();
+  }
+
+  FrameHeader header(size_t i) const {
+    return serializer->decodeFrameHeader(*sent.at(i))->header;
+  }
+
+  template <typename Frame>
+  Frame frame(size_t i) const {
+    Frame frame;
+    EXPECT_TRUE(serializer->deserializeFrom(frame, sent.at(i)->clone()));
+    return frame;
+  }
+
+  std::vector<std::unique_ptr<folly::IOBuf>> sent;
+
+  const std::unique_ptr<FrameSerializer> serializer{
+      FrameSerializer::createFrameSerializer(ProtocolVersion::Latest)};
+
+ private:
+  std::shared_ptr<DuplexConnection::Subscriber> input_;
+};
+
+Frame_SETUP setupFrame(std::string dataMimeType = "text/plain") {
+  return Frame_SETUP(
+      FrameFlags::EMPTY_,
+      ProtocolVersion::Latest.major,
+      ProtocolVersion::Latest.minor,
+      Frame_SETUP::kMaxKeepaliveTime,
+      Frame_SETUP::kMaxLifetime,
+      ResumeIdentificationToken::generateNew(),
+      "text/plain",
+      std::move(dataMimeType),
+      Payload());
+}
+
+std::shared_ptr<FrameProxy> createProxy(Peer& backend) {
+  auto proxy = FrameProxy::create(backend.connect(), SetupParameters());
+  EXPECT_EQ(1, backend.sent.size());
+  EXPECT_EQ(FrameType::SETUP, backend.header(0).type);
+  return proxy;
+}
+
+} // namespace
+
+TEST(FrameProxyTest, ForwardsStreamsWithRewrittenIds) {
+  Peer backend;
+  Peer edgeA;
+  Peer edgeB;
+  auto proxy = createProxy(backend);
+
+  proxy->addEdge(edgeA.connect());
+  proxy->addEdge(edgeB.connect());
+  edgeA.receive(setupFrame());
+  edgeB.receive(setupFrame());
+  EXPECT_EQ(2, proxy->numEdges());
+
+  edgeA.receive(Frame_REQUEST_STREAM(1, FrameFlags::EMPTY_, 5, Payload("a")));
+  edgeB.receive(Frame_REQUEST_STREAM(1, FrameFlags::EMPTY_, 7, Payload("b")));
+  ASSERT_EQ(3, backend.sent.size());
+  EXPECT_EQ(1, backend.header(1).streamId);
+  EXPECT_EQ(3, backend.header(2).streamId);
+  auto request = backend.frame<Frame_REQUEST_STREAM>(2);
+  EXPECT_EQ(7, request.requestN_);
+  EXPECT_EQ("b", request.payload_.moveDataToString());
+  EXPECT_EQ(2, proxy->numStreams());
+
+  backend.receive(Frame_PAYLOAD(3, FrameFlags::NEXT, Payload("hello b")));
+  ASSERT_EQ(1, edgeB.sent.size());
+  EXPECT_EQ(1, edgeB.header(0).streamId);
+  EXPECT_EQ(
+      "hello b", edgeB.frame<Frame_PAYLOAD>(0).payload_.moveDataToString());
+
+  // Credit goes through as it is.
+  edgeB.receive(Frame_REQUEST_N(1, 3));
+  ASSERT_EQ(4, backend.sent.size());
+  EXPECT_EQ(3, backend.header(3).streamId);
+  EXPECT_EQ(3, backend.frame<Frame_REQUEST_N>(3).requestN_);
+
+  backend.receive(Frame_PAYLOAD(1, FrameFlags::COMPLETE, Payload()));
+  ASSERT_EQ(1, edgeA.sent.size());
+  EXPECT_EQ(FrameType::PAYLOAD, edgeA.header(0).type);
+  EXPECT_EQ(1, edgeA.header(0).streamId);
+  EXPECT_EQ(1, proxy->numStreams());
+  EXPECT_EQ(1, edgeB.sent.size());
+}
+
+TEST(FrameProxyTest, RequestResponseEndsWithResponse) {
+  Peer backend;
+  Peer edge;
+  auto proxy = createProxy(backend);
+  proxy->addEdge(edge.connect());
+  edge.receive(setupFrame());
+
+  edge.receive(Frame_REQUEST_RESPONSE(1, FrameFlags::EMPTY_, Payload("q")));
+  EXPECT_EQ(1, proxy->numStreams());
+  backend.receive(
+      Frame_PAYLOAD(1, FrameFlags::NEXT | FrameFlags::COMPLETE, Payload("r")));
+  EXPECT_EQ(0, proxy->numStreams());
+  ASSERT_EQ(1, edge.sent.size());
+  EXPECT_EQ("r", edge.frame<Frame_PAYLOAD>(0).payload_.moveDataToString());
+}
+
+TEST(FrameProxyTest, ClosingEdgeCancelsItsStreams) {
+  Peer backend;
+  Peer edge;
+  auto proxy = createProxy(backend);
+  proxy->addEdge(edge.connect());
+  edge.receive(setupFrame());
+
+  edge.receive(Frame_REQUEST_STREAM(1, FrameFlags::EMPTY_, 5, Payload("a")));
+  edge.receive(Frame_REQUEST_CHANNEL(3, FrameFlags::EMPTY_, 5, Payload("b")));
+  edge.close();
+
+  EXPECT_EQ(0, proxy->numEdges());
+  EXPECT_EQ(0, proxy->numStreams());
+  ASSERT_EQ(5, backend.sent.size());
+  EXPECT_EQ(FrameType::CANCEL, backend.header(3).type);
+  EXPECT_EQ(1, backend.header(3).streamId);
+  // The channel still had payloads going up.
+  EXPECT_EQ(FrameType::ERROR, backend.header(4).type);
+  EXPECT_EQ(3, backend.header(4).streamId);
+}
+
+TEST(FrameProxyTest, RejectsMismatchedSetup) {
+  Peer backend;
+  Peer edge;
+  auto proxy = createProxy(backend);
+  proxy->addEdge(edge.connect());
+  edge.receive(setupFrame("application/json"));
+
+  EXPECT_EQ(0, proxy->numEdges());
+  ASSERT_EQ(1, edge.sent.size());
+  auto error = edge.frame<Frame_ERROR>(0);
+  EXPECT_EQ(ErrorCode::UNSUPPORTED_SETUP, error.errorCode_);
+}
+
+TEST(FrameProxyTest, AnswersKeepalives) {
+  Peer backend;
+  Peer edge;
+  auto proxy = createProxy(backend);
+  proxy->addEdge(edge.connect());
+  edge.receive(setupFrame());
+
+  edge.receive(Frame_KEEPALIVE(
+      FrameFlags::KEEPALIVE_RESPOND, 0, folly::IOBuf::copyBuffer("ping")));
+  ASSERT_EQ(1, edge.sent.size());
+  auto keepalive = edge.frame<Frame_KEEPALIVE>(0);
+  EXPECT_FALSE(!!(keepalive.header_.flags & FrameFlags::KEEPALIVE_RESPOND));
+  EXPECT_EQ("ping", keepalive.data_->moveToFbString().toStdString());
+  EXPECT_EQ(1, backend.sent.size());
+}
+
+TEST(FrameProxyTest, ClosingBackendClosesEdges) {
+  Peer backend;
+  Peer edge;
+  auto proxy = createProxy(backend);
+  proxy->addEdge(edge.connect());
+  edge.receive(setupFrame());
+  edge.receive(Frame_REQUEST_STREAM(1, FrameFlags::EMPTY_, 5, Payload("a")));
+
+  backend.close();
+  EXPECT_TRUE(proxy->isClosed());
+  EXPECT_EQ(0, proxy->numEdges());
+  EXPECT_EQ(0, proxy->numStreams());
+  ASSERT_EQ(1, edge.sent.size());
+  EXPECT_EQ(FrameType::ERROR, edge.header(0).type);
+  EXPECT_EQ(0, edge.header(0).streamId);
+}
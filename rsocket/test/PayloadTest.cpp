@@ -80,3 +80,46 @@ TEST(PayloadTest, Clone) {
   EXPECT_EQ(clone.data, nullptr);
   EXPECT_EQ(clone.metadata, nullptr);
 }
+
+TEST(PayloadTest, Views) {
+  Payload none;
+  ASSERT_TRUE(none.dataView().hasValue());
+  EXPECT_TRUE(none.dataView()->empty());
+  EXPECT_TRUE(none.coalescedMetadataView().empty());
+
+  Payload p("data", "metadata");
+  ASSERT_TRUE(p.dataView().hasValue());
+  EXPECT_EQ("data", *p.dataView());
+  EXPECT_EQ(p.data->data(), p.dataView()->bytes().data());
+  ASSERT_TRUE(p.metadataView().hasValue());
+  EXPECT_EQ("metadata", *p.metadataView());
+
+  // An empty buffer in the chain keeps the bytes contiguous.
+  p.data->prependChain(folly::IOBuf::create(0));
+  ASSERT_TRUE(p.dataView().hasValue());
+  EXPECT_EQ("data", *p.dataView());
+
+  p.data->prependChain(folly::IOBuf::copyBuffer("more"));
+  EXPECT_FALSE(p.dataView().hasValue());
+
+  std::vector<std::string> ranges;
+  p.forEachDataRange(
+      [&](folly::StringPiece range) { ranges.push_back(range.str()); });
+  EXPECT_EQ((std::vector<std::string>{"data", "more"}), ranges);
+
+  EXPECT_EQ("datamore", p.coalescedDataView());
+  EXPECT_FALSE(p.data->isChained());
+  ASSERT_TRUE(p.dataView().hasValue());
+  EXPECT_EQ("datamore", *p.dataView());
+}
+
+TEST(PayloadTest, SmallPayloadLayout) {
+  Payload dataOnly("data");
+  EXPECT_LE(Payload::kHeaderHeadroom, dataOnly.data->headroom());
+
+  Payload p("data", "metadata");
+  EXPECT_LE(Payload::kHeaderHeadroom, p.metadata->headroom());
+  EXPECT_LE(4, p.metadata->tailroom());
+  EXPECT_EQ("data", p.cloneDataToString());
+  EXPECT_EQ("metadata", p.cloneMetadataToString());
+}
@@ -15,14 +15,152 @@
 #include "RSocketTests.h"
 
 #include <folly/Random.h>
+#include <folly/Synchronized.h>
 #include <folly/io/async/ScopedEventBaseThread.h>
+#include <folly/synchronization/Baton.h>
 #include <gtest/gtest.h>
+
+#include <sched.h>
+
+#include <atomic>
+#include <thread>
+
 #include "rsocket/test/handlers/HelloStreamRequestHandler.h"
+#include "rsocket/transports/tcp/TcpConnectionAcceptor.h"
+#include "rsocket/transports/tcp/TcpWorkerPlacement.h"
+#include "yarpl/Single.h"
 
 using namespace rsocket;
 using namespace rsocket::tests;
 using namespace rsocket::tests::client_server;
 
+namespace {
+
+/// Places the first connection on the last worker, and all the others on the
+/// first one.
+class SkewedPlacement : public TcpWorkerPlacement {
+ public:
+  size_t pick(const std::vector<TcpWorkerLoad>& loads) override {
+    return placed_++ == 0 ? loads.size() - 1 : 0;
+  }
+
+ private:
+  size_t placed_{0};
+};
+
+class EchoResponseHandler : public RSocketResponder {
+ public:
+  std::shared_ptr<yarpl::single::Single<Payload>> handleRequestResponse(
+      Payload request,
+      StreamId) override {
+    return yarpl::single::Single<Payload>::just(std::move(request));
+  }
+};
+
+/// Holds on to the responses until respond() is called.
+class HeldResponseHandler : public RSocketResponder {
+ public:
+  std::shared_ptr<yarpl::single::Single<Payload>> handleRequestResponse(
+      Payload,
+      StreamId) override {
+    return yarpl::single::Single<Payload>::create(
+        [this](std::shared_ptr<yarpl::single::SingleObserver<Payload>>
+                   observer) {
+          observer->onSubscribe(yarpl::single::SingleSubscriptions::empty());
+          observers_.lock()->push_back(std::move(observer));
+          requested.post();
+        });
+  }
+
+  void respond() {
+    auto observers = std::move(*observers_.lock());
+    for (auto& observer : observers) {
+      observer->onSuccess(Payload("done"));
+    }
+  }
+
+  folly::Baton<> requested;
+
+ private:
+  folly::Synchronized<
+      std::vector<std::shared_ptr<yarpl::single::SingleObserver<Payload>>>>
+      observers_;
+};
+
+/// Counts the METADATA_PUSH frames it receives.
+class MetadataPushCounter : public RSocketResponder {
+ public:
+  explicit MetadataPushCounter(size_t expected) : expected_(expected) {}
+
+  void handleMetadataPush(std::unique_ptr<folly::IOBuf> metadata) override {
+    EXPECT_EQ("config", metadata->moveToFbString().toStdString());
+    if (++received_ == expected_) {
+      done.post();
+    }
+  }
+
+  folly::Baton<> done;
+
+ private:
+  const size_t expected_;
+  std::atomic<size_t> received_{0};
+};
+
+/// Client responder, counting the notifications the server pushes, and
+/// answering its stream requests with the request data.
+class NotificationCounter : public RSocketResponder {
+ public:
+  explicit NotificationCounter(size_t expected) : expected_(expected) {}
+
+  void handleFireAndForget(Payload request, StreamId) override {
+    EXPECT_EQ("notification", request.moveDataToString());
+    if (++received_ == expected_) {
+      done.post();
+    }
+  }
+
+  std::shared_ptr<yarpl::flowable::Flowable<Payload>> handleRequestStream(
+      Payload request,
+      StreamId) override {
+    return yarpl::flowable::Flowable<Payload>::justOnce(std::move(request));
+  }
+
+  folly::Baton<> done;
+
+ private:
+  const size_t expected_;
+  std::atomic<size_t> received_{0};
+};
+
+/// Serves a request/response from an acceptor whose worker threads busy poll,
+/// pinned to `cpuSets`, then stops it.
+void serveOnBusyPollWorkers(std::vector<std::vector<int>> cpuSets) {
+  TcpConnectionAcceptor::Options opts;
+  opts.threads = 2;
+  opts.address = folly::SocketAddress("0.0.0.0", 0);
+  opts.busyPoll = true;
+  opts.cpuSets = std::move(cpuSets);
+  opts.connection.busyPollMicros = 50;
+  auto server = RSocket::createServer(
+      std::make_unique<TcpConnectionAcceptor>(std::move(opts)));
+  auto handler = std::make_shared<EchoResponseHandler>();
+  server->start([handler](const SetupParameters&) { return handler; });
+
+  folly::ScopedEventBaseThread worker;
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  auto response = client->getRequester()
+                      ->requestResponseFuture(Payload("ping"))
+                      .get(std::chrono::seconds{5});
+  EXPECT_EQ("ping", response.moveDataToString());
+  EXPECT_EQ(1, server->getNumConnections());
+
+  client.reset();
+  server->shutdownAndWait();
+  EXPECT_EQ(0, server->getNumConnections());
+}
+
+} // namespace
+
 TEST(RSocketClientServer, StartAndShutdown) {
   folly::ScopedEventBaseThread worker;
   auto server = makeServer(std::make_shared<HelloStreamRequestHandler>());
@@ -93,6 +231,32 @@ TEST(RSocketClientServer, ConnectOnDifferentEvb) {
 
 /// Test destroying a client with an open connection on the same worker thread
 /// as that connection.
+TEST(RSocketClientServer, ConnectingClientRequestsBeforeConnect) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeServer(std::make_shared<EchoResponseHandler>());
+  auto client = RSocket::createConnectingClient(
+      getConnFactory(worker.getEventBase(), *server->listeningPort()),
+      *worker.getEventBase());
+
+  auto response = client->getRequester()
+                      ->requestResponseFuture(Payload("ping"))
+                      .get(std::chrono::seconds{5});
+  EXPECT_EQ("ping", response.moveDataToString());
+}
+
+TEST(RSocketClientServer, ConnectingClientFailsRequests) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeServer(std::make_shared<EchoResponseHandler>());
+  auto const port = *server->listeningPort();
+  server.reset();
+
+  auto client = RSocket::createConnectingClient(
+      getConnFactory(worker.getEventBase(), port), *worker.getEventBase());
+  EXPECT_ANY_THROW(client->getRequester()
+                       ->requestResponseFuture(Payload("ping"))
+                       .get(std::chrono::seconds{5}));
+}
+
 TEST(RSocketClientServer, ClientClosesOnWorker) {
   folly::ScopedEventBaseThread worker;
   auto server = makeServer(std::make_shared<HelloStreamRequestHandler>());
@@ -136,3 +300,216 @@ TEST(RSocketClientServer, CloseServerWithConnections) {
 
   server.reset();
 }
+
+TEST(RSocketClientServer, DrainWaitsForStreams) {
+  folly::ScopedEventBaseThread worker;
+  auto handler = std::make_shared<HeldResponseHandler>();
+  auto server = makeServer(handler);
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+
+  auto response =
+      client->getRequester()->requestResponseFuture(Payload("request"));
+  handler->requested.wait();
+
+  folly::Baton<> drained;
+  std::thread drainer([&] {
+    RSocketServer::DrainOptions options;
+    options.timeout = std::chrono::seconds{10};
+    server->drainAndWait(std::move(options));
+    drained.post();
+  });
+
+  // The connection stays open for the response.
+  EXPECT_FALSE(drained.try_wait_for(std::chrono::milliseconds{100}));
+  handler->respond();
+  EXPECT_EQ(
+      "done",
+      std::move(response).get(std::chrono::seconds{5}).moveDataToString());
+
+  drainer.join();
+}
+
+TEST(RSocketClientServer, DrainTimesOut) {
+  folly::ScopedEventBaseThread worker;
+  auto handler = std::make_shared<HeldResponseHandler>();
+  auto server = makeServer(handler);
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+
+  auto response =
+      client->getRequester()->requestResponseFuture(Payload("request"));
+  handler->requested.wait();
+
+  std::vector<size_t> progress;
+  RSocketServer::DrainOptions options;
+  options.timeout = std::chrono::milliseconds{100};
+  options.progressInterval = std::chrono::milliseconds{20};
+  options.onProgress = [&](size_t remaining) { progress.push_back(remaining); };
+  server->drainAndWait(std::move(options));
+
+  ASSERT_FALSE(progress.empty());
+  EXPECT_EQ(1, progress.front());
+  EXPECT_EQ(0, progress.back());
+  EXPECT_THROW(
+      std::move(response).get(std::chrono::seconds{5}), std::exception);
+}
+
+TEST(RSocketClientServer, BroadcastMetadataPush) {
+  constexpr size_t kClients = 8;
+  folly::ScopedEventBaseThread worker;
+  auto server = makeServer(std::make_shared<HelloStreamRequestHandler>());
+  auto counter = std::make_shared<MetadataPushCounter>(kClients);
+
+  std::vector<std::unique_ptr<RSocketClient>> clients;
+  for (size_t i = 0; i < kClients; ++i) {
+    clients.push_back(RSocket::createConnectedClient(
+                          getConnFactory(
+                              worker.getEventBase(), *server->listeningPort()),
+                          SetupParameters(),
+                          counter)
+                          .get());
+  }
+  // The server registers a connection once it has processed its SETUP.
+  for (int i = 0; i < 500 && server->getNumConnections() != kClients; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+  }
+  ASSERT_EQ(kClients, server->getNumConnections());
+
+  EXPECT_EQ(
+      kClients,
+      server->broadcastMetadataPush(folly::IOBuf::copyBuffer("config")));
+  EXPECT_TRUE(counter->done.try_wait_for(std::chrono::seconds{5}));
+}
+
+TEST(RSocketClientServer, BroadcastFireAndForgetAndStream) {
+  constexpr size_t kClients = 8;
+  folly::ScopedEventBaseThread worker;
+  auto server = makeServer(std::make_shared<HelloStreamRequestHandler>());
+  auto counter = std::make_shared<NotificationCounter>(kClients);
+
+  std::vector<std::unique_ptr<RSocketClient>> clients;
+  for (size_t i = 0; i < kClients; ++i) {
+    clients.push_back(RSocket::createConnectedClient(
+                          getConnFactory(
+                              worker.getEventBase(), *server->listeningPort()),
+                          SetupParameters(),
+                          counter)
+                          .get());
+  }
+  for (int i = 0; i < 500 && server->getNumConnections() != kClients; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+  }
+  ASSERT_EQ(kClients, server->getNumConnections());
+
+  EXPECT_EQ(
+      kClients, server->broadcastFireAndForget(Payload("notification")));
+  EXPECT_TRUE(counter->done.try_wait_for(std::chrono::seconds{5}));
+
+  // Twice, so that the second round gets the next stream ids.
+  std::atomic<size_t> responses{0};
+  folly::Baton<> done;
+  for (int round = 1; round <= 2; ++round) {
+    EXPECT_EQ(
+        kClients,
+        server->broadcastRequestStream(Payload("ping"), [&, round] {
+          return yarpl::flowable::Subscriber<Payload>::create(
+              [&, round](Payload payload) {
+                EXPECT_EQ("ping", payload.moveDataToString());
+                if (++responses == kClients * round) {
+                  done.post();
+                }
+              });
+        }));
+    EXPECT_TRUE(done.try_wait_for(std::chrono::seconds{5}));
+    done.reset();
+  }
+}
+
+TEST(RSocketClientServer, RebalanceMovesIdleConnections) {
+  constexpr size_t kClients = 7;
+  TcpConnectionAcceptor::Options opts;
+  opts.threads = 2;
+  opts.address = folly::SocketAddress("0.0.0.0", 0);
+  opts.placement = std::make_shared<SkewedPlacement>();
+  auto server = RSocket::createServer(
+      std::make_unique<TcpConnectionAcceptor>(std::move(opts)));
+  auto handler = std::make_shared<EchoResponseHandler>();
+  server->start([handler](const SetupParameters&) { return handler; });
+
+  folly::ScopedEventBaseThread worker;
+  std::vector<std::unique_ptr<RSocketClient>> clients;
+  for (size_t i = 0; i < kClients; ++i) {
+    clients.push_back(
+        makeClient(worker.getEventBase(), *server->listeningPort()));
+  }
+  for (int i = 0; i < 500 && server->getNumConnections() != kClients; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+  }
+  ASSERT_EQ(kClients, server->getNumConnections());
+
+  // Six connections on one worker and one on the other, so two move.
+  RSocketServer::RebalanceOptions options;
+  EXPECT_EQ(2, server->rebalance(options).get(std::chrono::seconds{5}));
+  EXPECT_EQ(0, server->rebalance(options).get(std::chrono::seconds{5}));
+
+  for (auto& client : clients) {
+    auto response = client->getRequester()
+                        ->requestResponseFuture(Payload("ping"))
+                        .get(std::chrono::seconds{5});
+    EXPECT_EQ("ping", response.moveDataToString());
+  }
+}
+
+TEST(RSocketClientServer, AcceptPacingHoldsConnectionsInBacklog) {
+  constexpr size_t kClients = 5;
+  TcpConnectionAcceptor::Options opts;
+  opts.threads = 1;
+  opts.backlog = 128;
+  opts.address = folly::SocketAddress("0.0.0.0", 0);
+  opts.acceptPacing.emplace();
+  opts.acceptPacing->maxQueueDelay = std::chrono::milliseconds{5};
+  opts.acceptPacing->checkInterval = std::chrono::milliseconds{1};
+  auto server = RSocket::createServer(
+      std::make_unique<TcpConnectionAcceptor>(std::move(opts)));
+
+  // The first SETUP stalls the only worker, so accepting pauses until it is
+  // released.
+  auto handler = std::make_shared<EchoResponseHandler>();
+  folly::Baton<> release;
+  std::atomic<bool> first{true};
+  server->start([&](const SetupParameters&) {
+    if (first.exchange(false)) {
+      release.wait();
+    }
+    return handler;
+  });
+
+  folly::ScopedEventBaseThread worker;
+  std::vector<std::unique_ptr<RSocketClient>> clients;
+  for (size_t i = 0; i < kClients; ++i) {
+    clients.push_back(
+        makeClient(worker.getEventBase(), *server->listeningPort()));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds{50});
+  EXPECT_GT(kClients, server->getNumConnections());
+  release.post();
+
+  for (auto& client : clients) {
+    auto response = client->getRequester()
+                        ->requestResponseFuture(Payload("ping"))
+                        .get(std::chrono::seconds{5});
+    EXPECT_EQ("ping", response.moveDataToString());
+  }
+  EXPECT_EQ(kClients, server->getNumConnections());
+}
+
+TEST(RSocketClientServer, BusyPollWorkers) {
+  // The CPU this thread runs on is one the workers may run on too.
+  auto const cpu = ::sched_getcpu();
+  ASSERT_LE(0, cpu);
+  serveOnBusyPollWorkers({{cpu}, {cpu}});
+}
+
+TEST(RSocketClientServer, BusyPollWorkersOnInvalidCpus) {
+  // Workers that can't be pinned run unpinned.
+  serveOnBusyPollWorkers({{-1}, {1 << 20}});
+}
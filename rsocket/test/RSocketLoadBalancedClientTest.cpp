@@ -0,0 +1,191 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <folly/Conv.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+#include "RSocketTests.h"
+#include "rsocket/RSocketLoadBalancedClient.h"
+#include "rsocket/test/test_utils/GenericRequestResponseHandler.h"
+#include "yarpl/Single.h"
+#include "yarpl/single/SingleTestObserver.h"
+
+using namespace yarpl::single;
+using namespace rsocket;
+using namespace rsocket::tests;
+using namespace rsocket::tests::client_server;
+
+namespace {
+
+struct Backend {
+  explicit Backend(std::string name)
+      : server(makeServer(std::make_shared<GenericRequestResponseHandler>(
+            [this, name = std::move(name)](StringPair const&) {
+              ++requests;
+              return payload_response(name, "");
+            }))),
+        address(folly::to<std::string>(*server->listeningPort())) {}
+
+  std::atomic<size_t> requests{0};
+  std::unique_ptr<RSocketServer> server;
+  std::string address;
+};
+
+std::string requestOnce(RSocketRequester& requester) {
+  auto to = SingleTestObserver<std::string>::create();
+  requester.requestResponse(Payload("hello"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(to);
+  to->awaitTerminalEvent();
+  to->assertSuccess();
+  return to->getOnSuccessValue();
+}
+
+void waitForConnections(RSocketLoadBalancedClient& client, size_t n) {
+  for (int i = 0; i < 500 && client.getNumConnections() != n; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_EQ(n, client.getNumConnections());
+}
+
+} // namespace
+
+class RSocketLoadBalancedClientTest : public ::testing::Test {
+ protected:
+  RSocketLoadBalancedClient::ClientFactory factory() {
+    return [evb = worker_.getEventBase()](const std::string& port) {
+      return RSocket::createConnectedClient(
+          getConnFactory(evb, folly::to<uint16_t>(port)));
+    };
+  }
+
+  folly::ScopedEventBaseThread worker_;
+};
+
+TEST_F(RSocketLoadBalancedClientTest, NoConnection) {
+  RSocketLoadBalancedClient client(factory());
+  EXPECT_EQ(0, client.getNumConnections());
+
+  auto to = SingleTestObserver<Payload>::create();
+  client.getRequester()->requestResponse(Payload("hello"))->subscribe(to);
+  to->awaitTerminalEvent();
+  to->assertOnErrorMessage("No connection to send the request to");
+}
+
+TEST_F(RSocketLoadBalancedClientTest, SpreadsRequests) {
+  Backend a("a");
+  Backend b("b");
+  RSocketLoadBalancedClient client(factory());
+  client.setServers({a.address, b.address});
+  waitForConnections(client, 2);
+
+  for (int i = 0; i < 200; ++i) {
+    auto const name = requestOnce(*client.getRequester());
+    EXPECT_TRUE(name == "a" || name == "b") << name;
+  }
+  EXPECT_EQ(200, a.requests + b.requests);
+  EXPECT_GT(a.requests, 0);
+  EXPECT_GT(b.requests, 0);
+}
+
+TEST_F(RSocketLoadBalancedClientTest, RemovedServerGetsNoRequests) {
+  Backend a("a");
+  Backend b("b");
+  RSocketLoadBalancedClient client(factory());
+  client.setServers({a.address, b.address});
+  waitForConnections(client, 2);
+
+  client.setServers({b.address});
+  EXPECT_EQ(1, client.getNumConnections());
+  auto const before = a.requests.load();
+  for (int i = 0; i < 50; ++i) {
+    EXPECT_EQ("b", requestOnce(*client.getRequester()));
+  }
+  EXPECT_EQ(before, a.requests);
+}
+
+TEST_F(RSocketLoadBalancedClientTest, FailedServerIsDropped) {
+  Backend a("a");
+  RSocketLoadBalancedClient client(
+      [real = factory()](const std::string& s) {
+        if (s == "unreachable") {
+          return folly::makeFuture<std::unique_ptr<RSocketClient>>(
+              std::runtime_error("unreachable"));
+        }
+        return real(s);
+      });
+  client.setServers({"unreachable", a.address});
+  waitForConnections(client, 1);
+  EXPECT_EQ("a", requestOnce(*client.getRequester()));
+}
+
+namespace {
+
+class HedgeStats : public RSocketStats {
+ public:
+  void hedgeableRequest() override {
+    ++hedgeable;
+  }
+  void hedgeSent() override {
+    ++sent;
+  }
+  void hedgeWon() override {
+    ++won;
+  }
+
+  std::atomic<size_t> hedgeable{0};
+  std::atomic<size_t> sent{0};
+  std::atomic<size_t> won{0};
+};
+
+} // namespace
+
+TEST_F(RSocketLoadBalancedClientTest, HedgesSlowServer) {
+  Backend fast("fast");
+  std::atomic<bool> slowDown{false};
+  auto slow = makeServer(std::make_shared<GenericRequestResponseHandler>(
+      [&slowDown](StringPair const&) {
+        if (slowDown) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        }
+        return payload_response("slow", "");
+      }));
+
+  auto stats = std::make_shared<HedgeStats>();
+  RSocketLoadBalancedClient::Options options;
+  options.hedgePercentile = 0.9;
+  options.stats = stats;
+  RSocketLoadBalancedClient client(factory(), options);
+  client.setServers(
+      {fast.address, folly::to<std::string>(*slow->listeningPort())});
+  waitForConnections(client, 2);
+
+  // Let the pool learn its latencies.
+  for (int i = 0; i < 200; ++i) {
+    requestOnce(*client.getRequester());
+  }
+  EXPECT_EQ(200, stats->hedgeable);
+
+  slowDown = true;
+  for (int i = 0; i < 20; ++i) {
+    EXPECT_EQ("fast", requestOnce(*client.getRequester()));
+  }
+  EXPECT_GT(stats->sent, 0);
+  EXPECT_GT(stats->won, 0);
+  EXPECT_LE(stats->won, stats->sent);
+}
@@ -0,0 +1,116 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <folly/Conv.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+
+#include "RSocketTests.h"
+#include "rsocket/RSocketShardedClient.h"
+#include "rsocket/test/test_utils/GenericRequestResponseHandler.h"
+
+using namespace rsocket;
+using namespace rsocket::tests;
+using namespace rsocket::tests::client_server;
+
+namespace {
+
+struct Backend {
+  explicit Backend(std::string name)
+      : server(makeServer(std::make_shared<GenericRequestResponseHandler>(
+            [this, name = std::move(name)](StringPair const&) {
+              ++requests;
+              return payload_response(name, "");
+            }))) {}
+
+  uint16_t port() const {
+    return *server->listeningPort();
+  }
+
+  std::atomic<size_t> requests{0};
+  std::unique_ptr<RSocketServer> server;
+};
+
+std::string requestOn(folly::Executor* executor, RSocketRequester& requester) {
+  return folly::via(
+             executor,
+             [&requester] {
+               return requester.requestResponseFuture(Payload("hello"));
+             })
+      .get(std::chrono::seconds(5))
+      .moveDataToString();
+}
+
+} // namespace
+
+class RSocketShardedClientTest : public ::testing::Test {
+ protected:
+  // Connects the first worker to `a`, the second to `b`.
+  std::unique_ptr<RSocketShardedClient> connect() {
+    auto const first = workers_[0].getEventBase();
+    return RSocketShardedClient::connect(
+               {first, workers_[1].getEventBase()},
+               [this, first](folly::EventBase& eventBase) {
+                 auto const port = &eventBase == first ? a_.port() : b_.port();
+                 return makeClientAsync(&eventBase, port, &eventBase);
+               })
+        .get(std::chrono::seconds(5));
+  }
+
+  Backend a_{"a"};
+  Backend b_{"b"};
+  folly::ScopedEventBaseThread workers_[2];
+};
+
+TEST_F(RSocketShardedClientTest, RequestsGoToConnectionOfWorker) {
+  auto client = connect();
+  ASSERT_EQ(2, client->getNumShards());
+  auto& requester = *client->getRequester();
+
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ("a", requestOn(workers_[0].getEventBase(), requester));
+    EXPECT_EQ("b", requestOn(workers_[1].getEventBase(), requester));
+  }
+  EXPECT_EQ(10, a_.requests);
+  EXPECT_EQ(10, b_.requests);
+}
+
+TEST_F(RSocketShardedClientTest, OtherThreadsAreSpread) {
+  auto client = connect();
+  for (int i = 0; i < 10; ++i) {
+    client->getRequester()
+        ->requestResponseFuture(Payload("hello"))
+        .get(std::chrono::seconds(5));
+  }
+  EXPECT_EQ(5, a_.requests);
+  EXPECT_EQ(5, b_.requests);
+}
+
+TEST_F(RSocketShardedClientTest, FailsIfAnyShardFails) {
+  auto const first = workers_[0].getEventBase();
+  auto result = RSocketShardedClient::connect(
+                    {first, workers_[1].getEventBase()},
+                    [this, first](folly::EventBase& eventBase) {
+                      if (&eventBase != first) {
+                        return folly::makeFuture<
+                            std::unique_ptr<RSocketClient>>(
+                            std::runtime_error("unreachable"));
+                      }
+                      return makeClientAsync(&eventBase, a_.port(), first);
+                    })
+                    .getTry();
+  EXPECT_TRUE(result.hasException());
+}
@@ -0,0 +1,175 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <folly/synchronization/Baton.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+
+#include "RSocketTests.h"
+#include "rsocket/RequestDeadline.h"
+#include "yarpl/Flowable.h"
+#include "yarpl/Single.h"
+#include "yarpl/flowable/TestSubscriber.h"
+#include "yarpl/single/SingleTestObserver.h"
+
+using namespace yarpl;
+using namespace rsocket;
+using namespace rsocket::tests;
+using namespace rsocket::tests::client_server;
+using namespace std::chrono_literals;
+
+namespace {
+
+using Clock = RequestDeadline::Clock;
+
+class DeadlineStats : public RSocketStats {
+ public:
+  void requestDeadlineExpired() override {
+    ++expired;
+    expiredBaton.post();
+  }
+
+  std::atomic<size_t> expired{0};
+  folly::Baton<> expiredBaton;
+};
+
+/// Never answers, and records the deadline of the requests it gets.
+class SlowHandler : public RSocketResponder {
+ public:
+  std::shared_ptr<single::Single<Payload>> handleRequestResponse(
+      Payload,
+      StreamId) override {
+    ++calls;
+    deadline = RequestDeadline::current();
+    called.post();
+    return single::Single<Payload>::create([this](auto observer) {
+      observer->onSubscribe(
+          single::SingleSubscriptions::create([this] { cancelled.post(); }));
+    });
+  }
+
+  std::shared_ptr<flowable::Flowable<Payload>> handleRequestStream(
+      Payload,
+      StreamId) override {
+    ++calls;
+    deadline = RequestDeadline::current();
+    called.post();
+    return flowable::Flowable<Payload>::never()->doOnCancel(
+        [this] { cancelled.post(); });
+  }
+
+  std::atomic<size_t> calls{0};
+  folly::Optional<Clock::time_point> deadline;
+  folly::Baton<> called;
+  folly::Baton<> cancelled;
+};
+
+} // namespace
+
+TEST(RequestDeadlineTest, Frame) {
+  auto const now = Clock::now();
+  auto frame = RequestDeadline::frame(3, now + 5s);
+  EXPECT_EQ(3, frame.header_.streamId);
+  EXPECT_TRUE(!!(frame.header_.flags & FrameFlags::IGNORE_));
+
+  auto const left = RequestDeadline::parse(frame);
+  ASSERT_TRUE(left.hasValue());
+  EXPECT_LE(*left, 5s);
+  EXPECT_GT(*left, 4s);
+
+  auto const passed = RequestDeadline::parse(RequestDeadline::frame(3, now));
+  ASSERT_TRUE(passed.hasValue());
+  EXPECT_EQ(0ms, *passed);
+
+  frame.extendedType_ = RequestDeadline::kExtendedType + 1;
+  EXPECT_FALSE(RequestDeadline::parse(frame).hasValue());
+}
+
+TEST(RequestDeadlineTest, Scope) {
+  EXPECT_FALSE(RequestDeadline::current().hasValue());
+  EXPECT_FALSE(RequestDeadline::expired());
+
+  auto const deadline = Clock::now() + 1h;
+  {
+    RequestDeadline::Scope outer(deadline);
+    EXPECT_EQ(deadline, RequestDeadline::current());
+    EXPECT_FALSE(RequestDeadline::expired());
+    {
+      RequestDeadline::Scope inner(Clock::now() - 1ms);
+      EXPECT_TRUE(RequestDeadline::expired());
+    }
+    EXPECT_EQ(deadline, RequestDeadline::current());
+  }
+  EXPECT_FALSE(RequestDeadline::current().hasValue());
+}
+
+TEST(RequestDeadlineTest, HandlerSeesDeadline) {
+  folly::ScopedEventBaseThread worker;
+  auto handler = std::make_shared<SlowHandler>();
+  auto server = makeServer(handler);
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+
+  auto const deadline = Clock::now() + 10s;
+  auto to = single::SingleTestObserver<Payload>::create();
+  client->getRequester()
+      ->withDeadline(deadline)
+      ->requestResponse(Payload("request"))
+      ->subscribe(to);
+  handler->called.wait();
+
+  ASSERT_TRUE(handler->deadline.hasValue());
+  EXPECT_LE(*handler->deadline, deadline + 1s);
+  EXPECT_GT(*handler->deadline, deadline - 1s);
+  to->cancel();
+}
+
+TEST(RequestDeadlineTest, StreamCancelledAtDeadline) {
+  folly::ScopedEventBaseThread worker;
+  auto handler = std::make_shared<SlowHandler>();
+  auto server = makeServer(handler);
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+
+  auto ts = flowable::TestSubscriber<Payload>::create();
+  client->getRequester()
+      ->withDeadline(Clock::now() + 100ms)
+      ->requestStream(Payload("request"))
+      ->subscribe(ts);
+
+  ts->awaitTerminalEvent();
+  ts->assertOnErrorMessage("Request deadline expired");
+  EXPECT_TRUE(handler->cancelled.try_wait_for(5s));
+  EXPECT_EQ(1, handler->calls);
+}
+
+TEST(RequestDeadlineTest, ExpiredRequestIsDropped) {
+  folly::ScopedEventBaseThread worker;
+  auto handler = std::make_shared<SlowHandler>();
+  auto stats = std::make_shared<DeadlineStats>();
+  auto server = makeServer(handler, stats);
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+
+  auto to = single::SingleTestObserver<Payload>::create();
+  client->getRequester()
+      ->withDeadline(Clock::now() - 1ms)
+      ->requestResponse(Payload("request"))
+      ->subscribe(to);
+
+  to->awaitTerminalEvent();
+  to->assertOnErrorMessage("Request deadline expired");
+  EXPECT_TRUE(stats->expiredBaton.try_wait_for(5s));
+  EXPECT_EQ(1, stats->expired);
+  EXPECT_EQ(0, handler->calls);
+}
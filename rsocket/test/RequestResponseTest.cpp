@@ -12,10 +12,14 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <folly/Portability.h>
 #include <folly/io/async/ScopedEventBaseThread.h>
 #include <folly/synchronization/Baton.h>
 #include <gtest/gtest.h>
 #include <thread>
+#if FOLLY_HAS_COROUTINES
+#include <folly/experimental/coro/BlockingWait.h>
+#endif
 
 #include "RSocketTests.h"
 #include "rsocket/test/test_utils/GenericRequestResponseHandler.h"
@@ -126,6 +130,21 @@ TEST(RequestResponseTest, Hello) {
   to->assertOnSuccessValue({"Hello, Jane Doe!", ":)"});
 }
 
+#if FOLLY_HAS_COROUTINES
+TEST(RequestResponseTest, HelloCoro) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeServer(std::make_shared<GenericRequestResponseHandler>(
+      [](StringPair const& request) {
+        return payload_response("Hello, " + request.first + "!", ":)");
+      }));
+
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  auto response = folly::coro::blockingWait(
+      client->getRequester()->requestResponseCo(Payload("Jane")));
+  EXPECT_EQ("Hello, Jane!", response.moveDataToString());
+}
+#endif
+
 TEST(RequestResponseTest, FailureInResponse) {
   folly::ScopedEventBaseThread worker;
   auto server = makeServer(std::make_shared<GenericRequestResponseHandler>(
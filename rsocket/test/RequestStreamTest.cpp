@@ -12,9 +12,13 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <folly/Portability.h>
 #include <folly/io/async/ScopedEventBaseThread.h>
 #include <gtest/gtest.h>
 #include <thread>
+#if FOLLY_HAS_COROUTINES
+#include <folly/experimental/coro/BlockingWait.h>
+#endif
 
 #include "RSocketTests.h"
 #include "yarpl/Flowable.h"
@@ -60,6 +64,31 @@ TEST(RequestStreamTest, HelloSync) {
   ts->assertValueAt(9, "Hello Bob 10!");
 }
 
+TEST(RequestStreamTest, HelloByteCredit) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeServer(std::make_shared<TestHandlerSync>());
+
+  // Room for about one payload at a time, so the stream only completes if
+  // the client keeps granting byte credit.
+  SetupParameters setup;
+  setup.byteCredit = 32;
+  auto client = RSocket::createConnectedClient(
+                    getConnFactory(
+                        worker.getEventBase(), *server->listeningPort()),
+                    std::move(setup))
+                    .get();
+
+  auto ts = TestSubscriber<std::string>::create();
+  client->getRequester()
+      ->requestStream(Payload("Bob"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(ts);
+  ts->awaitTerminalEvent();
+  ts->assertSuccess();
+  ts->assertValueCount(10);
+  ts->assertValueAt(9, "Hello Bob 10!");
+}
+
 TEST(RequestStreamTest, HelloFlowControl) {
   folly::ScopedEventBaseThread worker;
   auto server = makeServer(std::make_shared<TestHandlerSync>());
@@ -355,3 +384,50 @@ TEST(RequestStreamTest, MultiSubscribe) {
   ts->assertValueAt(0, "Hello Bob 1!");
   ts->assertValueAt(9, "Hello Bob 10!");
 }
+
+#if FOLLY_HAS_COROUTINES
+TEST(RequestStreamTest, HelloCoro) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeServer(std::make_shared<TestHandlerSync>());
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  auto requester = client->getRequester();
+
+  auto values = folly::coro::blockingWait(
+      [&]() -> folly::coro::Task<std::vector<std::string>> {
+        std::vector<std::string> values;
+        // A batch smaller than the stream, so that credits are granted more
+        // than once.
+        auto stream = requester->requestStreamCo(Payload("Bob"), 3);
+        while (auto item = co_await stream.next()) {
+          values.push_back(item->moveDataToString());
+        }
+        co_return values;
+      }());
+  ASSERT_EQ(10, values.size());
+  EXPECT_EQ("Hello Bob 1!", values[0]);
+  EXPECT_EQ("Hello Bob 10!", values[9]);
+}
+
+TEST(RequestStreamTest, CoroStopEarly) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeServer(std::make_shared<TestHandlerSync>());
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+  auto requester = client->getRequester();
+
+  auto first = folly::coro::blockingWait(
+      [&]() -> folly::coro::Task<std::string> {
+        auto stream = requester->requestStreamCo(Payload("Bob"));
+        auto item = co_await stream.next();
+        co_return item->moveDataToString();
+      }());
+  EXPECT_EQ("Hello Bob 1!", first);
+
+  // The connection is still usable after the stream was cancelled.
+  auto ts = TestSubscriber<std::string>::create();
+  requester->requestStream(Payload("Bob"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(ts);
+  ts->awaitTerminalEvent();
+  ts->assertValueCount(10);
+}
+#endif
@@ -0,0 +1,161 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <folly/Conv.h>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/io/async/EventBaseManager.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <folly/synchronization/Baton.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <limits>
+
+#include "RSocketTests.h"
+#include "rsocket/transports/tcp/TcpConnectionAcceptor.h"
+#include "yarpl/Flowable.h"
+#include "yarpl/Single.h"
+#include "yarpl/flowable/TestSubscriber.h"
+#include "yarpl/single/SingleTestObserver.h"
+
+using namespace yarpl;
+using namespace rsocket;
+using namespace rsocket::tests;
+using namespace rsocket::tests::client_server;
+
+namespace {
+
+bool onEventBaseThread() {
+  return folly::EventBaseManager::get()->getExistingEventBase() != nullptr;
+}
+
+class OffloadedHandler : public RSocketResponder {
+ public:
+  std::shared_ptr<single::Single<Payload>> handleRequestResponse(
+      Payload request,
+      StreamId) override {
+    if (onEventBaseThread()) {
+      ++callsOnEventBase;
+    }
+    return single::Single<Payload>::create(
+        [name = request.moveDataToString()](auto observer) {
+          observer->onSubscribe(single::SingleSubscriptions::empty());
+          observer->onSuccess(Payload("Hello, " + name + "!"));
+        });
+  }
+
+  std::shared_ptr<flowable::Flowable<Payload>> handleRequestStream(
+      Payload request,
+      StreamId) override {
+    if (onEventBaseThread()) {
+      ++callsOnEventBase;
+    }
+    return flowable::Flowable<>::range(1, 100)->map(
+        [this, name = request.moveDataToString()](int64_t v) {
+          if (onEventBaseThread()) {
+            ++callsOnEventBase;
+          }
+          return Payload(name + " " + folly::to<std::string>(v));
+        });
+  }
+
+  void handleFireAndForget(Payload, StreamId) override {
+    if (onEventBaseThread()) {
+      ++callsOnEventBase;
+    }
+    fireAndForgets.post();
+  }
+
+  std::atomic<size_t> callsOnEventBase{0};
+  folly::Baton<> fireAndForgets;
+};
+
+std::unique_ptr<RSocketServer> makeOffloadingServer(
+    std::shared_ptr<RSocketResponder> responder,
+    folly::Executor::KeepAlive<> executor) {
+  TcpConnectionAcceptor::Options opts;
+  opts.threads = 2;
+  opts.address = folly::SocketAddress("0.0.0.0", 0);
+
+  auto rs = RSocket::createServer(
+      std::make_unique<TcpConnectionAcceptor>(std::move(opts)));
+  rs->setResponderExecutor(std::move(executor));
+  rs->start([r = std::move(responder)](const SetupParameters&) { return r; });
+  return rs;
+}
+
+} // namespace
+
+class ResponderExecutorTest : public ::testing::Test {
+ protected:
+  folly::CPUThreadPoolExecutor pool_{4};
+  std::shared_ptr<OffloadedHandler> handler_{
+      std::make_shared<OffloadedHandler>()};
+};
+
+TEST_F(ResponderExecutorTest, RequestResponse) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeOffloadingServer(handler_, folly::getKeepAliveToken(pool_));
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+
+  auto to = single::SingleTestObserver<std::string>::create();
+  client->getRequester()
+      ->requestResponse(Payload("Jane"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(to);
+  to->awaitTerminalEvent();
+  to->assertOnSuccessValue("Hello, Jane!");
+  EXPECT_EQ(0, handler_->callsOnEventBase);
+}
+
+TEST_F(ResponderExecutorTest, RequestStreamKeepsOrder) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeOffloadingServer(handler_, folly::getKeepAliveToken(pool_));
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+
+  std::vector<std::shared_ptr<flowable::TestSubscriber<std::string>>> streams;
+  for (int i = 0; i < 8; ++i) {
+    auto ts = flowable::TestSubscriber<std::string>::create(7);
+    client->getRequester()
+        ->requestStream(Payload(folly::to<std::string>(i)))
+        ->map([](auto p) { return p.moveDataToString(); })
+        ->subscribe(ts);
+    streams.push_back(std::move(ts));
+  }
+
+  for (int i = 0; i < 8; ++i) {
+    auto& ts = streams[i];
+    ts->awaitValueCount(7);
+    ts->request(std::numeric_limits<int64_t>::max());
+    ts->awaitTerminalEvent();
+    ts->assertSuccess();
+    ts->assertValueCount(100);
+    for (int v = 0; v < 100; ++v) {
+      ts->assertValueAt(v, folly::to<std::string>(i, " ", v + 1));
+    }
+  }
+  EXPECT_EQ(0, handler_->callsOnEventBase);
+}
+
+TEST_F(ResponderExecutorTest, FireAndForget) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeOffloadingServer(handler_, folly::getKeepAliveToken(pool_));
+  auto client = makeClient(worker.getEventBase(), *server->listeningPort());
+
+  client->getRequester()
+      ->fireAndForget(Payload("Jane"))
+      ->subscribe(single::SingleObservers::create<void>());
+  handler_->fireAndForgets.wait();
+  EXPECT_EQ(0, handler_->callsOnEventBase);
+}
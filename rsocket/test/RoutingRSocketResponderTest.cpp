@@ -0,0 +1,227 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <string>
+
+#include "rsocket/RoutingRSocketResponder.h"
+#include "yarpl/flowable/Flowable.h"
+#include "yarpl/flowable/TestSubscriber.h"
+#include "yarpl/single/SingleTestObserver.h"
+#include "yarpl/single/Singles.h"
+
+using namespace rsocket;
+using namespace yarpl::flowable;
+using namespace yarpl::single;
+
+using MetadataFormat = RoutingRSocketResponder::MetadataFormat;
+
+namespace {
+
+std::string routingMetadata(const std::string& route) {
+  return std::string(1, static_cast<char>(route.size())) + route;
+}
+
+/// An entry of composite metadata, with the mime type already encoded.
+std::string compositeEntry(std::string mime, const std::string& metadata) {
+  mime += static_cast<char>(metadata.size() >> 16);
+  mime += static_cast<char>(metadata.size() >> 8);
+  mime += static_cast<char>(metadata.size());
+  return mime + metadata;
+}
+
+std::string compositeMetadata(const std::string& route) {
+  // A custom entry naming its mime type, then the well-known routing one.
+  return compositeEntry("\x09text/plain", "ignored") +
+      compositeEntry("\xFE", routingMetadata(route));
+}
+
+RoutingRSocketResponder::RequestResponseHandler respondWith(std::string data) {
+  return [data](Payload, StreamId) {
+    return Singles::just<Payload>(Payload(data));
+  };
+}
+
+std::string requestResponse(RSocketResponder& responder, Payload request) {
+  auto observer = SingleTestObserver<Payload>::create();
+  responder.handleRequestResponse(std::move(request), 1)->subscribe(observer);
+  if (observer->getException()) {
+    return "error";
+  }
+  return observer->getOnSuccessValue().moveDataToString();
+}
+
+class CountingStats : public RSocketStats {
+ public:
+  void requestUnrouted() override {
+    ++unrouted;
+  }
+
+  size_t unrouted{0};
+};
+
+} // namespace
+
+TEST(RoutingRSocketResponderTest, ParsesRoutes) {
+  auto const parse = [](const std::string& metadata, MetadataFormat format) {
+    auto buf = folly::IOBuf::copyBuffer(metadata);
+    auto route = RoutingRSocketResponder::parseRoute(*buf, format);
+    return route ? route->str() : "none";
+  };
+
+  EXPECT_EQ("a.b", parse(compositeMetadata("a.b"), MetadataFormat::Composite));
+  EXPECT_EQ(
+      "a.b",
+      parse(
+          compositeEntry("\xFE", routingMetadata("a.b") + "\x01" "c"),
+          MetadataFormat::Composite));
+  EXPECT_EQ("a.b", parse(routingMetadata("a.b"), MetadataFormat::Routing));
+  EXPECT_EQ("a.b", parse("a.b", MetadataFormat::Raw));
+
+  // Truncated or missing routes.
+  EXPECT_EQ("none", parse("", MetadataFormat::Raw));
+  EXPECT_EQ("none", parse("", MetadataFormat::Routing));
+  EXPECT_EQ("none", parse("\x05" "ab", MetadataFormat::Routing));
+  auto const composite = compositeMetadata("a.b");
+  EXPECT_EQ(
+      "none",
+      parse(
+          composite.substr(0, composite.size() - 1),
+          MetadataFormat::Composite));
+  EXPECT_EQ(
+      "none",
+      parse(compositeEntry("\x81", "a.b"), MetadataFormat::Composite));
+}
+
+TEST(RoutingRSocketResponderTest, DispatchesByRoute) {
+  RoutingRSocketResponder::Routes routes;
+  routes.requestResponse("a", respondWith("A"))
+      .requestResponse("b", respondWith("B"))
+      .requestStream("a", [](Payload, StreamId) {
+        return Flowable<Payload>::justOnce(Payload("1"));
+      });
+  RoutingRSocketResponder responder{std::move(routes)};
+
+  auto const request = [](const std::string& route) {
+    return Payload("", compositeMetadata(route));
+  };
+  EXPECT_EQ("A", requestResponse(responder, request("a")));
+  EXPECT_EQ("B", requestResponse(responder, request("b")));
+  EXPECT_EQ("A", requestResponse(responder, request("a")));
+
+  auto subscriber = TestSubscriber<Payload>::create();
+  responder.handleRequestStream(Payload("", compositeMetadata("a")), 1)
+      ->subscribe(subscriber);
+  subscriber->awaitTerminalEvent();
+  subscriber->assertValueCount(1);
+
+  std::map<std::string, uint64_t> counts;
+  responder.forEachRoute([&](folly::StringPiece route, uint64_t requests) {
+    counts[route.str()] = requests;
+  });
+  EXPECT_EQ((std::map<std::string, uint64_t>{{"a", 3}, {"b", 1}}), counts);
+  EXPECT_EQ(0, responder.unrouted());
+}
+
+TEST(RoutingRSocketResponderTest, UnroutedRequests) {
+  RoutingRSocketResponder::Routes routes;
+  routes.requestResponse("a", respondWith("A"));
+  auto stats = std::make_shared<CountingStats>();
+  RoutingRSocketResponder responder{
+      std::move(routes), MetadataFormat::Raw, nullptr, stats};
+
+  EXPECT_EQ("error", requestResponse(responder, Payload("", "b")));
+  EXPECT_EQ("error", requestResponse(responder, Payload("data")));
+
+  // The route exists, but it doesn't take streams.
+  auto subscriber = TestSubscriber<Payload>::create();
+  responder.handleRequestStream(Payload("", "a"), 1)->subscribe(subscriber);
+  subscriber->assertOnErrorMessage("No route for request");
+
+  EXPECT_EQ(3, responder.unrouted());
+  EXPECT_EQ(3, stats->unrouted);
+}
+
+TEST(RoutingRSocketResponderTest, FallsBack) {
+  class Fallback : public RSocketResponder {
+   public:
+    std::shared_ptr<Single<Payload>> handleRequestResponse(Payload, StreamId)
+        override {
+      return Singles::just<Payload>(Payload("fallback"));
+    }
+  };
+
+  RoutingRSocketResponder::Routes routes;
+  routes.requestResponse("a", respondWith("A"));
+  RoutingRSocketResponder responder{std::move(routes),
+                                    MetadataFormat::Routing,
+                                    std::make_shared<Fallback>()};
+
+  EXPECT_EQ("A", requestResponse(responder, Payload("", routingMetadata("a"))));
+  EXPECT_EQ(
+      "fallback",
+      requestResponse(responder, Payload("", routingMetadata("b"))));
+  EXPECT_EQ(1, responder.unrouted());
+}
+
+TEST(RoutingRSocketResponderTest, ManyRoutes) {
+  constexpr int kRoutes = 5000;
+  RoutingRSocketResponder::Routes routes;
+  for (int i = 0; i < kRoutes; ++i) {
+    routes.requestResponse(
+        "service.method" + std::to_string(i), respondWith(std::to_string(i)));
+  }
+  RoutingRSocketResponder responder{std::move(routes), MetadataFormat::Raw};
+
+  for (int i = 0; i < kRoutes; ++i) {
+    EXPECT_EQ(
+        std::to_string(i),
+        requestResponse(
+            responder, Payload("", "service.method" + std::to_string(i))));
+  }
+  EXPECT_EQ(
+      "error",
+      requestResponse(
+          responder, Payload("", "service.method" + std::to_string(kRoutes))));
+}
+
+TEST(RoutingRSocketResponderTest, ChainedMetadata) {
+  RoutingRSocketResponder::Routes routes;
+  routes.requestResponse("route", respondWith("A"));
+  RoutingRSocketResponder responder{std::move(routes), MetadataFormat::Raw};
+
+  auto metadata = folly::IOBuf::copyBuffer("ro");
+  metadata->prependChain(folly::IOBuf::copyBuffer("ute"));
+  EXPECT_EQ(
+      "A",
+      requestResponse(
+          responder, Payload(folly::IOBuf::create(0), std::move(metadata))));
+}
+
+TEST(RoutingRSocketResponderTest, ChainedCompositeMetadata) {
+  RoutingRSocketResponder::Routes routes;
+  routes.requestResponse("route", respondWith("A"));
+  RoutingRSocketResponder responder{std::move(routes)};
+
+  // The route straddles the two buffers.
+  auto const composite = compositeMetadata("route");
+  auto metadata = folly::IOBuf::copyBuffer(composite.substr(0, 28));
+  metadata->prependChain(folly::IOBuf::copyBuffer(composite.substr(28)));
+  EXPECT_EQ(
+      "A",
+      requestResponse(
+          responder, Payload(folly::IOBuf::create(0), std::move(metadata))));
+}
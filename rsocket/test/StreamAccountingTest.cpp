@@ -0,0 +1,71 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "rsocket/CompositeMetadata.h"
+#include "rsocket/StreamAccounting.h"
+
+using namespace rsocket;
+using namespace std::chrono_literals;
+
+TEST(StreamAccountingTest, KeysByRoute) {
+  StreamAccounting accounting;
+  auto const metadata =
+      CompositeMetadataBuilder().addRouting({"route", "tag"}).build();
+  Payload request{folly::IOBuf::copyBuffer("data"), metadata->clone()};
+  EXPECT_EQ("route", accounting.keyOf(StreamType::STREAM, request));
+  EXPECT_EQ("", accounting.keyOf(StreamType::STREAM, Payload{"data"}));
+
+  auto const raw = StreamAccounting::byRoute(
+      RoutingRSocketResponder::MetadataFormat::Raw);
+  EXPECT_EQ("route", raw(StreamType::FNF, Payload{"data", "route"}));
+}
+
+TEST(StreamAccountingTest, SumsUsagePerKey) {
+  StreamAccounting accounting;
+  StreamAccounting::Usage usage;
+  usage.streams = 1;
+  usage.bytesIn = 10;
+  usage.bytesOut = 20;
+  usage.handlerTime = 5us;
+  accounting.add("a", usage);
+  accounting.add("a", usage);
+  accounting.add("b", usage);
+
+  auto snapshot = accounting.snapshot();
+  ASSERT_EQ(2, snapshot.size());
+  EXPECT_EQ(2, snapshot["a"].streams);
+  EXPECT_EQ(20, snapshot["a"].bytesIn);
+  EXPECT_EQ(40, snapshot["a"].bytesOut);
+  EXPECT_EQ(10us, snapshot["a"].handlerTime);
+  EXPECT_EQ(1, snapshot["b"].streams);
+}
+
+TEST(StreamAccountingTest, SumsThreads) {
+  StreamAccounting accounting;
+  StreamAccounting::Usage usage;
+  usage.streams = 1;
+  usage.bytesIn = 1;
+
+  accounting.add("route", usage);
+  std::thread([&] { accounting.add("route", usage); }).join();
+
+  // The usage of the exited thread is kept.
+  auto snapshot = accounting.snapshot();
+  EXPECT_EQ(2, snapshot["route"].streams);
+  EXPECT_EQ(2, snapshot["route"].bytesIn);
+}
@@ -0,0 +1,128 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include "rsocket/TenantQuotas.h"
+
+using namespace rsocket;
+using namespace std::chrono_literals;
+
+using Quota = TenantQuotas::Quota;
+
+TEST(TenantQuotasTest, LimitsConnections) {
+  Quota quota;
+  quota.maxConnections = 2;
+  TenantQuotas::Bucket bucket("tenant", quota);
+
+  EXPECT_TRUE(bucket.tryOpenConnection());
+  EXPECT_TRUE(bucket.tryOpenConnection());
+  EXPECT_FALSE(bucket.tryOpenConnection());
+  EXPECT_EQ(2, bucket.connections());
+
+  bucket.closeConnection();
+  EXPECT_TRUE(bucket.tryOpenConnection());
+}
+
+TEST(TenantQuotasTest, LimitsStreams) {
+  Quota quota;
+  quota.maxActiveStreams = 1;
+  TenantQuotas::Bucket bucket("tenant", quota);
+
+  EXPECT_TRUE(bucket.tryOpenStream());
+  EXPECT_FALSE(bucket.tryOpenStream());
+
+  // Fire-and-forget requests are counted past the limit.
+  bucket.openStream();
+  EXPECT_EQ(2, bucket.activeStreams());
+
+  bucket.closeStreams(2);
+  EXPECT_EQ(0, bucket.activeStreams());
+  EXPECT_TRUE(bucket.tryOpenStream());
+}
+
+TEST(TenantQuotasTest, NoLimits) {
+  TenantQuotas::Bucket bucket("tenant", Quota());
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_TRUE(bucket.tryOpenConnection());
+    EXPECT_TRUE(bucket.tryOpenStream());
+  }
+  bucket.bytesRead(size_t{1} << 40);
+  EXPECT_TRUE(bucket.withinByteRate());
+  EXPECT_EQ(nullptr, bucket.resumeBufferBudget());
+}
+
+TEST(TenantQuotasTest, LimitsByteRate) {
+  Quota quota;
+  quota.maxBytesPerSecond = 1000;
+  quota.burstBytes = 500;
+  TenantQuotas::Bucket bucket("tenant", quota);
+  auto const now = TenantQuotas::Clock::now();
+
+  // The burst is spent at once.
+  bucket.bytesRead(500, now);
+  EXPECT_TRUE(bucket.withinByteRate(now));
+  bucket.bytesRead(100, now);
+  EXPECT_FALSE(bucket.withinByteRate(now));
+
+  // And comes back at the rate.
+  EXPECT_FALSE(bucket.withinByteRate(now + 50ms));
+  EXPECT_TRUE(bucket.withinByteRate(now + 100ms));
+
+  // Idle time doesn't grow the burst past its size.
+  auto const later = now + 10s;
+  bucket.bytesRead(500, later);
+  EXPECT_TRUE(bucket.withinByteRate(later));
+  bucket.bytesRead(1, later);
+  EXPECT_FALSE(bucket.withinByteRate(later));
+}
+
+TEST(TenantQuotasTest, BucketPerTenant) {
+  Quota defaultQuota;
+  defaultQuota.maxConnections = 1;
+  TenantQuotas quotas(
+      [](const SetupParameters& params) {
+        return params.payload.cloneMetadataToString();
+      },
+      defaultQuota);
+
+  Quota quota;
+  quota.maxConnections = 10;
+  quota.maxResumeBufferBytes = 1024;
+  quotas.setQuota("big", quota);
+
+  auto const setup = [](std::string tenant) {
+    SetupParameters params;
+    params.payload = Payload("", tenant);
+    return params;
+  };
+
+  auto small = quotas.bucketFor(setup("small"));
+  EXPECT_EQ("small", small->tenant());
+  EXPECT_EQ(1, small->quota().maxConnections);
+  EXPECT_EQ(small, quotas.bucketFor(setup("small")));
+  EXPECT_EQ(nullptr, small->resumeBufferBudget());
+
+  auto big = quotas.bucketFor(setup("big"));
+  EXPECT_NE(small, big);
+  EXPECT_EQ(10, big->quota().maxConnections);
+  ASSERT_NE(nullptr, big->resumeBufferBudget());
+  EXPECT_EQ(1024, big->resumeBufferBudget()->limit());
+
+  // Changing the quota starts a new bucket.
+  quota.maxConnections = 20;
+  quotas.setQuota("big", quota);
+  EXPECT_NE(big, quotas.bucket("big"));
+  EXPECT_EQ(20, quotas.bucket("big")->quota().maxConnections);
+}
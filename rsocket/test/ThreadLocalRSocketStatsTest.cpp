@@ -0,0 +1,194 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "rsocket/ThreadLocalRSocketStats.h"
+
+using namespace rsocket;
+using namespace std::chrono_literals;
+
+using Counter = ThreadLocalRSocketStats::Counter;
+
+TEST(ThreadLocalRSocketStatsTest, CountsEvents) {
+  ThreadLocalRSocketStats stats;
+  stats.socketCreated();
+  stats.bytesWritten(100);
+  stats.bytesWritten(20);
+  stats.frameWritten(FrameType::PAYLOAD);
+  stats.frameWritten(FrameType::PAYLOAD);
+  stats.frameRead(FrameType::REQUEST_N);
+  stats.streamStateMachineAllocated(true);
+  stats.serverResume(folly::none, 0, 0, RSocketStats::ResumeOutcome::FAILURE);
+  stats.serverResume(10, 500, 80, RSocketStats::ResumeOutcome::SUCCESS);
+
+  auto const snapshot = stats.snapshot();
+  EXPECT_EQ(1, snapshot[Counter::SOCKETS_CREATED]);
+  EXPECT_EQ(0, snapshot[Counter::SOCKETS_CLOSED]);
+  EXPECT_EQ(120, snapshot[Counter::BYTES_WRITTEN]);
+  EXPECT_EQ(2, snapshot[Counter::FRAMES_WRITTEN]);
+  EXPECT_EQ(2, snapshot.framesWritten(FrameType::PAYLOAD));
+  EXPECT_EQ(0, snapshot.framesWritten(FrameType::REQUEST_N));
+  EXPECT_EQ(1, snapshot.framesRead(FrameType::REQUEST_N));
+  EXPECT_EQ(1, snapshot[Counter::STREAM_STATE_MACHINES_POOLED]);
+  EXPECT_EQ(0, snapshot[Counter::STREAM_STATE_MACHINES_ALLOCATED]);
+  EXPECT_EQ(1, snapshot[Counter::RESUMES_FAILED]);
+  EXPECT_EQ(1, snapshot[Counter::RESUMES_SUCCEEDED]);
+  EXPECT_EQ(80, snapshot[Counter::RESUME_BYTES_REPLAYED]);
+}
+
+TEST(ThreadLocalRSocketStatsTest, CountsColdResumptions) {
+  ThreadLocalRSocketStats stats;
+  stats.coldResumeStreamsRestored(3, 250us);
+  stats.coldResumeStreamsRestored(1, 50us);
+
+  auto const snapshot = stats.snapshot();
+  EXPECT_EQ(2, snapshot[Counter::COLD_RESUMES]);
+  EXPECT_EQ(4, snapshot[Counter::COLD_RESUME_STREAMS_RESTORED]);
+  EXPECT_EQ(300, snapshot[Counter::COLD_RESUME_MICROS]);
+}
+
+TEST(ThreadLocalRSocketStatsTest, CountsEventBaseInstrumentation) {
+  ThreadLocalRSocketStats stats;
+  stats.eventBaseLoopLag(nullptr, 100us, 7);
+  stats.eventBaseLoopLag(nullptr, 20us, 3);
+  stats.eventBaseActivity(
+      nullptr, RSocketStats::EventBaseActivity::READ, 10us);
+  stats.eventBaseActivity(
+      nullptr, RSocketStats::EventBaseActivity::RESPONDER, 40us);
+  stats.eventBaseActivity(
+      nullptr, RSocketStats::EventBaseActivity::RESPONDER, 2us);
+
+  auto snapshot = stats.snapshot();
+  EXPECT_EQ(2, snapshot[Counter::EVENT_BASE_LAG_SAMPLES]);
+  EXPECT_EQ(120, snapshot[Counter::EVENT_BASE_LAG_MICROS]);
+  EXPECT_EQ(10, snapshot[Counter::EVENT_BASE_READ_MICROS]);
+  EXPECT_EQ(42, snapshot[Counter::EVENT_BASE_RESPONDER_MICROS]);
+  EXPECT_EQ(0, snapshot[Counter::EVENT_BASE_WRITE_MICROS]);
+
+  // The latest depth of each thread, for the threads still running.
+  EXPECT_EQ(3, snapshot.eventBaseQueueDepth);
+  std::thread([&] { stats.eventBaseLoopLag(nullptr, 1us, 5); }).join();
+  snapshot = stats.snapshot();
+  EXPECT_EQ(3, snapshot.eventBaseQueueDepth);
+  EXPECT_EQ(3, snapshot[Counter::EVENT_BASE_LAG_SAMPLES]);
+}
+
+TEST(ThreadLocalRSocketStatsTest, CountsReconnects) {
+  ThreadLocalRSocketStats stats;
+  stats.reconnectAttempted();
+  stats.reconnectAttempted();
+  stats.reconnectAttempted();
+  stats.reconnected(1500us, 2);
+  stats.reconnected(500us, 1);
+
+  auto const snapshot = stats.snapshot();
+  EXPECT_EQ(3, snapshot[Counter::RECONNECT_ATTEMPTS]);
+  EXPECT_EQ(2, snapshot[Counter::RECONNECTS]);
+  EXPECT_EQ(3, snapshot[Counter::RECONNECT_ROUNDS]);
+  EXPECT_EQ(2000, snapshot[Counter::RECONNECT_DOWNTIME_MICROS]);
+}
+
+TEST(ThreadLocalRSocketStatsTest, TracksMemoryPressure) {
+  ThreadLocalRSocketStats stats;
+  EXPECT_EQ(
+      RSocketStats::MemoryPressure::NONE, stats.snapshot().memoryPressure);
+
+  stats.memoryPressureChanged(RSocketStats::MemoryPressure::HIGH, 2000);
+  stats.requestRejectedMemoryPressure();
+  std::thread([&] {
+    stats.memoryPressureChanged(RSocketStats::MemoryPressure::ELEVATED, 1500);
+  }).join();
+
+  auto const snapshot = stats.snapshot();
+  EXPECT_EQ(2, snapshot[Counter::MEMORY_PRESSURE_CHANGES]);
+  EXPECT_EQ(1, snapshot[Counter::REQUESTS_REJECTED_MEMORY_PRESSURE]);
+  EXPECT_EQ(RSocketStats::MemoryPressure::ELEVATED, snapshot.memoryPressure);
+  EXPECT_EQ(1500, snapshot.memoryPressureBytes);
+}
+
+TEST(ThreadLocalRSocketStatsTest, TracksBuffers) {
+  ThreadLocalRSocketStats stats;
+  stats.resumeBufferChanged(3, 300);
+  stats.resumeBufferChanged(-1, -100);
+  stats.streamBufferChanged(3, 80);
+  stats.streamBufferChanged(-1, -30);
+
+  auto const snapshot = stats.snapshot();
+  EXPECT_EQ(2, snapshot.resumeBufferFrames);
+  EXPECT_EQ(200, snapshot.resumeBufferBytes);
+  EXPECT_EQ(2, snapshot.streamBufferFrames);
+  EXPECT_EQ(50, snapshot.streamBufferBytes);
+
+  // Everything buffered so far, including what was flushed since.
+  EXPECT_EQ(3, snapshot[Counter::STREAM_FRAMES_BUFFERED]);
+  EXPECT_EQ(80, snapshot[Counter::STREAM_BYTES_BUFFERED]);
+}
+
+TEST(ThreadLocalRSocketStatsTest, TimesStreams) {
+  ThreadLocalRSocketStats stats;
+  stats.streamOpened(StreamType::REQUEST_RESPONSE);
+  stats.streamFirstPayload(StreamType::REQUEST_RESPONSE, 100us);
+  stats.streamClosed(StreamType::REQUEST_RESPONSE, 120us, 64);
+  stats.streamOpened(StreamType::STREAM);
+
+  auto const snapshot = stats.snapshot();
+  EXPECT_EQ(2, snapshot[Counter::STREAMS_OPENED]);
+  EXPECT_EQ(1, snapshot[Counter::STREAMS_CLOSED]);
+  EXPECT_EQ(64, snapshot[Counter::STREAM_BYTES]);
+
+  auto const& latency =
+      snapshot.firstPayloadLatency(StreamType::REQUEST_RESPONSE);
+  EXPECT_EQ(1, latency.count);
+  EXPECT_EQ(100, latency.max);
+  EXPECT_EQ(120, snapshot.streamDuration(StreamType::REQUEST_RESPONSE).max);
+  EXPECT_EQ(0, snapshot.firstPayloadLatency(StreamType::STREAM).count);
+}
+
+TEST(ThreadLocalRSocketStatsTest, SumsThreads) {
+  ThreadLocalRSocketStats stats;
+  stats.keepaliveSent();
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&] {
+      for (int j = 0; j < 1000; ++j) {
+        stats.keepaliveSent();
+        stats.frameRead(FrameType::KEEPALIVE);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // The threads exited, their counts were kept.
+  auto const snapshot = stats.snapshot();
+  EXPECT_EQ(4001, snapshot[Counter::KEEPALIVES_SENT]);
+  EXPECT_EQ(4000, snapshot.framesRead(FrameType::KEEPALIVE));
+}
+
+TEST(ThreadLocalRSocketStatsTest, NamesCounters) {
+  EXPECT_EQ(
+      "SOCKETS_CREATED",
+      ThreadLocalRSocketStats::toString(Counter::SOCKETS_CREATED));
+  EXPECT_EQ(
+      "HEDGES_WON", ThreadLocalRSocketStats::toString(Counter::HEDGES_WON));
+  EXPECT_EQ(
+      "RECONNECTS_ABANDONED",
+      ThreadLocalRSocketStats::toString(Counter::RECONNECTS_ABANDONED));
+}
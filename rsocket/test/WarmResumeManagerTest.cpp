@@ -16,6 +16,7 @@
 #include <folly/io/IOBuf.h>
 #include <gmock/gmock.h>
 
+#include "rsocket/ResumeStateHandoff.h"
 #include "rsocket/framing/Frame.h"
 #include "rsocket/framing/FrameSerializer.h"
 #include "rsocket/framing/FrameTransportImpl.h"
@@ -157,6 +158,78 @@ TEST_F(WarmResumeManagerTest, TwoFrames) {
   cache.sendFramesFromPosition(frame1Size, transport);
 }
 
+TEST_F(WarmResumeManagerTest, SendFramesUpTo) {
+  WarmResumeManager cache(RSocketStats::noop());
+  FrameTransportMock transport;
+
+  auto frame = frameSerializer_->serializeOut(Frame_REQUEST_N(0, 2));
+  const auto frameSize = frame->computeChainDataLength();
+  for (int i = 0; i < 3; ++i) {
+    cache.trackSentFrame(*frame, FrameType::REQUEST_N, 1, 0);
+  }
+
+  // Stops at the first frame boundary past the bound.
+  EXPECT_CALL(transport, outputFrameOrDrop_(_)).Times(2);
+  EXPECT_EQ(
+      (ResumePosition)(2 * frameSize),
+      cache.sendFramesFromPositionUpTo(0, transport, frameSize + 1));
+  Mock::VerifyAndClearExpectations(&transport);
+
+  // Sends at least one frame.
+  EXPECT_CALL(transport, outputFrameOrDrop_(_)).Times(1);
+  EXPECT_EQ(
+      cache.lastSentPosition(),
+      cache.sendFramesFromPositionUpTo(2 * frameSize, transport, 1));
+  Mock::VerifyAndClearExpectations(&transport);
+
+  EXPECT_CALL(transport, outputFrameOrDrop_(_)).Times(0);
+  EXPECT_EQ(
+      cache.lastSentPosition(),
+      cache.sendFramesFromPositionUpTo(cache.lastSentPosition(), transport, 1));
+}
+
+TEST_F(WarmResumeManagerTest, RestoreHandedOffState) {
+  auto frame = frameSerializer_->serializeOut(Frame_REQUEST_N(1, 2));
+  const auto frameSize =
+      static_cast<ResumePosition>(frame->computeChainDataLength());
+
+  ResumeHandoffState state;
+  state.protocolVersion = ProtocolVersion::Latest;
+  state.dataMimeType = "application/json";
+  state.impliedPosition = 42;
+  state.firstSentPosition = 100;
+  state.nextStreamId = 8;
+  state.openStreams = {1, 4};
+  state.frames.push_back(frame->clone());
+  state.frames.push_back(frame->clone());
+
+  auto restored = ResumeHandoffState::deserialize(*state.serialize());
+  EXPECT_EQ(ProtocolVersion::Latest, restored.protocolVersion);
+  EXPECT_EQ("application/json", restored.dataMimeType);
+  EXPECT_EQ(8, restored.nextStreamId);
+  EXPECT_EQ((std::vector<StreamId>{1, 4}), restored.openStreams);
+  ASSERT_EQ(2, restored.frames.size());
+  EXPECT_TRUE(folly::IOBufEqualTo()(*frame, *restored.frames[1]));
+
+  auto truncated = state.serialize();
+  truncated->coalesce();
+  truncated->trimEnd(1);
+  EXPECT_THROW(
+      ResumeHandoffState::deserialize(*truncated), std::runtime_error);
+
+  WarmResumeManager cache(RSocketStats::noop());
+  cache.restore(
+      restored.firstSentPosition, restored.impliedPosition, restored.frames);
+  EXPECT_EQ(42, cache.impliedPosition());
+  EXPECT_EQ(100, cache.firstSentPosition());
+  EXPECT_EQ(100 + 2 * frameSize, cache.lastSentPosition());
+  EXPECT_TRUE(cache.isPositionAvailable(100 + frameSize));
+
+  FrameTransportMock transport;
+  EXPECT_CALL(transport, outputFrameOrDrop_(_)).Times(2);
+  cache.sendFramesFromPosition(100, transport);
+}
+
 TEST_F(WarmResumeManagerTest, Stats) {
   auto stats = std::make_shared<StrictMock<MockStats>>();
   WarmResumeManager cache(stats);
@@ -344,3 +417,30 @@ TEST_F(WarmResumeManagerTest, PositionLargeFrame) {
       frame->computeChainDataLength(),
       static_cast<size_t>(cache.lastSentPosition()));
 }
+
+TEST_F(WarmResumeManagerTest, CappedUnderMemoryPressure) {
+  auto frame = frameSerializer_->serializeOut(Frame_REQUEST_N(0, 2));
+  const auto frameSize = frame->computeChainDataLength();
+
+  MemoryPressureController::Options options;
+  options.highBytes = 1000;
+  options.highResumeBufferBytes = 2 * frameSize;
+  auto controller = std::make_shared<MemoryPressureController>(options);
+
+  WarmResumeManager cache(RSocketStats::noop());
+  cache.setMemoryPressure(controller);
+  for (int i = 0; i < 4; ++i) {
+    cache.trackSentFrame(*frame, FrameType::REQUEST_N, 1, 0);
+  }
+  EXPECT_EQ(4 * frameSize, cache.size());
+
+  // Only the newest frames within the cap are kept from now on.
+  controller->sample(1000);
+  cache.trackSentFrame(*frame, FrameType::REQUEST_N, 1, 0);
+  EXPECT_EQ(2 * frameSize, cache.size());
+  EXPECT_EQ((ResumePosition)(3 * frameSize), cache.firstSentPosition());
+
+  controller->sample(0);
+  cache.trackSentFrame(*frame, FrameType::REQUEST_N, 1, 0);
+  EXPECT_EQ(3 * frameSize, cache.size());
+}
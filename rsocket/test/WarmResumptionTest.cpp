@@ -12,12 +12,18 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <folly/io/async/EventBaseManager.h>
 #include <folly/io/async/ScopedEventBaseThread.h>
 #include <gtest/gtest.h>
+#include <atomic>
 #include <thread>
 
 #include "RSocketTests.h"
 
+#include "rsocket/ResumeStateHandoff.h"
+#include "rsocket/transports/tcp/TcpConnectionAcceptor.h"
+#include "rsocket/transports/tcp/TcpConnectionFactory.h"
+
 #include "rsocket/test/handlers/HelloServiceHandler.h"
 #include "rsocket/test/handlers/HelloStreamRequestHandler.h"
 
@@ -52,6 +58,164 @@ TEST(WarmResumptionTest, SuccessfulResumption) {
   ts->assertValueCount(10);
 }
 
+TEST(WarmResumptionTest, ResumptionThroughServerIndex) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeResumableServer(RSocketServiceHandler::create(
+      [](const SetupParameters&) {
+        return std::make_shared<HelloStreamRequestHandler>();
+      },
+      true /* resumable */));
+  auto client =
+      makeWarmResumableClient(worker.getEventBase(), *server->listeningPort());
+  auto ts = TestSubscriber<std::string>::create(7 /* initialRequestN */);
+  client->getRequester()
+      ->requestStream(Payload("Bob"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(ts);
+  // Wait for a few frames before disconnecting.
+  while (ts->getValueCount() < 3) {
+    std::this_thread::yield();
+  }
+  auto result =
+      client->disconnect(std::runtime_error("Test triggered disconnect"))
+          .thenValue([&](auto&&) { return client->resume(); });
+  EXPECT_NO_THROW(std::move(result).get());
+  ts->request(3);
+  ts->awaitTerminalEvent();
+  ts->assertSuccess();
+  ts->assertValueCount(10);
+}
+
+TEST(WarmResumptionTest, NonResumableStreamEndsOnDisconnect) {
+  folly::ScopedEventBaseThread worker;
+  auto server = makeResumableServer(std::make_shared<HelloServiceHandler>());
+  auto client =
+      makeWarmResumableClient(worker.getEventBase(), *server->listeningPort());
+  auto ts = TestSubscriber<std::string>::create(7 /* initialRequestN */);
+  client->getRequester()
+      ->requestStream(Payload("Bob"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(ts);
+  auto untrackedTs =
+      TestSubscriber<std::string>::create(7 /* initialRequestN */);
+  client->getRequester()
+      ->withoutResumption()
+      ->requestStream(Payload("Alice"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(untrackedTs);
+  // Wait for a few frames before disconnecting.
+  while (ts->getValueCount() < 3 || untrackedTs->getValueCount() < 3) {
+    std::this_thread::yield();
+  }
+  auto result =
+      client->disconnect(std::runtime_error("Test triggered disconnect"))
+          .thenValue([&](auto&&) { return client->resume(); });
+  EXPECT_NO_THROW(std::move(result).get());
+
+  untrackedTs->awaitTerminalEvent();
+  EXPECT_TRUE(untrackedTs->isError());
+
+  // The positions of both sides leave out the frames of the other stream, so
+  // this one picks up where it left off.
+  ts->request(3);
+  ts->awaitTerminalEvent();
+  ts->assertSuccess();
+  ts->assertValueCount(10);
+}
+
+namespace {
+/// Connects to the first server, and resumes on the second one.
+class MovingConnectionFactory : public ConnectionFactory {
+ public:
+  MovingConnectionFactory(
+      folly::EventBase& eventBase,
+      uint16_t firstPort,
+      uint16_t secondPort)
+      : first_(eventBase, folly::SocketAddress("127.0.0.1", firstPort)),
+        second_(eventBase, folly::SocketAddress("127.0.0.1", secondPort)) {}
+
+  folly::Future<ConnectedDuplexConnection> connect(
+      ProtocolVersion version,
+      ResumeStatus resume) override {
+    return resume == ResumeStatus::RESUMING ? second_.connect(version, resume)
+                                            : first_.connect(version, resume);
+  }
+
+ private:
+  TcpConnectionFactory first_;
+  TcpConnectionFactory second_;
+};
+
+std::unique_ptr<RSocketServer> makeHandoffServer(
+    std::shared_ptr<ResumeStateHandoff> handoff) {
+  TcpConnectionAcceptor::Options opts;
+  opts.threads = 2;
+  opts.address = folly::SocketAddress("0.0.0.0", 0);
+  auto server = RSocket::createServer(
+      std::make_unique<TcpConnectionAcceptor>(std::move(opts)));
+  server->setResumeStateHandoff(std::move(handoff));
+  server->start(RSocketServiceHandler::create(
+      [](const SetupParameters&) {
+        return std::make_shared<HelloStreamRequestHandler>();
+      },
+      true /* resumable */));
+  return server;
+}
+} // namespace
+
+TEST(WarmResumptionTest, ResumeOnAnotherServer) {
+  folly::ScopedEventBaseThread worker;
+  auto handoff = std::make_shared<InMemoryResumeStateHandoff>();
+  auto first = makeHandoffServer(handoff);
+  auto second = makeHandoffServer(handoff);
+
+  SetupParameters setupParameters;
+  setupParameters.resumable = true;
+  auto client = RSocket::createConnectedClient(
+                    std::make_unique<MovingConnectionFactory>(
+                        *worker.getEventBase(),
+                        *first->listeningPort(),
+                        *second->listeningPort()),
+                    std::move(setupParameters),
+                    std::make_shared<RSocketResponder>(),
+                    kDefaultKeepaliveInterval,
+                    RSocketStats::noop(),
+                    nullptr,
+                    std::make_shared<WarmResumeManager>(RSocketStats::noop()))
+                    .get();
+
+  auto ts = TestSubscriber<std::string>::create(3 /* initialRequestN */);
+  client->getRequester()
+      ->requestStream(Payload("Bob"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(ts);
+  while (ts->getValueCount() < 3) {
+    std::this_thread::yield();
+  }
+
+  client->disconnect(std::runtime_error("Test triggered disconnect")).get();
+  RSocketServer::DrainOptions options;
+  options.timeout = std::chrono::milliseconds{50};
+  first->drainAndWait(std::move(options));
+
+  EXPECT_NO_THROW(client->resume().get());
+
+  // The stream was served by the first server, so it can't carry on.
+  ts->awaitTerminalEvent();
+  EXPECT_TRUE(ts->isError());
+  ts->assertValueCount(3);
+
+  auto resumedTs = TestSubscriber<std::string>::create(10);
+  client->getRequester()
+      ->requestStream(Payload("Alice"))
+      ->map([](auto p) { return p.moveDataToString(); })
+      ->subscribe(resumedTs);
+  resumedTs->awaitTerminalEvent();
+  resumedTs->assertSuccess();
+  resumedTs->assertValueCount(10);
+  EXPECT_EQ(1, second->getNumConnections());
+}
+
 // Verify after resumption the client is able to consume stream
 // from within onError() context
 TEST(WarmResumptionTest, FailedResumption1) {
@@ -171,3 +335,42 @@ TEST(WarmResumptionTest, DifferentEvb) {
   ts->assertSuccess();
   ts->assertValueCount(10);
 }
+
+// Verify that the client moves its stateMachine onto the EventBase of the
+// Transport on resumption when asked to
+TEST(WarmResumptionTest, MigrateOnResume) {
+  folly::ScopedEventBaseThread transportWorker;
+  folly::ScopedEventBaseThread SMWorker;
+  auto server = makeResumableServer(std::make_shared<HelloServiceHandler>());
+  auto client = makeWarmResumableClient(
+      transportWorker.getEventBase(),
+      *server->listeningPort(),
+      nullptr, // connectionEvents
+      SMWorker.getEventBase());
+  client->setMigrateOnResume(true);
+
+  // Runs a stream to completion, returning the EventBase it was delivered on.
+  auto const streamOn = [&] {
+    std::atomic<folly::EventBase*> evb{nullptr};
+    auto ts = TestSubscriber<std::string>::create();
+    client->getRequester()
+        ->requestStream(Payload("Bob"))
+        ->map([&](auto p) {
+          evb = folly::EventBaseManager::get()->getExistingEventBase();
+          return p.moveDataToString();
+        })
+        ->subscribe(ts);
+    ts->awaitTerminalEvent();
+    ts->assertSuccess();
+    return evb.load();
+  };
+
+  EXPECT_EQ(SMWorker.getEventBase(), streamOn());
+
+  auto result =
+      client->disconnect(std::runtime_error("Test triggered disconnect"))
+          .thenValue([&](auto&&) { return client->resume(); });
+  EXPECT_NO_THROW(std::move(result).get());
+
+  EXPECT_EQ(transportWorker.getEventBase(), streamOn());
+}
@@ -289,6 +289,19 @@ TEST(FrameTest, Frame_RESUME_OK) {
   EXPECT_EQ(position, frame.position_);
 }
 
+TEST(FrameTest, Frame_EXT) {
+  uint32_t streamId = 42;
+  FrameFlags flags = FrameFlags::IGNORE_;
+  uint32_t extendedType = 7;
+  auto data = folly::IOBuf::copyBuffer("424242");
+  auto frame =
+      reserialize<Frame_EXT>(streamId, flags, extendedType, data->clone());
+
+  expectHeader(FrameType::EXT, flags, streamId, frame);
+  EXPECT_EQ(extendedType, frame.extendedType_);
+  EXPECT_TRUE(folly::IOBufEqualTo()(*data, *frame.data_));
+}
+
 TEST(FrameTest, Frame_PreallocatedFrameLengthField) {
   uint32_t streamId = 42;
   FrameFlags flags = FrameFlags::COMPLETE;
@@ -302,3 +315,199 @@ TEST(FrameTest, Frame_PreallocatedFrameLengthField) {
 
   EXPECT_LT(0, serializedFrame->headroom());
 }
+
+TEST(FrameTest, MetadataFlagFollowsPayload) {
+  Frame_PAYLOAD withMetadata(
+      1, FrameFlags::NEXT | FrameFlags::IGNORE_, Payload("data", "meta"));
+  EXPECT_EQ(
+      FrameFlags::NEXT | FrameFlags::METADATA, withMetadata.header_.flags);
+
+  Frame_REQUEST_STREAM withoutMetadata(
+      1, FrameFlags::FOLLOWS, 10, Payload("data"));
+  EXPECT_EQ(FrameFlags::FOLLOWS, withoutMetadata.header_.flags);
+}
+
+TEST(FrameTest, SharedSerializers) {
+  auto const framed = FrameSerializer::shared(ProtocolVersion::Latest, true);
+  auto const unframed = FrameSerializer::shared(ProtocolVersion::Latest, false);
+  ASSERT_NE(nullptr, framed);
+  ASSERT_NE(nullptr, unframed);
+  EXPECT_NE(framed, unframed);
+  EXPECT_EQ(framed, FrameSerializer::shared(ProtocolVersion::Latest, true));
+  EXPECT_EQ(ProtocolVersion::Latest, framed->protocolVersion());
+  EXPECT_EQ(nullptr, FrameSerializer::shared(ProtocolVersion::Unknown, true));
+
+  auto frame = Frame_PAYLOAD(
+      42, FrameFlags::COMPLETE, Payload(folly::IOBuf::copyBuffer("424242")));
+  EXPECT_LT(0, framed->serializeOut(std::move(frame))->headroom());
+}
+
+TEST(FrameTest, Frame_PAYLOAD_SerializedIntoHeadroom) {
+  uint32_t streamId = 42;
+  FrameFlags flags = FrameFlags::COMPLETE | FrameFlags::METADATA;
+  auto frameSerializer =
+      FrameSerializer::createFrameSerializer(ProtocolVersion::Latest);
+  frameSerializer->preallocateFrameSizeField() = true;
+
+  auto metadata = Payload::copyBuffer("i'm so meta even this acronym");
+  auto data = Payload::copyBuffer("424242");
+  auto const metadataBuffer = metadata->data();
+
+  auto frame = Frame_PAYLOAD(
+      streamId, flags, Payload(std::move(data), std::move(metadata)));
+  auto serializedFrame = frameSerializer->serializeOut(std::move(frame));
+
+  // The header was written in front of the metadata, in the same buffer.
+  EXPECT_EQ(metadataBuffer, serializedFrame->data() + 9);
+  EXPECT_LE(3, serializedFrame->headroom());
+
+  Frame_PAYLOAD newFrame;
+  EXPECT_TRUE(
+      frameSerializer->deserializeFrom(newFrame, std::move(serializedFrame)));
+  expectHeader(FrameType::PAYLOAD, flags, streamId, newFrame);
+  EXPECT_EQ(
+      "i'm so meta even this acronym",
+      newFrame.payload_.moveMetadataToString());
+  EXPECT_EQ("424242", newFrame.payload_.moveDataToString());
+}
+
+TEST(FrameTest, Frame_PAYLOAD_SmallPayloadIsOneBuffer) {
+  uint32_t streamId = 42;
+  FrameFlags flags = FrameFlags::COMPLETE | FrameFlags::METADATA;
+  auto frameSerializer =
+      FrameSerializer::createFrameSerializer(ProtocolVersion::Latest);
+  frameSerializer->preallocateFrameSizeField() = true;
+
+  auto frame = Frame_PAYLOAD(streamId, flags, Payload("424242", "meta"));
+  auto serializedFrame = frameSerializer->serializeOut(std::move(frame));
+
+  // The data was copied in behind the metadata.
+  EXPECT_FALSE(serializedFrame->isChained());
+  EXPECT_LE(3, serializedFrame->headroom());
+
+  Frame_PAYLOAD newFrame;
+  EXPECT_TRUE(
+      frameSerializer->deserializeFrom(newFrame, std::move(serializedFrame)));
+  expectHeader(FrameType::PAYLOAD, flags, streamId, newFrame);
+  EXPECT_EQ("meta", newFrame.payload_.moveMetadataToString());
+  EXPECT_EQ("424242", newFrame.payload_.moveDataToString());
+}
+
+TEST(FrameTest, Frame_PAYLOAD_LargeDataIsChained) {
+  uint32_t streamId = 42;
+  FrameFlags flags = FrameFlags::COMPLETE | FrameFlags::METADATA;
+  auto frameSerializer =
+      FrameSerializer::createFrameSerializer(ProtocolVersion::Latest);
+
+  std::string const data(2 * Payload::kSmallPayloadSize, 'x');
+  auto metadata = folly::IOBuf::copyBuffer(
+      "meta", 4, Payload::kHeaderHeadroom, /* minTailroom */ data.size());
+  auto frame = Frame_PAYLOAD(
+      streamId,
+      flags,
+      Payload(Payload::copyBuffer(data), std::move(metadata)));
+  auto serializedFrame = frameSerializer->serializeOut(std::move(frame));
+  EXPECT_TRUE(serializedFrame->isChained());
+
+  Frame_PAYLOAD newFrame;
+  EXPECT_TRUE(
+      frameSerializer->deserializeFrom(newFrame, std::move(serializedFrame)));
+  EXPECT_EQ("meta", newFrame.payload_.moveMetadataToString());
+  EXPECT_EQ(data, newFrame.payload_.moveDataToString());
+}
+
+TEST(FrameTest, RewriteStreamId) {
+  auto frameSerializer =
+      FrameSerializer::createFrameSerializer(ProtocolVersion::Latest);
+  auto serializedFrame = frameSerializer->serializeOut(
+      Frame_PAYLOAD(1, FrameFlags::NEXT, Payload("424242")));
+  serializedFrame->coalesce();
+
+  // A buffer someone else can see is left alone.
+  auto shared = serializedFrame->clone();
+  auto rewritten =
+      frameSerializer->rewriteStreamId(std::move(shared), 0x01020304);
+  EXPECT_EQ(1, *frameSerializer->peekStreamId(*serializedFrame, false));
+  EXPECT_EQ(0x01020304, *frameSerializer->peekStreamId(*rewritten, false));
+  rewritten.reset();
+
+  // Otherwise the stream id is written in place.
+  auto const data = serializedFrame->data();
+  rewritten = frameSerializer->rewriteStreamId(std::move(serializedFrame), 7);
+  EXPECT_EQ(data, rewritten->data());
+
+  Frame_PAYLOAD frame;
+  EXPECT_TRUE(frameSerializer->deserializeFrom(frame, std::move(rewritten)));
+  expectHeader(FrameType::PAYLOAD, FrameFlags::NEXT, 7, frame);
+  EXPECT_EQ("424242", frame.payload_.moveDataToString());
+}
+
+TEST(FrameTest, PeekHeaderAcrossChain) {
+  uint32_t streamId = 0x01020304;
+  auto frameSerializer =
+      FrameSerializer::createFrameSerializer(ProtocolVersion::Latest);
+  auto frame = Frame_REQUEST_N(streamId, 7);
+  auto serializedFrame = frameSerializer->serializeOut(std::move(frame));
+  serializedFrame->coalesce();
+
+  EXPECT_EQ(
+      FrameType::REQUEST_N, frameSerializer->peekFrameType(*serializedFrame));
+  EXPECT_EQ(streamId, *frameSerializer->peekStreamId(*serializedFrame, false));
+
+  // Split the header over two buffers, forcing the Cursor path.
+  auto head = folly::IOBuf::copyBuffer(serializedFrame->data(), 3);
+  head->appendChain(folly::IOBuf::copyBuffer(
+      serializedFrame->data() + 3, serializedFrame->length() - 3));
+
+  EXPECT_EQ(FrameType::REQUEST_N, frameSerializer->peekFrameType(*head));
+  EXPECT_EQ(streamId, *frameSerializer->peekStreamId(*head, false));
+}
+
+TEST(FrameTest, DecodeHeaderThenDeserializeBody) {
+  uint32_t streamId = 42;
+  FrameFlags flags = FrameFlags::COMPLETE | FrameFlags::METADATA;
+  auto frameSerializer =
+      FrameSerializer::createFrameSerializer(ProtocolVersion::Latest);
+  auto serializedFrame = frameSerializer->serializeOut(Frame_PAYLOAD(
+      streamId, flags, Payload("424242", "i'm so meta even this acronym")));
+
+  auto decoded = frameSerializer->decodeFrameHeader(*serializedFrame);
+  ASSERT_TRUE(decoded);
+  EXPECT_EQ(FrameType::PAYLOAD, decoded->header.type);
+  EXPECT_EQ(flags, decoded->header.flags);
+  EXPECT_EQ(streamId, decoded->header.streamId);
+
+  Frame_PAYLOAD newFrame;
+  EXPECT_TRUE(frameSerializer->deserializeFrom(
+      newFrame, std::move(serializedFrame), *decoded));
+  expectHeader(FrameType::PAYLOAD, flags, streamId, newFrame);
+  EXPECT_EQ(
+      "i'm so meta even this acronym",
+      newFrame.payload_.moveMetadataToString());
+  EXPECT_EQ("424242", newFrame.payload_.moveDataToString());
+}
+
+TEST(FrameTest, DecodeTruncatedHeader) {
+  auto frameSerializer =
+      FrameSerializer::createFrameSerializer(ProtocolVersion::Latest);
+  auto buf = folly::IOBuf::copyBuffer("\x00\x00\x00", 3);
+  EXPECT_FALSE(frameSerializer->decodeFrameHeader(*buf));
+}
+
+TEST(FrameTest, DeserializedDataSharesFrameBuffer) {
+  auto frameSerializer =
+      FrameSerializer::createFrameSerializer(ProtocolVersion::Latest);
+  auto buf = frameSerializer->serializeOut(
+      Frame_PAYLOAD(1, FrameFlags::NEXT, Payload("data", "metadata")));
+  buf->coalesce();
+  auto const frameStart = buf->data();
+  auto const frameEnd = buf->tail();
+
+  Frame_PAYLOAD frame;
+  ASSERT_TRUE(frameSerializer->deserializeFrom(frame, std::move(buf)));
+  ASSERT_TRUE(frame.payload_.data);
+  EXPECT_EQ("data", frame.payload_.data->cloneAsValue().moveToFbString());
+  EXPECT_EQ(frameEnd, frame.payload_.data->tail());
+  EXPECT_LT(frameStart, frame.payload_.data->data());
+  EXPECT_EQ("metadata", frame.payload_.moveMetadataToString());
+}
@@ -12,15 +12,22 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <folly/io/Cursor.h>
+#include <folly/tracing/StaticTracepoint.h>
 #include <gtest/gtest.h>
 
+#include "rsocket/framing/FrameSerializer.h"
 #include "rsocket/framing/FrameTransportImpl.h"
+#include "rsocket/framing/FramedDuplexConnection.h"
 #include "rsocket/test/test_utils/MockDuplexConnection.h"
 #include "rsocket/test/test_utils/MockFrameProcessor.h"
 
 using namespace rsocket;
 using namespace testing;
 
+// Fails to link unless FrameTransportImpl defines the semaphore.
+FOLLY_SDT_DECLARE_SEMAPHORE(rsocket, frame_read);
+
 namespace {
 
 /*
@@ -80,3 +87,150 @@ TEST(FrameTransport, InputSendsError) {
   transport->setFrameProcessor(std::move(processor));
   transport->close();
 }
+
+TEST(FrameTransport, FramedBatchIsOneWrite) {
+  auto connection = std::make_unique<StrictMock<MockDuplexConnection>>();
+  EXPECT_CALL(*connection, setInput_(_));
+
+  // Both frames, each prefixed with its 3 byte length, in one write.
+  EXPECT_CALL(
+      *connection,
+      send_(IOBufStringEq(std::string("\0\0\5Hello\0\0\5World", 16))));
+
+  auto framed = std::make_unique<FramedDuplexConnection>(
+      std::move(connection), ProtocolVersion::Latest);
+  auto transport = std::make_shared<FrameTransportImpl>(std::move(framed));
+
+  transport->setFrameProcessor(
+      std::make_shared<StrictMock<MockFrameProcessor>>());
+
+  std::vector<std::unique_ptr<folly::IOBuf>> frames;
+  frames.push_back(folly::IOBuf::copyBuffer("Hello"));
+  frames.push_back(folly::IOBuf::copyBuffer("World"));
+  transport->outputFramesOrDrop(std::move(frames));
+
+  transport->close();
+}
+
+TEST(FrameTransport, SmallFramesOfBatchShareOutputBlocks) {
+  auto connection = std::make_unique<StrictMock<MockDuplexConnection>>();
+  EXPECT_CALL(*connection, setInput_(_));
+
+  constexpr size_t kSmallFrames = 1000;
+  auto large = folly::IOBuf::copyBuffer(std::string(4096, 'x'));
+  auto const largeData = large->data();
+
+  EXPECT_CALL(*connection, send_(_))
+      .WillOnce(Invoke([&](std::unique_ptr<folly::IOBuf>& buf) {
+        EXPECT_EQ(
+            kSmallFrames * (3 + 5) + 3 + 4096, buf->computeChainDataLength());
+
+        // The small frames are copied into a few shared blocks, the large
+        // frame is chained in as is.
+        EXPECT_LE(buf->countChainElements(), 4);
+        bool largeChained = false;
+        for (auto range : *buf) {
+          largeChained = largeChained || range.data() == largeData;
+        }
+        EXPECT_TRUE(largeChained);
+
+        folly::io::Cursor cursor(buf.get());
+        for (size_t i = 0; i < kSmallFrames; ++i) {
+          EXPECT_EQ(std::string("\0\0\5Hello", 8), cursor.readFixedString(8));
+        }
+        EXPECT_EQ(std::string("\0\x10\0", 3), cursor.readFixedString(3));
+        EXPECT_EQ(std::string(4096, 'x'), cursor.readFixedString(4096));
+      }));
+
+  auto framed = std::make_unique<FramedDuplexConnection>(
+      std::move(connection), ProtocolVersion::Latest);
+  auto transport = std::make_shared<FrameTransportImpl>(std::move(framed));
+
+  transport->setFrameProcessor(
+      std::make_shared<StrictMock<MockFrameProcessor>>());
+
+  std::vector<std::unique_ptr<folly::IOBuf>> frames;
+  for (size_t i = 0; i < kSmallFrames; ++i) {
+    frames.push_back(folly::IOBuf::copyBuffer("Hello"));
+  }
+  frames.push_back(std::move(large));
+  transport->outputFramesOrDrop(std::move(frames));
+
+  transport->close();
+}
+
+TEST(FrameTransport, OutputWhileProcessingIsOneWrite) {
+  std::shared_ptr<DuplexConnection::Subscriber> input;
+  auto connection = std::make_unique<StrictMock<MockDuplexConnection>>(
+      [&](auto subscriber) { input = std::move(subscriber); });
+  EXPECT_CALL(*connection, bufferedOutputBytes()).WillRepeatedly(Return(0));
+  EXPECT_CALL(
+      *connection,
+      send_(IOBufStringEq(std::string("\0\0\5Hello\0\0\5World", 16))));
+
+  auto framed = std::make_unique<FramedDuplexConnection>(
+      std::move(connection), ProtocolVersion::Latest);
+  auto transport = std::make_shared<FrameTransportImpl>(std::move(framed));
+
+  auto processor = std::make_shared<StrictMock<MockFrameProcessor>>();
+  EXPECT_CALL(*processor, processFrame_(_))
+      .WillOnce(Invoke([&](std::unique_ptr<folly::IOBuf>&) {
+        transport->outputFrameOrDrop(folly::IOBuf::copyBuffer("Hello"));
+        transport->outputFrameOrDrop(folly::IOBuf::copyBuffer("World"));
+        EXPECT_EQ(10, transport->bufferedOutputBytes());
+      }));
+
+  transport->setFrameProcessor(std::move(processor));
+  ASSERT_TRUE(input);
+  input->onSubscribe(
+      std::make_shared<NiceMock<yarpl::mocks::MockSubscription>>());
+  input->onNext(folly::IOBuf::copyBuffer(std::string("\0\0\4Ping", 7)));
+  EXPECT_EQ(0, transport->bufferedOutputBytes());
+  transport->close();
+}
+
+TEST(FrameTransport, SerializedFrameIsFramedInPlace) {
+  auto connection = std::make_unique<StrictMock<MockDuplexConnection>>();
+  EXPECT_CALL(*connection, setInput_(_));
+
+  auto serializer =
+      FrameSerializer::createFrameSerializer(ProtocolVersion::Latest);
+  serializer->preallocateFrameSizeField() = true;
+  auto frame = serializer->serializeOut(Frame_REQUEST_N(1, 5));
+  auto const head = frame.get();
+  auto const data = frame->data();
+
+  // The length field goes into the headroom of the frame, no buffer is
+  // chained in front of it.
+  EXPECT_CALL(*connection, send_(_))
+      .WillOnce(Invoke([&](std::unique_ptr<folly::IOBuf>& buf) {
+        EXPECT_EQ(head, buf.get());
+        EXPECT_FALSE(buf->isChained());
+        EXPECT_EQ(data - 3, buf->data());
+      }));
+
+  auto framed = std::make_unique<FramedDuplexConnection>(
+      std::move(connection), ProtocolVersion::Latest);
+  auto transport = std::make_shared<FrameTransportImpl>(std::move(framed));
+  transport->setFrameProcessor(
+      std::make_shared<StrictMock<MockFrameProcessor>>());
+
+  transport->outputFrameOrDrop(std::move(frame));
+  transport->close();
+}
+
+TEST(FrameTransport, FrameReadProbeHasSemaphore) {
+  // No tracer is attached to the probe, so it is skipped.
+  EXPECT_FALSE(FOLLY_SDT_IS_ENABLED(rsocket, frame_read));
+
+  auto connection = std::make_unique<StrictMock<MockDuplexConnection>>();
+  EXPECT_CALL(*connection, setInput_(_));
+  auto transport = std::make_shared<FrameTransportImpl>(std::move(connection));
+
+  auto processor = std::make_shared<StrictMock<MockFrameProcessor>>();
+  EXPECT_CALL(*processor, processFrame_(_));
+  transport->setFrameProcessor(processor);
+
+  transport->onNext(folly::IOBuf::copyBuffer("frame"));
+  transport->close();
+}
@@ -12,6 +12,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #include "rsocket/framing/FramedReader.h"
@@ -111,3 +113,80 @@ TEST(FramedReader, SubscriberErrorAfterError) {
   reader->error("Oops");
   reader->onError(std::runtime_error{"Not oops"});
 }
+
+TEST(FramedReader, ManyFramesInOneBuffer) {
+  auto version = std::make_shared<ProtocolVersion>(ProtocolVersion::Latest);
+  auto reader = std::make_shared<FramedReader>(version);
+
+  // Three 6-byte frames, each preceded by its 3-byte length.  The first two
+  // are contained in the first buffer, the last one spans both buffers.
+  std::string bytes;
+  for (char c : {'a', 'b', 'c'}) {
+    bytes += std::string{'\x00', '\x00', '\x06'};
+    bytes += std::string(6, c);
+  }
+  auto buf = folly::IOBuf::copyBuffer(bytes.data(), 22);
+  buf->prependChain(folly::IOBuf::copyBuffer(bytes.data() + 22, 5));
+
+  auto subscriber = std::make_shared<
+      StrictMock<MockSubscriber<std::unique_ptr<folly::IOBuf>>>>();
+  std::vector<std::string> frames;
+  EXPECT_CALL(*subscriber, onSubscribe_(_));
+  EXPECT_CALL(*subscriber, onNext_(_))
+      .Times(3)
+      .WillRepeatedly(Invoke([&](const std::unique_ptr<folly::IOBuf>& frame) {
+        frames.push_back(frame->clone()->moveToFbString().toStdString());
+      }));
+  EXPECT_CALL(*subscriber, onComplete_());
+
+  reader->onSubscribe(yarpl::flowable::Subscription::create());
+  reader->setInput(subscriber);
+  reader->onNext(std::move(buf));
+  reader->onComplete();
+
+  EXPECT_EQ(
+      (std::vector<std::string>{
+          std::string(6, 'a'), std::string(6, 'b'), std::string(6, 'c')}),
+      frames);
+}
+
+TEST(FramedReader, CopiesSmallFrames) {
+  auto version = std::make_shared<ProtocolVersion>(ProtocolVersion::Latest);
+  FramedReader::Options options;
+  options.copyThreshold = 8;
+  auto reader = std::make_shared<FramedReader>(version, options);
+
+  // A 6-byte frame and a 10-byte frame in one buffer, then a 6-byte frame
+  // that spans two buffers.
+  std::string bytes;
+  bytes += std::string{'\x00', '\x00', '\x06'} + std::string(6, 'a');
+  bytes += std::string{'\x00', '\x00', '\x0a'} + std::string(10, 'b');
+  bytes += std::string{'\x00', '\x00', '\x06'} + std::string(6, 'c');
+  auto buf = folly::IOBuf::copyBuffer(bytes.data(), 25);
+  buf->prependChain(folly::IOBuf::copyBuffer(bytes.data() + 25, 6));
+
+  auto subscriber = std::make_shared<
+      StrictMock<MockSubscriber<std::unique_ptr<folly::IOBuf>>>>();
+  std::vector<std::string> frames;
+  std::vector<bool> shared;
+  EXPECT_CALL(*subscriber, onSubscribe_(_));
+  EXPECT_CALL(*subscriber, onNext_(_))
+      .Times(3)
+      .WillRepeatedly(Invoke([&](const std::unique_ptr<folly::IOBuf>& frame) {
+        shared.push_back(frame->isShared());
+        frames.push_back(frame->clone()->moveToFbString().toStdString());
+      }));
+  EXPECT_CALL(*subscriber, onComplete_());
+
+  reader->onSubscribe(yarpl::flowable::Subscription::create());
+  reader->setInput(subscriber);
+  reader->onNext(std::move(buf));
+  reader->onComplete();
+
+  EXPECT_EQ(
+      (std::vector<std::string>{
+          std::string(6, 'a'), std::string(10, 'b'), std::string(6, 'c')}),
+      frames);
+  // Only the 10-byte frame is a slice of the read buffer.
+  EXPECT_EQ((std::vector<bool>{false, true, false}), shared);
+}
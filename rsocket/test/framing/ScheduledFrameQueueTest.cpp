@@ -0,0 +1,87 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/framing/ScheduledFrameQueue.h"
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+using namespace rsocket;
+
+namespace {
+
+std::string toString(const std::unique_ptr<folly::IOBuf>& buf) {
+  return buf->cloneCoalescedAsValue().moveToFbString().toStdString();
+}
+
+} // namespace
+
+TEST(ScheduledFrameQueueTest, OneDrainPerBatch) {
+  ScheduledFrameQueue queue;
+
+  EXPECT_TRUE(queue.push(folly::IOBuf::copyBuffer("a")));
+  EXPECT_FALSE(queue.push(folly::IOBuf::copyBuffer("b")));
+
+  std::vector<std::unique_ptr<folly::IOBuf>> more;
+  more.push_back(folly::IOBuf::copyBuffer("c"));
+  more.push_back(folly::IOBuf::copyBuffer("d"));
+  EXPECT_FALSE(queue.push(std::move(more)));
+
+  auto frames = queue.drain();
+  ASSERT_EQ(4, frames.size());
+  EXPECT_EQ("a", toString(frames[0]));
+  EXPECT_EQ("b", toString(frames[1]));
+  EXPECT_EQ("c", toString(frames[2]));
+  EXPECT_EQ("d", toString(frames[3]));
+
+  EXPECT_TRUE(queue.drain().empty());
+  EXPECT_TRUE(queue.push(folly::IOBuf::copyBuffer("e")));
+  EXPECT_EQ(1, queue.drain().size());
+}
+
+TEST(ScheduledFrameQueueTest, ConcurrentProducers) {
+  constexpr size_t kProducers = 4;
+  constexpr size_t kFrames = 10000;
+  ScheduledFrameQueue queue;
+  std::atomic<size_t> drainsRequested{0};
+
+  std::vector<std::thread> producers;
+  for (size_t i = 0; i < kProducers; ++i) {
+    producers.emplace_back([&] {
+      for (size_t j = 0; j < kFrames; ++j) {
+        if (queue.push(folly::IOBuf::copyBuffer("x"))) {
+          ++drainsRequested;
+        }
+      }
+    });
+  }
+
+  size_t drained = 0;
+  size_t drains = 0;
+  while (drained < kProducers * kFrames) {
+    if (drains < drainsRequested.load()) {
+      ++drains;
+      drained += queue.drain().size();
+    } else {
+      std::this_thread::yield();
+    }
+  }
+
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  EXPECT_EQ(kProducers * kFrames, drained);
+  EXPECT_TRUE(queue.drain().empty());
+}
@@ -0,0 +1,554 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Replays inputs through the frame parsing path and flags the ones that make
+// it spend more than linear time or memory, which the crash-oriented
+// frame_fuzzer doesn't notice.
+//
+// Every input is fed to a FramedReader, in reads of --chunk bytes, and every
+// frame it delivers is parsed by FrameSerializerV1_0.  Fragments are
+// reassembled by a StreamFragmentAccumulator per stream, with and without
+// contiguous reassembly.  Each run is checked against budgets that grow
+// linearly with the length of the input:
+//
+//   time   <= --fixed_ns    + --ns_per_byte    * bytes
+//   memory <= --fixed_bytes + --bytes_per_byte * bytes
+//
+// Memory is the peak heap growth of the run when running with jemalloc, and
+// otherwise the peak of the bytes held by the reader and the accumulators.
+//
+// Inputs are the files named on the command line, or stdin when there are
+// none.  With --generate, pathological inputs (tiny fragments, huge length
+// fields, fragments left open on many streams...) are generated instead, each
+// at two sizes, and also flagged when the cost per byte grows with the size.
+//
+// Exits with status 1 if any input is over budget.
+
+#include <folly/Format.h>
+#include <folly/Optional.h>
+#include <folly/Random.h>
+#include <folly/init/Init.h>
+#include <folly/io/IOBufQueue.h>
+#include <folly/memory/Malloc.h>
+#include <folly/memory/MallctlHelper.h>
+#include <folly/portability/GFlags.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "rsocket/framing/FrameSerializer_v1_0.h"
+#include "rsocket/framing/FramedReader.h"
+#include "rsocket/statemachine/StreamFragmentAccumulator.h"
+
+DEFINE_int32(chunk, 0, "bytes per read, 0 to deliver each input at once");
+DEFINE_int64(fixed_ns, 10 * 1000 * 1000, "time budget of any input");
+DEFINE_double(ns_per_byte, 2000, "time budget per input byte");
+DEFINE_int64(fixed_bytes, 1 << 20, "memory budget of any input");
+DEFINE_double(bytes_per_byte, 16, "memory budget per input byte");
+DEFINE_int64(
+    max_payload_size,
+    16 << 20,
+    "largest reassembled payload, as StreamFragmentAccumulator::maxSize");
+DEFINE_bool(generate, false, "run generated inputs instead of files");
+DEFINE_int32(size, 1 << 20, "bytes per generated input");
+DEFINE_double(
+    growth_slack,
+    2.0,
+    "how much more a generated input may cost per byte at 4x the size");
+DEFINE_int32(repeat, 3, "runs per input, the fastest one is measured");
+DEFINE_int64(seed, 0, "seed of the random inputs, 0 for a random seed");
+
+using namespace rsocket;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/// Bytes in use on the heap by this thread, or none without jemalloc.
+folly::Optional<int64_t> threadHeapBytes() {
+  if (!folly::usingJEMalloc()) {
+    return folly::none;
+  }
+  try {
+    uint64_t allocated = 0;
+    uint64_t deallocated = 0;
+    folly::mallctlRead("thread.allocated", &allocated);
+    folly::mallctlRead("thread.deallocated", &deallocated);
+    return static_cast<int64_t>(allocated) - static_cast<int64_t>(deallocated);
+  } catch (const std::exception&) {
+    return folly::none;
+  }
+}
+
+/// Parses the frames a FramedReader delivers and reassembles fragments the
+/// way streams would.
+class ParsingSubscriber : public DuplexConnection::Subscriber {
+ public:
+  explicit ParsingSubscriber(StreamFragmentAccumulator::Options options)
+      : options_{std::move(options)} {}
+
+  void onSubscribe(
+      std::shared_ptr<yarpl::flowable::Subscription> subscription) override {
+    subscription->request(std::numeric_limits<int64_t>::max());
+  }
+
+  void onNext(std::unique_ptr<folly::IOBuf> frame) override {
+    ++frames;
+    switch (serializer_.peekFrameType(*frame)) {
+      case FrameType::REQUEST_RESPONSE:
+        parsePayload<Frame_REQUEST_RESPONSE>(std::move(frame));
+        break;
+      case FrameType::REQUEST_FNF:
+        parsePayload<Frame_REQUEST_FNF>(std::move(frame));
+        break;
+      case FrameType::REQUEST_STREAM:
+        parsePayload<Frame_REQUEST_STREAM>(std::move(frame));
+        break;
+      case FrameType::REQUEST_CHANNEL:
+        parsePayload<Frame_REQUEST_CHANNEL>(std::move(frame));
+        break;
+      case FrameType::PAYLOAD:
+        parsePayload<Frame_PAYLOAD>(std::move(frame));
+        break;
+      case FrameType::SETUP:
+        parse<Frame_SETUP>(std::move(frame));
+        break;
+      case FrameType::LEASE:
+        parse<Frame_LEASE>(std::move(frame));
+        break;
+      case FrameType::KEEPALIVE:
+        parse<Frame_KEEPALIVE>(std::move(frame));
+        break;
+      case FrameType::REQUEST_N:
+        parse<Frame_REQUEST_N>(std::move(frame));
+        break;
+      case FrameType::CANCEL:
+        parse<Frame_CANCEL>(std::move(frame));
+        break;
+      case FrameType::ERROR:
+        parse<Frame_ERROR>(std::move(frame));
+        break;
+      case FrameType::METADATA_PUSH:
+        parse<Frame_METADATA_PUSH>(std::move(frame));
+        break;
+      case FrameType::RESUME:
+        parse<Frame_RESUME>(std::move(frame));
+        break;
+      case FrameType::RESUME_OK:
+        parse<Frame_RESUME_OK>(std::move(frame));
+        break;
+      case FrameType::EXT:
+        parse<Frame_EXT>(std::move(frame));
+        break;
+      case FrameType::RESERVED:
+      default:
+        ++malformed;
+        break;
+    }
+  }
+
+  void onComplete() override {}
+  void onError(folly::exception_wrapper) override {}
+
+  /// Bytes held by the accumulators.
+  size_t bufferedBytes() const {
+    return buffered_;
+  }
+
+  size_t frames{0};
+  size_t malformed{0};
+  size_t rejected{0};
+
+ private:
+  template <typename Frame>
+  bool parse(std::unique_ptr<folly::IOBuf> buf, Frame& frame) {
+    if (!serializer_.deserializeFrom(frame, std::move(buf))) {
+      ++malformed;
+      return false;
+    }
+    return true;
+  }
+
+  template <typename Frame>
+  void parse(std::unique_ptr<folly::IOBuf> buf) {
+    Frame frame;
+    parse(std::move(buf), frame);
+  }
+
+  template <typename Frame>
+  void parsePayload(std::unique_ptr<folly::IOBuf> buf) {
+    Frame frame;
+    if (parse(std::move(buf), frame)) {
+      accumulate(frame.header_, std::move(frame.payload_));
+    }
+  }
+
+  void accumulate(const FrameHeader& header, Payload payload) {
+    auto const follows = header.flagsFollows();
+    auto it = streams_.find(header.streamId);
+    if (it == streams_.end()) {
+      if (!follows) {
+        return;
+      }
+      it = streams_.emplace(header.streamId, options_).first;
+    }
+
+    auto& fragments = it->second;
+    if (fragments.exceedsMaxSize(payload, follows)) {
+      ++rejected;
+      buffered_ -= fragments.size();
+      streams_.erase(it);
+      return;
+    }
+
+    auto const before = fragments.size();
+    fragments.addPayload(
+        std::move(payload), header.flagsNext(), header.flagsComplete());
+    buffered_ += fragments.size() - before;
+    if (!follows) {
+      buffered_ -= fragments.size();
+      fragments.consumePayloadAndFlags();
+      streams_.erase(it);
+    }
+  }
+
+  FrameSerializerV1_0 serializer_;
+  const StreamFragmentAccumulator::Options options_;
+  std::unordered_map<StreamId, StreamFragmentAccumulator> streams_;
+  size_t buffered_{0};
+};
+
+struct Measurement {
+  size_t bytes{0};
+  size_t frames{0};
+  uint64_t nanos{std::numeric_limits<uint64_t>::max()};
+
+  /// Peak heap growth, or with no jemalloc, peak bytes held by the parser.
+  size_t memory{0};
+};
+
+/// The reads of an input, allocated before the run so that they don't count
+/// towards its memory.
+std::vector<std::unique_ptr<folly::IOBuf>> splitIntoReads(
+    const std::string& input) {
+  std::vector<std::unique_ptr<folly::IOBuf>> reads;
+  auto const chunk =
+      FLAGS_chunk > 0 ? static_cast<size_t>(FLAGS_chunk) : input.size();
+  for (size_t offset = 0; offset < input.size(); offset += chunk) {
+    auto const length = std::min(chunk, input.size() - offset);
+    reads.push_back(folly::IOBuf::copyBuffer(input.data() + offset, length));
+  }
+  return reads;
+}
+
+/// Feeds `input` through the parser once.  Samples the memory held after
+/// every read when `sampleMemory` is set, which slows the run down.
+Measurement runOnce(
+    const std::string& input,
+    bool contiguous,
+    bool sampleMemory) {
+  auto reads = splitIntoReads(input);
+
+  StreamFragmentAccumulator::Options options;
+  options.contiguous = contiguous;
+  options.maxSize = static_cast<size_t>(FLAGS_max_payload_size);
+
+  Measurement measurement;
+  measurement.bytes = input.size();
+  folly::Optional<int64_t> heapBase;
+  if (sampleMemory) {
+    heapBase = threadHeapBytes();
+  }
+
+  auto const start = Clock::now();
+  {
+    auto version = std::make_shared<ProtocolVersion>(ProtocolVersion::Latest);
+    auto reader = std::make_shared<FramedReader>(version);
+    auto parser = std::make_shared<ParsingSubscriber>(options);
+    reader->onSubscribe(yarpl::flowable::Subscription::create());
+    reader->setInput(parser);
+
+    for (auto& read : reads) {
+      reader->onNext(std::move(read));
+      if (!sampleMemory) {
+        continue;
+      }
+      size_t memory = 0;
+      if (heapBase) {
+        auto const heap = *threadHeapBytes() - *heapBase;
+        memory = heap > 0 ? static_cast<size_t>(heap) : 0;
+      } else {
+        memory = reader->bufferedBytes() + parser->bufferedBytes();
+      }
+      measurement.memory = std::max(measurement.memory, memory);
+    }
+    reader->onComplete();
+    measurement.frames = parser->frames;
+  }
+  measurement.nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          Clock::now() - start)
+                          .count();
+  return measurement;
+}
+
+/// The fastest of --repeat runs, with the memory of a sampled run.
+Measurement measure(const std::string& input, bool contiguous) {
+  Measurement best;
+  for (int i = 0; i < std::max(FLAGS_repeat, 1); ++i) {
+    auto const run = runOnce(input, contiguous, false);
+    if (run.nanos < best.nanos) {
+      best = run;
+    }
+  }
+  best.memory = runOnce(input, contiguous, true).memory;
+  return best;
+}
+
+/// Logs the measurement, and whether it is within the linear budgets.
+bool withinBudget(const std::string& name, const Measurement& m) {
+  auto const timeBudget =
+      FLAGS_fixed_ns + static_cast<double>(m.bytes) * FLAGS_ns_per_byte;
+  auto const memoryBudget =
+      FLAGS_fixed_bytes + static_cast<double>(m.bytes) * FLAGS_bytes_per_byte;
+  auto const ok = m.nanos <= timeBudget && m.memory <= memoryBudget;
+
+  auto const line = folly::sformat(
+      "{}: {} bytes, {} frames, {} us ({:.1f} ns/byte), {} bytes of memory "
+      "({:.1f}/byte)",
+      name,
+      m.bytes,
+      m.frames,
+      m.nanos / 1000,
+      m.bytes ? static_cast<double>(m.nanos) / m.bytes : 0.0,
+      m.memory,
+      m.bytes ? static_cast<double>(m.memory) / m.bytes : 0.0);
+  if (ok) {
+    LOG(INFO) << line;
+  } else {
+    LOG(ERROR) << "OVER BUDGET " << line;
+  }
+  return ok;
+}
+
+/// Flags costs per byte that grow by more than the slack between an input
+/// and the same input at 4x the size.  Costs too small to measure reliably
+/// are ignored.
+bool scalesLinearly(
+    const std::string& name,
+    const Measurement& small,
+    const Measurement& large) {
+  constexpr uint64_t kMinNanos = 1000 * 1000;
+  constexpr size_t kMinMemory = 64 * 1024;
+  auto const limit = 4 * FLAGS_growth_slack;
+
+  bool ok = true;
+  if (small.nanos >= kMinNanos &&
+      static_cast<double>(large.nanos) / small.nanos > limit) {
+    LOG(ERROR) << "SUPERLINEAR TIME " << name << ": " << small.nanos / 1000
+               << " us to " << large.nanos / 1000 << " us for 4x the bytes";
+    ok = false;
+  }
+  if (small.memory >= kMinMemory &&
+      static_cast<double>(large.memory) / small.memory > limit) {
+    LOG(ERROR) << "SUPERLINEAR MEMORY " << name << ": " << small.memory
+               << " to " << large.memory << " bytes for 4x the bytes";
+    ok = false;
+  }
+  return ok;
+}
+
+// Generated inputs.
+
+void appendFrame(std::string& out, std::unique_ptr<folly::IOBuf> frame) {
+  auto const length = frame->computeChainDataLength();
+  out.push_back(static_cast<char>((length >> 16) & 0xFF));
+  out.push_back(static_cast<char>((length >> 8) & 0xFF));
+  out.push_back(static_cast<char>(length & 0xFF));
+  for (auto const range : *frame) {
+    out.append(reinterpret_cast<const char*>(range.data()), range.size());
+  }
+}
+
+/// One payload of `bytes` bytes sent as fragments of `fragment` bytes each,
+/// data or metadata.
+std::string fragmentedPayload(size_t bytes, size_t fragment, bool metadata) {
+  FrameSerializerV1_0 serializer;
+  std::string out;
+  std::string const chunk(fragment, 'x');
+  for (size_t sent = 0; sent < bytes; sent += fragment) {
+    auto const last = sent + fragment >= bytes;
+    auto buf = folly::IOBuf::copyBuffer(chunk);
+    auto payload = metadata
+        ? Payload(std::unique_ptr<folly::IOBuf>(), std::move(buf))
+        : Payload(std::move(buf));
+    auto const flags = last ? FrameFlags::NEXT | FrameFlags::COMPLETE
+                            : FrameFlags::NEXT | FrameFlags::FOLLOWS;
+    appendFrame(
+        out,
+        serializer.serializeOut(Frame_PAYLOAD(1, flags, std::move(payload))));
+  }
+  return out;
+}
+
+/// Fragments left open on ever more streams, none of them completed.
+std::string openFragments(size_t bytes) {
+  FrameSerializerV1_0 serializer;
+  std::string out;
+  for (StreamId id = 1; out.size() < bytes; id += 2) {
+    appendFrame(
+        out,
+        serializer.serializeOut(Frame_REQUEST_STREAM(
+            id, FrameFlags::FOLLOWS, 1, Payload("fragment"))));
+  }
+  return out;
+}
+
+/// A frame length field of the largest length, then the rest of a frame that
+/// never ends.
+std::string hugeLength(size_t bytes) {
+  std::string out("\xFF\xFF\xFF", 3);
+  out.append(std::max<size_t>(bytes, 3) - 3, '\0');
+  return out;
+}
+
+/// The smallest well-formed frames, back to back.
+std::string tinyFrames(size_t bytes) {
+  FrameSerializerV1_0 serializer;
+  std::string out;
+  while (out.size() < bytes) {
+    appendFrame(out, serializer.serializeOut(Frame_CANCEL(1)));
+  }
+  return out;
+}
+
+std::string randomBytes(size_t bytes, uint32_t seed) {
+  folly::Random::DefaultGenerator rng(seed);
+  std::string out(bytes, '\0');
+  for (auto& c : out) {
+    c = static_cast<char>(folly::Random::rand32(rng));
+  }
+  return out;
+}
+
+/// Frames of random length and content, framed correctly.
+std::string randomFrames(size_t bytes, uint32_t seed) {
+  folly::Random::DefaultGenerator rng(seed);
+  std::string out;
+  while (out.size() < bytes) {
+    auto const length = 6 + folly::Random::rand32(64, rng);
+    auto frame = folly::IOBuf::create(length);
+    for (size_t i = 0; i < length; ++i) {
+      frame->writableTail()[i] =
+          static_cast<uint8_t>(folly::Random::rand32(rng));
+    }
+    frame->append(length);
+    appendFrame(out, std::move(frame));
+  }
+  return out;
+}
+
+struct Shape {
+  std::string name;
+  std::function<std::string(size_t)> generate;
+};
+
+std::vector<Shape> shapes(uint32_t seed) {
+  return {
+      {"1-byte data fragments",
+       [](size_t bytes) { return fragmentedPayload(bytes / 10, 1, false); }},
+      {"1-byte metadata fragments",
+       [](size_t bytes) { return fragmentedPayload(bytes / 13, 1, true); }},
+      {"4KB fragments",
+       [](size_t bytes) { return fragmentedPayload(bytes, 4096, false); }},
+      {"open fragments on many streams", openFragments},
+      {"huge length field", hugeLength},
+      {"tiny frames", tinyFrames},
+      {"random bytes",
+       [seed](size_t bytes) { return randomBytes(bytes, seed); }},
+      {"random frames",
+       [seed](size_t bytes) { return randomFrames(bytes, seed); }},
+  };
+}
+
+std::string readFile(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  CHECK(file) << "Cannot open " << path;
+  std::ostringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+std::string readStdin() {
+  std::cin >> std::noskipws;
+  std::istream_iterator<char> it(std::cin);
+  std::istream_iterator<char> end;
+  return std::string(it, end);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  folly::init(&argc, &argv);
+  FLAGS_logtostderr = 1;
+
+  if (!folly::usingJEMalloc()) {
+    LOG(WARNING) << "Not running with jemalloc, memory is measured as the "
+                 << "bytes held by the parser rather than the heap growth";
+  }
+
+  std::string input;
+  if (!FLAGS_generate && argc <= 1) {
+    input = readStdin();
+  }
+
+  bool ok = true;
+  for (auto const contiguous : {false, true}) {
+    auto const mode = contiguous ? " (contiguous)" : "";
+
+    if (FLAGS_generate) {
+      auto const seed = FLAGS_seed ? static_cast<uint32_t>(FLAGS_seed)
+                                   : folly::Random::rand32();
+      LOG(INFO) << "Generating inputs with seed " << seed;
+      auto const size = static_cast<size_t>(std::max(FLAGS_size, 16));
+      for (auto const& shape : shapes(seed)) {
+        auto const name = shape.name + mode;
+        auto const small = measure(shape.generate(size / 4), contiguous);
+        auto const large = measure(shape.generate(size), contiguous);
+        ok &= withinBudget(name, small);
+        ok &= withinBudget(name, large);
+        ok &= scalesLinearly(name, small, large);
+      }
+    } else if (argc > 1) {
+      for (int i = 1; i < argc; ++i) {
+        auto const name = argv[i] + std::string(mode);
+        ok &= withinBudget(name, measure(readFile(argv[i]), contiguous));
+      }
+    } else {
+      ok &= withinBudget(
+          std::string("stdin") + mode, measure(input, contiguous));
+    }
+  }
+
+  return ok ? 0 : 1;
+}
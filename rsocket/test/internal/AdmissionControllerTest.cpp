@@ -0,0 +1,96 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/AdmissionController.h"
+#include <gtest/gtest.h>
+
+#include <folly/io/async/EventBase.h>
+
+#include <functional>
+#include <thread>
+
+using namespace ::rsocket;
+using namespace std::chrono_literals;
+
+namespace {
+
+AdmissionController::Options options() {
+  AdmissionController::Options opts;
+  opts.target = 5ms;
+  opts.interval = 100ms;
+  return opts;
+}
+
+} // namespace
+
+TEST(AdmissionControllerTest, AdmitsByDefault) {
+  AdmissionController controller{options()};
+  EXPECT_TRUE(controller.admit());
+}
+
+TEST(AdmissionControllerTest, AbsorbsShortBursts) {
+  auto const now = AdmissionController::Clock::now();
+  AdmissionController controller{options()};
+
+  controller.sample(50ms, now);
+  controller.sample(50ms, now + 99ms);
+  EXPECT_TRUE(controller.admit());
+
+  // The delay went back under the target, which restarts the interval.
+  controller.sample(1ms, now + 100ms);
+  controller.sample(50ms, now + 150ms);
+  controller.sample(50ms, now + 200ms);
+  EXPECT_TRUE(controller.admit());
+}
+
+TEST(AdmissionControllerTest, RejectsWhenDelayStaysAboveTarget) {
+  auto const now = AdmissionController::Clock::now();
+  AdmissionController controller{options()};
+
+  controller.sample(6ms, now);
+  controller.sample(50ms, now + 50ms);
+  controller.sample(6ms, now + 100ms);
+  EXPECT_FALSE(controller.admit());
+
+  controller.sample(5ms, now + 110ms);
+  EXPECT_TRUE(controller.admit());
+}
+
+TEST(AdmissionControllerTest, SamplesEventBase) {
+  folly::EventBase evb;
+  AdmissionController::Options opts;
+  opts.target = 2ms;
+  opts.interval = 20ms;
+  opts.sampleInterval = 1ms;
+  auto controller = AdmissionController::create(evb, opts);
+
+  // Keep the loop busy, so that every sample comes in late.
+  size_t iterations = 0;
+  std::function<void()> busy = [&] {
+    std::this_thread::sleep_for(10ms);
+    if (controller->admit() && ++iterations < 100) {
+      evb.runInLoop(busy);
+    } else {
+      evb.terminateLoopSoon();
+    }
+  };
+  evb.runInLoop(busy);
+  evb.loopForever();
+  EXPECT_FALSE(controller->admit());
+
+  // Once the loop is idle again, the next sample lets requests in.
+  evb.runAfterDelay([&] { evb.terminateLoopSoon(); }, 50);
+  evb.loopForever();
+  EXPECT_TRUE(controller->admit());
+}
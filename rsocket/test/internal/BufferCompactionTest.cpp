@@ -0,0 +1,101 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/BufferCompaction.h"
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+#include "rsocket/Payload.h"
+
+using namespace ::rsocket;
+
+namespace {
+
+std::unique_ptr<folly::IOBuf> sliceOf(size_t capacity, size_t length) {
+  auto buf = folly::IOBuf::create(capacity);
+  memset(buf->writableData(), 'a', length);
+  buf->append(length);
+  return buf;
+}
+
+std::unique_ptr<folly::IOBuf> chainOf(size_t buffers) {
+  auto chain = folly::IOBuf::copyBuffer("x");
+  for (size_t i = 1; i < buffers; ++i) {
+    chain->prependChain(folly::IOBuf::copyBuffer("x"));
+  }
+  return chain;
+}
+
+} // namespace
+
+TEST(BufferCompactionTest, LeavesSmallBuffersAlone) {
+  BufferCompaction compaction;
+  auto buf = sliceOf(64, 16);
+  EXPECT_FALSE(compaction.needed(*buf));
+
+  auto original = buf.get();
+  EXPECT_FALSE(compaction.compact(buf));
+  EXPECT_EQ(original, buf.get());
+}
+
+TEST(BufferCompactionTest, CompactsSlicesOfLargeBuffers) {
+  BufferCompaction compaction;
+  auto buf = sliceOf(64 * 1024, 100);
+  EXPECT_TRUE(compaction.needed(*buf));
+
+  EXPECT_TRUE(compaction.compact(buf));
+  EXPECT_FALSE(buf->isChained());
+  EXPECT_FALSE(buf->isShared());
+  EXPECT_EQ(100, buf->length());
+  EXPECT_LT(buf->capacity(), 4 * 1024);
+  EXPECT_EQ(std::string(100, 'a'), buf->moveToFbString().toStdString());
+}
+
+TEST(BufferCompactionTest, CompactsLongChains) {
+  BufferCompaction compaction;
+  EXPECT_FALSE(compaction.needed(*chainOf(compaction.maxBuffers)));
+
+  auto chain = chainOf(compaction.maxBuffers + 1);
+  EXPECT_TRUE(compaction.needed(*chain));
+  EXPECT_TRUE(compaction.compact(*chain));
+  EXPECT_FALSE(chain->isChained());
+  EXPECT_EQ(
+      std::string(compaction.maxBuffers + 1, 'x'),
+      chain->moveToFbString().toStdString());
+}
+
+TEST(BufferCompactionTest, LeavesLargeChainsAlone) {
+  BufferCompaction compaction;
+  compaction.maxBuffers = 0;
+  EXPECT_TRUE(compaction.needed(*sliceOf(128, 100)));
+  EXPECT_FALSE(compaction.needed(*sliceOf(128, 0)));
+  EXPECT_FALSE(compaction.needed(
+      *sliceOf(compaction.maxLength + 1, compaction.maxLength + 1)));
+}
+
+TEST(BufferCompactionTest, Payload) {
+  auto payload = Payload(sliceOf(64 * 1024, 10), chainOf(10));
+  payload.compact();
+  EXPECT_FALSE(payload.data->isChained());
+  EXPECT_LT(payload.data->capacity(), 4 * 1024);
+  EXPECT_FALSE(payload.metadata->isChained());
+  EXPECT_EQ("aaaaaaaaaa", payload.moveDataToString());
+  EXPECT_EQ("xxxxxxxxxx", payload.moveMetadataToString());
+
+  // Payloads without metadata stay without it.
+  auto dataOnly = Payload(chainOf(10));
+  dataOnly.compact();
+  EXPECT_EQ(nullptr, dataOnly.metadata);
+}
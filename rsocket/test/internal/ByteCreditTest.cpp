@@ -0,0 +1,63 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/ByteCredit.h"
+#include <gtest/gtest.h>
+
+#include <folly/io/IOBuf.h>
+
+using namespace ::rsocket;
+
+TEST(ByteCreditTest, MimeTypeParameter) {
+  auto mimeType = ByteCredit::addToMimeType("text/plain", 65536);
+  EXPECT_EQ("text/plain;rsocket-byte-credit=65536", mimeType);
+  EXPECT_EQ(65536, ByteCredit::removeFromMimeType(mimeType));
+  EXPECT_EQ("text/plain", mimeType);
+
+  std::string plain = "text/plain";
+  EXPECT_EQ(0, ByteCredit::removeFromMimeType(plain));
+  EXPECT_EQ("text/plain", plain);
+
+  std::string invalid = "text/plain; rsocket-byte-credit=lots";
+  EXPECT_EQ(0, ByteCredit::removeFromMimeType(invalid));
+  EXPECT_EQ("text/plain", invalid);
+}
+
+TEST(ByteCreditTest, Grant) {
+  auto frame = ByteCredit::grantFrame(3, 4096);
+  EXPECT_EQ(FrameType::EXT, frame.header_.type);
+  EXPECT_EQ(3, frame.header_.streamId);
+  EXPECT_EQ(FrameFlags::IGNORE_, frame.header_.flags);
+  EXPECT_EQ(4096, ByteCredit::parseGrant(frame).value_or(0));
+
+  Frame_EXT other{3, FrameFlags::IGNORE_, 42, frame.data_->clone()};
+  EXPECT_FALSE(ByteCredit::parseGrant(other));
+
+  Frame_EXT truncated{3,
+                      FrameFlags::IGNORE_,
+                      ByteCredit::kExtendedType,
+                      folly::IOBuf::copyBuffer("ab")};
+  EXPECT_FALSE(ByteCredit::parseGrant(truncated));
+
+  Frame_EXT zero{3,
+                 FrameFlags::IGNORE_,
+                 ByteCredit::kExtendedType,
+                 folly::IOBuf::copyBuffer(std::string(4, '\0'))};
+  EXPECT_FALSE(ByteCredit::parseGrant(zero));
+}
+
+TEST(ByteCreditTest, LengthOf) {
+  EXPECT_EQ(0, ByteCredit::lengthOf(Payload()));
+  EXPECT_EQ(5, ByteCredit::lengthOf(Payload("abc", "de")));
+}
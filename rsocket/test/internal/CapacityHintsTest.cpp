@@ -0,0 +1,92 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/CapacityHints.h"
+#include <gtest/gtest.h>
+
+#include "rsocket/RSocketParameters.h"
+#include "rsocket/framing/FrameSerializer_v1_0.h"
+
+using namespace ::rsocket;
+
+TEST(CapacityHintsTest, MimeTypeParameters) {
+  CapacityHints hints;
+  hints.streams = 10000;
+  hints.resumeWindow = 1 << 20;
+
+  auto mimeType = CapacityHints::addToMimeType("text/plain", hints);
+  EXPECT_EQ(
+      "text/plain;rsocket-expected-streams=10000;"
+      "rsocket-resume-window=1048576",
+      mimeType);
+
+  auto const parsed = CapacityHints::removeFromMimeType(mimeType);
+  EXPECT_EQ(10000, parsed.streams);
+  EXPECT_EQ(0, parsed.payloadSize);
+  EXPECT_EQ(1 << 20, parsed.resumeWindow);
+  EXPECT_EQ("text/plain", mimeType);
+
+  std::string plain = "text/plain";
+  EXPECT_TRUE(CapacityHints::removeFromMimeType(plain).empty());
+  EXPECT_EQ("text/plain", plain);
+
+  std::string malformed = "text/plain;rsocket-payload-size=lots";
+  EXPECT_TRUE(CapacityHints::removeFromMimeType(malformed).empty());
+  EXPECT_EQ("text/plain", malformed);
+}
+
+TEST(CapacityHintsTest, BoundedBy) {
+  CapacityHints hints;
+  hints.streams = 10000;
+  hints.payloadSize = 512;
+  hints.resumeWindow = 1 << 30;
+
+  CapacityHints limits;
+  limits.streams = 4096;
+  limits.payloadSize = 64 * 1024;
+
+  auto const bounded = hints.boundedBy(limits);
+  EXPECT_EQ(4096, bounded.streams);
+  EXPECT_EQ(512, bounded.payloadSize);
+  EXPECT_EQ(0, bounded.resumeWindow);
+}
+
+TEST(CapacityHintsTest, SetupFrame) {
+  SetupParameters params;
+  params.capacityHints.streams = 100;
+  params.capacityHints.payloadSize = 4096;
+
+  FrameSerializerV1_0 serializer;
+  Frame_SETUP frame(
+      FrameFlags::EMPTY_,
+      1,
+      0,
+      1000,
+      Frame_SETUP::kMaxLifetime,
+      params.token,
+      CapacityHints::addToMimeType(
+          params.metadataMimeType, params.capacityHints),
+      params.dataMimeType,
+      Payload());
+
+  Frame_SETUP decoded;
+  ASSERT_TRUE(serializer.deserializeFrom(
+      decoded, serializer.serializeOut(std::move(frame))));
+  SetupParameters received;
+  decoded.moveToSetupPayload(received);
+  EXPECT_EQ("text/plain", received.metadataMimeType);
+  EXPECT_EQ(100, received.capacityHints.streams);
+  EXPECT_EQ(4096, received.capacityHints.payloadSize);
+  EXPECT_EQ(0, received.capacityHints.resumeWindow);
+}
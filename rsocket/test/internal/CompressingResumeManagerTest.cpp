@@ -0,0 +1,142 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <folly/executors/ManualExecutor.h>
+#include <folly/io/IOBuf.h>
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/EventBaseManager.h>
+#include <gmock/gmock.h>
+
+#include <thread>
+
+#include "rsocket/framing/FrameTransportImpl.h"
+#include "rsocket/internal/CompressingResumeManager.h"
+#include "rsocket/test/test_utils/MockDuplexConnection.h"
+
+using namespace ::testing;
+using namespace ::rsocket;
+
+namespace {
+
+class FrameTransportMock : public FrameTransportImpl {
+ public:
+  FrameTransportMock()
+      : FrameTransportImpl(std::make_unique<MockDuplexConnection>()) {}
+
+  void outputFrameOrDrop(std::unique_ptr<folly::IOBuf> frame) override {
+    headrooms.push_back(frame->headroom());
+    sent.push_back(frame->moveToFbString().toStdString());
+  }
+
+  std::vector<std::string> sent;
+  std::vector<size_t> headrooms;
+};
+
+class CompressingResumeManagerTest : public Test {
+ protected:
+  void SetUp() override {
+    if (!folly::io::hasCodec(folly::io::CodecType::ZSTD)) {
+      return; // folly was built without zstd
+    }
+    folly::EventBaseManager::get()->setEventBase(&evb_, false);
+    CompressingResumeManager::Options options;
+    options.idleDelay = std::chrono::milliseconds{1};
+    manager_ = std::make_shared<CompressingResumeManager>(
+        RSocketStats::noop(), folly::getKeepAliveToken(executor_), options);
+  }
+
+  void TearDown() override {
+    manager_.reset();
+    folly::EventBaseManager::get()->clearEventBase();
+  }
+
+  void track(const std::string& frame) {
+    manager_->trackSentFrame(
+        *folly::IOBuf::copyBuffer(frame), FrameType::PAYLOAD, 1, 0);
+  }
+
+  /// Runs the EventBase and the compressor until the buffer is compressed, or
+  /// gives up after a while.
+  void waitForCompression() {
+    for (int i = 0; i < 1000 && !manager_->isCompressed(); ++i) {
+      evb_.loopOnce(EVLOOP_NONBLOCK);
+      executor_.run();
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    }
+  }
+
+  folly::EventBase evb_;
+  folly::ManualExecutor executor_;
+  std::shared_ptr<CompressingResumeManager> manager_;
+};
+
+} // namespace
+
+TEST_F(CompressingResumeManagerTest, CompressesWhileDisconnected) {
+  if (!manager_) {
+    return;
+  }
+  const std::string a(1000, 'a');
+  const std::string b(2000, 'b');
+  track(a);
+  track(b);
+  EXPECT_EQ(3000, manager_->bufferedBytes());
+
+  manager_->onDisconnected();
+  waitForCompression();
+  ASSERT_TRUE(manager_->isCompressed());
+  EXPECT_LT(manager_->bufferedBytes(), 3000);
+  EXPECT_TRUE(manager_->isPositionAvailable(1000));
+  EXPECT_FALSE(manager_->isPositionAvailable(500));
+
+  manager_->onConnected();
+  FrameTransportMock transport;
+  manager_->sendFramesFromPosition(0, transport);
+  EXPECT_FALSE(manager_->isCompressed());
+  EXPECT_EQ((std::vector<std::string>{a, b}), transport.sent);
+  for (auto headroom : transport.headrooms) {
+    EXPECT_GE(headroom, kFrameLengthFieldHeadroom);
+  }
+  EXPECT_EQ(3000, manager_->bufferedBytes());
+}
+
+TEST_F(CompressingResumeManagerTest, ReconnectCancelsCompression) {
+  if (!manager_) {
+    return;
+  }
+  track(std::string(1000, 'a'));
+
+  manager_->onDisconnected();
+  manager_->onConnected();
+  waitForCompression();
+  EXPECT_FALSE(manager_->isCompressed());
+  EXPECT_EQ(1000, manager_->bufferedBytes());
+}
+
+TEST_F(CompressingResumeManagerTest, ResetExpandsFirst) {
+  if (!manager_) {
+    return;
+  }
+  track(std::string(1000, 'a'));
+  track(std::string(1000, 'b'));
+
+  manager_->onDisconnected();
+  waitForCompression();
+  ASSERT_TRUE(manager_->isCompressed());
+
+  manager_->resetUpToPosition(1000);
+  EXPECT_FALSE(manager_->isCompressed());
+  EXPECT_EQ(1000, manager_->firstSentPosition());
+  EXPECT_EQ(1000, manager_->bufferedBytes());
+}
@@ -16,6 +16,9 @@
 
 #include <folly/io/async/EventBase.h>
 
+#include <thread>
+#include <vector>
+
 #include "rsocket/RSocketConnectionEvents.h"
 #include "rsocket/RSocketResponder.h"
 #include "rsocket/RSocketStats.h"
@@ -63,3 +66,69 @@ TEST(ConnectionSet, CloseViaSetDtor) {
   set.insert(machine, &evb);
   machine->registerCloseCallback(&set);
 }
+
+TEST(ConnectionSet, MemoryUsage) {
+  folly::EventBase evb;
+  auto machine = makeStateMachine(&evb);
+  auto other = makeStateMachine(&evb);
+
+  ConnectionSet set;
+  set.insert(machine, &evb);
+  set.insert(other, &evb);
+  machine->registerCloseCallback(&set);
+  other->registerCloseCallback(&set);
+
+  auto usage = set.memoryUsage().via(&evb).getVia(&evb);
+  EXPECT_EQ(machine->memoryUsage().total() * 2, usage.total());
+}
+
+TEST(ConnectionSet, Size) {
+  folly::EventBase evb;
+  auto machine = makeStateMachine(&evb);
+  auto other = makeStateMachine(&evb);
+
+  ConnectionSet set;
+  EXPECT_EQ(0, set.size());
+  set.insert(machine, &evb);
+  set.insert(other, &evb);
+  machine->registerCloseCallback(&set);
+  other->registerCloseCallback(&set);
+  EXPECT_EQ(2, set.size());
+
+  machine->close({}, StreamCompletionSignal::CANCEL);
+  EXPECT_EQ(1, set.size());
+
+  set.shutdownAndWait();
+  EXPECT_EQ(0, set.size());
+  EXPECT_FALSE(set.insert(makeStateMachine(&evb), &evb));
+}
+
+TEST(ConnectionSet, ConcurrentInserts) {
+  constexpr size_t kThreads = 4;
+  constexpr size_t kPerThread = 64;
+
+  folly::EventBase evb;
+  std::vector<std::shared_ptr<RSocketStateMachine>> machines;
+  for (size_t i = 0; i < kThreads * kPerThread; ++i) {
+    machines.push_back(makeStateMachine(&evb));
+  }
+
+  ConnectionSet set;
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t] {
+      for (size_t i = t * kPerThread; i < (t + 1) * kPerThread; ++i) {
+        EXPECT_TRUE(set.insert(machines[i], &evb));
+        machines[i]->registerCloseCallback(&set);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(kThreads * kPerThread, set.size());
+
+  // Closes every machine, each on its EventBase.
+  set.shutdownAndWait();
+  EXPECT_EQ(0, set.size());
+}
@@ -0,0 +1,94 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/EventBaseMonitor.h"
+#include <gtest/gtest.h>
+
+#include <folly/io/async/EventBase.h>
+
+#include <map>
+#include <thread>
+
+using namespace ::rsocket;
+using namespace std::chrono_literals;
+
+namespace {
+
+using Activity = EventBaseMonitor::Activity;
+
+class RecordingStats : public RSocketStats {
+ public:
+  void eventBaseLoopLag(
+      folly::EventBase*,
+      std::chrono::microseconds lag,
+      size_t queueDepth) override {
+    ++reports;
+    maxLag = std::max(maxLag, lag);
+    maxQueueDepth = std::max(maxQueueDepth, queueDepth);
+  }
+
+  void eventBaseActivity(
+      folly::EventBase*,
+      Activity activity,
+      std::chrono::microseconds time) override {
+    times[activity] += time;
+  }
+
+  size_t reports{0};
+  std::chrono::microseconds maxLag{0};
+  size_t maxQueueDepth{0};
+  std::map<Activity, std::chrono::microseconds> times;
+};
+
+} // namespace
+
+TEST(EventBaseMonitorTest, ScopesOutsideMonitoredThreadsDoNothing) {
+  auto stats = std::make_shared<RecordingStats>();
+  folly::EventBase evb;
+  EventBaseMonitor monitor{EventBaseMonitor::Options(), stats};
+  std::thread([&] {
+    EventBaseMonitor::ActivityScope activity{Activity::READ};
+    std::this_thread::sleep_for(1ms);
+    monitor.report(evb, 0ms);
+  }).join();
+  EXPECT_EQ(0ms, stats->times[Activity::READ]);
+}
+
+TEST(EventBaseMonitorTest, ReportsNestedActivities) {
+  auto stats = std::make_shared<RecordingStats>();
+  folly::EventBase evb;
+  EventBaseMonitor::Options options;
+  options.interval = 5ms;
+  auto monitor = EventBaseMonitor::create(evb, options, stats);
+
+  evb.runInEventBaseThread([&] {
+    EventBaseMonitor::ActivityScope read{Activity::READ};
+    std::this_thread::sleep_for(2ms);
+    {
+      EventBaseMonitor::ActivityScope dispatch{Activity::FRAME_DISPATCH};
+      std::this_thread::sleep_for(10ms);
+    }
+    // Keep the loop busy past the next report, so that it comes in late.
+    std::this_thread::sleep_for(10ms);
+  });
+  evb.runAfterDelay([&] { evb.terminateLoopSoon(); }, 50);
+  evb.loopForever();
+
+  EXPECT_GE(stats->reports, 2);
+  EXPECT_GE(stats->maxLag, 5ms);
+  EXPECT_GE(stats->times[Activity::READ], 12ms);
+  EXPECT_LT(stats->times[Activity::READ], 22ms);
+  EXPECT_GE(stats->times[Activity::FRAME_DISPATCH], 10ms);
+  EXPECT_EQ(0ms, stats->times[Activity::WRITE]);
+}
@@ -0,0 +1,172 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/FrameChecksums.h"
+#include <gtest/gtest.h>
+
+#include <folly/io/IOBuf.h>
+
+#include "rsocket/framing/FrameSerializer_v1_0.h"
+#include "rsocket/framing/FramedReader.h"
+#include "rsocket/test/test_utils/MockDuplexConnection.h"
+
+using namespace ::rsocket;
+using namespace ::testing;
+using namespace ::yarpl::mocks;
+
+namespace {
+
+std::unique_ptr<folly::IOBuf> payloadFrame(StreamId streamId) {
+  return FrameSerializerV1_0().serializeOut(Frame_PAYLOAD(
+      streamId, FrameFlags::NEXT, Payload("some data", "some metadata")));
+}
+
+std::string toString(const folly::IOBuf& buf) {
+  return buf.cloneAsValue().moveToFbString().toStdString();
+}
+
+} // namespace
+
+TEST(FrameChecksumsTest, MimeTypeParameter) {
+  auto mimeType =
+      FrameChecksums::addToMimeType("text/plain", FrameChecksums::kCrc32c);
+  EXPECT_EQ("text/plain;rsocket-frame-checksum=crc32c", mimeType);
+  EXPECT_EQ("crc32c", FrameChecksums::removeFromMimeType(mimeType));
+  EXPECT_EQ("text/plain", mimeType);
+
+  std::string plain = "text/plain";
+  EXPECT_EQ("", FrameChecksums::removeFromMimeType(plain));
+  EXPECT_EQ("text/plain", plain);
+
+  EXPECT_TRUE(FrameChecksums::isSupported("crc32c"));
+  EXPECT_FALSE(FrameChecksums::isSupported("adler32"));
+}
+
+TEST(FrameChecksumsTest, AppendAndRemove) {
+  auto frame = payloadFrame(1);
+  auto const original = toString(*frame);
+
+  FrameSerializerV1_0::appendChecksum(*frame);
+  EXPECT_EQ(
+      original.size() + FrameSerializerV1_0::kChecksumSize,
+      frame->computeChainDataLength());
+
+  EXPECT_TRUE(FrameSerializerV1_0::removeChecksum(*frame));
+  EXPECT_EQ(original, toString(*frame));
+}
+
+TEST(FrameChecksumsTest, SharedBufferIsNotWritten) {
+  auto frame = payloadFrame(1);
+  auto const copy = frame->clone();
+  auto const original = toString(*copy);
+
+  FrameSerializerV1_0::appendChecksum(*frame);
+  EXPECT_EQ(original, toString(*copy));
+  EXPECT_TRUE(FrameSerializerV1_0::removeChecksum(*frame));
+  EXPECT_EQ(original, toString(*frame));
+}
+
+TEST(FrameChecksumsTest, ChecksumSpansBuffers) {
+  auto frame = payloadFrame(1);
+  FrameSerializerV1_0::appendChecksum(*frame);
+  auto const bytes = toString(*frame);
+
+  // One buffer per byte, so that the trailer straddles four of them.
+  auto chain = folly::IOBuf::copyBuffer(bytes.data(), 1);
+  for (size_t i = 1; i < bytes.size(); ++i) {
+    chain->prependChain(folly::IOBuf::copyBuffer(bytes.data() + i, 1));
+  }
+  EXPECT_EQ(
+      FrameSerializerV1_0::checksum(*frame, bytes.size()),
+      FrameSerializerV1_0::checksum(*chain, bytes.size()));
+
+  EXPECT_TRUE(FrameSerializerV1_0::removeChecksum(*chain));
+  EXPECT_EQ(
+      bytes.substr(0, bytes.size() - FrameSerializerV1_0::kChecksumSize),
+      toString(*chain));
+}
+
+TEST(FrameChecksumsTest, Mismatch) {
+  auto frame = payloadFrame(1);
+  FrameSerializerV1_0::appendChecksum(*frame);
+  auto corrupted = folly::IOBuf::copyBuffer(toString(*frame));
+  corrupted->writableData()[FrameSerializerV1_0::kFrameHeaderSize] ^= 0x01;
+  auto const length = corrupted->computeChainDataLength();
+
+  EXPECT_FALSE(FrameSerializerV1_0::removeChecksum(*corrupted));
+  EXPECT_EQ(length, corrupted->computeChainDataLength());
+
+  auto tooShort = folly::IOBuf::copyBuffer("abcd");
+  EXPECT_FALSE(FrameSerializerV1_0::removeChecksum(*tooShort));
+}
+
+TEST(FrameChecksumsTest, ExemptFrames) {
+  FrameSerializerV1_0 serializer;
+  EXPECT_TRUE(FrameSerializerV1_0::carriesChecksum(*payloadFrame(1)));
+  EXPECT_TRUE(FrameSerializerV1_0::carriesChecksum(
+      *serializer.serializeOut(Frame_REQUEST_N(1, 10))));
+  EXPECT_FALSE(FrameSerializerV1_0::carriesChecksum(
+      *serializer.serializeOut(Frame_RESUME_OK(0))));
+  EXPECT_FALSE(FrameSerializerV1_0::carriesChecksum(
+      *serializer.serializeOut(Frame_SETUP(
+          FrameFlags::EMPTY_,
+          1,
+          0,
+          Frame_SETUP::kMaxKeepaliveTime,
+          Frame_SETUP::kMaxLifetime,
+          ResumeIdentificationToken(),
+          "text/plain",
+          "text/plain",
+          Payload()))));
+}
+
+TEST(FrameChecksumsTest, FramedReaderStripsAndChecks) {
+  auto version = std::make_shared<ProtocolVersion>(ProtocolVersion::Latest);
+  auto reader = std::make_shared<FramedReader>(version);
+  reader->enableFrameChecksums();
+
+  auto frame = payloadFrame(1);
+  auto const original = toString(*frame);
+  FrameSerializerV1_0::appendChecksum(*frame);
+  auto const bytes = toString(*frame);
+
+  // A good frame, followed by the same frame with its last byte flipped,
+  // each preceded by its 3-byte length.
+  std::string input;
+  for (auto corrupt : {false, true}) {
+    input += static_cast<char>(bytes.size() >> 16);
+    input += static_cast<char>(bytes.size() >> 8);
+    input += static_cast<char>(bytes.size());
+    input += bytes;
+    if (corrupt) {
+      input.back() ^= 0x01;
+    }
+  }
+
+  auto subscriber = std::make_shared<
+      StrictMock<MockSubscriber<std::unique_ptr<folly::IOBuf>>>>();
+  std::vector<std::string> frames;
+  EXPECT_CALL(*subscriber, onSubscribe_(_));
+  EXPECT_CALL(*subscriber, onNext_(_))
+      .WillOnce(Invoke([&](const std::unique_ptr<folly::IOBuf>& next) {
+        frames.push_back(toString(*next));
+      }));
+  EXPECT_CALL(*subscriber, onError_(_));
+
+  reader->onSubscribe(yarpl::flowable::Subscription::create());
+  reader->setInput(subscriber);
+  reader->onNext(folly::IOBuf::copyBuffer(input));
+
+  EXPECT_EQ(std::vector<std::string>{original}, frames);
+}
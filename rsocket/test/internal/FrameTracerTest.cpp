@@ -0,0 +1,125 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <sstream>
+#include <thread>
+
+#include "rsocket/internal/FrameTracer.h"
+
+using namespace rsocket;
+
+namespace {
+
+/// The events of the rings that belong to the given stream.  The rings are
+/// shared by all the tests, so every test uses streams of its own.
+std::vector<FrameTracer::Event> eventsOf(StreamId streamId) {
+  auto events = FrameTracer::dump();
+  events.erase(
+      std::remove_if(
+          events.begin(),
+          events.end(),
+          [&](const FrameTracer::Event& event) {
+            return event.streamId != streamId;
+          }),
+      events.end());
+  return events;
+}
+
+class FrameTracerTest : public testing::Test {
+ protected:
+  void TearDown() override {
+    FrameTracer::setSampleRate(0);
+  }
+};
+
+} // namespace
+
+TEST_F(FrameTracerTest, DisabledByDefault) {
+  EXPECT_FALSE(FrameTracer::enabled());
+  EXPECT_FALSE(FrameTracer::sampled(1));
+}
+
+TEST_F(FrameTracerTest, SamplesOneInN) {
+  FrameTracer::setSampleRate(4);
+  EXPECT_TRUE(FrameTracer::enabled());
+  EXPECT_FALSE(FrameTracer::sampled(0));
+
+  size_t sampled = 0;
+  for (StreamId streamId = 1; streamId < 1 + 2 * 400; streamId += 2) {
+    sampled += FrameTracer::sampled(streamId) ? 1 : 0;
+  }
+  EXPECT_EQ(100, sampled);
+
+  FrameTracer::setSampleRate(1);
+  EXPECT_TRUE(FrameTracer::sampled(2));
+  EXPECT_TRUE(FrameTracer::sampled(3));
+}
+
+TEST_F(FrameTracerTest, DumpsInOrder) {
+  const StreamId streamId = 1001;
+  FrameTracer::record(
+      FrameTracer::Point::PARSED, streamId, FrameType::REQUEST_RESPONSE, 20);
+  FrameTracer::record(
+      FrameTracer::Point::SOCKET_READ,
+      streamId,
+      FrameType::REQUEST_RESPONSE,
+      10);
+  FrameTracer::record(
+      FrameTracer::Point::WRITTEN, streamId, FrameType::PAYLOAD, 30);
+
+  auto const events = eventsOf(streamId);
+  ASSERT_EQ(3, events.size());
+  EXPECT_EQ(FrameTracer::Point::SOCKET_READ, events[0].point);
+  EXPECT_EQ(FrameType::REQUEST_RESPONSE, events[0].type);
+  EXPECT_EQ(10, events[0].nanos);
+  EXPECT_EQ(FrameTracer::Point::PARSED, events[1].point);
+  EXPECT_EQ(FrameTracer::Point::WRITTEN, events[2].point);
+  EXPECT_EQ(FrameType::PAYLOAD, events[2].type);
+
+  std::ostringstream os;
+  FrameTracer::print(os, events);
+  EXPECT_NE(std::string::npos, os.str().find("stream 1001"));
+  EXPECT_NE(std::string::npos, os.str().find("WRITTEN"));
+}
+
+TEST_F(FrameTracerTest, KeepsEventsOfExitedThreads) {
+  const StreamId streamId = 1003;
+  std::thread([&] {
+    FrameTracer::record(
+        FrameTracer::Point::DISPATCHED, streamId, FrameType::REQUEST_N);
+  }).join();
+
+  auto const events = eventsOf(streamId);
+  ASSERT_EQ(1, events.size());
+  EXPECT_EQ(FrameTracer::Point::DISPATCHED, events[0].point);
+  EXPECT_EQ(FrameType::REQUEST_N, events[0].type);
+}
+
+TEST_F(FrameTracerTest, RingKeepsLastEvents) {
+  const StreamId streamId = 1005;
+  std::thread([&] {
+    for (size_t i = 0; i < FrameTracer::kRingSize + 10; ++i) {
+      FrameTracer::record(
+          FrameTracer::Point::SERIALIZED, streamId, FrameType::PAYLOAD, i);
+    }
+  }).join();
+
+  auto const events = eventsOf(streamId);
+  ASSERT_EQ(FrameTracer::kRingSize, events.size());
+  EXPECT_EQ(10, events.front().nanos);
+  EXPECT_EQ(FrameTracer::kRingSize + 9, events.back().nanos);
+}
@@ -41,6 +41,14 @@ class MockConnectionAutomaton : public FrameSink {
   void disconnectOrCloseWithError(Frame_ERROR&& error) override {
     disconnectOrCloseWithError_(error);
   }
+
+  bool needsKeepaliveFrames() const override {
+    return needsKeepaliveFrames_;
+  }
+
+  MOCK_METHOD0(keepaliveSuppressed, void());
+
+  bool needsKeepaliveFrames_{true};
 };
 } // namespace
 
@@ -84,3 +92,50 @@ TEST(FollyKeepaliveTimerTest, NoResponse) {
 
   timer.stop();
 }
+
+TEST(FollyKeepaliveTimerTest, SkippedWhileFramesArrive) {
+  auto connectionAutomaton =
+      std::make_shared<StrictMock<MockConnectionAutomaton>>();
+  connectionAutomaton->needsKeepaliveFrames_ = false;
+
+  EXPECT_CALL(*connectionAutomaton, sendKeepalive_(_)).Times(0);
+  EXPECT_CALL(*connectionAutomaton, keepaliveSuppressed()).Times(2);
+
+  folly::EventBase eventBase;
+
+  KeepaliveTimer timer(std::chrono::milliseconds(50), eventBase);
+
+  timer.start(connectionAutomaton);
+
+  // Frames arrive within both of the periods that end before the timer is
+  // stopped.
+  timer.frameReceived();
+  eventBase.runAfterDelay([&] { timer.frameReceived(); }, 70);
+  eventBase.runAfterDelay([&] { eventBase.terminateLoopSoon(); }, 130);
+  eventBase.loopForever();
+
+  timer.stop();
+}
+
+TEST(FollyKeepaliveTimerTest, SentWhileFramesArriveByDefault) {
+  auto connectionAutomaton =
+      std::make_shared<StrictMock<MockConnectionAutomaton>>();
+
+  // Like a client consuming a stream from the server, which the server
+  // can't tell apart from a dead one but by its keepalives.
+  EXPECT_CALL(*connectionAutomaton, sendKeepalive_(_)).Times(2);
+  EXPECT_CALL(*connectionAutomaton, keepaliveSuppressed()).Times(0);
+
+  folly::EventBase eventBase;
+
+  KeepaliveTimer timer(std::chrono::milliseconds(50), eventBase);
+
+  timer.start(connectionAutomaton);
+
+  timer.frameReceived();
+  eventBase.runAfterDelay([&] { timer.frameReceived(); }, 70);
+  eventBase.runAfterDelay([&] { eventBase.terminateLoopSoon(); }, 130);
+  eventBase.loopForever();
+
+  timer.stop();
+}
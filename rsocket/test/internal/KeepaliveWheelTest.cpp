@@ -0,0 +1,141 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/KeepaliveWheel.h"
+
+#include <folly/io/async/EventBase.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <functional>
+#include <vector>
+
+using namespace ::rsocket;
+
+namespace {
+
+struct TestEntry : public KeepaliveWheel::Entry {
+  explicit TestEntry(std::function<void()> onExpired = nullptr)
+      : onExpired_(std::move(onExpired)) {}
+
+  void expired() override {
+    ++fired;
+    if (onExpired_) {
+      onExpired_();
+    }
+  }
+
+  size_t fired{0};
+  std::function<void()> onExpired_;
+};
+
+void runFor(folly::EventBase& evb, std::chrono::milliseconds duration) {
+  evb.runAfterDelay(
+      [&evb] { evb.terminateLoopSoon(); },
+      static_cast<uint32_t>(duration.count()));
+  evb.loopForever();
+}
+
+} // namespace
+
+TEST(KeepaliveWheelTest, FiresOnce) {
+  folly::EventBase evb;
+  auto& wheel = KeepaliveWheel::get(evb);
+  EXPECT_EQ(&wheel, &KeepaliveWheel::get(evb));
+
+  TestEntry entry;
+  wheel.schedule(entry, std::chrono::milliseconds{20});
+  EXPECT_EQ(1, wheel.size());
+
+  runFor(evb, std::chrono::milliseconds{100});
+  EXPECT_EQ(1, entry.fired);
+  EXPECT_EQ(0, wheel.size());
+}
+
+TEST(KeepaliveWheelTest, Cancel) {
+  folly::EventBase evb;
+  auto& wheel = KeepaliveWheel::get(evb);
+
+  TestEntry entry;
+  wheel.schedule(entry, std::chrono::milliseconds{20});
+  wheel.cancel(entry);
+  wheel.cancel(entry);
+  EXPECT_EQ(0, wheel.size());
+
+  runFor(evb, std::chrono::milliseconds{60});
+  EXPECT_EQ(0, entry.fired);
+}
+
+TEST(KeepaliveWheelTest, RescheduleMovesEntry) {
+  folly::EventBase evb;
+  auto& wheel = KeepaliveWheel::get(evb);
+
+  TestEntry entry;
+  wheel.schedule(entry, std::chrono::milliseconds{20});
+  wheel.schedule(entry, std::chrono::milliseconds{500});
+  EXPECT_EQ(1, wheel.size());
+
+  runFor(evb, std::chrono::milliseconds{100});
+  EXPECT_EQ(0, entry.fired);
+  wheel.cancel(entry);
+}
+
+TEST(KeepaliveWheelTest, FiresAllDueInOnePass) {
+  folly::EventBase evb;
+  auto& wheel = KeepaliveWheel::get(evb);
+
+  std::vector<TestEntry> entries(100);
+  for (auto& entry : entries) {
+    wheel.schedule(entry, std::chrono::milliseconds{20});
+  }
+  EXPECT_EQ(entries.size(), wheel.size());
+
+  runFor(evb, std::chrono::milliseconds{100});
+  for (auto& entry : entries) {
+    EXPECT_EQ(1, entry.fired);
+  }
+}
+
+TEST(KeepaliveWheelTest, LongerThanARevolution) {
+  folly::EventBase evb;
+  auto& wheel = KeepaliveWheel::get(evb);
+
+  // Lands in a slot that comes due a couple of times before the entry does.
+  auto const revolution = KeepaliveWheel::kTick * KeepaliveWheel::kSlots;
+  TestEntry entry;
+  wheel.schedule(entry, revolution + std::chrono::milliseconds{20});
+
+  runFor(evb, std::chrono::milliseconds{100});
+  EXPECT_EQ(0, entry.fired);
+  EXPECT_EQ(1, wheel.size());
+  wheel.cancel(entry);
+}
+
+TEST(KeepaliveWheelTest, RescheduleFromExpired) {
+  folly::EventBase evb;
+  auto& wheel = KeepaliveWheel::get(evb);
+
+  TestEntry* self = nullptr;
+  TestEntry entry([&] {
+    if (self->fired < 3) {
+      wheel.schedule(*self, std::chrono::milliseconds{10});
+    }
+  });
+  self = &entry;
+  wheel.schedule(entry, std::chrono::milliseconds{10});
+
+  runFor(evb, std::chrono::milliseconds{200});
+  EXPECT_EQ(3, entry.fired);
+  EXPECT_EQ(0, wheel.size());
+}
@@ -0,0 +1,62 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/LeaseBudget.h"
+#include <gtest/gtest.h>
+
+using namespace ::rsocket;
+using namespace std::chrono_literals;
+
+TEST(LeaseBudgetTest, NoLease) {
+  LeaseBudget budget;
+  EXPECT_FALSE(budget.available());
+  EXPECT_FALSE(budget.tryConsume());
+}
+
+TEST(LeaseBudgetTest, ConsumesRequests) {
+  auto const now = LeaseBudget::Clock::now();
+  LeaseBudget budget;
+  budget.grant(1000ms, 2, now);
+
+  EXPECT_TRUE(budget.tryConsume(now));
+  EXPECT_EQ(1, budget.remaining());
+  EXPECT_TRUE(budget.tryConsume(now));
+  EXPECT_FALSE(budget.tryConsume(now));
+  EXPECT_EQ(0, budget.remaining());
+}
+
+TEST(LeaseBudgetTest, Expires) {
+  auto const now = LeaseBudget::Clock::now();
+  LeaseBudget budget;
+  budget.grant(1000ms, 10, now);
+
+  EXPECT_TRUE(budget.available(now + 999ms));
+  EXPECT_FALSE(budget.available(now + 1000ms));
+  EXPECT_FALSE(budget.tryConsume(now + 1000ms));
+  EXPECT_EQ(10, budget.remaining());
+}
+
+TEST(LeaseBudgetTest, GrantReplacesLease) {
+  auto const now = LeaseBudget::Clock::now();
+  LeaseBudget budget;
+  budget.grant(1000ms, 10, now);
+  budget.grant(1000ms, 1, now + 500ms);
+
+  EXPECT_TRUE(budget.tryConsume(now + 1200ms));
+  EXPECT_FALSE(budget.tryConsume(now + 1200ms));
+
+  budget.grant(1000ms, 5, now);
+  budget.clear();
+  EXPECT_FALSE(budget.available(now));
+}
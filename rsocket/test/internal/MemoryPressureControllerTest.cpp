@@ -0,0 +1,162 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/MemoryPressureController.h"
+#include <gtest/gtest.h>
+
+#include <folly/io/async/EventBase.h>
+
+#include <atomic>
+#include <limits>
+#include <vector>
+
+#include "rsocket/internal/Common.h"
+
+using namespace ::rsocket;
+using namespace std::chrono_literals;
+
+using Level = MemoryPressureController::Level;
+
+namespace {
+
+MemoryPressureController::Options options() {
+  MemoryPressureController::Options opts;
+  opts.elevatedBytes = 1000;
+  opts.highBytes = 2000;
+  opts.criticalBytes = 3000;
+  opts.hysteresis = 0.1;
+  opts.elevatedRequestN = 64;
+  opts.highRequestN = 8;
+  opts.highResumeBufferBytes = 4096;
+  return opts;
+}
+
+class LevelStats : public RSocketStats {
+ public:
+  void memoryPressureChanged(MemoryPressure level, size_t) override {
+    levels.push_back(level);
+  }
+
+  std::vector<MemoryPressure> levels;
+};
+
+} // namespace
+
+TEST(MemoryPressureControllerTest, NoPressureByDefault) {
+  MemoryPressureController controller{options()};
+  EXPECT_EQ(Level::NONE, controller.level());
+  EXPECT_EQ(static_cast<size_t>(kMaxRequestN), controller.maxRequestN());
+  EXPECT_EQ(
+      std::numeric_limits<size_t>::max(), controller.maxResumeBufferBytes());
+  EXPECT_TRUE(controller.acceptConnections());
+  EXPECT_TRUE(controller.admitStreams());
+}
+
+TEST(MemoryPressureControllerTest, DegradesProgressively) {
+  MemoryPressureController controller{options()};
+
+  controller.sample(1000);
+  EXPECT_EQ(Level::ELEVATED, controller.level());
+  EXPECT_EQ(64, controller.maxRequestN());
+  EXPECT_EQ(
+      std::numeric_limits<size_t>::max(), controller.maxResumeBufferBytes());
+  EXPECT_TRUE(controller.acceptConnections());
+
+  controller.sample(2500);
+  EXPECT_EQ(Level::HIGH, controller.level());
+  EXPECT_EQ(8, controller.maxRequestN());
+  EXPECT_EQ(4096, controller.maxResumeBufferBytes());
+  EXPECT_FALSE(controller.acceptConnections());
+  EXPECT_TRUE(controller.admitStreams());
+
+  controller.sample(3000);
+  EXPECT_EQ(Level::CRITICAL, controller.level());
+  EXPECT_FALSE(controller.admitStreams());
+
+  // Levels can be skipped on the way down.
+  controller.sample(100);
+  EXPECT_EQ(Level::NONE, controller.level());
+  EXPECT_TRUE(controller.admitStreams());
+  EXPECT_TRUE(controller.acceptConnections());
+}
+
+TEST(MemoryPressureControllerTest, Hysteresis) {
+  MemoryPressureController controller{options()};
+
+  controller.sample(2000);
+  EXPECT_EQ(Level::HIGH, controller.level());
+
+  // Within 10% of the threshold of HIGH.
+  controller.sample(1900);
+  EXPECT_EQ(Level::HIGH, controller.level());
+
+  // Past the margin of HIGH, but within the one of ELEVATED.
+  controller.sample(950);
+  EXPECT_EQ(Level::ELEVATED, controller.level());
+  controller.sample(900);
+  EXPECT_EQ(Level::NONE, controller.level());
+
+  // Going up isn't delayed.
+  controller.sample(1000);
+  EXPECT_EQ(Level::ELEVATED, controller.level());
+}
+
+TEST(MemoryPressureControllerTest, DisabledLevels) {
+  MemoryPressureController::Options opts;
+  opts.criticalBytes = 1000;
+  MemoryPressureController controller{opts};
+
+  controller.sample(999);
+  EXPECT_EQ(Level::NONE, controller.level());
+  controller.sample(1000);
+  EXPECT_EQ(Level::CRITICAL, controller.level());
+}
+
+TEST(MemoryPressureControllerTest, ReportsChanges) {
+  auto stats = std::make_shared<LevelStats>();
+  MemoryPressureController controller{options(), stats};
+
+  controller.sample(1500);
+  controller.sample(1600);
+  controller.sample(3500);
+  controller.sample(0);
+  EXPECT_EQ(
+      (std::vector<Level>{
+          Level::ELEVATED, Level::CRITICAL, Level::NONE}),
+      stats->levels);
+}
+
+TEST(MemoryPressureControllerTest, SamplesUsage) {
+  folly::EventBase evb;
+  auto opts = options();
+  opts.sampleInterval = 1ms;
+  std::atomic<size_t> usage{2500};
+  auto controller = MemoryPressureController::create(
+      evb, opts, RSocketStats::noop(), [&] { return usage.load(); });
+
+  evb.runAfterDelay([&] { evb.terminateLoopSoon(); }, 20);
+  evb.loopForever();
+  EXPECT_EQ(Level::HIGH, controller->level());
+
+  usage = 0;
+  evb.runAfterDelay([&] { evb.terminateLoopSoon(); }, 20);
+  evb.loopForever();
+  EXPECT_EQ(Level::NONE, controller->level());
+}
+
+TEST(MemoryPressureControllerTest, ResidentSetBytes) {
+#ifdef __linux__
+  EXPECT_GT(MemoryPressureController::residentSetBytes(), 0);
+#endif
+}
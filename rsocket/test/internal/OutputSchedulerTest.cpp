@@ -0,0 +1,184 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/OutputScheduler.h"
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+using namespace ::rsocket;
+
+namespace {
+
+/// A frame of `length` bytes, tagged with the stream it belongs to.
+std::unique_ptr<folly::IOBuf> makeFrame(StreamId streamId, size_t length) {
+  auto frame = folly::IOBuf::copyBuffer(std::string(length, 'x'));
+  *frame->writableData() = static_cast<uint8_t>(streamId);
+  return frame;
+}
+
+StreamId streamOf(const folly::IOBuf& frame) {
+  return *frame.data();
+}
+
+std::vector<StreamId> drain(OutputScheduler& scheduler) {
+  std::vector<StreamId> order;
+  while (auto frame = scheduler.pop()) {
+    order.push_back(streamOf(*frame));
+  }
+  return order;
+}
+
+OutputScheduler::Options makeOptions(size_t quantum) {
+  OutputScheduler::Options options;
+  options.quantum = quantum;
+  return options;
+}
+
+} // namespace
+
+TEST(OutputSchedulerTest, Empty) {
+  OutputScheduler scheduler{makeOptions(100)};
+  EXPECT_TRUE(scheduler.empty());
+  EXPECT_EQ(nullptr, scheduler.pop());
+}
+
+TEST(OutputSchedulerTest, KeepsStreamOrder) {
+  OutputScheduler scheduler{makeOptions(10)};
+  for (size_t i = 1; i <= 3; ++i) {
+    auto frame = makeFrame(1, 20);
+    frame->writableData()[1] = static_cast<uint8_t>(i);
+    scheduler.push(1, std::move(frame));
+  }
+  EXPECT_EQ(3, scheduler.size());
+  EXPECT_EQ(60, scheduler.bytes());
+
+  for (uint8_t i = 1; i <= 3; ++i) {
+    auto frame = scheduler.pop();
+    ASSERT_NE(nullptr, frame);
+    EXPECT_EQ(i, frame->data()[1]);
+  }
+  EXPECT_TRUE(scheduler.empty());
+  EXPECT_EQ(0, scheduler.bytes());
+}
+
+TEST(OutputSchedulerTest, SmallFramesOvertakeBulkStream) {
+  OutputScheduler scheduler{makeOptions(100)};
+  for (int i = 0; i < 4; ++i) {
+    scheduler.push(1, makeFrame(1, 100));
+  }
+  scheduler.push(3, makeFrame(3, 10));
+  scheduler.push(3, makeFrame(3, 10));
+
+  // Stream 1 gets one frame's worth of credit per turn.
+  EXPECT_EQ((std::vector<StreamId>{1, 3, 3, 1, 1, 1}), drain(scheduler));
+}
+
+TEST(OutputSchedulerTest, SharesBandwidthByWeight) {
+  OutputScheduler scheduler{makeOptions(100)};
+  scheduler.setWeight(3, 2);
+  for (int i = 0; i < 4; ++i) {
+    scheduler.push(1, makeFrame(1, 100));
+    scheduler.push(3, makeFrame(3, 100));
+  }
+
+  EXPECT_EQ((std::vector<StreamId>{1, 3, 3, 1, 3, 3, 1, 1}), drain(scheduler));
+}
+
+TEST(OutputSchedulerTest, LargeFramesAccumulateCredit) {
+  OutputScheduler scheduler{makeOptions(10)};
+  scheduler.push(1, makeFrame(1, 35));
+  scheduler.push(3, makeFrame(3, 10));
+  scheduler.push(3, makeFrame(3, 10));
+  scheduler.push(3, makeFrame(3, 10));
+
+  // Stream 1 needs four turns of credit to send its frame.
+  EXPECT_EQ((std::vector<StreamId>{3, 3, 3, 1}), drain(scheduler));
+}
+
+TEST(OutputSchedulerTest, IdleStreamLosesCredit) {
+  OutputScheduler scheduler{makeOptions(100)};
+  scheduler.push(1, makeFrame(1, 10));
+  EXPECT_EQ((std::vector<StreamId>{1}), drain(scheduler));
+
+  // Stream 1 had 90 bytes of credit left, which it doesn't get to keep.
+  scheduler.push(1, makeFrame(1, 100));
+  scheduler.push(1, makeFrame(1, 50));
+  scheduler.push(3, makeFrame(3, 10));
+  EXPECT_EQ((std::vector<StreamId>{1, 3, 1}), drain(scheduler));
+}
+
+TEST(OutputSchedulerTest, EraseWeightKeepsFrames) {
+  OutputScheduler scheduler{makeOptions(100)};
+  scheduler.setWeight(1, 4);
+  scheduler.push(1, makeFrame(1, 10));
+  scheduler.eraseWeight(1);
+
+  EXPECT_EQ((std::vector<StreamId>{1}), drain(scheduler));
+}
+
+TEST(OutputSchedulerTest, EarliestDeadlineFirst) {
+  using namespace std::chrono_literals;
+  auto options = makeOptions(100);
+  options.earliestDeadlineFirst = true;
+  OutputScheduler scheduler{options};
+  auto const now = OutputScheduler::Clock::now();
+  scheduler.setDeadline(3, now + 2h);
+  scheduler.setDeadline(5, now + 1h);
+
+  scheduler.push(1, makeFrame(1, 10));
+  scheduler.push(3, makeFrame(3, 10));
+  scheduler.push(5, makeFrame(5, 10));
+  scheduler.push(3, makeFrame(3, 10));
+  scheduler.push(5, makeFrame(5, 10));
+
+  // Streams without a deadline go last.
+  EXPECT_EQ((std::vector<StreamId>{5, 5, 3, 3, 1}), drain(scheduler));
+  EXPECT_EQ(0, scheduler.takeExpiredFramesDropped());
+}
+
+TEST(OutputSchedulerTest, DropsExpiredFrames) {
+  using namespace std::chrono_literals;
+  auto options = makeOptions(100);
+  options.earliestDeadlineFirst = true;
+  OutputScheduler scheduler{options};
+  auto const now = OutputScheduler::Clock::now();
+  scheduler.setDeadline(1, now - 1ms);
+  scheduler.setDeadline(3, now + 1h);
+
+  scheduler.push(1, makeFrame(1, 10));
+  scheduler.push(1, makeFrame(1, 10));
+  scheduler.push(3, makeFrame(3, 10));
+  EXPECT_EQ((std::vector<StreamId>{3}), drain(scheduler));
+  EXPECT_TRUE(scheduler.empty());
+  EXPECT_EQ(0, scheduler.bytes());
+  EXPECT_EQ(2, scheduler.takeExpiredFramesDropped());
+  EXPECT_EQ(0, scheduler.takeExpiredFramesDropped());
+
+  // Frames queued after the stream is dropped, e.g. its CANCEL, are sent.
+  scheduler.push(3, makeFrame(3, 10));
+  EXPECT_EQ(1, scheduler.dropExpired(3));
+  scheduler.push(3, makeFrame(3, 10));
+  EXPECT_EQ((std::vector<StreamId>{3}), drain(scheduler));
+}
+
+TEST(OutputSchedulerTest, IgnoresDeadlinesUnlessEnabled) {
+  using namespace std::chrono_literals;
+  OutputScheduler scheduler{makeOptions(100)};
+  scheduler.setDeadline(1, OutputScheduler::Clock::now() - 1ms);
+  scheduler.push(1, makeFrame(1, 10));
+  EXPECT_EQ(0, scheduler.dropExpired(1));
+  EXPECT_EQ((std::vector<StreamId>{1}), drain(scheduler));
+}
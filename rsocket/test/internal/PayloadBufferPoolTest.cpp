@@ -0,0 +1,78 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/PayloadBufferPool.h"
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "rsocket/Payload.h"
+
+using namespace ::rsocket;
+
+TEST(PayloadBufferPoolTest, ReusesFreedBuffers) {
+  auto const cached = PayloadBufferPool::cachedBuffers();
+
+  auto buf = Payload::allocate(3000);
+  EXPECT_EQ(Payload::kHeaderHeadroom, buf->headroom());
+  EXPECT_GE(buf->tailroom(), 3000);
+  EXPECT_EQ(0, buf->length());
+  EXPECT_FALSE(buf->isShared());
+  auto const block = buf->buffer();
+
+  buf.reset();
+  EXPECT_EQ(cached + 1, PayloadBufferPool::cachedBuffers());
+
+  // Same size class.
+  buf = Payload::allocate(2500);
+  EXPECT_EQ(block, buf->buffer());
+  EXPECT_EQ(cached, PayloadBufferPool::cachedBuffers());
+}
+
+TEST(PayloadBufferPoolTest, ReturnsToLastReference) {
+  auto const cached = PayloadBufferPool::cachedBuffers();
+
+  auto buf = Payload::allocate(2000);
+  buf->append(100);
+  auto clone = buf->clone();
+  buf.reset();
+  EXPECT_EQ(cached, PayloadBufferPool::cachedBuffers());
+  clone.reset();
+  EXPECT_EQ(cached + 1, PayloadBufferPool::cachedBuffers());
+}
+
+TEST(PayloadBufferPoolTest, SizesOutsideTheClassesAreNotPooled) {
+  auto const cached = PayloadBufferPool::cachedBuffers();
+
+  auto small = Payload::allocate(100);
+  EXPECT_EQ(Payload::kHeaderHeadroom, small->headroom());
+  EXPECT_GE(small->tailroom(), 100);
+  auto large = Payload::allocate(PayloadBufferPool::kMaxClassSize);
+  EXPECT_GE(large->tailroom(), PayloadBufferPool::kMaxClassSize);
+
+  small.reset();
+  large.reset();
+  EXPECT_EQ(cached, PayloadBufferPool::cachedBuffers());
+}
+
+TEST(PayloadBufferPoolTest, FreedOnAnotherThread) {
+  auto buf = Payload::allocate(5000);
+  size_t cachedThere = 0;
+  std::thread([&] {
+    auto const before = PayloadBufferPool::cachedBuffers();
+    buf.reset();
+    cachedThere = PayloadBufferPool::cachedBuffers() - before;
+  }).join();
+  EXPECT_EQ(1, cachedThere);
+}
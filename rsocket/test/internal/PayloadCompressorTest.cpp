@@ -0,0 +1,86 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include "rsocket/RSocketStats.h"
+#include "rsocket/internal/PayloadCompressor.h"
+
+using namespace ::rsocket;
+
+namespace {
+
+std::unique_ptr<PayloadCompressor> makeCompressor(size_t threshold) {
+  auto compressor =
+      PayloadCompressor::create("zstd", RSocketStats::noop(), threshold);
+  if (!compressor) {
+    compressor =
+        PayloadCompressor::create("lz4", RSocketStats::noop(), threshold);
+  }
+  return compressor;
+}
+
+} // namespace
+
+TEST(PayloadCompressorTest, UnknownCodec) {
+  EXPECT_FALSE(PayloadCompressor::create("gzip9000", RSocketStats::noop()));
+}
+
+TEST(PayloadCompressorTest, MimeTypeParameter) {
+  auto mimeType = PayloadCompressor::addToMimeType("application/json", "zstd");
+  EXPECT_EQ("application/json;rsocket-compression=zstd", mimeType);
+  EXPECT_EQ("zstd", PayloadCompressor::removeFromMimeType(mimeType));
+  EXPECT_EQ("application/json", mimeType);
+
+  std::string plain = "text/plain";
+  EXPECT_EQ("", PayloadCompressor::removeFromMimeType(plain));
+  EXPECT_EQ("text/plain", plain);
+
+  std::string withOthers =
+      "text/plain; charset=utf-8; rsocket-compression=lz4; q=1";
+  EXPECT_EQ("lz4", PayloadCompressor::removeFromMimeType(withOthers));
+  EXPECT_EQ("text/plain; charset=utf-8; q=1", withOthers);
+}
+
+TEST(PayloadCompressorTest, RoundTrip) {
+  auto compressor = makeCompressor(64);
+  if (!compressor) {
+    return; // folly was built without zstd and lz4
+  }
+
+  const std::string big(4096, 'x');
+  Payload payload(big, "metadata");
+  compressor->compress(payload);
+  EXPECT_LT(payload.data->computeChainDataLength(), big.size());
+  EXPECT_TRUE(compressor->decompress(payload));
+  EXPECT_EQ(big, payload.moveDataToString());
+  EXPECT_EQ("metadata", payload.moveMetadataToString());
+
+  // Payloads under the threshold are only tagged.
+  Payload small("tiny");
+  compressor->compress(small);
+  EXPECT_EQ(5, small.data->computeChainDataLength());
+  EXPECT_TRUE(compressor->decompress(small));
+  EXPECT_EQ("tiny", small.moveDataToString());
+}
+
+TEST(PayloadCompressorTest, MalformedData) {
+  auto compressor = makeCompressor(64);
+  if (!compressor) {
+    return;
+  }
+
+  Payload payload("\x01garbage");
+  EXPECT_FALSE(compressor->decompress(payload));
+}
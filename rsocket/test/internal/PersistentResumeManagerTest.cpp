@@ -0,0 +1,166 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <folly/executors/ManualExecutor.h>
+#include <folly/io/IOBuf.h>
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/EventBaseManager.h>
+#include <gmock/gmock.h>
+
+#include "rsocket/framing/FrameTransportImpl.h"
+#include "rsocket/internal/PersistentResumeManager.h"
+#include "rsocket/test/test_utils/MockDuplexConnection.h"
+
+using namespace ::testing;
+using namespace ::rsocket;
+
+namespace {
+
+class FrameTransportMock : public FrameTransportImpl {
+ public:
+  FrameTransportMock()
+      : FrameTransportImpl(std::make_unique<MockDuplexConnection>()) {}
+
+  void outputFrameOrDrop(std::unique_ptr<folly::IOBuf> frame) override {
+    sent.push_back(frame->moveToFbString().toStdString());
+  }
+
+  std::vector<std::string> sent;
+};
+
+class CountingResumeStore : public InMemoryResumeStore {
+ public:
+  void commit(Writes writes) override {
+    ++commits;
+    InMemoryResumeStore::commit(std::move(writes));
+  }
+
+  int commits{0};
+};
+
+class PersistentResumeManagerTest : public Test {
+ protected:
+  std::unique_ptr<PersistentResumeManager> makeManager() {
+    return std::make_unique<PersistentResumeManager>(
+        RSocketStats::noop(),
+        store_,
+        "session/",
+        folly::getKeepAliveToken(executor_));
+  }
+
+  void track(PersistentResumeManager& manager, const std::string& frame) {
+    manager.trackSentFrame(
+        *folly::IOBuf::copyBuffer(frame), FrameType::PAYLOAD, 1, 0);
+  }
+
+  std::shared_ptr<CountingResumeStore> store_{
+      std::make_shared<CountingResumeStore>()};
+  folly::ManualExecutor executor_;
+};
+
+} // namespace
+
+TEST_F(PersistentResumeManagerTest, RestoresState) {
+  {
+    auto manager = makeManager();
+    manager->onStreamOpen(
+        1, RequestOriginator::LOCAL, "token", StreamType::STREAM);
+    manager->onStreamOpen(
+        2, RequestOriginator::REMOTE, "closed", StreamType::STREAM);
+    track(*manager, "aaaa");
+    track(*manager, "bbbbbb");
+    manager->trackReceivedFrame(5, FrameType::REQUEST_N, 1, 7);
+    manager->onStreamClosed(2);
+  }
+  // Nothing is written until the writer runs.
+  EXPECT_TRUE(store_->load("session/").empty());
+  executor_.run();
+
+  auto manager = makeManager();
+  EXPECT_EQ(0, manager->firstSentPosition());
+  EXPECT_EQ(10, manager->lastSentPosition());
+  EXPECT_EQ(5, manager->impliedPosition());
+  EXPECT_EQ(1, manager->getLargestUsedStreamId());
+
+  const auto& infos = manager->getStreamResumeInfos();
+  ASSERT_EQ(1, infos.size());
+  EXPECT_EQ("token", infos.at(1).streamToken);
+  EXPECT_EQ(StreamType::STREAM, infos.at(1).streamType);
+  EXPECT_EQ(RequestOriginator::LOCAL, infos.at(1).requester);
+  EXPECT_EQ(7, infos.at(1).consumerAllowance);
+
+  FrameTransportMock transport;
+  manager->sendFramesFromPosition(0, transport);
+  EXPECT_EQ((std::vector<std::string>{"aaaa", "bbbbbb"}), transport.sent);
+}
+
+TEST_F(PersistentResumeManagerTest, ErasesAcknowledgedFrames) {
+  auto manager = makeManager();
+  manager->onStreamOpen(1, RequestOriginator::LOCAL, "", StreamType::STREAM);
+  track(*manager, "aaaa");
+  track(*manager, "bbbbbb");
+  manager->resetUpToPosition(4);
+  executor_.run();
+
+  auto entries = store_->load("session/frame/");
+  ASSERT_EQ(1, entries.size());
+  EXPECT_EQ("bbbbbb", entries.begin()->second);
+
+  manager.reset();
+  executor_.run();
+  manager = makeManager();
+  EXPECT_EQ(4, manager->firstSentPosition());
+  EXPECT_FALSE(manager->isPositionAvailable(0));
+  EXPECT_TRUE(manager->isPositionAvailable(4));
+}
+
+TEST_F(PersistentResumeManagerTest, DropsFramesBeforeGap) {
+  {
+    auto manager = makeManager();
+    manager->onStreamOpen(1, RequestOriginator::LOCAL, "", StreamType::STREAM);
+    track(*manager, "aaaa");
+    track(*manager, "bbbb");
+    track(*manager, "cccc");
+  }
+  executor_.run();
+  // As if the write of the second frame had been lost.
+  store_->commit({{"session/frame/00000000000000000004", folly::none}});
+
+  auto manager = makeManager();
+  EXPECT_EQ(8, manager->firstSentPosition());
+  EXPECT_EQ(12, manager->lastSentPosition());
+  EXPECT_FALSE(manager->isPositionAvailable(0));
+  executor_.run();
+  EXPECT_EQ(1, store_->load("session/frame/").size());
+}
+
+TEST_F(PersistentResumeManagerTest, BatchesWritesPerLoop) {
+  folly::EventBase evb;
+  folly::EventBaseManager::get()->setEventBase(&evb, false);
+
+  auto manager = makeManager();
+  manager->onStreamOpen(1, RequestOriginator::LOCAL, "", StreamType::STREAM);
+  for (int i = 0; i < 10; ++i) {
+    track(*manager, "aaaa");
+  }
+  executor_.run();
+  EXPECT_EQ(0, store_->commits);
+
+  evb.loopOnce();
+  executor_.run();
+  EXPECT_EQ(1, store_->commits);
+  EXPECT_EQ(10, store_->load("session/frame/").size());
+
+  folly::EventBaseManager::get()->clearEventBase();
+}
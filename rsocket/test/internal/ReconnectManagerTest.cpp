@@ -0,0 +1,182 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/ReconnectManager.h"
+#include <gtest/gtest.h>
+
+#include <folly/io/async/EventBase.h>
+
+#include <vector>
+
+using namespace ::rsocket;
+using namespace std::chrono_literals;
+
+namespace {
+
+using Connection = ReconnectManager::Connection;
+
+class RecordingStats : public RSocketStats {
+ public:
+  void reconnectAttempted() override {
+    ++attempts;
+  }
+
+  void reconnected(std::chrono::microseconds, size_t rounds) override {
+    reconnectedAfterRounds.push_back(rounds);
+  }
+
+  void reconnectAbandoned() override {
+    ++abandoned;
+  }
+
+  size_t attempts{0};
+  std::vector<size_t> reconnectedAfterRounds;
+  size_t abandoned{0};
+};
+
+ReconnectOptions fastOptions() {
+  ReconnectOptions options;
+  options.initialBackoff = 1ms;
+  options.maxBackoff = 2ms;
+  return options;
+}
+
+} // namespace
+
+TEST(ReconnectManagerTest, Backoff) {
+  ReconnectOptions options;
+  options.initialBackoff = 10ms;
+  options.maxBackoff = 100ms;
+  options.backoffMultiplier = 2;
+
+  EXPECT_EQ(0ms, ReconnectManager::backoff(options, 0));
+  EXPECT_EQ(10ms, ReconnectManager::backoff(options, 1));
+  EXPECT_EQ(20ms, ReconnectManager::backoff(options, 2));
+  EXPECT_EQ(80ms, ReconnectManager::backoff(options, 4));
+  EXPECT_EQ(100ms, ReconnectManager::backoff(options, 5));
+  EXPECT_EQ(100ms, ReconnectManager::backoff(options, 1000));
+}
+
+TEST(ReconnectManagerTest, ResumesOnFirstConnection) {
+  folly::EventBase evb;
+  auto stats = std::make_shared<RecordingStats>();
+  std::vector<folly::Promise<Connection>> connects;
+  size_t resumes = 0;
+
+  auto options = fastOptions();
+  options.parallelAttempts = 3;
+  auto manager = std::make_shared<ReconnectManager>(
+      evb,
+      options,
+      [&] {
+        connects.emplace_back();
+        return connects.back().getFuture();
+      },
+      [&](Connection) {
+        ++resumes;
+        return folly::makeFuture();
+      },
+      stats);
+
+  manager->onDisconnected();
+  evb.loopOnce();
+  ASSERT_EQ(3, connects.size());
+  EXPECT_EQ(3, stats->attempts);
+
+  // Asking again while reconnecting has no effect.
+  manager->onDisconnected();
+  evb.loopOnce();
+  EXPECT_EQ(3, connects.size());
+
+  connects[1].setException(std::runtime_error("refused"));
+  connects[2].setValue(Connection{nullptr, evb});
+  connects[0].setValue(Connection{nullptr, evb});
+  evb.loop();
+
+  EXPECT_EQ(1, resumes);
+  EXPECT_EQ(std::vector<size_t>{1}, stats->reconnectedAfterRounds);
+}
+
+TEST(ReconnectManagerTest, RetriesFailedResumption) {
+  folly::EventBase evb;
+  auto stats = std::make_shared<RecordingStats>();
+  size_t resumes = 0;
+
+  auto manager = std::make_shared<ReconnectManager>(
+      evb,
+      fastOptions(),
+      [&] { return folly::makeFuture(Connection{nullptr, evb}); },
+      [&](Connection) {
+        if (++resumes == 1) {
+          return folly::makeFuture<folly::Unit>(
+              std::runtime_error("resumption failed"));
+        }
+        return folly::makeFuture();
+      },
+      stats);
+
+  manager->onDisconnected();
+  evb.loop();
+
+  EXPECT_EQ(2, resumes);
+  EXPECT_EQ(std::vector<size_t>{2}, stats->reconnectedAfterRounds);
+}
+
+TEST(ReconnectManagerTest, GivesUp) {
+  folly::EventBase evb;
+  auto stats = std::make_shared<RecordingStats>();
+
+  auto options = fastOptions();
+  options.maxRounds = 3;
+  options.parallelAttempts = 2;
+  auto manager = std::make_shared<ReconnectManager>(
+      evb,
+      options,
+      [] {
+        return folly::makeFuture<Connection>(std::runtime_error("refused"));
+      },
+      [](Connection) { return folly::makeFuture(); },
+      stats);
+
+  manager->onDisconnected();
+  evb.loop();
+
+  EXPECT_EQ(6, stats->attempts);
+  EXPECT_EQ(1, stats->abandoned);
+  EXPECT_TRUE(stats->reconnectedAfterRounds.empty());
+}
+
+TEST(ReconnectManagerTest, StopsWhenClosed) {
+  folly::EventBase evb;
+  size_t connects = 0;
+
+  auto manager = std::make_shared<ReconnectManager>(
+      evb,
+      fastOptions(),
+      [&] {
+        ++connects;
+        return folly::makeFuture<Connection>(std::runtime_error("refused"));
+      },
+      [](Connection) { return folly::makeFuture(); },
+      nullptr);
+
+  manager->onDisconnected();
+  evb.loopOnce();
+  EXPECT_EQ(1, connects);
+
+  // Stops before the next round.
+  manager->onClosed();
+  evb.loop();
+  EXPECT_EQ(1, connects);
+}
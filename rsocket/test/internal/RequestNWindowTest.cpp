@@ -0,0 +1,118 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/RequestNWindow.h"
+#include <gtest/gtest.h>
+
+using namespace ::rsocket;
+using namespace std::chrono_literals;
+
+namespace {
+
+RequestNWindow::Options makeOptions(size_t minWindow, size_t maxWindow) {
+  RequestNWindow::Options options;
+  options.initialWindow = 10;
+  options.minWindow = minWindow;
+  options.maxWindow = maxWindow;
+  options.gain = 2.0;
+  return options;
+}
+
+} // namespace
+
+TEST(RequestNWindowTest, StartsWithInitialWindow) {
+  EXPECT_EQ(10, RequestNWindow(makeOptions(1, 100)).size());
+  EXPECT_EQ(20, RequestNWindow(makeOptions(20, 100)).size());
+  EXPECT_EQ(5, RequestNWindow(makeOptions(1, 5)).size());
+}
+
+TEST(RequestNWindowTest, SizesToBandwidthDelayProduct) {
+  RequestNWindow window{makeOptions(1, 10000)};
+  auto const start = RequestNWindow::Clock::now();
+
+  // A round trip of 10ms, then a payload every millisecond.
+  window.onRequestSent(100, start);
+  for (int i = 0; i <= 10; ++i) {
+    window.onPayload(start + 10ms + i * 1ms);
+  }
+
+  ASSERT_TRUE(window.rtt().hasValue());
+  EXPECT_EQ(RequestNWindow::Clock::duration(10ms), *window.rtt());
+  EXPECT_DOUBLE_EQ(1000.0, window.rate());
+  EXPECT_EQ(20, window.size());
+}
+
+TEST(RequestNWindowTest, KeepsSmallestRecentRtt) {
+  RequestNWindow window{makeOptions(1, 10000)};
+  auto const start = RequestNWindow::Clock::now();
+
+  window.onRequestSent(1, start);
+  window.onPayload(start + 10ms);
+  window.onRequestSent(1, start + 20ms);
+  window.onPayload(start + 50ms);
+  EXPECT_EQ(RequestNWindow::Clock::duration(10ms), *window.rtt());
+
+  // The 10ms sample eventually expires.
+  window.onRequestSent(1, start + 11s);
+  window.onPayload(start + 11s + 30ms);
+  EXPECT_EQ(RequestNWindow::Clock::duration(30ms), *window.rtt());
+}
+
+TEST(RequestNWindowTest, RttSampledFromFirstPayloadOfEachRequest) {
+  RequestNWindow window{makeOptions(1, 10000)};
+  auto const start = RequestNWindow::Clock::now();
+
+  window.onRequestSent(2, start);
+  window.onPayload(start + 20ms);
+  window.onRequestSent(1, start + 30ms);
+  window.onPayload(start + 31ms);
+  EXPECT_EQ(RequestNWindow::Clock::duration(20ms), *window.rtt());
+
+  // The third payload is the first one allowed by the second request.
+  window.onPayload(start + 35ms);
+  EXPECT_EQ(RequestNWindow::Clock::duration(5ms), *window.rtt());
+}
+
+TEST(RequestNWindowTest, ClampsToBounds) {
+  auto const start = RequestNWindow::Clock::now();
+
+  RequestNWindow fast{makeOptions(1, 50)};
+  fast.onRequestSent(1000, start);
+  for (int i = 0; i <= 100; ++i) {
+    fast.onPayload(start + 100ms + i * 1ms);
+  }
+  EXPECT_EQ(50, fast.size());
+
+  RequestNWindow slow{makeOptions(8, 10000)};
+  slow.onRequestSent(10, start);
+  for (int i = 0; i <= 2; ++i) {
+    slow.onPayload(start + 1ms + i * 1s);
+  }
+  EXPECT_EQ(8, slow.size());
+}
+
+TEST(RequestNWindowTest, SmoothsDecreasingRate) {
+  RequestNWindow window{makeOptions(1, 10000)};
+  auto const start = RequestNWindow::Clock::now();
+
+  window.onRequestSent(100, start);
+  for (int i = 0; i <= 10; ++i) {
+    window.onPayload(start + 10ms + i * 1ms);
+  }
+  EXPECT_DOUBLE_EQ(1000.0, window.rate());
+
+  // One payload in the next 100ms: 10 per second.
+  window.onPayload(start + 120ms);
+  EXPECT_DOUBLE_EQ(0.75 * 1000.0 + 0.25 * 10.0, window.rate());
+}
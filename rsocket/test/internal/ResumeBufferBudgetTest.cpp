@@ -0,0 +1,95 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/EventBaseManager.h>
+#include <gmock/gmock.h>
+
+#include "rsocket/framing/FrameSerializer.h"
+#include "rsocket/internal/ResumeBufferBudget.h"
+#include "rsocket/internal/WarmResumeManager.h"
+#include "rsocket/test/test_utils/MockStats.h"
+
+using namespace ::testing;
+using namespace ::rsocket;
+
+namespace {
+
+class ResumeBufferBudgetTest : public Test {
+ protected:
+  void track(WarmResumeManager& manager) {
+    manager.trackSentFrame(*frame_, FrameType::CANCEL, 1, 0);
+  }
+
+  std::unique_ptr<folly::IOBuf> frame_{
+      FrameSerializer::createFrameSerializer(ProtocolVersion(1, 0))
+          ->serializeOut(Frame_CANCEL(0))};
+  const size_t frameSize_{frame_->computeChainDataLength()};
+};
+
+} // namespace
+
+TEST_F(ResumeBufferBudgetTest, TrimsOwnBuffer) {
+  auto budget = std::make_shared<ResumeBufferBudget>(2 * frameSize_);
+  auto stats = std::make_shared<NiceMock<MockStats>>();
+  auto manager =
+      std::make_shared<WarmResumeManager>(stats, 10 * frameSize_, budget);
+
+  track(*manager);
+  track(*manager);
+  EXPECT_EQ(2 * frameSize_, budget->used());
+
+  EXPECT_CALL(*stats, resumeBufferEvictedForBudget(1, frameSize_));
+  track(*manager);
+  EXPECT_FALSE(manager->isPositionAvailable(0));
+  EXPECT_TRUE(manager->isPositionAvailable(frameSize_));
+  EXPECT_EQ(2 * frameSize_, manager->size());
+  EXPECT_EQ(2 * frameSize_, budget->used());
+
+  manager.reset();
+  EXPECT_EQ(0, budget->used());
+}
+
+TEST_F(ResumeBufferBudgetTest, TrimsLeastRecentlyUsedOfLargest) {
+  folly::EventBase evb;
+  folly::EventBaseManager::get()->setEventBase(&evb, false);
+
+  auto budget = std::make_shared<ResumeBufferBudget>(3 * frameSize_);
+  auto idleStats = std::make_shared<StrictMock<MockStats>>();
+  auto busyStats = std::make_shared<NiceMock<MockStats>>();
+  EXPECT_CALL(*idleStats, resumeBufferChanged(_, _)).Times(AnyNumber());
+  auto idle =
+      std::make_shared<WarmResumeManager>(idleStats, 10 * frameSize_, budget);
+  auto busy =
+      std::make_shared<WarmResumeManager>(busyStats, 10 * frameSize_, budget);
+
+  track(*idle);
+  track(*idle);
+  track(*busy);
+  track(*busy);
+  EXPECT_EQ(4 * frameSize_, budget->used());
+
+  // The buffers are as large, so the one that was charged last is spared.
+  // The other one drops its frame on its EventBase.
+  EXPECT_TRUE(idle->isPositionAvailable(0));
+  EXPECT_CALL(*idleStats, resumeBufferEvictedForBudget(1, frameSize_));
+  evb.loopOnce();
+
+  EXPECT_FALSE(idle->isPositionAvailable(0));
+  EXPECT_EQ(frameSize_, idle->size());
+  EXPECT_EQ(2 * frameSize_, busy->size());
+  EXPECT_EQ(3 * frameSize_, budget->used());
+
+  folly::EventBaseManager::get()->clearEventBase();
+}
@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <folly/container/F14Set.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
@@ -27,3 +28,53 @@ TEST(ResumeIdentificationTokenTest, Conversion) {
     CHECK_EQ(token.str(), token2.str());
   }
 }
+
+TEST(ResumeIdentificationTokenTest, Comparison) {
+  auto const token = ResumeIdentificationToken::generateNew();
+  EXPECT_EQ(ResumeIdentificationToken::kInlineSize, token.data().size());
+
+  ResumeIdentificationToken copy;
+  copy.set(std::vector<uint8_t>(token.data().begin(), token.data().end()));
+  EXPECT_EQ(token, copy);
+  EXPECT_EQ(token.hash(), copy.hash());
+
+  // A shorter token with the same bytes, as padded inline.
+  ResumeIdentificationToken shorter;
+  shorter.set(token.data().subpiece(0, token.data().size() - 1));
+  EXPECT_NE(token, shorter);
+  EXPECT_LT(shorter, token);
+
+  EXPECT_EQ(ResumeIdentificationToken(), ResumeIdentificationToken("0x"));
+  EXPECT_LT(
+      ResumeIdentificationToken("0x01ff"), ResumeIdentificationToken("0x02"));
+}
+
+TEST(ResumeIdentificationTokenTest, LongTokens) {
+  auto const hex = "0x" + std::string(2 * 40, 'a');
+  ResumeIdentificationToken const token{hex};
+  EXPECT_EQ(40, token.data().size());
+  EXPECT_EQ(hex, token.str());
+
+  ResumeIdentificationToken other{hex};
+  EXPECT_EQ(token, other);
+  EXPECT_EQ(token.hash(), other.hash());
+  other.set(std::vector<uint8_t>(40, 0xab));
+  EXPECT_NE(token, other);
+
+  other.set(token.data());
+  EXPECT_EQ(token, other);
+}
+
+TEST(ResumeIdentificationTokenTest, F14Key) {
+  folly::F14FastSet<ResumeIdentificationToken> tokens;
+  std::vector<ResumeIdentificationToken> generated;
+  for (int i = 0; i < 100; i++) {
+    generated.push_back(ResumeIdentificationToken::generateNew());
+    tokens.insert(generated.back());
+  }
+  EXPECT_EQ(100, tokens.size());
+  for (auto const& token : generated) {
+    EXPECT_EQ(1, tokens.count(ResumeIdentificationToken(token.str())));
+  }
+  EXPECT_EQ(0, tokens.count(ResumeIdentificationToken()));
+}
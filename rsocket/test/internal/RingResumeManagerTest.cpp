@@ -0,0 +1,142 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <folly/io/IOBuf.h>
+#include <gmock/gmock.h>
+
+#include "rsocket/framing/FrameTransportImpl.h"
+#include "rsocket/internal/RingResumeManager.h"
+#include "rsocket/test/test_utils/MockDuplexConnection.h"
+#include "rsocket/test/test_utils/MockStats.h"
+
+using namespace ::testing;
+using namespace ::rsocket;
+
+namespace {
+
+class FrameTransportMock : public FrameTransportImpl {
+ public:
+  FrameTransportMock()
+      : FrameTransportImpl(std::make_unique<MockDuplexConnection>()) {}
+
+  void outputFrameOrDrop(std::unique_ptr<folly::IOBuf> frame) override {
+    headrooms.push_back(frame->headroom());
+    sent.push_back(frame->moveToFbString().toStdString());
+  }
+
+  std::vector<std::string> sent;
+  std::vector<size_t> headrooms;
+};
+
+void track(RingResumeManager& manager, const std::string& frame) {
+  manager.trackSentFrame(
+      *folly::IOBuf::copyBuffer(frame), FrameType::PAYLOAD, 1, 0);
+}
+
+} // namespace
+
+TEST(RingResumeManagerTest, ReplaysFrames) {
+  RingResumeManager manager(RSocketStats::noop(), 16);
+  FrameTransportMock transport;
+
+  track(manager, "aaaa");
+  track(manager, "bbbbbb");
+  EXPECT_EQ(0, manager.firstSentPosition());
+  EXPECT_EQ(10, manager.lastSentPosition());
+  EXPECT_EQ(10, manager.bufferedBytes());
+  EXPECT_TRUE(manager.isPositionAvailable(0));
+  EXPECT_TRUE(manager.isPositionAvailable(4));
+  EXPECT_TRUE(manager.isPositionAvailable(10));
+  EXPECT_FALSE(manager.isPositionAvailable(2)); // misaligned
+
+  manager.sendFramesFromPosition(0, transport);
+  EXPECT_EQ((std::vector<std::string>{"aaaa", "bbbbbb"}), transport.sent);
+  for (auto headroom : transport.headrooms) {
+    EXPECT_GE(headroom, kFrameLengthFieldHeadroom);
+  }
+
+  transport.sent.clear();
+  manager.sendFramesFromPosition(10, transport);
+  EXPECT_TRUE(transport.sent.empty());
+}
+
+TEST(RingResumeManagerTest, WrapsAround) {
+  RingResumeManager manager(RSocketStats::noop(), 16);
+  FrameTransportMock transport;
+
+  track(manager, "aaaaaaaa");
+  track(manager, "bbbbbb");
+  // Goes past the end of the ring, and evicts the first frame.
+  track(manager, "cccccc");
+  EXPECT_EQ(8, manager.firstSentPosition());
+  EXPECT_EQ(20, manager.lastSentPosition());
+  EXPECT_FALSE(manager.isPositionAvailable(0));
+
+  manager.sendFramesFromPosition(8, transport);
+  EXPECT_EQ((std::vector<std::string>{"bbbbbb", "cccccc"}), transport.sent);
+}
+
+TEST(RingResumeManagerTest, CopiesChainedFrames) {
+  RingResumeManager manager(RSocketStats::noop(), 8);
+  FrameTransportMock transport;
+
+  track(manager, "xxxxxx");
+  auto chain = folly::IOBuf::copyBuffer("ab");
+  chain->prependChain(folly::IOBuf::copyBuffer("cde"));
+  manager.trackSentFrame(*chain, FrameType::PAYLOAD, 1, 0);
+
+  manager.sendFramesFromPosition(6, transport);
+  EXPECT_EQ(std::vector<std::string>{"abcde"}, transport.sent);
+}
+
+TEST(RingResumeManagerTest, ResetAndOversizedFrames) {
+  RingResumeManager manager(RSocketStats::noop(), 8);
+
+  track(manager, "aaa");
+  track(manager, "bbb");
+  manager.resetUpToPosition(3);
+  EXPECT_EQ(3, manager.firstSentPosition());
+  EXPECT_EQ(3, manager.bufferedBytes());
+
+  // A position inside a frame drops the whole frame.
+  manager.resetUpToPosition(4);
+  EXPECT_EQ(6, manager.firstSentPosition());
+  EXPECT_EQ(0, manager.bufferedBytes());
+
+  track(manager, "ccc");
+  track(manager, "dddddddddd");
+  EXPECT_EQ(19, manager.firstSentPosition());
+  EXPECT_EQ(19, manager.lastSentPosition());
+  EXPECT_FALSE(manager.isPositionAvailable(6));
+  EXPECT_TRUE(manager.isPositionAvailable(19));
+}
+
+TEST(RingResumeManagerTest, Stats) {
+  auto stats = std::make_shared<StrictMock<MockStats>>();
+  {
+    InSequence dummy;
+    EXPECT_CALL(*stats, resumeBufferChanged(1, 4));
+    EXPECT_CALL(*stats, resumeBufferChanged(1, 4));
+    // One evicted, one added
+    EXPECT_CALL(*stats, resumeBufferChanged(-1, -4));
+    EXPECT_CALL(*stats, resumeBufferChanged(1, 4));
+    // Destruction
+    EXPECT_CALL(*stats, resumeBufferChanged(-2, -8));
+  }
+
+  RingResumeManager manager(stats, 8);
+  track(manager, "aaaa");
+  track(manager, "bbbb");
+  track(manager, "cccc");
+}
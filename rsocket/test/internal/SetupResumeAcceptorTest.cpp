@@ -15,6 +15,9 @@
 #include <gtest/gtest.h>
 
 #include <folly/io/async/EventBase.h>
+#include <folly/synchronization/Baton.h>
+
+#include <thread>
 
 #include "rsocket/framing/FrameSerializer.h"
 #include "rsocket/framing/FrameTransportImpl.h"
@@ -78,7 +81,24 @@ TEST(SetupResumeAcceptor, ImmediateDtor) {
 TEST(SetupResumeAcceptor, ImmediateClose) {
   folly::EventBase evb;
   SetupResumeAcceptor acceptor{&evb};
-  acceptor.close().get();
+  bool closed = false;
+  acceptor.close([&] { closed = true; });
+  EXPECT_TRUE(closed);
+}
+
+TEST(SetupResumeAcceptor, CloseFromOtherThread) {
+  folly::EventBase evb;
+  SetupResumeAcceptor acceptor{&evb};
+
+  std::thread thread{[&] {
+    folly::Baton<> closed;
+    acceptor.close([&] { closed.post(); });
+    closed.wait();
+    evb.terminateLoopSoon();
+  }};
+
+  evb.loopForever();
+  thread.join();
 }
 
 TEST(SetupResumeAcceptor, CloseWithActiveConnection) {
@@ -105,6 +125,33 @@ TEST(SetupResumeAcceptor, CloseWithActiveConnection) {
   outerInput->onComplete();
 }
 
+TEST(SetupResumeAcceptor, CloseWithManyConnections) {
+  folly::EventBase evb;
+  SetupResumeAcceptor acceptor{&evb};
+
+  std::vector<std::weak_ptr<DuplexConnection::Subscriber>> inputs;
+
+  for (size_t i = 0; i < 10; ++i) {
+    auto connection =
+        std::make_unique<StrictMock<MockDuplexConnection>>([&](auto input) {
+          inputs.push_back(input);
+          input->onSubscribe(yarpl::flowable::Subscription::create());
+        });
+    acceptor.accept(std::move(connection), setupFail, resumeFail);
+  }
+
+  // The acceptor keeps every connection alive until its first frame arrives.
+  for (auto& input : inputs) {
+    EXPECT_FALSE(input.expired());
+  }
+
+  acceptor.close();
+
+  for (auto& input : inputs) {
+    EXPECT_TRUE(input.expired());
+  }
+}
+
 TEST(SetupResumeAcceptor, EarlyComplete) {
   folly::EventBase evb;
   SetupResumeAcceptor acceptor{&evb};
@@ -0,0 +1,150 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <folly/io/IOBuf.h>
+#include <gmock/gmock.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "rsocket/framing/FrameTransportImpl.h"
+#include "rsocket/internal/SpillingResumeManager.h"
+#include "rsocket/test/test_utils/MockDuplexConnection.h"
+
+using namespace ::testing;
+using namespace ::rsocket;
+
+namespace {
+
+class FrameTransportMock : public FrameTransportImpl {
+ public:
+  FrameTransportMock()
+      : FrameTransportImpl(std::make_unique<MockDuplexConnection>()) {}
+
+  void outputFrameOrDrop(std::unique_ptr<folly::IOBuf> frame) override {
+    sent.push_back(frame->moveToFbString().toStdString());
+  }
+
+  std::vector<std::string> sent;
+};
+
+class SpillingResumeManagerTest : public Test {
+ protected:
+  void SetUp() override {
+    char dir[] = "/tmp/rsocket-spill-XXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(dir));
+    options_.directory = dir;
+    options_.memoryCapacity = 8;
+    options_.segmentSize = 16;
+    options_.maxSegments = 2;
+  }
+
+  void TearDown() override {
+    // Fails unless every segment file was unlinked.
+    EXPECT_EQ(0, rmdir(options_.directory.c_str()));
+  }
+
+  SpillingResumeManager::Options options_;
+};
+
+void track(SpillingResumeManager& manager, const std::string& frame) {
+  manager.trackSentFrame(
+      *folly::IOBuf::copyBuffer(frame), FrameType::PAYLOAD, 1, 0);
+}
+
+} // namespace
+
+TEST_F(SpillingResumeManagerTest, SpillsAndReplays) {
+  SpillingResumeManager manager(RSocketStats::noop(), options_);
+  FrameTransportMock transport;
+
+  track(manager, "aaaa");
+  track(manager, "bbbb");
+  EXPECT_EQ(8, manager.bufferedBytes());
+  EXPECT_EQ(0, manager.spilledBytes());
+
+  // Pushes the oldest frames out of memory.
+  track(manager, "cccccc");
+  EXPECT_EQ(6, manager.bufferedBytes());
+  EXPECT_EQ(8, manager.spilledBytes());
+  EXPECT_EQ(0, manager.firstSentPosition());
+  EXPECT_EQ(14, manager.lastSentPosition());
+  EXPECT_TRUE(manager.isPositionAvailable(0));
+  EXPECT_TRUE(manager.isPositionAvailable(4));
+  EXPECT_TRUE(manager.isPositionAvailable(8));
+  EXPECT_TRUE(manager.isPositionAvailable(14));
+  EXPECT_FALSE(manager.isPositionAvailable(2)); // misaligned
+
+  manager.sendFramesFromPosition(0, transport);
+  EXPECT_EQ(
+      (std::vector<std::string>{"aaaa", "bbbb", "cccccc"}), transport.sent);
+
+  transport.sent.clear();
+  manager.sendFramesFromPosition(8, transport);
+  EXPECT_EQ((std::vector<std::string>{"cccccc"}), transport.sent);
+}
+
+TEST_F(SpillingResumeManagerTest, ResetDropsSpilledFrames) {
+  SpillingResumeManager manager(RSocketStats::noop(), options_);
+  FrameTransportMock transport;
+
+  track(manager, "aaaa");
+  track(manager, "bbbb");
+  track(manager, "cccccc");
+
+  // Inside the second frame, so that frame is dropped too.
+  manager.resetUpToPosition(6);
+  EXPECT_EQ(8, manager.firstSentPosition());
+  EXPECT_EQ(0, manager.spilledBytes());
+  EXPECT_FALSE(manager.isPositionAvailable(4));
+
+  manager.sendFramesFromPosition(8, transport);
+  EXPECT_EQ((std::vector<std::string>{"cccccc"}), transport.sent);
+}
+
+TEST_F(SpillingResumeManagerTest, DropsOldestSegment) {
+  SpillingResumeManager manager(RSocketStats::noop(), options_);
+  FrameTransportMock transport;
+
+  // Every frame but the last one is spilled, 16 bytes to a segment.
+  for (char c = 'a'; c <= 'g'; ++c) {
+    track(manager, std::string(8, c));
+  }
+  // Only the last two segments are kept.
+  EXPECT_EQ(16, manager.firstSentPosition());
+  EXPECT_EQ(56, manager.lastSentPosition());
+  EXPECT_EQ(32, manager.spilledBytes());
+  EXPECT_FALSE(manager.isPositionAvailable(8));
+
+  manager.sendFramesFromPosition(16, transport);
+  EXPECT_EQ(
+      (std::vector<std::string>{
+          "cccccccc", "dddddddd", "eeeeeeee", "ffffffff", "gggggggg"}),
+      transport.sent);
+}
+
+TEST_F(SpillingResumeManagerTest, OversizedFrameResets) {
+  SpillingResumeManager manager(RSocketStats::noop(), options_);
+  FrameTransportMock transport;
+
+  track(manager, "aaaa");
+  track(manager, std::string(32, 'b'));
+  EXPECT_EQ(36, manager.firstSentPosition());
+  EXPECT_EQ(36, manager.lastSentPosition());
+  EXPECT_EQ(0, manager.bufferedBytes());
+
+  track(manager, "cccc");
+  manager.sendFramesFromPosition(36, transport);
+  EXPECT_EQ((std::vector<std::string>{"cccc"}), transport.sent);
+}
@@ -0,0 +1,39 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/StackTraceUtils.h"
+#include <gtest/gtest.h>
+
+using namespace ::rsocket;
+
+TEST(StackTraceUtilsTest, OffByDefault) {
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_FALSE(shouldSampleStackTrace());
+  }
+  EXPECT_EQ("", sampledStackTrace());
+}
+
+TEST(StackTraceUtilsTest, SamplesOneInN) {
+  setStackTraceSampling(10);
+  size_t sampled = 0;
+  for (int i = 0; i < 100; ++i) {
+    if (shouldSampleStackTrace()) {
+      ++sampled;
+    }
+  }
+  EXPECT_EQ(10, sampled);
+
+  setStackTraceSampling(0);
+  EXPECT_FALSE(shouldSampleStackTrace());
+}
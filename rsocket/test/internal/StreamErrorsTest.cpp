@@ -0,0 +1,86 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/StreamErrors.h"
+#include <gtest/gtest.h>
+
+#include <folly/io/IOBuf.h>
+
+#include "rsocket/RSocketException.h"
+
+using namespace ::rsocket;
+
+TEST(StreamErrorsTest, CommonErrors) {
+  auto disconnected = StreamErrors::disconnected();
+  EXPECT_TRUE(disconnected.is_compatible_with<std::runtime_error>());
+  EXPECT_STREQ(
+      "RSocket connection is disconnected or closed",
+      disconnected.get_exception()->what());
+  EXPECT_STREQ(
+      disconnected.get_exception()->what(),
+      StreamErrors::disconnected().get_exception()->what());
+
+  EXPECT_TRUE(StreamErrors::outputPaused()
+                  .is_compatible_with<OutputBackpressureException>());
+  EXPECT_STREQ(
+      "Request deadline expired",
+      StreamErrors::deadlineExpired().get_exception()->what());
+}
+
+TEST(StreamErrorsTest, EmptyApplicationError) {
+  StreamErrorCache cache;
+  auto error = cache.error(ErrorCode::APPLICATION_ERROR, Payload());
+  ASSERT_TRUE(error.with_exception([](const ErrorWithPayload& err) {
+    EXPECT_FALSE(err.payload);
+  }));
+
+  auto withEmptyBuffers = cache.error(
+      ErrorCode::APPLICATION_ERROR,
+      Payload(folly::IOBuf::create(0), folly::IOBuf::create(0)));
+  EXPECT_TRUE(withEmptyBuffers.is_compatible_with<ErrorWithPayload>());
+}
+
+TEST(StreamErrorsTest, ApplicationErrorKeepsPayload) {
+  StreamErrorCache cache;
+  auto error =
+      cache.error(ErrorCode::APPLICATION_ERROR, Payload("data", "metadata"));
+  ASSERT_TRUE(error.with_exception([](const ErrorWithPayload& err) {
+    EXPECT_EQ("data", err.payload.cloneDataToString());
+    EXPECT_EQ("metadata", err.payload.cloneMetadataToString());
+  }));
+}
+
+TEST(StreamErrorsTest, RepeatedMessages) {
+  StreamErrorCache cache;
+  auto first = cache.error(ErrorCode::REJECTED, Payload("overloaded"));
+  EXPECT_FALSE(first.is_compatible_with<ErrorWithPayload>());
+  EXPECT_STREQ("overloaded", first.get_exception()->what());
+
+  auto again = cache.error(ErrorCode::REJECTED, Payload("overloaded"));
+  EXPECT_STREQ("overloaded", again.get_exception()->what());
+
+  // Chained buffers compare by their bytes.
+  auto chained = folly::IOBuf::copyBuffer("over");
+  chained->prependChain(folly::IOBuf::copyBuffer("loaded"));
+  auto fromChain =
+      cache.error(ErrorCode::CANCELED, Payload(std::move(chained)));
+  EXPECT_STREQ("overloaded", fromChain.get_exception()->what());
+
+  auto other = cache.error(ErrorCode::REJECTED, Payload("overload"));
+  EXPECT_STREQ("overload", other.get_exception()->what());
+  EXPECT_STREQ("overloaded", first.get_exception()->what());
+
+  auto empty = cache.error(ErrorCode::INVALID, Payload());
+  EXPECT_STREQ("", empty.get_exception()->what());
+}
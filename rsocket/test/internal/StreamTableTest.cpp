@@ -0,0 +1,228 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/StreamTable.h"
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+using namespace ::rsocket;
+
+TEST(StreamTableTest, EmplaceFindErase) {
+  StreamTable<int> table;
+  EXPECT_TRUE(table.empty());
+  EXPECT_EQ(nullptr, table.find(1));
+  EXPECT_FALSE(table.erase(1));
+
+  EXPECT_TRUE(table.emplace(1, 10));
+  EXPECT_TRUE(table.emplace(2, 20));
+  EXPECT_FALSE(table.emplace(1, 11));
+  EXPECT_FALSE(table.emplace(0, 0));
+  EXPECT_EQ(2, table.size());
+
+  ASSERT_NE(nullptr, table.find(1));
+  EXPECT_EQ(10, *table.find(1));
+  EXPECT_EQ(20, table.at(2));
+  EXPECT_EQ(nullptr, table.find(3));
+  EXPECT_THROW(table.at(3), std::out_of_range);
+
+  EXPECT_TRUE(table.erase(1));
+  EXPECT_FALSE(table.contains(1));
+  EXPECT_TRUE(table.contains(2));
+  EXPECT_EQ(1, table.size());
+}
+
+TEST(StreamTableTest, SlotReuseChecksStreamId) {
+  StreamTable<int> table;
+  auto const capacity =
+      static_cast<StreamId>(StreamTable<int>::kInitialLaneCapacity);
+
+  EXPECT_TRUE(table.emplace(1, 1));
+  EXPECT_TRUE(table.erase(1));
+
+  // Maps to the same slot as stream 1.
+  auto const later = 1 + 2 * capacity;
+  EXPECT_TRUE(table.emplace(later, 2));
+  EXPECT_EQ(nullptr, table.find(1));
+  EXPECT_EQ(2, table.at(later));
+}
+
+TEST(StreamTableTest, GrowsOnCollision) {
+  StreamTable<int> table;
+  auto const capacity =
+      static_cast<StreamId>(StreamTable<int>::kInitialLaneCapacity);
+
+  for (StreamId id = 1; id < 8 * capacity; id += 2) {
+    EXPECT_TRUE(table.emplace(id, static_cast<int>(id)));
+  }
+  for (StreamId id = 1; id < 8 * capacity; id += 2) {
+    ASSERT_NE(nullptr, table.find(id));
+    EXPECT_EQ(static_cast<int>(id), *table.find(id));
+  }
+  EXPECT_EQ(4 * capacity, table.size());
+}
+
+TEST(StreamTableTest, SparseIdsOverflow) {
+  StreamTable<int> table;
+  auto const stride =
+      static_cast<StreamId>(2 * StreamTable<int>::kMaxLaneCapacity);
+
+  EXPECT_TRUE(table.emplace(2, 0));
+  EXPECT_TRUE(table.emplace(2 + stride, 1));
+  EXPECT_TRUE(table.emplace(2 + 2 * stride, 2));
+  EXPECT_EQ(3, table.size());
+
+  EXPECT_EQ(0, table.at(2));
+  EXPECT_EQ(1, table.at(2 + stride));
+  EXPECT_EQ(2, table.at(2 + 2 * stride));
+
+  EXPECT_TRUE(table.erase(2 + stride));
+  EXPECT_FALSE(table.contains(2 + stride));
+  EXPECT_EQ(2, table.size());
+}
+
+TEST(StreamTableTest, ExtractAll) {
+  StreamTable<int> table;
+  auto const stride =
+      static_cast<StreamId>(2 * StreamTable<int>::kMaxLaneCapacity);
+
+  table.emplace(1, 1);
+  table.emplace(2, 2);
+  table.emplace(3, 3);
+  table.emplace(2 + stride, 4);
+
+  auto values = table.extractAll();
+  std::sort(values.begin(), values.end());
+  EXPECT_EQ((std::vector<int>{1, 2, 3, 4}), values);
+  EXPECT_TRUE(table.empty());
+  EXPECT_EQ(nullptr, table.find(1));
+  EXPECT_EQ(nullptr, table.find(2 + stride));
+}
+
+TEST(StreamTableTest, SizeWithParityOf) {
+  StreamTable<int> table;
+  auto const stride =
+      static_cast<StreamId>(2 * StreamTable<int>::kMaxLaneCapacity);
+
+  table.emplace(1, 1);
+  table.emplace(3, 3);
+  table.emplace(2, 2);
+  table.emplace(2 + stride, 4);
+  EXPECT_EQ(2, table.sizeWithParityOf(1));
+  EXPECT_EQ(2, table.sizeWithParityOf(2));
+
+  EXPECT_TRUE(table.erase(2 + stride));
+  EXPECT_TRUE(table.erase(3));
+  EXPECT_EQ(1, table.sizeWithParityOf(5));
+  EXPECT_EQ(1, table.sizeWithParityOf(4));
+
+  table.extractAll();
+  EXPECT_EQ(0, table.sizeWithParityOf(1));
+  EXPECT_EQ(0, table.sizeWithParityOf(2));
+}
+
+TEST(StreamTableTest, Reserve) {
+  StreamTable<int> table;
+  table.reserve(1, 1000);
+
+  // Holds the first 1024 streams opened by the client.
+  for (StreamId id = 1; id < 2 * 1024; id += 2) {
+    EXPECT_TRUE(table.emplace(id, static_cast<int>(id)));
+  }
+  EXPECT_TRUE(table.emplace(2, 2));
+  EXPECT_EQ(1025, table.size());
+  EXPECT_EQ(1023, table.at(1023));
+
+  // Grows a lane in use, keeping its streams.
+  table.reserve(2, 4000);
+  EXPECT_EQ(2, table.at(2));
+  table.reserve(1, 1 << 20);
+  EXPECT_EQ(2047, table.at(2047));
+  EXPECT_EQ(1024, table.sizeWithParityOf(1));
+}
+
+TEST(StreamTableTest, LongLivedStreamAmongShortOnes) {
+  StreamTable<int> table;
+  EXPECT_TRUE(table.emplace(1, 1));
+
+  // Every request collides with the long-lived stream once in a while, which
+  // is no reason to grow the lane.
+  for (StreamId id = 3; id < 3 + 2 * 100000; id += 2) {
+    ASSERT_TRUE(table.emplace(id, static_cast<int>(id)));
+    ASSERT_EQ(static_cast<int>(id), table.at(id));
+    ASSERT_TRUE(table.erase(id));
+  }
+  EXPECT_EQ(StreamTable<int>::kInitialLaneCapacity, table.laneCapacity(1));
+  EXPECT_EQ(1, table.size());
+  EXPECT_EQ(1, table.at(1));
+}
+
+TEST(StreamTableTest, SparsePairDoesntGrow) {
+  StreamTable<int> table;
+  EXPECT_TRUE(table.emplace(2, 0));
+  EXPECT_TRUE(table.emplace(2 + (1 << 17), 1));
+  EXPECT_EQ(StreamTable<int>::kInitialLaneCapacity, table.laneCapacity(2));
+  EXPECT_EQ(0, table.at(2));
+  EXPECT_EQ(1, table.at(2 + (1 << 17)));
+}
+
+TEST(StreamTableTest, ShrinksWhenSparse) {
+  StreamTable<int> table;
+  for (StreamId id = 1; id < 2 * 1024; id += 2) {
+    EXPECT_TRUE(table.emplace(id, static_cast<int>(id)));
+  }
+  EXPECT_EQ(1024, table.laneCapacity(1));
+
+  // Keeps every 64th stream, which shrinking may move to the overflow map.
+  for (StreamId id = 1; id < 2 * 1024; id += 2) {
+    if (id % 128 != 1) {
+      EXPECT_TRUE(table.erase(id));
+    }
+  }
+  EXPECT_EQ(16, table.size());
+  EXPECT_GE(128, table.laneCapacity(1));
+  for (StreamId id = 1; id < 2 * 1024; id += 128) {
+    EXPECT_EQ(static_cast<int>(id), table.at(id));
+  }
+
+  for (StreamId id = 1; id < 2 * 1024; id += 128) {
+    EXPECT_TRUE(table.erase(id));
+  }
+  EXPECT_TRUE(table.empty());
+  EXPECT_EQ(StreamTable<int>::kInitialLaneCapacity, table.laneCapacity(1));
+}
+
+TEST(StreamTableTest, ReservedLaneDoesntShrink) {
+  StreamTable<int> table;
+  table.reserve(1, 1000);
+  for (StreamId id = 1; id < 2 * 1024; id += 2) {
+    EXPECT_TRUE(table.emplace(id, static_cast<int>(id)));
+  }
+  for (StreamId id = 1; id < 2 * 1024; id += 2) {
+    EXPECT_TRUE(table.erase(id));
+  }
+  EXPECT_EQ(1024, table.laneCapacity(1));
+}
+
+TEST(StreamTableTest, MaxLaneCapacity) {
+  StreamTable<int> table{50};
+  for (StreamId id = 1; id < 2 * 1000; id += 2) {
+    EXPECT_TRUE(table.emplace(id, static_cast<int>(id)));
+  }
+  EXPECT_EQ(64, table.laneCapacity(1));
+  EXPECT_EQ(1000, table.size());
+  for (StreamId id = 1; id < 2 * 1000; id += 2) {
+    EXPECT_EQ(static_cast<int>(id), table.at(id));
+  }
+}
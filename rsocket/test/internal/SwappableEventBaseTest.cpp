@@ -13,9 +13,16 @@
 // limitations under the License.
 
 #include <folly/ExceptionWrapper.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <folly/synchronization/Baton.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <array>
+#include <atomic>
+#include <thread>
+#include <vector>
+
 #include "rsocket/internal/SwappableEventBase.h"
 
 using SwappableEventBase = rsocket::SwappableEventBase;
@@ -204,4 +211,115 @@ TEST_F(SwappableEbTest, CanDestroySEB) {
   loop_ebs();
 }
 
+TEST_F(SwappableEbTest, NotInEventBaseThreadWhileSwapping) {
+  EB(EbA);
+  EB(EbB);
+
+  SwappableEventBase seb(EbA);
+
+  MAKE_DID_EXEC(t1);
+  seb.runInEventBaseThread([&](auto&) {
+    t1->mark();
+    EXPECT_EQ(&EbA, seb.getEventBaseIfInThread());
+  });
+  loop_ebs();
+
+  // Callbacks enqueued during the swap must go after those still on EbA.
+  seb.setEventBase(EbB);
+  EXPECT_EQ(nullptr, seb.getEventBaseIfInThread());
+
+  // Neither EventBase is looping, so this thread counts as theirs.
+  loop_ebs();
+  EXPECT_EQ(&EbB, seb.getEventBaseIfInThread());
+}
+
+TEST_F(SwappableEbTest, BatchedCallbacksRunInOrder) {
+  EB(EbA);
+
+  SwappableEventBase seb(EbA);
+
+  MAKE_DID_EXEC(t1);
+  MAKE_DID_EXEC(t2);
+  MAKE_DID_EXEC(t3);
+  seb.runInEventBaseThread([&](auto&) { t1->mark(); });
+  seb.runInEventBaseThread([&](auto&) {
+    t2->mark();
+    // Enqueued while the batch runs, so it goes in a batch of its own.
+    seb.runInEventBaseThread([&](auto&) { t3->mark(); });
+  });
+
+  // Running inline would overtake the callbacks waiting to run.
+  EXPECT_EQ(nullptr, seb.getEventBaseIfInThread());
+
+  loop_ebs();
+  EXPECT_EQ(&EbA, seb.getEventBaseIfInThread());
+}
+
+TEST_F(SwappableEbTest, TrySetEventBase) {
+  EB(EbA);
+  EB(EbB);
+
+  SwappableEventBase seb(EbA);
+
+  MAKE_DID_EXEC(t1);
+  seb.runInEventBaseThread([&](auto&) { t1->mark(); });
+
+  // Not while a callback still waits to run on EbA.
+  EXPECT_FALSE(seb.trySetEventBase(EbB, [](auto&) { FAIL(); }));
+  loop_ebs();
+
+  MAKE_DID_EXEC(t2);
+  MAKE_DID_EXEC(t3);
+  EXPECT_TRUE(seb.trySetEventBase(EbB, [&](folly::EventBase& eb) {
+    ASSERT_EQ(&eb, &EbB);
+    t2->mark();
+  }));
+  seb.runInEventBaseThread([&](folly::EventBase& eb) {
+    ASSERT_EQ(&eb, &EbB);
+    t3->mark();
+  });
+  loop_ebs();
+}
+
+TEST(SwappableEventBaseThreads, OrderedAcrossSwapsFromManyThreads) {
+  folly::ScopedEventBaseThread first;
+  folly::ScopedEventBaseThread second;
+  std::array<folly::EventBase*, 2> ebs{
+      {first.getEventBase(), second.getEventBase()}};
+  SwappableEventBase seb(*ebs[0]);
+
+  constexpr int kThreads = 4;
+  constexpr int kCallbacks = 10000;
+  std::vector<int> last(kThreads, -1);
+  std::atomic<int> ran{0};
+  std::atomic<int> outOfOrder{0};
+  folly::Baton<> done;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < kCallbacks; ++i) {
+        seb.runInEventBaseThread([&, t, i](folly::EventBase& eb) {
+          if (!eb.isInEventBaseThread() || last[t] != i - 1) {
+            ++outOfOrder;
+          }
+          last[t] = i;
+          if (++ran == kThreads * kCallbacks) {
+            done.post();
+          }
+        });
+      }
+    });
+  }
+  for (int i = 0; i < 100; ++i) {
+    seb.setEventBase(*ebs[i % 2]);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  done.wait();
+  EXPECT_EQ(0, outOfOrder);
+}
+
 } /* namespace */
@@ -0,0 +1,52 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/ThreadAffinity.h"
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace ::rsocket;
+
+TEST(ThreadAffinityTest, CpuSetsAcrossNumaNodes) {
+  auto const nodes = numaNodeCpus();
+  auto const sets = cpuSetsAcrossNumaNodes(5);
+  if (nodes.empty()) {
+    EXPECT_TRUE(sets.empty());
+    return;
+  }
+
+  ASSERT_EQ(5, sets.size());
+  for (auto const& set : sets) {
+    EXPECT_FALSE(set.empty());
+    EXPECT_NE(nodes.end(), std::find(nodes.begin(), nodes.end(), set));
+  }
+}
+
+TEST(ThreadAffinityTest, PinToEmptySet) {
+  EXPECT_TRUE(pinCurrentThreadToCpus({}));
+  EXPECT_FALSE(pinCurrentThreadToCpus({-1}));
+}
+
+TEST(ThreadAffinityTest, NumaLocalBuffer) {
+  auto buffer = createNumaLocalBuffer(10000);
+  EXPECT_EQ(0, buffer->length());
+  ASSERT_GE(buffer->tailroom(), 10000);
+
+  std::memset(buffer->writableTail(), 'x', 10000);
+  buffer->append(10000);
+  EXPECT_EQ(10000, buffer->computeChainDataLength());
+  EXPECT_EQ('x', buffer->data()[9999]);
+}
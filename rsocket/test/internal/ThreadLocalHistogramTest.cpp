@@ -0,0 +1,85 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/internal/ThreadLocalHistogram.h"
+#include <gtest/gtest.h>
+
+#include <limits>
+#include <thread>
+#include <vector>
+
+using namespace ::rsocket;
+
+TEST(ThreadLocalHistogramTest, Buckets) {
+  EXPECT_EQ(0, ThreadLocalHistogram::bucketOf(0));
+  EXPECT_EQ(3, ThreadLocalHistogram::bucketOf(3));
+  EXPECT_EQ(
+      ThreadLocalHistogram::kBuckets - 1,
+      ThreadLocalHistogram::bucketOf(std::numeric_limits<uint64_t>::max()));
+
+  // Every value lands in a bucket whose bound is at least the value and
+  // within 25% of it.
+  for (uint64_t value = 1; value < (uint64_t(1) << 62); value = value * 3 + 1) {
+    auto const bucket = ThreadLocalHistogram::bucketOf(value);
+    auto const bound = ThreadLocalHistogram::upperBoundOf(bucket);
+    EXPECT_GE(bound, value);
+    EXPECT_LE(bound - value, value / 4);
+    EXPECT_EQ(bucket, ThreadLocalHistogram::bucketOf(bound));
+    EXPECT_EQ(bucket + 1, ThreadLocalHistogram::bucketOf(bound + 1));
+  }
+}
+
+TEST(ThreadLocalHistogramTest, Percentiles) {
+  ThreadLocalHistogram histogram;
+  EXPECT_EQ(0, histogram.snapshot().percentile(0.5));
+
+  for (uint64_t value = 1; value <= 100; ++value) {
+    histogram.record(value);
+  }
+  auto const snapshot = histogram.snapshot();
+  EXPECT_EQ(100, snapshot.count);
+  EXPECT_EQ(5050, snapshot.sum);
+  EXPECT_EQ(100, snapshot.max);
+  EXPECT_DOUBLE_EQ(50.5, snapshot.mean());
+
+  auto const p50 = snapshot.percentile(0.5);
+  EXPECT_GE(p50, 50);
+  EXPECT_LE(p50, 55);
+  EXPECT_EQ(100, snapshot.percentile(1.0));
+  EXPECT_EQ(1, snapshot.percentile(0.0));
+}
+
+TEST(ThreadLocalHistogramTest, AggregatesThreads) {
+  ThreadLocalHistogram histogram;
+  histogram.record(1000);
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&] {
+      for (int j = 0; j < 1000; ++j) {
+        histogram.record(10);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // The threads exited, their counts were kept.
+  auto const snapshot = histogram.snapshot();
+  EXPECT_EQ(4001, snapshot.count);
+  EXPECT_EQ(41000, snapshot.sum);
+  EXPECT_EQ(1000, snapshot.max);
+  EXPECT_EQ(4000, snapshot.buckets[ThreadLocalHistogram::bucketOf(10)]);
+}
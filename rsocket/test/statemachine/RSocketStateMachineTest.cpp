@@ -13,6 +13,9 @@
 // limitations under the License.
 
 #include "rsocket/statemachine/RSocketStateMachine.h"
+#include <algorithm>
+
+#include <folly/io/async/EventBaseManager.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <yarpl/single/SingleSubscriptions.h>
@@ -23,6 +26,8 @@
 #include "rsocket/framing/FrameSerializer_v1_0.h"
 #include "rsocket/framing/FrameTransportImpl.h"
 #include "rsocket/internal/Common.h"
+#include "rsocket/internal/PayloadCompressor.h"
+#include "rsocket/internal/WarmResumeManager.h"
 #include "rsocket/statemachine/ChannelRequester.h"
 #include "rsocket/statemachine/ChannelResponder.h"
 #include "rsocket/statemachine/RequestResponseResponder.h"
@@ -68,6 +73,11 @@ class ResponderMock : public RSocketResponder {
   }
 };
 
+class LeaseSenderMock : public LeaseSender {
+ public:
+  MOCK_METHOD0(nextLease, folly::Optional<Lease>());
+};
+
 struct ConnectionEventsMock : public RSocketConnectionEvents {
   MOCK_METHOD1(onDisconnected, void(const folly::exception_wrapper&));
   MOCK_METHOD0(onStreamsPaused, void());
@@ -77,7 +87,8 @@ class RSocketStateMachineTest : public Test {
  public:
   auto createClient(
       std::unique_ptr<MockDuplexConnection> connection,
-      std::shared_ptr<RSocketResponder> responder) {
+      std::shared_ptr<RSocketResponder> responder,
+      SetupParameters setupParameters = SetupParameters()) {
     EXPECT_CALL(*connection, setInput_(_));
     EXPECT_CALL(*connection, isFramed());
 
@@ -93,7 +104,6 @@ class RSocketStateMachineTest : public Test {
         ResumeManager::makeEmpty(),
         nullptr);
 
-    SetupParameters setupParameters;
     setupParameters.resumable = false; // Not resumable!
     stateMachine->connectClient(
         std::move(transport), std::move(setupParameters));
@@ -132,11 +142,15 @@ class RSocketStateMachineTest : public Test {
     return stateMachine;
   }
 
-  const std::unordered_map<StreamId, std::shared_ptr<StreamStateMachineBase>>&
-  getStreams(RSocketStateMachine& stateMachine) {
+  const StreamTable<std::shared_ptr<StreamStateMachineBase>>& getStreams(
+      RSocketStateMachine& stateMachine) {
     return stateMachine.streams_;
   }
 
+  bool isClosed(RSocketStateMachine& stateMachine) {
+    return stateMachine.isClosed();
+  }
+
   void setupRequestStream(
       RSocketStateMachine& stateMachine,
       StreamId streamId,
@@ -230,6 +244,58 @@ TEST_F(RSocketStateMachineTest, RequestStream_EarlyClose) {
   stateMachine->close({}, StreamCompletionSignal::CONNECTION_END);
 }
 
+TEST_F(RSocketStateMachineTest, StreamEndedByFrameIsReleased) {
+  // Holds the only reference to the stream other than the connection, and
+  // lets go of it once the stream completes.
+  class Subscriber : public yarpl::flowable::Subscriber<Payload> {
+   public:
+    void onSubscribe(std::shared_ptr<yarpl::flowable::Subscription> s)
+        override {
+      subscription_ = std::move(s);
+      subscription_->request(10);
+    }
+    void onNext(Payload) override {}
+    void onComplete() override {
+      subscription_ = nullptr;
+      completed = true;
+    }
+    void onError(folly::exception_wrapper) override {
+      subscription_ = nullptr;
+    }
+
+    bool completed{false};
+
+   private:
+    std::shared_ptr<yarpl::flowable::Subscription> subscription_;
+  };
+
+  auto connection = std::make_unique<StrictMock<MockDuplexConnection>>();
+  // Setup frame and request stream frame.
+  EXPECT_CALL(*connection, send_(_)).Times(2);
+
+  auto stateMachine =
+      createClient(std::move(connection), std::make_shared<RSocketResponder>());
+
+  auto subscriber = std::make_shared<Subscriber>();
+  stateMachine->requestStream(Payload{}, subscriber);
+
+  auto& streams = getStreams(*stateMachine);
+  ASSERT_EQ(1, streams.size());
+  std::weak_ptr<StreamStateMachineBase> stream = streams.at(1);
+
+  // The stream ends while handling the frame, and is released after.
+  auto processor = std::dynamic_pointer_cast<FrameProcessor>(stateMachine);
+  FrameSerializerV1_0 serializer;
+  processor->processFrame(
+      serializer.serializeOut(Frame_PAYLOAD(1, FrameFlags::COMPLETE, {})));
+
+  EXPECT_TRUE(subscriber->completed);
+  EXPECT_TRUE(streams.empty());
+  EXPECT_TRUE(stream.expired());
+
+  stateMachine->close({}, StreamCompletionSignal::CONNECTION_END);
+}
+
 TEST_F(RSocketStateMachineTest, RequestChannel) {
   auto connection = std::make_unique<StrictMock<MockDuplexConnection>>();
   // Setup frame and request channel frame
@@ -276,6 +342,436 @@ TEST_F(RSocketStateMachineTest, RequestResponse) {
   stateMachine->close({}, StreamCompletionSignal::CONNECTION_END);
 }
 
+TEST_F(RSocketStateMachineTest, RequestResponseFuture) {
+  auto connection = std::make_unique<StrictMock<MockDuplexConnection>>();
+  // Setup frame and request response frame
+  EXPECT_CALL(*connection, send_(_)).Times(2);
+
+  auto stateMachine =
+      createClient(std::move(connection), std::make_shared<RSocketResponder>());
+
+  folly::Promise<Payload> promise;
+  auto future = promise.getSemiFuture();
+  stateMachine->requestResponse(Payload{}, std::move(promise));
+
+  auto& streams = getStreams(*stateMachine);
+  ASSERT_EQ(1, streams.size());
+  EXPECT_FALSE(future.isReady());
+
+  // This line completes the future and closes the stream
+  streams.at(1)->handlePayload(Payload{"test", "123"}, true, false, false);
+
+  EXPECT_EQ(0, streams.size());
+  ASSERT_TRUE(future.isReady());
+  EXPECT_EQ("test", std::move(future).get().moveDataToString());
+
+  stateMachine->close({}, StreamCompletionSignal::CONNECTION_END);
+}
+
+TEST_F(RSocketStateMachineTest, RequestResponseFutureInterrupted) {
+  auto connection = std::make_unique<StrictMock<MockDuplexConnection>>();
+  // Setup frame and request response frame
+  EXPECT_CALL(*connection, send_(_)).Times(2);
+
+  auto stateMachine =
+      createClient(std::move(connection), std::make_shared<RSocketResponder>());
+
+  folly::Promise<Payload> promise;
+  auto future = promise.getSemiFuture();
+  stateMachine->requestResponse(Payload{}, std::move(promise));
+
+  stateMachine->close({}, StreamCompletionSignal::CONNECTION_END);
+
+  ASSERT_TRUE(future.isReady());
+  EXPECT_THROW(std::move(future).get(), StreamInterruptedException);
+
+  // Requests on a closed connection fail straight away
+  folly::Promise<Payload> closedPromise;
+  auto closedFuture = closedPromise.getSemiFuture();
+  stateMachine->requestResponse(Payload{}, std::move(closedPromise));
+  ASSERT_TRUE(closedFuture.isReady());
+  EXPECT_THROW(std::move(closedFuture).get(), std::runtime_error);
+}
+
+TEST_F(RSocketStateMachineTest, FireAndForgetBatch) {
+  auto connection = std::make_unique<StrictMock<MockDuplexConnection>>();
+  std::vector<StreamId> streamIds;
+  FrameSerializerV1_0 serializer;
+  EXPECT_CALL(*connection, send_(_))
+      .Times(4)
+      .WillRepeatedly(Invoke([&](std::unique_ptr<folly::IOBuf>& buf) {
+        if (serializer.peekFrameType(*buf) == FrameType::REQUEST_FNF) {
+          streamIds.push_back(*serializer.peekStreamId(*buf, false));
+        }
+      }));
+
+  auto stateMachine =
+      createClient(std::move(connection), std::make_shared<RSocketResponder>());
+
+  std::vector<Payload> batch;
+  batch.emplace_back("a");
+  batch.emplace_back("b");
+  batch.emplace_back("c");
+  stateMachine->fireAndForgetBatch(std::move(batch));
+
+  EXPECT_EQ((std::vector<StreamId>{1, 3, 5}), streamIds);
+
+  stateMachine->close({}, StreamCompletionSignal::CONNECTION_END);
+}
+
+TEST_F(RSocketStateMachineTest, BatchedRequestsShareAWrite) {
+  folly::EventBase evb;
+  folly::EventBaseManager::get()->setEventBase(&evb, false);
+
+  auto connection = std::make_unique<StrictMock<MockDuplexConnection>>();
+  FrameSerializerV1_0 serializer;
+  std::vector<std::pair<FrameType, StreamId>> sent;
+  EXPECT_CALL(*connection, send_(_))
+      .WillRepeatedly(Invoke([&](std::unique_ptr<folly::IOBuf>& buf) {
+        sent.emplace_back(
+            serializer.peekFrameType(*buf),
+            *serializer.peekStreamId(*buf, false));
+      }));
+
+  auto stateMachine =
+      createClient(std::move(connection), std::make_shared<RSocketResponder>());
+  auto const request = [&](RequestBatchingOptions batching) {
+    stateMachine->requestResponse(
+        Payload("x"),
+        folly::Promise<Payload>(),
+        0,
+        true,
+        folly::none,
+        batching);
+  };
+  // The SETUP frame.
+  sent.clear();
+
+  // Held back until the end of the loop iteration.
+  request(RequestBatchingOptions());
+  request(RequestBatchingOptions());
+  EXPECT_TRUE(sent.empty());
+  evb.loopOnce(EVLOOP_NONBLOCK);
+  EXPECT_EQ(
+      (std::vector<std::pair<FrameType, StreamId>>{
+          {FrameType::REQUEST_RESPONSE, 1}, {FrameType::REQUEST_RESPONSE, 3}}),
+      sent);
+
+  // Written at once when the batch is full.
+  sent.clear();
+  RequestBatchingOptions small;
+  small.maxBytes = 1;
+  request(small);
+  EXPECT_EQ(1, sent.size());
+
+  // Any other frame writes the batch out ahead of it.
+  sent.clear();
+  request(RequestBatchingOptions());
+  stateMachine->fireAndForget(Payload("y"));
+  EXPECT_EQ(
+      (std::vector<std::pair<FrameType, StreamId>>{
+          {FrameType::REQUEST_RESPONSE, 7}, {FrameType::REQUEST_FNF, 9}}),
+      sent);
+
+  // Nothing is left for the scheduled flush to write.
+  sent.clear();
+  evb.loopOnce(EVLOOP_NONBLOCK);
+  EXPECT_TRUE(sent.empty());
+
+  stateMachine->close({}, StreamCompletionSignal::CONNECTION_END);
+  folly::EventBaseManager::get()->clearEventBase();
+}
+
+TEST_F(RSocketStateMachineTest, StreamLimitHoldsBackRequests) {
+  auto connection = std::make_unique<StrictMock<MockDuplexConnection>>();
+  FrameSerializerV1_0 serializer;
+  std::vector<StreamId> requested;
+  EXPECT_CALL(*connection, send_(_))
+      .WillRepeatedly(Invoke([&](std::unique_ptr<folly::IOBuf>& buf) {
+        if (serializer.peekFrameType(*buf) == FrameType::REQUEST_STREAM) {
+          requested.push_back(*serializer.peekStreamId(*buf, false));
+        }
+      }));
+
+  auto stateMachine =
+      createClient(std::move(connection), std::make_shared<RSocketResponder>());
+  StreamLimits limits;
+  limits.maxActiveStreams = 1;
+  limits.maxQueuedRequests = 1;
+  stateMachine->setStreamLimits(limits);
+
+  auto active = std::make_shared<StrictMock<MockSubscriber<Payload>>>(1000);
+  EXPECT_CALL(*active, onSubscribe_(_));
+  EXPECT_CALL(*active, onComplete_());
+  stateMachine->requestStream(Payload{}, active);
+
+  auto waiting = std::make_shared<StrictMock<MockSubscriber<Payload>>>(1000);
+  stateMachine->requestStream(Payload{}, waiting);
+
+  // Only one request may wait for a stream to end.
+  auto failed = std::make_shared<StrictMock<MockSubscriber<Payload>>>(1000);
+  EXPECT_CALL(*failed, onSubscribe_(_));
+  EXPECT_CALL(*failed, onError_(_));
+  stateMachine->requestStream(Payload{}, failed);
+
+  auto& streams = getStreams(*stateMachine);
+  EXPECT_EQ(1, streams.size());
+  EXPECT_EQ(std::vector<StreamId>{1}, requested);
+
+  EXPECT_CALL(*waiting, onSubscribe_(_));
+  EXPECT_CALL(*waiting, onComplete_());
+  streams.at(1)->endStream(StreamCompletionSignal::CANCEL);
+
+  ASSERT_EQ(1, streams.size());
+  EXPECT_TRUE(streams.contains(3));
+  EXPECT_EQ((std::vector<StreamId>{1, 3}), requested);
+
+  streams.at(3)->endStream(StreamCompletionSignal::CANCEL);
+  stateMachine->close({}, StreamCompletionSignal::CONNECTION_END);
+}
+
+TEST_F(RSocketStateMachineTest, StreamLimitRejectsPeerRequests) {
+  auto connection = std::make_unique<StrictMock<MockDuplexConnection>>();
+  FrameSerializerV1_0 serializer;
+  std::vector<FrameType> sent;
+  EXPECT_CALL(*connection, send_(_))
+      .WillRepeatedly(Invoke([&](std::unique_ptr<folly::IOBuf>& buf) {
+        sent.push_back(serializer.peekFrameType(*buf));
+      }));
+
+  auto responder = std::make_shared<StrictMock<ResponderMock>>();
+  EXPECT_CALL(*responder, handleRequestStream_(2))
+      .WillOnce(Return(yarpl::flowable::Flowable<Payload>::never()));
+
+  auto stateMachine = createClient(std::move(connection), responder);
+  StreamLimits limits;
+  limits.maxPeerActiveStreams = 1;
+  stateMachine->setStreamLimits(limits);
+
+  setupRequestStream(*stateMachine, 2, 1, Payload{});
+  setupRequestStream(*stateMachine, 4, 1, Payload{});
+
+  auto& streams = getStreams(*stateMachine);
+  EXPECT_EQ(1, streams.size());
+  EXPECT_EQ((std::vector<FrameType>{FrameType::SETUP, FrameType::ERROR}), sent);
+
+  stateMachine->close({}, StreamCompletionSignal::CONNECTION_END);
+}
+
+TEST_F(RSocketStateMachineTest, TenantStreamQuotaSpansConnections) {
+  FrameSerializerV1_0 serializer;
+  std::vector<FrameType> sent;
+  auto const makeConnection = [&] {
+    auto connection = std::make_unique<StrictMock<MockDuplexConnection>>();
+    EXPECT_CALL(*connection, send_(_))
+        .WillRepeatedly(Invoke([&](std::unique_ptr<folly::IOBuf>& buf) {
+          sent.push_back(serializer.peekFrameType(*buf));
+        }));
+    return connection;
+  };
+
+  auto responder = std::make_shared<StrictMock<ResponderMock>>();
+  EXPECT_CALL(*responder, handleRequestStream_(2))
+      .Times(2)
+      .WillRepeatedly(Return(yarpl::flowable::Flowable<Payload>::never()));
+
+  TenantQuotas::Quota quota;
+  quota.maxActiveStreams = 1;
+  auto tenant = std::make_shared<TenantQuotas::Bucket>("tenant", quota);
+
+  auto first = createClient(makeConnection(), responder);
+  ASSERT_TRUE(tenant->tryOpenConnection());
+  first->setTenant(tenant);
+  auto second = createClient(makeConnection(), responder);
+  ASSERT_TRUE(tenant->tryOpenConnection());
+  second->setTenant(tenant);
+
+  setupRequestStream(*first, 2, 1, Payload{});
+  EXPECT_EQ(1, tenant->activeStreams());
+
+  // The stream of the other connection used up the quota.
+  sent.clear();
+  setupRequestStream(*second, 2, 1, Payload{});
+  EXPECT_EQ(0, getStreams(*second).size());
+  EXPECT_EQ((std::vector<FrameType>{FrameType::ERROR}), sent);
+
+  first->close({}, StreamCompletionSignal::CONNECTION_END);
+  EXPECT_EQ(0, tenant->activeStreams());
+  EXPECT_EQ(1, tenant->connections());
+
+  setupRequestStream(*second, 4, 1, Payload{});
+  EXPECT_EQ(1, getStreams(*second).size());
+  second->close({}, StreamCompletionSignal::CONNECTION_END);
+  EXPECT_EQ(0, tenant->activeStreams());
+  EXPECT_EQ(0, tenant->connections());
+}
+
+TEST_F(RSocketStateMachineTest, CancelBurstClosesStreamsOnce) {
+  auto connection = std::make_unique<StrictMock<MockDuplexConnection>>();
+  EXPECT_CALL(*connection, send_(_)).Times(AnyNumber());
+
+  auto responder = std::make_shared<StrictMock<ResponderMock>>();
+  EXPECT_CALL(*responder, handleRequestStream_(_))
+      .Times(3)
+      .WillRepeatedly(Return(yarpl::flowable::Flowable<Payload>::never()));
+
+  auto tenant =
+      std::make_shared<TenantQuotas::Bucket>("tenant", TenantQuotas::Quota());
+  ASSERT_TRUE(tenant->tryOpenConnection());
+  auto stateMachine = createClient(std::move(connection), responder);
+  stateMachine->setTenant(tenant);
+
+  setupRequestStream(*stateMachine, 2, 1, Payload{});
+  setupRequestStream(*stateMachine, 4, 1, Payload{});
+  setupRequestStream(*stateMachine, 6, 1, Payload{});
+  EXPECT_EQ(3, tenant->activeStreams());
+
+  auto& streams = getStreams(*stateMachine);
+  std::weak_ptr<StreamStateMachineBase> stream = streams.at(2);
+
+  folly::EventBase evb;
+  folly::EventBaseManager::get()->setEventBase(&evb, false);
+  auto processor = std::dynamic_pointer_cast<FrameProcessor>(stateMachine);
+  FrameSerializerV1_0 serializer;
+
+  // The streams leave the table right away, the rest waits for the end of
+  // the loop iteration.
+  processor->processFrame(serializer.serializeOut(Frame_CANCEL(2)));
+  processor->processFrame(serializer.serializeOut(Frame_CANCEL(4)));
+  EXPECT_EQ(1, streams.size());
+  EXPECT_EQ(3, tenant->activeStreams());
+  EXPECT_FALSE(stream.expired());
+
+  evb.loopOnce();
+  EXPECT_EQ(1, tenant->activeStreams());
+  EXPECT_TRUE(stream.expired());
+
+  // A frame of another type ends the burst.
+  processor->processFrame(serializer.serializeOut(Frame_CANCEL(6)));
+  EXPECT_EQ(1, tenant->activeStreams());
+  processor->processFrame(serializer.serializeOut(Frame_REQUEST_N(6, 1)));
+  EXPECT_EQ(0, tenant->activeStreams());
+  EXPECT_TRUE(streams.empty());
+
+  stateMachine->close({}, StreamCompletionSignal::CONNECTION_END);
+  evb.loopOnce();
+  folly::EventBaseManager::get()->clearEventBase();
+}
+
+TEST_F(RSocketStateMachineTest, StreamAccountingByKey) {
+  auto connection = std::make_unique<StrictMock<MockDuplexConnection>>();
+  // SETUP, REQUEST_RESPONSE and the response to the peer.
+  EXPECT_CALL(*connection, send_(_)).Times(3);
+
+  auto responder = std::make_shared<StrictMock<ResponderMock>>();
+  EXPECT_CALL(*responder, handleRequestResponse_(2))
+      .WillOnce(Return(Singles::fromGenerator<Payload>(
+          [] { return Payload{"12345"}; })));
+
+  auto accounting = std::make_shared<StreamAccounting>(
+      [](StreamType, const Payload& request) {
+        return request.cloneMetadataToString();
+      });
+  auto stateMachine = createClient(std::move(connection), responder);
+  stateMachine->setStreamAccounting(accounting);
+
+  auto in = std::make_shared<SingleObserverBase<Payload>>();
+  stateMachine->requestResponse(Payload{"q", "route"}, in);
+  setupRequestResponse(*stateMachine, 2, Payload{"data", "route"});
+
+  // Streams are only accounted once they close.
+  auto usage = accounting->snapshot()["route"];
+  EXPECT_EQ(1, usage.streams);
+  EXPECT_EQ(9, usage.bytesIn);
+  EXPECT_EQ(5, usage.bytesOut);
+  EXPECT_GT(usage.handlerTime.count(), 0);
+
+  getStreams(*stateMachine)
+      .at(1)
+      ->handlePayload(Payload{"test", "123"}, true, false, false);
+  usage = accounting->snapshot()["route"];
+  EXPECT_EQ(2, usage.streams);
+  EXPECT_EQ(16, usage.bytesIn);
+  EXPECT_EQ(11, usage.bytesOut);
+
+  stateMachine->close({}, StreamCompletionSignal::CONNECTION_END);
+}
+
+TEST_F(RSocketStateMachineTest, MemoryUsageTracksReassembly) {
+  auto connection = std::make_unique<StrictMock<MockDuplexConnection>>();
+  // Setup frame and request response frame
+  EXPECT_CALL(*connection, send_(_)).Times(2);
+
+  auto stateMachine =
+      createClient(std::move(connection), std::make_shared<RSocketResponder>());
+  EXPECT_EQ(0, stateMachine->memoryUsage().streams);
+
+  folly::Promise<Payload> promise;
+  auto future = promise.getSemiFuture();
+  stateMachine->requestResponse(Payload{}, std::move(promise));
+  EXPECT_LT(0, stateMachine->memoryUsage().streams);
+
+  FrameSerializerV1_0 serializer;
+  auto processor = std::dynamic_pointer_cast<FrameProcessor>(stateMachine);
+  processor->processFrame(serializer.serializeOut(Frame_PAYLOAD(
+      1, FrameFlags::NEXT | FrameFlags::FOLLOWS, Payload("abcd"))));
+  EXPECT_EQ(4, stateMachine->memoryUsage().reassembly);
+
+  processor->processFrame(serializer.serializeOut(Frame_PAYLOAD(
+      1, FrameFlags::NEXT | FrameFlags::COMPLETE, Payload("ef"))));
+  EXPECT_EQ(0, stateMachine->memoryUsage().reassembly);
+  ASSERT_TRUE(future.isReady());
+  EXPECT_EQ("abcdef", std::move(future).get().moveDataToString());
+
+  // The freed state machine stays in the pool.
+  EXPECT_LT(0, stateMachine->memoryUsage().streams);
+
+  stateMachine->close({}, StreamCompletionSignal::CONNECTION_END);
+}
+
+TEST_F(RSocketStateMachineTest, FlowControl) {
+  auto connection = std::make_unique<NiceMock<MockDuplexConnection>>();
+  auto responder = std::make_shared<StrictMock<ResponderMock>>();
+  EXPECT_CALL(*responder, handleRequestStream_(2))
+      .WillOnce(Return(yarpl::flowable::Flowable<Payload>::never()));
+
+  auto stateMachine = createClient(std::move(connection), responder);
+
+  auto subscriber = std::make_shared<NiceMock<MockSubscriber<Payload>>>(10);
+  stateMachine->requestStream(Payload{}, subscriber);
+  setupRequestStream(*stateMachine, 2, 5, Payload{});
+
+  FrameSerializerV1_0 serializer;
+  auto processor = std::dynamic_pointer_cast<FrameProcessor>(stateMachine);
+  processor->processFrame(serializer.serializeOut(
+      Frame_PAYLOAD(1, FrameFlags::NEXT, Payload("data"))));
+
+  auto flowControl = stateMachine->flowControl();
+  EXPECT_FALSE(flowControl.outputPaused);
+  ASSERT_EQ(2, flowControl.streams.size());
+  std::sort(
+      flowControl.streams.begin(),
+      flowControl.streams.end(),
+      [](const StreamFlowControl& a, const StreamFlowControl& b) {
+        return a.streamId < b.streamId;
+      });
+
+  auto const& requester = flowControl.streams[0];
+  EXPECT_EQ(1, requester.streamId);
+  EXPECT_TRUE(requester.consumer);
+  EXPECT_FALSE(requester.publisher);
+  EXPECT_EQ(9, requester.consumerAllowance);
+
+  auto const& responderStream = flowControl.streams[1];
+  EXPECT_EQ(2, responderStream.streamId);
+  EXPECT_FALSE(responderStream.consumer);
+  EXPECT_TRUE(responderStream.publisher);
+  EXPECT_EQ(5, responderStream.publisherAllowance);
+  EXPECT_EQ(0, responderStream.publisherHeldBack);
+
+  stateMachine->close({}, StreamCompletionSignal::CONNECTION_END);
+}
+
 TEST_F(RSocketStateMachineTest, RespondStream) {
   auto connection = std::make_unique<StrictMock<MockDuplexConnection>>();
   int requestCount = 5;
@@ -406,6 +902,90 @@ TEST_F(RSocketStateMachineTest, TransportOnNextClose) {
   rawTransport->onNext(std::move(buf));
 }
 
+TEST_F(RSocketStateMachineTest, RequestsBeforeConnectShareSetupWrite) {
+  /// Records the type of the frames of every write.
+  class BatchRecorder : public MockDuplexConnection {
+   public:
+    explicit BatchRecorder(std::vector<std::vector<FrameType>>& writes)
+        : writes_(writes) {}
+
+    void send(std::unique_ptr<folly::IOBuf> buf) override {
+      writes_.push_back({serializer_.peekFrameType(*buf)});
+    }
+
+    void sendBatch(std::vector<std::unique_ptr<folly::IOBuf>> bufs) override {
+      writes_.emplace_back();
+      for (auto& buf : bufs) {
+        writes_.back().push_back(serializer_.peekFrameType(*buf));
+      }
+    }
+
+   private:
+    std::vector<std::vector<FrameType>>& writes_;
+    FrameSerializerV1_0 serializer_;
+  };
+
+  std::vector<std::vector<FrameType>> writes;
+  auto stateMachine = std::make_shared<RSocketStateMachine>(
+      std::make_shared<RSocketResponder>(),
+      nullptr,
+      RSocketMode::CLIENT,
+      nullptr,
+      nullptr,
+      ResumeManager::makeEmpty(),
+      nullptr);
+
+  SetupParameters params;
+  params.resumable = false;
+  stateMachine->prepareClient(std::move(params));
+
+  folly::Promise<Payload> response;
+  auto future = response.getFuture();
+  stateMachine->requestResponse(Payload("hello"), std::move(response));
+  stateMachine->fireAndForget(Payload("bye"));
+  EXPECT_TRUE(writes.empty());
+  EXPECT_FALSE(future.isReady());
+
+  stateMachine->connectClient(std::make_shared<FrameTransportImpl>(
+      std::make_unique<NiceMock<BatchRecorder>>(writes)));
+  ASSERT_EQ(1, writes.size());
+  EXPECT_EQ(
+      (std::vector<FrameType>{FrameType::SETUP,
+                              FrameType::REQUEST_RESPONSE,
+                              FrameType::REQUEST_FNF}),
+      writes[0]);
+
+  stateMachine->close({}, StreamCompletionSignal::CONNECTION_END);
+  EXPECT_TRUE(future.isReady());
+}
+
+TEST_F(RSocketStateMachineTest, ClosedBeforeConnectFailsRequests) {
+  auto stateMachine = std::make_shared<RSocketStateMachine>(
+      std::make_shared<RSocketResponder>(),
+      nullptr,
+      RSocketMode::CLIENT,
+      nullptr,
+      nullptr,
+      ResumeManager::makeEmpty(),
+      nullptr);
+  stateMachine->prepareClient(SetupParameters());
+
+  folly::Promise<Payload> queued;
+  auto queuedFuture = queued.getFuture();
+  stateMachine->requestResponse(Payload("hello"), std::move(queued));
+  stateMachine->close(
+      std::runtime_error{"Connection failed"},
+      StreamCompletionSignal::CONNECTION_ERROR);
+  ASSERT_TRUE(queuedFuture.isReady());
+  EXPECT_TRUE(queuedFuture.hasException());
+
+  folly::Promise<Payload> late;
+  auto lateFuture = late.getFuture();
+  stateMachine->requestResponse(Payload("hello"), std::move(late));
+  ASSERT_TRUE(lateFuture.isReady());
+  EXPECT_TRUE(lateFuture.hasException());
+}
+
 TEST_F(RSocketStateMachineTest, ResumeWithCurrentConnection) {
   auto resumeToken = ResumeIdentificationToken::generateNew();
 
@@ -427,4 +1007,429 @@ TEST_F(RSocketStateMachineTest, ResumeWithCurrentConnection) {
   stateMachine->close({}, StreamCompletionSignal::CONNECTION_END);
 }
 
+TEST_F(RSocketStateMachineTest, ResumeAckThreshold) {
+  FrameSerializerV1_0 serializer;
+  size_t keepalives = 0;
+
+  auto connection = std::make_unique<NiceMock<MockDuplexConnection>>();
+  ON_CALL(*connection, isFramed()).WillByDefault(Return(true));
+  ON_CALL(*connection, send_(_))
+      .WillByDefault(Invoke([&](std::unique_ptr<folly::IOBuf>& buf) {
+        if (serializer.peekFrameType(*buf) == FrameType::KEEPALIVE) {
+          ++keepalives;
+        }
+      }));
+
+  auto transport = std::make_shared<FrameTransportImpl>(std::move(connection));
+  auto stateMachine = std::make_shared<RSocketStateMachine>(
+      std::make_shared<RSocketResponder>(),
+      nullptr,
+      RSocketMode::SERVER,
+      nullptr,
+      nullptr,
+      std::make_shared<WarmResumeManager>(RSocketStats::noop()),
+      nullptr);
+  stateMachine->setResumeAckThreshold(100);
+
+  SetupParameters setupParameters;
+  setupParameters.resumable = true;
+  setupParameters.token = ResumeIdentificationToken::generateNew();
+  stateMachine->connectServer(transport, setupParameters);
+
+  // Each frame is 46 bytes long, so every third one calls for an ack.
+  StreamId streamId = 1;
+  auto receiveRequest = [&] {
+    transport->onNext(serializer.serializeOut(Frame_REQUEST_FNF(
+        streamId, FrameFlags::EMPTY_, Payload(std::string(40, 'x')))));
+    streamId += 2;
+  };
+
+  receiveRequest();
+  receiveRequest();
+  EXPECT_EQ(0, keepalives);
+  receiveRequest();
+  EXPECT_EQ(1, keepalives);
+  receiveRequest();
+  receiveRequest();
+  EXPECT_EQ(1, keepalives);
+  receiveRequest();
+  EXPECT_EQ(2, keepalives);
+
+  stateMachine->close({}, StreamCompletionSignal::CONNECTION_END);
+}
+
+TEST_F(RSocketStateMachineTest, KeepaliveSuppression) {
+  FrameSerializerV1_0 serializer;
+  auto transport = std::make_shared<FrameTransportImpl>(
+      std::make_unique<NiceMock<MockDuplexConnection>>());
+  auto stateMachine = std::make_shared<RSocketStateMachine>(
+      std::make_shared<RSocketResponder>(),
+      nullptr,
+      RSocketMode::SERVER,
+      nullptr,
+      nullptr,
+      std::make_shared<WarmResumeManager>(RSocketStats::noop()),
+      nullptr);
+
+  SetupParameters setupParameters;
+  setupParameters.resumable = true;
+  setupParameters.token = ResumeIdentificationToken::generateNew();
+  stateMachine->connectServer(transport, setupParameters);
+
+  EXPECT_TRUE(stateMachine->needsKeepaliveFrames());
+  stateMachine->setKeepaliveSuppression(true);
+  EXPECT_FALSE(stateMachine->needsKeepaliveFrames());
+
+  // Received frames have to be acknowledged by the next keepalive.
+  transport->onNext(serializer.serializeOut(
+      Frame_REQUEST_FNF(1, FrameFlags::EMPTY_, Payload("hello"))));
+  EXPECT_TRUE(stateMachine->needsKeepaliveFrames());
+
+  stateMachine->sendKeepalive(folly::IOBuf::create(0));
+  EXPECT_FALSE(stateMachine->needsKeepaliveFrames());
+
+  stateMachine->close({}, StreamCompletionSignal::CONNECTION_END);
+}
+
+TEST_F(RSocketStateMachineTest, KeepaliveSuppressionWithoutResumption) {
+  FrameSerializerV1_0 serializer;
+  auto transport = std::make_shared<FrameTransportImpl>(
+      std::make_unique<NiceMock<MockDuplexConnection>>());
+  auto stateMachine = std::make_shared<RSocketStateMachine>(
+      std::make_shared<RSocketResponder>(),
+      nullptr,
+      RSocketMode::SERVER,
+      nullptr,
+      nullptr,
+      ResumeManager::makeEmpty(),
+      nullptr);
+
+  stateMachine->connectServer(transport, SetupParameters{});
+
+  // Sent by default, even while frames arrive.
+  transport->onNext(serializer.serializeOut(
+      Frame_REQUEST_FNF(1, FrameFlags::EMPTY_, Payload("hello"))));
+  EXPECT_TRUE(stateMachine->needsKeepaliveFrames());
+
+  stateMachine->setKeepaliveSuppression(true);
+  EXPECT_FALSE(stateMachine->needsKeepaliveFrames());
+
+  stateMachine->close({}, StreamCompletionSignal::CONNECTION_END);
+}
+
+TEST_F(RSocketStateMachineTest, MalformedCompressedPayloadFailsStream) {
+  if (!PayloadCompressor::create("zstd", RSocketStats::noop())) {
+    return; // folly was built without zstd
+  }
+
+  auto connection = std::make_unique<StrictMock<MockDuplexConnection>>();
+  FrameSerializerV1_0 serializer;
+  std::vector<FrameType> sent;
+  EXPECT_CALL(*connection, send_(_))
+      .WillRepeatedly(Invoke([&](std::unique_ptr<folly::IOBuf>& buf) {
+        sent.push_back(serializer.peekFrameType(*buf));
+      }));
+
+  SetupParameters setupParameters;
+  setupParameters.payloadCompression = "zstd";
+  auto stateMachine = createClient(
+      std::move(connection),
+      std::make_shared<RSocketResponder>(),
+      std::move(setupParameters));
+
+  auto subscriber = std::make_shared<StrictMock<MockSubscriber<Payload>>>(1);
+  EXPECT_CALL(*subscriber, onSubscribe_(_));
+  EXPECT_CALL(*subscriber, onError_(_));
+  stateMachine->requestStream(Payload{}, subscriber);
+
+  auto processor = std::dynamic_pointer_cast<FrameProcessor>(stateMachine);
+  processor->processFrame(serializer.serializeOut(
+      Frame_PAYLOAD(1, FrameFlags::NEXT, Payload("\x01garbage"))));
+
+  EXPECT_EQ(
+      (std::vector<FrameType>{
+          FrameType::SETUP, FrameType::REQUEST_STREAM, FrameType::ERROR}),
+      sent);
+  EXPECT_EQ(0, getStreams(*stateMachine).size());
+
+  stateMachine->close({}, StreamCompletionSignal::CONNECTION_END);
+}
+
+TEST_F(RSocketStateMachineTest, LeaseHoldsBackRequests) {
+  auto connection = std::make_unique<StrictMock<MockDuplexConnection>>();
+  FrameSerializerV1_0 serializer;
+  std::vector<FrameType> sent;
+  EXPECT_CALL(*connection, send_(_))
+      .WillRepeatedly(Invoke([&](std::unique_ptr<folly::IOBuf>& buf) {
+        sent.push_back(serializer.peekFrameType(*buf));
+      }));
+
+  SetupParameters setupParameters;
+  setupParameters.honorLease = true;
+  setupParameters.maxRequestsAwaitingLease = 1;
+  auto stateMachine = createClient(
+      std::move(connection),
+      std::make_shared<RSocketResponder>(),
+      std::move(setupParameters));
+
+  auto waiting = std::make_shared<StrictMock<MockSubscriber<Payload>>>(1000);
+  stateMachine->requestStream(Payload{}, waiting);
+
+  // Only one request may wait for a lease.
+  auto failed = std::make_shared<StrictMock<MockSubscriber<Payload>>>(1000);
+  EXPECT_CALL(*failed, onSubscribe_(_));
+  EXPECT_CALL(*failed, onError_(_));
+  stateMachine->requestStream(Payload{}, failed);
+
+  auto& streams = getStreams(*stateMachine);
+  EXPECT_EQ(0, streams.size());
+  EXPECT_EQ(std::vector<FrameType>{FrameType::SETUP}, sent);
+
+  EXPECT_CALL(*waiting, onSubscribe_(_));
+  EXPECT_CALL(*waiting, onComplete_());
+
+  auto processor = std::dynamic_pointer_cast<FrameProcessor>(stateMachine);
+  processor->processFrame(serializer.serializeOut(Frame_LEASE(1000, 1)));
+
+  ASSERT_EQ(1, streams.size());
+  EXPECT_EQ(
+      (std::vector<FrameType>{FrameType::SETUP, FrameType::REQUEST_STREAM}),
+      sent);
+
+  streams.at(1)->endStream(StreamCompletionSignal::CANCEL);
+  stateMachine->close({}, StreamCompletionSignal::CONNECTION_END);
+}
+
+TEST_F(RSocketStateMachineTest, LeaseRejectsExcessRequests) {
+  auto connection = std::make_unique<NiceMock<MockDuplexConnection>>();
+  FrameSerializerV1_0 serializer;
+  std::vector<FrameType> sent;
+  EXPECT_CALL(*connection, send_(_))
+      .WillRepeatedly(Invoke([&](std::unique_ptr<folly::IOBuf>& buf) {
+        sent.push_back(serializer.peekFrameType(*buf));
+      }));
+
+  auto leaseSender = std::make_shared<StrictMock<LeaseSenderMock>>();
+  EXPECT_CALL(*leaseSender, nextLease())
+      .WillOnce(Return(Lease{std::chrono::seconds{10}, 1}))
+      .WillRepeatedly(Return(folly::none));
+
+  auto stateMachine = std::make_shared<RSocketStateMachine>(
+      std::make_shared<RSocketResponder>(),
+      nullptr,
+      RSocketMode::SERVER,
+      nullptr,
+      nullptr,
+      ResumeManager::makeEmpty(),
+      nullptr);
+  stateMachine->setLeaseSender(leaseSender);
+
+  SetupParameters setupParameters;
+  setupParameters.honorLease = true;
+  stateMachine->connectServer(
+      std::make_shared<FrameTransportImpl>(std::move(connection)),
+      setupParameters);
+  EXPECT_EQ(std::vector<FrameType>{FrameType::LEASE}, sent);
+
+  auto processor = std::dynamic_pointer_cast<FrameProcessor>(stateMachine);
+  processor->processFrame(serializer.serializeOut(
+      Frame_REQUEST_FNF(1, FrameFlags::EMPTY_, Payload{})));
+  processor->processFrame(serializer.serializeOut(
+      Frame_REQUEST_RESPONSE(3, FrameFlags::EMPTY_, Payload{})));
+
+  EXPECT_EQ(0, getStreams(*stateMachine).size());
+  EXPECT_EQ((std::vector<FrameType>{FrameType::LEASE, FrameType::ERROR}), sent);
+
+  stateMachine->close({}, StreamCompletionSignal::CONNECTION_END);
+}
+
+TEST_F(RSocketStateMachineTest, LeaseRequiresSender) {
+  auto stateMachine = std::make_shared<RSocketStateMachine>(
+      std::make_shared<RSocketResponder>(),
+      nullptr,
+      RSocketMode::SERVER,
+      nullptr,
+      nullptr,
+      ResumeManager::makeEmpty(),
+      nullptr);
+
+  SetupParameters setupParameters;
+  setupParameters.honorLease = true;
+  stateMachine->connectServer(
+      std::make_shared<FrameTransportImpl>(
+          std::make_unique<NiceMock<MockDuplexConnection>>()),
+      setupParameters);
+  EXPECT_TRUE(isClosed(*stateMachine));
+}
+
+TEST_F(RSocketStateMachineTest, AdmissionRejectsRequestsWhileOverloaded) {
+  auto connection = std::make_unique<NiceMock<MockDuplexConnection>>();
+  FrameSerializerV1_0 serializer;
+  std::vector<FrameType> sent;
+  EXPECT_CALL(*connection, send_(_))
+      .WillRepeatedly(Invoke([&](std::unique_ptr<folly::IOBuf>& buf) {
+        sent.push_back(serializer.peekFrameType(*buf));
+      }));
+
+  auto responder = std::make_shared<StrictMock<ResponderMock>>();
+  EXPECT_CALL(*responder, handleRequestResponse_(5))
+      .WillOnce(Return(Singles::fromGenerator<Payload>([] {
+        return Payload("response");
+      })));
+
+  AdmissionController::Options options;
+  options.target = std::chrono::milliseconds{5};
+  options.interval = std::chrono::milliseconds{100};
+  auto controller = std::make_shared<AdmissionController>(options);
+  auto const now = AdmissionController::Clock::now();
+  controller->sample(std::chrono::milliseconds{50}, now);
+  controller->sample(
+      std::chrono::milliseconds{50}, now + std::chrono::milliseconds{100});
+  ASSERT_FALSE(controller->admit());
+
+  auto stateMachine = std::make_shared<RSocketStateMachine>(
+      responder,
+      nullptr,
+      RSocketMode::SERVER,
+      nullptr,
+      nullptr,
+      ResumeManager::makeEmpty(),
+      nullptr);
+  stateMachine->setAdmissionController(controller);
+  stateMachine->connectServer(
+      std::make_shared<FrameTransportImpl>(std::move(connection)),
+      SetupParameters());
+
+  auto processor = std::dynamic_pointer_cast<FrameProcessor>(stateMachine);
+  processor->processFrame(serializer.serializeOut(
+      Frame_REQUEST_RESPONSE(1, FrameFlags::EMPTY_, Payload{})));
+  processor->processFrame(serializer.serializeOut(
+      Frame_REQUEST_FNF(3, FrameFlags::EMPTY_, Payload{})));
+  EXPECT_EQ(0, getStreams(*stateMachine).size());
+  EXPECT_EQ(std::vector<FrameType>{FrameType::ERROR}, sent);
+
+  controller->sample(std::chrono::milliseconds{1});
+  processor->processFrame(serializer.serializeOut(
+      Frame_REQUEST_RESPONSE(5, FrameFlags::EMPTY_, Payload{})));
+  EXPECT_EQ(
+      (std::vector<FrameType>{FrameType::ERROR, FrameType::PAYLOAD}), sent);
+
+  stateMachine->close({}, StreamCompletionSignal::CONNECTION_END);
+}
+
+TEST_F(RSocketStateMachineTest, MemoryPressureRejectsRequestsWhenCritical) {
+  auto connection = std::make_unique<NiceMock<MockDuplexConnection>>();
+  FrameSerializerV1_0 serializer;
+  std::vector<FrameType> sent;
+  EXPECT_CALL(*connection, send_(_))
+      .WillRepeatedly(Invoke([&](std::unique_ptr<folly::IOBuf>& buf) {
+        sent.push_back(serializer.peekFrameType(*buf));
+      }));
+
+  auto responder = std::make_shared<StrictMock<ResponderMock>>();
+  EXPECT_CALL(*responder, handleRequestResponse_(5))
+      .WillOnce(Return(Singles::fromGenerator<Payload>([] {
+        return Payload("response");
+      })));
+
+  MemoryPressureController::Options options;
+  options.highBytes = 1000;
+  options.criticalBytes = 2000;
+  auto controller = std::make_shared<MemoryPressureController>(options);
+  controller->sample(2000);
+
+  auto stateMachine = std::make_shared<RSocketStateMachine>(
+      responder,
+      nullptr,
+      RSocketMode::SERVER,
+      nullptr,
+      nullptr,
+      ResumeManager::makeEmpty(),
+      nullptr);
+  stateMachine->setMemoryPressure(controller);
+  stateMachine->connectServer(
+      std::make_shared<FrameTransportImpl>(std::move(connection)),
+      SetupParameters());
+  EXPECT_EQ(options.highRequestN, stateMachine->requestNLimit());
+
+  auto processor = std::dynamic_pointer_cast<FrameProcessor>(stateMachine);
+  processor->processFrame(serializer.serializeOut(
+      Frame_REQUEST_RESPONSE(1, FrameFlags::EMPTY_, Payload{})));
+  processor->processFrame(serializer.serializeOut(
+      Frame_REQUEST_FNF(3, FrameFlags::EMPTY_, Payload{})));
+  EXPECT_EQ(0, getStreams(*stateMachine).size());
+  EXPECT_EQ(std::vector<FrameType>{FrameType::ERROR}, sent);
+
+  // HIGH still degrades the connection, but lets requests in.
+  controller->sample(1500);
+  processor->processFrame(serializer.serializeOut(
+      Frame_REQUEST_RESPONSE(5, FrameFlags::EMPTY_, Payload{})));
+  EXPECT_EQ(
+      (std::vector<FrameType>{FrameType::ERROR, FrameType::PAYLOAD}), sent);
+
+  stateMachine->close({}, StreamCompletionSignal::CONNECTION_END);
+}
+
+TEST_F(RSocketStateMachineTest, TransportOutputWatermarks) {
+  auto connection = std::make_unique<NiceMock<MockDuplexConnection>>();
+  FrameSerializerV1_0 serializer;
+  size_t buffered = 0;
+  size_t payloads = 0;
+  std::function<void()> outputWritten;
+  EXPECT_CALL(*connection, bufferedOutputBytes())
+      .WillRepeatedly(Invoke([&] { return buffered; }));
+  EXPECT_CALL(*connection, setOutputWrittenCallback(_))
+      .WillOnce(SaveArg<0>(&outputWritten));
+  EXPECT_CALL(*connection, send_(_))
+      .WillRepeatedly(Invoke([&](std::unique_ptr<folly::IOBuf>& buf) {
+        buffered += buf->computeChainDataLength();
+        if (serializer.peekFrameType(*buf) == FrameType::PAYLOAD) {
+          ++payloads;
+        }
+      }));
+
+  auto responder = std::make_shared<StrictMock<ResponderMock>>();
+  EXPECT_CALL(*responder, handleRequestStream_(1))
+      .WillOnce(Return(yarpl::flowable::Flowable<Payload>::fromGenerator(
+          [] { return Payload(std::string(100, 'x')); })));
+
+  auto stateMachine = std::make_shared<RSocketStateMachine>(
+      responder,
+      nullptr,
+      RSocketMode::SERVER,
+      nullptr,
+      nullptr,
+      ResumeManager::makeEmpty(),
+      nullptr);
+  TransportOutputOptions options;
+  options.highWatermark = 200;
+  options.lowWatermark = 50;
+  stateMachine->setTransportOutputOptions(options);
+  stateMachine->connectServer(
+      std::make_shared<FrameTransportImpl>(std::move(connection)),
+      SetupParameters());
+  ASSERT_TRUE(outputWritten);
+
+  auto processor = std::dynamic_pointer_cast<FrameProcessor>(stateMachine);
+  processor->processFrame(serializer.serializeOut(
+      Frame_REQUEST_STREAM(1, FrameFlags::EMPTY_, 2, Payload{})));
+  EXPECT_EQ(2, payloads);
+  EXPECT_TRUE(stateMachine->flowControl().transportOutputPaused);
+
+  // The producer isn't asked for more while the transport is full.
+  processor->processFrame(serializer.serializeOut(Frame_REQUEST_N(1, 3)));
+  EXPECT_EQ(2, payloads);
+
+  buffered = 100;
+  outputWritten();
+  EXPECT_EQ(2, payloads);
+
+  buffered = 0;
+  outputWritten();
+  EXPECT_EQ(5, payloads);
+  EXPECT_TRUE(stateMachine->flowControl().transportOutputPaused);
+
+  stateMachine->close({}, StreamCompletionSignal::CONNECTION_END);
+}
+
 } // namespace rsocket
@@ -0,0 +1,120 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include "rsocket/RSocketStats.h"
+#include "rsocket/internal/PayloadCompressor.h"
+#include "rsocket/statemachine/StreamFragmentAccumulator.h"
+
+using namespace rsocket;
+
+TEST(StreamFragmentAccumulatorTest, ChainsFragmentsByDefault) {
+  StreamFragmentAccumulator fragments;
+  fragments.addPayload(Payload("abc"), true, false);
+  fragments.addPayload(Payload("def"), true, false);
+
+  auto result = fragments.consumePayloadAndFlags().value();
+  auto& payload = std::get<0>(result);
+  EXPECT_TRUE(payload.data->isChained());
+  EXPECT_EQ("abcdef", payload.moveDataToString());
+  EXPECT_TRUE(std::get<1>(result));
+  EXPECT_FALSE(std::get<2>(result));
+}
+
+TEST(StreamFragmentAccumulatorTest, ContiguousReassembly) {
+  StreamFragmentAccumulator::Options options;
+  options.contiguous = true;
+  options.sizeHint = 64;
+  StreamFragmentAccumulator fragments(options);
+
+  fragments.addPayload(Payload("abc", "m1"), true, false);
+  fragments.addPayload(Payload("def", "m2"), false, false);
+  fragments.addPayload(Payload("ghi"), false, true);
+
+  auto result = fragments.consumePayloadAndFlags().value();
+  auto& payload = std::get<0>(result);
+  EXPECT_FALSE(payload.data->isChained());
+  EXPECT_LE(64, payload.data->capacity());
+  EXPECT_FALSE(payload.metadata->isChained());
+  EXPECT_EQ("abcdefghi", payload.moveDataToString());
+  EXPECT_EQ("m1m2", payload.moveMetadataToString());
+  EXPECT_TRUE(std::get<1>(result));
+  EXPECT_TRUE(std::get<2>(result));
+  EXPECT_FALSE(fragments.anyFragments());
+}
+
+TEST(StreamFragmentAccumulatorTest, SingleFragmentIsNotCopied) {
+  StreamFragmentAccumulator::Options options;
+  options.contiguous = true;
+  StreamFragmentAccumulator fragments(options);
+
+  auto data = folly::IOBuf::copyBuffer("abc");
+  auto const buffer = data->data();
+  fragments.addPayloadIgnoreFlags(Payload(std::move(data)));
+
+  EXPECT_EQ(buffer, fragments.consumePayloadIgnoreFlags()->data->data());
+}
+
+TEST(StreamFragmentAccumulatorTest, MaxSize) {
+  StreamFragmentAccumulator::Options options;
+  options.maxSize = 8;
+  StreamFragmentAccumulator fragments(options);
+
+  // Unfragmented payloads are never limited.
+  EXPECT_FALSE(fragments.exceedsMaxSize(Payload("0123456789"), false));
+
+  EXPECT_FALSE(fragments.exceedsMaxSize(Payload("0123"), true));
+  fragments.addPayloadIgnoreFlags(Payload("0123"));
+  EXPECT_FALSE(fragments.exceedsMaxSize(Payload("4567"), false));
+  EXPECT_TRUE(fragments.exceedsMaxSize(Payload("45678"), false));
+
+  fragments.consumePayloadIgnoreFlags();
+  EXPECT_FALSE(fragments.exceedsMaxSize(Payload("45678"), false));
+}
+
+TEST(StreamFragmentAccumulatorTest, ContiguousGrowsGeometrically) {
+  StreamFragmentAccumulator::Options options;
+  options.contiguous = true;
+  StreamFragmentAccumulator fragments(options);
+
+  for (size_t i = 0; i < 1000; ++i) {
+    fragments.addPayloadIgnoreFlags(Payload("x"));
+  }
+
+  auto payload = fragments.consumePayloadIgnoreFlags().value();
+  EXPECT_FALSE(payload.data->isChained());
+  EXPECT_GE(4 * 1000, payload.data->capacity());
+  EXPECT_EQ(std::string(1000, 'x'), payload.moveDataToString());
+}
+
+TEST(StreamFragmentAccumulatorTest, MalformedCompressedPayload) {
+  StreamFragmentAccumulator::Options options;
+  options.compressor = PayloadCompressor::create("zstd", RSocketStats::noop());
+  if (!options.compressor) {
+    return; // folly was built without zstd
+  }
+  StreamFragmentAccumulator fragments(options);
+
+  fragments.addPayload(Payload("\x01garb"), true, false);
+  fragments.addPayload(Payload("age"), true, true);
+  EXPECT_FALSE(fragments.consumePayloadAndFlags());
+  EXPECT_FALSE(fragments.anyFragments());
+
+  // The next payload is reassembled as usual, its marker says it is raw.
+  fragments.addPayloadIgnoreFlags(Payload(folly::StringPiece("\0fine", 5)));
+  auto payload = fragments.consumePayloadIgnoreFlags();
+  ASSERT_TRUE(payload);
+  EXPECT_EQ("fine", payload->moveDataToString());
+}
@@ -16,6 +16,7 @@
 #include <gtest/gtest.h>
 #include <yarpl/test_utils/Mocks.h>
 
+#include "rsocket/internal/Common.h"
 #include "rsocket/statemachine/StreamResponder.h"
 #include "rsocket/test/test_utils/MockStreamsWriter.h"
 
@@ -152,3 +153,101 @@ TEST(StreamResponder, EndStream) {
   responder->endStream(StreamCompletionSignal::SOCKET_CLOSED);
   ASSERT_TRUE(responder->publisherClosed());
 }
+
+TEST(StreamResponder, OutputPausedHoldsBackDemand) {
+  auto writer = std::make_shared<StrictMock<MockStreamsWriter>>();
+  auto responder = std::make_shared<StreamResponder>(writer, 1u, 2);
+
+  EXPECT_CALL(*writer, onStreamClosed(1u));
+
+  auto subscription = std::make_shared<StrictMock<MockSubscription>>();
+
+  responder->handleOutputPaused(true);
+  responder->onSubscribe(subscription);
+  responder->handleRequestN(3);
+
+  EXPECT_CALL(*subscription, request_(5));
+  responder->handleOutputPaused(false);
+
+  EXPECT_CALL(*subscription, request_(1));
+  responder->handleRequestN(1);
+
+  EXPECT_CALL(*subscription, cancel_());
+  responder->handleCancel();
+}
+
+TEST(StreamResponder, ByteCredit) {
+  auto writer = std::make_shared<StrictMock<MockStreamsWriter>>();
+  writer->initialByteCredit_ = 100;
+  auto responder = std::make_shared<StreamResponder>(writer, 1u, 10);
+
+  EXPECT_CALL(*writer, writePayload_(_)).Times(3);
+  EXPECT_CALL(*writer, onStreamClosed(1u));
+
+  auto subscription = std::make_shared<StrictMock<MockSubscription>>();
+  {
+    InSequence seq;
+    // One payload until their size is known, then as many as the byte credit
+    // left is worth, at least one.
+    EXPECT_CALL(*subscription, request_(1)).Times(3);
+    // Nothing until the peer grants more credit.
+    EXPECT_CALL(*subscription, request_(2));
+    EXPECT_CALL(*subscription, cancel_());
+  }
+
+  responder->onSubscribe(subscription);
+  for (int i = 0; i < 3; ++i) {
+    responder->onNext(Payload(std::string(40, 'x')));
+  }
+
+  StreamFlowControl flowControl;
+  responder->describeFlowControl(flowControl);
+  EXPECT_EQ(0, flowControl.publisherByteCredit);
+  EXPECT_EQ(7, flowControl.publisherHeldBack);
+
+  responder->handleByteCredit(80);
+  responder->handleCancel();
+}
+
+TEST(StreamResponder, UnboundedDemand) {
+  auto writer = std::make_shared<StrictMock<MockStreamsWriter>>();
+  auto responder =
+      std::make_shared<StreamResponder>(writer, 1u, kMaxRequestN);
+
+  EXPECT_CALL(*writer, onStreamClosed(1u));
+
+  // The producer is asked for unbounded demand once, later REQUEST_N frames
+  // change nothing.
+  auto subscription = std::make_shared<StrictMock<MockSubscription>>();
+  EXPECT_CALL(*subscription, request_(yarpl::credits::kNoFlowControl));
+  responder->onSubscribe(subscription);
+  responder->handleRequestN(5);
+  responder->handleRequestN(kMaxRequestN);
+
+  EXPECT_CALL(*subscription, cancel_());
+  responder->handleCancel();
+}
+
+TEST(StreamResponder, RequestNBecomesUnbounded) {
+  auto writer = std::make_shared<StrictMock<MockStreamsWriter>>();
+  auto responder = std::make_shared<StreamResponder>(writer, 1u, 2);
+
+  EXPECT_CALL(*writer, onStreamClosed(1u));
+
+  auto subscription = std::make_shared<StrictMock<MockSubscription>>();
+  {
+    InSequence seq;
+    EXPECT_CALL(*subscription, request_(2));
+    EXPECT_CALL(*subscription, request_(yarpl::credits::kNoFlowControl));
+    EXPECT_CALL(*subscription, cancel_());
+  }
+  responder->onSubscribe(subscription);
+  responder->handleRequestN(kMaxRequestN);
+  responder->handleRequestN(1);
+
+  StreamFlowControl flowControl;
+  responder->describeFlowControl(flowControl);
+  EXPECT_EQ(Allowance::max(), flowControl.publisherAllowance);
+
+  responder->handleCancel();
+}
@@ -0,0 +1,105 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "rsocket/statemachine/StreamStateMachinePool.h"
+#include "rsocket/test/test_utils/MockStats.h"
+
+using namespace rsocket;
+using namespace testing;
+
+namespace {
+
+struct Small {
+  explicit Small(int v) : value(v) {}
+  int value;
+};
+
+struct Large {
+  char bytes[256];
+};
+
+} // namespace
+
+TEST(StreamStateMachinePoolTest, ReusesFreedBlocks) {
+  auto stats = std::make_shared<StrictMock<MockStats>>();
+  auto pool = std::make_shared<StreamStateMachinePool>(stats);
+
+  EXPECT_CALL(*stats, streamStateMachineAllocated(false));
+  auto first = pool->make<Small>(1);
+  auto const block = static_cast<void*>(first.get());
+  EXPECT_EQ(1, first->value);
+
+  first.reset();
+  EXPECT_EQ(1, pool->pooled());
+
+  EXPECT_CALL(*stats, streamStateMachineAllocated(true));
+  auto second = pool->make<Small>(2);
+  EXPECT_EQ(block, static_cast<void*>(second.get()));
+  EXPECT_EQ(2, second->value);
+  EXPECT_EQ(0, pool->pooled());
+}
+
+TEST(StreamStateMachinePoolTest, BlocksAreKeptPerSize) {
+  auto stats = std::make_shared<StrictMock<MockStats>>();
+  auto pool = std::make_shared<StreamStateMachinePool>(stats);
+
+  EXPECT_CALL(*stats, streamStateMachineAllocated(false)).Times(2);
+  pool->make<Small>(1).reset();
+  pool->make<Large>();
+  EXPECT_EQ(2, pool->pooled());
+}
+
+TEST(StreamStateMachinePoolTest, BoundsPooledBlocks) {
+  auto pool =
+      std::make_shared<StreamStateMachinePool>(RSocketStats::noop(), 2);
+
+  std::vector<std::shared_ptr<Small>> objects;
+  for (int i = 0; i < 5; ++i) {
+    objects.push_back(pool->make<Small>(i));
+  }
+  objects.clear();
+  EXPECT_EQ(2, pool->pooled());
+}
+
+TEST(StreamStateMachinePoolTest, CountsBytes) {
+  auto pool =
+      std::make_shared<StreamStateMachinePool>(RSocketStats::noop(), 1);
+  EXPECT_EQ(0, pool->bytes());
+
+  auto first = pool->make<Small>(1);
+  auto const blockSize = pool->bytes();
+  EXPECT_GE(blockSize, sizeof(Small));
+
+  auto second = pool->make<Small>(2);
+  EXPECT_EQ(2 * blockSize, pool->bytes());
+
+  // One block goes back to the pool, and is still counted, the other is freed.
+  first.reset();
+  second.reset();
+  EXPECT_EQ(1, pool->pooled());
+  EXPECT_EQ(blockSize, pool->bytes());
+
+  pool->make<Small>(3).reset();
+  EXPECT_EQ(blockSize, pool->bytes());
+}
+
+TEST(StreamStateMachinePoolTest, ObjectsOutliveOwner) {
+  auto pool = std::make_shared<StreamStateMachinePool>(RSocketStats::noop());
+  auto object = pool->make<Small>(7);
+  pool.reset();
+  EXPECT_EQ(7, object->value);
+}
@@ -15,16 +15,46 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <yarpl/test_utils/Mocks.h>
+#include "rsocket/RSocketStats.h"
+#include "rsocket/internal/ByteCredit.h"
 #include "rsocket/internal/Common.h"
 #include "rsocket/statemachine/ChannelRequester.h"
 #include "rsocket/statemachine/ChannelResponder.h"
+#include "rsocket/statemachine/RequestResponseResponder.h"
+#include "rsocket/statemachine/StreamRequester.h"
 #include "rsocket/statemachine/StreamStateMachineBase.h"
 #include "rsocket/test/test_utils/MockStreamsWriter.h"
+#include "yarpl/single/SingleSubscriptions.h"
 
 using namespace rsocket;
 using namespace testing;
 using namespace yarpl::mocks;
 
+namespace {
+
+class LifecycleStats : public RSocketStats {
+ public:
+  void streamOpened(StreamType type) override {
+    opened.push_back(type);
+  }
+
+  void streamFirstPayload(StreamType type, std::chrono::microseconds)
+      override {
+    firstPayloads.push_back(type);
+  }
+
+  void streamClosed(StreamType type, std::chrono::microseconds, size_t bytes)
+      override {
+    closed.emplace_back(type, bytes);
+  }
+
+  std::vector<StreamType> opened;
+  std::vector<StreamType> firstPayloads;
+  std::vector<std::pair<StreamType, size_t>> closed;
+};
+
+} // namespace
+
 class TestStreamStateMachineBase : public StreamStateMachineBase {
  public:
   using StreamStateMachineBase::StreamStateMachineBase;
@@ -330,3 +360,217 @@ TEST(StreamState, ChannelResponderHandleCancel) {
   auto consumerSubscription = mockSubscriber->subscription();
   consumerSubscription->cancel();
 }
+
+TEST(StreamState, StreamRequesterRequestNLowWatermark) {
+  auto writer = std::make_shared<StrictMock<MockStreamsWriter>>();
+  writer->requestNOptions_.lowWatermark = 2;
+  auto requester = std::make_shared<StreamRequester>(writer, 1u, Payload());
+
+  EXPECT_CALL(*writer, writeNewStream_(1u, StreamType::STREAM, 10u, _));
+  auto mockSubscriber =
+      std::make_shared<StrictMock<MockSubscriber<rsocket::Payload>>>(10);
+  EXPECT_CALL(*mockSubscriber, onSubscribe_(_));
+  requester->subscribe(mockSubscriber);
+
+  // The subscriber requests one more payload for each it receives.  That is
+  // only synced once the peer is down to two outstanding payloads.
+  EXPECT_CALL(*mockSubscriber, onNext_(_)).Times(8);
+  EXPECT_CALL(*writer, writeRequestN_(Field(&Frame_REQUEST_N::requestN_, 7u)));
+  for (int i = 0; i < 8; ++i) {
+    requester->handlePayload(Payload("x"), false, true, false);
+    mockSubscriber->subscription()->request(1);
+  }
+
+  EXPECT_CALL(*writer, writeCancel_(_));
+  EXPECT_CALL(*writer, onStreamClosed(1u));
+  mockSubscriber->subscription()->cancel();
+}
+
+TEST(StreamState, StreamRequesterRequestNLimit) {
+  auto writer = std::make_shared<StrictMock<MockStreamsWriter>>();
+  writer->requestNLimit_ = 4;
+  auto requester = std::make_shared<StreamRequester>(writer, 1u, Payload());
+
+  // Only four of the ten payloads requested are outstanding at any time.
+  EXPECT_CALL(*writer, writeNewStream_(1u, StreamType::STREAM, 4u, _));
+  auto mockSubscriber =
+      std::make_shared<StrictMock<MockSubscriber<rsocket::Payload>>>(10);
+  EXPECT_CALL(*mockSubscriber, onSubscribe_(_));
+  requester->subscribe(mockSubscriber);
+
+  EXPECT_CALL(*mockSubscriber, onNext_(_)).Times(6);
+  EXPECT_CALL(*writer, writeRequestN_(Field(&Frame_REQUEST_N::requestN_, 2u)))
+      .Times(3);
+  for (int i = 0; i < 6; ++i) {
+    requester->handlePayload(Payload("x"), false, true, false);
+  }
+
+  EXPECT_CALL(*writer, writeCancel_(_));
+  EXPECT_CALL(*writer, onStreamClosed(1u));
+  mockSubscriber->subscription()->cancel();
+}
+
+TEST(StreamState, StreamRequesterAdaptiveWindow) {
+  auto writer = std::make_shared<StrictMock<MockStreamsWriter>>();
+  RequestNWindow::Options window;
+  window.initialWindow = window.minWindow = window.maxWindow = 4;
+  writer->requestNOptions_.adaptiveWindow = window;
+  auto requester = std::make_shared<StreamRequester>(writer, 1u, Payload());
+
+  // Only the window is sent with the initial request.
+  EXPECT_CALL(*writer, writeNewStream_(1u, StreamType::STREAM, 4u, _));
+  auto mockSubscriber =
+      std::make_shared<StrictMock<MockSubscriber<rsocket::Payload>>>(100);
+  EXPECT_CALL(*mockSubscriber, onSubscribe_(_));
+  requester->subscribe(mockSubscriber);
+
+  // The window is topped up each time the peer has used half of it.
+  EXPECT_CALL(*mockSubscriber, onNext_(_)).Times(4);
+  EXPECT_CALL(*writer, writeRequestN_(Field(&Frame_REQUEST_N::requestN_, 2u)))
+      .Times(2);
+  for (int i = 0; i < 4; ++i) {
+    requester->handlePayload(Payload("x"), false, true, false);
+  }
+  EXPECT_EQ(96, requester->getConsumerAllowance());
+
+  EXPECT_CALL(*writer, writeCancel_(_));
+  EXPECT_CALL(*writer, onStreamClosed(1u));
+  mockSubscriber->subscription()->cancel();
+}
+
+TEST(StreamState, StreamRequesterUnboundedDemand) {
+  auto writer = std::make_shared<StrictMock<MockStreamsWriter>>();
+  auto requester = std::make_shared<StreamRequester>(writer, 1u, Payload());
+
+  // An unbounded request is sent once, as kMaxRequestN, and never topped up.
+  auto const unbounded = static_cast<uint32_t>(kMaxRequestN);
+  EXPECT_CALL(*writer, writeNewStream_(1u, StreamType::STREAM, unbounded, _));
+  EXPECT_CALL(*writer, writeRequestN_(_)).Times(0);
+  auto mockSubscriber =
+      std::make_shared<StrictMock<MockSubscriber<rsocket::Payload>>>();
+  EXPECT_CALL(*mockSubscriber, onSubscribe_(_));
+  requester->subscribe(mockSubscriber);
+
+  EXPECT_CALL(*mockSubscriber, onNext_(_)).Times(100);
+  for (int i = 0; i < 100; ++i) {
+    requester->handlePayload(Payload("x"), false, true, false);
+    mockSubscriber->subscription()->request(1);
+  }
+
+  StreamFlowControl flowControl;
+  requester->describeFlowControl(flowControl);
+  EXPECT_EQ(Allowance::max(), flowControl.consumerAllowance);
+  EXPECT_EQ(0, flowControl.consumerPendingAllowance);
+
+  EXPECT_CALL(*writer, writeCancel_(_));
+  EXPECT_CALL(*writer, onStreamClosed(1u));
+  mockSubscriber->subscription()->cancel();
+}
+
+TEST(StreamState, StreamRequesterBecomesUnbounded) {
+  auto writer = std::make_shared<StrictMock<MockStreamsWriter>>();
+  auto requester = std::make_shared<StreamRequester>(writer, 1u, Payload());
+
+  EXPECT_CALL(*writer, writeNewStream_(1u, StreamType::STREAM, 2u, _));
+  auto mockSubscriber =
+      std::make_shared<StrictMock<MockSubscriber<rsocket::Payload>>>(2);
+  EXPECT_CALL(*mockSubscriber, onSubscribe_(_));
+  requester->subscribe(mockSubscriber);
+
+  EXPECT_CALL(
+      *writer,
+      writeRequestN_(Field(
+          &Frame_REQUEST_N::requestN_, static_cast<uint32_t>(kMaxRequestN))));
+  mockSubscriber->subscription()->request(yarpl::credits::kNoFlowControl);
+
+  // Payloads past the bounded allowance are no flow control error.
+  EXPECT_CALL(*mockSubscriber, onNext_(_)).Times(10);
+  for (int i = 0; i < 10; ++i) {
+    requester->handlePayload(Payload("x"), false, true, false);
+  }
+
+  EXPECT_CALL(*writer, writeCancel_(_));
+  EXPECT_CALL(*writer, onStreamClosed(1u));
+  mockSubscriber->subscription()->cancel();
+}
+
+TEST(StreamState, StreamRequesterGrantsByteCredit) {
+  auto writer = std::make_shared<StrictMock<MockStreamsWriter>>();
+  writer->initialByteCredit_ = 10;
+  auto requester = std::make_shared<StreamRequester>(writer, 1u, Payload());
+
+  EXPECT_CALL(*writer, writeNewStream_(1u, StreamType::STREAM, 10u, _));
+  auto mockSubscriber =
+      std::make_shared<StrictMock<MockSubscriber<rsocket::Payload>>>(10);
+  EXPECT_CALL(*mockSubscriber, onSubscribe_(_));
+  requester->subscribe(mockSubscriber);
+
+  // Credit is granted back once the peer is down to half of it.
+  EXPECT_CALL(*mockSubscriber, onNext_(_)).Times(2);
+  EXPECT_CALL(*writer, writeExt_(_)).WillOnce(Invoke([](Frame_EXT& frame) {
+    EXPECT_EQ(1u, frame.header_.streamId);
+    EXPECT_EQ(6u, ByteCredit::parseGrant(frame).value_or(0));
+  }));
+  requester->handlePayload(Payload("abcdef"), false, true, false);
+  requester->handlePayload(Payload("ab"), false, true, false);
+
+  StreamFlowControl flowControl;
+  requester->describeFlowControl(flowControl);
+  EXPECT_EQ(8, flowControl.consumerByteCredit);
+
+  EXPECT_CALL(*writer, writeCancel_(_));
+  EXPECT_CALL(*writer, onStreamClosed(1u));
+  mockSubscriber->subscription()->cancel();
+}
+
+TEST(StreamState, StreamRequesterReportsLifecycle) {
+  auto writer = std::make_shared<StrictMock<MockStreamsWriter>>();
+  auto stats = std::make_shared<LifecycleStats>();
+  writer->streamStats_ = stats;
+  auto requester =
+      std::make_shared<StreamRequester>(writer, 1u, Payload("req"));
+
+  EXPECT_CALL(*writer, writeNewStream_(1u, StreamType::STREAM, 10u, _));
+  auto mockSubscriber =
+      std::make_shared<StrictMock<MockSubscriber<rsocket::Payload>>>(10);
+  EXPECT_CALL(*mockSubscriber, onSubscribe_(_));
+  requester->subscribe(mockSubscriber);
+  EXPECT_EQ(std::vector<StreamType>{StreamType::STREAM}, stats->opened);
+  EXPECT_TRUE(stats->firstPayloads.empty());
+
+  EXPECT_CALL(*mockSubscriber, onNext_(_)).Times(2);
+  requester->handlePayload(Payload("abc"), false, true, false);
+  EXPECT_EQ(std::vector<StreamType>{StreamType::STREAM}, stats->firstPayloads);
+  EXPECT_TRUE(stats->closed.empty());
+
+  EXPECT_CALL(*mockSubscriber, onComplete_());
+  EXPECT_CALL(*writer, onStreamClosed(1u));
+  requester->handlePayload(Payload("de"), true, true, false);
+
+  EXPECT_EQ(1, stats->firstPayloads.size());
+  ASSERT_EQ(1, stats->closed.size());
+  EXPECT_EQ(StreamType::STREAM, stats->closed[0].first);
+  EXPECT_EQ(8, stats->closed[0].second);
+}
+
+TEST(StreamState, RequestResponseResponderReportsLifecycle) {
+  auto writer = std::make_shared<StrictMock<MockStreamsWriter>>();
+  auto stats = std::make_shared<LifecycleStats>();
+  writer->streamStats_ = stats;
+  auto responder = std::make_shared<RequestResponseResponder>(writer, 1u);
+
+  responder->handlePayload(Payload("req"), false, false, false);
+  EXPECT_EQ(
+      std::vector<StreamType>{StreamType::REQUEST_RESPONSE}, stats->opened);
+
+  EXPECT_CALL(*writer, writePayload_(_));
+  EXPECT_CALL(*writer, onStreamClosed(1u));
+  responder->onSubscribe(yarpl::single::SingleSubscriptions::empty());
+  responder->onSuccess(Payload("response"));
+
+  EXPECT_EQ(
+      std::vector<StreamType>{StreamType::REQUEST_RESPONSE},
+      stats->firstPayloads);
+  ASSERT_EQ(1, stats->closed.size());
+  EXPECT_EQ(11, stats->closed[0].second);
+}
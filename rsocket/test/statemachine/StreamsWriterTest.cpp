@@ -12,6 +12,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <vector>
+
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <yarpl/test_utils/Mocks.h>
@@ -84,3 +86,133 @@ TEST(StreamsWriterTest, FlushQueuedFrames) {
   // it will not send the pending frames twice
   impl.sendPendingFrames();
 }
+
+TEST(StreamsWriterTest, FragmentChainedPayloadWithoutCopying) {
+  auto writer = std::make_shared<StrictMock<MockStreamsWriterImpl>>();
+  writer->maxFragmentSize_ = 5000;
+
+  std::vector<std::unique_ptr<folly::IOBuf>> frames;
+  EXPECT_CALL(*writer, shouldQueue()).Times(3);
+  EXPECT_CALL(*writer, outputFrame_(_))
+      .Times(3)
+      .WillRepeatedly(Invoke(
+          [&](folly::IOBuf* buf) { frames.push_back(buf->clone()); }));
+
+  auto data = folly::IOBuf::copyBuffer(std::string(8000, 'a'));
+  data->prependChain(folly::IOBuf::copyBuffer(std::string(4000, 'b')));
+  auto const chainData = data->data();
+
+  writer->writePayload(
+      Frame_PAYLOAD(1, FrameFlags::NEXT, Payload(std::move(data))));
+
+  ASSERT_EQ(3, frames.size());
+  std::string received;
+  for (size_t i = 0; i < frames.size(); ++i) {
+    Frame_PAYLOAD frame;
+    ASSERT_TRUE(
+        writer->frameSerializer.deserializeFrom(frame, std::move(frames[i])));
+    EXPECT_EQ(i + 1 < frames.size(), frame.header_.flagsFollows());
+    EXPECT_TRUE(frame.header_.flagsNext());
+    if (i == 0) {
+      // The first fragment still points at the original buffer.
+      EXPECT_EQ(chainData, frame.payload_.data->data());
+    }
+    received += frame.payload_.moveDataToString();
+  }
+  EXPECT_EQ(std::string(8000, 'a') + std::string(4000, 'b'), received);
+}
+
+TEST(StreamsWriterTest, OutputSchedulerInterleavesStreams) {
+  auto writer = std::make_shared<StrictMock<MockStreamsWriterImpl>>();
+  writer->maxFragmentSize_ = 5000;
+  writer->deferOutput_ = true;
+
+  OutputScheduler::Options options;
+  options.quantum = 6000;
+  writer->enableOutputScheduler(options);
+
+  std::vector<StreamId> streamIds;
+  EXPECT_CALL(*writer, shouldQueue()).Times(AnyNumber());
+  EXPECT_CALL(*writer, outputFrame_(_))
+      .Times(4)
+      .WillRepeatedly(Invoke([&](folly::IOBuf* buf) {
+        streamIds.push_back(*writer->frameSerializer.peekStreamId(*buf, false));
+      }));
+
+  // Three fragments on stream 1, then a small payload on stream 3.
+  writer->writePayload(Frame_PAYLOAD(
+      1,
+      FrameFlags::NEXT,
+      Payload(folly::IOBuf::copyBuffer(std::string(12000, 'a')))));
+  writer->writePayload(Frame_PAYLOAD(
+      3, FrameFlags::NEXT | FrameFlags::COMPLETE, Payload("hello")));
+
+  EXPECT_EQ(1, writer->outputsScheduled_);
+  EXPECT_TRUE(streamIds.empty());
+
+  writer->drainScheduledFrames();
+  EXPECT_EQ((std::vector<StreamId>{1, 3, 1, 1}), streamIds);
+}
+
+TEST(StreamsWriterTest, PendingOutputWatermarks) {
+  auto writer = std::make_shared<StrictMock<MockStreamsWriterImpl>>();
+  writer->shouldQueue_ = true;
+
+  PendingOutputOptions options;
+  options.highWatermark = 2500;
+  options.lowWatermark = 1000;
+  writer->setPendingOutputOptions(options);
+
+  EXPECT_CALL(*writer, shouldQueue()).Times(AnyNumber());
+  EXPECT_CALL(*writer, outputFrame_(_)).Times(3);
+
+  auto writeKilobyte = [&] {
+    writer->writePayload(Frame_PAYLOAD(
+        1,
+        FrameFlags::NEXT,
+        Payload(folly::IOBuf::copyBuffer(std::string(1000, 'a')))));
+  };
+
+  writeKilobyte();
+  writeKilobyte();
+  EXPECT_FALSE(writer->pendingOutputPaused());
+  writeKilobyte();
+  EXPECT_TRUE(writer->pendingOutputPaused());
+
+  // Still can't send, so the frames stay pending.
+  writer->sendPendingFrames();
+  EXPECT_TRUE(writer->pendingOutputPaused());
+
+  writer->shouldQueue_ = false;
+  writer->sendPendingFrames();
+  EXPECT_FALSE(writer->pendingOutputPaused());
+  EXPECT_EQ((std::vector<bool>{true, false}), writer->pausedChanges_);
+}
+
+TEST(StreamsWriterTest, AdaptiveFragmentSize) {
+  FragmentSizeOptions options;
+  options.minFragmentSize = 4 * 1024;
+  options.maxFragmentSize = 1024 * 1024;
+  options.maxFragmentDelay = std::chrono::microseconds(1000);
+
+  // Nothing known about the transport.
+  DuplexConnection::TransportInfo info;
+  EXPECT_EQ(1024 * 1024, adaptiveFragmentSize(options, info, 1));
+
+  // A share of the send buffer per stream.
+  info.sendBufferSize = 256 * 1024;
+  EXPECT_EQ(256 * 1024, adaptiveFragmentSize(options, info, 0));
+  EXPECT_EQ(64 * 1024, adaptiveFragmentSize(options, info, 4));
+  EXPECT_EQ(4 * 1024, adaptiveFragmentSize(options, info, 1000));
+
+  // Fast local link: a window of 100KB every 100us sends 1MB per ms.
+  info.congestionWindow = 100 * 1000;
+  info.rtt = std::chrono::microseconds(100);
+  EXPECT_EQ(256 * 1024, adaptiveFragmentSize(options, info, 1));
+
+  // Slow link: a window of 100KB every 50ms sends 2KB per ms.
+  info.rtt = std::chrono::milliseconds(50);
+  EXPECT_EQ(4 * 1024, adaptiveFragmentSize(options, info, 1));
+  info.rtt = std::chrono::milliseconds(10);
+  EXPECT_EQ(10 * 1000, adaptiveFragmentSize(options, info, 1));
+}
@@ -103,12 +103,10 @@ ColdResumeManager::ColdResumeManager(
         throw std::runtime_error(
             "Invalid file content.  Expected dynamic object of 1 element");
       }
-      auto ioBuf = folly::IOBuf::copyBuffer(
-          item.values().begin()->getString().c_str(),
-          item.values().begin()->getString().size());
+      const auto& data = item.values().begin()->getString();
       frames_.emplace_back(
           folly::to<int64_t>(item.keys().begin()->getString()),
-          std::move(ioBuf));
+          folly::IOBuf(folly::IOBuf::COPY_BUFFER, data.data(), data.size()));
     }
   } catch (const std::exception& ex) {
     throw std::runtime_error(
@@ -143,7 +141,7 @@ void ColdResumeManager::persistState(std::string outputFile) {
     for (const auto& frame : frames_) {
       state[FRAMES].push_back(folly::dynamic::object(
           folly::to<std::string>(frame.first),
-          frame.second->moveToFbString().toStdString()));
+          frame.second.cloneAsValue().moveToFbString().toStdString()));
     }
     std::string jsonState = folly::toPrettyJson(state);
     std::ofstream f(outputFile);
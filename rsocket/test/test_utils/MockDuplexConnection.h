@@ -49,6 +49,8 @@ class MockDuplexConnection : public DuplexConnection {
   MOCK_METHOD1(setInput_, void(std::shared_ptr<Subscriber>));
   MOCK_METHOD1(send_, void(std::unique_ptr<folly::IOBuf>&));
   MOCK_CONST_METHOD0(isFramed, bool());
+  MOCK_CONST_METHOD0(bufferedOutputBytes, size_t());
+  MOCK_METHOD1(setOutputWrittenCallback, void(std::function<void()>));
 };
 
 } // namespace rsocket
@@ -39,9 +39,14 @@ class MockStats : public RSocketStats {
 
   MOCK_METHOD1(bytesWritten, void(size_t));
   MOCK_METHOD1(bytesRead, void(size_t));
+  MOCK_METHOD1(bytesWrittenZeroCopy, void(size_t));
+  MOCK_METHOD1(bytesWrittenCopied, void(size_t));
+  MOCK_METHOD3(kernelTls, void(DuplexConnection*, bool, bool));
   MOCK_METHOD1(frameWritten, void(FrameType));
   MOCK_METHOD1(frameRead, void(FrameType));
   MOCK_METHOD2(resumeBufferChanged, void(int, int));
+  MOCK_METHOD2(resumeBufferEvictedForBudget, void(int, int));
   MOCK_METHOD2(streamBufferChanged, void(int64_t, int64_t));
+  MOCK_METHOD1(streamStateMachineAllocated, void(bool));
 };
 } // namespace rsocket
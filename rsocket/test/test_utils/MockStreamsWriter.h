@@ -16,6 +16,8 @@
 
 #include <gmock/gmock.h>
 
+#include <vector>
+
 #include "rsocket/RSocketStats.h"
 #include "rsocket/framing/FrameSerializer_v1_0.h"
 #include "rsocket/statemachine/StreamsWriter.h"
@@ -39,7 +41,7 @@ class MockStreamsWriterImpl : public StreamsWriterImpl {
     outputFrame_(buf.get());
   }
 
-  FrameSerializer& serializer() override {
+  const FrameSerializer& serializer() override {
     return frameSerializer;
   }
 
@@ -47,6 +49,11 @@ class MockStreamsWriterImpl : public StreamsWriterImpl {
     return *stats_;
   }
 
+  size_t maxFragmentSize() const override {
+    return maxFragmentSize_ ? maxFragmentSize_
+                            : StreamsWriterImpl::maxFragmentSize();
+  }
+
   std::shared_ptr<yarpl::flowable::Subscriber<Payload>> onNewStreamReady(
       StreamId streamId,
       StreamType streamType,
@@ -65,9 +72,33 @@ class MockStreamsWriterImpl : public StreamsWriterImpl {
     // ignoring...
   }
 
+  void scheduleOutput() override {
+    if (deferOutput_) {
+      ++outputsScheduled_;
+    } else {
+      StreamsWriterImpl::scheduleOutput();
+    }
+  }
+
+  void onPendingOutputPaused(bool paused) override {
+    pausedChanges_.push_back(paused);
+  }
+
+  using StreamsWriterImpl::drainScheduledFrames;
+  using StreamsWriterImpl::enableOutputScheduler;
+  using StreamsWriterImpl::pendingOutputPaused;
   using StreamsWriterImpl::sendPendingFrames;
+  using StreamsWriterImpl::setPendingOutputOptions;
 
   bool shouldQueue_{false};
+  size_t maxFragmentSize_{0};
+
+  /// Leave scheduled frames until drainScheduledFrames() is called.
+  bool deferOutput_{false};
+  size_t outputsScheduled_{0};
+
+  /// Arguments of every onPendingOutputPaused() call.
+  std::vector<bool> pausedChanges_;
   std::shared_ptr<RSocketStats> stats_ = RSocketStats::noop();
   FrameSerializerV1_0 frameSerializer;
 };
@@ -77,6 +108,7 @@ class MockStreamsWriter : public StreamsWriter {
   MOCK_METHOD4(writeNewStream_, void(StreamId, StreamType, uint32_t, Payload&));
   MOCK_METHOD1(writeRequestN_, void(rsocket::Frame_REQUEST_N));
   MOCK_METHOD1(writeCancel_, void(rsocket::Frame_CANCEL));
+  MOCK_METHOD1(writeExt_, void(rsocket::Frame_EXT&));
   MOCK_METHOD1(writePayload_, void(rsocket::Frame_PAYLOAD&));
   MOCK_METHOD1(writeError_, void(rsocket::Frame_ERROR&));
   MOCK_METHOD1(onStreamClosed, void(rsocket::StreamId));
@@ -112,6 +144,13 @@ class MockStreamsWriter : public StreamsWriter {
     }
   }
 
+  void writeExt(rsocket::Frame_EXT&& ext) override {
+    writeExt_(ext);
+    if (delegateToImpl_) {
+      impl_.writeExt(std::move(ext));
+    }
+  }
+
   void writePayload(rsocket::Frame_PAYLOAD&& payload) override {
     writePayload_(payload);
     if (delegateToImpl_) {
@@ -144,6 +183,27 @@ class MockStreamsWriter : public StreamsWriter {
     // ignoring...
   }
 
+  RequestNOptions requestNOptions() const override {
+    return requestNOptions_;
+  }
+
+  RSocketStats* streamStats() override {
+    return streamStats_.get();
+  }
+
+  size_t initialByteCredit() const override {
+    return initialByteCredit_;
+  }
+
+  size_t requestNLimit() const override {
+    return requestNLimit_;
+  }
+
+  RequestNOptions requestNOptions_;
+  size_t initialByteCredit_{0};
+  size_t requestNLimit_{kMaxRequestN};
+  std::shared_ptr<RSocketStats> streamStats_;
+
  protected:
   MockStreamsWriterImpl impl_;
   bool delegateToImpl_{false};
@@ -77,4 +77,8 @@ void StatsPrinter::keepaliveSent() {
 void StatsPrinter::keepaliveReceived() {
   LOG(INFO) << "keepalive response received";
 }
+
+void StatsPrinter::keepaliveSuppressed() {
+  LOG(INFO) << "keepalive suppressed";
+}
 } // namespace rsocket
@@ -41,5 +41,6 @@ class StatsPrinter : public RSocketStats {
 
   void keepaliveSent() override;
   void keepaliveReceived() override;
+  void keepaliveSuppressed() override;
 };
 } // namespace rsocket
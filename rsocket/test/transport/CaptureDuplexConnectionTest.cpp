@@ -0,0 +1,176 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <folly/executors/ManualExecutor.h>
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <limits>
+
+#include "rsocket/test/test_utils/MockDuplexConnection.h"
+#include "rsocket/transports/capture/CaptureDuplexConnection.h"
+#include "rsocket/transports/capture/CaptureFile.h"
+
+using namespace rsocket;
+using namespace testing;
+
+namespace {
+
+class Collector : public DuplexConnection::Subscriber {
+ public:
+  void onSubscribe(
+      std::shared_ptr<yarpl::flowable::Subscription> subscription) override {
+    subscription->request(std::numeric_limits<int64_t>::max());
+  }
+
+  void onNext(std::unique_ptr<folly::IOBuf> frame) override {
+    frames.push_back(frame->moveToFbString().toStdString());
+  }
+
+  void onComplete() override {}
+  void onError(folly::exception_wrapper) override {}
+
+  std::vector<std::string> frames;
+};
+
+std::string toString(const CapturedFrame& frame) {
+  return frame.frame->cloneCoalescedAsValue().moveToFbString().toStdString();
+}
+
+class CaptureDuplexConnectionTest : public Test {
+ protected:
+  void SetUp() override {
+    char path[] = "/tmp/rsocket-capture-XXXXXX";
+    const auto fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    path_ = path;
+  }
+
+  void TearDown() override {
+    unlink(path_.c_str());
+  }
+
+  /// Decorates a mock connection, whose input ends up in `input_`.
+  std::unique_ptr<CaptureDuplexConnection> makeConnection(
+      size_t maxBytes = size_t{1} << 30) {
+    auto connection = std::make_unique<NiceMock<MockDuplexConnection>>();
+    ON_CALL(*connection, setInput_(_))
+        .WillByDefault(
+            Invoke([this](std::shared_ptr<DuplexConnection::Subscriber> in) {
+              input_ = std::move(in);
+              input_->onSubscribe(std::make_shared<
+                                  NiceMock<yarpl::mocks::MockSubscription>>());
+            }));
+    ON_CALL(*connection, send_(_))
+        .WillByDefault(Invoke([this](std::unique_ptr<folly::IOBuf>& frame) {
+          sent_.push_back(frame->moveToFbString().toStdString());
+        }));
+
+    CaptureDuplexConnection::Options options;
+    options.path = path_;
+    options.writer = folly::getKeepAliveToken(executor_);
+    options.maxBytes = maxBytes;
+    return std::make_unique<CaptureDuplexConnection>(
+        std::move(connection), std::move(options));
+  }
+
+  std::string path_;
+  folly::ManualExecutor executor_;
+  std::shared_ptr<DuplexConnection::Subscriber> input_;
+  std::vector<std::string> sent_;
+};
+
+} // namespace
+
+TEST_F(CaptureDuplexConnectionTest, RecordsBothDirections) {
+  auto connection = makeConnection();
+  auto collector = std::make_shared<Collector>();
+  connection->setInput(collector);
+  ASSERT_TRUE(input_);
+
+  input_->onNext(folly::IOBuf::copyBuffer("in 1"));
+  connection->send(folly::IOBuf::copyBuffer("out 1"));
+  std::vector<std::unique_ptr<folly::IOBuf>> batch;
+  batch.push_back(folly::IOBuf::copyBuffer("out 2"));
+  batch.push_back(folly::IOBuf::copyBuffer("out 3"));
+  connection->sendBatch(std::move(batch));
+  input_->onNext(folly::IOBuf::copyBuffer("in 2"));
+
+  EXPECT_EQ((std::vector<std::string>{"in 1", "in 2"}), collector->frames);
+  EXPECT_EQ((std::vector<std::string>{"out 1", "out 2", "out 3"}), sent_);
+
+  connection.reset();
+  executor_.drain();
+
+  const auto session = CaptureFile::read(path_);
+  ASSERT_EQ(5, session.frames.size());
+  const std::vector<std::pair<FrameCapture::Direction, std::string>> expected{
+      {FrameCapture::Direction::IN, "in 1"},
+      {FrameCapture::Direction::OUT, "out 1"},
+      {FrameCapture::Direction::OUT, "out 2"},
+      {FrameCapture::Direction::OUT, "out 3"},
+      {FrameCapture::Direction::IN, "in 2"},
+  };
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(expected[i].first, session.frames[i].direction);
+    EXPECT_EQ(expected[i].second, toString(session.frames[i]));
+    if (i > 0) {
+      EXPECT_GE(session.frames[i].offset, session.frames[i - 1].offset);
+    }
+  }
+}
+
+TEST_F(CaptureDuplexConnectionTest, StopsRecordingAtMaxBytes) {
+  // The header, and room for a single frame.
+  auto connection = makeConnection(17 + 20);
+  connection->send(folly::IOBuf::copyBuffer("first"));
+  connection->send(folly::IOBuf::copyBuffer(std::string(30, 'x')));
+  connection->send(folly::IOBuf::copyBuffer("last"));
+  EXPECT_EQ(3, sent_.size());
+
+  connection.reset();
+  executor_.drain();
+
+  const auto session = CaptureFile::read(path_);
+  ASSERT_EQ(1, session.frames.size());
+  EXPECT_EQ("first", toString(session.frames[0]));
+}
+
+TEST(CaptureFileTest, DropsFrameCutShort) {
+  folly::IOBufQueue queue{folly::IOBufQueue::cacheChainLength()};
+  CaptureFile::appendHeader(queue, std::chrono::system_clock::now());
+  CaptureFile::appendFrame(
+      queue,
+      std::chrono::microseconds{5},
+      FrameCapture::Direction::IN,
+      *folly::IOBuf::copyBuffer("complete"));
+  CaptureFile::appendFrame(
+      queue,
+      std::chrono::microseconds{5},
+      FrameCapture::Direction::OUT,
+      *folly::IOBuf::copyBuffer("cut short"));
+  auto data = queue.move()->cloneCoalescedAsValue();
+  data.trimEnd(3);
+
+  const auto session = CaptureFile::parse(data.coalesce());
+  ASSERT_EQ(1, session.frames.size());
+  EXPECT_EQ(std::chrono::microseconds{5}, session.frames[0].offset);
+  EXPECT_EQ("complete", toString(session.frames[0]));
+
+  EXPECT_THROW(
+      CaptureFile::parse(folly::ByteRange{folly::StringPiece{"not a capture"}}),
+      std::runtime_error);
+}
@@ -0,0 +1,157 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <folly/synchronization/Baton.h>
+#include <gtest/gtest.h>
+
+#include "rsocket/test/transport/DuplexConnectionTest.h"
+#include "rsocket/transports/inprocess/InProcessConnectionAcceptor.h"
+#include "rsocket/transports/inprocess/InProcessConnectionFactory.h"
+#include "rsocket/transports/inprocess/InProcessDuplexConnection.h"
+#include "yarpl/test_utils/Mocks.h"
+
+namespace rsocket {
+namespace tests {
+
+using namespace folly;
+using namespace rsocket;
+using namespace ::testing;
+
+namespace {
+
+using MockFrameSubscriber =
+    yarpl::mocks::MockSubscriber<std::unique_ptr<folly::IOBuf>>;
+
+struct ConnectionPair {
+  ConnectionPair() {
+    auto connections = InProcessDuplexConnection::makePair(
+        *server.getEventBase(), *client.getEventBase());
+    serverConnection = std::move(connections.first);
+    clientConnection = std::move(connections.second);
+  }
+
+  folly::ScopedEventBaseThread server;
+  folly::ScopedEventBaseThread client;
+  std::unique_ptr<DuplexConnection> serverConnection;
+  std::unique_ptr<DuplexConnection> clientConnection;
+};
+
+} // namespace
+
+TEST(InProcessDuplexConnection, MultipleSetInputGetOutputCalls) {
+  ConnectionPair pair;
+  makeMultipleSetInputGetOutputCalls(
+      std::move(pair.serverConnection),
+      pair.server.getEventBase(),
+      std::move(pair.clientConnection),
+      pair.client.getEventBase());
+}
+
+TEST(InProcessDuplexConnection, InputAndOutputIsUntied) {
+  ConnectionPair pair;
+  verifyInputAndOutputIsUntied(
+      std::move(pair.serverConnection),
+      pair.server.getEventBase(),
+      std::move(pair.clientConnection),
+      pair.client.getEventBase());
+}
+
+TEST(InProcessDuplexConnection, ConnectionAndSubscribersAreUntied) {
+  ConnectionPair pair;
+  verifyClosingInputAndOutputDoesntCloseConnection(
+      std::move(pair.serverConnection),
+      pair.server.getEventBase(),
+      std::move(pair.clientConnection),
+      pair.client.getEventBase());
+}
+
+TEST(InProcessDuplexConnection, KeepsFramesAndTheirBoundaries) {
+  ConnectionPair pair;
+  EXPECT_TRUE(pair.clientConnection->isFramed());
+
+  // Sent before there is a subscriber, so they have to be held on to.
+  pair.client.getEventBase()->runInEventBaseThreadAndWait([&] {
+    pair.clientConnection->send(folly::IOBuf::copyBuffer("one"));
+    std::vector<std::unique_ptr<folly::IOBuf>> frames;
+    frames.push_back(folly::IOBuf::copyBuffer("two"));
+    frames.push_back(folly::IOBuf::copyBuffer("three"));
+    pair.clientConnection->sendBatch(std::move(frames));
+  });
+
+  std::vector<std::string> received;
+  folly::Baton<> completed;
+
+  auto subscriber = std::make_shared<MockFrameSubscriber>();
+  EXPECT_CALL(*subscriber, onSubscribe_(_));
+  EXPECT_CALL(*subscriber, onNext_(_))
+      .Times(3)
+      .WillRepeatedly(Invoke([&](const std::unique_ptr<folly::IOBuf>& buf) {
+        received.push_back(buf->moveToFbString().toStdString());
+      }));
+  EXPECT_CALL(*subscriber, onComplete_()).WillOnce(Invoke([&] {
+    completed.post();
+  }));
+
+  pair.server.getEventBase()->runInEventBaseThreadAndWait(
+      [&] { pair.serverConnection->setInput(subscriber); });
+
+  // Destroying one end completes the input of the other, once all frames
+  // have been received.
+  pair.client.getEventBase()->runInEventBaseThreadAndWait(
+      [connection = std::move(pair.clientConnection)] {});
+
+  EXPECT_TRUE(completed.try_wait_for(std::chrono::seconds(1)));
+  EXPECT_EQ((std::vector<std::string>{"one", "two", "three"}), received);
+
+  pair.server.getEventBase()->runInEventBaseThreadAndWait(
+      [connection = std::move(pair.serverConnection)] {});
+}
+
+TEST(InProcessDuplexConnection, ConnectFailsAfterStop) {
+  folly::ScopedEventBaseThread server;
+  folly::ScopedEventBaseThread client;
+
+  InProcessConnectionAcceptor acceptor(*server.getEventBase());
+  InProcessConnectionFactory factory(*client.getEventBase(), acceptor);
+
+  folly::Baton<> accepted;
+  std::unique_ptr<DuplexConnection> serverConnection;
+  acceptor.start([&](std::unique_ptr<DuplexConnection> connection,
+                     EventBase& eventBase) {
+    EXPECT_EQ(server.getEventBase(), &eventBase);
+    serverConnection = std::move(connection);
+    accepted.post();
+  });
+
+  auto connected =
+      factory.connect(ProtocolVersion::Latest, ResumeStatus::NEW_SESSION)
+          .get();
+  EXPECT_EQ(client.getEventBase(), &connected.eventBase);
+  EXPECT_TRUE(accepted.try_wait_for(std::chrono::seconds(1)));
+
+  acceptor.stop();
+  EXPECT_THROW(
+      factory.connect(ProtocolVersion::Latest, ResumeStatus::NEW_SESSION)
+          .get(),
+      std::runtime_error);
+
+  client.getEventBase()->runInEventBaseThreadAndWait(
+      [connection = std::move(connected.connection)] {});
+  server.getEventBase()->runInEventBaseThreadAndWait(
+      [connection = std::move(serverConnection)] {});
+}
+
+} // namespace tests
+} // namespace rsocket
@@ -0,0 +1,234 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <folly/futures/Future.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <folly/synchronization/Baton.h>
+#include <gtest/gtest.h>
+
+#include "rsocket/test/transport/DuplexConnectionTest.h"
+#include "rsocket/transports/uring/IoUringConnectionAcceptor.h"
+#include "rsocket/transports/uring/IoUringConnectionFactory.h"
+#include "yarpl/test_utils/Mocks.h"
+
+namespace rsocket {
+namespace tests {
+
+using namespace folly;
+using namespace rsocket;
+using namespace ::testing;
+
+namespace {
+
+/**
+ * Synchronously create a server and a client.
+ */
+std::pair<
+    std::unique_ptr<ConnectionAcceptor>,
+    std::unique_ptr<ConnectionFactory>>
+makeIoUringClientServer(
+    std::unique_ptr<DuplexConnection>& serverConnection,
+    EventBase** serverEvb,
+    std::unique_ptr<DuplexConnection>& clientConnection,
+    EventBase* clientEvb) {
+  Promise<Unit> serverPromise;
+
+  IoUringConnectionAcceptor::Options options;
+  options.address = folly::SocketAddress{"::", 0};
+  options.threads = 1;
+  options.backlog = 0;
+
+  auto server = std::make_unique<IoUringConnectionAcceptor>(std::move(options));
+  server->start(
+      [&serverPromise, &serverConnection, &serverEvb](
+          std::unique_ptr<DuplexConnection> connection, EventBase& eventBase) {
+        serverConnection = std::move(connection);
+        *serverEvb = &eventBase;
+        serverPromise.setValue();
+      });
+
+  int16_t port = server->listeningPort().value();
+
+  auto client = std::make_unique<IoUringConnectionFactory>(
+      *clientEvb, SocketAddress("localhost", port, true));
+  client->connect(ProtocolVersion::Latest, ResumeStatus::NEW_SESSION)
+      .thenValue([&clientConnection](
+                     ConnectionFactory::ConnectedDuplexConnection connection) {
+        clientConnection = std::move(connection.connection);
+      })
+      .wait();
+
+  serverPromise.getSemiFuture().wait();
+  return std::make_pair(std::move(server), std::move(client));
+}
+
+} // namespace
+
+TEST(IoUringDuplexConnection, MultipleSetInputGetOutputCalls) {
+  if (!IoUringLoop::isAvailable()) {
+    return;
+  }
+  folly::ScopedEventBaseThread worker;
+  std::unique_ptr<DuplexConnection> serverConnection, clientConnection;
+  EventBase* serverEvb = nullptr;
+  auto keepAlive = makeIoUringClientServer(
+      serverConnection, &serverEvb, clientConnection, worker.getEventBase());
+  makeMultipleSetInputGetOutputCalls(
+      std::move(serverConnection),
+      serverEvb,
+      std::move(clientConnection),
+      worker.getEventBase());
+}
+
+TEST(IoUringDuplexConnection, InputAndOutputIsUntied) {
+  if (!IoUringLoop::isAvailable()) {
+    return;
+  }
+  folly::ScopedEventBaseThread worker;
+  std::unique_ptr<DuplexConnection> serverConnection, clientConnection;
+  EventBase* serverEvb = nullptr;
+  auto keepAlive = makeIoUringClientServer(
+      serverConnection, &serverEvb, clientConnection, worker.getEventBase());
+  verifyInputAndOutputIsUntied(
+      std::move(serverConnection),
+      serverEvb,
+      std::move(clientConnection),
+      worker.getEventBase());
+}
+
+TEST(IoUringDuplexConnection, ConnectionAndSubscribersAreUntied) {
+  if (!IoUringLoop::isAvailable()) {
+    return;
+  }
+  folly::ScopedEventBaseThread worker;
+  std::unique_ptr<DuplexConnection> serverConnection, clientConnection;
+  EventBase* serverEvb = nullptr;
+  auto keepAlive = makeIoUringClientServer(
+      serverConnection, &serverEvb, clientConnection, worker.getEventBase());
+  verifyClosingInputAndOutputDoesntCloseConnection(
+      std::move(serverConnection),
+      serverEvb,
+      std::move(clientConnection),
+      worker.getEventBase());
+}
+
+TEST(IoUringDuplexConnection, BatchedSends) {
+  if (!IoUringLoop::isAvailable()) {
+    return;
+  }
+  folly::ScopedEventBaseThread worker;
+  std::unique_ptr<DuplexConnection> serverConnection, clientConnection;
+  EventBase* serverEvb = nullptr;
+  auto keepAlive = makeIoUringClientServer(
+      serverConnection, &serverEvb, clientConnection, worker.getEventBase());
+
+  constexpr size_t kFrames = 100;
+  const std::string frame = "0123456";
+
+  size_t bytesReceived = 0;
+  folly::Baton<> allReceived;
+
+  auto serverSubscriber = std::make_shared<
+      yarpl::mocks::MockSubscriber<std::unique_ptr<folly::IOBuf>>>();
+  EXPECT_CALL(*serverSubscriber, onSubscribe_(_));
+  EXPECT_CALL(*serverSubscriber, onNext_(_))
+      .WillRepeatedly(Invoke([&](const std::unique_ptr<folly::IOBuf>& buf) {
+        bytesReceived += buf->computeChainDataLength();
+        if (bytesReceived == kFrames * frame.size()) {
+          allReceived.post();
+        }
+      }));
+
+  serverEvb->runInEventBaseThreadAndWait(
+      [&] { serverConnection->setInput(serverSubscriber); });
+
+  worker.getEventBase()->runInEventBaseThreadAndWait([&] {
+    for (size_t i = 0; i < kFrames; ++i) {
+      clientConnection->send(folly::IOBuf::copyBuffer(frame));
+    }
+  });
+
+  EXPECT_TRUE(allReceived.try_wait_for(std::chrono::seconds(1)));
+  EXPECT_EQ(kFrames * frame.size(), bytesReceived);
+
+  serverEvb->runInEventBaseThreadAndWait(
+      [subscriber = std::move(serverSubscriber)] {
+        subscriber->subscription()->cancel();
+      });
+  worker.getEventBase()->runInEventBaseThreadAndWait(
+      [connection = std::move(clientConnection)] {});
+  serverEvb->runInEventBaseThreadAndWait(
+      [connection = std::move(serverConnection)] {});
+}
+
+TEST(IoUringDuplexConnection, HeldReceiveBuffersDontStallReceives) {
+  if (!IoUringLoop::isAvailable()) {
+    return;
+  }
+  // Freed last, on this thread, after the loops are gone.
+  std::vector<std::unique_ptr<folly::IOBuf>> held;
+
+  folly::ScopedEventBaseThread worker;
+  std::unique_ptr<DuplexConnection> serverConnection, clientConnection;
+  EventBase* serverEvb = nullptr;
+  auto keepAlive = makeIoUringClientServer(
+      serverConnection, &serverEvb, clientConnection, worker.getEventBase());
+
+  // More sends than there are receive buffers, each in its own iteration.
+  constexpr size_t kFrames = 1000;
+  const std::string frame(1000, 'x');
+
+  size_t bytesReceived = 0;
+  folly::Baton<> allReceived;
+
+  auto serverSubscriber = std::make_shared<
+      yarpl::mocks::MockSubscriber<std::unique_ptr<folly::IOBuf>>>();
+  EXPECT_CALL(*serverSubscriber, onSubscribe_(_));
+  EXPECT_CALL(*serverSubscriber, onNext_(_))
+      .WillRepeatedly(Invoke([&](const std::unique_ptr<folly::IOBuf>& buf) {
+        bytesReceived += buf->computeChainDataLength();
+        held.push_back(buf->clone());
+        if (bytesReceived == kFrames * frame.size()) {
+          allReceived.post();
+        }
+      }));
+
+  serverEvb->runInEventBaseThreadAndWait(
+      [&] { serverConnection->setInput(serverSubscriber); });
+
+  for (size_t i = 0; i < kFrames; ++i) {
+    worker.getEventBase()->runInEventBaseThreadAndWait(
+        [&] { clientConnection->send(folly::IOBuf::copyBuffer(frame)); });
+  }
+
+  EXPECT_TRUE(allReceived.try_wait_for(std::chrono::seconds(5)));
+  EXPECT_EQ(kFrames * frame.size(), bytesReceived);
+
+  // Buffers go back to the ring on the thread of the loop, from another
+  // thread, and once the loop is gone.
+  serverEvb->runInEventBaseThreadAndWait([&] { held.resize(held.size() / 2); });
+  held.resize(held.size() / 2);
+
+  serverEvb->runInEventBaseThreadAndWait(
+      [subscriber = std::move(serverSubscriber)] {
+        subscriber->subscription()->cancel();
+      });
+  worker.getEventBase()->runInEventBaseThreadAndWait(
+      [connection = std::move(clientConnection)] {});
+  serverEvb->runInEventBaseThreadAndWait(
+      [connection = std::move(serverConnection)] {});
+}
+
+} // namespace tests
+} // namespace rsocket
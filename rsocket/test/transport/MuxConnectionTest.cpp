@@ -0,0 +1,177 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <deque>
+#include <limits>
+
+#include "rsocket/test/test_utils/MockDuplexConnection.h"
+#include "rsocket/transports/mux/MuxConnection.h"
+
+using namespace rsocket;
+using namespace testing;
+
+namespace {
+
+/// Two ends of a connection, frames sent on one end are received by the
+/// other in-line.
+class Link {
+ public:
+  std::unique_ptr<DuplexConnection> end(size_t i) {
+    auto connection = std::make_unique<NiceMock<MockDuplexConnection>>();
+    ON_CALL(*connection, isFramed()).WillByDefault(Return(true));
+    ON_CALL(*connection, setInput_(_))
+        .WillByDefault(Invoke(
+            [this, i](std::shared_ptr<DuplexConnection::Subscriber> input) {
+              inputs_[i] = input;
+              input->onSubscribe(std::make_shared<
+                                 NiceMock<yarpl::mocks::MockSubscription>>());
+              while (!pending_[i].empty() && inputs_[i]) {
+                auto frame = std::move(pending_[i].front());
+                pending_[i].pop_front();
+                inputs_[i]->onNext(std::move(frame));
+              }
+            }));
+    ON_CALL(*connection, send_(_))
+        .WillByDefault(
+            Invoke([this, i](std::unique_ptr<folly::IOBuf>& frame) {
+              if (auto& peer = inputs_[1 - i]) {
+                peer->onNext(std::move(frame));
+              } else {
+                pending_[1 - i].push_back(std::move(frame));
+              }
+            }));
+    return std::move(connection);
+  }
+
+  void closeInput(size_t i) {
+    if (auto input = std::move(inputs_[i])) {
+      input->onComplete();
+    }
+  }
+
+ private:
+  std::array<std::shared_ptr<DuplexConnection::Subscriber>, 2> inputs_;
+  std::array<std::deque<std::unique_ptr<folly::IOBuf>>, 2> pending_;
+};
+
+class Collector : public DuplexConnection::Subscriber {
+ public:
+  void onSubscribe(
+      std::shared_ptr<yarpl::flowable::Subscription> subscription) override {
+    subscription->request(std::numeric_limits<int64_t>::max());
+  }
+
+  void onNext(std::unique_ptr<folly::IOBuf> frame) override {
+    frames.push_back(frame->moveToFbString().toStdString());
+  }
+
+  void onComplete() override {
+    completed = true;
+  }
+
+  void onError(folly::exception_wrapper) override {
+    failed = true;
+  }
+
+  std::vector<std::string> frames;
+  bool completed{false};
+  bool failed{false};
+};
+
+struct Muxes {
+  Muxes() {
+    client = MuxConnection::client(link.end(0));
+    server = MuxConnection::server(
+        link.end(1), [this](std::unique_ptr<DuplexConnection> session) {
+          sessions.push_back(std::move(session));
+        });
+  }
+
+  Link link;
+  std::shared_ptr<MuxConnection> client;
+  std::shared_ptr<MuxConnection> server;
+  std::vector<std::unique_ptr<DuplexConnection>> sessions;
+};
+
+} // namespace
+
+TEST(MuxConnectionTest, SessionsAreSeparate) {
+  Muxes muxes;
+  auto first = muxes.client->openSession();
+  auto second = muxes.client->openSession();
+  auto firstInput = std::make_shared<Collector>();
+  auto secondInput = std::make_shared<Collector>();
+  first->setInput(firstInput);
+  second->setInput(secondInput);
+
+  first->send(folly::IOBuf::copyBuffer("one"));
+  second->send(folly::IOBuf::copyBuffer("two"));
+  first->send(folly::IOBuf::copyBuffer("three"));
+  ASSERT_EQ(2, muxes.sessions.size());
+  EXPECT_EQ(2, muxes.server->numSessions());
+
+  // Frames received before a session has a subscriber are held for it.
+  auto firstAccepted = std::make_shared<Collector>();
+  auto secondAccepted = std::make_shared<Collector>();
+  muxes.sessions[0]->setInput(firstAccepted);
+  muxes.sessions[1]->setInput(secondAccepted);
+  EXPECT_EQ((std::vector<std::string>{"one", "three"}), firstAccepted->frames);
+  EXPECT_EQ((std::vector<std::string>{"two"}), secondAccepted->frames);
+
+  muxes.sessions[1]->send(folly::IOBuf::copyBuffer("back"));
+  EXPECT_TRUE(firstInput->frames.empty());
+  EXPECT_EQ((std::vector<std::string>{"back"}), secondInput->frames);
+}
+
+TEST(MuxConnectionTest, ClosingSessionClosesOtherEnd) {
+  Muxes muxes;
+  auto first = muxes.client->openSession();
+  auto second = muxes.client->openSession();
+  first->send(folly::IOBuf::copyBuffer("one"));
+  second->send(folly::IOBuf::copyBuffer("two"));
+  ASSERT_EQ(2, muxes.sessions.size());
+  auto firstAccepted = std::make_shared<Collector>();
+  muxes.sessions[0]->setInput(firstAccepted);
+
+  first.reset();
+  EXPECT_TRUE(firstAccepted->completed);
+  EXPECT_FALSE(muxes.client->isClosed());
+  EXPECT_EQ(1, muxes.client->numSessions());
+
+  // Frames of the closed session are dropped.
+  muxes.sessions[0]->send(folly::IOBuf::copyBuffer("late"));
+
+  // The client end closes with its last session.
+  second.reset();
+  EXPECT_TRUE(muxes.client->isClosed());
+  EXPECT_EQ(nullptr, muxes.client->openSession());
+}
+
+TEST(MuxConnectionTest, ClosingUnderlyingConnectionTerminatesSessions) {
+  Muxes muxes;
+  auto session = muxes.client->openSession();
+  session->send(folly::IOBuf::copyBuffer("one"));
+  ASSERT_EQ(1, muxes.sessions.size());
+  auto accepted = std::make_shared<Collector>();
+  muxes.sessions[0]->setInput(accepted);
+
+  muxes.link.closeInput(1);
+  EXPECT_TRUE(muxes.server->isClosed());
+  EXPECT_EQ(0, muxes.server->numSessions());
+  EXPECT_TRUE(accepted->completed);
+  EXPECT_EQ((std::vector<std::string>{"one"}), accepted->frames);
+}
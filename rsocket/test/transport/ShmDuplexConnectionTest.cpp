@@ -0,0 +1,191 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <unistd.h>
+
+#include <folly/futures/Future.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <folly/synchronization/Baton.h>
+#include <gtest/gtest.h>
+
+#include "rsocket/test/transport/DuplexConnectionTest.h"
+#include "rsocket/transports/shm/ShmConnectionAcceptor.h"
+#include "rsocket/transports/shm/ShmConnectionFactory.h"
+#include "yarpl/test_utils/Mocks.h"
+
+namespace rsocket {
+namespace tests {
+
+using namespace folly;
+using namespace rsocket;
+using namespace ::testing;
+
+namespace {
+
+std::string socketPath() {
+  return "/tmp/rsocket-shm-test-" + std::to_string(::getpid()) + ".sock";
+}
+
+/**
+ * Synchronously create a server and a client.
+ */
+std::pair<
+    std::unique_ptr<ConnectionAcceptor>,
+    std::unique_ptr<ConnectionFactory>>
+makeShmClientServer(
+    std::unique_ptr<DuplexConnection>& serverConnection,
+    EventBase** serverEvb,
+    std::unique_ptr<DuplexConnection>& clientConnection,
+    EventBase* clientEvb,
+    size_t ringCapacity = 1 << 20) {
+  Promise<Unit> serverPromise;
+
+  ShmConnectionAcceptor::Options options;
+  options.path = socketPath();
+  options.threads = 1;
+  options.ringCapacity = ringCapacity;
+
+  auto server = std::make_unique<ShmConnectionAcceptor>(std::move(options));
+  server->start(
+      [&serverPromise, &serverConnection, &serverEvb](
+          std::unique_ptr<DuplexConnection> connection, EventBase& eventBase) {
+        serverConnection = std::move(connection);
+        *serverEvb = &eventBase;
+        serverPromise.setValue();
+      });
+
+  auto client = std::make_unique<ShmConnectionFactory>(*clientEvb, socketPath());
+  client->connect(ProtocolVersion::Latest, ResumeStatus::NEW_SESSION)
+      .thenValue([&clientConnection](
+                     ConnectionFactory::ConnectedDuplexConnection connection) {
+        clientConnection = std::move(connection.connection);
+      })
+      .wait();
+
+  serverPromise.getSemiFuture().wait();
+  return std::make_pair(std::move(server), std::move(client));
+}
+
+} // namespace
+
+TEST(ShmDuplexConnection, MultipleSetInputGetOutputCalls) {
+  folly::ScopedEventBaseThread worker;
+  std::unique_ptr<DuplexConnection> serverConnection, clientConnection;
+  EventBase* serverEvb = nullptr;
+  auto keepAlive = makeShmClientServer(
+      serverConnection, &serverEvb, clientConnection, worker.getEventBase());
+  EXPECT_TRUE(clientConnection->isFramed());
+  makeMultipleSetInputGetOutputCalls(
+      std::move(serverConnection),
+      serverEvb,
+      std::move(clientConnection),
+      worker.getEventBase());
+}
+
+TEST(ShmDuplexConnection, InputAndOutputIsUntied) {
+  folly::ScopedEventBaseThread worker;
+  std::unique_ptr<DuplexConnection> serverConnection, clientConnection;
+  EventBase* serverEvb = nullptr;
+  auto keepAlive = makeShmClientServer(
+      serverConnection, &serverEvb, clientConnection, worker.getEventBase());
+  verifyInputAndOutputIsUntied(
+      std::move(serverConnection),
+      serverEvb,
+      std::move(clientConnection),
+      worker.getEventBase());
+}
+
+TEST(ShmDuplexConnection, ConnectionAndSubscribersAreUntied) {
+  folly::ScopedEventBaseThread worker;
+  std::unique_ptr<DuplexConnection> serverConnection, clientConnection;
+  EventBase* serverEvb = nullptr;
+  auto keepAlive = makeShmClientServer(
+      serverConnection, &serverEvb, clientConnection, worker.getEventBase());
+  verifyClosingInputAndOutputDoesntCloseConnection(
+      std::move(serverConnection),
+      serverEvb,
+      std::move(clientConnection),
+      worker.getEventBase());
+}
+
+TEST(ShmDuplexConnection, FramesLargerThanTheRing) {
+  folly::ScopedEventBaseThread worker;
+  std::unique_ptr<DuplexConnection> serverConnection, clientConnection;
+  EventBase* serverEvb = nullptr;
+  auto keepAlive = makeShmClientServer(
+      serverConnection,
+      &serverEvb,
+      clientConnection,
+      worker.getEventBase(),
+      4096);
+
+  constexpr size_t kFrames = 20;
+  std::vector<std::string> frames;
+  for (size_t i = 0; i < kFrames; ++i) {
+    frames.emplace_back(i * 1000 + 1, static_cast<char>('a' + i));
+  }
+
+  std::vector<std::string> received;
+  folly::Baton<> allReceived;
+
+  auto serverSubscriber = std::make_shared<
+      yarpl::mocks::MockSubscriber<std::unique_ptr<folly::IOBuf>>>();
+  EXPECT_CALL(*serverSubscriber, onSubscribe_(_));
+  EXPECT_CALL(*serverSubscriber, onNext_(_))
+      .Times(kFrames)
+      .WillRepeatedly(Invoke([&](const std::unique_ptr<folly::IOBuf>& buf) {
+        received.push_back(buf->cloneCoalescedAsValue()
+                               .moveToFbString()
+                               .toStdString());
+        if (received.size() == kFrames) {
+          allReceived.post();
+        }
+      }));
+
+  serverEvb->runInEventBaseThreadAndWait(
+      [&] { serverConnection->setInput(serverSubscriber); });
+
+  worker.getEventBase()->runInEventBaseThreadAndWait([&] {
+    for (auto& frame : frames) {
+      // Split over several buffers, as serialized frames are.
+      auto buf = folly::IOBuf::copyBuffer(frame.substr(0, frame.size() / 2));
+      buf->prependChain(
+          folly::IOBuf::copyBuffer(frame.substr(frame.size() / 2)));
+      clientConnection->send(std::move(buf));
+    }
+  });
+
+  EXPECT_TRUE(allReceived.try_wait_for(std::chrono::seconds(5)));
+  EXPECT_EQ(frames, received);
+
+  serverEvb->runInEventBaseThreadAndWait(
+      [subscriber = std::move(serverSubscriber)] {
+        subscriber->subscription()->cancel();
+      });
+  worker.getEventBase()->runInEventBaseThreadAndWait(
+      [connection = std::move(clientConnection)] {});
+  serverEvb->runInEventBaseThreadAndWait(
+      [connection = std::move(serverConnection)] {});
+}
+
+TEST(ShmDuplexConnection, ConnectFailsWithoutServer) {
+  folly::ScopedEventBaseThread worker;
+  ShmConnectionFactory client(*worker.getEventBase(), socketPath() + ".none");
+  EXPECT_THROW(
+      client.connect(ProtocolVersion::Latest, ResumeStatus::NEW_SESSION).get(),
+      std::system_error);
+}
+
+} // namespace tests
+} // namespace rsocket
@@ -0,0 +1,141 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "rsocket/transports/shm/ShmRing.h"
+
+using namespace rsocket;
+
+namespace {
+
+class ShmRingTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    region_.resize(ShmRing::regionSize(kCapacity) / sizeof(uint64_t));
+    ShmRing::initialize(region_.data(), kCapacity);
+    ASSERT_TRUE(writer_.attach(region_.data(), region_.size() * 8));
+    ASSERT_TRUE(reader_.attach(region_.data(), region_.size() * 8));
+  }
+
+  /// Writes a whole frame, returns false if it didn't fit.
+  bool writeFrame(const std::string& frame) {
+    folly::ByteRange data(folly::StringPiece(frame));
+    while (!data.empty()) {
+      if (!writer_.write(data, true)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /// Reads all complete frames.
+  std::vector<std::string> readFrames() {
+    std::vector<std::string> frames;
+    EXPECT_TRUE(reader_.read([&](folly::ByteRange data, bool end) {
+      partial_.append(reinterpret_cast<const char*>(data.data()), data.size());
+      if (end) {
+        frames.push_back(std::move(partial_));
+        partial_.clear();
+      }
+      return true;
+    }));
+    return frames;
+  }
+
+  static constexpr size_t kCapacity{256};
+
+  std::vector<uint64_t> region_;
+  ShmRing writer_;
+  ShmRing reader_;
+  std::string partial_;
+};
+
+} // namespace
+
+TEST_F(ShmRingTest, WriteRead) {
+  EXPECT_TRUE(reader_.empty());
+  EXPECT_TRUE(writeFrame("hello"));
+  EXPECT_TRUE(writeFrame(""));
+  EXPECT_TRUE(writeFrame("world"));
+  EXPECT_FALSE(reader_.empty());
+
+  EXPECT_EQ((std::vector<std::string>{"hello", "", "world"}), readFrames());
+  EXPECT_TRUE(reader_.empty());
+}
+
+TEST_F(ShmRingTest, WrapsAround) {
+  // Frames that don't divide the capacity end up at every offset, and some
+  // of them need the end of the ring padded.
+  const std::string frame(37, 'x');
+  for (int i = 0; i < 100; ++i) {
+    ASSERT_TRUE(writeFrame(frame + std::to_string(i)));
+    ASSERT_EQ(
+        (std::vector<std::string>{frame + std::to_string(i)}), readFrames());
+  }
+}
+
+TEST_F(ShmRingTest, SplitsLargeFrames) {
+  const std::string frame(1000, 'y');
+  folly::ByteRange data(folly::StringPiece(frame));
+  std::vector<std::string> frames;
+
+  while (!data.empty()) {
+    if (!writer_.write(data, true)) {
+      EXPECT_TRUE(writer_.prepareToWaitForSpace());
+      auto read = readFrames();
+      frames.insert(frames.end(), read.begin(), read.end());
+      EXPECT_TRUE(reader_.shouldWakeWriter());
+    }
+  }
+  auto read = readFrames();
+  frames.insert(frames.end(), read.begin(), read.end());
+
+  EXPECT_EQ((std::vector<std::string>{frame}), frames);
+}
+
+TEST_F(ShmRingTest, WaitingFlags) {
+  EXPECT_TRUE(reader_.prepareToWaitForData());
+  EXPECT_TRUE(writeFrame("wake up"));
+  EXPECT_TRUE(writer_.shouldWakeReader());
+  // Only one wakeup per wait.
+  EXPECT_FALSE(writer_.shouldWakeReader());
+
+  // Data is there already, no need to wait.
+  EXPECT_FALSE(reader_.prepareToWaitForData());
+  EXPECT_FALSE(writer_.shouldWakeReader());
+}
+
+TEST_F(ShmRingTest, RejectsMalformedRecords) {
+  ASSERT_TRUE(writeFrame("fine"));
+  // Claim a record far longer than the ring.
+  auto record = reinterpret_cast<uint32_t*>(
+      reinterpret_cast<uint8_t*>(region_.data()) +
+      (ShmRing::regionSize(kCapacity) - kCapacity));
+  record[0] = 100000;
+  EXPECT_FALSE(reader_.read([](folly::ByteRange, bool) { return true; }));
+}
+
+TEST(ShmRing, AttachChecksTheRegion) {
+  std::vector<uint64_t> region(ShmRing::regionSize(256) / sizeof(uint64_t));
+  ShmRing ring;
+  EXPECT_FALSE(ring.attach(region.data(), region.size() * 8));
+
+  ShmRing::initialize(region.data(), 256);
+  EXPECT_FALSE(ring.attach(region.data(), 64));
+  EXPECT_TRUE(ring.attach(region.data(), region.size() * 8));
+}
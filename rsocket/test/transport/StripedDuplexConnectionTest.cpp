@@ -0,0 +1,326 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <folly/io/async/EventBase.h>
+#include <folly/portability/Event.h>
+#include <gtest/gtest.h>
+
+#include <limits>
+
+#include "rsocket/framing/FrameSerializer_v1_0.h"
+#include "rsocket/test/test_utils/MockDuplexConnection.h"
+#include "rsocket/transports/striped/StripeHandshake.h"
+#include "rsocket/transports/striped/StripedConnectionAcceptor.h"
+#include "rsocket/transports/striped/StripedDuplexConnection.h"
+
+using namespace rsocket;
+using namespace testing;
+
+namespace {
+
+std::unique_ptr<folly::IOBuf> cancelFrame(StreamId streamId) {
+  return FrameSerializerV1_0().serializeOut(Frame_CANCEL(streamId));
+}
+
+StreamId streamIdOf(const folly::IOBuf& frame) {
+  return FrameSerializer::peekStreamId(ProtocolVersion::Latest, frame, false)
+      .value();
+}
+
+class Collector : public DuplexConnection::Subscriber {
+ public:
+  void onSubscribe(
+      std::shared_ptr<yarpl::flowable::Subscription> subscription) override {
+    subscription->request(std::numeric_limits<int64_t>::max());
+  }
+
+  void onNext(std::unique_ptr<folly::IOBuf> frame) override {
+    streamIds.push_back(streamIdOf(*frame));
+  }
+
+  void onComplete() override {
+    completed = true;
+  }
+
+  void onError(folly::exception_wrapper) override {
+    failed = true;
+  }
+
+  std::vector<StreamId> streamIds;
+  bool completed{false};
+  bool failed{false};
+};
+
+/// Mock stripes on one EventBase, which remember what is sent over them.
+struct Stripes {
+  explicit Stripes(size_t n, bool holdUntilFirstStripe = false)
+      : inputs(n), sent(n) {
+    std::vector<StripedDuplexConnection::Stripe> stripes;
+    for (size_t i = 0; i < n; ++i) {
+      auto connection = std::make_unique<NiceMock<MockDuplexConnection>>();
+      ON_CALL(*connection, isFramed()).WillByDefault(Return(true));
+      ON_CALL(*connection, setInput_(_))
+          .WillByDefault(Invoke(
+              [this, i](std::shared_ptr<DuplexConnection::Subscriber> input) {
+                inputs[i] = input;
+                input->onSubscribe(std::make_shared<
+                                   NiceMock<yarpl::mocks::MockSubscription>>());
+              }));
+      ON_CALL(*connection, send_(_))
+          .WillByDefault(
+              Invoke([this, i](std::unique_ptr<folly::IOBuf>& frame) {
+                sent[i].push_back(streamIdOf(*frame));
+              }));
+      stripes.push_back(
+          StripedDuplexConnection::Stripe{std::move(connection), &evb});
+    }
+    striped = std::make_unique<StripedDuplexConnection>(
+        std::move(stripes), evb, holdUntilFirstStripe);
+  }
+
+  folly::EventBase evb;
+  std::vector<std::shared_ptr<DuplexConnection::Subscriber>> inputs;
+  std::vector<std::vector<StreamId>> sent;
+  std::unique_ptr<StripedDuplexConnection> striped;
+};
+
+
+/// What the test sees of a connection handed to a StripedConnectionAcceptor.
+struct StripeEnd {
+  std::shared_ptr<DuplexConnection::Subscriber> input;
+  bool destroyed{false};
+};
+
+class StripeConnection : public NiceMock<MockDuplexConnection> {
+ public:
+  explicit StripeConnection(std::shared_ptr<StripeEnd> end) : end_(end) {
+    ON_CALL(*this, isFramed()).WillByDefault(Return(true));
+    ON_CALL(*this, setInput_(_))
+        .WillByDefault(
+            Invoke([end](std::shared_ptr<DuplexConnection::Subscriber> input) {
+              end->input = input;
+              input->onSubscribe(std::make_shared<
+                                 NiceMock<yarpl::mocks::MockSubscription>>());
+            }));
+  }
+
+  ~StripeConnection() override {
+    end_->destroyed = true;
+  }
+
+ private:
+  const std::shared_ptr<StripeEnd> end_;
+};
+
+class StubAcceptor : public ConnectionAcceptor {
+ public:
+  void start(OnDuplexConnectionAccept accept) override {
+    onAccept = std::move(accept);
+  }
+
+  void stop() override {}
+
+  folly::Optional<uint16_t> listeningPort() const override {
+    return folly::none;
+  }
+
+  OnDuplexConnectionAccept onAccept;
+};
+
+/// A StripedConnectionAcceptor over connections the test hands to it, all on
+/// one EventBase.
+struct StripedServer {
+  explicit StripedServer(StripedConnectionAcceptor::Options options =
+                             StripedConnectionAcceptor::Options()) {
+    auto stub = std::make_unique<StubAcceptor>();
+    auto const raw = stub.get();
+    acceptor = std::make_unique<StripedConnectionAcceptor>(
+        std::move(stub), std::move(options));
+    acceptor->start([this](
+                        std::unique_ptr<DuplexConnection> connection,
+                        folly::EventBase&) {
+      accepted.push_back(std::move(connection));
+    });
+    onAccept = &raw->onAccept;
+  }
+
+  /// Hands a connection to the acceptor, which reads `hello` from it.
+  std::shared_ptr<StripeEnd>
+  connect(uint64_t groupId, uint16_t index, uint16_t count) {
+    StripeHello hello;
+    hello.groupId = groupId;
+    hello.index = index;
+    hello.count = count;
+    auto end = std::make_shared<StripeEnd>();
+    (*onAccept)(std::make_unique<StripeConnection>(end), evb);
+    end->input->onNext(serializeStripeHello(hello));
+    settle();
+    return end;
+  }
+
+  /// Runs what the acceptor posted to the EventBase.
+  void settle() {
+    for (int i = 0; i < 8; ++i) {
+      evb.loopOnce(EVLOOP_NONBLOCK);
+    }
+  }
+
+  folly::EventBase evb;
+  std::vector<std::unique_ptr<DuplexConnection>> accepted;
+  std::unique_ptr<StripedConnectionAcceptor> acceptor;
+  OnDuplexConnectionAccept* onAccept{nullptr};
+};
+
+} // namespace
+
+TEST(StripedDuplexConnectionTest, StreamsArePinnedToStripes) {
+  Stripes stripes(3);
+  stripes.striped->send(cancelFrame(0));
+  stripes.striped->send(cancelFrame(1));
+  stripes.striped->send(cancelFrame(3));
+  stripes.striped->send(cancelFrame(2));
+
+  std::vector<std::unique_ptr<folly::IOBuf>> batch;
+  batch.push_back(cancelFrame(5));
+  batch.push_back(cancelFrame(7));
+  batch.push_back(cancelFrame(1));
+  stripes.striped->sendBatch(std::move(batch));
+
+  EXPECT_EQ((std::vector<StreamId>{0, 1, 7, 1}), stripes.sent[0]);
+  EXPECT_EQ((std::vector<StreamId>{3, 2}), stripes.sent[1]);
+  EXPECT_EQ((std::vector<StreamId>{5}), stripes.sent[2]);
+
+  stripes.striped->sendToStripe(2, cancelFrame(1));
+  EXPECT_EQ((std::vector<StreamId>{5, 1}), stripes.sent[2]);
+}
+
+TEST(StripedDuplexConnectionTest, MergesInputOfStripes) {
+  Stripes stripes(2);
+  ASSERT_TRUE(stripes.inputs[0] && stripes.inputs[1]);
+
+  // Frames received before the striped connection has an input are held.
+  stripes.inputs[1]->onNext(cancelFrame(3));
+  auto input = std::make_shared<Collector>();
+  stripes.striped->setInput(input);
+  stripes.inputs[0]->onNext(cancelFrame(1));
+  stripes.inputs[1]->onNext(cancelFrame(5));
+  EXPECT_EQ((std::vector<StreamId>{3, 1, 5}), input->streamIds);
+}
+
+TEST(StripedDuplexConnectionTest, HoldsOtherStripesUntilFirstStripe) {
+  Stripes stripes(2, true);
+  auto input = std::make_shared<Collector>();
+  stripes.striped->setInput(input);
+
+  stripes.inputs[1]->onNext(cancelFrame(3));
+  EXPECT_TRUE(input->streamIds.empty());
+
+  stripes.inputs[0]->onNext(cancelFrame(0));
+  stripes.inputs[1]->onNext(cancelFrame(5));
+  EXPECT_EQ((std::vector<StreamId>{0, 3, 5}), input->streamIds);
+}
+
+TEST(StripedDuplexConnectionTest, ClosingAnyStripeTerminates) {
+  Stripes stripes(2);
+  auto input = std::make_shared<Collector>();
+  stripes.striped->setInput(input);
+
+  auto const second = stripes.inputs[1];
+  second->onError(std::runtime_error("gone"));
+  EXPECT_TRUE(input->failed);
+
+  // Nothing goes out over the closed stripes.
+  stripes.striped->send(cancelFrame(0));
+  stripes.evb.loopOnce();
+  EXPECT_TRUE(stripes.sent[0].empty());
+}
+
+TEST(StripedDuplexConnectionTest, HelloRoundTrip) {
+  StripeHello hello;
+  hello.groupId = 0x0123456789abcdef;
+  hello.index = 2;
+  hello.count = 4;
+
+  auto frame = serializeStripeHello(hello);
+  auto const parsed = parseStripeHello(*frame);
+  ASSERT_TRUE(parsed.hasValue());
+  EXPECT_TRUE(*parsed == hello);
+
+  EXPECT_FALSE(parseStripeHello(*cancelFrame(1)).hasValue());
+}
+
+TEST(StripedConnectionAcceptorTest, AcceptsCompleteGroup) {
+  StripedServer server;
+  auto first = server.connect(7, 0, 2);
+  EXPECT_TRUE(server.accepted.empty());
+  auto second = server.connect(7, 1, 2);
+  EXPECT_EQ(1, server.accepted.size());
+  EXPECT_FALSE(first->destroyed);
+  EXPECT_FALSE(second->destroyed);
+}
+
+TEST(StripedConnectionAcceptorTest, RefusesTooManyStripes) {
+  StripedConnectionAcceptor::Options options;
+  options.maxStripes = 4;
+  StripedServer server{options};
+
+  auto refused = server.connect(7, 0, 5);
+  EXPECT_TRUE(refused->destroyed);
+  auto held = server.connect(8, 0, 4);
+  EXPECT_FALSE(held->destroyed);
+}
+
+TEST(StripedConnectionAcceptorTest, DropsGroupWhenStripeCloses) {
+  StripedServer server;
+  auto first = server.connect(7, 0, 3);
+  auto second = server.connect(7, 1, 3);
+
+  first->input->onComplete();
+  server.settle();
+  EXPECT_TRUE(first->destroyed);
+  EXPECT_TRUE(second->destroyed);
+
+  // The last stripe starts over as a new group.
+  auto third = server.connect(7, 2, 3);
+  EXPECT_FALSE(third->destroyed);
+  EXPECT_TRUE(server.accepted.empty());
+}
+
+TEST(StripedConnectionAcceptorTest, DropsGroupWhenStripeSendsEarly) {
+  StripedServer server;
+  auto first = server.connect(7, 0, 2);
+
+  first->input->onNext(cancelFrame(1));
+  server.settle();
+  EXPECT_TRUE(first->destroyed);
+
+  server.connect(7, 1, 2);
+  EXPECT_TRUE(server.accepted.empty());
+}
+
+TEST(StripedConnectionAcceptorTest, DropsIncompleteGroupAfterTimeout) {
+  StripedConnectionAcceptor::Options options;
+  options.groupTimeout = std::chrono::milliseconds{10};
+  StripedServer server{options};
+
+  auto first = server.connect(7, 0, 2);
+  EXPECT_FALSE(first->destroyed);
+  for (int i = 0; i < 100 && !first->destroyed; ++i) {
+    server.evb.loopOnce();
+  }
+  EXPECT_TRUE(first->destroyed);
+
+  server.connect(7, 1, 2);
+  EXPECT_TRUE(server.accepted.empty());
+}
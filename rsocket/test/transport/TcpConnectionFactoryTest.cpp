@@ -0,0 +1,161 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "rsocket/transports/tcp/TcpConnectionAcceptor.h"
+#include "rsocket/transports/tcp/TcpConnectionFactory.h"
+
+namespace rsocket {
+namespace tests {
+
+using namespace folly;
+using namespace std::chrono_literals;
+
+namespace {
+
+/// Listens on a random port and counts the connections it accepts.
+class CountingServer {
+ public:
+  CountingServer() {
+    TcpConnectionAcceptor::Options options;
+    options.address = SocketAddress{"::", 0};
+    options.threads = 1;
+    acceptor_ = std::make_unique<TcpConnectionAcceptor>(std::move(options));
+    acceptor_->start(
+        [this](std::unique_ptr<DuplexConnection> connection, EventBase& evb) {
+          // Keep the connection open, as a server waiting for SETUP would.
+          std::lock_guard<std::mutex> lock(mutex_);
+          connections_.emplace_back(std::move(connection), &evb);
+          ++accepted;
+        });
+  }
+
+  ~CountingServer() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& connection : connections_) {
+      connection.second->runInEventBaseThreadAndWait(
+          [&] { connection.first.reset(); });
+    }
+  }
+
+  uint16_t port() const {
+    return *acceptor_->listeningPort();
+  }
+
+  /// Waits for the number of accepted connections to reach `count`.
+  bool waitForAccepted(int count) {
+    for (int i = 0; i < 500 && accepted < count; ++i) {
+      std::this_thread::sleep_for(10ms);
+    }
+    return accepted >= count;
+  }
+
+  std::atomic<int> accepted{0};
+
+ private:
+  std::mutex mutex_;
+  std::vector<std::pair<std::unique_ptr<DuplexConnection>, EventBase*>>
+      connections_;
+  std::unique_ptr<TcpConnectionAcceptor> acceptor_;
+};
+
+} // namespace
+
+TEST(TcpConnectionFactoryTest, OpensSpareConnectionsAhead) {
+  CountingServer server;
+  ScopedEventBaseThread worker;
+
+  TcpConnectionFactory::Options options;
+  options.spareConnections = 2;
+  TcpConnectionFactory factory(
+      *worker.getEventBase(),
+      {SocketAddress("::1", server.port())},
+      nullptr,
+      TcpDuplexConnection::Options(),
+      nullptr,
+      options);
+  ASSERT_TRUE(server.waitForAccepted(2));
+
+  auto connection =
+      factory.connect(ProtocolVersion::Latest, ResumeStatus::NEW_SESSION)
+          .get(5s);
+  EXPECT_TRUE(connection.connection);
+
+  // The spare handed out is replaced.
+  EXPECT_TRUE(server.waitForAccepted(3));
+  std::this_thread::sleep_for(50ms);
+  EXPECT_EQ(3, server.accepted);
+
+  worker.getEventBase()->runInEventBaseThreadAndWait(
+      [&] { connection.connection.reset(); });
+}
+
+TEST(TcpConnectionFactoryTest, FallsBackToNextAddress) {
+  CountingServer server;
+  ScopedEventBaseThread worker;
+
+  // Nothing listens on port 1, so the first attempt is refused.
+  TcpConnectionFactory factory(
+      *worker.getEventBase(),
+      {SocketAddress("127.0.0.1", 1), SocketAddress("::1", server.port())},
+      nullptr,
+      TcpDuplexConnection::Options(),
+      nullptr,
+      TcpConnectionFactory::Options());
+
+  auto connection =
+      factory.connect(ProtocolVersion::Latest, ResumeStatus::NEW_SESSION)
+          .get(5s);
+  EXPECT_TRUE(connection.connection);
+  EXPECT_TRUE(server.waitForAccepted(1));
+
+  worker.getEventBase()->runInEventBaseThreadAndWait(
+      [&] { connection.connection.reset(); });
+}
+
+TEST(TcpConnectionFactoryTest, FailsWhenAllAddressesFail) {
+  ScopedEventBaseThread worker;
+
+  TcpConnectionFactory factory(
+      *worker.getEventBase(),
+      {SocketAddress("127.0.0.1", 1), SocketAddress("::1", 1)},
+      nullptr,
+      TcpDuplexConnection::Options(),
+      nullptr,
+      TcpConnectionFactory::Options());
+
+  EXPECT_THROW(
+      factory.connect(ProtocolVersion::Latest, ResumeStatus::NEW_SESSION)
+          .get(5s),
+      AsyncSocketException);
+}
+
+TEST(TcpConnectionFactoryTest, ResolveAddresses) {
+  auto const addresses = TcpConnectionFactory::resolveAddresses("localhost", 7);
+  ASSERT_FALSE(addresses.empty());
+  for (auto const& address : addresses) {
+    EXPECT_TRUE(address.isLoopbackAddress());
+    EXPECT_EQ(7, address.getPort());
+  }
+}
+
+} // namespace tests
+} // namespace rsocket
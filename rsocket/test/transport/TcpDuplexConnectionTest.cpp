@@ -12,7 +12,14 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+
 #include <folly/futures/Future.h>
+#include <folly/synchronization/Baton.h>
+#include <folly/io/async/AsyncSocket.h>
 #include <folly/io/async/AsyncTransport.h>
 #include <folly/io/async/ScopedEventBaseThread.h>
 #include <folly/io/async/ssl/SSLErrors.h>
@@ -21,12 +28,15 @@
 #include "rsocket/test/transport/DuplexConnectionTest.h"
 #include "rsocket/transports/tcp/TcpConnectionAcceptor.h"
 #include "rsocket/transports/tcp/TcpConnectionFactory.h"
+#include "rsocket/transports/tcp/TcpHandoff.h"
+#include "yarpl/test_utils/Mocks.h"
 
 namespace rsocket {
 namespace tests {
 
 using namespace folly;
 using namespace rsocket;
+using namespace ::testing;
 
 /**
  * Synchronously create a server and a client.
@@ -38,13 +48,16 @@ makeSingleClientServer(
     std::unique_ptr<DuplexConnection>& serverConnection,
     EventBase** serverEvb,
     std::unique_ptr<DuplexConnection>& clientConnection,
-    EventBase* clientEvb) {
+    EventBase* clientEvb,
+    TcpDuplexConnection::Options connectionOptions =
+        TcpDuplexConnection::Options()) {
   Promise<Unit> serverPromise;
 
   TcpConnectionAcceptor::Options options;
   options.address = folly::SocketAddress{"::", 0};
   options.threads = 1;
   options.backlog = 0;
+  options.connection = connectionOptions;
 
   auto server = std::make_unique<TcpConnectionAcceptor>(std::move(options));
   server->start(
@@ -58,7 +71,10 @@ makeSingleClientServer(
   int16_t port = server->listeningPort().value();
 
   auto client = std::make_unique<TcpConnectionFactory>(
-      *clientEvb, SocketAddress("localhost", port, true));
+      *clientEvb,
+      SocketAddress("localhost", port, true),
+      nullptr,
+      connectionOptions);
   client->connect(ProtocolVersion::Latest, ResumeStatus::NEW_SESSION)
       .thenValue([&clientConnection](
                      ConnectionFactory::ConnectedDuplexConnection connection) {
@@ -109,6 +125,306 @@ TEST(TcpDuplexConnection, ConnectionAndSubscribersAreUntied) {
       worker.getEventBase());
 }
 
+TEST(TcpDuplexConnection, CoalescedWrites) {
+  folly::ScopedEventBaseThread worker;
+  std::unique_ptr<DuplexConnection> serverConnection, clientConnection;
+  EventBase* serverEvb = nullptr;
+
+  TcpDuplexConnection::Options connectionOptions;
+  connectionOptions.coalesceWrites = true;
+  connectionOptions.maxCoalescedFrames = 16;
+
+  auto keepAlive = makeSingleClientServer(
+      serverConnection,
+      &serverEvb,
+      clientConnection,
+      worker.getEventBase(),
+      connectionOptions);
+
+  constexpr size_t kFrames = 100;
+  const std::string frame = "0123456";
+
+  size_t bytesReceived = 0;
+  folly::Baton<> allReceived;
+
+  auto serverSubscriber = std::make_shared<
+      yarpl::mocks::MockSubscriber<std::unique_ptr<folly::IOBuf>>>();
+  EXPECT_CALL(*serverSubscriber, onSubscribe_(_));
+  EXPECT_CALL(*serverSubscriber, onNext_(_))
+      .WillRepeatedly(Invoke([&](const std::unique_ptr<folly::IOBuf>& buf) {
+        bytesReceived += buf->computeChainDataLength();
+        if (bytesReceived == kFrames * frame.size()) {
+          allReceived.post();
+        }
+      }));
+
+  serverEvb->runInEventBaseThreadAndWait(
+      [&] { serverConnection->setInput(serverSubscriber); });
+
+  worker.getEventBase()->runInEventBaseThreadAndWait([&] {
+    for (size_t i = 0; i < kFrames; ++i) {
+      clientConnection->send(folly::IOBuf::copyBuffer(frame));
+    }
+  });
+
+  EXPECT_TRUE(allReceived.try_wait_for(std::chrono::seconds(1)));
+  EXPECT_EQ(kFrames * frame.size(), bytesReceived);
+
+  serverEvb->runInEventBaseThreadAndWait(
+      [subscriber = std::move(serverSubscriber)] {
+        subscriber->subscription()->cancel();
+      });
+  worker.getEventBase()->runInEventBaseThreadAndWait(
+      [connection = std::move(clientConnection)] {});
+  serverEvb->runInEventBaseThreadAndWait(
+      [connection = std::move(serverConnection)] {});
+}
+
+TEST(TcpDuplexConnection, ZeroCopyWrites) {
+  folly::ScopedEventBaseThread worker;
+  std::unique_ptr<DuplexConnection> serverConnection, clientConnection;
+  EventBase* serverEvb = nullptr;
+
+  TcpDuplexConnection::Options connectionOptions;
+  connectionOptions.zeroCopyThreshold = 16 * 1024;
+
+  auto keepAlive = makeSingleClientServer(
+      serverConnection,
+      &serverEvb,
+      clientConnection,
+      worker.getEventBase(),
+      connectionOptions);
+
+  // Alternate frames above and below the threshold.  Whether or not the
+  // kernel supports MSG_ZEROCOPY, every byte must arrive intact and in order.
+  constexpr size_t kFrames = 16;
+  std::string expected;
+  std::vector<std::string> frames;
+  for (size_t i = 0; i < kFrames; ++i) {
+    auto const size = i % 2 == 0 ? 128 * 1024 : 100;
+    frames.emplace_back(size, static_cast<char>('a' + i));
+    expected += frames.back();
+  }
+
+  std::string received;
+  folly::Baton<> allReceived;
+
+  auto serverSubscriber = std::make_shared<
+      yarpl::mocks::MockSubscriber<std::unique_ptr<folly::IOBuf>>>();
+  EXPECT_CALL(*serverSubscriber, onSubscribe_(_));
+  EXPECT_CALL(*serverSubscriber, onNext_(_))
+      .WillRepeatedly(Invoke([&](const std::unique_ptr<folly::IOBuf>& buf) {
+        received += buf->cloneCoalescedAsValue().moveToFbString().toStdString();
+        if (received.size() == expected.size()) {
+          allReceived.post();
+        }
+      }));
+
+  serverEvb->runInEventBaseThreadAndWait(
+      [&] { serverConnection->setInput(serverSubscriber); });
+
+  worker.getEventBase()->runInEventBaseThreadAndWait([&] {
+    for (auto& frame : frames) {
+      clientConnection->send(folly::IOBuf::copyBuffer(frame));
+    }
+  });
+
+  EXPECT_TRUE(allReceived.try_wait_for(std::chrono::seconds(5)));
+  EXPECT_EQ(expected, received);
+
+  serverEvb->runInEventBaseThreadAndWait(
+      [subscriber = std::move(serverSubscriber)] {
+        subscriber->subscription()->cancel();
+      });
+  worker.getEventBase()->runInEventBaseThreadAndWait(
+      [connection = std::move(clientConnection)] {});
+  serverEvb->runInEventBaseThreadAndWait(
+      [connection = std::move(serverConnection)] {});
+}
+
+namespace {
+
+/// A TcpDuplexConnection reading one end of a socketpair on an EventBase the
+/// test drives itself, so that every write to the other end is read in as few
+/// reads as the read buffer allows.
+class ReadBufferProbe {
+ public:
+  explicit ReadBufferProbe(TcpDuplexConnection::Options options) {
+    int fds[2];
+    ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    peer_ = fds[1];
+    connection_ = std::make_unique<TcpDuplexConnection>(
+        folly::AsyncTransportWrapper::UniquePtr(new folly::AsyncSocket(
+            &evb_, folly::NetworkSocket::fromFd(fds[0]))),
+        nullptr,
+        std::move(options));
+
+    subscriber_ = std::make_shared<NiceMock<
+        yarpl::mocks::MockSubscriber<std::unique_ptr<folly::IOBuf>>>>();
+    ON_CALL(*subscriber_, onNext_(_))
+        .WillByDefault(Invoke([this](const std::unique_ptr<folly::IOBuf>& buf) {
+          received_ += buf->computeChainDataLength();
+        }));
+    connection_->setInput(subscriber_);
+  }
+
+  ~ReadBufferProbe() {
+    subscriber_->subscription()->cancel();
+    connection_.reset();
+    ::close(peer_);
+  }
+
+  /// Writes the bytes in one go, then loops until the connection read them.
+  void deliver(size_t bytes) {
+    auto const target = received_ + bytes;
+    std::string const data(bytes, 'x');
+    size_t written = 0;
+    while (written < bytes) {
+      auto const n = ::write(peer_, data.data() + written, bytes - written);
+      ASSERT_GT(n, 0);
+      written += n;
+    }
+    while (received_ < target) {
+      evb_.loopOnce();
+    }
+  }
+
+  TcpDuplexConnection& connection() {
+    return *connection_;
+  }
+
+  size_t readBufferSize() const {
+    return connection_->readBufferSize();
+  }
+
+ private:
+  folly::EventBase evb_;
+  int peer_{-1};
+  std::unique_ptr<TcpDuplexConnection> connection_;
+  std::shared_ptr<
+      NiceMock<yarpl::mocks::MockSubscriber<std::unique_ptr<folly::IOBuf>>>>
+      subscriber_;
+  size_t received_{0};
+};
+
+TcpDuplexConnection::Options adaptiveReadBufferOptions() {
+  TcpDuplexConnection::Options options;
+  options.adaptiveReadBuffer = true;
+  options.minReadBufferSize = 4 * 1024;
+  options.maxReadBufferSize = 16 * 1024;
+  return options;
+}
+
+} // namespace
+
+TEST(TcpDuplexConnection, AdaptiveReadBufferGrowsAfterFullReads) {
+  ReadBufferProbe probe{adaptiveReadBufferOptions()};
+  EXPECT_EQ(4 * 1024, probe.readBufferSize());
+
+  // Each read fills its buffer, so the buffer doubles up to the upper bound.
+  probe.deliver(64 * 1024);
+  EXPECT_EQ(16 * 1024, probe.readBufferSize());
+
+  probe.deliver(64 * 1024);
+  EXPECT_EQ(16 * 1024, probe.readBufferSize());
+}
+
+TEST(TcpDuplexConnection, AdaptiveReadBufferShrinksAfterSmallReads) {
+  ReadBufferProbe probe{adaptiveReadBufferOptions()};
+  probe.deliver(64 * 1024);
+  ASSERT_EQ(16 * 1024, probe.readBufferSize());
+  // Neither full nor small, this ends any run of small reads.
+  probe.deliver(8 * 1024);
+  ASSERT_EQ(16 * 1024, probe.readBufferSize());
+
+  // It takes a whole run of small reads to halve the buffer.
+  for (size_t i = 1; i < 8; ++i) {
+    probe.deliver(16);
+  }
+  EXPECT_EQ(16 * 1024, probe.readBufferSize());
+  probe.deliver(16);
+  EXPECT_EQ(8 * 1024, probe.readBufferSize());
+
+  // And it never shrinks below the lower bound.
+  for (size_t i = 0; i < 32; ++i) {
+    probe.deliver(16);
+    EXPECT_GE(probe.readBufferSize(), 4 * 1024);
+  }
+  EXPECT_EQ(4 * 1024, probe.readBufferSize());
+}
+
+TEST(TcpDuplexConnection, AdaptiveReadBufferKeepsHintedFloor) {
+  ReadBufferProbe probe{adaptiveReadBufferOptions()};
+  probe.connection().setReadBufferSizeHint(10000);
+  EXPECT_EQ(10000 + sizeof(uint32_t), probe.readBufferSize());
+
+  probe.deliver(64 * 1024);
+  EXPECT_EQ(16 * 1024, probe.readBufferSize());
+  for (size_t i = 0; i < 32; ++i) {
+    probe.deliver(16);
+  }
+  EXPECT_EQ(10000 + sizeof(uint32_t), probe.readBufferSize());
+}
+
+TEST(TcpDuplexConnection, FixedReadBuffer) {
+  auto options = adaptiveReadBufferOptions();
+  options.adaptiveReadBuffer = false;
+  ReadBufferProbe probe{options};
+
+  probe.deliver(64 * 1024);
+  EXPECT_EQ(4 * 1024, probe.readBufferSize());
+  for (size_t i = 0; i < 16; ++i) {
+    probe.deliver(16);
+  }
+  EXPECT_EQ(4 * 1024, probe.readBufferSize());
+}
+
+TEST(TcpDuplexConnection, ReusePortListeners) {
+  constexpr size_t kClients = 16;
+
+  TcpConnectionAcceptor::Options options;
+  options.address = folly::SocketAddress{"::", 0};
+  options.threads = 4;
+  options.reusePort = true;
+
+  std::atomic<size_t> accepted{0};
+  std::atomic<size_t> acceptedOnOtherThread{0};
+  folly::Baton<> allAccepted;
+
+  TcpConnectionAcceptor server(std::move(options));
+  server.start(
+      [&](std::unique_ptr<DuplexConnection>, EventBase& eventBase) {
+        if (!eventBase.isInEventBaseThread()) {
+          ++acceptedOnOtherThread;
+        }
+        if (++accepted == kClients) {
+          allAccepted.post();
+        }
+      });
+  auto const port = server.listeningPort().value();
+
+  folly::ScopedEventBaseThread worker;
+  std::vector<std::unique_ptr<TcpConnectionFactory>> clients;
+  std::vector<std::unique_ptr<DuplexConnection>> clientConnections;
+  for (size_t i = 0; i < kClients; ++i) {
+    clients.push_back(std::make_unique<TcpConnectionFactory>(
+        *worker.getEventBase(), SocketAddress("localhost", port, true)));
+    clients.back()
+        ->connect(ProtocolVersion::Latest, ResumeStatus::NEW_SESSION)
+        .thenValue([&](ConnectionFactory::ConnectedDuplexConnection c) {
+          clientConnections.push_back(std::move(c.connection));
+        })
+        .wait();
+  }
+
+  allAccepted.wait();
+  EXPECT_EQ(0, acceptedOnOtherThread);
+
+  worker.getEventBase()->runInEventBaseThreadAndWait(
+      [&] { clientConnections.clear(); });
+  server.stop();
+}
+
 TEST(TcpDuplexConnection, ExceptionWrapperTest) {
   folly::AsyncSocketException socketException(
       folly::AsyncSocketException::AsyncSocketExceptionType::INVALID_STATE,
@@ -129,5 +445,159 @@ TEST(TcpDuplexConnection, ExceptionWrapperTest) {
       std::make_exception_ptr(socketExceptionRef), socketExceptionRef);
 }
 
+TEST(TcpDuplexConnection, UnixSocket) {
+  auto const address = folly::SocketAddress::makeFromPath(
+      "/tmp/rsocket-tcp-test-" + std::to_string(::getpid()) + ".sock");
+
+  folly::ScopedEventBaseThread worker;
+  std::unique_ptr<DuplexConnection> serverConnection, clientConnection;
+  EventBase* serverEvb = nullptr;
+  folly::Baton<> accepted;
+
+  TcpConnectionAcceptor::Options options;
+  options.address = address;
+  options.threads = 1;
+
+  TcpConnectionAcceptor server(std::move(options));
+  server.start([&](std::unique_ptr<DuplexConnection> connection,
+                   EventBase& eventBase) {
+    serverConnection = std::move(connection);
+    serverEvb = &eventBase;
+    accepted.post();
+  });
+  EXPECT_FALSE(server.listeningPort());
+
+  TcpConnectionFactory client(*worker.getEventBase(), address);
+  clientConnection =
+      client.connect(ProtocolVersion::Latest, ResumeStatus::NEW_SESSION)
+          .get()
+          .connection;
+  ASSERT_TRUE(accepted.try_wait_for(std::chrono::seconds(1)));
+
+  makeMultipleSetInputGetOutputCalls(
+      std::move(serverConnection),
+      serverEvb,
+      std::move(clientConnection),
+      worker.getEventBase());
+}
+
+TEST(TcpDuplexConnection, HandOffListener) {
+  int channel[2];
+  ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_SEQPACKET, 0, channel));
+
+  TcpConnectionAcceptor::Options oldOptions;
+  oldOptions.address = folly::SocketAddress{"::", 0};
+  oldOptions.threads = 1;
+  TcpConnectionAcceptor oldServer(std::move(oldOptions));
+  oldServer.start([](std::unique_ptr<DuplexConnection>, EventBase&) {
+    ADD_FAILURE() << "The old server mustn't accept after the handoff";
+  });
+  auto const port = oldServer.listeningPort().value();
+
+  sendSockets(
+      folly::NetworkSocket::fromFd(channel[0]),
+      {oldServer.listenerSocket()},
+      folly::StringPiece("listener"));
+  std::string data;
+  auto sockets =
+      receiveSockets(folly::NetworkSocket::fromFd(channel[1]), data);
+  ASSERT_EQ(1, sockets.size());
+  EXPECT_EQ("listener", data);
+
+  folly::Baton<> accepted;
+  std::unique_ptr<DuplexConnection> serverConnection;
+  EventBase* serverEvb = nullptr;
+
+  TcpConnectionAcceptor::Options newOptions;
+  newOptions.listener = sockets[0];
+  newOptions.threads = 1;
+  TcpConnectionAcceptor newServer(std::move(newOptions));
+  newServer.start([&](std::unique_ptr<DuplexConnection> connection,
+                      EventBase& eventBase) {
+    serverConnection = std::move(connection);
+    serverEvb = &eventBase;
+    accepted.post();
+  });
+  oldServer.stop();
+  EXPECT_EQ(port, newServer.listeningPort().value());
+
+  folly::ScopedEventBaseThread worker;
+  TcpConnectionFactory client(
+      *worker.getEventBase(), SocketAddress("localhost", port, true));
+  auto clientConnection =
+      client.connect(ProtocolVersion::Latest, ResumeStatus::NEW_SESSION)
+          .get()
+          .connection;
+  EXPECT_TRUE(accepted.try_wait_for(std::chrono::seconds(1)));
+
+  worker.getEventBase()->runInEventBaseThreadAndWait(
+      [connection = std::move(clientConnection)] {});
+  serverEvb->runInEventBaseThreadAndWait(
+      [connection = std::move(serverConnection)] {});
+  ::close(channel[0]);
+  ::close(channel[1]);
+}
+
+TEST(TcpDuplexConnection, HandOffConnection) {
+  folly::ScopedEventBaseThread worker;
+  std::unique_ptr<DuplexConnection> serverConnection, clientConnection;
+  EventBase* serverEvb = nullptr;
+  auto keepAlive = makeSingleClientServer(
+      serverConnection, &serverEvb, clientConnection, worker.getEventBase());
+
+  int channel[2];
+  ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_SEQPACKET, 0, channel));
+
+  folly::NetworkSocket detached;
+  serverEvb->runInEventBaseThreadAndWait([&] {
+    detached =
+        dynamic_cast<TcpDuplexConnection&>(*serverConnection).detachSocket();
+    serverConnection.reset();
+  });
+  ASSERT_NE(folly::NetworkSocket(), detached);
+
+  sendSockets(
+      folly::NetworkSocket::fromFd(channel[0]),
+      {detached},
+      folly::StringPiece("connection"));
+  ::close(detached.toFd());
+  std::string data;
+  auto sockets =
+      receiveSockets(folly::NetworkSocket::fromFd(channel[1]), data);
+  ASSERT_EQ(1, sockets.size());
+
+  // The successor picks up the connection without the client noticing.
+  folly::ScopedEventBaseThread successor;
+  auto const successorEvb = successor.getEventBase();
+  std::unique_ptr<DuplexConnection> adopted;
+  successorEvb->runInEventBaseThreadAndWait([&] {
+    adopted = TcpConnectionFactory::createDuplexConnectionFromSocket(
+        folly::AsyncTransportWrapper::UniquePtr(
+            new folly::AsyncSocket(successorEvb, sockets[0])));
+  });
+
+  auto serverSubscriber = std::make_shared<
+      yarpl::mocks::MockSubscriber<std::unique_ptr<folly::IOBuf>>>();
+  EXPECT_CALL(*serverSubscriber, onSubscribe_(_));
+  EXPECT_CALL(*serverSubscriber, onNext_(_));
+  successorEvb->runInEventBaseThreadAndWait(
+      [&] { adopted->setInput(serverSubscriber); });
+
+  worker.getEventBase()->runInEventBaseThreadAndWait(
+      [&] { clientConnection->send(folly::IOBuf::copyBuffer("still here")); });
+  serverSubscriber->awaitFrames(1);
+
+  successorEvb->runInEventBaseThreadAndWait(
+      [subscriber = std::move(serverSubscriber)] {
+        subscriber->subscription()->cancel();
+      });
+  worker.getEventBase()->runInEventBaseThreadAndWait(
+      [connection = std::move(clientConnection)] {});
+  successorEvb->runInEventBaseThreadAndWait(
+      [connection = std::move(adopted)] {});
+  ::close(channel[0]);
+  ::close(channel[1]);
+}
+
 } // namespace tests
 } // namespace rsocket
@@ -0,0 +1,378 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <folly/Synchronized.h>
+#include <folly/io/async/SSLContext.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <folly/portability/OpenSSL.h>
+#include <folly/ssl/OpenSSLPtrTypes.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include "rsocket/transports/tcp/TcpConnectionAcceptor.h"
+#include "rsocket/transports/tcp/TcpConnectionFactory.h"
+#include "rsocket/transports/tcp/TlsSessionCache.h"
+#include "yarpl/test_utils/Mocks.h"
+
+namespace rsocket {
+namespace tests {
+
+using namespace ::testing;
+
+namespace {
+
+using Subscriber = yarpl::mocks::MockSubscriber<std::unique_ptr<folly::IOBuf>>;
+
+folly::ssl::EvpPkeyUniquePtr makeKey() {
+  std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)> context(
+      EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr), EVP_PKEY_CTX_free);
+  EVP_PKEY* key = nullptr;
+  CHECK(context);
+  CHECK_EQ(1, EVP_PKEY_keygen_init(context.get()));
+  CHECK_EQ(
+      1,
+      EVP_PKEY_CTX_set_ec_paramgen_curve_nid(
+          context.get(), NID_X9_62_prime256v1));
+  CHECK_EQ(1, EVP_PKEY_keygen(context.get(), &key));
+  return folly::ssl::EvpPkeyUniquePtr(key);
+}
+
+/// A server context with a self-signed certificate for "localhost", made up
+/// on the spot, which caches sessions for the clients to resume.
+std::shared_ptr<folly::SSLContext> makeServerContext() {
+  auto const key = makeKey();
+  folly::ssl::X509UniquePtr certificate(X509_new());
+  X509_set_version(certificate.get(), 2);
+  ASN1_INTEGER_set(X509_get_serialNumber(certificate.get()), 1);
+  X509_gmtime_adj(X509_getm_notBefore(certificate.get()), 0);
+  X509_gmtime_adj(X509_getm_notAfter(certificate.get()), 24 * 60 * 60);
+  auto const name = X509_get_subject_name(certificate.get());
+  X509_NAME_add_entry_by_txt(
+      name,
+      "CN",
+      MBSTRING_ASC,
+      reinterpret_cast<const unsigned char*>("localhost"),
+      -1,
+      -1,
+      0);
+  X509_set_issuer_name(certificate.get(), name);
+  X509_set_pubkey(certificate.get(), key.get());
+  CHECK_LT(0, X509_sign(certificate.get(), key.get(), EVP_sha256()));
+
+  auto context = std::make_shared<folly::SSLContext>();
+  auto const ctx = context->getSSLCtx();
+  // Both take references of their own.
+  CHECK_EQ(1, SSL_CTX_use_certificate(ctx, certificate.get()));
+  CHECK_EQ(1, SSL_CTX_use_PrivateKey(ctx, key.get()));
+
+  static const unsigned char kSessionContext[] = "rsocket-test";
+  SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+  SSL_CTX_set_session_id_context(
+      ctx, kSessionContext, sizeof(kSessionContext) - 1);
+  return context;
+}
+
+/// A client context trusting any certificate.  Limited to TLS 1.2, which is
+/// all TlsSessionCache resumes.
+std::shared_ptr<folly::SSLContext> makeClientContext() {
+  auto context = std::make_shared<folly::SSLContext>();
+  context->setVerificationOption(
+      folly::SSLContext::SSLVerifyPeerEnum::NO_VERIFY);
+  SSL_CTX_set_max_proto_version(context->getSSLCtx(), TLS1_2_VERSION);
+  return context;
+}
+
+/// Polls `condition` for up to five seconds.
+bool eventually(std::function<bool()> condition) {
+  for (int i = 0; i < 500; ++i) {
+    if (condition()) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+  }
+  return condition();
+}
+
+/// A plain TCP connection, which doesn't speak TLS.
+int connectPlain(uint16_t port) {
+  folly::SocketAddress const address("localhost", port, true);
+  sockaddr_storage storage;
+  auto const length = address.getAddress(&storage);
+  auto const fd = ::socket(address.getFamily(), SOCK_STREAM, 0);
+  CHECK_LE(0, fd);
+  CHECK_EQ(0, ::connect(fd, reinterpret_cast<sockaddr*>(&storage), length));
+
+  timeval timeout{5, 0};
+  ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  return fd;
+}
+
+/// Whether the peer closes the socket within five seconds.  Whatever it sends
+/// before, like a TLS alert, is skipped.  A peer closing with bytes left
+/// unread resets the connection instead.
+bool closedByPeer(int fd) {
+  char buffer[256];
+  while (true) {
+    auto const n = ::read(fd, buffer, sizeof(buffer));
+    if (n <= 0) {
+      return n == 0 || errno == ECONNRESET;
+    }
+  }
+}
+
+/// A TLS acceptor on a single worker thread, holding on to the connections
+/// it hands on.
+class TlsServer {
+ public:
+  TlsServer() : TlsServer(TcpConnectionAcceptor::Options()) {}
+
+  explicit TlsServer(TcpConnectionAcceptor::Options options) {
+    options.address = folly::SocketAddress{"::", 0};
+    options.threads = 1;
+    options.sslContext = makeServerContext();
+    acceptor_ = std::make_unique<TcpConnectionAcceptor>(std::move(options));
+    acceptor_->start([this](
+                         std::unique_ptr<DuplexConnection> connection,
+                         folly::EventBase& evb) {
+      accepted_.wlock()->emplace_back(std::move(connection), &evb);
+    });
+  }
+
+  ~TlsServer() {
+    auto accepted = std::move(*accepted_.wlock());
+    for (auto& connection : accepted) {
+      connection.second->runInEventBaseThreadAndWait(
+          [c = std::move(connection.first)] {});
+    }
+    acceptor_.reset();
+  }
+
+  uint16_t port() const {
+    return *acceptor_->listeningPort();
+  }
+
+  TcpConnectionAcceptor& acceptor() {
+    return *acceptor_;
+  }
+
+  size_t accepted() const {
+    return accepted_.rlock()->size();
+  }
+
+  /// Waits for a connection to be handed on, and takes it.
+  std::pair<std::unique_ptr<DuplexConnection>, folly::EventBase*> take() {
+    std::pair<std::unique_ptr<DuplexConnection>, folly::EventBase*> taken;
+    eventually([&] {
+      auto accepted = accepted_.wlock();
+      if (accepted->empty()) {
+        return false;
+      }
+      taken = std::move(accepted->front());
+      accepted->erase(accepted->begin());
+      return true;
+    });
+    return taken;
+  }
+
+ private:
+  std::unique_ptr<TcpConnectionAcceptor> acceptor_;
+  folly::Synchronized<std::vector<
+      std::pair<std::unique_ptr<DuplexConnection>, folly::EventBase*>>>
+      accepted_;
+};
+
+/// Expects a single read of `data`.
+std::shared_ptr<Subscriber> expectRead(std::string data) {
+  auto subscriber = std::make_shared<Subscriber>();
+  EXPECT_CALL(*subscriber, onSubscribe_(_));
+  EXPECT_CALL(*subscriber, onNext_(_))
+      .WillOnce(Invoke([data](const std::unique_ptr<folly::IOBuf>& buf) {
+        EXPECT_EQ(data, buf->moveToFbString().toStdString());
+      }));
+  return subscriber;
+}
+
+/// Connects to the server over TLS, and sends a message each way.
+void roundTrip(
+    TlsServer& server,
+    TcpConnectionFactory& factory,
+    folly::EventBase& clientEvb) {
+  auto client =
+      factory.connect(ProtocolVersion::Latest, ResumeStatus::NEW_SESSION)
+          .get(std::chrono::seconds{5})
+          .connection;
+  auto accepted = server.take();
+  ASSERT_TRUE(accepted.first);
+  auto const serverEvb = accepted.second;
+
+  auto serverSubscriber = expectRead("ping");
+  auto clientSubscriber = expectRead("pong");
+  serverEvb->runInEventBaseThreadAndWait(
+      [&] { accepted.first->setInput(serverSubscriber); });
+  clientEvb.runInEventBaseThreadAndWait([&] {
+    client->setInput(clientSubscriber);
+    client->send(folly::IOBuf::copyBuffer("ping"));
+  });
+  serverSubscriber->awaitFrames(1);
+  serverEvb->runInEventBaseThreadAndWait(
+      [&] { accepted.first->send(folly::IOBuf::copyBuffer("pong")); });
+  clientSubscriber->awaitFrames(1);
+
+  serverEvb->runInEventBaseThreadAndWait(
+      [subscriber = std::move(serverSubscriber),
+       connection = std::move(accepted.first)] {
+        subscriber->subscription()->cancel();
+      });
+  clientEvb.runInEventBaseThreadAndWait(
+      [subscriber = std::move(clientSubscriber),
+       connection = std::move(client)] {
+        subscriber->subscription()->cancel();
+      });
+}
+
+/// Hands connections to the worker through the Dispatcher, which stops
+/// accepting as soon as a single handshake is pending on the worker.  A
+/// handshake that isn't accounted for when it ends stalls accepting.
+TcpConnectionAcceptor::Options pacedOptions() {
+  TcpConnectionAcceptor::Options options;
+  options.acceptPacing.emplace();
+  options.acceptPacing->maxPendingConnections = 0;
+  options.acceptPacing->maxQueueDelay = std::chrono::seconds{1};
+  options.acceptPacing->checkInterval = std::chrono::milliseconds{1};
+  return options;
+}
+
+} // namespace
+
+TEST(TcpTls, RoundTrip) {
+  TlsServer server;
+  folly::ScopedEventBaseThread worker;
+  TcpConnectionFactory factory(
+      *worker.getEventBase(),
+      folly::SocketAddress("localhost", server.port(), true),
+      makeClientContext());
+  roundTrip(server, factory, *worker.getEventBase());
+  EXPECT_EQ(0, server.acceptor().pendingHandshakes());
+}
+
+TEST(TcpTls, HandshakeFailure) {
+  TlsServer server{pacedOptions()};
+  auto const fd = connectPlain(server.port());
+  ASSERT_TRUE(eventually(
+      [&] { return server.acceptor().pendingHandshakes() == 1; }));
+
+  // Not a ClientHello.
+  std::string const garbage(64, 'x');
+  ASSERT_EQ(
+      static_cast<ssize_t>(garbage.size()),
+      ::write(fd, garbage.data(), garbage.size()));
+  EXPECT_TRUE(closedByPeer(fd));
+  ::close(fd);
+  EXPECT_TRUE(eventually(
+      [&] { return server.acceptor().pendingHandshakes() == 0; }));
+  EXPECT_EQ(0, server.accepted());
+
+  // The worker is no longer counted as busy with the handshake.
+  folly::ScopedEventBaseThread worker;
+  TcpConnectionFactory factory(
+      *worker.getEventBase(),
+      folly::SocketAddress("localhost", server.port(), true),
+      makeClientContext());
+  roundTrip(server, factory, *worker.getEventBase());
+}
+
+TEST(TcpTls, HandshakeTimeout) {
+  auto options = pacedOptions();
+  options.handshakeTimeout = std::chrono::milliseconds{100};
+  TlsServer server{std::move(options)};
+
+  auto const fd = connectPlain(server.port());
+  EXPECT_TRUE(closedByPeer(fd));
+  ::close(fd);
+  EXPECT_TRUE(eventually(
+      [&] { return server.acceptor().pendingHandshakes() == 0; }));
+  EXPECT_EQ(0, server.accepted());
+
+  folly::ScopedEventBaseThread worker;
+  TcpConnectionFactory factory(
+      *worker.getEventBase(),
+      folly::SocketAddress("localhost", server.port(), true),
+      makeClientContext());
+  roundTrip(server, factory, *worker.getEventBase());
+}
+
+TEST(TcpTls, DestroyedDuringHandshakes) {
+  constexpr size_t kConnections = 4;
+
+  TcpConnectionAcceptor::Options options;
+  options.address = folly::SocketAddress{"::", 0};
+  options.threads = 2;
+  options.sslContext = makeServerContext();
+  auto acceptor = std::make_unique<TcpConnectionAcceptor>(std::move(options));
+  acceptor->start(
+      [](std::unique_ptr<DuplexConnection>, folly::EventBase&) {
+        ADD_FAILURE() << "No handshake completes";
+      });
+
+  std::vector<int> fds;
+  for (size_t i = 0; i < kConnections; ++i) {
+    fds.push_back(connectPlain(*acceptor->listeningPort()));
+  }
+  ASSERT_TRUE(eventually(
+      [&] { return acceptor->pendingHandshakes() == kConnections; }));
+
+  // The pending handshakes are closed along with the workers.
+  acceptor.reset();
+  for (auto const fd : fds) {
+    EXPECT_TRUE(closedByPeer(fd));
+    ::close(fd);
+  }
+}
+
+TEST(TcpTls, ResumesSessions) {
+  TlsServer server;
+  folly::ScopedEventBaseThread worker;
+  auto const sessions = std::make_shared<TlsSessionCache>();
+  TcpConnectionFactory::Options options;
+  options.tlsSessions = sessions;
+  TcpConnectionFactory factory(
+      *worker.getEventBase(),
+      {folly::SocketAddress("localhost", server.port(), true)},
+      makeClientContext(),
+      TcpDuplexConnection::Options(),
+      nullptr,
+      std::move(options));
+
+  roundTrip(server, factory, *worker.getEventBase());
+  EXPECT_EQ(1, sessions->full());
+  EXPECT_EQ(0, sessions->resumed());
+
+  roundTrip(server, factory, *worker.getEventBase());
+  EXPECT_EQ(1, sessions->full());
+  EXPECT_EQ(1, sessions->resumed());
+}
+
+} // namespace tests
+} // namespace rsocket
@@ -0,0 +1,69 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <set>
+
+#include "rsocket/transports/tcp/TcpWorkerPlacement.h"
+
+using namespace rsocket;
+
+namespace {
+
+std::vector<TcpWorkerLoad> loads(
+    std::vector<size_t> connections,
+    std::vector<size_t> bytes) {
+  std::vector<TcpWorkerLoad> result(connections.size());
+  for (size_t i = 0; i < result.size(); ++i) {
+    result[i].connections = connections[i];
+    result[i].bytesInLastInterval = bytes[i];
+  }
+  return result;
+}
+
+} // namespace
+
+TEST(TcpWorkerPlacementTest, LeastConnections) {
+  auto placement = TcpWorkerPlacement::leastConnections();
+  EXPECT_EQ(0, placement->pick(loads({1}, {0})));
+  EXPECT_EQ(2, placement->pick(loads({3, 2, 1, 4}, {0, 0, 100, 0})));
+  EXPECT_EQ(0, placement->pick(loads({1, 1, 1}, {100, 0, 0})));
+}
+
+TEST(TcpWorkerPlacementTest, LeastBytes) {
+  auto placement = TcpWorkerPlacement::leastBytes();
+  EXPECT_EQ(1, placement->pick(loads({1, 5, 1}, {10, 5, 20})));
+  EXPECT_EQ(2, placement->pick(loads({3, 2, 1}, {0, 0, 0})));
+}
+
+TEST(TcpWorkerPlacementTest, PowerOfTwoChoices) {
+  auto placement = TcpWorkerPlacement::powerOfTwoChoices();
+  EXPECT_EQ(0, placement->pick(loads({7}, {0})));
+
+  // The busiest worker loses every comparison.
+  auto const workers = loads({1, 1, 1, 9}, {0, 0, 0, 0});
+  std::set<size_t> picked;
+  for (int i = 0; i < 1000; ++i) {
+    auto const index = placement->pick(workers);
+    ASSERT_LT(index, 3);
+    picked.insert(index);
+  }
+  EXPECT_EQ(3, picked.size());
+
+  // Of two workers the idle one always wins.
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(1, placement->pick(loads({2, 0}, {0, 0})));
+  }
+}
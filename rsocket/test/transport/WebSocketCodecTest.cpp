@@ -0,0 +1,202 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <folly/io/IOBufQueue.h>
+
+#include "rsocket/transports/ws/WebSocketCodec.h"
+#include "rsocket/transports/ws/WebSocketHandshake.h"
+#include "yarpl/test_utils/Mocks.h"
+
+using namespace rsocket;
+
+namespace {
+
+/// Keeps what is sent over it.
+class RecordingConnection : public DuplexConnection {
+ public:
+  void setInput(std::shared_ptr<DuplexConnection::Subscriber>) override {}
+
+  void send(std::unique_ptr<folly::IOBuf> buf) override {
+    sent.push_back(buf->moveToFbString().toStdString());
+  }
+
+  std::vector<std::string> sent;
+};
+
+/// Keeps the messages it gets.
+class CollectingSubscriber : public DuplexConnection::Subscriber {
+ public:
+  void onSubscribe(
+      std::shared_ptr<yarpl::flowable::Subscription> subscription) override {
+    subscription->request(std::numeric_limits<int64_t>::max());
+  }
+
+  void onNext(std::unique_ptr<folly::IOBuf> message) override {
+    messages.push_back(message->moveToFbString().toStdString());
+  }
+
+  void onComplete() override {
+    completed = true;
+  }
+
+  void onError(folly::exception_wrapper ew) override {
+    error = ew.what().toStdString();
+  }
+
+  std::vector<std::string> messages;
+  bool completed{false};
+  std::string error;
+};
+
+class WebSocketCodecTest : public ::testing::Test {
+ protected:
+  /// Sets up a reader for the `role` end of the connection.
+  void makeReader(WebSocketRole role) {
+    output_ = std::make_shared<RecordingConnection>();
+    reader_ = std::make_shared<WebSocketReader>(role, output_);
+    reader_->onSubscribe(
+        std::make_shared<testing::NiceMock<yarpl::mocks::MockSubscription>>());
+    subscriber_ = std::make_shared<CollectingSubscriber>();
+    reader_->setInput(subscriber_);
+  }
+
+  /// Feeds bytes to the reader, one at a time.
+  void feedBytewise(const std::string& bytes) {
+    for (auto const c : bytes) {
+      reader_->onNext(folly::IOBuf::copyBuffer(&c, 1));
+    }
+  }
+
+  void feed(const std::string& bytes) {
+    reader_->onNext(folly::IOBuf::copyBuffer(bytes));
+  }
+
+  static std::string encode(
+      WebSocketOpcode opcode,
+      const std::string& payload,
+      WebSocketRole role) {
+    auto frame =
+        encodeWebSocketFrame(opcode, folly::IOBuf::copyBuffer(payload), role);
+    return frame->moveToFbString().toStdString();
+  }
+
+  std::shared_ptr<RecordingConnection> output_;
+  std::shared_ptr<WebSocketReader> reader_;
+  std::shared_ptr<CollectingSubscriber> subscriber_;
+};
+
+} // namespace
+
+TEST(WebSocketHandshake, AcceptKey) {
+  // The example of RFC 6455, section 1.3.
+  EXPECT_EQ(
+      "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=",
+      webSocketAcceptKey("dGhlIHNhbXBsZSBub25jZQ=="));
+}
+
+TEST_F(WebSocketCodecTest, HeaderLengths) {
+  auto const server = WebSocketRole::SERVER;
+  auto const client = WebSocketRole::CLIENT;
+  auto const binary = WebSocketOpcode::BINARY;
+
+  EXPECT_EQ(2 + 125, encode(binary, std::string(125, 'a'), server).size());
+  EXPECT_EQ(4 + 126, encode(binary, std::string(126, 'a'), server).size());
+  EXPECT_EQ(
+      4 + 0xFFFF, encode(binary, std::string(0xFFFF, 'a'), server).size());
+  EXPECT_EQ(
+      10 + 0x10000, encode(binary, std::string(0x10000, 'a'), server).size());
+  EXPECT_EQ(6 + 10, encode(binary, std::string(10, 'a'), client).size());
+
+  auto const frame = encode(binary, "hello", server);
+  EXPECT_EQ('\x82', frame[0]);
+  EXPECT_EQ('\x05', frame[1]);
+  EXPECT_EQ("hello", frame.substr(2));
+}
+
+TEST_F(WebSocketCodecTest, ClientToServer) {
+  makeReader(WebSocketRole::SERVER);
+
+  std::vector<std::string> const messages{
+      "x", std::string(300, 'y'), std::string(70000, 'z')};
+  std::string bytes;
+  for (auto const& message : messages) {
+    bytes += encode(WebSocketOpcode::BINARY, message, WebSocketRole::CLIENT);
+  }
+  feedBytewise(bytes.substr(0, 1000));
+  feed(bytes.substr(1000));
+
+  EXPECT_EQ(messages, subscriber_->messages);
+  EXPECT_TRUE(subscriber_->error.empty());
+  EXPECT_EQ(0, reader_->bufferedBytes());
+}
+
+TEST_F(WebSocketCodecTest, SharedPayloadIsNotMasked) {
+  auto const payload = folly::IOBuf::copyBuffer("unchanged");
+  auto frame = encodeWebSocketFrame(
+      WebSocketOpcode::BINARY, payload->clone(), WebSocketRole::CLIENT);
+  EXPECT_EQ("unchanged", payload->moveToFbString().toStdString());
+
+  makeReader(WebSocketRole::SERVER);
+  reader_->onNext(std::move(frame));
+  EXPECT_EQ(std::vector<std::string>{"unchanged"}, subscriber_->messages);
+}
+
+TEST_F(WebSocketCodecTest, FragmentedMessage) {
+  makeReader(WebSocketRole::CLIENT);
+  feed(std::string("\x02\x03" "abc", 5));
+  EXPECT_TRUE(subscriber_->messages.empty());
+  feed(std::string("\x00\x01" "d", 3));
+  feed(std::string("\x80\x02" "ef", 4));
+  EXPECT_EQ(std::vector<std::string>{"abcdef"}, subscriber_->messages);
+}
+
+TEST_F(WebSocketCodecTest, AnswersPing) {
+  makeReader(WebSocketRole::SERVER);
+  feed(encode(WebSocketOpcode::PING, "hi", WebSocketRole::CLIENT));
+  ASSERT_EQ(1, output_->sent.size());
+  EXPECT_EQ(
+      encode(WebSocketOpcode::PONG, "hi", WebSocketRole::SERVER),
+      output_->sent[0]);
+  EXPECT_TRUE(subscriber_->messages.empty());
+}
+
+TEST_F(WebSocketCodecTest, CloseCompletesInput) {
+  makeReader(WebSocketRole::CLIENT);
+  feed(std::string("\x88\x02\x03\xE8", 4));
+  EXPECT_TRUE(subscriber_->completed);
+  EXPECT_TRUE(reader_->closeSent());
+  ASSERT_EQ(1, output_->sent.size());
+  EXPECT_EQ(0x88, static_cast<uint8_t>(output_->sent[0][0]));
+}
+
+TEST_F(WebSocketCodecTest, RejectsTextMessages) {
+  makeReader(WebSocketRole::CLIENT);
+  feed(encode(WebSocketOpcode::TEXT, "text", WebSocketRole::SERVER));
+  EXPECT_FALSE(subscriber_->error.empty());
+  EXPECT_TRUE(subscriber_->messages.empty());
+  EXPECT_TRUE(reader_->closeSent());
+}
+
+TEST_F(WebSocketCodecTest, RejectsUnmaskedClientFrames) {
+  makeReader(WebSocketRole::SERVER);
+  feed(encode(WebSocketOpcode::BINARY, "frame", WebSocketRole::SERVER));
+  EXPECT_FALSE(subscriber_->error.empty());
+  EXPECT_TRUE(subscriber_->messages.empty());
+}
@@ -0,0 +1,164 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <folly/futures/Future.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <gtest/gtest.h>
+
+#include "rsocket/test/transport/DuplexConnectionTest.h"
+#include "rsocket/transports/ws/WebSocketConnectionAcceptor.h"
+#include "rsocket/transports/ws/WebSocketConnectionFactory.h"
+#include "yarpl/test_utils/Mocks.h"
+
+namespace rsocket {
+namespace tests {
+
+using namespace folly;
+using namespace rsocket;
+using namespace ::testing;
+
+namespace {
+
+/**
+ * Synchronously create a server and a client.
+ */
+std::pair<
+    std::unique_ptr<ConnectionAcceptor>,
+    std::unique_ptr<ConnectionFactory>>
+makeWebSocketClientServer(
+    std::unique_ptr<DuplexConnection>& serverConnection,
+    EventBase** serverEvb,
+    std::unique_ptr<DuplexConnection>& clientConnection,
+    EventBase* clientEvb) {
+  Promise<Unit> serverPromise;
+
+  WebSocketConnectionAcceptor::Options options;
+  options.tcp.address = folly::SocketAddress{"::", 0};
+  options.tcp.threads = 1;
+  options.tcp.backlog = 0;
+  options.path = "/rsocket";
+
+  auto server =
+      std::make_unique<WebSocketConnectionAcceptor>(std::move(options));
+  server->start(
+      [&serverPromise, &serverConnection, &serverEvb](
+          std::unique_ptr<DuplexConnection> connection, EventBase& eventBase) {
+        serverConnection = std::move(connection);
+        *serverEvb = &eventBase;
+        serverPromise.setValue();
+      });
+
+  int16_t port = server->listeningPort().value();
+
+  WebSocketConnectionFactory::Options clientOptions;
+  clientOptions.path = "/rsocket";
+  auto client = std::make_unique<WebSocketConnectionFactory>(
+      *clientEvb,
+      SocketAddress("localhost", port, true),
+      std::move(clientOptions));
+  client->connect(ProtocolVersion::Latest, ResumeStatus::NEW_SESSION)
+      .thenValue([&clientConnection](
+                     ConnectionFactory::ConnectedDuplexConnection connection) {
+        clientConnection = std::move(connection.connection);
+      })
+      .wait();
+
+  serverPromise.getSemiFuture().wait();
+  return std::make_pair(std::move(server), std::move(client));
+}
+
+} // namespace
+
+TEST(WebSocketDuplexConnection, IsFramed) {
+  folly::ScopedEventBaseThread worker;
+  std::unique_ptr<DuplexConnection> serverConnection, clientConnection;
+  EventBase* serverEvb = nullptr;
+  auto keepAlive = makeWebSocketClientServer(
+      serverConnection, &serverEvb, clientConnection, worker.getEventBase());
+  ASSERT_TRUE(clientConnection);
+  ASSERT_TRUE(serverConnection);
+  EXPECT_TRUE(clientConnection->isFramed());
+  EXPECT_TRUE(serverConnection->isFramed());
+
+  worker.getEventBase()->runInEventBaseThreadAndWait(
+      [connection = std::move(clientConnection)] {});
+  serverEvb->runInEventBaseThreadAndWait(
+      [connection = std::move(serverConnection)] {});
+}
+
+TEST(WebSocketDuplexConnection, MultipleSetInputGetOutputCalls) {
+  folly::ScopedEventBaseThread worker;
+  std::unique_ptr<DuplexConnection> serverConnection, clientConnection;
+  EventBase* serverEvb = nullptr;
+  auto keepAlive = makeWebSocketClientServer(
+      serverConnection, &serverEvb, clientConnection, worker.getEventBase());
+  makeMultipleSetInputGetOutputCalls(
+      std::move(serverConnection),
+      serverEvb,
+      std::move(clientConnection),
+      worker.getEventBase());
+}
+
+TEST(WebSocketDuplexConnection, InputAndOutputIsUntied) {
+  folly::ScopedEventBaseThread worker;
+  std::unique_ptr<DuplexConnection> serverConnection, clientConnection;
+  EventBase* serverEvb = nullptr;
+  auto keepAlive = makeWebSocketClientServer(
+      serverConnection, &serverEvb, clientConnection, worker.getEventBase());
+  verifyInputAndOutputIsUntied(
+      std::move(serverConnection),
+      serverEvb,
+      std::move(clientConnection),
+      worker.getEventBase());
+}
+
+TEST(WebSocketDuplexConnection, ConnectionAndSubscribersAreUntied) {
+  folly::ScopedEventBaseThread worker;
+  std::unique_ptr<DuplexConnection> serverConnection, clientConnection;
+  EventBase* serverEvb = nullptr;
+  auto keepAlive = makeWebSocketClientServer(
+      serverConnection, &serverEvb, clientConnection, worker.getEventBase());
+  verifyClosingInputAndOutputDoesntCloseConnection(
+      std::move(serverConnection),
+      serverEvb,
+      std::move(clientConnection),
+      worker.getEventBase());
+}
+
+TEST(WebSocketDuplexConnection, RefusesOtherPaths) {
+  folly::ScopedEventBaseThread worker;
+
+  WebSocketConnectionAcceptor::Options options;
+  options.tcp.address = folly::SocketAddress{"::", 0};
+  options.tcp.threads = 1;
+  options.path = "/rsocket";
+  WebSocketConnectionAcceptor server(std::move(options));
+  server.start([](std::unique_ptr<DuplexConnection>, EventBase&) {
+    FAIL() << "Upgrade to the wrong path was accepted";
+  });
+
+  WebSocketConnectionFactory::Options clientOptions;
+  clientOptions.path = "/elsewhere";
+  WebSocketConnectionFactory client(
+      *worker.getEventBase(),
+      SocketAddress("localhost", server.listeningPort().value(), true),
+      std::move(clientOptions));
+  auto connected =
+      client.connect(ProtocolVersion::Latest, ResumeStatus::NEW_SESSION);
+  connected.wait();
+  EXPECT_TRUE(connected.result().hasException());
+}
+
+} // namespace tests
+} // namespace rsocket
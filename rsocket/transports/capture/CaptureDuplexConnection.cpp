@@ -0,0 +1,252 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/capture/CaptureDuplexConnection.h"
+
+#include <folly/File.h>
+#include <folly/FileUtil.h>
+#include <folly/Synchronized.h>
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/EventBaseManager.h>
+
+#include <fcntl.h>
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+
+#include "rsocket/FrameCapture.h"
+#include "rsocket/transports/capture/CaptureFile.h"
+
+namespace rsocket {
+
+namespace {
+
+/// Appends batches to the file on the writer executor, one at a time and in
+/// order.  Owned jointly by the recorder and the batches in flight.
+class FileWriter : public std::enable_shared_from_this<FileWriter> {
+ public:
+  FileWriter(folly::File file, folly::Executor::KeepAlive<> executor)
+      : file_{std::move(file)}, executor_{std::move(executor)} {}
+
+  void enqueue(std::unique_ptr<folly::IOBuf> batch) {
+    {
+      auto queue = queue_.lock();
+      queue->batches.push_back(std::move(batch));
+      if (queue->draining) {
+        return;
+      }
+      queue->draining = true;
+    }
+    executor_->add([self = shared_from_this()] { self->drain(); });
+  }
+
+ private:
+  struct Queue {
+    std::deque<std::unique_ptr<folly::IOBuf>> batches;
+    bool draining{false};
+  };
+
+  void drain() {
+    while (true) {
+      std::unique_ptr<folly::IOBuf> batch;
+      {
+        auto queue = queue_.lock();
+        if (queue->batches.empty()) {
+          queue->draining = false;
+          return;
+        }
+        batch = std::move(queue->batches.front());
+        queue->batches.pop_front();
+      }
+      if (failed_) {
+        continue;
+      }
+      for (const auto range : *batch) {
+        if (folly::writeFull(file_.fd(), range.data(), range.size()) < 0) {
+          PLOG(ERROR) << "Failed writing frame capture, dropping the rest";
+          failed_ = true;
+          break;
+        }
+      }
+    }
+  }
+
+  const folly::File file_;
+  const folly::Executor::KeepAlive<> executor_;
+  folly::Synchronized<Queue, std::mutex> queue_;
+
+  /// Only accessed by drain(), which never runs concurrently with itself.
+  bool failed_{false};
+};
+
+} // namespace
+
+/// Encodes the frames into batches on the thread of the connection.
+class CaptureDuplexConnection::Recorder
+    : public folly::EventBase::LoopCallback {
+ public:
+  explicit Recorder(Options options)
+      : flushBytes_{options.flushBytes},
+        maxBytes_{options.maxBytes},
+        writer_{std::make_shared<FileWriter>(
+            folly::File{
+                options.path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644},
+            std::move(options.writer))} {
+    CaptureFile::appendHeader(pending_, std::chrono::system_clock::now());
+    bytes_ = pending_.chainLength();
+  }
+
+  ~Recorder() override {
+    flush();
+  }
+
+  void record(FrameCapture::Direction direction, const folly::IOBuf& frame) {
+    if (full_) {
+      return;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    const auto before = pending_.chainLength();
+    CaptureFile::appendFrame(pending_, now - last_, direction, frame);
+    const auto encoded = pending_.chainLength() - before;
+    if (bytes_ + encoded > maxBytes_) {
+      // Drop the frame, the capture ends right before it.
+      pending_.trimEnd(encoded);
+      full_ = true;
+      LOG(WARNING) << "Frame capture reached " << bytes_
+                   << " bytes, no longer recording frames";
+      return;
+    }
+    bytes_ += encoded;
+    last_ = now;
+    scheduleFlush();
+  }
+
+  void flush() {
+    cancelLoopCallback();
+    if (!pending_.empty()) {
+      writer_->enqueue(pending_.move());
+    }
+  }
+
+  void runLoopCallback() noexcept override {
+    flush();
+  }
+
+ private:
+  void scheduleFlush() {
+    if (pending_.chainLength() >= flushBytes_) {
+      flush();
+      return;
+    }
+    if (isLoopCallbackScheduled()) {
+      return;
+    }
+    if (auto evb = folly::EventBaseManager::get()->getExistingEventBase()) {
+      evb->runInLoop(this);
+    } else {
+      flush();
+    }
+  }
+
+  const size_t flushBytes_;
+  const size_t maxBytes_;
+  const std::shared_ptr<FileWriter> writer_;
+
+  folly::IOBufQueue pending_{folly::IOBufQueue::cacheChainLength()};
+  std::chrono::steady_clock::time_point last_{
+      std::chrono::steady_clock::now()};
+  size_t bytes_{0};
+  bool full_{false};
+};
+
+/// Records the frames read by the connection on their way to its input.
+class CaptureDuplexConnection::Input : public DuplexConnection::Subscriber {
+ public:
+  Input(
+      std::shared_ptr<Recorder> recorder,
+      std::shared_ptr<DuplexConnection::Subscriber> inner)
+      : recorder_{std::move(recorder)}, inner_{std::move(inner)} {}
+
+  void onSubscribe(
+      std::shared_ptr<yarpl::flowable::Subscription> subscription) override {
+    inner_->onSubscribe(std::move(subscription));
+  }
+
+  void onNext(std::unique_ptr<folly::IOBuf> frame) override {
+    recorder_->record(FrameCapture::Direction::IN, *frame);
+    inner_->onNext(std::move(frame));
+  }
+
+  void onNextBatch(folly::Range<std::unique_ptr<folly::IOBuf>*> frames)
+      override {
+    for (const auto& frame : frames) {
+      recorder_->record(FrameCapture::Direction::IN, *frame);
+    }
+    inner_->onNextBatch(frames);
+  }
+
+  void onComplete() override {
+    recorder_->flush();
+    inner_->onComplete();
+  }
+
+  void onError(folly::exception_wrapper ew) override {
+    recorder_->flush();
+    inner_->onError(std::move(ew));
+  }
+
+ private:
+  const std::shared_ptr<Recorder> recorder_;
+  const std::shared_ptr<DuplexConnection::Subscriber> inner_;
+};
+
+CaptureDuplexConnection::CaptureDuplexConnection(
+    std::unique_ptr<DuplexConnection> connection,
+    Options options)
+    : connection_{std::move(connection)},
+      recorder_{std::make_shared<Recorder>(std::move(options))} {
+  DCHECK(connection_);
+}
+
+CaptureDuplexConnection::~CaptureDuplexConnection() {
+  recorder_->flush();
+}
+
+void CaptureDuplexConnection::setInput(
+    std::shared_ptr<DuplexConnection::Subscriber> input) {
+  connection_->setInput(
+      input ? std::make_shared<Input>(recorder_, std::move(input)) : nullptr);
+}
+
+void CaptureDuplexConnection::send(std::unique_ptr<folly::IOBuf> frame) {
+  recorder_->record(FrameCapture::Direction::OUT, *frame);
+  connection_->send(std::move(frame));
+}
+
+void CaptureDuplexConnection::sendBatch(
+    std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+  for (const auto& frame : frames) {
+    recorder_->record(FrameCapture::Direction::OUT, *frame);
+  }
+  connection_->sendBatch(std::move(frames));
+}
+
+void CaptureDuplexConnection::detachEventBase() {
+  // The flush may not be scheduled on the EventBase that is going away.
+  recorder_->flush();
+  connection_->detachEventBase();
+}
+
+} // namespace rsocket
@@ -0,0 +1,113 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Executor.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rsocket/DuplexConnection.h"
+
+namespace rsocket {
+
+/// Decorates a connection to record every frame it reads and sends, with
+/// its time, into a capture file, which can be replayed later, e.g. by the
+/// CaptureReplay benchmark.  See CaptureFile for the format.
+///
+/// Frames are encoded on the thread of the connection into a batch, which is
+/// handed to the writer executor at the end of the EventBase loop iteration
+/// (or once it reaches `flushBytes`), so the file is never written to from
+/// the I/O thread.
+class CaptureDuplexConnection : public DuplexConnection {
+ public:
+  struct Options {
+    /// File the capture is written to.  Truncated if it exists.
+    std::string path;
+
+    /// Writes the batches to the file, one at a time and in order.
+    folly::Executor::KeepAlive<> writer;
+
+    size_t flushBytes{64 * 1024};
+
+    /// Frames stop being recorded once the file would grow past this.
+    size_t maxBytes{size_t{1} << 30};
+  };
+
+  /// Throws if the file cannot be created.
+  CaptureDuplexConnection(
+      std::unique_ptr<DuplexConnection> connection,
+      Options options);
+
+  /// Hands the frames recorded so far over to the writer.  They are still
+  /// written after the connection is gone.
+  ~CaptureDuplexConnection() override;
+
+  void setInput(std::shared_ptr<DuplexConnection::Subscriber>) override;
+
+  void send(std::unique_ptr<folly::IOBuf>) override;
+
+  void sendBatch(std::vector<std::unique_ptr<folly::IOBuf>> frames) override;
+
+  size_t bufferedInputBytes() const override {
+    return connection_->bufferedInputBytes();
+  }
+
+  size_t bufferedOutputBytes() const override {
+    return connection_->bufferedOutputBytes();
+  }
+
+  void setOutputWrittenCallback(std::function<void()> callback) override {
+    connection_->setOutputWrittenCallback(std::move(callback));
+  }
+
+  TransportInfo transportInfo() const override {
+    return connection_->transportInfo();
+  }
+
+  bool supportsFrameChecksums() const override {
+    return connection_->supportsFrameChecksums();
+  }
+
+  void enableFrameChecksums() override {
+    connection_->enableFrameChecksums();
+  }
+
+  bool isDetachable() const override {
+    return connection_->isDetachable();
+  }
+
+  void detachEventBase() override;
+
+  void attachEventBase(folly::EventBase& eventBase) override {
+    connection_->attachEventBase(eventBase);
+  }
+
+  bool isFramed() const override {
+    return connection_->isFramed();
+  }
+
+ private:
+  class Input;
+  class Recorder;
+
+  const std::unique_ptr<DuplexConnection> connection_;
+
+  /// Shared with the input subscriber, which may outlive the connection.
+  const std::shared_ptr<Recorder> recorder_;
+};
+
+} // namespace rsocket
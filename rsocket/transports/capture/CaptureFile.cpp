@@ -0,0 +1,132 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/capture/CaptureFile.h"
+
+#include <folly/FileUtil.h>
+#include <folly/Varint.h>
+#include <folly/io/Cursor.h>
+#include <folly/lang/Bits.h>
+
+#include <stdexcept>
+
+namespace rsocket {
+
+namespace {
+
+constexpr folly::StringPiece kMagic{"RSOCKCAP"};
+
+void appendVarint(folly::io::QueueAppender& appender, uint64_t value) {
+  uint8_t buf[folly::kMaxVarintLength64];
+  appender.push(buf, folly::encodeVarint(value, buf));
+}
+
+/// Returns false if the data ends in the middle of the varint.
+bool readVarint(folly::ByteRange& data, uint64_t& value) {
+  auto decoded = folly::tryDecodeVarint(data);
+  if (decoded.hasError()) {
+    if (decoded.error() == folly::DecodeVarintError::TooFewBytes) {
+      return false;
+    }
+    throw std::runtime_error("Malformed varint in capture file");
+  }
+  value = decoded.value();
+  return true;
+}
+
+} // namespace
+
+void CaptureFile::appendHeader(
+    folly::IOBufQueue& queue,
+    std::chrono::system_clock::time_point start) {
+  folly::io::QueueAppender appender{&queue, kMagic.size() + 9};
+  appender.push(folly::ByteRange{kMagic});
+  appender.write<uint8_t>(kVersion);
+  appender.writeBE<int64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          start.time_since_epoch())
+          .count());
+}
+
+void CaptureFile::appendFrame(
+    folly::IOBufQueue& queue,
+    std::chrono::nanoseconds sincePrevious,
+    FrameCapture::Direction direction,
+    const folly::IOBuf& frame) {
+  const auto length = frame.computeChainDataLength();
+  folly::io::QueueAppender appender{
+      &queue, 2 * folly::kMaxVarintLength64 + 1 + length};
+  appendVarint(appender, static_cast<uint64_t>(sincePrevious.count()));
+  appender.write<uint8_t>(static_cast<uint8_t>(direction));
+  appendVarint(appender, length);
+  for (const auto range : frame) {
+    appender.push(range);
+  }
+}
+
+CapturedSession CaptureFile::parse(folly::ByteRange data) {
+  if (!data.startsWith(folly::ByteRange{kMagic}) ||
+      data.size() < kMagic.size() + 9) {
+    throw std::runtime_error("Not a capture file");
+  }
+  data.advance(kMagic.size());
+  if (data[0] != kVersion) {
+    throw std::runtime_error("Unsupported capture file version");
+  }
+  data.advance(1);
+
+  CapturedSession session;
+  const auto startNanos =
+      folly::Endian::big(folly::loadUnaligned<int64_t>(data.data()));
+  session.start = std::chrono::system_clock::time_point{
+      std::chrono::duration_cast<std::chrono::system_clock::duration>(
+          std::chrono::nanoseconds{startNanos})};
+  data.advance(sizeof(int64_t));
+
+  std::chrono::nanoseconds offset{0};
+  while (!data.empty()) {
+    uint64_t sincePrevious = 0;
+    if (!readVarint(data, sincePrevious) || data.empty()) {
+      break;
+    }
+    const auto direction = data[0];
+    data.advance(1);
+    if (direction > static_cast<uint8_t>(FrameCapture::Direction::OUT)) {
+      throw std::runtime_error("Malformed frame direction in capture file");
+    }
+    uint64_t length = 0;
+    if (!readVarint(data, length) || length > data.size()) {
+      break;
+    }
+
+    offset += std::chrono::nanoseconds{sincePrevious};
+    CapturedFrame frame;
+    frame.offset = offset;
+    frame.direction = static_cast<FrameCapture::Direction>(direction);
+    frame.frame = folly::IOBuf::copyBuffer(data.data(), length);
+    session.frames.push_back(std::move(frame));
+    data.advance(length);
+  }
+  return session;
+}
+
+CapturedSession CaptureFile::read(const std::string& path) {
+  std::string contents;
+  if (!folly::readFile(path.c_str(), contents)) {
+    throw std::runtime_error("Cannot read capture file " + path);
+  }
+  return parse(folly::ByteRange{folly::StringPiece{contents}});
+}
+
+} // namespace rsocket
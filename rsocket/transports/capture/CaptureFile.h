@@ -0,0 +1,76 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/io/IOBuf.h>
+#include <folly/io/IOBufQueue.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rsocket/FrameCapture.h"
+
+namespace rsocket {
+
+/// A frame of a capture file, see CaptureFile.
+struct CapturedFrame {
+  /// Time from the start of the capture to when the frame was read or handed
+  /// to the connection.
+  std::chrono::nanoseconds offset{0};
+  FrameCapture::Direction direction{FrameCapture::Direction::IN};
+
+  /// The serialized frame, without its frame length field.
+  std::unique_ptr<folly::IOBuf> frame;
+};
+
+/// The frames of one connection, in the order they were captured.
+struct CapturedSession {
+  std::chrono::system_clock::time_point start;
+  std::vector<CapturedFrame> frames;
+};
+
+/// Format of the files written by CaptureDuplexConnection.
+///
+/// A file starts with an 8 byte magic, a version byte and the wall time the
+/// capture started at, in nanoseconds since the epoch.  Each frame follows as
+/// the varint nanoseconds since the previous frame (or the start), a
+/// direction byte, the varint length of the frame and the frame itself.
+class CaptureFile {
+ public:
+  static constexpr uint8_t kVersion = 1;
+
+  static void appendHeader(
+      folly::IOBufQueue& queue,
+      std::chrono::system_clock::time_point start);
+
+  static void appendFrame(
+      folly::IOBufQueue& queue,
+      std::chrono::nanoseconds sincePrevious,
+      FrameCapture::Direction direction,
+      const folly::IOBuf& frame);
+
+  /// Parses a capture.  A frame cut short at the end, as when the process
+  /// writing the capture died, is dropped.  Throws std::runtime_error if the
+  /// capture is malformed.
+  static CapturedSession parse(folly::ByteRange data);
+
+  /// Reads and parses a capture file.  Throws std::runtime_error if the file
+  /// cannot be read or is malformed.
+  static CapturedSession read(const std::string& path);
+};
+
+} // namespace rsocket
@@ -0,0 +1,79 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/inprocess/InProcessConnectionAcceptor.h"
+
+#include <folly/io/async/EventBase.h>
+#include <glog/logging.h>
+
+#include <stdexcept>
+
+#include "rsocket/transports/inprocess/InProcessDuplexConnection.h"
+#include "rsocket/transports/inprocess/InProcessEndpoint.h"
+
+namespace rsocket {
+
+void InProcessEndpoint::start(OnDuplexConnectionAccept onAccept) {
+  auto locked = onAccept_.wlock();
+  if (*locked) {
+    throw std::runtime_error(
+        "InProcessConnectionAcceptor::start() already called");
+  }
+  *locked = std::make_shared<OnDuplexConnectionAccept>(std::move(onAccept));
+}
+
+void InProcessEndpoint::stop() {
+  onAccept_.wlock()->reset();
+}
+
+std::unique_ptr<DuplexConnection> InProcessEndpoint::connect(
+    folly::EventBase& clientEventBase) {
+  auto onAccept = *onAccept_.rlock();
+  if (!onAccept) {
+    throw std::runtime_error("InProcessConnectionAcceptor is not accepting");
+  }
+
+  auto connections =
+      InProcessDuplexConnection::makePair(clientEventBase, eventBase_);
+  eventBase_.runInEventBaseThread(
+      [evb = &eventBase_,
+       onAccept = std::move(onAccept),
+       server = std::move(connections.second)]() mutable {
+        VLOG(2) << "Accepting in-process connection";
+        (*onAccept)(std::move(server), *evb);
+      });
+  return std::move(connections.first);
+}
+
+InProcessConnectionAcceptor::InProcessConnectionAcceptor(
+    folly::EventBase& eventBase)
+    : endpoint_(std::make_shared<InProcessEndpoint>(eventBase)) {}
+
+InProcessConnectionAcceptor::~InProcessConnectionAcceptor() {
+  stop();
+}
+
+void InProcessConnectionAcceptor::start(OnDuplexConnectionAccept onAccept) {
+  endpoint_->start(std::move(onAccept));
+}
+
+void InProcessConnectionAcceptor::stop() {
+  endpoint_->stop();
+}
+
+folly::Optional<uint16_t> InProcessConnectionAcceptor::listeningPort() const {
+  return folly::none;
+}
+
+} // namespace rsocket
@@ -0,0 +1,65 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+
+#include "rsocket/ConnectionAcceptor.h"
+
+namespace rsocket {
+
+class InProcessEndpoint;
+
+/**
+ * In-process implementation of ConnectionAcceptor for use with
+ * RSocket::createServer
+ *
+ * Accepts the connections made by the InProcessConnectionFactory instances
+ * created for it, and serves all of them on one EventBase.  See
+ * InProcessDuplexConnection.
+ *
+ * Construction of this does nothing.  The `start` method kicks off work.
+ */
+class InProcessConnectionAcceptor : public ConnectionAcceptor {
+ public:
+  /// Accepted connections are handed out and used on `eventBase`.
+  explicit InProcessConnectionAcceptor(folly::EventBase& eventBase);
+  ~InProcessConnectionAcceptor();
+
+  // ConnectionAcceptor overrides.
+
+  /**
+   * Start accepting connections from the factories of this acceptor.
+   */
+  void start(OnDuplexConnectionAccept) override;
+
+  /**
+   * Stop accepting connections.  Later connects fail.
+   */
+  void stop() override;
+
+  /**
+   * In-process connections don't have a port.  Always none.
+   */
+  folly::Optional<uint16_t> listeningPort() const override;
+
+ private:
+  friend class InProcessConnectionFactory;
+
+  /// What the factories connect to.  Outlives the acceptor if needed.
+  const std::shared_ptr<InProcessEndpoint> endpoint_;
+};
+
+} // namespace rsocket
@@ -0,0 +1,58 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+
+#include "rsocket/ConnectionFactory.h"
+
+namespace rsocket {
+
+class InProcessConnectionAcceptor;
+class InProcessEndpoint;
+
+/**
+ * In-process implementation of ConnectionFactory for use with
+ * RSocket::createClient().
+ *
+ * Connects to an InProcessConnectionAcceptor in the same process.  See
+ * InProcessDuplexConnection.  The factory may outlive the acceptor, connects
+ * fail once the acceptor is stopped.
+ *
+ * Creation of this does nothing.  The `connect` method kicks off work.
+ */
+class InProcessConnectionFactory : public ConnectionFactory {
+ public:
+  /// Client connections are used on `eventBase`.
+  InProcessConnectionFactory(
+      folly::EventBase& eventBase,
+      const InProcessConnectionAcceptor& acceptor);
+  ~InProcessConnectionFactory() override;
+
+  /**
+   * Connect to the acceptor defined in constructor.
+   *
+   * Each call to connect() creates a new pair of InProcessDuplexConnections.
+   */
+  folly::Future<ConnectedDuplexConnection> connect(
+      ProtocolVersion,
+      ResumeStatus resume) override;
+
+ private:
+  folly::EventBase* eventBase_;
+  const std::shared_ptr<InProcessEndpoint> endpoint_;
+};
+
+} // namespace rsocket
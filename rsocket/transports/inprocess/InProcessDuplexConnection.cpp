@@ -0,0 +1,247 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/inprocess/InProcessDuplexConnection.h"
+
+#include <deque>
+#include <iterator>
+#include <limits>
+#include <mutex>
+
+#include <folly/io/async/EventBase.h>
+#include <glog/logging.h>
+
+#include "yarpl/flowable/Subscription.h"
+
+namespace rsocket {
+
+using namespace yarpl::flowable;
+
+/// The frames travelling from one end of a connection to the other.
+///
+/// The writing end may be on any thread.  Everything about the reading end is
+/// only touched on the thread of its EventBase.
+class InProcessPipe : public std::enable_shared_from_this<InProcessPipe> {
+ public:
+  explicit InProcessPipe(folly::EventBase& eventBase)
+      : eventBase_(eventBase) {}
+
+  ~InProcessPipe() {
+    DCHECK(!input_);
+  }
+
+  // Writing end.
+
+  void write(std::unique_ptr<folly::IOBuf> frame) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (readerClosed_ || writerClosed_) {
+        return;
+      }
+      frames_.push_back(std::move(frame));
+      if (std::exchange(drainScheduled_, true)) {
+        return;
+      }
+    }
+    scheduleDrain();
+  }
+
+  void write(std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (readerClosed_ || writerClosed_) {
+        return;
+      }
+      if (frames_.empty()) {
+        frames_ = std::move(frames);
+      } else {
+        frames_.insert(
+            frames_.end(),
+            std::make_move_iterator(frames.begin()),
+            std::make_move_iterator(frames.end()));
+      }
+      if (std::exchange(drainScheduled_, true)) {
+        return;
+      }
+    }
+    scheduleDrain();
+  }
+
+  /// The reading end is completed once it has received all frames written
+  /// so far.
+  void closeWriter() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (std::exchange(writerClosed_, true) ||
+          std::exchange(drainScheduled_, true)) {
+        return;
+      }
+    }
+    scheduleDrain();
+  }
+
+  // Reading end.
+
+  void setInput(std::shared_ptr<DuplexConnection::Subscriber> input) {
+    DCHECK(eventBase_.isInEventBaseThread());
+    if (input && readerClosed_) {
+      input->onComplete();
+      return;
+    }
+    input_ = std::move(input);
+    deliver();
+  }
+
+  /// Drops the frames that haven't been received yet, and any that are
+  /// written from now on.
+  void closeReader() {
+    DCHECK(eventBase_.isInEventBaseThread());
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      readerClosed_ = true;
+      frames_.clear();
+    }
+    unread_.clear();
+    if (auto input = std::move(input_)) {
+      input->onComplete();
+    }
+  }
+
+ private:
+  void scheduleDrain() {
+    eventBase_.runInEventBaseThread(
+        [self = shared_from_this()] { self->drain(); });
+  }
+
+  void drain() {
+    std::vector<std::unique_ptr<folly::IOBuf>> frames;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      drainScheduled_ = false;
+      frames.swap(frames_);
+      writerDone_ = writerClosed_;
+    }
+
+    size_t i = 0;
+    if (unread_.empty()) {
+      // The common case, the frames go straight to the subscriber.
+      for (; i < frames.size() && input_; ++i) {
+        input_->onNext(std::move(frames[i]));
+      }
+    }
+    unread_.insert(
+        unread_.end(),
+        std::make_move_iterator(frames.begin() + i),
+        std::make_move_iterator(frames.end()));
+    deliver();
+  }
+
+  /// Hands the frames received so far to the subscriber, if there is one.
+  void deliver() {
+    while (input_ && !unread_.empty()) {
+      auto frame = std::move(unread_.front());
+      unread_.pop_front();
+      input_->onNext(std::move(frame));
+    }
+    if (input_ && writerDone_) {
+      auto input = std::move(input_);
+      input->onComplete();
+    }
+  }
+
+  folly::EventBase& eventBase_;
+
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<folly::IOBuf>> frames_;
+  bool drainScheduled_{false};
+  bool writerClosed_{false};
+  bool readerClosed_{false};
+
+  /// Frames received while there was no subscriber.
+  std::deque<std::unique_ptr<folly::IOBuf>> unread_;
+
+  /// Whether the writing end was closed as of the last drain.
+  bool writerDone_{false};
+
+  std::shared_ptr<DuplexConnection::Subscriber> input_;
+};
+
+namespace {
+
+class InProcessInputSubscription : public Subscription {
+ public:
+  explicit InProcessInputSubscription(std::shared_ptr<InProcessPipe> pipe)
+      : pipe_(std::move(pipe)) {
+    CHECK(pipe_);
+  }
+
+  void request(int64_t n) noexcept override {
+    DCHECK(pipe_);
+    DCHECK_EQ(n, std::numeric_limits<int64_t>::max())
+        << "InProcessDuplexConnection doesnt support proper flow control";
+  }
+
+  void cancel() noexcept override {
+    pipe_->setInput(nullptr);
+    pipe_ = nullptr;
+  }
+
+ private:
+  std::shared_ptr<InProcessPipe> pipe_;
+};
+
+} // namespace
+
+std::pair<
+    std::unique_ptr<InProcessDuplexConnection>,
+    std::unique_ptr<InProcessDuplexConnection>>
+InProcessDuplexConnection::makePair(
+    folly::EventBase& firstEventBase,
+    folly::EventBase& secondEventBase) {
+  auto toFirst = std::make_shared<InProcessPipe>(firstEventBase);
+  auto toSecond = std::make_shared<InProcessPipe>(secondEventBase);
+  std::unique_ptr<InProcessDuplexConnection> first(
+      new InProcessDuplexConnection(toFirst, toSecond));
+  std::unique_ptr<InProcessDuplexConnection> second(
+      new InProcessDuplexConnection(std::move(toSecond), std::move(toFirst)));
+  return std::make_pair(std::move(first), std::move(second));
+}
+
+InProcessDuplexConnection::InProcessDuplexConnection(
+    std::shared_ptr<InProcessPipe> input,
+    std::shared_ptr<InProcessPipe> output)
+    : input_(std::move(input)), output_(std::move(output)) {}
+
+InProcessDuplexConnection::~InProcessDuplexConnection() {
+  output_->closeWriter();
+  input_->closeReader();
+}
+
+void InProcessDuplexConnection::send(std::unique_ptr<folly::IOBuf> frame) {
+  output_->write(std::move(frame));
+}
+
+void InProcessDuplexConnection::sendBatch(
+    std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+  output_->write(std::move(frames));
+}
+
+void InProcessDuplexConnection::setInput(
+    std::shared_ptr<DuplexConnection::Subscriber> inputSubscriber) {
+  inputSubscriber->onSubscribe(
+      std::make_shared<InProcessInputSubscription>(input_));
+  input_->setInput(std::move(inputSubscriber));
+}
+
+} // namespace rsocket
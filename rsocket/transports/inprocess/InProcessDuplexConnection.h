@@ -0,0 +1,75 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+#include <utility>
+
+#include "rsocket/DuplexConnection.h"
+
+namespace folly {
+class EventBase;
+}
+
+namespace rsocket {
+
+class InProcessPipe;
+
+/// One end of a connection between two RSocket state machines in the same
+/// process.
+///
+/// Frames are handed to the other end by move.  They're never copied, never
+/// get a frame length field, and never go through a FramedReader.  The frames
+/// sent during one loop iteration reach the other end together, in a single
+/// hop to its EventBase.  The state machines still exchange every frame, so
+/// flow control, leases, keepalives and resumption behave as over any other
+/// transport.
+///
+/// Each end must be used, and destroyed, on the thread of its EventBase.  The
+/// two ends may share an EventBase.
+class InProcessDuplexConnection : public DuplexConnection {
+ public:
+  /// Creates the two ends of a connection.  The first end is used on
+  /// `firstEventBase`, the second one on `secondEventBase`.
+  static std::pair<
+      std::unique_ptr<InProcessDuplexConnection>,
+      std::unique_ptr<InProcessDuplexConnection>>
+  makePair(folly::EventBase& firstEventBase, folly::EventBase& secondEventBase);
+
+  ~InProcessDuplexConnection() override;
+
+  void send(std::unique_ptr<folly::IOBuf>) override;
+
+  void sendBatch(std::vector<std::unique_ptr<folly::IOBuf>>) override;
+
+  void setInput(std::shared_ptr<DuplexConnection::Subscriber>) override;
+
+  bool isFramed() const override {
+    return true;
+  }
+
+ private:
+  InProcessDuplexConnection(
+      std::shared_ptr<InProcessPipe> input,
+      std::shared_ptr<InProcessPipe> output);
+
+  /// Frames sent by the other end, towards this one.
+  const std::shared_ptr<InProcessPipe> input_;
+
+  /// Frames sent by this end, towards the other one.
+  const std::shared_ptr<InProcessPipe> output_;
+};
+
+} // namespace rsocket
@@ -0,0 +1,47 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Synchronized.h>
+
+#include <memory>
+
+#include "rsocket/ConnectionAcceptor.h"
+
+namespace rsocket {
+
+/// What an InProcessConnectionFactory connects to.  Shared between an
+/// InProcessConnectionAcceptor and its factories.
+class InProcessEndpoint {
+ public:
+  explicit InProcessEndpoint(folly::EventBase& eventBase)
+      : eventBase_(eventBase) {}
+
+  void start(OnDuplexConnectionAccept onAccept);
+  void stop();
+
+  /// Creates a connection, and hands its server end to the acceptor.  Returns
+  /// the client end, to be used on `clientEventBase`.  Throws if the acceptor
+  /// isn't accepting connections.
+  std::unique_ptr<DuplexConnection> connect(folly::EventBase& clientEventBase);
+
+ private:
+  folly::EventBase& eventBase_;
+
+  /// Set while the acceptor is accepting connections.
+  folly::Synchronized<std::shared_ptr<OnDuplexConnectionAccept>> onAccept_;
+};
+
+} // namespace rsocket
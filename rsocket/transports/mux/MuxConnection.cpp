@@ -0,0 +1,402 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/mux/MuxConnection.h"
+
+#include <folly/io/Cursor.h>
+#include <glog/logging.h>
+
+#include <deque>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#include "rsocket/framing/FrameSerializer.h"
+#include "rsocket/framing/FramedDuplexConnection.h"
+#include "yarpl/flowable/Subscription.h"
+
+namespace rsocket {
+
+using namespace yarpl::flowable;
+
+constexpr size_t MuxConnection::kSessionIdSize;
+
+namespace {
+
+/// Prefixes a frame with the id of its session, in place when the frame has
+/// the headroom for it.
+std::unique_ptr<folly::IOBuf> withSessionId(
+    uint32_t sessionId,
+    std::unique_ptr<folly::IOBuf> frame) {
+  constexpr auto kSize = MuxConnection::kSessionIdSize;
+  if (frame && frame->headroom() >= kSize && !frame->isSharedOne()) {
+    frame->prepend(kSize);
+  } else {
+    auto head = folly::IOBuf::create(kFrameLengthFieldHeadroom + kSize);
+    head->advance(kFrameLengthFieldHeadroom);
+    head->append(kSize);
+    if (frame) {
+      head->prependChain(std::move(frame));
+    }
+    frame = std::move(head);
+  }
+  folly::io::RWPrivateCursor cur(frame.get());
+  cur.writeBE<uint32_t>(sessionId);
+  return frame;
+}
+
+} // namespace
+
+/// The input side of a session: the subscriber of its connection, and the
+/// frames received before there was one.  Shared by the connection of the
+/// session and the MuxConnection, so that either can go away while the
+/// other delivers frames.
+class MuxConnection::Session : public std::enable_shared_from_this<Session> {
+ public:
+  explicit Session(uint32_t sessionId) : sessionId_(sessionId) {}
+
+  uint32_t sessionId() const {
+    return sessionId_;
+  }
+
+  /// Whether the other end closed the session, or the underlying connection
+  /// closed.
+  bool isTerminated() const {
+    return terminated_;
+  }
+
+  void setInput(std::shared_ptr<DuplexConnection::Subscriber> input) {
+    if (auto previous = std::move(input_)) {
+      previous->onComplete();
+    }
+    if (!input) {
+      return;
+    }
+    input_ = input;
+    input->onSubscribe(std::make_shared<InputSubscription>(shared_from_this()));
+
+    while (input_ && !unread_.empty()) {
+      auto frame = std::move(unread_.front());
+      unread_.pop_front();
+      auto const current = input_;
+      current->onNext(std::move(frame));
+    }
+    if (terminated_) {
+      finish();
+    }
+  }
+
+  void deliver(std::unique_ptr<folly::IOBuf> frame) {
+    if (terminated_) {
+      return;
+    }
+    if (input_ && unread_.empty()) {
+      auto const input = input_;
+      input->onNext(std::move(frame));
+    } else {
+      unread_.push_back(std::move(frame));
+    }
+  }
+
+  void terminate(folly::exception_wrapper ex) {
+    if (terminated_) {
+      return;
+    }
+    terminated_ = true;
+    error_ = std::move(ex);
+    if (unread_.empty()) {
+      finish();
+    }
+  }
+
+  /// The connection of the session is gone, drops everything.
+  void close() {
+    terminated_ = true;
+    unread_.clear();
+    input_ = nullptr;
+  }
+
+ private:
+  class InputSubscription : public Subscription {
+   public:
+    explicit InputSubscription(std::shared_ptr<Session> session)
+        : session_(std::move(session)) {}
+
+    void request(int64_t n) noexcept override {
+      DCHECK_EQ(n, std::numeric_limits<int64_t>::max())
+          << "MuxConnection doesn't support proper flow control";
+    }
+
+    void cancel() noexcept override {
+      if (auto session = std::move(session_)) {
+        session->input_ = nullptr;
+      }
+    }
+
+   private:
+    std::shared_ptr<Session> session_;
+  };
+
+  void finish() {
+    if (auto input = std::move(input_)) {
+      if (error_) {
+        input->onError(std::move(error_));
+      } else {
+        input->onComplete();
+      }
+    }
+  }
+
+  const uint32_t sessionId_;
+  std::shared_ptr<DuplexConnection::Subscriber> input_;
+  std::deque<std::unique_ptr<folly::IOBuf>> unread_;
+  bool terminated_{false};
+  folly::exception_wrapper error_;
+};
+
+/// What openSession() and the OnSession callback hand out.
+class MuxConnection::SessionConnection : public DuplexConnection {
+ public:
+  SessionConnection(
+      std::shared_ptr<MuxConnection> mux,
+      std::shared_ptr<Session> session)
+      : mux_(std::move(mux)), session_(std::move(session)) {}
+
+  ~SessionConnection() override {
+    mux_->removeSession(session_->sessionId());
+    session_->close();
+  }
+
+  void setInput(std::shared_ptr<DuplexConnection::Subscriber> input) override {
+    // Delivering frames may destroy this connection.
+    auto const session = session_;
+    session->setInput(std::move(input));
+  }
+
+  void send(std::unique_ptr<folly::IOBuf> frame) override {
+    mux_->send(session_->sessionId(), std::move(frame));
+  }
+
+  void sendBatch(std::vector<std::unique_ptr<folly::IOBuf>> frames) override {
+    mux_->sendBatch(session_->sessionId(), std::move(frames));
+  }
+
+  size_t bufferedOutputBytes() const override {
+    return mux_->bufferedOutputBytes();
+  }
+
+  bool isFramed() const override {
+    return true;
+  }
+
+ private:
+  const std::shared_ptr<MuxConnection> mux_;
+  const std::shared_ptr<Session> session_;
+};
+
+/// Subscriber of the underlying connection.  Keeps the MuxConnection alive
+/// until the underlying connection closes, as nothing else may hold on to
+/// the server end.
+class MuxConnection::Input : public DuplexConnection::Subscriber {
+ public:
+  explicit Input(std::shared_ptr<MuxConnection> mux) : mux_(std::move(mux)) {}
+
+  void onSubscribe(std::shared_ptr<Subscription> subscription) override {
+    if (!mux_ || mux_->isClosed()) {
+      subscription->cancel();
+      return;
+    }
+    mux_->inputSubscription_ = subscription;
+    subscription->request(std::numeric_limits<int64_t>::max());
+  }
+
+  void onNext(std::unique_ptr<folly::IOBuf> frame) override {
+    if (mux_) {
+      mux_->onFrame(std::move(frame));
+    }
+  }
+
+  void onComplete() override {
+    if (auto mux = std::move(mux_)) {
+      mux->terminate(folly::exception_wrapper());
+    }
+  }
+
+  void onError(folly::exception_wrapper ex) override {
+    if (auto mux = std::move(mux_)) {
+      mux->terminate(std::move(ex));
+    }
+  }
+
+ private:
+  std::shared_ptr<MuxConnection> mux_;
+};
+
+std::shared_ptr<MuxConnection> MuxConnection::client(
+    std::unique_ptr<DuplexConnection> connection) {
+  return std::shared_ptr<MuxConnection>(
+      new MuxConnection(std::move(connection), nullptr));
+}
+
+std::shared_ptr<MuxConnection> MuxConnection::server(
+    std::unique_ptr<DuplexConnection> connection,
+    OnSession onSession) {
+  CHECK(onSession);
+  auto mux = std::shared_ptr<MuxConnection>(
+      new MuxConnection(std::move(connection), std::move(onSession)));
+  mux->start();
+  return mux;
+}
+
+MuxConnection::MuxConnection(
+    std::unique_ptr<DuplexConnection> connection,
+    OnSession onSession)
+    : onSession_(std::move(onSession)) {
+  CHECK(connection);
+  if (connection->isFramed()) {
+    connection_ = std::move(connection);
+  } else {
+    connection_ = std::make_unique<FramedDuplexConnection>(
+        std::move(connection), ProtocolVersion::Latest);
+  }
+}
+
+MuxConnection::~MuxConnection() {
+  VLOG(3) << "~MuxConnection (" << this << ")";
+}
+
+void MuxConnection::start() {
+  if (std::exchange(started_, true) || !connection_) {
+    return;
+  }
+  // Frames may be delivered in-line.
+  auto const connection = connection_.get();
+  connection->setInput(std::make_shared<Input>(shared_from_this()));
+}
+
+std::unique_ptr<DuplexConnection> MuxConnection::openSession() {
+  DCHECK(!onSession_) << "Sessions are opened by the client end";
+  start();
+  if (closed_ || lastSessionId_ == std::numeric_limits<uint32_t>::max()) {
+    return nullptr;
+  }
+  auto session = std::make_shared<Session>(++lastSessionId_);
+  sessions_.emplace(session->sessionId(), session);
+  return std::make_unique<SessionConnection>(
+      shared_from_this(), std::move(session));
+}
+
+void MuxConnection::close() {
+  terminate(folly::exception_wrapper());
+}
+
+void MuxConnection::onFrame(std::unique_ptr<folly::IOBuf> frame) {
+  if (frame->computeChainDataLength() < kSessionIdSize) {
+    terminate(std::runtime_error("Multiplexed frame without a session id"));
+    return;
+  }
+  if (frame->length() < kSessionIdSize) {
+    frame->gather(kSessionIdSize);
+  }
+  auto const sessionId = folly::io::Cursor(frame.get()).readBE<uint32_t>();
+  frame->trimStart(kSessionIdSize);
+  auto const closing = frame->empty();
+
+  auto it = sessions_.find(sessionId);
+  if (it != sessions_.end()) {
+    // Delivering may remove the session.
+    auto const session = it->second;
+    if (closing) {
+      session->terminate(folly::exception_wrapper());
+    } else {
+      session->deliver(std::move(frame));
+    }
+    return;
+  }
+
+  if (closing || !onSession_ || sessionId <= lastSessionId_) {
+    VLOG(4) << "Dropping frame of closed session " << sessionId;
+    return;
+  }
+
+  lastSessionId_ = sessionId;
+  auto session = std::make_shared<Session>(sessionId);
+  sessions_.emplace(sessionId, session);
+  // Held until the session gets a subscriber.
+  session->deliver(std::move(frame));
+  onSession_(
+      std::make_unique<SessionConnection>(
+          shared_from_this(), std::move(session)));
+}
+
+void MuxConnection::send(
+    uint32_t sessionId,
+    std::unique_ptr<folly::IOBuf> frame) {
+  if (connection_) {
+    connection_->send(withSessionId(sessionId, std::move(frame)));
+  }
+}
+
+void MuxConnection::sendBatch(
+    uint32_t sessionId,
+    std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+  if (!connection_) {
+    return;
+  }
+  for (auto& frame : frames) {
+    frame = withSessionId(sessionId, std::move(frame));
+  }
+  connection_->sendBatch(std::move(frames));
+}
+
+size_t MuxConnection::bufferedOutputBytes() const {
+  return connection_ ? connection_->bufferedOutputBytes() : 0;
+}
+
+void MuxConnection::removeSession(uint32_t sessionId) {
+  auto it = sessions_.find(sessionId);
+  if (it == sessions_.end()) {
+    return;
+  }
+  auto const notifyPeer = !it->second->isTerminated();
+  sessions_.erase(it);
+
+  if (notifyPeer) {
+    send(sessionId, nullptr);
+  }
+  if (!onSession_ && sessions_.empty()) {
+    close();
+  }
+}
+
+void MuxConnection::terminate(folly::exception_wrapper ex) {
+  if (closed_.exchange(true)) {
+    return;
+  }
+  // Closing the underlying connection may drop the last other reference.
+  auto const self = shared_from_this();
+
+  auto connection = std::move(connection_);
+  if (auto subscription = std::move(inputSubscription_)) {
+    subscription->cancel();
+  }
+
+  auto sessions = std::move(sessions_);
+  sessions_.clear();
+  for (auto& entry : sessions) {
+    entry.second->terminate(ex);
+  }
+}
+
+} // namespace rsocket
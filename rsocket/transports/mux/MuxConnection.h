@@ -0,0 +1,118 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/ExceptionWrapper.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "rsocket/DuplexConnection.h"
+
+namespace rsocket {
+
+/// Carries many RSocket sessions over one underlying connection.
+///
+/// Each session is a DuplexConnection of its own, with its own state machine
+/// on top, while all of them share one socket.  On the underlying connection
+/// every frame of a session is prefixed with the 4 byte id of the session.
+/// A bare session id, without a frame behind it, closes the session.
+///
+/// The client end opens sessions with openSession().  The server end hands
+/// every session the client opens to a callback.  Session ids are never
+/// reused on one underlying connection.
+///
+/// Everything, including the sessions, must be used on the thread of the
+/// EventBase of the underlying connection.  Sessions share its output buffer,
+/// so bufferedOutputBytes() of a session counts the output of all of them.
+class MuxConnection : public std::enable_shared_from_this<MuxConnection> {
+ public:
+  using OnSession = std::function<void(std::unique_ptr<DuplexConnection>)>;
+
+  static constexpr size_t kSessionIdSize = sizeof(uint32_t);
+
+  /// Creates the client end.  The underlying connection is closed once the
+  /// last session open on it closes.
+  static std::shared_ptr<MuxConnection> client(
+      std::unique_ptr<DuplexConnection>);
+
+  /// Creates the server end, which runs `onSession` for every session the
+  /// client end opens.
+  static std::shared_ptr<MuxConnection> server(
+      std::unique_ptr<DuplexConnection>,
+      OnSession onSession);
+
+  ~MuxConnection();
+
+  /// Opens a session on the client end.  Returns nullptr once the underlying
+  /// connection is closed.
+  std::unique_ptr<DuplexConnection> openSession();
+
+  /// Closes the underlying connection, which completes the input of every
+  /// session.
+  void close();
+
+  /// Can be called from any thread.
+  bool isClosed() const {
+    return closed_;
+  }
+
+  size_t numSessions() const {
+    return sessions_.size();
+  }
+
+ private:
+  class Input;
+  class Session;
+  class SessionConnection;
+
+  MuxConnection(std::unique_ptr<DuplexConnection>, OnSession);
+
+  /// Subscribes to the underlying connection, on the first use.
+  void start();
+
+  void onFrame(std::unique_ptr<folly::IOBuf>);
+
+  void send(uint32_t sessionId, std::unique_ptr<folly::IOBuf>);
+  void sendBatch(
+      uint32_t sessionId,
+      std::vector<std::unique_ptr<folly::IOBuf>>);
+  size_t bufferedOutputBytes() const;
+
+  /// Forgets a session whose connection was destroyed, and tells the other
+  /// end unless it closed the session first.
+  void removeSession(uint32_t sessionId);
+
+  /// Closes the underlying connection, and terminates the input of every
+  /// session with `ex`.
+  void terminate(folly::exception_wrapper ex);
+
+  std::unique_ptr<DuplexConnection> connection_;
+  std::shared_ptr<yarpl::flowable::Subscription> inputSubscription_;
+  const OnSession onSession_;
+  bool started_{false};
+  std::atomic<bool> closed_{false};
+
+  std::unordered_map<uint32_t, std::shared_ptr<Session>> sessions_;
+
+  /// Last session id opened on the client end, or accepted on the server
+  /// end.
+  uint32_t lastSessionId_{0};
+};
+
+} // namespace rsocket
@@ -0,0 +1,52 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/mux/MuxConnectionAcceptor.h"
+
+#include <glog/logging.h>
+
+#include "rsocket/transports/mux/MuxConnection.h"
+
+namespace rsocket {
+
+MuxConnectionAcceptor::MuxConnectionAcceptor(
+    std::unique_ptr<ConnectionAcceptor> acceptor)
+    : acceptor_(std::move(acceptor)) {
+  CHECK(acceptor_);
+}
+
+MuxConnectionAcceptor::~MuxConnectionAcceptor() = default;
+
+void MuxConnectionAcceptor::start(OnDuplexConnectionAccept onAccept) {
+  acceptor_->start([onAccept = std::move(onAccept)](
+                       std::unique_ptr<DuplexConnection> connection,
+                       folly::EventBase& eventBase) {
+    // Lives as long as the connection does.
+    MuxConnection::server(
+        std::move(connection),
+        [onAccept, &eventBase](std::unique_ptr<DuplexConnection> session) {
+          onAccept(std::move(session), eventBase);
+        });
+  });
+}
+
+void MuxConnectionAcceptor::stop() {
+  acceptor_->stop();
+}
+
+folly::Optional<uint16_t> MuxConnectionAcceptor::listeningPort() const {
+  return acceptor_->listeningPort();
+}
+
+} // namespace rsocket
@@ -0,0 +1,61 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+
+#include "rsocket/ConnectionAcceptor.h"
+
+namespace rsocket {
+
+/**
+ * Implementation of ConnectionAcceptor that accepts the sessions multiplexed
+ * over the connections of another acceptor, for use with
+ * RSocket::createServer.
+ *
+ * Every session a MuxConnectionFactory opens is handed out as a connection of
+ * its own, on the EventBase of the connection it is multiplexed over.  See
+ * MuxConnection.
+ *
+ * Construction of this does nothing.  The `start` method kicks off work.
+ */
+class MuxConnectionAcceptor : public ConnectionAcceptor {
+ public:
+  explicit MuxConnectionAcceptor(std::unique_ptr<ConnectionAcceptor> acceptor);
+  ~MuxConnectionAcceptor();
+
+  // ConnectionAcceptor overrides.
+
+  /**
+   * Start accepting connections, and the sessions multiplexed over them.
+   */
+  void start(OnDuplexConnectionAccept) override;
+
+  /**
+   * Stop accepting connections.  Sessions of the connections accepted so far
+   * are still accepted.
+   */
+  void stop() override;
+
+  /**
+   * Get the port the underlying acceptor is listening on.
+   */
+  folly::Optional<uint16_t> listeningPort() const override;
+
+ private:
+  const std::unique_ptr<ConnectionAcceptor> acceptor_;
+};
+
+} // namespace rsocket
@@ -0,0 +1,90 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/mux/MuxConnectionFactory.h"
+
+#include <folly/io/async/EventBase.h>
+
+#include <stdexcept>
+
+#include "rsocket/transports/mux/MuxConnection.h"
+
+namespace rsocket {
+
+MuxConnectionFactory::MuxConnectionFactory(
+    std::unique_ptr<ConnectionFactory> factory)
+    : factory_(std::move(factory)) {
+  CHECK(factory_);
+}
+
+MuxConnectionFactory::~MuxConnectionFactory() = default;
+
+folly::Future<ConnectionFactory::ConnectedDuplexConnection>
+MuxConnectionFactory::connect(
+    ProtocolVersion version,
+    ResumeStatus /* unused */) {
+  return underlying(version).thenValue([](Underlying underlying) {
+    // Sessions are opened on the thread of the underlying connection.
+    auto const eventBase = underlying.eventBase;
+    return folly::via(eventBase, [underlying, eventBase] {
+      auto session = underlying.mux->openSession();
+      if (!session) {
+        throw std::runtime_error("Multiplexed connection is closed");
+      }
+      return ConnectedDuplexConnection{std::move(session), *eventBase};
+    });
+  });
+}
+
+folly::Future<MuxConnectionFactory::Underlying>
+MuxConnectionFactory::underlying(ProtocolVersion version) {
+  std::shared_ptr<folly::SharedPromise<Underlying>> connecting;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (underlying_.mux && !underlying_.mux->isClosed()) {
+      return folly::makeFuture(underlying_);
+    }
+    if (connecting_) {
+      return connecting_->getFuture();
+    }
+    connecting = connecting_ =
+        std::make_shared<folly::SharedPromise<Underlying>>();
+  }
+
+  // Called without the lock held, the future may complete in-line.
+  factory_->connect(version, ResumeStatus::NEW_SESSION)
+      .thenTry([this, connecting](
+                   folly::Try<ConnectedDuplexConnection> result) {
+        if (result.hasException()) {
+          {
+            std::lock_guard<std::mutex> lock(mutex_);
+            connecting_ = nullptr;
+          }
+          connecting->setException(std::move(result.exception()));
+          return;
+        }
+        Underlying underlying{
+            MuxConnection::client(std::move(result->connection)),
+            &result->eventBase};
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          underlying_ = underlying;
+          connecting_ = nullptr;
+        }
+        connecting->setValue(std::move(underlying));
+      });
+  return connecting->getFuture();
+}
+
+} // namespace rsocket
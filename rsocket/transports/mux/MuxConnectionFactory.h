@@ -0,0 +1,73 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/futures/SharedPromise.h>
+
+#include <memory>
+#include <mutex>
+
+#include "rsocket/ConnectionFactory.h"
+
+namespace rsocket {
+
+class MuxConnection;
+
+/**
+ * Implementation of ConnectionFactory that multiplexes the connections it
+ * makes over a single connection of another factory, for use with
+ * RSocket::createClient().
+ *
+ * The first connect() makes the underlying connection, and every connect()
+ * opens a session on it.  See MuxConnection.  Once the underlying connection
+ * closes, the next connect() makes a new one.  The server has to accept the
+ * connections with a MuxConnectionAcceptor.
+ *
+ * Creation of this does nothing.  The `connect` method kicks off work.
+ */
+class MuxConnectionFactory : public ConnectionFactory {
+ public:
+  explicit MuxConnectionFactory(std::unique_ptr<ConnectionFactory> factory);
+  ~MuxConnectionFactory() override;
+
+  /**
+   * Opens a session on the underlying connection, connecting it first if
+   * needed.
+   *
+   * Resumption makes a new session like any other connect(); it is the
+   * RSocket session on top that is resumed.
+   */
+  folly::Future<ConnectedDuplexConnection> connect(
+      ProtocolVersion,
+      ResumeStatus resume) override;
+
+ private:
+  struct Underlying {
+    std::shared_ptr<MuxConnection> mux;
+    folly::EventBase* eventBase{nullptr};
+  };
+
+  folly::Future<Underlying> underlying(ProtocolVersion);
+
+  const std::unique_ptr<ConnectionFactory> factory_;
+
+  std::mutex mutex_;
+  Underlying underlying_;
+
+  /// Set while the underlying connection is being made.
+  std::shared_ptr<folly::SharedPromise<Underlying>> connecting_;
+};
+
+} // namespace rsocket
@@ -0,0 +1,154 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/quic/QuicConnectionAcceptor.h"
+
+#include <stdexcept>
+
+#include <folly/io/async/EventBase.h>
+#include <glog/logging.h>
+#include <quic/QuicException.h>
+#include <quic/server/QuicServerTransport.h>
+#include <quic/server/QuicServerTransportFactory.h>
+
+#include "rsocket/transports/quic/QuicDuplexConnection.h"
+
+namespace rsocket {
+
+namespace {
+
+/// Waits for the client to open the stream of the RSocket connection.
+/// Deletes itself once it is handed over, or the QUIC connection ends first.
+class AcceptCallback : public quic::QuicSocket::ConnectionCallback {
+ public:
+  AcceptCallback(
+      folly::EventBase& eventBase,
+      ConnectionAcceptor::OnDuplexConnectionAccept onAccept)
+      : eventBase_(eventBase), onAccept_(std::move(onAccept)) {}
+
+  void setTransport(std::shared_ptr<quic::QuicSocket> transport) {
+    transport_ = std::move(transport);
+  }
+
+  void onNewBidirectionalStream(quic::StreamId streamId) noexcept override {
+    std::unique_ptr<AcceptCallback> deleter(this);
+    VLOG(2) << "Accepted QUIC stream " << streamId << " from "
+            << transport_->getPeerAddress();
+
+    auto connection = std::make_unique<QuicDuplexConnection>(
+        std::move(transport_), streamId, RSocketStats::noop());
+    onAccept_(std::move(connection), eventBase_);
+  }
+
+  void onNewUnidirectionalStream(quic::StreamId streamId) noexcept override {
+    transport_->setReadCallback(streamId, nullptr);
+  }
+
+  void onStopSending(
+      quic::StreamId,
+      quic::ApplicationErrorCode) noexcept override {}
+
+  void onConnectionEnd() noexcept override {
+    drop();
+  }
+
+  void onConnectionError(
+      std::pair<quic::QuicErrorCode, std::string> error) noexcept override {
+    VLOG(2) << "QUIC connection failed before opening a stream: "
+            << quic::toString(error.first) << " " << error.second;
+    drop();
+  }
+
+ private:
+  /// The transport is in the middle of calling back, it has to be released
+  /// later.
+  void drop() {
+    transport_->setConnectionCallback(nullptr);
+    eventBase_.runInLoop([transport = std::move(transport_)] {});
+    delete this;
+  }
+
+  folly::EventBase& eventBase_;
+  const ConnectionAcceptor::OnDuplexConnectionAccept onAccept_;
+  std::shared_ptr<quic::QuicSocket> transport_;
+};
+
+} // namespace
+
+class QuicConnectionAcceptor::TransportFactory
+    : public quic::QuicServerTransportFactory {
+ public:
+  explicit TransportFactory(OnDuplexConnectionAccept onAccept)
+      : onAccept_(std::move(onAccept)) {}
+
+  quic::QuicServerTransport::Ptr make(
+      folly::EventBase* evb,
+      std::unique_ptr<folly::AsyncUDPSocket> socket,
+      const folly::SocketAddress& /* peer */,
+      std::shared_ptr<const fizz::server::FizzServerContext> ctx) noexcept
+      override {
+    auto callback = new AcceptCallback(*evb, onAccept_);
+    auto transport = quic::QuicServerTransport::make(
+        evb, std::move(socket), *callback, std::move(ctx));
+    callback->setTransport(transport);
+    return transport;
+  }
+
+ private:
+  const OnDuplexConnectionAccept onAccept_;
+};
+
+QuicConnectionAcceptor::QuicConnectionAcceptor(Options options)
+    : options_(std::move(options)) {}
+
+QuicConnectionAcceptor::~QuicConnectionAcceptor() {
+  stop();
+}
+
+void QuicConnectionAcceptor::start(OnDuplexConnectionAccept onAccept) {
+  if (server_) {
+    throw std::runtime_error("QuicConnectionAcceptor::start() already called");
+  }
+  if (!options_.fizzContext) {
+    throw std::invalid_argument("QuicConnectionAcceptor needs a fizzContext");
+  }
+
+  server_ = quic::QuicServer::createQuicServer();
+  server_->setTransportSettings(options_.transportSettings);
+  server_->setFizzContext(options_.fizzContext);
+  server_->setQuicServerTransportFactory(
+      std::make_unique<TransportFactory>(std::move(onAccept)));
+  server_->start(options_.address, options_.threads);
+  server_->waitUntilInitialized();
+
+  LOG(INFO) << "QuicConnectionAcceptor => listening on "
+            << server_->getAddress();
+}
+
+void QuicConnectionAcceptor::stop() {
+  VLOG(1) << "Shutting down QUIC listening socket";
+
+  if (auto server = std::move(server_)) {
+    server->shutdown();
+  }
+}
+
+folly::Optional<uint16_t> QuicConnectionAcceptor::listeningPort() const {
+  if (!server_) {
+    return folly::none;
+  }
+  return server_->getAddress().getPort();
+}
+
+} // namespace rsocket
@@ -0,0 +1,82 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <fizz/server/FizzServerContext.h>
+#include <folly/SocketAddress.h>
+#include <quic/server/QuicServer.h>
+#include <quic/state/TransportSettings.h>
+
+#include "rsocket/ConnectionAcceptor.h"
+
+namespace rsocket {
+
+/**
+ * QUIC implementation of ConnectionAcceptor for use with
+ * RSocket::createServer
+ *
+ * Every QUIC connection carries one RSocket connection, on the first
+ * bidirectional stream the client opens.  The connection is handed over once
+ * that stream shows up.
+ *
+ * Construction of this does nothing.  The `start` method kicks off work.
+ */
+class QuicConnectionAcceptor : public ConnectionAcceptor {
+ public:
+  struct Options {
+    /// Address to listen on
+    folly::SocketAddress address{"::", 8080};
+
+    /// Number of worker threads accepting and processing connections.
+    size_t threads{2};
+
+    /// Certificates and TLS settings of the handshake.  Required.
+    std::shared_ptr<const fizz::server::FizzServerContext> fizzContext;
+
+    /// Settings of every QUIC connection.
+    quic::TransportSettings transportSettings;
+  };
+
+  explicit QuicConnectionAcceptor(Options);
+  ~QuicConnectionAcceptor();
+
+  // ConnectionAcceptor overrides.
+
+  /**
+   * Bind the UDP socket and start accepting QUIC connections.
+   */
+  void start(OnDuplexConnectionAccept) override;
+
+  /**
+   * Stop accepting connections and close the UDP socket.
+   */
+  void stop() override;
+
+  /**
+   * Get the port being listened on.
+   */
+  folly::Optional<uint16_t> listeningPort() const override;
+
+ private:
+  class TransportFactory;
+
+  /// Options this acceptor has been configured with.
+  const Options options_;
+
+  /// The server, while the acceptor is started.
+  std::shared_ptr<quic::QuicServer> server_;
+};
+
+} // namespace rsocket
@@ -0,0 +1,158 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/quic/QuicConnectionFactory.h"
+
+#include <stdexcept>
+
+#include <folly/Conv.h>
+#include <glog/logging.h>
+#include <quic/QuicException.h>
+#include <quic/fizz/client/handshake/FizzClientQuicHandshakeContext.h>
+
+#include "rsocket/transports/quic/QuicDuplexConnection.h"
+
+namespace rsocket {
+
+namespace {
+
+class ConnectCallback : public quic::QuicSocket::ConnectionCallback {
+ public:
+  ConnectCallback(
+      folly::EventBase& eventBase,
+      std::shared_ptr<quic::QuicClientTransport> client,
+      folly::Promise<ConnectionFactory::ConnectedDuplexConnection>
+          connectPromise)
+      : eventBase_(eventBase),
+        client_(std::move(client)),
+        connectPromise_(std::move(connectPromise)) {}
+
+  /// Deletes itself once the handshake completes or fails.
+  void start() {
+    client_->start(this);
+  }
+
+  void onTransportReady() noexcept override {
+    auto streamId = client_->createBidirectionalStream();
+    if (streamId.hasError()) {
+      fail(folly::to<std::string>(
+          "Cannot open a QUIC stream: ", quic::toString(streamId.error())));
+      return;
+    }
+
+    std::unique_ptr<ConnectCallback> deleter(this);
+    VLOG(4) << "connectSuccess() on " << client_->getPeerAddress();
+
+    auto connection = std::make_unique<QuicDuplexConnection>(
+        std::move(client_), streamId.value(), RSocketStats::noop());
+    connectPromise_.setValue(ConnectionFactory::ConnectedDuplexConnection{
+        std::move(connection), eventBase_});
+  }
+
+  void onNewBidirectionalStream(quic::StreamId) noexcept override {}
+
+  void onNewUnidirectionalStream(quic::StreamId) noexcept override {}
+
+  void onStopSending(
+      quic::StreamId,
+      quic::ApplicationErrorCode) noexcept override {}
+
+  void onConnectionEnd() noexcept override {
+    fail("QUIC connection closed during the handshake");
+  }
+
+  void onConnectionError(
+      std::pair<quic::QuicErrorCode, std::string> error) noexcept override {
+    fail(folly::to<std::string>(
+        "QUIC connection failed: ",
+        quic::toString(error.first),
+        " ",
+        error.second));
+  }
+
+ private:
+  void fail(std::string message) {
+    std::unique_ptr<ConnectCallback> deleter(this);
+    VLOG(4) << "connectErr(" << message << ")";
+
+    // The client is in the middle of calling back, it has to be released
+    // later.
+    client_->setConnectionCallback(nullptr);
+    client_->closeNow(folly::none);
+    eventBase_.runInLoop([client = std::move(client_)] {});
+    connectPromise_.setException(std::runtime_error(std::move(message)));
+  }
+
+  folly::EventBase& eventBase_;
+  std::shared_ptr<quic::QuicClientTransport> client_;
+  folly::Promise<ConnectionFactory::ConnectedDuplexConnection> connectPromise_;
+};
+
+} // namespace
+
+QuicConnectionFactory::QuicConnectionFactory(
+    folly::EventBase& eventBase,
+    folly::SocketAddress address,
+    Options options)
+    : eventBase_(&eventBase),
+      address_(std::move(address)),
+      options_(std::move(options)) {
+  if (!options_.verifier) {
+    throw std::invalid_argument("QuicConnectionFactory needs a verifier");
+  }
+}
+
+QuicConnectionFactory::~QuicConnectionFactory() = default;
+
+folly::Future<ConnectionFactory::ConnectedDuplexConnection>
+QuicConnectionFactory::connect(ProtocolVersion, ResumeStatus /* unused */) {
+  folly::Promise<ConnectionFactory::ConnectedDuplexConnection> connectPromise;
+  auto connectFuture = connectPromise.getFuture();
+
+  eventBase_->runInEventBaseThread(
+      [this, promise = std::move(connectPromise)]() mutable {
+        auto client = quic::QuicClientTransport::newClient(
+            eventBase_,
+            std::make_unique<folly::AsyncUDPSocket>(eventBase_),
+            quic::FizzClientQuicHandshakeContext::Builder()
+                .setFizzClientContext(options_.fizzContext)
+                .setCertificateVerifier(options_.verifier)
+                .build());
+        client->setHostname(options_.hostname);
+        client->addNewPeerAddress(address_);
+        client->setTransportSettings(options_.transportSettings);
+        lastClient_ = client;
+
+        VLOG(3) << "Attempting QUIC connection to " << address_;
+        (new ConnectCallback(
+             *eventBase_, std::move(client), std::move(promise)))
+            ->start();
+      });
+  return connectFuture;
+}
+
+bool QuicConnectionFactory::switchNetwork(
+    std::unique_ptr<folly::AsyncUDPSocket> socket) {
+  DCHECK(eventBase_->isInEventBaseThread());
+
+  auto client = lastClient_.lock();
+  if (!client || !client->good()) {
+    return false;
+  }
+  VLOG(2) << "Migrating QUIC connection to " << address_;
+  client->onNetworkSwitch(std::move(socket));
+  return true;
+}
+
+} // namespace rsocket
@@ -0,0 +1,89 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <fizz/client/FizzClientContext.h>
+#include <fizz/protocol/CertificateVerifier.h>
+#include <folly/SocketAddress.h>
+#include <folly/io/async/AsyncUDPSocket.h>
+#include <quic/client/QuicClientTransport.h>
+#include <quic/state/TransportSettings.h>
+
+#include "rsocket/ConnectionFactory.h"
+
+namespace rsocket {
+
+/**
+ * QUIC implementation of ConnectionFactory for use with
+ * RSocket::createClient().
+ *
+ * Each connect() opens a QUIC connection, and runs the RSocket connection on
+ * one bidirectional stream of it.
+ *
+ * Creation of this does nothing.  The `connect` method kicks off work.
+ */
+class QuicConnectionFactory : public ConnectionFactory {
+ public:
+  struct Options {
+    /// TLS settings of the handshake.  Defaults to those of fizz.
+    std::shared_ptr<const fizz::client::FizzClientContext> fizzContext{
+        std::make_shared<fizz::client::FizzClientContext>()};
+
+    /// Checks the certificate of the server.  Required.
+    std::shared_ptr<const fizz::CertificateVerifier> verifier;
+
+    /// Name of the server, for SNI and the certificate check.
+    std::string hostname;
+
+    /// Settings of every QUIC connection.
+    quic::TransportSettings transportSettings;
+  };
+
+  QuicConnectionFactory(
+      folly::EventBase& eventBase,
+      folly::SocketAddress address,
+      Options options);
+  ~QuicConnectionFactory() override;
+
+  /**
+   * Connect to server defined in constructor.
+   *
+   * Each call to connect() creates a new QUIC connection.
+   */
+  folly::Future<ConnectedDuplexConnection> connect(
+      ProtocolVersion,
+      ResumeStatus resume) override;
+
+  /**
+   * Moves the last connection made by connect() onto another UDP socket,
+   * e.g. one bound to a new network interface.  The QUIC connection and all
+   * of its streams carry on without the RSocket connection noticing, where
+   * TCP would need a reconnect and a resumption.
+   *
+   * Must be called on the thread of the EventBase.  Returns false if there is
+   * no such connection any more.
+   */
+  bool switchNetwork(std::unique_ptr<folly::AsyncUDPSocket> socket);
+
+ private:
+  folly::EventBase* eventBase_;
+  const folly::SocketAddress address_;
+  const Options options_;
+
+  /// Connection made by the last call to connect().
+  std::weak_ptr<quic::QuicClientTransport> lastClient_;
+};
+
+} // namespace rsocket
@@ -0,0 +1,341 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/quic/QuicDuplexConnection.h"
+
+#include <limits>
+#include <stdexcept>
+
+#include <folly/Conv.h>
+#include <folly/io/IOBufQueue.h>
+#include <glog/logging.h>
+#include <quic/QuicException.h>
+
+#include "rsocket/framing/FramedDuplexConnection.h"
+#include "yarpl/flowable/Subscription.h"
+
+namespace rsocket {
+
+using namespace yarpl::flowable;
+
+/// The stream an RSocket connection runs on, as a stream of bytes.  It is
+/// registered as the read and connection callback of the QUIC connection,
+/// which holds a reference to it until it is closed.
+class QuicStream : public quic::QuicSocket::ReadCallback,
+                   public quic::QuicSocket::ConnectionCallback {
+  friend void intrusive_ptr_add_ref(QuicStream* x);
+  friend void intrusive_ptr_release(QuicStream* x);
+
+ public:
+  QuicStream(
+      std::shared_ptr<quic::QuicSocket> socket,
+      quic::StreamId streamId,
+      std::shared_ptr<RSocketStats> stats)
+      : socket_(std::move(socket)),
+        streamId_(streamId),
+        stats_(std::move(stats)) {
+    socket_->setConnectionCallback(this);
+    socket_->setReadCallback(streamId_, this);
+    intrusive_ptr_add_ref(this);
+  }
+
+  ~QuicStream() override {
+    DCHECK(state_ == State::CLOSED);
+    DCHECK(!inputSubscriber_);
+  }
+
+  quic::QuicSocket& socket() const {
+    return *socket_;
+  }
+
+  size_t bufferedBytes() const {
+    return unread_.chainLength();
+  }
+
+  void setInput(std::shared_ptr<DuplexConnection::Subscriber> inputSubscriber) {
+    if (inputSubscriber && state_ != State::OPEN) {
+      inputSubscriber->onComplete();
+      return;
+    }
+
+    if (!inputSubscriber) {
+      inputSubscriber_ = nullptr;
+      return;
+    }
+
+    CHECK(!inputSubscriber_);
+    inputSubscriber_ = std::move(inputSubscriber);
+
+    // Hand over what came in while there was no subscriber.
+    if (!unread_.empty()) {
+      inputSubscriber_->onNext(unread_.move());
+    }
+  }
+
+  void send(std::unique_ptr<folly::IOBuf> data) {
+    if (state_ != State::OPEN) {
+      return;
+    }
+
+    if (stats_) {
+      stats_->bytesWritten(data->computeChainDataLength());
+    }
+    auto const result = socket_->writeChain(
+        streamId_, std::move(data), /* eof */ false, /* cork */ false);
+    if (result.hasError()) {
+      closeWithError(std::runtime_error(folly::to<std::string>(
+          "QUIC write failed: ", quic::toString(result.error()))));
+    }
+  }
+
+  /// Closes the QUIC connection and completes the input.
+  void close() {
+    if (state_ != State::OPEN) {
+      return;
+    }
+    auto subscriber = std::move(inputSubscriber_);
+    detach();
+    socket_->close(folly::none);
+    if (subscriber) {
+      subscriber->onComplete();
+    }
+  }
+
+  void closeWithError(folly::exception_wrapper ew) {
+    if (state_ != State::OPEN) {
+      return;
+    }
+    auto subscriber = std::move(inputSubscriber_);
+    detach();
+    socket_->close(std::make_pair(
+        quic::QuicErrorCode(quic::GenericApplicationErrorCode::UNKNOWN),
+        ew.what().toStdString()));
+    if (subscriber) {
+      subscriber->onError(std::move(ew));
+    }
+  }
+
+ private:
+  enum class State { OPEN, CLOSED };
+
+  // quic::QuicSocket::ReadCallback.
+
+  void readAvailable(quic::StreamId streamId) noexcept override {
+    DCHECK_EQ(streamId, streamId_);
+    // Reading may close the connection and drop the last reference.
+    boost::intrusive_ptr<QuicStream> self(this);
+
+    while (state_ == State::OPEN) {
+      auto result = socket_->read(streamId_, /* maxLen */ 0);
+      if (result.hasError()) {
+        closeWithError(std::runtime_error(folly::to<std::string>(
+            "QUIC read failed: ", quic::toString(result.error()))));
+        return;
+      }
+
+      auto& data = result.value().first;
+      auto const eof = result.value().second;
+      if (data && !data->empty()) {
+        if (stats_) {
+          stats_->bytesRead(data->computeChainDataLength());
+        }
+        if (inputSubscriber_) {
+          inputSubscriber_->onNext(std::move(data));
+        } else {
+          unread_.append(std::move(data));
+        }
+      }
+
+      if (eof) {
+        close();
+        return;
+      }
+      if (!data) {
+        return;
+      }
+    }
+  }
+
+  void readError(
+      quic::StreamId streamId,
+      std::pair<quic::QuicErrorCode, folly::Optional<folly::StringPiece>>
+          error) noexcept override {
+    DCHECK_EQ(streamId, streamId_);
+    closeWithError(std::runtime_error(folly::to<std::string>(
+        "QUIC stream failed: ", quic::toString(error.first))));
+  }
+
+  // quic::QuicSocket::ConnectionCallback.
+
+  void onNewBidirectionalStream(quic::StreamId streamId) noexcept override {
+    VLOG(3) << "Refusing bidirectional QUIC stream " << streamId;
+    socket_->resetStream(streamId, quic::GenericApplicationErrorCode::UNKNOWN);
+  }
+
+  void onNewUnidirectionalStream(quic::StreamId streamId) noexcept override {
+    VLOG(3) << "Refusing unidirectional QUIC stream " << streamId;
+    socket_->setReadCallback(streamId, nullptr);
+  }
+
+  void onStopSending(
+      quic::StreamId streamId,
+      quic::ApplicationErrorCode) noexcept override {
+    if (streamId == streamId_) {
+      closeWithError(std::runtime_error("QUIC peer stopped reading"));
+    }
+  }
+
+  void onConnectionEnd() noexcept override {
+    close();
+  }
+
+  void onConnectionError(
+      std::pair<quic::QuicErrorCode, std::string> error) noexcept override {
+    closeWithError(std::runtime_error(folly::to<std::string>(
+        "QUIC connection failed: ",
+        quic::toString(error.first),
+        " ",
+        error.second)));
+  }
+
+  /// Stops getting callbacks from the QUIC connection, and drops the
+  /// reference it held.
+  void detach() {
+    state_ = State::CLOSED;
+    unread_.move();
+    socket_->setReadCallback(streamId_, nullptr);
+    socket_->setConnectionCallback(nullptr);
+    intrusive_ptr_release(this);
+  }
+
+  const std::shared_ptr<quic::QuicSocket> socket_;
+  const quic::StreamId streamId_;
+  const std::shared_ptr<RSocketStats> stats_;
+
+  State state_{State::OPEN};
+
+  /// Data received while there was no input subscriber.
+  folly::IOBufQueue unread_{folly::IOBufQueue::cacheChainLength()};
+
+  std::shared_ptr<DuplexConnection::Subscriber> inputSubscriber_;
+  int refCount_{0};
+};
+
+void intrusive_ptr_add_ref(QuicStream* x);
+void intrusive_ptr_release(QuicStream* x);
+
+inline void intrusive_ptr_add_ref(QuicStream* x) {
+  ++x->refCount_;
+}
+
+inline void intrusive_ptr_release(QuicStream* x) {
+  if (--x->refCount_ == 0)
+    delete x;
+}
+
+namespace {
+
+class QuicInputSubscription : public Subscription {
+ public:
+  explicit QuicInputSubscription(boost::intrusive_ptr<QuicStream> stream)
+      : stream_(std::move(stream)) {
+    CHECK(stream_);
+  }
+
+  void request(int64_t n) noexcept override {
+    DCHECK(stream_);
+    DCHECK_EQ(n, std::numeric_limits<int64_t>::max())
+        << "QuicDuplexConnection doesnt support proper flow control";
+  }
+
+  void cancel() noexcept override {
+    stream_->setInput(nullptr);
+    stream_ = nullptr;
+  }
+
+ private:
+  boost::intrusive_ptr<QuicStream> stream_;
+};
+
+/// The bytes of the stream, for a FramedDuplexConnection to delimit.
+class QuicStreamConnection : public DuplexConnection {
+ public:
+  explicit QuicStreamConnection(boost::intrusive_ptr<QuicStream> stream)
+      : stream_(std::move(stream)) {}
+
+  void send(std::unique_ptr<folly::IOBuf> buf) override {
+    stream_->send(std::move(buf));
+  }
+
+  void setInput(
+      std::shared_ptr<DuplexConnection::Subscriber> inputSubscriber) override {
+    inputSubscriber->onSubscribe(
+        std::make_shared<QuicInputSubscription>(stream_));
+    stream_->setInput(std::move(inputSubscriber));
+  }
+
+  size_t bufferedInputBytes() const override {
+    return stream_->bufferedBytes();
+  }
+
+ private:
+  const boost::intrusive_ptr<QuicStream> stream_;
+};
+
+} // namespace
+
+QuicDuplexConnection::QuicDuplexConnection(
+    std::shared_ptr<quic::QuicSocket> socket,
+    quic::StreamId streamId,
+    std::shared_ptr<RSocketStats> stats)
+    : stream_(new QuicStream(std::move(socket), streamId, stats)),
+      framed_(std::make_unique<FramedDuplexConnection>(
+          std::make_unique<QuicStreamConnection>(stream_),
+          ProtocolVersion::Latest)),
+      stats_(std::move(stats)) {
+  if (stats_) {
+    stats_->duplexConnectionCreated("quic", this);
+  }
+}
+
+QuicDuplexConnection::~QuicDuplexConnection() {
+  if (stats_) {
+    stats_->duplexConnectionClosed("quic", this);
+  }
+  stream_->close();
+}
+
+void QuicDuplexConnection::send(std::unique_ptr<folly::IOBuf> buf) {
+  framed_->send(std::move(buf));
+}
+
+void QuicDuplexConnection::sendBatch(
+    std::vector<std::unique_ptr<folly::IOBuf>> bufs) {
+  framed_->sendBatch(std::move(bufs));
+}
+
+void QuicDuplexConnection::setInput(
+    std::shared_ptr<DuplexConnection::Subscriber> inputSubscriber) {
+  framed_->setInput(std::move(inputSubscriber));
+}
+
+size_t QuicDuplexConnection::bufferedInputBytes() const {
+  return framed_->bufferedInputBytes();
+}
+
+quic::QuicSocket& QuicDuplexConnection::socket() const {
+  return stream_->socket();
+}
+
+} // namespace rsocket
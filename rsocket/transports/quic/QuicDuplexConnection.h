@@ -0,0 +1,68 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <boost/smart_ptr/intrusive_ptr.hpp>
+#include <quic/api/QuicSocket.h>
+
+#include "rsocket/DuplexConnection.h"
+#include "rsocket/RSocketStats.h"
+
+namespace rsocket {
+
+class FramedDuplexConnection;
+class QuicStream;
+
+/// A DuplexConnection over one bidirectional stream of a QUIC connection.
+///
+/// Frames go over the stream with the frame length field of RSocket 1.0 which
+/// this connection adds and strips itself, so it is framed as it is.  Losing
+/// a packet only holds up that stream, not the QUIC connection.
+///
+/// The connection owns the QUIC connection, and closes it when destroyed.
+/// Must be used and destroyed on the thread of the EventBase of the QUIC
+/// connection.
+class QuicDuplexConnection : public DuplexConnection {
+ public:
+  /// `streamId` must be a bidirectional stream of `socket`.  Takes over the
+  /// connection callback of the socket.
+  QuicDuplexConnection(
+      std::shared_ptr<quic::QuicSocket> socket,
+      quic::StreamId streamId,
+      std::shared_ptr<RSocketStats> stats = RSocketStats::noop());
+  ~QuicDuplexConnection();
+
+  void send(std::unique_ptr<folly::IOBuf>) override;
+
+  void sendBatch(std::vector<std::unique_ptr<folly::IOBuf>>) override;
+
+  void setInput(std::shared_ptr<DuplexConnection::Subscriber>) override;
+
+  size_t bufferedInputBytes() const override;
+
+  bool isFramed() const override {
+    return true;
+  }
+
+  /// The QUIC connection, e.g. to migrate it to another network.
+  quic::QuicSocket& socket() const;
+
+ private:
+  boost::intrusive_ptr<QuicStream> stream_;
+  std::unique_ptr<FramedDuplexConnection> framed_;
+  std::shared_ptr<RSocketStats> stats_;
+};
+
+} // namespace rsocket
@@ -0,0 +1,146 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/shm/ShmConnectionAcceptor.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <folly/futures/Future.h>
+
+#include "rsocket/transports/shm/ShmDuplexConnection.h"
+#include "rsocket/transports/shm/ShmHandshake.h"
+
+namespace rsocket {
+
+class ShmConnectionAcceptor::SocketCallback
+    : public folly::AsyncServerSocket::AcceptCallback {
+ public:
+  SocketCallback(OnDuplexConnectionAccept& onAccept, size_t ringCapacity)
+      : thread_{"rsshm-acceptor"},
+        onAccept_{onAccept},
+        ringCapacity_{ringCapacity} {}
+
+  void connectionAccepted(
+      folly::NetworkSocket fdNetworkSocket,
+      const folly::SocketAddress&) noexcept override {
+    int fd = fdNetworkSocket.toFd();
+
+    VLOG(2) << "Accepting shared memory connection on FD " << fd;
+
+    std::unique_ptr<ShmDuplexConnection> connection;
+    try {
+      auto files = acceptShmConnection(
+          folly::File(fd, /* ownsFd */ true), ringCapacity_);
+      connection = std::make_unique<ShmDuplexConnection>(
+          std::move(files), *eventBase());
+    } catch (const std::exception& exn) {
+      VLOG(2) << "Cannot set up shared memory connection: " << exn.what();
+      return;
+    }
+    onAccept_(std::move(connection), *eventBase());
+  }
+
+  void acceptError(const std::exception& ex) noexcept override {
+    VLOG(2) << "Unix socket error: " << ex.what();
+  }
+
+  folly::EventBase* eventBase() const {
+    return thread_.getEventBase();
+  }
+
+ private:
+  /// The thread running this callback.
+  folly::ScopedEventBaseThread thread_;
+
+  /// Reference to the ConnectionAcceptor's callback.
+  OnDuplexConnectionAccept& onAccept_;
+
+  const size_t ringCapacity_;
+};
+
+ShmConnectionAcceptor::ShmConnectionAcceptor(Options options)
+    : options_(std::move(options)) {}
+
+ShmConnectionAcceptor::~ShmConnectionAcceptor() {
+  if (onAccept_) {
+    stop();
+    serverThread_.reset();
+  }
+}
+
+void ShmConnectionAcceptor::start(OnDuplexConnectionAccept onAccept) {
+  if (onAccept_ != nullptr) {
+    throw std::runtime_error("ShmConnectionAcceptor::start() already called");
+  }
+
+  onAccept_ = std::move(onAccept);
+
+  callbacks_.reserve(options_.threads);
+  for (size_t i = 0; i < options_.threads; ++i) {
+    callbacks_.push_back(
+        std::make_unique<SocketCallback>(onAccept_, options_.ringCapacity));
+  }
+
+  VLOG(1) << "Starting shared memory listener on " << options_.path
+          << " with " << options_.threads << " request threads";
+
+  // Binding fails on a path that is already taken.  Only a socket is safe to
+  // remove, some other file at the path is more likely a mistake.
+  struct stat st;
+  if (::lstat(options_.path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+    ::unlink(options_.path.c_str());
+  }
+
+  serverThread_ =
+      std::make_unique<folly::ScopedEventBaseThread>("rsshm-listener");
+  auto const evb = serverThread_->getEventBase();
+  serverSocket_.reset(new folly::AsyncServerSocket(evb));
+
+  // The AsyncServerSocket needs to be accessed from the listener thread only.
+  // This will propagate out any exceptions the listener throws.
+  folly::via(
+      evb,
+      [this] {
+        serverSocket_->bind(folly::SocketAddress::makeFromPath(options_.path));
+
+        for (auto const& callback : callbacks_) {
+          serverSocket_->addAcceptCallback(
+              callback.get(), callback->eventBase());
+        }
+
+        serverSocket_->listen(options_.backlog);
+        serverSocket_->startAccepting();
+
+        VLOG(1) << "Listening on " << options_.path;
+      })
+      .get();
+}
+
+void ShmConnectionAcceptor::stop() {
+  if (!serverSocket_) {
+    return;
+  }
+  VLOG(1) << "Shutting down shared memory listener";
+
+  serverSocket_->getEventBase()->runInEventBaseThreadAndWait(
+      [serverSocket = std::move(serverSocket_)]() {});
+  ::unlink(options_.path.c_str());
+}
+
+folly::Optional<uint16_t> ShmConnectionAcceptor::listeningPort() const {
+  return folly::none;
+}
+
+} // namespace rsocket
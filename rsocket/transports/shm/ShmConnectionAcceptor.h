@@ -0,0 +1,94 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/io/async/AsyncServerSocket.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+
+#include <string>
+
+#include "rsocket/ConnectionAcceptor.h"
+
+namespace rsocket {
+
+/**
+ * Shared memory implementation of ConnectionAcceptor for use with
+ * RSocket::createServer
+ *
+ * Listens on a Unix socket.  Every connection accepted on it is set up over
+ * shared memory, see ShmDuplexConnection and ShmHandshake.  Only processes on
+ * the same host can connect.
+ *
+ * Construction of this does nothing.  The `start` method kicks off work.
+ */
+class ShmConnectionAcceptor : public ConnectionAcceptor {
+ public:
+  struct Options {
+    /// Path of the Unix socket to listen on.  A stale socket left at the path
+    /// by an earlier server is replaced.
+    std::string path;
+
+    /// Number of worker threads processing requests.
+    size_t threads{2};
+
+    /// Number of connections to buffer before accept handlers process them.
+    int backlog{10};
+
+    /// Capacity of each of the two rings of a connection.  Must be a power of
+    /// two.
+    size_t ringCapacity{1 << 20};
+  };
+
+  explicit ShmConnectionAcceptor(Options);
+  ~ShmConnectionAcceptor();
+
+  // ConnectionAcceptor overrides.
+
+  /**
+   * Bind an AsyncServerSocket to the path and start accepting connections.
+   */
+  void start(OnDuplexConnectionAccept) override;
+
+  /**
+   * Shutdown the AsyncServerSocket and associated listener thread, and remove
+   * the socket from the path.
+   */
+  void stop() override;
+
+  /**
+   * Unix sockets don't have a port.  Always none.
+   */
+  folly::Optional<uint16_t> listeningPort() const override;
+
+ private:
+  class SocketCallback;
+
+  /// Options this acceptor has been configured with.
+  const Options options_;
+
+  /// The thread driving the AsyncServerSocket.
+  std::unique_ptr<folly::ScopedEventBaseThread> serverThread_;
+
+  /// Function to run when a connection is accepted.
+  OnDuplexConnectionAccept onAccept_;
+
+  /// The callbacks handling accepted connections.  Each has its own worker
+  /// thread.
+  std::vector<std::unique_ptr<SocketCallback>> callbacks_;
+
+  folly::AsyncServerSocket::UniquePtr serverSocket_;
+};
+
+} // namespace rsocket
@@ -0,0 +1,135 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/shm/ShmConnectionFactory.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include <folly/File.h>
+#include <folly/io/async/EventHandler.h>
+#include <glog/logging.h>
+
+#include "rsocket/transports/shm/ShmDuplexConnection.h"
+#include "rsocket/transports/shm/ShmHandshake.h"
+
+namespace rsocket {
+
+namespace {
+
+/// Waits for the server to send the shared memory of the connection.
+class HandshakeCallback : public folly::EventHandler {
+ public:
+  HandshakeCallback(
+      folly::EventBase& eventBase,
+      std::string path,
+      folly::Promise<ConnectionFactory::ConnectedDuplexConnection>
+          connectPromise)
+      : eventBase_(eventBase),
+        path_(std::move(path)),
+        connectPromise_(std::move(connectPromise)) {}
+
+  /// Deletes itself once the handshake is done.
+  void start() {
+    VLOG(3) << "Attempting connection to " << path_;
+
+    try {
+      sockaddr_un address{};
+      address.sun_family = AF_UNIX;
+      if (path_.size() >= sizeof(address.sun_path)) {
+        throw std::invalid_argument("Unix socket path is too long: " + path_);
+      }
+      std::memcpy(address.sun_path, path_.data(), path_.size());
+
+      auto const fd =
+          ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+      if (fd < 0) {
+        throw std::system_error(errno, std::system_category(), "socket");
+      }
+      control_ = folly::File(fd, /* ownsFd */ true);
+
+      // Connecting a Unix socket completes right away, or fails when the
+      // backlog of the server is full.
+      if (::connect(
+              control_.fd(),
+              reinterpret_cast<sockaddr*>(&address),
+              sizeof(address)) != 0) {
+        throw std::system_error(errno, std::system_category(), "connect");
+      }
+    } catch (const std::exception& exn) {
+      fail(folly::exception_wrapper{std::current_exception(), exn});
+      return;
+    }
+
+    initHandler(&eventBase_, folly::NetworkSocket::fromFd(control_.fd()));
+    registerHandler(folly::EventHandler::READ);
+  }
+
+  void handlerReady(uint16_t) noexcept override {
+    std::unique_ptr<HandshakeCallback> deleter(this);
+    try {
+      auto files = receiveShmConnection(std::move(control_));
+      auto connection =
+          std::make_unique<ShmDuplexConnection>(std::move(files), eventBase_);
+      VLOG(4) << "connectSuccess() on " << path_;
+      connectPromise_.setValue(ConnectionFactory::ConnectedDuplexConnection{
+          std::move(connection), eventBase_});
+    } catch (const std::exception& exn) {
+      VLOG(4) << "connectErr(" << exn.what() << ") on " << path_;
+      connectPromise_.setException(
+          folly::exception_wrapper{std::current_exception(), exn});
+    }
+  }
+
+ private:
+  void fail(folly::exception_wrapper ew) {
+    std::unique_ptr<HandshakeCallback> deleter(this);
+    VLOG(4) << "connectErr(" << ew.what() << ") on " << path_;
+    connectPromise_.setException(std::move(ew));
+  }
+
+  folly::EventBase& eventBase_;
+  const std::string path_;
+  folly::Promise<ConnectionFactory::ConnectedDuplexConnection> connectPromise_;
+  folly::File control_;
+};
+
+} // namespace
+
+ShmConnectionFactory::ShmConnectionFactory(
+    folly::EventBase& eventBase,
+    std::string path)
+    : eventBase_(&eventBase), path_(std::move(path)) {}
+
+ShmConnectionFactory::~ShmConnectionFactory() = default;
+
+folly::Future<ConnectionFactory::ConnectedDuplexConnection>
+ShmConnectionFactory::connect(ProtocolVersion, ResumeStatus /* unused */) {
+  folly::Promise<ConnectionFactory::ConnectedDuplexConnection> connectPromise;
+  auto connectFuture = connectPromise.getFuture();
+
+  eventBase_->runInEventBaseThread(
+      [this, promise = std::move(connectPromise)]() mutable {
+        (new HandshakeCallback(*eventBase_, path_, std::move(promise)))
+            ->start();
+      });
+  return connectFuture;
+}
+
+} // namespace rsocket
@@ -0,0 +1,51 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <string>
+
+#include "rsocket/ConnectionFactory.h"
+
+namespace rsocket {
+
+/**
+ * Shared memory implementation of ConnectionFactory for use with
+ * RSocket::createClient().
+ *
+ * Connects to the Unix socket of a ShmConnectionAcceptor on the same host,
+ * and receives the shared memory of the connection over it.
+ *
+ * Creation of this does nothing.  The `connect` method kicks off work.
+ */
+class ShmConnectionFactory : public ConnectionFactory {
+ public:
+  ShmConnectionFactory(folly::EventBase& eventBase, std::string path);
+  ~ShmConnectionFactory() override;
+
+  /**
+   * Connect to server defined in constructor.
+   *
+   * Each call to connect() creates a new Unix socket and shared memory.
+   */
+  folly::Future<ConnectedDuplexConnection> connect(
+      ProtocolVersion,
+      ResumeStatus resume) override;
+
+ private:
+  folly::EventBase* eventBase_;
+  const std::string path_;
+};
+
+} // namespace rsocket
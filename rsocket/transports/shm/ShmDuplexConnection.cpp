@@ -0,0 +1,443 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/shm/ShmDuplexConnection.h"
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+
+#include <folly/io/IOBufQueue.h>
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/EventHandler.h>
+
+#include "rsocket/transports/shm/ShmRing.h"
+#include "yarpl/flowable/Subscription.h"
+
+namespace rsocket {
+
+using namespace yarpl::flowable;
+
+/// The state of a ShmDuplexConnection.  The EventHandlers hold a reference to
+/// it while they run, and closing holds one until the frames accepted by
+/// send() are all in the ring.
+class ShmSocket : public folly::EventBase::LoopCallback {
+  friend void intrusive_ptr_add_ref(ShmSocket* x);
+  friend void intrusive_ptr_release(ShmSocket* x);
+
+ public:
+  ShmSocket(
+      ShmDuplexConnection::Files files,
+      folly::EventBase& eventBase,
+      std::shared_ptr<RSocketStats> stats)
+      : files_(std::move(files)),
+        eventBase_(eventBase),
+        stats_(std::move(stats)),
+        wakeHandler_(*this, &ShmSocket::onWake),
+        controlHandler_(*this, &ShmSocket::onControl) {
+    struct stat st;
+    if (::fstat(files_.memory.fd(), &st) != 0) {
+      throw std::system_error(errno, std::system_category(), "fstat");
+    }
+    mappingSize_ = static_cast<size_t>(st.st_size);
+    mapping_ = ::mmap(
+        nullptr,
+        mappingSize_,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED,
+        files_.memory.fd(),
+        0);
+    if (mapping_ == MAP_FAILED) {
+      throw std::system_error(errno, std::system_category(), "mmap");
+    }
+
+    // The first ring carries the frames of the client, the second ring those
+    // of the server.
+    ShmRing first, second;
+    auto const base = static_cast<uint8_t*>(mapping_);
+    bool const valid = first.attach(base, mappingSize_) &&
+        second.attach(
+            base + ShmRing::regionSize(first.capacity()),
+            mappingSize_ - ShmRing::regionSize(first.capacity()));
+    if (!valid) {
+      ::munmap(mapping_, mappingSize_);
+      throw std::runtime_error("Shared memory doesn't hold two valid rings");
+    }
+    input_ = files_.isServer ? first : second;
+    output_ = files_.isServer ? second : first;
+
+    wakeHandler_.initHandler(
+        &eventBase_, folly::NetworkSocket::fromFd(files_.wake.fd()));
+    wakeHandler_.registerHandler(
+        folly::EventHandler::READ | folly::EventHandler::PERSIST);
+    controlHandler_.initHandler(
+        &eventBase_, folly::NetworkSocket::fromFd(files_.control.fd()));
+    controlHandler_.registerHandler(
+        folly::EventHandler::READ | folly::EventHandler::PERSIST);
+  }
+
+  ~ShmSocket() override {
+    DCHECK(state_ == State::CLOSED);
+    DCHECK(!inputSubscriber_);
+    ::munmap(mapping_, mappingSize_);
+  }
+
+  void setInput(std::shared_ptr<DuplexConnection::Subscriber> inputSubscriber) {
+    if (inputSubscriber && state_ != State::OPEN) {
+      inputSubscriber->onComplete();
+      return;
+    }
+
+    if (!inputSubscriber) {
+      inputSubscriber_ = nullptr;
+      return;
+    }
+
+    CHECK(!inputSubscriber_);
+    inputSubscriber_ = std::move(inputSubscriber);
+
+    // Frames stay in the ring while there is no subscriber, which holds the
+    // other end back once the ring fills up.
+    boost::intrusive_ptr<ShmSocket> self(this);
+    readFrames();
+  }
+
+  void send(std::unique_ptr<folly::IOBuf> frame) {
+    if (state_ != State::OPEN) {
+      return;
+    }
+
+    if (stats_) {
+      stats_->bytesWritten(frame->computeChainDataLength());
+    }
+    pendingWrites_.push_back(std::move(frame));
+
+    if (!isLoopCallbackScheduled()) {
+      // The EventBase will hold a reference to this instance until it calls
+      // runLoopCallback.
+      intrusive_ptr_add_ref(this);
+      eventBase_.runInLoop(this, /* thisIteration */ true);
+    }
+  }
+
+  /// Completes the input.  Frames which were already accepted by send() still
+  /// go into the ring, unless the other end goes away first.
+  void close() {
+    if (state_ != State::OPEN) {
+      return;
+    }
+    state_ = State::CLOSING;
+    if (pendingWrites_.empty()) {
+      shutdown();
+    } else {
+      // Released by shutdown(), once the writes are done.
+      intrusive_ptr_add_ref(this);
+      flushing_ = true;
+    }
+    if (auto subscriber = std::move(inputSubscriber_)) {
+      subscriber->onComplete();
+    }
+  }
+
+  void closeWithError(folly::exception_wrapper ew) {
+    if (state_ == State::CLOSED) {
+      return;
+    }
+    pendingWrites_.clear();
+    writing_ = nullptr;
+    auto subscriber = std::move(inputSubscriber_);
+    shutdown();
+    if (subscriber) {
+      subscriber->onError(std::move(ew));
+    }
+  }
+
+ private:
+  enum class State { OPEN, CLOSING, CLOSED };
+
+  /// Forwards the readiness of a file descriptor to a member function.
+  class Handler : public folly::EventHandler {
+   public:
+    Handler(ShmSocket& socket, void (ShmSocket::*fn)())
+        : socket_(socket), fn_(fn) {}
+
+    void handlerReady(uint16_t) noexcept override {
+      boost::intrusive_ptr<ShmSocket> self(&socket_);
+      (socket_.*fn_)();
+    }
+
+   private:
+    ShmSocket& socket_;
+    void (ShmSocket::*fn_)();
+  };
+
+  void runLoopCallback() noexcept override {
+    boost::intrusive_ptr<ShmSocket> self(this, /* add_ref */ false);
+    writeFrames();
+  }
+
+  /// The other end wrote into an empty ring, or read from a full one.
+  void onWake() {
+    uint64_t count;
+    while (::read(files_.wake.fd(), &count, sizeof(count)) > 0) {
+    }
+    writeFrames();
+    readFrames();
+  }
+
+  /// The other end closed the connection, or went away.  It only ever closes
+  /// after all of its frames are in the ring.
+  void onControl() {
+    char byte;
+    auto const result = ::recv(files_.control.fd(), &byte, 1, MSG_DONTWAIT);
+    if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return;
+    }
+
+    readFrames();
+    pendingWrites_.clear();
+    writing_ = nullptr;
+    if (state_ == State::CLOSING) {
+      shutdown();
+    } else {
+      close();
+    }
+  }
+
+  void wakePeer() {
+    uint64_t const one = 1;
+    if (::write(files_.peerWake.fd(), &one, sizeof(one)) < 0 &&
+        errno != EAGAIN) {
+      VLOG(2) << "Cannot wake the other end: " << std::strerror(errno);
+    }
+  }
+
+  /// Copies as many of the pending frames as fit into the output ring.
+  void writeFrames() {
+    if (state_ == State::CLOSED) {
+      return;
+    }
+
+    bool wrote = false;
+    while (!pendingWrites_.empty()) {
+      if (writeFrontFrame(wrote)) {
+        pendingWrites_.pop_front();
+      } else if (!output_.prepareToWaitForSpace()) {
+        // The other end made room in the meantime.
+        continue;
+      } else {
+        break;
+      }
+    }
+
+    if (wrote && output_.shouldWakeReader()) {
+      wakePeer();
+    }
+    if (pendingWrites_.empty() && state_ == State::CLOSING) {
+      shutdown();
+    }
+  }
+
+  /// Writes the rest of the first pending frame.  Returns false if the ring
+  /// filled up before all of it could be written.
+  bool writeFrontFrame(bool& wrote) {
+    auto const frame = pendingWrites_.front().get();
+    if (!writing_) {
+      writing_ = frame;
+      writingOffset_ = 0;
+    }
+
+    while (true) {
+      bool const last = writing_->next() == frame;
+      folly::ByteRange range(
+          writing_->data() + writingOffset_,
+          writing_->length() - writingOffset_);
+
+      // An empty last buffer still ends the frame with an empty record.
+      if (!range.empty() || last) {
+        auto const size = range.size();
+        if (!output_.write(range, last)) {
+          return false;
+        }
+        wrote = true;
+        writingOffset_ += size - range.size();
+        if (!range.empty()) {
+          continue;
+        }
+      }
+
+      if (last) {
+        writing_ = nullptr;
+        return true;
+      }
+      writing_ = writing_->next();
+      writingOffset_ = 0;
+    }
+  }
+
+  /// Hands the frames in the input ring to the subscriber.
+  void readFrames() {
+    while (inputSubscriber_ && state_ == State::OPEN) {
+      bool const valid = input_.read([this](folly::ByteRange data, bool end) {
+        if (stats_) {
+          stats_->bytesRead(data.size());
+        }
+        if (!end) {
+          partialFrame_.append(folly::IOBuf::copyBuffer(data));
+          return true;
+        }
+
+        std::unique_ptr<folly::IOBuf> frame;
+        if (partialFrame_.empty()) {
+          frame = folly::IOBuf::copyBuffer(data);
+        } else {
+          partialFrame_.append(folly::IOBuf::copyBuffer(data));
+          frame = partialFrame_.move();
+        }
+        inputSubscriber_->onNext(std::move(frame));
+        return inputSubscriber_ && state_ == State::OPEN;
+      });
+
+      if (!valid) {
+        closeWithError(
+            std::runtime_error("Malformed record in the shared memory ring"));
+        return;
+      }
+      if (input_.shouldWakeWriter()) {
+        wakePeer();
+      }
+      if (!inputSubscriber_ || state_ != State::OPEN ||
+          input_.prepareToWaitForData()) {
+        return;
+      }
+    }
+  }
+
+  void shutdown() {
+    state_ = State::CLOSED;
+    wakeHandler_.unregisterHandler();
+    controlHandler_.unregisterHandler();
+    ::shutdown(files_.control.fd(), SHUT_RDWR);
+    if (std::exchange(flushing_, false)) {
+      intrusive_ptr_release(this);
+    }
+  }
+
+  const ShmDuplexConnection::Files files_;
+  folly::EventBase& eventBase_;
+  const std::shared_ptr<RSocketStats> stats_;
+
+  State state_{State::OPEN};
+
+  void* mapping_{nullptr};
+  size_t mappingSize_{0};
+  ShmRing input_;
+  ShmRing output_;
+
+  Handler wakeHandler_;
+  Handler controlHandler_;
+
+  /// Frames waiting for room in the output ring.
+  std::deque<std::unique_ptr<folly::IOBuf>> pendingWrites_;
+
+  /// Where writing of the first pending frame stopped when the ring was full.
+  folly::IOBuf* writing_{nullptr};
+  size_t writingOffset_{0};
+
+  /// Whether close() is waiting for the pending frames to be written.
+  bool flushing_{false};
+
+  /// The records received so far of a frame split over several of them.
+  folly::IOBufQueue partialFrame_{folly::IOBufQueue::cacheChainLength()};
+
+  std::shared_ptr<DuplexConnection::Subscriber> inputSubscriber_;
+  int refCount_{0};
+};
+
+void intrusive_ptr_add_ref(ShmSocket* x);
+void intrusive_ptr_release(ShmSocket* x);
+
+inline void intrusive_ptr_add_ref(ShmSocket* x) {
+  ++x->refCount_;
+}
+
+inline void intrusive_ptr_release(ShmSocket* x) {
+  if (--x->refCount_ == 0)
+    delete x;
+}
+
+namespace {
+
+class ShmInputSubscription : public Subscription {
+ public:
+  explicit ShmInputSubscription(boost::intrusive_ptr<ShmSocket> socket)
+      : socket_(std::move(socket)) {
+    CHECK(socket_);
+  }
+
+  void request(int64_t n) noexcept override {
+    DCHECK(socket_);
+    DCHECK_EQ(n, std::numeric_limits<int64_t>::max())
+        << "ShmDuplexConnection doesnt support proper flow control";
+  }
+
+  void cancel() noexcept override {
+    socket_->setInput(nullptr);
+    socket_ = nullptr;
+  }
+
+ private:
+  boost::intrusive_ptr<ShmSocket> socket_;
+};
+
+} // namespace
+
+ShmDuplexConnection::ShmDuplexConnection(
+    Files files,
+    folly::EventBase& eventBase,
+    std::shared_ptr<RSocketStats> stats)
+    : socket_(new ShmSocket(std::move(files), eventBase, stats)),
+      stats_(std::move(stats)) {
+  if (stats_) {
+    stats_->duplexConnectionCreated("shm", this);
+  }
+}
+
+ShmDuplexConnection::~ShmDuplexConnection() {
+  if (stats_) {
+    stats_->duplexConnectionClosed("shm", this);
+  }
+  socket_->close();
+}
+
+void ShmDuplexConnection::send(std::unique_ptr<folly::IOBuf> buf) {
+  socket_->send(std::move(buf));
+}
+
+void ShmDuplexConnection::setInput(
+    std::shared_ptr<DuplexConnection::Subscriber> inputSubscriber) {
+  inputSubscriber->onSubscribe(
+      std::make_shared<ShmInputSubscription>(socket_));
+  socket_->setInput(std::move(inputSubscriber));
+}
+
+} // namespace rsocket
@@ -0,0 +1,82 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <boost/smart_ptr/intrusive_ptr.hpp>
+#include <folly/File.h>
+
+#include "rsocket/DuplexConnection.h"
+#include "rsocket/RSocketStats.h"
+
+namespace folly {
+class EventBase;
+}
+
+namespace rsocket {
+
+class ShmSocket;
+
+/// One end of a connection between two processes on the same host, over two
+/// rings in shared memory.  See ShmRing.
+///
+/// Each end copies the frames it sends into one ring and the frames it
+/// receives out of the other.  An eventfd per end wakes it up when the other
+/// end has written frames into an empty ring, or freed space in a full one.
+/// The Unix socket the connection was set up over stays open to tell either
+/// end when the other one goes away.
+///
+/// Frame boundaries are preserved, so no FramedDuplexConnection is needed.
+class ShmDuplexConnection : public DuplexConnection {
+ public:
+  /// The resources of one end of a connection, as set up by ShmHandshake.
+  struct Files {
+    /// The shared memory holding both rings.
+    folly::File memory;
+
+    /// The eventfd this end sleeps on.
+    folly::File wake;
+
+    /// The eventfd the other end sleeps on.
+    folly::File peerWake;
+
+    /// The Unix socket connected to the other end.
+    folly::File control;
+
+    /// The server end sends into the second ring, the client into the first.
+    bool isServer{false};
+  };
+
+  /// Must be created on the thread of the EventBase.  Throws if the shared
+  /// memory doesn't hold two valid rings.
+  ShmDuplexConnection(
+      Files files,
+      folly::EventBase& eventBase,
+      std::shared_ptr<RSocketStats> stats = RSocketStats::noop());
+  ~ShmDuplexConnection();
+
+  void send(std::unique_ptr<folly::IOBuf>) override;
+
+  void setInput(std::shared_ptr<DuplexConnection::Subscriber>) override;
+
+  bool isFramed() const override {
+    return true;
+  }
+
+ private:
+  boost::intrusive_ptr<ShmSocket> socket_;
+  std::shared_ptr<RSocketStats> stats_;
+};
+
+} // namespace rsocket
@@ -0,0 +1,178 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/shm/ShmHandshake.h"
+
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "rsocket/transports/shm/ShmRing.h"
+
+namespace rsocket {
+
+namespace {
+
+constexpr uint32_t kHandshakeMagic{0x5253484d}; // "RSHM"
+constexpr uint32_t kHandshakeVersion{1};
+constexpr size_t kHandshakeFiles{3};
+
+struct HandshakeMessage {
+  uint32_t magic;
+  uint32_t version;
+};
+
+[[noreturn]] void throwSystemError(const char* what) {
+  throw std::system_error(errno, std::system_category(), what);
+}
+
+folly::File makeEventFd() {
+  auto const fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (fd < 0) {
+    throwSystemError("eventfd");
+  }
+  return folly::File(fd, /* ownsFd */ true);
+}
+
+} // namespace
+
+ShmDuplexConnection::Files acceptShmConnection(
+    folly::File control,
+    size_t ringCapacity) {
+  auto const ringSize = ShmRing::regionSize(ringCapacity);
+  auto const size = 2 * ringSize;
+
+  auto const memoryFd = ::memfd_create("rsocket-shm", MFD_CLOEXEC);
+  if (memoryFd < 0) {
+    throwSystemError("memfd_create");
+  }
+  folly::File memory(memoryFd, /* ownsFd */ true);
+  if (::ftruncate(memory.fd(), size) != 0) {
+    throwSystemError("ftruncate");
+  }
+
+  auto const mapping = ::mmap(
+      nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, memory.fd(), 0);
+  if (mapping == MAP_FAILED) {
+    throwSystemError("mmap");
+  }
+  ShmRing::initialize(mapping, ringCapacity);
+  ShmRing::initialize(static_cast<uint8_t*>(mapping) + ringSize, ringCapacity);
+  ::munmap(mapping, size);
+
+  auto serverWake = makeEventFd();
+  auto clientWake = makeEventFd();
+
+  HandshakeMessage payload{kHandshakeMagic, kHandshakeVersion};
+  struct iovec iov {
+    &payload, sizeof(payload)
+  };
+
+  std::array<int, kHandshakeFiles> const fds{
+      {memory.fd(), clientWake.fd(), serverWake.fd()}};
+  alignas(struct cmsghdr) char buffer[CMSG_SPACE(sizeof(fds))] = {};
+
+  struct msghdr message {};
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = buffer;
+  message.msg_controllen = sizeof(buffer);
+
+  auto cmsg = CMSG_FIRSTHDR(&message);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+  std::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(fds));
+
+  // The message is tiny and the socket fresh, it always fits its buffer.
+  if (::sendmsg(control.fd(), &message, MSG_NOSIGNAL) !=
+      static_cast<ssize_t>(sizeof(payload))) {
+    throwSystemError("sendmsg");
+  }
+
+  ShmDuplexConnection::Files files;
+  files.memory = std::move(memory);
+  files.wake = std::move(serverWake);
+  files.peerWake = std::move(clientWake);
+  files.control = std::move(control);
+  files.isServer = true;
+  return files;
+}
+
+ShmDuplexConnection::Files receiveShmConnection(folly::File control) {
+  HandshakeMessage payload{};
+  struct iovec iov {
+    &payload, sizeof(payload)
+  };
+
+  alignas(struct cmsghdr) char
+      buffer[CMSG_SPACE(kHandshakeFiles * sizeof(int))] = {};
+
+  struct msghdr message {};
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = buffer;
+  message.msg_controllen = sizeof(buffer);
+
+  auto const received = ::recvmsg(control.fd(), &message, MSG_CMSG_CLOEXEC);
+  if (received < 0) {
+    throwSystemError("recvmsg");
+  }
+
+  // Take ownership of whatever was passed before looking at it, so nothing
+  // leaks when the message turns out to be bad.
+  std::vector<folly::File> files;
+  for (auto cmsg = CMSG_FIRSTHDR(&message); cmsg;
+       cmsg = CMSG_NXTHDR(&message, cmsg)) {
+    if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+      continue;
+    }
+    auto const count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    for (size_t i = 0; i < count; ++i) {
+      int fd;
+      std::memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(fd));
+      files.emplace_back(fd, /* ownsFd */ true);
+    }
+  }
+
+  if (received != static_cast<ssize_t>(sizeof(payload)) ||
+      (message.msg_flags & MSG_CTRUNC) || files.size() != kHandshakeFiles ||
+      payload.magic != kHandshakeMagic) {
+    throw std::runtime_error("Malformed shared memory handshake");
+  }
+  if (payload.version != kHandshakeVersion) {
+    throw std::runtime_error(
+        "Unsupported shared memory handshake version " +
+        std::to_string(payload.version));
+  }
+
+  ShmDuplexConnection::Files result;
+  result.memory = std::move(files[0]);
+  result.wake = std::move(files[1]);
+  result.peerWake = std::move(files[2]);
+  result.control = std::move(control);
+  result.isServer = false;
+  return result;
+}
+
+} // namespace rsocket
@@ -0,0 +1,40 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "rsocket/transports/shm/ShmDuplexConnection.h"
+
+namespace rsocket {
+
+/// Sets up a connection over a Unix socket that was just accepted.
+///
+/// The server creates the shared memory with both rings and the eventfds of
+/// the two ends, and passes the ones of the client over the socket with
+/// SCM_RIGHTS, along with a version tag.  After that the socket only signals
+/// when either end goes away.
+
+/// Creates the connection on the server end, with rings of `ringCapacity`
+/// bytes, and sends the files of the client end over `control`.  Returns the
+/// files of the server end.  Throws std::system_error on failure.
+ShmDuplexConnection::Files acceptShmConnection(
+    folly::File control,
+    size_t ringCapacity);
+
+/// Receives the files of the client end from the server over `control`,
+/// which must be readable.  Throws std::system_error on failure, and
+/// std::runtime_error if the server speaks another version.
+ShmDuplexConnection::Files receiveShmConnection(folly::File control);
+
+} // namespace rsocket
@@ -0,0 +1,141 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/shm/ShmRing.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <new>
+
+namespace rsocket {
+
+namespace {
+
+constexpr size_t kHeaderRegionSize{(sizeof(ShmRing::Header) + 63) & ~63};
+
+} // namespace
+
+size_t ShmRing::regionSize(size_t capacity) {
+  return kHeaderRegionSize + ((capacity + 63) & ~size_t{63});
+}
+
+void ShmRing::initialize(void* region, size_t capacity) {
+  CHECK_GE(capacity, 64);
+  CHECK_EQ(capacity & (capacity - 1), 0)
+      << "The capacity of a ring must be a power of two";
+
+  auto header = new (region) Header();
+  header->head.store(0);
+  header->tail.store(0);
+  header->readerWaiting.store(0);
+  header->writerWaiting.store(0);
+  header->capacity = capacity;
+  header->magic = kMagic;
+}
+
+bool ShmRing::attach(void* region, size_t size) {
+  if (size < kHeaderRegionSize) {
+    return false;
+  }
+  auto header = static_cast<Header*>(region);
+  auto const capacity = header->capacity;
+  if (header->magic != kMagic || capacity < 64 ||
+      (capacity & (capacity - 1)) != 0 || regionSize(capacity) > size) {
+    return false;
+  }
+
+  header_ = header;
+  data_ = static_cast<uint8_t*>(region) + kHeaderRegionSize;
+  capacity_ = capacity;
+  return true;
+}
+
+bool ShmRing::write(folly::ByteRange& data, bool endOfFrame) {
+  auto head = header_->head.load(std::memory_order_relaxed);
+
+  while (true) {
+    auto const tail = header_->tail.load(std::memory_order_acquire);
+    auto const free = capacity_ - (head - tail);
+    auto const offset = head & (capacity_ - 1);
+    auto const contiguous = capacity_ - offset;
+
+    // A record needs room for its header, plus at least some of the data.
+    auto const minimum = kRecordHeaderSize + (data.empty() ? 0 : 8);
+
+    if (contiguous < minimum && contiguous < free) {
+      // Skip the end of the ring, the record goes to its start.
+      RecordHeader padding{
+          static_cast<uint32_t>(contiguous - kRecordHeaderSize), kPadding};
+      std::memcpy(data_ + offset, &padding, sizeof(padding));
+      head += contiguous;
+      header_->head.store(head, std::memory_order_release);
+      continue;
+    }
+
+    auto const available = std::min(free, contiguous);
+    if (available < minimum) {
+      return false;
+    }
+
+    auto const length = std::min<uint64_t>(
+        data.size(), (available - kRecordHeaderSize) & ~uint64_t{7});
+    RecordHeader record{
+        static_cast<uint32_t>(length),
+        length == data.size() && endOfFrame ? kEndOfFrame : 0};
+    std::memcpy(data_ + offset, &record, sizeof(record));
+    std::memcpy(data_ + offset + kRecordHeaderSize, data.data(), length);
+    data.advance(length);
+
+    head += kRecordHeaderSize + aligned(length);
+    header_->head.store(head, std::memory_order_release);
+    return true;
+  }
+}
+
+bool ShmRing::prepareToWaitForSpace() {
+  header_->writerWaiting.store(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  auto const head = header_->head.load(std::memory_order_relaxed);
+  auto const tail = header_->tail.load(std::memory_order_acquire);
+  if (head - tail < capacity_ / 2) {
+    header_->writerWaiting.store(0, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+bool ShmRing::shouldWakeReader() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  return header_->readerWaiting.load(std::memory_order_relaxed) != 0 &&
+      header_->readerWaiting.exchange(0) != 0;
+}
+
+bool ShmRing::prepareToWaitForData() {
+  header_->readerWaiting.store(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (!empty()) {
+    header_->readerWaiting.store(0, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+bool ShmRing::shouldWakeWriter() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  return header_->writerWaiting.load(std::memory_order_relaxed) != 0 &&
+      header_->writerWaiting.exchange(0) != 0;
+}
+
+} // namespace rsocket
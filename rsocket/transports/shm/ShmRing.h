@@ -0,0 +1,160 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Range.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+namespace rsocket {
+
+/// A single-producer single-consumer ring of records, laid out in memory
+/// that is shared between two processes.
+///
+/// A frame is written as one or more records, each an 8 byte header followed
+/// by the bytes of the record padded to 8 bytes.  Frames larger than the free
+/// space of the ring are split into several records, the last of which is
+/// flagged.  A record never wraps around the end of the ring, a padding
+/// record fills the tail end instead when needed.
+///
+/// Positions only grow, the producer owns the head and the consumer the tail.
+/// The waiting flags let either side sleep on an eventfd without missing a
+/// wakeup: a side sets its flag, re-checks the ring, and only then sleeps.
+/// The other side checks the flag after it has updated its position.
+class ShmRing {
+ public:
+  /// The part of the ring at the start of the shared memory.
+  struct Header {
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+    alignas(64) std::atomic<uint32_t> readerWaiting;
+    std::atomic<uint32_t> writerWaiting;
+    uint32_t magic;
+    uint64_t capacity;
+  };
+
+  static constexpr size_t kRecordHeaderSize{8};
+
+  /// Bytes of shared memory taken by a ring with the given capacity, which
+  /// must be a power of two.  A multiple of 64.
+  static size_t regionSize(size_t capacity);
+
+  /// Sets up a ring in zeroed shared memory of regionSize(capacity) bytes.
+  static void initialize(void* region, size_t capacity);
+
+  /// Attaches to a ring in a region of `size` bytes.  Returns false, leaving
+  /// the ring unusable, if the region doesn't hold a valid ring.
+  bool attach(void* region, size_t size);
+
+  // Producer.
+
+  /// Writes a record holding as much of the front of `data` as fits, and
+  /// advances `data` past it.  The record ends the frame if it takes all of
+  /// `data` and `endOfFrame` is set.  Returns false if there is no room for a
+  /// record, in which case nothing is written.
+  bool write(folly::ByteRange& data, bool endOfFrame);
+
+  /// To be called before sleeping on a full ring.  Returns false if the ring
+  /// drained in the meantime and the write should be retried instead.
+  bool prepareToWaitForSpace();
+
+  /// To be called after writing.  Whether the consumer is asleep and has to
+  /// be woken up.
+  bool shouldWakeReader();
+
+  // Consumer.
+
+  /// Calls `fn(folly::ByteRange, bool endOfFrame)` for each record, releasing
+  /// its space once `fn` returns.  The bytes must be copied out by `fn`, which
+  /// returns whether to go on with the next record.  Returns false if the
+  /// producer wrote a malformed record, in which case the ring must not be
+  /// used anymore.
+  template <typename F>
+  bool read(F&& fn);
+
+  /// To be called before sleeping on an empty ring.  Returns false if data
+  /// arrived in the meantime and the ring should be read instead.
+  bool prepareToWaitForData();
+
+  /// To be called after reading.  Whether the producer is asleep and has to
+  /// be woken up.
+  bool shouldWakeWriter();
+
+  uint64_t capacity() const {
+    return capacity_;
+  }
+
+  bool empty() const {
+    return header_->head.load(std::memory_order_acquire) ==
+        header_->tail.load(std::memory_order_acquire);
+  }
+
+ private:
+  static constexpr uint32_t kMagic{0x52535231}; // "RSR1"
+  static constexpr uint32_t kEndOfFrame{1};
+  static constexpr uint32_t kPadding{2};
+
+  struct RecordHeader {
+    uint32_t length;
+    uint32_t flags;
+  };
+
+  static constexpr uint64_t aligned(uint64_t length) {
+    return (length + 7) & ~uint64_t{7};
+  }
+
+  Header* header_{nullptr};
+  uint8_t* data_{nullptr};
+  uint64_t capacity_{0};
+};
+
+template <typename F>
+bool ShmRing::read(F&& fn) {
+  auto tail = header_->tail.load(std::memory_order_relaxed);
+  auto const head = header_->head.load(std::memory_order_acquire);
+
+  while (tail != head) {
+    auto const offset = tail & (capacity_ - 1);
+    if (head - tail < kRecordHeaderSize) {
+      return false;
+    }
+
+    RecordHeader record;
+    std::memcpy(&record, data_ + offset, sizeof(record));
+    auto const size = kRecordHeaderSize + aligned(record.length);
+    if (size > capacity_ - offset || size > head - tail) {
+      return false;
+    }
+
+    bool more = true;
+    if (!(record.flags & kPadding)) {
+      more =
+          fn(folly::ByteRange(
+                 data_ + offset + kRecordHeaderSize, record.length),
+             (record.flags & kEndOfFrame) != 0);
+    }
+
+    tail += size;
+    header_->tail.store(tail, std::memory_order_release);
+    if (!more) {
+      break;
+    }
+  }
+  return true;
+}
+
+} // namespace rsocket
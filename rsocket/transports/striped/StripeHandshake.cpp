@@ -0,0 +1,173 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/striped/StripeHandshake.h"
+
+#include <folly/Conv.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/async/EventBase.h>
+#include <glog/logging.h>
+
+#include <limits>
+#include <stdexcept>
+
+#include "rsocket/framing/FrameSerializer.h"
+
+namespace rsocket {
+
+namespace {
+
+constexpr uint32_t kStripeHelloMagic = 0x52535452; // "RSTR"
+constexpr size_t kStripeHelloSize = sizeof(uint32_t) + sizeof(uint64_t) +
+    sizeof(uint16_t) + sizeof(uint16_t);
+
+class StripeHandshakeReader
+    : public DuplexConnection::Subscriber,
+      public std::enable_shared_from_this<StripeHandshakeReader> {
+ public:
+  StripeHandshakeReader(
+      std::unique_ptr<DuplexConnection> connection,
+      folly::EventBase& eventBase)
+      : connection_(std::move(connection)), eventBase_(eventBase) {}
+
+  folly::Future<AcceptedStripe> accept() {
+    auto future = promise_.getFuture();
+    connection_->setInput(shared_from_this());
+    return future;
+  }
+
+  folly::Future<AcceptedStripe> connect(StripeHello hello) {
+    expected_ = hello;
+    auto future = promise_.getFuture();
+    connection_->setInput(shared_from_this());
+    if (connection_) {
+      connection_->send(serializeStripeHello(hello));
+    }
+    return future;
+  }
+
+  void onSubscribe(
+      std::shared_ptr<yarpl::flowable::Subscription> subscription) override {
+    subscription_ = std::move(subscription);
+    subscription_->request(std::numeric_limits<int64_t>::max());
+  }
+
+  void onNext(std::unique_ptr<folly::IOBuf> frame) override {
+    // Finishing the handshake drops the reference held by the connection.
+    auto const self = shared_from_this();
+    if (!connection_) {
+      return;
+    }
+
+    auto const hello = parseStripeHello(*frame);
+    if (!hello || hello->index >= hello->count ||
+        (expected_ && !(*hello == *expected_))) {
+      fail("Invalid stripe handshake");
+      return;
+    }
+
+    if (auto subscription = std::move(subscription_)) {
+      subscription->cancel();
+    }
+    promise_.setValue(AcceptedStripe{std::move(connection_), *hello});
+  }
+
+  void onComplete() override {
+    subscription_ = nullptr;
+    fail("Connection closed during the stripe handshake");
+  }
+
+  void onError(folly::exception_wrapper ew) override {
+    subscription_ = nullptr;
+    fail(folly::to<std::string>(
+        "Connection failed during the stripe handshake: ", ew.what()));
+  }
+
+ private:
+  void fail(std::string message) {
+    VLOG(2) << message;
+    if (auto subscription = std::move(subscription_)) {
+      subscription->cancel();
+    }
+    if (auto connection = std::move(connection_)) {
+      // The connection may be calling into this right now, so it has to go
+      // away later.
+      eventBase_.runInLoop([connection = std::move(connection)] {});
+      promise_.setException(std::runtime_error(std::move(message)));
+    }
+  }
+
+  std::unique_ptr<DuplexConnection> connection_;
+  folly::EventBase& eventBase_;
+  folly::Promise<AcceptedStripe> promise_;
+  std::shared_ptr<yarpl::flowable::Subscription> subscription_;
+
+  /// Client side: the hello the server must echo.
+  folly::Optional<StripeHello> expected_;
+};
+
+} // namespace
+
+bool operator==(const StripeHello& a, const StripeHello& b) {
+  return a.groupId == b.groupId && a.index == b.index && a.count == b.count;
+}
+
+std::unique_ptr<folly::IOBuf> serializeStripeHello(const StripeHello& hello) {
+  auto frame =
+      folly::IOBuf::create(kFrameLengthFieldHeadroom + kStripeHelloSize);
+  frame->advance(kFrameLengthFieldHeadroom);
+  folly::io::Appender appender(frame.get(), 0);
+  appender.writeBE<uint32_t>(kStripeHelloMagic);
+  appender.writeBE<uint64_t>(hello.groupId);
+  appender.writeBE<uint16_t>(hello.index);
+  appender.writeBE<uint16_t>(hello.count);
+  return frame;
+}
+
+folly::Optional<StripeHello> parseStripeHello(const folly::IOBuf& frame) {
+  if (frame.computeChainDataLength() != kStripeHelloSize) {
+    return folly::none;
+  }
+  folly::io::Cursor cur(&frame);
+  if (cur.readBE<uint32_t>() != kStripeHelloMagic) {
+    return folly::none;
+  }
+  StripeHello hello;
+  hello.groupId = cur.readBE<uint64_t>();
+  hello.index = cur.readBE<uint16_t>();
+  hello.count = cur.readBE<uint16_t>();
+  return hello;
+}
+
+folly::Future<AcceptedStripe> acceptStripe(
+    std::unique_ptr<DuplexConnection> connection,
+    folly::EventBase& eventBase) {
+  DCHECK(eventBase.isInEventBaseThread());
+  auto reader =
+      std::make_shared<StripeHandshakeReader>(std::move(connection), eventBase);
+  return reader->accept();
+}
+
+folly::Future<std::unique_ptr<DuplexConnection>> connectStripe(
+    std::unique_ptr<DuplexConnection> connection,
+    folly::EventBase& eventBase,
+    StripeHello hello) {
+  DCHECK(eventBase.isInEventBaseThread());
+  auto reader =
+      std::make_shared<StripeHandshakeReader>(std::move(connection), eventBase);
+  return reader->connect(hello).thenValue(
+      [](AcceptedStripe stripe) { return std::move(stripe.connection); });
+}
+
+} // namespace rsocket
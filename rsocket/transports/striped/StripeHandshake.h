@@ -0,0 +1,70 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/futures/Future.h>
+
+#include <memory>
+
+#include "rsocket/DuplexConnection.h"
+
+namespace folly {
+class EventBase;
+}
+
+namespace rsocket {
+
+/// The first frame on every connection of a striped connection, which tells
+/// the server which striped connection it belongs to.
+struct StripeHello {
+  /// Random id shared by the connections of one striped connection.
+  uint64_t groupId{0};
+
+  /// Which stripe the connection is, out of `count`.
+  uint16_t index{0};
+  uint16_t count{0};
+};
+
+bool operator==(const StripeHello&, const StripeHello&);
+
+std::unique_ptr<folly::IOBuf> serializeStripeHello(const StripeHello&);
+
+/// Returns folly::none if the frame isn't a StripeHello.
+folly::Optional<StripeHello> parseStripeHello(const folly::IOBuf&);
+
+/// A connection whose StripeHello was read.
+struct AcceptedStripe {
+  std::unique_ptr<DuplexConnection> connection;
+  StripeHello hello;
+};
+
+/// Server side: reads the hello from `connection`, which must be framed.  The
+/// server echoes the hello back once it has all stripes and listens to their
+/// frames.  Must be called on the thread of `eventBase`, the one of
+/// `connection`.
+folly::Future<AcceptedStripe> acceptStripe(
+    std::unique_ptr<DuplexConnection> connection,
+    folly::EventBase& eventBase);
+
+/// Client side: sends `hello` over `connection`, which must be framed, and
+/// resolves with the connection once the server echoed the hello.  Must be
+/// called on the thread of `eventBase`, the one of `connection`.
+folly::Future<std::unique_ptr<DuplexConnection>> connectStripe(
+    std::unique_ptr<DuplexConnection> connection,
+    folly::EventBase& eventBase,
+    StripeHello hello);
+
+} // namespace rsocket
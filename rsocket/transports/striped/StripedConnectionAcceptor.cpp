@@ -0,0 +1,302 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/striped/StripedConnectionAcceptor.h"
+
+#include <folly/Range.h>
+#include <folly/io/async/EventBase.h>
+#include <glog/logging.h>
+
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+
+#include "rsocket/framing/FramedDuplexConnection.h"
+#include "rsocket/transports/striped/StripeHandshake.h"
+#include "rsocket/transports/striped/StripedDuplexConnection.h"
+
+namespace rsocket {
+
+using Stripe = StripedDuplexConnection::Stripe;
+
+/// The stripes of the groups that aren't complete yet.  Shared with the
+/// callbacks of the underlying acceptor, which may outlive this.
+class StripedConnectionAcceptor::Groups
+    : public std::enable_shared_from_this<Groups> {
+ public:
+  explicit Groups(Options options) : options_(std::move(options)) {}
+
+  ~Groups() {
+    for (auto& entry : groups_) {
+      dropStripes(std::move(entry.second));
+    }
+  }
+
+  /// Adds a stripe to its group.  Once all stripes of the group are there,
+  /// makes the striped connection and hands it to `onAccept`.  Runs on the
+  /// thread of the stripe.
+  void add(
+      AcceptedStripe accepted,
+      folly::EventBase& eventBase,
+      const OnDuplexConnectionAccept& onAccept) {
+    auto const hello = accepted.hello;
+    Stripe stripe{std::move(accepted.connection), &eventBase};
+    if (hello.count > options_.maxStripes) {
+      VLOG(2) << "Dropping stripe " << hello.index << " of group "
+              << hello.groupId << ", which has more than "
+              << options_.maxStripes << " stripes";
+      drop(std::move(stripe), nullptr);
+      return;
+    }
+
+    std::vector<Stripe> stripes;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = groups_.find(hello.groupId);
+      if (it == groups_.end()) {
+        it = groups_.emplace(hello.groupId, Group()).first;
+        auto& group = it->second;
+        group.serial = nextSerial_++;
+        group.stripes.resize(hello.count);
+        group.watches.resize(hello.count);
+        expireLater(eventBase, hello.groupId, group.serial);
+      }
+      auto& group = it->second;
+      if (group.stripes.size() != hello.count ||
+          group.stripes[hello.index].connection) {
+        VLOG(2) << "Dropping stripe " << hello.index << " of group "
+                << hello.groupId << ", which doesn't fit the group";
+        drop(std::move(stripe), nullptr);
+        return;
+      }
+      if (++group.received < hello.count) {
+        // Posted while holding the lock, so that it runs before the watch is
+        // released again.
+        auto watch = std::make_shared<StripeWatch>(
+            shared_from_this(), hello.groupId, group.serial);
+        eventBase.runInEventBaseThread(
+            [watch, connection = stripe.connection.get()] {
+              connection->setInput(watch);
+            });
+        group.watches[hello.index] = std::move(watch);
+        group.stripes[hello.index] = std::move(stripe);
+        return;
+      }
+      group.stripes[hello.index] = std::move(stripe);
+
+      // The watches are released before the striped connection subscribes to
+      // the stripes, which it does on their threads too.
+      for (size_t i = 0; i < group.watches.size(); ++i) {
+        if (auto watch = std::move(group.watches[i])) {
+          group.stripes[i].eventBase->runInEventBaseThread(
+              [watch = std::move(watch)] { watch->release(); });
+        }
+      }
+      stripes = std::move(group.stripes);
+      groups_.erase(it);
+    }
+
+    // The striped connection lives on the thread of the first stripe.
+    auto const home = stripes.front().eventBase;
+    home->runInEventBaseThread(
+        [stripes = std::move(stripes), hello, home, onAccept]() mutable {
+          auto striped = std::make_unique<StripedDuplexConnection>(
+              std::move(stripes), *home, true);
+          // Tells the client that the server end listens on every stripe.
+          auto ack = hello;
+          for (uint16_t i = 0; i < hello.count; ++i) {
+            ack.index = i;
+            striped->sendToStripe(i, serializeStripeHello(ack));
+          }
+          onAccept(std::move(striped), *home);
+        });
+  }
+
+ private:
+  class StripeWatch;
+
+  struct Group {
+    /// Tells this group from an earlier one with the same id.
+    uint64_t serial{0};
+    std::vector<Stripe> stripes;
+    std::vector<std::shared_ptr<StripeWatch>> watches;
+    size_t received{0};
+  };
+
+  /// Drops a group with all its stripes, unless it completed already.
+  void dropGroup(uint64_t groupId, uint64_t serial, folly::StringPiece why) {
+    Group group;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = groups_.find(groupId);
+      if (it == groups_.end() || it->second.serial != serial) {
+        return;
+      }
+      group = std::move(it->second);
+      groups_.erase(it);
+    }
+    VLOG(2) << "Dropping group " << groupId << ", " << why;
+    dropStripes(std::move(group));
+  }
+
+  /// Drops the group once Options::groupTimeout has passed, if it is still
+  /// incomplete by then.
+  void expireLater(
+      folly::EventBase& eventBase,
+      uint64_t groupId,
+      uint64_t serial) {
+    std::weak_ptr<Groups> weak = shared_from_this();
+    auto const timeout = static_cast<uint32_t>(options_.groupTimeout.count());
+    eventBase.runInEventBaseThread(
+        [&eventBase, weak, groupId, serial, timeout] {
+          eventBase.runAfterDelay(
+              [weak, groupId, serial] {
+                if (auto groups = weak.lock()) {
+                  groups->dropGroup(
+                      groupId, serial, "which didn't complete in time");
+                }
+              },
+              timeout);
+        });
+  }
+
+  static void dropStripes(Group group) {
+    for (size_t i = 0; i < group.stripes.size(); ++i) {
+      drop(std::move(group.stripes[i]), std::move(group.watches[i]));
+    }
+  }
+
+  static void drop(Stripe stripe, std::shared_ptr<StripeWatch> watch);
+
+  const Options options_;
+  std::mutex mutex_;
+  std::unordered_map<uint64_t, Group> groups_;
+  uint64_t nextSerial_{0};
+};
+
+/// Subscribes to a stripe waiting for the rest of its group, and drops the
+/// group when the stripe closes, or sends a frame before the server
+/// acknowledged it.  Runs on the thread of the stripe.
+class StripedConnectionAcceptor::Groups::StripeWatch
+    : public DuplexConnection::Subscriber {
+ public:
+  StripeWatch(std::weak_ptr<Groups> groups, uint64_t groupId, uint64_t serial)
+      : groups_(std::move(groups)), groupId_(groupId), serial_(serial) {}
+
+  void onSubscribe(
+      std::shared_ptr<yarpl::flowable::Subscription> subscription) override {
+    if (done_) {
+      subscription->cancel();
+      return;
+    }
+    subscription_ = std::move(subscription);
+    subscription_->request(std::numeric_limits<int64_t>::max());
+  }
+
+  void onNext(std::unique_ptr<folly::IOBuf>) override {
+    dropGroup("one of whose stripes sent a frame too early");
+  }
+
+  void onComplete() override {
+    subscription_ = nullptr;
+    dropGroup("one of whose stripes closed");
+  }
+
+  void onError(folly::exception_wrapper) override {
+    subscription_ = nullptr;
+    dropGroup("one of whose stripes failed");
+  }
+
+  /// Stops watching, before the stripe is handed on or closed.
+  void release() {
+    done_ = true;
+    if (auto subscription = std::move(subscription_)) {
+      subscription->cancel();
+    }
+  }
+
+ private:
+  void dropGroup(folly::StringPiece why) {
+    if (done_) {
+      return;
+    }
+    done_ = true;
+    if (auto groups = groups_.lock()) {
+      groups->dropGroup(groupId_, serial_, why);
+    }
+  }
+
+  const std::weak_ptr<Groups> groups_;
+  const uint64_t groupId_;
+  const uint64_t serial_;
+  std::shared_ptr<yarpl::flowable::Subscription> subscription_;
+  bool done_{false};
+};
+
+void StripedConnectionAcceptor::Groups::drop(
+    Stripe stripe,
+    std::shared_ptr<StripeWatch> watch) {
+  if (auto connection = std::move(stripe.connection)) {
+    stripe.eventBase->runInEventBaseThread(
+        [connection = std::move(connection), watch = std::move(watch)] {
+          if (watch) {
+            watch->release();
+          }
+        });
+  }
+}
+
+StripedConnectionAcceptor::StripedConnectionAcceptor(
+    std::unique_ptr<ConnectionAcceptor> acceptor)
+    : StripedConnectionAcceptor(std::move(acceptor), Options()) {}
+
+StripedConnectionAcceptor::StripedConnectionAcceptor(
+    std::unique_ptr<ConnectionAcceptor> acceptor,
+    Options options)
+    : acceptor_(std::move(acceptor)),
+      groups_(std::make_shared<Groups>(std::move(options))) {
+  CHECK(acceptor_);
+}
+
+StripedConnectionAcceptor::~StripedConnectionAcceptor() = default;
+
+void StripedConnectionAcceptor::start(OnDuplexConnectionAccept onAccept) {
+  acceptor_->start([groups = groups_, onAccept = std::move(onAccept)](
+                       std::unique_ptr<DuplexConnection> connection,
+                       folly::EventBase& eventBase) {
+    if (!connection->isFramed()) {
+      connection = std::make_unique<FramedDuplexConnection>(
+          std::move(connection), ProtocolVersion::Latest);
+    }
+    acceptStripe(std::move(connection), eventBase)
+        .thenTry([groups, onAccept, &eventBase](
+                     folly::Try<AcceptedStripe> result) {
+          if (result.hasException()) {
+            VLOG(2) << "Dropping connection: " << result.exception().what();
+            return;
+          }
+          groups->add(std::move(result).value(), eventBase, onAccept);
+        });
+  });
+}
+
+void StripedConnectionAcceptor::stop() {
+  acceptor_->stop();
+}
+
+folly::Optional<uint16_t> StripedConnectionAcceptor::listeningPort() const {
+  return acceptor_->listeningPort();
+}
+
+} // namespace rsocket
@@ -0,0 +1,81 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#include "rsocket/ConnectionAcceptor.h"
+
+namespace rsocket {
+
+/**
+ * Implementation of ConnectionAcceptor that accepts the striped connections
+ * of a StripedConnectionFactory over the connections of another acceptor, for
+ * use with RSocket::createServer.
+ *
+ * Connections are grouped by the hello frame the client sends first on each
+ * of them, and every complete group is handed out as one
+ * StripedDuplexConnection, on the EventBase of its first stripe.  A group
+ * that doesn't complete in time, or one of whose stripes closes or sends a
+ * frame before it is complete, is dropped with all its connections.
+ *
+ * Construction of this does nothing.  The `start` method kicks off work.
+ */
+class StripedConnectionAcceptor : public ConnectionAcceptor {
+ public:
+  struct Options {
+    /// Most stripes a group may have.  Connections claiming to belong to a
+    /// larger group are closed, so that a client can't make the server set
+    /// up room for that many stripes.
+    uint16_t maxStripes{32};
+
+    /// Time the stripes of a group are given to arrive, from the first one.
+    std::chrono::milliseconds groupTimeout{10000};
+  };
+
+  explicit StripedConnectionAcceptor(
+      std::unique_ptr<ConnectionAcceptor> acceptor);
+  StripedConnectionAcceptor(
+      std::unique_ptr<ConnectionAcceptor> acceptor,
+      Options options);
+  ~StripedConnectionAcceptor();
+
+  // ConnectionAcceptor overrides.
+
+  /**
+   * Start accepting connections, and grouping them into striped connections.
+   */
+  void start(OnDuplexConnectionAccept) override;
+
+  /**
+   * Stop accepting connections.
+   */
+  void stop() override;
+
+  /**
+   * Get the port the underlying acceptor is listening on.
+   */
+  folly::Optional<uint16_t> listeningPort() const override;
+
+ private:
+  class Groups;
+
+  const std::unique_ptr<ConnectionAcceptor> acceptor_;
+  const std::shared_ptr<Groups> groups_;
+};
+
+} // namespace rsocket
@@ -0,0 +1,137 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/striped/StripedConnectionFactory.h"
+
+#include <folly/Random.h>
+#include <folly/executors/InlineExecutor.h>
+#include <folly/futures/Future.h>
+#include <folly/io/async/EventBase.h>
+
+#include <limits>
+#include <stdexcept>
+
+#include "rsocket/framing/FramedDuplexConnection.h"
+#include "rsocket/transports/striped/StripeHandshake.h"
+#include "rsocket/transports/striped/StripedDuplexConnection.h"
+
+namespace rsocket {
+
+namespace {
+
+using Stripe = StripedDuplexConnection::Stripe;
+
+folly::Future<Stripe> connectOneStripe(
+    ConnectionFactory& factory,
+    ProtocolVersion version,
+    StripeHello hello) {
+  return factory.connect(version, ResumeStatus::NEW_SESSION)
+      .thenValue([version, hello](
+                     ConnectionFactory::ConnectedDuplexConnection connected) {
+        // The handshake has to run on the thread of the connection.
+        auto eventBase = &connected.eventBase;
+        return folly::via(
+            eventBase,
+            [connection = std::move(connected.connection),
+             eventBase,
+             version,
+             hello]() mutable {
+              if (!connection->isFramed()) {
+                connection = std::make_unique<FramedDuplexConnection>(
+                    std::move(connection), version);
+              }
+              return connectStripe(std::move(connection), *eventBase, hello)
+                  .thenValue(
+                      [eventBase](std::unique_ptr<DuplexConnection> stripe) {
+                        return Stripe{std::move(stripe), eventBase};
+                      });
+            });
+      });
+}
+
+/// Destroys the stripes that did connect, on their own threads.
+void dropStripes(std::vector<folly::Try<Stripe>>& results) {
+  for (auto& result : results) {
+    if (result.hasValue() && result->connection) {
+      auto const eventBase = result->eventBase;
+      eventBase->runInEventBaseThread(
+          [connection = std::move(result->connection)] {});
+    }
+  }
+}
+
+} // namespace
+
+StripedConnectionFactory::StripedConnectionFactory(
+    std::unique_ptr<ConnectionFactory> factory,
+    size_t numStripes)
+    : factory_(std::move(factory)), numStripes_(numStripes) {
+  CHECK(factory_);
+  CHECK_GT(numStripes_, 0);
+  CHECK_LE(numStripes_, std::numeric_limits<uint16_t>::max());
+}
+
+StripedConnectionFactory::~StripedConnectionFactory() = default;
+
+folly::Future<ConnectionFactory::ConnectedDuplexConnection>
+StripedConnectionFactory::connect(
+    ProtocolVersion version,
+    ResumeStatus resume) {
+  if (resume == ResumeStatus::RESUMING) {
+    return folly::makeFuture<ConnectedDuplexConnection>(
+        std::runtime_error("Striped connections can't be resumed"));
+  }
+
+  StripeHello hello;
+  hello.groupId = folly::Random::secureRand64();
+  hello.count = static_cast<uint16_t>(numStripes_);
+
+  std::vector<folly::Future<Stripe>> stripes;
+  stripes.reserve(numStripes_);
+  for (size_t i = 0; i < numStripes_; ++i) {
+    hello.index = static_cast<uint16_t>(i);
+    stripes.push_back(connectOneStripe(*factory_, version, hello));
+  }
+
+  return folly::collectAll(std::move(stripes))
+      .via(&folly::InlineExecutor::instance())
+      .thenValue([](std::vector<folly::Try<Stripe>> results) {
+        for (auto& result : results) {
+          if (result.hasException()) {
+            auto ew = std::move(result.exception());
+            dropStripes(results);
+            return folly::makeFuture<ConnectedDuplexConnection>(
+                std::move(ew));
+          }
+        }
+
+        std::vector<Stripe> connected;
+        connected.reserve(results.size());
+        for (auto& result : results) {
+          connected.push_back(std::move(result).value());
+        }
+
+        // The striped connection lives on the thread of the first stripe.
+        auto const eventBase = connected.front().eventBase;
+        return folly::via(
+            eventBase, [connected = std::move(connected), eventBase]() mutable {
+              return ConnectedDuplexConnection{
+                  std::make_unique<StripedDuplexConnection>(
+                      std::move(connected), *eventBase, false),
+                  *eventBase};
+            });
+      });
+}
+
+} // namespace rsocket
@@ -0,0 +1,56 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+
+#include "rsocket/ConnectionFactory.h"
+
+namespace rsocket {
+
+/**
+ * Implementation of ConnectionFactory that stripes every connection it makes
+ * over several connections of another factory, for use with
+ * RSocket::createClient().
+ *
+ * Lets a single RSocket session use more bandwidth than the congestion window
+ * of one TCP flow allows.  See StripedDuplexConnection.  The server has to
+ * accept the connections with a StripedConnectionAcceptor.
+ *
+ * Creation of this does nothing.  The `connect` method kicks off work.
+ */
+class StripedConnectionFactory : public ConnectionFactory {
+ public:
+  StripedConnectionFactory(
+      std::unique_ptr<ConnectionFactory> factory,
+      size_t numStripes);
+  ~StripedConnectionFactory() override;
+
+  /**
+   * Makes `numStripes` connections with the underlying factory, and hands
+   * them out as one once the server has accepted all of them.
+   *
+   * Striped connections can't be resumed, asking to resume fails.
+   */
+  folly::Future<ConnectedDuplexConnection> connect(
+      ProtocolVersion,
+      ResumeStatus resume) override;
+
+ private:
+  const std::unique_ptr<ConnectionFactory> factory_;
+  const size_t numStripes_;
+};
+
+} // namespace rsocket
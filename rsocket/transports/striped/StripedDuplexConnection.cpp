@@ -0,0 +1,401 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/striped/StripedDuplexConnection.h"
+
+#include <folly/io/async/EventBase.h>
+#include <glog/logging.h>
+
+#include <deque>
+#include <limits>
+#include <utility>
+
+#include "rsocket/framing/FrameSerializer.h"
+#include "yarpl/flowable/Subscription.h"
+
+namespace rsocket {
+
+using namespace yarpl::flowable;
+
+/// The input side of the striped connection, and the stripes.  Lives on the
+/// thread of the striped connection, and is shared with the stripes so that
+/// they can hand it frames after the striped connection is gone.
+class StripedDuplexConnection::State
+    : public std::enable_shared_from_this<State> {
+ public:
+  State(folly::EventBase& eventBase, bool holdUntilFirstStripe)
+      : eventBase_(eventBase), holding_(holdUntilFirstStripe) {}
+
+  folly::EventBase& eventBase() const {
+    return eventBase_;
+  }
+
+  bool isTerminated() const {
+    return terminated_;
+  }
+
+  void setInput(std::shared_ptr<DuplexConnection::Subscriber> input);
+
+  void onFrame(size_t index, std::unique_ptr<folly::IOBuf> frame);
+
+  /// Closes every stripe, and terminates the input with `ex`.
+  void terminate(folly::exception_wrapper ex);
+
+  /// The striped connection is gone, closes every stripe and drops the
+  /// input.
+  void close();
+
+  std::vector<std::shared_ptr<Link>> links;
+
+ private:
+  class InputSubscription : public Subscription {
+   public:
+    explicit InputSubscription(std::shared_ptr<State> state)
+        : state_(std::move(state)) {}
+
+    void request(int64_t n) noexcept override {
+      DCHECK_EQ(n, std::numeric_limits<int64_t>::max())
+          << "StripedDuplexConnection doesn't support proper flow control";
+    }
+
+    void cancel() noexcept override {
+      if (auto state = std::move(state_)) {
+        state->input_ = nullptr;
+      }
+    }
+
+   private:
+    std::shared_ptr<State> state_;
+  };
+
+  void deliver(std::unique_ptr<folly::IOBuf> frame);
+
+  /// Hands the unread frames to the input, and then the terminal signal if
+  /// there was one.
+  void drain();
+
+  void closeLinks();
+  void finish();
+
+  folly::EventBase& eventBase_;
+  std::shared_ptr<DuplexConnection::Subscriber> input_;
+
+  /// Frames received before there was an input.
+  std::deque<std::unique_ptr<folly::IOBuf>> unread_;
+
+  /// Whether frames of the other stripes are held back until the first
+  /// stripe delivers a frame, and the frames held back.
+  bool holding_;
+  std::deque<std::unique_ptr<folly::IOBuf>> held_;
+
+  bool terminated_{false};
+  folly::exception_wrapper error_;
+};
+
+/// One stripe, and the subscriber of its connection.  Everything but the
+/// constructor runs on the thread of the stripe.
+class StripedDuplexConnection::Link
+    : public DuplexConnection::Subscriber,
+      public std::enable_shared_from_this<Link> {
+ public:
+  Link(std::shared_ptr<State> state, size_t index, Stripe stripe)
+      : state_(state),
+        home_(state->eventBase()),
+        index_(index),
+        connection_(std::move(stripe.connection)),
+        eventBase_(*stripe.eventBase),
+        local_(&eventBase_ == &home_) {}
+
+  /// Runs `fn` on the thread of the stripe.  Called from the thread of the
+  /// striped connection, in the order the calls have to run in.
+  template <typename F>
+  void run(F&& fn) {
+    if (local_) {
+      fn(*this);
+    } else {
+      eventBase_.runInEventBaseThread(
+          [self = shared_from_this(), fn = std::forward<F>(fn)]() mutable {
+            fn(*self);
+          });
+    }
+  }
+
+  void start() {
+    if (connection_) {
+      connection_->setInput(shared_from_this());
+    }
+  }
+
+  void send(std::unique_ptr<folly::IOBuf> frame) {
+    if (connection_) {
+      connection_->send(std::move(frame));
+    }
+  }
+
+  void sendBatch(std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+    if (connection_) {
+      connection_->sendBatch(std::move(frames));
+    }
+  }
+
+  void close() {
+    if (auto subscription = std::move(subscription_)) {
+      subscription->cancel();
+    }
+    if (auto connection = std::move(connection_)) {
+      // The connection may be calling into this right now.
+      eventBase_.runInLoop([connection = std::move(connection)] {});
+    }
+  }
+
+  void onSubscribe(std::shared_ptr<Subscription> subscription) override {
+    if (!connection_) {
+      subscription->cancel();
+      return;
+    }
+    subscription_ = std::move(subscription);
+    subscription_->request(std::numeric_limits<int64_t>::max());
+  }
+
+  void onNext(std::unique_ptr<folly::IOBuf> frame) override {
+    toHome([index = index_, frame = std::move(frame)](State& state) mutable {
+      state.onFrame(index, std::move(frame));
+    });
+  }
+
+  void onComplete() override {
+    subscription_ = nullptr;
+    toHome([](State& state) { state.terminate(folly::exception_wrapper()); });
+  }
+
+  void onError(folly::exception_wrapper ex) override {
+    subscription_ = nullptr;
+    toHome([ex = std::move(ex)](State& state) mutable {
+      state.terminate(std::move(ex));
+    });
+  }
+
+ private:
+  /// Runs `fn` on the thread of the striped connection, unless the striped
+  /// connection is gone by then.
+  template <typename F>
+  void toHome(F&& fn) {
+    if (local_) {
+      if (auto state = state_.lock()) {
+        fn(*state);
+      }
+      return;
+    }
+    home_.runInEventBaseThread(
+        [weak = state_, fn = std::forward<F>(fn)]() mutable {
+          if (auto state = weak.lock()) {
+            fn(*state);
+          }
+        });
+  }
+
+  const std::weak_ptr<State> state_;
+  folly::EventBase& home_;
+  const size_t index_;
+
+  std::unique_ptr<DuplexConnection> connection_;
+  std::shared_ptr<Subscription> subscription_;
+  folly::EventBase& eventBase_;
+
+  /// Whether the stripe lives on the thread of the striped connection.
+  const bool local_;
+};
+
+void StripedDuplexConnection::State::setInput(
+    std::shared_ptr<DuplexConnection::Subscriber> input) {
+  if (auto previous = std::move(input_)) {
+    previous->onComplete();
+  }
+  if (!input) {
+    return;
+  }
+  input_ = input;
+  input->onSubscribe(std::make_shared<InputSubscription>(shared_from_this()));
+  drain();
+}
+
+void StripedDuplexConnection::State::onFrame(
+    size_t index,
+    std::unique_ptr<folly::IOBuf> frame) {
+  if (terminated_) {
+    return;
+  }
+  if (!holding_) {
+    deliver(std::move(frame));
+    return;
+  }
+  if (index != 0) {
+    held_.push_back(std::move(frame));
+    return;
+  }
+
+  holding_ = false;
+  unread_.push_back(std::move(frame));
+  for (auto& held : held_) {
+    unread_.push_back(std::move(held));
+  }
+  held_.clear();
+  drain();
+}
+
+void StripedDuplexConnection::State::terminate(folly::exception_wrapper ex) {
+  if (terminated_) {
+    return;
+  }
+  // Terminating the input may destroy the striped connection.
+  auto const self = shared_from_this();
+  terminated_ = true;
+  error_ = std::move(ex);
+  held_.clear();
+  closeLinks();
+  if (unread_.empty()) {
+    finish();
+  }
+}
+
+void StripedDuplexConnection::State::close() {
+  terminated_ = true;
+  unread_.clear();
+  held_.clear();
+  input_ = nullptr;
+  closeLinks();
+}
+
+void StripedDuplexConnection::State::deliver(
+    std::unique_ptr<folly::IOBuf> frame) {
+  if (input_ && unread_.empty()) {
+    auto const input = input_;
+    input->onNext(std::move(frame));
+  } else {
+    unread_.push_back(std::move(frame));
+  }
+}
+
+void StripedDuplexConnection::State::drain() {
+  while (input_ && !unread_.empty()) {
+    auto frame = std::move(unread_.front());
+    unread_.pop_front();
+    auto const input = input_;
+    input->onNext(std::move(frame));
+  }
+  if (terminated_ && unread_.empty()) {
+    finish();
+  }
+}
+
+void StripedDuplexConnection::State::closeLinks() {
+  auto closing = std::move(links);
+  links.clear();
+  for (auto& link : closing) {
+    link->run([](Link& l) { l.close(); });
+  }
+}
+
+void StripedDuplexConnection::State::finish() {
+  if (auto input = std::move(input_)) {
+    if (error_) {
+      input->onError(std::move(error_));
+    } else {
+      input->onComplete();
+    }
+  }
+}
+
+StripedDuplexConnection::StripedDuplexConnection(
+    std::vector<Stripe> stripes,
+    folly::EventBase& eventBase,
+    bool holdUntilFirstStripe)
+    : state_(std::make_shared<State>(eventBase, holdUntilFirstStripe)),
+      numStripes_(stripes.size()) {
+  DCHECK(eventBase.isInEventBaseThread());
+  CHECK(!stripes.empty());
+  for (size_t i = 0; i < stripes.size(); ++i) {
+    CHECK(stripes[i].connection && stripes[i].connection->isFramed());
+    CHECK(stripes[i].eventBase);
+    state_->links.push_back(
+        std::make_shared<Link>(state_, i, std::move(stripes[i])));
+  }
+  for (auto& link : state_->links) {
+    link->run([](Link& l) { l.start(); });
+  }
+}
+
+StripedDuplexConnection::~StripedDuplexConnection() {
+  VLOG(3) << "~StripedDuplexConnection (" << this << ")";
+  state_->close();
+}
+
+void StripedDuplexConnection::sendToStripe(
+    size_t index,
+    std::unique_ptr<folly::IOBuf> frame) {
+  DCHECK_LT(index, numStripes_);
+  if (state_->isTerminated()) {
+    return;
+  }
+  state_->links[index]->run([frame = std::move(frame)](Link& l) mutable {
+    l.send(std::move(frame));
+  });
+}
+
+void StripedDuplexConnection::setInput(
+    std::shared_ptr<DuplexConnection::Subscriber> input) {
+  // Delivering frames may destroy this connection.
+  auto const state = state_;
+  state->setInput(std::move(input));
+}
+
+void StripedDuplexConnection::send(std::unique_ptr<folly::IOBuf> frame) {
+  if (state_->isTerminated()) {
+    return;
+  }
+  auto const& link = state_->links[stripeOfFrame(*frame)];
+  link->run([frame = std::move(frame)](Link& l) mutable {
+    l.send(std::move(frame));
+  });
+}
+
+void StripedDuplexConnection::sendBatch(
+    std::vector<std::unique_ptr<folly::IOBuf>> frames) {
+  if (state_->isTerminated()) {
+    return;
+  }
+  auto& links = state_->links;
+  std::vector<std::vector<std::unique_ptr<folly::IOBuf>>> batches(
+      numStripes_);
+  for (auto& frame : frames) {
+    batches[stripeOfFrame(*frame)].push_back(std::move(frame));
+  }
+  for (size_t i = 0; i < numStripes_; ++i) {
+    if (batches[i].empty()) {
+      continue;
+    }
+    links[i]->run([batch = std::move(batches[i])](Link& l) mutable {
+      l.sendBatch(std::move(batch));
+    });
+  }
+}
+
+size_t StripedDuplexConnection::stripeOfFrame(
+    const folly::IOBuf& frame) const {
+  auto const streamId =
+      FrameSerializer::peekStreamId(ProtocolVersion::Latest, frame, false);
+  return stripeOf(streamId.value_or(0), numStripes_);
+}
+
+} // namespace rsocket
@@ -0,0 +1,96 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "rsocket/DuplexConnection.h"
+#include "rsocket/internal/Common.h"
+
+namespace folly {
+class EventBase;
+}
+
+namespace rsocket {
+
+/// Spreads the frames of one RSocket session over several connections, the
+/// stripes, so that the session isn't limited by the congestion window of a
+/// single TCP flow.
+///
+/// Every stream is pinned to one stripe, see stripeOf(), which keeps the
+/// frames of a stream in order.  Frames of different streams may overtake
+/// each other, which RSocket allows.  Frames of stream 0 (SETUP, KEEPALIVE,
+/// LEASE, METADATA_PUSH, connection errors) all go over the first stripe.
+///
+/// The stripes may live on other EventBases than the striped connection, in
+/// which case frames hop between the threads.  The striped connection itself
+/// must be used on the thread of `eventBase`.  The output buffers of the
+/// stripes aren't reported by bufferedOutputBytes().
+///
+/// Resumption isn't supported, as the positions of frames in a striped
+/// session depend on how the stripes interleave.
+class StripedDuplexConnection : public DuplexConnection {
+ public:
+  struct Stripe {
+    /// Must be framed.
+    std::unique_ptr<DuplexConnection> connection;
+
+    /// EventBase of `connection`.
+    folly::EventBase* eventBase{nullptr};
+  };
+
+  /// On the server end, `holdUntilFirstStripe` holds back the frames of the
+  /// other stripes until the first stripe delivered a frame, so that no
+  /// request overtakes the SETUP frame.
+  StripedDuplexConnection(
+      std::vector<Stripe> stripes,
+      folly::EventBase& eventBase,
+      bool holdUntilFirstStripe);
+  ~StripedDuplexConnection() override;
+
+  /// Index of the stripe that carries the frames of a stream.
+  static size_t stripeOf(StreamId streamId, size_t numStripes) {
+    return streamId == 0 ? 0 : (streamId >> 1) % numStripes;
+  }
+
+  size_t numStripes() const {
+    return numStripes_;
+  }
+
+  /// Sends a frame over a given stripe, rather than the one of its stream.
+  void sendToStripe(size_t index, std::unique_ptr<folly::IOBuf> frame);
+
+  void setInput(std::shared_ptr<DuplexConnection::Subscriber>) override;
+
+  void send(std::unique_ptr<folly::IOBuf>) override;
+
+  void sendBatch(std::vector<std::unique_ptr<folly::IOBuf>> frames) override;
+
+  bool isFramed() const override {
+    return true;
+  }
+
+ private:
+  class Link;
+  class State;
+
+  size_t stripeOfFrame(const folly::IOBuf& frame) const;
+
+  const std::shared_ptr<State> state_;
+  const size_t numStripes_;
+};
+
+} // namespace rsocket
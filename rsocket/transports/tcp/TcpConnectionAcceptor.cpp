@@ -14,20 +14,168 @@
 
 #include "rsocket/transports/tcp/TcpConnectionAcceptor.h"
 
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <unordered_map>
+
 #include <folly/Format.h>
 #include <folly/futures/Future.h>
+#include <folly/io/async/AsyncSSLSocket.h>
 #include <folly/io/async/AsyncSocket.h>
+#include <folly/io/async/AsyncTimeout.h>
 #include <folly/io/async/EventBaseManager.h>
+#include <folly/portability/OpenSSL.h>
 
+#include "rsocket/internal/BusyPollEventBaseThread.h"
+#include "rsocket/internal/ThreadAffinity.h"
 #include "rsocket/transports/tcp/TcpDuplexConnection.h"
 
 namespace rsocket {
 
+/// Counts the connections open on a worker and the bytes they read, for
+/// Options::placement, and samples how far behind the worker is, for
+/// Options::acceptPacing.
+class TcpConnectionAcceptor::WorkerStats : public RSocketStats {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  void duplexConnectionCreated(
+      const std::string& /* type */,
+      DuplexConnection* /* connection */) override {
+    connections_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void duplexConnectionClosed(
+      const std::string& /* type */,
+      DuplexConnection* /* connection */) override {
+    connections_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  void bytesRead(size_t bytes) override {
+    bytes_.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  /// A connection was handed to the worker and hasn't reached it yet.  It
+  /// counts as open from then on, so that a burst of connections doesn't all
+  /// go to the worker that was the least loaded before the burst.
+  void addPending() {
+    pending_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void removePending() {
+    pending_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  size_t connections() const {
+    return connections_.load(std::memory_order_relaxed) +
+        pending_.load(std::memory_order_relaxed);
+  }
+
+  void addHandshake() {
+    handshakes_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void removeHandshake() {
+    handshakes_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  /// Connections on their way to the worker or in their TLS handshake, which
+  /// haven't been handed to the server yet.
+  size_t setups() const {
+    return pending_.load(std::memory_order_relaxed) +
+        handshakes_.load(std::memory_order_relaxed);
+  }
+
+  /// Records how long a task posted to the worker waited before it ran.
+  void recordQueueDelay(Clock::duration delay) {
+    queueDelay_.store(delay.count(), std::memory_order_relaxed);
+  }
+
+  /// Posts a task measuring the queue delay of the worker, unless the
+  /// previous one hasn't run yet.
+  void probe(folly::EventBase& evb, Clock::time_point now) {
+    Clock::rep expected = 0;
+    if (!probeSent_.compare_exchange_strong(
+            expected, now.time_since_epoch().count())) {
+      return;
+    }
+    evb.runInEventBaseThread([this] {
+      auto const sent = probeSent_.exchange(0, std::memory_order_relaxed);
+      recordQueueDelay(Clock::now().time_since_epoch() - Clock::duration(sent));
+    });
+  }
+
+  /// The latest queue delay recorded, or longer if a probe has already been
+  /// waiting for longer than that.
+  Clock::duration queueDelay(Clock::time_point now) const {
+    auto const delay =
+        Clock::duration(queueDelay_.load(std::memory_order_relaxed));
+    auto const sent = probeSent_.load(std::memory_order_relaxed);
+    if (sent == 0) {
+      return delay;
+    }
+    return std::max(delay, now.time_since_epoch() - Clock::duration(sent));
+  }
+
+  /// Bytes read since the previous call.
+  size_t takeBytes() {
+    return bytes_.exchange(0, std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<size_t> connections_{0};
+  std::atomic<size_t> pending_{0};
+  std::atomic<size_t> bytes_{0};
+  std::atomic<size_t> handshakes_{0};
+
+  std::atomic<Clock::rep> queueDelay_{0};
+
+  /// When the probe in flight was posted, zero if there is none.
+  std::atomic<Clock::rep> probeSent_{0};
+};
+
 class TcpConnectionAcceptor::SocketCallback
     : public folly::AsyncServerSocket::AcceptCallback {
  public:
-  explicit SocketCallback(OnDuplexConnectionAccept& onAccept)
-      : thread_{folly::sformat("rstcp-acceptor")}, onAccept_{onAccept} {}
+  SocketCallback(
+      OnDuplexConnectionAccept& onAccept,
+      const TcpDuplexConnection::Options& connectionOptions,
+      const std::shared_ptr<folly::SSLContext>& sslContext,
+      std::chrono::milliseconds handshakeTimeout,
+      bool busyPoll,
+      std::vector<int> cpus,
+      std::shared_ptr<WorkerStats> workerStats)
+      : workerStats_{std::move(workerStats)},
+        onAccept_{onAccept},
+        connectionOptions_{connectionOptions},
+        sslContext_{sslContext},
+        handshakeTimeout_{handshakeTimeout} {
+    auto const name = folly::sformat("rstcp-acceptor");
+    if (busyPoll) {
+      busyPollThread_ =
+          std::make_unique<BusyPollEventBaseThread>(name, std::move(cpus));
+      return;
+    }
+
+    thread_ = std::make_unique<folly::ScopedEventBaseThread>(name);
+    pinEventBaseThread(*thread_->getEventBase(), cpus);
+  }
+
+  ~SocketCallback() override {
+    // Sockets still in their handshake are closed on their thread.  Their
+    // handshakeErr() comes back inline and finds nothing left to finish.
+    eventBase()->runInEventBaseThreadAndWait([this] {
+      auto handshakes = std::move(handshakes_);
+      handshakes_.clear();
+      for (auto& handshake : handshakes) {
+        handshake.second->socket.reset();
+      }
+    });
+  }
 
   void connectionAccepted(
       folly::NetworkSocket fdNetworkSocket,
@@ -36,11 +184,23 @@ class TcpConnectionAcceptor::SocketCallback
 
     VLOG(2) << "Accepting TCP connection from " << address << " on FD " << fd;
 
-    folly::AsyncTransportWrapper::UniquePtr socket(
-        new folly::AsyncSocket(eventBase(), folly::NetworkSocket::fromFd(fd)));
+    if (!sslContext_) {
+      accept(folly::AsyncTransportWrapper::UniquePtr(new folly::AsyncSocket(
+          eventBase(), folly::NetworkSocket::fromFd(fd))));
+      return;
+    }
 
-    auto connection = std::make_unique<TcpDuplexConnection>(std::move(socket));
-    onAccept_(std::move(connection), *eventBase());
+    auto handshake = std::make_unique<Handshake>(
+        *this,
+        folly::AsyncSSLSocket::UniquePtr(new folly::AsyncSSLSocket(
+            sslContext_, eventBase(), folly::NetworkSocket::fromFd(fd))));
+    auto const raw = handshake.get();
+    handshakes_.emplace(raw, std::move(handshake));
+    if (workerStats_) {
+      workerStats_->addHandshake();
+    }
+    // May fail inline.
+    raw->socket->sslAccept(raw, handshakeTimeout_);
   }
 
   void acceptError(const std::exception& ex) noexcept override {
@@ -48,22 +208,298 @@ class TcpConnectionAcceptor::SocketCallback
   }
 
   folly::EventBase* eventBase() const {
-    return thread_.getEventBase();
+    return thread_ ? thread_->getEventBase()
+                   : busyPollThread_->getEventBase();
+  }
+
+  /// Connections still in their TLS handshake.  Waits for the worker thread.
+  size_t pendingHandshakes() const {
+    size_t pending = 0;
+    eventBase()->runInEventBaseThreadAndWait(
+        [&] { pending = handshakes_.size(); });
+    return pending;
+  }
+
+  /// Load of the worker, null unless the Dispatcher is used.
+  WorkerStats* workerStats() const {
+    return workerStats_.get();
   }
 
  private:
-  /// The thread running this callback.
-  folly::ScopedEventBaseThread thread_;
+  /// The TLS handshake of an accepted connection.
+  class Handshake : public folly::AsyncSSLSocket::HandshakeCB {
+   public:
+    Handshake(SocketCallback& callback, folly::AsyncSSLSocket::UniquePtr s)
+        : socket{std::move(s)}, callback_{callback} {}
+
+    void handshakeSuc(folly::AsyncSSLSocket*) noexcept override {
+      callback_.finishHandshake(*this, true);
+    }
+
+    void handshakeErr(
+        folly::AsyncSSLSocket*,
+        const folly::AsyncSocketException& ex) noexcept override {
+      VLOG(2) << "TLS handshake failed: " << ex.what();
+      callback_.finishHandshake(*this, false);
+    }
+
+    folly::AsyncSSLSocket::UniquePtr socket;
+
+   private:
+    SocketCallback& callback_;
+  };
+
+  void accept(folly::AsyncTransportWrapper::UniquePtr socket) {
+    auto connection = std::make_unique<TcpDuplexConnection>(
+        std::move(socket),
+        workerStats_ ? workerStats_ : RSocketStats::noop(),
+        connectionOptions_);
+    onAccept_(std::move(connection), *eventBase());
+  }
+
+  /// Hands the connection on if its handshake succeeded, and closes it
+  /// otherwise.  Runs from within the handshake callback, which the socket
+  /// no longer refers to by then.
+  void finishHandshake(Handshake& handshake, bool succeeded) {
+    auto it = handshakes_.find(&handshake);
+    if (it == handshakes_.end()) {
+      return;
+    }
+    auto const done = std::move(it->second);
+    handshakes_.erase(it);
+    if (workerStats_) {
+      workerStats_->removeHandshake();
+    }
+    if (succeeded) {
+      accept(std::move(done->socket));
+    }
+  }
+
+  /// Counters of the connections of this worker.  Outlives the threads, which
+  /// may still run connections handed over by the Dispatcher as they stop.
+  std::shared_ptr<WorkerStats> workerStats_;
+
+  /// The thread running this callback, one of the two.
+  std::unique_ptr<folly::ScopedEventBaseThread> thread_;
+  std::unique_ptr<BusyPollEventBaseThread> busyPollThread_;
 
   /// Reference to the ConnectionAcceptor's callback.
   OnDuplexConnectionAccept& onAccept_;
+
+  /// Reference to the options for accepted connections.
+  const TcpDuplexConnection::Options& connectionOptions_;
+
+  /// Reference to the TLS context, null for plaintext connections.
+  const std::shared_ptr<folly::SSLContext>& sslContext_;
+  const std::chrono::milliseconds handshakeTimeout_;
+
+  /// Connections still in their TLS handshake.
+  std::unordered_map<Handshake*, std::unique_ptr<Handshake>> handshakes_;
+};
+
+class TcpConnectionAcceptor::Dispatcher
+    : public folly::AsyncServerSocket::AcceptCallback {
+ public:
+  explicit Dispatcher(TcpConnectionAcceptor& acceptor)
+      : acceptor_{acceptor},
+        loads_(acceptor.callbacks_.size()),
+        intervalStart_{std::chrono::steady_clock::now()} {}
+
+  void connectionAccepted(
+      folly::NetworkSocket fd,
+      const folly::SocketAddress& address) noexcept override {
+    auto const& callbacks = acceptor_.callbacks_;
+    auto const& options = acceptor_.options_;
+
+    // Intervals roll over lazily, when a connection comes in.
+    auto const now = std::chrono::steady_clock::now();
+    auto const rollOver = now - intervalStart_ >= options.loadInterval;
+    if (rollOver) {
+      intervalStart_ = now;
+    }
+    for (size_t i = 0; i < callbacks.size(); ++i) {
+      auto const stats = callbacks[i]->workerStats();
+      loads_[i].connections = stats->connections();
+      if (rollOver) {
+        loads_[i].bytesInLastInterval = stats->takeBytes();
+      }
+    }
+
+    auto const index = pick(now);
+    auto const callback = callbacks[index].get();
+    auto stats = callback->workerStats();
+    stats->addPending();
+    callback->eventBase()->runInEventBaseThread(
+        [callback, stats, fd, address, now] {
+          stats->recordQueueDelay(std::chrono::steady_clock::now() - now);
+          callback->connectionAccepted(fd, address);
+          stats->removePending();
+        });
+
+    if (serverSocket_) {
+      pace(now);
+    }
+  }
+
+  void acceptError(const std::exception& ex) noexcept override {
+    VLOG(2) << "TCP error: " << ex.what();
+  }
+
+  /// Starts sampling the workers for Options::acceptPacing.  Runs on the
+  /// listener thread, like everything touching `serverSocket`.
+  void startPacing(folly::AsyncServerSocket& serverSocket) {
+    auto const interval = acceptor_.options_.acceptPacing->checkInterval;
+    serverSocket_ = &serverSocket;
+    timer_ = folly::AsyncTimeout::make(
+        *serverSocket.getEventBase(), [this, interval]() noexcept {
+          auto const now = std::chrono::steady_clock::now();
+          for (auto const& callback : acceptor_.callbacks_) {
+            callback->workerStats()->probe(*callback->eventBase(), now);
+          }
+          pace(now);
+          timer_->scheduleTimeout(interval);
+        });
+    timer_->scheduleTimeout(interval);
+  }
+
+  /// Stops sampling, before the listener goes away.  Runs on the listener
+  /// thread.
+  void stopPacing() {
+    timer_.reset();
+    serverSocket_ = nullptr;
+  }
+
+ private:
+  /// Chooses the worker for a new connection.  Without a placement policy
+  /// that is the next worker round-robin that isn't overloaded, if any.
+  size_t pick(std::chrono::steady_clock::time_point now) {
+    auto const& callbacks = acceptor_.callbacks_;
+    auto const& placement = acceptor_.options_.placement;
+    if (placement) {
+      auto const index = placement->pick(loads_);
+      if (index < callbacks.size()) {
+        return index;
+      }
+      LOG(DFATAL) << "Placement picked worker " << index << " out of "
+                  << callbacks.size();
+      return 0;
+    }
+
+    for (size_t tried = 0; tried < callbacks.size(); ++tried) {
+      auto const index = next_++ % callbacks.size();
+      if (!serverSocket_ || !overloaded(index, now)) {
+        return index;
+      }
+    }
+    return next_++ % callbacks.size();
+  }
+
+  bool overloaded(size_t index, std::chrono::steady_clock::time_point now) {
+    auto const& pacing = *acceptor_.options_.acceptPacing;
+    auto const stats = acceptor_.callbacks_[index]->workerStats();
+    return stats->setups() > pacing.maxPendingConnections ||
+        stats->queueDelay(now) > pacing.maxQueueDelay;
+  }
+
+  /// Pauses accepting while every worker is overloaded or memory is tight,
+  /// and resumes it as soon as neither is the case.  Connections that arrive
+  /// meanwhile wait in the kernel's backlog.
+  void pace(std::chrono::steady_clock::time_point now) {
+    auto const& memoryPressure = acceptor_.options_.memoryPressure;
+    auto const memoryTight =
+        memoryPressure && !memoryPressure->acceptConnections();
+    auto allOverloaded = true;
+    for (size_t i = 0; i < acceptor_.callbacks_.size() && allOverloaded; ++i) {
+      allOverloaded = overloaded(i, now);
+    }
+    auto const pause = allOverloaded || memoryTight;
+    if (pause == paused_) {
+      return;
+    }
+
+    paused_ = pause;
+    if (paused_) {
+      VLOG(1) << (memoryTight ? "Memory is tight"
+                              : "All workers are overloaded")
+              << ", pausing accepts";
+      serverSocket_->pauseAccepting();
+    } else {
+      VLOG(1) << "Resuming accepts";
+      serverSocket_->startAccepting();
+    }
+  }
+
+  TcpConnectionAcceptor& acceptor_;
+
+  /// Scratch space for the loads handed to the placement policy, which also
+  /// keeps the byte counts of the last interval.
+  std::vector<TcpWorkerLoad> loads_;
+
+  std::chrono::steady_clock::time_point intervalStart_;
+
+  /// The next worker to try, when handing connections out round-robin.
+  size_t next_{0};
+
+  /// The listener to pause, null unless Options::acceptPacing is used.
+  folly::AsyncServerSocket* serverSocket_{nullptr};
+
+  /// Samples the workers every AcceptPacing::checkInterval.
+  folly::AsyncTimeout::UniquePtr timer_;
+
+  bool paused_{false};
+};
+
+/// Pauses accepting on a listener while memory is too tight for new
+/// connections, see Options::memoryPressure.  Created and destroyed on the
+/// thread of the listener.
+class TcpConnectionAcceptor::MemoryPressureWatch {
+ public:
+  MemoryPressureWatch(
+      folly::AsyncServerSocket& serverSocket,
+      std::shared_ptr<const MemoryPressureController> controller)
+      : serverSocket_{serverSocket}, controller_{std::move(controller)} {
+    auto const interval = controller_->options().sampleInterval;
+    timer_ = folly::AsyncTimeout::make(
+        *serverSocket.getEventBase(), [this, interval]() noexcept {
+          check();
+          timer_->scheduleTimeout(interval);
+        });
+    check();
+    timer_->scheduleTimeout(interval);
+  }
+
+  folly::EventBase* eventBase() const {
+    return serverSocket_.getEventBase();
+  }
+
+ private:
+  void check() {
+    auto const pause = !controller_->acceptConnections();
+    if (pause == paused_) {
+      return;
+    }
+
+    paused_ = pause;
+    if (paused_) {
+      VLOG(1) << "Memory is tight, pausing accepts";
+      serverSocket_.pauseAccepting();
+    } else {
+      VLOG(1) << "Resuming accepts";
+      serverSocket_.startAccepting();
+    }
+  }
+
+  folly::AsyncServerSocket& serverSocket_;
+  const std::shared_ptr<const MemoryPressureController> controller_;
+  folly::AsyncTimeout::UniquePtr timer_;
+  bool paused_{false};
 };
 
 TcpConnectionAcceptor::TcpConnectionAcceptor(Options options)
     : options_(std::move(options)) {}
 
 TcpConnectionAcceptor::~TcpConnectionAcceptor() {
-  if (serverThread_) {
+  if (onAccept_) {
     stop();
     serverThread_.reset();
   }
@@ -75,54 +511,191 @@ void TcpConnectionAcceptor::start(OnDuplexConnectionAccept onAccept) {
   }
 
   onAccept_ = std::move(onAccept);
-  serverThread_ =
-      std::make_unique<folly::ScopedEventBaseThread>("rstcp-listener");
+
+  if (options_.sslContext) {
+#if !FOLLY_OPENSSL_HAS_ALPN
+#error ALPN is required for rsockets. \
+      Your version of OpenSSL is likely too old.
+#else
+    options_.sslContext->setAdvertisedNextProtocols({"rs"});
+#endif
+  }
+
+  auto const dispatch =
+      (options_.placement || options_.acceptPacing) && !options_.reusePort;
 
   callbacks_.reserve(options_.threads);
   for (size_t i = 0; i < options_.threads; ++i) {
-    callbacks_.push_back(std::make_unique<SocketCallback>(onAccept_));
+    std::vector<int> cpus;
+    if (i < options_.cpuSets.size()) {
+      cpus = options_.cpuSets[i];
+    }
+    callbacks_.push_back(std::make_unique<SocketCallback>(
+        onAccept_,
+        options_.connection,
+        options_.sslContext,
+        options_.handshakeTimeout,
+        options_.busyPoll,
+        std::move(cpus),
+        dispatch ? std::make_shared<WorkerStats>() : nullptr));
+  }
+  if (dispatch) {
+    dispatcher_ = std::make_unique<Dispatcher>(*this);
   }
 
-  VLOG(1) << "Starting TCP listener on port " << options_.address.getPort()
-          << " with " << options_.threads << " request threads";
+  VLOG(1) << "Starting TCP listener on " << options_.address.describe()
+          << " with " << options_.threads << " request threads"
+          << (options_.reusePort ? ", one listener each" : "")
+          << (options_.sslContext ? ", over TLS" : "")
+          << (options_.busyPoll ? ", busy polling" : "");
 
-  serverSocket_.reset(
-      new folly::AsyncServerSocket(serverThread_->getEventBase()));
+  if (options_.reusePort) {
+    if (options_.listener != folly::NetworkSocket() ||
+        options_.address.getFamily() == AF_UNIX) {
+      throw std::invalid_argument(
+          "SO_REUSEPORT listeners need a TCP address to bind to");
+    }
+    startReusePortListeners();
+    return;
+  }
+
+  // Binding fails on a path that is already taken.  Only a socket is safe to
+  // remove, some other file at the path is more likely a mistake.
+  if (options_.listener == folly::NetworkSocket() &&
+      options_.address.getFamily() == AF_UNIX) {
+    auto const path = options_.address.getPath();
+    struct stat st;
+    if (::lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+      ::unlink(path.c_str());
+    }
+  }
+
+  serverThread_ =
+      std::make_unique<folly::ScopedEventBaseThread>("rstcp-listener");
+  auto const evb = serverThread_->getEventBase();
+  serverSockets_.emplace_back(new folly::AsyncServerSocket(evb));
 
   // The AsyncServerSocket needs to be accessed from the listener thread only.
   // This will propagate out any exceptions the listener throws.
   folly::via(
-      serverThread_->getEventBase(),
-      [this] {
-        serverSocket_->bind(options_.address);
+      evb,
+      [this, serverSocket = serverSockets_.back().get()] {
+        if (options_.listener != folly::NetworkSocket()) {
+          serverSocket->useExistingSocket(options_.listener);
+        } else {
+          serverSocket->bind(options_.address);
+        }
 
-        for (auto const& callback : callbacks_) {
-          serverSocket_->addAcceptCallback(
-              callback.get(), callback->eventBase());
+        // The dispatcher runs inline on this thread.
+        if (dispatcher_) {
+          serverSocket->addAcceptCallback(dispatcher_.get(), nullptr);
+        } else {
+          for (auto const& callback : callbacks_) {
+            serverSocket->addAcceptCallback(
+                callback.get(), callback->eventBase());
+          }
         }
 
-        serverSocket_->listen(options_.backlog);
-        serverSocket_->startAccepting();
+        if (options_.listener == folly::NetworkSocket()) {
+          serverSocket->listen(options_.backlog);
+        }
+        serverSocket->startAccepting();
+        if (dispatcher_ && options_.acceptPacing) {
+          dispatcher_->startPacing(*serverSocket);
+        } else if (options_.memoryPressure) {
+          memoryPressureWatches_.push_back(
+              std::make_unique<MemoryPressureWatch>(
+                  *serverSocket, options_.memoryPressure));
+        }
 
-        for (const auto& i : serverSocket_->getAddresses()) {
+        for (const auto& i : serverSocket->getAddresses()) {
           VLOG(1) << "Listening on " << i.describe();
         }
       })
       .get();
 }
 
+void TcpConnectionAcceptor::startReusePortListeners() {
+  // All the listeners bind to the port of the first one, which matters when
+  // the options ask for an ephemeral port.
+  auto address = options_.address;
+
+  for (auto const& callback : callbacks_) {
+    auto const evb = callback->eventBase();
+    serverSockets_.emplace_back(new folly::AsyncServerSocket(evb));
+
+    // Each listener is only accessed from the thread of its callback, which
+    // then runs the callback inline.
+    address = folly::via(
+                  evb,
+                  [&, serverSocket = serverSockets_.back().get()] {
+                    serverSocket->setReusePortEnabled(true);
+                    serverSocket->bind(address);
+                    serverSocket->addAcceptCallback(callback.get(), nullptr);
+                    serverSocket->listen(options_.backlog);
+                    serverSocket->startAccepting();
+                    if (options_.memoryPressure) {
+                      memoryPressureWatches_.push_back(
+                          std::make_unique<MemoryPressureWatch>(
+                              *serverSocket, options_.memoryPressure));
+                    }
+
+                    auto const bound = serverSocket->getAddress();
+                    VLOG(1) << "Listening on " << bound.describe();
+                    return bound;
+                  })
+                  .get();
+  }
+}
+
 void TcpConnectionAcceptor::stop() {
   VLOG(1) << "Shutting down TCP listener";
 
-  serverThread_->getEventBase()->runInEventBaseThreadAndWait(
-      [serverSocket = std::move(serverSocket_)]() {});
+  for (auto& watch : memoryPressureWatches_) {
+    auto const evb = watch->eventBase();
+    evb->runInEventBaseThreadAndWait(
+        [watch = std::move(watch)]() mutable { watch.reset(); });
+  }
+  memoryPressureWatches_.clear();
+
+  // Each socket is destroyed on the thread that drives it.  The dispatcher
+  // stops pacing on the same thread, before its socket goes.
+  for (auto& serverSocket : serverSockets_) {
+    auto const evb = serverSocket->getEventBase();
+    evb->runInEventBaseThreadAndWait(
+        [this, serverSocket = std::move(serverSocket)]() {
+          if (dispatcher_) {
+            dispatcher_->stopPacing();
+          }
+        });
+  }
+  serverSockets_.clear();
 }
 
 folly::Optional<uint16_t> TcpConnectionAcceptor::listeningPort() const {
-  if (!serverSocket_) {
+  if (serverSockets_.empty()) {
     return folly::none;
   }
-  return serverSocket_->getAddress().getPort();
+  auto const address = serverSockets_.front()->getAddress();
+  if (address.getFamily() == AF_UNIX) {
+    return folly::none;
+  }
+  return address.getPort();
+}
+
+folly::NetworkSocket TcpConnectionAcceptor::listenerSocket() const {
+  if (serverSockets_.size() != 1) {
+    return folly::NetworkSocket();
+  }
+  return serverSockets_.front()->getNetworkSocket();
+}
+
+size_t TcpConnectionAcceptor::pendingHandshakes() const {
+  size_t pending = 0;
+  for (auto const& callback : callbacks_) {
+    pending += callback->pendingHandshakes();
+  }
+  return pending;
 }
 
 } // namespace rsocket
@@ -14,10 +14,22 @@
 
 #pragma once
 
+#include <folly/Optional.h>
 #include <folly/io/async/AsyncServerSocket.h>
 #include <folly/io/async/ScopedEventBaseThread.h>
 
+#include <chrono>
+#include <vector>
+
 #include "rsocket/ConnectionAcceptor.h"
+#include "rsocket/internal/MemoryPressureController.h"
+#include "rsocket/transports/tcp/TcpDuplexConnection.h"
+#include "rsocket/transports/tcp/TcpWorkerPlacement.h"
+
+namespace folly {
+
+class SSLContext;
+}
 
 namespace rsocket {
 
@@ -29,14 +41,96 @@ namespace rsocket {
 class TcpConnectionAcceptor : public ConnectionAcceptor {
  public:
   struct Options {
-    /// Address to listen on
+    /// Address to listen on.  May be the path of a Unix socket (see
+    /// folly::SocketAddress::makeFromPath()), for peers on the same host.  A
+    /// stale Unix socket left at the path is replaced.
     folly::SocketAddress address{"::", 8080};
 
+    /// A listening socket handed over by the process this one replaces, see
+    /// TcpHandoff.h.  When set, connections are accepted on it instead of on
+    /// a socket bound to `address`, so none are refused during a restart.
+    /// Ownership passes to the acceptor.
+    folly::NetworkSocket listener;
+
     /// Number of worker threads processing requests.
     size_t threads{2};
 
     /// Number of connections to buffer before accept handlers process them.
+    /// With `acceptPacing` this is what holds a burst of connections while
+    /// accepting is paused, and wants to be much larger.
     int backlog{10};
+
+    /// Open one SO_REUSEPORT listener per worker thread instead of a single
+    /// listener on a thread of its own.  The kernel then spreads incoming
+    /// connections over the workers, and each connection is accepted on the
+    /// thread that goes on to serve it.
+    bool reusePort{false};
+
+    /// Drive the worker threads with BusyPollEventBaseThreads, which spin
+    /// instead of sleeping until the next event.  Trades a fully busy CPU
+    /// per worker for lower latency.  Usually goes with
+    /// `connection.busyPollMicros` and `cpuSets`.
+    bool busyPoll{false};
+
+    /// Sets of CPUs to pin the worker threads to, the i-th worker to the i-th
+    /// set.  Workers past the end of the list aren't pinned.  Connections,
+    /// their read buffers and their state machines stay on the worker that
+    /// accepted them, so cpuSetsAcrossNumaNodes() keeps each connection on a
+    /// single NUMA node.
+    std::vector<std::vector<int>> cpuSets;
+
+    /// Chooses the worker thread serving each accepted connection, from the
+    /// number of connections and the bytes read on every worker.  When null,
+    /// the listener hands connections to the workers round-robin.  Not used
+    /// with `reusePort`, where the kernel places connections.
+    std::shared_ptr<TcpWorkerPlacement> placement;
+
+    /// Length of the intervals over which the bytes read on every worker are
+    /// counted for `placement`.
+    std::chrono::milliseconds loadInterval{1000};
+
+    /// Options applied to every accepted TcpDuplexConnection.
+    TcpDuplexConnection::Options connection;
+
+    /// Accept TLS connections with this context, which holds the server's
+    /// certificate and key.  The handshake runs on the worker thread, and
+    /// the connection is only handed on once it is done.  The context
+    /// advertises the "rs" ALPN protocol, as TcpConnectionFactory does.
+    std::shared_ptr<folly::SSLContext> sslContext;
+
+    /// Time a peer is given to complete the TLS handshake.
+    std::chrono::milliseconds handshakeTimeout{10000};
+
+    /// When accepting pauses under load, see `acceptPacing`.  A worker is
+    /// overloaded when either limit is exceeded.
+    struct AcceptPacing {
+      /// Connections handed to the worker that it hasn't picked up yet, or
+      /// that are still in their TLS handshake.
+      size_t maxPendingConnections{32};
+
+      /// Time work posted to the worker waits before it runs, which is also
+      /// how long the SETUP frame of a new connection would sit unread.
+      std::chrono::milliseconds maxQueueDelay{50};
+
+      /// Time between two samples of the workers' queue delay, and between
+      /// two checks of whether accepting can resume.
+      std::chrono::milliseconds checkInterval{10};
+    };
+
+    /// Stop accepting while every worker is overloaded, and leave new
+    /// connections in the kernel's backlog until one of them catches up,
+    /// instead of admitting connections whose SETUP would time out anyway.
+    /// Connections aren't handed to an overloaded worker while another one
+    /// has room.  Not used with `reusePort`.
+    folly::Optional<AcceptPacing> acceptPacing;
+
+    /// Stop accepting while the controller reports that memory is too tight
+    /// for new connections, see MemoryPressureController::
+    /// acceptConnections(), and resume once pressure clears.  Connections
+    /// that arrive meanwhile wait in the kernel's backlog.  Checked every
+    /// AcceptPacing::checkInterval with `acceptPacing`, and every sample
+    /// interval of the controller otherwise.
+    std::shared_ptr<const MemoryPressureController> memoryPressure;
   };
 
   explicit TcpConnectionAcceptor(Options);
@@ -55,17 +149,39 @@ class TcpConnectionAcceptor : public ConnectionAcceptor {
   void stop() override;
 
   /**
-   * Get the port being listened on.
+   * Get the port being listened on.  None when listening on a Unix socket.
    */
   folly::Optional<uint16_t> listeningPort() const override;
 
+  /**
+   * The socket being listened on, to be handed over to the process that
+   * replaces this one.  Stays owned by the acceptor, which keeps accepting on
+   * it until stopped.  Not available with Options::reusePort.
+   */
+  folly::NetworkSocket listenerSocket() const;
+
+  /**
+   * Accepted connections still in their TLS handshake, over all the worker
+   * threads.  Waits for every worker to tell.  Only to be used for
+   * observation purposes.
+   */
+  size_t pendingHandshakes() const;
+
  private:
+  class Dispatcher;
+  class MemoryPressureWatch;
   class SocketCallback;
+  class WorkerStats;
+
+  /// Binds a listener on the thread of every callback, see
+  /// Options::reusePort.
+  void startReusePortListeners();
 
   /// Options this acceptor has been configured with.
   const Options options_;
 
-  /// The thread driving the AsyncServerSocket.
+  /// The thread driving the AsyncServerSocket.  Not used with
+  /// Options::reusePort.
   std::unique_ptr<folly::ScopedEventBaseThread> serverThread_;
 
   /// Function to run when a connection is accepted.
@@ -75,8 +191,17 @@ class TcpConnectionAcceptor : public ConnectionAcceptor {
   /// thread.
   std::vector<std::unique_ptr<SocketCallback>> callbacks_;
 
-  /// The socket listening for new connections.
-  folly::AsyncServerSocket::UniquePtr serverSocket_;
+  /// Hands accepted connections to the workers when Options::placement or
+  /// Options::acceptPacing is set.
+  std::unique_ptr<Dispatcher> dispatcher_;
+
+  /// The sockets listening for new connections.  There is one per worker
+  /// thread with Options::reusePort, and a single one otherwise.
+  std::vector<folly::AsyncServerSocket::UniquePtr> serverSockets_;
+
+  /// Pause the listeners not paced by the dispatcher under memory pressure,
+  /// see Options::memoryPressure.  Each lives on the thread of its listener.
+  std::vector<std::unique_ptr<MemoryPressureWatch>> memoryPressureWatches_;
 };
 
 } // namespace rsocket
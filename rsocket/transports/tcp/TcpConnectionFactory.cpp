@@ -14,91 +14,445 @@
 
 #include "rsocket/transports/tcp/TcpConnectionFactory.h"
 
+#include <folly/Conv.h>
+#include <folly/ScopeGuard.h>
+#include <folly/Try.h>
 #include <folly/io/async/AsyncSSLSocket.h>
 #include <folly/io/async/AsyncSocket.h>
+#include <folly/io/async/AsyncTimeout.h>
 #include <folly/io/async/AsyncTransport.h>
-#include <folly/io/async/EventBaseManager.h>
+#include <folly/io/async/DelayedDestruction.h>
+#include <folly/portability/OpenSSL.h>
+#include <folly/portability/Sockets.h>
 #include <glog/logging.h>
 
+#include <netdb.h>
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+
 #include "rsocket/transports/tcp/TcpDuplexConnection.h"
 
 namespace rsocket {
 
 namespace {
 
-class ConnectCallback : public folly::AsyncSocket::ConnectCallback {
- public:
-  ConnectCallback(
-      folly::SocketAddress address,
-      const std::shared_ptr<folly::SSLContext>& sslContext,
-      folly::Promise<ConnectionFactory::ConnectedDuplexConnection>
-          connectPromise)
-      : address_(address), connectPromise_(std::move(connectPromise)) {
-    VLOG(2) << "Constructing ConnectCallback";
+// OpenSSL 3.0 moves the record layer into the kernel on its own when the
+// session asks for it, and the socket BIO that folly's AsyncSSLSocket derives
+// its BIO from answers the kTLS controls.
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(OPENSSL_NO_KTLS)
+#define RSOCKET_HAVE_KTLS 1
+#else
+#define RSOCKET_HAVE_KTLS 0
+#endif
 
-    // Set up by ScopedEventBaseThread.
-    auto evb = folly::EventBaseManager::get()->getExistingEventBase();
-    DCHECK(evb);
+void requestKernelTls(folly::SSLContext& sslContext) {
+#if RSOCKET_HAVE_KTLS
+  SSL_CTX_set_options(sslContext.getSSLCtx(), SSL_OP_ENABLE_KTLS);
+#else
+  (void)sslContext;
+  LOG(WARNING) << "kTLS needs OpenSSL 3.0 built with kTLS support, TLS "
+               << "records will be encrypted in user space";
+#endif
+}
+
+void reportKernelTls(
+    const folly::AsyncSSLSocket& socket,
+    DuplexConnection* connection,
+    RSocketStats& stats) {
+  bool send = false;
+  bool receive = false;
+#if RSOCKET_HAVE_KTLS
+  if (auto ssl = socket.getSSL()) {
+    send = BIO_get_ktls_send(SSL_get_wbio(ssl)) == 1;
+    receive = BIO_get_ktls_recv(SSL_get_rbio(ssl)) == 1;
+  }
+#else
+  (void)socket;
+#endif
+  VLOG(3) << "kTLS send " << (send ? "on" : "off") << ", receive "
+          << (receive ? "on" : "off");
+  stats.kernelTls(connection, send, receive);
+}
 
-    if (sslContext) {
+folly::AsyncSocket::UniquePtr makeSocket(
+    folly::EventBase& evb,
+    const std::shared_ptr<folly::SSLContext>& sslContext,
+    const TcpDuplexConnection::Options& connectionOptions,
+    const std::shared_ptr<TlsSessionCache>& tlsSessions) {
+  if (!sslContext) {
+    VLOG(3) << "Starting socket";
+    return folly::AsyncSocket::UniquePtr(new folly::AsyncSocket(&evb));
+  }
 #if !FOLLY_OPENSSL_HAS_ALPN
-      // setAdvertisedNextProtocols() is unavailable
+  // setAdvertisedNextProtocols() is unavailable
 #error ALPN is required for rsockets. \
       Your version of OpenSSL is likely too old.
 #else
-      VLOG(3) << "Starting SSL socket";
-      sslContext->setAdvertisedNextProtocols({"rs"});
+  VLOG(3) << "Starting SSL socket";
+  sslContext->setAdvertisedNextProtocols({"rs"});
 #endif
-      socket_.reset(new folly::AsyncSSLSocket(sslContext, evb));
-    } else {
-      VLOG(3) << "Starting socket";
-      socket_.reset(new folly::AsyncSocket(evb));
+  if (connectionOptions.kernelTls) {
+    requestKernelTls(*sslContext);
+  }
+  auto socket = new folly::AsyncSSLSocket(sslContext, &evb);
+  if (tlsSessions) {
+    tlsSessions->apply(*socket);
+  }
+  return folly::AsyncSocket::UniquePtr(socket);
+}
+
+ConnectionFactory::ConnectedDuplexConnection makeConnection(
+    folly::AsyncSocket::UniquePtr socket,
+    const TcpDuplexConnection::Options& connectionOptions,
+    const std::shared_ptr<RSocketStats>& stats,
+    const std::shared_ptr<TlsSessionCache>& tlsSessions) {
+  auto sslSocket = dynamic_cast<folly::AsyncSSLSocket*>(socket.get());
+  if (sslSocket && tlsSessions) {
+    tlsSessions->update(*sslSocket);
+  }
+  if (!connectionOptions.kernelTls) {
+    sslSocket = nullptr;
+  }
+  auto evb = socket->getEventBase();
+
+  auto connection = TcpConnectionFactory::createDuplexConnectionFromSocket(
+      std::move(socket), stats, connectionOptions);
+  if (sslSocket) {
+    reportKernelTls(*sslSocket, connection.get(), *stats);
+  }
+  return ConnectionFactory::ConnectedDuplexConnection{std::move(connection),
+                                                      *evb};
+}
+
+/// Orders the addresses alternating between the address families, starting
+/// with the family of the first one (RFC 8305, section 4).
+std::vector<folly::SocketAddress> interleaveFamilies(
+    std::vector<folly::SocketAddress> addresses) {
+  if (addresses.empty()) {
+    return addresses;
+  }
+  auto const preferredFamily = addresses.front().getFamily();
+  std::vector<folly::SocketAddress> preferred;
+  std::vector<folly::SocketAddress> others;
+  for (auto& address : addresses) {
+    auto& family = address.getFamily() == preferredFamily ? preferred : others;
+    family.push_back(std::move(address));
+  }
+
+  std::vector<folly::SocketAddress> interleaved;
+  interleaved.reserve(preferred.size() + others.size());
+  for (size_t i = 0; i < std::max(preferred.size(), others.size()); ++i) {
+    if (i < preferred.size()) {
+      interleaved.push_back(std::move(preferred[i]));
+    }
+    if (i < others.size()) {
+      interleaved.push_back(std::move(others[i]));
+    }
+  }
+  return interleaved;
+}
+
+/// Races connection attempts to a list of addresses.  Each attempt starts
+/// once the previous one has failed or has been pending for the attempt
+/// delay.  The first socket to connect (and, with TLS, to finish the
+/// handshake) wins, and the attempts still pending are closed.
+class Connector : public folly::DelayedDestruction {
+ public:
+  using Callback =
+      folly::Function<void(folly::Try<folly::AsyncSocket::UniquePtr>)>;
+
+  /// Must be called on the EventBase.
+  static void start(
+      folly::EventBase& evb,
+      const std::vector<folly::SocketAddress>& addresses,
+      const std::shared_ptr<folly::SSLContext>& sslContext,
+      const TcpDuplexConnection::Options& connectionOptions,
+      const std::shared_ptr<TlsSessionCache>& tlsSessions,
+      std::chrono::milliseconds attemptDelay,
+      Callback callback) {
+    DCHECK(!addresses.empty());
+    auto connector = new Connector(
+        evb,
+        addresses,
+        sslContext,
+        connectionOptions,
+        tlsSessions,
+        attemptDelay,
+        std::move(callback));
+    DestructorGuard dg(connector);
+    connector->startNextAttempt();
+  }
+
+ private:
+  class Attempt : public folly::AsyncSocket::ConnectCallback {
+   public:
+    Attempt(Connector& connector, folly::AsyncSocket::UniquePtr socket)
+        : socket(std::move(socket)), connector_(connector) {}
+
+    void connectSuccess() noexcept override {
+      connector_.onConnected(*this);
+    }
+
+    void connectErr(const folly::AsyncSocketException& ex) noexcept override {
+      connector_.onFailed(*this, ex);
     }
 
-    VLOG(3) << "Attempting connection to " << address_;
+    /// Null once the attempt is over.
+    folly::AsyncSocket::UniquePtr socket;
 
-    socket_->connect(this, address_);
+   private:
+    Connector& connector_;
+  };
+
+  Connector(
+      folly::EventBase& evb,
+      std::vector<folly::SocketAddress> addresses,
+      std::shared_ptr<folly::SSLContext> sslContext,
+      TcpDuplexConnection::Options connectionOptions,
+      std::shared_ptr<TlsSessionCache> tlsSessions,
+      std::chrono::milliseconds attemptDelay,
+      Callback callback)
+      : evb_(evb),
+        addresses_(std::move(addresses)),
+        sslContext_(std::move(sslContext)),
+        connectionOptions_(std::move(connectionOptions)),
+        tlsSessions_(std::move(tlsSessions)),
+        attemptDelay_(attemptDelay),
+        callback_(std::move(callback)),
+        attemptTimeout_(folly::AsyncTimeout::make(evb, [this]() noexcept {
+          DestructorGuard dg(this);
+          startNextAttempt();
+        })) {
+    VLOG(2) << "Constructing Connector";
+  }
+
+  ~Connector() override {
+    VLOG(2) << "Destroying Connector";
   }
 
-  ~ConnectCallback() override {
-    VLOG(2) << "Destroying ConnectCallback";
+  void startNextAttempt() {
+    if (done_ || next_ == addresses_.size()) {
+      return;
+    }
+    auto const& address = addresses_[next_++];
+    VLOG(3) << "Attempting connection to " << address;
+
+    attempts_.push_back(std::make_unique<Attempt>(
+        *this,
+        makeSocket(evb_, sslContext_, connectionOptions_, tlsSessions_)));
+    auto& attempt = *attempts_.back();
+    ++pending_;
+    // May fail inline, which starts the next attempt right away.
+    attempt.socket->connect(&attempt, address);
+
+    if (!done_ && next_ < addresses_.size()) {
+      attemptTimeout_->scheduleTimeout(attemptDelay_);
+    }
   }
 
-  void connectSuccess() noexcept override {
-    std::unique_ptr<ConnectCallback> deleter(this);
-    VLOG(4) << "connectSuccess() on " << address_;
+  void onConnected(Attempt& winner) {
+    DestructorGuard dg(this);
+    --pending_;
+    auto socket = std::move(winner.socket);
+    if (!done_) {
+      done_ = true;
+      attemptTimeout_->cancelTimeout();
+      VLOG(4) << "connectSuccess() on " << socket->getPeerAddress();
 
-    auto connection = TcpConnectionFactory::createDuplexConnectionFromSocket(
-        std::move(socket_), RSocketStats::noop());
-    auto evb = folly::EventBaseManager::get()->getExistingEventBase();
-    CHECK(evb);
-    connectPromise_.setValue(ConnectionFactory::ConnectedDuplexConnection{
-        std::move(connection), *evb});
+      // Their connectErr() comes back inline.
+      for (auto& attempt : attempts_) {
+        attempt->socket.reset();
+      }
+      callback_(folly::Try<folly::AsyncSocket::UniquePtr>(std::move(socket)));
+    }
+    finishIfDone();
   }
 
-  void connectErr(const folly::AsyncSocketException& ex) noexcept override {
-    std::unique_ptr<ConnectCallback> deleter(this);
-    VLOG(4) << "connectErr(" << ex.what() << ") on " << address_;
-    connectPromise_.setException(ex);
+  void onFailed(Attempt& attempt, const folly::AsyncSocketException& ex) {
+    DestructorGuard dg(this);
+    --pending_;
+    attempt.socket.reset();
+    if (!done_) {
+      VLOG(4) << "connectErr(" << ex.what() << ")";
+      error_ = folly::make_exception_wrapper<folly::AsyncSocketException>(ex);
+      if (next_ < addresses_.size()) {
+        attemptTimeout_->cancelTimeout();
+        startNextAttempt();
+      } else if (pending_ == 0) {
+        done_ = true;
+        callback_(folly::Try<folly::AsyncSocket::UniquePtr>(std::move(error_)));
+      }
+    }
+    finishIfDone();
   }
 
- private:
-  const folly::SocketAddress address_;
-  folly::AsyncSocket::UniquePtr socket_;
-  folly::Promise<ConnectionFactory::ConnectedDuplexConnection> connectPromise_;
+  void finishIfDone() {
+    if (done_ && pending_ == 0 && !destroying_) {
+      destroying_ = true;
+      destroy();
+    }
+  }
+
+  folly::EventBase& evb_;
+  const std::vector<folly::SocketAddress> addresses_;
+  const std::shared_ptr<folly::SSLContext> sslContext_;
+  const TcpDuplexConnection::Options connectionOptions_;
+  const std::shared_ptr<TlsSessionCache> tlsSessions_;
+  const std::chrono::milliseconds attemptDelay_;
+  Callback callback_;
+  const std::unique_ptr<folly::AsyncTimeout> attemptTimeout_;
+
+  std::vector<std::unique_ptr<Attempt>> attempts_;
+  /// Index of the next address to try.
+  size_t next_{0};
+  /// Attempts started and not over yet.
+  size_t pending_{0};
+  folly::exception_wrapper error_;
+  bool done_{false};
+  bool destroying_{false};
 };
 
 } // namespace
 
+/// Connections opened ahead of connect().  Lives on the EventBase.
+class TcpConnectionFactory::Spares
+    : public std::enable_shared_from_this<TcpConnectionFactory::Spares> {
+ public:
+  Spares(
+      folly::EventBase& evb,
+      std::vector<folly::SocketAddress> addresses,
+      std::shared_ptr<folly::SSLContext> sslContext,
+      TcpDuplexConnection::Options connectionOptions,
+      Options options)
+      : evb_(evb),
+        addresses_(std::move(addresses)),
+        sslContext_(std::move(sslContext)),
+        connectionOptions_(std::move(connectionOptions)),
+        options_(std::move(options)) {}
+
+  /// Takes a spare that is still open, or returns null.  A spare the server
+  /// has closed in the meantime reads as EOF, so a readable one is dropped.
+  folly::AsyncSocket::UniquePtr take() {
+    while (!sockets_.empty()) {
+      auto socket = std::move(sockets_.front());
+      sockets_.pop_front();
+      if (socket->good() && !socket->readable()) {
+        return socket;
+      }
+      VLOG(3) << "Dropping a spare connection closed by the server";
+    }
+    return nullptr;
+  }
+
+  /// Opens connections until there are as many open and opening as asked
+  /// for.  A spare that fails to connect is retried at the next refill.
+  void refill() {
+    auto const open = sockets_.size() + connecting_;
+    auto const missing =
+        options_.spareConnections > open ? options_.spareConnections - open : 0;
+    // Counted up front, as a connection may fail inline.
+    for (size_t i = 0; i < missing; ++i) {
+      ++connecting_;
+      Connector::start(
+          evb_,
+          addresses_,
+          sslContext_,
+          connectionOptions_,
+          options_.tlsSessions,
+          options_.attemptDelay,
+          [weak = std::weak_ptr<Spares>(shared_from_this())](
+              folly::Try<folly::AsyncSocket::UniquePtr> socket) {
+            auto self = weak.lock();
+            if (!self) {
+              return;
+            }
+            --self->connecting_;
+            if (socket.hasException()) {
+              VLOG(2) << "Failed to open a spare connection: "
+                      << socket.exception().what();
+              return;
+            }
+            self->sockets_.push_back(std::move(*socket));
+          });
+    }
+  }
+
+ private:
+  folly::EventBase& evb_;
+  const std::vector<folly::SocketAddress> addresses_;
+  const std::shared_ptr<folly::SSLContext> sslContext_;
+  const TcpDuplexConnection::Options connectionOptions_;
+  const Options options_;
+
+  std::deque<folly::AsyncSocket::UniquePtr> sockets_;
+  size_t connecting_{0};
+};
+
 TcpConnectionFactory::TcpConnectionFactory(
     folly::EventBase& eventBase,
     folly::SocketAddress address,
     std::shared_ptr<folly::SSLContext> sslContext)
+    : TcpConnectionFactory(
+          eventBase,
+          std::move(address),
+          std::move(sslContext),
+          TcpDuplexConnection::Options()) {}
+
+TcpConnectionFactory::TcpConnectionFactory(
+    folly::EventBase& eventBase,
+    folly::SocketAddress address,
+    std::shared_ptr<folly::SSLContext> sslContext,
+    TcpDuplexConnection::Options connectionOptions)
+    : TcpConnectionFactory(
+          eventBase,
+          std::move(address),
+          std::move(sslContext),
+          std::move(connectionOptions),
+          RSocketStats::noop()) {}
+
+TcpConnectionFactory::TcpConnectionFactory(
+    folly::EventBase& eventBase,
+    folly::SocketAddress address,
+    std::shared_ptr<folly::SSLContext> sslContext,
+    TcpDuplexConnection::Options connectionOptions,
+    std::shared_ptr<RSocketStats> stats)
+    : TcpConnectionFactory(
+          eventBase,
+          std::vector<folly::SocketAddress>{std::move(address)},
+          std::move(sslContext),
+          std::move(connectionOptions),
+          std::move(stats),
+          Options()) {}
+
+TcpConnectionFactory::TcpConnectionFactory(
+    folly::EventBase& eventBase,
+    std::vector<folly::SocketAddress> addresses,
+    std::shared_ptr<folly::SSLContext> sslContext,
+    TcpDuplexConnection::Options connectionOptions,
+    std::shared_ptr<RSocketStats> stats,
+    Options options)
     : eventBase_(&eventBase),
-      address_(std::move(address)),
-      sslContext_(std::move(sslContext)) {}
+      addresses_(interleaveFamilies(std::move(addresses))),
+      sslContext_(std::move(sslContext)),
+      connectionOptions_(std::move(connectionOptions)),
+      stats_(stats ? std::move(stats) : RSocketStats::noop()),
+      options_(std::move(options)) {
+  CHECK(!addresses_.empty()) << "No address to connect to";
+  if (options_.spareConnections > 0) {
+    spares_ = std::make_shared<Spares>(
+        *eventBase_, addresses_, sslContext_, connectionOptions_, options_);
+    eventBase_->runInEventBaseThread([spares = spares_] { spares->refill(); });
+  }
+}
 
-TcpConnectionFactory::~TcpConnectionFactory() = default;
+TcpConnectionFactory::~TcpConnectionFactory() {
+  if (spares_) {
+    // The spare sockets must be closed on their EventBase.
+    eventBase_->runInEventBaseThread([spares = std::move(spares_)] {});
+  }
+}
 
 folly::Future<ConnectionFactory::ConnectedDuplexConnection>
 TcpConnectionFactory::connect(ProtocolVersion, ResumeStatus /* unused */) {
@@ -107,11 +461,73 @@ TcpConnectionFactory::connect(ProtocolVersion, ResumeStatus /* unused */) {
 
   eventBase_->runInEventBaseThread(
       [this, promise = std::move(connectPromise)]() mutable {
-        new ConnectCallback(address_, sslContext_, std::move(promise));
+        if (spares_) {
+          auto socket = spares_->take();
+          spares_->refill();
+          if (socket) {
+            VLOG(3) << "Using a spare connection to "
+                    << socket->getPeerAddress();
+            promise.setValue(makeConnection(
+                std::move(socket),
+                connectionOptions_,
+                stats_,
+                options_.tlsSessions));
+            return;
+          }
+        }
+
+        Connector::start(
+            *eventBase_,
+            addresses_,
+            sslContext_,
+            connectionOptions_,
+            options_.tlsSessions,
+            options_.attemptDelay,
+            [promise = std::move(promise),
+             connectionOptions = connectionOptions_,
+             stats = stats_,
+             tlsSessions = options_.tlsSessions](
+                folly::Try<folly::AsyncSocket::UniquePtr> socket) mutable {
+              if (socket.hasException()) {
+                promise.setException(std::move(socket.exception()));
+                return;
+              }
+              promise.setValue(makeConnection(
+                  std::move(*socket), connectionOptions, stats, tlsSessions));
+            });
       });
   return connectFuture;
 }
 
+std::vector<folly::SocketAddress> TcpConnectionFactory::resolveAddresses(
+    const std::string& host,
+    uint16_t port) {
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_ADDRCONFIG;
+
+  struct addrinfo* results = nullptr;
+  auto const service = folly::to<std::string>(port);
+  if (auto const error =
+          ::getaddrinfo(host.c_str(), service.c_str(), &hints, &results)) {
+    throw std::runtime_error(folly::to<std::string>(
+        "Failed to resolve ", host, ": ", gai_strerror(error)));
+  }
+  SCOPE_EXIT {
+    ::freeaddrinfo(results);
+  };
+
+  std::vector<folly::SocketAddress> addresses;
+  for (auto info = results; info; info = info->ai_next) {
+    folly::SocketAddress address;
+    address.setFromSockaddr(info->ai_addr, info->ai_addrlen);
+    addresses.push_back(std::move(address));
+  }
+  return addresses;
+}
+
 std::unique_ptr<DuplexConnection>
 TcpConnectionFactory::createDuplexConnectionFromSocket(
     folly::AsyncTransportWrapper::UniquePtr socket,
@@ -120,4 +536,13 @@ TcpConnectionFactory::createDuplexConnectionFromSocket(
       std::move(socket), std::move(stats));
 }
 
+std::unique_ptr<DuplexConnection>
+TcpConnectionFactory::createDuplexConnectionFromSocket(
+    folly::AsyncTransportWrapper::UniquePtr socket,
+    std::shared_ptr<RSocketStats> stats,
+    TcpDuplexConnection::Options connectionOptions) {
+  return std::make_unique<TcpDuplexConnection>(
+      std::move(socket), std::move(stats), std::move(connectionOptions));
+}
+
 } // namespace rsocket
@@ -17,8 +17,13 @@
 #include <folly/SocketAddress.h>
 #include <folly/io/async/AsyncTransport.h>
 
+#include <chrono>
+#include <vector>
+
 #include "rsocket/ConnectionFactory.h"
 #include "rsocket/DuplexConnection.h"
+#include "rsocket/transports/tcp/TcpDuplexConnection.h"
+#include "rsocket/transports/tcp/TlsSessionCache.h"
 
 namespace folly {
 
@@ -32,20 +37,67 @@ class RSocketStats;
 /**
  * TCP implementation of ConnectionFactory for use with RSocket::createClient().
  *
- * Creation of this does nothing.  The `start` method kicks off work.
+ * Connections run on the EventBase given to the constructor.  For a busy
+ * polling client, take it from a BusyPollEventBaseThread and set
+ * TcpDuplexConnection::Options::busyPollMicros.
+ *
+ * Given several addresses (e.g. from resolveAddresses()), connect() races
+ * them as in RFC 8305 "Happy Eyeballs": the addresses are tried alternating
+ * between IPv6 and IPv4, each attempt starting when the previous one fails or
+ * has been pending for Options::attemptDelay, and the first connection to be
+ * established wins.
+ *
+ * Creation of this does nothing, unless Options::spareConnections asks for
+ * connections to be opened ahead of connect().
  */
 class TcpConnectionFactory : public ConnectionFactory {
  public:
+  struct Options {
+    /// Time an attempt is given before the next address is tried alongside.
+    std::chrono::milliseconds attemptDelay{250};
+
+    /// Connections kept open ahead of calls to connect(), so that new and
+    /// resumed sessions start on an established socket.  With an SSLContext
+    /// the spares have also completed the TLS handshake.  The factory opens
+    /// them when constructed and replaces each one as it is handed out.
+    size_t spareConnections{0};
+
+    /// Resumes the TLS session of an earlier connection, saving the
+    /// certificate exchange and key agreement of a full handshake.  Share one
+    /// cache between factories for connections to the same server.  Only
+    /// used with an SSLContext.
+    std::shared_ptr<TlsSessionCache> tlsSessions;
+  };
+
   TcpConnectionFactory(
       folly::EventBase& eventBase,
       folly::SocketAddress address,
       std::shared_ptr<folly::SSLContext> sslContext = nullptr);
+  TcpConnectionFactory(
+      folly::EventBase& eventBase,
+      folly::SocketAddress address,
+      std::shared_ptr<folly::SSLContext> sslContext,
+      TcpDuplexConnection::Options connectionOptions);
+  TcpConnectionFactory(
+      folly::EventBase& eventBase,
+      folly::SocketAddress address,
+      std::shared_ptr<folly::SSLContext> sslContext,
+      TcpDuplexConnection::Options connectionOptions,
+      std::shared_ptr<RSocketStats> stats);
+  TcpConnectionFactory(
+      folly::EventBase& eventBase,
+      std::vector<folly::SocketAddress> addresses,
+      std::shared_ptr<folly::SSLContext> sslContext,
+      TcpDuplexConnection::Options connectionOptions,
+      std::shared_ptr<RSocketStats> stats,
+      Options options);
   virtual ~TcpConnectionFactory();
 
   /**
    * Connect to server defined in constructor.
    *
-   * Each call to connect() creates a new AsyncSocket.
+   * Hands out a spare connection if one is still open, otherwise creates a
+   * new AsyncSocket.
    */
   folly::Future<ConnectedDuplexConnection> connect(
       ProtocolVersion,
@@ -55,9 +107,29 @@ class TcpConnectionFactory : public ConnectionFactory {
       folly::AsyncTransportWrapper::UniquePtr socket,
       std::shared_ptr<RSocketStats> stats = std::shared_ptr<RSocketStats>());
 
+  static std::unique_ptr<DuplexConnection> createDuplexConnectionFromSocket(
+      folly::AsyncTransportWrapper::UniquePtr socket,
+      std::shared_ptr<RSocketStats> stats,
+      TcpDuplexConnection::Options connectionOptions);
+
+  /// Resolves all the IPv6 and IPv4 addresses of a host.  Blocks on DNS, and
+  /// throws std::runtime_error if the host doesn't resolve.
+  static std::vector<folly::SocketAddress> resolveAddresses(
+      const std::string& host,
+      uint16_t port);
+
  private:
+  class Spares;
+
   folly::EventBase* eventBase_;
-  const folly::SocketAddress address_;
+  const std::vector<folly::SocketAddress> addresses_;
   std::shared_ptr<folly::SSLContext> sslContext_;
+  const TcpDuplexConnection::Options connectionOptions_;
+  const std::shared_ptr<RSocketStats> stats_;
+  const Options options_;
+
+  /// Lives on the EventBase, so that connections completing after the
+  /// factory is gone can tell.
+  std::shared_ptr<Spares> spares_;
 };
 } // namespace rsocket
@@ -14,10 +14,19 @@
 
 #include "rsocket/transports/tcp/TcpDuplexConnection.h"
 
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+
 #include <folly/ExceptionWrapper.h>
 #include <folly/io/IOBufQueue.h>
+#include <folly/io/async/EventBase.h>
 
 #include "rsocket/internal/Common.h"
+#include "rsocket/internal/EventBaseMonitor.h"
+#include "rsocket/internal/ThreadAffinity.h"
 #include "yarpl/flowable/Subscription.h"
 
 namespace rsocket {
@@ -25,15 +34,37 @@ namespace rsocket {
 using namespace yarpl::flowable;
 
 class TcpReaderWriter : public folly::AsyncTransportWrapper::WriteCallback,
-                        public folly::AsyncTransportWrapper::ReadCallback {
+                        public folly::AsyncTransportWrapper::ReadCallback,
+                        public folly::EventBase::LoopCallback {
   friend void intrusive_ptr_add_ref(TcpReaderWriter* x);
   friend void intrusive_ptr_release(TcpReaderWriter* x);
 
  public:
-  explicit TcpReaderWriter(
+  TcpReaderWriter(
       folly::AsyncTransportWrapper::UniquePtr&& socket,
-      std::shared_ptr<RSocketStats> stats)
-      : socket_(std::move(socket)), stats_(std::move(stats)) {}
+      std::shared_ptr<RSocketStats> stats,
+      TcpDuplexConnection::Options options)
+      : socket_(std::move(socket)),
+        stats_(std::move(stats)),
+        options_(std::move(options)),
+        readBufferSize_(options_.minReadBufferSize),
+        readBufferFloor_(options_.minReadBufferSize) {
+    DCHECK_GT(options_.minReadBufferSize, 0);
+    DCHECK_LE(options_.minReadBufferSize, options_.maxReadBufferSize);
+
+    if (options_.zeroCopyThreshold > 0) {
+      auto asyncSocket = socket_->getUnderlyingTransport<folly::AsyncSocket>();
+      zeroCopy_ = asyncSocket && asyncSocket->setZeroCopy(true);
+      if (!zeroCopy_) {
+        VLOG(2) << "MSG_ZEROCOPY is unavailable, copying all writes";
+      }
+    }
+
+    if (options_.busyPollMicros > 0) {
+      setBusyPoll();
+    }
+    setTrafficClass();
+  }
 
   ~TcpReaderWriter() override {
     CHECK(isClosed());
@@ -44,6 +75,19 @@ class TcpReaderWriter : public folly::AsyncTransportWrapper::WriteCallback,
     return socket_.get();
   }
 
+  size_t readBufferSize() const {
+    return readBufferSize_;
+  }
+
+  size_t bufferedOutputBytes() const {
+    return pendingWrites_.chainLength() +
+        (socket_ ? socket_->getAppBytesBuffered() : 0);
+  }
+
+  void setOutputWrittenCallback(std::function<void()> callback) {
+    outputWritten_ = std::move(callback);
+  }
+
   void setInput(std::shared_ptr<DuplexConnection::Subscriber> inputSubscriber) {
     if (inputSubscriber && isClosed()) {
       inputSubscriber->onComplete();
@@ -74,13 +118,51 @@ class TcpReaderWriter : public folly::AsyncTransportWrapper::WriteCallback,
     if (stats_) {
       stats_->bytesWritten(element->computeChainDataLength());
     }
-    // now AsyncSocket will hold a reference to this instance as a writer until
-    // they call writeComplete or writeErr
-    intrusive_ptr_add_ref(this);
-    socket_->writeChain(this, std::move(element));
+
+    if (!options_.coalesceWrites) {
+      writeChain(std::move(element));
+      return;
+    }
+
+    pendingWrites_.append(std::move(element));
+    ++pendingWriteFrames_;
+
+    if (pendingWriteFrames_ >= options_.maxCoalescedFrames ||
+        pendingWrites_.chainLength() >= options_.maxCoalescedBytes) {
+      flushPendingWrites();
+      return;
+    }
+
+    if (!isLoopCallbackScheduled()) {
+      // The EventBase will hold a reference to this instance until it calls
+      // runLoopCallback.
+      intrusive_ptr_add_ref(this);
+      socket_->getEventBase()->runInLoop(this, /* thisIteration */ true);
+    }
+  }
+
+  bool isDetachable() const {
+    return !isClosed() && socket_->isDetachable();
+  }
+
+  void detachEventBase() {
+    flushPendingWrites();
+    if (isLoopCallbackScheduled()) {
+      cancelLoopCallback();
+      intrusive_ptr_release(this);
+    }
+    socket_->detachEventBase();
+  }
+
+  void attachEventBase(folly::EventBase& eventBase) {
+    if (!isClosed()) {
+      socket_->attachEventBase(&eventBase);
+    }
   }
 
   void close() {
+    // Frames which were already accepted by send() must still hit the wire.
+    flushPendingWrites();
     if (auto socket = std::move(socket_)) {
       socket->close();
     }
@@ -89,7 +171,33 @@ class TcpReaderWriter : public folly::AsyncTransportWrapper::WriteCallback,
     }
   }
 
+  folly::NetworkSocket detachSocket() {
+    auto asyncSocket = socket_
+        ? socket_->getUnderlyingTransport<folly::AsyncSocket>()
+        : nullptr;
+    if (!asyncSocket) {
+      return folly::NetworkSocket();
+    }
+
+    // Releasing the reference of the read callback mustn't destroy this.
+    boost::intrusive_ptr<TcpReaderWriter> self(this);
+    flushPendingWrites();
+    if (socket_->getReadCallback()) {
+      socket_->setReadCB(nullptr);
+      intrusive_ptr_release(this);
+    }
+
+    auto const fd = asyncSocket->detachNetworkSocket();
+    socket_.reset();
+    if (auto subscriber = std::move(inputSubscriber_)) {
+      subscriber->onComplete();
+    }
+    return fd;
+  }
+
   void closeErr(folly::exception_wrapper ew) {
+    pendingWrites_.move();
+    pendingWriteFrames_ = 0;
     if (auto socket = std::move(socket_)) {
       socket->close();
     }
@@ -103,7 +211,124 @@ class TcpReaderWriter : public folly::AsyncTransportWrapper::WriteCallback,
     return !socket_;
   }
 
+  void setBusyPoll() {
+#ifdef SO_BUSY_POLL
+    auto const asyncSocket =
+        socket_->getUnderlyingTransport<folly::AsyncSocket>();
+    int const micros = static_cast<int>(options_.busyPollMicros);
+    if (asyncSocket &&
+        asyncSocket->setSockOpt(SOL_SOCKET, SO_BUSY_POLL, &micros) == 0) {
+      return;
+    }
+#endif
+    VLOG(2) << "SO_BUSY_POLL is unavailable, reads wait for interrupts";
+  }
+
+  DuplexConnection::TransportInfo transportInfo() {
+    DuplexConnection::TransportInfo info;
+    auto const asyncSocket = socket_
+        ? socket_->getUnderlyingTransport<folly::AsyncSocket>()
+        : nullptr;
+    if (!asyncSocket) {
+      return info;
+    }
+
+    int sendBufferSize = 0;
+    socklen_t length = sizeof(sendBufferSize);
+    if (asyncSocket->getSockOpt(
+            SOL_SOCKET, SO_SNDBUF, &sendBufferSize, &length) == 0 &&
+        sendBufferSize > 0) {
+      info.sendBufferSize = static_cast<size_t>(sendBufferSize);
+    }
+
+#if defined(__linux__) && defined(TCP_INFO)
+    struct tcp_info tcpInfo;
+    length = sizeof(tcpInfo);
+    if (asyncSocket->getSockOpt(IPPROTO_TCP, TCP_INFO, &tcpInfo, &length) ==
+        0) {
+      info.congestionWindow =
+          static_cast<size_t>(tcpInfo.tcpi_snd_cwnd) * tcpInfo.tcpi_snd_mss;
+      info.rtt = std::chrono::microseconds(tcpInfo.tcpi_rtt);
+    }
+#endif
+    return info;
+  }
+
+  void setTrafficClass() {
+    auto const asyncSocket =
+        socket_->getUnderlyingTransport<folly::AsyncSocket>();
+    if (!asyncSocket) {
+      return;
+    }
+
+    if (options_.dscp >= 0) {
+      DCHECK_LT(options_.dscp, 64);
+      int const tos = options_.dscp << 2;
+      folly::SocketAddress local;
+      asyncSocket->getLocalAddress(&local);
+      // IPv4-mapped peers of an IPv6 socket take the mark from IP_TOS.
+      bool marked = asyncSocket->setSockOpt(IPPROTO_IP, IP_TOS, &tos) == 0;
+      if (local.getFamily() == AF_INET6) {
+        marked = asyncSocket->setSockOpt(IPPROTO_IPV6, IPV6_TCLASS, &tos) == 0;
+      }
+      if (!marked) {
+        VLOG(2) << "Failed to mark the socket with DSCP " << options_.dscp;
+      }
+    }
+
+    if (options_.sendBufferSize > 0 &&
+        asyncSocket->setSendBufSize(options_.sendBufferSize) != 0) {
+      VLOG(2) << "Failed to set SO_SNDBUF to " << options_.sendBufferSize;
+    }
+    if (options_.receiveBufferSize > 0 &&
+        asyncSocket->setRecvBufSize(options_.receiveBufferSize) != 0) {
+      VLOG(2) << "Failed to set SO_RCVBUF to " << options_.receiveBufferSize;
+    }
+  }
+
+  void writeChain(std::unique_ptr<folly::IOBuf> chain) {
+    auto flags = folly::WriteFlags::NONE;
+    if (zeroCopy_) {
+      auto const length = chain->computeChainDataLength();
+      if (length >= options_.zeroCopyThreshold) {
+        flags = folly::WriteFlags::WRITE_MSG_ZEROCOPY;
+        if (stats_) {
+          stats_->bytesWrittenZeroCopy(length);
+        }
+      } else if (stats_) {
+        stats_->bytesWrittenCopied(length);
+      }
+    }
+
+    // now AsyncSocket will hold a reference to this instance as a writer until
+    // they call writeComplete or writeErr
+    intrusive_ptr_add_ref(this);
+    EventBaseMonitor::ActivityScope activity{
+        EventBaseMonitor::Activity::WRITE};
+    socket_->writeChain(this, std::move(chain), flags);
+  }
+
+  /// Write out all frames coalesced since the last flush as a single chain.
+  void flushPendingWrites() {
+    if (pendingWrites_.empty()) {
+      return;
+    }
+    pendingWriteFrames_ = 0;
+    auto chain = pendingWrites_.move();
+    if (!isClosed()) {
+      writeChain(std::move(chain));
+    }
+  }
+
+  void runLoopCallback() noexcept override {
+    flushPendingWrites();
+    intrusive_ptr_release(this);
+  }
+
   void writeSuccess() noexcept override {
+    if (outputWritten_ && !isClosed()) {
+      outputWritten_();
+    }
     intrusive_ptr_release(this);
   }
 
@@ -115,11 +340,47 @@ class TcpReaderWriter : public folly::AsyncTransportWrapper::WriteCallback,
   }
 
   void getReadBuffer(void** bufReturn, size_t* lenReturn) noexcept override {
-    std::tie(*bufReturn, *lenReturn) = readBuffer_.preallocate(4096, 4096);
+    if (options_.numaLocalReadBuffers &&
+        readBuffer_.tailroom() < readBufferSize_) {
+      readBuffer_.append(createNumaLocalBuffer(readBufferSize_));
+    }
+    std::tie(*bufReturn, *lenReturn) =
+        readBuffer_.preallocate(readBufferSize_, readBufferSize_);
+    offeredReadBufferSize_ = *lenReturn;
+  }
+
+  void setReadBufferSizeHint(size_t bytes) {
+    // Room for a whole frame, with its length field.
+    readBufferFloor_ = std::max(
+        std::min(bytes + sizeof(uint32_t), options_.maxReadBufferSize),
+        options_.minReadBufferSize);
+    readBufferSize_ = std::max(readBufferSize_, readBufferFloor_);
+  }
+
+  /// Double the read buffer when a read fills it completely, halve it after a
+  /// run of reads that use less than a quarter of it.
+  void adjustReadBufferSize(size_t len) {
+    if (!options_.adaptiveReadBuffer) {
+      return;
+    }
+
+    if (len >= offeredReadBufferSize_) {
+      readBufferSize_ =
+          std::min(readBufferSize_ * 2, options_.maxReadBufferSize);
+      smallReads_ = 0;
+    } else if (len < readBufferSize_ / 4) {
+      if (++smallReads_ >= kSmallReadsBeforeShrink) {
+        readBufferSize_ = std::max(readBufferSize_ / 2, readBufferFloor_);
+        smallReads_ = 0;
+      }
+    } else {
+      smallReads_ = 0;
+    }
   }
 
   void readDataAvailable(size_t len) noexcept override {
     readBuffer_.postallocate(len);
+    adjustReadBufferSize(len);
     if (stats_) {
       stats_->bytesRead(len);
     }
@@ -146,12 +407,38 @@ class TcpReaderWriter : public folly::AsyncTransportWrapper::WriteCallback,
   void readBufferAvailable(
       std::unique_ptr<folly::IOBuf> readBuf) noexcept override {
     CHECK(inputSubscriber_);
+    EventBaseMonitor::ActivityScope activity{EventBaseMonitor::Activity::READ};
     inputSubscriber_->onNext(std::move(readBuf));
   }
 
+  static constexpr size_t kSmallReadsBeforeShrink{8};
+
   folly::IOBufQueue readBuffer_{folly::IOBufQueue::cacheChainLength()};
   folly::AsyncTransportWrapper::UniquePtr socket_;
   const std::shared_ptr<RSocketStats> stats_;
+  const TcpDuplexConnection::Options options_;
+
+  /// Size of the buffer requested from readBuffer_ for the next read.
+  size_t readBufferSize_;
+  /// Size the read buffer doesn't shrink below, see setReadBufferSizeHint().
+  size_t readBufferFloor_;
+  /// Size of the buffer actually handed to the socket for the current read.
+  size_t offeredReadBufferSize_{0};
+  /// Number of consecutive reads which used little of the offered buffer.
+  size_t smallReads_{0};
+
+  /// Whether chains above the zerocopy threshold are written with
+  /// MSG_ZEROCOPY.
+  bool zeroCopy_{false};
+
+  /// Frames waiting to be written out as one chain at the end of the current
+  /// EventBase loop iteration.  Only used when coalescing writes.
+  folly::IOBufQueue pendingWrites_{folly::IOBufQueue::cacheChainLength()};
+  size_t pendingWriteFrames_{0};
+
+  /// Run after each completed write, see
+  /// DuplexConnection::setOutputWrittenCallback().
+  std::function<void()> outputWritten_;
 
   std::shared_ptr<DuplexConnection::Subscriber> inputSubscriber_;
   int refCount_{0};
@@ -199,7 +486,14 @@ class TcpInputSubscription : public Subscription {
 TcpDuplexConnection::TcpDuplexConnection(
     folly::AsyncTransportWrapper::UniquePtr&& socket,
     std::shared_ptr<RSocketStats> stats)
-    : tcpReaderWriter_(new TcpReaderWriter(std::move(socket), stats)),
+    : TcpDuplexConnection(std::move(socket), std::move(stats), Options()) {}
+
+TcpDuplexConnection::TcpDuplexConnection(
+    folly::AsyncTransportWrapper::UniquePtr&& socket,
+    std::shared_ptr<RSocketStats> stats,
+    Options options)
+    : tcpReaderWriter_(
+          new TcpReaderWriter(std::move(socket), stats, std::move(options))),
       stats_(stats) {
   if (stats_) {
     stats_->duplexConnectionCreated("tcp", this);
@@ -210,13 +504,60 @@ TcpDuplexConnection::~TcpDuplexConnection() {
   if (stats_) {
     stats_->duplexConnectionClosed("tcp", this);
   }
+  tcpReaderWriter_->setOutputWrittenCallback(nullptr);
   tcpReaderWriter_->close();
 }
 
+folly::NetworkSocket TcpDuplexConnection::detachSocket() {
+  return tcpReaderWriter_ ? tcpReaderWriter_->detachSocket()
+                          : folly::NetworkSocket();
+}
+
 folly::AsyncTransportWrapper* TcpDuplexConnection::getTransport() {
   return tcpReaderWriter_ ? tcpReaderWriter_->getTransport() : nullptr;
 }
 
+size_t TcpDuplexConnection::readBufferSize() const {
+  return tcpReaderWriter_ ? tcpReaderWriter_->readBufferSize() : 0;
+}
+
+size_t TcpDuplexConnection::bufferedOutputBytes() const {
+  return tcpReaderWriter_ ? tcpReaderWriter_->bufferedOutputBytes() : 0;
+}
+
+void TcpDuplexConnection::setOutputWrittenCallback(
+    std::function<void()> callback) {
+  if (tcpReaderWriter_) {
+    tcpReaderWriter_->setOutputWrittenCallback(std::move(callback));
+  }
+}
+
+DuplexConnection::TransportInfo TcpDuplexConnection::transportInfo() const {
+  return tcpReaderWriter_ ? tcpReaderWriter_->transportInfo()
+                          : TransportInfo();
+}
+
+void TcpDuplexConnection::setReadBufferSizeHint(size_t bytes) {
+  if (tcpReaderWriter_) {
+    tcpReaderWriter_->setReadBufferSizeHint(bytes);
+  }
+}
+
+bool TcpDuplexConnection::isDetachable() const {
+  return tcpReaderWriter_ && tcpReaderWriter_->isDetachable();
+}
+
+void TcpDuplexConnection::detachEventBase() {
+  DCHECK(isDetachable());
+  tcpReaderWriter_->detachEventBase();
+}
+
+void TcpDuplexConnection::attachEventBase(folly::EventBase& eventBase) {
+  if (tcpReaderWriter_) {
+    tcpReaderWriter_->attachEventBase(eventBase);
+  }
+}
+
 void TcpDuplexConnection::send(std::unique_ptr<folly::IOBuf> buf) {
   if (tcpReaderWriter_) {
     tcpReaderWriter_->send(std::move(buf));
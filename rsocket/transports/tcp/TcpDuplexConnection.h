@@ -28,18 +28,118 @@ class TcpReaderWriter;
 
 class TcpDuplexConnection : public DuplexConnection {
  public:
+  struct Options {
+    /// Gather all frames sent during a single EventBase loop iteration into
+    /// one IOBuf chain and hand it to the socket with a single writeChain().
+    bool coalesceWrites{false};
+
+    /// Flush the coalesced chain early once it holds this many bytes.
+    size_t maxCoalescedBytes{64 * 1024};
+
+    /// Flush the coalesced chain early once it holds this many frames.
+    size_t maxCoalescedFrames{128};
+
+    /// Grow the read buffer while reads keep filling it and shrink it back
+    /// once reads become small again.  When disabled, every read uses a
+    /// buffer of minReadBufferSize bytes.
+    bool adaptiveReadBuffer{false};
+
+    /// Bounds for the size of the buffer offered to the socket per read.
+    size_t minReadBufferSize{4096};
+    size_t maxReadBufferSize{256 * 1024};
+
+    /// Take read buffers from the NUMA node of the thread reading the socket,
+    /// even when the process interleaves its memory across the nodes.  Every
+    /// buffer then costs an mmap(), so this goes best with a large
+    /// minReadBufferSize.  See createNumaLocalBuffer().
+    bool numaLocalReadBuffers{false};
+
+    /// Write chains of at least this many bytes with MSG_ZEROCOPY, so that the
+    /// kernel sends them straight from their IOBufs instead of copying them.
+    /// The socket keeps each such chain alive until the kernel reports it is
+    /// done with it.  Zero disables zerocopy, as does a socket on which
+    /// AsyncSocket::setZeroCopy() fails (e.g. a kernel older than 4.14).
+    size_t zeroCopyThreshold{0};
+
+    /// Have OpenSSL hand TLS record encryption and decryption over to the
+    /// kernel once the handshake is done (kTLS), instead of running it in the
+    /// EventBase thread.  Needs OpenSSL 3.0 built with kTLS support and the
+    /// Linux `tls` module; the connection stays in user space otherwise.  Only
+    /// applies to connections made by a TcpConnectionFactory with an
+    /// SSLContext, whose options it changes.  See RSocketStats::kernelTls().
+    bool kernelTls{false};
+
+    /// Set SO_BUSY_POLL on the socket, so that reads poll the device queue
+    /// for up to this many microseconds instead of waiting for an interrupt.
+    /// Best combined with an EventBase driven by a BusyPollEventBaseThread.
+    /// Values above net.core.busy_read need CAP_NET_ADMIN.  Zero leaves the
+    /// socket as it is.
+    uint32_t busyPollMicros{0};
+
+    /// DSCP code point (0-63) to mark the packets of the socket with, in the
+    /// IP_TOS or IPV6_TCLASS field, so that the network can queue bulk and
+    /// interactive traffic apart.  A negative value leaves the socket as it
+    /// is.
+    int dscp{-1};
+
+    /// SO_SNDBUF and SO_RCVBUF of the socket.  A small send buffer keeps the
+    /// frames of a latency-sensitive connection queued in the scheduler
+    /// rather than in the kernel, a large one lets a bulk connection fill a
+    /// long fat pipe.  Set on a connected socket, so a receive buffer beyond
+    /// what the window scale of the handshake allows is of no use.  Zero
+    /// leaves the kernel's default.
+    size_t sendBufferSize{0};
+    size_t receiveBufferSize{0};
+  };
+
   explicit TcpDuplexConnection(
       folly::AsyncTransportWrapper::UniquePtr&& socket,
       std::shared_ptr<RSocketStats> stats = RSocketStats::noop());
+  TcpDuplexConnection(
+      folly::AsyncTransportWrapper::UniquePtr&& socket,
+      std::shared_ptr<RSocketStats> stats,
+      Options options);
   ~TcpDuplexConnection();
 
   void send(std::unique_ptr<folly::IOBuf>) override;
 
   void setInput(std::shared_ptr<DuplexConnection::Subscriber>) override;
 
+  /// Frames coalesced for the next write, plus the bytes the socket holds.
+  size_t bufferedOutputBytes() const override;
+
+  /// Runs the callback each time the socket finishes writing a chain.
+  void setOutputWrittenCallback(std::function<void()>) override;
+
+  /// SO_SNDBUF, and the congestion window and round-trip time from
+  /// TCP_INFO where the platform has it.
+  TransportInfo transportInfo() const override;
+
+  /// Reads into buffers of at least the hinted size, plus the frame length
+  /// field, within the read buffer bounds of the options.
+  void setReadBufferSizeHint(size_t bytes) override;
+
+  /// Writes out the coalesced frames on detach, so that only the socket
+  /// moves.  See folly::AsyncTransport::isDetachable().
+  bool isDetachable() const override;
+  void detachEventBase() override;
+  void attachEventBase(folly::EventBase&) override;
+
+  /// Stops using the socket and hands it over, to be passed to the process
+  /// that replaces this one (see TcpHandoff.h).  The input is completed, and
+  /// the connection drops all frames sent from now on.  Bytes queued in the
+  /// socket but not yet written are lost, so this must only be called once
+  /// the connection is idle.  Returns an invalid socket if the transport
+  /// isn't an AsyncSocket.
+  folly::NetworkSocket detachSocket();
+
   // Only to be used for observation purposes.
   folly::AsyncTransportWrapper* getTransport();
 
+  /// Size of the buffer the next read asks for, see adaptiveReadBuffer.  Only
+  /// to be used for observation purposes.
+  size_t readBufferSize() const;
+
  private:
   boost::intrusive_ptr<TcpReaderWriter> tcpReaderWriter_;
   std::shared_ptr<RSocketStats> stats_;
@@ -0,0 +1,135 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/tcp/TcpHandoff.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+namespace rsocket {
+
+namespace {
+
+constexpr size_t kControlSize{CMSG_SPACE(kMaxHandoffSockets * sizeof(int))};
+
+} // namespace
+
+void sendSockets(
+    folly::NetworkSocket channel,
+    const std::vector<folly::NetworkSocket>& sockets,
+    folly::ByteRange data) {
+  if (sockets.size() > kMaxHandoffSockets) {
+    throw std::invalid_argument("Too many sockets to hand off at once");
+  }
+  if (data.empty()) {
+    throw std::invalid_argument("Handoff messages need some data");
+  }
+
+  struct iovec iov {
+    const_cast<uint8_t*>(data.data()), data.size()
+  };
+  alignas(struct cmsghdr) char control[kControlSize] = {};
+
+  struct msghdr message {};
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+
+  if (!sockets.empty()) {
+    auto const size = sockets.size() * sizeof(int);
+    message.msg_control = control;
+    message.msg_controllen = CMSG_SPACE(size);
+
+    auto cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(size);
+    for (size_t i = 0; i < sockets.size(); ++i) {
+      int const fd = sockets[i].toFd();
+      std::memcpy(CMSG_DATA(cmsg) + i * sizeof(int), &fd, sizeof(fd));
+    }
+  }
+
+  ssize_t sent;
+  do {
+    sent = ::sendmsg(channel.toFd(), &message, MSG_NOSIGNAL);
+  } while (sent < 0 && errno == EINTR);
+  if (sent < 0) {
+    throw std::system_error(errno, std::system_category(), "sendmsg");
+  }
+  if (static_cast<size_t>(sent) != data.size()) {
+    throw std::runtime_error("Handoff message was only partially sent");
+  }
+}
+
+std::vector<folly::NetworkSocket> receiveSockets(
+    folly::NetworkSocket channel,
+    std::string& data,
+    size_t maxDataSize) {
+  data.resize(maxDataSize);
+  struct iovec iov {
+    &data[0], data.size()
+  };
+  alignas(struct cmsghdr) char control[kControlSize] = {};
+
+  struct msghdr message {};
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  ssize_t received;
+  do {
+    received = ::recvmsg(channel.toFd(), &message, MSG_CMSG_CLOEXEC);
+  } while (received < 0 && errno == EINTR);
+  if (received < 0) {
+    throw std::system_error(errno, std::system_category(), "recvmsg");
+  }
+
+  std::vector<folly::NetworkSocket> sockets;
+  for (auto cmsg = CMSG_FIRSTHDR(&message); cmsg;
+       cmsg = CMSG_NXTHDR(&message, cmsg)) {
+    if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+      continue;
+    }
+    auto const count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    for (size_t i = 0; i < count; ++i) {
+      int fd;
+      std::memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(fd));
+      sockets.push_back(folly::NetworkSocket::fromFd(fd));
+    }
+  }
+
+  auto const fail = [&](const char* what) {
+    for (auto socket : sockets) {
+      ::close(socket.toFd());
+    }
+    throw std::runtime_error(what);
+  };
+  if (received == 0) {
+    fail("Handoff channel closed");
+  }
+  if (message.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) {
+    fail("Handoff message was truncated");
+  }
+
+  data.resize(static_cast<size_t>(received));
+  return sockets;
+}
+
+} // namespace rsocket
@@ -0,0 +1,64 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Range.h>
+#include <folly/net/NetworkSocket.h>
+
+#include <string>
+#include <vector>
+
+namespace rsocket {
+
+/// Passing of sockets between processes over a connected Unix socket, for
+/// rolling restarts.  The channel should be a SOCK_SEQPACKET socket (e.g.
+/// from socketpair() before forking the successor), which keeps each
+/// message whole.
+///
+/// The process being replaced sends its listening socket (see
+/// TcpConnectionAcceptor::listenerSocket()) and the sockets of its idle
+/// connections (see TcpDuplexConnection::detachSocket()) to its successor.
+/// The successor accepts on the listener through
+/// TcpConnectionAcceptor::Options::listener, and wraps each connection in a
+/// TcpDuplexConnection to hand to RSocketServer::acceptConnection().  Peers
+/// keep their TCP connections, and never see a refused connect.
+///
+/// Sockets carry no RSocket session state across.  A connection handed over
+/// after its SETUP frame needs the session to be resumable, with its resume
+/// state available to the successor (e.g. through a PersistentResumeManager).
+
+/// Most sockets that fit in one message, the limit of SCM_RIGHTS.
+constexpr size_t kMaxHandoffSockets{253};
+
+/// Sends `sockets` over `channel`, in one message along with `data`, which
+/// must not be empty.  The sockets stay open in this process.  Throws
+/// std::invalid_argument for too many sockets, and std::system_error if the
+/// message can't be sent.
+void sendSockets(
+    folly::NetworkSocket channel,
+    const std::vector<folly::NetworkSocket>& sockets,
+    folly::ByteRange data);
+
+/// Receives a message sent by sendSockets() over `channel`, blocking until it
+/// arrives.  The data of the message, up to `maxDataSize` bytes, goes to
+/// `data`.  The caller owns the returned sockets.  Throws std::system_error
+/// if the message can't be received, and std::runtime_error if the channel
+/// is closed or the message is truncated.
+std::vector<folly::NetworkSocket> receiveSockets(
+    folly::NetworkSocket channel,
+    std::string& data,
+    size_t maxDataSize = 64 * 1024);
+
+} // namespace rsocket
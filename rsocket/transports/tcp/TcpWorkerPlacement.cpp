@@ -0,0 +1,86 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/tcp/TcpWorkerPlacement.h"
+
+#include <folly/Random.h>
+
+#include <algorithm>
+#include <tuple>
+
+namespace rsocket {
+
+namespace {
+
+class LeastConnections : public TcpWorkerPlacement {
+ public:
+  size_t pick(const std::vector<TcpWorkerLoad>& loads) override {
+    auto const it = std::min_element(
+        loads.begin(),
+        loads.end(),
+        [](const TcpWorkerLoad& a, const TcpWorkerLoad& b) {
+          return a.connections < b.connections;
+        });
+    return it - loads.begin();
+  }
+};
+
+class LeastBytes : public TcpWorkerPlacement {
+ public:
+  size_t pick(const std::vector<TcpWorkerLoad>& loads) override {
+    auto const it = std::min_element(
+        loads.begin(),
+        loads.end(),
+        [](const TcpWorkerLoad& a, const TcpWorkerLoad& b) {
+          return std::tie(a.bytesInLastInterval, a.connections) <
+              std::tie(b.bytesInLastInterval, b.connections);
+        });
+    return it - loads.begin();
+  }
+};
+
+class PowerOfTwoChoices : public TcpWorkerPlacement {
+ public:
+  size_t pick(const std::vector<TcpWorkerLoad>& loads) override {
+    auto const size = static_cast<uint32_t>(loads.size());
+    if (size == 1) {
+      return 0;
+    }
+    auto const first = folly::Random::rand32(size, rng_);
+    // Never the same worker twice.
+    auto const second =
+        (first + 1 + folly::Random::rand32(size - 1, rng_)) % size;
+    return loads[second].connections < loads[first].connections ? second
+                                                                 : first;
+  }
+
+ private:
+  folly::Random::DefaultGenerator rng_{folly::Random::create()};
+};
+
+} // namespace
+
+std::shared_ptr<TcpWorkerPlacement> TcpWorkerPlacement::leastConnections() {
+  return std::make_shared<LeastConnections>();
+}
+
+std::shared_ptr<TcpWorkerPlacement> TcpWorkerPlacement::leastBytes() {
+  return std::make_shared<LeastBytes>();
+}
+
+std::shared_ptr<TcpWorkerPlacement> TcpWorkerPlacement::powerOfTwoChoices() {
+  return std::make_shared<PowerOfTwoChoices>();
+}
+
+} // namespace rsocket
@@ -0,0 +1,59 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace rsocket {
+
+/// Load of one worker thread of a TcpConnectionAcceptor.
+struct TcpWorkerLoad {
+  /// Connections currently open on the worker.
+  size_t connections{0};
+
+  /// Bytes the connections of the worker read during the last completed
+  /// load interval, see TcpConnectionAcceptor::Options::loadInterval.
+  size_t bytesInLastInterval{0};
+};
+
+/// Policy choosing the worker thread of a TcpConnectionAcceptor that serves a
+/// newly accepted connection.
+///
+/// Only ever called from the listener thread, so implementations may keep
+/// state without synchronization.
+class TcpWorkerPlacement {
+ public:
+  virtual ~TcpWorkerPlacement() = default;
+
+  /// Returns the index of the worker to serve a new connection, given the
+  /// current load of every worker.  `loads` is never empty.
+  virtual size_t pick(const std::vector<TcpWorkerLoad>& loads) = 0;
+
+  /// The worker with the fewest open connections.
+  static std::shared_ptr<TcpWorkerPlacement> leastConnections();
+
+  /// The worker whose connections read the fewest bytes during the last
+  /// interval, the fewest connections breaking ties.
+  static std::shared_ptr<TcpWorkerPlacement> leastBytes();
+
+  /// The less loaded by connections of two workers picked at random.  Almost
+  /// as balanced as leastConnections(), but doesn't herd a burst of
+  /// connections onto the one worker that looked idlest.
+  static std::shared_ptr<TcpWorkerPlacement> powerOfTwoChoices();
+};
+
+} // namespace rsocket
@@ -0,0 +1,47 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/tcp/TlsSessionCache.h"
+
+#include <folly/io/async/AsyncSSLSocket.h>
+#include <glog/logging.h>
+
+namespace rsocket {
+
+void TlsSessionCache::apply(folly::AsyncSSLSocket& socket) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (session_) {
+    // Takes a reference of its own.
+    socket.setSSLSession(session_.get());
+  }
+}
+
+void TlsSessionCache::update(folly::AsyncSSLSocket& socket) {
+  if (socket.getSSLSessionReused()) {
+    resumed_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  full_.fetch_add(1, std::memory_order_relaxed);
+
+  // Returns a new reference.
+  folly::ssl::SSLSessionUniquePtr session(socket.getSSLSession());
+  if (!session) {
+    return;
+  }
+  VLOG(4) << "Caching a new TLS session";
+  std::lock_guard<std::mutex> lock(mutex_);
+  session_ = std::move(session);
+}
+
+} // namespace rsocket
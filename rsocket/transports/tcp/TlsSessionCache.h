@@ -0,0 +1,67 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/ssl/OpenSSLPtrTypes.h>
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+
+namespace folly {
+
+class AsyncSSLSocket;
+}
+
+namespace rsocket {
+
+/// Keeps the TLS session of the latest connection made with it, so that the
+/// next connection resumes that session (from the server's session cache or
+/// a session ticket) instead of going through a full handshake.  See
+/// TcpConnectionFactory::Options::tlsSessions.
+///
+/// May be shared by several factories, e.g. by the factories of all the
+/// clients of a process talking to the same server.  Thread safe.
+///
+/// The session is taken as soon as the handshake completes.  A TLS 1.3 server
+/// sends its tickets after that, so only TLS 1.2 sessions are resumed.
+class TlsSessionCache {
+ public:
+  /// Offers the cached session, if any, to a socket about to connect.
+  void apply(folly::AsyncSSLSocket&);
+
+  /// Takes the session of a socket that completed its handshake, and counts
+  /// whether it resumed the cached one.
+  void update(folly::AsyncSSLSocket&);
+
+  /// Handshakes that resumed a session, and that went through a full
+  /// handshake.
+  size_t resumed() const {
+    return resumed_.load(std::memory_order_relaxed);
+  }
+
+  size_t full() const {
+    return full_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::mutex mutex_;
+  folly::ssl::SSLSessionUniquePtr session_;
+
+  std::atomic<size_t> resumed_{0};
+  std::atomic<size_t> full_{0};
+};
+
+} // namespace rsocket
@@ -0,0 +1,180 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/uring/IoUringConnectionAcceptor.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <folly/synchronization/Baton.h>
+#include <glog/logging.h>
+
+namespace rsocket {
+
+class IoUringConnectionAcceptor::Worker : public IoUringLoop::Operation {
+ public:
+  Worker(
+      int listenFd,
+      OnDuplexConnectionAccept& onAccept,
+      const IoUringDuplexConnection::Options& connectionOptions)
+      : thread_{"rsuring-acceptor"},
+        listenFd_{listenFd},
+        onAccept_{onAccept},
+        connectionOptions_{connectionOptions} {}
+
+  void start() {
+    eventBase()->runInEventBaseThreadAndWait([this] { startAccepting(); });
+  }
+
+  /// Cancels the accept, and waits for the kernel to let go of it.
+  void stop() {
+    eventBase()->runInEventBaseThread([this] {
+      stopping_ = true;
+      if (accepting_) {
+        io_uring_prep_cancel(loop_->prepare(nullptr), this, 0);
+      } else {
+        stopped_.post();
+      }
+    });
+    stopped_.wait();
+  }
+
+  void onCompletion(int result, uint32_t flags) noexcept override {
+    if (result >= 0) {
+      VLOG(2) << "Accepting TCP connection on FD " << result;
+      auto connection = std::make_unique<IoUringDuplexConnection>(
+          folly::NetworkSocket::fromFd(result),
+          *eventBase(),
+          RSocketStats::noop(),
+          connectionOptions_);
+      onAccept_(std::move(connection), *eventBase());
+    } else if (result != -ECANCELED) {
+      VLOG(2) << "TCP accept error: " << std::strerror(-result);
+    }
+
+    if (flags & IORING_CQE_F_MORE) {
+      return;
+    }
+    accepting_ = false;
+    if (stopping_) {
+      stopped_.post();
+    } else {
+      startAccepting();
+    }
+  }
+
+  folly::EventBase* eventBase() const {
+    return thread_.getEventBase();
+  }
+
+ private:
+  void startAccepting() {
+    loop_ = &IoUringLoop::get(*eventBase(), connectionOptions_.loop);
+    auto const sqe = loop_->prepare(this);
+    io_uring_prep_multishot_accept(sqe, listenFd_, nullptr, nullptr, 0);
+    accepting_ = true;
+  }
+
+  /// The thread running this worker.
+  folly::ScopedEventBaseThread thread_;
+
+  const int listenFd_;
+
+  /// Reference to the ConnectionAcceptor's callback.
+  OnDuplexConnectionAccept& onAccept_;
+
+  /// Reference to the options for accepted connections.
+  const IoUringDuplexConnection::Options& connectionOptions_;
+
+  IoUringLoop* loop_{nullptr};
+  bool accepting_{false};
+  bool stopping_{false};
+  folly::Baton<> stopped_;
+};
+
+IoUringConnectionAcceptor::IoUringConnectionAcceptor(Options options)
+    : options_(std::move(options)) {}
+
+IoUringConnectionAcceptor::~IoUringConnectionAcceptor() {
+  if (listenFd_ >= 0) {
+    stop();
+  }
+}
+
+void IoUringConnectionAcceptor::start(OnDuplexConnectionAccept onAccept) {
+  if (onAccept_ != nullptr) {
+    throw std::runtime_error(
+        "IoUringConnectionAcceptor::start() already called");
+  }
+  onAccept_ = std::move(onAccept);
+
+  listenFd_ = ::socket(
+      options_.address.getFamily(), SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+  if (listenFd_ < 0) {
+    throw std::system_error(errno, std::system_category(), "socket");
+  }
+
+  int const one = 1;
+  ::setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  sockaddr_storage storage;
+  auto const length = options_.address.getAddress(&storage);
+  if (::bind(listenFd_, reinterpret_cast<sockaddr*>(&storage), length) != 0 ||
+      ::listen(listenFd_, options_.backlog) != 0) {
+    auto const error = errno;
+    ::close(listenFd_);
+    listenFd_ = -1;
+    throw std::system_error(error, std::system_category(), "bind");
+  }
+
+  folly::SocketAddress bound;
+  bound.setFromLocalAddress(folly::NetworkSocket::fromFd(listenFd_));
+  port_ = bound.getPort();
+
+  VLOG(1) << "Listening on " << bound.describe() << " with "
+          << options_.threads << " io_uring threads";
+
+  workers_.reserve(options_.threads);
+  for (size_t i = 0; i < options_.threads; ++i) {
+    workers_.push_back(
+        std::make_unique<Worker>(listenFd_, onAccept_, options_.connection));
+    workers_.back()->start();
+  }
+}
+
+void IoUringConnectionAcceptor::stop() {
+  VLOG(1) << "Shutting down io_uring listener";
+
+  for (auto& worker : workers_) {
+    worker->stop();
+  }
+  if (listenFd_ >= 0) {
+    ::close(listenFd_);
+    listenFd_ = -1;
+  }
+}
+
+folly::Optional<uint16_t> IoUringConnectionAcceptor::listeningPort() const {
+  if (listenFd_ < 0) {
+    return folly::none;
+  }
+  return port_;
+}
+
+} // namespace rsocket
@@ -0,0 +1,90 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/SocketAddress.h>
+
+#include "rsocket/ConnectionAcceptor.h"
+#include "rsocket/transports/uring/IoUringDuplexConnection.h"
+
+namespace rsocket {
+
+/**
+ * io_uring implementation of ConnectionAcceptor for use with
+ * RSocket::createServer
+ *
+ * Every worker thread keeps a multishot accept armed on the listening socket,
+ * so each connection is accepted and served by the same thread, with all of
+ * its I/O going through the IoUringLoop of that thread.  Needs Linux 6.0 or
+ * later.
+ *
+ * Construction of this does nothing.  The `start` method kicks off work.
+ */
+class IoUringConnectionAcceptor : public ConnectionAcceptor {
+ public:
+  struct Options {
+    /// Address to listen on
+    folly::SocketAddress address{"::", 8080};
+
+    /// Number of worker threads accepting and processing connections.
+    size_t threads{2};
+
+    /// Number of connections to buffer before the workers accept them.
+    int backlog{10};
+
+    /// Options applied to every accepted IoUringDuplexConnection.
+    IoUringDuplexConnection::Options connection;
+  };
+
+  explicit IoUringConnectionAcceptor(Options);
+  ~IoUringConnectionAcceptor();
+
+  // ConnectionAcceptor overrides.
+
+  /**
+   * Bind the listening socket and start accepting TCP connections.
+   */
+  void start(OnDuplexConnectionAccept) override;
+
+  /**
+   * Stop accepting connections and close the listening socket.
+   */
+  void stop() override;
+
+  /**
+   * Get the port being listened on.
+   */
+  folly::Optional<uint16_t> listeningPort() const override;
+
+ private:
+  class Worker;
+
+  /// Options this acceptor has been configured with.
+  const Options options_;
+
+  /// Function to run when a connection is accepted.
+  OnDuplexConnectionAccept onAccept_;
+
+  /// The listening socket, or -1.
+  int listenFd_{-1};
+
+  /// The port listenFd_ is bound to.
+  uint16_t port_{0};
+
+  /// The workers accepting connections, each with its own thread.
+  std::vector<std::unique_ptr<Worker>> workers_;
+};
+
+} // namespace rsocket
@@ -0,0 +1,130 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/uring/IoUringConnectionFactory.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+#include <glog/logging.h>
+
+namespace rsocket {
+
+namespace {
+
+class ConnectOperation : public IoUringLoop::Operation {
+ public:
+  ConnectOperation(
+      folly::EventBase& eventBase,
+      folly::SocketAddress address,
+      IoUringDuplexConnection::Options connectionOptions,
+      folly::Promise<ConnectionFactory::ConnectedDuplexConnection>
+          connectPromise)
+      : eventBase_(eventBase),
+        address_(std::move(address)),
+        connectionOptions_(std::move(connectionOptions)),
+        connectPromise_(std::move(connectPromise)) {}
+
+  /// Deletes itself once the connect completes.
+  void start() {
+    fd_ = ::socket(
+        address_.getFamily(), SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+    if (fd_ < 0) {
+      fail(errno);
+      return;
+    }
+
+    VLOG(3) << "Attempting connection to " << address_;
+
+    auto& loop = IoUringLoop::get(eventBase_, connectionOptions_.loop);
+    auto const length = address_.getAddress(&storage_);
+    io_uring_prep_connect(
+        loop.prepare(this),
+        fd_,
+        reinterpret_cast<sockaddr*>(&storage_),
+        length);
+  }
+
+  void onCompletion(int result, uint32_t) noexcept override {
+    if (result < 0) {
+      VLOG(4) << "connectErr(" << std::strerror(-result) << ") on "
+              << address_;
+      fail(-result);
+      return;
+    }
+
+    std::unique_ptr<ConnectOperation> deleter(this);
+    VLOG(4) << "connectSuccess() on " << address_;
+
+    auto connection = std::make_unique<IoUringDuplexConnection>(
+        folly::NetworkSocket::fromFd(fd_),
+        eventBase_,
+        RSocketStats::noop(),
+        connectionOptions_);
+    connectPromise_.setValue(ConnectionFactory::ConnectedDuplexConnection{
+        std::move(connection), eventBase_});
+  }
+
+ private:
+  void fail(int error) {
+    std::unique_ptr<ConnectOperation> deleter(this);
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+    connectPromise_.setException(
+        std::system_error(error, std::system_category(), "connect"));
+  }
+
+  folly::EventBase& eventBase_;
+  const folly::SocketAddress address_;
+  const IoUringDuplexConnection::Options connectionOptions_;
+  folly::Promise<ConnectionFactory::ConnectedDuplexConnection> connectPromise_;
+
+  /// The kernel reads the address after submission, so it has to outlive
+  /// the call to start().
+  sockaddr_storage storage_;
+  int fd_{-1};
+};
+
+} // namespace
+
+IoUringConnectionFactory::IoUringConnectionFactory(
+    folly::EventBase& eventBase,
+    folly::SocketAddress address,
+    IoUringDuplexConnection::Options connectionOptions)
+    : eventBase_(&eventBase),
+      address_(std::move(address)),
+      connectionOptions_(std::move(connectionOptions)) {}
+
+IoUringConnectionFactory::~IoUringConnectionFactory() = default;
+
+folly::Future<ConnectionFactory::ConnectedDuplexConnection>
+IoUringConnectionFactory::connect(ProtocolVersion, ResumeStatus /* unused */) {
+  folly::Promise<ConnectionFactory::ConnectedDuplexConnection> connectPromise;
+  auto connectFuture = connectPromise.getFuture();
+
+  eventBase_->runInEventBaseThread(
+      [this, promise = std::move(connectPromise)]() mutable {
+        (new ConnectOperation(
+             *eventBase_, address_, connectionOptions_, std::move(promise)))
+            ->start();
+      });
+  return connectFuture;
+}
+
+} // namespace rsocket
@@ -0,0 +1,374 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/uring/IoUringDuplexConnection.h"
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <limits>
+#include <system_error>
+
+#include <folly/FBVector.h>
+#include <folly/io/IOBufQueue.h>
+#include <folly/io/async/EventBase.h>
+
+#include "yarpl/flowable/Subscription.h"
+
+namespace rsocket {
+
+using namespace yarpl::flowable;
+
+/// The state of an IoUringDuplexConnection.  Every operation in flight holds
+/// a reference to it, so it outlives the connection until the kernel is done
+/// with its buffers.
+class IoUringSocket : public folly::EventBase::LoopCallback {
+  friend void intrusive_ptr_add_ref(IoUringSocket* x);
+  friend void intrusive_ptr_release(IoUringSocket* x);
+
+ public:
+  IoUringSocket(
+      folly::NetworkSocket socket,
+      IoUringLoop& loop,
+      std::shared_ptr<RSocketStats> stats)
+      : fd_(socket.toFd()),
+        loop_(loop),
+        stats_(std::move(stats)),
+        receiveOperation_(*this),
+        sendOperation_(*this) {
+    int const noDelay = 1;
+    if (::setsockopt(
+            fd_, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay)) != 0) {
+      VLOG(2) << "Cannot set TCP_NODELAY on FD " << fd_;
+    }
+  }
+
+  ~IoUringSocket() override {
+    DCHECK(!receiving_);
+    DCHECK(!sending_);
+    DCHECK(!inputSubscriber_);
+    ::close(fd_);
+  }
+
+  void setInput(std::shared_ptr<DuplexConnection::Subscriber> inputSubscriber) {
+    if (inputSubscriber && state_ != State::OPEN) {
+      inputSubscriber->onComplete();
+      return;
+    }
+
+    if (!inputSubscriber) {
+      inputSubscriber_ = nullptr;
+      return;
+    }
+
+    CHECK(!inputSubscriber_);
+    inputSubscriber_ = std::move(inputSubscriber);
+
+    // Hand over what came in while there was no subscriber.
+    if (!unread_.empty()) {
+      inputSubscriber_->onNext(unread_.move());
+    }
+    if (!receiving_ && state_ == State::OPEN) {
+      startReceiving();
+    }
+  }
+
+  void send(std::unique_ptr<folly::IOBuf> frame) {
+    if (state_ != State::OPEN) {
+      return;
+    }
+
+    if (stats_) {
+      stats_->bytesWritten(frame->computeChainDataLength());
+    }
+    pendingWrites_.append(std::move(frame));
+
+    // While a sendmsg() is in flight, its completion sends what queued up.
+    if (!sending_ && !isLoopCallbackScheduled()) {
+      // The EventBase will hold a reference to this instance until it calls
+      // runLoopCallback.
+      intrusive_ptr_add_ref(this);
+      loop_.eventBase().runInLoop(this, /* thisIteration */ true);
+    }
+  }
+
+  /// Stops receiving and completes the input.  Frames which were already
+  /// accepted by send() still hit the wire.
+  void close() {
+    if (state_ != State::OPEN) {
+      return;
+    }
+    state_ = State::CLOSING;
+    cancel(receiveOperation_, receiving_);
+    unread_.move();
+    if (!sending_ && !isLoopCallbackScheduled()) {
+      shutdown();
+    }
+    if (auto subscriber = std::move(inputSubscriber_)) {
+      subscriber->onComplete();
+    }
+  }
+
+  void closeWithError(folly::exception_wrapper ew) {
+    if (state_ == State::CLOSED) {
+      return;
+    }
+    pendingWrites_.move();
+    unread_.move();
+    cancel(receiveOperation_, receiving_);
+    cancel(sendOperation_, sending_);
+    shutdown();
+    if (auto subscriber = std::move(inputSubscriber_)) {
+      subscriber->onError(std::move(ew));
+    }
+  }
+
+ private:
+  enum class State { OPEN, CLOSING, CLOSED };
+
+  /// Forwards the completions of one kind of operation to a member function.
+  template <void (IoUringSocket::*fn)(int, uint32_t)>
+  class Operation : public IoUringLoop::Operation {
+   public:
+    explicit Operation(IoUringSocket& socket) : socket_(socket) {}
+
+    void onCompletion(int result, uint32_t flags) noexcept override {
+      (socket_.*fn)(result, flags);
+    }
+
+   private:
+    IoUringSocket& socket_;
+  };
+
+  void startReceiving() {
+    auto const sqe = loop_.prepare(&receiveOperation_);
+    io_uring_prep_recv_multishot(sqe, fd_, nullptr, 0, 0);
+    sqe->flags |= IOSQE_BUFFER_SELECT;
+    sqe->buf_group = loop_.receiveBufferGroup();
+
+    // The receive holds a reference to this instance until its last
+    // completion.
+    intrusive_ptr_add_ref(this);
+    receiving_ = true;
+  }
+
+  void onReceived(int result, uint32_t flags) {
+    if (result > 0) {
+      DCHECK(flags & IORING_CQE_F_BUFFER);
+      auto const id = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+      auto data = loop_.takeReceiveBuffer(id, result);
+
+      if (stats_) {
+        stats_->bytesRead(result);
+      }
+      if (inputSubscriber_) {
+        inputSubscriber_->onNext(std::move(data));
+      } else if (state_ == State::OPEN) {
+        unread_.append(std::move(data));
+      }
+    }
+
+    if (flags & IORING_CQE_F_MORE) {
+      return;
+    }
+
+    receiving_ = false;
+    boost::intrusive_ptr<IoUringSocket> self(this, /* add_ref */ false);
+    if (state_ != State::OPEN) {
+      return;
+    }
+
+    if (result == 0) {
+      close();
+    } else if (result > 0 || result == -ENOBUFS) {
+      // The kernel ends a multishot receive when it runs out of provided
+      // buffers.  All but those lent out are back in the ring by now, see
+      // IoUringLoop::takeReceiveBuffer().
+      startReceiving();
+    } else if (result != -ECANCELED) {
+      closeWithError(
+          std::system_error(-result, std::system_category(), "recv"));
+    }
+  }
+
+  void runLoopCallback() noexcept override {
+    boost::intrusive_ptr<IoUringSocket> self(this, /* add_ref */ false);
+    startSending();
+  }
+
+  /// Sends everything queued up since the last sendmsg() in a single one.
+  void startSending() {
+    if (sending_ || state_ == State::CLOSED) {
+      return;
+    }
+    if (pendingWrites_.empty()) {
+      if (state_ == State::CLOSING) {
+        shutdown();
+      }
+      return;
+    }
+
+    writing_ = pendingWrites_.move();
+    iovecs_ = writing_->getIov();
+
+    message_ = {};
+    message_.msg_iov = iovecs_.data();
+    message_.msg_iovlen = std::min<size_t>(iovecs_.size(), IOV_MAX);
+
+    auto const sqe = loop_.prepare(&sendOperation_);
+    io_uring_prep_sendmsg(sqe, fd_, &message_, MSG_NOSIGNAL);
+
+    // The send holds a reference to this instance until it completes.
+    intrusive_ptr_add_ref(this);
+    sending_ = true;
+  }
+
+  void onSent(int result, uint32_t) {
+    sending_ = false;
+    boost::intrusive_ptr<IoUringSocket> self(this, /* add_ref */ false);
+
+    if (result < 0) {
+      writing_.reset();
+      if (result != -ECANCELED) {
+        closeWithError(
+            std::system_error(-result, std::system_category(), "sendmsg"));
+      }
+      return;
+    }
+
+    // Whatever the kernel didn't take goes out first in the next sendmsg().
+    folly::IOBufQueue rest{folly::IOBufQueue::cacheChainLength()};
+    rest.append(std::move(writing_));
+    rest.trimStart(static_cast<size_t>(result));
+    rest.append(pendingWrites_.move());
+    pendingWrites_ = std::move(rest);
+    startSending();
+  }
+
+  void cancel(IoUringLoop::Operation& operation, bool inFlight) {
+    if (inFlight) {
+      io_uring_prep_cancel(loop_.prepare(nullptr), &operation, 0);
+    }
+  }
+
+  void shutdown() {
+    state_ = State::CLOSED;
+    ::shutdown(fd_, SHUT_RDWR);
+  }
+
+  const int fd_;
+  IoUringLoop& loop_;
+  const std::shared_ptr<RSocketStats> stats_;
+
+  State state_{State::OPEN};
+
+  Operation<&IoUringSocket::onReceived> receiveOperation_;
+  bool receiving_{false};
+
+  /// Data received while there was no input subscriber.
+  folly::IOBufQueue unread_{folly::IOBufQueue::cacheChainLength()};
+
+  Operation<&IoUringSocket::onSent> sendOperation_;
+  bool sending_{false};
+
+  /// Frames to send once the sendmsg() in flight completes.
+  folly::IOBufQueue pendingWrites_{folly::IOBufQueue::cacheChainLength()};
+
+  /// The chain the sendmsg() in flight sends, and its iovecs.  The kernel
+  /// reads both until it completes.
+  std::unique_ptr<folly::IOBuf> writing_;
+  folly::fbvector<struct iovec> iovecs_;
+  struct msghdr message_ {};
+
+  std::shared_ptr<DuplexConnection::Subscriber> inputSubscriber_;
+  int refCount_{0};
+};
+
+void intrusive_ptr_add_ref(IoUringSocket* x);
+void intrusive_ptr_release(IoUringSocket* x);
+
+inline void intrusive_ptr_add_ref(IoUringSocket* x) {
+  ++x->refCount_;
+}
+
+inline void intrusive_ptr_release(IoUringSocket* x) {
+  if (--x->refCount_ == 0)
+    delete x;
+}
+
+namespace {
+
+class IoUringInputSubscription : public Subscription {
+ public:
+  explicit IoUringInputSubscription(boost::intrusive_ptr<IoUringSocket> socket)
+      : socket_(std::move(socket)) {
+    CHECK(socket_);
+  }
+
+  void request(int64_t n) noexcept override {
+    DCHECK(socket_);
+    DCHECK_EQ(n, std::numeric_limits<int64_t>::max())
+        << "IoUringDuplexConnection doesnt support proper flow control";
+  }
+
+  void cancel() noexcept override {
+    socket_->setInput(nullptr);
+    socket_ = nullptr;
+  }
+
+ private:
+  boost::intrusive_ptr<IoUringSocket> socket_;
+};
+
+} // namespace
+
+IoUringDuplexConnection::IoUringDuplexConnection(
+    folly::NetworkSocket socket,
+    folly::EventBase& eventBase,
+    std::shared_ptr<RSocketStats> stats,
+    Options options)
+    : socket_(new IoUringSocket(
+          socket,
+          IoUringLoop::get(eventBase, options.loop),
+          stats)),
+      stats_(std::move(stats)) {
+  if (stats_) {
+    stats_->duplexConnectionCreated("io_uring", this);
+  }
+}
+
+IoUringDuplexConnection::~IoUringDuplexConnection() {
+  if (stats_) {
+    stats_->duplexConnectionClosed("io_uring", this);
+  }
+  socket_->close();
+}
+
+void IoUringDuplexConnection::send(std::unique_ptr<folly::IOBuf> buf) {
+  socket_->send(std::move(buf));
+}
+
+void IoUringDuplexConnection::setInput(
+    std::shared_ptr<DuplexConnection::Subscriber> inputSubscriber) {
+  inputSubscriber->onSubscribe(
+      std::make_shared<IoUringInputSubscription>(socket_));
+  socket_->setInput(std::move(inputSubscriber));
+}
+
+} // namespace rsocket
@@ -0,0 +1,66 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <boost/smart_ptr/intrusive_ptr.hpp>
+#include <folly/net/NetworkSocket.h>
+
+#include "rsocket/DuplexConnection.h"
+#include "rsocket/RSocketStats.h"
+#include "rsocket/transports/uring/IoUringLoop.h"
+
+namespace folly {
+class EventBase;
+}
+
+namespace rsocket {
+
+class IoUringSocket;
+
+/// A DuplexConnection over a connected TCP socket, doing all of its I/O
+/// through the IoUringLoop of its EventBase.
+///
+/// A single multishot receive stays armed for the lifetime of the connection,
+/// and reads into the provided buffers of the loop, handed on without a copy.
+/// The frames sent during a loop iteration go out in one sendmsg(), submitted
+/// together with the other operations of the iteration.
+///
+/// Frames aren't delimited, wrap the connection in a FramedDuplexConnection.
+class IoUringDuplexConnection : public DuplexConnection {
+ public:
+  struct Options {
+    /// Options of the loop, if the connection is the first to use it.
+    IoUringLoop::Options loop;
+  };
+
+  /// Takes ownership of the socket.  Must be created on the thread of the
+  /// EventBase.
+  IoUringDuplexConnection(
+      folly::NetworkSocket socket,
+      folly::EventBase& eventBase,
+      std::shared_ptr<RSocketStats> stats = RSocketStats::noop(),
+      Options options = Options());
+  ~IoUringDuplexConnection();
+
+  void send(std::unique_ptr<folly::IOBuf>) override;
+
+  void setInput(std::shared_ptr<DuplexConnection::Subscriber>) override;
+
+ private:
+  boost::intrusive_ptr<IoUringSocket> socket_;
+  std::shared_ptr<RSocketStats> stats_;
+};
+
+} // namespace rsocket
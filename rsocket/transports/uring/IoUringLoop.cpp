@@ -0,0 +1,287 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/uring/IoUringLoop.h"
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <system_error>
+#include <vector>
+
+#include <folly/io/async/EventBaseLocal.h>
+#include <glog/logging.h>
+
+namespace rsocket {
+
+namespace {
+
+folly::EventBaseLocal<std::unique_ptr<IoUringLoop>>& loops() {
+  static auto* loops = new folly::EventBaseLocal<std::unique_ptr<IoUringLoop>>;
+  return *loops;
+}
+
+[[noreturn]] void throwSystemError(int error, const char* what) {
+  throw std::system_error(error, std::system_category(), what);
+}
+
+} // namespace
+
+struct IoUringLoop::ReceiveBuffers {
+  /// A receive buffer lent out, the user data of the IOBuf holding it.
+  struct Lent {
+    uint16_t id;
+
+    /// Keeps the memory alive until the IOBuf is freed.
+    std::shared_ptr<ReceiveBuffers> keepAlive;
+  };
+
+  ReceiveBuffers(IoUringLoop& owner, unsigned count, size_t bufferSize)
+      : memory(new uint8_t[count * bufferSize]),
+        size(bufferSize),
+        loop(&owner) {
+    lent.reserve(count);
+    for (unsigned id = 0; id < count; ++id) {
+      lent.push_back(Lent{static_cast<uint16_t>(id), nullptr});
+    }
+  }
+
+  uint8_t* buffer(uint16_t id) const {
+    return memory.get() + id * size;
+  }
+
+  /// The free function of the IOBufs, may run on any thread.
+  static void freeLent(void*, void* userData) {
+    auto const lent = static_cast<Lent*>(userData);
+    auto const id = lent->id;
+    auto const buffers = std::move(lent->keepAlive);
+
+    std::lock_guard<std::mutex> lock(buffers->mutex);
+    if (auto const loop = buffers->loop) {
+      if (loop->eventBase_.isInEventBaseThread()) {
+        loop->recycleReceiveBuffer(id);
+        --loop->lentReceiveBuffers_;
+        return;
+      }
+      loop->eventBase_.runInEventBaseThread([buffers, id] {
+        std::lock_guard<std::mutex> innerLock(buffers->mutex);
+        if (auto const innerLoop = buffers->loop) {
+          innerLoop->recycleReceiveBuffer(id);
+          --innerLoop->lentReceiveBuffers_;
+        }
+      });
+    }
+  }
+
+  const std::unique_ptr<uint8_t[]> memory;
+  const size_t size;
+  std::vector<Lent> lent;
+
+  /// Guards `loop`, which is null once the loop is gone.
+  std::mutex mutex;
+  IoUringLoop* loop;
+};
+
+IoUringLoop& IoUringLoop::get(folly::EventBase& evb, const Options& options) {
+  DCHECK(evb.isInEventBaseThread());
+  if (auto loop = loops().get(evb)) {
+    return **loop;
+  }
+  return *loops().emplace(evb, std::make_unique<IoUringLoop>(evb, options));
+}
+
+bool IoUringLoop::isAvailable() {
+  io_uring ring;
+  if (io_uring_queue_init(2, &ring, 0) != 0) {
+    return false;
+  }
+  io_uring_queue_exit(&ring);
+  return true;
+}
+
+IoUringLoop::IoUringLoop(folly::EventBase& evb, const Options& options)
+    : folly::EventHandler(&evb), eventBase_(evb), options_(options) {
+  CHECK_GT(options_.receiveBuffers, 0);
+  CHECK_EQ(options_.receiveBuffers & (options_.receiveBuffers - 1), 0)
+      << "The number of receive buffers must be a power of two";
+
+  if (auto const ret = io_uring_queue_init(options_.entries, &ring_, 0)) {
+    throwSystemError(-ret, "io_uring_queue_init");
+  }
+
+  eventFd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (eventFd_ < 0) {
+    auto const error = errno;
+    io_uring_queue_exit(&ring_);
+    throwSystemError(error, "eventfd");
+  }
+  if (auto const ret = io_uring_register_eventfd(&ring_, eventFd_)) {
+    ::close(eventFd_);
+    io_uring_queue_exit(&ring_);
+    throwSystemError(-ret, "io_uring_register_eventfd");
+  }
+
+  int ret = 0;
+  receiveBufferRing_ = io_uring_setup_buf_ring(
+      &ring_, options_.receiveBuffers, kReceiveBufferGroup, 0, &ret);
+  if (!receiveBufferRing_) {
+    ::close(eventFd_);
+    io_uring_queue_exit(&ring_);
+    throwSystemError(-ret, "io_uring_setup_buf_ring");
+  }
+  receiveBuffers_ = std::make_shared<ReceiveBuffers>(
+      *this, options_.receiveBuffers, options_.receiveBufferSize);
+  auto const mask = io_uring_buf_ring_mask(options_.receiveBuffers);
+  for (unsigned id = 0; id < options_.receiveBuffers; ++id) {
+    io_uring_buf_ring_add(
+        receiveBufferRing_,
+        receiveBuffers_->buffer(id),
+        options_.receiveBufferSize,
+        id,
+        mask,
+        id);
+  }
+  io_uring_buf_ring_advance(receiveBufferRing_, options_.receiveBuffers);
+
+  changeHandlerFD(folly::NetworkSocket::fromFd(eventFd_));
+  registerHandler(folly::EventHandler::READ | folly::EventHandler::PERSIST);
+
+  VLOG(2) << "Created io_uring with " << options_.entries << " entries and "
+          << options_.receiveBuffers << " receive buffers of "
+          << options_.receiveBufferSize << " bytes";
+}
+
+IoUringLoop::~IoUringLoop() {
+  {
+    // The buffers still lent out are freed along with their IOBufs.
+    std::lock_guard<std::mutex> lock(receiveBuffers_->mutex);
+    receiveBuffers_->loop = nullptr;
+  }
+  unregisterHandler();
+  cancelLoopCallback();
+  io_uring_free_buf_ring(
+      &ring_, receiveBufferRing_, options_.receiveBuffers, kReceiveBufferGroup);
+  io_uring_queue_exit(&ring_);
+  ::close(eventFd_);
+}
+
+io_uring_sqe* IoUringLoop::prepare(Operation* op) {
+  auto sqe = io_uring_get_sqe(&ring_);
+  if (!sqe) {
+    // The submission queue is full, make room right away.
+    submit();
+    sqe = io_uring_get_sqe(&ring_);
+    CHECK(sqe) << "io_uring submission queue is full";
+  }
+  io_uring_sqe_set_data(sqe, op);
+
+  if (!isLoopCallbackScheduled()) {
+    eventBase_.runInLoop(this, /* thisIteration */ true);
+  }
+  return sqe;
+}
+
+std::unique_ptr<folly::IOBuf> IoUringLoop::takeReceiveBuffer(
+    uint16_t id,
+    size_t length) {
+  DCHECK_LT(id, options_.receiveBuffers);
+  DCHECK_LE(length, options_.receiveBufferSize);
+  auto const buffer = receiveBuffers_->buffer(id);
+
+  // Lend at most three quarters of the buffers.
+  if ((lentReceiveBuffers_ + 1) * 4 > options_.receiveBuffers * 3) {
+    auto data = folly::IOBuf::copyBuffer(buffer, length);
+    recycleReceiveBuffer(id);
+    return data;
+  }
+
+  auto& lent = receiveBuffers_->lent[id];
+  DCHECK(!lent.keepAlive);
+  lent.keepAlive = receiveBuffers_;
+  ++lentReceiveBuffers_;
+  return folly::IOBuf::takeOwnership(
+      buffer,
+      options_.receiveBufferSize,
+      length,
+      &ReceiveBuffers::freeLent,
+      &lent);
+}
+
+void IoUringLoop::recycleReceiveBuffer(uint16_t id) {
+  io_uring_buf_ring_add(
+      receiveBufferRing_,
+      receiveBuffers_->buffer(id),
+      options_.receiveBufferSize,
+      id,
+      io_uring_buf_ring_mask(options_.receiveBuffers),
+      0);
+  io_uring_buf_ring_advance(receiveBufferRing_, 1);
+}
+
+void IoUringLoop::runLoopCallback() noexcept {
+  submit();
+}
+
+void IoUringLoop::submit() {
+  auto const ret = io_uring_submit(&ring_);
+  if (ret < 0) {
+    LOG(ERROR) << "io_uring_submit failed: " << std::strerror(-ret);
+  }
+}
+
+void IoUringLoop::handlerReady(uint16_t) noexcept {
+  uint64_t count;
+  while (::read(eventFd_, &count, sizeof(count)) == sizeof(count)) {
+  }
+  reapCompletions();
+}
+
+void IoUringLoop::reapCompletions() {
+  struct Completion {
+    Operation* op;
+    int result;
+    uint32_t flags;
+  };
+
+  io_uring_cqe* cqes[kCompletionBatch];
+  Completion completions[kCompletionBatch];
+
+  while (auto const count =
+             io_uring_peek_batch_cqe(&ring_, cqes, kCompletionBatch)) {
+    // Consume the batch before running any operation, which may submit or
+    // complete others.
+    for (unsigned i = 0; i < count; ++i) {
+      completions[i] = Completion{
+          static_cast<Operation*>(io_uring_cqe_get_data(cqes[i])),
+          cqes[i]->res,
+          cqes[i]->flags};
+    }
+    io_uring_cq_advance(&ring_, count);
+
+    for (unsigned i = 0; i < count; ++i) {
+      if (auto const op = completions[i].op) {
+        op->onCompletion(completions[i].result, completions[i].flags);
+      }
+    }
+
+    if (count < kCompletionBatch) {
+      break;
+    }
+  }
+}
+
+} // namespace rsocket
@@ -0,0 +1,128 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <liburing.h>
+
+#include <folly/io/IOBuf.h>
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/EventHandler.h>
+
+#include <memory>
+
+namespace rsocket {
+
+/// An io_uring driven by a folly::EventBase.
+///
+/// Operations queued during a loop iteration go to the kernel in a single
+/// io_uring_submit() at the end of the iteration.  The kernel signals
+/// completions through an eventfd the EventBase polls, and they are reaped in
+/// batches.
+///
+/// Multishot receives select their buffer from a ring of buffers provided to
+/// the kernel up front, so no buffer is tied up by an idle connection.  The
+/// received bytes are handed out in the buffer they were received into, which
+/// goes back to the ring once it is freed.
+///
+/// Must only be used from the thread of its EventBase.
+class IoUringLoop : private folly::EventHandler,
+                    private folly::EventBase::LoopCallback {
+ public:
+  struct Options {
+    /// Size of the submission queue.
+    unsigned entries{256};
+
+    /// Number of buffers the kernel picks from for multishot receives.  Must
+    /// be a power of two.
+    unsigned receiveBuffers{256};
+
+    /// Size of each receive buffer.
+    size_t receiveBufferSize{16 * 1024};
+  };
+
+  /// Waits for the completions of an operation.
+  class Operation {
+   public:
+    virtual ~Operation() = default;
+
+    /// Called with the result and the flags of each completion.  Multishot
+    /// operations complete several times, the last time without
+    /// IORING_CQE_F_MORE.
+    virtual void onCompletion(int result, uint32_t flags) noexcept = 0;
+  };
+
+  /// The loop of the EventBase, created with the given options on first use.
+  /// Must be called from the thread of the EventBase.
+  static IoUringLoop& get(folly::EventBase&, const Options& = Options());
+
+  /// Whether the kernel supports io_uring, and the process may use it.
+  static bool isAvailable();
+
+  IoUringLoop(folly::EventBase&, const Options&);
+  ~IoUringLoop() override;
+
+  IoUringLoop(const IoUringLoop&) = delete;
+  IoUringLoop& operator=(const IoUringLoop&) = delete;
+
+  /// Returns the submission queue entry of an operation reporting to `op`,
+  /// to be filled in by the caller.  A null `op` ignores the completion.
+  io_uring_sqe* prepare(Operation* op);
+
+  /// The group of provided buffers multishot receives select from.
+  uint16_t receiveBufferGroup() const {
+    return kReceiveBufferGroup;
+  }
+
+  /// The bytes the kernel received into a provided buffer, wrapped in an
+  /// IOBuf which hands the buffer back to the ring once it is freed, on any
+  /// thread.  While fewer than a quarter of the buffers are left to the
+  /// kernel, the bytes are copied out instead and the buffer goes back right
+  /// away, so that received data held on to can't starve the receives.
+  std::unique_ptr<folly::IOBuf> takeReceiveBuffer(uint16_t id, size_t length);
+
+  folly::EventBase& eventBase() const {
+    return eventBase_;
+  }
+
+ private:
+  static constexpr uint16_t kReceiveBufferGroup{0};
+  static constexpr unsigned kCompletionBatch{64};
+
+  void handlerReady(uint16_t events) noexcept override;
+  void runLoopCallback() noexcept override;
+
+  void submit();
+  void reapCompletions();
+
+  void recycleReceiveBuffer(uint16_t id);
+
+  folly::EventBase& eventBase_;
+  const Options options_;
+
+  io_uring ring_;
+  int eventFd_{-1};
+
+  io_uring_buf_ring* receiveBufferRing_{nullptr};
+
+  /// The memory of the receive buffers.  Shared with the IOBufs it is lent
+  /// out in, which may outlive the loop.
+  struct ReceiveBuffers;
+  std::shared_ptr<ReceiveBuffers> receiveBuffers_;
+
+  /// Receive buffers lent out in IOBufs, and not freed yet.
+  unsigned lentReceiveBuffers_{0};
+};
+
+} // namespace rsocket
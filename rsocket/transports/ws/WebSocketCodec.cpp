@@ -0,0 +1,399 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/ws/WebSocketCodec.h"
+
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include <folly/Random.h>
+#include <folly/io/Cursor.h>
+#include <glog/logging.h>
+
+namespace rsocket {
+
+using namespace yarpl::flowable;
+
+namespace {
+
+constexpr uint8_t kFinBit = 0x80;
+constexpr uint8_t kReservedBits = 0x70;
+constexpr uint8_t kControlBit = 0x08;
+constexpr uint8_t kOpcodeBits = 0x0F;
+constexpr uint8_t kMaskBit = 0x80;
+constexpr uint8_t kLengthBits = 0x7F;
+
+constexpr size_t kMaxHeaderLength = 14;
+constexpr size_t kMaxControlPayloadLength = 125;
+
+/// XORs every byte of the chain with the masking key, in place.  Masking and
+/// unmasking are the same operation.
+void applyMask(folly::IOBuf& chain, const uint8_t (&key)[4]) {
+  // Only the data range of each buffer is written to.  Buffers shared with
+  // the read queue hold other bytes outside of that range, which stay as they
+  // are.
+  size_t offset = 0;
+  auto buf = &chain;
+  do {
+    auto const data = buf->writableData();
+    for (size_t i = 0; i < buf->length(); ++i, ++offset) {
+      data[i] ^= key[offset & 3];
+    }
+    buf = buf->next();
+  } while (buf != &chain);
+}
+
+} // namespace
+
+std::unique_ptr<folly::IOBuf> encodeWebSocketFrame(
+    WebSocketOpcode opcode,
+    std::unique_ptr<folly::IOBuf> payload,
+    WebSocketRole role) {
+  if (!payload) {
+    payload = folly::IOBuf::create(0);
+  }
+  auto const length = payload->computeChainDataLength();
+  bool const masked = role == WebSocketRole::CLIENT;
+  uint8_t const maskBit = masked ? kMaskBit : 0;
+
+  uint8_t header[kMaxHeaderLength];
+  size_t headerLength = 0;
+  header[headerLength++] = kFinBit | static_cast<uint8_t>(opcode);
+  if (length < 126) {
+    header[headerLength++] = maskBit | static_cast<uint8_t>(length);
+  } else if (length <= 0xFFFF) {
+    header[headerLength++] = maskBit | 126;
+    header[headerLength++] = static_cast<uint8_t>(length >> 8);
+    header[headerLength++] = static_cast<uint8_t>(length);
+  } else {
+    header[headerLength++] = maskBit | 127;
+    for (int shift = 56; shift >= 0; shift -= 8) {
+      header[headerLength++] = static_cast<uint8_t>(length >> shift);
+    }
+  }
+
+  if (masked) {
+    uint8_t key[4];
+    auto const random = folly::Random::secureRand32();
+    std::memcpy(key, &random, sizeof(key));
+    std::memcpy(header + headerLength, key, sizeof(key));
+    headerLength += sizeof(key);
+
+    // The frame may be kept for resumption as well, it can't be scrambled.
+    if (payload->isShared()) {
+      auto copy = folly::IOBuf::create(length);
+      folly::io::Cursor(payload.get()).pull(copy->writableTail(), length);
+      copy->append(length);
+      payload = std::move(copy);
+    }
+    applyMask(*payload, key);
+  }
+
+  if (payload->headroom() >= headerLength && !payload->isSharedOne()) {
+    payload->prepend(headerLength);
+    std::memcpy(payload->writableData(), header, headerLength);
+    return payload;
+  }
+
+  auto frame = folly::IOBuf::createCombined(headerLength);
+  std::memcpy(frame->writableTail(), header, headerLength);
+  frame->append(headerLength);
+  frame->appendChain(std::move(payload));
+  return frame;
+}
+
+std::unique_ptr<folly::IOBuf> webSocketClosePayload(WebSocketCloseCode code) {
+  auto payload = folly::IOBuf::create(sizeof(uint16_t));
+  folly::io::Appender appender(payload.get(), /* do not grow */ 0);
+  appender.writeBE(static_cast<uint16_t>(code));
+  return payload;
+}
+
+void WebSocketReader::setInput(
+    std::shared_ptr<DuplexConnection::Subscriber> inner) {
+  CHECK(!inner_)
+      << "Must cancel original input to WebSocketReader before setting a new "
+      << "one";
+  inner_ = std::move(inner);
+  inner_->onSubscribe(shared_from_this());
+
+  // The connection may have ended before anyone was listening.
+  if (terminated_) {
+    if (auto subscriber = std::move(inner_)) {
+      subscriber->onComplete();
+    }
+  }
+}
+
+void WebSocketReader::onSubscribe(std::shared_ptr<Subscription> subscription) {
+  subscription_ = std::move(subscription);
+  subscription_->request(std::numeric_limits<int64_t>::max());
+}
+
+void WebSocketReader::onNext(std::unique_ptr<folly::IOBuf> data) {
+  queue_.append(std::move(data));
+  parseFrames();
+}
+
+void WebSocketReader::onComplete() {
+  terminated_ = true;
+  queue_.move();
+  fragments_.move();
+  auto subscription = std::move(subscription_);
+  if (auto subscriber = std::move(inner_)) {
+    // After this call the instance can be destroyed!
+    subscriber->onComplete();
+  }
+}
+
+void WebSocketReader::onError(folly::exception_wrapper ex) {
+  terminated_ = true;
+  queue_.move();
+  fragments_.move();
+  auto subscription = std::move(subscription_);
+  if (auto subscriber = std::move(inner_)) {
+    // After this call the instance can be destroyed!
+    subscriber->onError(std::move(ex));
+  }
+}
+
+void WebSocketReader::request(int64_t n) {
+  allowance_.add(n);
+  parseFrames();
+}
+
+void WebSocketReader::cancel() {
+  allowance_.consumeAll();
+  inner_ = nullptr;
+}
+
+void WebSocketReader::parseFrames() {
+  if (dispatching_) {
+    return;
+  }
+
+  // Delivering onNext can trigger termination and destroy this instance.
+  auto const self = shared_from_this();
+
+  dispatching_ = true;
+  while (allowance_.canConsume(1) && inner_ && parseFrame()) {
+  }
+  dispatching_ = false;
+}
+
+bool WebSocketReader::parseFrame() {
+  auto const available = queue_.chainLength();
+  size_t headerLength = 2;
+  if (available < headerLength) {
+    return false;
+  }
+
+  folly::io::Cursor cursor(queue_.front());
+  auto const first = cursor.read<uint8_t>();
+  auto const second = cursor.read<uint8_t>();
+
+  if (first & kReservedBits) {
+    fail(WebSocketCloseCode::PROTOCOL_ERROR, "WebSocket extension in use");
+    return false;
+  }
+  bool const fin = first & kFinBit;
+  bool const control = first & kControlBit;
+  auto const opcode = static_cast<WebSocketOpcode>(first & kOpcodeBits);
+
+  // Clients must mask every frame, servers must not mask any.
+  bool const masked = second & kMaskBit;
+  if (masked != (role_ == WebSocketRole::SERVER)) {
+    fail(
+        WebSocketCloseCode::PROTOCOL_ERROR,
+        masked ? "Masked WebSocket frame from the server"
+               : "Unmasked WebSocket frame from the client");
+    return false;
+  }
+
+  uint64_t length = second & kLengthBits;
+  if (length == 126) {
+    headerLength += sizeof(uint16_t);
+    if (available < headerLength) {
+      return false;
+    }
+    length = cursor.readBE<uint16_t>();
+  } else if (length == 127) {
+    headerLength += sizeof(uint64_t);
+    if (available < headerLength) {
+      return false;
+    }
+    length = cursor.readBE<uint64_t>();
+  }
+
+  uint8_t key[4];
+  if (masked) {
+    headerLength += sizeof(key);
+    if (available < headerLength) {
+      return false;
+    }
+    cursor.pull(key, sizeof(key));
+  }
+
+  if (control && (!fin || length > kMaxControlPayloadLength)) {
+    fail(WebSocketCloseCode::PROTOCOL_ERROR, "Invalid WebSocket control frame");
+    return false;
+  }
+  if (!control && length > kMaxMessageLength - fragments_.chainLength()) {
+    fail(WebSocketCloseCode::TOO_BIG, "WebSocket message is too big");
+    return false;
+  }
+  if (available - headerLength < length) {
+    // Need to accumulate more data.
+    return false;
+  }
+
+  queue_.trimStart(headerLength);
+  auto payload =
+      length > 0 ? queue_.split(length) : folly::IOBuf::create(0);
+  if (masked) {
+    applyMask(*payload, key);
+  }
+
+  if (control) {
+    handleControlFrame(opcode, std::move(payload));
+    return true;
+  }
+
+  switch (opcode) {
+    case WebSocketOpcode::BINARY:
+      if (inFragmentedMessage_) {
+        fail(
+            WebSocketCloseCode::PROTOCOL_ERROR,
+            "WebSocket message inside a fragmented message");
+        return false;
+      }
+      if (fin) {
+        deliver(std::move(payload));
+      } else {
+        inFragmentedMessage_ = true;
+        fragments_.append(std::move(payload));
+      }
+      return true;
+
+    case WebSocketOpcode::CONTINUATION:
+      if (!inFragmentedMessage_) {
+        fail(
+            WebSocketCloseCode::PROTOCOL_ERROR,
+            "WebSocket continuation frame outside of a message");
+        return false;
+      }
+      fragments_.append(std::move(payload));
+      if (fin) {
+        inFragmentedMessage_ = false;
+        auto message = fragments_.move();
+        deliver(message ? std::move(message) : folly::IOBuf::create(0));
+      }
+      return true;
+
+    case WebSocketOpcode::TEXT:
+      fail(
+          WebSocketCloseCode::UNSUPPORTED_DATA,
+          "RSocket frames must be sent as binary WebSocket messages");
+      return false;
+
+    default:
+      fail(WebSocketCloseCode::PROTOCOL_ERROR, "Unknown WebSocket opcode");
+      return false;
+  }
+}
+
+void WebSocketReader::deliver(std::unique_ptr<folly::IOBuf> message) {
+  CHECK(allowance_.tryConsume(1));
+  VLOG(4) << "parsed WebSocket message length="
+          << message->computeChainDataLength();
+  inner_->onNext(std::move(message));
+}
+
+void WebSocketReader::handleControlFrame(
+    WebSocketOpcode opcode,
+    std::unique_ptr<folly::IOBuf> payload) {
+  switch (opcode) {
+    case WebSocketOpcode::PING:
+      reply(WebSocketOpcode::PONG, std::move(payload));
+      break;
+
+    case WebSocketOpcode::PONG:
+      break;
+
+    case WebSocketOpcode::CLOSE: {
+      VLOG(3) << "WebSocket closed by the peer";
+      if (!closeSent_) {
+        // Echo the status code of the peer.
+        std::unique_ptr<folly::IOBuf> echo;
+        if (payload->computeChainDataLength() >= sizeof(uint16_t)) {
+          folly::io::Cursor cursor(payload.get());
+          echo = webSocketClosePayload(
+              static_cast<WebSocketCloseCode>(cursor.readBE<uint16_t>()));
+        }
+        reply(WebSocketOpcode::CLOSE, std::move(echo));
+        closeSent_ = true;
+      }
+      complete();
+      break;
+    }
+
+    default:
+      fail(WebSocketCloseCode::PROTOCOL_ERROR, "Unknown WebSocket opcode");
+      break;
+  }
+}
+
+void WebSocketReader::reply(
+    WebSocketOpcode opcode,
+    std::unique_ptr<folly::IOBuf> payload) {
+  if (auto output = output_.lock()) {
+    output->send(encodeWebSocketFrame(opcode, std::move(payload), role_));
+  }
+}
+
+void WebSocketReader::fail(WebSocketCloseCode code, std::string message) {
+  VLOG(1) << "error: " << message;
+
+  if (!closeSent_) {
+    reply(WebSocketOpcode::CLOSE, webSocketClosePayload(code));
+    closeSent_ = true;
+  }
+
+  terminated_ = true;
+  queue_.move();
+  fragments_.move();
+  if (auto subscription = std::move(subscription_)) {
+    subscription->cancel();
+  }
+  if (auto subscriber = std::move(inner_)) {
+    // After this call the instance can be destroyed!
+    subscriber->onError(std::runtime_error{std::move(message)});
+  }
+}
+
+void WebSocketReader::complete() {
+  terminated_ = true;
+  queue_.move();
+  fragments_.move();
+  if (auto subscription = std::move(subscription_)) {
+    subscription->cancel();
+  }
+  if (auto subscriber = std::move(inner_)) {
+    // After this call the instance can be destroyed!
+    subscriber->onComplete();
+  }
+}
+
+} // namespace rsocket
@@ -0,0 +1,145 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/io/IOBufQueue.h>
+
+#include <cstdint>
+#include <memory>
+
+#include "rsocket/DuplexConnection.h"
+#include "rsocket/internal/Allowance.h"
+#include "yarpl/flowable/Subscription.h"
+
+namespace rsocket {
+
+/// Which end of a WebSocket connection this is.  Clients mask the frames they
+/// send, servers don't (RFC 6455, section 5.3).
+enum class WebSocketRole { CLIENT, SERVER };
+
+enum class WebSocketOpcode : uint8_t {
+  CONTINUATION = 0x0,
+  TEXT = 0x1,
+  BINARY = 0x2,
+  CLOSE = 0x8,
+  PING = 0x9,
+  PONG = 0xA,
+};
+
+/// Close status codes of RFC 6455, section 7.4.1.
+enum class WebSocketCloseCode : uint16_t {
+  NORMAL = 1000,
+  PROTOCOL_ERROR = 1002,
+  UNSUPPORTED_DATA = 1003,
+  TOO_BIG = 1009,
+};
+
+/// Wraps `payload` in a single, final WebSocket frame.  The header goes in the
+/// headroom of the payload when there is enough of it.  A client masks the
+/// payload in place, or into a copy if the payload is shared.
+std::unique_ptr<folly::IOBuf> encodeWebSocketFrame(
+    WebSocketOpcode opcode,
+    std::unique_ptr<folly::IOBuf> payload,
+    WebSocketRole role);
+
+/// The payload of a close frame.
+std::unique_ptr<folly::IOBuf> webSocketClosePayload(WebSocketCloseCode code);
+
+/// Turns the bytes of a WebSocket connection back into the messages sent over
+/// it, one binary message per RSocket frame.
+///
+/// Messages are cut out of the received buffers, and unmasked in place, so
+/// they reach the subscriber without being copied.  Pings are answered and a
+/// close frame of the peer completes the input, replies go out through
+/// `output` for as long as it exists.
+class WebSocketReader : public DuplexConnection::Subscriber,
+                        public yarpl::flowable::Subscription,
+                        public std::enable_shared_from_this<WebSocketReader> {
+ public:
+  /// Largest message accepted, the largest frame RSocket can length-prefix.
+  static constexpr size_t kMaxMessageLength = 0xFFFFFF;
+
+  WebSocketReader(WebSocketRole role, std::weak_ptr<DuplexConnection> output)
+      : role_(role), output_(std::move(output)) {}
+
+  /// Set the inner subscriber which will be getting whole messages.
+  void setInput(std::shared_ptr<DuplexConnection::Subscriber>);
+
+  // Subscriber.
+
+  void onSubscribe(std::shared_ptr<yarpl::flowable::Subscription>) override;
+  void onNext(std::unique_ptr<folly::IOBuf>) override;
+  void onComplete() override;
+  void onError(folly::exception_wrapper) override;
+
+  // Subscription.
+
+  void request(int64_t) override;
+  void cancel() override;
+
+  /// Whether a close frame went out to the peer already.
+  bool closeSent() const {
+    return closeSent_;
+  }
+
+  /// Bytes received that don't form a complete message yet.
+  size_t bufferedBytes() const {
+    return queue_.chainLength() + fragments_.chainLength();
+  }
+
+ private:
+  void parseFrames();
+
+  /// Parses and handles the frame at the front of the queue.  Returns false
+  /// if it isn't complete yet, or the connection failed.
+  bool parseFrame();
+
+  void deliver(std::unique_ptr<folly::IOBuf> message);
+
+  void handleControlFrame(
+      WebSocketOpcode opcode,
+      std::unique_ptr<folly::IOBuf> payload);
+
+  /// Sends a frame to the peer, if the connection is still around.
+  void reply(WebSocketOpcode opcode, std::unique_ptr<folly::IOBuf> payload);
+
+  /// Closes the WebSocket with `code` and errors the inner subscriber.
+  void fail(WebSocketCloseCode code, std::string message);
+
+  void complete();
+
+  const WebSocketRole role_;
+  const std::weak_ptr<DuplexConnection> output_;
+
+  std::shared_ptr<yarpl::flowable::Subscription> subscription_;
+  std::shared_ptr<DuplexConnection::Subscriber> inner_;
+
+  Allowance allowance_;
+  bool dispatching_{false};
+
+  /// Whether a close frame went out already.
+  bool closeSent_{false};
+
+  /// Whether the input ended, or failed.
+  bool terminated_{false};
+
+  folly::IOBufQueue queue_{folly::IOBufQueue::cacheChainLength()};
+
+  /// The fragments received so far of a fragmented message.
+  folly::IOBufQueue fragments_{folly::IOBufQueue::cacheChainLength()};
+  bool inFragmentedMessage_{false};
+};
+
+} // namespace rsocket
@@ -0,0 +1,52 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/ws/WebSocketConnectionAcceptor.h"
+
+#include <glog/logging.h>
+
+#include "rsocket/transports/ws/WebSocketHandshake.h"
+
+namespace rsocket {
+
+WebSocketConnectionAcceptor::WebSocketConnectionAcceptor(Options options)
+    : tcp_(std::move(options.tcp)), path_(std::move(options.path)) {}
+
+WebSocketConnectionAcceptor::~WebSocketConnectionAcceptor() = default;
+
+void WebSocketConnectionAcceptor::start(OnDuplexConnectionAccept onAccept) {
+  tcp_.start([path = path_, onAccept = std::move(onAccept)](
+                 std::unique_ptr<DuplexConnection> connection,
+                 folly::EventBase& eventBase) {
+    acceptWebSocket(std::move(connection), eventBase, path)
+        .thenTry([onAccept, &eventBase](
+                     folly::Try<std::unique_ptr<DuplexConnection>> result) {
+          if (result.hasException()) {
+            VLOG(2) << "Dropping connection: " << result.exception().what();
+            return;
+          }
+          onAccept(std::move(result).value(), eventBase);
+        });
+  });
+}
+
+void WebSocketConnectionAcceptor::stop() {
+  tcp_.stop();
+}
+
+folly::Optional<uint16_t> WebSocketConnectionAcceptor::listeningPort() const {
+  return tcp_.listeningPort();
+}
+
+} // namespace rsocket
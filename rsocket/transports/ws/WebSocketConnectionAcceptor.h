@@ -0,0 +1,72 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <string>
+
+#include "rsocket/ConnectionAcceptor.h"
+#include "rsocket/transports/tcp/TcpConnectionAcceptor.h"
+
+namespace rsocket {
+
+/**
+ * WebSocket implementation of ConnectionAcceptor for use with
+ * RSocket::createServer
+ *
+ * Accepts TCP connections like TcpConnectionAcceptor, and hands them over as
+ * WebSocketDuplexConnections once their upgrade request is answered.  Lets
+ * browsers and edge clients reach the server without a proxy translating
+ * into TCP RSocket.
+ *
+ * Construction of this does nothing.  The `start` method kicks off work.
+ */
+class WebSocketConnectionAcceptor : public ConnectionAcceptor {
+ public:
+  struct Options {
+    /// Options of the TCP listener.
+    TcpConnectionAcceptor::Options tcp;
+
+    /// Path to accept WebSocket upgrades for.  Any path when empty.
+    std::string path;
+  };
+
+  explicit WebSocketConnectionAcceptor(Options);
+  ~WebSocketConnectionAcceptor();
+
+  // ConnectionAcceptor overrides.
+
+  /**
+   * Start accepting TCP connections, and upgrading them to WebSockets.
+   */
+  void start(OnDuplexConnectionAccept) override;
+
+  /**
+   * Stop accepting connections.
+   */
+  void stop() override;
+
+  /**
+   * Get the port being listened on.
+   */
+  folly::Optional<uint16_t> listeningPort() const override;
+
+ private:
+  TcpConnectionAcceptor tcp_;
+
+  /// Path to accept WebSocket upgrades for.
+  const std::string path_;
+};
+
+} // namespace rsocket
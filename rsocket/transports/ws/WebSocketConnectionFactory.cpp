@@ -0,0 +1,63 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/ws/WebSocketConnectionFactory.h"
+
+#include <folly/io/async/EventBase.h>
+
+#include "rsocket/transports/ws/WebSocketHandshake.h"
+
+namespace rsocket {
+
+WebSocketConnectionFactory::WebSocketConnectionFactory(
+    folly::EventBase& eventBase,
+    folly::SocketAddress address,
+    Options options)
+    : tcp_(
+          eventBase,
+          address,
+          std::move(options.sslContext),
+          std::move(options.connection)),
+      host_(options.host.empty() ? address.describe() : options.host),
+      path_(std::move(options.path)) {}
+
+WebSocketConnectionFactory::~WebSocketConnectionFactory() = default;
+
+folly::Future<ConnectionFactory::ConnectedDuplexConnection>
+WebSocketConnectionFactory::connect(
+    ProtocolVersion version,
+    ResumeStatus resume) {
+  return tcp_.connect(version, resume)
+      .thenValue([host = host_, path = path_](
+                     ConnectedDuplexConnection connected) mutable {
+        // The handshake has to run on the thread of the connection.
+        auto eventBase = &connected.eventBase;
+        return folly::via(
+            eventBase,
+            [connection = std::move(connected.connection),
+             eventBase,
+             host = std::move(host),
+             path = std::move(path)]() mutable {
+              return connectWebSocket(
+                         std::move(connection), *eventBase, host, path)
+                  .thenValue(
+                      [eventBase](std::unique_ptr<DuplexConnection> ws) {
+                        return ConnectedDuplexConnection{
+                            std::move(ws), *eventBase};
+                      });
+            });
+      });
+}
+
+} // namespace rsocket
@@ -0,0 +1,72 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/SocketAddress.h>
+
+#include <string>
+
+#include "rsocket/ConnectionFactory.h"
+#include "rsocket/transports/tcp/TcpConnectionFactory.h"
+
+namespace rsocket {
+
+/**
+ * WebSocket implementation of ConnectionFactory for use with
+ * RSocket::createClient().
+ *
+ * Connects over TCP, or TLS when given an SSLContext, and upgrades the
+ * connection to a WebSocket.
+ *
+ * Creation of this does nothing.  The `connect` method kicks off work.
+ */
+class WebSocketConnectionFactory : public ConnectionFactory {
+ public:
+  struct Options {
+    /// Host the upgrade request is for.  The address when empty.
+    std::string host;
+
+    /// Path the upgrade request is for.
+    std::string path{"/"};
+
+    /// Connect over TLS (wss://) when set.
+    std::shared_ptr<folly::SSLContext> sslContext;
+
+    /// Options of the underlying TcpDuplexConnection.
+    TcpDuplexConnection::Options connection;
+  };
+
+  WebSocketConnectionFactory(
+      folly::EventBase& eventBase,
+      folly::SocketAddress address,
+      Options options = Options());
+  ~WebSocketConnectionFactory() override;
+
+  /**
+   * Connect to server defined in constructor.
+   *
+   * Each call to connect() creates a new TCP connection.
+   */
+  folly::Future<ConnectedDuplexConnection> connect(
+      ProtocolVersion,
+      ResumeStatus resume) override;
+
+ private:
+  TcpConnectionFactory tcp_;
+  const std::string host_;
+  const std::string path_;
+};
+
+} // namespace rsocket
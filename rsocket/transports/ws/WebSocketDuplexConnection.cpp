@@ -0,0 +1,82 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/ws/WebSocketDuplexConnection.h"
+
+namespace rsocket {
+
+WebSocketDuplexConnection::WebSocketDuplexConnection(
+    std::unique_ptr<DuplexConnection> connection,
+    WebSocketRole role,
+    std::unique_ptr<folly::IOBuf> initialInput,
+    std::shared_ptr<RSocketStats> stats)
+    : inner_(std::move(connection)),
+      role_(role),
+      inputReader_(std::make_shared<WebSocketReader>(role_, inner_)),
+      stats_(std::move(stats)) {
+  if (stats_) {
+    stats_->duplexConnectionCreated("websocket", this);
+  }
+  inner_->setInput(inputReader_);
+  if (initialInput) {
+    inputReader_->onNext(std::move(initialInput));
+  }
+}
+
+WebSocketDuplexConnection::~WebSocketDuplexConnection() {
+  if (stats_) {
+    stats_->duplexConnectionClosed("websocket", this);
+  }
+  if (!inputReader_->closeSent()) {
+    inner_->send(encodeWebSocketFrame(
+        WebSocketOpcode::CLOSE,
+        webSocketClosePayload(WebSocketCloseCode::NORMAL),
+        role_));
+  }
+}
+
+void WebSocketDuplexConnection::send(std::unique_ptr<folly::IOBuf> buf) {
+  inner_->send(
+      encodeWebSocketFrame(WebSocketOpcode::BINARY, std::move(buf), role_));
+}
+
+void WebSocketDuplexConnection::sendBatch(
+    std::vector<std::unique_ptr<folly::IOBuf>> bufs) {
+  if (bufs.empty()) {
+    return;
+  }
+
+  std::unique_ptr<folly::IOBuf> chain;
+  for (auto& buf : bufs) {
+    auto message =
+        encodeWebSocketFrame(WebSocketOpcode::BINARY, std::move(buf), role_);
+    if (chain) {
+      chain->prependChain(std::move(message));
+    } else {
+      chain = std::move(message);
+    }
+  }
+  inner_->send(std::move(chain));
+}
+
+size_t WebSocketDuplexConnection::bufferedInputBytes() const {
+  return inputReader_->bufferedBytes();
+}
+
+void WebSocketDuplexConnection::setInput(
+    std::shared_ptr<DuplexConnection::Subscriber> framesSink) {
+  inputReader_->setInput(std::move(framesSink));
+}
+
+} // namespace rsocket
@@ -0,0 +1,67 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+
+#include "rsocket/DuplexConnection.h"
+#include "rsocket/RSocketStats.h"
+#include "rsocket/transports/ws/WebSocketCodec.h"
+
+namespace rsocket {
+
+/// A DuplexConnection over a WebSocket, carrying each RSocket frame in one
+/// binary message as the RSocket WebSocket transport does.  The messages
+/// delimit the frames, so they don't get a frame length field.
+///
+/// Runs on top of another DuplexConnection carrying the bytes of the
+/// WebSocket connection, usually a TcpDuplexConnection, once the opening
+/// handshake is done (see WebSocketHandshake.h).  Received messages are
+/// handed to the input subscriber in the buffers they were read into.
+class WebSocketDuplexConnection : public DuplexConnection {
+ public:
+  /// `initialInput` holds bytes that were received right after the opening
+  /// handshake, if any.  Takes over the input of `connection` right away, so
+  /// nothing received before setInput() is lost.
+  WebSocketDuplexConnection(
+      std::unique_ptr<DuplexConnection> connection,
+      WebSocketRole role,
+      std::unique_ptr<folly::IOBuf> initialInput = nullptr,
+      std::shared_ptr<RSocketStats> stats = RSocketStats::noop());
+
+  /// Sends a close frame, unless one went out already, and closes the
+  /// underlying connection.
+  ~WebSocketDuplexConnection();
+
+  void send(std::unique_ptr<folly::IOBuf>) override;
+
+  void sendBatch(std::vector<std::unique_ptr<folly::IOBuf>>) override;
+
+  void setInput(std::shared_ptr<DuplexConnection::Subscriber>) override;
+
+  size_t bufferedInputBytes() const override;
+
+  bool isFramed() const override {
+    return true;
+  }
+
+ private:
+  const std::shared_ptr<DuplexConnection> inner_;
+  const WebSocketRole role_;
+  const std::shared_ptr<WebSocketReader> inputReader_;
+  std::shared_ptr<RSocketStats> stats_;
+};
+
+} // namespace rsocket
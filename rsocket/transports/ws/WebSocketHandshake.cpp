@@ -0,0 +1,355 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rsocket/transports/ws/WebSocketHandshake.h"
+
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <folly/Conv.h>
+#include <folly/Optional.h>
+#include <folly/Random.h>
+#include <folly/String.h>
+#include <folly/io/async/EventBase.h>
+#include <glog/logging.h>
+
+#include "rsocket/transports/ws/WebSocketDuplexConnection.h"
+
+namespace rsocket {
+
+namespace {
+
+constexpr folly::StringPiece kAcceptGuid{
+    "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"};
+constexpr folly::StringPiece kHeadEnd{"\r\n\r\n"};
+constexpr folly::StringPiece kSubprotocol{"rsocket"};
+
+/// Upgrade requests and responses are small, anything longer is refused.
+constexpr size_t kMaxHeadLength = 8192;
+
+std::string base64(const uint8_t* data, size_t length) {
+  std::string encoded(4 * ((length + 2) / 3), '\0');
+  auto const written = EVP_EncodeBlock(
+      reinterpret_cast<unsigned char*>(&encoded[0]),
+      data,
+      static_cast<int>(length));
+  encoded.resize(written);
+  return encoded;
+}
+
+bool equalsIgnoreCase(folly::StringPiece a, folly::StringPiece b) {
+  return a.equals(b, folly::AsciiCaseInsensitive());
+}
+
+/// The start line and header fields of an HTTP request or response.
+struct HttpHead {
+  std::vector<folly::StringPiece> startLine;
+  std::vector<std::pair<folly::StringPiece, folly::StringPiece>> fields;
+
+  folly::Optional<folly::StringPiece> field(folly::StringPiece name) const {
+    for (auto const& field : fields) {
+      if (equalsIgnoreCase(field.first, name)) {
+        return field.second;
+      }
+    }
+    return folly::none;
+  }
+
+  bool fieldEquals(folly::StringPiece name, folly::StringPiece value) const {
+    auto const actual = field(name);
+    return actual && *actual == value;
+  }
+
+  /// Whether a field holding a comma-separated list contains `token`.
+  bool fieldHasToken(folly::StringPiece name, folly::StringPiece token) const {
+    auto const value = field(name);
+    if (!value) {
+      return false;
+    }
+    std::vector<folly::StringPiece> tokens;
+    folly::split(',', *value, tokens);
+    for (auto const candidate : tokens) {
+      if (equalsIgnoreCase(folly::trimWhitespace(candidate), token)) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+folly::Optional<HttpHead> parseHttpHead(folly::StringPiece text) {
+  std::vector<folly::StringPiece> lines;
+  folly::split("\r\n", text, lines);
+  if (lines.empty()) {
+    return folly::none;
+  }
+
+  HttpHead head;
+  folly::split(' ', lines[0], head.startLine, /* ignoreEmpty */ true);
+  if (head.startLine.size() < 3) {
+    return folly::none;
+  }
+
+  for (size_t i = 1; i < lines.size(); ++i) {
+    auto const line = lines[i];
+    if (line.empty()) {
+      continue;
+    }
+    auto const colon = line.find(':');
+    if (colon == folly::StringPiece::npos) {
+      return folly::none;
+    }
+    head.fields.emplace_back(
+        folly::trimWhitespace(line.subpiece(0, colon)),
+        folly::trimWhitespace(line.subpiece(colon + 1)));
+  }
+  return head;
+}
+
+/// Reads the HTTP head of the opening handshake off a connection, then puts a
+/// WebSocketDuplexConnection on top of the connection.  Keeps itself alive
+/// through the subscription of the connection until then.
+class HandshakeReader : public DuplexConnection::Subscriber,
+                        public std::enable_shared_from_this<HandshakeReader> {
+ public:
+  HandshakeReader(
+      std::unique_ptr<DuplexConnection> connection,
+      folly::EventBase& eventBase,
+      WebSocketRole role)
+      : connection_(std::move(connection)),
+        eventBase_(eventBase),
+        role_(role) {}
+
+  /// Server side: answers an upgrade request for `path`.
+  folly::Future<std::unique_ptr<DuplexConnection>> accept(std::string path) {
+    path_ = std::move(path);
+    return start();
+  }
+
+  /// Client side: sends an upgrade request for `path` on `host`.
+  folly::Future<std::unique_ptr<DuplexConnection>> connect(
+      folly::StringPiece host,
+      folly::StringPiece path) {
+    uint8_t nonce[16];
+    folly::Random::secureRandom(nonce, sizeof(nonce));
+    auto const key = base64(nonce, sizeof(nonce));
+    expectedAccept_ = webSocketAcceptKey(key);
+
+    auto future = start();
+    connection_->send(folly::IOBuf::copyBuffer(folly::to<std::string>(
+        "GET ",
+        path.empty() ? folly::StringPiece{"/"} : path,
+        " HTTP/1.1\r\n",
+        "Host: ",
+        host,
+        "\r\n",
+        "Upgrade: websocket\r\n",
+        "Connection: Upgrade\r\n",
+        "Sec-WebSocket-Key: ",
+        key,
+        "\r\n",
+        "Sec-WebSocket-Version: 13\r\n",
+        "Sec-WebSocket-Protocol: ",
+        kSubprotocol,
+        "\r\n\r\n")));
+    return future;
+  }
+
+  void onSubscribe(
+      std::shared_ptr<yarpl::flowable::Subscription> subscription) override {
+    subscription_ = std::move(subscription);
+    subscription_->request(std::numeric_limits<int64_t>::max());
+  }
+
+  void onNext(std::unique_ptr<folly::IOBuf> data) override {
+    // Finishing the handshake drops the reference held by the connection.
+    auto const self = shared_from_this();
+    if (!connection_) {
+      return;
+    }
+
+    for (auto const range : *data) {
+      head_.append(reinterpret_cast<const char*>(range.data()), range.size());
+    }
+
+    auto const end = head_.find(kHeadEnd.data());
+    if (end == std::string::npos) {
+      if (head_.size() > kMaxHeadLength) {
+        fail("WebSocket handshake is too long");
+      }
+      return;
+    }
+
+    auto const headLength = end + kHeadEnd.size();
+    auto const head =
+        parseHttpHead(folly::StringPiece(head_).subpiece(0, headLength));
+    if (!head) {
+      fail("Malformed WebSocket handshake");
+      return;
+    }
+    if (role_ == WebSocketRole::SERVER) {
+      answerRequest(*head);
+    } else {
+      checkResponse(*head);
+    }
+    if (!connection_) {
+      return;
+    }
+
+    // Whatever came after the head already belongs to the WebSocket.
+    std::unique_ptr<folly::IOBuf> rest;
+    if (head_.size() > headLength) {
+      rest = folly::IOBuf::copyBuffer(
+          head_.data() + headLength, head_.size() - headLength);
+    }
+
+    if (auto subscription = std::move(subscription_)) {
+      subscription->cancel();
+    }
+    promise_.setValue(std::make_unique<WebSocketDuplexConnection>(
+        std::move(connection_), role_, std::move(rest)));
+  }
+
+  void onComplete() override {
+    subscription_ = nullptr;
+    fail("Connection closed during the WebSocket handshake");
+  }
+
+  void onError(folly::exception_wrapper ew) override {
+    subscription_ = nullptr;
+    fail(folly::to<std::string>(
+        "Connection failed during the WebSocket handshake: ", ew.what()));
+  }
+
+ private:
+  folly::Future<std::unique_ptr<DuplexConnection>> start() {
+    auto future = promise_.getFuture();
+    connection_->setInput(shared_from_this());
+    return future;
+  }
+
+  void answerRequest(const HttpHead& request) {
+    auto const& line = request.startLine;
+    auto const target = line[1].subpiece(0, line[1].find('?'));
+    auto const key = request.field("Sec-WebSocket-Key");
+
+    if (line[0] != "GET" || (!path_.empty() && target != path_) ||
+        !request.fieldHasToken("Upgrade", "websocket") ||
+        !request.fieldHasToken("Connection", "upgrade") ||
+        !request.fieldEquals("Sec-WebSocket-Version", "13") ||
+        !key) {
+      connection_->send(folly::IOBuf::copyBuffer(
+          "HTTP/1.1 400 Bad Request\r\n"
+          "Connection: close\r\n"
+          "Content-Length: 0\r\n\r\n"));
+      fail(folly::to<std::string>(
+          "Invalid WebSocket upgrade request for ", target));
+      return;
+    }
+
+    std::string subprotocol;
+    if (request.fieldHasToken("Sec-WebSocket-Protocol", kSubprotocol)) {
+      subprotocol = folly::to<std::string>(
+          "Sec-WebSocket-Protocol: ", kSubprotocol, "\r\n");
+    }
+    connection_->send(folly::IOBuf::copyBuffer(folly::to<std::string>(
+        "HTTP/1.1 101 Switching Protocols\r\n",
+        "Upgrade: websocket\r\n",
+        "Connection: Upgrade\r\n",
+        "Sec-WebSocket-Accept: ",
+        webSocketAcceptKey(*key),
+        "\r\n",
+        subprotocol,
+        "\r\n")));
+  }
+
+  void checkResponse(const HttpHead& response) {
+    if (response.startLine[1] != "101") {
+      fail(folly::to<std::string>(
+          "WebSocket upgrade refused with status ", response.startLine[1]));
+      return;
+    }
+    if (!response.fieldHasToken("Upgrade", "websocket") ||
+        !response.fieldEquals("Sec-WebSocket-Accept", expectedAccept_)) {
+      fail("Invalid WebSocket upgrade response");
+    }
+  }
+
+  void fail(std::string message) {
+    VLOG(2) << message;
+    if (auto subscription = std::move(subscription_)) {
+      subscription->cancel();
+    }
+    if (auto connection = std::move(connection_)) {
+      // The connection may be calling into this right now, so it has to go
+      // away later.
+      eventBase_.runInLoop([connection = std::move(connection)] {});
+      promise_.setException(std::runtime_error(std::move(message)));
+    }
+  }
+
+  std::unique_ptr<DuplexConnection> connection_;
+  folly::EventBase& eventBase_;
+  const WebSocketRole role_;
+  folly::Promise<std::unique_ptr<DuplexConnection>> promise_;
+  std::shared_ptr<yarpl::flowable::Subscription> subscription_;
+
+  /// The bytes received so far.
+  std::string head_;
+
+  /// Server side: path to accept upgrades for.
+  std::string path_;
+
+  /// Client side: the Sec-WebSocket-Accept value the server must answer with.
+  std::string expectedAccept_;
+};
+
+} // namespace
+
+folly::Future<std::unique_ptr<DuplexConnection>> acceptWebSocket(
+    std::unique_ptr<DuplexConnection> connection,
+    folly::EventBase& eventBase,
+    std::string path) {
+  DCHECK(eventBase.isInEventBaseThread());
+  auto reader = std::make_shared<HandshakeReader>(
+      std::move(connection), eventBase, WebSocketRole::SERVER);
+  return reader->accept(std::move(path));
+}
+
+folly::Future<std::unique_ptr<DuplexConnection>> connectWebSocket(
+    std::unique_ptr<DuplexConnection> connection,
+    folly::EventBase& eventBase,
+    std::string host,
+    std::string path) {
+  DCHECK(eventBase.isInEventBaseThread());
+  auto reader = std::make_shared<HandshakeReader>(
+      std::move(connection), eventBase, WebSocketRole::CLIENT);
+  return reader->connect(host, path);
+}
+
+std::string webSocketAcceptKey(folly::StringPiece key) {
+  auto const input = folly::to<std::string>(key, kAcceptGuid);
+  uint8_t digest[SHA_DIGEST_LENGTH];
+  SHA1(reinterpret_cast<const unsigned char*>(input.data()),
+       input.size(),
+       digest);
+  return base64(digest, sizeof(digest));
+}
+
+} // namespace rsocket
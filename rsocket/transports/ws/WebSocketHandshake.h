@@ -0,0 +1,59 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/Range.h>
+#include <folly/futures/Future.h>
+
+#include <memory>
+#include <string>
+
+#include "rsocket/DuplexConnection.h"
+
+namespace folly {
+class EventBase;
+}
+
+namespace rsocket {
+
+/// Runs the server side of the WebSocket opening handshake over `connection`,
+/// which carries the bytes of an HTTP/1.1 connection.
+///
+/// Resolves with a WebSocketDuplexConnection on top of `connection` once the
+/// upgrade request is answered.  A request that isn't a WebSocket upgrade, or
+/// is for another path than `path` (if not empty), gets a 400 response and
+/// fails the future.  Must be called on the thread of `eventBase`, the one of
+/// `connection`.
+folly::Future<std::unique_ptr<DuplexConnection>> acceptWebSocket(
+    std::unique_ptr<DuplexConnection> connection,
+    folly::EventBase& eventBase,
+    std::string path);
+
+/// Runs the client side of the WebSocket opening handshake over `connection`,
+/// asking for `path` on `host`.
+///
+/// Resolves with a WebSocketDuplexConnection on top of `connection` once the
+/// server accepted the upgrade.  Must be called on the thread of `eventBase`,
+/// the one of `connection`.
+folly::Future<std::unique_ptr<DuplexConnection>> connectWebSocket(
+    std::unique_ptr<DuplexConnection> connection,
+    folly::EventBase& eventBase,
+    std::string host,
+    std::string path);
+
+/// The Sec-WebSocket-Accept value answering a Sec-WebSocket-Key.
+std::string webSocketAcceptKey(folly::StringPiece key);
+
+} // namespace rsocket
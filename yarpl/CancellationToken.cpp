@@ -0,0 +1,220 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "yarpl/CancellationToken.h"
+
+#include <atomic>
+#include <mutex>
+
+namespace yarpl {
+namespace details {
+
+/// The state holds the generation of the slot, shifted left by one, and the
+/// kClaimed bit.  Whoever sets kClaimed, a token cancelling or the owner
+/// releasing, recycles the slot under the next generation, which disposes
+/// the tokens of the previous one.
+struct CancellationSlot {
+  static constexpr uint64_t kClaimed = 1;
+
+  std::atomic<uint64_t> state{0};
+  std::weak_ptr<void> target;
+  void (*cancel)(void*){nullptr};
+  CancellationSlot* next{nullptr};
+};
+
+} // namespace details
+
+namespace {
+
+using details::CancellationSlot;
+
+constexpr size_t kSlotsPerChunk = 256;
+constexpr size_t kMaxCachedSlots = 128;
+
+/// Slots are never freed, as tokens may point to them for ever.
+class SlotPool {
+ public:
+  static SlotPool& instance() {
+    static auto pool = new SlotPool;
+    return *pool;
+  }
+
+  /// Takes up to `count` free slots, allocating a chunk if there are none.
+  CancellationSlot* take(size_t count, size_t& taken) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!head_) {
+      auto chunk = new CancellationSlot[kSlotsPerChunk];
+      for (size_t i = 0; i < kSlotsPerChunk; ++i) {
+        chunk[i].next = head_;
+        head_ = &chunk[i];
+      }
+    }
+    auto first = head_;
+    auto last = head_;
+    taken = 1;
+    while (taken < count && last->next) {
+      last = last->next;
+      ++taken;
+    }
+    head_ = last->next;
+    last->next = nullptr;
+    return first;
+  }
+
+  /// Gives back a list of slots.
+  void give(CancellationSlot* first) {
+    auto last = first;
+    while (last->next) {
+      last = last->next;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    last->next = head_;
+    head_ = first;
+  }
+
+ private:
+  std::mutex mutex_;
+  CancellationSlot* head_{nullptr};
+};
+
+/// Trivially destructible, so that slots recycled while other thread_locals
+/// are destroyed still find it.  The Reaper gives the cached slots back at
+/// thread exit, and makes later slots bypass the cache.
+struct FreeSlots {
+  CancellationSlot* head;
+  size_t count;
+  bool dead;
+};
+
+FreeSlots& freeSlots() {
+  static thread_local FreeSlots slots{nullptr, 0, false};
+  return slots;
+}
+
+struct Reaper {
+  ~Reaper() {
+    auto& slots = freeSlots();
+    if (slots.head) {
+      SlotPool::instance().give(slots.head);
+    }
+    slots.head = nullptr;
+    slots.count = 0;
+    slots.dead = true;
+  }
+};
+
+/// Registers the thread's Reaper the first time it caches a slot.
+void reaper() {
+  static thread_local Reaper reaper;
+  (void)reaper;
+}
+
+CancellationSlot* acquireSlot() {
+  auto& slots = freeSlots();
+  if (slots.dead) {
+    size_t taken;
+    return SlotPool::instance().take(1, taken);
+  }
+  if (!slots.head) {
+    reaper();
+    slots.head = SlotPool::instance().take(kMaxCachedSlots / 2, slots.count);
+  }
+  auto slot = slots.head;
+  slots.head = slot->next;
+  slot->next = nullptr;
+  --slots.count;
+  return slot;
+}
+
+/// Recycles a slot claimed under `generation`.
+void recycleSlot(CancellationSlot* slot, uint64_t generation) {
+  slot->target.reset();
+  slot->cancel = nullptr;
+  slot->state.store((generation + 1) << 1, std::memory_order_release);
+
+  auto& slots = freeSlots();
+  if (slots.dead) {
+    SlotPool::instance().give(slot);
+    return;
+  }
+  reaper();
+  slot->next = slots.head;
+  slots.head = slot;
+  if (++slots.count > kMaxCachedSlots) {
+    // Slots recycled on a thread other than the one that acquired them
+    // would otherwise pile up in its cache.
+    auto last = slot;
+    for (size_t i = 1; i < kMaxCachedSlots / 2; ++i) {
+      last = last->next;
+    }
+    slots.head = last->next;
+    last->next = nullptr;
+    slots.count -= kMaxCachedSlots / 2;
+    SlotPool::instance().give(slot);
+  }
+}
+
+/// Sets kClaimed, if the slot still is in `generation`.
+bool claimSlot(CancellationSlot* slot, uint64_t generation) {
+  auto expected = generation << 1;
+  return slot->state.compare_exchange_strong(
+      expected,
+      expected | CancellationSlot::kClaimed,
+      std::memory_order_acq_rel);
+}
+
+} // namespace
+
+void CancellationToken::dispose() {
+  if (!slot_ || !claimSlot(slot_, generation_)) {
+    return;
+  }
+  // The owner can't release the slot while it's claimed, so the target
+  // can't be replaced under us.
+  if (auto target = slot_->target.lock()) {
+    slot_->cancel(target.get());
+  }
+  recycleSlot(slot_, generation_);
+}
+
+bool CancellationToken::isDisposed() const {
+  return !slot_ ||
+      slot_->state.load(std::memory_order_acquire) != generation_ << 1;
+}
+
+CancellationRegistration::CancellationRegistration(
+    std::weak_ptr<void> target,
+    void (*cancel)(void*))
+    : slot_(acquireSlot()) {
+  generation_ = slot_->state.load(std::memory_order_relaxed) >> 1;
+  slot_->target = std::move(target);
+  slot_->cancel = cancel;
+  // Publishes the target to the tokens.
+  slot_->state.store(generation_ << 1, std::memory_order_release);
+}
+
+void CancellationRegistration::release() {
+  auto slot = slot_;
+  if (!slot) {
+    return;
+  }
+  slot_ = nullptr;
+  // If a token claimed the slot first, it recycles the slot once it is done
+  // cancelling, which may well be what got us here.
+  if (claimSlot(slot, generation_)) {
+    recycleSlot(slot, generation_);
+  }
+}
+
+} // namespace yarpl
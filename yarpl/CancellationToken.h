@@ -0,0 +1,115 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+namespace yarpl {
+
+namespace details {
+struct CancellationSlot;
+} // namespace details
+
+/**
+ * A cheap handle to cancel a subscription, in place of a Disposable.
+ *
+ * A token is two words, copied by value.  It points to a slot in a
+ * process-wide slab of cancellation slots, which are recycled without
+ * allocating.  So tokens don't keep anything alive, and are safe to use
+ * after the subscription terminated: a token of a terminated or cancelled
+ * subscription is disposed, and dispose() does nothing.
+ */
+class CancellationToken {
+ public:
+  /// A token that is already disposed.
+  CancellationToken() = default;
+
+  /**
+   * Cancels the subscription, unless it already terminated.  Idempotent,
+   * and may be called from any thread.
+   */
+  void dispose();
+
+  /**
+   * Returns true once the subscription was cancelled or terminated.
+   */
+  bool isDisposed() const;
+
+ private:
+  friend class CancellationRegistration;
+
+  CancellationToken(details::CancellationSlot* slot, uint64_t generation)
+      : slot_(slot), generation_(generation) {}
+
+  details::CancellationSlot* slot_{nullptr};
+  uint64_t generation_{0};
+};
+
+/**
+ * Holds a cancellation slot on behalf of whatever a CancellationToken
+ * cancels, e.g. a subscriber.  The owner must release() the slot once it
+ * terminated, or destroy the registration, after which its tokens are
+ * disposed.
+ */
+class CancellationRegistration {
+ public:
+  CancellationRegistration() = default;
+
+  /// Tokens call `target->cancel()`, while `target` is still alive.
+  template <typename Target>
+  explicit CancellationRegistration(const std::shared_ptr<Target>& target)
+      : CancellationRegistration(
+            std::weak_ptr<void>(target),
+            [](void* ptr) { static_cast<Target*>(ptr)->cancel(); }) {}
+
+  CancellationRegistration(std::weak_ptr<void> target, void (*cancel)(void*));
+
+  CancellationRegistration(CancellationRegistration&& other) noexcept
+      : slot_(other.slot_), generation_(other.generation_) {
+    other.slot_ = nullptr;
+  }
+
+  CancellationRegistration& operator=(CancellationRegistration&& other) {
+    if (this != &other) {
+      release();
+      slot_ = other.slot_;
+      generation_ = other.generation_;
+      other.slot_ = nullptr;
+    }
+    return *this;
+  }
+
+  ~CancellationRegistration() {
+    release();
+  }
+
+  explicit operator bool() const {
+    return slot_ != nullptr;
+  }
+
+  CancellationToken token() const {
+    return CancellationToken(slot_, generation_);
+  }
+
+  /// Disposes the tokens, and recycles the slot.  Idempotent.
+  void release();
+
+ private:
+  details::CancellationSlot* slot_{nullptr};
+  uint64_t generation_{0};
+};
+
+} // namespace yarpl
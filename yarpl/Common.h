@@ -14,11 +14,57 @@
 
 #pragma once
 
+#include <cstddef>
 #include <memory>
 #include <stdexcept>
+#include <type_traits>
+#include <utility>
 
 namespace yarpl {
 
+namespace details {
+
+// How operators that hand the same value to several subscribers copy it.
+// Types with a `T clone() const`, like rsocket::Payload, are cloned, which is
+// expected to share their buffers rather than copy them.
+template <typename T, typename = void>
+struct ValueCopy {
+  static T copy(const T& value) {
+    return value;
+  }
+};
+
+template <typename T>
+struct ValueCopy<
+    T,
+    std::enable_if_t<
+        std::is_same<decltype(std::declval<const T&>().clone()), T>::value>> {
+  static T copy(const T& value) {
+    return value.clone();
+  }
+};
+
+// How operators that keep values for a long time, like Flowable::replay(),
+// prepare them.  Types with a `void compact()`, like rsocket::Payload, are
+// compacted, which is expected to let go of the larger buffers they only
+// hold slices of.
+template <typename T, typename = void>
+struct ValueRetain {
+  static void retain(T&) {}
+};
+
+template <typename T>
+struct ValueRetain<
+    T,
+    std::enable_if_t<
+        std::is_void<decltype(std::declval<T&>().compact())>::value>> {
+  static void retain(T& value) {
+    value.compact();
+  }
+};
+
+} // namespace details
+
 namespace observable {
 template <typename T>
 class Observable;
@@ -50,6 +96,16 @@ enum class BackpressureStrategy {
   MISSING // OnNext events are written without any buffering or dropping.
 };
 
+/**
+ * What a bounded BUFFER strategy does with a value that arrives while its
+ * buffer is full.
+ */
+enum class BufferOverflowPolicy {
+  ERROR, // Signals a MissingBackpressureException and cancels the upstream.
+  DROP_OLDEST, // Drops the oldest buffered value to make room for the new one.
+  DROP_NEWEST // Drops the value that just arrived.
+};
+
 template <typename T>
 class IBackpressureStrategy {
  public:
@@ -60,6 +116,10 @@ class IBackpressureStrategy {
       std::shared_ptr<flowable::Subscriber<T>> downstream) = 0;
 
   static std::shared_ptr<IBackpressureStrategy<T>> buffer();
+  // Buffers at most `capacity` values, in a ring allocated up front.
+  static std::shared_ptr<IBackpressureStrategy<T>> buffer(
+      size_t capacity,
+      BufferOverflowPolicy policy);
   static std::shared_ptr<IBackpressureStrategy<T>> drop();
   static std::shared_ptr<IBackpressureStrategy<T>> error();
   static std::shared_ptr<IBackpressureStrategy<T>> latest();
@@ -14,35 +14,71 @@
 
 #pragma once
 
+#include <folly/Portability.h>
 #include <folly/Synchronized.h>
 #include <atomic>
+#include <memory>
+
+// folly::atomic_shared_ptr relies on the layout of libstdc++'s shared_ptr,
+// and on packing a count into the upper bits of a pointer.
+#if defined(__GLIBCXX__) && (FOLLY_X64 || FOLLY_AARCH64 || FOLLY_PPC64)
+#define YARPL_LOCK_FREE_ATOMIC_REFERENCE 1
+#include <folly/concurrency/AtomicSharedPtr.h>
+#else
+#define YARPL_LOCK_FREE_ATOMIC_REFERENCE 0
+#endif
 
 namespace yarpl {
 
+/// A std::shared_ptr that can be loaded, stored and exchanged from several
+/// threads at once, through atomic_load(), atomic_store() and
+/// atomic_exchange().
+///
+/// Lock-free where folly::atomic_shared_ptr is supported, a mutex-guarded
+/// std::shared_ptr elsewhere.
 template <typename T>
 struct AtomicReference {
+#if YARPL_LOCK_FREE_ATOMIC_REFERENCE
+  folly::atomic_shared_ptr<T> ref;
+#else
   folly::Synchronized<std::shared_ptr<T>, std::mutex> ref;
+#endif
 
   AtomicReference() = default;
 
-  AtomicReference(std::shared_ptr<T>&& r) {
-    *(ref.lock()) = std::move(r);
+  AtomicReference(std::shared_ptr<T>&& r) : ref(std::move(r)) {}
+
+  AtomicReference& operator=(std::shared_ptr<T> r) {
+#if YARPL_LOCK_FREE_ATOMIC_REFERENCE
+    ref.store(std::move(r));
+#else
+    *ref.lock() = std::move(r);
+#endif
+    return *this;
   }
 };
 
 template <typename T>
 std::shared_ptr<T> atomic_load(AtomicReference<T>* ar) {
+#if YARPL_LOCK_FREE_ATOMIC_REFERENCE
+  return ar->ref.load();
+#else
   return *(ar->ref.lock());
+#endif
 }
 
 template <typename T>
 std::shared_ptr<T> atomic_exchange(
     AtomicReference<T>* ar,
     std::shared_ptr<T> r) {
+#if YARPL_LOCK_FREE_ATOMIC_REFERENCE
+  return ar->ref.exchange(std::move(r));
+#else
   auto refptr = ar->ref.lock();
   auto old = std::move(*refptr);
   *refptr = std::move(r);
   return old;
+#endif
 }
 
 template <typename T>
@@ -52,7 +88,27 @@ std::shared_ptr<T> atomic_exchange(AtomicReference<T>* ar, std::nullptr_t) {
 
 template <typename T>
 void atomic_store(AtomicReference<T>* ar, std::shared_ptr<T> r) {
-  *ar->ref.lock() = std::move(r);
+  *ar = std::move(r);
+}
+
+/// Replaces the reference with `desired` if it still is `*expected`.
+/// Otherwise loads the current reference into `*expected` and returns false.
+template <typename T>
+bool atomic_compare_exchange(
+    AtomicReference<T>* ar,
+    std::shared_ptr<T>* expected,
+    std::shared_ptr<T> desired) {
+#if YARPL_LOCK_FREE_ATOMIC_REFERENCE
+  return ar->ref.compare_exchange_strong(*expected, std::move(desired));
+#else
+  auto refptr = ar->ref.lock();
+  if (*refptr == *expected) {
+    *refptr = std::move(desired);
+    return true;
+  }
+  *expected = *refptr;
+  return false;
+#endif
 }
 
 class enable_get_ref : public std::enable_shared_from_this<enable_get_ref> {
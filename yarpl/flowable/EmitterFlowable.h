@@ -117,6 +117,17 @@ class EmiterSubscription final : public Subscription,
     }
   }
 
+  void onNextBatch(folly::Range<T*> values) override {
+#ifndef NDEBUG
+    DCHECK(!hasFinished_) << "onComplete() or onError() already called";
+#endif
+    if (subscriber_) {
+      subscriber_->onNextBatch(values);
+    } else {
+      DCHECK(requested_.load(std::memory_order_relaxed) == kCanceled);
+    }
+  }
+
   void onComplete() override {
 #ifndef NDEBUG
     DCHECK(!hasFinished_) << "onComplete() or onError() already called";
@@ -274,6 +285,17 @@ class TrackingSubscriber : public Subscriber<T> {
     inner_->onNext(std::move(value));
   }
 
+  // Accounts for the whole batch at once, then hands it on.
+  void onNextBatch(folly::Range<T*> values) override {
+    auto const size = static_cast<int64_t>(values.size());
+#ifndef NDEBUG
+    DCHECK(size <= requested_) << "cannot emit more than requested";
+    credits::consume(requested_, size);
+#endif
+    emitted_ += size;
+    inner_->onNextBatch(values);
+  }
+
   auto getResult() {
     return std::make_tuple(emitted_, completed_);
   }
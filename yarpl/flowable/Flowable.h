@@ -18,7 +18,11 @@
 #include <folly/functional/Invoke.h>
 #include <folly/io/async/HHWheelTimer.h>
 #include <glog/logging.h>
+#include <chrono>
+#include <limits>
 #include <memory>
+#include <vector>
+#include "yarpl/CancellationToken.h"
 #include "yarpl/Disposable.h"
 #include "yarpl/Refcounted.h"
 #include "yarpl/flowable/Subscriber.h"
@@ -36,8 +40,20 @@ namespace flowable {
 template <typename T = void>
 class Flowable;
 
+template <typename U, typename D, typename F, typename EF>
+class FusedOperator;
+
+template <typename T>
+class ParallelFlowable;
+
+template <typename K, typename T>
+class GroupedFlowable;
+
 namespace details {
 
+struct IdentityStage;
+struct IdentityErrorMapper;
+
 template <typename T>
 struct IsFlowable : std::false_type {};
 
@@ -124,6 +140,21 @@ class Flowable : public yarpl::enable_get_ref {
         std::move(subscriber));
   }
 
+  /**
+   * Same as the subscribe overloads that accept lambdas, but returns a
+   * CancellationToken instead of a Disposable.  The token doesn't allocate,
+   * nor keep the subscriber alive, which suits many short-lived
+   * subscriptions.
+   */
+  template <typename... Args>
+  CancellationToken subscribeWithToken(Args&&... args) {
+    auto subscriber =
+        details::LambdaSubscriber<T>::create(std::forward<Args>(args)...);
+    auto token = subscriber->cancellationToken();
+    subscribe(std::move(subscriber));
+    return token;
+  }
+
   void subscribe() {
     subscribe(Subscriber<T>::create());
   }
@@ -241,6 +272,17 @@ class Flowable : public yarpl::enable_get_ref {
           typename folly::invoke_result_t<Function, T>>::ElemType>
   std::shared_ptr<Flowable<R>> flatMap(Function&& func);
 
+  // flatMap() subscribed to at most `maxConcurrency` of the mapped Flowables
+  // at a time.  Each mapped Flowable is requested `prefetch` elements up
+  // front, and then more in batches as its elements are delivered, which
+  // bounds how many elements are buffered.
+  template <
+      typename Function,
+      typename R = typename details::IsFlowable<
+          typename folly::invoke_result_t<Function, T>>::ElemType>
+  std::shared_ptr<Flowable<R>>
+  flatMap(Function&& func, size_t maxConcurrency, size_t prefetch = 32);
+
   template <typename Function>
   std::shared_ptr<Flowable<T>> filter(Function&& function);
 
@@ -249,12 +291,128 @@ class Flowable : public yarpl::enable_get_ref {
       typename R = typename folly::invoke_result_t<Function, T, T>>
   std::shared_ptr<Flowable<R>> reduce(Function&& function);
 
+  // Emits the accumulator after each element, as returned by
+  // `function(R accumulator, T value)` starting from `seed`.  The seed itself
+  // is not emitted.
+  template <typename R, typename Function>
+  std::shared_ptr<Flowable<R>> scan(R seed, Function&& function);
+
+  // Like reduce(), but folds the elements into `seed` in place, with
+  // `function(R& accumulator, T value)`, and emits it once this flowable
+  // completes, even if it was empty.
+  template <typename R, typename Function>
+  std::shared_ptr<Flowable<R>> reduceInto(R seed, Function&& function);
+
+  // Folds each `count` elements into a copy of `seed` in place, with
+  // `function(R& accumulator, T value)`, and emits the result; the last
+  // window may hold fewer.  A request for n windows is a request for
+  // n * count elements upstream.
+  template <typename R, typename Function>
+  std::shared_ptr<Flowable<R>>
+  window(size_t count, R seed, Function&& function);
+
+  // Like window(count, seed, function), but also closes a window once
+  // `timeout` has passed since its first element arrived.  All signals must
+  // come from `timerEvb`.
+  template <typename R, typename Function>
+  std::shared_ptr<Flowable<R>> windowTimeout(
+      size_t count,
+      std::chrono::milliseconds timeout,
+      folly::EventBase& timerEvb,
+      R seed,
+      Function&& function);
+
+  /**
+   * Starts a chain of map() and filter() operators that run as a single
+   * operator.  Every map() and filter() called on the result composes its
+   * function with the previous ones at compile time, so that each element
+   * goes through all of them in one inlined call, rather than through a
+   * subscriber per operator.  See FusedOperator.
+   *
+   *   flowable->fuse()->map(f)->filter(p)->map(g)
+   */
+  std::shared_ptr<FusedOperator<
+      T,
+      T,
+      details::IdentityStage,
+      details::IdentityErrorMapper>>
+  fuse();
+
   std::shared_ptr<Flowable<T>> take(int64_t);
 
   std::shared_ptr<Flowable<T>> skip(int64_t);
 
   std::shared_ptr<Flowable<T>> ignoreElements();
 
+  // Emits the elements in vectors of `count`, the last one possibly shorter.
+  // A request for n vectors is a request for n * count elements upstream.
+  std::shared_ptr<Flowable<std::vector<T>>> buffer(size_t count);
+
+  // Like buffer(count), but also emits a shorter vector once `timeout` has
+  // passed since its first element arrived.  All signals must come from
+  // `timerEvb`.
+  std::shared_ptr<Flowable<std::vector<T>>> bufferTimeout(
+      size_t count,
+      std::chrono::milliseconds timeout,
+      folly::EventBase& timerEvb);
+
+  // Emits the elements in vectors of at most `maxBytes` bytes, as measured by
+  // `sizeOf(const T&)`.  An element bigger than that gets a vector of its
+  // own.  The upstream is requested `prefetch` elements at a time, while the
+  // downstream is waiting for a vector.
+  template <typename SizeFunction>
+  std::shared_ptr<Flowable<std::vector<T>>>
+  bufferBytes(size_t maxBytes, SizeFunction&& sizeOf, int64_t prefetch = 32);
+
+  // Emits an element, then drops those that arrive within `window` of it.
+  // Each dropped element is replaced by requesting another one upstream.
+  std::shared_ptr<Flowable<T>> throttleFirst(std::chrono::milliseconds window);
+
+  // Every `period`, emits the newest element that arrived since the previous
+  // one was emitted, if the downstream has requested one.  This flowable is
+  // requested without limit and the other elements are dropped.  All signals
+  // must come from `timerEvb`.
+  std::shared_ptr<Flowable<T>> sample(
+      std::chrono::milliseconds period,
+      folly::EventBase& timerEvb);
+
+  // Requests elements from this flowable at no more than `permitsPerSecond`,
+  // in bursts of up to `burst`.  Nothing is dropped: demand over the limit is
+  // requested later, from a timer on `timerEvb`.  All signals must come from
+  // `timerEvb`.
+  std::shared_ptr<Flowable<T>> rateLimit(
+      double permitsPerSecond,
+      int64_t burst,
+      folly::EventBase& timerEvb);
+
+  // Emits a GroupedFlowable for each distinct key returned by
+  // `keyFunction(const T&)`, which gets the elements with that key.  A group
+  // buffers up to `bufferSize` elements ahead of its subscriber, and this
+  // flowable is only requested what every group can still buffer, so a slow
+  // group slows down all of them.  A cancelled group is evicted, and a later
+  // element with its key opens a new one.  The key must be hashable.
+  template <
+      typename KeyFunction,
+      typename K = std::decay_t<folly::invoke_result_t<KeyFunction&, const T&>>>
+  std::shared_ptr<Flowable<std::shared_ptr<GroupedFlowable<K, T>>>> groupBy(
+      KeyFunction&& keyFunction,
+      size_t bufferSize = 32);
+
+  // Shares a single subscription to this flowable between all subscribers,
+  // replaying the last `maxItems` elements to those that subscribe late.
+  // This flowable is subscribed to, with unbounded demand, by the first
+  // subscriber.  The elements are stored once and copied to each subscriber
+  // on delivery; types with a `T clone() const` are cloned.
+  std::shared_ptr<Flowable<T>> replay(size_t maxItems);
+
+  // Like replay(maxItems), but retains the newest elements that fit in
+  // `maxBytes` as measured by `sizeOf(const T&)`, and at least one.
+  template <typename SizeFunction>
+  std::shared_ptr<Flowable<T>> replay(size_t maxBytes, SizeFunction&& sizeOf);
+
+  // Like replay(), but retains every element.
+  std::shared_ptr<Flowable<T>> cache();
+
   /*
    * To instruct a Flowable to do its work on a particular Executor.
    * the onSubscribe, request and cancel methods will be scheduled on the
@@ -266,6 +424,15 @@ class Flowable : public yarpl::enable_get_ref {
 
   std::shared_ptr<Flowable<T>> observeOn(folly::Executor::KeepAlive<>);
 
+  // Splits the elements across `parallelism` rails, each of which processes
+  // its share on `executor`, see ParallelFlowable.  Each rail hands its
+  // elements over to the executor in batches, as observeOn() does.
+  std::shared_ptr<ParallelFlowable<T>> parallel(
+      size_t parallelism,
+      folly::Executor& executor);
+
+  // Emits the elements of this flowable, then those of the given one.  Like
+  // take(), this expects request() and the upstream signals to be serialized.
   std::shared_ptr<Flowable<T>> concatWith(std::shared_ptr<Flowable<T>>);
 
   template <typename... Args>
@@ -288,10 +455,15 @@ class Flowable : public yarpl::enable_get_ref {
 
   // Combines multiple Flowables so that they act like a
   // single Flowable. The items
-  // emitted by the merged Flowables may interlieve.
+  // emitted by the merged Flowables may interlieve.  Each merged Flowable is
+  // requested `prefetch` elements up front, and then more in batches, as with
+  // the bounded flatMap(), and may signal from any thread.
   template <typename Q = T>
-  enableWrapRef<Q> merge() {
-    return this->flatMap([](auto f) { return std::move(f); });
+  enableWrapRef<Q> merge(size_t prefetch = 32) {
+    return this->flatMap(
+        [](auto f) { return std::move(f); },
+        std::numeric_limits<size_t>::max(),
+        prefetch);
   }
 
   // function is invoked when onComplete occurs.
@@ -388,6 +560,9 @@ class Flowable : public yarpl::enable_get_ref {
       std::chrono::milliseconds initTimeout,
       ExceptionGenerator&& exnGen = ExceptionGenerator());
 
+  // The emitter is called with the number of elements it may emit, and can
+  // emit them one at a time with onNext() or several at once with
+  // onNextBatch(), which accounts for the credits of the batch in one go.
   template <
       typename Emitter,
       typename = typename std::enable_if<folly::is_invocable_r<
@@ -416,6 +591,8 @@ class Flowable : public yarpl::enable_get_ref {
 #include "yarpl/flowable/DeferFlowable.h"
 #include "yarpl/flowable/EmitterFlowable.h"
 #include "yarpl/flowable/FlowableOperator.h"
+#include "yarpl/flowable/GeneratorFlowable.h"
+#include "yarpl/flowable/ParallelFlowable.h"
 
 namespace yarpl {
 namespace flowable {
@@ -486,22 +663,11 @@ template <typename T>
 template <typename TGenerator>
 std::shared_ptr<Flowable<T>> Flowable<T>::fromGenerator(
     TGenerator&& generator) {
-  auto lambda = [generator = std::forward<TGenerator>(generator)](
-                    Subscriber<T>& subscriber, int64_t requested) mutable {
-    try {
-      while (requested-- > 0) {
-        subscriber.onNext(generator());
-      }
-    } catch (const std::exception& ex) {
-      subscriber.onError(
-          folly::exception_wrapper(std::current_exception(), ex));
-    } catch (...) {
-      subscriber.onError(std::runtime_error(
-          "Flowable::fromGenerator() threw from Subscriber:onNext()"));
-    }
-  };
-  return Flowable<T>::create(std::move(lambda));
-} // namespace flowable
+  using State = details::FunctionState<T, std::decay_t<TGenerator>>;
+  return std::make_shared<details::GeneratorFlowable<T, State>>(
+      State{std::make_shared<std::decay_t<TGenerator>>(
+          std::forward<TGenerator>(generator))});
+}
 
 template <typename T>
 template <typename FlowableFactory, typename>
@@ -537,6 +703,74 @@ std::shared_ptr<Flowable<R>> Flowable<T>::reduce(Function&& function) {
       this->ref_from_this(this), std::forward<Function>(function));
 }
 
+template <typename T>
+template <typename R, typename Function>
+std::shared_ptr<Flowable<R>> Flowable<T>::scan(R seed, Function&& function) {
+  return std::make_shared<
+      details::ScanOperator<T, R, std::decay_t<Function>>>(
+      this->ref_from_this(this),
+      std::move(seed),
+      std::forward<Function>(function));
+}
+
+template <typename T>
+template <typename R, typename Function>
+std::shared_ptr<Flowable<R>> Flowable<T>::reduceInto(
+    R seed,
+    Function&& function) {
+  return std::make_shared<
+      details::ReduceIntoOperator<T, R, std::decay_t<Function>>>(
+      this->ref_from_this(this),
+      std::move(seed),
+      std::forward<Function>(function));
+}
+
+template <typename T>
+template <typename R, typename Function>
+std::shared_ptr<Flowable<R>>
+Flowable<T>::window(size_t count, R seed, Function&& function) {
+  return std::make_shared<
+      details::WindowOperator<T, R, std::decay_t<Function>>>(
+      this->ref_from_this(this),
+      count,
+      std::chrono::milliseconds(0),
+      nullptr,
+      std::move(seed),
+      std::forward<Function>(function));
+}
+
+template <typename T>
+template <typename R, typename Function>
+std::shared_ptr<Flowable<R>> Flowable<T>::windowTimeout(
+    size_t count,
+    std::chrono::milliseconds timeout,
+    folly::EventBase& timerEvb,
+    R seed,
+    Function&& function) {
+  return std::make_shared<
+      details::WindowOperator<T, R, std::decay_t<Function>>>(
+      this->ref_from_this(this),
+      count,
+      timeout,
+      &timerEvb,
+      std::move(seed),
+      std::forward<Function>(function));
+}
+
+template <typename T>
+std::shared_ptr<
+    FusedOperator<T, T, details::IdentityStage, details::IdentityErrorMapper>>
+Flowable<T>::fuse() {
+  return std::make_shared<FusedOperator<
+      T,
+      T,
+      details::IdentityStage,
+      details::IdentityErrorMapper>>(
+      this->ref_from_this(this),
+      details::IdentityStage(),
+      details::IdentityErrorMapper());
+}
+
 template <typename T>
 std::shared_ptr<Flowable<T>> Flowable<T>::take(int64_t limit) {
   return std::make_shared<TakeOperator<T>>(this->ref_from_this(this), limit);
@@ -552,6 +786,104 @@ std::shared_ptr<Flowable<T>> Flowable<T>::ignoreElements() {
   return std::make_shared<IgnoreElementsOperator<T>>(this->ref_from_this(this));
 }
 
+template <typename T>
+std::shared_ptr<Flowable<std::vector<T>>> Flowable<T>::buffer(size_t count) {
+  return std::make_shared<details::BufferOperator<T>>(
+      this->ref_from_this(this),
+      count,
+      0,
+      nullptr,
+      1,
+      std::chrono::milliseconds(0),
+      nullptr);
+}
+
+template <typename T>
+std::shared_ptr<Flowable<std::vector<T>>> Flowable<T>::bufferTimeout(
+    size_t count,
+    std::chrono::milliseconds timeout,
+    folly::EventBase& timerEvb) {
+  return std::make_shared<details::BufferOperator<T>>(
+      this->ref_from_this(this), count, 0, nullptr, 1, timeout, &timerEvb);
+}
+
+template <typename T>
+template <typename SizeFunction>
+std::shared_ptr<Flowable<std::vector<T>>> Flowable<T>::bufferBytes(
+    size_t maxBytes,
+    SizeFunction&& sizeOf,
+    int64_t prefetch) {
+  return std::make_shared<details::BufferOperator<T>>(
+      this->ref_from_this(this),
+      std::numeric_limits<size_t>::max(),
+      maxBytes,
+      std::forward<SizeFunction>(sizeOf),
+      prefetch,
+      std::chrono::milliseconds(0),
+      nullptr);
+}
+
+template <typename T>
+std::shared_ptr<Flowable<T>> Flowable<T>::throttleFirst(
+    std::chrono::milliseconds window) {
+  return std::make_shared<details::ThrottleFirstOperator<T>>(
+      this->ref_from_this(this), window);
+}
+
+template <typename T>
+std::shared_ptr<Flowable<T>> Flowable<T>::sample(
+    std::chrono::milliseconds period,
+    folly::EventBase& timerEvb) {
+  return std::make_shared<details::SampleOperator<T>>(
+      this->ref_from_this(this), period, timerEvb);
+}
+
+template <typename T>
+std::shared_ptr<Flowable<T>> Flowable<T>::rateLimit(
+    double permitsPerSecond,
+    int64_t burst,
+    folly::EventBase& timerEvb) {
+  return std::make_shared<details::RateLimitOperator<T>>(
+      this->ref_from_this(this), permitsPerSecond, burst, timerEvb);
+}
+
+template <typename T>
+template <typename KeyFunction, typename K>
+std::shared_ptr<Flowable<std::shared_ptr<GroupedFlowable<K, T>>>>
+Flowable<T>::groupBy(KeyFunction&& keyFunction, size_t bufferSize) {
+  return std::make_shared<
+      details::GroupByOperator<T, K, std::decay_t<KeyFunction>>>(
+      this->ref_from_this(this),
+      std::forward<KeyFunction>(keyFunction),
+      bufferSize);
+}
+
+template <typename T>
+std::shared_ptr<Flowable<T>> Flowable<T>::replay(size_t maxItems) {
+  return std::make_shared<details::ReplayOperator<T>>(
+      this->ref_from_this(this),
+      maxItems,
+      std::numeric_limits<size_t>::max(),
+      nullptr);
+}
+
+template <typename T>
+template <typename SizeFunction>
+std::shared_ptr<Flowable<T>> Flowable<T>::replay(
+    size_t maxBytes,
+    SizeFunction&& sizeOf) {
+  return std::make_shared<details::ReplayOperator<T>>(
+      this->ref_from_this(this),
+      std::numeric_limits<size_t>::max(),
+      maxBytes,
+      std::forward<SizeFunction>(sizeOf));
+}
+
+template <typename T>
+std::shared_ptr<Flowable<T>> Flowable<T>::cache() {
+  return replay(std::numeric_limits<size_t>::max());
+}
+
 template <typename T>
 std::shared_ptr<Flowable<T>> Flowable<T>::subscribeOn(
     folly::Executor& executor) {
@@ -559,6 +891,25 @@ std::shared_ptr<Flowable<T>> Flowable<T>::subscribeOn(
       this->ref_from_this(this), executor);
 }
 
+template <typename T>
+std::shared_ptr<ParallelFlowable<T>> Flowable<T>::parallel(
+    size_t parallelism,
+    folly::Executor& executor) {
+  CHECK_GT(parallelism, 0);
+  auto upstream = this->ref_from_this(this);
+  auto factory = [upstream, parallelism, &executor](bool ordered) {
+    auto source = std::make_shared<details::ParallelSource<T>>(
+        upstream, parallelism, ordered);
+    auto rails = source->rails();
+    for (auto& rail : rails) {
+      rail = rail->observeOn(executor);
+    }
+    return rails;
+  };
+  return std::make_shared<ParallelFlowable<T>>(
+      parallelism, std::move(factory));
+}
+
 template <typename T>
 std::shared_ptr<Flowable<T>> Flowable<T>::observeOn(folly::Executor& executor) {
   return observeOn(folly::getKeepAliveToken(executor));
@@ -578,6 +929,19 @@ std::shared_ptr<Flowable<R>> Flowable<T>::flatMap(Function&& function) {
       this->ref_from_this(this), std::forward<Function>(function));
 }
 
+template <typename T>
+template <typename Function, typename R>
+std::shared_ptr<Flowable<R>> Flowable<T>::flatMap(
+    Function&& function,
+    size_t maxConcurrency,
+    size_t prefetch) {
+  return std::make_shared<details::BoundedFlatMapOperator<T, R>>(
+      this->ref_from_this(this),
+      std::forward<Function>(function),
+      maxConcurrency,
+      prefetch);
+}
+
 template <typename T>
 std::shared_ptr<Flowable<T>> Flowable<T>::concatWith(
     std::shared_ptr<Flowable<T>> next) {
@@ -0,0 +1,259 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// IWYU pragma: private, include "yarpl/flowable/Flowable.h"
+
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <vector>
+
+#include "yarpl/flowable/FlowableOperator.h"
+
+namespace yarpl {
+namespace flowable {
+namespace details {
+
+/// Groups the elements of the upstream into vectors, see Flowable::buffer(),
+/// Flowable::bufferTimeout() and Flowable::bufferBytes().
+///
+/// A batch is closed once it holds `maxCount` elements, once adding the next
+/// element would take it over `maxBytes` as measured by `sizeOf`, or
+/// `timeout` after its first element arrived.  Closed batches wait for
+/// downstream demand, and whatever is left is emitted when the upstream
+/// completes.
+///
+/// When batches are only limited by count, a request for n batches becomes a
+/// request for n * maxCount elements.  Batches closed early by the timer
+/// leave some of those credits outstanding, and the elements they bring in
+/// wait in closed batches for the next downstream request.  When batches are
+/// limited by size, the upstream is requested `prefetch` elements at a time,
+/// whenever fewer batches are closed than were requested and the previous
+/// window has arrived.
+///
+/// Like take() and skip(), this expects request() and the upstream signals to
+/// be serialized.  With a timeout they must all come from `timerEvb`.
+template <typename T>
+class BufferOperator : public FlowableOperator<T, std::vector<T>> {
+  using Super = FlowableOperator<T, std::vector<T>>;
+
+ public:
+  using SizeFunction = folly::Function<size_t(const T&)>;
+
+  BufferOperator(
+      std::shared_ptr<Flowable<T>> upstream,
+      size_t maxCount,
+      size_t maxBytes,
+      SizeFunction sizeOf,
+      int64_t prefetch,
+      std::chrono::milliseconds timeout,
+      folly::EventBase* timerEvb)
+      : upstream_(std::move(upstream)),
+        maxCount_(maxCount),
+        maxBytes_(maxBytes),
+        sizeOf_(std::move(sizeOf)),
+        prefetch_(prefetch),
+        timeout_(timeout),
+        timerEvb_(timerEvb) {
+    CHECK_GT(maxCount_, 0);
+    CHECK_GT(prefetch_, 0);
+    CHECK(timeout_.count() == 0 || timerEvb_);
+  }
+
+  void subscribe(std::shared_ptr<Subscriber<std::vector<T>>> subscriber)
+      override {
+    upstream_->subscribe(std::make_shared<BufferSubscription>(
+        this->ref_from_this(this), std::move(subscriber)));
+  }
+
+ private:
+  using SuperSubscription = typename Super::Subscription;
+  class BufferSubscription : public SuperSubscription,
+                             public folly::HHWheelTimer::Callback {
+   public:
+    BufferSubscription(
+        std::shared_ptr<BufferOperator> flowable,
+        std::shared_ptr<Subscriber<std::vector<T>>> subscriber)
+        : SuperSubscription(std::move(subscriber)),
+          flowable_(std::move(flowable)) {}
+
+    void onNextImpl(T value) override {
+      auto& flowable = *flowable_;
+      DCHECK(!isTimed() || flowable.timerEvb_->isInEventBaseThread());
+
+      if (bySize()) {
+        --outstanding_;
+        auto const size = flowable.sizeOf_(value);
+        if (!current_.empty() && currentBytes_ + size > flowable.maxBytes_) {
+          closeBatch();
+        }
+        currentBytes_ += size;
+      }
+
+      if (current_.empty() && isTimed()) {
+        flowable.timerEvb_->timer().scheduleTimeout(this, flowable.timeout_);
+      }
+      current_.push_back(std::move(value));
+
+      if (current_.size() >= flowable.maxCount_ ||
+          (bySize() && currentBytes_ >= flowable.maxBytes_)) {
+        closeBatch();
+      }
+      drain();
+    }
+
+    void onCompleteImpl() override {
+      closeBatch();
+      upstreamDone_ = true;
+      drain();
+    }
+
+    void onErrorImpl(folly::exception_wrapper ew) override {
+      terminated_ = true;
+      current_.clear();
+      ready_.clear();
+      SuperSubscription::onErrorImpl(std::move(ew));
+    }
+
+    void onTerminateImpl() override {
+      cancelTimeout();
+      SuperSubscription::onTerminateImpl();
+    }
+
+    void request(int64_t n) override {
+      if (n <= 0) {
+        return;
+      }
+      requested_ = credits::add(requested_, n);
+      if (!bySize()) {
+        auto const maxCount = static_cast<int64_t>(flowable_->maxCount_);
+        SuperSubscription::request(
+            n > credits::kNoFlowControl / maxCount ? credits::kNoFlowControl
+                                                   : n * maxCount);
+      }
+      drain();
+    }
+
+    void cancel() override {
+      cancelled_ = true;
+      cancelTimeout();
+      SuperSubscription::cancel();
+    }
+
+    void timeoutExpired() noexcept override {
+      closeBatch();
+      drain();
+    }
+
+    void callbackCanceled() noexcept override {}
+
+   private:
+    bool isTimed() const {
+      return flowable_->timeout_.count() > 0;
+    }
+
+    bool bySize() const {
+      return static_cast<bool>(flowable_->sizeOf_);
+    }
+
+    void closeBatch() {
+      if (isTimed()) {
+        cancelTimeout();
+      }
+      if (!current_.empty()) {
+        ready_.push_back(std::move(current_));
+        current_ = std::vector<T>();
+        currentBytes_ = 0;
+      }
+    }
+
+    // Calls made while already draining, e.g. from a downstream requesting
+    // more batches in onNext(), or an upstream emitting from request(), only
+    // ask the outermost call to go around again.
+    void drain() {
+      if (draining_) {
+        missed_ = true;
+        return;
+      }
+      draining_ = true;
+      do {
+        missed_ = false;
+        drainOnce();
+      } while (missed_);
+      draining_ = false;
+    }
+
+    void drainOnce() {
+      if (terminated_) {
+        return;
+      }
+
+      while (requested_ > 0 && !ready_.empty() && !cancelled_) {
+        auto batch = std::move(ready_.front());
+        ready_.pop_front();
+        if (requested_ != credits::kNoFlowControl) {
+          --requested_;
+        }
+        SuperSubscription::subscriberOnNext(std::move(batch));
+      }
+      if (cancelled_) {
+        return;
+      }
+
+      if (upstreamDone_) {
+        if (ready_.empty()) {
+          terminated_ = true;
+          SuperSubscription::terminate();
+        }
+        return;
+      }
+
+      if (bySize() && outstanding_ == 0 &&
+          static_cast<size_t>(requested_) > ready_.size()) {
+        outstanding_ = flowable_->prefetch_;
+        SuperSubscription::request(outstanding_);
+      }
+    }
+
+    std::shared_ptr<BufferOperator> flowable_;
+
+    std::vector<T> current_;
+    size_t currentBytes_{0};
+    std::deque<std::vector<T>> ready_;
+
+    // downstream batches requested and not yet delivered
+    int64_t requested_{0};
+    // upstream elements requested and not yet received, when limited by size
+    int64_t outstanding_{0};
+
+    bool upstreamDone_{false};
+    bool cancelled_{false};
+    bool terminated_{false};
+    bool draining_{false};
+    bool missed_{false};
+  };
+
+  std::shared_ptr<Flowable<T>> upstream_;
+  size_t const maxCount_;
+  size_t const maxBytes_;
+  SizeFunction sizeOf_;
+  int64_t const prefetch_;
+  std::chrono::milliseconds const timeout_;
+  folly::EventBase* const timerEvb_;
+};
+
+} // namespace details
+} // namespace flowable
+} // namespace yarpl
@@ -14,15 +14,28 @@
 
 #pragma once
 
+#include <deque>
+
 #include "yarpl/flowable/FlowableOperator.h"
 
 namespace yarpl {
 namespace flowable {
 namespace details {
 
+/// Subscribes to `second` once `first` completes.  The subscription is not
+/// synchronized, so its signals must be serialized, and its credits are
+/// thread confined.
+///
+/// Chains of concatenations, e.g. from calling concatWith() once per page of
+/// a paged response, are flattened into a single queue of sources when
+/// subscribed to.  One subscription then subscribes itself to every source in
+/// turn from a drain loop, rather than from the onComplete() of the source
+/// before, so neither the stack nor the number of subscribers grows with the
+/// length of the chain.
 template <typename T>
-class ConcatWithOperator : public FlowableOperator<T, T> {
-  using Super = FlowableOperator<T, T>;
+class ConcatWithOperator
+    : public FlowableOperator<T, T, credits::ThreadConfined> {
+  using Super = FlowableOperator<T, T, credits::ThreadConfined>;
 
  public:
   ConcatWithOperator(
@@ -33,6 +46,19 @@ class ConcatWithOperator : public FlowableOperator<T, T> {
     CHECK(second_);
   }
 
+  ~ConcatWithOperator() override {
+    // Unlinks a chain that isn't shared one operator at a time, rather than
+    // destroying it recursively.
+    auto next = std::move(first_);
+    while (next.use_count() == 1) {
+      auto const concat = dynamic_cast<ConcatWithOperator*>(next.get());
+      if (!concat) {
+        break;
+      }
+      next = std::move(concat->first_);
+    }
+  }
+
   void subscribe(std::shared_ptr<Subscriber<T>> subscriber) override {
     auto subscription =
         std::make_shared<ConcatWithSubscription>(subscriber, first_, second_);
@@ -40,147 +66,141 @@ class ConcatWithOperator : public FlowableOperator<T, T> {
   }
 
  private:
-  class ForwardSubscriber;
-
-  // Downstream will always point to this subscription
+  // Downstream will always point to this subscription, and every source is
+  // subscribed to by it.
   class ConcatWithSubscription
       : public yarpl::flowable::Subscription,
+        public yarpl::flowable::Subscriber<T>,
         public std::enable_shared_from_this<ConcatWithSubscription> {
    public:
     ConcatWithSubscription(
         std::shared_ptr<Subscriber<T>> subscriber,
         std::shared_ptr<Flowable<T>> first,
         std::shared_ptr<Flowable<T>> second)
-        : downSubscriber_(std::move(subscriber)),
-          first_(std::move(first)),
-          second_(std::move(second)) {}
+        : downSubscriber_(std::move(subscriber)) {
+      sources_.push_back(std::move(first));
+      sources_.push_back(std::move(second));
+    }
 
     void init() {
-      upSubscriber_ =
-          std::make_shared<ForwardSubscriber>(this->shared_from_this());
-      first_->subscribe(upSubscriber_);
-      downSubscriber_->onSubscribe(this->shared_from_this());
+      // The first source is subscribed to right away, the others once there
+      // is demand for them.
+      auto self = this->shared_from_this();
+      active_ = true;
+      nextSource()->subscribe(self);
+      downSubscriber_->onSubscribe(self);
+      started_ = true;
+      drain();
     }
 
     void request(int64_t n) override {
-      credits::add(&requested_, n);
-      if (!upSubscriber_) {
-        if (auto second = std::exchange(second_, nullptr)) {
-          upSubscriber_ = std::make_shared<ForwardSubscriber>(
-              this->shared_from_this(), requested_);
-          second->subscribe(upSubscriber_);
-        }
-      } else {
-        upSubscriber_->request(n);
+      requested_.add(n);
+      if (subscription_) {
+        subscription_->request(n);
+      } else if (!active_) {
+        drain();
       }
     }
 
     void cancel() override {
-      if (auto subscriber = std::move(upSubscriber_)) {
-        subscriber->cancel();
-      }
-      first_.reset();
-      second_.reset();
-      downSubscriber_.reset();
-      upSubscriber_.reset();
-    }
-
-    void onNext(T value) {
-      credits::consume(&requested_, 1);
-      downSubscriber_->onNext(std::move(value));
-    }
-
-    void onComplete() {
-      upSubscriber_.reset();
-      if (auto first = std::move(first_)) {
-        if (requested_ > 0) {
-          if (auto second = std::exchange(second_, nullptr)) {
-            upSubscriber_ = std::make_shared<ForwardSubscriber>(
-                this->shared_from_this(), requested_);
-            // TODO - T28771728
-            // Concat should not call 'subscribe' on onComplete
-            second->subscribe(upSubscriber_);
-          }
-        }
-      } else {
-        if (auto downSubscriber = std::exchange(downSubscriber_, nullptr)) {
-          downSubscriber->onComplete();
-        }
-        upSubscriber_.reset();
-      }
-    }
-
-    void onError(folly::exception_wrapper ew) {
-      downSubscriber_->onError(std::move(ew));
-      first_.reset();
-      second_.reset();
+      sources_.clear();
       downSubscriber_.reset();
-      upSubscriber_.reset();
-    }
-
-   private:
-    std::shared_ptr<Subscriber<T>> downSubscriber_;
-    std::shared_ptr<Flowable<T>> first_;
-    std::shared_ptr<Flowable<T>> second_;
-    std::shared_ptr<ForwardSubscriber> upSubscriber_;
-    std::atomic<int64_t> requested_{0};
-  };
-
-  class ForwardSubscriber : public yarpl::flowable::Subscriber<T>,
-                            public yarpl::flowable::Subscription {
-   public:
-    ForwardSubscriber(
-        std::shared_ptr<ConcatWithSubscription> concatWithSubscription,
-        uint32_t initialRequest = 0u)
-        : concatWithSubscription_(std::move(concatWithSubscription)),
-          initialRequest_(initialRequest) {}
-
-    void request(int64_t n) override {
-      subscription_->request(n);
-    }
-
-    void cancel() override {
-      if (auto subs = std::move(subscription_)) {
-        subs->cancel();
-      } else {
-        canceled_ = true;
+      if (auto subscription = std::move(subscription_)) {
+        subscription->cancel();
       }
     }
 
     void onSubscribe(std::shared_ptr<Subscription> subscription) override {
-      if (canceled_) {
+      if (!downSubscriber_) {
         subscription->cancel();
         return;
       }
       subscription_ = std::move(subscription);
-      if (auto req = std::exchange(initialRequest_, 0)) {
-        subscription_->request(req);
+      if (auto const n = requested_.load()) {
+        subscription_->request(n);
+      }
+    }
+
+    void onNext(T value) override {
+      requested_.consume(1);
+      if (downSubscriber_) {
+        downSubscriber_->onNext(std::move(value));
       }
     }
 
     void onComplete() override {
-      auto sub = std::exchange(concatWithSubscription_, nullptr);
-      sub->onComplete();
+      subscription_.reset();
+      active_ = false;
+      drain();
     }
 
     void onError(folly::exception_wrapper ew) override {
-      auto sub = std::exchange(concatWithSubscription_, nullptr);
-      sub->onError(std::move(ew));
-    }
-    void onNext(T value) override {
-      concatWithSubscription_->onNext(std::move(value));
+      subscription_.reset();
+      active_ = false;
+      sources_.clear();
+      if (auto downSubscriber = std::exchange(downSubscriber_, nullptr)) {
+        downSubscriber->onError(std::move(ew));
+      }
     }
 
    private:
-    std::shared_ptr<ConcatWithSubscription> concatWithSubscription_;
-    std::shared_ptr<flowable::Subscription> subscription_;
+    /// Subscribes to the next source whenever none is active and there is
+    /// demand, or completes downstream after the last one.  A source that
+    /// completes while being subscribed to makes the loop that subscribed
+    /// to it go on, instead of recursing into another one.
+    void drain() {
+      if (draining_) {
+        redrain_ = true;
+        return;
+      }
+      draining_ = true;
+      do {
+        redrain_ = false;
+        if (!started_ || active_ || !downSubscriber_) {
+          break;
+        }
+        if (sources_.empty()) {
+          std::exchange(downSubscriber_, nullptr)->onComplete();
+          break;
+        }
+        if (requested_.load() <= 0) {
+          break;
+        }
+        active_ = true;
+        nextSource()->subscribe(this->shared_from_this());
+      } while (redrain_);
+      draining_ = false;
+    }
 
-    uint32_t initialRequest_{0};
-    bool canceled_{false};
+    /// Pops the next source off the queue, expanding the concatenations at
+    /// its front into their sources.  The queue must not be empty.
+    std::shared_ptr<Flowable<T>> nextSource() {
+      while (auto const concat =
+                 dynamic_cast<ConcatWithOperator*>(sources_.front().get())) {
+        auto first = concat->first_;
+        auto second = concat->second_;
+        sources_.front() = std::move(second);
+        sources_.push_front(std::move(first));
+      }
+      auto source = std::move(sources_.front());
+      sources_.pop_front();
+      return source;
+    }
+
+    std::shared_ptr<Subscriber<T>> downSubscriber_;
+    std::shared_ptr<flowable::Subscription> subscription_;
+    std::deque<std::shared_ptr<Flowable<T>>> sources_;
+    typename Super::Credits requested_;
+
+    /// Whether a source is subscribed to and hasn't terminated yet.
+    bool active_{false};
+    /// Whether downstream got its onSubscribe().
+    bool started_{false};
+    bool draining_{false};
+    bool redrain_{false};
   };
 
- private:
-  const std::shared_ptr<Flowable<T>> first_;
+  std::shared_ptr<Flowable<T>> first_;
   const std::shared_ptr<Flowable<T>> second_;
 };
 
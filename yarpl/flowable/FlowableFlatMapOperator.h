@@ -0,0 +1,400 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/concurrency/UnboundedQueue.h>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#include "yarpl/flowable/FlowableOperator.h"
+
+namespace yarpl {
+namespace flowable {
+namespace details {
+
+/// flatMap() with a bound on the number of inner Flowables subscribed to at
+/// once.
+///
+/// The upstream is requested `maxConcurrency` elements up front, and one more
+/// every time an inner Flowable terminates.  Each inner Flowable is requested
+/// `prefetch` elements when subscribed to, and replenished in batches of
+/// three quarters of that as its elements are delivered downstream, so at
+/// most `maxConcurrency * prefetch` elements are ever buffered.
+///
+/// Inner Flowables hand their elements over through lock-free queues, and
+/// an inner with elements to deliver puts itself on a queue of ready inners.
+/// A single drain loop, run by whichever thread signals while no other thread
+/// is running it, delivers them downstream round-robin from the ready inners,
+/// so delivering an element costs the same however many inners there are.
+/// Once inners terminate, the upstream is replenished with one request for
+/// all of the inners that terminated in a pass of the drain loop.
+///
+/// Flowable::merge() is this with no bound on the concurrency.
+template <typename T, typename R>
+class BoundedFlatMapOperator : public FlowableOperator<T, R> {
+  using Super = FlowableOperator<T, R>;
+
+ public:
+  BoundedFlatMapOperator(
+      std::shared_ptr<Flowable<T>> upstream,
+      folly::Function<std::shared_ptr<Flowable<R>>(T)> function,
+      size_t maxConcurrency,
+      size_t prefetch)
+      : upstream_(std::move(upstream)),
+        function_(std::move(function)),
+        maxConcurrency_(toCredits(maxConcurrency)),
+        prefetch_(toCredits(prefetch)) {
+    CHECK_GT(maxConcurrency, 0);
+    CHECK_GT(prefetch, 0);
+  }
+
+  void subscribe(std::shared_ptr<Subscriber<R>> subscriber) override {
+    upstream_->subscribe(std::make_shared<MergeSubscription>(
+        this->ref_from_this(this), std::move(subscriber)));
+  }
+
+ private:
+  static int64_t toCredits(size_t n) {
+    return static_cast<int64_t>(
+        std::min<size_t>(n, static_cast<size_t>(credits::kNoFlowControl)));
+  }
+
+  using SuperSubscription = typename Super::Subscription;
+  class MergeSubscription : public SuperSubscription {
+    class InnerSubscriber;
+
+   public:
+    MergeSubscription(
+        std::shared_ptr<BoundedFlatMapOperator> flowable,
+        std::shared_ptr<Subscriber<R>> subscriber)
+        : SuperSubscription(std::move(subscriber)),
+          maxConcurrency_(flowable->maxConcurrency_),
+          prefetch_(flowable->prefetch_),
+          flowable_(std::move(flowable)) {}
+
+    void onSubscribeImpl() override {
+      SuperSubscription::onSubscribeImpl();
+      SuperSubscription::request(maxConcurrency_);
+    }
+
+    void onNextImpl(T value) override {
+      auto flowable = yarpl::atomic_load(&flowable_);
+      if (!flowable || terminated_) {
+        return;
+      }
+
+      std::shared_ptr<Flowable<R>> inner;
+      try {
+        inner = flowable->function_(std::move(value));
+      } catch (const std::exception& exn) {
+        fail(folly::exception_wrapper{std::current_exception(), exn});
+        return;
+      }
+
+      auto subscriber =
+          std::make_shared<InnerSubscriber>(this->ref_from_this(this));
+      // Registered before subscribing, so that the drain loop knows about it
+      // by the time it delivers an element.
+      added_.enqueue(subscriber);
+      inner->subscribe(std::move(subscriber));
+    }
+
+    // The downstream completes once every inner Flowable has.
+    void onCompleteImpl() override {
+      upstreamDone_.store(true, std::memory_order_release);
+      drain();
+    }
+
+    void onErrorImpl(folly::exception_wrapper ew) override {
+      fail(std::move(ew));
+    }
+
+    void onTerminateImpl() override {
+      yarpl::atomic_exchange(&flowable_, nullptr);
+      SuperSubscription::onTerminateImpl();
+    }
+
+    void request(int64_t n) override {
+      credits::add(&requested_, n);
+      drain();
+    }
+
+    void cancel() override {
+      cancelled_ = true;
+      drain();
+    }
+
+   private:
+    void fail(folly::exception_wrapper ew) {
+      {
+        std::lock_guard<std::mutex> g(errorGuard_);
+        if (!error_) {
+          error_ = std::move(ew);
+        }
+      }
+      drain();
+    }
+
+    // only one thread at a time runs drainImpl()
+    void drain() {
+      auto self = this->ref_from_this(this);
+      if (drainLoopMutex_++ == 0) {
+        do {
+          drainImpl();
+        } while (drainLoopMutex_-- != 1);
+      }
+    }
+
+    void drainImpl() {
+      if (terminated_) {
+        return;
+      }
+
+      // Read before taking the new inner subscribers: once the upstream has
+      // completed, every inner subscriber it created is in `added_`.
+      auto const upstreamDone = upstreamDone_.load(std::memory_order_acquire);
+      registerAdded();
+
+      if (cancelled_) {
+        terminated_ = true;
+        SuperSubscription::cancel();
+        cancelInners();
+        return;
+      }
+
+      folly::exception_wrapper ew;
+      {
+        std::lock_guard<std::mutex> g(errorGuard_);
+        ew = std::move(error_);
+      }
+      if (ew) {
+        terminated_ = true;
+        cancelInners();
+        this->terminateErr(std::move(ew));
+        return;
+      }
+
+      // Deliver one element from each ready inner subscriber per turn, for
+      // as long as there are elements and credits.
+      int64_t replenish = 0;
+      while (!cancelled_) {
+        // Inners that became ready line up behind the ones already ready.
+        while (auto inner = readyQueue_.try_dequeue()) {
+          readyInners_.push_back(std::move(*inner));
+        }
+        if (readyInners_.empty()) {
+          break;
+        }
+
+        auto& inner = readyInners_.front();
+        if (inner->queue_.empty()) {
+          auto idle = std::move(inner);
+          readyInners_.pop_front();
+          // Synchronizes with the makeReady() of an element enqueued before
+          // the flag was cleared, so that the element isn't left behind.
+          idle->ready_.exchange(false, std::memory_order_acq_rel);
+          if (!idle->queue_.empty()) {
+            if (!idle->ready_.exchange(true)) {
+              readyInners_.push_back(std::move(idle));
+            }
+          } else if (idle->done_.load(std::memory_order_acquire)) {
+            // It has terminated and all its elements were delivered.
+            replenish += remove(*idle);
+          }
+          continue;
+        }
+        if (requested_ <= 0) {
+          break;
+        }
+
+        auto value = inner->queue_.try_dequeue();
+        DCHECK(value);
+        auto delivered = std::move(inner);
+        readyInners_.pop_front();
+        readyInners_.push_back(delivered);
+        credits::consume(&requested_, 1);
+        this->subscriberOnNext(std::move(*value));
+        delivered->consumed();
+      }
+      if (cancelled_) {
+        // cancel() already queued another run of drainImpl() to handle it
+        return;
+      }
+
+      if (upstreamDone && inners_.empty()) {
+        terminated_ = true;
+        this->terminate();
+        return;
+      }
+      if (replenish > 0 && !upstreamDone) {
+        SuperSubscription::request(replenish);
+      }
+    }
+
+    void cancelInners() {
+      auto inners = std::move(inners_);
+      readyInners_.clear();
+      for (auto& inner : inners) {
+        inner->cancel();
+      }
+    }
+
+    /// Removes a finished inner subscriber, returning whether it was still
+    /// there.  An inner can be ready more than once after it terminated.
+    int64_t remove(InnerSubscriber& inner) {
+      if (inner.index_ == kUnregistered) {
+        // It terminated after the drain loop took the new inner subscribers.
+        registerAdded();
+      }
+      auto const index = inner.index_;
+      if (index == kRemoved) {
+        return 0;
+      }
+      inner.index_ = kRemoved;
+      if (index + 1 != inners_.size()) {
+        inners_[index] = std::move(inners_.back());
+        inners_[index]->index_ = index;
+      }
+      inners_.pop_back();
+      return 1;
+    }
+
+    void registerAdded() {
+      while (auto subscriber = added_.try_dequeue()) {
+        (*subscriber)->index_ = inners_.size();
+        inners_.push_back(std::move(*subscriber));
+      }
+    }
+
+    static constexpr size_t kUnregistered = std::numeric_limits<size_t>::max();
+    static constexpr size_t kRemoved = kUnregistered - 1;
+
+    class InnerSubscriber : public BaseSubscriber<R> {
+     public:
+      explicit InnerSubscriber(std::shared_ptr<MergeSubscription> parent)
+          : prefetch_(parent->prefetch_),
+            limit_(prefetch_ - prefetch_ / 4),
+            parent_(std::move(parent)) {}
+
+      void onSubscribeImpl() override {
+        auto parent = yarpl::atomic_load(&parent_);
+        if (!parent || parent->terminated_) {
+          BaseSubscriber<R>::cancel();
+          return;
+        }
+        BaseSubscriber<R>::request(prefetch_);
+      }
+
+      void onNextImpl(R value) override {
+        queue_.enqueue(std::move(value));
+        if (auto parent = yarpl::atomic_load(&parent_)) {
+          makeReady(*parent);
+          parent->drain();
+        }
+      }
+
+      void onCompleteImpl() override {}
+
+      void onErrorImpl(folly::exception_wrapper ew) override {
+        if (auto parent = yarpl::atomic_load(&parent_)) {
+          parent->fail(std::move(ew));
+        }
+      }
+
+      void onTerminateImpl() override {
+        done_.store(true, std::memory_order_release);
+        if (auto parent = yarpl::atomic_exchange(&parent_, nullptr)) {
+          makeReady(*parent);
+          parent->drain();
+        }
+      }
+
+     private:
+      friend class MergeSubscription;
+
+      // puts this on the ready queue of the parent, unless it is on it
+      void makeReady(MergeSubscription& parent) {
+        if (!ready_.exchange(true)) {
+          parent.readyQueue_.enqueue(this->ref_from_this(this));
+        }
+      }
+
+      // called from the drain loop once an element was delivered downstream
+      void consumed() {
+        if (++consumed_ == limit_) {
+          consumed_ = 0;
+          BaseSubscriber<R>::request(limit_);
+        }
+      }
+
+      int64_t const prefetch_;
+      int64_t const limit_;
+      int64_t consumed_{0};
+
+      folly::USPSCQueue<R, false /* MayBlock */> queue_;
+      std::atomic<bool> done_{false};
+
+      // whether this is on the ready queue, or the drain loop's ready list
+      std::atomic<bool> ready_{false};
+
+      // position in MergeSubscription::inners_, only accessed from
+      // drainImpl()
+      size_t index_{kUnregistered};
+
+      AtomicReference<MergeSubscription> parent_;
+    };
+
+    int64_t const maxConcurrency_;
+    int64_t const prefetch_;
+    AtomicReference<BoundedFlatMapOperator> flowable_;
+
+    // inner subscribers created by onNextImpl(), not yet seen by the drain
+    // loop
+    folly::USPSCQueue<std::shared_ptr<InnerSubscriber>, false /* MayBlock */>
+        added_;
+
+    // inner subscribers with elements to deliver, or that terminated, not
+    // yet seen by the drain loop
+    folly::UMPSCQueue<std::shared_ptr<InnerSubscriber>, false /* MayBlock */>
+        readyQueue_;
+
+    // only accessed from drainImpl()
+    std::vector<std::shared_ptr<InnerSubscriber>> inners_;
+    std::deque<std::shared_ptr<InnerSubscriber>> readyInners_;
+
+    std::atomic<int64_t> drainLoopMutex_{0};
+    std::atomic<int64_t> requested_{0};
+    std::atomic<bool> upstreamDone_{false};
+    std::atomic<bool> cancelled_{false};
+    std::atomic<bool> terminated_{false};
+
+    std::mutex errorGuard_;
+    folly::exception_wrapper error_;
+  };
+
+  std::shared_ptr<Flowable<T>> upstream_;
+  folly::Function<std::shared_ptr<Flowable<R>>(T)> function_;
+  int64_t const maxConcurrency_;
+  int64_t const prefetch_;
+};
+
+} // namespace details
+} // namespace flowable
+} // namespace yarpl
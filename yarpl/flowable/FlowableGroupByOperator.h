@@ -0,0 +1,421 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// IWYU pragma: private, include "yarpl/flowable/Flowable.h"
+
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <folly/Optional.h>
+
+#include "yarpl/flowable/FlowableOperator.h"
+
+namespace yarpl {
+namespace flowable {
+
+/**
+ * The elements of a Flowable that share a key, see Flowable::groupBy().  A
+ * group can be subscribed to once.
+ */
+template <typename K, typename T>
+class GroupedFlowable : public Flowable<T> {
+ public:
+  const K& key() const {
+    return key_;
+  }
+
+ protected:
+  explicit GroupedFlowable(K key) : key_(std::move(key)) {}
+
+ private:
+  K const key_;
+};
+
+namespace details {
+
+/// Splits the upstream into a GroupedFlowable per key, see
+/// Flowable::groupBy().
+///
+/// Each group buffers at most `bufferSize` elements that its subscriber has
+/// not requested yet.  The upstream is requested in windows, once the previous
+/// window has arrived, and only as many elements as every live group can
+/// still buffer: any of them may belong to any group.  Nothing is requested
+/// while a new group waits for downstream demand, which bounds the number of
+/// groups created ahead of it.
+///
+/// A group that is cancelled is evicted: a later element with its key opens a
+/// new group.  Cancelling the flowable of groups stops new groups from being
+/// opened, and the upstream is cancelled once no group is left.
+///
+/// Signals may come from any thread.  The state is kept under a mutex, and
+/// delivered by a drain loop outside of it.
+template <typename T, typename K, typename KeyFunction>
+class GroupByOperator
+    : public FlowableOperator<T, std::shared_ptr<GroupedFlowable<K, T>>> {
+  using Group = GroupedFlowable<K, T>;
+  using Super = FlowableOperator<T, std::shared_ptr<Group>>;
+
+ public:
+  template <typename F>
+  GroupByOperator(
+      std::shared_ptr<Flowable<T>> upstream,
+      F&& keyFunction,
+      size_t bufferSize)
+      : upstream_(std::move(upstream)),
+        keyFunction_(std::forward<F>(keyFunction)),
+        bufferSize_(static_cast<int64_t>(bufferSize)) {
+    CHECK_GT(bufferSize_, 0);
+  }
+
+  void subscribe(std::shared_ptr<Subscriber<std::shared_ptr<Group>>>
+                     subscriber) override {
+    upstream_->subscribe(std::make_shared<GroupBySubscription>(
+        this->ref_from_this(this), std::move(subscriber)));
+  }
+
+ private:
+  using SuperSubscription = typename Super::Subscription;
+  class GroupBySubscription;
+  class GroupSubscription;
+
+  class GroupState : public Group {
+   public:
+    GroupState(K key, std::shared_ptr<GroupBySubscription> parent)
+        : Group(std::move(key)), parent_(std::move(parent)) {}
+
+    void subscribe(std::shared_ptr<Subscriber<T>> subscriber) override {
+      bool first;
+      {
+        std::lock_guard<std::mutex> lock(parent_->mutex_);
+        first = !std::exchange(subscribed_, true);
+      }
+      if (!first) {
+        subscriber->onSubscribe(yarpl::flowable::Subscription::create());
+        subscriber->onError(
+            std::logic_error("GroupedFlowable already subscribed"));
+        return;
+      }
+
+      subscriber->onSubscribe(
+          std::make_shared<GroupSubscription>(this->ref_from_this(this)));
+      {
+        // Only now can the drain loop deliver to it.
+        std::lock_guard<std::mutex> lock(parent_->mutex_);
+        if (!done_) {
+          subscriber_ = std::move(subscriber);
+        }
+      }
+      parent_->drain();
+    }
+
+   private:
+    friend class GroupBySubscription;
+    friend class GroupSubscription;
+
+    // The group is in the map of its parent until it completes or is
+    // cancelled, which is what breaks this cycle.
+    std::shared_ptr<GroupBySubscription> const parent_;
+
+    // guarded by the mutex of the parent
+    std::shared_ptr<Subscriber<T>> subscriber_;
+    std::deque<T> queue_;
+    int64_t requested_{0};
+    bool subscribed_{false};
+    bool done_{false};
+  };
+
+  class GroupSubscription : public yarpl::flowable::Subscription {
+   public:
+    explicit GroupSubscription(std::shared_ptr<GroupState> group)
+        : group_(std::move(group)) {}
+
+    void request(int64_t n) override {
+      group_->parent_->requestGroup(*group_, n);
+    }
+
+    void cancel() override {
+      group_->parent_->cancelGroup(*group_);
+    }
+
+   private:
+    std::shared_ptr<GroupState> const group_;
+  };
+
+  class GroupBySubscription : public SuperSubscription {
+   public:
+    GroupBySubscription(
+        std::shared_ptr<GroupByOperator> flowable,
+        std::shared_ptr<Subscriber<std::shared_ptr<Group>>> subscriber)
+        : SuperSubscription(std::move(subscriber)),
+          flowable_(std::move(flowable)) {}
+
+    void onSubscribeImpl() override {
+      SuperSubscription::onSubscribeImpl();
+      drain();
+    }
+
+    void onNextImpl(T value) override {
+      folly::Optional<K> key;
+      try {
+        key = flowable_->keyFunction_(static_cast<const T&>(value));
+      } catch (const std::exception& exn) {
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          upstreamDone_ = true;
+          error_ = folly::exception_wrapper{std::current_exception(), exn};
+        }
+        BaseSubscriber<T>::cancel();
+        drain();
+        return;
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --outstanding_;
+        auto it = groups_.find(*key);
+        if (it == groups_.end()) {
+          if (cancelled_) {
+            // no new groups once the downstream is gone
+            return;
+          }
+          auto group = std::make_shared<GroupState>(
+              *key, this->ref_from_this(this));
+          it = groups_.emplace(std::move(*key), group).first;
+          newGroups_.push_back(std::move(group));
+        }
+        it->second->queue_.push_back(std::move(value));
+      }
+      drain();
+    }
+
+    void onCompleteImpl() override {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        upstreamDone_ = true;
+      }
+      drain();
+    }
+
+    void onErrorImpl(folly::exception_wrapper ew) override {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        upstreamDone_ = true;
+        error_ = std::move(ew);
+      }
+      drain();
+    }
+
+    // Demand for groups.
+    void request(int64_t n) override {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        groupsRequested_ = credits::add(groupsRequested_, n);
+      }
+      drain();
+    }
+
+    void cancel() override {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancelled_ = true;
+        for (auto& group : newGroups_) {
+          group->done_ = true;
+          evict(*group);
+        }
+        newGroups_.clear();
+      }
+      drain();
+    }
+
+    void requestGroup(GroupState& group, int64_t n) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        group.requested_ = credits::add(group.requested_, n);
+      }
+      drain();
+    }
+
+    void cancelGroup(GroupState& group) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        group.done_ = true;
+        group.subscriber_.reset();
+        group.queue_.clear();
+        evict(group);
+      }
+      drain();
+    }
+
+    void drain() {
+      if (drainLoopMutex_++ == 0) {
+        auto self = this->ref_from_this(this);
+        do {
+          while (drainOnce()) {
+          }
+        } while (drainLoopMutex_-- != 1);
+      }
+    }
+
+   private:
+    friend class GroupState;
+
+    // Takes what can be delivered under the lock and delivers it outside of
+    // it.  Returns whether there was anything to do.
+    bool drainOnce() {
+      std::vector<std::shared_ptr<Group>> opened;
+      std::vector<std::pair<std::shared_ptr<Subscriber<T>>, T>> values;
+      std::vector<std::shared_ptr<Subscriber<T>>> finished;
+      folly::exception_wrapper error;
+      bool finishMain = false;
+      bool cancelUpstream = false;
+      int64_t toRequest = 0;
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (terminated_) {
+          return false;
+        }
+
+        while (groupsRequested_ > 0 && !newGroups_.empty()) {
+          if (groupsRequested_ != credits::kNoFlowControl) {
+            --groupsRequested_;
+          }
+          opened.push_back(std::move(newGroups_.front()));
+          newGroups_.pop_front();
+        }
+
+        auto capacity = bufferSize();
+        std::vector<K> done;
+        for (auto& entry : groups_) {
+          auto& group = *entry.second;
+          while (group.subscriber_ && group.requested_ > 0 &&
+                 !group.queue_.empty()) {
+            if (group.requested_ != credits::kNoFlowControl) {
+              --group.requested_;
+            }
+            values.emplace_back(
+                group.subscriber_, std::move(group.queue_.front()));
+            group.queue_.pop_front();
+          }
+          if (upstreamDone_ && group.subscriber_ && group.queue_.empty()) {
+            group.done_ = true;
+            finished.push_back(std::move(group.subscriber_));
+            done.push_back(entry.first);
+            continue;
+          }
+          capacity = std::min(
+              capacity,
+              bufferSize() - static_cast<int64_t>(group.queue_.size()));
+        }
+        for (auto& key : done) {
+          groups_.erase(key);
+        }
+        error = error_;
+
+        if (!mainDone_ && newGroups_.empty() &&
+            (upstreamDone_ || cancelled_)) {
+          mainDone_ = true;
+          finishMain = !cancelled_;
+        }
+
+        if (!upstreamDone_) {
+          if (cancelled_ && groups_.empty()) {
+            upstreamDone_ = true;
+            cancelUpstream = true;
+          } else if (outstanding_ == 0 && newGroups_.empty() && capacity > 0) {
+            outstanding_ = toRequest = capacity;
+          }
+        }
+
+        if (upstreamDone_ && mainDone_ && groups_.empty()) {
+          terminated_ = true;
+        }
+      }
+
+      for (auto& group : opened) {
+        SuperSubscription::subscriberOnNext(std::move(group));
+      }
+      for (auto& value : values) {
+        value.first->onNext(std::move(value.second));
+      }
+      for (auto& subscriber : finished) {
+        if (error) {
+          subscriber->onError(error);
+        } else {
+          subscriber->onComplete();
+        }
+      }
+      if (finishMain) {
+        if (error) {
+          SuperSubscription::terminateErr(std::move(error));
+        } else {
+          SuperSubscription::terminate();
+        }
+      }
+      if (cancelUpstream) {
+        SuperSubscription::cancel();
+      }
+      if (toRequest > 0) {
+        SuperSubscription::request(toRequest);
+      }
+
+      return !opened.empty() || !values.empty() || !finished.empty() ||
+          finishMain || cancelUpstream || toRequest > 0;
+    }
+
+    int64_t bufferSize() const {
+      return flowable_->bufferSize_;
+    }
+
+    void evict(GroupState& group) {
+      auto it = groups_.find(group.key());
+      if (it != groups_.end() && it->second.get() == &group) {
+        groups_.erase(it);
+      }
+    }
+
+    std::shared_ptr<GroupByOperator> const flowable_;
+
+    std::atomic<int64_t> drainLoopMutex_{0};
+
+    std::mutex mutex_;
+    // live groups, by key
+    std::unordered_map<K, std::shared_ptr<GroupState>> groups_;
+    // groups waiting for downstream demand
+    std::deque<std::shared_ptr<GroupState>> newGroups_;
+    int64_t groupsRequested_{0};
+    // upstream elements requested and not yet received
+    int64_t outstanding_{0};
+    folly::exception_wrapper error_;
+    bool upstreamDone_{false};
+    bool cancelled_{false};
+    bool mainDone_{false};
+    bool terminated_{false};
+  };
+
+  std::shared_ptr<Flowable<T>> upstream_;
+  KeyFunction keyFunction_;
+  int64_t const bufferSize_;
+};
+
+} // namespace details
+} // namespace flowable
+} // namespace yarpl
@@ -14,6 +14,10 @@
 
 #pragma once
 
+#include <folly/concurrency/UnboundedQueue.h>
+
+#include <atomic>
+
 #include "yarpl/flowable/Flowable.h"
 
 namespace yarpl {
@@ -54,10 +58,21 @@ class ObserveOnOperatorSubscription : public yarpl::flowable::Subscription,
   std::shared_ptr<Subscription> subscription_;
 };
 
+/// Hands the signals of the upstream over to `executor_`.
+///
+/// Elements go through a lock-free queue rather than an executor task each.
+/// Only the element that finds no drain pending schedules one, and a drain
+/// delivers every element queued by the time it runs, up to kMaxBatch, so a
+/// burst of elements costs a single executor hop.  The queue never holds
+/// more elements than were requested, since the upstream can't send more.
 template <typename T>
 class ObserveOnOperatorSubscriber : public yarpl::flowable::Subscriber<T>,
                                     public yarpl::enable_get_ref {
  public:
+  /// Most elements delivered by one drain, before it yields the executor to
+  /// other tasks and schedules another.
+  static constexpr size_t kMaxBatch = 128;
+
   ObserveOnOperatorSubscriber(
       std::shared_ptr<Subscriber<T>> inner,
       folly::Executor::KeepAlive<> executor)
@@ -73,36 +88,75 @@ class ObserveOnOperatorSubscriber : public yarpl::flowable::Subscriber<T>,
     });
   }
   void onNext(T next) override {
-    executor_->add(
-        [self = this->ref_from_this(this), n = std::move(next)]() mutable {
-          if (auto& inner = self->inner_) {
-            inner->onNext(std::move(n));
-          }
-        });
+    queue_.enqueue(std::move(next));
+    scheduleDrain();
   }
   void onComplete() override {
-    executor_->add([self = this->ref_from_this(this)]() mutable {
-      if (auto inner = std::exchange(self->inner_, nullptr)) {
-        inner->onComplete();
-      }
-    });
+    terminated_.store(true, std::memory_order_release);
+    scheduleDrain();
   }
   void onError(folly::exception_wrapper err) override {
-    executor_->add(
-        [self = this->ref_from_this(this), e = std::move(err)]() mutable {
-          if (auto inner = std::exchange(self->inner_, nullptr)) {
-            inner->onError(std::move(e));
-          }
-        });
+    error_ = std::move(err);
+    terminated_.store(true, std::memory_order_release);
+    scheduleDrain();
   }
 
  private:
   friend class ObserveOnOperatorSubscription<T>;
 
+  void scheduleDrain() {
+    if (!drainScheduled_.exchange(true, std::memory_order_acq_rel)) {
+      executor_->add(
+          [self = this->ref_from_this(this)]() mutable { self->drain(); });
+    }
+  }
+
+  // called from 'executor_'
+  void drain() {
+    // Signals from now on schedule another drain, which finds nothing left if
+    // this one took everything.
+    drainScheduled_.exchange(false, std::memory_order_acq_rel);
+
+    // Read before taking the elements: if the upstream has terminated, every
+    // element it sent is in the queue by now.
+    auto const terminated = terminated_.load(std::memory_order_acquire);
+
+    for (size_t delivered = 0; inner_;) {
+      auto next = queue_.try_dequeue();
+      if (!next) {
+        break;
+      }
+      inner_->onNext(std::move(*next));
+      if (++delivered == kMaxBatch) {
+        scheduleDrain();
+        return;
+      }
+    }
+
+    if (!terminated) {
+      return;
+    }
+    if (auto inner = std::exchange(inner_, nullptr)) {
+      if (error_) {
+        inner->onError(std::move(error_));
+      } else {
+        inner->onComplete();
+      }
+    }
+  }
+
   std::shared_ptr<Subscriber<T>> inner_;
   folly::Executor::KeepAlive<> executor_;
+
+  folly::USPSCQueue<T, false /* MayBlock */> queue_;
+  std::atomic<bool> drainScheduled_{false};
+  std::atomic<bool> terminated_{false};
+  folly::exception_wrapper error_;
 };
 
+template <typename T>
+constexpr size_t ObserveOnOperatorSubscriber<T>::kMaxBatch;
+
 template <typename T>
 class ObserveOnOperator : public yarpl::flowable::Flowable<T> {
  public:
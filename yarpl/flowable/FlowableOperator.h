@@ -37,10 +37,17 @@ namespace flowable {
  * (downstream) and U (upstream).  Operators are created by method calls on an
  * upstream Flowable, and are Flowables themselves.  Multi-stage pipelines can
  * be built: a Flowable heading a sequence of Operators.
+ *
+ * Operators whose subscriptions only ever see serialized signals, from one
+ * thread at a time, can pass credits::ThreadConfined as `Confinement` so that
+ * their Credits counters avoid atomic read-modify-write operations.
  */
-template <typename U, typename D>
+template <typename U, typename D, typename Confinement = credits::Concurrent>
 class FlowableOperator : public Flowable<D> {
  protected:
+  /// Credits counter matching the confinement of the operator.
+  using Credits = credits::Credits<Confinement>;
+
   /// An Operator's subscription.
   ///
   /// When a pipeline chain is active, each Flowable has a corresponding
@@ -259,6 +266,200 @@ class FilterOperator : public FlowableOperator<U, U> {
   F function_;
 };
 
+namespace details {
+
+/// The stage of a FusedOperator that passes elements on as they are.
+struct IdentityStage {
+  template <typename T, typename Sink>
+  void operator()(T&& value, Sink& sink) {
+    sink(std::forward<T>(value));
+  }
+};
+
+/// Stage `First` followed by a map of its results.
+template <typename First, typename Function>
+struct MapStage {
+  template <typename T, typename Sink>
+  void operator()(T&& value, Sink& sink) {
+    auto next = [&](auto&& result) {
+      sink(function(std::forward<decltype(result)>(result)));
+    };
+    first(std::forward<T>(value), next);
+  }
+
+  First first;
+  Function function;
+};
+
+/// Stage `First` followed by a filter of its results.
+template <typename First, typename Predicate>
+struct FilterStage {
+  template <typename T, typename Sink>
+  void operator()(T&& value, Sink& sink) {
+    auto next = [&](auto&& result) {
+      if (predicate(result)) {
+        sink(std::forward<decltype(result)>(result));
+      }
+    };
+    first(std::forward<T>(value), next);
+  }
+
+  First first;
+  Predicate predicate;
+};
+
+struct IdentityErrorMapper {
+  folly::exception_wrapper operator()(folly::exception_wrapper&& ew) {
+    return std::move(ew);
+  }
+};
+
+template <typename First, typename Second>
+struct ComposedErrorMapper {
+  folly::exception_wrapper operator()(folly::exception_wrapper&& ew) {
+    return second(first(std::move(ew)));
+  }
+
+  First first;
+  Second second;
+};
+
+} // namespace details
+
+/// Consecutive map() and filter() operators fused into one, see
+/// Flowable::fuse().
+///
+/// `F` is the composition of the functions of all the fused operators, called
+/// as `function(value, sink)` with every upstream element, and calling `sink`
+/// with the downstream element unless a filter dropped it.  `EF` is the
+/// composition of the error mappers of the map() operators.
+///
+/// map() and filter() on a FusedOperator return a new FusedOperator with the
+/// function appended, and leave this one as it is.  The functions are copied
+/// into the new operator, so they must be copyable.
+template <typename U, typename D, typename F, typename EF>
+class FusedOperator : public FlowableOperator<U, D> {
+  using Super = FlowableOperator<U, D>;
+  static_assert(std::is_same<std::decay_t<F>, F>::value, "undecayed");
+
+ public:
+  FusedOperator(
+      std::shared_ptr<Flowable<U>> upstream,
+      F function,
+      EF errFunction)
+      : upstream_(std::move(upstream)),
+        function_(std::move(function)),
+        errFunction_(std::move(errFunction)) {}
+
+  void subscribe(std::shared_ptr<Subscriber<D>> subscriber) override {
+    upstream_->subscribe(std::make_shared<Subscription>(
+        this->ref_from_this(this), std::move(subscriber)));
+  }
+
+  template <
+      typename Function,
+      typename R = typename folly::invoke_result_t<Function, D>>
+  std::shared_ptr<FusedOperator<
+      U,
+      R,
+      details::MapStage<F, std::decay_t<Function>>,
+      EF>>
+  map(Function&& function) {
+    using Stage = details::MapStage<F, std::decay_t<Function>>;
+    return std::make_shared<FusedOperator<U, R, Stage, EF>>(
+        upstream_,
+        Stage{function_, std::forward<Function>(function)},
+        errFunction_);
+  }
+
+  template <
+      typename Function,
+      typename ErrorFunction,
+      typename R = typename folly::invoke_result_t<Function, D>>
+  std::shared_ptr<FusedOperator<
+      U,
+      R,
+      details::MapStage<F, std::decay_t<Function>>,
+      details::ComposedErrorMapper<EF, std::decay_t<ErrorFunction>>>>
+  map(Function&& function, ErrorFunction&& errFunction) {
+    using Stage = details::MapStage<F, std::decay_t<Function>>;
+    using ErrorMapper =
+        details::ComposedErrorMapper<EF, std::decay_t<ErrorFunction>>;
+    return std::make_shared<FusedOperator<U, R, Stage, ErrorMapper>>(
+        upstream_,
+        Stage{function_, std::forward<Function>(function)},
+        ErrorMapper{errFunction_, std::forward<ErrorFunction>(errFunction)});
+  }
+
+  template <typename Function>
+  std::shared_ptr<FusedOperator<
+      U,
+      D,
+      details::FilterStage<F, std::decay_t<Function>>,
+      EF>>
+  filter(Function&& function) {
+    using Stage = details::FilterStage<F, std::decay_t<Function>>;
+    return std::make_shared<FusedOperator<U, D, Stage, EF>>(
+        upstream_,
+        Stage{function_, std::forward<Function>(function)},
+        errFunction_);
+  }
+
+ private:
+  using SuperSubscription = typename Super::Subscription;
+  class Subscription : public SuperSubscription {
+   public:
+    Subscription(
+        std::shared_ptr<FusedOperator> flowable,
+        std::shared_ptr<Subscriber<D>> subscriber)
+        : SuperSubscription(std::move(subscriber)),
+          flowable_(std::move(flowable)) {}
+
+    void onNextImpl(U value) override {
+      try {
+        if (auto flowable = yarpl::atomic_load(&flowable_)) {
+          bool emitted = false;
+          auto sink = [&](auto&& result) {
+            emitted = true;
+            this->subscriberOnNext(D(std::forward<decltype(result)>(result)));
+          };
+          flowable->function_(std::move(value), sink);
+          if (!emitted) {
+            // Filtered out, ask for a replacement.
+            SuperSubscription::request(1);
+          }
+        }
+      } catch (const std::exception& exn) {
+        folly::exception_wrapper ew{std::current_exception(), exn};
+        this->terminateErr(std::move(ew));
+      }
+    }
+
+    void onErrorImpl(folly::exception_wrapper ew) override {
+      try {
+        if (auto flowable = yarpl::atomic_load(&flowable_)) {
+          SuperSubscription::onErrorImpl(flowable->errFunction_(std::move(ew)));
+        }
+      } catch (const std::exception& exn) {
+        this->terminateErr(
+            folly::exception_wrapper{std::current_exception(), exn});
+      }
+    }
+
+    void onTerminateImpl() override {
+      yarpl::atomic_exchange(&flowable_, nullptr);
+      SuperSubscription::onTerminateImpl();
+    }
+
+   private:
+    AtomicReference<FusedOperator> flowable_;
+  };
+
+  std::shared_ptr<Flowable<U>> upstream_;
+  F function_;
+  EF errFunction_;
+};
+
 template <typename U, typename D, typename F>
 class ReduceOperator : public FlowableOperator<U, D> {
   using Super = FlowableOperator<U, D>;
@@ -1004,7 +1205,13 @@ class FlatMapOperator : public FlowableOperator<T, R> {
 } // namespace flowable
 } // namespace yarpl
 
+#include "yarpl/flowable/FlowableBufferOperator.h"
 #include "yarpl/flowable/FlowableConcatOperators.h"
 #include "yarpl/flowable/FlowableDoOperator.h"
+#include "yarpl/flowable/FlowableFlatMapOperator.h"
+#include "yarpl/flowable/FlowableGroupByOperator.h"
 #include "yarpl/flowable/FlowableObserveOnOperator.h"
+#include "yarpl/flowable/FlowableRateLimitOperators.h"
+#include "yarpl/flowable/FlowableReplayOperator.h"
 #include "yarpl/flowable/FlowableTimeoutOperator.h"
+#include "yarpl/flowable/FlowableWindowOperators.h"
@@ -0,0 +1,317 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// IWYU pragma: private, include "yarpl/flowable/Flowable.h"
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include <folly/Optional.h>
+
+#include "yarpl/flowable/FlowableOperator.h"
+
+namespace yarpl {
+namespace flowable {
+namespace details {
+
+/// Emits an element and drops the ones that arrive within `window` of it,
+/// see Flowable::throttleFirst().  Like filter(), each dropped element is
+/// replaced by requesting another one from the upstream, so the downstream
+/// gets one element for each one it requested.
+template <typename T>
+class ThrottleFirstOperator : public FlowableOperator<T, T> {
+  using Super = FlowableOperator<T, T>;
+  using Clock = std::chrono::steady_clock;
+
+ public:
+  ThrottleFirstOperator(
+      std::shared_ptr<Flowable<T>> upstream,
+      std::chrono::milliseconds window)
+      : upstream_(std::move(upstream)), window_(window) {}
+
+  void subscribe(std::shared_ptr<Subscriber<T>> subscriber) override {
+    upstream_->subscribe(
+        std::make_shared<Subscription>(window_, std::move(subscriber)));
+  }
+
+ private:
+  using SuperSubscription = typename Super::Subscription;
+  class Subscription : public SuperSubscription {
+   public:
+    Subscription(
+        std::chrono::milliseconds window,
+        std::shared_ptr<Subscriber<T>> subscriber)
+        : SuperSubscription(std::move(subscriber)), window_(window) {}
+
+    void onNextImpl(T value) override {
+      auto const now = Clock::now();
+      if (lastEmitted_ && now - *lastEmitted_ < window_) {
+        SuperSubscription::request(1);
+        return;
+      }
+      lastEmitted_ = now;
+      SuperSubscription::subscriberOnNext(std::move(value));
+    }
+
+   private:
+    std::chrono::milliseconds const window_;
+    folly::Optional<Clock::time_point> lastEmitted_;
+  };
+
+  std::shared_ptr<Flowable<T>> upstream_;
+  std::chrono::milliseconds const window_;
+};
+
+/// Emits the newest element every `period`, see Flowable::sample().
+///
+/// The upstream is requested without limit.  A tick emits the element that
+/// arrived last since the previous tick, if the downstream has asked for one;
+/// otherwise the element is held, and replaced by newer ones, until a tick
+/// finds demand.  A held element is dropped when the upstream completes.
+///
+/// All signals, including request() and cancel(), must come from `timerEvb`.
+template <typename T>
+class SampleOperator : public FlowableOperator<T, T> {
+  using Super = FlowableOperator<T, T>;
+
+ public:
+  SampleOperator(
+      std::shared_ptr<Flowable<T>> upstream,
+      std::chrono::milliseconds period,
+      folly::EventBase& timerEvb)
+      : upstream_(std::move(upstream)), period_(period), timerEvb_(timerEvb) {
+    CHECK_GT(period_.count(), 0);
+  }
+
+  void subscribe(std::shared_ptr<Subscriber<T>> subscriber) override {
+    upstream_->subscribe(std::make_shared<SampleSubscription>(
+        this->ref_from_this(this), std::move(subscriber)));
+  }
+
+ private:
+  using SuperSubscription = typename Super::Subscription;
+  class SampleSubscription : public SuperSubscription,
+                             public folly::HHWheelTimer::Callback {
+   public:
+    SampleSubscription(
+        std::shared_ptr<SampleOperator> flowable,
+        std::shared_ptr<Subscriber<T>> subscriber)
+        : SuperSubscription(std::move(subscriber)),
+          flowable_(std::move(flowable)) {}
+
+    void onSubscribeImpl() override {
+      DCHECK(flowable_->timerEvb_.isInEventBaseThread());
+      SuperSubscription::onSubscribeImpl();
+      if (cancelled_) {
+        return;
+      }
+      flowable_->timerEvb_.timer().scheduleTimeout(this, flowable_->period_);
+      SuperSubscription::request(credits::kNoFlowControl);
+    }
+
+    void onNextImpl(T value) override {
+      DCHECK(flowable_->timerEvb_.isInEventBaseThread());
+      latest_ = std::move(value);
+    }
+
+    void onTerminateImpl() override {
+      cancelTimeout();
+      latest_.clear();
+      SuperSubscription::onTerminateImpl();
+    }
+
+    void request(int64_t n) override {
+      requested_ = credits::add(requested_, n);
+    }
+
+    void cancel() override {
+      cancelled_ = true;
+      cancelTimeout();
+      SuperSubscription::cancel();
+    }
+
+    void timeoutExpired() noexcept override {
+      // Scheduled ahead of the emission, so that a downstream cancelling from
+      // onNext() also cancels the next tick.
+      flowable_->timerEvb_.timer().scheduleTimeout(this, flowable_->period_);
+
+      if (latest_ && requested_ > 0) {
+        if (requested_ != credits::kNoFlowControl) {
+          --requested_;
+        }
+        auto value = std::move(*latest_);
+        latest_.clear();
+        SuperSubscription::subscriberOnNext(std::move(value));
+      }
+    }
+
+    void callbackCanceled() noexcept override {}
+
+   private:
+    std::shared_ptr<SampleOperator> flowable_;
+    folly::Optional<T> latest_;
+    int64_t requested_{0};
+    bool cancelled_{false};
+  };
+
+  std::shared_ptr<Flowable<T>> upstream_;
+  std::chrono::milliseconds const period_;
+  folly::EventBase& timerEvb_;
+};
+
+/// Paces the requests made to the upstream with a token bucket, see
+/// Flowable::rateLimit().
+///
+/// The bucket starts full with `burst` tokens, and refills at
+/// `permitsPerSecond` up to `burst`.  Each element requested from the upstream
+/// takes a token, so downstream demand is passed on as far as the bucket
+/// allows, and the rest is requested from a timer on `timerEvb` as tokens come
+/// back.  Elements are
+/// never dropped: the downstream only gets what it asked for, just later.
+///
+/// All signals, including request() and cancel(), must come from `timerEvb`.
+template <typename T>
+class RateLimitOperator : public FlowableOperator<T, T> {
+  using Super = FlowableOperator<T, T>;
+  using Clock = std::chrono::steady_clock;
+
+ public:
+  RateLimitOperator(
+      std::shared_ptr<Flowable<T>> upstream,
+      double permitsPerSecond,
+      int64_t burst,
+      folly::EventBase& timerEvb)
+      : upstream_(std::move(upstream)),
+        permitsPerSecond_(permitsPerSecond),
+        burst_(burst),
+        timerEvb_(timerEvb) {
+    CHECK_GT(permitsPerSecond_, 0);
+    CHECK_GT(burst_, 0);
+  }
+
+  void subscribe(std::shared_ptr<Subscriber<T>> subscriber) override {
+    upstream_->subscribe(std::make_shared<RateLimitSubscription>(
+        this->ref_from_this(this), std::move(subscriber)));
+  }
+
+ private:
+  using SuperSubscription = typename Super::Subscription;
+  class RateLimitSubscription : public SuperSubscription,
+                                public folly::HHWheelTimer::Callback {
+   public:
+    RateLimitSubscription(
+        std::shared_ptr<RateLimitOperator> flowable,
+        std::shared_ptr<Subscriber<T>> subscriber)
+        : SuperSubscription(std::move(subscriber)),
+          flowable_(std::move(flowable)),
+          tokens_(static_cast<double>(flowable_->burst_)),
+          lastRefill_(Clock::now()) {}
+
+    void onNextImpl(T value) override {
+      DCHECK(flowable_->timerEvb_.isInEventBaseThread());
+      --outstanding_;
+      if (requested_ != credits::kNoFlowControl) {
+        --requested_;
+      }
+      SuperSubscription::subscriberOnNext(std::move(value));
+    }
+
+    void onTerminateImpl() override {
+      terminated_ = true;
+      cancelTimeout();
+      SuperSubscription::onTerminateImpl();
+    }
+
+    void request(int64_t n) override {
+      DCHECK(flowable_->timerEvb_.isInEventBaseThread());
+      if (n <= 0) {
+        return;
+      }
+      requested_ = credits::add(requested_, n);
+      pump();
+    }
+
+    void cancel() override {
+      terminated_ = true;
+      cancelTimeout();
+      SuperSubscription::cancel();
+    }
+
+    void timeoutExpired() noexcept override {
+      pump();
+    }
+
+    void callbackCanceled() noexcept override {}
+
+   private:
+    // Requests from the upstream whatever the downstream asked for and has not
+    // been requested yet, as far as the tokens go.  The bookkeeping is done
+    // before calling request(), which may emit and so come back in here.
+    void pump() {
+      if (terminated_) {
+        return;
+      }
+      refill();
+
+      auto const unrequested = requested_ - outstanding_;
+      auto const n = std::min<int64_t>(
+          unrequested, static_cast<int64_t>(std::floor(tokens_)));
+      if (n > 0) {
+        tokens_ -= static_cast<double>(n);
+        outstanding_ += n;
+        SuperSubscription::request(n);
+      }
+
+      if (!terminated_ && requested_ > outstanding_ && !isScheduled()) {
+        auto const wait = (1.0 - tokens_) / flowable_->permitsPerSecond_;
+        auto const delay = std::chrono::milliseconds(std::max<int64_t>(
+            1, static_cast<int64_t>(std::ceil(wait * 1000))));
+        flowable_->timerEvb_.timer().scheduleTimeout(this, delay);
+      }
+    }
+
+    void refill() {
+      auto const now = Clock::now();
+      std::chrono::duration<double> const elapsed = now - lastRefill_;
+      lastRefill_ = now;
+      tokens_ = std::min(
+          static_cast<double>(flowable_->burst_),
+          tokens_ + elapsed.count() * flowable_->permitsPerSecond_);
+    }
+
+    std::shared_ptr<RateLimitOperator> flowable_;
+
+    double tokens_;
+    Clock::time_point lastRefill_;
+
+    // downstream elements requested and not yet delivered
+    int64_t requested_{0};
+    // upstream elements requested and not yet received
+    int64_t outstanding_{0};
+
+    bool terminated_{false};
+  };
+
+  std::shared_ptr<Flowable<T>> upstream_;
+  double const permitsPerSecond_;
+  int64_t const burst_;
+  folly::EventBase& timerEvb_;
+};
+
+} // namespace details
+} // namespace flowable
+} // namespace yarpl
@@ -0,0 +1,423 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// IWYU pragma: private, include "yarpl/flowable/Flowable.h"
+
+#pragma once
+
+#include <folly/Function.h>
+#include <folly/Optional.h>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#include "yarpl/Common.h"
+#include "yarpl/flowable/Flowable.h"
+#include "yarpl/utils/credits.h"
+
+namespace yarpl {
+namespace flowable {
+namespace details {
+
+/// Multicasts the upstream to any number of subscribers, replaying what it
+/// has already emitted to those that subscribe late, see Flowable::replay()
+/// and Flowable::cache().
+///
+/// The upstream is subscribed to, with unbounded demand, when the first
+/// subscriber arrives, and stays subscribed when subscribers cancel.
+/// Elements are appended to a linked list of fixed-size segments that are
+/// never modified once written; every subscriber only holds a cursor into
+/// that list and its own credits, and gets a copy (see ValueCopy) of each
+/// element as it is delivered.  So N subscribers cost one stored copy of the
+/// stream rather than N queues.
+///
+/// Elements are compacted as they are stored (see ValueRetain), so that the
+/// ones retained don't pin the larger buffers they arrived in.
+///
+/// The retained window is bounded by `maxItems` elements and by `maxBytes`
+/// as measured by `sizeOf`, always keeping at least the newest element.
+/// Elements that fall out of the window are no longer replayed to new
+/// subscribers, and their segments are freed once every existing subscriber
+/// has moved past them.
+template <typename T>
+class ReplayOperator : public Flowable<T> {
+ public:
+  using SizeFunction = folly::Function<size_t(const T&)>;
+
+  ReplayOperator(
+      std::shared_ptr<Flowable<T>> upstream,
+      size_t maxItems,
+      size_t maxBytes,
+      SizeFunction sizeOf)
+      : upstream_(std::move(upstream)),
+        maxItems_(maxItems),
+        maxBytes_(maxBytes),
+        sizeOf_(std::move(sizeOf)),
+        head_(std::make_shared<Segment>()),
+        tail_(head_),
+        subscriptions_(std::make_shared<const SubscriptionsVector>()) {
+    CHECK_GT(maxItems_, 0);
+    CHECK(sizeOf_ || maxBytes_ == std::numeric_limits<size_t>::max());
+  }
+
+  void subscribe(std::shared_ptr<Subscriber<T>> subscriber) override {
+    auto subscription =
+        std::make_shared<ReplaySubscription>(this->ref_from_this(this));
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      subscription->start(subscriber, head_, headIndex_);
+    }
+    subscriber->onSubscribe(subscription);
+
+    // Elements that arrive before the subscription is listed are picked up
+    // by the drain() that follows.
+    addSubscription(subscription);
+    if (subscription->isCancelled()) {
+      removeSubscription(subscription.get());
+    }
+    subscription->drain();
+
+    if (!connected_.exchange(true)) {
+      upstream_->subscribe(
+          std::make_shared<UpstreamSubscriber>(this->ref_from_this(this)));
+    }
+  }
+
+ private:
+  static constexpr size_t kSegmentSize = 64;
+
+  /// A run of consecutive elements.  Only the upstream appends to the tail
+  /// segment; subscribers read the elements below size() without locking.
+  class Segment {
+   public:
+    Segment() : slots_(new folly::Optional<T>[kSegmentSize]) {}
+
+    ~Segment() {
+      // Unlink the segments that only this one refers to iteratively, so
+      // that freeing a long replay does not recurse once per segment.
+      auto next = yarpl::atomic_exchange(&next_, nullptr);
+      while (next && next.use_count() == 1) {
+        next = yarpl::atomic_exchange(&next->next_, nullptr);
+      }
+    }
+
+    size_t size() const {
+      return size_.load(std::memory_order_acquire);
+    }
+
+    bool full() const {
+      return size_.load(std::memory_order_relaxed) == kSegmentSize;
+    }
+
+    const T& operator[](size_t index) const {
+      return *slots_[index];
+    }
+
+    void append(T value) {
+      auto const size = size_.load(std::memory_order_relaxed);
+      slots_[size] = std::move(value);
+      size_.store(size + 1, std::memory_order_release);
+    }
+
+    std::shared_ptr<Segment> next() const {
+      return yarpl::atomic_load(&next_);
+    }
+
+    void setNext(std::shared_ptr<Segment> next) {
+      yarpl::atomic_store(&next_, std::move(next));
+    }
+
+   private:
+    std::unique_ptr<folly::Optional<T>[]> slots_;
+    std::atomic<size_t> size_{0};
+    mutable AtomicReference<Segment> next_;
+  };
+
+  class ReplaySubscription : public Subscription,
+                             public yarpl::enable_get_ref {
+   public:
+    explicit ReplaySubscription(std::shared_ptr<ReplayOperator> flowable)
+        : flowable_(std::move(flowable)) {}
+
+    void start(
+        std::shared_ptr<Subscriber<T>> subscriber,
+        std::shared_ptr<Segment> segment,
+        size_t index) {
+      subscriber_ = std::move(subscriber);
+      segment_ = std::move(segment);
+      index_ = index;
+    }
+
+    bool isCancelled() const {
+      return cancelled_;
+    }
+
+    void request(int64_t n) override {
+      credits::add(&requested_, n);
+      drain();
+    }
+
+    void cancel() override {
+      cancelled_ = true;
+      flowable_->removeSubscription(this);
+      drain();
+    }
+
+    void drain() {
+      if (drainLoopMutex_++ == 0) {
+        // The subscriber may drop the last reference to this on termination.
+        auto self = this->ref_from_this(this);
+        do {
+          drainImpl();
+        } while (drainLoopMutex_-- != 1);
+      }
+    }
+
+   private:
+    void drainImpl() {
+      if (!subscriber_) {
+        return;
+      }
+
+      auto const requested = requested_.load();
+      int64_t emitted = 0;
+      while (!cancelled_) {
+        auto const done = flowable_->done_.load(std::memory_order_acquire);
+        if (index_ == kSegmentSize) {
+          if (auto next = segment_->next()) {
+            segment_ = std::move(next);
+            index_ = 0;
+          }
+        }
+
+        if (index_ == kSegmentSize || index_ >= segment_->size()) {
+          if (done) {
+            terminate();
+            return;
+          }
+          break;
+        }
+        if (requested != credits::kNoFlowControl && emitted == requested) {
+          break;
+        }
+
+        auto const& value = (*segment_)[index_++];
+        ++emitted;
+        subscriber_->onNext(yarpl::details::ValueCopy<T>::copy(value));
+      }
+
+      if (cancelled_) {
+        subscriber_.reset();
+        segment_.reset();
+        return;
+      }
+      credits::consume(&requested_, emitted);
+    }
+
+    void terminate() {
+      auto subscriber = std::move(subscriber_);
+      segment_.reset();
+      flowable_->removeSubscription(this);
+      if (flowable_->error_) {
+        subscriber->onError(flowable_->error_);
+      } else {
+        subscriber->onComplete();
+      }
+    }
+
+    std::shared_ptr<ReplayOperator> flowable_;
+    std::shared_ptr<Subscriber<T>> subscriber_;
+
+    // Cursor: the next element to deliver is (*segment_)[index_].
+    std::shared_ptr<Segment> segment_;
+    size_t index_{0};
+
+    std::atomic<int64_t> requested_{0};
+    std::atomic<bool> cancelled_{false};
+    std::atomic<int> drainLoopMutex_{0};
+  };
+
+  class UpstreamSubscriber : public BaseSubscriber<T> {
+   public:
+    explicit UpstreamSubscriber(std::shared_ptr<ReplayOperator> flowable)
+        : flowable_(std::move(flowable)) {}
+
+   private:
+    void onSubscribeImpl() override {
+      this->request(credits::kNoFlowControl);
+    }
+
+    void onNextImpl(T value) override {
+      flowable_->append(std::move(value));
+    }
+
+    void onCompleteImpl() override {
+      flowable_->finish(folly::exception_wrapper());
+    }
+
+    void onErrorImpl(folly::exception_wrapper ew) override {
+      flowable_->finish(std::move(ew));
+    }
+
+    void onTerminateImpl() override {
+      flowable_.reset();
+    }
+
+    std::shared_ptr<ReplayOperator> flowable_;
+  };
+
+  using SubscriptionsVector = std::vector<std::shared_ptr<ReplaySubscription>>;
+
+  void append(T value) {
+    // Outside of the lock, this may copy the value.
+    yarpl::details::ValueRetain<T>::retain(value);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      size_t size = 0;
+      if (sizeOf_) {
+        size = sizeOf_(value);
+        sizes_.push_back(size);
+        bytes_ += size;
+      }
+
+      if (tail_->full()) {
+        auto segment = std::make_shared<Segment>();
+        segment->append(std::move(value));
+        tail_->setNext(segment);
+        tail_ = std::move(segment);
+      } else {
+        tail_->append(std::move(value));
+      }
+      ++retained_;
+
+      while (retained_ > 1 && (retained_ > maxItems_ || bytes_ > maxBytes_)) {
+        evictOldest();
+      }
+    }
+    notify();
+  }
+
+  void evictOldest() {
+    --retained_;
+    if (sizeOf_) {
+      bytes_ -= sizes_.front();
+      sizes_.pop_front();
+    }
+    if (++headIndex_ == kSegmentSize) {
+      head_ = head_->next();
+      headIndex_ = 0;
+    }
+  }
+
+  void finish(folly::exception_wrapper ew) {
+    error_ = std::move(ew);
+    done_.store(true, std::memory_order_release);
+    notify();
+  }
+
+  void notify() {
+    auto subscriptions = yarpl::atomic_load(&subscriptions_);
+    for (const auto& subscription : *subscriptions) {
+      subscription->drain();
+    }
+  }
+
+  void addSubscription(std::shared_ptr<ReplaySubscription> subscription) {
+    while (true) {
+      auto oldSubscriptions = yarpl::atomic_load(&subscriptions_);
+      auto newSubscriptions = std::make_shared<SubscriptionsVector>();
+      newSubscriptions->reserve(oldSubscriptions->size() + 1);
+      newSubscriptions->insert(
+          newSubscriptions->begin(),
+          oldSubscriptions->cbegin(),
+          oldSubscriptions->cend());
+      newSubscriptions->push_back(subscription);
+
+      if (yarpl::atomic_compare_exchange(
+              &subscriptions_,
+              &oldSubscriptions,
+              std::shared_ptr<const SubscriptionsVector>(
+                  std::move(newSubscriptions)))) {
+        return;
+      }
+      // else the vector changed so we will have to do it again
+    }
+  }
+
+  void removeSubscription(ReplaySubscription* subscription) {
+    while (true) {
+      auto oldSubscriptions = yarpl::atomic_load(&subscriptions_);
+      auto removing = std::find_if(
+          oldSubscriptions->cbegin(),
+          oldSubscriptions->cend(),
+          [&](const auto& ptr) { return ptr.get() == subscription; });
+      if (removing == oldSubscriptions->cend()) {
+        return;
+      }
+
+      auto newSubscriptions = std::make_shared<SubscriptionsVector>();
+      newSubscriptions->reserve(oldSubscriptions->size() - 1);
+      newSubscriptions->insert(
+          newSubscriptions->begin(), oldSubscriptions->cbegin(), removing);
+      newSubscriptions->insert(
+          newSubscriptions->end(),
+          std::next(removing),
+          oldSubscriptions->cend());
+
+      if (yarpl::atomic_compare_exchange(
+              &subscriptions_,
+              &oldSubscriptions,
+              std::shared_ptr<const SubscriptionsVector>(
+                  std::move(newSubscriptions)))) {
+        return;
+      }
+      // else the vector changed so we will have to do it again
+    }
+  }
+
+  const std::shared_ptr<Flowable<T>> upstream_;
+  const size_t maxItems_;
+  const size_t maxBytes_;
+  SizeFunction sizeOf_;
+
+  std::atomic<bool> connected_{false};
+
+  // Written before done_ is set, read after it is seen.
+  folly::exception_wrapper error_;
+  std::atomic<bool> done_{false};
+
+  // Guards the retained window; the tail is only appended to by the
+  // upstream.
+  std::mutex mutex_;
+  std::shared_ptr<Segment> head_;
+  size_t headIndex_{0};
+  std::shared_ptr<Segment> tail_;
+  size_t retained_{0};
+  size_t bytes_{0};
+  std::deque<size_t> sizes_;
+
+  AtomicReference<const SubscriptionsVector> subscriptions_;
+};
+
+template <typename T>
+constexpr size_t ReplayOperator<T>::kSegmentSize;
+
+} // namespace details
+} // namespace flowable
+} // namespace yarpl
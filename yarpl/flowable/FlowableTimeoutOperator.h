@@ -37,6 +37,15 @@ class TimeoutExceptionGenerator {
 namespace flowable {
 namespace details {
 
+/// Fails the stream when no element arrives within `timeout` of the previous
+/// one, or within `initTimeout` of subscribing.
+///
+/// The subscription keeps a single timeout scheduled on the HHWheelTimer of
+/// `timerEvb`, which is shared by every stream on that EventBase.  An element
+/// only moves the deadline forward; the timer is not rescheduled for it.
+/// When the timer fires before the current deadline it is scheduled again for
+/// the time that is left, so a busy stream costs one timer callback per
+/// timeout period rather than a cancel and reschedule per element.
 template <typename T, typename ExceptionGenerator>
 class TimeoutOperator : public FlowableOperator<T, T> {
   using Super = FlowableOperator<T, T>;
@@ -72,6 +81,7 @@ class TimeoutOperator : public FlowableOperator<T, T> {
   class TimeoutSubscription : public Super::Subscription,
                               public folly::HHWheelTimer::Callback {
     using SuperSub = typename Super::Subscription;
+    using Clock = std::chrono::steady_clock;
 
    public:
     TimeoutSubscription(
@@ -89,10 +99,10 @@ class TimeoutOperator : public FlowableOperator<T, T> {
     void onSubscribeImpl() override {
       DCHECK(timerEvb_.isInEventBaseThread());
       if (initTimeout_.count() > 0) {
-        nextTime_ = std::chrono::steady_clock::now() + initTimeout_;
+        nextTime_ = Clock::now() + initTimeout_;
         timerEvb_.timer().scheduleTimeout(this, initTimeout_);
       } else {
-        nextTime_ = std::chrono::steady_clock::time_point::max();
+        nextTime_ = Clock::time_point::max();
       }
 
       SuperSub::onSubscribeImpl();
@@ -101,21 +111,27 @@ class TimeoutOperator : public FlowableOperator<T, T> {
     void onNextImpl(T value) override {
       DCHECK(timerEvb_.isInEventBaseThread());
       if (flowable_) {
-        if (nextTime_ != std::chrono::steady_clock::time_point::max()) {
-          cancelTimeout(); // cancel timer before calling onNext
-          auto currentTime = std::chrono::steady_clock::now();
-          if (currentTime > nextTime_) {
-            timeoutExpired();
-            return;
-          }
-          nextTime_ = std::chrono::steady_clock::time_point::max();
+        // The timer may be overdue without having fired yet.
+        if (nextTime_ != Clock::time_point::max() &&
+            Clock::now() > nextTime_) {
+          cancelTimeout();
+          expire();
+          return;
         }
 
         SuperSub::subscriberOnNext(std::move(value));
+        if (!flowable_) {
+          return;
+        }
 
         if (timeout_.count() > 0) {
-          nextTime_ = std::chrono::steady_clock::now() + timeout_;
-          timerEvb_.timer().scheduleTimeout(this, timeout_);
+          nextTime_ = Clock::now() + timeout_;
+          if (!isScheduled()) {
+            timerEvb_.timer().scheduleTimeout(this, timeout_);
+          }
+        } else if (nextTime_ != Clock::time_point::max()) {
+          nextTime_ = Clock::time_point::max();
+          cancelTimeout();
         }
       }
     }
@@ -127,6 +143,27 @@ class TimeoutOperator : public FlowableOperator<T, T> {
     }
 
     void timeoutExpired() noexcept override {
+      if (!flowable_ || nextTime_ == Clock::time_point::max()) {
+        return;
+      }
+      auto const now = Clock::now();
+      if (now < nextTime_) {
+        timerEvb_.timer().scheduleTimeout(
+            this,
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                nextTime_ - now) +
+                std::chrono::milliseconds(1));
+        return;
+      }
+      expire();
+    }
+
+    void callbackCanceled() noexcept override {
+      // Do nothing..
+    }
+
+   private:
+    void expire() {
       if (auto flowable = std::exchange(flowable_, nullptr)) {
         SuperSub::terminateErr([&]() -> folly::exception_wrapper {
           try {
@@ -138,16 +175,12 @@ class TimeoutOperator : public FlowableOperator<T, T> {
       }
     }
 
-    void callbackCanceled() noexcept override {
-      // Do nothing..
-    }
-
-   private:
     std::shared_ptr<TimeoutOperator<T, ExceptionGenerator>> flowable_;
     folly::EventBase& timerEvb_;
     std::chrono::milliseconds initTimeout_;
     std::chrono::milliseconds timeout_;
-    std::chrono::steady_clock::time_point nextTime_;
+    // deadline for the next element, or max() when there is none
+    Clock::time_point nextTime_;
   };
 
   std::shared_ptr<Flowable<T>> upstream_;
@@ -0,0 +1,350 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// IWYU pragma: private, include "yarpl/flowable/Flowable.h"
+
+#pragma once
+
+#include <chrono>
+#include <deque>
+
+#include <folly/Optional.h>
+
+#include "yarpl/flowable/FlowableOperator.h"
+
+namespace yarpl {
+namespace flowable {
+namespace details {
+
+/// Emits the accumulator after each element, see Flowable::scan().  The
+/// accumulator is moved through `function` and copied out to the downstream,
+/// one element for one element, so requests pass straight through.
+template <typename T, typename R, typename F>
+class ScanOperator : public FlowableOperator<T, R> {
+  using Super = FlowableOperator<T, R>;
+  static_assert(std::is_same<std::decay_t<F>, F>::value, "undecayed");
+  static_assert(folly::is_invocable_r<R, F&, R, T>::value, "not invocable");
+  static_assert(std::is_copy_constructible<R>::value, "not copyable");
+
+ public:
+  template <typename Func>
+  ScanOperator(std::shared_ptr<Flowable<T>> upstream, R seed, Func&& function)
+      : upstream_(std::move(upstream)),
+        seed_(std::move(seed)),
+        function_(std::forward<Func>(function)) {}
+
+  void subscribe(std::shared_ptr<Subscriber<R>> subscriber) override {
+    upstream_->subscribe(std::make_shared<Subscription>(
+        this->ref_from_this(this), std::move(subscriber)));
+  }
+
+ private:
+  using SuperSubscription = typename Super::Subscription;
+  class Subscription : public SuperSubscription {
+   public:
+    Subscription(
+        std::shared_ptr<ScanOperator> flowable,
+        std::shared_ptr<Subscriber<R>> subscriber)
+        : SuperSubscription(std::move(subscriber)),
+          flowable_(std::move(flowable)),
+          acc_(flowable_->seed_) {}
+
+    void onNextImpl(T value) override {
+      try {
+        acc_ = flowable_->function_(std::move(acc_), std::move(value));
+      } catch (const std::exception& exn) {
+        SuperSubscription::terminateErr(
+            folly::exception_wrapper{std::current_exception(), exn});
+        return;
+      }
+      SuperSubscription::subscriberOnNext(acc_);
+    }
+
+   private:
+    std::shared_ptr<ScanOperator> const flowable_;
+    R acc_;
+  };
+
+  std::shared_ptr<Flowable<T>> upstream_;
+  R const seed_;
+  F function_;
+};
+
+/// Folds every element into the accumulator in place, and emits it once the
+/// upstream completes, see Flowable::reduceInto().  Like reduce(), this
+/// requests all of the upstream.
+template <typename T, typename R, typename F>
+class ReduceIntoOperator : public FlowableOperator<T, R> {
+  using Super = FlowableOperator<T, R>;
+  static_assert(std::is_same<std::decay_t<F>, F>::value, "undecayed");
+  static_assert(folly::is_invocable<F&, R&, T>::value, "not invocable");
+
+ public:
+  template <typename Func>
+  ReduceIntoOperator(
+      std::shared_ptr<Flowable<T>> upstream,
+      R seed,
+      Func&& function)
+      : upstream_(std::move(upstream)),
+        seed_(std::move(seed)),
+        function_(std::forward<Func>(function)) {}
+
+  void subscribe(std::shared_ptr<Subscriber<R>> subscriber) override {
+    upstream_->subscribe(std::make_shared<Subscription>(
+        this->ref_from_this(this), std::move(subscriber)));
+  }
+
+ private:
+  using SuperSubscription = typename Super::Subscription;
+  class Subscription : public SuperSubscription {
+   public:
+    Subscription(
+        std::shared_ptr<ReduceIntoOperator> flowable,
+        std::shared_ptr<Subscriber<R>> subscriber)
+        : SuperSubscription(std::move(subscriber)),
+          flowable_(std::move(flowable)),
+          acc_(flowable_->seed_) {}
+
+    void request(int64_t) override {
+      SuperSubscription::request(credits::kNoFlowControl);
+    }
+
+    void onNextImpl(T value) override {
+      try {
+        flowable_->function_(acc_, std::move(value));
+      } catch (const std::exception& exn) {
+        SuperSubscription::terminateErr(
+            folly::exception_wrapper{std::current_exception(), exn});
+      }
+    }
+
+    void onCompleteImpl() override {
+      SuperSubscription::subscriberOnNext(std::move(acc_));
+      SuperSubscription::onCompleteImpl();
+    }
+
+   private:
+    std::shared_ptr<ReduceIntoOperator> const flowable_;
+    R acc_;
+  };
+
+  std::shared_ptr<Flowable<T>> upstream_;
+  R const seed_;
+  F function_;
+};
+
+/// Folds the elements of each window into a fresh copy of the seed, in place,
+/// and emits the result when the window closes, see Flowable::window() and
+/// Flowable::windowTimeout().
+///
+/// A window closes once it holds `count` elements, `timeout` after its first
+/// element arrived, or when the upstream completes.  Like buffer(), a request
+/// for n windows becomes a request for n * count elements, and windows closed
+/// early by the timer wait for the next downstream request.
+///
+/// Like take() and skip(), this expects request() and the upstream signals to
+/// be serialized.  With a timeout they must all come from `timerEvb`.
+template <typename T, typename R, typename F>
+class WindowOperator : public FlowableOperator<T, R> {
+  using Super = FlowableOperator<T, R>;
+  static_assert(std::is_same<std::decay_t<F>, F>::value, "undecayed");
+  static_assert(folly::is_invocable<F&, R&, T>::value, "not invocable");
+  static_assert(std::is_copy_constructible<R>::value, "not copyable");
+
+ public:
+  template <typename Func>
+  WindowOperator(
+      std::shared_ptr<Flowable<T>> upstream,
+      size_t count,
+      std::chrono::milliseconds timeout,
+      folly::EventBase* timerEvb,
+      R seed,
+      Func&& function)
+      : upstream_(std::move(upstream)),
+        count_(count),
+        timeout_(timeout),
+        timerEvb_(timerEvb),
+        seed_(std::move(seed)),
+        function_(std::forward<Func>(function)) {
+    CHECK_GT(count_, 0);
+    CHECK(timeout_.count() == 0 || timerEvb_);
+  }
+
+  void subscribe(std::shared_ptr<Subscriber<R>> subscriber) override {
+    upstream_->subscribe(std::make_shared<WindowSubscription>(
+        this->ref_from_this(this), std::move(subscriber)));
+  }
+
+ private:
+  using SuperSubscription = typename Super::Subscription;
+  class WindowSubscription : public SuperSubscription,
+                             public folly::HHWheelTimer::Callback {
+   public:
+    WindowSubscription(
+        std::shared_ptr<WindowOperator> flowable,
+        std::shared_ptr<Subscriber<R>> subscriber)
+        : SuperSubscription(std::move(subscriber)),
+          flowable_(std::move(flowable)) {}
+
+    void onNextImpl(T value) override {
+      auto& flowable = *flowable_;
+      DCHECK(!isTimed() || flowable.timerEvb_->isInEventBaseThread());
+
+      if (!current_) {
+        current_.emplace(flowable.seed_);
+        if (isTimed()) {
+          flowable.timerEvb_->timer().scheduleTimeout(this, flowable.timeout_);
+        }
+      }
+      try {
+        flowable.function_(*current_, std::move(value));
+      } catch (const std::exception& exn) {
+        terminated_ = true;
+        current_.clear();
+        ready_.clear();
+        SuperSubscription::terminateErr(
+            folly::exception_wrapper{std::current_exception(), exn});
+        return;
+      }
+
+      if (++currentCount_ >= flowable.count_) {
+        closeWindow();
+      }
+      drain();
+    }
+
+    void onCompleteImpl() override {
+      closeWindow();
+      upstreamDone_ = true;
+      drain();
+    }
+
+    void onErrorImpl(folly::exception_wrapper ew) override {
+      terminated_ = true;
+      current_.clear();
+      ready_.clear();
+      SuperSubscription::onErrorImpl(std::move(ew));
+    }
+
+    void onTerminateImpl() override {
+      cancelTimeout();
+      SuperSubscription::onTerminateImpl();
+    }
+
+    void request(int64_t n) override {
+      if (n <= 0) {
+        return;
+      }
+      requested_ = credits::add(requested_, n);
+      auto const count = static_cast<int64_t>(flowable_->count_);
+      SuperSubscription::request(
+          n > credits::kNoFlowControl / count ? credits::kNoFlowControl
+                                              : n * count);
+      drain();
+    }
+
+    void cancel() override {
+      cancelled_ = true;
+      cancelTimeout();
+      SuperSubscription::cancel();
+    }
+
+    void timeoutExpired() noexcept override {
+      closeWindow();
+      drain();
+    }
+
+    void callbackCanceled() noexcept override {}
+
+   private:
+    bool isTimed() const {
+      return flowable_->timeout_.count() > 0;
+    }
+
+    void closeWindow() {
+      if (isTimed()) {
+        cancelTimeout();
+      }
+      if (current_) {
+        ready_.push_back(std::move(*current_));
+        current_.clear();
+        currentCount_ = 0;
+      }
+    }
+
+    // See BufferOperator: nested calls only make the outermost one go around
+    // again.
+    void drain() {
+      if (draining_) {
+        missed_ = true;
+        return;
+      }
+      draining_ = true;
+      do {
+        missed_ = false;
+        drainOnce();
+      } while (missed_);
+      draining_ = false;
+    }
+
+    void drainOnce() {
+      if (terminated_) {
+        return;
+      }
+
+      while (requested_ > 0 && !ready_.empty() && !cancelled_) {
+        auto window = std::move(ready_.front());
+        ready_.pop_front();
+        if (requested_ != credits::kNoFlowControl) {
+          --requested_;
+        }
+        SuperSubscription::subscriberOnNext(std::move(window));
+      }
+      if (cancelled_) {
+        return;
+      }
+
+      if (upstreamDone_ && ready_.empty()) {
+        terminated_ = true;
+        SuperSubscription::terminate();
+      }
+    }
+
+    std::shared_ptr<WindowOperator> flowable_;
+
+    folly::Optional<R> current_;
+    size_t currentCount_{0};
+    std::deque<R> ready_;
+
+    // downstream windows requested and not yet delivered
+    int64_t requested_{0};
+
+    bool upstreamDone_{false};
+    bool cancelled_{false};
+    bool terminated_{false};
+    bool draining_{false};
+    bool missed_{false};
+  };
+
+  std::shared_ptr<Flowable<T>> upstream_;
+  size_t const count_;
+  std::chrono::milliseconds const timeout_;
+  folly::EventBase* const timerEvb_;
+  R const seed_;
+  F function_;
+};
+
+} // namespace details
+} // namespace flowable
+} // namespace yarpl
@@ -14,8 +14,11 @@
 
 #pragma once
 
+#include <folly/Optional.h>
 #include <folly/Synchronized.h>
 #include <deque>
+#include <queue>
+#include <vector>
 #include "yarpl/Common.h"
 #include "yarpl/Flowable.h"
 #include "yarpl/utils/credits.h"
@@ -179,8 +182,10 @@ class BufferBackpressureStrategy : public BackpressureStrategyBase<T> {
  public:
   static constexpr size_t kNoLimit = 0;
 
-  explicit BufferBackpressureStrategy(size_t bufferSizeLimit = kNoLimit)
-      : buffer_(folly::in_place, bufferSizeLimit) {}
+  explicit BufferBackpressureStrategy(
+      size_t bufferSizeLimit = kNoLimit,
+      BufferOverflowPolicy overflowPolicy = BufferOverflowPolicy::ERROR)
+      : buffer_(folly::in_place, bufferSizeLimit, overflowPolicy) {}
 
  private:
   using Super = BackpressureStrategyBase<T>;
@@ -235,33 +240,68 @@ class BufferBackpressureStrategy : public BackpressureStrategyBase<T> {
     }
   }
 
+  // Unbounded, a queue.  Bounded, a ring of `sizeLimit` slots allocated up
+  // front, so that pushing and popping never allocate.
   struct Buffer {
    public:
-    explicit Buffer(size_t sizeLimit) : sizeLimit_(sizeLimit) {}
+    Buffer(size_t sizeLimit, BufferOverflowPolicy overflowPolicy)
+        : sizeLimit_(sizeLimit), overflowPolicy_(overflowPolicy) {
+      if (sizeLimit_ != kNoLimit) {
+        ring_.resize(sizeLimit_);
+      }
+    }
 
     bool empty() const {
-      return buffer_.empty();
+      return size_ == 0;
     }
 
+    // Returns false if the buffer is full and the overflow policy is ERROR.
     bool push(T&& value) {
-      if (sizeLimit_ != kNoLimit && buffer_.size() >= sizeLimit_) {
-        return false;
+      if (sizeLimit_ == kNoLimit) {
+        queue_.push(std::move(value));
+        ++size_;
+        return true;
+      }
+
+      if (size_ == sizeLimit_) {
+        switch (overflowPolicy_) {
+          case BufferOverflowPolicy::ERROR:
+            return false;
+          case BufferOverflowPolicy::DROP_NEWEST:
+            return true;
+          case BufferOverflowPolicy::DROP_OLDEST:
+            pop();
+            break;
+        }
       }
-      buffer_.push(std::move(value));
+      ring_[(head_ + size_) % sizeLimit_] = std::move(value);
+      ++size_;
       return true;
     }
 
     T& front() {
-      return buffer_.front();
+      return sizeLimit_ == kNoLimit ? queue_.front() : *ring_[head_];
     }
 
     void pop() {
-      buffer_.pop();
+      if (sizeLimit_ == kNoLimit) {
+        queue_.pop();
+      } else {
+        ring_[head_].clear();
+        head_ = (head_ + 1) % sizeLimit_;
+      }
+      --size_;
     }
 
    private:
     const size_t sizeLimit_;
-    std::queue<T> buffer_;
+    const BufferOverflowPolicy overflowPolicy_;
+    size_t size_{0};
+
+    std::queue<T> queue_;
+
+    std::vector<folly::Optional<T>> ring_;
+    size_t head_{0};
   };
 
   folly::Synchronized<Buffer> buffer_;
@@ -325,6 +365,14 @@ std::shared_ptr<IBackpressureStrategy<T>> IBackpressureStrategy<T>::buffer() {
   return std::make_shared<BufferBackpressureStrategy<T>>();
 }
 
+template <typename T>
+std::shared_ptr<IBackpressureStrategy<T>> IBackpressureStrategy<T>::buffer(
+    size_t capacity,
+    BufferOverflowPolicy policy) {
+  CHECK_GT(capacity, 0);
+  return std::make_shared<BufferBackpressureStrategy<T>>(capacity, policy);
+}
+
 template <typename T>
 std::shared_ptr<IBackpressureStrategy<T>> IBackpressureStrategy<T>::drop() {
   return std::make_shared<DropBackpressureStrategy<T>>();
@@ -0,0 +1,214 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// IWYU pragma: private, include "yarpl/flowable/Flowable.h"
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+#include "yarpl/flowable/Flowable.h"
+
+namespace yarpl {
+namespace flowable {
+namespace details {
+
+/// Subscription of a synchronous source, which emits whatever is requested
+/// in one loop on the thread whose request() took the credits from zero.
+///
+/// `State` is the per-subscription state of the source:
+///
+///   bool exhausted() const;             // nothing left, complete
+///   bool next(Subscriber<T>&);          // emit one element, false if it
+///                                       // terminated the subscriber instead
+///
+/// The loop keeps a local count of what it emitted and only goes back to the
+/// credits once it has caught up with them, so with unbounded demand an
+/// element costs a relaxed load to check for cancellation and a call to
+/// onNext().
+template <typename T, typename State>
+class GeneratorSubscription
+    : public Subscription,
+      public std::enable_shared_from_this<GeneratorSubscription<T, State>> {
+ public:
+  GeneratorSubscription(std::shared_ptr<Subscriber<T>> subscriber, State state)
+      : subscriber_(std::move(subscriber)), state_(std::move(state)) {}
+
+  void start() {
+    // Read before a request can start the loop on another thread.
+    auto const empty = state_.exhausted();
+    subscriber_->onSubscribe(this->shared_from_this());
+
+    // An empty source completes without waiting for a request, unless a
+    // request made the loop responsible for that already.
+    int64_t expected = 0;
+    if (empty &&
+        requested_.compare_exchange_strong(expected, credits::kCanceled)) {
+      std::exchange(subscriber_, nullptr)->onComplete();
+    }
+  }
+
+  void request(int64_t n) override {
+    if (n <= 0) {
+      return;
+    }
+    auto current = requested_.load(std::memory_order_relaxed);
+    int64_t total;
+    do {
+      if (current == credits::kCanceled) {
+        return;
+      }
+      total = credits::add(current, n);
+    } while (!requested_.compare_exchange_weak(current, total));
+
+    if (current == 0) {
+      drain(total);
+    }
+  }
+
+  void cancel() override {
+    // Without a loop running the subscriber can be released from here,
+    // otherwise the loop releases it when it sees the cancellation.
+    if (requested_.exchange(credits::kCanceled) == 0) {
+      subscriber_.reset();
+    }
+  }
+
+ private:
+  void drain(int64_t requested) {
+    auto self = this->shared_from_this();
+    int64_t emitted = 0;
+
+    for (;;) {
+      while (emitted != requested) {
+        if (isCancelled()) {
+          subscriber_.reset();
+          return;
+        }
+        if (state_.exhausted()) {
+          complete();
+          return;
+        }
+        if (!state_.next(*subscriber_)) {
+          requested_.store(credits::kCanceled);
+          subscriber_.reset();
+          return;
+        }
+        ++emitted;
+      }
+
+      // Complete along with the last element, rather than on the next
+      // request.
+      if (state_.exhausted()) {
+        complete();
+        return;
+      }
+
+      requested = requested_.load();
+      if (requested == credits::kCanceled) {
+        subscriber_.reset();
+        return;
+      }
+      if (requested == emitted) {
+        if (requested_.compare_exchange_strong(requested, 0)) {
+          return;
+        }
+        // More was requested meanwhile, or it was cancelled.
+        if (requested == credits::kCanceled) {
+          subscriber_.reset();
+          return;
+        }
+      }
+    }
+  }
+
+  void complete() {
+    if (requested_.exchange(credits::kCanceled) != credits::kCanceled) {
+      std::exchange(subscriber_, nullptr)->onComplete();
+    } else {
+      subscriber_.reset();
+    }
+  }
+
+  bool isCancelled() const {
+    return requested_.load(std::memory_order_relaxed) == credits::kCanceled;
+  }
+
+  std::shared_ptr<Subscriber<T>> subscriber_;
+  State state_;
+  std::atomic<int64_t> requested_{0};
+};
+
+/// A synchronous source, which gets a copy of `State` for each subscription.
+template <typename T, typename State>
+class GeneratorFlowable : public Flowable<T> {
+ public:
+  explicit GeneratorFlowable(State state) : state_(std::move(state)) {}
+
+  void subscribe(std::shared_ptr<Subscriber<T>> subscriber) override {
+    auto subscription = std::make_shared<GeneratorSubscription<T, State>>(
+        std::move(subscriber), state_);
+    subscription->start();
+  }
+
+ private:
+  State const state_;
+};
+
+/// State of Flowable<>::range().
+struct RangeState {
+  bool exhausted() const {
+    return next_ == end_;
+  }
+
+  bool next(Subscriber<int64_t>& subscriber) {
+    subscriber.onNext(next_++);
+    return true;
+  }
+
+  int64_t next_;
+  int64_t end_;
+};
+
+/// State of Flowable<T>::fromGenerator().  The generator is shared by all
+/// subscriptions, as it may not be copyable.
+template <typename T, typename Generator>
+struct FunctionState {
+  bool exhausted() const {
+    return false;
+  }
+
+  bool next(Subscriber<T>& subscriber) {
+    try {
+      subscriber.onNext((*generator_)());
+      return true;
+    } catch (const std::exception& ex) {
+      subscriber.onError(
+          folly::exception_wrapper(std::current_exception(), ex));
+    } catch (...) {
+      subscriber.onError(std::runtime_error(
+          "Flowable::fromGenerator() threw from Subscriber:onNext()"));
+    }
+    return false;
+  }
+
+  std::shared_ptr<Generator> generator_;
+};
+
+} // namespace details
+} // namespace flowable
+} // namespace yarpl
@@ -0,0 +1,584 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// IWYU pragma: private, include "yarpl/flowable/Flowable.h"
+
+#pragma once
+
+#include <folly/Executor.h>
+#include <folly/concurrency/UnboundedQueue.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "yarpl/flowable/Flowable.h"
+#include "yarpl/utils/credits.h"
+
+namespace yarpl {
+namespace flowable {
+
+/**
+ * The elements of a Flowable split across a fixed number of rails, each of
+ * which processes its share on an executor, see Flowable::parallel().
+ *
+ * Operators applied to a ParallelFlowable run on every rail separately, so
+ * the functions passed to them are called concurrently and must be
+ * thread-safe.  sequential() and sequentialOrdered() merge the rails back
+ * into a single Flowable.
+ *
+ * Nothing is subscribed to until the merged Flowable is; every subscription
+ * to it builds its own set of rails and its own subscription upstream.
+ */
+template <typename T>
+class ParallelFlowable {
+ public:
+  /// Builds the rails for one subscription.  `ordered` is whether they will
+  /// be merged back in the order of the upstream.
+  using RailsFactory =
+      std::function<std::vector<std::shared_ptr<Flowable<T>>>(bool ordered)>;
+
+  ParallelFlowable(size_t parallelism, RailsFactory factory)
+      : parallelism_(parallelism), factory_(std::move(factory)) {}
+
+  size_t parallelism() const {
+    return parallelism_;
+  }
+
+  /// Maps the elements on the rails.
+  template <
+      typename Function,
+      typename R = typename folly::invoke_result_t<Function&, T>>
+  std::shared_ptr<ParallelFlowable<R>> map(Function&& function) {
+    auto shared = std::make_shared<std::decay_t<Function>>(
+        std::forward<Function>(function));
+    auto factory = [inner = factory_, shared](bool ordered) {
+      std::vector<std::shared_ptr<Flowable<R>>> rails;
+      for (auto& rail : inner(ordered)) {
+        rails.push_back(rail->map(
+            [shared](T value) -> R { return (*shared)(std::move(value)); }));
+      }
+      return rails;
+    };
+    return std::make_shared<ParallelFlowable<R>>(
+        parallelism_, std::move(factory));
+  }
+
+  /// Merges the rails, emitting each element as soon as its rail has
+  /// processed it.  Each rail is requested `prefetch` elements at a time.
+  std::shared_ptr<Flowable<T>> sequential(size_t prefetch = 32);
+
+  /// Merges the rails, emitting the elements in the order of the upstream.
+  /// The upstream elements are dealt to the rails in turn, so a slow element
+  /// holds back the ones after it.
+  std::shared_ptr<Flowable<T>> sequentialOrdered(size_t prefetch = 32);
+
+ private:
+  const size_t parallelism_;
+  RailsFactory factory_;
+};
+
+namespace details {
+
+/// Deals the elements of the upstream to `parallelism` rails.
+///
+/// The demand of the rails is forwarded upstream as it arrives.  Unordered,
+/// each element goes to the next rail, round-robin, that has credits left.
+/// Ordered, element k always goes to rail k % parallelism, and the upstream
+/// is only requested as many elements as fit that pattern.  Either way the
+/// upstream never sends an element no rail can take.
+///
+/// The upstream is subscribed to once every rail has been.  Elements meant
+/// for a rail that was cancelled are dropped, and the upstream is cancelled
+/// with the last rail.
+template <typename T>
+class ParallelSource : public yarpl::enable_get_ref {
+ public:
+  ParallelSource(
+      std::shared_ptr<Flowable<T>> upstream,
+      size_t parallelism,
+      bool ordered)
+      : upstream_(std::move(upstream)), ordered_(ordered), rails_(parallelism) {
+    CHECK_GT(parallelism, 0);
+  }
+
+  /// The rails, to be subscribed to once each.
+  std::vector<std::shared_ptr<Flowable<T>>> rails() {
+    std::vector<std::shared_ptr<Flowable<T>>> rails;
+    for (size_t i = 0; i < rails_.size(); ++i) {
+      rails.push_back(
+          std::make_shared<RailFlowable>(this->ref_from_this(this), i));
+    }
+    return rails;
+  }
+
+ private:
+  struct Rail {
+    AtomicReference<Subscriber<T>> subscriber;
+    std::atomic<int64_t> requested{0};
+    // cumulative demand, for ordered dealing; guarded by orderedGuard_
+    int64_t demand{0};
+  };
+
+  class RailSubscription : public Subscription {
+   public:
+    RailSubscription(std::shared_ptr<ParallelSource> source, size_t rail)
+        : source_(std::move(source)), rail_(rail) {}
+
+    void request(int64_t n) override {
+      source_->request(rail_, n);
+    }
+
+    void cancel() override {
+      source_->cancel(rail_);
+    }
+
+   private:
+    const std::shared_ptr<ParallelSource> source_;
+    const size_t rail_;
+  };
+
+  class RailFlowable : public Flowable<T> {
+   public:
+    RailFlowable(std::shared_ptr<ParallelSource> source, size_t rail)
+        : source_(std::move(source)), rail_(rail) {}
+
+    void subscribe(std::shared_ptr<Subscriber<T>> subscriber) override {
+      source_->subscribeRail(rail_, std::move(subscriber));
+    }
+
+   private:
+    const std::shared_ptr<ParallelSource> source_;
+    const size_t rail_;
+  };
+
+  class UpstreamSubscriber : public BaseSubscriber<T> {
+   public:
+    explicit UpstreamSubscriber(std::shared_ptr<ParallelSource> source)
+        : source_(std::move(source)) {}
+
+   private:
+    void onSubscribeImpl() override {
+      source_->connected_.store(true);
+      source_->forwardDemand();
+    }
+
+    void onNextImpl(T value) override {
+      source_->deal(std::move(value));
+    }
+
+    void onCompleteImpl() override {
+      source_->terminateRails(folly::exception_wrapper());
+    }
+
+    void onErrorImpl(folly::exception_wrapper ew) override {
+      source_->terminateRails(std::move(ew));
+    }
+
+    void onTerminateImpl() override {
+      source_.reset();
+    }
+
+    std::shared_ptr<ParallelSource> source_;
+  };
+
+  void subscribeRail(size_t index, std::shared_ptr<Subscriber<T>> subscriber) {
+    auto& rail = rails_[index];
+    if (yarpl::atomic_load(&rail.subscriber)) {
+      subscriber->onSubscribe(Subscription::create());
+      subscriber->onError(std::runtime_error("rail already subscribed"));
+      return;
+    }
+    yarpl::atomic_store(&rail.subscriber, subscriber);
+    subscriber->onSubscribe(std::make_shared<RailSubscription>(
+        this->ref_from_this(this), index));
+
+    if (++subscribedRails_ == rails_.size()) {
+      auto upstream =
+          std::make_shared<UpstreamSubscriber>(this->ref_from_this(this));
+      yarpl::atomic_store(&upstreamSubscriber_, upstream);
+      upstream_->subscribe(std::move(upstream));
+    }
+  }
+
+  void request(size_t index, int64_t n) {
+    if (n <= 0) {
+      return;
+    }
+    auto& rail = rails_[index];
+    if (!ordered_) {
+      credits::add(&rail.requested, n);
+      credits::add(&unforwarded_, n);
+      forwardDemand();
+      return;
+    }
+
+    // Element k goes to rail k % size, so the upstream can send elements up
+    // to the first one whose rail has no credits for it.
+    std::lock_guard<std::mutex> lock(orderedGuard_);
+    rail.demand = credits::add(rail.demand, n);
+    auto const size = static_cast<int64_t>(rails_.size());
+    auto allowed = credits::kNoFlowControl;
+    for (int64_t i = 0; i < size; ++i) {
+      auto const demand = rails_[i].demand;
+      if (demand < (credits::kNoFlowControl - i) / size) {
+        allowed = std::min(allowed, demand * size + i);
+      }
+    }
+    if (allowed > dealtDemand_) {
+      credits::add(
+          &unforwarded_,
+          allowed == credits::kNoFlowControl ? allowed
+                                             : allowed - dealtDemand_);
+      dealtDemand_ = allowed;
+    }
+    forwardDemand();
+  }
+
+  void forwardDemand() {
+    if (!connected_.load()) {
+      return;
+    }
+    auto const n = unforwarded_.exchange(0);
+    if (n > 0) {
+      if (auto upstream = yarpl::atomic_load(&upstreamSubscriber_)) {
+        upstream->request(n);
+      }
+    }
+  }
+
+  void cancel(size_t index) {
+    if (yarpl::atomic_exchange(&rails_[index].subscriber, nullptr) &&
+        ++cancelledRails_ == rails_.size()) {
+      if (auto upstream = yarpl::atomic_load(&upstreamSubscriber_)) {
+        upstream->cancel();
+      }
+    }
+  }
+
+  // called from the upstream
+  void deal(T value) {
+    auto const size = rails_.size();
+    if (ordered_) {
+      auto& rail = rails_[next_];
+      next_ = (next_ + 1) % size;
+      if (auto subscriber = yarpl::atomic_load(&rail.subscriber)) {
+        subscriber->onNext(std::move(value));
+      }
+      return;
+    }
+
+    for (size_t tries = 0; tries < size; ++tries) {
+      auto& rail = rails_[next_];
+      next_ = (next_ + 1) % size;
+      if (credits::tryConsume(&rail.requested, 1)) {
+        if (auto subscriber = yarpl::atomic_load(&rail.subscriber)) {
+          subscriber->onNext(std::move(value));
+        }
+        return;
+      }
+    }
+    VLOG(2) << "ParallelSource dropped an element no rail had requested";
+  }
+
+  // called from the upstream
+  void terminateRails(folly::exception_wrapper ew) {
+    for (auto& rail : rails_) {
+      if (auto subscriber = yarpl::atomic_exchange(&rail.subscriber, nullptr)) {
+        if (ew) {
+          subscriber->onError(ew);
+        } else {
+          subscriber->onComplete();
+        }
+      }
+    }
+  }
+
+  const std::shared_ptr<Flowable<T>> upstream_;
+  const bool ordered_;
+  std::vector<Rail> rails_;
+
+  std::atomic<size_t> subscribedRails_{0};
+  std::atomic<size_t> cancelledRails_{0};
+  AtomicReference<UpstreamSubscriber> upstreamSubscriber_;
+
+  // demand of the rails not yet requested from the upstream
+  std::atomic<int64_t> unforwarded_{0};
+  std::atomic<bool> connected_{false};
+
+  // ordered dealing: number of upstream elements already accounted for
+  std::mutex orderedGuard_;
+  int64_t dealtDemand_{0};
+
+  // only accessed from the upstream
+  size_t next_{0};
+};
+
+/// Merges rails in the order ParallelSource dealt them, taking one element
+/// from each rail in turn, see ParallelFlowable::sequentialOrdered().
+///
+/// Like the merge of flatMap(), each rail is requested `prefetch` elements
+/// up front and replenished in batches of three quarters of that, and a
+/// single drain loop delivers the queued elements downstream.
+template <typename T>
+class OrderedRailsMerge : public Flowable<T> {
+ public:
+  OrderedRailsMerge(
+      std::vector<std::shared_ptr<Flowable<T>>> rails,
+      int64_t prefetch)
+      : rails_(std::move(rails)), prefetch_(prefetch) {
+    CHECK_GT(prefetch_, 0);
+  }
+
+  void subscribe(std::shared_ptr<Subscriber<T>> subscriber) override {
+    auto merge =
+        std::make_shared<MergeSubscription>(std::move(subscriber), prefetch_);
+    merge->start(std::move(rails_));
+  }
+
+ private:
+  class MergeSubscription : public Subscription, public yarpl::enable_get_ref {
+    class RailSubscriber;
+
+   public:
+    MergeSubscription(
+        std::shared_ptr<Subscriber<T>> subscriber,
+        int64_t prefetch)
+        : subscriber_(std::move(subscriber)), prefetch_(prefetch) {}
+
+    void start(std::vector<std::shared_ptr<Flowable<T>>> rails) {
+      auto self = this->ref_from_this(this);
+      for (size_t i = 0; i < rails.size(); ++i) {
+        inners_.push_back(std::make_shared<RailSubscriber>(self));
+      }
+      // The downstream may cancel, and empty inners_, from onSubscribe().
+      auto inners = inners_;
+      subscriber_->onSubscribe(self);
+      for (size_t i = 0; i < rails.size(); ++i) {
+        rails[i]->subscribe(std::move(inners[i]));
+      }
+    }
+
+    void request(int64_t n) override {
+      credits::add(&requested_, n);
+      drain();
+    }
+
+    void cancel() override {
+      cancelled_ = true;
+      drain();
+    }
+
+   private:
+    void fail(folly::exception_wrapper ew) {
+      {
+        std::lock_guard<std::mutex> g(errorGuard_);
+        if (!error_) {
+          error_ = std::move(ew);
+        }
+      }
+      drain();
+    }
+
+    // only one thread at a time runs drainImpl()
+    void drain() {
+      auto self = this->ref_from_this(this);
+      if (drainLoopMutex_++ == 0) {
+        do {
+          drainImpl();
+        } while (drainLoopMutex_-- != 1);
+      }
+    }
+
+    void drainImpl() {
+      if (!subscriber_) {
+        return;
+      }
+
+      if (cancelled_) {
+        terminated_ = true;
+        subscriber_.reset();
+        cancelInners();
+        return;
+      }
+
+      folly::exception_wrapper ew;
+      {
+        std::lock_guard<std::mutex> g(errorGuard_);
+        ew = std::move(error_);
+      }
+      if (ew) {
+        terminated_ = true;
+        cancelInners();
+        std::exchange(subscriber_, nullptr)->onError(std::move(ew));
+        return;
+      }
+
+      while (!cancelled_) {
+        auto& inner = *inners_[turn_];
+        // Read before looking at the queue: once the rail has terminated,
+        // all its elements are queued.
+        auto const done = inner.done_.load(std::memory_order_acquire);
+        if (inner.queue_.empty()) {
+          if (done) {
+            // The upstream ended before the element of this turn.
+            terminated_ = true;
+            cancelInners();
+            std::exchange(subscriber_, nullptr)->onComplete();
+          }
+          return;
+        }
+        if (requested_ <= 0) {
+          return;
+        }
+
+        auto value = inner.queue_.try_dequeue();
+        credits::consume(&requested_, 1);
+        turn_ = (turn_ + 1) % inners_.size();
+        subscriber_->onNext(std::move(*value));
+        inner.consumed();
+      }
+    }
+
+    void cancelInners() {
+      auto inners = std::move(inners_);
+      for (auto& inner : inners) {
+        inner->cancel();
+      }
+    }
+
+    class RailSubscriber : public BaseSubscriber<T> {
+     public:
+      explicit RailSubscriber(std::shared_ptr<MergeSubscription> parent)
+          : prefetch_(parent->prefetch_),
+            limit_(prefetch_ - prefetch_ / 4),
+            parent_(std::move(parent)) {}
+
+      void onSubscribeImpl() override {
+        auto parent = yarpl::atomic_load(&parent_);
+        if (!parent || parent->terminated_) {
+          BaseSubscriber<T>::cancel();
+          return;
+        }
+        BaseSubscriber<T>::request(prefetch_);
+      }
+
+      void onNextImpl(T value) override {
+        queue_.enqueue(std::move(value));
+        if (auto parent = yarpl::atomic_load(&parent_)) {
+          parent->drain();
+        }
+      }
+
+      void onCompleteImpl() override {}
+
+      void onErrorImpl(folly::exception_wrapper ew) override {
+        if (auto parent = yarpl::atomic_load(&parent_)) {
+          parent->fail(std::move(ew));
+        }
+      }
+
+      void onTerminateImpl() override {
+        done_.store(true, std::memory_order_release);
+        if (auto parent = yarpl::atomic_exchange(&parent_, nullptr)) {
+          parent->drain();
+        }
+      }
+
+     private:
+      friend class MergeSubscription;
+
+      // called from the drain loop once an element was delivered downstream
+      void consumed() {
+        if (++consumed_ == limit_) {
+          consumed_ = 0;
+          BaseSubscriber<T>::request(limit_);
+        }
+      }
+
+      int64_t const prefetch_;
+      int64_t const limit_;
+      int64_t consumed_{0};
+
+      folly::USPSCQueue<T, false /* MayBlock */> queue_;
+      std::atomic<bool> done_{false};
+
+      AtomicReference<MergeSubscription> parent_;
+    };
+
+    std::shared_ptr<Subscriber<T>> subscriber_;
+    int64_t const prefetch_;
+
+    // only accessed from drainImpl() once the rails are subscribed to
+    std::vector<std::shared_ptr<RailSubscriber>> inners_;
+    size_t turn_{0};
+
+    std::atomic<int64_t> drainLoopMutex_{0};
+    std::atomic<int64_t> requested_{0};
+    std::atomic<bool> cancelled_{false};
+    std::atomic<bool> terminated_{false};
+
+    std::mutex errorGuard_;
+    folly::exception_wrapper error_;
+  };
+
+  std::vector<std::shared_ptr<Flowable<T>>> rails_;
+  int64_t const prefetch_;
+};
+
+} // namespace details
+
+template <typename T>
+std::shared_ptr<Flowable<T>> ParallelFlowable<T>::sequential(size_t prefetch) {
+  auto factory = factory_;
+  auto const parallelism = parallelism_;
+  return Flowable<T>::defer([factory, parallelism, prefetch] {
+    auto rails = factory(false);
+    return Flowable<std::shared_ptr<Flowable<T>>>::create(
+               [rails = std::move(rails), i = size_t{0}](
+                   Subscriber<std::shared_ptr<Flowable<T>>>& subscriber,
+                   int64_t requested) mutable {
+                 while (i < rails.size() && requested-- > 0) {
+                   subscriber.onNext(std::move(rails[i++]));
+                 }
+                 if (i == rails.size()) {
+                   subscriber.onComplete();
+                 }
+               })
+        ->flatMap(
+            [](std::shared_ptr<Flowable<T>> rail) { return rail; },
+            parallelism,
+            prefetch);
+  });
+}
+
+template <typename T>
+std::shared_ptr<Flowable<T>> ParallelFlowable<T>::sequentialOrdered(
+    size_t prefetch) {
+  auto factory = factory_;
+  auto const credits = static_cast<int64_t>(std::min<size_t>(
+      prefetch, static_cast<size_t>(credits::kNoFlowControl)));
+  return Flowable<T>::defer([factory, credits] {
+    return std::make_shared<details::OrderedRailsMerge<T>>(
+        factory(true), credits);
+  });
+}
+
+} // namespace flowable
+} // namespace yarpl
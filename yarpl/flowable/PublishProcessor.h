@@ -14,7 +14,9 @@
 
 #pragma once
 
-#include <folly/Synchronized.h>
+#include <algorithm>
+#include <iterator>
+#include <utility>
 #include <vector>
 #include "yarpl/Common.h"
 #include "yarpl/flowable/Flowable.h"
@@ -46,8 +48,8 @@ class PublishProcessor : public observable::Observable<T>,
   }
 
   ~PublishProcessor() {
-    auto publishers = std::make_shared<const PublishersVector>();
-    publishers_.swap(publishers);
+    auto publishers = yarpl::atomic_exchange(
+        &publishers_, std::make_shared<const PublishersVector>());
 
     for (const auto& publisher : *publishers) {
       publisher->terminate();
@@ -55,7 +57,7 @@ class PublishProcessor : public observable::Observable<T>,
   }
 
   bool hasSubscribers() const {
-    return !publishers_.copy()->empty();
+    return !yarpl::atomic_load(&publishers_)->empty();
   }
 
   std::shared_ptr<observable::Subscription> subscribe(
@@ -81,7 +83,7 @@ class PublishProcessor : public observable::Observable<T>,
   }
 
   void onSubscribe(std::shared_ptr<Subscription> subscription) override {
-    auto publishers = publishers_.copy();
+    auto publishers = yarpl::atomic_load(&publishers_);
     if (publishers == kCompletedPublishers() ||
         publishers == kErroredPublishers()) {
       subscription->cancel();
@@ -92,18 +94,24 @@ class PublishProcessor : public observable::Observable<T>,
   }
 
   void onNext(T value) override {
-    auto publishers = publishers_.copy();
+    auto publishers = yarpl::atomic_load(&publishers_);
     DCHECK(publishers != kCompletedPublishers());
     DCHECK(publishers != kErroredPublishers());
 
-    for (const auto& publisher : *publishers) {
-      publisher->onNext(value);
+    if (publishers->empty()) {
+      return;
+    }
+    // Every subscriber but the last gets a copy, see ValueCopy.
+    auto const last = std::prev(publishers->cend());
+    for (auto it = publishers->cbegin(); it != last; ++it) {
+      (*it)->onNext(yarpl::details::ValueCopy<T>::copy(value));
     }
+    (*last)->onNext(std::move(value));
   }
 
   void onError(folly::exception_wrapper ex) override {
-    auto publishers = kErroredPublishers();
-    publishers_.swap(publishers);
+    auto publishers =
+        yarpl::atomic_exchange(&publishers_, kErroredPublishers());
     DCHECK(publishers != kCompletedPublishers());
     DCHECK(publishers != kErroredPublishers());
 
@@ -113,8 +121,8 @@ class PublishProcessor : public observable::Observable<T>,
   }
 
   void onComplete() override {
-    auto publishers = kCompletedPublishers();
-    publishers_.swap(publishers);
+    auto publishers =
+        yarpl::atomic_exchange(&publishers_, kCompletedPublishers());
     DCHECK(publishers != kCompletedPublishers());
     DCHECK(publishers != kErroredPublishers());
 
@@ -129,7 +137,7 @@ class PublishProcessor : public observable::Observable<T>,
   std::shared_ptr<const PublishersVector> tryAddPublisher(
       std::shared_ptr<PublisherSubscription> subscriber) {
     while (true) {
-      auto oldPublishers = publishers_.copy();
+      auto oldPublishers = yarpl::atomic_load(&publishers_);
       if (oldPublishers == kCompletedPublishers() ||
           oldPublishers == kErroredPublishers()) {
         return oldPublishers;
@@ -143,9 +151,9 @@ class PublishProcessor : public observable::Observable<T>,
           oldPublishers->cend());
       newPublishers->push_back(subscriber);
 
-      auto locked = publishers_.lock();
-      if (*locked == oldPublishers) {
-        *locked = newPublishers;
+      std::shared_ptr<const PublishersVector> added = newPublishers;
+      if (yarpl::atomic_compare_exchange(
+              &publishers_, &oldPublishers, std::move(added))) {
         return newPublishers;
       }
       // else the vector changed so we will have to do it again
@@ -154,7 +162,7 @@ class PublishProcessor : public observable::Observable<T>,
 
   void removePublisher(PublisherSubscription* subscriber) {
     while (true) {
-      auto oldPublishers = publishers_.copy();
+      auto oldPublishers = yarpl::atomic_load(&publishers_);
 
       auto removingItem = std::find_if(
           oldPublishers->cbegin(),
@@ -175,9 +183,11 @@ class PublishProcessor : public observable::Observable<T>,
       newPublishers->insert(
           newPublishers->end(), std::next(removingItem), oldPublishers->cend());
 
-      auto locked = publishers_.lock();
-      if (*locked == oldPublishers) {
-        *locked = std::move(newPublishers);
+      if (yarpl::atomic_compare_exchange(
+              &publishers_,
+              &oldPublishers,
+              std::shared_ptr<const PublishersVector>(
+                  std::move(newPublishers)))) {
         return;
       }
       // else the vector changed so we will have to do it again
@@ -248,8 +258,9 @@ class PublishProcessor : public observable::Observable<T>,
     return constant;
   }
 
-  folly::Synchronized<std::shared_ptr<const PublishersVector>, std::mutex>
-      publishers_;
+  // Replaced as a whole on every change, so that onNext() reads it with a
+  // single lock-free load.
+  mutable AtomicReference<const PublishersVector> publishers_;
 };
 } // namespace flowable
 } // namespace yarpl
@@ -16,8 +16,11 @@
 
 #include <boost/noncopyable.hpp>
 #include <folly/ExceptionWrapper.h>
+#include <folly/Range.h>
 #include <folly/functional/Invoke.h>
 #include <glog/logging.h>
+#include <memory>
+#include "yarpl/CancellationToken.h"
 #include "yarpl/Disposable.h"
 #include "yarpl/Refcounted.h"
 #include "yarpl/flowable/Subscription.h"
@@ -35,6 +38,15 @@ class Subscriber : boost::noncopyable {
   virtual void onError(folly::exception_wrapper) = 0;
   virtual void onNext(T) = 0;
 
+  /// Delivers several elements at once, moving them out of `values`.  The
+  /// default forwards them one by one to onNext(); subscribers that can
+  /// amortize per-element work over a batch override it.
+  virtual void onNextBatch(folly::Range<T*> values) {
+    for (auto& value : values) {
+      onNext(std::move(value));
+    }
+  }
+
   template <
       typename Next,
       typename = typename std::enable_if<
@@ -68,6 +80,52 @@ class Subscriber : boost::noncopyable {
       Complete&& complete,
       int64_t batch = credits::kNoFlowControl);
 
+  // Allocate the subscriber with `alloc` instead of make_shared, e.g. with a
+  // yarpl::PoolAllocator for short-lived request/response subscribers.
+  template <
+      typename Alloc,
+      typename Next,
+      typename = typename std::enable_if<
+          folly::is_invocable<std::decay_t<Next>&, T>::value>::type>
+  static std::shared_ptr<Subscriber<T>> create(
+      std::allocator_arg_t,
+      const Alloc& alloc,
+      Next&& next,
+      int64_t batch = credits::kNoFlowControl);
+
+  template <
+      typename Alloc,
+      typename Next,
+      typename Error,
+      typename = typename std::enable_if<
+          folly::is_invocable<std::decay_t<Next>&, T>::value &&
+          folly::is_invocable<std::decay_t<Error>&, folly::exception_wrapper>::
+              value>::type>
+  static std::shared_ptr<Subscriber<T>> create(
+      std::allocator_arg_t,
+      const Alloc& alloc,
+      Next&& next,
+      Error&& error,
+      int64_t batch = credits::kNoFlowControl);
+
+  template <
+      typename Alloc,
+      typename Next,
+      typename Error,
+      typename Complete,
+      typename = typename std::enable_if<
+          folly::is_invocable<std::decay_t<Next>&, T>::value &&
+          folly::is_invocable<std::decay_t<Error>&, folly::exception_wrapper>::
+              value &&
+          folly::is_invocable<std::decay_t<Complete>&>::value>::type>
+  static std::shared_ptr<Subscriber<T>> create(
+      std::allocator_arg_t,
+      const Alloc& alloc,
+      Next&& next,
+      Error&& error,
+      Complete&& complete,
+      int64_t batch = credits::kNoFlowControl);
+
   static std::shared_ptr<Subscriber<T>> create() {
     class NullSubscriber : public Subscriber<T> {
       void onSubscribe(std::shared_ptr<Subscription> s) override final {
@@ -169,6 +227,25 @@ class BaseSubscriber : public Subscriber<T>, public yarpl::enable_get_ref {
     }
   }
 
+  // Same as onNext() per element, but takes the reference to this once for
+  // the whole batch.  Stops early if an element terminates the subscriber.
+  void onNextBatch(folly::Range<T*> values) final override {
+#ifndef NDEBUG
+    DCHECK(gotOnSubscribe_.load()) << "Not subscibed to BaseSubscriber";
+#endif
+
+    if (values.empty() || isTerminated()) {
+      return;
+    }
+    KEEP_REF_TO_THIS();
+    for (auto& value : values) {
+      onNextImpl(std::move(value));
+      if (isTerminated()) {
+        return;
+      }
+    }
+  }
+
   void cancel() {
     std::shared_ptr<Subscription> null;
     if (auto sub = yarpl::atomic_exchange(&subscription_, null)) {
@@ -280,6 +357,70 @@ class LambdaSubscriber : public BaseSubscriber<T> {
       Error&& error,
       Complete&& complete,
       int64_t batch = credits::kNoFlowControl);
+
+  // Allocate the subscriber with `alloc` instead of make_shared, e.g. with a
+  // yarpl::PoolAllocator for short-lived request/response subscribers.
+  template <
+      typename Alloc,
+      typename Next,
+      typename = typename std::enable_if<
+          folly::is_invocable<std::decay_t<Next>&, T>::value>::type>
+  static std::shared_ptr<LambdaSubscriber<T>> create(
+      std::allocator_arg_t,
+      const Alloc& alloc,
+      Next&& next,
+      int64_t batch = credits::kNoFlowControl);
+
+  template <
+      typename Alloc,
+      typename Next,
+      typename Error,
+      typename = typename std::enable_if<
+          folly::is_invocable<std::decay_t<Next>&, T>::value &&
+          folly::is_invocable<std::decay_t<Error>&, folly::exception_wrapper>::
+              value>::type>
+  static std::shared_ptr<LambdaSubscriber<T>> create(
+      std::allocator_arg_t,
+      const Alloc& alloc,
+      Next&& next,
+      Error&& error,
+      int64_t batch = credits::kNoFlowControl);
+
+  template <
+      typename Alloc,
+      typename Next,
+      typename Error,
+      typename Complete,
+      typename = typename std::enable_if<
+          folly::is_invocable<std::decay_t<Next>&, T>::value &&
+          folly::is_invocable<std::decay_t<Error>&, folly::exception_wrapper>::
+              value &&
+          folly::is_invocable<std::decay_t<Complete>&>::value>::type>
+  static std::shared_ptr<LambdaSubscriber<T>> create(
+      std::allocator_arg_t,
+      const Alloc& alloc,
+      Next&& next,
+      Error&& error,
+      Complete&& complete,
+      int64_t batch = credits::kNoFlowControl);
+
+  // Returns a token that cancels this subscriber, and that is disposed once
+  // the subscriber terminates.  Must be called before subscribing, see
+  // Flowable::subscribeWithToken().
+  CancellationToken cancellationToken() {
+    if (!registration_) {
+      registration_ = CancellationRegistration(this->ref_from_this(this));
+    }
+    return registration_.token();
+  }
+
+ protected:
+  void onTerminateImpl() override {
+    registration_.release();
+  }
+
+ private:
+  CancellationRegistration registration_;
 };
 
 template <typename T, typename Next>
@@ -412,6 +553,56 @@ std::shared_ptr<LambdaSubscriber<T>> LambdaSubscriber<T>::create(
       batch);
 }
 
+template <typename T>
+template <typename Alloc, typename Next, typename>
+std::shared_ptr<LambdaSubscriber<T>> LambdaSubscriber<T>::create(
+    std::allocator_arg_t,
+    const Alloc& alloc,
+    Next&& next,
+    int64_t batch) {
+  return std::allocate_shared<details::Base<T, std::decay_t<Next>>>(
+      alloc, std::forward<Next>(next), batch);
+}
+
+template <typename T>
+template <typename Alloc, typename Next, typename Error, typename>
+std::shared_ptr<LambdaSubscriber<T>> LambdaSubscriber<T>::create(
+    std::allocator_arg_t,
+    const Alloc& alloc,
+    Next&& next,
+    Error&& error,
+    int64_t batch) {
+  return std::allocate_shared<
+      details::WithError<T, std::decay_t<Next>, std::decay_t<Error>>>(
+      alloc, std::forward<Next>(next), std::forward<Error>(error), batch);
+}
+
+template <typename T>
+template <
+    typename Alloc,
+    typename Next,
+    typename Error,
+    typename Complete,
+    typename>
+std::shared_ptr<LambdaSubscriber<T>> LambdaSubscriber<T>::create(
+    std::allocator_arg_t,
+    const Alloc& alloc,
+    Next&& next,
+    Error&& error,
+    Complete&& complete,
+    int64_t batch) {
+  return std::allocate_shared<details::WithErrorAndComplete<
+      T,
+      std::decay_t<Next>,
+      std::decay_t<Error>,
+      std::decay_t<Complete>>>(
+      alloc,
+      std::forward<Next>(next),
+      std::forward<Error>(error),
+      std::forward<Complete>(complete),
+      batch);
+}
+
 } // namespace details
 
 template <typename T>
@@ -444,5 +635,51 @@ std::shared_ptr<Subscriber<T>> Subscriber<T>::create(
       batch);
 }
 
+template <typename T>
+template <typename Alloc, typename Next, typename>
+std::shared_ptr<Subscriber<T>> Subscriber<T>::create(
+    std::allocator_arg_t tag,
+    const Alloc& alloc,
+    Next&& next,
+    int64_t batch) {
+  return details::LambdaSubscriber<T>::create(
+      tag, alloc, std::forward<Next>(next), batch);
+}
+
+template <typename T>
+template <typename Alloc, typename Next, typename Error, typename>
+std::shared_ptr<Subscriber<T>> Subscriber<T>::create(
+    std::allocator_arg_t tag,
+    const Alloc& alloc,
+    Next&& next,
+    Error&& error,
+    int64_t batch) {
+  return details::LambdaSubscriber<T>::create(
+      tag, alloc, std::forward<Next>(next), std::forward<Error>(error), batch);
+}
+
+template <typename T>
+template <
+    typename Alloc,
+    typename Next,
+    typename Error,
+    typename Complete,
+    typename>
+std::shared_ptr<Subscriber<T>> Subscriber<T>::create(
+    std::allocator_arg_t tag,
+    const Alloc& alloc,
+    Next&& next,
+    Error&& error,
+    Complete&& complete,
+    int64_t batch) {
+  return details::LambdaSubscriber<T>::create(
+      tag,
+      alloc,
+      std::forward<Next>(next),
+      std::forward<Error>(error),
+      std::forward<Complete>(complete),
+      batch);
+}
+
 } // namespace flowable
 } // namespace yarpl
@@ -14,6 +14,8 @@
 
 #pragma once
 
+#include <memory>
+
 #include "yarpl/Refcounted.h"
 
 namespace yarpl {
@@ -35,6 +37,14 @@ class Subscription {
   static std::shared_ptr<Subscription> create(
       CancelFunc&& onCancel,
       RequestFunc&& onRequest);
+
+  /// Same as above, but allocates the subscription with `alloc`.
+  template <typename Alloc, typename CancelFunc, typename RequestFunc>
+  static std::shared_ptr<Subscription> create(
+      std::allocator_arg_t,
+      const Alloc& alloc,
+      CancelFunc&& onCancel,
+      RequestFunc&& onRequest);
 };
 
 namespace detail {
@@ -77,6 +87,20 @@ std::shared_ptr<Subscription> Subscription::create(
       std::forward<CancelFunc>(onCancel), std::forward<RequestFunc>(onRequest));
 }
 
+template <typename Alloc, typename CancelFunc, typename RequestFunc>
+std::shared_ptr<Subscription> Subscription::create(
+    std::allocator_arg_t,
+    const Alloc& alloc,
+    CancelFunc&& onCancel,
+    RequestFunc&& onRequest) {
+  return std::allocate_shared<detail::CallbackSubscription<
+      std::decay_t<CancelFunc>,
+      std::decay_t<RequestFunc>>>(
+      alloc,
+      std::forward<CancelFunc>(onCancel),
+      std::forward<RequestFunc>(onRequest));
+}
+
 template <typename CancelFunc>
 std::shared_ptr<Subscription> Subscription::create(CancelFunc&& onCancel) {
   return Subscription::create(
@@ -8,6 +8,7 @@
 #include <folly/experimental/coro/Invoke.h>
 #include <folly/experimental/coro/Task.h>
 #endif
+#include <folly/Range.h>
 #include <folly/executors/SerialExecutor.h>
 
 #include <thrift/lib/cpp2/async/ClientBufferedStream.h>
@@ -32,6 +33,8 @@ class ThriftStreamShim {
       apache::thrift::detail::ClientStreamBridge::Ptr streamBridge_;
       folly::Executor::KeepAlive<folly::SequencedExecutor> ex_;
       std::atomic<bool> canceled_{false};
+      // credits requested and not yet passed on to the stream bridge
+      std::atomic<int64_t> pendingCredits_{0};
     };
 
     return yarpl::flowable::internal::flowableFromSubscriber<T>(
@@ -49,10 +52,15 @@ class ThriftStreamShim {
               CHECK(n != yarpl::credits::kNoFlowControl)
                   << "kNoFlowControl unsupported";
 
+              // Requests made before the previous ones reached the stream
+              // bridge are passed on together.
               if (auto state = state_.lock()) {
-                state->ex_->add([n, state = std::move(state)]() {
-                  state->streamBridge_->requestN(n);
-                });
+                if (state->pendingCredits_.fetch_add(n) == 0) {
+                  state->ex_->add([state = std::move(state)]() {
+                    state->streamBridge_->requestN(
+                        state->pendingCredits_.exchange(0));
+                  });
+                }
               }
             }
 
@@ -110,34 +118,47 @@ class ThriftStreamShim {
                     }
                   }
 
-                  {
+                  // Everything that arrived together is handed over in one
+                  // executor task, through onNextBatch().
+                  std::vector<T> values;
+                  folly::exception_wrapper error;
+                  bool complete = false;
+                  while (!queue.empty()) {
                     auto& payload = queue.front();
                     if (!payload.hasValue() && !payload.hasException()) {
-                      state->ex_->add([subscriber = std::move(subscriber),
-                                       keepAlive = state->ex_.copy()] {
-                        subscriber->onComplete();
-                      });
+                      complete = true;
                       break;
                     }
                     auto value = decode(std::move(payload));
                     queue.pop();
                     if (value.hasValue()) {
-                      state->ex_->add([subscriber,
-                                       keepAlive = state->ex_.copy(),
-                                       value = std::move(value)]() mutable {
-                        subscriber->onNext(std::move(value).value());
-                      });
+                      values.push_back(std::move(value).value());
                     } else if (value.hasException()) {
-                      state->ex_->add([subscriber = std::move(subscriber),
-                                       keepAlive = state->ex_.copy(),
-                                       value = std::move(value)]() mutable {
-                        subscriber->onError(std::move(value).exception());
-                      });
+                      error = std::move(value).exception();
                       break;
                     } else {
                       LOG(FATAL) << "unreachable";
                     }
                   }
+
+                  auto const done = complete || error;
+                  state->ex_->add([subscriber,
+                                   keepAlive = state->ex_.copy(),
+                                   values = std::move(values),
+                                   error = std::move(error),
+                                   complete]() mutable {
+                    if (!values.empty()) {
+                      subscriber->onNextBatch(folly::range(values));
+                    }
+                    if (error) {
+                      subscriber->onError(std::move(error));
+                    } else if (complete) {
+                      subscriber->onComplete();
+                    }
+                  });
+                  if (done) {
+                    break;
+                  }
                 }
               })
               .scheduleOn(state->ex_)
@@ -181,7 +202,8 @@ class ThriftStreamShim {
 
       // Subscriber implementation
       void onSubscribe(std::shared_ptr<Subscription> subscription) override {
-        eb_->add([this, subscription = std::move(subscription)]() mutable {
+        runInEventBase([this,
+                        subscription = std::move(subscription)]() mutable {
           if (!clientCallback_) {
             return subscription->cancel();
           }
@@ -193,17 +215,15 @@ class ThriftStreamShim {
         });
       }
       void onNext(T next) override {
-        eb_->add([this, next = std::move(next), s = self_]() mutable {
+        runInEventBase([this, next = std::move(next), s = self_]() mutable {
           if (clientCallback_) {
-            std::ignore =
-                clientCallback_->onStreamNext(apache::thrift::StreamPayload{
-                    encode_(folly::Try<T>(std::move(next))).value().payload,
-                    {}});
+            std::ignore = clientCallback_->onStreamNext(
+                std::move(encode_(folly::Try<T>(std::move(next)))).value());
           }
         });
       }
       void onError(folly::exception_wrapper ew) override {
-        eb_->add([this, ew = std::move(ew), s = self_]() mutable {
+        runInEventBase([this, ew = std::move(ew), s = self_]() mutable {
           if (clientCallback_) {
             std::exchange(clientCallback_, nullptr)
                 ->onStreamError(
@@ -213,7 +233,7 @@ class ThriftStreamShim {
         });
       }
       void onComplete() override {
-        eb_->add([this, s = self_] {
+        runInEventBase([this, s = self_] {
           if (clientCallback_) {
             std::exchange(clientCallback_, nullptr)->onStreamComplete();
             self_.reset();
@@ -226,12 +246,28 @@ class ThriftStreamShim {
       }
 
      private:
+      // Runs inline when the flowable signals from the client EventBase, and
+      // nothing it signalled earlier from elsewhere is still queued there.
+      template <typename F>
+      void runInEventBase(F&& f) {
+        if (eb_->isInEventBaseThread() && queued_.load() == 0) {
+          f();
+          return;
+        }
+        ++queued_;
+        eb_->add([this, f = std::forward<F>(f)]() mutable {
+          --queued_;
+          f();
+        });
+      }
+
       apache::thrift::StreamClientCallback* clientCallback_{nullptr};
       std::shared_ptr<Subscription> subscription_;
       uint32_t tokensBeforeSubscribe_{0};
       folly::Try<apache::thrift::StreamPayload> (*encode_)(folly::Try<T>&&);
       folly::EventBase* eb_;
       std::shared_ptr<StreamServerCallbackAdaptor> self_;
+      std::atomic<size_t> queued_{0};
     };
 
     return apache::thrift::ServerStream<T>(
@@ -303,6 +303,32 @@ class Observable : public yarpl::enable_get_ref {
    * Convert from Observable to Flowable with a given BackpressureStrategy.
    */
   auto toFlowable(std::shared_ptr<IBackpressureStrategy<T>> strategy);
+
+  /**
+   * Convert to a Flowable that drops the values the downstream hasn't
+   * requested.
+   */
+  auto onBackpressureDrop() {
+    return toFlowable(IBackpressureStrategy<T>::drop());
+  }
+
+  /**
+   * Convert to a Flowable that keeps only the latest value the downstream
+   * hasn't requested yet.
+   */
+  auto onBackpressureLatest() {
+    return toFlowable(IBackpressureStrategy<T>::latest());
+  }
+
+  /**
+   * Convert to a Flowable that buffers up to `capacity` values the downstream
+   * hasn't requested yet, and applies `policy` when there are more.
+   */
+  auto onBackpressureBuffer(
+      size_t capacity,
+      BufferOverflowPolicy policy = BufferOverflowPolicy::ERROR) {
+    return toFlowable(IBackpressureStrategy<T>::buffer(capacity, policy));
+  }
 };
 } // namespace observable
 } // namespace yarpl
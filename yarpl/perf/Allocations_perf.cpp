@@ -0,0 +1,121 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "yarpl/Flowable.h"
+#include "yarpl/flowable/PublishProcessor.h"
+
+/*
+ * Heap allocations per element of common pipelines, counted by replacing the
+ * global operator new of this binary.  Reported as the allocsPerElement
+ * counter; the timings include the cost of counting.
+ */
+
+namespace {
+std::atomic<size_t> allocations{0};
+} // namespace
+
+void* operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (auto p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  std::free(p);
+}
+
+using namespace yarpl;
+using namespace yarpl::flowable;
+
+namespace {
+
+constexpr int64_t kElements = 10000;
+
+template <typename Flowable>
+void consume(const std::shared_ptr<Flowable>& flowable) {
+  int64_t sum = 0;
+  flowable->subscribe(
+      Subscriber<int64_t>::create([&](int64_t value) { sum += value; }));
+  benchmark::DoNotOptimize(sum);
+}
+
+template <typename F>
+void countAllocations(benchmark::State& state, int64_t elements, F&& f) {
+  auto const before = allocations.load();
+  while (state.KeepRunning()) {
+    f();
+  }
+  auto const total = allocations.load() - before;
+  state.counters["allocsPerElement"] =
+      static_cast<double>(total) / (state.iterations() * elements);
+  state.SetItemsProcessed(state.iterations() * elements);
+}
+
+} // namespace
+
+static void Allocations_Range(benchmark::State& state) {
+  countAllocations(
+      state, kElements, [] { consume(Flowable<>::range(0, kElements)); });
+}
+BENCHMARK(Allocations_Range);
+
+static void Allocations_MapFilter(benchmark::State& state) {
+  countAllocations(state, kElements, [] {
+    consume(Flowable<>::range(0, kElements)
+                ->map([](int64_t v) { return v + 1; })
+                ->filter([](int64_t v) { return v % 2 == 0; }));
+  });
+}
+BENCHMARK(Allocations_MapFilter);
+
+static void Allocations_FlatMap(benchmark::State& state) {
+  countAllocations(state, kElements, [] {
+    consume(Flowable<>::range(0, kElements / 10)->flatMap([](int64_t v) {
+      return Flowable<>::range(v * 10, 10);
+    }));
+  });
+}
+BENCHMARK(Allocations_FlatMap);
+
+static void Allocations_ConcatWith(benchmark::State& state) {
+  countAllocations(state, kElements, [] {
+    consume(Flowable<>::range(0, kElements / 2)
+                ->concatWith(Flowable<>::range(0, kElements / 2)));
+  });
+}
+BENCHMARK(Allocations_ConcatWith);
+
+static void Allocations_PublishProcessor(benchmark::State& state) {
+  auto pp = PublishProcessor<int64_t>::create();
+  std::vector<std::shared_ptr<observable::Subscription>> subscriptions;
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    subscriptions.push_back(pp->subscribe(observable::Observer<int64_t>::create(
+        [](int64_t value) { benchmark::DoNotOptimize(value); })));
+  }
+  countAllocations(state, 1, [&] { pp->onNext(1); });
+  pp->onComplete();
+}
+BENCHMARK(Allocations_PublishProcessor)->Arg(1)->Arg(100);
+
+BENCHMARK_MAIN()
@@ -0,0 +1,82 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <benchmark/benchmark.h>
+#include <folly/Synchronized.h>
+#include <memory>
+#include "yarpl/Refcounted.h"
+
+/*
+ * Contention on yarpl::AtomicReference, as on the subscription of a stream
+ * whose request() and cancel() race from different threads.  The Mutex
+ * benchmarks are the mutex-guarded std::shared_ptr it used to be, for
+ * comparison.
+ */
+
+namespace {
+
+struct Mutexed {
+  folly::Synchronized<std::shared_ptr<int>, std::mutex> ref{
+      std::make_shared<int>(1)};
+};
+
+yarpl::AtomicReference<int> atomicRef{std::make_shared<int>(1)};
+Mutexed mutexRef;
+
+} // namespace
+
+static void AtomicReference_Load(benchmark::State& state) {
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(yarpl::atomic_load(&atomicRef));
+  }
+}
+BENCHMARK(AtomicReference_Load)->ThreadRange(1, 8);
+
+static void Mutex_Load(benchmark::State& state) {
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(*mutexRef.ref.lock());
+  }
+}
+BENCHMARK(Mutex_Load)->ThreadRange(1, 8);
+
+// One thread in four swaps the reference while the others load it.
+static void AtomicReference_LoadExchange(benchmark::State& state) {
+  auto const value = std::make_shared<int>(state.thread_index);
+  auto const exchanger = state.thread_index % 4 == 0;
+  while (state.KeepRunning()) {
+    if (exchanger) {
+      benchmark::DoNotOptimize(yarpl::atomic_exchange(&atomicRef, value));
+    } else {
+      benchmark::DoNotOptimize(yarpl::atomic_load(&atomicRef));
+    }
+  }
+}
+BENCHMARK(AtomicReference_LoadExchange)->ThreadRange(1, 8);
+
+static void Mutex_LoadExchange(benchmark::State& state) {
+  auto const value = std::make_shared<int>(state.thread_index);
+  auto const exchanger = state.thread_index % 4 == 0;
+  while (state.KeepRunning()) {
+    if (exchanger) {
+      auto ref = mutexRef.ref.lock();
+      auto old = std::exchange(*ref, value);
+      benchmark::DoNotOptimize(old);
+    } else {
+      benchmark::DoNotOptimize(*mutexRef.ref.lock());
+    }
+  }
+}
+BENCHMARK(Mutex_LoadExchange)->ThreadRange(1, 8);
+
+BENCHMARK_MAIN()
@@ -0,0 +1,243 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <benchmark/benchmark.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <folly/synchronization/Baton.h>
+#include <vector>
+#include "yarpl/Flowable.h"
+
+using namespace yarpl::flowable;
+
+namespace {
+
+constexpr int64_t kElements = 100000;
+
+template <typename Flowable>
+void consume(const std::shared_ptr<Flowable>& flowable) {
+  int64_t sum = 0;
+  flowable->subscribe(
+      Subscriber<int64_t>::create([&](int64_t value) { sum += value; }));
+  benchmark::DoNotOptimize(sum);
+}
+
+/// Requests `batch` elements at a time, each time the previous batch has
+/// arrived, and posts `done` on termination.
+class BatchingSubscriber : public BaseSubscriber<int64_t> {
+ public:
+  BatchingSubscriber(int64_t batch, folly::Baton<>& done)
+      : batch_(batch), done_(done) {}
+
+  void onSubscribeImpl() override {
+    this->request(batch_);
+  }
+
+  void onNextImpl(int64_t value) override {
+    sum_ += value;
+    if (++received_ == batch_) {
+      received_ = 0;
+      this->request(batch_);
+    }
+  }
+
+  void onCompleteImpl() override {
+    benchmark::DoNotOptimize(sum_);
+    done_.post();
+  }
+
+  void onErrorImpl(folly::exception_wrapper) override {
+    done_.post();
+  }
+
+ private:
+  int64_t const batch_;
+  folly::Baton<>& done_;
+  int64_t received_{0};
+  int64_t sum_{0};
+};
+
+template <typename Flowable>
+void consumeAsync(const std::shared_ptr<Flowable>& flowable, int64_t batch) {
+  folly::Baton<> done;
+  flowable->subscribe(std::make_shared<BatchingSubscriber>(batch, done));
+  done.wait();
+}
+
+class CancelOnSubscribe : public BaseSubscriber<int64_t> {
+  void onSubscribeImpl() override {
+    this->cancel();
+  }
+  void onNextImpl(int64_t) override {}
+  void onCompleteImpl() override {}
+  void onErrorImpl(folly::exception_wrapper) override {}
+};
+
+} // namespace
+
+static void Flowable_Range(benchmark::State& state) {
+  while (state.KeepRunning()) {
+    consume(Flowable<>::range(0, kElements));
+  }
+  state.SetItemsProcessed(state.iterations() * kElements);
+}
+BENCHMARK(Flowable_Range);
+
+static void Flowable_Map(benchmark::State& state) {
+  while (state.KeepRunning()) {
+    consume(
+        Flowable<>::range(0, kElements)->map([](int64_t v) { return v + 1; }));
+  }
+  state.SetItemsProcessed(state.iterations() * kElements);
+}
+BENCHMARK(Flowable_Map);
+
+static void Flowable_Filter(benchmark::State& state) {
+  while (state.KeepRunning()) {
+    consume(Flowable<>::range(0, kElements)->filter([](int64_t v) {
+      return v % 2 == 0;
+    }));
+  }
+  state.SetItemsProcessed(state.iterations() * kElements);
+}
+BENCHMARK(Flowable_Filter);
+
+// state.range(0) inner flowables of kElements / state.range(0) elements each.
+static void Flowable_FlatMap(benchmark::State& state) {
+  auto const inners = state.range(0);
+  auto const perInner = kElements / inners;
+  while (state.KeepRunning()) {
+    consume(Flowable<>::range(0, inners)->flatMap([perInner](int64_t v) {
+      return Flowable<>::range(v * perInner, perInner);
+    }));
+  }
+  state.SetItemsProcessed(state.iterations() * inners * perInner);
+}
+BENCHMARK(Flowable_FlatMap)->Arg(1)->Arg(100)->Arg(10000);
+
+// state.range(0) inner flowables of kElements / state.range(0) elements each,
+// merged on the subscribing thread.
+static void Flowable_Merge(benchmark::State& state) {
+  auto const inners = state.range(0);
+  auto const perInner = kElements / inners;
+  while (state.KeepRunning()) {
+    consume(Flowable<>::range(0, inners)
+                ->map([perInner](int64_t v) {
+                  return Flowable<>::range(v * perInner, perInner);
+                })
+                ->merge());
+  }
+  state.SetItemsProcessed(state.iterations() * inners * perInner);
+}
+BENCHMARK(Flowable_Merge)->Arg(1)->Arg(1000);
+
+// As above, with the inner flowables spread over four producer threads, e.g.
+// the streams of connections on different EventBases.
+static void Flowable_MergeCrossThread(benchmark::State& state) {
+  auto const inners = state.range(0);
+  auto const perInner = kElements / inners;
+  std::vector<folly::ScopedEventBaseThread> producers(4);
+  while (state.KeepRunning()) {
+    consumeAsync(
+        Flowable<>::range(0, inners)
+            ->map([&, perInner](int64_t v) {
+              auto& producer = producers[v % producers.size()];
+              return Flowable<>::range(v * perInner, perInner)
+                  ->subscribeOn(*producer.getEventBase());
+            })
+            ->merge(),
+        kElements);
+  }
+  state.SetItemsProcessed(state.iterations() * inners * perInner);
+}
+BENCHMARK(Flowable_MergeCrossThread)->Arg(1)->Arg(1000);
+
+static void Flowable_ConcatWith(benchmark::State& state) {
+  while (state.KeepRunning()) {
+    consume(Flowable<>::range(0, kElements / 2)
+                ->concatWith(Flowable<>::range(0, kElements / 2)));
+  }
+  state.SetItemsProcessed(state.iterations() * kElements);
+}
+BENCHMARK(Flowable_ConcatWith);
+
+// Elements handed over to another thread, requested state.range(0) at a time.
+static void Flowable_ObserveOn(benchmark::State& state) {
+  folly::ScopedEventBaseThread consumer;
+  while (state.KeepRunning()) {
+    consumeAsync(
+        Flowable<>::range(0, kElements)
+            ->observeOn(*consumer.getEventBase()),
+        state.range(0));
+  }
+  state.SetItemsProcessed(state.iterations() * kElements);
+}
+BENCHMARK(Flowable_ObserveOn)->Arg(1)->Arg(64)->Arg(kElements);
+
+// Credits go from the consumer thread to the producer thread, and elements
+// come back, state.range(0) at a time.
+static void Flowable_CrossThreadCredits(benchmark::State& state) {
+  folly::ScopedEventBaseThread producer;
+  folly::ScopedEventBaseThread consumer;
+  while (state.KeepRunning()) {
+    consumeAsync(
+        Flowable<>::range(0, kElements)
+            ->subscribeOn(*producer.getEventBase())
+            ->observeOn(*consumer.getEventBase()),
+        state.range(0));
+  }
+  state.SetItemsProcessed(state.iterations() * kElements);
+}
+BENCHMARK(Flowable_CrossThreadCredits)->Arg(1)->Arg(64)->Arg(1024);
+
+// Cost of setting up and tearing down a three stage pipeline.
+static void Flowable_SubscribeCancel(benchmark::State& state) {
+  auto flowable = Flowable<>::range(0, kElements)
+                      ->map([](int64_t v) { return v + 1; })
+                      ->filter([](int64_t v) { return v % 2 == 0; });
+  while (state.KeepRunning()) {
+    flowable->subscribe(std::make_shared<CancelOnSubscribe>());
+  }
+}
+BENCHMARK(Flowable_SubscribeCancel);
+
+static void Flowable_MapFilterChain(benchmark::State& state) {
+  while (state.KeepRunning()) {
+    consume(Flowable<>::range(0, kElements)
+                ->map([](int64_t v) { return v + 1; })
+                ->filter([](int64_t v) { return v % 3 != 0; })
+                ->map([](int64_t v) { return v * 2; })
+                ->filter([](int64_t v) { return v % 5 != 0; })
+                ->map([](int64_t v) { return v - 1; })
+                ->map([](int64_t v) { return v / 2; }));
+  }
+  state.SetItemsProcessed(state.iterations() * kElements);
+}
+BENCHMARK(Flowable_MapFilterChain);
+
+static void Flowable_FusedMapFilterChain(benchmark::State& state) {
+  while (state.KeepRunning()) {
+    consume(Flowable<>::range(0, kElements)
+                ->fuse()
+                ->map([](int64_t v) { return v + 1; })
+                ->filter([](int64_t v) { return v % 3 != 0; })
+                ->map([](int64_t v) { return v * 2; })
+                ->filter([](int64_t v) { return v % 5 != 0; })
+                ->map([](int64_t v) { return v - 1; })
+                ->map([](int64_t v) { return v / 2; }));
+  }
+  state.SetItemsProcessed(state.iterations() * kElements);
+}
+BENCHMARK(Flowable_FusedMapFilterChain);
+
+BENCHMARK_MAIN()
@@ -0,0 +1,77 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <vector>
+#include "yarpl/flowable/PublishProcessor.h"
+
+using namespace yarpl;
+using namespace yarpl::flowable;
+
+namespace {
+
+/// Move-only value whose clone() shares its buffer, like rsocket::Payload.
+struct SharedBuffer {
+  explicit SharedBuffer(std::shared_ptr<const std::vector<char>> b)
+      : buffer(std::move(b)) {}
+  SharedBuffer(SharedBuffer&&) = default;
+  SharedBuffer& operator=(SharedBuffer&&) = default;
+
+  SharedBuffer clone() const {
+    return SharedBuffer(buffer);
+  }
+
+  std::shared_ptr<const std::vector<char>> buffer;
+};
+
+template <typename T>
+std::vector<std::shared_ptr<observable::Subscription>> subscribeN(
+    PublishProcessor<T>& pp,
+    int64_t n) {
+  std::vector<std::shared_ptr<observable::Subscription>> subscriptions;
+  for (int64_t i = 0; i < n; ++i) {
+    subscriptions.push_back(pp.subscribe(observable::Observer<T>::create(
+        [](T value) { benchmark::DoNotOptimize(value); })));
+  }
+  return subscriptions;
+}
+
+} // namespace
+
+// One onNext() fanned out to state.range(0) subscribers.
+static void PublishProcessor_OnNext(benchmark::State& state) {
+  auto pp = PublishProcessor<int>::create();
+  auto subscriptions = subscribeN(*pp, state.range(0));
+  while (state.KeepRunning()) {
+    pp->onNext(1);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  pp->onComplete();
+}
+BENCHMARK(PublishProcessor_OnNext)->Arg(100)->Arg(10000);
+
+static void PublishProcessor_OnNextClone(benchmark::State& state) {
+  auto pp = PublishProcessor<SharedBuffer>::create();
+  auto subscriptions = subscribeN(*pp, state.range(0));
+  auto const buffer = std::make_shared<const std::vector<char>>(1024);
+  while (state.KeepRunning()) {
+    pp->onNext(SharedBuffer(buffer));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  pp->onComplete();
+}
+BENCHMARK(PublishProcessor_OnNextClone)->Arg(100)->Arg(10000);
+
+BENCHMARK_MAIN()
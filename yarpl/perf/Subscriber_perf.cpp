@@ -0,0 +1,71 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <benchmark/benchmark.h>
+#include "yarpl/flowable/Subscriber.h"
+#include "yarpl/utils/PoolAllocator.h"
+
+/*
+ * Cost of creating the lambda subscriber and subscription of a short-lived
+ * request/response stream, with make_shared and with yarpl::PoolAllocator.
+ */
+
+using namespace yarpl;
+using namespace yarpl::flowable;
+
+static void Subscriber_MakeShared(benchmark::State& state) {
+  int64_t sum = 0;
+  while (state.KeepRunning()) {
+    auto subscriber = Subscriber<int64_t>::create(
+        [&](int64_t value) { sum += value; },
+        [](folly::exception_wrapper) {},
+        [] {});
+    subscriber->onSubscribe(Subscription::create([] {}, [](int64_t) {}));
+    subscriber->onNext(1);
+    subscriber->onComplete();
+  }
+  benchmark::DoNotOptimize(sum);
+}
+BENCHMARK(Subscriber_MakeShared);
+
+static void Subscriber_Pooled(benchmark::State& state) {
+  int64_t sum = 0;
+  PoolAllocator<void> alloc;
+  while (state.KeepRunning()) {
+    auto subscriber = Subscriber<int64_t>::create(
+        std::allocator_arg,
+        alloc,
+        [&](int64_t value) { sum += value; },
+        [](folly::exception_wrapper) {},
+        [] {});
+    subscriber->onSubscribe(Subscription::create(
+        std::allocator_arg, alloc, [] {}, [](int64_t) {}));
+    subscriber->onNext(1);
+    subscriber->onComplete();
+  }
+  benchmark::DoNotOptimize(sum);
+}
+BENCHMARK(Subscriber_Pooled);
+
+static void Subscriber_PooledThreads(benchmark::State& state) {
+  PoolAllocator<void> alloc;
+  while (state.KeepRunning()) {
+    auto subscriber = Subscriber<int64_t>::create(
+        std::allocator_arg, alloc, [](int64_t) {});
+    benchmark::DoNotOptimize(subscriber.get());
+  }
+}
+BENCHMARK(Subscriber_PooledThreads)->ThreadRange(1, 8);
+
+BENCHMARK_MAIN()
@@ -14,6 +14,8 @@
 
 #pragma once
 
+#include <folly/Optional.h>
+#include <folly/Try.h>
 #include <folly/functional/Invoke.h>
 #include <folly/synchronization/Baton.h>
 
@@ -32,6 +34,20 @@ class Single : public yarpl::enable_get_ref {
 
   virtual void subscribe(std::shared_ptr<SingleObserver<T>>) = 0;
 
+  /**
+   * Moves the result out of a Single that was created with it, such as
+   * Singles::just() or Singles::error(), and returns folly::none for any
+   * other Single.  This lets a consumer skip the observer and subscription
+   * for a result that is ready up front.
+   *
+   * Only call this on a Single that can't be subscribed to by anyone else,
+   * e.g. one that was just returned to the caller and whose use_count() is 1:
+   * once the result is taken the Single has nothing left to deliver.
+   */
+  virtual folly::Optional<folly::Try<T>> takeReadyResult() {
+    return folly::none;
+  }
+
   /**
    * Subscribe overload that accepts lambdas.
    */
@@ -0,0 +1,271 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <folly/ExceptionWrapper.h>
+#include <folly/Try.h>
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "yarpl/Refcounted.h"
+#include "yarpl/single/Single.h"
+#include "yarpl/single/SingleObserver.h"
+#include "yarpl/single/SingleSubscription.h"
+
+namespace yarpl {
+namespace single {
+namespace details {
+
+/// Subscribes to all of its singles at once, and combines their results as
+/// `Policy` says, see Singles::zip(), Singles::whenAll() and
+/// Singles::firstOf().
+///
+/// A subscription allocates a single State, which is the observer of every
+/// input single through an aliasing shared_ptr, and the subscription of the
+/// downstream observer.  The inputs may signal from any thread: the first
+/// of the inputs and the downstream to terminate the state wins, and
+/// cancels the inputs still running.
+template <typename T, typename Policy>
+class GatherSingle : public Single<typename Policy::Result> {
+  using Result = typename Policy::Result;
+
+ public:
+  explicit GatherSingle(std::vector<std::shared_ptr<Single<T>>> singles)
+      : singles_(std::move(singles)) {
+    for (const auto& single : singles_) {
+      CHECK(single);
+    }
+  }
+
+  void subscribe(std::shared_ptr<SingleObserver<Result>> observer) override {
+    auto state = std::make_shared<State>(std::move(observer), singles_.size());
+    state->start(singles_);
+  }
+
+  class State : public SingleSubscription,
+                public std::enable_shared_from_this<State> {
+   public:
+    State(std::shared_ptr<SingleObserver<Result>> observer, size_t size)
+        : observer_(std::move(observer)), inputs_(size), pending_(size) {
+      for (size_t i = 0; i < size; ++i) {
+        inputs_[i].state_ = this;
+        inputs_[i].index_ = i;
+      }
+    }
+
+    void start(const std::vector<std::shared_ptr<Single<T>>>& singles) {
+      auto self = this->shared_from_this();
+      observer_->onSubscribe(self);
+      if (singles.empty()) {
+        Policy::onEmpty(*this);
+        return;
+      }
+      for (size_t i = 0; i < singles.size(); ++i) {
+        if (terminated_.load(std::memory_order_acquire)) {
+          return;
+        }
+        singles[i]->subscribe(
+            std::shared_ptr<SingleObserver<T>>(self, &inputs_[i]));
+      }
+    }
+
+    void cancel() override {
+      if (!terminated_.exchange(true)) {
+        observer_.reset();
+        cancelInputs();
+      }
+    }
+
+    size_t size() const {
+      return inputs_.size();
+    }
+
+    /// The result of an input, once it has arrived().
+    folly::Try<T>& result(size_t index) {
+      return inputs_[index].result_;
+    }
+
+    /// Counts an input as terminated.  Returns true for the last one, which
+    /// sees the results of all of them.
+    bool arrived() {
+      return pending_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+
+    void succeed(Result result) {
+      if (!terminated_.exchange(true)) {
+        cancelInputs();
+        std::exchange(observer_, nullptr)->onSuccess(std::move(result));
+      }
+    }
+
+    void fail(folly::exception_wrapper ew) {
+      if (!terminated_.exchange(true)) {
+        cancelInputs();
+        std::exchange(observer_, nullptr)->onError(std::move(ew));
+      }
+    }
+
+   private:
+    class Input : public SingleObserver<T> {
+     public:
+      void onSubscribe(std::shared_ptr<SingleSubscription> subscription)
+          override {
+        yarpl::atomic_store(&subscription_, std::move(subscription));
+        // The state may have terminated before the subscription was stored.
+        if (state_->terminated_.load()) {
+          cancel();
+        }
+      }
+
+      void onSuccess(T value) override {
+        yarpl::atomic_exchange(&subscription_, nullptr);
+        Policy::onSuccess(*state_, index_, std::move(value));
+      }
+
+      void onError(folly::exception_wrapper ew) override {
+        yarpl::atomic_exchange(&subscription_, nullptr);
+        Policy::onError(*state_, index_, std::move(ew));
+      }
+
+      void cancel() {
+        auto subscription = yarpl::atomic_exchange(&subscription_, nullptr);
+        if (subscription) {
+          subscription->cancel();
+        }
+      }
+
+     private:
+      friend class State;
+
+      State* state_{nullptr};
+      size_t index_{0};
+      AtomicReference<SingleSubscription> subscription_;
+      folly::Try<T> result_;
+    };
+
+    void cancelInputs() {
+      for (auto& input : inputs_) {
+        input.cancel();
+      }
+    }
+
+    /// Only touched by whoever terminates the state.
+    std::shared_ptr<SingleObserver<Result>> observer_;
+    std::vector<Input> inputs_;
+    std::atomic<size_t> pending_;
+    std::atomic<bool> terminated_{false};
+  };
+
+ private:
+  const std::vector<std::shared_ptr<Single<T>>> singles_;
+};
+
+/// Succeeds with all the values once every input succeeded, or fails with
+/// the first error.
+template <typename T>
+struct ZipPolicy {
+  using Result = std::vector<T>;
+
+  template <typename State>
+  static void onEmpty(State& state) {
+    state.succeed(Result());
+  }
+
+  template <typename State>
+  static void onSuccess(State& state, size_t index, T value) {
+    state.result(index) = folly::Try<T>(std::move(value));
+    if (state.arrived()) {
+      Result values;
+      values.reserve(state.size());
+      for (size_t i = 0; i < state.size(); ++i) {
+        values.push_back(std::move(state.result(i)).value());
+      }
+      state.succeed(std::move(values));
+    }
+  }
+
+  template <typename State>
+  static void onError(State& state, size_t, folly::exception_wrapper ew) {
+    state.fail(std::move(ew));
+  }
+};
+
+/// Succeeds with the results of all the inputs once every one terminated.
+template <typename T>
+struct WhenAllPolicy {
+  using Result = std::vector<folly::Try<T>>;
+
+  template <typename State>
+  static void onEmpty(State& state) {
+    state.succeed(Result());
+  }
+
+  template <typename State>
+  static void onSuccess(State& state, size_t index, T value) {
+    state.result(index) = folly::Try<T>(std::move(value));
+    finishIfLast(state);
+  }
+
+  template <typename State>
+  static void
+  onError(State& state, size_t index, folly::exception_wrapper ew) {
+    state.result(index) = folly::Try<T>(std::move(ew));
+    finishIfLast(state);
+  }
+
+  template <typename State>
+  static void finishIfLast(State& state) {
+    if (state.arrived()) {
+      Result results;
+      results.reserve(state.size());
+      for (size_t i = 0; i < state.size(); ++i) {
+        results.push_back(std::move(state.result(i)));
+      }
+      state.succeed(std::move(results));
+    }
+  }
+};
+
+/// Succeeds with the first value, or fails with the last error once every
+/// input failed.
+template <typename T>
+struct FirstOfPolicy {
+  using Result = T;
+
+  template <typename State>
+  static void onEmpty(State& state) {
+    state.fail(std::invalid_argument("firstOf() of no singles"));
+  }
+
+  template <typename State>
+  static void onSuccess(State& state, size_t, T value) {
+    state.succeed(std::move(value));
+  }
+
+  template <typename State>
+  static void onError(State& state, size_t, folly::exception_wrapper ew) {
+    if (state.arrived()) {
+      state.fail(std::move(ew));
+    }
+  }
+};
+
+} // namespace details
+} // namespace single
+} // namespace yarpl
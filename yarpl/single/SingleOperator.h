@@ -17,8 +17,10 @@
 #include <folly/Try.h>
 #include <folly/functional/Invoke.h>
 
+#include <stdexcept>
 #include <utility>
 
+#include "yarpl/Common.h"
 #include "yarpl/single/Single.h"
 #include "yarpl/single/SingleObserver.h"
 #include "yarpl/single/SingleSubscriptions.h"
@@ -225,6 +227,34 @@ class FromPublisherOperator : public Single<T> {
   OnSubscribe function_;
 };
 
+/// Single created with its result, see Singles::just() and Singles::error().
+/// Every subscriber gets a copy of the value (see ValueCopy), unless it was
+/// moved out by takeReadyResult().
+template <typename T>
+class ReadySingle : public Single<T> {
+ public:
+  explicit ReadySingle(folly::Try<T> result) : result_(std::move(result)) {}
+
+  void subscribe(std::shared_ptr<SingleObserver<T>> observer) override {
+    observer->onSubscribe(SingleSubscriptions::ready());
+    if (!result_) {
+      observer->onError(std::logic_error("Single result was already taken"));
+    } else if (result_->hasValue()) {
+      observer->onSuccess(
+          yarpl::details::ValueCopy<T>::copy(result_->value()));
+    } else {
+      observer->onError(result_->exception());
+    }
+  }
+
+  folly::Optional<folly::Try<T>> takeReadyResult() override {
+    return std::exchange(result_, folly::none);
+  }
+
+ private:
+  folly::Optional<folly::Try<T>> result_;
+};
+
 template <typename OnSubscribe>
 class SingleVoidFromPublisherOperator : public Single<void> {
   static_assert(
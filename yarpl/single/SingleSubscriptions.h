@@ -130,6 +130,16 @@ class SingleSubscriptions {
   static std::shared_ptr<SingleSubscription> empty() {
     return std::make_shared<AtomicBoolSingleSubscription>();
   }
+  // Shared subscription for Singles that deliver their result from within
+  // subscribe(), where there is nothing left to cancel.
+  static const std::shared_ptr<SingleSubscription>& ready() {
+    class ReadySingleSubscription : public SingleSubscription {
+      void cancel() override {}
+    };
+    static const std::shared_ptr<SingleSubscription> instance =
+        std::make_shared<ReadySingleSubscription>();
+    return instance;
+  }
   static std::shared_ptr<AtomicBoolSingleSubscription>
   atomicBoolSubscription() {
     return std::make_shared<AtomicBoolSingleSubscription>();
@@ -15,10 +15,14 @@
 #pragma once
 
 #include "yarpl/single/Single.h"
+#include "yarpl/single/SingleCombinators.h"
 #include "yarpl/single/SingleSubscriptions.h"
 
 #include <folly/functional/Invoke.h>
 
+#include <type_traits>
+#include <vector>
+
 namespace yarpl {
 namespace single {
 
@@ -26,12 +30,15 @@ class Singles {
  public:
   template <typename T>
   static std::shared_ptr<Single<T>> just(const T& value) {
-    auto lambda = [value](std::shared_ptr<SingleObserver<T>> observer) {
-      observer->onSubscribe(SingleSubscriptions::empty());
-      observer->onSuccess(value);
-    };
+    return std::make_shared<ReadySingle<T>>(
+        folly::Try<T>(yarpl::details::ValueCopy<T>::copy(value)));
+  }
 
-    return Single<T>::create(std::move(lambda));
+  template <
+      typename T,
+      typename = std::enable_if_t<!std::is_reference<T>::value>>
+  static std::shared_ptr<Single<T>> just(T&& value) {
+    return std::make_shared<ReadySingle<T>>(folly::Try<T>(std::move(value)));
   }
 
   template <
@@ -48,21 +55,13 @@ class Singles {
 
   template <typename T>
   static std::shared_ptr<Single<T>> error(folly::exception_wrapper ex) {
-    auto lambda =
-        [e = std::move(ex)](std::shared_ptr<SingleObserver<T>> observer) {
-          observer->onSubscribe(SingleSubscriptions::empty());
-          observer->onError(e);
-        };
-    return Single<T>::create(std::move(lambda));
+    return std::make_shared<ReadySingle<T>>(folly::Try<T>(std::move(ex)));
   }
 
   template <typename T, typename ExceptionType>
   static std::shared_ptr<Single<T>> error(const ExceptionType& ex) {
-    auto lambda = [ex](std::shared_ptr<SingleObserver<T>> observer) {
-      observer->onSubscribe(SingleSubscriptions::empty());
-      observer->onError(ex);
-    };
-    return Single<T>::create(std::move(lambda));
+    return std::make_shared<ReadySingle<T>>(
+        folly::Try<T>(folly::exception_wrapper(ex)));
   }
 
   template <typename T, typename TGenerator>
@@ -75,6 +74,46 @@ class Singles {
     return Single<T>::create(std::move(lambda));
   }
 
+  /**
+   * Subscribes to all of `singles` at once, and succeeds with their values,
+   * in the same order, once all of them succeeded.  Fails with the first
+   * error, and cancels the singles that are still running.
+   *
+   * Made for scatter-gather: whatever the number of singles, a subscription
+   * allocates a single state object, which observes all of them.
+   */
+  template <typename T>
+  static std::shared_ptr<Single<std::vector<T>>> zip(
+      std::vector<std::shared_ptr<Single<T>>> singles) {
+    return std::make_shared<
+        details::GatherSingle<T, details::ZipPolicy<T>>>(std::move(singles));
+  }
+
+  /**
+   * Like zip(), but waits for all of `singles` to terminate, and succeeds
+   * with their results, errors included.
+   */
+  template <typename T>
+  static std::shared_ptr<Single<std::vector<folly::Try<T>>>> whenAll(
+      std::vector<std::shared_ptr<Single<T>>> singles) {
+    return std::make_shared<
+        details::GatherSingle<T, details::WhenAllPolicy<T>>>(
+        std::move(singles));
+  }
+
+  /**
+   * Succeeds with the value of the first of `singles` to succeed, and
+   * cancels the others.  Fails with the last error if all of them fail, and
+   * with std::invalid_argument if there are none.
+   */
+  template <typename T>
+  static std::shared_ptr<Single<T>> firstOf(
+      std::vector<std::shared_ptr<Single<T>>> singles) {
+    return std::make_shared<
+        details::GatherSingle<T, details::FirstOfPolicy<T>>>(
+        std::move(singles));
+  }
+
  private:
   Singles() = delete;
 };
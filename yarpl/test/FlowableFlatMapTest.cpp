@@ -16,6 +16,7 @@
 #include <folly/io/async/EventBaseThread.h>
 #include <folly/synchronization/Baton.h>
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <deque>
 #include <thread>
 #include <type_traits>
@@ -293,5 +294,233 @@ TEST(FlowableFlatMapTest, MergeOperator) {
       sub->values(), {{"foo", "bar"}, {"baz", "quxx"}}));
 }
 
+namespace {
+
+/// Flowable that a test drives by hand, recording the requests it gets.
+class ManualFlowable : public Flowable<int64_t> {
+ public:
+  void subscribe(std::shared_ptr<Subscriber<int64_t>> subscriber) override {
+    subscriber_ = std::move(subscriber);
+    subscriber_->onSubscribe(subscription_);
+  }
+
+  bool subscribed() const {
+    return subscriber_ != nullptr;
+  }
+  int64_t requested() const {
+    return subscription_->requested;
+  }
+  bool cancelled() const {
+    return subscription_->cancelled;
+  }
+
+  void next(int64_t value) {
+    subscriber_->onNext(value);
+  }
+  void complete() {
+    std::exchange(subscriber_, nullptr)->onComplete();
+  }
+  void error(std::string message) {
+    std::exchange(subscriber_, nullptr)
+        ->onError(std::runtime_error(std::move(message)));
+  }
+
+ private:
+  struct ManualSubscription : public Subscription {
+    void request(int64_t n) override {
+      requested += n;
+    }
+    void cancel() override {
+      cancelled = true;
+    }
+
+    int64_t requested{0};
+    bool cancelled{false};
+  };
+
+  std::shared_ptr<ManualSubscription> subscription_{
+      std::make_shared<ManualSubscription>()};
+  std::shared_ptr<Subscriber<int64_t>> subscriber_;
+};
+
+std::vector<std::shared_ptr<ManualFlowable>> makeManualFlowables(size_t n) {
+  std::vector<std::shared_ptr<ManualFlowable>> flowables;
+  for (size_t i = 0; i < n; ++i) {
+    flowables.push_back(std::make_shared<ManualFlowable>());
+  }
+  return flowables;
+}
+
+} // namespace
+
+TEST(FlowableFlatMapTest, MergeManyInnersAcrossThreads) {
+  constexpr int64_t kInners = 1000;
+  constexpr int64_t kPerInner = 100;
+  std::vector<folly::EventBaseThread> threads(4);
+
+  auto sub = std::make_shared<TestSubscriber<int64_t>>();
+  Flowable<>::range(0, kInners)
+      ->map([&](int64_t i) {
+        auto& thread = threads[i % threads.size()];
+        return Flowable<>::range(i * kPerInner, kPerInner)
+            ->subscribeOn(*thread.getEventBase());
+      })
+      ->merge(8)
+      ->subscribe(sub);
+
+  sub->awaitTerminalEvent(std::chrono::seconds{5});
+  EXPECT_TRUE(sub->isComplete());
+  auto values = sub->values();
+  ASSERT_EQ(kInners * kPerInner, values.size());
+  std::sort(values.begin(), values.end());
+  for (int64_t i = 0; i < kInners * kPerInner; ++i) {
+    ASSERT_EQ(i, values[i]);
+  }
+}
+
+TEST(FlowableFlatMapTest, MergePrefetches) {
+  auto inners = makeManualFlowables(2);
+  auto sub = std::make_shared<TestSubscriber<int64_t>>(0);
+  Flowable<>::justN<std::shared_ptr<Flowable<int64_t>>>(
+      {inners[0], inners[1]})
+      ->merge(4)
+      ->subscribe(sub);
+  EXPECT_EQ(4, inners[0]->requested());
+  EXPECT_EQ(4, inners[1]->requested());
+
+  for (int64_t i = 0; i < 4; ++i) {
+    inners[0]->next(i);
+  }
+  inners[1]->next(10);
+  sub->request(2);
+  // Round-robin over the inners with elements.
+  EXPECT_EQ(std::vector<int64_t>({0, 10}), sub->values());
+
+  sub->request(10);
+  EXPECT_EQ(std::vector<int64_t>({0, 10, 1, 2, 3}), sub->values());
+  EXPECT_EQ(4 + 3, inners[0]->requested());
+
+  inners[0]->complete();
+  inners[1]->complete();
+  EXPECT_TRUE(sub->isComplete());
+}
+
+TEST(FlowableFlatMapTest, BoundedConcurrencyAllValues) {
+  auto f = Flowable<>::range(0, 10)->flatMap(
+      [](int64_t n) { return Flowable<>::range(n * 10, 5); }, 3, 2);
+
+  auto values = run(f, 1000);
+  ASSERT_EQ(50, values.size());
+  std::sort(values.begin(), values.end());
+  for (int64_t n = 0; n < 10; ++n) {
+    for (int64_t i = 0; i < 5; ++i) {
+      EXPECT_EQ(n * 10 + i, values[n * 5 + i]);
+    }
+  }
+}
+
+TEST(FlowableFlatMapTest, BoundedConcurrencyLimitsSubscriptions) {
+  auto inners = makeManualFlowables(4);
+  auto f = Flowable<>::range(0, 4)->flatMap(
+      [&](int64_t n) -> std::shared_ptr<Flowable<int64_t>> {
+        return inners[n];
+      },
+      2,
+      4);
+
+  auto sub = std::make_shared<TestSubscriber<int64_t>>();
+  f->subscribe(sub);
+
+  EXPECT_TRUE(inners[0]->subscribed());
+  EXPECT_TRUE(inners[1]->subscribed());
+  EXPECT_FALSE(inners[2]->subscribed());
+  EXPECT_EQ(4, inners[0]->requested());
+
+  inners[1]->next(7);
+  EXPECT_EQ(std::vector<int64_t>({7}), sub->values());
+
+  inners[0]->complete();
+  EXPECT_TRUE(inners[2]->subscribed());
+  EXPECT_FALSE(inners[3]->subscribed());
+
+  inners[1]->complete();
+  inners[2]->complete();
+  EXPECT_TRUE(inners[3]->subscribed());
+  EXPECT_FALSE(sub->isComplete());
+
+  inners[3]->next(8);
+  inners[3]->complete();
+  EXPECT_EQ(std::vector<int64_t>({7, 8}), sub->values());
+  EXPECT_TRUE(sub->isComplete());
+}
+
+TEST(FlowableFlatMapTest, BoundedConcurrencyReplenishesInBatches) {
+  auto inners = makeManualFlowables(1);
+  auto f = Flowable<>::range(0, 1)->flatMap(
+      [&](int64_t n) -> std::shared_ptr<Flowable<int64_t>> {
+        return inners[n];
+      },
+      1,
+      4);
+
+  auto sub = std::make_shared<TestSubscriber<int64_t>>(0);
+  f->subscribe(sub);
+  EXPECT_EQ(4, inners[0]->requested());
+
+  for (int64_t i = 0; i < 4; ++i) {
+    inners[0]->next(i);
+  }
+  // Buffered until the downstream asks for them.
+  EXPECT_EQ(0, sub->getValueCount());
+
+  sub->request(2);
+  EXPECT_EQ(std::vector<int64_t>({0, 1}), sub->values());
+  EXPECT_EQ(4, inners[0]->requested());
+
+  sub->request(2);
+  EXPECT_EQ(std::vector<int64_t>({0, 1, 2, 3}), sub->values());
+  EXPECT_EQ(4 + 3, inners[0]->requested());
+
+  inners[0]->complete();
+  EXPECT_TRUE(sub->isComplete());
+}
+
+TEST(FlowableFlatMapTest, BoundedConcurrencyErrorCancelsInners) {
+  auto inners = makeManualFlowables(2);
+  auto f = Flowable<>::range(0, 2)->flatMap(
+      [&](int64_t n) -> std::shared_ptr<Flowable<int64_t>> {
+        return inners[n];
+      },
+      2,
+      4);
+
+  auto sub = std::make_shared<TestSubscriber<int64_t>>();
+  f->subscribe(sub);
+
+  inners[1]->error("oops");
+  EXPECT_TRUE(sub->isError());
+  EXPECT_EQ("oops", sub->getErrorMsg());
+  EXPECT_TRUE(inners[0]->cancelled());
+}
+
+TEST(FlowableFlatMapTest, BoundedConcurrencyCancelCancelsInners) {
+  auto inners = makeManualFlowables(3);
+  auto f = Flowable<>::range(0, 3)->flatMap(
+      [&](int64_t n) -> std::shared_ptr<Flowable<int64_t>> {
+        return inners[n];
+      },
+      2,
+      4);
+
+  auto sub = std::make_shared<TestSubscriber<int64_t>>();
+  f->subscribe(sub);
+
+  sub->cancel();
+  EXPECT_TRUE(inners[0]->cancelled());
+  EXPECT_TRUE(inners[1]->cancelled());
+  EXPECT_FALSE(inners[2]->subscribed());
+  EXPECT_FALSE(sub->isComplete());
+}
+
 } // namespace flowable
 } // namespace yarpl
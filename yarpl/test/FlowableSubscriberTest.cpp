@@ -14,6 +14,7 @@
 
 #include "yarpl/flowable/Subscriber.h"
 #include "yarpl/test_utils/Mocks.h"
+#include "yarpl/utils/PoolAllocator.h"
 
 using namespace yarpl;
 using namespace yarpl::flowable;
@@ -143,4 +144,81 @@ TEST(FlowableSubscriberTest, AutoFlowControl) {
 
   subscriber->onSubscribe(subscription);
 }
+
+TEST(FlowableSubscriberTest, PooledSubscriber) {
+  int next{0}, errors{0}, completes{0};
+  auto create = [&] {
+    return Subscriber<int>::create(
+        std::allocator_arg,
+        PoolAllocator<void>(),
+        [&](int) { ++next; },
+        [&](folly::exception_wrapper) { ++errors; },
+        [&] { ++completes; });
+  };
+
+  auto subscriber = create();
+  subscriber->onSubscribe(Subscription::create());
+  subscriber->onNext(1);
+  subscriber->onComplete();
+  EXPECT_EQ(1, next);
+  EXPECT_EQ(0, errors);
+  EXPECT_EQ(1, completes);
+
+  // The block goes back to this thread's pool and is handed out again.
+  auto address = subscriber.get();
+  subscriber.reset();
+  subscriber = create();
+  EXPECT_EQ(address, subscriber.get());
+
+  subscriber->onSubscribe(Subscription::create(
+      std::allocator_arg, PoolAllocator<void>(), [] {}, [](int64_t) {}));
+  subscriber->onError(std::runtime_error("failed"));
+  EXPECT_EQ(1, errors);
+}
+
+TEST(FlowableSubscriberTest, CancellationToken) {
+  int next{0}, cancels{0};
+  auto subscriber =
+      details::LambdaSubscriber<int>::create([&](int) { ++next; });
+  auto token = subscriber->cancellationToken();
+  EXPECT_FALSE(token.isDisposed());
+
+  subscriber->onSubscribe(Subscription::create([&] { ++cancels; }));
+  subscriber->onNext(1);
+  token.dispose();
+  EXPECT_TRUE(token.isDisposed());
+  EXPECT_EQ(1, cancels);
+
+  subscriber->onNext(2);
+  token.dispose();
+  EXPECT_EQ(1, next);
+  EXPECT_EQ(1, cancels);
+}
+
+TEST(FlowableSubscriberTest, CancellationTokenAfterTermination) {
+  int cancels{0};
+  auto subscriber = details::LambdaSubscriber<int>::create([](int) {});
+  auto token = subscriber->cancellationToken();
+  subscriber->onSubscribe(Subscription::create([&] { ++cancels; }));
+  subscriber->onComplete();
+  EXPECT_TRUE(token.isDisposed());
+
+  // The slot is recycled for the next subscriber, which the stale token
+  // must not cancel.
+  auto other = details::LambdaSubscriber<int>::create([](int) {});
+  auto otherToken = other->cancellationToken();
+  other->onSubscribe(Subscription::create([&] { ++cancels; }));
+  token.dispose();
+  EXPECT_FALSE(otherToken.isDisposed());
+  EXPECT_EQ(0, cancels);
+
+  // Nor does a token keep its subscriber alive.
+  std::weak_ptr<void> weak = other;
+  other.reset();
+  EXPECT_TRUE(weak.expired());
+  EXPECT_TRUE(otherToken.isDisposed());
+  otherToken.dispose();
+  EXPECT_EQ(0, cancels);
+  EXPECT_TRUE(CancellationToken().isDisposed());
+}
 } // namespace
@@ -17,6 +17,8 @@
 #include <folly/io/async/ScopedEventBaseThread.h>
 #include <folly/synchronization/Baton.h>
 #include <gtest/gtest.h>
+#include <map>
+#include <numeric>
 #include <thread>
 #include <type_traits>
 #include <vector>
@@ -180,6 +182,70 @@ TEST(FlowableTest, Range) {
       std::vector<int64_t>({10, 11, 12, 13, 14}));
 }
 
+TEST(FlowableTest, RangeResubscribe) {
+  auto flowable = Flowable<>::range(1, 3);
+  auto first = std::make_shared<TestSubscriber<int64_t>>(1);
+  flowable->subscribe(first);
+  EXPECT_EQ(std::vector<int64_t>({1}), first->values());
+
+  // A second subscription starts from the beginning, without disturbing the
+  // first one.
+  EXPECT_EQ(run(flowable), std::vector<int64_t>({1, 2, 3}));
+
+  first->request(10);
+  EXPECT_EQ(std::vector<int64_t>({1, 2, 3}), first->values());
+  EXPECT_TRUE(first->isComplete());
+}
+
+TEST(FlowableTest, RangeEmptyCompletesWithoutRequest) {
+  auto subscriber = std::make_shared<TestSubscriber<int64_t>>(0);
+  Flowable<>::range(1, 0)->subscribe(subscriber);
+  EXPECT_TRUE(subscriber->isComplete());
+  EXPECT_EQ(0, subscriber->getValueCount());
+}
+
+TEST(FlowableTest, RangeCancel) {
+  EXPECT_EQ(
+      run(Flowable<>::range(1, 1000000)->take(3)),
+      std::vector<int64_t>({1, 2, 3}));
+}
+
+TEST(FlowableTest, FromGeneratorResubscribe) {
+  auto flowable = Flowable<int>::fromGenerator([i = 0]() mutable {
+    return i++;
+  });
+  EXPECT_EQ(run(flowable->take(3)), std::vector<int>({0, 1, 2}));
+  // Subscriptions share the generator, as they did when fromGenerator was
+  // built on create().
+  EXPECT_EQ(run(flowable->take(2)), std::vector<int>({3, 4}));
+}
+
+TEST(FlowableTest, EmitBatch) {
+  auto makeFlowable = [] {
+    return Flowable<std::string>::create(
+        [i = 0](Subscriber<std::string>& subscriber, int64_t n) mutable {
+          std::vector<std::string> batch;
+          while (i < 10 && static_cast<int64_t>(batch.size()) < n &&
+                 batch.size() < 3) {
+            batch.push_back(std::to_string(i++));
+          }
+          subscriber.onNextBatch(folly::range(batch));
+          if (i == 10) {
+            subscriber.onComplete();
+          }
+        });
+  };
+
+  EXPECT_EQ(
+      run(makeFlowable()),
+      std::vector<std::string>(
+          {"0", "1", "2", "3", "4", "5", "6", "7", "8", "9"}));
+  // take() cancels in the middle of the second batch.
+  EXPECT_EQ(
+      run(makeFlowable()->take(4)),
+      std::vector<std::string>({"0", "1", "2", "3"}));
+}
+
 TEST(FlowableTest, RangeWithMap) {
   auto flowable = Flowable<>::range(1, 3)
                       ->map([](int64_t v) { return v * v; })
@@ -280,6 +346,90 @@ TEST(FlowableTest, RangeWithMapAndFilter) {
   EXPECT_EQ(run(std::move(flowable)), std::vector<char>({11, 13, 15, 17, 19}));
 }
 
+TEST(FlowableTest, FusedMapAndFilter) {
+  std::shared_ptr<Flowable<std::string>> flowable =
+      Flowable<>::range(0, 10)
+          ->fuse()
+          ->map([](int64_t v) { return v * v; })
+          ->filter([](int64_t v) { return v % 2 != 0; })
+          ->map([](int64_t v) { return std::to_string(v); });
+  EXPECT_EQ(
+      run(std::move(flowable)),
+      std::vector<std::string>({"1", "9", "25", "49", "81"}));
+}
+
+TEST(FlowableTest, FusedFilterRequestsReplacements) {
+  std::shared_ptr<Flowable<int64_t>> flowable =
+      Flowable<>::range(0, 10)->fuse()->filter([](int64_t v) {
+        return v % 2 != 0;
+      });
+  EXPECT_EQ(run(std::move(flowable), 2), std::vector<int64_t>({1, 3}));
+}
+
+TEST(FlowableTest, FusedOperatorsAreReusable) {
+  auto squares =
+      Flowable<>::range(1, 3)->fuse()->map([](int64_t v) { return v * v; });
+  std::shared_ptr<Flowable<int64_t>> plusOne =
+      squares->map([](int64_t v) { return v + 1; });
+
+  EXPECT_EQ(
+      run(std::shared_ptr<Flowable<int64_t>>(squares)),
+      std::vector<int64_t>({1, 4, 9}));
+  EXPECT_EQ(run(std::move(plusOne)), std::vector<int64_t>({2, 5, 10}));
+}
+
+TEST(FlowableTest, FusedMapWithException) {
+  auto flowable = Flowable<>::justN<int>({1, 2, 3, 4})
+                      ->fuse()
+                      ->map([](int n) { return n * 2; })
+                      ->map([](int n) {
+                        if (n > 4) {
+                          throw std::runtime_error{"Too big!"};
+                        }
+                        return n;
+                      });
+
+  auto subscriber = std::make_shared<TestSubscriber<int>>();
+  flowable->subscribe(subscriber);
+
+  EXPECT_EQ(subscriber->values(), std::vector<int>({2, 4}));
+  EXPECT_TRUE(subscriber->isError());
+  EXPECT_EQ(subscriber->getErrorMsg(), "Too big!");
+}
+
+TEST(FlowableTest, FusedMapsErrors) {
+  auto flowable =
+      Flowable<int>::error(std::runtime_error("first"))
+          ->fuse()
+          ->map(
+              [](int n) { return n; },
+              [](folly::exception_wrapper&&) {
+                return folly::make_exception_wrapper<std::runtime_error>(
+                    "second");
+              })
+          ->map(
+              [](int n) { return n; },
+              [](folly::exception_wrapper&& ew) {
+                return folly::make_exception_wrapper<std::runtime_error>(
+                    ew.get_exception()->what() + std::string(" third"));
+              });
+
+  auto subscriber = std::make_shared<TestSubscriber<int>>();
+  flowable->subscribe(subscriber);
+  EXPECT_TRUE(subscriber->isError());
+  EXPECT_EQ(subscriber->getErrorMsg(), "second third");
+}
+
+TEST(FlowableTest, FusedThenUnfused) {
+  std::shared_ptr<Flowable<int64_t>> flowable = Flowable<>::range(0, 100)
+                                                    ->fuse()
+                                                    ->map([](int64_t v) {
+                                                      return v + 1;
+                                                    })
+                                                    ->take(3);
+  EXPECT_EQ(run(std::move(flowable)), std::vector<int64_t>({1, 2, 3}));
+}
+
 TEST(FlowableTest, SimpleTake) {
   EXPECT_EQ(
       run(Flowable<>::range(0, 100)->take(3)), std::vector<int64_t>({0, 1, 2}));
@@ -331,6 +481,372 @@ TEST(FlowableTest, SkipPartial) {
   subscriber->cancel();
 }
 
+TEST(FlowableTest, Buffer) {
+  EXPECT_EQ(
+      run(Flowable<>::range(0, 7)->buffer(3)),
+      std::vector<std::vector<int64_t>>({{0, 1, 2}, {3, 4, 5}, {6}}));
+  EXPECT_EQ(
+      run(Flowable<>::range(0, 0)->buffer(3)),
+      std::vector<std::vector<int64_t>>());
+}
+
+TEST(FlowableTest, BufferTranslatesDemand) {
+  int64_t requested = 0;
+  int64_t next = 0;
+  auto flowable = Flowable<int64_t>::create([&](auto& subscriber, int64_t n) {
+    requested += n;
+    while (n-- > 0) {
+      subscriber.onNext(next++);
+    }
+  });
+
+  auto subscriber = std::make_shared<TestSubscriber<std::vector<int64_t>>>(2);
+  flowable->buffer(3)->subscribe(subscriber);
+  EXPECT_EQ(6, requested);
+  EXPECT_EQ(
+      subscriber->values(),
+      std::vector<std::vector<int64_t>>({{0, 1, 2}, {3, 4, 5}}));
+
+  subscriber->request(1);
+  EXPECT_EQ(9, requested);
+  EXPECT_EQ(3, subscriber->getValueCount());
+  subscriber->cancel();
+}
+
+TEST(FlowableTest, BufferBytes) {
+  auto flowable =
+      Flowable<>::justN<std::string>({"aa", "bbb", "c", "dddddd", "e"})
+          ->bufferBytes(4, [](const std::string& s) { return s.size(); });
+  EXPECT_EQ(
+      run(flowable),
+      std::vector<std::vector<std::string>>(
+          {{"aa"}, {"bbb", "c"}, {"dddddd"}, {"e"}}));
+}
+
+TEST(FlowableTest, BufferBytesWaitsForDemand) {
+  auto flowable =
+      Flowable<>::range(0, 10)->bufferBytes(2, [](int64_t) { return 1; }, 3);
+
+  auto subscriber = std::make_shared<TestSubscriber<std::vector<int64_t>>>(1);
+  flowable->subscribe(subscriber);
+  EXPECT_EQ(
+      subscriber->values(), std::vector<std::vector<int64_t>>({{0, 1}}));
+
+  subscriber->request(100);
+  EXPECT_EQ(5, subscriber->getValueCount());
+  EXPECT_EQ(subscriber->values().back(), std::vector<int64_t>({8, 9}));
+  EXPECT_TRUE(subscriber->isComplete());
+}
+
+TEST(FlowableTest, BufferTimeout) {
+  folly::EventBase timerEvb;
+  auto flowable =
+      Flowable<>::range(1, 2)
+          ->concatWith(Flowable<int64_t>::never())
+          ->bufferTimeout(5, std::chrono::milliseconds(10), timerEvb);
+
+  auto subscriber = std::make_shared<TestSubscriber<std::vector<int64_t>>>();
+  flowable->subscribe(subscriber);
+  EXPECT_EQ(0, subscriber->getValueCount());
+
+  timerEvb.loop();
+  EXPECT_EQ(
+      subscriber->values(), std::vector<std::vector<int64_t>>({{1, 2}}));
+  EXPECT_FALSE(subscriber->isComplete());
+  subscriber->cancel();
+}
+
+TEST(FlowableTest, ThrottleFirst) {
+  EXPECT_EQ(
+      run(Flowable<>::range(1, 5)->throttleFirst(std::chrono::hours(1))),
+      std::vector<int64_t>({1}));
+  EXPECT_EQ(
+      run(Flowable<>::range(1, 3)->throttleFirst(std::chrono::milliseconds(0))),
+      std::vector<int64_t>({1, 2, 3}));
+}
+
+TEST(FlowableTest, ThrottleFirstReplacesDropped) {
+  auto subscriber = std::make_shared<TestSubscriber<int64_t>>(2);
+  Flowable<>::range(1, 5)
+      ->throttleFirst(std::chrono::hours(1))
+      ->subscribe(subscriber);
+  EXPECT_EQ(subscriber->values(), std::vector<int64_t>({1}));
+  EXPECT_TRUE(subscriber->isComplete());
+}
+
+TEST(FlowableTest, Sample) {
+  folly::EventBase timerEvb;
+  auto flowable = Flowable<>::range(1, 3)
+                      ->concatWith(Flowable<int64_t>::never())
+                      ->sample(std::chrono::milliseconds(10), timerEvb);
+
+  auto subscriber = std::make_shared<TestSubscriber<int64_t>>();
+  flowable->subscribe(subscriber);
+  EXPECT_EQ(0, subscriber->getValueCount());
+
+  timerEvb.runAfterDelay([&] { subscriber->cancel(); }, 50);
+  timerEvb.loop();
+  EXPECT_EQ(subscriber->values(), std::vector<int64_t>({3}));
+}
+
+TEST(FlowableTest, RateLimit) {
+  folly::EventBase timerEvb;
+  auto flowable = Flowable<>::range(1, 10)->rateLimit(1000, 2, timerEvb);
+
+  auto subscriber = std::make_shared<TestSubscriber<int64_t>>();
+  flowable->subscribe(subscriber);
+  EXPECT_EQ(subscriber->values(), std::vector<int64_t>({1, 2}));
+
+  timerEvb.loop();
+  std::vector<int64_t> expected(10);
+  std::iota(expected.begin(), expected.end(), 1);
+  EXPECT_EQ(subscriber->values(), expected);
+  EXPECT_TRUE(subscriber->isComplete());
+}
+
+TEST(FlowableTest, RateLimitWithinBurst) {
+  folly::EventBase timerEvb;
+  auto flowable = Flowable<>::range(1, 10)->rateLimit(1, 5, timerEvb);
+
+  auto subscriber = std::make_shared<TestSubscriber<int64_t>>(3);
+  flowable->subscribe(subscriber);
+  EXPECT_EQ(subscriber->values(), std::vector<int64_t>({1, 2, 3}));
+
+  // Nothing to request later, so no timer is left behind.
+  timerEvb.loop();
+  EXPECT_EQ(3, subscriber->getValueCount());
+  subscriber->cancel();
+}
+
+TEST(FlowableTest, GroupBy) {
+  using Group = std::shared_ptr<GroupedFlowable<int64_t, int64_t>>;
+  std::map<int64_t, std::shared_ptr<TestSubscriber<int64_t>>> groups;
+  auto groupsSubscriber = Subscriber<Group>::create([&](Group group) {
+    auto subscriber = std::make_shared<TestSubscriber<int64_t>>();
+    groups[group->key()] = subscriber;
+    group->subscribe(subscriber);
+  });
+
+  Flowable<>::range(0, 10)
+      ->groupBy([](int64_t v) { return v % 3; })
+      ->subscribe(groupsSubscriber);
+
+  ASSERT_EQ(3, groups.size());
+  EXPECT_EQ(groups[0]->values(), std::vector<int64_t>({0, 3, 6, 9}));
+  EXPECT_EQ(groups[1]->values(), std::vector<int64_t>({1, 4, 7}));
+  EXPECT_EQ(groups[2]->values(), std::vector<int64_t>({2, 5, 8}));
+  for (auto& group : groups) {
+    EXPECT_TRUE(group.second->isComplete());
+  }
+}
+
+TEST(FlowableTest, GroupByBoundedBuffers) {
+  using Group = std::shared_ptr<GroupedFlowable<int64_t, int64_t>>;
+  std::vector<std::shared_ptr<TestSubscriber<int64_t>>> groups;
+  auto groupsSubscriber = Subscriber<Group>::create([&](Group group) {
+    groups.push_back(std::make_shared<TestSubscriber<int64_t>>(0));
+    group->subscribe(groups.back());
+  });
+
+  int64_t emitted = 0;
+  Flowable<>::range(0, 100)
+      ->doOnNext([&](int64_t) { ++emitted; })
+      ->groupBy([](int64_t v) { return v % 2; }, 2)
+      ->subscribe(groupsSubscriber);
+
+  // Nothing is requested, so the groups fill up: the first window of 2 opens
+  // both, a window of 1 fills the first one, and then no group has room.
+  ASSERT_EQ(2, groups.size());
+  EXPECT_EQ(3, emitted);
+
+  groups[0]->request(1000);
+  groups[1]->request(1000);
+  EXPECT_EQ(100, emitted);
+  EXPECT_EQ(50, groups[0]->getValueCount());
+  EXPECT_EQ(50, groups[1]->getValueCount());
+  EXPECT_TRUE(groups[0]->isComplete());
+  EXPECT_TRUE(groups[1]->isComplete());
+}
+
+TEST(FlowableTest, GroupByEvictsCancelledGroups) {
+  using Group = std::shared_ptr<GroupedFlowable<int64_t, int64_t>>;
+  std::vector<int64_t> keys;
+  std::vector<std::shared_ptr<TestSubscriber<int64_t>>> groups;
+  auto groupsSubscriber = Subscriber<Group>::create([&](Group group) {
+    keys.push_back(group->key());
+    groups.push_back(std::make_shared<TestSubscriber<int64_t>>());
+    group->take(1)->subscribe(groups.back());
+  });
+
+  // With room for a single element, each one is requested after the
+  // previous one was delivered.
+  Flowable<>::range(0, 6)
+      ->groupBy([](int64_t v) { return v % 2; }, 1)
+      ->subscribe(groupsSubscriber);
+
+  EXPECT_EQ(keys, std::vector<int64_t>({0, 1, 0, 1, 0, 1}));
+  for (size_t i = 0; i < groups.size(); ++i) {
+    EXPECT_EQ(groups[i]->values(), std::vector<int64_t>({int64_t(i)}));
+  }
+}
+
+TEST(FlowableTest, Scan) {
+  auto flowable = Flowable<>::range(1, 4)->scan(
+      int64_t(0), [](int64_t acc, int64_t v) { return acc + v; });
+  EXPECT_EQ(run(flowable), std::vector<int64_t>({1, 3, 6, 10}));
+
+  auto subscriber = std::make_shared<TestSubscriber<int64_t>>(2);
+  flowable->subscribe(subscriber);
+  EXPECT_EQ(subscriber->values(), std::vector<int64_t>({1, 3}));
+  subscriber->cancel();
+}
+
+TEST(FlowableTest, ReduceInto) {
+  auto flowable = Flowable<>::range(1, 4)->reduceInto(
+      std::vector<int64_t>(),
+      [](std::vector<int64_t>& acc, int64_t v) { acc.push_back(v * 2); });
+  EXPECT_EQ(
+      run(flowable), std::vector<std::vector<int64_t>>({{2, 4, 6, 8}}));
+
+  auto empty = Flowable<int64_t>::empty()->reduceInto(
+      int64_t(7), [](int64_t& acc, int64_t v) { acc += v; });
+  EXPECT_EQ(run(empty), std::vector<int64_t>({7}));
+}
+
+TEST(FlowableTest, Window) {
+  auto flowable = Flowable<>::range(1, 10)->window(
+      4, int64_t(0), [](int64_t& acc, int64_t v) { acc += v; });
+  EXPECT_EQ(run(flowable), std::vector<int64_t>({10, 26, 19}));
+
+  auto subscriber = std::make_shared<TestSubscriber<int64_t>>(1);
+  flowable->subscribe(subscriber);
+  EXPECT_EQ(subscriber->values(), std::vector<int64_t>({10}));
+  subscriber->request(5);
+  EXPECT_EQ(subscriber->values(), std::vector<int64_t>({10, 26, 19}));
+  EXPECT_TRUE(subscriber->isComplete());
+}
+
+TEST(FlowableTest, WindowTimeout) {
+  folly::EventBase timerEvb;
+  auto flowable =
+      Flowable<>::range(1, 2)
+          ->concatWith(Flowable<int64_t>::never())
+          ->windowTimeout(
+              5,
+              std::chrono::milliseconds(10),
+              timerEvb,
+              int64_t(0),
+              [](int64_t& acc, int64_t) { ++acc; });
+
+  auto subscriber = std::make_shared<TestSubscriber<int64_t>>();
+  flowable->subscribe(subscriber);
+  EXPECT_EQ(0, subscriber->getValueCount());
+
+  timerEvb.loop();
+  EXPECT_EQ(subscriber->values(), std::vector<int64_t>({2}));
+  EXPECT_FALSE(subscriber->isComplete());
+  subscriber->cancel();
+}
+
+TEST(FlowableTest, Cache) {
+  int subscriptions = 0;
+  auto flowable = Flowable<>::range(0, 5)
+                      ->doOnSubscribe([&] { ++subscriptions; })
+                      ->cache();
+  EXPECT_EQ(0, subscriptions);
+
+  EXPECT_EQ(run(flowable), std::vector<int64_t>({0, 1, 2, 3, 4}));
+  EXPECT_EQ(run(flowable), std::vector<int64_t>({0, 1, 2, 3, 4}));
+  EXPECT_EQ(1, subscriptions);
+}
+
+TEST(FlowableTest, ReplayBounded) {
+  auto flowable = Flowable<>::range(0, 5)->replay(2);
+  EXPECT_EQ(run(flowable), std::vector<int64_t>({0, 1, 2, 3, 4}));
+  EXPECT_EQ(run(flowable), std::vector<int64_t>({3, 4}));
+}
+
+TEST(FlowableTest, ReplayAcrossSegments) {
+  auto flowable = Flowable<>::range(0, 1000)->replay(300);
+  std::vector<int64_t> expected(300);
+  std::iota(expected.begin(), expected.end(), 700);
+
+  auto subscriber = std::make_shared<TestSubscriber<int64_t>>();
+  flowable->subscribe(subscriber);
+  EXPECT_EQ(1000, subscriber->getValueCount());
+  EXPECT_EQ(run(flowable, 1000), expected);
+}
+
+TEST(FlowableTest, ReplayBytes) {
+  auto flowable =
+      Flowable<>::justN<std::string>({"aaaa", "bb", "cc", "dddddddd"})
+          ->replay(6, [](const std::string& s) { return s.size(); });
+  EXPECT_EQ(
+      run(flowable),
+      std::vector<std::string>({"aaaa", "bb", "cc", "dddddddd"}));
+  // The newest element is kept even though it doesn't fit.
+  EXPECT_EQ(run(flowable), std::vector<std::string>({"dddddddd"}));
+}
+
+namespace {
+struct Compactable {
+  int value{0};
+  bool compacted{false};
+
+  void compact() {
+    compacted = true;
+  }
+};
+} // namespace
+
+TEST(FlowableTest, ReplayCompacts) {
+  auto flowable =
+      Flowable<>::justN<Compactable>({Compactable{1}, Compactable{2}})
+          ->cache();
+  auto subscriber = std::make_shared<TestSubscriber<Compactable>>();
+  flowable->subscribe(subscriber);
+  ASSERT_EQ(2, subscriber->getValueCount());
+  for (const auto& value : subscriber->values()) {
+    EXPECT_TRUE(value.compacted);
+  }
+}
+
+TEST(FlowableTest, ReplayPerSubscriberCredits) {
+  auto flowable = Flowable<>::range(0, 5)->cache();
+
+  auto slow = std::make_shared<TestSubscriber<int64_t>>(0);
+  auto fast = std::make_shared<TestSubscriber<int64_t>>(3);
+  flowable->subscribe(slow);
+  flowable->subscribe(fast);
+  EXPECT_EQ(0, slow->getValueCount());
+  EXPECT_EQ(fast->values(), std::vector<int64_t>({0, 1, 2}));
+
+  slow->request(1);
+  EXPECT_EQ(slow->values(), std::vector<int64_t>({0}));
+  fast->request(2);
+  EXPECT_EQ(fast->values(), std::vector<int64_t>({0, 1, 2, 3, 4}));
+  EXPECT_TRUE(fast->isComplete());
+
+  slow->request(10);
+  EXPECT_EQ(slow->values(), std::vector<int64_t>({0, 1, 2, 3, 4}));
+  EXPECT_TRUE(slow->isComplete());
+}
+
+TEST(FlowableTest, ReplayError) {
+  auto flowable = Flowable<>::range(0, 2)
+                      ->concatWith(Flowable<int64_t>::error(
+                          std::runtime_error("replayed error")))
+                      ->cache();
+
+  for (int i = 0; i < 2; ++i) {
+    auto subscriber = std::make_shared<TestSubscriber<int64_t>>();
+    flowable->subscribe(subscriber);
+    EXPECT_EQ(subscriber->values(), std::vector<int64_t>({0, 1}));
+    EXPECT_TRUE(subscriber->isError());
+    EXPECT_EQ(subscriber->getErrorMsg(), "replayed error");
+  }
+}
+
 TEST(FlowableTest, IgnoreElements) {
   auto flowable = Flowable<>::range(0, 100)->ignoreElements()->map(
       [](int64_t v) { return v * v; });
@@ -865,6 +1381,22 @@ void cancelDuringOnNext(Op&& op, F&& f) {
   cancelled.post();
 }
 
+TEST(FlowableTest, SubscribeWithToken) {
+  int values{0}, cancels{0};
+  auto token = Flowable<int64_t>::never()
+                   ->doOnCancel([&] { ++cancels; })
+                   ->subscribeWithToken([&](int64_t) { ++values; });
+  EXPECT_FALSE(token.isDisposed());
+  token.dispose();
+  EXPECT_TRUE(token.isDisposed());
+  EXPECT_EQ(1, cancels);
+
+  token = Flowable<>::justN({1, 2, 3})->subscribeWithToken(
+      [&](int64_t) { ++values; }, [](folly::exception_wrapper) {}, 1);
+  EXPECT_EQ(3, values);
+  EXPECT_TRUE(token.isDisposed());
+}
+
 TEST(FlowableTest, CancelDuringMapOnNext) {
   cancelDuringOnNext(
       [](auto&& flowable, auto&& f) { return flowable->map(f); },
@@ -1015,6 +1547,28 @@ TEST(FlowableTest, ConcatTest) {
   EXPECT_EQ(run(combined), std::vector<int64_t>({1, 2, 5, 6, 10, 11, 15, 16}));
 }
 
+TEST(FlowableTest, ConcatWithLongChain) {
+  // Neither subscribing to the chain, nor destroying it, recurses once per
+  // concatenated flowable.
+  constexpr int64_t kPages = 100000;
+  auto combined = Flowable<>::range(0, 1);
+  for (int64_t i = 1; i < kPages; ++i) {
+    combined = combined->concatWith(Flowable<>::range(i, 1));
+  }
+
+  std::vector<int64_t> expected(kPages);
+  std::iota(expected.begin(), expected.end(), 0);
+  EXPECT_EQ(run(combined), expected);
+
+  auto subscriber = std::make_shared<TestSubscriber<int64_t>>(0);
+  combined->subscribe(subscriber);
+  subscriber->request(3);
+  EXPECT_EQ(subscriber->values(), std::vector<int64_t>({0, 1, 2}));
+  subscriber->request(kPages);
+  EXPECT_EQ(subscriber->values(), expected);
+  EXPECT_TRUE(subscriber->isComplete());
+}
+
 TEST(FlowableTest, ConcatWith_DelaySubscribe) {
   // If there is no request for the second flowable, don't subscribe to it
   bool subscribed = false;
@@ -1170,6 +1724,36 @@ TEST(FlowableTest, Timeout_OnNextTimeout) {
   EXPECT_TRUE(subscriber->isError());
 }
 
+TEST(FlowableTest, Timeout_DeadlineMovesWithElements) {
+  folly::EventBase timerEvb;
+
+  // Elements every 20 msec keep pushing the 50 msec deadline out, well past
+  // the first expiry of the timer.
+  auto flowable = Flowable<>::range(1, 10)->observeOn(timerEvb)->timeout(
+      timerEvb, std::chrono::milliseconds(50), std::chrono::milliseconds(0));
+
+  int requestCount = 1;
+  auto subscriber = std::make_shared<TestSubscriber<int64_t>>(requestCount);
+  flowable->subscribe(subscriber);
+  flowable.reset();
+
+  TestTimeout* next = nullptr;
+  TestTimeout timeout(&timerEvb, [&]() {
+    subscriber->request(1);
+    if (!subscriber->isComplete() && !subscriber->isError()) {
+      next->scheduleTimeout(20);
+    }
+  });
+  next = &timeout;
+  timeout.scheduleTimeout(20);
+
+  timerEvb.loop();
+
+  subscriber->awaitTerminalEvent(std::chrono::seconds(1));
+  EXPECT_EQ(10, subscriber->getValueCount());
+  EXPECT_FALSE(subscriber->isError());
+}
+
 TEST(FlowableTest, Timeout_InitTimeout) {
   folly::EventBase timerEvb;
   auto flowable = Flowable<int64_t>::create([=](auto& subscriber, int64_t req) {
@@ -429,6 +429,64 @@ TEST(Observable, toFlowableBufferStrategyLimit) {
   EXPECT_TRUE(subscription->isCancelled());
 }
 
+namespace {
+
+/// Pushes 1..8 through `strategy` to a subscriber that requested 2 values,
+/// then requests 10 more.  Returns the values the subscriber got.
+std::vector<int64_t> runBoundedBuffer(
+    std::shared_ptr<IBackpressureStrategy<int64_t>> strategy) {
+  std::shared_ptr<Observer<int64_t>> observer;
+  auto a = Observable<int64_t>::createEx(
+      [&](auto o, auto) { observer = std::move(o); });
+
+  std::vector<int64_t> v;
+  auto subscriber = std::make_shared<NiceMock<MockSubscriber<int64_t>>>(2);
+  EXPECT_CALL(*subscriber, onNext_(_))
+      .WillRepeatedly(Invoke([&](int64_t value) { v.push_back(value); }));
+  a->toFlowable(std::move(strategy))->subscribe(subscriber);
+
+  for (int64_t i = 1; i <= 8; ++i) {
+    observer->onNext(i);
+  }
+  subscriber->subscription()->request(10);
+  return v;
+}
+
+} // namespace
+
+TEST(Observable, toFlowableBoundedBufferDropOldest) {
+  EXPECT_EQ(
+      runBoundedBuffer(IBackpressureStrategy<int64_t>::buffer(
+          3, BufferOverflowPolicy::DROP_OLDEST)),
+      std::vector<int64_t>({1, 2, 6, 7, 8}));
+}
+
+TEST(Observable, toFlowableBoundedBufferDropNewest) {
+  EXPECT_EQ(
+      runBoundedBuffer(IBackpressureStrategy<int64_t>::buffer(
+          3, BufferOverflowPolicy::DROP_NEWEST)),
+      std::vector<int64_t>({1, 2, 3, 4, 5}));
+}
+
+TEST(Observable, toFlowableBoundedBufferReusesRing) {
+  std::shared_ptr<Observer<int64_t>> observer;
+  auto a = Observable<int64_t>::createEx(
+      [&](auto o, auto) { observer = std::move(o); });
+
+  std::vector<int64_t> v;
+  auto subscriber = std::make_shared<NiceMock<MockSubscriber<int64_t>>>(0);
+  EXPECT_CALL(*subscriber, onNext_(_))
+      .WillRepeatedly(Invoke([&](int64_t value) { v.push_back(value); }));
+  a->onBackpressureBuffer(2)->subscribe(subscriber);
+
+  // Wraps around the ring several times.
+  for (int64_t i = 1; i <= 10; ++i) {
+    observer->onNext(i);
+    subscriber->subscription()->request(1);
+  }
+  EXPECT_EQ(v, std::vector<int64_t>({1, 2, 3, 4, 5, 6, 7, 8, 9, 10}));
+}
+
 TEST(Observable, toFlowableBufferStrategyStress) {
   std::shared_ptr<Observer<int64_t>> observer;
   auto a = Observable<int64_t>::createEx(
@@ -0,0 +1,123 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "yarpl/Flowable.h"
+#include "yarpl/flowable/TestSubscriber.h"
+
+using namespace yarpl::flowable;
+
+namespace {
+
+constexpr int64_t kElements = 1000;
+
+std::vector<int64_t> doubled(int64_t count) {
+  std::vector<int64_t> values(count);
+  std::iota(values.begin(), values.end(), 0);
+  for (auto& value : values) {
+    value *= 2;
+  }
+  return values;
+}
+
+class ParallelFlowableTest : public ::testing::Test {
+ protected:
+  folly::CPUThreadPoolExecutor pool_{4};
+};
+
+} // namespace
+
+TEST_F(ParallelFlowableTest, Sequential) {
+  auto flowable = Flowable<>::range(0, kElements)
+                      ->parallel(4, pool_)
+                      ->map([](int64_t v) { return v * 2; })
+                      ->sequential();
+
+  auto subscriber = std::make_shared<TestSubscriber<int64_t>>();
+  flowable->subscribe(subscriber);
+  subscriber->awaitTerminalEvent(std::chrono::seconds(5));
+  EXPECT_TRUE(subscriber->isComplete());
+
+  auto values = subscriber->values();
+  std::sort(values.begin(), values.end());
+  EXPECT_EQ(doubled(kElements), values);
+}
+
+TEST_F(ParallelFlowableTest, SequentialOrdered) {
+  auto flowable = Flowable<>::range(0, kElements)
+                      ->parallel(4, pool_)
+                      ->map([](int64_t v) {
+                        if (v % 7 == 0) {
+                          // Let the other rails run ahead.
+                          std::this_thread::sleep_for(
+                              std::chrono::microseconds(100));
+                        }
+                        return v * 2;
+                      })
+                      ->sequentialOrdered(8);
+
+  for (int i = 0; i < 2; ++i) {
+    auto subscriber = std::make_shared<TestSubscriber<int64_t>>();
+    flowable->subscribe(subscriber);
+    subscriber->awaitTerminalEvent(std::chrono::seconds(5));
+    EXPECT_TRUE(subscriber->isComplete());
+    EXPECT_EQ(doubled(kElements), subscriber->values());
+  }
+}
+
+TEST_F(ParallelFlowableTest, Backpressure) {
+  std::atomic<int64_t> produced{0};
+  auto flowable = Flowable<>::range(0, kElements)
+                      ->doOnNext([&](int64_t) { ++produced; })
+                      ->parallel(2, pool_)
+                      ->sequential(4);
+
+  auto subscriber = std::make_shared<TestSubscriber<int64_t>>(10);
+  flowable->subscribe(subscriber);
+  subscriber->awaitValueCount(10, std::chrono::seconds(5));
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  EXPECT_EQ(10, subscriber->getValueCount());
+  // Two rails, each prefetching 4 elements past what was requested.
+  EXPECT_LE(produced, 10 + 2 * 4);
+  subscriber->cancel();
+}
+
+TEST_F(ParallelFlowableTest, Error) {
+  auto flowable = Flowable<>::range(0, kElements)
+                      ->parallel(4, pool_)
+                      ->map([](int64_t v) {
+                        if (v == 500) {
+                          throw std::runtime_error("bad element");
+                        }
+                        return v;
+                      })
+                      ->sequentialOrdered();
+
+  auto subscriber = std::make_shared<TestSubscriber<int64_t>>();
+  flowable->subscribe(subscriber);
+  subscriber->awaitTerminalEvent(std::chrono::seconds(5));
+  EXPECT_TRUE(subscriber->isError());
+  EXPECT_EQ("bad element", subscriber->getErrorMsg());
+  EXPECT_LE(subscriber->getValueCount(), 500);
+}
@@ -217,3 +217,53 @@ TEST(PublishProcessorTest, OnMultipleSubscribersMultithreadedTest) {
     thread.join();
   }
 }
+
+namespace {
+
+/// Move-only value whose clone() shares its buffer, like rsocket::Payload.
+struct SharedBuffer {
+  explicit SharedBuffer(std::shared_ptr<int> b) : buffer(std::move(b)) {}
+  SharedBuffer(SharedBuffer&&) = default;
+  SharedBuffer& operator=(SharedBuffer&&) = default;
+
+  SharedBuffer clone() const {
+    ++clones;
+    return SharedBuffer(buffer);
+  }
+
+  std::shared_ptr<int> buffer;
+  static int clones;
+};
+
+int SharedBuffer::clones = 0;
+
+} // namespace
+
+TEST(PublishProcessorTest, OnNextClonesMoveOnlyValues) {
+  auto pp = PublishProcessor<SharedBuffer>::create();
+
+  std::vector<std::shared_ptr<int>> received;
+  std::vector<std::shared_ptr<observable::Subscription>> subscriptions;
+  for (int i = 0; i < 3; ++i) {
+    subscriptions.push_back(pp->subscribe(
+        observable::Observer<SharedBuffer>::create([&](SharedBuffer value) {
+          received.push_back(std::move(value.buffer));
+        })));
+  }
+
+  SharedBuffer::clones = 0;
+  auto buffer = std::make_shared<int>(42);
+  pp->onNext(SharedBuffer(buffer));
+
+  // The last subscriber gets the original.
+  EXPECT_EQ(2, SharedBuffer::clones);
+  ASSERT_EQ(3, received.size());
+  for (auto& b : received) {
+    EXPECT_EQ(buffer, b);
+  }
+
+  for (auto& subscription : subscriptions) {
+    subscription->cancel();
+  }
+  EXPECT_FALSE(pp->hasSubscribers());
+}
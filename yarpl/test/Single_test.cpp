@@ -67,6 +67,34 @@ TEST(Single, Error) {
   to->assertOnErrorMessage("something broke!");
 }
 
+TEST(Single, TakeReadyResult) {
+  auto just = Singles::just<int>(1);
+  auto result = just->takeReadyResult();
+  ASSERT_TRUE(result.hasValue());
+  EXPECT_EQ(1, result->value());
+
+  // Nothing is left to deliver once the result has been taken.
+  EXPECT_FALSE(just->takeReadyResult().hasValue());
+  auto to = SingleTestObserver<int>::create();
+  just->subscribe(to);
+  to->awaitTerminalEvent();
+  to->assertOnErrorMessage("Single result was already taken");
+
+  auto error = Singles::error<int>(std::runtime_error("something broke!"));
+  result = error->takeReadyResult();
+  ASSERT_TRUE(result.hasValue());
+  EXPECT_TRUE(result->hasException());
+  EXPECT_STREQ(
+      "something broke!", result->exception().get_exception()->what());
+
+  auto created =
+      Single<int>::create([](std::shared_ptr<SingleObserver<int>> obs) {
+        obs->onSubscribe(SingleSubscriptions::empty());
+        obs->onSuccess(1);
+      });
+  EXPECT_FALSE(created->takeReadyResult().hasValue());
+}
+
 TEST(Single, SingleMap) {
   auto a = Single<int>::create([](std::shared_ptr<SingleObserver<int>> obs) {
     obs->onSubscribe(SingleSubscriptions::empty());
@@ -92,3 +120,119 @@ TEST(Single, MapWithException) {
 
   observer->assertOnErrorMessage("Too big!");
 }
+
+namespace {
+/// A single that hands its observer out, to be completed by the test.
+std::shared_ptr<Single<int>> pendingSingle(
+    std::shared_ptr<SingleObserver<int>>& observer,
+    std::atomic_bool& cancelled) {
+  return Single<int>::create(
+      [&observer, &cancelled](std::shared_ptr<SingleObserver<int>> obs) {
+        obs->onSubscribe(SingleSubscriptions::create(cancelled));
+        observer = std::move(obs);
+      });
+}
+} // namespace
+
+TEST(Single, ZipKeepsOrder) {
+  std::shared_ptr<SingleObserver<int>> first, second;
+  std::atomic_bool cancelled{false};
+  auto zipped = Singles::zip<int>({pendingSingle(first, cancelled),
+                                   Singles::just<int>(2),
+                                   pendingSingle(second, cancelled)});
+
+  auto observer = SingleTestObserver<std::vector<int>>::create();
+  zipped->subscribe(observer);
+  observer->assertNoTerminalEvent();
+
+  second->onSuccess(3);
+  observer->assertNoTerminalEvent();
+  first->onSuccess(1);
+  observer->assertSuccess();
+  EXPECT_EQ((std::vector<int>{1, 2, 3}), observer->getOnSuccessValue());
+  EXPECT_FALSE(cancelled);
+}
+
+TEST(Single, ZipFailsFast) {
+  std::shared_ptr<SingleObserver<int>> first, second;
+  std::atomic_bool firstCancelled{false}, secondCancelled{false};
+  auto zipped = Singles::zip<int>({pendingSingle(first, firstCancelled),
+                                   pendingSingle(second, secondCancelled)});
+
+  auto observer = SingleTestObserver<std::vector<int>>::create();
+  zipped->subscribe(observer);
+
+  second->onError(std::runtime_error("boom"));
+  observer->assertOnErrorMessage("boom");
+  EXPECT_TRUE(firstCancelled);
+  EXPECT_FALSE(secondCancelled);
+}
+
+TEST(Single, ZipCancel) {
+  std::shared_ptr<SingleObserver<int>> first;
+  std::atomic_bool cancelled{false};
+  auto zipped = Singles::zip<int>({pendingSingle(first, cancelled)});
+
+  auto observer = SingleTestObserver<std::vector<int>>::create();
+  zipped->subscribe(observer);
+  observer->cancel();
+  EXPECT_TRUE(cancelled);
+
+  first->onSuccess(1);
+  observer->assertNoTerminalEvent();
+}
+
+TEST(Single, ZipEmpty) {
+  auto observer = SingleTestObserver<std::vector<int>>::create();
+  Singles::zip<int>({})->subscribe(observer);
+  observer->assertSuccess();
+  EXPECT_TRUE(observer->getOnSuccessValue().empty());
+}
+
+TEST(Single, WhenAllCollectsErrors) {
+  auto all = Singles::whenAll<int>(
+      {Singles::just<int>(1),
+       Singles::error<int>(std::runtime_error("boom")),
+       Singles::just<int>(3)});
+
+  auto observer = SingleTestObserver<std::vector<folly::Try<int>>>::create();
+  all->subscribe(observer);
+  observer->assertSuccess();
+
+  auto& results = observer->getOnSuccessValue();
+  ASSERT_EQ(3, results.size());
+  EXPECT_EQ(1, results[0].value());
+  EXPECT_TRUE(results[1].hasException());
+  EXPECT_EQ(3, results[2].value());
+}
+
+TEST(Single, FirstOf) {
+  std::shared_ptr<SingleObserver<int>> first, second;
+  std::atomic_bool firstCancelled{false}, secondCancelled{false};
+  auto single = Singles::firstOf<int>({pendingSingle(first, firstCancelled),
+                                       pendingSingle(second, secondCancelled)});
+
+  auto observer = SingleTestObserver<int>::create();
+  single->subscribe(observer);
+
+  first->onError(std::runtime_error("boom"));
+  observer->assertNoTerminalEvent();
+  second->onSuccess(2);
+  observer->assertOnSuccessValue(2);
+  EXPECT_FALSE(firstCancelled);
+  EXPECT_FALSE(secondCancelled);
+}
+
+TEST(Single, FirstOfAllFail) {
+  auto single = Singles::firstOf<int>(
+      {Singles::error<int>(std::runtime_error("first")),
+       Singles::error<int>(std::runtime_error("last"))});
+
+  auto observer = SingleTestObserver<int>::create();
+  single->subscribe(observer);
+  observer->assertOnErrorMessage("last");
+
+  auto empty = SingleTestObserver<int>::create();
+  Singles::firstOf<int>({})->subscribe(empty);
+  EXPECT_TRUE(empty->getError().is_compatible_with<std::invalid_argument>());
+}
@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <folly/executors/ManualExecutor.h>
 #include <folly/io/async/ScopedEventBaseThread.h>
 #include <folly/synchronization/Baton.h>
 #include <gtest/gtest.h>
@@ -217,3 +218,74 @@ TEST(FlowableTests, EarlyCancelObserveOn) {
 
   subscriber_complete.timed_wait(timeout);
 }
+
+namespace {
+/// Runs the tasks of a ManualExecutor until there are none left, returning
+/// how many ran.
+size_t runAll(folly::ManualExecutor& executor) {
+  size_t tasks = 0;
+  while (auto ran = executor.run()) {
+    tasks += ran;
+  }
+  return tasks;
+}
+} // namespace
+
+TEST(FlowableTests, ObserveOnBatchesElements) {
+  folly::ManualExecutor executor;
+  auto subscriber = std::make_shared<TestSubscriber<int64_t>>();
+  Flowable<>::range(1, 100)->observeOn(executor)->subscribe(subscriber);
+
+  // One task for onSubscribe, and one drain for all the elements and the
+  // completion.
+  EXPECT_EQ(2, runAll(executor));
+  EXPECT_EQ(100, subscriber->getValueCount());
+  EXPECT_EQ(1, subscriber->values().front());
+  EXPECT_EQ(100, subscriber->values().back());
+  EXPECT_TRUE(subscriber->isComplete());
+}
+
+TEST(FlowableTests, ObserveOnLimitsBatchSize) {
+  constexpr auto kMaxBatch =
+      detail::ObserveOnOperatorSubscriber<int64_t>::kMaxBatch;
+
+  folly::ManualExecutor executor;
+  auto subscriber = std::make_shared<TestSubscriber<int64_t>>();
+  Flowable<>::range(1, 3 * kMaxBatch + 1)
+      ->observeOn(executor)
+      ->subscribe(subscriber);
+
+  EXPECT_EQ(1 + 4, runAll(executor));
+  EXPECT_EQ(3 * kMaxBatch + 1, subscriber->getValueCount());
+  EXPECT_TRUE(subscriber->isComplete());
+}
+
+TEST(FlowableTests, ObserveOnDeliversErrorAfterElements) {
+  folly::ManualExecutor executor;
+  auto f = Flowable<int>::create([](auto& subscriber, auto) {
+    subscriber.onNext(1);
+    subscriber.onNext(2);
+    subscriber.onError(std::runtime_error("oops!"));
+  });
+
+  auto subscriber = std::make_shared<TestSubscriber<int>>();
+  f->observeOn(executor)->subscribe(subscriber);
+  runAll(executor);
+
+  EXPECT_EQ(std::vector<int>({1, 2}), subscriber->values());
+  EXPECT_TRUE(subscriber->isError());
+  EXPECT_EQ("oops!", subscriber->getErrorMsg());
+}
+
+TEST(FlowableTests, ObserveOnStopsDeliveringAfterCancel) {
+  folly::ManualExecutor executor;
+  auto subscriber = std::make_shared<TestSubscriber<int64_t>>(10);
+  Flowable<>::range(1, 100)->observeOn(executor)->subscribe(subscriber);
+
+  executor.run();
+  subscriber->cancel();
+  runAll(executor);
+
+  EXPECT_EQ(0, subscriber->getValueCount());
+  EXPECT_FALSE(subscriber->isComplete());
+}
@@ -59,6 +59,21 @@ TEST(ThriftStreamShimTest, ClientStream) {
   EXPECT_EQ(run(flowable), std::vector<int>({1, 2, 3, 4, 5}));
 }
 
+TEST(ThriftStreamShimTest, ClientStreamCredits) {
+  auto flowable = ThriftStreamShim::fromClientStream(
+      makeRange(1, 5), folly::getEventBase());
+  auto subscriber = std::make_shared<TestSubscriber<int>>(2);
+  flowable->subscribe(subscriber);
+  subscriber->awaitValueCount(2);
+
+  // Passed on to the stream together, or one by one; either way all of them.
+  subscriber->request(1);
+  subscriber->request(1);
+  subscriber->request(10);
+  subscriber->awaitTerminalEvent(std::chrono::seconds(1));
+  EXPECT_EQ(subscriber->values(), std::vector<int>({1, 2, 3, 4, 5}));
+}
+
 TEST(ThriftStreamShimTest, ServerStream) {
   auto stream = ThriftStreamShim::toServerStream(Flowable<>::range(1, 5));
   EXPECT_EQ(run(std::move(stream)), std::vector<long>({1, 2, 3, 4, 5}));
@@ -119,3 +119,47 @@ TEST(Credits, consumeTooMany) {
   consume(&rn, 110);
   ASSERT_EQ(rn, 0);
 }
+
+template <typename Confinement>
+class CreditsCounter : public ::testing::Test {};
+
+using Confinements = ::testing::Types<Concurrent, ThreadConfined>;
+TYPED_TEST_CASE(CreditsCounter, Confinements);
+
+TYPED_TEST(CreditsCounter, addAndConsume) {
+  Credits<TypeParam> credits;
+  EXPECT_EQ(10, credits.add(10));
+  EXPECT_EQ(10, credits.add(-5));
+  EXPECT_EQ(7, credits.consume(3));
+  EXPECT_EQ(0, credits.consume(100));
+  EXPECT_EQ(0, credits.load());
+}
+
+TYPED_TEST(CreditsCounter, tryConsume) {
+  Credits<TypeParam> credits;
+  credits.add(2);
+  EXPECT_FALSE(credits.tryConsume(3));
+  EXPECT_TRUE(credits.tryConsume(2));
+  EXPECT_FALSE(credits.tryConsume(1));
+  EXPECT_FALSE(credits.tryConsume(0));
+}
+
+TYPED_TEST(CreditsCounter, infinite) {
+  Credits<TypeParam> credits;
+  credits.add(100);
+  EXPECT_EQ(INT64_MAX, credits.add(INT64_MAX));
+  EXPECT_TRUE(credits.isInfinite());
+  credits.consume(10);
+  EXPECT_TRUE(credits.isInfinite());
+}
+
+TYPED_TEST(CreditsCounter, cancel) {
+  Credits<TypeParam> credits;
+  credits.add(100);
+  EXPECT_TRUE(credits.cancel());
+  EXPECT_FALSE(credits.cancel());
+  credits.add(1);
+  credits.consume(1);
+  EXPECT_TRUE(credits.isCancelled());
+  EXPECT_EQ(INT64_MIN, credits.load());
+}
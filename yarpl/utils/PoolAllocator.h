@@ -0,0 +1,156 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace yarpl {
+
+namespace details {
+
+/// Per-thread cache of freed blocks of `Size` bytes.
+///
+/// The list itself is trivially destructible so that it stays usable while
+/// other thread_locals are being destroyed; the Reaper frees the cached
+/// blocks at thread exit and makes later deallocations bypass the cache.
+template <size_t Size>
+class BlockCache {
+ public:
+  static constexpr uint32_t kMaxCachedBlocks = 1024;
+
+  static void* allocate() {
+    auto& list = freeList();
+    if (list.head) {
+      auto node = list.head;
+      list.head = node->next;
+      --list.count;
+      return node;
+    }
+    return ::operator new(Size);
+  }
+
+  static void deallocate(void* p) {
+    auto& list = freeList();
+    if (list.dead || list.count >= kMaxCachedBlocks) {
+      ::operator delete(p);
+      return;
+    }
+    reaper();
+    auto node = static_cast<Node*>(p);
+    node->next = list.head;
+    list.head = node;
+    ++list.count;
+  }
+
+ private:
+  struct Node {
+    Node* next;
+  };
+
+  struct FreeList {
+    Node* head;
+    uint32_t count;
+    bool dead;
+  };
+
+  struct Reaper {
+    ~Reaper() {
+      auto& list = freeList();
+      while (auto node = list.head) {
+        list.head = node->next;
+        ::operator delete(node);
+      }
+      list.count = 0;
+      list.dead = true;
+    }
+  };
+
+  static FreeList& freeList() {
+    static thread_local FreeList list{nullptr, 0, false};
+    return list;
+  }
+
+  // Registers the thread's Reaper the first time it caches a block.
+  static void reaper() {
+    static thread_local Reaper reaper;
+    (void)reaper;
+  }
+};
+
+} // namespace details
+
+/**
+ * Stateless allocator that recycles single-object allocations through a
+ * per-thread free list, one list per size class.
+ *
+ * Meant for std::allocate_shared of short-lived, fixed-size objects such as
+ * the lambda subscribers and subscriptions of a request/response stream,
+ * where a make_shared per stream otherwise dominates.  Blocks freed on a
+ * different thread than they were allocated on go to the freeing thread's
+ * list.  Each list caches at most BlockCache::kMaxCachedBlocks blocks; array
+ * allocations always go to the global allocator.
+ */
+template <typename T>
+class PoolAllocator {
+ public:
+  using value_type = T;
+
+  PoolAllocator() noexcept = default;
+
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U>&) noexcept {}
+
+  T* allocate(size_t n) {
+    if (n != 1) {
+      return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    return static_cast<T*>(details::BlockCache<blockSize()>::allocate());
+  }
+
+  void deallocate(T* p, size_t n) noexcept {
+    if (n != 1) {
+      ::operator delete(p);
+      return;
+    }
+    details::BlockCache<blockSize()>::deallocate(p);
+  }
+
+  template <typename U>
+  bool operator==(const PoolAllocator<U>&) const noexcept {
+    return true;
+  }
+
+  template <typename U>
+  bool operator!=(const PoolAllocator<U>&) const noexcept {
+    return false;
+  }
+
+ private:
+  static constexpr size_t kAlign = alignof(std::max_align_t);
+
+  // Rounding up to the fundamental alignment keeps blocks suitably aligned
+  // and lets similarly-sized types share a list.  A function rather than a
+  // constant so that PoolAllocator<void> can be rebound from.
+  static constexpr size_t blockSize() {
+    static_assert(
+        alignof(T) <= kAlign,
+        "PoolAllocator does not support over-aligned types");
+    return (sizeof(T) + kAlign - 1) / kAlign * kAlign;
+  }
+};
+
+} // namespace yarpl
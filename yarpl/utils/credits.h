@@ -14,6 +14,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <cstdint>
 #include <limits>
@@ -96,5 +97,121 @@ bool isCancelled(std::atomic<int64_t>*);
  */
 bool isInfinite(std::atomic<int64_t>*);
 
+/**
+ * Tags selecting how a Credits counter is synchronized.
+ *
+ * A Concurrent counter may be modified from several threads at once, and
+ * goes through the compare_exchange_strong loops above.  A ThreadConfined
+ * counter is only modified from one thread at a time, e.g. the EventBase its
+ * operator runs on, so it gets by with relaxed loads and stores and no
+ * read-modify-write operations.  Other threads may still read it, but
+ * without any ordering.
+ */
+struct Concurrent {};
+struct ThreadConfined {};
+
+/**
+ * Credits of a subscription, with the semantics of the functions above:
+ * capped at kNoFlowControl, which is never consumed, and frozen once
+ * cancelled.
+ */
+template <typename Confinement>
+class Credits;
+
+template <>
+class Credits<Concurrent> {
+ public:
+  int64_t load() const {
+    return value_.load();
+  }
+
+  int64_t add(int64_t n) {
+    return credits::add(&value_, n);
+  }
+
+  int64_t consume(int64_t n) {
+    return credits::consume(&value_, n);
+  }
+
+  bool tryConsume(int64_t n) {
+    return credits::tryConsume(&value_, n);
+  }
+
+  bool cancel() {
+    return credits::cancel(&value_);
+  }
+
+  bool isCancelled() const {
+    return load() == kCanceled;
+  }
+
+  bool isInfinite() const {
+    return load() == kNoFlowControl;
+  }
+
+ private:
+  std::atomic<int64_t> value_{0};
+};
+
+template <>
+class Credits<ThreadConfined> {
+ public:
+  int64_t load() const {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+  int64_t add(int64_t n) {
+    auto const r = load();
+    if (r == kCanceled || n <= 0) {
+      return r;
+    }
+    auto const u = credits::add(r, n);
+    store(u);
+    return u;
+  }
+
+  int64_t consume(int64_t n) {
+    auto const r = load();
+    if (r == kNoFlowControl || r == kCanceled || n <= 0) {
+      return r;
+    }
+    auto const u = r - std::min(r, n);
+    store(u);
+    return u;
+  }
+
+  bool tryConsume(int64_t n) {
+    auto const r = load();
+    if (n <= 0 || r < n) {
+      return false;
+    }
+    store(r - n);
+    return true;
+  }
+
+  bool cancel() {
+    if (load() == kCanceled) {
+      return false;
+    }
+    store(kCanceled);
+    return true;
+  }
+
+  bool isCancelled() const {
+    return load() == kCanceled;
+  }
+
+  bool isInfinite() const {
+    return load() == kNoFlowControl;
+  }
+
+ private:
+  void store(int64_t value) {
+    value_.store(value, std::memory_order_relaxed);
+  }
+
+  std::atomic<int64_t> value_{0};
+};
+
 } // namespace credits
 } // namespace yarpl